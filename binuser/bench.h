@@ -0,0 +1,137 @@
+#pragma once
+
+#include <sys/syscall.h>
+
+/* The helpers shared by the userspace benchmarks (bench_*.c).
+ *
+ * A benchmark times a batch of `batch` operations per sample with sys_get_ticks(), and reports the minimum, the
+ * median and the 99th percentile of the time of an operation (in nanoseconds), and optionally a throughput (e.g.
+ * pixels per second, from the median). The results are printed with sys_print() as JSON lines, in the format
+ * read by tools/run-benchmarks.py:
+ *
+ *   BENCH_BEGIN {"program": "bench_syscall", "tick_frequency": 62500000}
+ *   BENCH {"name": "syscall.getpid", "iterations": 8192, "ns_min": 410, "ns_median": 423, "ns_p99": 1170}
+ *   BENCH_END {}
+ */
+
+#define BENCH_MAX_SAMPLES 256
+#define BENCH_MAX_LINE_SIZE 256
+
+typedef struct bench_t {
+  const char* name;
+  /* The operations timed by a sample. */
+  uint64_t batch;
+  /* The ticks of each sample. */
+  uint64_t samples[BENCH_MAX_SAMPLES];
+  size_t count;
+  uint64_t start;
+} bench_t;
+
+/* Appends `text` at `buffer`, and returns the position after it. */
+static char* bench_append_text(char* buffer, const char* text) {
+  while (*text != '\0')
+    *buffer++ = *text++;
+  return buffer;
+}
+
+/* Appends the decimal representation of `value` at `buffer`, and returns the position after it. */
+static char* bench_append_number(char* buffer, uint64_t value) {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (count > 0)
+    *buffer++ = digits[--count];
+  return buffer;
+}
+
+static uint64_t bench_ticks_to_ns(uint64_t ticks) {
+  // Split to not overflow with the long samples.
+  const uint64_t frequency = sys_get_tick_frequency();
+  return (ticks / frequency) * 1000000000 + ((ticks % frequency) * 1000000000) / frequency;
+}
+
+static void bench_begin(const char* program) {
+  char line[BENCH_MAX_LINE_SIZE];
+  char* end = bench_append_text(line, "BENCH_BEGIN {\"program\": \"");
+  end = bench_append_text(end, program);
+  end = bench_append_text(end, "\", \"tick_frequency\": ");
+  end = bench_append_number(end, sys_get_tick_frequency());
+  end = bench_append_text(end, "}");
+  *end = '\0';
+  sys_print(line);
+}
+
+static void bench_end() {
+  sys_print("BENCH_END {}");
+}
+
+static void bench_init(bench_t* bench, const char* name, uint64_t batch) {
+  bench->name = name;
+  bench->batch = batch;
+  bench->count = 0;
+}
+
+static bool bench_is_done(const bench_t* bench) {
+  return bench->count == BENCH_MAX_SAMPLES;
+}
+
+/* Records a sample measured by the caller (e.g. across processes, see bench_spawn.c). */
+static void bench_add_sample(bench_t* bench, uint64_t ticks) {
+  if (bench->count < BENCH_MAX_SAMPLES)
+    bench->samples[bench->count++] = ticks;
+}
+
+static void bench_start_sample(bench_t* bench) {
+  bench->start = sys_get_ticks();
+}
+
+static void bench_stop_sample(bench_t* bench) {
+  const uint64_t end = sys_get_ticks();
+  bench_add_sample(bench, end - bench->start);
+}
+
+/* Prints the result of `bench`. If `unit` is not NULL, the throughput of `units_per_op` units per operation is
+ * added as "<unit>_per_s". */
+static void bench_report(bench_t* bench, const char* unit, uint64_t units_per_op) {
+  if (bench->count == 0)
+    return;
+
+  // Few samples, an insertion sort is enough.
+  for (size_t i = 1; i < bench->count; ++i) {
+    const uint64_t sample = bench->samples[i];
+    size_t j = i;
+    for (; j > 0 && bench->samples[j - 1] > sample; --j)
+      bench->samples[j] = bench->samples[j - 1];
+    bench->samples[j] = sample;
+  }
+
+  const uint64_t batch = bench->batch != 0 ? bench->batch : 1;
+  const uint64_t median = bench->samples[bench->count / 2];
+  const uint64_t p99 = bench->samples[(bench->count * 99) / 100];
+
+  char line[BENCH_MAX_LINE_SIZE];
+  char* end = bench_append_text(line, "BENCH {\"name\": \"");
+  end = bench_append_text(end, bench->name);
+  end = bench_append_text(end, "\", \"iterations\": ");
+  end = bench_append_number(end, bench->count * batch);
+  end = bench_append_text(end, ", \"ns_min\": ");
+  end = bench_append_number(end, bench_ticks_to_ns(bench->samples[0]) / batch);
+  end = bench_append_text(end, ", \"ns_median\": ");
+  end = bench_append_number(end, bench_ticks_to_ns(median) / batch);
+  end = bench_append_text(end, ", \"ns_p99\": ");
+  end = bench_append_number(end, bench_ticks_to_ns(p99) / batch);
+  if (unit != NULL && median != 0) {
+    end = bench_append_text(end, ", \"");
+    end = bench_append_text(end, unit);
+    end = bench_append_text(end, "_per_s\": ");
+    end = bench_append_number(end, (units_per_op * batch * sys_get_tick_frequency()) / median);
+  }
+
+  end = bench_append_text(end, "}");
+  *end = '\0';
+  sys_print(line);
+}
@@ -0,0 +1,96 @@
+#include <sys/file.h>
+#include "bench.h"
+
+/* The latency of opening a file, the read throughput for small and large reads, and the listing of a directory
+ * entry by entry or in bulk, on the ramdisk. */
+
+#define FILE_PATH "/wallpaper.jpg"
+#define DIR_PATH "/bin"
+#define OPEN_BATCH 16
+#define DIR_SAMPLES 64
+#define MAX_READ_SIZE (64 * 1024)
+
+static bench_t g_bench;
+static uint8_t g_buffer[MAX_READ_SIZE];
+
+static void bench_open_close() {
+  bench_init(&g_bench, "fs.open_close", OPEN_BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (int i = 0; i < OPEN_BATCH; ++i)
+      sys_close_file(sys_open_file(FILE_PATH, SYS_FM_READ));
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, NULL, 0);
+}
+
+/* Each sample reads the whole file with reads of `read_size` bytes. */
+static void bench_read(sys_file_t* file, size_t read_size, const char* name) {
+  const size_t file_size = sys_get_file_size(file);
+  bench_init(&g_bench, name, 1);
+  while (!bench_is_done(&g_bench)) {
+    sys_file_seek(file, 0);
+    bench_start_sample(&g_bench);
+    size_t read_bytes = 0;
+    do {
+      if (!SYS_IS_OK(sys_file_read(file, g_buffer, read_size, &read_bytes)))
+        break;
+    } while (read_bytes != 0);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "bytes", file_size);
+}
+
+/* Returns the count of entries of the directory (one sample lists it once). */
+static size_t bench_read_dir() {
+  size_t count = 0;
+  bench_init(&g_bench, "fs.read_dir", 1);
+  for (int i = 0; i < DIR_SAMPLES; ++i) {
+    count = 0;
+    bench_start_sample(&g_bench);
+    sys_dir_t* dir = sys_open_dir(DIR_PATH);
+    sys_file_info_t info;
+    while (SYS_IS_OK(sys_read_dir(dir, &info)))
+      ++count;
+    sys_close_dir(dir);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "entries", count);
+  return count;
+}
+
+static void bench_read_dir_many(size_t count) {
+  bench_init(&g_bench, "fs.read_dir_many", 1);
+  for (int i = 0; i < DIR_SAMPLES; ++i) {
+    bench_start_sample(&g_bench);
+    sys_dir_t* dir = sys_open_dir(DIR_PATH);
+    size_t read_size = 0;
+    while (SYS_IS_OK(sys_read_dir_many(dir, g_buffer, MAX_READ_SIZE, 0, &read_size)) && read_size != 0)
+      continue;
+    sys_close_dir(dir);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "entries", count);
+}
+
+int main() {
+  sys_file_t* file = sys_open_file(FILE_PATH, SYS_FM_READ);
+  if (file == NULL) {
+    sys_print("Failed to open " FILE_PATH " for bench_fs");
+    return 1;
+  }
+
+  bench_begin("bench_fs");
+  bench_open_close();
+  bench_read(file, 4 * 1024, "fs.read_4k");
+  bench_read(file, MAX_READ_SIZE, "fs.read_64k");
+  bench_read_dir_many(bench_read_dir());
+  bench_end();
+
+  sys_close_file(file);
+  return 0;
+}
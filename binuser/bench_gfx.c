@@ -0,0 +1,146 @@
+#include <gfx/gfx.h>
+#include <sys/syscall.h>
+#include <sys/window.h>
+#include "bench.h"
+
+/* The throughput of the drawing system calls for a few sizes, the same drawing by libgfx into the window surface,
+ * and the present rate of the whole window. */
+
+#define WIDTH 640
+#define HEIGHT 480
+#define BATCH 16
+#define MAX_SIZE 256
+#define MAX_TEXT_LENGTH 128
+
+static bench_t g_bench;
+static uint32_t g_pixels[MAX_SIZE * MAX_SIZE];
+static char g_text[MAX_TEXT_LENGTH + 1];
+
+static void bench_fill_rect(sys_window_t* window, uint32_t size, const char* name) {
+  bench_init(&g_bench, name, BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (uint32_t i = 0; i < BATCH; ++i)
+      sys_gfx_fill_rect(window, i, i, size, size, 0xff000000 | (i * 0x0f0f0f));
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "pixels", size * size);
+}
+
+static void bench_blit(sys_window_t* window, uint32_t size, const char* name) {
+  bench_init(&g_bench, name, BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (uint32_t i = 0; i < BATCH; ++i)
+      sys_gfx_blit(window, i, i, size, size, g_pixels);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "pixels", size * size);
+}
+
+static void bench_draw_text(sys_window_t* window, uint32_t length, const char* name) {
+  for (uint32_t i = 0; i < length; ++i)
+    g_text[i] = (char)('a' + i % 26);
+  g_text[length] = '\0';
+
+  bench_init(&g_bench, name, BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (uint32_t i = 0; i < BATCH; ++i)
+      sys_gfx_draw_text(window, 0, i * 16, g_text, 0x000000);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "chars", length);
+}
+
+static void bench_libgfx_fill_rect(gfx_painter_t* painter, uint32_t size, uint32_t alpha, const char* name) {
+  bench_init(&g_bench, name, BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (uint32_t i = 0; i < BATCH; ++i)
+      gfx_fill_rect(painter, i, i, size, size, (alpha << 24) | (i * 0x0f0f0f));
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "pixels", size * size);
+}
+
+static void bench_libgfx_draw_text(gfx_painter_t* painter, uint32_t length, const char* name) {
+  for (uint32_t i = 0; i < length; ++i)
+    g_text[i] = (char)('a' + i % 26);
+  g_text[length] = '\0';
+
+  bench_init(&g_bench, name, BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (uint32_t i = 0; i < BATCH; ++i)
+      gfx_draw_text(painter, 0, i * 16, g_text, 0xff000000);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "chars", length);
+}
+
+static void bench_libgfx(sys_window_t* window) {
+  gfx_font_t font;
+  gfx_painter_t painter;
+  if (!SYS_IS_OK(gfx_font_load(&font, "/fonts/firacode_16.pkf")))
+    return;
+  if (!SYS_IS_OK(gfx_painter_init_window(&painter, window))) {
+    gfx_font_destroy(&font);
+    return;
+  }
+
+  gfx_set_font(&painter, &font);
+  bench_libgfx_fill_rect(&painter, 64, 0xff, "libgfx.fill_rect_64");
+  bench_libgfx_fill_rect(&painter, 256, 0xff, "libgfx.fill_rect_256");
+  bench_libgfx_fill_rect(&painter, 256, 0x80, "libgfx.blend_rect_256");
+  bench_libgfx_draw_text(&painter, 32, "libgfx.draw_text_32");
+  bench_libgfx_draw_text(&painter, 128, "libgfx.draw_text_128");
+  gfx_font_destroy(&font);
+}
+
+static void bench_present(sys_window_t* window) {
+  // Each frame is damaged as a whole, as an animation redrawing the window would.
+  bench_init(&g_bench, "gfx.present_640x480", 1);
+  for (uint32_t i = 0; !bench_is_done(&g_bench); ++i) {
+    sys_gfx_fill_rect(window, 0, 0, WIDTH, HEIGHT, 0xff000000 | (i * 0x010101));
+    bench_start_sample(&g_bench);
+    sys_window_present(window);
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, "frames", 1);
+}
+
+int main() {
+  sys_window_t* window =
+      sys_window_create("Benchmark", SYS_POS_DEFAULT, SYS_POS_DEFAULT, WIDTH, HEIGHT, SYS_WF_DEFAULT);
+  if (window == NULL) {
+    sys_print("Failed to create window for bench_gfx");
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < MAX_SIZE * MAX_SIZE; ++i)
+    g_pixels[i] = 0xff000000 | (i * 0x010203);
+
+  bench_begin("bench_gfx");
+  bench_fill_rect(window, 16, "gfx.fill_rect_16");
+  bench_fill_rect(window, 64, "gfx.fill_rect_64");
+  bench_fill_rect(window, 256, "gfx.fill_rect_256");
+  bench_blit(window, 16, "gfx.blit_16");
+  bench_blit(window, 64, "gfx.blit_64");
+  bench_blit(window, 256, "gfx.blit_256");
+  bench_draw_text(window, 8, "gfx.draw_text_8");
+  bench_draw_text(window, 32, "gfx.draw_text_32");
+  bench_draw_text(window, 128, "gfx.draw_text_128");
+  bench_libgfx(window);
+  bench_present(window);
+  bench_end();
+
+  sys_window_destroy(window);
+  return 0;
+}
@@ -0,0 +1,51 @@
+#include <sys/channel.h>
+#include "bench.h"
+
+/* The latency from sys_spawn() to the first instruction of the new process, i.e. the loading of the program and
+ * its first scheduling. The program spawns itself: the child connects to the channel of the parent and sends it
+ * the ticks read as soon as it starts. */
+
+#define CHANNEL_NAME "bench_spawn"
+#define SPAWN_COUNT 32
+
+static bench_t g_bench;
+
+int main() {
+  const uint64_t start_ticks = sys_get_ticks();
+
+  sys_channel_t channel;
+  if (SYS_IS_OK(sys_channel_connect(CHANNEL_NAME, &channel))) {
+    sys_channel_send(&channel, 0, &start_ticks, sizeof(start_ticks), 0);
+    sys_channel_close(&channel);
+    return 0;
+  }
+
+  bench_begin("bench_spawn");
+  bench_init(&g_bench, "spawn.first_instruction", 1);
+  for (int i = 0; i < SPAWN_COUNT; ++i) {
+    if (!SYS_IS_OK(sys_channel_create(CHANNEL_NAME, &channel))) {
+      sys_print("Failed to create the channel of bench_spawn");
+      return 1;
+    }
+
+    const uint64_t spawn_ticks = sys_get_ticks();
+    if (!SYS_IS_OK(sys_spawn("/bin/bench_spawn"))) {
+      sys_print("Failed to spawn /bin/bench_spawn");
+      sys_channel_close(&channel);
+      return 1;
+    }
+
+    sys_channel_message_t message;
+    if (SYS_IS_OK(sys_channel_receive(&channel, &message)) && message.size == sizeof(uint64_t)) {
+      uint64_t child_ticks;
+      __builtin_memcpy(&child_ticks, message.data, sizeof(child_ticks));
+      bench_add_sample(&g_bench, child_ticks - spawn_ticks);
+    }
+
+    sys_channel_close(&channel);
+  }
+
+  bench_report(&g_bench, NULL, 0);
+  bench_end();
+  return 0;
+}
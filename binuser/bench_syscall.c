@@ -0,0 +1,55 @@
+#include "bench.h"
+
+/* The round-trip latency of the cheapest system calls, i.e. the cost of the kernel entry and exit. */
+
+#define BATCH 64
+
+static bench_t g_bench;
+
+static void op_get_ticks() {
+  sys_get_ticks();
+}
+
+static void op_get_time_ns() {
+  sys_get_time_ns();
+}
+
+static void op_getpid() {
+  sys_getpid();
+}
+
+static void op_yield() {
+  sys_yield();
+}
+
+static void op_sbrk() {
+  sys_sbrk(4096);
+  sys_sbrk(-4096);
+}
+
+static void run(const char* name, void (*op)()) {
+  bench_init(&g_bench, name, BATCH);
+  while (!bench_is_done(&g_bench)) {
+    bench_start_sample(&g_bench);
+    for (int i = 0; i < BATCH; ++i)
+      op();
+    bench_stop_sample(&g_bench);
+  }
+
+  bench_report(&g_bench, NULL, 0);
+}
+
+int main() {
+  bench_begin("bench_syscall");
+  // Not a system call, the overhead of the measure itself.
+  run("syscall.get_ticks", op_get_ticks);
+  // Neither are these ones anymore, they read a register and the information page.
+  run("syscall.getpid", op_getpid);
+  run("syscall.get_time_ns", op_get_time_ns);
+  // Switches to another task only if one is runnable.
+  run("syscall.yield", op_yield);
+  // A page is added to the heap and removed, without being touched.
+  run("syscall.sbrk_grow_shrink", op_sbrk);
+  bench_end();
+  return 0;
+}
@@ -1,48 +1,62 @@
+#include <gfx/gfx.h>
 #include <sys/syscall.h>
 #include <sys/window.h>
 
-static void draw_credits(sys_window_t* window) {
-  sys_gfx_clear(window, 0xffffff);
-  sys_gfx_draw_text(window, 20, 50, "Proudly presented by:", 0x000000);
+// Drawn into the window surface by libgfx, then only the damaged area is presented.
+static gfx_font_t g_font;
 
-  uint32_t x = 20, y = 80;
-#define DRAW_ITEM(text)                                      \
-  sys_gfx_fill_rect(window, x + 5, y + 5, 5, 5, 0xff000000); \
-  sys_gfx_draw_text(window, x + 20, y, (text), 0x000000);    \
+static void draw_credits(sys_window_t* window) {
+  gfx_painter_t painter;
+  if (!SYS_IS_OK(gfx_painter_init_window(&painter, window)))
+    return;
+
+  gfx_set_font(&painter, &g_font);
+  gfx_clear(&painter, 0xffffff);
+  gfx_draw_text(&painter, 20, 50, "Proudly presented by:", 0xff000000);
+
+  int32_t x = 20, y = 80;
+#define DRAW_ITEM(text)                                    \
+  gfx_fill_rect(&painter, x + 5, y + 5, 5, 5, 0xff000000); \
+  gfx_draw_text(&painter, x + 20, y, (text), 0xff000000);  \
   y += 20
 
   DRAW_ITEM("Gabriel Desfrene");
   DRAW_ITEM("Hubert Gruniaux");
   DRAW_ITEM("Emile Sauvat");
+
+  gfx_present(&painter, window);
+}
+
+static void on_frame(sys_event_loop_t* loop, uint64_t frame_time_us) {
+  (void)frame_time_us;
+  draw_credits(loop->window);
+}
+
+static void on_message(sys_event_loop_t* loop, const sys_message_t* message) {
+  // The resizes are redrawn by the event loop, once per frame.
+  if (message->id == SYS_MSG_CLOSE)
+    sys_event_loop_quit(loop);
 }
 
 int main() {
   sys_print("CREDITS");
 
+  if (!SYS_IS_OK(gfx_font_load(&g_font, "/fonts/firacode_16.pkf"))) {
+    sys_print("Failed to load the font for credits");
+    return 1;
+  }
+
   sys_window_t* window = sys_window_create("Credits", SYS_POS_DEFAULT, SYS_POS_DEFAULT, 500, 400, SYS_WF_DEFAULT);
   if (window == NULL) {
     sys_print("Failed to create window for credits");
     return 1;
   }
 
-  draw_credits(window);
-
-  bool should_close = false;
-  while (!should_close) {
-    sys_message_t message;
-    sys_wait_message(window, &message);
-    switch (message.id) {
-      case SYS_MSG_CLOSE:
-        should_close = true;
-        break;
-      case SYS_MSG_RESIZE:
-        draw_credits(window);
-        break;
-      default:
-        break;
-    }
-  }
+  sys_event_loop_t loop;
+  sys_event_loop_init(&loop, window, on_message, on_frame, NULL);
+  sys_event_loop_run(&loop);
 
   sys_window_destroy(window);
+  gfx_font_destroy(&g_font);
   return 0;
 }
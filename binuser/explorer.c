@@ -1,3 +1,5 @@
+#include <gfx/gfx.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
 #include <sys/keyboard.h>
@@ -7,92 +9,431 @@
 #define INDENT 20
 #define TITLE_BAR_HEIGHT 30
 #define PADDING 20
+#define ROW_HEIGHT 20
+// The y coordinate of the first visible row.
+#define ROWS_TOP (TITLE_BAR_HEIGHT + PADDING)
+// The buffer of each open directory level, a page of entries is read by each system call.
+#define DIR_BUFFER_SIZE 1024
+#define MAX_DEPTH 16
+#define MAX_PATH_LENGTH 256
+// The preview of the selected image, at the top right corner (see sys_get_thumbnail()).
+#define PREVIEW_SIZE 128
+// The rows covered by the preview, from the first visible one.
+#define PREVIEW_ROW_COUNT ((PREVIEW_SIZE + ROW_HEIGHT - 1) / ROW_HEIGHT + 1)
 
-static sys_window_t* window = NULL;
+#define BACKGROUND_COLOR 0xff000000
+#define DIR_COLOR 0xffff0000
+#define FILE_COLOR 0xffffff00
+#define SELECTED_MARKER_COLOR 0xff6ba4b8
+#define MARKER_COLOR 0xffffffff
 
-static uint32_t current_x, current_y, current_idx;
-static uint32_t current_selected = 10;
+#define NO_ROW UINT32_MAX
 
-static sys_bool_t current_is_file = sys_false;
-static const char* current_path = NULL;
+/*
+ * The model: the rows of the directory tree in depth-first order (all the directories are expanded). The
+ * directories are read lazily, page by page with sys_read_dir_many(), only until the rows to show are known: the
+ * open directories form a stack, each with the page of entries it is consuming.
+ */
+
+typedef struct {
+  // The parent directory row, NO_ROW for the entries of the root.
+  uint32_t parent;
+  // The offset of the name in the names pool.
+  uint32_t name_offset;
+  uint32_t depth;
+  sys_bool_t is_dir;
+  // The cached layout: the x coordinate of the name (the marker is at its left).
+  int32_t x;
+} row_t;
+
+typedef struct {
+  sys_dir_t* dir;
+  // The row of the directory, NO_ROW for the root.
+  uint32_t row;
+  // The next entry in the page, and the page byte size.
+  size_t offset;
+  size_t size;
+  uint64_t page[DIR_BUFFER_SIZE / sizeof(uint64_t)];
+} dir_level_t;
+
+static struct {
+  row_t* rows;
+  uint32_t row_count;
+  uint32_t row_capacity;
+
+  char* names;
+  size_t names_size;
+  size_t names_capacity;
+
+  dir_level_t levels[MAX_DEPTH];
+  uint32_t level_count;
+  sys_bool_t is_complete;
+} g_model;
+
+static const char* get_row_name(uint32_t row) {
+  return g_model.names + g_model.rows[row].name_offset;
+}
+
+/** Writes the path of @a row into @a path (with a trailing '/' for the directories). Returns sys_false if it does
+ * not fit. */
+static sys_bool_t get_row_path(uint32_t row, char path[MAX_PATH_LENGTH]) {
+  uint32_t chain[MAX_DEPTH + 1];
+  uint32_t chain_length = 0;
+  for (uint32_t it = row; it != NO_ROW && chain_length <= MAX_DEPTH; it = g_model.rows[it].parent)
+    chain[chain_length++] = it;
+
+  size_t length = 0;
+  path[length++] = '/';
+  while (chain_length > 0) {
+    const uint32_t it = chain[--chain_length];
+    const char* name = get_row_name(it);
+    const size_t name_length = strlen(name);
+    if (length + name_length + 2 > MAX_PATH_LENGTH)
+      return sys_false;
+
+    memcpy(path + length, name, name_length);
+    length += name_length;
+    if (g_model.rows[it].is_dir)
+      path[length++] = '/';
+  }
+
+  path[length] = '\0';
+  return sys_true;
+}
+
+static void open_dir_level(const char* path, uint32_t row) {
+  if (g_model.level_count == MAX_DEPTH)
+    return;  // the deeper directories are not shown
 
-static void draw_dir(sys_window_t* window, const char* path) {
   sys_dir_t* dir = sys_open_dir(path);
+  if (dir == NULL)
+    return;
 
-  sys_file_info_t file_info;
-  while (SYS_IS_OK(sys_read_dir(dir, &file_info))) {
-    if (current_selected == current_idx) {
-      sys_gfx_fill_rect(window, current_x - 10, current_y + 5, 5, 5, 0xff6BA4B8);
-      current_is_file = !file_info.is_dir;
-
-      static char file_path[256];
-      const size_t path_len = strlen(path);
-      memcpy(file_path, path, path_len);
-      const size_t name_len = strlen(file_info.name);
-      memcpy(file_path + path_len, file_info.name, name_len);
-      file_path[path_len + name_len] = '\0';
-
-      current_path = file_path;
-    } else {
-      sys_gfx_draw_rect(window, current_x - 10, current_y + 5, 5, 5, 0xffffffff);
-    }
+  dir_level_t* level = &g_model.levels[g_model.level_count++];
+  level->dir = dir;
+  level->row = row;
+  level->offset = 0;
+  level->size = 0;
+}
+
+static sys_bool_t append_row(const sys_dir_entry_t* entry, const dir_level_t* level) {
+  const size_t name_size = strlen(entry->name) + 1;
+  if (g_model.names_size + name_size > g_model.names_capacity) {
+    const size_t capacity = (g_model.names_capacity + name_size) * 2;
+    char* names = (char*)realloc(g_model.names, capacity);
+    if (names == NULL)
+      return sys_false;
+    g_model.names = names;
+    g_model.names_capacity = capacity;
+  }
+
+  if (g_model.row_count == g_model.row_capacity) {
+    const uint32_t capacity = g_model.row_capacity == 0 ? 64 : g_model.row_capacity * 2;
+    row_t* rows = (row_t*)realloc(g_model.rows, sizeof(row_t) * capacity);
+    if (rows == NULL)
+      return sys_false;
+    g_model.rows = rows;
+    g_model.row_capacity = capacity;
+  }
 
-    if (file_info.is_dir) {
-      sys_gfx_draw_text(window, current_x, current_y, file_info.name, 0xff0000);
-
-      char sub_path[256];
-      const size_t path_len = strlen(path);
-      memcpy(sub_path, path, path_len);
-      const size_t name_len = strlen(file_info.name);
-      memcpy(sub_path + path_len, file_info.name, name_len);
-      sub_path[path_len + name_len] = '/';
-      sub_path[path_len + name_len + 1] = '\0';
-
-      current_y += 20;
-      current_x += INDENT;
-      draw_dir(window, sub_path);
-      current_x -= INDENT;
-    } else {
-      sys_gfx_draw_text(window, current_x, current_y, file_info.name, 0xffff00);
-      current_y += 20;
+  row_t* row = &g_model.rows[g_model.row_count++];
+  row->parent = level->row;
+  row->name_offset = (uint32_t)g_model.names_size;
+  row->depth = (uint32_t)(level - g_model.levels);
+  row->is_dir = entry->is_dir;
+  row->x = PADDING + 10 + INDENT * (int32_t)row->depth;
+
+  memcpy(g_model.names + g_model.names_size, entry->name, name_size);
+  g_model.names_size += name_size;
+  return sys_true;
+}
+
+/** Reads the next entry of the tree into a new row. */
+static void read_next_row() {
+  dir_level_t* level = &g_model.levels[g_model.level_count - 1];
+  if (level->offset == level->size) {
+    level->offset = 0;
+    if (!SYS_IS_OK(sys_read_dir_many(level->dir, level->page, sizeof(level->page), 0, &level->size)))
+      level->size = 0;
+
+    if (level->size == 0) {
+      // Back to the parent directory, after the entry of this one.
+      sys_close_dir(level->dir);
+      g_model.is_complete = --g_model.level_count == 0;
+      return;
     }
+  }
+
+  const sys_dir_entry_t* entry = (const sys_dir_entry_t*)((const uint8_t*)level->page + level->offset);
+  level->offset += entry->size;
+  if (!append_row(entry, level)) {
+    sys_print("Failed to allocate the rows of the file explorer");
+    return;
+  }
+
+  char path[MAX_PATH_LENGTH];
+  if (entry->is_dir && get_row_path(g_model.row_count - 1, path))
+    open_dir_level(path, g_model.row_count - 1);
+}
+
+/** Reads the tree until it has @a row_count rows, or is completely read. */
+static void load_rows(uint32_t row_count) {
+  while (!g_model.is_complete && g_model.row_count < row_count)
+    read_next_row();
+}
+
+static void init_model() {
+  memset(&g_model, 0, sizeof(g_model));
+  open_dir_level("/", NO_ROW);
+  g_model.is_complete = g_model.level_count == 0;
+}
+
+/*
+ * The view: only the visible rows are drawn. The surface keeps what was drawn, so a move of the selection redraws
+ * two markers, and a scroll moves the rows still visible with gfx_copy_area() then draws the rows scrolled into
+ * view. Only the changed area is presented. The preview of the selected image is drawn over the rows, the thumbnail
+ * is shared with the other processes showing it (decoded once by the kernel).
+ */
+
+static struct {
+  gfx_font_t font;
+  gfx_painter_t painter;
+
+  uint32_t selected;
+  // The first visible row.
+  uint32_t scroll;
 
-    ++current_idx;
+  // What the surface shows, is_drawn is false if it must be drawn again from scratch.
+  sys_bool_t is_drawn;
+  uint32_t drawn_selected;
+  uint32_t drawn_scroll;
+
+  // The preview of the row preview_row, pixels is NULL if it is not an image.
+  sys_thumbnail_t preview;
+  uint32_t preview_row;
+  sys_bool_t is_preview_drawn;
+} g_view;
+
+static uint32_t get_rows_height() {
+  return g_view.painter.height > ROWS_TOP ? g_view.painter.height - ROWS_TOP : 0;
+}
+
+/** The count of rows visible, the last one may be partially visible. */
+static uint32_t get_visible_row_count() {
+  return (get_rows_height() + ROW_HEIGHT - 1) / ROW_HEIGHT;
+}
+
+static int32_t get_row_y(uint32_t row) {
+  return ROWS_TOP + ((int32_t)row - (int32_t)g_view.scroll) * ROW_HEIGHT;
+}
+
+static sys_bool_t is_row_visible(uint32_t row) {
+  return row >= g_view.scroll && row - g_view.scroll < get_visible_row_count();
+}
+
+static void draw_marker(uint32_t row) {
+  if (row >= g_model.row_count || !is_row_visible(row))
+    return;
+
+  const int32_t x = g_model.rows[row].x - 10;
+  const int32_t y = get_row_y(row) + 5;
+  if (row == g_view.selected) {
+    gfx_fill_rect(&g_view.painter, x, y, 5, 5, SELECTED_MARKER_COLOR);
+  } else {
+    gfx_fill_rect(&g_view.painter, x, y, 5, 5, BACKGROUND_COLOR);
+    gfx_draw_rect(&g_view.painter, x, y, 5, 5, MARKER_COLOR);
   }
+}
 
-  sys_close_dir(dir);
+/** Draws the rows visible at the indices [@a first, @a last) of the view (0 is the first visible row). */
+static void draw_rows(uint32_t first, uint32_t last) {
+  gfx_painter_t* painter = &g_view.painter;
+  load_rows(g_view.scroll + last);
+
+  for (uint32_t i = first; i < last; ++i) {
+    const uint32_t row = g_view.scroll + i;
+    const int32_t y = get_row_y(row);
+    gfx_fill_rect(painter, 0, y, painter->width, ROW_HEIGHT, BACKGROUND_COLOR);
+    if (row >= g_model.row_count)
+      continue;
+
+    const uint32_t color = g_model.rows[row].is_dir ? DIR_COLOR : FILE_COLOR;
+    draw_marker(row);
+    gfx_draw_text(painter, g_model.rows[row].x, y, get_row_name(row), color);
+  }
+}
+
+/** Moves the rows still visible after the scroll from drawn_scroll, and draws the other ones. */
+static void scroll_rows() {
+  const uint32_t visible_row_count = get_visible_row_count();
+  const uint32_t rows_height = get_rows_height();
+  const uint32_t delta = g_view.scroll > g_view.drawn_scroll ? g_view.scroll - g_view.drawn_scroll
+                                                             : g_view.drawn_scroll - g_view.scroll;
+  if (delta >= visible_row_count || delta * ROW_HEIGHT >= rows_height) {
+    draw_rows(0, visible_row_count);
+    return;
+  }
+
+  const uint32_t moved_height = rows_height - delta * ROW_HEIGHT;
+  if (g_view.scroll > g_view.drawn_scroll) {
+    gfx_copy_area(&g_view.painter, 0, ROWS_TOP + delta * ROW_HEIGHT, g_view.painter.width, moved_height, 0,
+                  ROWS_TOP);
+    // The rows from the last one fully moved, the one below may only be partially visible before.
+    draw_rows(moved_height / ROW_HEIGHT, visible_row_count);
+  } else {
+    gfx_copy_area(&g_view.painter, 0, ROWS_TOP, g_view.painter.width, moved_height, 0,
+                  ROWS_TOP + delta * ROW_HEIGHT);
+    draw_rows(0, delta);
+  }
+}
+
+static sys_bool_t is_image_name(const char* name) {
+  static const char* const extensions[] = {".jpg", ".jpeg", ".qoi"};
+  const size_t length = strlen(name);
+  for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i) {
+    const size_t extension_length = strlen(extensions[i]);
+    if (length <= extension_length)
+      continue;
+
+    // The FAT short names are upper case.
+    size_t j = 0;
+    while (j < extension_length && (name[length - extension_length + j] | 0x20) == extensions[i][j])
+      ++j;
+    if (j == extension_length)
+      return sys_true;
+  }
+
+  return sys_false;
+}
+
+/** Gets the preview of the selected row if it changed, the previous one is released. */
+static void update_preview() {
+  if (g_view.preview_row == g_view.selected)
+    return;
+
+  if (g_view.preview.pixels != NULL)
+    sys_munmap((void*)g_view.preview.pixels, 0);
+  g_view.preview.pixels = NULL;
+  g_view.preview_row = g_view.selected;
+
+  char path[MAX_PATH_LENGTH];
+  if (g_view.selected >= g_model.row_count || g_model.rows[g_view.selected].is_dir ||
+      !is_image_name(get_row_name(g_view.selected)) || !get_row_path(g_view.selected, path))
+    return;
+
+  if (!SYS_IS_OK(sys_get_thumbnail(path, PREVIEW_SIZE, PREVIEW_SIZE, &g_view.preview)))
+    g_view.preview.pixels = NULL;
+}
+
+static void draw_preview() {
+  const int32_t x = (int32_t)g_view.painter.width - PADDING - PREVIEW_SIZE;
+  if (g_view.preview.pixels == NULL || x < 0)
+    return;
+
+  gfx_fill_rect(&g_view.painter, x, ROWS_TOP, PREVIEW_SIZE, PREVIEW_SIZE, BACKGROUND_COLOR);
+  gfx_blit(&g_view.painter, x + (PREVIEW_SIZE - g_view.preview.width) / 2,
+           ROWS_TOP + (PREVIEW_SIZE - g_view.preview.height) / 2, g_view.preview.width, g_view.preview.height,
+           g_view.preview.pixels);
 }
 
 static void draw(sys_window_t* window) {
-  current_idx = 0;
-  current_x = PADDING + 10;
-  current_y = TITLE_BAR_HEIGHT + PADDING;
-  draw_dir(window, "/");
-  sys_window_present(window);
+  update_preview();
+
+  if (!g_view.is_drawn) {
+    if (!SYS_IS_OK(gfx_painter_init_window(&g_view.painter, window)))
+      return;
+
+    gfx_set_font(&g_view.painter, &g_view.font);
+    gfx_clear(&g_view.painter, BACKGROUND_COLOR);
+    draw_rows(0, get_visible_row_count());
+  } else {
+    // The preview would be moved with the rows, they are all drawn again under it.
+    if (g_view.scroll != g_view.drawn_scroll && g_view.is_preview_drawn)
+      draw_rows(0, get_visible_row_count());
+    else if (g_view.scroll != g_view.drawn_scroll)
+      scroll_rows();
+    else if (g_view.is_preview_drawn && g_view.preview.pixels == NULL)
+      draw_rows(0, PREVIEW_ROW_COUNT < get_visible_row_count() ? PREVIEW_ROW_COUNT : get_visible_row_count());
+
+    // The previous marker may have been moved by the scroll, it is then drawn where it is now.
+    draw_marker(g_view.drawn_selected);
+    draw_marker(g_view.selected);
+  }
+
+  draw_preview();
+  g_view.is_preview_drawn = g_view.preview.pixels != NULL;
+  g_view.is_drawn = sys_true;
+  g_view.drawn_selected = g_view.selected;
+  g_view.drawn_scroll = g_view.scroll;
+  gfx_present(&g_view.painter, window);
 }
 
-static void handle_key_event(sys_key_event_t event) {
+static void select_row(uint32_t row) {
+  g_view.selected = row;
+
+  // Scroll the selected row into view, entirely.
+  const uint32_t full_row_count = get_rows_height() / ROW_HEIGHT > 0 ? get_rows_height() / ROW_HEIGHT : 1;
+  if (row < g_view.scroll)
+    g_view.scroll = row;
+  else if (row - g_view.scroll >= full_row_count)
+    g_view.scroll = row - full_row_count + 1;
+}
+
+static void open_selected_row() {
+  char path[MAX_PATH_LENGTH];
+  if (g_view.selected >= g_model.row_count || !get_row_path(g_view.selected, path))
+    return;
+
+  if (g_model.rows[g_view.selected].is_dir) {
+    sys_print("The current selected item is not a file");
+  } else if (!SYS_IS_OK(sys_spawn_from_zygote(path))) {
+    sys_print("Failed to spawn the selected item (probably not an ELF program)");
+  }
+}
+
+static void handle_key_event(sys_event_loop_t* loop, sys_key_event_t event) {
   if (!sys_is_press_event(event))
     return;
 
   switch (sys_get_key_code(event)) {
     case SYS_KEY_UP_ARROW:
-      if (current_selected == 0)
+      if (g_view.selected == 0)
         return;
-      current_selected--;
-      draw(window);
+      select_row(g_view.selected - 1);
+      sys_event_loop_invalidate(loop);
       break;
     case SYS_KEY_DOWN_ARROW:
-      current_selected++;
-      draw(window);
+      load_rows(g_view.selected + 2);
+      if (g_view.selected + 1 >= g_model.row_count)
+        return;
+      select_row(g_view.selected + 1);
+      sys_event_loop_invalidate(loop);
       break;
     case SYS_KEY_ENTER:
-      if (current_is_file) {
-        if (!SYS_IS_OK(sys_spawn(current_path)))
-          sys_print("Failed to spawn the selected item (probably not an ELF program)");
-      } else {
-        sys_print("The current selected item is not a file");
-      }
+      open_selected_row();
+      break;
+    default:
+      break;
+  }
+}
+
+static void on_frame(sys_event_loop_t* loop, uint64_t frame_time_us) {
+  (void)frame_time_us;
+  draw(loop->window);
+}
+
+static void on_message(sys_event_loop_t* loop, const sys_message_t* message) {
+  switch (message->id) {
+    case SYS_MSG_CLOSE:
+      sys_event_loop_quit(loop);
+      break;
+    case SYS_MSG_SHOW:
+    case SYS_MSG_RESIZE:
+      // The surface changed, it is drawn again at the next frame (the loop invalidates it).
+      g_view.is_drawn = sys_false;
+      break;
+    case SYS_MSG_KEYDOWN:
+      handle_key_event(loop, message->param1);
       break;
     default:
       break;
@@ -102,33 +443,31 @@ static void handle_key_event(sys_key_event_t event) {
 int main() {
   sys_print("FILE EXPLORER");
 
-  window = sys_window_create("File Explorer", SYS_POS_DEFAULT, SYS_POS_DEFAULT, 500, 400, SYS_WF_DEFAULT);
+  // The font is mapped before the zygote is ready, so that its copies share it.
+  if (!SYS_IS_OK(gfx_font_load(&g_view.font, "/fonts/firacode_16.pkf"))) {
+    sys_print("Failed to load the font for file explorer");
+    return 1;
+  }
+
+  // Started as a zygote (see init.c), the copies resume here.
+  sys_zygote_ready();
+
+  sys_window_t* window =
+      sys_window_create("File Explorer", SYS_POS_DEFAULT, SYS_POS_DEFAULT, 500, 400, SYS_WF_DEFAULT);
   if (window == NULL) {
     sys_print("Failed to create window for file explorer");
     return 1;
   }
 
-  draw(window);
-
-  bool should_close = false;
-  while (!should_close) {
-    sys_message_t message;
-    sys_wait_message(window, &message);
-    switch (message.id) {
-      case SYS_MSG_CLOSE:
-        should_close = true;
-        break;
-      case SYS_MSG_RESIZE:
-        draw(window);
-        break;
-      case SYS_MSG_KEYDOWN:
-        handle_key_event(message.param1);
-        break;
-      default:
-        break;
-    }
-  }
+  // The directories are read when shown, and again by each copy of the zygote.
+  init_model();
+  g_view.preview_row = NO_ROW;
+
+  sys_event_loop_t loop;
+  sys_event_loop_init(&loop, window, on_message, on_frame, NULL);
+  sys_event_loop_run(&loop);
 
   sys_window_destroy(window);
+  gfx_font_destroy(&g_view.font);
   return 0;
 }
@@ -9,6 +9,16 @@ int main() {
       sys_print("Failed to spawn " program); \
   } while (0)
 
+// The programs launched from the menu start from a pre-initialized zygote, see sys_zygote_start().
+#define START_ZYGOTE(program)                              \
+  do {                                                     \
+    if (!SYS_IS_OK(sys_zygote_start(program)))             \
+      sys_print("Failed to start the zygote of " program); \
+  } while (0)
+
+//  START_ZYGOTE("/bin/explorer");
+//  START_ZYGOTE("/bin/slides");
+
 //  LAUNCH("/bin/explorer");
 //  LAUNCH("/bin/credits");
 //  LAUNCH("/bin/slides");
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/* A decoder of the QOI images (https://qoiformat.org), the same as the kernel one (kernel/graphics/qoi.hpp).
+ *
+ * The images are converted at build time (see tools/img2qoi.py), and decoded at about the speed of a memory copy
+ * directly into 0x00RRGGBB pixels, the format of the window surfaces (the alpha channel is dropped). */
+
+#define QOI_HEADER_SIZE 14
+#define QOI_END_MARKER_SIZE 8
+
+#define QOI_OP_INDEX 0x00 /* 00xxxxxx */
+#define QOI_OP_DIFF 0x40  /* 01xxxxxx */
+#define QOI_OP_LUMA 0x80  /* 10xxxxxx */
+#define QOI_OP_RUN 0xc0   /* 11xxxxxx */
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_OP_MASK 0xc0
+
+/* The limit of the specification, so that the decoded size fits in 32-bits with 4 channels. */
+#define QOI_MAX_PIXEL_COUNT 400000000ull
+
+static uint32_t qoi_read_be32(const uint8_t* data) {
+  return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+/* Reads the size of the QOI image of `size` bytes at `data`. Returns false if it is not a QOI image. */
+static bool qoi_read_header(const uint8_t* data, size_t size, uint32_t* width, uint32_t* height) {
+  if (size < QOI_HEADER_SIZE + QOI_END_MARKER_SIZE || memcmp(data, "qoif", 4) != 0)
+    return false;
+
+  *width = qoi_read_be32(data + 4);
+  *height = qoi_read_be32(data + 8);
+  const uint8_t channels = data[12];
+  return *width != 0 && *height != 0 && (uint64_t)*width * *height <= QOI_MAX_PIXEL_COUNT &&
+         (channels == 3 || channels == 4);
+}
+
+/* Decodes the QOI image of `size` bytes at `data` into `pixels` (rows of `pitch` pixels), which must hold the
+ * whole image. Returns false if the image is invalid or truncated. */
+static bool qoi_decode(const uint8_t* data, size_t size, uint32_t* pixels, size_t pitch) {
+  uint32_t width, height;
+  if (!qoi_read_header(data, size, &width, &height))
+    return false;
+
+  // The previous pixel and the 64 recently seen ones, as 0xAARRGGBB words.
+  uint32_t index[64] = {0};
+  uint32_t r = 0, g = 0, b = 0, a = 0xff;
+  uint32_t run = 0;
+
+  const uint8_t* it = data + QOI_HEADER_SIZE;
+  // The ops are at most 5 bytes long, the end marker is never part of them.
+  const uint8_t* const end = data + size - QOI_END_MARKER_SIZE;
+  for (uint32_t y = 0; y < height; ++y) {
+    uint32_t* row = pixels + pitch * y;
+    for (uint32_t x = 0; x < width; ++x) {
+      if (run > 0) {
+        --run;
+      } else {
+        if (it >= end)
+          return false;
+
+        const uint8_t op = *it++;
+        if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+          if (end - it < (op == QOI_OP_RGB ? 3 : 4))
+            return false;
+
+          r = it[0];
+          g = it[1];
+          b = it[2];
+          if (op == QOI_OP_RGBA)
+            a = it[3];
+          it += op == QOI_OP_RGB ? 3 : 4;
+        } else if ((op & QOI_OP_MASK) == QOI_OP_INDEX) {
+          const uint32_t argb = index[op];
+          a = argb >> 24;
+          r = (argb >> 16) & 0xff;
+          g = (argb >> 8) & 0xff;
+          b = argb & 0xff;
+        } else if ((op & QOI_OP_MASK) == QOI_OP_DIFF) {
+          r = (r + ((op >> 4) & 0x3) - 2) & 0xff;
+          g = (g + ((op >> 2) & 0x3) - 2) & 0xff;
+          b = (b + (op & 0x3) - 2) & 0xff;
+        } else if ((op & QOI_OP_MASK) == QOI_OP_LUMA) {
+          if (it == end)
+            return false;
+
+          const uint8_t next = *it++;
+          const uint32_t dg = (op & 0x3f) - 32;
+          r = (r + dg + (next >> 4) - 8) & 0xff;
+          g = (g + dg) & 0xff;
+          b = (b + dg + (next & 0x0f) - 8) & 0xff;
+        } else {  // QOI_OP_RUN, the current pixel is repeated
+          run = op & 0x3f;
+        }
+
+        index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = (a << 24) | (r << 16) | (g << 8) | b;
+      }
+
+      row[x] = (r << 16) | (g << 8) | b;
+    }
+  }
+
+  return true;
+}
@@ -6,6 +6,7 @@
 #include <sys/syscall.h>
 #include <sys/window.h>
 
+#include "qoi.h"
 #include "stb_image.h"
 
 static sys_window_t* window = NULL;
@@ -35,7 +36,23 @@ static void draw_slide() {
   if ((uint32_t)slide_height < win_height)
     y += win_height / 2 - slide_height / 2;
 
-  sys_gfx_blit(window, x, y, slide_width, slide_height, slide_pixels);
+  uint32_t* surface;
+  uint32_t pitch;
+  if (!SYS_IS_OK(sys_window_get_surface(window, &surface, &pitch))) {
+    sys_print("Failed to get the slides window surface");
+    return;
+  }
+
+  // Copy the slide into the window surface (it is already in its format), clipped to the window.
+  win_height += TITLE_BAR_HEIGHT;
+  if (x >= win_width || y >= win_height)
+    return;
+
+  const uint32_t width = (x + slide_width > win_width) ? win_width - x : (uint32_t)slide_width;
+  const uint32_t height = (y + slide_height > win_height) ? win_height - y : (uint32_t)slide_height;
+  for (uint32_t j = 0; j < height; ++j)
+    memcpy(surface + x + pitch * (y + j), slide_pixels + slide_width * j, sizeof(uint32_t) * width);
+
   sys_window_present(window);
 }
 
@@ -63,84 +80,263 @@ char* itoa(char* buffer, int res) {
   return buffer + size;
 }
 
-static const char* get_slide_path(int idx) {
-  static char buffer[512];
+/* The path is written into @buffer (SLIDE_PATH_MAX bytes), the prefetch thread also loads slides. */
+#define SLIDE_PATH_MAX 64
 
+/* The @extension is ".qoi" or ".jpg" (4 characters). */
+static const char* get_slide_path(int idx, const char* extension, char* buffer) {
   char* it = buffer;
   memcpy(it, SLIDE_PATH_PREFIX, SLIDE_PATH_PREFIX_LEN);
   it = itoa(it + SLIDE_PATH_PREFIX_LEN, idx);
-  memcpy(it, ".jpg\0", 5);
+  memcpy(it, extension, 5);
 
   return buffer;
 }
 
-static uint8_t* load_slide_image(int idx, int* buffer_length) {
-  const char* path = get_slide_path(idx);
+/* Maps the image file of the slide @idx with the given @extension, to be unmapped with sys_munmap(). */
+static const uint8_t* load_slide_image(int idx, const char* extension, int* buffer_length) {
+  char path_buffer[SLIDE_PATH_MAX];
+  const char* path = get_slide_path(idx, extension, path_buffer);
   sys_print("Loading...");
   sys_print(path);
   sys_file_t* file = sys_open_file(path, SYS_FM_READ);
   if (file == NULL)
     return NULL;
 
-  const size_t file_size = sys_get_file_size(file);
-  uint8_t* buffer = malloc(sizeof(uint8_t) * file_size);
-  assert(buffer != NULL);
-
-  size_t read_bytes;
-  sys_file_read(file, buffer, file_size, &read_bytes);
-  assert(read_bytes == file_size);
-
-  *buffer_length = file_size;
+  // The file pages are mapped as is, there is no copy to do.
+  const uint8_t* buffer;
+  const sys_error_t error = sys_mmap_file(file, (const void**)&buffer);
+  *buffer_length = sys_get_file_size(file);
 
   sys_close_file(file);
+  if (!SYS_IS_OK(error))
+    return NULL;
+
   sys_print("Done.");
 
   return buffer;
 }
 
-static void convert_to_argb(uint32_t* pixels, int width, int height) {
-  for (int x = 0; x < width; ++x) {
-    for (int y = 0; y < height; ++y) {
-      // The image is in RGBA, we expect ABGR.
-      const uint32_t color = __builtin_bswap32(pixels[x + width * y]);
-      pixels[x + width * y] = color >> 8;
-    }
+/* The decoded slides. After a slide is shown, its neighbors are decoded by the prefetch thread (on another
+ * core, if any) so moving to them does not stall on the JPEG decoder. A slide that failed to load is also
+ * kept (pixels is NULL), so it is not retried after each transition. */
+#define SLIDE_CACHE_SIZE 4
+
+typedef struct {
+  int index;
+  int width, height;
+  uint32_t* pixels;
+  uint32_t last_use; /* 0 if the entry is unused */
+} cached_slide_t;
+
+/* Everything below is shared with the prefetch thread and protected by slide_cache_lock. */
+static sys_mutex_t slide_cache_lock;
+static cached_slide_t slide_cache[SLIDE_CACHE_SIZE];
+static uint32_t slide_cache_clock = 0;
+/* The shown slide, never evicted as its pixels are drawn on resize. */
+static int shown_slide = -1;
+/* The slides decoded right now by each thread (-1 if none). */
+static int prefetched_slide = -1;
+static int loaded_slide = -1;
+/* The slides to prefetch (-1 if none), the sequence is incremented (and woken) at each new request. */
+static int prefetch_requests[2] = {-1, -1};
+static uint32_t prefetch_sequence = 0;
+/* Incremented (and woken) each time the prefetch thread has decoded a slide. */
+static uint32_t prefetch_done_sequence = 0;
+
+/* Decodes the QOI slide at @buffer, returns false if it is invalid. */
+static bool decode_qoi_slide(cached_slide_t* slide, const uint8_t* buffer, int buffer_length) {
+  uint32_t width, height;
+  if (!qoi_read_header(buffer, buffer_length, &width, &height))
+    return false;
+
+  slide->pixels = malloc(sizeof(uint32_t) * width * height);
+  if (slide->pixels == NULL)
+    return false;
+
+  if (!qoi_decode(buffer, buffer_length, slide->pixels, width)) {
+    free(slide->pixels);
+    slide->pixels = NULL;
+    return false;
   }
+
+  slide->width = (int)width;
+  slide->height = (int)height;
+  return true;
 }
 
-static void update_current_slide() {
+/* Decodes the JPEG slide at @buffer and converts it to the window surface format, returns false if it is
+ * invalid. */
+static bool decode_jpeg_slide(cached_slide_t* slide, const uint8_t* buffer, int buffer_length) {
+  slide->pixels = (uint32_t*)stbi_load_from_memory(buffer, buffer_length, &slide->width, &slide->height, NULL, 4);
+  if (slide->pixels == NULL)
+    return false;
+
+  // The image is in RGBA, we expect ABGR (converted once, not at each draw).
+  const size_t count = (size_t)slide->width * slide->height;
+  for (size_t i = 0; i < count; ++i)
+    slide->pixels[i] = __builtin_bswap32(slide->pixels[i]) >> 8;
+  return true;
+}
+
+/* Decodes the slide @idx, without the lock held. The QOI image (converted at build time, see tools/img2qoi.py) is
+ * preferred, it is decoded many times faster than the JPEG. */
+static void decode_slide(cached_slide_t* slide, int idx) {
+  slide->index = idx;
+  slide->pixels = NULL;
+
   int slide_buffer_len = 0;
-  uint8_t* slide_buffer = load_slide_image(current_slide, &slide_buffer_len);
+  bool is_qoi = true;
+  const uint8_t* slide_buffer = load_slide_image(idx, ".qoi", &slide_buffer_len);
   if (slide_buffer == NULL) {
-    if (current_slide > 0)
-      current_slide--;
+    is_qoi = false;
+    slide_buffer = load_slide_image(idx, ".jpg", &slide_buffer_len);
+  }
 
-    sys_print("Failed to open next slide (invalid file)");
+  if (slide_buffer == NULL) {
+    sys_print("Failed to open slide (invalid file)");
     return;
   }
 
-  int width, height;
-  uint32_t* new_slide_pixels =
-      (uint32_t*)stbi_load_from_memory(slide_buffer, slide_buffer_len, &width, &height, NULL, 4);
-  free(slide_buffer);
+  const bool is_ok = is_qoi ? decode_qoi_slide(slide, slide_buffer, slide_buffer_len)
+                            : decode_jpeg_slide(slide, slide_buffer, slide_buffer_len);
+  sys_munmap((void*)slide_buffer, slide_buffer_len);
+
+  if (!is_ok)
+    sys_print("Failed to open slide (invalid image)");
+}
+
+/* Returns the cached slide @idx or NULL, the lock must be held. */
+static cached_slide_t* find_slide(int idx) {
+  for (int i = 0; i < SLIDE_CACHE_SIZE; ++i) {
+    if (slide_cache[i].last_use != 0 && slide_cache[i].index == idx)
+      return &slide_cache[i];
+  }
+
+  return NULL;
+}
+
+/* Stores the decoded @slide in place of the least recently used one (but the shown slide), the lock must
+ * be held. If it was decoded twice, the new copy is dropped. */
+static cached_slide_t* insert_slide(const cached_slide_t* slide) {
+  cached_slide_t* entry = find_slide(slide->index);
+  if (entry != NULL) {
+    free(slide->pixels);
+    return entry;
+  }
 
-  if (new_slide_pixels == NULL) {
+  for (int i = 0; i < SLIDE_CACHE_SIZE; ++i) {
+    cached_slide_t* it = &slide_cache[i];
+    if (it->last_use != 0 && it->index == shown_slide)
+      continue;
+
+    if (entry == NULL || it->last_use < entry->last_use)
+      entry = it;
+  }
+
+  free(entry->pixels);
+  *entry = *slide;
+  entry->last_use = ++slide_cache_clock;
+  return entry;
+}
+
+static void prefetch_thread(void* arg) {
+  (void)arg;
+
+  sys_mutex_lock(&slide_cache_lock);
+  while (true) {
+    // Take the next requested slide that is not already decoded or being decoded.
+    int idx = -1;
+    for (int i = 0; i < 2 && idx < 0; ++i) {
+      if (prefetch_requests[i] >= 0 && prefetch_requests[i] != loaded_slide && find_slide(prefetch_requests[i]) == NULL)
+        idx = prefetch_requests[i];
+      prefetch_requests[i] = -1;
+    }
+
+    if (idx < 0) {
+      const uint32_t sequence = prefetch_sequence;
+      sys_mutex_unlock(&slide_cache_lock);
+      sys_futex_wait(&prefetch_sequence, sequence);
+      sys_mutex_lock(&slide_cache_lock);
+      continue;
+    }
+
+    prefetched_slide = idx;
+    sys_mutex_unlock(&slide_cache_lock);
+
+    cached_slide_t slide;
+    decode_slide(&slide, idx);
+
+    sys_mutex_lock(&slide_cache_lock);
+    insert_slide(&slide);
+    prefetched_slide = -1;
+    ++prefetch_done_sequence;
+    sys_futex_wake(&prefetch_done_sequence, UINT32_MAX);
+  }
+}
+
+/* Returns the slide @idx and makes it the shown one if it loaded, decoding it if not prefetched. */
+static cached_slide_t get_slide(int idx) {
+  sys_mutex_lock(&slide_cache_lock);
+
+  // If being prefetched, wait for it rather than decoding it twice.
+  cached_slide_t* entry = find_slide(idx);
+  while (entry == NULL && prefetched_slide == idx) {
+    const uint32_t sequence = prefetch_done_sequence;
+    sys_mutex_unlock(&slide_cache_lock);
+    sys_futex_wait(&prefetch_done_sequence, sequence);
+    sys_mutex_lock(&slide_cache_lock);
+    entry = find_slide(idx);
+  }
+
+  if (entry == NULL) {
+    loaded_slide = idx;
+    sys_mutex_unlock(&slide_cache_lock);
+
+    cached_slide_t slide;
+    decode_slide(&slide, idx);
+
+    sys_mutex_lock(&slide_cache_lock);
+    loaded_slide = -1;
+    entry = insert_slide(&slide);
+  }
+
+  entry->last_use = ++slide_cache_clock;
+  if (entry->pixels != NULL)
+    shown_slide = idx;
+
+  const cached_slide_t slide = *entry;
+  sys_mutex_unlock(&slide_cache_lock);
+  return slide;
+}
+
+static void prefetch_slides(int next_idx, int previous_idx) {
+  sys_mutex_lock(&slide_cache_lock);
+  prefetch_requests[0] = next_idx;
+  prefetch_requests[1] = previous_idx;
+  ++prefetch_sequence;
+  sys_mutex_unlock(&slide_cache_lock);
+  sys_futex_wake(&prefetch_sequence, 1);
+}
+
+static void update_current_slide() {
+  const cached_slide_t slide = get_slide(current_slide);
+  if (slide.pixels == NULL) {
     if (current_slide > 0)
       current_slide--;
 
-    sys_print("Failed to open next slide (invalid image)");
+    sys_print("Failed to open next slide");
     return;
   }
 
-  free((void*)slide_pixels);
-
-  convert_to_argb(new_slide_pixels, width, height);
-
-  slide_pixels = new_slide_pixels;
-  slide_width = width;
-  slide_height = height;
+  slide_pixels = slide.pixels;
+  slide_width = slide.width;
+  slide_height = slide.height;
 
   draw_slide();
+
+  if (begin_show)
+    prefetch_slides(current_slide + 1, current_slide - 1);
 }
 
 static void handle_key_event(sys_key_event_t event) {
@@ -170,7 +366,7 @@ static void handle_key_event(sys_key_event_t event) {
       if (!sys_is_alt_pressed(event))
         break;
 
-      if (!SYS_IS_OK(sys_spawn("/bin/credits")))
+      if (!SYS_IS_OK(sys_spawn_from_zygote("/bin/credits")))
         sys_print("Failed to spawn credits :/");
 
       break;
@@ -184,12 +380,20 @@ static void handle_key_event(sys_key_event_t event) {
 int main() {
   sys_print("SLIDES");
 
+  // Started as a zygote (see init.c), the first slide is decoded once for all the copies, which resume here.
+  (void)get_slide(current_slide);
+  sys_zygote_ready();
+
   window = sys_window_create("Slides", SYS_POS_CENTERED, SYS_POS_CENTERED, 800, 600, SYS_WF_DEFAULT);
   if (window == NULL) {
     sys_print("Failed to create window for slides");
     return 1;
   }
 
+  sys_pid_t prefetch_tid;
+  if (!SYS_IS_OK(sys_thread_create(prefetch_thread, NULL, &prefetch_tid)))
+    sys_print("Failed to create the slides prefetch thread");
+
   update_current_slide();
 
   bool should_close = false;
@@ -211,8 +415,10 @@ int main() {
     }
   }
 
-  if (slide_pixels != NULL)
-    free((void*)slide_pixels);
+  // Keep the lock, the prefetch thread must not touch the cache anymore (it is killed when main() returns).
+  sys_mutex_lock(&slide_cache_lock);
+  for (int i = 0; i < SLIDE_CACHE_SIZE; ++i)
+    free(slide_cache[i].pixels);
 
   sys_window_destroy(window);
   return 0;
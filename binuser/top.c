@@ -0,0 +1,150 @@
+#include <sys/syscall.h>
+#include <sys/window.h>
+
+#define MAX_TASKS 64
+#define REFRESH_INTERVAL_US 1000000
+#define LINE_HEIGHT 16
+
+static sys_task_stats_t g_stats[MAX_TASKS];
+static size_t g_count = 0;
+
+// The stats of the previous refresh, to compute the CPU usage over the last interval.
+static sys_task_stats_t g_previous_stats[MAX_TASKS];
+static size_t g_previous_count = 0;
+
+/* Writes the decimal representation of `value` right-aligned in `width` characters at `buffer`, and returns the
+ * position after it. */
+static char* format_number(char* buffer, uint64_t value, int width) {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  for (int i = count; i < width; ++i)
+    *buffer++ = ' ';
+  while (count > 0)
+    *buffer++ = digits[--count];
+  return buffer;
+}
+
+/* Writes `text` after `padding` spaces at `buffer`, and returns the position after it. */
+static char* format_text(char* buffer, const char* text, int padding) {
+  for (int i = 0; i < padding; ++i)
+    *buffer++ = ' ';
+
+  char* end = buffer;
+  while (*text != '\0')
+    *end++ = *text++;
+  return end;
+}
+
+static const sys_task_stats_t* find_previous_stats(sys_pid_t pid) {
+  for (size_t i = 0; i < g_previous_count; ++i) {
+    if (g_previous_stats[i].pid == pid)
+      return &g_previous_stats[i];
+  }
+
+  return NULL;
+}
+
+/* Returns the CPU usage of `stats` since the previous refresh, in tenths of percent of a core. */
+static uint64_t get_cpu_usage(const sys_task_stats_t* stats) {
+  const sys_task_stats_t* previous = find_previous_stats(stats->pid);
+  const uint64_t interval_ticks = stats->tick_frequency * (REFRESH_INTERVAL_US / 1000) / 1000;
+  if (previous == NULL || interval_ticks == 0)
+    return 0;
+
+  const uint64_t ticks =
+      (stats->user_ticks + stats->system_ticks) - (previous->user_ticks + previous->system_ticks);
+  return ticks * 1000 / interval_ticks;
+}
+
+static void draw_top(sys_window_t* window) {
+  sys_gfx_clear(window, 0xffffff);
+  sys_gfx_draw_text(window, 10, 10, "  PID  PPID PRIO S  CPU%  USER(ms)   SYS(ms)   VCSW  IVCSW  FAULTS  RSS(KiB)",
+                    0x000000);
+
+  const char* state_names[] = {"R", "S", "D"};
+  const size_t count = g_count < MAX_TASKS ? g_count : MAX_TASKS;
+  for (size_t i = 0; i < count; ++i) {
+    const sys_task_stats_t* stats = &g_stats[i];
+    const uint64_t cpu_usage = get_cpu_usage(stats);
+    const uint64_t ticks_per_ms = stats->tick_frequency / 1000 != 0 ? stats->tick_frequency / 1000 : 1;
+
+    char line[128];
+    char* end = line;
+    end = format_number(end, stats->pid, 5);
+    end = format_number(end, stats->parent_pid, 6);
+    end = format_number(end, stats->priority, 5);
+    end = format_text(end, stats->state < 3 ? state_names[stats->state] : "?", 1);
+    end = format_number(end, cpu_usage / 10, 5);
+    *end++ = '.';
+    end = format_number(end, cpu_usage % 10, 1);
+    end = format_number(end, stats->user_ticks / ticks_per_ms, 10);
+    end = format_number(end, stats->system_ticks / ticks_per_ms, 10);
+    end = format_number(end, stats->voluntary_switches, 7);
+    end = format_number(end, stats->involuntary_switches, 7);
+    end = format_number(end, stats->page_faults, 8);
+    end = format_number(end, stats->resident_byte_size / 1024, 10);
+    end = format_text(end, stats->is_kernel ? " [kernel]" : (stats->is_thread ? " [thread]" : ""), 0);
+    *end = '\0';
+
+    sys_gfx_draw_text(window, 10, 10 + LINE_HEIGHT * (i + 1), line, 0x000000);
+  }
+}
+
+static void refresh_stats() {
+  for (size_t i = 0; i < g_count && i < MAX_TASKS; ++i)
+    g_previous_stats[i] = g_stats[i];
+  g_previous_count = g_count < MAX_TASKS ? g_count : MAX_TASKS;
+
+  if (!SYS_IS_OK(sys_get_task_stats(g_stats, MAX_TASKS, &g_count)))
+    g_count = 0;
+}
+
+int main() {
+  sys_print("TOP");
+
+  sys_window_t* window = sys_window_create("Top", SYS_POS_DEFAULT, SYS_POS_DEFAULT, 700, 500, SYS_WF_DEFAULT);
+  if (window == NULL) {
+    sys_print("Failed to create window for top");
+    return 1;
+  }
+
+  // The refreshes are paced by a timer, so the window still reacts to its messages between them.
+  sys_timer_t timer;
+  if (!SYS_IS_OK(sys_timer_create(window, &timer)) ||
+      !SYS_IS_OK(sys_timer_arm(timer, REFRESH_INTERVAL_US, REFRESH_INTERVAL_US))) {
+    sys_print("Failed to create the refresh timer of top");
+    sys_window_destroy(window);
+    return 1;
+  }
+
+  refresh_stats();
+  draw_top(window);
+
+  bool should_close = false;
+  while (!should_close) {
+    sys_message_t message;
+    sys_wait_message(window, &message);
+    switch (message.id) {
+      case SYS_MSG_CLOSE:
+        should_close = true;
+        break;
+      case SYS_MSG_TIMER:
+        refresh_stats();
+        draw_top(window);
+        break;
+      case SYS_MSG_RESIZE:
+        draw_top(window);
+        break;
+      default:
+        break;
+    }
+  }
+
+  sys_window_destroy(window);
+  return 0;
+}
@@ -5,6 +5,7 @@
 
 #include "boot/mmu_utils.hpp"
 #include "fs/fat/ramdisk.hpp"
+#include "hardware/timer.hpp"
 #include "memory/mmu_table.hpp"
 
 #define resolve_symbol_pa(symbol)                     \
@@ -51,11 +52,13 @@ static inline constexpr PagesAttributes device_memory = {.sh = Shareability::Out
                                                          .access = Accessibility::Privileged,
                                                          .type = MemoryType::Device_nGnRnE};
 
+// The screen framebuffer lives there: write-combining (normal non-cacheable) memory, so the CPU writes are
+// gathered into bursts and are never hidden from the VideoCore in a cache.
 static inline constexpr PagesAttributes vc_memory = {.sh = Shareability::OuterShareable,
                                                      .exec = ExecutionPermission::NeverExecute,
                                                      .rw = ReadWritePermission::ReadWrite,
                                                      .access = Accessibility::Privileged,
-                                                     .type = MemoryType::Device_nGnRnE};
+                                                     .type = MemoryType::Normal_NoCache};
 
 DeviceMemoryProperties inline get_memory_properties(const DeviceTree& dt) {
   Property tmp_prop;
@@ -179,8 +182,10 @@ void inline setup_device_mapping(MMUTable* tbl, const DeviceTree& dt, const Devi
 }
 
 void inline setup_stack_mapping(MMUTable* tbl) {
-  enforce(map_range(tbl, KERNEL_STACK_PAGE_TOP((uint64_t)DEFAULT_CORE),
-                    KERNEL_STACK_PAGE_BOTTOM((uint64_t)DEFAULT_CORE), PHYSICAL_STACK_TOP, rw_memory));
+  for (uint64_t core = 0; core < NB_CORES; ++core) {
+    enforce(map_range(tbl, KERNEL_STACK_PAGE_TOP(core), KERNEL_STACK_PAGE_BOTTOM(core), PHYSICAL_CORE_STACK_TOP(core),
+                      rw_memory));
+  }
 }
 
 void inline setup_fs_mapping(MMUTable* tbl) {
@@ -223,13 +228,13 @@ void inline setup_tcr() {
   asm volatile("isb");
 }
 
-void inline setup_ttbr0_ttbr1(MMUTable* tbl) {
+void inline setup_ttbr0_ttbr1(PhysicalPA pgd) {
   static constexpr uint64_t TTBR_CNP = 0x1;
 
   // lower half, user space
-  asm volatile("msr ttbr0_el1, %0" : : "r"(tbl->pgd + TTBR_CNP));
+  asm volatile("msr ttbr0_el1, %0" : : "r"(pgd + TTBR_CNP));
   // upper half, kernel space
-  asm volatile("msr ttbr1_el1, %0" : : "r"(tbl->pgd + TTBR_CNP));
+  asm volatile("msr ttbr1_el1, %0" : : "r"(pgd + TTBR_CNP));
 
   asm volatile("dsb ish; isb;");
 }
@@ -257,7 +262,9 @@ void inline setup_sctlr() {
          (1 << 1));  // clear A, no alignment check
 
   r |= (1 << 0) |  // set M, enable MMU
-                   //              (1 << 2) |  // set C, enable caching of normal memory // FIXME Later (Never)
+#ifdef CONFIG_USE_DATA_CACHE
+       (1 << 2) |  // set C, enable caching of normal memory
+#endif             // CONFIG_USE_DATA_CACHE
        (1 << 12);  // set I, enable instruction cache
 
   asm volatile("msr sctlr_el1, %0" : : "r"(r));
@@ -279,12 +286,14 @@ extern "C" VirtualPA mmu_alloc_page(void* handle_ptr) {
   return mmu_resolve_pa(nullptr, new_page);
 }
 
-extern "C" void mmu_init(uintptr_t dtb) {
+extern "C" void mmu_init(uintptr_t dtb, uint64_t start_ticks) {
   MMUInitData* init_data = (MMUInitData*)resolve_symbol_pa(_init_data);
+  init_data->start_ticks = start_ticks;
 
   init_data->kernel_start = resolve_symbol_pa(_stext);
   init_data->kernel_stop = resolve_symbol_pa(_kend);
 
+  init_data->dtb = dtb;
   init_data->dtb_page_start = libk::align_to_previous(dtb, PAGE_SIZE);
   const size_t dtb_size = libk::from_be(libk::read32(dtb + sizeof(uint32_t)));
   init_data->dtb_page_end = libk::align_to_next(dtb + dtb_size, PAGE_SIZE);
@@ -306,6 +315,8 @@ extern "C" void mmu_init(uintptr_t dtb) {
       .free = nullptr,  // We don't free anything here !
       .resolve_pa = (ResolvePA)resolve_symbol_pa(mmu_resolve_pa),
       .resolve_va = (ResolveVA)resolve_symbol_pa(mmu_resolve_va),
+      // The MMU is still off: the entries are synced all at once by setup_ttbr0_ttbr1().
+      .is_inactive = true,
   };
 
   DeviceTree dt(dtb);
@@ -319,9 +330,25 @@ extern "C" void mmu_init(uintptr_t dtb) {
 
   setup_mair();
   setup_tcr();
-  setup_ttbr0_ttbr1(&tbl);
+  setup_ttbr0_ttbr1(tbl.pgd);
   setup_sctlr();
 
   // Convert the PGD to a Virtual Address
   init_data->pgd += KERNEL_BASE;
+
+  init_data->mmu_init_ticks = GenericTimer::get_tick_count();
+}
+
+/** Called by secondary cores (with the MMU off) once the boot core has built the kernel page tables. */
+extern "C" void mmu_secondary_init() {
+  const MMUInitData* init_data = (const MMUInitData*)resolve_symbol_pa(_init_data);
+
+  // Nothing may remain from the firmware in the TLB of this core.
+  asm volatile("tlbi vmalle1; dsb ish; isb;");
+
+  setup_mair();
+  setup_tcr();
+  // The boot core has already converted the PGD to a virtual address.
+  setup_ttbr0_ttbr1(init_data->pgd - KERNEL_BASE);
+  setup_sctlr();
 }
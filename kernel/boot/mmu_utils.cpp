@@ -1,15 +1,63 @@
 #include "boot/mmu_utils.hpp"
 
 // Force init_data to be in the .data segment (and not .bss)
-MMUInitData _init_data = {0x1, {}, {}, 0x2, 0x3, 0x4, 0x5};
+MMUInitData _init_data = {.pgd = 0x1,
+                          .lin_alloc = {},
+                          .mem_prop = {},
+                          .dtb = 0x2,
+                          .dtb_page_start = 0x3,
+                          .dtb_page_end = 0x4,
+                          .kernel_start = 0x5,
+                          .kernel_stop = 0x6,
+                          .start_ticks = 0x7,
+                          .mmu_init_ticks = 0x8};
 
 void zero_pages(VirtualPA pages, size_t nb_pages) {
+  // DC ZVA zeroes a whole block (of 4 << DCZID_EL0.BS bytes, at most 2 KiB) per instruction, without reading
+  // the memory first. It is not allowed if DCZID_EL0.DZP is set, and faults on the Device memory, which is all
+  // the memory while the MMU is off (in mmu_init()).
+  uint64_t dczid;
+  uint64_t sctlr;
+  asm volatile("mrs %0, dczid_el0" : "=r"(dczid));
+  asm volatile("mrs %0, sctlr_el1" : "=r"(sctlr));
+
+  const VirtualPA end = pages + nb_pages * PAGE_SIZE;
+  if ((dczid & (1 << 4)) == 0 && (sctlr & (1 << 0)) != 0) {
+    const size_t block_size = 4ull << (dczid & 0b1111);
+    for (VirtualPA block = pages; block < end; block += block_size) {
+      asm volatile("dc zva, %0" : : "r"(block) : "memory");
+    }
+    return;
+  }
+
   auto* const page_ptr = (uint64_t*)pages;
   for (size_t i = 0; i < nb_pages * PAGE_SIZE / sizeof(uint64_t); ++i) {
     page_ptr[i] = 0;
   }
 }
 
+void zero_range(VirtualPA start, VirtualPA end) {
+  // The whole pages in the range are zeroed with zero_pages(), the bytes before and after them one by one.
+  const VirtualPA pages_start = (start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  const VirtualPA pages_end = end & ~(PAGE_SIZE - 1);
+  if (pages_start >= pages_end) {
+    for (auto* byte = (volatile uint8_t*)start; byte < (uint8_t*)end; ++byte) {
+      *byte = 0;
+    }
+    return;
+  }
+
+  for (auto* byte = (volatile uint8_t*)start; byte < (uint8_t*)pages_start; ++byte) {
+    *byte = 0;
+  }
+
+  zero_pages(pages_start, (pages_end - pages_start) / PAGE_SIZE);
+
+  for (auto* byte = (volatile uint8_t*)pages_end; byte < (uint8_t*)end; ++byte) {
+    *byte = 0;
+  }
+}
+
 bool allocate_pages(LinearPageAllocator* alloc, size_t nb_pages, PhysicalPA* page) {
   const uintptr_t cur_page = alloc->first_page + PAGE_SIZE * alloc->nb_allocated;
 
@@ -2,6 +2,7 @@
 
 #define PAGE_SIZE (4096)                   // 4096 bytes
 #define KERNEL_STACK_SIZE (2 * PAGE_SIZE)  // 2 * 4096 bytes
+#define CONTIGUOUS_MAPPING_SIZE (16 * PAGE_SIZE)  // 64 KiB, the pages sharing a TLB entry with the contiguous bit
 
 #define KERNEL_BASE (0xffff000000000000)
 #define PROCESS_BASE (0x0000000000000000)
@@ -22,10 +23,34 @@
 #define KERNEL_STACK_PAGE_TOP(core) ((STACK_MEMORY + PHYSICAL_STACK_TOP) | (core << 36))
 #define KERNEL_STACK_PAGE_BOTTOM(core) (KERNEL_STACK_PAGE_TOP(core) + KERNEL_STACK_SIZE - PAGE_SIZE)
 
+// Each core has its own kernel stack, placed right below the one of the previous core.
+#define PHYSICAL_CORE_STACK_TOP(core) (PHYSICAL_STACK_TOP - (core) * KERNEL_STACK_SIZE)
+
 #define DEFAULT_CORE 0
+#define NB_CORES 4
+
+// The page right below the core stacks, never allocated: the secondary cores are parked there with their MMU off
+// while the next kernel boots after a warm restart (see Kexec).
+#define PHYSICAL_KEXEC_PAGE (PHYSICAL_CORE_STACK_TOP(NB_CORES - 1) - PAGE_SIZE)
+
+// The read-only information page of each process (see ProcessMemory::map_info_page()).
+#define PROCESS_INFO_PAGE (PROCESS_BASE + 0x0000100000000000)
 
+// Shared libraries, each one at the same address in all processes (see DynamicLoader).
+#define PROCESS_LIBRARY_BASE (PROCESS_BASE + 0x0000200000000000)
+#define PROCESS_LIBRARY_END (PROCESS_BASE + 0x0000400000000000)
+
+// Anonymous mappings (see ProcessMemory::map_anonymous()), placed anywhere between these two addresses.
+#define PROCESS_ANONYMOUS_BASE (PROCESS_BASE + 0x0000400000000000)
+#define PROCESS_ANONYMOUS_END (PROCESS_BASE + 0x0000800000000000)
 #define PROCESS_HEAP_BASE (PROCESS_BASE + 0x0000800000000000)
 #define PROCESS_STACK_BASE (PROCESS_BASE + 0x0000f00000000000)
+// Thread stacks are mapped below the main stack, one per slot. The unmapped pages between them act as guards.
+#define PROCESS_THREAD_STACK_SLOT_SIZE (0x100000)  // 1 MiB
+// Window surfaces mapped into their owner process, one per slot (large enough for the biggest window).
+#define PROCESS_SURFACE_BASE (PROCESS_BASE + 0x0000c00000000000)
+#define PROCESS_SURFACE_SLOT_SIZE (0x1000000000)  // 64 GiB
+#define PROCESS_SURFACE_SLOT_COUNT (0x200)
 
 #ifndef __ASSEMBLER__
 #include <cstddef>
@@ -52,11 +77,16 @@ struct MMUInitData {
   LinearPageAllocator lin_alloc;
   DeviceMemoryProperties mem_prop;
 
+  PhysicalPA dtb;  // the device tree given to _start
   PhysicalPA dtb_page_start;
   PhysicalPA dtb_page_end;
 
   PhysicalPA kernel_start;
   PhysicalPA kernel_stop;
+
+  // The counter (CNTPCT_EL0) at _start and at the end of mmu_init(), see BootProfile.
+  uint64_t start_ticks;
+  uint64_t mmu_init_ticks;
 };
 
 extern MMUInitData _init_data asm("_init_data");
@@ -66,4 +96,6 @@ inline constexpr auto* _mem_prop = &_init_data.mem_prop;
 
 bool allocate_pages(LinearPageAllocator* alloc, size_t nb_pages, PhysicalPA* page);
 void zero_pages(VirtualPA pages, size_t nb_pages);
+/** Zeroes the bytes from @a start to @a end (excluded), the whole pages inside with zero_pages(). */
+void zero_range(VirtualPA start, VirtualPA end);
 #endif
@@ -4,25 +4,32 @@
  * the kernel entry point kmain().
  */
 
+#include <libk/cpu_features.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "boot_profile.hpp"
+#include "coverage.hpp"
 #include "hardware/device.hpp"
+#include "hardware/dma/copy_engine.hpp"
 #include "hardware/dma/dma_controller.hpp"
 #include "hardware/gpio.hpp"
 #include "hardware/irq/irq_manager.hpp"
+#include "hardware/interrupts.hpp"
 #include "hardware/kernel_dt.hpp"
 #include "hardware/mailbox.hpp"
+#include "hardware/smp.hpp"
 #include "hardware/system_timer.hpp"
 #include "hardware/uart.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
 
 // The linker provides the following pointers.
 extern uint64_t __bss_start;
 extern uint64_t __bss_end;
 
-/** Erases the BSS section. */
+/** Erases the BSS section, mostly with DC ZVA (see zero_pages()). */
 void zero_bss() {
-  uint64_t* dst = &__bss_start;
-  while (dst < &__bss_end) {
-    *dst++ = 0;
-  }
+  zero_range((VirtualPA)&__bss_start, (VirtualPA)&__bss_end);
 }
 
 using FunctionPointer = void (*)();
@@ -68,45 +75,87 @@ extern "C" void _startup(uintptr_t dtb) {
   zero_bss();
   call_init_array();
 
+  // The stamps taken before the BSS was cleared were kept by mmu_init().
+  BootProfile::mark(BootProfile::Stage::START, _init_data.start_ticks);
+  BootProfile::mark(BootProfile::Stage::MMU_INIT, _init_data.mmu_init_ticks);
+  BootProfile::mark(BootProfile::Stage::STARTUP);
+
   // Set up the Interrupt Vector Table
   init_interrupts_vector_table();
 
+  // Read the cache topology, to tune the copies and fills before the first big ones.
+  libk::probe_cpu_features();
+
   // Set up the DeviceTree
   if (!KernelDT::init(dtb)) {
     libk::halt();
   }
+  BootProfile::mark(BootProfile::Stage::KERNEL_DT);
 
   // Set up the Kernel memory management
   if (!KernelMemory::init()) {
     libk::halt();
   }
+  BootProfile::mark(BootProfile::Stage::KERNEL_MEMORY);
 
   // Set up the VC-ARM Mailbox
   MailBox::init();
+  BootProfile::mark(BootProfile::Stage::MAILBOX);
 
   // Set up general Device functions
   if (!Device::init()) {
     libk::halt();
   }
+  BootProfile::mark(BootProfile::Stage::DEVICE);
 
   // Set up the IRQ Manager
   IRQManager::init();
+  BootProfile::mark(BootProfile::Stage::IRQ_MANAGER);
 
   // Set up GPIO Function.
   GPIO::init();
+  BootProfile::mark(BootProfile::Stage::GPIO);
 
   // Try to initialize UART early as possible.
   UART log(1000000, "uart1", /* irqs= */false);  // Set to a High Baud-rate, otherwise UART is THE bottleneck :/
   libk::register_logger(log);
+#ifdef CONFIG_TRACE
+  Trace::set_output(log);
+#endif  // CONFIG_TRACE
+#ifdef CONFIG_PROFILER
+  Profiler::set_output(log);
+#endif  // CONFIG_PROFILER
+#ifdef CONFIG_COVERAGE
+  Coverage::set_output(log);
+#endif  // CONFIG_COVERAGE
+  BootProfile::mark(BootProfile::Stage::LOG_UART);
 
   // Set up the System Timer
   SystemTimer::init();
   libk::set_log_timer(&SystemTimer::get_elapsed_time_in_ms);
+  BootProfile::mark(BootProfile::Stage::SYSTEM_TIMER);
 
   if (!DMA::init()) {
     LOG_ERROR("Unable to initialise the DMA Controller.");
+  } else {
+    DMA::init_copy_engine();
   }
+  BootProfile::mark(BootProfile::Stage::DMA);
+
+  // Wake up the other cores.
+  SMP::init();
+  BootProfile::mark(BootProfile::Stage::SMP);
 
   kmain();  // the real kernel entry point
   call_fini_array();
 }
+
+/** The C and C++ world entry point of secondary cores. It is called from the boot.S assembly script,
+ * once the MMU is enabled on the core. */
+extern "C" [[noreturn]] void _secondary_startup(size_t core_id) {
+  // Each core has its own Interrupt Vector Table register and FPU.
+  init_interrupts_vector_table();
+  enable_fpu_and_neon();
+
+  SMP::secondary_main(core_id);
+}
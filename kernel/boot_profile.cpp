@@ -0,0 +1,92 @@
+#include "boot_profile.hpp"
+#include <libk/log.hpp>
+#include "hardware/timer.hpp"
+
+namespace BootProfile {
+static uint64_t g_timestamps[STAGE_COUNT];
+
+static constexpr const char* STAGE_NAMES[] = {
+    "start",        "mmu init",      "startup",        "kernel device tree", "kernel memory",
+    "mailbox",      "device",        "irq manager",    "gpio",               "log uart",
+    "system timer", "dma",           "smp",            "task manager",       "file system",
+    "framebuffer",  "boot snapshot", "window manager", "wallpaper",          "init program",
+    "boot done",
+};
+
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == STAGE_COUNT, "a stage has no name");
+
+void mark(Stage stage) {
+  mark(stage, GenericTimer::get_tick_count());
+}
+
+void mark(Stage stage, uint64_t ticks) {
+  // The first mark wins. Each stage is marked by a single boot task.
+  uint64_t& timestamp = g_timestamps[(size_t)stage];
+  if (__atomic_load_n(&timestamp, __ATOMIC_RELAXED) == 0)
+    __atomic_store_n(&timestamp, ticks, __ATOMIC_RELAXED);
+}
+
+static uint64_t ticks_to_micros(uint64_t ticks, uint64_t frequency) {
+  return (ticks * 1'000'000) / frequency;
+}
+
+static void dump_timeline(const Record& record) {
+  const uint64_t origin = record.timestamps[(size_t)Stage::START];
+
+  LOG_INFO("Boot timeline (in us since _start):");
+
+  // The stages are not reached in order (the boot steps run in parallel), sort them. There are few.
+  bool is_dumped[STAGE_COUNT] = {};
+  uint64_t previous = origin;
+  while (true) {
+    size_t next = STAGE_COUNT;
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+      if (is_dumped[i] || record.timestamps[i] == 0)
+        continue;
+      if (next == STAGE_COUNT || record.timestamps[i] < record.timestamps[next])
+        next = i;
+    }
+
+    if (next == STAGE_COUNT)
+      break;
+
+    is_dumped[next] = true;
+    const uint64_t timestamp = record.timestamps[next];
+    LOG_INFO("  {} us (+{} us) {}", ticks_to_micros(timestamp - origin, record.frequency),
+             ticks_to_micros(timestamp - previous, record.frequency), STAGE_NAMES[next]);
+    previous = timestamp;
+  }
+
+  for (size_t i = 0; i < STAGE_COUNT; ++i) {
+    if (record.timestamps[i] == 0)
+      LOG_INFO("  (not reached) {}", STAGE_NAMES[i]);
+  }
+}
+
+static void dump_record(const Record& record) {
+  static constexpr char DIGITS[] = "0123456789abcdef";
+
+  // Hex encoded, on a single line prefixed by "BOOTPROF" so the host finds it in the log.
+  static char hex[2 * sizeof(Record) + 1];
+  const auto* bytes = (const uint8_t*)&record;
+  for (size_t i = 0; i < sizeof(Record); ++i) {
+    hex[2 * i] = DIGITS[bytes[i] >> 4];
+    hex[2 * i + 1] = DIGITS[bytes[i] & 0xf];
+  }
+
+  hex[2 * sizeof(Record)] = '\0';
+  LOG_INFO("BOOTPROF {}", (const char*)hex);
+}
+
+void dump() {
+  Record record = {};
+  record.magic = Record::MAGIC;
+  record.stage_count = STAGE_COUNT;
+  record.frequency = GenericTimer::get_frequency();
+  for (size_t i = 0; i < STAGE_COUNT; ++i)
+    record.timestamps[i] = __atomic_load_n(&g_timestamps[i], __ATOMIC_RELAXED);
+
+  dump_timeline(record);
+  dump_record(record);
+}
+}  // namespace BootProfile
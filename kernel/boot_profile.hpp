@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A timeline of the boot: each stage is stamped with the physical counter (CNTPCT_EL0) when it is reached,
+ * into a static table. Once the boot is done, dump() logs it as a human-readable timeline followed by a
+ * compact binary record (see Record), for tools/boot-profile.py.
+ *
+ * Stamping costs a register read and a store, so the stages are always stamped. With CONFIG_BOOT_PROFILE,
+ * the duration of each boot step (see Initcall) is logged too.
+ */
+namespace BootProfile {
+/** The boot stages, each one stamped when done (keep in sync with boot-profile.py). */
+enum class Stage : uint32_t {
+  /** The first instruction of the boot core, in boot.S. */
+  START,
+  /** The MMU is enabled, at the end of mmu_init(). */
+  MMU_INIT,
+  /** The BSS is cleared and the global constructors are called, in _startup(). */
+  STARTUP,
+  KERNEL_DT,
+  KERNEL_MEMORY,
+  MAILBOX,
+  DEVICE,
+  IRQ_MANAGER,
+  GPIO,
+  LOG_UART,
+  SYSTEM_TIMER,
+  DMA,
+  SMP,
+  TASK_MANAGER,
+  /** The root file system is mounted (f_mount()). */
+  FILE_SYSTEM,
+  FRAMEBUFFER,
+  /** The boot snapshot is shown, if any (see BootSnapshot). */
+  BOOT_SNAPSHOT,
+  WINDOW_MANAGER,
+  /** The wallpaper is read, from the boot snapshot, its cache or by decoding the image. */
+  WALLPAPER,
+  /** The init program is loaded and woken, it enters EL0 at its first scheduling. */
+  INIT_PROGRAM,
+  /** All the boot steps are done. */
+  BOOT_DONE,
+  COUNT,
+};  // enum class Stage
+
+static constexpr size_t STAGE_COUNT = (size_t)Stage::COUNT;
+
+/** The binary record, all in little endian. The stages not reached have a zero timestamp. */
+struct Record {
+  static constexpr uint32_t MAGIC = 0x544f4f42;  // "BOOT"
+
+  uint32_t magic;
+  uint32_t stage_count;
+  uint64_t frequency;  // of the counter, in Hz
+  uint64_t timestamps[STAGE_COUNT];
+};  // struct Record
+
+/** Stamps @a stage with the current counter, if not already stamped. Can be called from any context. */
+void mark(Stage stage);
+/** Stamps @a stage with the counter value @a ticks (read before the BSS was cleared). */
+void mark(Stage stage, uint64_t ticks);
+
+/** Logs the timeline, in the order the stages were reached, then the binary record. */
+void dump();
+}  // namespace BootProfile
@@ -0,0 +1,193 @@
+#include "boot_snapshot.hpp"
+
+#include <sys/file.h>
+
+#include <libk/log.hpp>
+#include <libk/lz4.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "fs/file.hpp"
+#include "fs/filesystem.hpp"
+#include "hardware/framebuffer.hpp"
+#include "memory/mem_alloc.hpp"
+#include "wm/window_manager.hpp"
+
+namespace BootSnapshot {
+/*
+ * The snapshot file: a Header, the stored byte size of each block (as uint32_t), then the blocks. A block stored
+ * with its original byte size is not compressed (it did not shrink).
+ */
+
+struct Header {
+  char magic[4];  // MAGIC
+  uint32_t width;
+  uint32_t height;
+  uint32_t block_count;
+  uint64_t digest;  // WindowManager::get_wallpaper_digest()
+};  // struct Header
+
+static constexpr char MAGIC[4] = {'P', 'K', 'S', 'N'};
+
+static uint32_t* g_wallpaper = nullptr;
+static bool g_is_loaded = false;
+
+static size_t get_block_count(size_t byte_size) {
+  return libk::div_round_up(byte_size, BLOCK_SIZE);
+}
+
+static size_t get_block_size(size_t byte_size, size_t index) {
+  return libk::min(BLOCK_SIZE, byte_size - BLOCK_SIZE * index);
+}
+
+/** Reads the blocks of @a file (after the header) into the @a byte_size bytes at @a pixels. */
+static bool read_blocks(File* file, size_t byte_size, uint8_t* pixels) {
+  const size_t block_count = get_block_count(byte_size);
+  auto* block_sizes = (uint32_t*)kmalloc(sizeof(uint32_t) * block_count, alignof(uint32_t));
+  auto* block = (uint8_t*)kmalloc(BLOCK_SIZE, alignof(uint64_t));
+  size_t read_bytes = 0;
+  bool is_ok = block_sizes != nullptr && block != nullptr &&
+               file->read(block_sizes, sizeof(uint32_t) * block_count, &read_bytes) &&
+               read_bytes == sizeof(uint32_t) * block_count;
+
+  for (size_t i = 0; is_ok && i < block_count; ++i) {
+    const size_t size = get_block_size(byte_size, i);
+    uint8_t* dst = pixels + BLOCK_SIZE * i;
+    if (block_sizes[i] == size) {
+      is_ok = file->read(dst, size, &read_bytes) && read_bytes == size;
+    } else {
+      is_ok = block_sizes[i] < size && file->read(block, block_sizes[i], &read_bytes) &&
+              read_bytes == block_sizes[i] && libk::lz4_decompress(block, block_sizes[i], dst, size);
+    }
+  }
+
+  kfree(block);
+  kfree(block_sizes);
+  return is_ok;
+}
+
+/** Copies the @a pixels of the screen size to the framebuffer, and presents them. */
+static void show(const uint32_t* pixels) {
+  auto& fb = FrameBuffer::get();
+  FrameBuffer::Pixel* buffer = fb.get_buffer();
+  for (uint32_t y = 0; y < fb.get_height(); ++y) {
+    for (uint32_t x = 0; x < fb.get_width(); ++x)
+      buffer[x + fb.get_pitch() * y] = FrameBuffer::PixelFormat::from_argb(pixels[x + fb.get_width() * y]);
+  }
+
+  if (fb.has_partial_present())
+    fb.present_rect(0, 0, fb.get_width(), fb.get_height());
+  else
+    fb.present();
+}
+
+bool load() {
+  const auto& fb = FrameBuffer::get();
+  if (!fb.is_initialized())
+    return false;
+
+  File* file = FileSystem::get().open(SNAPSHOT_PATH, SYS_FM_READ);
+  if (file == nullptr)
+    return false;
+
+  Header header;
+  size_t read_bytes = 0;
+  const size_t byte_size = sizeof(uint32_t) * fb.get_width() * fb.get_height();
+  bool is_ok = file->read(&header, sizeof(header), &read_bytes) && read_bytes == sizeof(header) &&
+               libk::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.width == fb.get_width() &&
+               header.height == fb.get_height() && header.block_count == get_block_count(byte_size) &&
+               header.digest == WindowManager::get_wallpaper_digest();
+
+  if (is_ok) {
+    g_wallpaper = (uint32_t*)kmalloc(byte_size, alignof(max_align_t));
+    is_ok = g_wallpaper != nullptr && read_blocks(file, byte_size, (uint8_t*)g_wallpaper);
+  }
+
+  FileSystem::get().close(file);
+  if (!is_ok) {
+    LOG_WARNING("Ignoring '{}', not made for this wallpaper and screen", SNAPSHOT_PATH);
+    kfree(g_wallpaper);
+    g_wallpaper = nullptr;
+    return false;
+  }
+
+  show(g_wallpaper);
+  g_is_loaded = true;
+  LOG_INFO("Boot snapshot shown from '{}'", SNAPSHOT_PATH);
+  return true;
+}
+
+bool has_wallpaper() {
+  return g_wallpaper != nullptr;
+}
+
+void take_wallpaper(uint32_t* wallpaper) {
+  const auto& fb = FrameBuffer::get();
+  libk::memcpy(wallpaper, g_wallpaper, sizeof(uint32_t) * fb.get_width() * fb.get_height());
+  kfree(g_wallpaper);
+  g_wallpaper = nullptr;
+}
+
+#if !FF_FS_READONLY
+/** Compresses the @a byte_size bytes at @a pixels into @a blocks, their byte sizes into @a block_sizes. Returns the
+ * byte size of the blocks. */
+static size_t compress_blocks(const uint8_t* pixels, size_t byte_size, uint8_t* blocks, uint32_t* block_sizes) {
+  size_t offset = 0;
+  for (size_t i = 0; i < get_block_count(byte_size); ++i) {
+    const size_t size = get_block_size(byte_size, i);
+    const uint8_t* src = pixels + BLOCK_SIZE * i;
+    // Kept only if it shrinks, the stored size then tells the blocks apart.
+    size_t stored_size = libk::lz4_compress(src, size, blocks + offset, size - 1);
+    if (stored_size == 0) {
+      libk::memcpy(blocks + offset, src, size);
+      stored_size = size;
+    }
+
+    block_sizes[i] = stored_size;
+    offset += stored_size;
+  }
+
+  return offset;
+}
+
+void save(const uint32_t* wallpaper) {
+  const auto& fb = FrameBuffer::get();
+  if (g_is_loaded || wallpaper == nullptr || !fb.is_initialized())
+    return;
+
+  const size_t byte_size = sizeof(uint32_t) * fb.get_width() * fb.get_height();
+  const size_t block_count = get_block_count(byte_size);
+  auto* block_sizes = (uint32_t*)kmalloc(sizeof(uint32_t) * block_count, alignof(uint32_t));
+  auto* blocks = (uint8_t*)kmalloc(byte_size, alignof(uint64_t));
+  File* file = nullptr;
+  if (block_sizes != nullptr && blocks != nullptr)
+    file = FileSystem::get().open(SNAPSHOT_PATH, SYS_FM_WRITE | SYS_FM_TRUNCATE);
+
+  if (file != nullptr) {
+    const size_t blocks_size = compress_blocks((const uint8_t*)wallpaper, byte_size, blocks, block_sizes);
+    const Header header = {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, fb.get_width(), fb.get_height(),
+                           (uint32_t)block_count, WindowManager::get_wallpaper_digest()};
+    size_t wrote_bytes = 0;
+    const bool is_ok = file->write(&header, sizeof(header), &wrote_bytes) && wrote_bytes == sizeof(header) &&
+                       file->write(block_sizes, sizeof(uint32_t) * block_count, &wrote_bytes) &&
+                       wrote_bytes == sizeof(uint32_t) * block_count &&
+                       file->write(blocks, blocks_size, &wrote_bytes) && wrote_bytes == blocks_size;
+
+    // A partial snapshot would fail to decompress, it is emptied anyway.
+    if (is_ok) {
+      LOG_INFO("Boot snapshot saved to '{}' ({} KiB)", SNAPSHOT_PATH, blocks_size / 1024);
+    } else {
+      file->seek(0);
+      file->truncate();
+    }
+
+    FileSystem::get().close(file);
+  }
+
+  kfree(blocks);
+  kfree(block_sizes);
+}
+#else
+void save(const uint32_t*) {}
+#endif  // !FF_FS_READONLY
+}  // namespace BootSnapshot
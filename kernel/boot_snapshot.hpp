@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The boot snapshot: the desktop computed by a previous boot (the wallpaper decoded and scaled to the screen),
+ * LZ4-compressed on the SD card, so the next boots show it as soon as the framebuffer and the file system are ready,
+ * before the window manager and the init program are started. The window manager then takes it as its wallpaper,
+ * without decoding the image again.
+ *
+ * The snapshot is identified by a digest of the wallpaper files and of the screen size (see
+ * WindowManager::get_wallpaper_digest()): it is ignored once one of them changes, and made again at the end of that
+ * boot. It is only written with CONFIG_WRITABLE_FS, but read whenever the file is there.
+ */
+namespace BootSnapshot {
+static constexpr const char* SNAPSHOT_PATH = "1:/boot.snap";
+/** The byte size of the blocks compressed on their own (the last one may be smaller). */
+static constexpr size_t BLOCK_SIZE = 32 * 1024;
+
+/** Reads the snapshot made for the current wallpaper and screen, and shows it on the screen. Returns false if there
+ * is none. Requires the framebuffer and the file system. */
+bool load();
+
+/** Checks if load() read a wallpaper not taken yet. */
+[[nodiscard]] bool has_wallpaper();
+/** Copies the wallpaper read by load() to @a wallpaper (the screen size, in 0x00RRGGBB format) and frees it. */
+void take_wallpaper(uint32_t* wallpaper);
+
+/** Stores @a wallpaper (the screen size, in 0x00RRGGBB format) as the snapshot of the next boots, unless it was
+ * read from the snapshot. Does nothing without CONFIG_WRITABLE_FS. */
+void save(const uint32_t* wallpaper);
+}  // namespace BootSnapshot
@@ -0,0 +1,99 @@
+#include "coverage.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/gcov.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "drain_task.hpp"
+#include "hardware/uart.hpp"
+
+// The pointers to the Info of the instrumented object files, gathered by the linker script.
+extern "C" const libk::gcov::Info* const __gcov_info_start[];
+extern "C" const libk::gcov::Info* const __gcov_info_end[];
+
+namespace Coverage {
+static const UART* g_output = nullptr;
+static libk::PanicHook g_previous_panic_hook = nullptr;
+static uint32_t g_dump_count = 0;
+static bool g_is_panicking = false;
+
+/** The record being filled, sent once its payload is full (see write()). Static, as a dump may be done at panic. */
+static Record g_record;
+
+static void send_record() {
+  // At panic, the other cores may have been stopped while holding the lock.
+  LogUARTLockGuard log_uart_lock(!g_is_panicking);
+  g_output->write("GCD", 3);
+  g_output->write((const char*)&g_record, sizeof(g_record));
+}
+
+static void start_record(uint16_t file, RecordKind kind, uint32_t offset) {
+  g_record = {};
+  g_record.dump = g_dump_count;
+  g_record.file = file;
+  g_record.kind = kind;
+  g_record.offset = offset;
+}
+
+/** Appends @a data to the DATA records of the current file, a libk::gcov::Writer. */
+static void write(const void* data, size_t byte_size, void*) {
+  const auto* bytes = (const uint8_t*)data;
+  while (byte_size > 0) {
+    const size_t size = libk::min(byte_size, PAYLOAD_SIZE - g_record.size);
+    libk::memcpy(g_record.payload + g_record.size, bytes, size);
+    g_record.size += size;
+    bytes += size;
+    byte_size -= size;
+
+    if (g_record.size == PAYLOAD_SIZE) {
+      send_record();
+      start_record(g_record.file, RecordKind::DATA, g_record.offset + PAYLOAD_SIZE);
+    }
+  }
+}
+
+static void dump_file(uint16_t file, const libk::gcov::Info& info) {
+  const size_t path_size = libk::strlen(info.filename) + 1;
+  start_record(file, RecordKind::FILE, path_size + libk::gcov::get_gcda_size(info));
+  send_record();
+
+  start_record(file, RecordKind::DATA, 0);
+  write(info.filename, path_size, nullptr);
+  libk::gcov::write_gcda(info, &write, nullptr);
+  if (g_record.size != 0)
+    send_record();
+}
+
+void dump(bool reset) {
+  if (g_output == nullptr)
+    return;
+
+  uint16_t file = 0;
+  for (const auto* it = __gcov_info_start; it != __gcov_info_end; ++it, ++file) {
+    dump_file(file, **it);
+    if (reset)
+      libk::gcov::reset(**it);
+  }
+
+  start_record(file, RecordKind::END, 0);
+  send_record();
+  LOG_INFO("Coverage: {} object files dumped", file);
+  ++g_dump_count;
+}
+
+/** Called by libk::panic(), chained with the other panic hooks (e.g. the stack trace of KernelSymbols). */
+static void dump_at_panic() {
+  if (g_previous_panic_hook != nullptr)
+    g_previous_panic_hook();
+
+  g_is_panicking = true;
+  dump(false);
+}
+
+void set_output(const UART& uart) {
+  g_output = &uart;
+  g_previous_panic_hook = libk::set_panic_hook(&dump_at_panic);
+}
+}  // namespace Coverage
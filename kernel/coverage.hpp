@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class UART;
+
+/**
+ * The export of the kernel arc counters, with KERNEL_PGO=GENERATE (see libk/gcov.hpp): the counters of each object
+ * file are serialized as a .gcda file and sent over the log UART, in records as for the trace (see trace.hpp). They
+ * are written back as .gcda files on the host by tools/gcda-extract.py, for the KERNEL_PGO=USE build.
+ *
+ * The counters are dumped with sys_debug_command(SYS_DEBUG_DUMP_COVERAGE, reset), once the workload to profile has
+ * run, and at a panic. The boot code is not instrumented: it runs before the MMU maps the counters.
+ *
+ * The coverage is only compiled in with CONFIG_COVERAGE.
+ */
+namespace Coverage {
+/** The kinds of records (keep in sync with gcda-extract.py). */
+enum class RecordKind : uint8_t {
+  /** offset: the byte size of the file, sent next as DATA records: its path, a NUL byte then the .gcda content */
+  FILE,
+  /** payload: the bytes of the file at offset */
+  DATA,
+  /** file: the count of files of the dump, all sent */
+  END,
+};  // enum class RecordKind
+
+static constexpr size_t PAYLOAD_SIZE = 240;
+
+struct Record {
+  uint32_t dump;  // the count of dumps before this one, since boot
+  uint16_t file;  // the index of the file in the dump
+  RecordKind kind;
+  uint8_t size;  // of the payload
+  uint32_t offset;
+  uint32_t reserved;  // 0
+  uint8_t payload[PAYLOAD_SIZE];
+};  // struct Record
+
+static_assert(sizeof(Record) == 256);
+
+/** Sets the UART the records are sent over (the log UART), and dumps the counters at the next panic. */
+void set_output(const UART& uart);
+
+/** Sends the counters of all the instrumented object files, then clears them if @a reset. Does not allocate. */
+void dump(bool reset);
+}  // namespace Coverage
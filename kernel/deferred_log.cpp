@@ -0,0 +1,178 @@
+#include "deferred_log.hpp"
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include "drain_task.hpp"
+#include "hardware/irq_save.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "task/task_manager.hpp"
+
+namespace DeferredLog {
+static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "the ring size must be a power of two");
+
+struct Slot {
+  uint64_t timestamp;  // in timer ticks (see GenericTimer), to merge the rings of the different cores
+  uint64_t time_in_ms;
+  const char* format;
+  const char* file_name;
+  uint32_t line;
+  libk::LogLevel level;
+  bool is_print;
+  bool has_time;
+  uint8_t args_count;
+  // The string arguments point into strings.
+  alignas(libk::detail::Argument) char args[MAX_ARGS * sizeof(libk::detail::Argument)];
+  char strings[MAX_STRINGS_SIZE];
+};  // struct Slot
+
+struct Ring {
+  // Written only by the core owning the ring.
+  uint64_t head;
+  uint64_t lost_count;
+  // Written only by the draining task.
+  alignas(64) uint64_t tail;
+  uint64_t reported_lost_count;
+  Slot slots[RING_SIZE];
+};  // struct Ring
+
+static Ring g_rings[SMP::MAX_CORES];
+/** Set once a critical message is emitted, the kernel is going to panic and writes everything itself. */
+static bool g_is_flushing = false;
+
+/** Copies @a message into @a slot. Returns false if it does not fit. */
+static bool copy_message(Slot& slot, const libk::LogMessage& message) {
+  if (message.args_count > MAX_ARGS)
+    return false;
+
+  libk::memcpy(slot.args, message.args, message.args_count * sizeof(libk::detail::Argument));
+  auto* args = (libk::detail::Argument*)slot.args;
+  size_t strings_size = 0;
+  for (size_t i = 0; i < message.args_count; ++i) {
+    if (args[i].type != libk::detail::Argument::Type::STRING)
+      continue;
+
+    // The string arguments are only borrowed by the caller, unlike the format string and the file name.
+    const size_t length = args[i].data.string_value.length;
+    if (length > MAX_STRINGS_SIZE - strings_size)
+      return false;
+
+    libk::memcpy(slot.strings + strings_size, args[i].data.string_value.value, length);
+    args[i].data.string_value.value = slot.strings + strings_size;
+    strings_size += length;
+  }
+
+  slot.timestamp = GenericTimer::get_tick_count();
+  slot.time_in_ms = message.time_in_ms;
+  slot.format = message.format;
+  slot.file_name = message.file_name;
+  slot.line = message.line;
+  slot.level = message.level;
+  slot.is_print = message.is_print;
+  slot.has_time = message.has_time;
+  slot.args_count = message.args_count;
+  return true;
+}
+
+static bool defer(const libk::LogMessage& message) {
+  if (__atomic_load_n(&g_is_flushing, __ATOMIC_ACQUIRE))
+    return false;
+
+  const uint64_t daif = IRQSave::mask_irqs();
+
+  Ring& ring = g_rings[SMP::get_core_id()];
+  bool is_deferred = true;
+  const uint64_t head = ring.head;
+  if (head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+    ring.lost_count++;
+  } else if (copy_message(ring.slots[head % RING_SIZE], message)) {
+    __atomic_store_n(&ring.head, head + 1, __ATOMIC_RELEASE);
+  } else {
+    is_deferred = false;
+  }
+
+  IRQSave::restore_irqs(daif);
+  return is_deferred;
+}
+
+static void write_slot(const Slot& slot) {
+  libk::LogMessage message = {};
+  message.level = slot.level;
+  message.is_print = slot.is_print;
+  message.has_time = slot.has_time;
+  message.time_in_ms = slot.time_in_ms;
+  message.format = slot.format;
+  message.file_name = slot.file_name;
+  message.line = slot.line;
+  message.args = (const libk::detail::Argument*)slot.args;
+  message.args_count = slot.args_count;
+  libk::detail::write_message(message);
+}
+
+static void report_lost_messages(Ring& ring) {
+  const uint64_t lost_count = __atomic_load_n(&ring.lost_count, __ATOMIC_ACQUIRE);
+  if (lost_count == ring.reported_lost_count)
+    return;
+
+  LogUARTLockGuard log_uart_lock(!__atomic_load_n(&g_is_flushing, __ATOMIC_ACQUIRE));
+
+  const libk::detail::Argument args[] = {lost_count - ring.reported_lost_count};
+  libk::LogMessage message = {};
+  message.level = libk::LogLevel::WARNING;
+  message.format = "{} log messages lost (the log ring was full)";
+  message.args = args;
+  message.args_count = 1;
+  libk::detail::write_message(message);
+  ring.reported_lost_count = lost_count;
+}
+
+size_t drain(size_t max_messages) {
+  size_t count = 0;
+  for (; count < max_messages; ++count) {
+    // Write the oldest message of all the rings first.
+    Ring* oldest_ring = nullptr;
+    for (Ring& ring : g_rings) {
+      const uint64_t tail = ring.tail;
+      if (tail == __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE))
+        continue;
+
+      if (oldest_ring == nullptr ||
+          ring.slots[tail % RING_SIZE].timestamp < oldest_ring->slots[oldest_ring->tail % RING_SIZE].timestamp)
+        oldest_ring = &ring;
+    }
+
+    if (oldest_ring == nullptr)
+      break;
+
+    {
+      // At panic, the other cores may have been stopped while holding the lock.
+      LogUARTLockGuard log_uart_lock(!__atomic_load_n(&g_is_flushing, __ATOMIC_ACQUIRE));
+      write_slot(oldest_ring->slots[oldest_ring->tail % RING_SIZE]);
+    }
+    __atomic_store_n(&oldest_ring->tail, oldest_ring->tail + 1, __ATOMIC_RELEASE);
+  }
+
+  for (Ring& ring : g_rings)
+    report_lost_messages(ring);
+
+  return count;
+}
+
+static void flush() {
+  // The drain task may be preempted in the middle of a drain, the messages it was writing are then
+  // written twice. As the kernel then panics, this is better than losing them.
+  __atomic_store_n(&g_is_flushing, true, __ATOMIC_RELEASE);
+  drain(SMP::MAX_CORES * RING_SIZE);
+}
+
+void init() {
+  static constexpr size_t MAX_MESSAGES_PER_DRAIN = 16;
+  auto task = DrainTask::create(&drain, MAX_MESSAGES_PER_DRAIN);
+  // Formatting and writing the messages is never urgent: only drain them when the cores have nothing
+  // better to do, the messages emitted meanwhile are dropped once the rings are full.
+  TaskManager::get().set_task_priority(task, Scheduler::MIN_PRIORITY + 1);
+  TaskManager::get().wake_task(task);
+
+  libk::set_log_deferrer(&defer, &flush);
+}
+}  // namespace DeferredLog
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Defers the formatting and the writing of the log messages to a low priority kernel task, so logging
+ * does not busy-wait on the log UART anymore (at 1 Mbaud, a log line costs about a millisecond).
+ *
+ * The caller only copies the message (the pointer to its format string, its arguments and a copy of its
+ * string arguments) into a slot of the ring of its core, IRQs masked, without any lock (the rings are
+ * single producer single consumer, using only ordered loads and stores, see KernelLock for why). The
+ * drain task merges the rings in the order the messages were emitted, formats and writes them.
+ *
+ * A message is dropped if its ring is full, the count of dropped messages is then logged by the drain task.
+ * The messages that do not fit in a slot and the critical ones are still written immediately.
+ */
+namespace DeferredLog {
+/** Count of slots of the ring of each core. */
+static constexpr size_t RING_SIZE = 64;
+/** The maximum count of arguments of a deferred message. */
+static constexpr size_t MAX_ARGS = 8;
+/** The room for the copies of the string arguments of a deferred message. */
+static constexpr size_t MAX_STRINGS_SIZE = 160;
+
+/**
+ * Formats and writes at most @a max_messages deferred messages. Returns the count of messages written.
+ * It must not be called by several cores at the same time.
+ */
+size_t drain(size_t max_messages);
+
+/** Starts deferring the log messages, and the kernel task that drains them. Requires the task manager. */
+void init();
+};  // namespace DeferredLog
@@ -0,0 +1,48 @@
+#include "drain_task.hpp"
+#include <libk/assert.hpp>
+#include "hardware/spin_lock.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+
+static BakeryLock g_log_uart_lock;
+
+LogUARTLockGuard::LogUARTLockGuard(bool is_locking) : m_is_locking(is_locking) {
+  if (!m_is_locking)
+    return;
+
+  Task::current()->disable_preempt();
+  g_log_uart_lock.lock();
+}
+
+LogUARTLockGuard::~LogUARTLockGuard() {
+  if (!m_is_locking)
+    return;
+
+  g_log_uart_lock.unlock();
+  Task::current()->enable_preempt();
+}
+
+namespace DrainTask {
+struct Drainer {
+  DrainFunction drain;
+  size_t batch_size;
+};  // struct Drainer
+
+static void run(void* arg) {
+  const auto* drainer = (const Drainer*)arg;
+  while (true) {
+    if (drainer->drain(drainer->batch_size) < drainer->batch_size)
+      sys_usleep(DRAIN_PERIOD);
+  }
+}
+
+libk::IntrusivePtr<Task> create(DrainFunction drain, size_t batch_size) {
+  // Never freed, the task runs forever.
+  auto* drainer = new Drainer{drain, batch_size};
+  KASSERT(drainer != nullptr);
+
+  auto task = TaskManager::get().create_kernel_task(&run, drainer);
+  KASSERT(task != nullptr);
+  return task;
+}
+}  // namespace DrainTask
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+
+class Task;
+
+/**
+ * The kernel tasks writing to the log UART what the cores buffered into their rings: the binary records of
+ * Trace ("TRC") and Profiler ("PRF"), and the messages of DeferredLog.
+ *
+ * These tasks never take the kernel lock (the rings and the polled log UART do not need it) and run on any
+ * core. Each record is written while holding the log UART lock (see LogUARTLockGuard), otherwise the bytes of
+ * the records written by several cores would interleave and break the framing the host decoders rely on.
+ */
+namespace DrainTask {
+/** Writes at most @a max_count buffered records. Returns the count of records written. */
+using DrainFunction = size_t (*)(size_t max_count);
+
+/** The sleep of the tasks once a drain found less than a batch of records. */
+static constexpr uint64_t DRAIN_PERIOD = 10'000;  // in microseconds
+
+/** Creates the kernel task calling @a drain by batches of @a batch_size records. The task is not awaken. */
+[[nodiscard]] libk::IntrusivePtr<Task> create(DrainFunction drain, size_t batch_size);
+}  // namespace DrainTask
+
+/**
+ * RAII helper serializing the writes of a record to the log UART, between the drain tasks (and the coverage
+ * dumps, see Coverage::dump()).
+ *
+ * The lock is a BakeryLock, taken with the preemption of the current task disabled: a task switched out while
+ * holding it would stall the drain tasks of the other cores, and the IRQs are not masked during the writes
+ * (a millisecond for a log line at 1 Mbaud). Without @a is_locking (at panic, once the other cores are stopped,
+ * maybe holding the lock), nothing is done.
+ */
+class LogUARTLockGuard {
+ public:
+  explicit LogUARTLockGuard(bool is_locking = true);
+  ~LogUARTLockGuard();
+
+  // No copy and move
+  LogUARTLockGuard(const LogUARTLockGuard&) = delete;
+  LogUARTLockGuard(LogUARTLockGuard&&) = delete;
+  LogUARTLockGuard& operator=(const LogUARTLockGuard&) = delete;
+  LogUARTLockGuard& operator=(LogUARTLockGuard&&) = delete;
+
+ private:
+  bool m_is_locking;
+};  // class LogUARTLockGuard
@@ -0,0 +1,77 @@
+#include "dentry_cache.hpp"
+#include <libk/hash.hpp>
+#include <libk/string.hpp>
+
+DentryCache::~DentryCache() {
+  while (!m_entries.is_empty())
+    evict(m_entries.back());
+}
+
+uint64_t DentryCache::hash(Kind kind, const char* path, size_t path_length) {
+  return libk::hash((const uint8_t*)path, path_length) ^ (uint64_t)kind;
+}
+
+const DentryCache::Entry* DentryCache::find(Kind kind, const char* path) {
+  const size_t path_length = libk::strlen(path);
+  if (path_length >= MAX_PATH_LENGTH)
+    return nullptr;
+
+  const uint64_t path_hash = hash(kind, path, path_length);
+  for (Entry* entry = m_buckets[path_hash % NB_BUCKETS]; entry != nullptr; entry = entry->next_in_bucket) {
+    if (entry->hash == path_hash && entry->kind == kind && entry->path_length == path_length &&
+        libk::memcmp(entry->path, path, path_length) == 0) {
+      // Move it to the front, so the least recently used entries are at the back.
+      m_entries.remove(entry);
+      m_entries.push_front(entry);
+      return entry;
+    }
+  }
+
+  return nullptr;
+}
+
+DentryCache::Entry* DentryCache::insert(Kind kind, const char* path, FRESULT result) {
+  const size_t path_length = libk::strlen(path);
+  if (path_length >= MAX_PATH_LENGTH)
+    return nullptr;
+
+  if (m_entry_count == MAX_ENTRIES)
+    evict(m_entries.back());
+
+  auto* entry = new Entry{};
+  entry->hash = hash(kind, path, path_length);
+  entry->kind = kind;
+  entry->result = result;
+  entry->path_length = path_length;
+  libk::memcpy(entry->path, path, path_length);
+  entry->path[path_length] = '\0';
+
+  Entry*& bucket = m_buckets[entry->hash % NB_BUCKETS];
+  entry->next_in_bucket = bucket;
+  bucket = entry;
+
+  m_entries.push_front(entry);
+  ++m_entry_count;
+  return entry;
+}
+
+size_t DentryCache::shrink(size_t byte_size) {
+  size_t freed_byte_size = 0;
+  while (freed_byte_size < byte_size && !m_entries.is_empty()) {
+    evict(m_entries.back());
+    freed_byte_size += sizeof(Entry);
+  }
+
+  return freed_byte_size;
+}
+
+void DentryCache::evict(Entry* entry) {
+  Entry** it = &m_buckets[entry->hash % NB_BUCKETS];
+  while (*it != entry)
+    it = &(*it)->next_in_bucket;
+  *it = entry->next_in_bucket;
+
+  m_entries.remove(entry);
+  --m_entry_count;
+  delete entry;
+}
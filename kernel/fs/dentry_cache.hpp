@@ -0,0 +1,64 @@
+#pragma once
+
+#include <libk/intrusive_list.hpp>
+#include <cstddef>
+#include <cstdint>
+#include "fat/ff.h"
+
+/**
+ * A cache of the path lookups done by the FileSystem (the FatFs directory walks), the failed ones included.
+ *
+ * The FatFs volume is read-only (FF_FS_READONLY), so a directory entry never changes once looked up: a file
+ * or directory is then reopened by copying the object state cached by its first opening, instead of parsing
+ * the path and walking (and decoding the long names of) the directory clusters again.
+ *
+ * The number of entries is bounded, the least recently used ones are evicted first.
+ */
+class DentryCache {
+ public:
+  /** Paths longer than this are not cached. */
+  static constexpr size_t MAX_PATH_LENGTH = 128;
+  static constexpr size_t MAX_ENTRIES = 256;
+  static constexpr size_t NB_BUCKETS = 64;
+
+  enum class Kind : uint8_t { FILE, DIR };
+
+  struct Entry {
+    libk::IntrusiveListHook hook;
+    Entry* next_in_bucket;
+    uint64_t hash;
+    Kind kind;
+    // FR_OK, or why the lookup failed.
+    FRESULT result;
+    // The object state as left by f_open() or f_opendir(), only valid if result is FR_OK.
+    union {
+      struct {
+        FFOBJID object;
+        // The file content inside the ramdisk, see File::get_data().
+        const uint8_t* data;
+      } file;
+      DIR dir;
+    };
+    size_t path_length;
+    char path[MAX_PATH_LENGTH];
+  };  // struct Entry
+
+  ~DentryCache();
+
+  /** Returns the cached lookup of @a path as a @a kind, or nullptr if not cached. */
+  [[nodiscard]] const Entry* find(Kind kind, const char* path);
+  /** Adds an entry for @a path to be filled by the caller, or returns nullptr if @a path is too long. */
+  [[nodiscard]] Entry* insert(Kind kind, const char* path, FRESULT result);
+  /** Evicts the least recently used entries until @a byte_size bytes are freed (or the cache is empty). Returns the
+   * count of bytes freed, see MemoryPressure::Shrinker. */
+  size_t shrink(size_t byte_size);
+
+ private:
+  [[nodiscard]] static uint64_t hash(Kind kind, const char* path, size_t path_length);
+  void evict(Entry* entry);
+
+  Entry* m_buckets[NB_BUCKETS] = {};
+  // The most recently used entries first.
+  libk::IntrusiveList<Entry, &Entry::hook> m_entries;
+  size_t m_entry_count = 0;
+};  // class DentryCache
@@ -1,10 +1,23 @@
 #include "dir.hpp"
 #include <libk/assert.hpp>
 #include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include <cstddef>
+#include "procfs.hpp"
 
 bool Dir::read(sys_file_info_t* file_info) {
   KASSERT(file_info != nullptr);
 
+  if (m_is_proc) {
+    if (m_proc_index == ProcFs::FILE_COUNT)
+      return false;
+
+    const char* name = ProcFs::FILE_NAMES[m_proc_index++];
+    libk::memcpy(file_info->name, name, libk::strlen(name) + 1);
+    file_info->is_dir = false;
+    return true;
+  }
+
   FILINFO filinfo;
   if (f_readdir(&m_handle, &filinfo) != FR_OK || filinfo.fname[0] == 0)
     return false;
@@ -13,3 +26,77 @@ bool Dir::read(sys_file_info_t* file_info) {
   file_info->is_dir = (filinfo.fattrib & AM_DIR) != 0;
   return true;
 }
+
+bool Dir::read_many(void* buffer, size_t buffer_size, bool names_only, size_t* read_size) {
+  KASSERT(buffer != nullptr && read_size != nullptr);
+
+  if (m_is_proc)
+    return read_many_proc(buffer, buffer_size, names_only, read_size);
+
+  auto* output = (uint8_t*)buffer;
+  size_t size = 0;
+  FILINFO filinfo;
+  while (true) {
+    // The position before the entry, to read it again by the next call if it does not fit.
+    const DIR previous_handle = m_handle;
+    if (f_readdir(&m_handle, &filinfo) != FR_OK || filinfo.fname[0] == 0)
+      break;
+
+    const size_t name_size = libk::strlen(filinfo.fname) + 1;
+    const size_t entry_size =
+        names_only ? name_size
+                   : libk::align_to_next(offsetof(sys_dir_entry_t, name) + name_size, SYS_DIR_ENTRY_ALIGNMENT);
+    if (entry_size > buffer_size - size) {
+      m_handle = previous_handle;
+      *read_size = size;
+      return size > 0;
+    }
+
+    if (names_only) {
+      libk::memcpy(output + size, filinfo.fname, name_size);
+    } else {
+      auto* entry = (sys_dir_entry_t*)(output + size);
+      entry->size = entry_size;
+      entry->is_dir = (filinfo.fattrib & AM_DIR) != 0;
+      entry->file_size = filinfo.fsize;
+      libk::memcpy(entry->name, filinfo.fname, name_size);
+    }
+
+    size += entry_size;
+  }
+
+  *read_size = size;
+  return true;
+}
+
+bool Dir::read_many_proc(void* buffer, size_t buffer_size, bool names_only, size_t* read_size) {
+  auto* output = (uint8_t*)buffer;
+  size_t size = 0;
+  for (; m_proc_index < ProcFs::FILE_COUNT; ++m_proc_index) {
+    const char* name = ProcFs::FILE_NAMES[m_proc_index];
+    const size_t name_size = libk::strlen(name) + 1;
+    const size_t entry_size =
+        names_only ? name_size
+                   : libk::align_to_next(offsetof(sys_dir_entry_t, name) + name_size, SYS_DIR_ENTRY_ALIGNMENT);
+    if (entry_size > buffer_size - size) {
+      *read_size = size;
+      return size > 0;
+    }
+
+    if (names_only) {
+      libk::memcpy(output + size, name, name_size);
+    } else {
+      // The size of a generated file is only known once opened.
+      auto* entry = (sys_dir_entry_t*)(output + size);
+      entry->size = entry_size;
+      entry->is_dir = false;
+      entry->file_size = 0;
+      libk::memcpy(entry->name, name, name_size);
+    }
+
+    size += entry_size;
+  }
+
+  *read_size = size;
+  return true;
+}
@@ -7,8 +7,20 @@
 class Dir {
  public:
   bool read(sys_file_info_t* file_info);
+  /**
+   * Reads as many of the next entries as fit into @a buffer, as sys_dir_entry_t or only the names if
+   * @a names_only (see sys_read_dir_many()). The written byte count is stored into @a read_size, it is
+   * 0 at the end of the directory. Returns false if the buffer is too small for the next entry.
+   */
+  bool read_many(void* buffer, size_t buffer_size, bool names_only, size_t* read_size);
 
  private:
+  /** Same as read_many() for the /proc directory. */
+  bool read_many_proc(void* buffer, size_t buffer_size, bool names_only, size_t* read_size);
+
   friend class FileSystem;
   DIR m_handle;
+  // The /proc directory (see ProcFs) is listed from ProcFs::FILE_NAMES instead of m_handle.
+  bool m_is_proc = false;
+  size_t m_proc_index = 0;
 };  // class Dir
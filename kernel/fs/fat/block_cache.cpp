@@ -0,0 +1,322 @@
+#include "block_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+BlockCache::~BlockCache() {
+  for (const Block& block : m_blocks)
+    delete[] block.data;
+  delete[] m_staging;
+}
+
+BlockCache::Block* BlockCache::find(LBA_t first_sector) {
+  Block** block = m_index.find(first_sector);
+  return block != nullptr ? *block : nullptr;
+}
+
+BlockCache::Block* BlockCache::insert(LBA_t first_sector, bool* has_failed) {
+  *has_failed = false;
+
+  if (m_staging == nullptr) {
+    m_staging = new uint8_t[MAX_RUN_LENGTH * SECTOR_SIZE];
+    if (m_staging == nullptr)
+      return nullptr;
+  }
+
+  Block* block;
+  if (!m_free_blocks.is_empty()) {
+    block = m_free_blocks.pop_front();
+  } else if (m_nb_blocks < CAPACITY) {
+    block = &m_blocks[m_nb_blocks++];
+  } else {
+    block = m_lru.back();
+    // The dirty sectors of the evicted block are written with all the others, merged into runs.
+    if (block->dirty_mask != 0 && !sync()) {
+      *has_failed = true;
+      return nullptr;
+    }
+
+    evict(block);
+  }
+
+  if (block->data == nullptr) {
+    block->data = new uint8_t[BLOCK_SIZE];
+    if (block->data == nullptr) {
+      m_free_blocks.push_back(block);
+      return nullptr;
+    }
+  }
+
+  block->first_sector = first_sector;
+  block->valid_mask = 0;
+  block->dirty_mask = 0;
+  m_index.insert(first_sector, block);
+  m_lru.push_front(block);
+  return block;
+}
+
+void BlockCache::evict(Block* block) {
+  KASSERT(block->dirty_mask == 0);
+  m_lru.remove(block);
+  m_index.remove(block->first_sector);
+  m_stats.nb_evictions++;
+}
+
+void BlockCache::touch(Block* block) {
+  if (m_lru.front() == block)
+    return;
+
+  m_lru.remove(block);
+  m_lru.push_front(block);
+}
+
+bool BlockCache::fill(Block* block, size_t readahead_count) {
+  // The following blocks are read ahead only if not cached at all, so the run is contiguous.
+  const LBA_t sector_count = m_get_sector_count();
+  Block* blocks[MAX_READAHEAD_BLOCKS] = {block};
+  size_t nb_blocks = 1;
+  while (nb_blocks <= readahead_count && nb_blocks < MAX_READAHEAD_BLOCKS) {
+    const LBA_t first_sector = block->first_sector + nb_blocks * SECTORS_PER_BLOCK;
+    if (first_sector >= sector_count || find(first_sector) != nullptr)
+      break;
+
+    bool has_failed;
+    blocks[nb_blocks] = insert(first_sector, &has_failed);
+    if (has_failed)
+      return false;
+    if (blocks[nb_blocks] == nullptr)
+      break;
+    ++nb_blocks;
+  }
+
+  // The last block of the device may be partial.
+  const size_t nb_sectors = libk::min<LBA_t>(nb_blocks * SECTORS_PER_BLOCK, sector_count - block->first_sector);
+  m_stats.nb_device_reads++;
+  if (!m_read(block->first_sector, m_staging, nb_sectors))
+    return false;
+
+  m_stats.nb_readahead_sectors += nb_sectors - libk::min(nb_sectors, SECTORS_PER_BLOCK);
+
+  for (size_t i = 0; i < nb_blocks; ++i) {
+    const size_t first = i * SECTORS_PER_BLOCK;
+    const size_t length = libk::min(nb_sectors - libk::min(nb_sectors, first), SECTORS_PER_BLOCK);
+    for (size_t j = 0; j < length; ++j) {
+      // The cached sectors (written ones) are newer than the device ones.
+      if ((blocks[i]->valid_mask & get_mask(j, 1)) == 0)
+        libk::memcpy(blocks[i]->data + j * SECTOR_SIZE, m_staging + (first + j) * SECTOR_SIZE, SECTOR_SIZE);
+    }
+
+    blocks[i]->valid_mask |= get_mask(0, length);
+  }
+
+  return true;
+}
+
+bool BlockCache::read_uncached(LBA_t sector, void* buffer, size_t count) {
+  m_stats.nb_uncached_sectors += count;
+  m_stats.nb_device_reads++;
+  if (!m_read(sector, buffer, count))
+    return false;
+
+  if (m_nb_dirty_sectors == 0)
+    return true;
+
+  auto* output = (uint8_t*)buffer;
+  for (size_t i = 0; i < count; ++i) {
+    const LBA_t first_sector = (sector + i) - (sector + i) % SECTORS_PER_BLOCK;
+    const size_t index = (sector + i) - first_sector;
+    const Block* block = find(first_sector);
+    if (block != nullptr && (block->dirty_mask & get_mask(index, 1)) != 0)
+      libk::memcpy(output + i * SECTOR_SIZE, block->data + index * SECTOR_SIZE, SECTOR_SIZE);
+  }
+
+  return true;
+}
+
+void BlockCache::update_cached_sectors(LBA_t sector, const void* buffer, size_t count) {
+  const auto* input = (const uint8_t*)buffer;
+  for (size_t i = 0; i < count; ++i) {
+    const LBA_t first_sector = (sector + i) - (sector + i) % SECTORS_PER_BLOCK;
+    const size_t index = (sector + i) - first_sector;
+    Block* block = find(first_sector);
+    if (block == nullptr || (block->valid_mask & get_mask(index, 1)) == 0)
+      continue;
+
+    libk::memcpy(block->data + index * SECTOR_SIZE, input + i * SECTOR_SIZE, SECTOR_SIZE);
+    if ((block->dirty_mask & get_mask(index, 1)) != 0) {
+      block->dirty_mask &= ~get_mask(index, 1);
+      m_nb_dirty_sectors--;
+    }
+  }
+}
+
+bool BlockCache::read(LBA_t sector, void* buffer, size_t count) {
+  const bool is_sequential = sector == m_next_sector;
+  m_next_sector = sector + count;
+
+  if (count > MAX_RUN_LENGTH)
+    return read_uncached(sector, buffer, count);
+
+  auto* output = (uint8_t*)buffer;
+  while (count > 0) {
+    const LBA_t first_sector = sector - sector % SECTORS_PER_BLOCK;
+    const size_t first = sector - first_sector;
+    const size_t length = libk::min(count, SECTORS_PER_BLOCK - first);
+    const SectorMask mask = get_mask(first, length);
+
+    Block* block = find(first_sector);
+    if (block != nullptr && (block->valid_mask & mask) == mask) {
+      m_stats.nb_hits += length;
+      touch(block);
+    } else {
+      if (block == nullptr) {
+        bool has_failed;
+        block = insert(first_sector, &has_failed);
+        if (has_failed)
+          return false;
+        // Out of memory, the remaining sectors are read without caching them.
+        if (block == nullptr)
+          return read_uncached(sector, output, count);
+      }
+
+      // Touched first, so the blocks read ahead can not evict it.
+      touch(block);
+      m_stats.nb_misses += length;
+      if (!fill(block, is_sequential ? MAX_READAHEAD_BLOCKS - 1 : 0))
+        return false;
+    }
+
+    libk::memcpy(output, block->data + first * SECTOR_SIZE, length * SECTOR_SIZE);
+    sector += length;
+    output += length * SECTOR_SIZE;
+    count -= length;
+  }
+
+  return true;
+}
+
+bool BlockCache::write(LBA_t sector, const void* buffer, size_t count) {
+  // Larger than a run, written as is.
+  if (count > MAX_RUN_LENGTH) {
+    update_cached_sectors(sector, buffer, count);
+    m_stats.nb_device_writes++;
+    m_stats.nb_written_sectors += count;
+    return m_write(sector, buffer, count);
+  }
+
+  const auto* input = (const uint8_t*)buffer;
+  while (count > 0) {
+    const LBA_t first_sector = sector - sector % SECTORS_PER_BLOCK;
+    const size_t first = sector - first_sector;
+    const size_t length = libk::min(count, SECTORS_PER_BLOCK - first);
+    const SectorMask mask = get_mask(first, length);
+
+    // The written sectors are not read from the device, the block is only partially valid.
+    Block* block = find(first_sector);
+    if (block == nullptr) {
+      bool has_failed;
+      block = insert(first_sector, &has_failed);
+      if (has_failed)
+        return false;
+    }
+
+    if (block == nullptr) {
+      // Out of memory, written as is.
+      m_stats.nb_device_writes++;
+      m_stats.nb_written_sectors += length;
+      if (!m_write(sector, input, length))
+        return false;
+    } else {
+      touch(block);
+      libk::memcpy(block->data + first * SECTOR_SIZE, input, length * SECTOR_SIZE);
+      m_nb_dirty_sectors += std::popcount((SectorMask)(mask & ~block->dirty_mask));
+      block->valid_mask |= mask;
+      block->dirty_mask |= mask;
+    }
+
+    sector += length;
+    input += length * SECTOR_SIZE;
+    count -= length;
+  }
+
+  return true;
+}
+
+bool BlockCache::sync() {
+  if (m_nb_dirty_sectors == 0)
+    return true;
+
+  Block* dirty_blocks[CAPACITY];
+  size_t nb_dirty_blocks = 0;
+  for (Block* block : m_lru) {
+    if (block->dirty_mask != 0)
+      dirty_blocks[nb_dirty_blocks++] = block;
+  }
+
+  std::sort(dirty_blocks, dirty_blocks + nb_dirty_blocks,
+            [](const Block* a, const Block* b) { return a->first_sector < b->first_sector; });
+
+  bool success = true;
+  LBA_t run_start = 0;
+  size_t run_length = 0;
+  const auto write_run = [&]() {
+    if (run_length == 0)
+      return;
+
+    m_stats.nb_device_writes++;
+    m_stats.nb_written_sectors += run_length;
+    success &= m_write(run_start, m_staging, run_length);
+    run_length = 0;
+  };
+
+  for (size_t i = 0; i < nb_dirty_blocks; ++i) {
+    Block* block = dirty_blocks[i];
+    for (size_t j = 0; j < SECTORS_PER_BLOCK; ++j) {
+      if ((block->dirty_mask & get_mask(j, 1)) == 0)
+        continue;
+
+      const LBA_t sector = block->first_sector + j;
+      if (run_length == MAX_RUN_LENGTH || (run_length > 0 && sector != run_start + run_length))
+        write_run();
+      if (run_length == 0)
+        run_start = sector;
+
+      libk::memcpy(m_staging + run_length * SECTOR_SIZE, block->data + j * SECTOR_SIZE, SECTOR_SIZE);
+      ++run_length;
+    }
+
+    block->dirty_mask = 0;
+  }
+
+  write_run();
+  m_nb_dirty_sectors = 0;
+  return success;
+}
+
+size_t BlockCache::shrink(size_t byte_size) {
+  size_t freed_byte_size = 0;
+  Block* block = m_lru.back();
+  while (block != nullptr && freed_byte_size < byte_size) {
+    Block* previous = m_lru.previous(block);
+    // The dirty blocks are kept until the next sync.
+    if (block->dirty_mask == 0) {
+      evict(block);
+      delete[] block->data;
+      block->data = nullptr;
+      m_free_blocks.push_back(block);
+      freed_byte_size += BLOCK_SIZE;
+    }
+
+    block = previous;
+  }
+
+  if (m_lru.is_empty() && m_staging != nullptr) {
+    delete[] m_staging;
+    m_staging = nullptr;
+    freed_byte_size += MAX_RUN_LENGTH * SECTOR_SIZE;
+  }
+
+  return freed_byte_size;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <libk/hash_table.hpp>
+#include <libk/intrusive_list.hpp>
+#include <cstddef>
+#include <cstdint>
+#include "boot/mmu_utils.hpp"
+#include "ff.h"
+
+/**
+ * A cache of the sectors of a block device (the SD card), between FatFs and the device driver (see disk_read()).
+ *
+ * The sectors are cached by page-sized blocks of SECTORS_PER_BLOCK sectors, found through a hash table and evicted
+ * in least recently used order. FatFs reads the same FAT and directory sectors again and again, they are then
+ * copied from the cache instead of costing a transfer (and its command overhead) each time. A read continuing the
+ * previous one is detected as sequential: its miss also reads ahead the following blocks, by the same transfer.
+ * Reads larger than MAX_RUN_LENGTH sectors (whole clusters read into the file buffers) go directly to the device,
+ * not to evict the metadata.
+ *
+ * The cache is write-back (without FF_FS_READONLY): the written sectors are only copied here, then written to the
+ * device by sync() sorted by sector and merged into runs of contiguous sectors, each run by a single multiple
+ * blocks transfer. A sector written several times meanwhile is written once. The cache is synced when a dirty
+ * block is evicted, and by CTRL_SYNC (see FileSystem::sync()).
+ *
+ * All the calls are done with the kernel lock held, as the FatFs ones.
+ */
+class BlockCache {
+ public:
+  using ReadFunction = bool (*)(LBA_t sector, void* buffer, size_t count);
+  using WriteFunction = bool (*)(LBA_t sector, const void* buffer, size_t count);
+  using SectorCountFunction = LBA_t (*)();
+
+  static constexpr size_t SECTOR_SIZE = FF_MIN_SS;
+  static constexpr size_t BLOCK_SIZE = PAGE_SIZE;
+  static constexpr size_t SECTORS_PER_BLOCK = BLOCK_SIZE / SECTOR_SIZE;
+  /** The count of cached blocks (256 KiB). */
+  static constexpr size_t CAPACITY = 64;
+  /** The longest run of sectors transferred at once (read ahead or written), and the largest cached read. */
+  static constexpr size_t MAX_RUN_LENGTH = 64;
+  static constexpr size_t MAX_READAHEAD_BLOCKS = MAX_RUN_LENGTH / SECTORS_PER_BLOCK;
+
+  struct Stats {
+    // The sectors read by FatFs found in the cache, and those read from the device on demand.
+    uint64_t nb_hits;
+    uint64_t nb_misses;
+    // The sectors read ahead of a sequential read, and those of the large reads not cached.
+    uint64_t nb_readahead_sectors;
+    uint64_t nb_uncached_sectors;
+    // The transfers with the device, and the sectors written.
+    uint64_t nb_device_reads;
+    uint64_t nb_device_writes;
+    uint64_t nb_written_sectors;
+    uint64_t nb_evictions;
+  };  // struct Stats
+
+  BlockCache(ReadFunction read, WriteFunction write, SectorCountFunction get_sector_count)
+      : m_read(read), m_write(write), m_get_sector_count(get_sector_count) {}
+  ~BlockCache();
+
+  /** Reads @a count sectors from @a sector into @a buffer, from the cache and the device. */
+  [[nodiscard]] bool read(LBA_t sector, void* buffer, size_t count);
+  /** Caches the @a count sectors of @a buffer to be written at @a sector. */
+  [[nodiscard]] bool write(LBA_t sector, const void* buffer, size_t count);
+
+  /** Writes all the dirty sectors to the device. They are clean afterwards even if a write fails (returns false). */
+  bool sync();
+  /** Evicts the least recently used clean blocks until @a byte_size bytes are freed (or none is left). Returns the
+   * count of bytes freed, see MemoryPressure::Shrinker. */
+  size_t shrink(size_t byte_size);
+
+  [[nodiscard]] size_t get_dirty_count() const { return m_nb_dirty_sectors; }
+  [[nodiscard]] const Stats& get_stats() const { return m_stats; }
+
+ private:
+  using SectorMask = uint8_t;
+  static_assert(SECTORS_PER_BLOCK <= 8 * sizeof(SectorMask));
+
+  struct Block {
+    libk::IntrusiveListHook hook;
+    LBA_t first_sector;     // a multiple of SECTORS_PER_BLOCK
+    SectorMask valid_mask;  // the sectors cached, a partially written block is not read from the device
+    SectorMask dirty_mask;  // the sectors written but not yet synced, all of them valid
+    uint8_t* data;          // BLOCK_SIZE bytes, freed by shrink()
+  };  // struct Block
+
+  /** Returns a mask of the sectors [@a first, @a first + @a count) of a block. */
+  [[nodiscard]] static SectorMask get_mask(size_t first, size_t count) {
+    return (SectorMask)(((1u << count) - 1) << first);
+  }
+
+  [[nodiscard]] Block* find(LBA_t first_sector);
+  /** Gets an empty block (evicting the least recently used one) for the sectors at @a first_sector. Returns nullptr
+   * if out of memory, or if the sync of the evicted block failed (@a has_failed is then true). */
+  [[nodiscard]] Block* insert(LBA_t first_sector, bool* has_failed);
+  void evict(Block* block);
+  /** Marks @a block as the most recently used. */
+  void touch(Block* block);
+
+  /** Reads the missing sectors of @a block and, if @a readahead_count > 0, of as many following uncached blocks
+   * by the same transfer. */
+  [[nodiscard]] bool fill(Block* block, size_t readahead_count);
+  /** Reads the sectors directly from the device, then copies over them the cached ones newer than the device ones. */
+  [[nodiscard]] bool read_uncached(LBA_t sector, void* buffer, size_t count);
+  /** Copies @a buffer, written directly to the device at @a sector, over the cached copies of its sectors. */
+  void update_cached_sectors(LBA_t sector, const void* buffer, size_t count);
+
+  ReadFunction m_read;
+  WriteFunction m_write;
+  SectorCountFunction m_get_sector_count;
+  uint8_t* m_staging = nullptr;  // MAX_RUN_LENGTH sectors, the run being read ahead or written
+  Block m_blocks[CAPACITY] = {};
+  size_t m_nb_blocks = 0;  // the blocks of m_blocks used at least once
+  size_t m_nb_dirty_sectors = 0;
+  // The cached blocks, the most recently used first, and the blocks freed by shrink().
+  libk::IntrusiveList<Block, &Block::hook> m_lru;
+  libk::IntrusiveList<Block, &Block::hook> m_free_blocks;
+  libk::HashTable<LBA_t, Block*> m_index;  // the block of each cached first sector
+  // The sector following the previous read, to detect the sequential reads.
+  LBA_t m_next_sector = 0;
+  Stats m_stats = {};
+};  // class BlockCache
+
+/** Gets the cache of the drive @a drive, or nullptr if it is not cached (the ramdisk, already in memory). */
+[[nodiscard]] BlockCache* get_block_cache(BYTE drive);
@@ -0,0 +1,104 @@
+#include "ff.h" /* Obtains integer types */
+
+#include "diskio.h" /* Declarations of disk functions */
+
+#include "block_cache.hpp"
+#include "hardware/sd_card.hpp"
+#include "ramdisk.hpp"
+
+// The SD card sectors are cached, the ramdisk ones are already in memory.
+static BlockCache g_sd_card_cache(
+    [](LBA_t sector, void* buffer, size_t count) { return SDCard::read_blocks(sector, buffer, count); },
+    [](LBA_t sector, const void* buffer, size_t count) { return SDCard::write_blocks(sector, buffer, count); },
+    []() { return (LBA_t)SDCard::get_block_count(); });
+
+BlockCache* get_block_cache(BYTE drive) {
+  return drive == SD_CARD_DRIVE ? &g_sd_card_cache : nullptr;
+}
+
+extern "C" {
+DSTATUS disk_status(BYTE drive) {
+  switch (drive) {
+    case RAM_FS_DRIVE:
+      return ramdisk_is_initialized() ? 0 : STA_NOINIT;
+    case SD_CARD_DRIVE:
+      return SDCard::is_initialized() ? 0 : STA_NOINIT;
+    default:
+      return STA_NOINIT;
+  }
+}
+
+DSTATUS disk_initialize(BYTE drive) {
+  switch (drive) {
+    case RAM_FS_DRIVE:
+      return ramdisk_initialize() ? 0 : STA_NOINIT;
+    case SD_CARD_DRIVE:
+      return SDCard::init() ? 0 : (STA_NOINIT | STA_NODISK);
+    default:
+      return STA_NOINIT;
+  }
+}
+
+DRESULT disk_read(BYTE drive, BYTE* buff, LBA_t sector, UINT count) {
+  switch (drive) {
+    case RAM_FS_DRIVE:
+      if (!ramdisk_is_initialized())
+        return RES_NOTRDY;
+      ramdisk_read(buff, sector, count);
+      return RES_OK;
+    case SD_CARD_DRIVE:
+      if (!SDCard::is_initialized())
+        return RES_NOTRDY;
+      return g_sd_card_cache.read(sector, buff, count) ? RES_OK : RES_ERROR;
+    default:
+      return RES_NOTRDY;
+  }
+}
+
+#if FF_FS_READONLY == 0
+
+DRESULT disk_write(BYTE drive, const BYTE* buff, LBA_t sector, UINT count) {
+  switch (drive) {
+    case RAM_FS_DRIVE:
+      if (!ramdisk_is_initialized())
+        return RES_NOTRDY;
+      ramdisk_write(buff, sector, count);
+      return RES_OK;
+    case SD_CARD_DRIVE:
+      if (!SDCard::is_initialized())
+        return RES_NOTRDY;
+      return g_sd_card_cache.write(sector, buff, count) ? RES_OK : RES_ERROR;
+    default:
+      return RES_NOTRDY;
+  }
+}
+
+#endif
+
+DRESULT disk_ioctl(BYTE drive, BYTE cmd, void* buff) {
+  if (disk_status(drive) != 0)
+    return RES_NOTRDY;
+
+  switch (cmd) {
+    case CTRL_SYNC:
+#if FF_FS_READONLY == 0
+      if (drive == SD_CARD_DRIVE)
+        return g_sd_card_cache.sync() ? RES_OK : RES_ERROR;
+#endif
+      return RES_OK;  // nothing to sync, the ramdisk writes are done synchronously
+    case GET_SECTOR_COUNT:
+      *(LBA_t*)buff = (drive == SD_CARD_DRIVE) ? (LBA_t)SDCard::get_block_count() : ramdisk_get_sector_count();
+      return RES_OK;
+    case GET_SECTOR_SIZE:
+      *(WORD*)buff = FF_MIN_SS;
+      return RES_OK;
+    case GET_BLOCK_SIZE:
+      *(DWORD*)buff = 1;
+      return RES_OK;
+    case CTRL_TRIM:
+      return RES_OK;  // not supported nor needed
+    default:
+      return RES_PARERR;
+  }
+}
+}
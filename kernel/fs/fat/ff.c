@@ -1284,6 +1284,15 @@ static FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 			fs->wflag = 1;
 			break;
 		}
+#if FF_USE_FREE_BITMAP
+		if (res == FR_OK && fs->fbmp && fs->fs_type != FS_EXFAT) {	/* Keep the free cluster bitmap in sync */
+			if (val == 0) {
+				fs->fbmp[clst / 32] |= (DWORD)1 << (clst % 32);
+			} else {
+				fs->fbmp[clst / 32] &= ~((DWORD)1 << (clst % 32));
+			}
+		}
+#endif
 	}
 	return res;
 }
@@ -1293,6 +1302,84 @@ static FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 
 
 
+#if FF_USE_FREE_BITMAP && !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* FAT12/16/32: Free cluster bitmap                                      */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT load_free_bitmap (	/* FR_OK(0):succeeded, !=0:error */
+	FATFS* fs		/* Filesystem object (not exFAT) */
+)
+{
+	FFOBJID obj;
+	DWORD clst, stat, nfree = 0;
+	UINT nw = (UINT)((fs->n_fatent + 31) / 32);
+	DWORD *bmp = ff_memalloc(nw * sizeof (DWORD));
+
+
+	if (!bmp) return FR_NOT_ENOUGH_CORE;
+	memset(bmp, 0, nw * sizeof (DWORD));
+	obj.fs = fs;
+	for (clst = 2; clst < fs->n_fatent; clst++) {	/* A single pass over the FAT, sector by sector in the window */
+		stat = get_fat(&obj, clst);
+		if (stat == 1 || stat == 0xFFFFFFFF) {
+			ff_memfree(bmp);
+			return stat == 1 ? FR_INT_ERR : FR_DISK_ERR;
+		}
+		if (stat == 0) {
+			bmp[clst / 32] |= (DWORD)1 << (clst % 32);
+			nfree++;
+		}
+	}
+	fs->fbmp = bmp;
+	fs->free_clst = nfree;		/* Now known, even without FSINFO */
+	fs->fsi_flag |= 1;
+	return FR_OK;
+}
+
+
+static DWORD find_free_cluster (	/* 0:No free cluster, >=2:Free cluster# */
+	FATFS* fs,		/* Filesystem object with a free cluster bitmap */
+	DWORD scl		/* Cluster to start to find after, wrapping around to it */
+)
+{
+	DWORD clst = scl + 1, end = fs->n_fatent, w;
+	int pass;
+
+
+	for (pass = 0; pass < 2; pass++) {
+		while (clst < end) {
+			w = fs->fbmp[clst / 32] >> (clst % 32);
+			if (w == 0) {	/* No free cluster left in this word */
+				clst = (clst / 32 + 1) * 32;
+				continue;
+			}
+			while (!(w & 1)) {
+				w >>= 1; clst++;
+			}
+			return clst < end ? clst : 0;	/* The bits past the last cluster are never set */
+		}
+		clst = 2; end = scl + 1 < fs->n_fatent ? scl + 1 : fs->n_fatent;	/* Wrap around */
+	}
+	return 0;
+}
+
+
+static void discard_free_bitmap (
+	FATFS* fs		/* Filesystem object */
+)
+{
+	if (fs->fbmp) {
+		ff_memfree(fs->fbmp);
+		fs->fbmp = 0;
+	}
+}
+
+#endif /* FF_USE_FREE_BITMAP && !FF_FS_READONLY */
+
+
+
+
 #if FF_FS_EXFAT && !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* exFAT: Accessing FAT and Allocation Bitmap                            */
@@ -1585,8 +1672,18 @@ static DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:D
 			}
 		}
 		if (ncl == 0) {	/* The new cluster cannot be contiguous and find another fragment */
-			ncl = scl;	/* Start cluster */
-			for (;;) {
+#if FF_USE_FREE_BITMAP
+			if (!fs->fbmp) {	/* Built at the first allocation, the FAT is scanned below if out of memory */
+				res = load_free_bitmap(fs);
+				if (res == FR_INT_ERR) return 1;
+				if (res == FR_DISK_ERR) return 0xFFFFFFFF;
+			}
+			if (fs->fbmp) {
+				ncl = find_free_cluster(fs, scl);
+				if (ncl == 0) return 0;		/* No free cluster found? */
+			} else
+#endif
+			for (ncl = scl;;) {	/* Start cluster */
 				ncl++;							/* Next cluster */
 				if (ncl >= fs->n_fatent) {		/* Check wrap-around */
 					ncl = 2;
@@ -3426,6 +3523,9 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 	/* Following code attempts to mount the volume. (find an FAT volume, analyze the BPB and initialize the filesystem object) */
 
 	fs->fs_type = 0;					/* Invalidate the filesystem object */
+#if FF_USE_FREE_BITMAP && !FF_FS_READONLY
+	discard_free_bitmap(fs);			/* Built again for the new volume */
+#endif
 	stat = disk_initialize(fs->pdrv);	/* Initialize the volume hosting physical drive */
 	if (stat & STA_NOINIT) { 			/* Check if the initialization succeeded */
 		return FR_NOT_READY;			/* Failed to initialize due to no medium or hard error */
@@ -3681,6 +3781,9 @@ FRESULT f_mount (
 		ff_mutex_delete(vol);
 #endif
 		cfs->fs_type = 0;		/* Invalidate the filesystem object to be unregistered */
+#if FF_USE_FREE_BITMAP && !FF_FS_READONLY
+		discard_free_bitmap(cfs);
+#endif
 	}
 
 	if (fs) {					/* Register new filesystem object */
@@ -3699,6 +3802,9 @@ FRESULT f_mount (
 #endif
 #endif
 		fs->fs_type = 0;		/* Invalidate the new filesystem object */
+#if FF_USE_FREE_BITMAP && !FF_FS_READONLY
+		fs->fbmp = 0;			/* Not built yet */
+#endif
 		FatFs[vol] = fs;		/* Register new fs object */
 	}
 
@@ -142,6 +142,9 @@ typedef struct {
 #if !FF_FS_READONLY
   DWORD last_clst; /* Last allocated cluster */
   DWORD free_clst; /* Number of free clusters */
+#if FF_USE_FREE_BITMAP
+  DWORD* fbmp; /* Free cluster bitmap (a set bit per free cluster), 0 until the first allocation */
+#endif
 #endif
 #if FF_FS_RPATH
   DWORD cdir; /* Current directory start cluster (0:root) */
@@ -8,11 +8,23 @@
 / Function Configurations
 /---------------------------------------------------------------------------*/
 
+#ifdef CONFIG_WRITABLE_FS
+#define FF_FS_READONLY 0
+#else
 #define FF_FS_READONLY 1
+#endif  // CONFIG_WRITABLE_FS
 /* This option switches read-only configuration. (0:Read/Write or 1:Read-only)
 /  Read-only configuration removes writing API functions, f_write(), f_sync(),
 /  f_unlink(), f_mkdir(), f_chmod(), f_rename(), f_truncate(), f_getfree()
-/  and optional writing functions as well. */
+/  and optional writing functions as well.
+/  The volumes are writable with CONFIG_WRITABLE_FS only, the kernel caches the
+/  lookups and maps the files in place otherwise (see DentryCache and PageCache). */
+
+#define FF_USE_FREE_BITMAP 1
+/* This option (added to FatFs) switches the in-memory free cluster bitmap of the
+/  FAT12/16/32 volumes, built by a single FAT scan at the first allocation after
+/  mount. The clusters are then allocated without reading the FAT to find free
+/  ones. It has no effect in read-only configuration. (0:Disable or 1:Enable) */
 
 #define FF_FS_MINIMIZE 0
 /* This option defines minimization level to remove some basic API functions.
@@ -30,7 +42,7 @@
 #define FF_USE_MKFS 0
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
-#define FF_USE_FASTSEEK 0
+#define FF_USE_FASTSEEK 1
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 #define FF_USE_EXPAND 0
@@ -151,7 +163,7 @@
 / Drive/Volume Configurations
 /---------------------------------------------------------------------------*/
 
-#define FF_VOLUMES 1
+#define FF_VOLUMES 2
 /* Number of volumes (logical drives) to be used. (1-10) */
 
 #define FF_STR_VOLUME_ID 0
@@ -247,7 +259,7 @@
 /      can be opened simultaneously under file lock control. Note that the file
 /      lock control is independent of re-entrancy. */
 
-#define FF_FS_REENTRANT 0
+#define FF_FS_REENTRANT 1
 #define FF_FS_TIMEOUT 1000
 /* The option FF_FS_REENTRANT switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
@@ -1,5 +1,6 @@
 #include "ff.h"
 
+#include "hardware/kernel_lock.hpp"
 #include "memory/mem_alloc.hpp"
 
 extern "C" {
@@ -10,4 +11,30 @@ void* ff_memalloc(UINT byte_count) {
 void ff_memfree(void* ptr) {
   kfree(ptr);
 }
+
+#if FF_FS_REENTRANT
+// The sync objects of all the volumes (and of the system, vol == FF_VOLUMES) are the big kernel lock.
+// FatFs can not use the sleeping primitives of sync.hpp: tasks are only switched at exception return,
+// not in the middle of a FatFs call. As the lock is recursive, the FatFs calls done by the system calls
+// and the kernel tasks, which already hold it, take it again without waiting.
+int ff_mutex_create(int vol) {
+  (void)vol;
+  return 1;
+}
+
+void ff_mutex_delete(int vol) {
+  (void)vol;
+}
+
+int ff_mutex_take(int vol) {
+  (void)vol;
+  KernelLock::acquire();
+  return 1;
+}
+
+void ff_mutex_give(int vol) {
+  (void)vol;
+  KernelLock::release();
+}
+#endif  // FF_FS_REENTRANT
 }
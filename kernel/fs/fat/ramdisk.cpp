@@ -1,77 +1,229 @@
 #include "ff.h" /* Obtains integer types */
 
-#include "diskio.h" /* Declarations of disk functions */
-
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include <libk/lz4.hpp>
 #include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "memory/buffer.hpp"
+#include "memory/kernel_internal_memory.hpp"
 #include "memory/memory.hpp"
 #include "ramdisk.hpp"
+#include "task/task.hpp"
+
+#ifdef CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
+#include "hardware/smp.hpp"
+#include "task/task_manager.hpp"
+#endif  // CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
 
 static uint8_t* ramdisk_buffer = nullptr;
+static size_t ramdisk_byte_size = 0;
+static PhysicalPA ramdisk_physical_address = 0;
+
+/*
+ * The compressed image, if any (see RamdiskCompressedHeader).
+ */
+
+enum BlockState : uint8_t {
+  BLOCK_COMPRESSED = 0,
+  BLOCK_DECOMPRESSING = 1,  // by a task with the preemption disabled, never for long
+  BLOCK_READY = 2,
+};  // enum BlockState
+
+static const uint8_t* ramdisk_image = nullptr;
+static const uint32_t* ramdisk_block_offsets = nullptr;  // inside the image, block_count + 1 of them
+static size_t ramdisk_block_count = 0;
+static uint8_t* ramdisk_block_states = nullptr;  // a BlockState per block, claimed under the kernel lock
+#ifdef CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
+static size_t ramdisk_next_block = 0;  // the next block to decompress by the background tasks
+#endif  // CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
 
-extern "C" {
-DSTATUS disk_status(BYTE drive) {
-  switch (drive) {
-    case 0:
-      return 0;
-    default:
-      return STA_NOINIT;
+static bool load_compressed_image(const uint8_t* image) {
+  const auto* header = (const RamdiskCompressedHeader*)image;
+  if (header->block_size != RAMDISK_BLOCK_SIZE || header->disk_size == 0 || header->disk_size > UINT32_MAX ||
+      header->disk_size % FF_MIN_SS != 0 ||
+      header->block_count != libk::div_round_up(header->disk_size, RAMDISK_BLOCK_SIZE)) {
+    LOG_ERROR("Invalid compressed ramdisk header");
+    return false;
   }
+
+  // The offsets must be increasing and inside the reserved memory, they are then trusted.
+  const auto* offsets = (const uint32_t*)(image + sizeof(RamdiskCompressedHeader));
+  const size_t index_end = sizeof(RamdiskCompressedHeader) + sizeof(uint32_t) * (header->block_count + 1);
+  if (index_end > RAM_FS_BYTE_SIZE || offsets[0] < index_end || offsets[header->block_count] > RAM_FS_BYTE_SIZE) {
+    LOG_ERROR("Invalid compressed ramdisk index");
+    return false;
+  }
+  for (size_t i = 0; i < header->block_count; ++i) {
+    if (offsets[i] > offsets[i + 1]) {
+      LOG_ERROR("Invalid compressed ramdisk index");
+      return false;
+    }
+  }
+
+  ramdisk_block_states = new uint8_t[header->block_count];
+  if (ramdisk_block_states == nullptr)
+    return false;
+  libk::bzero(ramdisk_block_states, header->block_count);
+
+  // The disk is given to the page cache (see ramdisk_get_physical_address()), so it never moves.
+  auto* disk = new Buffer(header->disk_size);
+  disk->pin();
+
+  ramdisk_image = image;
+  ramdisk_block_offsets = offsets;
+  ramdisk_block_count = header->block_count;
+  ramdisk_byte_size = header->disk_size;
+  ramdisk_buffer = (uint8_t*)disk->get();
+  ramdisk_physical_address = memory_impl::resolve_kernel_va((VirtualAddress)ramdisk_buffer, false);
+
+  LOG_INFO("Compressed ramdisk: {} KiB decompressed from {} KiB", ramdisk_byte_size / 1024,
+           offsets[header->block_count] / 1024);
+  return true;
 }
 
-DSTATUS disk_initialize(BYTE drive) {
-  switch (drive) {
-    case 0:
-      ramdisk_buffer = (uint8_t*)KernelMemory::get_fs_address();
-      if (ramdisk_buffer == nullptr)
-        return STA_NOINIT;
-      return 0;
-    default:
-      return STA_NOINIT;
+/** Claims the block @a index for its decompression if it is still compressed. Returns its state before. */
+static uint8_t claim_block(size_t index) {
+  // Claimed under the kernel lock, the decompression itself runs without it.
+  KernelLockGuard kernel_lock;
+  const uint8_t state = __atomic_load_n(&ramdisk_block_states[index], __ATOMIC_ACQUIRE);
+  if (state == BLOCK_COMPRESSED)
+    __atomic_store_n(&ramdisk_block_states[index], BLOCK_DECOMPRESSING, __ATOMIC_RELAXED);
+  return state;
+}
+
+/** Decompresses the block @a index, if not done or being done by another task. Returns false in the latter case. */
+static bool try_decompress_block(size_t index) {
+  // Disabled first: the other tasks wait for the claimed blocks, so the claimer must not be switched out.
+  Task::current()->disable_preempt();
+
+  const uint8_t state = claim_block(index);
+  if (state != BLOCK_COMPRESSED) {
+    Task::current()->enable_preempt();
+    return state == BLOCK_READY;
   }
+
+  const size_t offset = index * RAMDISK_BLOCK_SIZE;
+  const size_t size = libk::min(RAMDISK_BLOCK_SIZE, ramdisk_byte_size - offset);
+  const uint8_t* src = ramdisk_image + ramdisk_block_offsets[index];
+  const size_t src_size = ramdisk_block_offsets[index + 1] - ramdisk_block_offsets[index];
+  if (src_size == size) {
+    libk::memcpy_large(ramdisk_buffer + offset, src, size);  // stored as is, it did not compress
+  } else if (!libk::lz4_decompress(src, src_size, ramdisk_buffer + offset, size)) {
+    LOG_ERROR("Corrupted block {} of the compressed ramdisk", index);
+    libk::bzero(ramdisk_buffer + offset, size);
+  }
+
+  __atomic_store_n(&ramdisk_block_states[index], BLOCK_READY, __ATOMIC_RELEASE);
+  Task::current()->enable_preempt();
+  return true;
 }
 
-DRESULT disk_read(BYTE drive, BYTE* buff, LBA_t sector, UINT count) {
-  if (drive != 0 || ramdisk_buffer == nullptr)
-    return RES_NOTRDY;
+/** Ensures the @a byte_size bytes at @a offset of the disk are decompressed. */
+static void decompress_range(size_t offset, size_t byte_size) {
+  if (ramdisk_block_states == nullptr || byte_size == 0)
+    return;
 
-  libk::memcpy(buff, &ramdisk_buffer[sector * FF_MIN_SS], (size_t)count * FF_MIN_SS);
-  return RES_OK;
+  const size_t last = (offset + byte_size - 1) / RAMDISK_BLOCK_SIZE;
+  for (size_t i = offset / RAMDISK_BLOCK_SIZE; i <= last; ++i) {
+    // Another task decompresses the block on another core (it cannot be switched out meanwhile).
+    while (!try_decompress_block(i))
+      libk::yield();
+  }
 }
 
-#if FF_FS_READONLY == 0
+#ifdef CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
+static void decompress_in_background() {
+  while (true) {
+    size_t index;
+    {
+      KernelTaskLockGuard kernel_lock;
+      index = ramdisk_next_block++;
+    }
 
-DRESULT disk_write(BYTE drive, const BYTE* buff, LBA_t sector, UINT count) {
-  if (drive != 0 || ramdisk_buffer == nullptr)
-    return RES_NOTRDY;
+    if (index >= ramdisk_block_count)
+      return;
 
-  libk::memcpy(&ramdisk_buffer[sector * FF_MIN_SS], buff, (size_t)count * FF_MIN_SS);
-  return RES_OK;
+    // Skipped if already claimed by a reader.
+    try_decompress_block(index);
+  }
 }
+#endif  // CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
 
-#endif
+bool ramdisk_initialize() {
+  auto* image = (const uint8_t*)KernelMemory::get_fs_address();
+  if (image == nullptr)
+    return false;
 
-DRESULT disk_ioctl(BYTE drive, BYTE cmd, void* buff) {
-  if (drive != 0 || ramdisk_buffer == nullptr)
-    return RES_NOTRDY;
+  if (libk::memcmp(image, RAMDISK_COMPRESSED_MAGIC, sizeof(RAMDISK_COMPRESSED_MAGIC)) != 0) {
+    ramdisk_buffer = (uint8_t*)image;
+    ramdisk_byte_size = RAM_FS_BYTE_SIZE;
+    ramdisk_physical_address = RAM_FS_PHYSICAL_LOAD_ADDRESS;
+    return true;
+  }
 
-  switch (cmd) {
-    case CTRL_SYNC:
-      return RES_OK;  // nothing to sync
-    case GET_SECTOR_COUNT:
-      *(LBA_t*)buff = RAM_FS_SECTOR_COUNT;
-      break;
-    case GET_SECTOR_SIZE:
-      *(WORD*)buff = FF_MIN_SS;
+  if (!load_compressed_image(image))
+    return false;
+
+#ifdef CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
+  // A task per core, they run while the boot goes on (the blocks read meanwhile are decompressed by the readers).
+  for (size_t i = 0; i < SMP::get_online_cores_count(); ++i) {
+    auto task = TaskManager::get().create_kernel_task(&decompress_in_background);
+    if (task == nullptr)
       break;
-    case GET_BLOCK_SIZE:
-      *(DWORD*)buff = 1;
-      return RES_OK;
-    case CTRL_TRIM:
-      return RES_OK;  // not a flash memory device (not supported nor needed)
-    default:
-      return RES_PARERR;
+
+    task->set_name("ramdisk_lz4");
+    TaskManager::get().wake_task(task);
   }
+#endif  // CONFIG_RAMDISK_PARALLEL_DECOMPRESSION
+  return true;
+}
+
+bool ramdisk_is_initialized() {
+  return ramdisk_buffer != nullptr;
+}
+
+LBA_t ramdisk_get_sector_count() {
+  // Before the initialization, the size of an uncompressed image.
+  return (ramdisk_buffer != nullptr ? ramdisk_byte_size : RAM_FS_BYTE_SIZE) / FF_MIN_SS;
+}
+
+void ramdisk_read(BYTE* buff, LBA_t sector, UINT count) {
+  decompress_range(sector * FF_MIN_SS, (size_t)count * FF_MIN_SS);
+  libk::memcpy_large(buff, &ramdisk_buffer[sector * FF_MIN_SS], (size_t)count * FF_MIN_SS);
+}
 
-  return RES_PARERR;
+void ramdisk_write(const BYTE* buff, LBA_t sector, UINT count) {
+  // The whole blocks are decompressed first, or they would overwrite the written sectors later.
+  decompress_range(sector * FF_MIN_SS, (size_t)count * FF_MIN_SS);
+  libk::memcpy_large(&ramdisk_buffer[sector * FF_MIN_SS], buff, (size_t)count * FF_MIN_SS);
 }
+
+const void* ramdisk_get_file_address(FIL* file) {
+  if (ramdisk_buffer == nullptr || file->obj.fs->pdrv != RAM_FS_DRIVE || file->obj.sclust == 0)
+    return nullptr;
+
+  // Build the file cluster link map: a contiguous file has a single fragment, stored as
+  // {table size, cluster count, first cluster, 0}. FatFs fails if more fragments are needed.
+  DWORD link_map[4] = {4};
+  file->cltbl = link_map;
+  const FRESULT result = f_lseek(file, CREATE_LINKMAP);
+  file->cltbl = nullptr;
+  if (result != FR_OK)
+    return nullptr;
+
+  const FATFS* fs = file->obj.fs;
+  const LBA_t sector = fs->database + (LBA_t)fs->csize * (link_map[2] - 2);
+  if ((sector * FF_MIN_SS) + f_size(file) > ramdisk_byte_size)
+    return nullptr;
+
+  // The content is read in place from now on, through the page cache mappings as well.
+  decompress_range(sector * FF_MIN_SS, f_size(file));
+  return &ramdisk_buffer[sector * FF_MIN_SS];
+}
+
+PhysicalPA ramdisk_get_physical_address(const void* address) {
+  KASSERT(address >= ramdisk_buffer && address < ramdisk_buffer + ramdisk_byte_size);
+  return ramdisk_physical_address + ((const uint8_t*)address - ramdisk_buffer);
 }
@@ -1,7 +1,48 @@
 #pragma once
 
+#include "ff.h"
 #include "ffconf.h"
+#include "memory/memory.hpp"
 
 inline static constexpr PhysicalPA RAM_FS_PHYSICAL_LOAD_ADDRESS = 0x18000000;
 inline static constexpr size_t RAM_FS_BYTE_SIZE = 0xa00000;  // 10 Mio (Must be a multiple of PAGE_SIZE)
 inline static constexpr size_t RAM_FS_SECTOR_COUNT = RAM_FS_BYTE_SIZE / FF_MIN_SS;
+
+/** The FatFs drives, the ramdisk is the root volume ("/") and the SD card (if any) is "1:/". */
+inline static constexpr BYTE RAM_FS_DRIVE = 0;
+inline static constexpr BYTE SD_CARD_DRIVE = 1;
+
+/**
+ * The image loaded by the firmware may be compressed (see `mkfatimg -z`), the firmware then loads less bytes. It
+ * starts with a RamdiskCompressedHeader, followed by the offsets of the blocks inside the image (block_count + 1 of
+ * them, the last one being the image end) and the blocks. Each block is RAMDISK_BLOCK_SIZE bytes once decompressed
+ * (the last one may be shorter), and is stored either as a LZ4 block or as is if it has its decompressed size.
+ *
+ * The disk is then decompressed in the kernel memory, block by block when first read. With
+ * CONFIG_RAMDISK_PARALLEL_DECOMPRESSION, kernel tasks decompress all the blocks in the background as well, spread
+ * over the cores.
+ */
+struct RamdiskCompressedHeader {
+  char magic[8];  // RAMDISK_COMPRESSED_MAGIC
+  uint32_t block_size;
+  uint32_t block_count;
+  uint64_t disk_size;  // in bytes, once decompressed
+};  // struct RamdiskCompressedHeader
+
+inline static constexpr char RAMDISK_COMPRESSED_MAGIC[8] = {'P', 'K', 'L', 'Z', '4', 'F', 'S', '\0'};
+/** The decompressed size of the blocks, at most LZ4_MAX_INPUT_SIZE (keep in sync with tools/mkfatimg). */
+inline static constexpr size_t RAMDISK_BLOCK_SIZE = 32 * 1024;
+
+/** The ramdisk block device, used by the FatFs disk functions (see diskio.cpp). */
+bool ramdisk_initialize();
+[[nodiscard]] bool ramdisk_is_initialized();
+/** Gets the count of sectors of the disk (decompressed). */
+[[nodiscard]] LBA_t ramdisk_get_sector_count();
+void ramdisk_read(BYTE* buff, LBA_t sector, UINT count);
+void ramdisk_write(const BYTE* buff, LBA_t sector, UINT count);
+
+/** Gets the address of the content of the opened @a file inside the ramdisk, so it can be read without
+ * any copy. Returns nullptr if the file is empty or not stored contiguously. */
+const void* ramdisk_get_file_address(FIL* file);
+/** Gets the physical address of @a address, inside the ramdisk. */
+[[nodiscard]] PhysicalPA ramdisk_get_physical_address(const void* address);
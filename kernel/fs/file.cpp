@@ -1,6 +1,37 @@
 #include "file.hpp"
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "memory/mem_alloc.hpp"
+
+File::~File() {
+  kfree(m_generated_data);
+#if FF_USE_FASTSEEK
+  delete[] m_link_map;
+#endif  // FF_USE_FASTSEEK
+#if !FF_FS_READONLY
+  delete[] m_write_buffer;
+#endif  // !FF_FS_READONLY
+}
 
 bool File::read(void* buffer, size_t bytes_to_read, size_t* read_bytes) {
+  if (m_data != nullptr) {
+    // Same checks and result as f_read().
+    if (read_bytes != nullptr)
+      *read_bytes = 0;
+    if ((m_handle.flag & FA_READ) == 0)
+      return false;
+
+    const size_t count = libk::min<size_t>(bytes_to_read, f_size(&m_handle) - m_handle.fptr);
+    libk::memcpy_large(buffer, m_data + m_handle.fptr, count);
+    m_handle.fptr += count;
+    if (read_bytes != nullptr)
+      *read_bytes = count;
+    return true;
+  }
+
+  if (!flush())
+    return false;
+
   UINT read_bytes_bis;
   auto result = f_read(&m_handle, buffer, bytes_to_read, &read_bytes_bis);
   if (read_bytes != nullptr)
@@ -10,11 +41,34 @@ bool File::read(void* buffer, size_t bytes_to_read, size_t* read_bytes) {
 
 bool File::write(const void* buffer, size_t bytes_to_write, size_t* wrote_bytes) {
 #if !FF_FS_READONLY
-  UINT wrote_bytes_bis;
-  auto result = f_write(&m_handle, buffer, bytes_to_write, &wrote_bytes_bis);
   if (wrote_bytes != nullptr)
-    *wrote_bytes = wrote_bytes_bis;
-  return result == FR_OK;
+    *wrote_bytes = 0;
+  if ((m_handle.flag & FA_WRITE) == 0 || is_generated())
+    return false;
+
+  m_is_written = true;
+  if (m_write_buffer == nullptr)
+    m_write_buffer = new uint8_t[WRITE_BUFFER_SIZE];
+
+  // The large writes go straight to FatFs, after the buffered ones.
+  if (m_write_buffer == nullptr || m_buffered_size + bytes_to_write > WRITE_BUFFER_SIZE) {
+    if (!flush())
+      return false;
+
+    if (m_write_buffer == nullptr || bytes_to_write >= WRITE_BUFFER_SIZE) {
+      UINT wrote_bytes_bis;
+      auto result = f_write(&m_handle, buffer, bytes_to_write, &wrote_bytes_bis);
+      if (wrote_bytes != nullptr)
+        *wrote_bytes = wrote_bytes_bis;
+      return result == FR_OK;
+    }
+  }
+
+  libk::memcpy(m_write_buffer + m_buffered_size, buffer, bytes_to_write);
+  m_buffered_size += bytes_to_write;
+  if (wrote_bytes != nullptr)
+    *wrote_bytes = bytes_to_write;
+  return true;
 #else
   (void)buffer;
   (void)bytes_to_write;
@@ -23,12 +77,67 @@ bool File::write(const void* buffer, size_t bytes_to_write, size_t* wrote_bytes)
 #endif
 }
 
+bool File::flush() {
+#if !FF_FS_READONLY
+  if (m_buffered_size == 0)
+    return true;
+
+  UINT wrote_bytes;
+  const auto result = f_write(&m_handle, m_write_buffer, m_buffered_size, &wrote_bytes);
+  const bool success = result == FR_OK && wrote_bytes == m_buffered_size;
+  m_buffered_size = 0;  // dropped on failure as well (the volume is full), as f_write() does
+  return success;
+#else
+  return true;
+#endif
+}
+
 bool File::seek(long long int offset) {
+  if (!flush())
+    return false;
+
+  if (m_data != nullptr) {
+    // As f_lseek(), the offset is clamped to the file size (read-only file).
+    m_handle.fptr = libk::min<FSIZE_t>(offset, f_size(&m_handle));
+    return true;
+  }
+
+#if FF_USE_FASTSEEK
+  // FatFs can not extend the files seeked with a link map, the written ones keep following their FAT chain.
+  if (!m_has_link_map && (m_handle.flag & FA_WRITE) == 0) {
+    m_has_link_map = true;
+
+    // Try with a map of a single fragment first, FatFs then gives the needed size. If the map can not be built,
+    // seeking falls back to following the FAT chain from the start.
+    DWORD small_link_map[4] = {4};
+    m_handle.cltbl = small_link_map;
+    FRESULT result = f_lseek(&m_handle, CREATE_LINKMAP);
+    if (result == FR_OK) {
+      m_link_map = new DWORD[4];
+      libk::memcpy(m_link_map, small_link_map, sizeof(small_link_map));
+      m_handle.cltbl = m_link_map;
+    } else if (result == FR_NOT_ENOUGH_CORE) {
+      const DWORD size = small_link_map[0];
+      m_link_map = new DWORD[size];
+      m_link_map[0] = size;
+      m_handle.cltbl = m_link_map;
+      result = f_lseek(&m_handle, CREATE_LINKMAP);
+    }
+
+    if (result != FR_OK)
+      m_handle.cltbl = nullptr;
+  }
+#endif  // FF_USE_FASTSEEK
+
   return f_lseek(&m_handle, offset) == FR_OK;
 }
 
 bool File::truncate() {
 #if !FF_FS_READONLY
+  if (!flush())
+    return false;
+
+  m_is_written = true;
   return f_truncate(&m_handle) == FR_OK;
 #else
   return false;
@@ -1,21 +1,88 @@
 #pragma once
 
+#include <libk/intrusive_list.hpp>
 #include <cstddef>
+#include <cstdint>
 #include "fat/ff.h"
 
 class File {
  public:
+#if !FF_FS_READONLY
+  /** The byte size of the write buffer, see write(). */
+  static constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+#endif  // !FF_FS_READONLY
+
+  ~File();
+
   /** Returns the file size in bytes. */
-  [[nodiscard]] size_t get_size() const { return f_size(&m_handle); }
+  [[nodiscard]] size_t get_size() const {
+#if !FF_FS_READONLY
+    const size_t buffered_end = f_tell(&m_handle) + m_buffered_size;
+    return buffered_end > f_size(&m_handle) ? buffered_end : f_size(&m_handle);
+#else
+    return f_size(&m_handle);
+#endif  // !FF_FS_READONLY
+  }
+
+  /** Returns the file content inside the ramdisk, or nullptr if the file is not stored contiguously
+   * (or empty). It can then be used in place, without any copy. */
+  [[nodiscard]] const void* get_data() const { return is_generated() ? nullptr : m_data; }
+
+  /** Checks if the file content is generated by the kernel when opened (see ProcFs) rather than stored on a
+   * volume. Such a file has no volume nor first cluster. */
+  [[nodiscard]] bool is_generated() const { return m_generated_data != nullptr; }
+
+  /** Returns the volume of the file and its first cluster on it (0 if the file is empty), which identify
+   * the file content as the volumes are read-only. */
+  [[nodiscard]] const FATFS* get_volume() const { return m_handle.obj.fs; }
+  [[nodiscard]] DWORD get_first_cluster() const { return m_handle.obj.sclust; }
 
   bool read(void* buffer, size_t bytes_to_read, size_t* read_bytes);
+  /** Writes at the read/write pointer. The small writes following each other are gathered into a buffer, and only
+   * given to FatFs once it is full or by flush(): the clusters are then allocated (and the sectors written) for all
+   * of them at once, contiguously. Always fails unless CONFIG_WRITABLE_FS. */
   bool write(const void* buffer, size_t bytes_to_write, size_t* wrote_bytes);
+  /** Gives the buffered writes to FatFs, see write(). Called before any other access to the file. */
+  bool flush();
+  /** Moves the read/write pointer to @a offset bytes from the start of the file. The first seek builds
+   * the file cluster link map, so seeking then takes a constant time whatever the file size. */
   bool seek(long long offset);
-  size_t tell() const { return f_tell(&m_handle); }
+  size_t tell() const {
+#if !FF_FS_READONLY
+    return f_tell(&m_handle) + m_buffered_size;
+#else
+    return f_tell(&m_handle);
+#endif  // !FF_FS_READONLY
+  }
+  /** Truncates the file at the read/write pointer. */
   bool truncate();
-  bool eof() const { return f_eof(&m_handle); }
+  bool eof() const { return tell() >= get_size(); }
+
+#if !FF_FS_READONLY
+  /** Checks if the file was written since opened. */
+  [[nodiscard]] bool is_written() const { return m_is_written; }
+#endif  // !FF_FS_READONLY
 
  private:
   friend class FileSystem;
   FIL m_handle;
+  // If not null, the file is read and seeked directly from there instead of following its FAT chain
+  // through FatFs (see get_data()).
+  const uint8_t* m_data = nullptr;
+  // The generated content (also m_data), freed with the file.
+  char* m_generated_data = nullptr;
+#if FF_USE_FASTSEEK
+  // The cluster link map used by the FatFs fast seek mode (m_handle.cltbl), built by the first seek.
+  DWORD* m_link_map = nullptr;
+  bool m_has_link_map = false;
+#endif  // FF_USE_FASTSEEK
+#if !FF_FS_READONLY
+  // The bytes written at the FatFs file pointer but not given to f_write() yet (WRITE_BUFFER_SIZE bytes, allocated
+  // by the first write).
+  uint8_t* m_write_buffer = nullptr;
+  size_t m_buffered_size = 0;
+  bool m_is_written = false;
+  // In the list of the files opened for writing (see FileSystem::sync()).
+  libk::IntrusiveListHook m_written_hook;
+#endif  // !FF_FS_READONLY
 };  // class File
@@ -3,7 +3,20 @@
 #include <libk/log.hpp>
 #include <libk/string.hpp>
 
+#include "fat/block_cache.hpp"
+#include "fat/diskio.h"
 #include "fat/ff.h"
+#include "fat/ramdisk.hpp"
+#include "memory/memory_pressure.hpp"
+#include "boot_profile.hpp"
+#include "page_cache.hpp"
+#include "procfs.hpp"
+
+#if !FF_FS_READONLY
+#include <sys/syscall.h>
+#include "hardware/kernel_lock.hpp"
+#include "task/task_manager.hpp"
+#endif  // !FF_FS_READONLY
 
 FileSystem& FileSystem::get() {
   static FileSystem instance;
@@ -11,6 +24,7 @@ FileSystem& FileSystem::get() {
 }
 
 static FATFS fatfs;
+static FATFS sd_card_fatfs;
 
 void FileSystem::init() {
   auto error_code = f_mount(&fatfs, "/", 1);
@@ -18,20 +32,111 @@ void FileSystem::init() {
     LOG_CRITICAL("Failed to initialize the FAT filesystem (code = {})", error_code);
     return;
   }
+
+  BootProfile::mark(BootProfile::Stage::FILE_SYSTEM);
+
+  // The SD card is optional, its files are then accessed with the "1:/" prefix.
+  error_code = f_mount(&sd_card_fatfs, "1:", 1);
+  if (error_code != FR_OK)
+    LOG_INFO("No SD card FAT filesystem mounted (code = {})", error_code);
+
+  MemoryPressure::register_shrinker("page cache", &PageCache::shrink);
+  MemoryPressure::register_shrinker("dentry cache", [](size_t byte_size) {
+    return FileSystem::get().m_dentry_cache.shrink(byte_size);
+  });
+  // Only the clean blocks of the SD card cache are dropped, the dirty ones wait for the next sync. Its staging
+  // buffer is only freed once no block is left cached (m_lru empty), see BlockCache::shrink().
+  MemoryPressure::register_shrinker("block cache", [](size_t byte_size) {
+    return get_block_cache(SD_CARD_DRIVE)->shrink(byte_size);
+  });
+}
+
+#if FF_FS_READONLY
+/** Checks if the lookup result of a path does not depend on anything else than the (read-only) volume. */
+static bool is_cacheable(FRESULT result) {
+  return result == FR_OK || result == FR_NO_FILE || result == FR_NO_PATH || result == FR_INVALID_NAME;
 }
+#endif  // FF_FS_READONLY
 
 File* FileSystem::open(const char* path, int flags) {
   KASSERT(path != nullptr);
 
-  File* file = new File;
+  if (libk::StringView name; ProcFs::is_proc_file(path, &name)) {
+    // The generated files are read-only.
+    if ((flags & SYS_FM_WRITE) != 0)
+      return nullptr;
+
+    size_t size;
+    char* data = ProcFs::generate(name, &size);
+    if (data == nullptr)
+      return nullptr;
+
+    // Read and seeked as a file stored in place (see File::read()), without volume.
+    File* file = new File;
+    libk::bzero(&file->m_handle, sizeof(file->m_handle));
+    file->m_handle.obj.objsize = size;
+    file->m_handle.flag = FA_READ;
+    file->m_data = (const uint8_t*)data;
+    file->m_generated_data = data;
+    return file;
+  }
 
   BYTE mode = 0;
   if ((flags & SYS_FM_READ) != 0)
     mode |= FA_READ;
   if ((flags & SYS_FM_WRITE) != 0)
     mode |= FA_WRITE;
+  if ((flags & SYS_FM_TRUNCATE) != 0)
+    mode |= FA_CREATE_ALWAYS;
+  else if ((flags & SYS_FM_CREATE) != 0)
+    mode |= FA_OPEN_ALWAYS;
+
+#if FF_FS_READONLY
+  if (const auto* entry = m_dentry_cache.find(DentryCache::Kind::FILE, path); entry != nullptr) {
+    if (entry->result != FR_OK)
+      return nullptr;
+
+    // Leave the file object in the same state as f_open() does.
+    File* file = new File;
+    file->m_handle.obj = entry->file.object;
+    file->m_handle.flag = mode & FA_READ;
+    file->m_handle.err = 0;
+    file->m_handle.fptr = 0;
+    file->m_handle.clust = 0;
+    file->m_handle.sect = 0;
+#if FF_USE_FASTSEEK
+    file->m_handle.cltbl = nullptr;
+#endif  // FF_USE_FASTSEEK
+    file->m_data = entry->file.data;
+    return file;
+  }
+#endif  // FF_FS_READONLY
+
+  File* file = new File;
+  const auto result = f_open(&file->m_handle, path, mode);
+
+#if FF_FS_READONLY
+  // The ramdisk is not modified, so a contiguous file can be read in place.
+  if (result == FR_OK)
+    file->m_data = (const uint8_t*)ramdisk_get_file_address(&file->m_handle);
+
+  if (is_cacheable(result)) {
+    auto* entry = m_dentry_cache.insert(DentryCache::Kind::FILE, path, result);
+    if (entry != nullptr && result == FR_OK) {
+      entry->file.object = file->m_handle.obj;
+      entry->file.data = file->m_data;
+    }
+  }
+#endif  // FF_FS_READONLY
 
-  if (f_open(&file->m_handle, path, mode) == FR_OK)
+#if !FF_FS_READONLY
+  if (result == FR_OK && (mode & FA_WRITE) != 0) {
+    m_writable_files.push_back(file);
+    start_sync_task();
+  }
+#endif  // !FF_FS_READONLY
+
+  if (result == FR_OK)
     return file;
 
   delete file;
@@ -41,16 +146,94 @@ File* FileSystem::open(const char* path, int flags) {
 void FileSystem::close(File* handle) {
   KASSERT(handle != nullptr);
 
-  f_close(&handle->m_handle);
+#if !FF_FS_READONLY
+  if (handle->m_written_hook.is_linked()) {
+    m_writable_files.remove(handle);
+    if (!handle->flush())
+      LOG_ERROR("Failed to write a file being closed");
+
+    // The old content may be cached under the same first cluster.
+    if (handle->is_written())
+      PageCache::invalidate(handle);
+  }
+#endif  // !FF_FS_READONLY
+
+  if (!handle->is_generated())
+    f_close(&handle->m_handle);
   delete handle;
 }
 
+bool FileSystem::sync() {
+#if !FF_FS_READONLY
+  // f_sync() also writes the cached sectors of the volume of the file (CTRL_SYNC).
+  bool success = true;
+  for (File* file : m_writable_files)
+    success &= file->flush() && f_sync(&file->m_handle) == FR_OK;
+  return success;
+#else
+  return true;
+#endif  // !FF_FS_READONLY
+}
+
+#if !FF_FS_READONLY
+void FileSystem::start_sync_task() {
+  if (m_is_sync_task_started)
+    return;
+
+  auto task = TaskManager::get().create_kernel_task([]() {
+    while (true) {
+      sys_sleep(SYNC_PERIOD_MS);
+
+      {
+        KernelTaskLockGuard kernel_lock;
+        if (!FileSystem::get().sync())
+          LOG_ERROR("Failed to sync the written files");
+      }
+    }
+  });
+
+  if (task == nullptr)
+    return;
+
+  task->set_name("fs_sync");
+  TaskManager::get().wake_task(task);
+  m_is_sync_task_started = true;
+}
+#endif  // !FF_FS_READONLY
+
 Dir* FileSystem::open_dir(const char* path) {
   KASSERT(path != nullptr);
 
+  if (ProcFs::is_proc_dir(path)) {
+    Dir* dir = new Dir;
+    dir->m_is_proc = true;
+    return dir;
+  }
+
+#if FF_FS_READONLY
+  if (const auto* entry = m_dentry_cache.find(DentryCache::Kind::DIR, path); entry != nullptr) {
+    if (entry->result != FR_OK)
+      return nullptr;
+
+    // The directory object was cached just after f_opendir(), so it is rewound.
+    Dir* dir = new Dir;
+    dir->m_handle = entry->dir;
+    return dir;
+  }
+#endif  // FF_FS_READONLY
+
   Dir* dir = new Dir;
+  const auto result = f_opendir(&dir->m_handle, path);
+
+#if FF_FS_READONLY
+  if (is_cacheable(result)) {
+    auto* entry = m_dentry_cache.insert(DentryCache::Kind::DIR, path, result);
+    if (entry != nullptr && result == FR_OK)
+      entry->dir = dir->m_handle;
+  }
+#endif  // FF_FS_READONLY
 
-  if (f_opendir(&dir->m_handle, path) == FR_OK)
+  if (result == FR_OK)
     return dir;
 
   delete dir;
@@ -60,6 +243,7 @@ Dir* FileSystem::open_dir(const char* path) {
 void FileSystem::close_dir(Dir* handle) {
   KASSERT(handle != nullptr);
 
-  f_closedir(&handle->m_handle);
+  if (!handle->m_is_proc)
+    f_closedir(&handle->m_handle);
   delete handle;
 }
@@ -1,17 +1,39 @@
 #pragma once
 
+#include "dentry_cache.hpp"
 #include "dir.hpp"
 #include "file.hpp"
 
 class FileSystem {
  public:
+#if !FF_FS_READONLY
+  /** The period of the background sync of the written files, see sync(). */
+  static constexpr uint64_t SYNC_PERIOD_MS = 5000;
+#endif  // !FF_FS_READONLY
+
   static FileSystem& get();
 
   void init();
 
   File* open(const char* path, int flags);
+  /** Closes @a handle, its writes are synced. */
   void close(File* handle);
 
   Dir* open_dir(const char* path);
   void close_dir(Dir* handle);
+
+  /** Writes all the data and metadata of the opened files to the volumes (the buffered writes, then the cached
+   * sectors), see File::write() and BlockCache. Also done every SYNC_PERIOD_MS by a kernel task, once a file was
+   * opened for writing. Returns false if a write failed. */
+  bool sync();
+
+ private:
+  DentryCache m_dentry_cache;
+#if !FF_FS_READONLY
+  /** Starts the background sync, at the first file opened for writing (after the task manager is created). */
+  void start_sync_task();
+
+  libk::IntrusiveList<File, &File::m_written_hook> m_writable_files;
+  bool m_is_sync_task_started = false;
+#endif  // !FF_FS_READONLY
 };  // class FileSystem
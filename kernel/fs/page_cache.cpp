@@ -0,0 +1,126 @@
+#include "page_cache.hpp"
+
+#include <libk/linked_list.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "fat/ramdisk.hpp"
+#include "file.hpp"
+#include "memory/memory_chunk.hpp"
+
+namespace PageCache {
+struct Entry {
+  const FATFS* volume;
+  DWORD first_cluster;
+  size_t size;
+  // The count of allocated pages, 0 if the file is mapped in place.
+  size_t page_count;
+  libk::SharedPointer<MemoryChunk> chunk;
+};  // struct Entry
+
+// The most recently used files first.
+static libk::LinkedList<Entry> g_entries;
+static size_t g_entry_count = 0;
+static size_t g_page_count = 0;
+
+static libk::SharedPointer<MemoryChunk> load(File* file, size_t* page_count) {
+  const auto page_size = MemoryChunk::get_page_byte_size();
+  const size_t size = file->get_size();
+  const size_t nb_pages = libk::div_round_up(size, page_size);
+
+  const void* data = file->get_data();
+  if (data != nullptr && (uintptr_t)data % page_size == 0) {
+    auto chunk = libk::make_shared<MemoryChunk>((VirtualPA)data, ramdisk_get_physical_address(data), nb_pages);
+    if (!chunk || !chunk->is_status_okay())
+      return nullptr;
+
+    *page_count = 0;
+    return chunk;
+  }
+
+  // The pages are overwritten by the file content and the zeroed end of the last page.
+  auto chunk = libk::make_shared<MemoryChunk>(nb_pages, false);
+  if (!chunk || !chunk->is_status_okay())
+    return nullptr;
+
+  // The file may be in use by the process, keep its position.
+  const size_t position = file->tell();
+  size_t read_bytes = 0;
+  const bool success = file->seek(0) && file->read(chunk->get(), size, &read_bytes) && read_bytes == size;
+  file->seek(position);
+  if (!success)
+    return nullptr;
+
+  // The end of the last page is visible to the processes mapping the file.
+  libk::bzero((uint8_t*)chunk->get() + size, nb_pages * page_size - size);
+  *page_count = nb_pages;
+  return chunk;
+}
+
+size_t shrink(size_t byte_size) {
+  const auto page_size = MemoryChunk::get_page_byte_size();
+
+  // The chunks still mapped by a process would not be freed, and the ones mapped in place own no pages.
+  size_t freed_byte_size = 0;
+  // From the least recently used file (the last node), stepping back past the first one gives end().
+  auto it = g_entries.rbegin().base();
+  while (freed_byte_size < byte_size && it != g_entries.end()) {
+    auto current = it--;
+    if (current->page_count == 0 || !current->chunk.is_unique())
+      continue;
+
+    freed_byte_size += current->page_count * page_size;
+    g_page_count -= current->page_count;
+    --g_entry_count;
+    g_entries.erase(current);
+  }
+
+  return freed_byte_size;
+}
+
+void invalidate(const File* file) {
+  for (auto it = g_entries.begin(); it != g_entries.end();) {
+    auto current = it++;
+    if (current->volume != file->get_volume() || current->first_cluster != file->get_first_cluster())
+      continue;
+
+    g_page_count -= current->page_count;
+    --g_entry_count;
+    g_entries.erase(current);
+  }
+}
+
+libk::SharedPointer<MemoryChunk> get(File* file) {
+  if (file->get_size() == 0)
+    return nullptr;
+
+  // The generated files are not identified by a cluster and change at each open, they are never cached.
+  size_t page_count;
+  if (file->is_generated())
+    return load(file, &page_count);
+
+  for (auto it = g_entries.begin(); it != g_entries.end(); ++it) {
+    if (it->volume == file->get_volume() && it->first_cluster == file->get_first_cluster() &&
+        it->size == file->get_size()) {
+      const Entry entry = *it;
+      g_entries.erase(it);
+      g_entries.push_front(entry);
+      return entry.chunk;
+    }
+  }
+
+  auto chunk = load(file, &page_count);
+  if (!chunk || page_count > MAX_PAGE_COUNT)
+    return chunk;
+
+  while (g_entry_count == MAX_FILE_COUNT || g_page_count + page_count > MAX_PAGE_COUNT) {
+    g_page_count -= g_entries.pop_back().page_count;
+    --g_entry_count;
+  }
+
+  g_entries.push_front({file->get_volume(), file->get_first_cluster(), file->get_size(), page_count, chunk});
+  ++g_entry_count;
+  g_page_count += page_count;
+  return chunk;
+}
+}  // namespace PageCache
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <libk/memory.hpp>
+
+class File;
+class MemoryChunk;
+
+/**
+ * A cache of the file contents mapped into the processes (see SYS_MMAP_FILE), in memory chunks that can be
+ * mapped read-only by several processes.
+ *
+ * A file stored contiguously in the ramdisk, starting at a page boundary, is mapped in place: its chunk is
+ * made of the ramdisk pages themselves (the end of its last page is then the start of the next clusters).
+ * Otherwise, the file is read into newly allocated pages.
+ *
+ * The volumes are read-only (FF_FS_READONLY), so a file is identified by its volume and first cluster. With
+ * CONFIG_WRITABLE_FS, the written files are invalidated once closed (see invalidate()).
+ * The count of cached pages is bounded, the least recently used files are evicted first (the processes
+ * still mapping them keep their chunk).
+ */
+namespace PageCache {
+/** The maximum count of pages allocated for the cached files (the ramdisk pages are not counted). */
+static constexpr size_t MAX_PAGE_COUNT = 1024;
+static constexpr size_t MAX_FILE_COUNT = 32;
+
+/** Gets a memory chunk holding the content of @a file, zero padded to the end of its last page unless
+ * it is mapped in place. Returns nullptr if the file is empty, can not be read or if out of memory. */
+[[nodiscard]] libk::SharedPointer<MemoryChunk> get(File* file);
+
+/** Drops the cached content of @a file, which was written (the processes still mapping it keep their chunk). */
+void invalidate(const File* file);
+
+/** Evicts the least recently used files not mapped by any process until @a byte_size bytes of allocated pages are
+ * freed (or there is none left). Returns the count of bytes freed, see MemoryPressure::Shrinker. */
+size_t shrink(size_t byte_size);
+};  // namespace PageCache
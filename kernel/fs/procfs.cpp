@@ -0,0 +1,234 @@
+#include "procfs.hpp"
+#include <libk/format.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "fs/fat/block_cache.hpp"
+#include "hardware/irq/irq_lists.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "memory/kernel_internal_memory.hpp"
+#include "memory/mem_alloc.hpp"
+#include "memory/memory_pressure.hpp"
+#include "memory/zram.hpp"
+#include "task/syscall_stats.hpp"
+#include "task/task_manager.hpp"
+#include "wm/window_manager.hpp"
+
+namespace ProcFs {
+static constexpr libk::StringView DIR_PATH = "/proc";
+
+/** The names and titles are truncated to this length, so a line always fits into TextBuffer::MAX_LINE_SIZE. */
+static constexpr size_t MAX_NAME_LENGTH = 48;
+
+/** A text growing as lines are appended, allocated with kmalloc() so the file takes it as is (see take()). */
+class TextBuffer {
+ public:
+  static constexpr size_t MAX_LINE_SIZE = 256;
+
+  ~TextBuffer() { kfree(m_data); }
+
+  template <class... Args>
+  void append(libk::FormatString<std::type_identity_t<Args>...> line, const Args&... args) {
+    if (m_has_failed)
+      return;
+
+    if (m_capacity - m_size < MAX_LINE_SIZE) {
+      const size_t capacity = libk::max<size_t>(2 * m_capacity, PAGE_SIZE);
+      auto* data = (char*)kmalloc(capacity, alignof(max_align_t));
+      if (data == nullptr) {
+        m_has_failed = true;
+        return;
+      }
+
+      if (m_data != nullptr)
+        libk::memcpy(data, m_data, m_size);
+      kfree(m_data);
+      m_data = data;
+      m_capacity = capacity;
+    }
+
+    m_size = libk::format_to(m_data + m_size, line, args...) - m_data;
+  }
+
+  /** Returns the text (to free with kfree()) and its size, or nullptr if out of memory. */
+  [[nodiscard]] char* take(size_t* size) {
+    if (m_has_failed)
+      return nullptr;
+
+    // An empty text is still a valid buffer.
+    if (m_data == nullptr)
+      m_data = (char*)kmalloc(1, alignof(max_align_t));
+
+    char* data = m_data;
+    *size = m_size;
+    m_data = nullptr;
+    return data;
+  }
+
+ private:
+  char* m_data = nullptr;
+  size_t m_size = 0;
+  size_t m_capacity = 0;
+  bool m_has_failed = false;
+};  // class TextBuffer
+
+static libk::StringView truncate_name(const char* name) {
+  if (name == nullptr)
+    return "-";
+
+  return {name, libk::min(libk::strlen(name), MAX_NAME_LENGTH)};
+}
+
+static uint64_t ticks_to_us(uint64_t ticks) {
+  return (ticks * 1'000'000) / GenericTimer::get_frequency();
+}
+
+static char get_state_char(Task::State state) {
+  switch (state) {
+    case Task::State::RUNNING:
+      return 'R';
+    case Task::State::INTERRUPTIBLE:
+      return 'S';
+    case Task::State::UNINTERRUPTIBLE:
+      return 'D';
+    case Task::State::TERMINATED:
+      return 'Z';
+  }
+
+  return '?';
+}
+
+static void generate_tasks(TextBuffer& text) {
+  text.append("pid ppid prio state kernel thread user_us system_us voluntary involuntary faults rss_kb name\n");
+  TaskManager::get().for_each_task([&](const Task* task) {
+    if (task->is_terminated())
+      return;
+
+    const TaskCpuStats& cpu_stats = task->get_cpu_stats();
+    const auto memory = task->get_memory();
+    text.append("{} {} {} {} {} {} {} {} {} {} {} {} {}\n", task->get_id(),
+                task->has_parent() ? task->get_parent()->get_id() : 0, task->get_priority(),
+                get_state_char(task->get_state()), (int)task->is_kernel(), (int)task->is_thread(),
+                ticks_to_us(cpu_stats.user_ticks), ticks_to_us(cpu_stats.system_ticks), cpu_stats.voluntary_switches,
+                cpu_stats.involuntary_switches, cpu_stats.page_faults,
+                memory != nullptr ? memory->get_resident_byte_size() / 1024 : 0, truncate_name(task->get_name()));
+  });
+}
+
+static void generate_meminfo(TextBuffer& text) {
+  const auto* allocator = memory_impl::get_kernel_alloc();
+  text.append("page_size: {}\n", PAGE_SIZE);
+  text.append("total_pages: {}\n", allocator->get_nb_pages());
+  text.append("free_pages: {}\n", allocator->get_nb_free_pages());
+
+  const auto& pressure = MemoryPressure::get_stats();
+  text.append("reclaims: {}\n", pressure.nb_reclaims);
+  text.append("reclaimed_bytes: {}\n", pressure.reclaimed_byte_size);
+  text.append("paged_out_bytes: {}\n", pressure.paged_out_byte_size);
+  text.append("alloc_failures: {}\n", pressure.nb_failures);
+  text.append("oom_kills: {}\n", pressure.nb_oom_kills);
+
+  const auto& zram = Zram::get_stats();
+  text.append("zram_stored_pages: {}\n", zram.nb_stored_pages);
+  text.append("zram_compressed_bytes: {}\n", zram.compressed_byte_size);
+  text.append("zram_page_outs: {}\n", zram.nb_page_outs);
+  text.append("zram_page_ins: {}\n", zram.nb_page_ins);
+  text.append("zram_rejected_pages: {}\n", zram.nb_rejected_pages);
+}
+
+static void generate_irqs(TextBuffer& text) {
+  const size_t core_count = SMP::get_online_cores_count();
+  text.append("irq");
+  for (size_t core_id = 0; core_id < core_count; ++core_id)
+    text.append(" core{}", core_id);
+  text.append("\n");
+
+  const auto append_irqs = [&](IRQ::Type type, const char* type_name, size_t irq_count) {
+    for (size_t id = 0; id < irq_count; ++id) {
+      const IRQ irq = {.type = type, .id = id};
+      if (!IRQManager::has_irq_handler(irq))
+        continue;
+
+      text.append("{}:{}", type_name, id);
+      for (size_t core_id = 0; core_id < core_count; ++core_id)
+        text.append(" {}", IRQManager::get_irq_count(irq, core_id));
+      text.append("\n");
+    }
+  };
+
+  append_irqs(IRQ::Type::ARMCore, "armc", ARMC_IRQ_NB);
+  append_irqs(IRQ::Type::VideoCore, "vc", VC_IRQ_NB + ETH_PCIE_IRQ_NB);
+  append_irqs(IRQ::Type::Local, "local", LOCAL_IRQ_NB);
+}
+
+static void generate_syscalls(TextBuffer& text) {
+  text.append("id count total_us max_us\n");
+  for (uint32_t id = 0; id < SyscallStats::MAX_ID; ++id) {
+    sys_syscall_stats_t stats;
+    if (!SyscallStats::get_global().get(id, stats) || stats.count == 0)
+      continue;
+
+    text.append("{} {} {} {}\n", id, stats.count, ticks_to_us(stats.total_ticks), ticks_to_us(stats.max_ticks));
+  }
+}
+
+static void generate_disks(TextBuffer& text) {
+  text.append("drive hits misses readahead uncached reads writes written evictions dirty\n");
+  for (BYTE drive = 0; drive < FF_VOLUMES; ++drive) {
+    const BlockCache* cache = get_block_cache(drive);
+    if (cache == nullptr)
+      continue;
+
+    const BlockCache::Stats& stats = cache->get_stats();
+    text.append("{} {} {} {} {} {} {} {} {} {}\n", drive, stats.nb_hits, stats.nb_misses, stats.nb_readahead_sectors,
+                stats.nb_uncached_sectors, stats.nb_device_reads, stats.nb_device_writes, stats.nb_written_sectors,
+                stats.nb_evictions, cache->get_dirty_count());
+  }
+}
+
+static void generate_wm(TextBuffer& text) {
+  text.append("handle pid visible focus x y width height title\n");
+  WindowManager::get().for_each_window([&](const Window* window) {
+    const Rect geometry = window->get_geometry();
+    const libk::StringView title = window->get_title();
+    text.append("{} {} {} {} {} {} {} {} {}\n", window->get_handle(), window->get_task()->get_id(),
+                (int)window->is_visible(), (int)window->has_focus(), geometry.x(), geometry.y(), geometry.width(),
+                geometry.height(), libk::StringView(title.get_data(), libk::min(title.get_length(), MAX_NAME_LENGTH)));
+  });
+}
+
+bool is_proc_dir(libk::StringView path) {
+  return path == DIR_PATH || path == "/proc/";
+}
+
+bool is_proc_file(libk::StringView path, libk::StringView* name) {
+  if (!path.starts_with(DIR_PATH) || path.get_length() <= DIR_PATH.get_length() + 1 ||
+      path[DIR_PATH.get_length()] != '/')
+    return false;
+
+  *name = {path.get_data() + DIR_PATH.get_length() + 1, path.get_length() - DIR_PATH.get_length() - 1};
+  return true;
+}
+
+char* generate(libk::StringView name, size_t* size) {
+  TextBuffer text;
+  if (name == "tasks")
+    generate_tasks(text);
+  else if (name == "meminfo")
+    generate_meminfo(text);
+  else if (name == "irqs")
+    generate_irqs(text);
+  else if (name == "syscalls")
+    generate_syscalls(text);
+  else if (name == "disks")
+    generate_disks(text);
+  else if (name == "wm")
+    generate_wm(text);
+  else
+    return nullptr;
+
+  return text.take(size);
+}
+}  // namespace ProcFs
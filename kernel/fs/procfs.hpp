@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <libk/string_view.hpp>
+
+/**
+ * A read-only virtual directory, /proc, exposing the kernel statistics as text files as the procfs of Linux:
+ *
+ *  - /proc/tasks: one line per task (ids, state, CPU times, context switches, page faults, resident memory);
+ *  - /proc/meminfo: the page allocator, memory pressure and zram counters;
+ *  - /proc/irqs: the count of each IRQ with a handler, per core;
+ *  - /proc/syscalls: the count and durations of each system call called since boot;
+ *  - /proc/disks: the block cache counters of each cached drive, in sectors (see BlockCache::Stats);
+ *  - /proc/wm: the windows, from front to back.
+ *
+ * The files are read with the usual file system calls (see FileSystem::open()). Their content is generated
+ * when opened, from the counters kept by the kernel, so reading a file gives a consistent snapshot whatever
+ * the size of the reads. Nothing is stored on the volumes.
+ */
+namespace ProcFs {
+/** The names of the files of /proc, in the order they are listed. */
+static constexpr const char* FILE_NAMES[] = {"tasks", "meminfo", "irqs", "syscalls", "disks", "wm"};
+static constexpr size_t FILE_COUNT = sizeof(FILE_NAMES) / sizeof(FILE_NAMES[0]);
+
+/** Checks if @a path is /proc itself. */
+[[nodiscard]] bool is_proc_dir(libk::StringView path);
+/** Checks if @a path is inside /proc, the name of the file is then stored into @a name. */
+[[nodiscard]] bool is_proc_file(libk::StringView path, libk::StringView* name);
+
+/** Generates the content of the file /proc/@a name into a buffer allocated with kmalloc(), its size is stored
+ * into @a size. Returns nullptr if there is no such file, or if out of memory. */
+[[nodiscard]] char* generate(libk::StringView name, size_t* size);
+}  // namespace ProcFs
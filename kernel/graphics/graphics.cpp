@@ -1,6 +1,9 @@
 #include "graphics/graphics.hpp"
+#include <libk/string.hpp>
 #include <libk/utils.hpp>
+#include <type_traits>
 #include <utility>
+#include "graphics/text_run_cache.hpp"
 #include "hardware/framebuffer.hpp"
 
 extern const uint8_t firacode_16_pkf[100];
@@ -10,16 +13,45 @@ namespace graphics {
   return x < 0 ? -x : x;
 }
 
-Painter::Painter() : m_font(firacode_16_pkf) {
-  auto& fb = FrameBuffer::get();
-  create(fb.get_buffer(), fb.get_width(), fb.get_height(), fb.get_pitch());
+// The RGB channels of a color spread into 16-bits lanes (blue in the lowest one), so the three of them
+// are blended by the same 64-bits operations. A lane holds up to 255 * 255 without carrying into the next one.
+static constexpr uint64_t RGB_LANES_MASK = 0x000000ff00ff00ff;
+static constexpr uint64_t RGB_LANES_ONE = 0x0000000100010001;
+
+[[gnu::always_inline, nodiscard]] static inline uint64_t spread_rgb(uint32_t argb) {
+  return (argb & 0xff) | ((argb & 0xff00) << 8) | ((uint64_t)(argb & 0xff0000) << 16);
+}
+
+[[gnu::always_inline, nodiscard]] static inline uint32_t pack_rgb(uint64_t lanes) {
+  return (lanes & 0xff) | ((lanes >> 8) & 0xff00) | ((lanes >> 16) & 0xff0000);
+}
+
+/** Alpha blending: dst = (alpha * src + (255 - alpha) * dst) / 255, the result alpha is 0. */
+[[gnu::always_inline, nodiscard]] static inline uint32_t blend_rgb(uint64_t src_lanes, uint32_t dst, uint32_t alpha) {
+  const uint64_t lanes = src_lanes * alpha + spread_rgb(dst) * (255 - alpha);
+  // Exact division by 255 of each lane: x / 255 == (x + 1 + (x >> 8)) >> 8 for x < 2^16.
+  const uint64_t quotients = (lanes + ((lanes >> 8) & RGB_LANES_MASK) + RGB_LANES_ONE) >> 8;
+  return pack_rgb(quotients & RGB_LANES_MASK);
 }
 
-Painter::Painter(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch) : m_font(firacode_16_pkf) {
+template <class Format>
+BasicPainter<Format>::BasicPainter() : m_font(firacode_16_pkf) {
+  if constexpr (std::is_same_v<Format, FrameBuffer::PixelFormat>) {
+    auto& fb = FrameBuffer::get();
+    create(fb.get_buffer(), fb.get_width(), fb.get_height(), fb.get_pitch());
+  } else {
+    create(nullptr, 0, 0, 0);  // everything is clipped
+  }
+}
+
+template <class Format>
+BasicPainter<Format>::BasicPainter(Pixel* buffer, uint32_t width, uint32_t height, uint32_t pitch)
+    : m_font(firacode_16_pkf) {
   create(buffer, width, height, pitch);
 }
 
-void Painter::create(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch) {
+template <class Format>
+void BasicPainter<Format>::create(Pixel* buffer, uint32_t width, uint32_t height, uint32_t pitch) {
   m_buffer = buffer;
   m_width = width;
   m_height = height;
@@ -28,139 +60,206 @@ void Painter::create(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t
   revert_clipping();
 }
 
-[[gnu::hot]] void Painter::clear(graphics::Color clear_color) {
-  for (uint32_t x = 0; x < m_width; ++x) {
-    for (uint32_t y = 0; y < m_height; ++y) {
-      m_buffer[x + m_pitch * y] = clear_color.argb;
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::clear(graphics::Color clear_color) {
+  // Without padding between the rows, the whole framebuffer is a single span.
+  if (m_pitch == m_width) {
+    if constexpr (sizeof(Pixel) == sizeof(uint32_t)) {
+      libk::memset32_large(m_buffer, Format::from_argb(clear_color.argb), (size_t)m_pitch * m_height);
+    } else {
+      fill_pixels<Format>(m_buffer, Format::from_argb(clear_color.argb), (size_t)m_pitch * m_height);
     }
+    return;
+  }
+
+  for (uint32_t y = 0; y < m_height; ++y) {
+    fill_pixels<Format>(m_buffer + m_pitch * y, Format::from_argb(clear_color.argb), m_width);
   }
 }
 
-void Painter::draw_pixel(int32_t x, int32_t y) {
+template <class Format>
+void BasicPainter<Format>::draw_pixel(int32_t x, int32_t y) {
   draw_pixel(x, y, m_pen);
 }
 
-[[gnu::hot]] void Painter::draw_pixel(int32_t x, int32_t y, Color color) {
+template <class Format>
+template <typename BasicPainter<Format>::BlendMode MODE>
+[[gnu::always_inline]] inline void BasicPainter<Format>::plot(int32_t x, int32_t y, Color color, uint64_t src_lanes) {
   // Clipping
   if (x < m_clipping.x_min || x > m_clipping.x_max)
     return;
   if (y < m_clipping.y_min || y > m_clipping.y_max)
     return;
 
-  // Alpha blending: dst = alpha * src + (1 - alpha) * dst
-  const uint32_t dst_color = m_buffer[x + m_pitch * y];
-  const uint32_t dst_red = (dst_color >> 16) & 0xff;
-  const uint32_t dst_green = (dst_color >> 8) & 0xff;
-  const uint32_t dst_blue = dst_color & 0xff;
-
-  const uint32_t src_alpha = (color.argb >> 24) & 0xff;
-  const uint32_t src_red = (color.argb >> 16) & 0xff;
-  const uint32_t src_green = (color.argb >> 8) & 0xff;
-  const uint32_t src_blue = color.argb & 0xff;
+  Pixel& dst = m_buffer[x + m_pitch * y];
+  if constexpr (MODE == BlendMode::COPY) {
+    dst = Format::from_argb(color.argb);  // the same as the blending result for an alpha of 255
+  } else {
+    dst = Format::from_argb(blend_rgb(src_lanes, Format::to_argb(dst), (color.argb >> 24) & 0xff));
+  }
+}
 
-  const uint32_t result_red = (src_alpha * src_red + (255 - src_alpha) * dst_red) / 255;
-  const uint32_t result_green = (src_alpha * src_green + (255 - src_alpha) * dst_green) / 255;
-  const uint32_t result_blue = (src_alpha * src_blue + (255 - src_alpha) * dst_blue) / 255;
-  m_buffer[x + m_pitch * y] = (0x00 << 24) | (result_red << 16) | (result_green << 8) | result_blue;
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::draw_pixel(int32_t x, int32_t y, Color color) {
+  const uint32_t alpha = (color.argb >> 24) & 0xff;
+  if (alpha == 0xff) {
+    plot<BlendMode::COPY>(x, y, color, 0);
+  } else if (alpha != 0) {
+    plot<BlendMode::SRC_OVER>(x, y, color, spread_rgb(color.argb));
+  }
 }
 
-void Painter::draw_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+template <class Format>
+void BasicPainter<Format>::draw_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
   draw_line(x0, y0, x1, y1, m_pen);
 }
 
-[[gnu::hot]] void Painter::draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Color color) {
-  // See https://en.wikipedia.org/wiki/Bresenham's_line_algorithm
-
-  const auto dx = x2 - x1;
-  const auto dy = y2 - y1;
+template <class Format>
+template <typename BasicPainter<Format>::BlendMode MODE>
+void BasicPainter<Format>::draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Color color) {
+  // See https://en.wikipedia.org/wiki/Bresenham's_line_algorithm (the variant for all octants), only additions
+  // per pixel. In 64-bits, as the coordinates may come from the userspace.
+  const int64_t dx = libk::max<int64_t>(x2, x1) - libk::min<int64_t>(x2, x1);
+  const int64_t dy = libk::min<int64_t>(y2, y1) - libk::max<int64_t>(y2, y1);
+  const int32_t step_x = x1 < x2 ? 1 : -1;
+  const int32_t step_y = y1 < y2 ? 1 : -1;
+  const uint64_t src_lanes = spread_rgb(color.argb);
+
+  int64_t error = dx + dy;
+  while (true) {
+    plot<MODE>(x1, y1, color, src_lanes);
+    if (x1 == x2 && y1 == y2)
+      break;
+
+    const int64_t double_error = 2 * error;
+    if (double_error >= dy) {
+      error += dy;
+      x1 += step_x;
+    }
+    if (double_error <= dx) {
+      error += dx;
+      y1 += step_y;
+    }
+  }
+}
 
-  // If both of the differences are 0 there will be a division by 0 below.
-  if (dx == 0 && dy == 0) {
-    draw_pixel(x1, y1, color);
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Color color) {
+  // The horizontal and vertical lines are spans, clipped once (as the window frames and the rectangles).
+  if (y1 == y2) {
+    fill_rect(libk::min(x1, x2), y1, abs(x2 - x1) + 1, 1, color);
+    return;
+  }
+  if (x1 == x2) {
+    fill_rect(x1, libk::min(y1, y2), 1, abs(y2 - y1) + 1, color);
     return;
   }
 
-  if (abs(dx) > abs(dy)) {
-    if (x1 > x2) {
-      std::swap(x1, x2);
-      std::swap(y1, y2);
-    }
-
-    for (auto x = x1; x <= x2; ++x) {
-      const auto y = dy * (x - x1) / dx + y1;
-      draw_pixel(x, y, color);
-    }
-  } else {
-    if (y1 > y2) {
-      std::swap(x1, x2);
-      std::swap(y1, y2);
-    }
-
-    for (auto y = y1; y <= y2; ++y) {
-      const auto x = dx * (y - y1) / dy + x1;
-      draw_pixel(x, y, color);
-    }
+  const uint32_t alpha = (color.argb >> 24) & 0xff;
+  if (alpha == 0xff) {
+    draw_line<BlendMode::COPY>(x1, y1, x2, y2, color);
+  } else if (alpha != 0) {
+    draw_line<BlendMode::SRC_OVER>(x1, y1, x2, y2, color);
   }
 }
 
-void Painter::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
+template <class Format>
+void BasicPainter<Format>::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
   draw_rect(x, y, w, h, m_pen);
 }
 
-[[gnu::hot]] void Painter::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
-  draw_line(x, y, x + w - 1, y, color);                  // top edge
-  draw_line(x, y + h - 1, x + w - 1, y + h - 1, color);  // bottom edge
-  draw_line(x, y, x, y + h - 1, color);                  // left edge
-  draw_line(x + w - 1, y, x + w - 1, y + h - 1, color);  // right edge
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
+  // The edges do not overlap, so the corners of a translucent rectangle are blended once.
+  if (w <= 2 || h <= 2) {
+    fill_rect(x, y, w, h, color);
+    return;
+  }
+
+  fill_rect(x, y, w, 1, color);                  // top edge
+  fill_rect(x, y + h - 1, w, 1, color);          // bottom edge
+  fill_rect(x, y + 1, 1, h - 2, color);          // left edge
+  fill_rect(x + w - 1, y + 1, 1, h - 2, color);  // right edge
 }
 
-void Painter::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
+template <class Format>
+void BasicPainter<Format>::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
   fill_rect(x, y, w, h, m_pen);
 }
 
-[[gnu::hot]] void Painter::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
-  // Early clipping
-  x = libk::max(m_clipping.x_min, x);
-  y = libk::max(m_clipping.y_min, y);
-  w = libk::min(m_clipping.x_max - m_clipping.x_min + 1, w);
-  h = libk::min(m_clipping.y_max - m_clipping.y_min + 1, h);
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
+  // Early clipping (64-bits to not overflow)
+  const int64_t x_begin = libk::max<int64_t>(x, m_clipping.x_min);
+  const int64_t y_begin = libk::max<int64_t>(y, m_clipping.y_min);
+  const int64_t x_end = libk::min<int64_t>((int64_t)x + w, (int64_t)m_clipping.x_max + 1);
+  const int64_t y_end = libk::min<int64_t>((int64_t)y + h, (int64_t)m_clipping.y_max + 1);
+  if (x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  const uint32_t alpha = (color.argb >> 24) & 0xff;
+  if (alpha == 0)
+    return;  // nothing to draw
 
-  for (uint32_t i = x; i < (x + w); ++i) {
-    for (uint32_t j = y; j < (y + h); ++j) {
-      draw_pixel(i, j, color);
+  // An opaque color is stored as is, row span by row span (the same as the blending result of draw_pixel()).
+  if (alpha == 0xff) {
+    for (int64_t j = y_begin; j < y_end; ++j) {
+      fill_pixels<Format>(m_buffer + (x_begin + m_pitch * j), Format::from_argb(color.argb), x_end - x_begin);
+    }
+
+    return;
+  }
+
+  const uint64_t src_lanes = spread_rgb(color.argb);
+  for (int64_t j = y_begin; j < y_end; ++j) {
+    Pixel* row = m_buffer + m_pitch * j;
+    for (int64_t i = x_begin; i < x_end; ++i) {
+      row[i] = Format::from_argb(blend_rgb(src_lanes, Format::to_argb(row[i]), alpha));
     }
   }
 }
 
-uint32_t Painter::draw_text(int32_t x, int32_t y, const char* text) {
+template <class Format>
+uint32_t BasicPainter<Format>::draw_text(int32_t x, int32_t y, const char* text) {
   return draw_text(x, y, INT32_MAX, text, m_pen);
 }
 
-uint32_t Painter::draw_text(int32_t x, int32_t y, const char* text, Color color) {
+template <class Format>
+uint32_t BasicPainter<Format>::draw_text(int32_t x, int32_t y, const char* text, Color color) {
   return draw_text(x, y, INT32_MAX, text, color);
 }
 
-uint32_t Painter::draw_text(int32_t x, int32_t y, int32_t w, const char* text) {
+template <class Format>
+uint32_t BasicPainter<Format>::draw_text(int32_t x, int32_t y, int32_t w, const char* text) {
   return draw_text(x, y, w, text, m_pen);
 }
 
-uint32_t Painter::draw_text(int32_t x, int32_t y, int32_t w, const char* text, Color color) {
+template <class Format>
+uint32_t BasicPainter<Format>::draw_text(int32_t x, int32_t y, int32_t w, const char* text, Color color) {
+  // The repeated texts are composed once into a single alpha map, see TextRunCache.
+  const TextRun* run = TextRunCache::get(m_font, w, text);
+  if (run != nullptr) {
+    draw_alpha_map(x, y, run->alpha_map, run->width, run->height, color);
+    return x + run->end_x;
+  }
+
   auto current_x = x;
   auto current_y = y;
 
   const uint32_t char_width = m_font.get_char_width();
-  const uint32_t char_height = m_font.get_char_height();
-  const uint32_t advance = m_font.get_horizontal_advance();
   const uint32_t line_height = m_font.get_line_height();
 
+  uint32_t previous = 0;  // the previous character on the line, for kerning
   for (const char* it = text; *it != '\0'; ++it) {
-    const char ch = *it;
+    const uint32_t ch = (uint8_t)*it;
 
-    if (ch >= PKFont::FIRST_CHARACTER && ch <= PKFont::LAST_CHARACTER) {
+    if (m_font.has_glyph(ch)) {
       // Early clipping
       if (current_x > m_clipping.x_max)
         continue;
 
+      current_x += m_font.get_kerning(previous, ch);
+
       // If the character does not fit in the line, then start a new line.
       // We check (Y - x >= w) instead of (Y >= x + w) to avoid overflow, as w may be defined to UINT32_MAX.
       if ((current_x + char_width) - x >= w) {
@@ -168,17 +267,19 @@ uint32_t Painter::draw_text(int32_t x, int32_t y, int32_t w, const char* text, C
         current_y += line_height;
       }
 
-      const uint8_t* glyph = m_font.get_glyph(ch);
-      draw_alpha_map(current_x, current_y, glyph, char_width, char_height, color);
-      current_x += advance;
+      draw_glyph(current_x, current_y, ch, color);
+      current_x += m_font.get_horizontal_advance(ch);
+      previous = ch;
     } else {
       switch (ch) {
         case ' ':
-          current_x += advance;
+          current_x += m_font.get_horizontal_advance(ch);
+          previous = ch;
           break;
         case '\n':
           current_x = x;
           current_y += line_height;
+          previous = 0;
           break;
         default:
           // Ignore the unknown character.
@@ -196,43 +297,173 @@ uint32_t Painter::draw_text(int32_t x, int32_t y, int32_t w, const char* text, C
   return current_x;
 }
 
-[[gnu::hot]] void Painter::draw_alpha_map(int32_t x,
-                                          int32_t y,
-                                          const uint8_t* alpha_map,
-                                          uint32_t w,
-                                          uint32_t h,
-                                          Color color) {
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::draw_glyph(int32_t x, int32_t y, uint32_t code_point, Color color) {
+  // The glyphs only store their non-transparent spans (in the v2 format), each span is clipped on its own.
+  const uint64_t src_lanes = spread_rgb(color.argb);
+  const Pixel opaque_color = Format::from_argb(color.argb);  // the blending result for an alpha of 255
+
+  m_font.for_each_span(code_point, [&](uint32_t i, uint32_t j, const uint8_t* alphas, uint32_t length) {
+    const int64_t row_y = (int64_t)y + j;
+    if (row_y < m_clipping.y_min || row_y > m_clipping.y_max)
+      return;
+
+    const int64_t span_x = (int64_t)x + i;
+    const int64_t x_begin = libk::max<int64_t>(span_x, m_clipping.x_min);
+    const int64_t x_end = libk::min<int64_t>(span_x + length, (int64_t)m_clipping.x_max + 1);
+    if (x_begin >= x_end)
+      return;
+
+    Pixel* row = m_buffer + m_pitch * row_y;
+    if (alphas == nullptr) {
+      fill_pixels<Format>(row + x_begin, opaque_color, x_end - x_begin);
+      return;
+    }
+
+    for (int64_t k = x_begin; k < x_end; ++k) {
+      const uint32_t alpha = alphas[k - span_x];
+      if (alpha == 0)
+        continue;
+
+      if (alpha == 0xff)
+        row[k] = opaque_color;
+      else
+        row[k] = Format::from_argb(blend_rgb(src_lanes, Format::to_argb(row[k]), alpha));
+    }
+  });
+}
+
+template <class Format>
+[[gnu::hot]] void BasicPainter<Format>::draw_alpha_map(int32_t x,
+                                                       int32_t y,
+                                                       const uint8_t* alpha_map,
+                                                       uint32_t w,
+                                                       uint32_t h,
+                                                       Color color) {
   // This function is a performance bottleneck.
-  // It is called to draw each glyph.
-  // Therefore, it must be heavily optimized if possible.
-  for (uint32_t i = 0; i < w; ++i) {
-    for (uint32_t j = 0; j < h; ++j) {
-      const uint8_t alpha = alpha_map[i + j * w];
-      draw_pixel(x + i, y + j, color.with_alpha(alpha));
+  // It is called to draw each text run.
+  // Therefore, the run is clipped once and then blended row by row (both the alpha map and
+  // the framebuffer are row-major), skipping the transparent pixels and copying the opaque ones.
+  const int64_t i_begin = libk::max<int64_t>(0, (int64_t)m_clipping.x_min - x);
+  const int64_t i_end = libk::min<int64_t>(w, (int64_t)m_clipping.x_max + 1 - x);
+  const int64_t j_begin = libk::max<int64_t>(0, (int64_t)m_clipping.y_min - y);
+  const int64_t j_end = libk::min<int64_t>(h, (int64_t)m_clipping.y_max + 1 - y);
+  if (i_begin >= i_end || j_begin >= j_end)
+    return;
+
+  const uint64_t src_lanes = spread_rgb(color.argb);
+  const Pixel opaque_color = Format::from_argb(color.argb);  // the blending result for an alpha of 255
+
+  for (int64_t j = j_begin; j < j_end; ++j) {
+    const uint8_t* alpha_row = alpha_map + j * w;
+    Pixel* row = m_buffer + (x + m_pitch * (y + j));
+
+    for (int64_t i = i_begin; i < i_end; ++i) {
+      const uint32_t alpha = alpha_row[i];
+      if (alpha == 0)
+        continue;
+
+      if (alpha == 0xff)
+        row[i] = opaque_color;
+      else
+        row[i] = Format::from_argb(blend_rgb(src_lanes, Format::to_argb(row[i]), alpha));
     }
   }
 }
 
-void Painter::blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer) {
-  // TODO: Clipping
-  for (uint32_t i = 0; i < width; ++i) {
-    for (uint32_t j = 0; j < height; ++j) {
-      m_buffer[(x + i) + m_pitch * (y + j)] = argb_buffer[i + width * j];
-    }
+template <class Format>
+void BasicPainter<Format>::blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer) {
+  // Only the part of the image inside the clipping box is copied (64-bits to not overflow).
+  const int64_t x_begin = libk::max<int64_t>(x, m_clipping.x_min);
+  const int64_t y_begin = libk::max<int64_t>(y, m_clipping.y_min);
+  const int64_t x_end = libk::min<int64_t>((int64_t)x + width, (int64_t)m_clipping.x_max + 1);
+  const int64_t y_end = libk::min<int64_t>((int64_t)y + height, (int64_t)m_clipping.y_max + 1);
+
+  if (x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  // Both the image and the framebuffer are row-major, so each visible row is a single copy (or conversion).
+  for (int64_t j = y_begin; j < y_end; ++j) {
+    convert_from_argb<Format>(m_buffer + (x_begin + m_pitch * j), argb_buffer + ((x_begin - x) + width * (j - y)),
+                              x_end - x_begin);
+  }
+}
+
+template <class Format>
+void BasicPainter<Format>::copy_area(int32_t src_x, int32_t src_y, int32_t w, int32_t h, int32_t dst_x, int32_t dst_y) {
+  // The destination, clipped so that its source is inside the framebuffer (64-bits to not overflow).
+  const int64_t offset_x = (int64_t)dst_x - src_x;
+  const int64_t offset_y = (int64_t)dst_y - src_y;
+  const int64_t x_begin = libk::max(libk::max<int64_t>(dst_x, m_clipping.x_min), offset_x);
+  const int64_t y_begin = libk::max(libk::max<int64_t>(dst_y, m_clipping.y_min), offset_y);
+  const int64_t x_end =
+      libk::min(libk::min<int64_t>((int64_t)dst_x + w, (int64_t)m_clipping.x_max + 1), offset_x + m_width);
+  const int64_t y_end =
+      libk::min(libk::min<int64_t>((int64_t)dst_y + h, (int64_t)m_clipping.y_max + 1), offset_y + m_height);
+  if (x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  // When moving down, the rows are copied from the bottom so that the source rows are read before being
+  // overwritten. In a row, memmove() handles the overlap.
+  const size_t row_byte_size = sizeof(Pixel) * (x_end - x_begin);
+  const auto copy_row = [&](int64_t j) {
+    libk::memmove(m_buffer + (x_begin + m_pitch * j), m_buffer + ((x_begin - offset_x) + m_pitch * (j - offset_y)),
+                  row_byte_size);
+  };
+
+  if (offset_y > 0) {
+    for (int64_t j = y_end - 1; j >= y_begin; --j)
+      copy_row(j);
+  } else {
+    for (int64_t j = y_begin; j < y_end; ++j)
+      copy_row(j);
   }
 }
 
-void Painter::revert_clipping() {
+template <class Format>
+void BasicPainter<Format>::revert_clipping() {
   m_clipping.x_min = 0;
   m_clipping.y_min = 0;
   m_clipping.x_max = m_width - 1;
   m_clipping.y_max = m_height - 1;
 }
 
-void Painter::set_clipping(int32_t x_min, int32_t y_min, int32_t x_max, int32_t y_max) {
+template <class Format>
+void BasicPainter<Format>::set_clipping(int32_t x_min, int32_t y_min, int32_t x_max, int32_t y_max) {
   m_clipping.x_min = libk::max<int32_t>(0, x_min);  // maybe unnecessary?
   m_clipping.y_min = libk::max<int32_t>(0, y_min);  // maybe unnecessary?
   m_clipping.x_max = libk::min<int32_t>(m_width - 1, x_max);
   m_clipping.y_max = libk::min<int32_t>(m_height - 1, y_max);
 }
+
+template class BasicPainter<PixelFormatXrgb8888>;
+template class BasicPainter<PixelFormatRgb565>;
 }  // namespace graphics
+
+/*
+ * Benchmarks
+ */
+
+#include <libk/assert.hpp>
+#include <libk/benchmark.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "memory/mem_alloc.hpp"
+#include "task/task.hpp"
+
+BENCHMARK("kernel.draw_text") {
+  static constexpr uint32_t WIDTH = 512;
+  static constexpr uint32_t HEIGHT = 32;
+
+  // The text runs are cached globally.
+  {
+    KernelTaskLockGuard kernel_lock;
+    auto* buffer = (uint32_t*)kmalloc(WIDTH * HEIGHT * sizeof(uint32_t), alignof(uint32_t));
+    KASSERT(buffer != nullptr);
+
+    graphics::Painter painter(buffer, WIDTH, HEIGHT, WIDTH);
+    while (state.keep_running())
+      painter.draw_text(0, 0, "The quick brown fox jumps over the lazy dog 0123456789", graphics::Color::WHITE);
+
+    kfree(buffer);
+  }
+}
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "graphics/pixel_format.hpp"
 #include "graphics/pkfont.hpp"
 
 namespace graphics {
@@ -55,6 +56,10 @@ struct Color {
 /**
  * @brief Painter provides an interface for drawing in a framebuffer.
  *
+ * The painter is templated on the pixel format of the buffer (see graphics/pixel_format.hpp): Painter draws into
+ * XRGB8888 buffers (the window framebuffers), BasicPainter<FrameBuffer::PixelFormat> into the screen. The colors
+ * are always given in 0xAARRGGBB format.
+ *
  * ## Drawing functions
  *
  * Drawing functions are available for most primitives. For example, draw_line(), draw_rect(), draw_pixel(), etc.
@@ -74,12 +79,16 @@ struct Color {
  *
  * @see Color
  */
-class Painter {
+template <class Format>
+class BasicPainter {
  public:
-  /** @brief Creates a painter that draws into the global framebuffer. See FrameBuffer class. */
-  Painter();
+  using Pixel = typename Format::Pixel;
+
+  /** @brief Creates a painter that draws into the global framebuffer, if it has the same pixel format (otherwise,
+   * nothing is drawn until a buffer is given). See FrameBuffer class. */
+  BasicPainter();
   /** @brief Creates a painter that draws into the provided framebuffer. */
-  Painter(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch);
+  BasicPainter(Pixel* buffer, uint32_t width, uint32_t height, uint32_t pitch);
 
   /** @brief Gets the current used color to draw. */
   [[nodiscard]] Color get_pen() const { return m_pen; }
@@ -117,15 +126,29 @@ class Painter {
 
   // Image blit.
   void blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer);
+  /** @brief Moves the @a w x @a h pixels at (@a src_x, @a src_y) to (@a dst_x, @a dst_y), the areas may overlap (e.g.
+   * to scroll). The source is limited to the framebuffer and the destination to the clipping box. */
+  void copy_area(int32_t src_x, int32_t src_y, int32_t w, int32_t h, int32_t dst_x, int32_t dst_y);
 
   // Clipping functions:
   void revert_clipping();
   void set_clipping(int32_t x_min, int32_t y_min, int32_t x_max, int32_t y_max);
 
  private:
+  /** @brief How a color is written by the drawing functions: stored as is if opaque, or blended. */
+  enum class BlendMode { COPY, SRC_OVER };
+
   /** @brief Implements the Painter constructor. */
-  void create(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch);
-  /** @brief Used internally by draw_text() to draw a glyph alpha map. */
+  void create(Pixel* buffer, uint32_t width, uint32_t height, uint32_t pitch);
+  /** @brief Implements draw_pixel() for the given blend mode, @a src_lanes is spread_rgb() of @a color. */
+  template <BlendMode MODE>
+  void plot(int32_t x, int32_t y, Color color, uint64_t src_lanes);
+  /** @brief Implements draw_line() for the given blend mode. */
+  template <BlendMode MODE>
+  void draw_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, Color color);
+  /** @brief Used internally by draw_text() to draw the glyph of @a code_point, span by span. */
+  void draw_glyph(int32_t x, int32_t y, uint32_t code_point, Color color);
+  /** @brief Used internally by draw_text() to draw a text run alpha map. */
   void draw_alpha_map(int32_t x, int32_t y, const uint8_t* alpha_map, uint32_t w, uint32_t h, Color color);
 
   struct BBox {
@@ -136,11 +159,17 @@ class Painter {
   };  // struct BBox
 
   PKFont m_font;
-  uint32_t* m_buffer;  // framebuffer, in 0xAARRGGBB format
-  uint32_t m_width;    // width of the framebuffer, in pixels
-  uint32_t m_height;   // height of the framebuffer, in pixels
-  uint32_t m_pitch;    // pitch of the framebuffer
+  Pixel* m_buffer;    // framebuffer, in the Format pixels
+  uint32_t m_width;   // width of the framebuffer, in pixels
+  uint32_t m_height;  // height of the framebuffer, in pixels
+  uint32_t m_pitch;   // pitch of the framebuffer
   BBox m_clipping;
   Color m_pen = make_color(0xff, 0xff, 0xff);
-};  // class Painter
+};  // class BasicPainter
+
+extern template class BasicPainter<PixelFormatXrgb8888>;
+extern template class BasicPainter<PixelFormatRgb565>;
+
+/** Draws into the window framebuffers and the other XRGB8888 buffers. */
+using Painter = BasicPainter<PixelFormatXrgb8888>;
 }  // namespace graphics
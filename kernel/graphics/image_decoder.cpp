@@ -0,0 +1,67 @@
+#include "image_decoder.hpp"
+
+#include <libk/utils.hpp>
+#include "qoi.hpp"
+#include "stb_image.h"
+
+namespace graphics {
+ImageFormat detect_image_format(const uint8_t* data, size_t size) {
+  uint32_t width, height;
+  if (Qoi::read_header(data, size, width, height))
+    return ImageFormat::QOI;
+
+  // The JPEG files start with a SOI marker, then the marker of the first segment.
+  if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff)
+    return ImageFormat::JPEG;
+
+  return ImageFormat::UNKNOWN;
+}
+
+bool read_image_size(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height) {
+  switch (detect_image_format(data, size)) {
+    case ImageFormat::QOI:
+      return Qoi::read_header(data, size, width, height);
+    case ImageFormat::JPEG: {
+      // Only the headers are parsed.
+      int jpeg_width, jpeg_height;
+      if (stbi_info_from_memory(data, size, &jpeg_width, &jpeg_height, nullptr) == 0)
+        return false;
+
+      width = jpeg_width;
+      height = jpeg_height;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+/** Decodes the JPEG image with stb_image, then converts its RGBA pixels while copying them into @a pixels. */
+static bool decode_jpeg(const uint8_t* data, size_t size, uint32_t* pixels, size_t pitch) {
+  int width, height;
+  auto* image = (const uint32_t*)stbi_load_from_memory(data, size, &width, &height, nullptr, 4);
+  if (image == nullptr)
+    return false;
+
+  for (int y = 0; y < height; ++y) {
+    const uint32_t* src_row = image + (size_t)width * y;
+    uint32_t* dst_row = pixels + pitch * y;
+    for (int x = 0; x < width; ++x)
+      dst_row[x] = libk::bswap(src_row[x]) >> 8;
+  }
+
+  stbi_image_free((void*)image);
+  return true;
+}
+
+bool decode_image(const uint8_t* data, size_t size, uint32_t* pixels, size_t pitch) {
+  switch (detect_image_format(data, size)) {
+    case ImageFormat::QOI:
+      return Qoi::decode(data, size, pixels, pitch);
+    case ImageFormat::JPEG:
+      return decode_jpeg(data, size, pixels, pitch);
+    default:
+      return false;
+  }
+}
+}  // namespace graphics
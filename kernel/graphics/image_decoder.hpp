@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graphics {
+/**
+ * The decoding of the encoded images (the wallpaper...) into 0x00RRGGBB pixels, the format of the screen and of
+ * the window framebuffers, whatever their format: it is detected from their first bytes, not from the file name.
+ *
+ * The images are decoded by the CPU: QOI (see Qoi) at about the speed of a memory copy, JPEG with stb_image.
+ * This is the single place a hardware decoder would be tried first (the VideoCore one is only reachable through
+ * the VCHIQ and MMAL firmware services, which are not supported).
+ */
+enum class ImageFormat {
+  UNKNOWN,
+  QOI,
+  JPEG,
+};  // enum class ImageFormat
+
+/** Detects the format of the encoded image of @a size bytes at @a data. */
+[[nodiscard]] ImageFormat detect_image_format(const uint8_t* data, size_t size);
+
+/** Reads the size of the encoded image of @a size bytes at @a data. Returns false if its format is unknown. */
+[[nodiscard]] bool read_image_size(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height);
+
+/**
+ * Decodes the image of @a size bytes at @a data into @a pixels, in 0x00RRGGBB format. The rows are @a pitch
+ * pixels apart, @a pixels must hold the whole image (see read_image_size()).
+ * Returns false if the image is invalid, @a pixels is then partially written.
+ */
+[[nodiscard]] bool decode_image(const uint8_t* data, size_t size, uint32_t* pixels, size_t pitch);
+}  // namespace graphics
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <libk/string.hpp>
+
+namespace graphics {
+/**
+ * The pixel formats of the buffers drawn into (see BasicPainter). The colors are given in 0xAARRGGBB format,
+ * a format converts them to its pixels with from_argb() and back with to_argb() (the alpha is not stored).
+ */
+
+/** 32-bits pixels in 0x00RRGGBB format, the format of the window framebuffers. */
+struct PixelFormatXrgb8888 {
+  using Pixel = uint32_t;
+  /** The bits per pixel, as requested to the VideoCore. */
+  static constexpr uint32_t DEPTH = 32;
+
+  [[gnu::always_inline, nodiscard]] static constexpr Pixel from_argb(uint32_t argb) { return argb & 0x00ffffff; }
+  [[gnu::always_inline, nodiscard]] static constexpr uint32_t to_argb(Pixel pixel) { return pixel; }
+};  // struct PixelFormatXrgb8888
+
+/** 16-bits pixels with 5 bits of red, 6 bits of green and 5 bits of blue: half the memory traffic of XRGB8888. */
+struct PixelFormatRgb565 {
+  using Pixel = uint16_t;
+  static constexpr uint32_t DEPTH = 16;
+
+  [[gnu::always_inline, nodiscard]] static constexpr Pixel from_argb(uint32_t argb) {
+    return ((argb >> 8) & 0xf800) | ((argb >> 5) & 0x07e0) | ((argb >> 3) & 0x001f);
+  }
+  [[gnu::always_inline, nodiscard]] static constexpr uint32_t to_argb(Pixel pixel) {
+    // The high bits are replicated into the low ones, so that white stays white.
+    const uint32_t r = (pixel >> 11) & 0x1f;
+    const uint32_t g = (pixel >> 5) & 0x3f;
+    const uint32_t b = pixel & 0x1f;
+    return (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+  }
+};  // struct PixelFormatRgb565
+
+/** Sets the @a count pixels at @a dst to @a pixel. */
+template <class Format>
+void fill_pixels(typename Format::Pixel* dst, typename Format::Pixel pixel, size_t count) {
+  if constexpr (sizeof(typename Format::Pixel) == sizeof(uint32_t)) {
+    libk::memset32(dst, pixel, count);
+  } else {
+    // Two pixels per word, once @a dst is word aligned.
+    if (count > 0 && ((uintptr_t)dst & 0b11) != 0) {
+      *dst++ = pixel;
+      --count;
+    }
+
+    libk::memset32((uint32_t*)dst, pixel | ((uint32_t)pixel << 16), count / 2);
+    if (count % 2 != 0)
+      dst[count - 1] = pixel;
+  }
+}
+
+/** Converts the @a count pixels of @a src, in 0xAARRGGBB format, into @a dst. */
+template <class Format>
+void convert_from_argb(typename Format::Pixel* dst, const uint32_t* src, size_t count) {
+  if constexpr (std::is_same_v<Format, PixelFormatXrgb8888>) {
+    libk::memcpy(dst, src, sizeof(uint32_t) * count);  // the display ignores the alpha byte
+  } else {
+    for (size_t i = 0; i < count; ++i)
+      dst[i] = Format::from_argb(src[i]);
+  }
+}
+}  // namespace graphics
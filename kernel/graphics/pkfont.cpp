@@ -2,30 +2,92 @@
 
 #include <libk/string.hpp>
 
+uint32_t PKFont::get_horizontal_advance(uint32_t code_point) const {
+  if (is_v2()) {
+    const PKF2Glyph* glyph = find_v2_glyph(code_point);
+    if (glyph != nullptr)
+      return glyph->advance != 0 ? glyph->advance : get_horizontal_advance();
+  } else if (get_v1_glyph(code_point) != nullptr) {
+    return get_horizontal_advance();
+  }
+
+  return code_point == ' ' ? get_horizontal_advance() : 0;
+}
+
 uint32_t PKFont::get_horizontal_advance(const char* text, uint32_t length) const {
   if (length == UINT32_MAX) {
     length = libk::strlen(text);
   }
 
-  return get_horizontal_advance() * length;
+  uint32_t advance = 0;
+  uint32_t previous = 0;
+  for (uint32_t i = 0; i < length; ++i) {
+    const uint32_t code_point = (uint8_t)text[i];
+    advance += get_horizontal_advance(code_point) + get_kerning(previous, code_point);
+    previous = code_point;
+  }
+
+  return advance;
 }
 
-uint32_t PKFont::get_width(const char* text, uint32_t length) const {
-  if (length == UINT32_MAX) {
-    length = libk::strlen(text);
+int32_t PKFont::get_kerning(uint32_t left, uint32_t right) const {
+  if (!is_v2())
+    return 0;
+
+  const auto* header = reinterpret_cast<const PKF2Header*>(m_buffer);
+  const auto* ranges = reinterpret_cast<const PKF2Range*>(m_buffer + sizeof(PKF2Header));
+  const auto* glyphs = reinterpret_cast<const PKF2Glyph*>(ranges + header->range_count);
+  const auto* pairs = reinterpret_cast<const PKF2KerningPair*>(glyphs + header->glyph_count);
+
+  // Binary search, the pairs are sorted by (left, right).
+  const uint64_t key = ((uint64_t)left << 32) | right;
+  uint32_t begin = 0;
+  uint32_t end = header->kerning_count;
+  while (begin < end) {
+    const uint32_t middle = begin + (end - begin) / 2;
+    const uint64_t middle_key = ((uint64_t)pairs[middle].left << 32) | pairs[middle].right;
+    if (middle_key == key)
+      return pairs[middle].adjustment;
+
+    if (middle_key < key) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
   }
 
-  return get_char_width() * length;
+  return 0;
 }
 
-const uint8_t* PKFont::get_glyph(char code) const {
-  if (code < FIRST_CHARACTER || code > LAST_CHARACTER)
+bool PKFont::has_glyph(uint32_t code_point) const {
+  if (is_v2())
+    return find_v2_glyph(code_point) != nullptr;
+  return get_v1_glyph(code_point) != nullptr;
+}
+
+const uint8_t* PKFont::get_v1_glyph(uint32_t code_point) const {
+  if (code_point < FIRST_CHARACTER || code_point > LAST_CHARACTER)
     return nullptr;  // the font does not contain this glyph
 
   const uint32_t char_width = get_char_width();
   const uint32_t char_height = get_char_height();
 
-  const uint8_t index = (uint8_t)(code)-FIRST_CHARACTER;
+  const uint32_t index = code_point - FIRST_CHARACTER;
   const uint8_t* offset = m_buffer + sizeof(PKFHeader) + (size_t)((char_width * char_height) * index);
   return offset;
 }
+
+const PKF2Glyph* PKFont::find_v2_glyph(uint32_t code_point) const {
+  const auto* header = reinterpret_cast<const PKF2Header*>(m_buffer);
+  const auto* ranges = reinterpret_cast<const PKF2Range*>(m_buffer + sizeof(PKF2Header));
+  const auto* glyphs = reinterpret_cast<const PKF2Glyph*>(ranges + header->range_count);
+
+  // There are only a few ranges (usually ASCII and some Latin-1 or symbol blocks).
+  for (uint32_t i = 0; i < header->range_count; ++i) {
+    const PKF2Range& range = ranges[i];
+    if (code_point - range.first_code_point < range.count)
+      return &glyphs[range.first_glyph + (code_point - range.first_code_point)];
+  }
+
+  return nullptr;  // the font does not contain this glyph
+}
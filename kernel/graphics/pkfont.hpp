@@ -13,66 +13,172 @@ struct alignas(16) PKFHeader {
   uint32_t line_height;
 };  // struct PKFHeader
 
+/** @brief The first word of a PKF v2 file, "PKF2" in little-endian (never a valid v1 @c char_width). */
+static constexpr uint32_t PKF2_MAGIC = 0x32464b50;
+
+/** @brief The header of a PKF v2 file (see doc/pkf.md), followed by the ranges, the glyphs and their spans. */
+struct alignas(16) PKF2Header {
+  uint32_t magic;
+  /** @brief Number of PKF2Range following the header. */
+  uint32_t range_count;
+  /** @brief Number of PKF2Glyph following the ranges. */
+  uint32_t glyph_count;
+  /** @brief Number of PKF2KerningPair following the glyphs. */
+  uint32_t kerning_count;
+  /** @brief The cell metrics, the same as in a v1 file. */
+  PKFHeader metrics;
+};  // struct PKF2Header
+
+/** @brief A range of consecutive code points, whose glyphs are consecutive in the glyph table. */
+struct PKF2Range {
+  uint32_t first_code_point;
+  uint32_t count;
+  uint32_t first_glyph;
+};  // struct PKF2Range
+
+/** @brief How the spans of a PKF v2 glyph are stored. */
+enum PKF2Encoding : uint8_t {
+  /** @brief Each span is followed by its alpha values. */
+  PKF2_ENCODING_ALPHA = 0,
+  /** @brief All the span pixels are opaque, no alpha value is stored (1-bit glyphs). */
+  PKF2_ENCODING_OPAQUE = 1,
+};  // enum PKF2Encoding
+
+/** @brief A glyph of a PKF v2 file: its bounding box in the character cell and where its spans are. */
+struct PKF2Glyph {
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+  /** @brief A PKF2Encoding. */
+  uint8_t encoding;
+  /** @brief The horizontal advance of the glyph, or 0 for the advance of the header. */
+  uint8_t advance;
+  uint8_t reserved[2];
+  /** @brief Offset of the spans from the start of the file. */
+  uint32_t offset;
+};  // struct PKF2Glyph
+
+/** @brief The advance adjustment between two glyphs, sorted by @a left then @a right code point. */
+struct PKF2KerningPair {
+  uint32_t left;
+  uint32_t right;
+  int32_t adjustment;
+};  // struct PKF2KerningPair
+
 class PKFont {
  public:
-  /** @brief First ASCII character included in the font. */
+  /** @brief First ASCII character included in a v1 font. */
   static constexpr uint8_t FIRST_CHARACTER = 0x21;
-  /** @brief Last ASCII character included in the font. */
+  /** @brief Last ASCII character included in a v1 font. */
   static constexpr uint8_t LAST_CHARACTER = 0x7e;
 
-  /** @brief Creates a PKFont from the given @a buffer.
+  /** @brief Creates a PKFont from the given @a buffer, a v1 or a v2 PKF file.
    *
    * The length of the @a buffer is implicit. Moreover, this function expect
    * the @a buffer is well-defined (the function is not safe). */
   constexpr PKFont(const uint8_t* buffer) : m_buffer(buffer) {}
 
+  /** @brief Gets the buffer the font was created from (two fonts are the same if they have the same buffer). */
+  [[nodiscard]] const uint8_t* get_buffer() const { return m_buffer; }
+
+  /** @brief Checks if the font is in the PKF v2 format. */
+  [[nodiscard]] bool is_v2() const { return *reinterpret_cast<const uint32_t*>(m_buffer) == PKF2_MAGIC; }
+
   /** @brief Gets the width of a character in pixels.
    *
    * Access the @c char_width field of the header. */
-  [[nodiscard]] uint32_t get_char_width() const { return reinterpret_cast<const PKFHeader*>(m_buffer)->char_width; }
+  [[nodiscard]] uint32_t get_char_width() const { return get_metrics()->char_width; }
   /** @brief Gets the height of a character in pixels.
    *
    * Access the @c char_height field of the header. */
-  [[nodiscard]] uint32_t get_char_height() const { return reinterpret_cast<const PKFHeader*>(m_buffer)->char_height; }
+  [[nodiscard]] uint32_t get_char_height() const { return get_metrics()->char_height; }
   /** @brief Access the @c line_height field of the header. */
-  [[nodiscard]] uint32_t get_line_height() const { return reinterpret_cast<const PKFHeader*>(m_buffer)->line_height; }
+  [[nodiscard]] uint32_t get_line_height() const { return get_metrics()->line_height; }
 
-  /** @brief Returns the horizontal advance of a character in pixels.
+  /** @brief Returns the default horizontal advance of a character in pixels.
    *
-   * This is a distance appropriate for drawing a subsequent character after @a ch.
+   * This is a distance appropriate for drawing a subsequent character after a character.
    *
    * Access the @c advance field of the header. */
-  [[nodiscard]] uint32_t get_horizontal_advance() const {
-    return reinterpret_cast<const PKFHeader*>(m_buffer)->advance;
-  }
+  [[nodiscard]] uint32_t get_horizontal_advance() const { return get_metrics()->advance; }
 
-  /** @brief Returns the horizontal advance of character @a ch in pixels.
+  /** @brief Returns the horizontal advance of the character @a code_point in pixels.
    *
-   * This is a distance appropriate for drawing a subsequent character after @a ch.
+   * This is a distance appropriate for drawing a subsequent character after @a code_point (without kerning,
+   * see get_kerning()). The v1 fonts are monospace, and the v2 fonts store an advance per glyph. The space
+   * advances by the default advance if it has no glyph, the other characters without a glyph do not advance
+   * (as drawn by Painter::draw_text()). */
+  [[nodiscard]] uint32_t get_horizontal_advance(uint32_t code_point) const;
+  /** @brief Returns the horizontal advance of @a text in pixels, kerning included.
    *
-   * For monospace fonts (like PKF by default), the advance is the same for all characters. */
-  [[nodiscard]] uint32_t get_horizontal_advance(char ch [[maybe_unused]]) const { return get_horizontal_advance(); }
-  /** @brief Returns the horizontal advance of @a text in pixels.
-   *
-   * This is a distance appropriate for drawing a subsequent character after @a text.
+   * This is a distance appropriate for drawing a subsequent character after @a text, laid out on a single line.
+   * It walks the whole text, see TextWidthCache for the texts measured repeatedly.
    *
    * If @a length is UINT32_MAX, the @a text is assumed to be NUL-terminated. */
   [[nodiscard]] uint32_t get_horizontal_advance(const char* text, uint32_t length = UINT32_MAX) const;
 
-  /** @brief Returns the width of @a text in pixels.
-   *
-   * If @a length is UINT32_MAX, the @a text is assumed to be NUL-terminated. */
-  [[nodiscard]] uint32_t get_width(const char* text, uint32_t length = UINT32_MAX) const;
+  /** @brief Returns the adjustment, in pixels, of the advance between the characters @a left and @a right
+   * (0 for the v1 fonts, which have no kerning). */
+  [[nodiscard]] int32_t get_kerning(uint32_t left, uint32_t right) const;
 
-  /** @brief Returns the glyph alpha map corresponding of ASCII character @a code.
-   *
-   * A NULL pointer is returned if the glyph doesnt exist or is not supported by the font.
+  /** @brief Checks if the font has a glyph for @a code_point. */
+  [[nodiscard]] bool has_glyph(uint32_t code_point) const;
+
+  /** @brief Calls @a callback(x, y, alphas, length) for each span of non-transparent pixels of the glyph of
+   * @a code_point (nothing if the font has no such glyph).
    *
-   * The returned alpha map is a 2D matrix of uint8_t (alpha component, 0 = transparent, 255 = opaque),
-   * in row-major format. To access the alpha at (x,y), you query it with `buffer[x + char_width * y]`.
-   */
-  [[nodiscard]] const uint8_t* get_glyph(char code) const;
+   * A span is a horizontal run of @a length pixels starting at (@a x, @a y) in the character cell, whose
+   * alpha values (0 = transparent, 255 = opaque) are @a alphas, or nullptr if they are all opaque. The
+   * spans are given row by row, from left to right. The v1 glyphs have a single span per row, which may
+   * include transparent pixels. */
+  template <class F>
+  void for_each_span(uint32_t code_point, F callback) const {
+    if (!is_v2()) {
+      const uint8_t* glyph = get_v1_glyph(code_point);
+      if (glyph == nullptr)
+        return;
+
+      const uint32_t char_width = get_char_width();
+      for (uint32_t j = 0; j < get_char_height(); ++j)
+        callback(0, j, glyph + char_width * j, char_width);
+      return;
+    }
+
+    const PKF2Glyph* glyph = find_v2_glyph(code_point);
+    if (glyph == nullptr)
+      return;
+
+    // Each row is a span count, then (skip, length) pairs, each followed by the alpha values if not opaque.
+    const bool is_opaque = glyph->encoding == PKF2_ENCODING_OPAQUE;
+    const uint8_t* data = m_buffer + glyph->offset;
+    for (uint32_t j = 0; j < glyph->height; ++j) {
+      uint32_t x = glyph->x;
+      for (uint32_t span_count = *data++; span_count > 0; --span_count) {
+        x += data[0];
+        const uint32_t length = data[1];
+        data += 2;
+
+        callback(x, glyph->y + j, is_opaque ? nullptr : data, length);
+        if (!is_opaque)
+          data += length;
+        x += length;
+      }
+    }
+  }
 
  private:
+  [[nodiscard]] const PKFHeader* get_metrics() const {
+    if (is_v2())
+      return &reinterpret_cast<const PKF2Header*>(m_buffer)->metrics;
+    return reinterpret_cast<const PKFHeader*>(m_buffer);
+  }
+
+  /** @brief Returns the alpha map of the glyph of @a code_point in a v1 font (a row-major matrix of
+   * char_width x char_height alpha values), or nullptr if the font does not contain it. */
+  [[nodiscard]] const uint8_t* get_v1_glyph(uint32_t code_point) const;
+  /** @brief Returns the glyph of @a code_point in a v2 font, or nullptr if the font does not contain it. */
+  [[nodiscard]] const PKF2Glyph* find_v2_glyph(uint32_t code_point) const;
+
   const uint8_t* m_buffer;
 };  // class PKFont
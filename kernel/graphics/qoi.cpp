@@ -0,0 +1,97 @@
+#include "graphics/qoi.hpp"
+
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+namespace graphics::Qoi {
+static constexpr uint8_t OP_INDEX = 0x00;  // 00xxxxxx
+static constexpr uint8_t OP_DIFF = 0x40;   // 01xxxxxx
+static constexpr uint8_t OP_LUMA = 0x80;   // 10xxxxxx
+static constexpr uint8_t OP_RUN = 0xc0;    // 11xxxxxx
+static constexpr uint8_t OP_RGB = 0xfe;
+static constexpr uint8_t OP_RGBA = 0xff;
+static constexpr uint8_t OP_MASK = 0xc0;
+
+// The limit of the specification, so that the decoded size fits in 32-bits with 4 channels.
+static constexpr uint64_t MAX_PIXEL_COUNT = 400'000'000;
+
+static uint32_t read_be32(const uint8_t* data) {
+  return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+bool read_header(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height) {
+  if (size < HEADER_SIZE + END_MARKER_SIZE || libk::memcmp(data, "qoif", 4) != 0)
+    return false;
+
+  width = read_be32(data + 4);
+  height = read_be32(data + 8);
+  const uint8_t channels = data[12];
+  return width != 0 && height != 0 && (uint64_t)width * height <= MAX_PIXEL_COUNT && (channels == 3 || channels == 4);
+}
+
+bool decode(const uint8_t* data, size_t size, uint32_t* pixels, size_t pitch) {
+  uint32_t width, height;
+  if (!read_header(data, size, width, height))
+    return false;
+
+  // The previous pixel and the 64 recently seen ones, as 0xAARRGGBB words.
+  uint32_t index[64] = {};
+  uint32_t r = 0, g = 0, b = 0, a = 0xff;
+  uint32_t run = 0;
+
+  const uint8_t* it = data + HEADER_SIZE;
+  // The ops are at most 5 bytes long, the end marker is never part of them.
+  const uint8_t* const end = data + size - END_MARKER_SIZE;
+  for (uint32_t y = 0; y < height; ++y) {
+    uint32_t* row = pixels + pitch * y;
+    for (uint32_t x = 0; x < width; ++x) {
+      if (run > 0) {
+        --run;
+      } else {
+        if (it >= end)
+          return false;
+
+        const uint8_t op = *it++;
+        if (op == OP_RGB || op == OP_RGBA) {
+          if (end - it < (op == OP_RGB ? 3 : 4))
+            return false;
+
+          r = it[0];
+          g = it[1];
+          b = it[2];
+          if (op == OP_RGBA)
+            a = it[3];
+          it += op == OP_RGB ? 3 : 4;
+        } else if ((op & OP_MASK) == OP_INDEX) {
+          const uint32_t argb = index[op];
+          a = argb >> 24;
+          r = (argb >> 16) & 0xff;
+          g = (argb >> 8) & 0xff;
+          b = argb & 0xff;
+        } else if ((op & OP_MASK) == OP_DIFF) {
+          r = (r + ((op >> 4) & 0b11) - 2) & 0xff;
+          g = (g + ((op >> 2) & 0b11) - 2) & 0xff;
+          b = (b + (op & 0b11) - 2) & 0xff;
+        } else if ((op & OP_MASK) == OP_LUMA) {
+          if (it == end)
+            return false;
+
+          const uint8_t next = *it++;
+          const uint32_t dg = (op & 0x3f) - 32;
+          r = (r + dg + (next >> 4) - 8) & 0xff;
+          g = (g + dg) & 0xff;
+          b = (b + dg + (next & 0x0f) - 8) & 0xff;
+        } else {  // OP_RUN, the current pixel is repeated
+          run = op & 0x3f;
+        }
+
+        index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = (a << 24) | (r << 16) | (g << 8) | b;
+      }
+
+      row[x] = (r << 16) | (g << 8) | b;
+    }
+  }
+
+  return true;
+}
+}  // namespace graphics::Qoi
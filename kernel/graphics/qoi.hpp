@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graphics {
+/**
+ * A decoder of the QOI images (the "Quite OK Image" format, https://qoiformat.org/qoi-specification.pdf).
+ *
+ * QOI compresses less than JPEG, but it is lossless and decoded in a single pass with a few operations per pixel:
+ * about the speed of a memory copy, where stb_image spends seconds on a big JPEG. The images are converted at
+ * build time (see tools/img2qoi.py) and decoded directly into 0x00RRGGBB pixels, the format of the screen and of
+ * the window framebuffers.
+ */
+namespace Qoi {
+/** The byte size of the header, and of the end marker. */
+static constexpr size_t HEADER_SIZE = 14;
+static constexpr size_t END_MARKER_SIZE = 8;
+
+/** Reads the size of the QOI image of @a size bytes at @a data. Returns false if it is not a QOI image. */
+[[nodiscard]] bool read_header(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height);
+
+/**
+ * Decodes the QOI image of @a size bytes at @a data into @a pixels, in 0x00RRGGBB format (the alpha channel is
+ * dropped). The rows are @a pitch pixels apart, @a pixels must hold the whole image (see read_header()).
+ * Returns false if the image is invalid or truncated, @a pixels is then partially written.
+ */
+[[nodiscard]] bool decode(const uint8_t* data, size_t size, uint32_t* pixels, size_t pitch);
+}  // namespace Qoi
+}  // namespace graphics
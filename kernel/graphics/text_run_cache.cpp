@@ -0,0 +1,167 @@
+#include "graphics/text_run_cache.hpp"
+
+#include <new>
+
+#include <libk/hash.hpp>
+#include <libk/intrusive_list.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "memory/mem_alloc.hpp"
+
+namespace graphics::TextRunCache {
+// The entry, the text copy and the alpha map are a single allocation.
+struct Entry {
+  libk::IntrusiveListHook hook;
+  uint64_t hash;
+  const uint8_t* font;
+  int32_t w;
+  size_t length;
+  size_t byte_size;
+  const char* text;
+  TextRun run;
+
+  [[nodiscard]] bool is_same(const uint8_t* other_font, int32_t other_w, const char* other_text, size_t other_length,
+                             uint64_t other_hash) const {
+    return hash == other_hash && font == other_font && w == other_w && length == other_length &&
+           libk::memcmp(text, other_text, length) == 0;
+  }
+};  // struct Entry
+
+// There are only a few labels drawn at each frame, a list is enough (the most recently used first).
+static libk::IntrusiveList<Entry, &Entry::hook> g_entries;
+static size_t g_memory = 0;
+
+/** Calls @a callback(x, y, code_point) for each glyph of @a text, laid out the same as Painter::draw_text() (relative
+ * to the text origin). Returns the X coordinate after the last character. */
+template <class F>
+static uint32_t layout(PKFont font, int32_t w, const char* text, F callback) {
+  uint32_t current_x = 0;
+  uint32_t current_y = 0;
+
+  const uint32_t char_width = font.get_char_width();
+  const uint32_t line_height = font.get_line_height();
+
+  uint32_t previous = 0;  // the previous character on the line, for kerning
+  for (const char* it = text; *it != '\0'; ++it) {
+    const uint32_t ch = (uint8_t)*it;
+
+    if (font.has_glyph(ch)) {
+      current_x += font.get_kerning(previous, ch);
+
+      // If the character does not fit in the line, then start a new line.
+      if (current_x + char_width >= (uint32_t)w) {
+        current_x = 0;
+        current_y += line_height;
+      }
+
+      callback(current_x, current_y, ch);
+      current_x += font.get_horizontal_advance(ch);
+      previous = ch;
+    } else if (ch == ' ') {
+      current_x += font.get_horizontal_advance(ch);
+      previous = ch;
+    } else if (ch == '\n') {
+      current_x = 0;
+      current_y += line_height;
+      previous = 0;
+    }
+  }
+
+  return current_x;
+}
+
+static void evict(Entry* entry) {
+  g_entries.remove(entry);
+  g_memory -= entry->byte_size;
+  entry->~Entry();
+  kfree(entry);
+}
+
+static Entry* render(PKFont font, int32_t w, const char* text, size_t length, uint64_t hash) {
+  const uint32_t char_width = font.get_char_width();
+  const uint32_t char_height = font.get_char_height();
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  const uint32_t end_x = layout(font, w, text, [&](uint32_t x, uint32_t y, uint32_t) {
+    width = libk::max(width, x + char_width);
+    height = libk::max(height, y + char_height);
+  });
+
+  const size_t map_size = (size_t)width * height;
+  const size_t byte_size = sizeof(Entry) + length + map_size;
+  if (map_size == 0 || byte_size > MAX_MEMORY)
+    return nullptr;
+
+  while (g_memory + byte_size > MAX_MEMORY)
+    evict(g_entries.back());
+
+  auto* memory = (uint8_t*)kmalloc(byte_size, alignof(Entry));
+  if (memory == nullptr)
+    return nullptr;
+
+  auto* text_copy = (char*)(memory + sizeof(Entry));
+  libk::memcpy(text_copy, text, length);
+  auto* alpha_map = (uint8_t*)(text_copy + length);
+  libk::bzero(alpha_map, map_size);
+
+  // Compose the overlapping glyphs: a = a1 + a2 * (1 - a1), what blending them one after the other gives.
+  // Only the spans of the glyphs are composed, the transparent pixels of the v2 glyphs are not stored.
+  layout(font, w, text, [&](uint32_t x, uint32_t y, uint32_t code_point) {
+    font.for_each_span(code_point, [&](uint32_t i, uint32_t j, const uint8_t* alphas, uint32_t length) {
+      uint8_t* row = alpha_map + (x + i) + width * (y + j);
+      if (alphas == nullptr) {
+        libk::memset(row, 0xff, length);
+        return;
+      }
+
+      for (uint32_t k = 0; k < length; ++k)
+        row[k] = alphas[k] + (row[k] * (255 - alphas[k])) / 255;
+    });
+  });
+
+  auto* entry = new (memory) Entry{};
+  entry->hash = hash;
+  entry->font = font.get_buffer();
+  entry->w = w;
+  entry->length = length;
+  entry->byte_size = byte_size;
+  entry->text = text_copy;
+  entry->run = {width, height, end_x, alpha_map};
+
+  g_entries.push_front(entry);
+  g_memory += byte_size;
+  return entry;
+}
+
+size_t shrink(size_t byte_size) {
+  size_t freed_byte_size = 0;
+  while (freed_byte_size < byte_size && !g_entries.is_empty()) {
+    Entry* entry = g_entries.back();
+    freed_byte_size += entry->byte_size;
+    evict(entry);
+  }
+
+  return freed_byte_size;
+}
+
+const TextRun* get(PKFont font, int32_t w, const char* text) {
+  const size_t length = libk::strlen(text);
+  if (length < MIN_TEXT_LENGTH)
+    return nullptr;
+
+  const uint64_t hash = libk::hash((const uint8_t*)text, length);
+  for (Entry* entry = g_entries.front(); entry != nullptr; entry = g_entries.next(entry)) {
+    if (entry->is_same(font.get_buffer(), w, text, length, hash)) {
+      // Move it to the front, so the least recently used runs are at the back.
+      g_entries.remove(entry);
+      g_entries.push_front(entry);
+      return &entry->run;
+    }
+  }
+
+  Entry* entry = render(font, w, text, length, hash);
+  return entry != nullptr ? &entry->run : nullptr;
+}
+}  // namespace graphics::TextRunCache
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "graphics/pkfont.hpp"
+
+namespace graphics {
+/** A text rendered once into a single alpha map (same format as the PKFont glyphs). */
+struct TextRun {
+  uint32_t width;
+  uint32_t height;
+  // The X coordinate after the last character, relative to the run origin.
+  uint32_t end_x;
+  const uint8_t* alpha_map;
+};  // struct TextRun
+
+/**
+ * A cache of the recently drawn texts, keyed by font, wrapping width and string.
+ *
+ * The glyphs of a run are composed once (the same as drawing them one after the other with a
+ * single color), so the run does not depend on the text color and a repeated label is then drawn
+ * by a single alpha map pass instead of walking and blending each character.
+ *
+ * The cache memory is bounded, the least recently used runs are evicted first.
+ */
+namespace TextRunCache {
+/** Texts shorter than this are drawn glyph by glyph, the lookup is not worth it. */
+static constexpr size_t MIN_TEXT_LENGTH = 4;
+/** The maximum memory used by the cached runs, in bytes. */
+static constexpr size_t MAX_MEMORY = 256 * 1024;
+
+/**
+ * Gets the run of @a text, laid out as Painter::draw_text() does for the wrapping width @a w.
+ *
+ * Returns nullptr if the text is not cached (too small, too big or out of memory). The run stays
+ * valid until the next call.
+ */
+[[nodiscard]] const TextRun* get(PKFont font, int32_t w, const char* text);
+
+/** Evicts the least recently used runs until @a byte_size bytes are freed (or the cache is empty). Returns the
+ * count of bytes freed, see MemoryPressure::Shrinker. */
+size_t shrink(size_t byte_size);
+};  // namespace TextRunCache
+};  // namespace graphics
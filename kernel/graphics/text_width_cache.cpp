@@ -0,0 +1,28 @@
+#include "graphics/text_width_cache.hpp"
+
+#include <libk/hash.hpp>
+#include <libk/string.hpp>
+
+namespace graphics::TextWidthCache {
+struct Entry {
+  const uint8_t* font;
+  uint64_t hash;
+  uint32_t length;
+  uint32_t width;
+};  // struct Entry
+
+static Entry g_entries[SIZE] = {};
+
+uint32_t get(PKFont font, const char* text, uint32_t length) {
+  if (length == UINT32_MAX)
+    length = libk::strlen(text);
+
+  const uint64_t hash = libk::hash((const uint8_t*)text, length);
+  Entry& entry = g_entries[hash % SIZE];
+  if (entry.font == font.get_buffer() && entry.hash == hash && entry.length == length)
+    return entry.width;
+
+  entry = {font.get_buffer(), hash, length, font.get_horizontal_advance(text, length)};
+  return entry.width;
+}
+}  // namespace graphics::TextWidthCache
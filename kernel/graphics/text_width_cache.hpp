@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "graphics/pkfont.hpp"
+
+namespace graphics {
+/**
+ * A cache of the widths of the recently measured texts (see PKFont::get_horizontal_advance()), keyed by font and
+ * string hash.
+ *
+ * The window titles and the labels are measured at each frame to be laid out, but rarely change. With per-glyph
+ * advances and kerning, measuring a text walks all its characters and searches the kerning table for each pair,
+ * so the widths are kept instead.
+ *
+ * The cache is a small direct-mapped table: a new text replaces the one of its slot. The texts are not stored,
+ * two texts of the same font, length and 64-bit hash are considered the same.
+ */
+namespace TextWidthCache {
+/** The number of cached widths. */
+static constexpr size_t SIZE = 64;
+
+/** Returns the horizontal advance of the @a length first characters of @a text (see
+ * PKFont::get_horizontal_advance(const char*, uint32_t)), measured only if not cached. */
+[[nodiscard]] uint32_t get(PKFont font, const char* text, uint32_t length = UINT32_MAX);
+};  // namespace TextWidthCache
+};  // namespace graphics
@@ -0,0 +1,288 @@
+#include "graphics/thumbnail_cache.hpp"
+
+#include <sys/file.h>
+
+#include <libk/hash.hpp>
+#include <libk/linked_list.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "fs/file.hpp"
+#include "fs/filesystem.hpp"
+#include "graphics/image_decoder.hpp"
+#include "memory/mem_alloc.hpp"
+#include "memory/memory_chunk.hpp"
+
+namespace graphics::ThumbnailCache {
+struct Entry {
+  uint64_t digest;
+  size_t page_count;
+  Thumbnail thumbnail;
+};  // struct Entry
+
+// The most recently used thumbnails first.
+static libk::LinkedList<Entry> g_entries;
+static size_t g_entry_count = 0;
+static size_t g_page_count = 0;
+
+static size_t get_page_count(uint32_t width, uint32_t height) {
+  return libk::div_round_up(sizeof(uint32_t) * width * height, MemoryChunk::get_page_byte_size());
+}
+
+/** Allocates the chunk of a @a width x @a height thumbnail, the end of its last page zeroed (it is visible to the
+ * processes mapping it). */
+static libk::SharedPointer<MemoryChunk> allocate_chunk(uint32_t width, uint32_t height) {
+  const size_t nb_pages = get_page_count(width, height);
+  auto chunk = libk::make_shared<MemoryChunk>(nb_pages, false);
+  if (!chunk || !chunk->is_status_okay())
+    return nullptr;
+
+  const size_t byte_size = sizeof(uint32_t) * width * height;
+  libk::bzero((uint8_t*)chunk->get() + byte_size, nb_pages * MemoryChunk::get_page_byte_size() - byte_size);
+  return chunk;
+}
+
+/** Computes the size of a @a width x @a height image fitting the @a max_width x @a max_height box. */
+static void fit_size(uint32_t width, uint32_t height, uint32_t max_width, uint32_t max_height, Thumbnail& thumbnail) {
+  if (width <= max_width && height <= max_height) {
+    thumbnail.width = width;
+    thumbnail.height = height;
+  } else if ((uint64_t)max_width * height <= (uint64_t)max_height * width) {
+    thumbnail.width = max_width;
+    thumbnail.height = libk::max<uint32_t>(1, (uint64_t)height * max_width / width);
+  } else {
+    thumbnail.width = libk::max<uint32_t>(1, (uint64_t)width * max_height / height);
+    thumbnail.height = max_height;
+  }
+}
+
+/** Scales the @a src_width x @a src_height pixels of @a src down to the thumbnail size, each pixel being the average of
+ * the source pixels it covers (a box filter: unlike the nearest neighbor, the fine details do not alias). */
+static void scale_down(const uint32_t* src, uint32_t src_width, uint32_t src_height, uint32_t* dst,
+                       const Thumbnail& thumbnail) {
+  for (uint32_t y = 0; y < thumbnail.height; ++y) {
+    const uint32_t y_begin = (uint64_t)y * src_height / thumbnail.height;
+    const uint32_t y_end = libk::max<uint32_t>(y_begin + 1, (uint64_t)(y + 1) * src_height / thumbnail.height);
+    for (uint32_t x = 0; x < thumbnail.width; ++x) {
+      const uint32_t x_begin = (uint64_t)x * src_width / thumbnail.width;
+      const uint32_t x_end = libk::max<uint32_t>(x_begin + 1, (uint64_t)(x + 1) * src_width / thumbnail.width);
+
+      uint64_t r = 0, g = 0, b = 0;
+      for (uint32_t j = y_begin; j < y_end; ++j) {
+        const uint32_t* row = src + (size_t)src_width * j;
+        for (uint32_t i = x_begin; i < x_end; ++i) {
+          r += (row[i] >> 16) & 0xff;
+          g += (row[i] >> 8) & 0xff;
+          b += row[i] & 0xff;
+        }
+      }
+
+      const uint64_t count = (uint64_t)(x_end - x_begin) * (y_end - y_begin);
+      dst[(size_t)thumbnail.width * y + x] = ((r / count) << 16) | ((g / count) << 8) | (b / count);
+    }
+  }
+}
+
+/** Decodes the image @a file and scales it down into the thumbnail chunk. */
+static bool decode(File* file, uint32_t max_width, uint32_t max_height, Thumbnail& thumbnail) {
+  const size_t size = file->get_size();
+  if (size == 0)
+    return false;
+
+  // A file stored contiguously in the ramdisk is decoded in place.
+  const auto* data = (const uint8_t*)file->get_data();
+  uint8_t* buffer = nullptr;
+  if (data == nullptr) {
+    buffer = (uint8_t*)kmalloc(size, alignof(max_align_t));
+    size_t read_bytes = 0;
+    if (buffer == nullptr || !file->read(buffer, size, &read_bytes) || read_bytes != size) {
+      kfree(buffer);
+      return false;
+    }
+
+    data = buffer;
+  }
+
+  bool is_ok = false;
+  uint32_t width, height;
+  if (read_image_size(data, size, width, height) && width > 0 && height > 0 &&
+      (uint64_t)width * height <= MAX_IMAGE_PIXEL_COUNT) {
+    fit_size(width, height, max_width, max_height, thumbnail);
+    thumbnail.chunk = allocate_chunk(thumbnail.width, thumbnail.height);
+
+    if (!thumbnail.chunk) {
+      is_ok = false;
+    } else if (thumbnail.width == width && thumbnail.height == height) {
+      // Small enough, decoded directly into the chunk.
+      is_ok = decode_image(data, size, (uint32_t*)thumbnail.chunk->get(), width);
+    } else {
+      auto* image = (uint32_t*)kmalloc(sizeof(uint32_t) * width * height, alignof(max_align_t));
+      is_ok = image != nullptr && decode_image(data, size, image, width);
+      if (is_ok)
+        scale_down(image, width, height, (uint32_t*)thumbnail.chunk->get(), thumbnail);
+      kfree(image);
+    }
+  }
+
+  kfree(buffer);
+  return is_ok;
+}
+
+#if !FF_FS_READONLY
+/*
+ * The stored thumbnails: a StoredHeader followed by the pixels, in "<THUMBNAIL_DIRECTORY>/<digest>.thb".
+ */
+
+struct StoredHeader {
+  char magic[4];  // STORED_MAGIC
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;  // 0
+  uint64_t digest;
+};  // struct StoredHeader
+
+static constexpr char STORED_MAGIC[4] = {'P', 'K', 'T', 'H'};
+static constexpr size_t STORED_PATH_SIZE = 64;
+
+static void get_stored_path(uint64_t digest, char (&path)[STORED_PATH_SIZE]) {
+  const size_t length = libk::strlen(THUMBNAIL_DIRECTORY);
+  libk::memcpy(path, THUMBNAIL_DIRECTORY, length);
+  path[length] = '/';
+  for (size_t i = 0; i < 16; ++i)
+    path[length + 1 + i] = "0123456789abcdef"[(digest >> (60 - 4 * i)) & 0xf];
+  libk::memcpy(path + length + 17, ".thb", sizeof(".thb"));
+}
+
+/** Reads the stored thumbnail @a digest, if any. It is trusted only if its size is the expected one. */
+static bool load_stored(uint64_t digest, uint32_t max_width, uint32_t max_height, Thumbnail& thumbnail) {
+  char path[STORED_PATH_SIZE];
+  get_stored_path(digest, path);
+  File* file = FileSystem::get().open(path, SYS_FM_READ);
+  if (file == nullptr)
+    return false;
+
+  StoredHeader header;
+  size_t read_bytes = 0;
+  bool is_ok = file->read(&header, sizeof(header), &read_bytes) && read_bytes == sizeof(header) &&
+               libk::memcmp(header.magic, STORED_MAGIC, sizeof(STORED_MAGIC)) == 0 && header.digest == digest &&
+               header.width > 0 && header.width <= max_width && header.height > 0 && header.height <= max_height &&
+               file->get_size() == sizeof(header) + sizeof(uint32_t) * header.width * header.height;
+
+  if (is_ok) {
+    thumbnail.width = header.width;
+    thumbnail.height = header.height;
+    thumbnail.chunk = allocate_chunk(header.width, header.height);
+    const size_t byte_size = sizeof(uint32_t) * header.width * header.height;
+    is_ok = thumbnail.chunk && file->read(thumbnail.chunk->get(), byte_size, &read_bytes) && read_bytes == byte_size;
+  }
+
+  FileSystem::get().close(file);
+  return is_ok;
+}
+
+/** Stores the thumbnail @a digest, written to the SD card by the periodic sync (see FileSystem::sync()). */
+static void store(uint64_t digest, const Thumbnail& thumbnail) {
+  const FRESULT result = f_mkdir(THUMBNAIL_DIRECTORY);
+  if (result != FR_OK && result != FR_EXIST)
+    return;  // no SD card
+
+  char path[STORED_PATH_SIZE];
+  get_stored_path(digest, path);
+  File* file = FileSystem::get().open(path, SYS_FM_WRITE | SYS_FM_TRUNCATE);
+  if (file == nullptr)
+    return;
+
+  const StoredHeader header = {
+      {STORED_MAGIC[0], STORED_MAGIC[1], STORED_MAGIC[2], STORED_MAGIC[3]}, thumbnail.width, thumbnail.height, 0,
+      digest};
+  const size_t byte_size = sizeof(uint32_t) * thumbnail.width * thumbnail.height;
+  size_t wrote_bytes = 0;
+  const bool is_ok = file->write(&header, sizeof(header), &wrote_bytes) && wrote_bytes == sizeof(header) &&
+                     file->write(thumbnail.chunk->get(), byte_size, &wrote_bytes) && wrote_bytes == byte_size;
+
+  // A partial thumbnail would be rejected by its size when read, it is emptied anyway.
+  if (!is_ok) {
+    file->seek(0);
+    file->truncate();
+  }
+
+  FileSystem::get().close(file);
+}
+#endif  // !FF_FS_READONLY
+
+size_t shrink(size_t byte_size) {
+  const auto page_size = MemoryChunk::get_page_byte_size();
+
+  // The chunks still mapped by a process would not be freed.
+  size_t freed_byte_size = 0;
+  // From the least recently used thumbnail (the last node), stepping back past the first one gives end().
+  auto it = g_entries.rbegin().base();
+  while (freed_byte_size < byte_size && it != g_entries.end()) {
+    auto current = it--;
+    if (!current->thumbnail.chunk.is_unique())
+      continue;
+
+    freed_byte_size += current->page_count * page_size;
+    g_page_count -= current->page_count;
+    --g_entry_count;
+    g_entries.erase(current);
+  }
+
+  return freed_byte_size;
+}
+
+bool get(const char* path, uint32_t max_width, uint32_t max_height, Thumbnail& thumbnail) {
+  max_width = libk::min(max_width, MAX_SIZE);
+  max_height = libk::min(max_height, MAX_SIZE);
+  if (max_width == 0 || max_height == 0)
+    return false;
+
+  FILINFO file_info;
+  if (f_stat(path, &file_info) != FR_OK || (file_info.fattrib & AM_DIR) != 0)
+    return false;
+
+  const uint64_t digest = libk::hash_multiple(path, (uint64_t)file_info.fsize, file_info.fdate, file_info.ftime,
+                                              max_width, max_height);
+  for (auto it = g_entries.begin(); it != g_entries.end(); ++it) {
+    if (it->digest == digest) {
+      const Entry entry = *it;
+      g_entries.erase(it);
+      g_entries.push_front(entry);
+      thumbnail = entry.thumbnail;
+      return true;
+    }
+  }
+
+  bool is_ok = false;
+#if !FF_FS_READONLY
+  is_ok = load_stored(digest, max_width, max_height, thumbnail);
+#endif  // !FF_FS_READONLY
+
+  if (!is_ok) {
+    File* file = FileSystem::get().open(path, SYS_FM_READ);
+    if (file == nullptr)
+      return false;
+
+    is_ok = decode(file, max_width, max_height, thumbnail);
+    FileSystem::get().close(file);
+    if (!is_ok)
+      return false;
+
+#if !FF_FS_READONLY
+    store(digest, thumbnail);
+#endif  // !FF_FS_READONLY
+  }
+
+  // Any thumbnail fits in the cache (see MAX_SIZE).
+  const size_t page_count = get_page_count(thumbnail.width, thumbnail.height);
+  while (g_entry_count == MAX_THUMBNAIL_COUNT || g_page_count + page_count > MAX_PAGE_COUNT) {
+    g_page_count -= g_entries.pop_back().page_count;
+    --g_entry_count;
+  }
+
+  g_entries.push_front({digest, page_count, thumbnail});
+  ++g_entry_count;
+  g_page_count += page_count;
+  return true;
+}
+}  // namespace graphics::ThumbnailCache
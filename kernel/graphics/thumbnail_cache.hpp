@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+
+class MemoryChunk;
+
+namespace graphics {
+/**
+ * A cache of the decoded and scaled down images (the previews of the file explorer...), shared read-only by the
+ * processes asking for them (see SYS_GET_THUMBNAIL).
+ *
+ * A thumbnail is identified by a digest of the image path, size and modification timestamp (as the program files in
+ * SegmentCache) and of the box it fits in: a modified image is decoded again. It is decoded and scaled once, into a
+ * memory chunk mapped by all the processes showing it.
+ *
+ * With CONFIG_WRITABLE_FS, the thumbnails are also stored on the SD card (in THUMBNAIL_DIRECTORY, named after their
+ * digest) and read from there after a reboot instead of decoding the image again.
+ * The count of cached pages is bounded, the least recently used thumbnails are evicted first (the processes still
+ * mapping them keep their chunk).
+ */
+namespace ThumbnailCache {
+/** The maximum count of pages of the cached thumbnails. */
+static constexpr size_t MAX_PAGE_COUNT = 1024;
+static constexpr size_t MAX_THUMBNAIL_COUNT = 64;
+/** The largest thumbnail width and height, the boxes asked for are clamped to it. */
+static constexpr uint32_t MAX_SIZE = 512;
+/** The largest image decoded, in pixels (it is decoded whole before being scaled). */
+static constexpr uint64_t MAX_IMAGE_PIXEL_COUNT = 16 * 1024 * 1024;
+/** Where the thumbnails are stored, with CONFIG_WRITABLE_FS. */
+static constexpr const char* THUMBNAIL_DIRECTORY = "1:/thumbs";
+
+struct Thumbnail {
+  // The width x height pixels in 0x00RRGGBB format, the rows without padding, zero padded to the end of the last page.
+  libk::SharedPointer<MemoryChunk> chunk;
+  uint32_t width;
+  uint32_t height;
+};  // struct Thumbnail
+
+/**
+ * Gets the thumbnail of the image at @a path (see graphics::decode_image() for the formats), scaled down to fit a
+ * @a max_width x @a max_height box while keeping its aspect ratio (the smaller images are not scaled).
+ * Returns false if the file is not an image, can not be read or if out of memory.
+ */
+[[nodiscard]] bool get(const char* path, uint32_t max_width, uint32_t max_height, Thumbnail& thumbnail);
+
+/** Evicts the least recently used thumbnails not mapped by any process until @a byte_size bytes are freed (or there
+ * is none left). Returns the count of bytes freed, see MemoryPressure::Shrinker. */
+size_t shrink(size_t byte_size);
+};  // namespace ThumbnailCache
+};  // namespace graphics
@@ -0,0 +1,117 @@
+#include "cpufreq.hpp"
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "hardware/device.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+
+namespace CpuFreq {
+static Stats g_stats = {};
+static uint64_t g_last_sample_ticks = 0;
+static uint64_t g_last_idle_ticks[SMP::MAX_CORES] = {};
+
+const Stats& get_stats() {
+  return g_stats;
+}
+
+/** Gets the utilization (in percent) of the most loaded core since the previous sample. */
+static uint32_t sample_max_utilization() {
+  const uint64_t now = GenericTimer::get_tick_count();
+  const uint64_t elapsed_ticks = now - g_last_sample_ticks;
+  g_last_sample_ticks = now;
+
+  uint64_t max_busy_ticks = 0;
+  for (size_t core_id = 0; core_id < SMP::MAX_CORES; ++core_id) {
+    const uint64_t idle_ticks = TaskManager::get().get_idle_ticks(core_id, now);
+    const uint64_t idle_delta = idle_ticks - g_last_idle_ticks[core_id];
+    g_last_idle_ticks[core_id] = idle_ticks;
+
+    if (idle_delta < elapsed_ticks)
+      max_busy_ticks = libk::max(max_busy_ticks, elapsed_ticks - idle_delta);
+  }
+
+  if (elapsed_ticks == 0)
+    return 0;
+  return (uint32_t)libk::min(max_busy_ticks * 100 / elapsed_ticks, (uint64_t)100);
+}
+
+/** Lowers @a rate if the SoC is near its maximum temperature. */
+static uint32_t apply_thermal_cap(uint32_t rate) {
+  const uint32_t max_temp = Device::get_max_temp();
+  const uint32_t temp = Device::get_current_temp();
+  if (max_temp <= THERMAL_MARGIN_MILLI_C || temp == 0)
+    return rate;
+
+  const uint32_t throttle_temp = max_temp - THERMAL_MARGIN_MILLI_C;
+  if (temp <= throttle_temp)
+    return rate;
+
+  const uint64_t rate_range = g_stats.max_rate - g_stats.min_rate;
+  const uint64_t excess = libk::min(temp - throttle_temp, THERMAL_MARGIN_MILLI_C);
+  const uint32_t cap = g_stats.max_rate - (uint32_t)(rate_range * excess / THERMAL_MARGIN_MILLI_C);
+  if (cap >= rate)
+    return rate;
+
+  g_stats.nb_thermal_caps++;
+  return cap;
+}
+
+static void update_rate() {
+  const uint32_t utilization = sample_max_utilization();
+  g_stats.utilization_percent = utilization;
+
+  uint64_t rate = (uint64_t)g_stats.max_rate * utilization / TARGET_UTILIZATION_PERCENT;
+  rate = (rate + RATE_STEP_HZ - 1) / RATE_STEP_HZ * RATE_STEP_HZ;
+  rate = libk::clamp(rate, (uint64_t)g_stats.min_rate, (uint64_t)g_stats.max_rate);
+  const uint32_t target_rate = apply_thermal_cap((uint32_t)rate);
+
+  if (target_rate == g_stats.current_rate)
+    return;
+
+  if (!Device::set_clock_rate(Device::ARM, target_rate)) {
+    LOG_WARNING("[CpuFreq] Failed to set the ARM clock to {} Hz", target_rate);
+    return;
+  }
+
+  g_stats.current_rate = target_rate;
+  g_stats.nb_rate_changes++;
+}
+
+static void run() {
+  while (true) {
+    {
+      KernelTaskLockGuard kernel_lock;
+      update_rate();
+    }
+
+    sys_usleep(SAMPLE_INTERVAL_US);
+  }
+}
+
+void init() {
+  const uint32_t min_rate = Device::get_min_clock_rate(Device::ARM);
+  const uint32_t max_rate = Device::get_max_clock_rate(Device::ARM);
+  if (min_rate == 0 || max_rate <= min_rate) {
+    LOG_INFO("[CpuFreq] The ARM clock rate is fixed, the governor is disabled");
+    return;
+  }
+
+  g_stats.min_rate = min_rate;
+  g_stats.max_rate = max_rate;
+  g_stats.current_rate = Device::get_clock_rate(Device::ARM);
+
+  g_last_sample_ticks = GenericTimer::get_tick_count();
+  for (size_t core_id = 0; core_id < SMP::MAX_CORES; ++core_id)
+    g_last_idle_ticks[core_id] = TaskManager::get().get_idle_ticks(core_id, g_last_sample_ticks);
+
+  auto task = TaskManager::get().create_kernel_task(&run);
+  KASSERT(task != nullptr);
+  TaskManager::get().wake_task(task);
+
+  LOG_INFO("[CpuFreq] ARM clock between {} and {} MHz", min_rate / 1'000'000, max_rate / 1'000'000);
+}
+};  // namespace CpuFreq
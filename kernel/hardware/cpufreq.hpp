@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The governor of the ARM clock rate, driven by the load of the cores.
+ *
+ * A kernel task samples periodically the time each core spent out of its idle task (see
+ * Scheduler::get_idle_ticks()), and sets the ARM clock to the rate that would put the most loaded core at about
+ * TARGET_UTILIZATION_PERCENT of its capacity: the cores share a single clock, so the busiest decides. The rate
+ * is clamped between the minimum and maximum rates reported by the VideoCore, and rounded to RATE_STEP_HZ so the
+ * small variations of the load do not resend the same request.
+ *
+ * Near the maximum temperature of the SoC, the rate is capped: linearly from the maximum rate at
+ * THERMAL_MARGIN_MILLI_C below it, down to the minimum rate at it.
+ */
+namespace CpuFreq {
+static constexpr uint64_t SAMPLE_INTERVAL_US = 50'000;
+/** The utilization the rate is chosen for, the remaining leaves room for a load increase until the next sample. */
+static constexpr uint64_t TARGET_UTILIZATION_PERCENT = 80;
+static constexpr uint32_t RATE_STEP_HZ = 100'000'000;
+/** In thousandths of a degree C. */
+static constexpr uint32_t THERMAL_MARGIN_MILLI_C = 10'000;
+
+struct Stats {
+  uint32_t min_rate;
+  uint32_t max_rate;
+  uint32_t current_rate;
+  // The utilization of the most loaded core at the last sample (in percent).
+  uint32_t utilization_percent;
+  // Since the boot.
+  uint64_t nb_rate_changes;
+  uint64_t nb_thermal_caps;  // samples where the temperature lowered the rate
+};  // struct Stats
+
+/** Gets the state of the governor (all zero if it is not running). */
+[[nodiscard]] const Stats& get_stats();
+
+/** Starts the governor kernel task, unless the ARM clock rate can not be changed. Requires the task manager. */
+void init();
+};  // namespace CpuFreq
@@ -1,39 +1,89 @@
 #include "hardware/device.hpp"
 #include "hardware/mailbox.hpp"
-
-static uint32_t _max_temp = 0;
+#include "hardware/timer.hpp"
+
+namespace {
+/** How long the values read from the VideoCore are reused: a property request takes hundreds of microseconds
+ * (more if a flip is pending, see MailBox::finish_async_property()), and these values change rarely. */
+constexpr uint64_t CACHE_TTL_MS = 1000;
+
+/** A value read from the VideoCore, and when. */
+struct CachedValue {
+  uint32_t value = 0;
+  uint64_t time_ms = 0;
+  bool is_valid = false;
+
+  [[nodiscard]] bool is_fresh(uint64_t now_ms) const { return is_valid && now_ms - time_ms < CACHE_TTL_MS; }
+  void set(uint32_t new_value, uint64_t now_ms) {
+    value = new_value;
+    time_ms = now_ms;
+    is_valid = true;
+  }
+};  // struct CachedValue
+
+struct GetTempTagBuffer {
+  // Always 0.
+  uint32_t id = 0;
+  uint32_t value = 0;
+};  // struct GetTempTagBuffer
+
+struct GetClockRateBuffer {
+  uint32_t clock_id = 0;
+  uint32_t rate = 0;
+};  // struct GetClockRateBuffer
+
+using GetTempTag = MailBox::PropertyTag<0x00030006, GetTempTagBuffer>;
+using GetMaxTemperatureTag = MailBox::PropertyTag<0x0003000a, GetTempTagBuffer>;
+using GetClockRateTag = MailBox::PropertyTag<0x00030002, GetClockRateBuffer>;
+
+/** The clocks read at init in the same message as the temperatures, the ones used by the drivers. */
+constexpr Device::ClockId PREFETCHED_CLOCKS[] = {Device::UART, Device::CORE, Device::ARM, Device::EMMC2};
+constexpr size_t NB_PREFETCHED_CLOCKS = sizeof(PREFETCHED_CLOCKS) / sizeof(PREFETCHED_CLOCKS[0]);
+
+// The tags are answered in order, in a single round trip.
+struct alignas(16) InitMessage {
+  uint32_t buffer_size = sizeof(InitMessage);
+  volatile uint32_t status = 0;
+  GetMaxTemperatureTag max_temp_tag = {};
+  GetTempTag temp_tag = {};
+  GetClockRateTag clock_rate_tags[NB_PREFETCHED_CLOCKS] = {};
+  uint32_t end_tag = 0;
+};  // struct InitMessage
+
+uint32_t g_max_temp = 0;
+CachedValue g_current_temp;
+CachedValue g_clock_rates[Device::PIXEL_BVB + 1];
+}  // namespace
 
 bool Device::init() {
-  struct GetMaxTemperatureTagBuffer {
-    uint32_t id = 0;
-    uint32_t value = 0;
-  };
-
-  using GetMaxTemperatureTag = MailBox::PropertyTag<0x0003000a, GetMaxTemperatureTagBuffer>;
-
-  //  struct alignas(16) PropertyMessage {
-  //    uint32_t buffer_size = sizeof(PropertyMessage);
-  //    uint32_t status = 0;
-  //    volatile GetGetBoardModelTag board_model_tag = {};        // Can be modified by the GPU
-  //    volatile GetGetBoardRevisionTag board_revision_tag = {};  // Can be modified by the GPU
-  //    volatile GetGetBoardSerialTag board_serial_tag = {};      // Can be modified by the GPU
-  //      volatile GetARMMemoryTag arm_memory_tag = {};             // Can be modified by the GPU
-  //      volatile GetVCMemoryTag vc_memory_tag = {};               // Can be modified by the GPU
-  //      volatile GetMaxTemperatureTag max_temp_tag = {};          // Can be modified by the GPU
-  //    uint32_t end_tag = 0;
-  //  };
-
-  MailBox::PropertyMessage<GetMaxTemperatureTag> message;
+  InitMessage message;
+  for (size_t i = 0; i < NB_PREFETCHED_CLOCKS; ++i)
+    message.clock_rate_tags[i].buffer.clock_id = PREFETCHED_CLOCKS[i];
+
   if (!MailBox::send_property(message)) {
     return false;
   }
 
-  // Cache value
-  _max_temp = message.tag.buffer.value;
+  g_max_temp = message.max_temp_tag.buffer.value;
+
+  const uint64_t now_ms = GenericTimer::get_elapsed_time_in_ms();
+  if (MailBox::check_tag_status(message.temp_tag.status))
+    g_current_temp.set(message.temp_tag.buffer.value, now_ms);
+
+  for (size_t i = 0; i < NB_PREFETCHED_CLOCKS; ++i) {
+    if (MailBox::check_tag_status(message.clock_rate_tags[i].status))
+      g_clock_rates[PREFETCHED_CLOCKS[i]].set(message.clock_rate_tags[i].buffer.rate, now_ms);
+  }
 
   return true;
 }
 
+/** Forgets the clock rates read, after a change of the VideoCore configuration. */
+static void invalidate_clock_rates() {
+  for (auto& clock_rate : g_clock_rates)
+    clock_rate.is_valid = false;
+}
+
 bool Device::set_led_status(Device::Led led, bool on) {
   KASSERT(led == Led::ACT || led == Led::PWR);
 
@@ -55,21 +105,20 @@ bool Device::set_led_status(Device::Led led, bool on) {
 }
 
 uint32_t Device::get_current_temp() {
-  struct GetTempTagBuffer {
-    // Always 0.
-    uint32_t id = 0;
-    uint32_t value = 0;
-  };  // struct GetTempTagBuffer
-
-  using GetTempTag = MailBox::PropertyTag<0x00030006, GetTempTagBuffer>;
+  const uint64_t now_ms = GenericTimer::get_elapsed_time_in_ms();
+  if (g_current_temp.is_fresh(now_ms))
+    return g_current_temp.value;
 
   MailBox::PropertyMessage<GetTempTag> message;
-  const bool success = MailBox::send_property(message);
-  return success ? message.tag.buffer.value : 0;
+  if (!MailBox::send_property(message))
+    return 0;
+
+  g_current_temp.set(message.tag.buffer.value, now_ms);
+  return g_current_temp.value;
 }
 
 uint32_t Device::get_max_temp() {
-  return _max_temp;
+  return g_max_temp;
 }
 
 bool Device::set_power_state(uint32_t device_id, bool on, bool wait) {
@@ -84,6 +133,8 @@ bool Device::set_power_state(uint32_t device_id, bool on, bool wait) {
   message.tag.buffer.device_id = device_id;
   message.tag.buffer.state = (uint32_t)on | ((uint32_t)wait << 1);
   const bool success = MailBox::send_property(message);
+  // The clocks of a powered device may be reconfigured.
+  invalidate_clock_rates();
   return success && ((message.tag.buffer.state & 0x1) == (uint32_t)on)  // check if the device is in the expected state
          && ((message.tag.buffer.state & 0x2) != 0);                    // check if the device exists
 }
@@ -102,19 +153,68 @@ bool Device::set_turbo(bool on) {
   MailBox::PropertyMessage<SetTurboTag> message;
   message.tag.buffer.level = level;
   const bool success = MailBox::send_property(message);
+  // The turbo mode changes the ARM and GPU clocks.
+  invalidate_clock_rates();
   return success && (message.tag.buffer.level == level);
 }
 
 uint32_t Device::get_clock_rate(Device::ClockId id) {
-  struct GetClockRateBuffer {
-    volatile uint32_t clock_id = 0;
-    volatile uint32_t rate = 0;
-  };
-  using GetClockRateTag = MailBox::PropertyTag<0x00030002, GetClockRateBuffer>;
+  KASSERT(id <= PIXEL_BVB);
+  const uint64_t now_ms = GenericTimer::get_elapsed_time_in_ms();
+  if (g_clock_rates[id].is_fresh(now_ms))
+    return g_clock_rates[id].value;
 
   MailBox::PropertyMessage<GetClockRateTag> msg;
   msg.tag.buffer.clock_id = (uint32_t)id;
-  send_property(msg);
+  if (!MailBox::send_property(msg))
+    return 0;
+
+  g_clock_rates[id].set(msg.tag.buffer.rate, now_ms);
+  return g_clock_rates[id].value;
+}
+
+/** Reads a rate of the clock @a id with the tag @a TagId (which has the same buffer as the GET_CLOCK_RATE tag). */
+template <uint32_t TagId>
+static uint32_t get_clock_rate_limit(Device::ClockId id) {
+  using GetClockRateLimitTag = MailBox::PropertyTag<TagId, GetClockRateBuffer>;
+
+  MailBox::PropertyMessage<GetClockRateLimitTag> msg;
+  msg.tag.buffer.clock_id = (uint32_t)id;
+  if (!MailBox::send_property(msg) || !MailBox::check_tag_status(msg.tag.status))
+    return 0;
 
   return msg.tag.buffer.rate;
 }
+
+uint32_t Device::get_min_clock_rate(Device::ClockId id) {
+  return get_clock_rate_limit<0x00030007>(id);
+}
+
+uint32_t Device::get_max_clock_rate(Device::ClockId id) {
+  return get_clock_rate_limit<0x00030004>(id);
+}
+
+bool Device::set_clock_rate(Device::ClockId id, uint32_t rate) {
+  KASSERT(id <= PIXEL_BVB);
+
+  struct SetClockRateBuffer {
+    uint32_t clock_id = 0;
+    uint32_t rate = 0;
+    // 1 to not change the other clocks as the turbo settings would.
+    uint32_t skip_setting_turbo = 1;
+  };  // struct SetClockRateBuffer
+
+  using SetClockRateTag = MailBox::PropertyTag<0x00038002, SetClockRateBuffer>;
+
+  MailBox::PropertyMessage<SetClockRateTag> msg;
+  msg.tag.buffer.clock_id = (uint32_t)id;
+  msg.tag.buffer.rate = rate;
+  if (!MailBox::send_property(msg) || !MailBox::check_tag_status(msg.tag.status)) {
+    g_clock_rates[id].is_valid = false;
+    return false;
+  }
+
+  // The response holds the rate actually set.
+  g_clock_rates[id].set(msg.tag.buffer.rate, GenericTimer::get_elapsed_time_in_ms());
+  return true;
+}
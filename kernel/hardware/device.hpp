@@ -70,5 +70,12 @@ enum ClockId {
   PIXEL_BVB = 0x00000000e,
 };
 
+/** Gets the current rate of the clock @a id in Hz, or 0 on failure. The rate is cached for a while. */
 uint32_t get_clock_rate(ClockId id);
+/** Gets the minimum or maximum rate (in Hz) the clock @a id can be set to, or 0 on failure. */
+[[nodiscard]] uint32_t get_min_clock_rate(ClockId id);
+[[nodiscard]] uint32_t get_max_clock_rate(ClockId id);
+/** Sets the rate of the clock @a id to @a rate Hz (the VideoCore may round it), without the turbo settings
+ * changing the other clocks. Returns false on failure. */
+bool set_clock_rate(ClockId id, uint32_t rate);
 };  // namespace Device
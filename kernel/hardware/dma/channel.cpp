@@ -1,9 +1,12 @@
 #include "channel.hpp"
+#include <libk/cache.hpp>
 #include <libk/utils.hpp>
 
 #include "dma_impl.hpp"
+#include "hardware/irq/irq_lists.hpp"
 #include "libk/log.hpp"
 #include "memory/kernel_internal_memory.hpp"
+#include "trace.hpp"
 
 namespace DMA {
 
@@ -40,6 +43,10 @@ inline static constexpr uint32_t CONBLK_AD = 0x4;
 /** DMA Debug register. */
 // inline static constexpr uint32_t DEBUG = 0x20;
 
+static IRQ get_channel_irq(uintptr_t base) {
+  return {.type = VC_DMA_BASE.type, .id = VC_DMA_BASE.id + dma_impl::get_channel_id(base)};
+}
+
 Channel::Channel() : base(dma_impl::allocate_channel()) {
   dma_impl::set_channel_enable(base, true);
 
@@ -49,18 +56,50 @@ Channel::Channel() : base(dma_impl::allocate_channel()) {
   while ((libk::read32(base + CS) & CS_RESET) != 0) {
     libk::yield();
   }
+
+  IRQManager::register_irq_handler(get_channel_irq(base), &handle_interrupt, this);
 }
 
 Channel::~Channel() {
+  abort_previous();
+  IRQManager::unregister_irq_handle(get_channel_irq(base), nullptr, nullptr);
   dma_impl::set_channel_enable(base, false);
   dma_impl::free_channel(base);
 }
 
+void Channel::handle_interrupt(void* channel) {
+  auto* self = static_cast<Channel*>(channel);
+  self->complete(self->has_error());
+}
+
+void Channel::complete(bool has_error) {
+  // Acknowledge the interrupt (write 1 to clear).
+  libk::write32(base + CS, CS_INT | CS_END);
+
+  if (m_completion == nullptr)
+    return;
+
+  auto* completion = m_completion;
+  m_completion = nullptr;
+  completion->signal(has_error);
+}
+
 bool Channel::execute_requests(const Request* req) const {
   if (!is_free()) {
     return false;
   }
 
+  // The chain may loop back to its first request, it then runs until abort_previous().
+  const Request* it = req;
+  do {
+    it->clean_control_block();
+    it = it->next();
+  } while (it != nullptr && it != req);
+
+  // The control blocks and the data written by the CPU (the screen pixels are in write-combining memory)
+  // must reach the memory before the DMA starts reading it.
+  asm volatile("dsb sy" ::: "memory");
+
   const uintptr_t req_va_address = (uintptr_t)req->dma_s;
   const uintptr_t req_address = memory_impl::resolve_kernel_va(req_va_address, false);
   libk::write32(base + CONBLK_AD, req_address);
@@ -68,12 +107,37 @@ bool Channel::execute_requests(const Request* req) const {
   return true;
 }
 
-bool Channel::wait() const {
+bool Channel::submit(Request* req, Completion* completion) {
+  KASSERT(req != nullptr && completion != nullptr);
+
+  if (!is_free()) {
+    return false;
+  }
+
+  // Only the last request raises the interrupt.
+  Request* last_req = req;
+  while (last_req->next() != nullptr) {
+    last_req->set_interrupt_enable(false);
+    last_req = last_req->next();
+  }
+  last_req->set_interrupt_enable(true);
+
+  m_completion = completion;
+  completion->add_pending();
+  TRACE_EVENT(DMA_SUBMIT, base, (uintptr_t)req);
+  return execute_requests(req);
+}
+
+bool Channel::wait() {
   while (!is_free()) {
     libk::yield();
   }
 
-  return has_error();
+  // The interrupt may be pending on another core, do not wait for it.
+  const bool error = has_error();
+  if (m_completion != nullptr)
+    complete(error);
+  return error;
 }
 bool Channel::is_free() const {
   return ((libk::read32(base + CS) & CS_ACTIVE) == 0);
@@ -83,7 +147,7 @@ bool Channel::has_error() const {
   return (libk::read32(base + CS) & CS_ERROR) != 0;
 }
 
-void Channel::abort_previous() const {
+void Channel::abort_previous() {
   const auto old_cs = libk::read32(base + CS);
 
   libk::write32(base + CS, old_cs & ~(CS_ACTIVE));
@@ -91,6 +155,9 @@ void Channel::abort_previous() const {
   libk::write32(base + CS, CS_ABORT);
   libk::write32(base + CS, CS_RESET);
   libk::write32(base + CS, CS_INT | CS_END);
+
+  if (m_completion != nullptr)
+    complete(/* has_error= */ true);
 }
 
 }  // namespace DMA
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "hardware/dma/completion.hpp"
 #include "hardware/dma/request.hpp"
 
 namespace DMA {
@@ -11,12 +12,22 @@ class Channel {
   explicit Channel();
   ~Channel();
 
-  /** Try to execute the list of request @a req.
+  // No copy (the channel interrupt handler refers to this object)
+  Channel(const Channel&) = delete;
+  Channel& operator=(const Channel&) = delete;
+
+  /** Try to execute the list of request @a req. The last request may be linked to @a req, to repeat the list
+   * until abort_previous().
    * @a Returns `true` is the request has been started. */
   bool execute_requests(const Request* req) const;
 
-  /** Wait for requests to end. */
-  bool wait() const;
+  /** Try to execute asynchronously the list of request @a req: @a completion is signalled by the channel
+   * interrupt once the last request is done. The requests must stay alive until then.
+   * @a Returns `true` is the request has been started. */
+  bool submit(Request* req, Completion* completion);
+
+  /** Wait for requests to end (by polling the channel). */
+  bool wait();
 
   /** Checks if this DMA Channel is free to execute requests. */
   bool is_free() const;
@@ -24,10 +35,15 @@ class Channel {
   /** Checks if this DMA Channel have an error. */
   bool has_error() const;
 
-  /** Abort all previous requests ! */
-  void abort_previous() const;
+  /** Abort all previous requests ! The completion of submitted requests is signalled with an error. */
+  void abort_previous();
 
  private:
+  static void handle_interrupt(void* channel);
+  /** Signals the completion of the submitted requests, if any, and acknowledges the interrupt. */
+  void complete(bool has_error);
+
   const uintptr_t base;
+  Completion* m_completion = nullptr;
 };
 }  // namespace DMA
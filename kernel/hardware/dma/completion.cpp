@@ -0,0 +1,34 @@
+#include "completion.hpp"
+
+#include <libk/assert.hpp>
+
+namespace DMA {
+bool Completion::block_task_until_done(const libk::IntrusivePtr<Task>& task) {
+  if (is_done())
+    return false;
+
+  m_wait_list.add(task);
+  return true;
+}
+
+void Completion::add_pending() {
+  // A completion is reused by the next submissions once done.
+  if (is_done())
+    m_has_error = false;
+
+  m_pending_count++;
+}
+
+void Completion::signal(bool has_error) {
+  KASSERT(m_pending_count > 0);
+
+  m_has_error |= has_error;
+  m_pending_count--;
+  if (!is_done())
+    return;
+
+  m_wait_list.wake_all();
+  if (m_callback != nullptr)
+    m_callback(this, m_callback_data);
+}
+}  // namespace DMA
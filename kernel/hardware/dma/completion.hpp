@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <libk/memory.hpp>
+
+#include "task/wait_list.hpp"
+
+class Task;
+
+namespace DMA {
+/**
+ * The completion of requests executed asynchronously by one or several channels (see Channel::submit()).
+ *
+ * It is signalled by the channel interrupt when the last submitted request chain is done, waking the tasks
+ * blocked on it: they can do other work meanwhile instead of polling the channels.
+ */
+class Completion {
+ public:
+  using Callback = void (*)(Completion* completion, void* data);
+
+  /** Checks if all the submitted request chains are done. */
+  [[nodiscard]] bool is_done() const { return m_pending_count == 0; }
+  /** Checks if a channel reported an error for one of the request chains. */
+  [[nodiscard]] bool has_error() const { return m_has_error; }
+
+  /** Sets the function called (from the interrupt handler) when all the submitted request chains are done. */
+  void set_callback(Callback callback, void* data) {
+    m_callback = callback;
+    m_callback_data = data;
+  }
+
+  /**
+   * Blocks the given task until all the submitted request chains are done.
+   * The given task will be paused and awaken by the channel interrupt.
+   *
+   * Returns true if the task was blocked (some chains are still running).
+   * Otherwise, returns false.
+   */
+  bool block_task_until_done(const libk::IntrusivePtr<Task>& task);
+
+ private:
+  friend class Channel;
+
+  /** Called by a channel when a request chain is submitted. */
+  void add_pending();
+  /** Called by a channel when a request chain is done. */
+  void signal(bool has_error);
+
+  size_t m_pending_count = 0;
+  bool m_has_error = false;
+  Callback m_callback = nullptr;
+  void* m_callback_data = nullptr;
+  WaitList m_wait_list;
+};  // class Completion
+}  // namespace DMA
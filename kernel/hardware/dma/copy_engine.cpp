@@ -0,0 +1,270 @@
+#include "copy_engine.hpp"
+
+#include <libk/cache.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "hardware/dma/channel.hpp"
+#include "hardware/dma/dma_impl.hpp"
+#include "hardware/kernel_lock.hpp"
+
+namespace DMA {
+/** The count of requests executed at once, a bigger copy is done in several batches. */
+static inline constexpr size_t NB_BATCH_REQUESTS = 32;
+/** The biggest byte length of a single request (the LENGTH register has 30 bits). */
+static inline constexpr size_t MAX_REQUEST_LENGTH = 1 << 29;
+
+static Channel* _channel = nullptr;
+static Request* _requests[NB_BATCH_REQUESTS] = {};
+/** The pattern read by the fill requests, it must stay in memory reachable by the DMA. */
+static uint32_t _fill_pattern;
+/** Set while the channel is used, the CPU does the nested copies. Protected by the kernel lock. */
+static bool _is_busy = false;
+/** Set once the DMA controller is initialized, see init_copy_engine(). */
+static bool _is_enabled = false;
+
+static bool acquire() {
+  // The flag is written under the kernel lock, the callers not holding it copy with the CPU.
+  if (!KernelLock::is_owned() || _is_busy)
+    return false;
+
+  _is_busy = true;
+
+  if (_channel != nullptr)
+    return true;
+
+  if (!has_free_channel()) {
+    _is_busy = false;
+    return false;
+  }
+
+  _channel = new Channel;
+  for (auto& request : _requests) {
+    request = Request::memcpy(0, 0, 0);
+  }
+
+  return true;
+}
+
+static void release() {
+  _is_busy = false;
+}
+
+/** Gets the DMA address of the kernel memory at @a va, returns false if it is not reachable by the DMA. */
+static bool get_bus_address(uintptr_t va, bool read_only, Address* address) {
+  // The user space memory may be paged out or copy-on-write, so only the kernel memory is used.
+  uintptr_t bus_address;
+  if (va < KERNEL_BASE || !dma_impl::try_get_dma_bus_address(va, read_only, &bus_address))
+    return false;
+
+  if (bus_address > UINT32_MAX)
+    return false;
+
+  *address = bus_address;
+  return true;
+}
+
+/** Gets the DMA address of the physically contiguous @a length bytes at @a pa, returns false if they are not all
+ * reachable by the DMA (or not contiguous on the bus). */
+static bool get_pa_bus_address(PhysicalPA pa, size_t length, Address* address) {
+  uintptr_t bus_address, last_bus_address;
+  if (!dma_impl::try_get_pa_dma_bus_address(pa, &bus_address) ||
+      !dma_impl::try_get_pa_dma_bus_address(pa + length - 1, &last_bus_address))
+    return false;
+
+  if (last_bus_address > UINT32_MAX || last_bus_address - bus_address != length - 1)
+    return false;
+
+  *address = bus_address;
+  return true;
+}
+
+/** Gets the byte length (up to @a max_length) of the memory at @a va contiguous on the DMA bus from @a address. */
+static size_t get_contiguous_length(uintptr_t va, Address address, size_t max_length, bool read_only) {
+  size_t length = libk::min(max_length, PAGE_SIZE - (va % PAGE_SIZE));
+  while (length < max_length) {
+    Address next_address;
+    if (!get_bus_address(va + length, read_only, &next_address) || next_address != address + length)
+      break;
+
+    length = libk::min(max_length, length + PAGE_SIZE);
+  }
+
+  return length;
+}
+
+/** Executes the first @a nb_requests requests, returns false if the channel reported an error. */
+static bool execute_batch(size_t nb_requests) {
+  for (size_t i = 1; i < nb_requests; ++i) {
+    _requests[i - 1]->link_to(_requests[i]);
+  }
+
+  const bool started = _channel->execute_requests(_requests[0]);
+  const bool has_error = started && _channel->wait();
+
+  for (size_t i = 0; i < nb_requests; ++i) {
+    _requests[i]->unlink();
+  }
+
+  return started && !has_error;
+}
+
+static bool copy(void* dst, const void* src, size_t length) {
+  if (!acquire())
+    return false;
+
+  // The DMA reads and writes the memory, not the CPU caches. The dirty lines of the destination are
+  // written back now, so they are not evicted later over the copied bytes.
+  libk::clean_dcache_range(src, length);
+  libk::clean_invalidate_dcache_range(dst, length);
+
+  auto dst_va = (uintptr_t)dst;
+  auto src_va = (uintptr_t)src;
+  bool success = true;
+  while (success && length > 0) {
+    size_t nb_requests = 0;
+    while (nb_requests < NB_BATCH_REQUESTS && length > 0) {
+      Address dst_address, src_address;
+      if (!get_bus_address(dst_va, false, &dst_address) || !get_bus_address(src_va, true, &src_address)) {
+        success = false;
+        break;
+      }
+
+      const size_t max_length = libk::min(length, MAX_REQUEST_LENGTH);
+      size_t run_length = get_contiguous_length(dst_va, dst_address, max_length, false);
+      run_length = get_contiguous_length(src_va, src_address, run_length, true);
+
+      _requests[nb_requests++]->set_memcpy(src_address, dst_address, run_length);
+      dst_va += run_length;
+      src_va += run_length;
+      length -= run_length;
+    }
+
+    if (nb_requests > 0)
+      success = execute_batch(nb_requests) && success;
+  }
+
+  // Drops the lines speculatively loaded during the copy.
+  libk::invalidate_dcache_range(dst, dst_va - (uintptr_t)dst);
+
+  release();
+  // The copy is done again by the CPU on failure, the memory areas do not overlap.
+  return success;
+}
+
+static bool fill(uint32_t* dst, uint32_t pattern, size_t length) {
+  if (!acquire())
+    return false;
+
+  Address pattern_address;
+  bool success = get_bus_address((uintptr_t)&_fill_pattern, true, &pattern_address);
+  _fill_pattern = pattern;
+  libk::clean_dcache_range(&_fill_pattern, sizeof(_fill_pattern));
+  libk::clean_invalidate_dcache_range(dst, length);
+
+  auto dst_va = (uintptr_t)dst;
+  while (success && length > 0) {
+    size_t nb_requests = 0;
+    while (nb_requests < NB_BATCH_REQUESTS && length > 0) {
+      Address dst_address;
+      if (!get_bus_address(dst_va, false, &dst_address)) {
+        success = false;
+        break;
+      }
+
+      const size_t max_length = libk::min(length, MAX_REQUEST_LENGTH);
+      const size_t run_length = get_contiguous_length(dst_va, dst_address, max_length, false);
+
+      _requests[nb_requests++]->set_fill(pattern_address, dst_address, run_length);
+      dst_va += run_length;
+      length -= run_length;
+    }
+
+    if (nb_requests > 0)
+      success = execute_batch(nb_requests) && success;
+  }
+
+  libk::invalidate_dcache_range(dst, dst_va - (uintptr_t)dst);
+
+  release();
+  return success;
+}
+
+void init_copy_engine() {
+  static const libk::LargeCopyEngine engine = {.copy = &copy, .fill = &fill};
+  libk::set_large_copy_engine(&engine);
+  _is_enabled = true;
+}
+
+bool copy_segments(const MemoryChunk::Segment* segments, size_t nb_segments, void* va, bool to_segments) {
+  if (!_is_enabled || !acquire())
+    return false;
+
+  // The CPU accesses the segments through the linear mapping of the physical memory.
+  size_t length = 0;
+  for (size_t i = 0; i < nb_segments; ++i) {
+    const auto* segment_va = (const void*)(segments[i].pa + KERNEL_BASE);
+    if (to_segments)
+      libk::clean_invalidate_dcache_range(segment_va, segments[i].byte_size);
+    else
+      libk::clean_dcache_range(segment_va, segments[i].byte_size);
+    length += segments[i].byte_size;
+  }
+
+  if (to_segments)
+    libk::clean_dcache_range(va, length);
+  else
+    libk::clean_invalidate_dcache_range(va, length);
+
+  auto kernel_va = (uintptr_t)va;
+  size_t segment_id = 0;
+  size_t segment_offset = 0;
+  bool success = true;
+  while (success && segment_id < nb_segments) {
+    size_t nb_requests = 0;
+    while (nb_requests < NB_BATCH_REQUESTS && segment_id < nb_segments) {
+      const MemoryChunk::Segment& segment = segments[segment_id];
+      const size_t max_length = libk::min(segment.byte_size - segment_offset, MAX_REQUEST_LENGTH);
+
+      Address segment_address, kernel_address;
+      if (!get_bus_address(kernel_va, to_segments, &kernel_address)) {
+        success = false;
+        break;
+      }
+
+      const size_t run_length = get_contiguous_length(kernel_va, kernel_address, max_length, to_segments);
+      if (!get_pa_bus_address(segment.pa + segment_offset, run_length, &segment_address)) {
+        success = false;
+        break;
+      }
+
+      if (to_segments)
+        _requests[nb_requests++]->set_memcpy(kernel_address, segment_address, run_length);
+      else
+        _requests[nb_requests++]->set_memcpy(segment_address, kernel_address, run_length);
+
+      kernel_va += run_length;
+      segment_offset += run_length;
+      if (segment_offset == segment.byte_size) {
+        segment_id++;
+        segment_offset = 0;
+      }
+    }
+
+    if (nb_requests > 0)
+      success = execute_batch(nb_requests) && success;
+  }
+
+  // Drops the lines speculatively loaded during the copy.
+  if (to_segments) {
+    for (size_t i = 0; i < nb_segments; ++i)
+      libk::invalidate_dcache_range((const void*)(segments[i].pa + KERNEL_BASE), segments[i].byte_size);
+  } else {
+    libk::invalidate_dcache_range(va, length);
+  }
+
+  release();
+  return success;
+}
+}  // namespace DMA
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "memory/memory_chunk.hpp"
+
+namespace DMA {
+/**
+ * Registers a DMA channel as the large copy engine of libk (see libk::memcpy_large()).
+ *
+ * The channel is allocated at the first big copy. The copies are done synchronously, by polling the
+ * channel, and the CPU does them instead if the channel is busy, the caller does not hold the kernel lock or the
+ * memory is not reachable by the DMA (user space memory, physically non-contiguous pages are split in several
+ * requests).
+ */
+void init_copy_engine();
+
+/**
+ * Copies between the kernel memory at @a va and the scatter-gather list of @a nb_segments @a segments (see
+ * MemoryChunk::get_segments()), towards the segments if @a to_segments. The requests are built from the physical
+ * addresses of the segments: only the kernel memory side is split at its discontinuities.
+ * @returns false if the copy engine is unable to do it (the caller then copies with the CPU).
+ */
+[[nodiscard]] bool copy_segments(const MemoryChunk::Segment* segments, size_t nb_segments, void* va, bool to_segments);
+}  // namespace DMA
@@ -11,4 +11,16 @@ Address get_dma_bus_address(VirtualAddress va_addr, bool read_only_address) {
   return dma_impl::get_dma_bus_address(va_addr, read_only_address);
 }
 
+bool has_free_channel() {
+  return dma_impl::has_free_channel();
+}
+
+bool block_task_until_channel_free(const libk::IntrusivePtr<Task>& task) {
+  return dma_impl::block_task_until_channel_free(task);
+}
+
+void reset_channels() {
+  dma_impl::reset_channels();
+}
+
 }  // namespace DMA
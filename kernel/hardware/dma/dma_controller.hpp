@@ -1,7 +1,11 @@
 #pragma once
 
+#include <libk/memory.hpp>
+
 #include "memory/memory.hpp"
 
+class Task;
+
 namespace DMA {
 using Address = uint32_t;
 
@@ -10,4 +14,20 @@ using Address = uint32_t;
 /** Convert a KERNEL virtual address to its corresponding DMA address. */
 [[nodiscard]] Address get_dma_bus_address(VirtualAddress va_addr, bool read_only_address);
 
+/** Checks if a Channel can be created now (the channels are a limited resource). */
+[[nodiscard]] bool has_free_channel();
+
+/**
+ * Blocks the given task until a channel is destroyed.
+ * The given task will be paused and awaken when a channel is freed.
+ *
+ * Returns true if the task was blocked (no channel is free currently).
+ * Otherwise, returns false.
+ */
+bool block_task_until_channel_free(const libk::IntrusivePtr<Task>& task);
+
+/** Stops the transfers of all the channels, before restarting into another kernel (see Kexec). The channels must
+ * not be used anymore. */
+void reset_channels();
+
 }  // namespace DMA
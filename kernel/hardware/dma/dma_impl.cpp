@@ -5,6 +5,7 @@
 #include "hardware/kernel_dt.hpp"
 #include "hardware/timer.hpp"
 #include "memory/kernel_internal_memory.hpp"
+#include "task/wait_list.hpp"
 
 /** Interrupt status of each DMA channel. */
 // inline static constexpr uint32_t INT_STATUS = 0xfe0;
@@ -12,6 +13,10 @@
 /** Global enable bits for each DMA channel. */
 inline static constexpr uint32_t ENABLE = 0xff0;
 
+/** Control and status register of a DMA Channel, and its reset bit (see channel.cpp). */
+inline static constexpr uint32_t CHANNEL_CS = 0;
+inline static constexpr uint32_t CHANNEL_CS_RESET = 1u << 31;
+
 /** Size reserved memory for all the registers of a DMA Channel. */
 static inline constexpr size_t CHANNEL_REGS_SIZE = 0x100;
 
@@ -23,6 +28,12 @@ namespace dma_impl {
 static uintptr_t _dma_base = 0;
 static Property _soc_dma_range;
 static uint16_t _dma_channels;
+/** The channels given to the ARM by the device tree, free or not. */
+static uint16_t _dma_all_channels;
+/** Highest channel that can be allocated (the lower channels are the faster ones, with the full features). */
+static inline constexpr int MAX_CHANNEL_ID = 6;
+/** The tasks waiting for a free channel. */
+static WaitList _channel_wait_list;
 
 bool init() {
   /* Fill _dma_base */
@@ -52,6 +63,7 @@ bool init() {
   }
 
   _dma_channels = dma_mask.get_value();
+  _dma_all_channels = _dma_channels;
 
   return true;
 }
@@ -59,7 +71,7 @@ bool init() {
 uintptr_t allocate_channel() {
   KASSERT(_dma_base != 0);
 
-  for (int i = 6; i >= 0; i--) {
+  for (int i = MAX_CHANNEL_ID; i >= 0; i--) {
     if (_dma_channels & (1 << i)) {
       _dma_channels &= ~(1 << i);
       return _dma_base + i * CHANNEL_REGS_SIZE;
@@ -70,12 +82,43 @@ uintptr_t allocate_channel() {
 }
 
 void free_channel(uintptr_t chan_base) {
-  const size_t chan_id = (chan_base - _dma_base) / CHANNEL_REGS_SIZE;
+  const size_t chan_id = get_channel_id(chan_base);
   _dma_channels |= 1 << chan_id;
+  _channel_wait_list.wake_all();
+}
+
+size_t get_channel_id(uintptr_t chan_base) {
+  return (chan_base - _dma_base) / CHANNEL_REGS_SIZE;
+}
+
+bool has_free_channel() {
+  return (_dma_channels & ((1 << (MAX_CHANNEL_ID + 1)) - 1)) != 0;
+}
+
+bool block_task_until_channel_free(const libk::IntrusivePtr<Task>& task) {
+  if (has_free_channel())
+    return false;
+
+  _channel_wait_list.add(task);
+  return true;
+}
+
+void reset_channels() {
+  if (_dma_base == 0)
+    return;
+
+  // The allocated channels are the given ones not free anymore.
+  const uint16_t allocated = _dma_all_channels & ~_dma_channels;
+  for (int i = 0; i <= MAX_CHANNEL_ID; ++i) {
+    if ((allocated & (1 << i)) != 0)
+      libk::write32(_dma_base + i * CHANNEL_REGS_SIZE + CHANNEL_CS, CHANNEL_CS_RESET);
+  }
+
+  libk::write32(_dma_base + ENABLE, libk::read32(_dma_base + ENABLE) & ~(uint32_t)allocated);
 }
 
 void set_channel_enable(uintptr_t chan_base, bool enable) {
-  const size_t chan_id = (chan_base - _dma_base) / CHANNEL_REGS_SIZE;
+  const size_t chan_id = get_channel_id(chan_base);
 
   const auto old_enable_value = libk::read32(_dma_base + ENABLE);
   const uint32_t mask = 1u << chan_id;
@@ -93,8 +136,25 @@ void set_channel_enable(uintptr_t chan_base, bool enable) {
 }
 
 uintptr_t get_dma_bus_address(VirtualAddress va_addr, bool read_only_address) {
-  PhysicalAddress pa = memory_impl::resolve_kernel_va(va_addr, read_only_address);
+  uintptr_t address;
+  if (!try_get_dma_bus_address(va_addr, read_only_address, &address)) {
+    LOG_ERROR("Unable to find corresponding DMA address of {:#x}.", va_addr);
+    libk::panic("Unable to find DMA address.");
+  }
+
+  return address;
+}
+
+bool try_get_dma_bus_address(VirtualAddress va_addr, bool read_only_address, uintptr_t* address) {
+  PhysicalAddress pa;
+  if (!memory_impl::try_resolve_kernel_va(va_addr, read_only_address, &pa)) {
+    return false;
+  }
+
+  return try_get_pa_dma_bus_address(pa, address);
+}
 
+bool try_get_pa_dma_bus_address(PhysicalAddress pa, uintptr_t* address) {
   size_t index = 0;
   while (index < _soc_dma_range.length) {
     uint64_t soc_start = 0;
@@ -113,12 +173,12 @@ uintptr_t get_dma_bus_address(VirtualAddress va_addr, bool read_only_address) {
 
     if (arm_start <= pa && pa < arm_start + length) {
       const size_t offset = pa - arm_start;
-      return soc_start + offset;
+      *address = soc_start + offset;
+      return true;
     }
   }
 
-  LOG_ERROR("Unable to find corresponding DMA address of {:#x}.", va_addr);
-  libk::panic("Unable to find DMA address.");
+  return false;
 }
 
 }  // namespace dma_impl
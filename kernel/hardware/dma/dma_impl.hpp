@@ -1,8 +1,12 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <libk/memory.hpp>
 
 #include "memory/memory.hpp"
 
+class Task;
+
 namespace dma_impl {
 
 [[nodiscard]] bool init();
@@ -11,8 +15,25 @@ namespace dma_impl {
 
 void free_channel(uintptr_t chan_base);
 
+/** Gets the index of the channel (which also gives its IRQ). */
+[[nodiscard]] size_t get_channel_id(uintptr_t chan_base);
+
+[[nodiscard]] bool has_free_channel();
+
+/** Blocks @a task until a channel is freed. Returns true if the task was blocked (no channel is free). */
+bool block_task_until_channel_free(const libk::IntrusivePtr<Task>& task);
+
 void set_channel_enable(uintptr_t chan_base, bool enable);
 
+/** Resets and disables the allocated channels, stopping their transfers. */
+void reset_channels();
+
 [[nodiscard]] uintptr_t get_dma_bus_address(VirtualAddress va_addr, bool read_only_address);
 
+/** Same as get_dma_bus_address(), but returns false if @a va_addr is not mapped or not reachable by the DMA. */
+[[nodiscard]] bool try_get_dma_bus_address(VirtualAddress va_addr, bool read_only_address, uintptr_t* address);
+
+/** Same as try_get_dma_bus_address(), for the physical address @a pa (no page table walk). */
+[[nodiscard]] bool try_get_pa_dma_bus_address(PhysicalAddress pa, uintptr_t* address);
+
 };  // namespace dma_impl
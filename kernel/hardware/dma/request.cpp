@@ -1,8 +1,8 @@
 #include "request.hpp"
-#include <climits>
+#include "libk/cache.hpp"
 #include "libk/log.hpp"
+#include "libk/object_cache.hpp"
 #include "memory/kernel_internal_memory.hpp"
-#include "memory/mem_alloc.hpp"
 
 namespace DMA {
 /** Don’t do wide writes as a 2 beat burst.
@@ -10,9 +10,25 @@ namespace DMA {
  * This is an inefficient access mode, so the default is to use the bursts. */
 inline static constexpr uint32_t TI_NO_WIDE_BURSTS = 1 << 26;
 
+/** Don't perform source reads, the source is then zeroes. */
+// inline static constexpr uint32_t TI_SRC_IGNORE = 1 << 11;
+
+/** The DREQ selected by PERMAP gates the source reads. */
+inline static constexpr uint32_t TI_SRC_DREQ = 1 << 10;
+
+/** Don't perform destination writes. */
+inline static constexpr uint32_t TI_DEST_IGNORE = 1 << 7;
+
+/** Peripheral number whose ready signal paces the transfer (5 bits). */
+inline static constexpr uint32_t TI_PERMAP_SHIFT = 16;
+inline static constexpr uint32_t TI_PERMAP_MASK = 0b11111 << TI_PERMAP_SHIFT;
+
 /** Source address increments after each read. */
 inline static constexpr uint32_t TI_SRC_INC = 1 << 8;
 
+/** The DREQ selected by PERMAP gates the destination writes. */
+inline static constexpr uint32_t TI_DEST_DREQ = 1 << 6;
+
 /** Destination address increments after each write. */
 inline static constexpr uint32_t TI_DEST_INC = 1 << 4;
 
@@ -23,9 +39,10 @@ inline static constexpr uint32_t TI_WAIT_RESP = 1 << 3;
 inline static constexpr uint32_t TI_TD_MODE = 1 << 1;
 
 /** Interrupt Enable. */
-// inline static constexpr uint32_t TI_INT_EN = 1 << 0;
+inline static constexpr uint32_t TI_INT_EN = 1 << 0;
 
-struct Request::DMAStruct {
+/** The control blocks must be 256-bit aligned. */
+struct alignas(32) Request::DMAStruct {
   uint32_t ti;
   uint32_t src;
   uint32_t dst;
@@ -33,23 +50,34 @@ struct Request::DMAStruct {
   uint32_t stride;
   uint32_t next_req;
   uint32_t res[2] = {0};
+  // The source of the 2D fills (see set_fill_2d()), after the control block so the DMA does not read it as such.
+  uint32_t fill_value = 0;
+
+  static libk::ObjectCache<DMAStruct>& get_cache() {
+    static libk::ObjectCache<DMAStruct> cache;
+    return cache;
+  }
 };
 
-Request::Request() : dma_s((DMAStruct*)(kmalloc(sizeof(DMAStruct), 256 / CHAR_BIT))), next_req(nullptr) {}
+static libk::ObjectCache<Request> g_request_cache;
+
+void* Request::operator new(size_t size) {
+  KASSERT(size == sizeof(Request));
+  return g_request_cache.allocate();
+}
+
+void Request::operator delete(void* ptr) {
+  g_request_cache.deallocate(ptr);
+}
+
+Request::Request() : dma_s(DMAStruct::get_cache().create()), next_req(nullptr) {}
 
 Request::~Request() {
-  kfree(dma_s);
+  DMAStruct::get_cache().destroy(dma_s);
 }
 
 Request::Request(Address src, Address dest, uint32_t length) : Request() {
-  dma_s->ti = TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP | TI_NO_WIDE_BURSTS;
-  dma_s->src = src;
-  dma_s->dst = dest;
-  dma_s->length = length;
-  dma_s->stride = 0;
-  dma_s->next_req = 0;
-  dma_s->res[0] = 0;
-  dma_s->res[1] = 0;
+  set_memcpy(src, dest, length);
 }
 
 Request::Request(Address src,
@@ -59,9 +87,39 @@ Request::Request(Address src,
                  uint16_t src_strid,
                  uint16_t dst_stride)
     : Request() {
+  set_memcpy_2d(src, dest, x_length, y_length, src_strid, dst_stride);
+}
+
+void Request::set_memcpy(Address src, Address dst, uint32_t length) {
+  KASSERT(next_req == nullptr);
+
+  dma_s->ti = TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP | TI_NO_WIDE_BURSTS;
+  dma_s->src = src;
+  dma_s->dst = dst;
+  dma_s->length = length;
+  dma_s->stride = 0;
+  dma_s->next_req = 0;
+  dma_s->res[0] = 0;
+  dma_s->res[1] = 0;
+}
+
+void Request::set_fill(Address pattern, Address dst, uint32_t length) {
+  set_memcpy(pattern, dst, length);
+  // The source is not incremented, so the same 4 bytes are read again and again.
+  dma_s->ti &= ~TI_SRC_INC;
+}
+
+void Request::set_memcpy_2d(Address src,
+                            Address dst,
+                            uint16_t x_length,
+                            uint16_t y_length,
+                            uint16_t src_strid,
+                            uint16_t dst_stride) {
+  KASSERT(next_req == nullptr);
+
   dma_s->ti = TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP | TI_TD_MODE | TI_NO_WIDE_BURSTS;
   dma_s->src = src;
-  dma_s->dst = dest;
+  dma_s->dst = dst;
   dma_s->length = (y_length << 16) | x_length;
   dma_s->stride = (dst_stride << 16) | src_strid;
   dma_s->next_req = 0;
@@ -69,6 +127,34 @@ Request::Request(Address src,
   dma_s->res[1] = 0;
 }
 
+void Request::set_fill_2d(uint32_t value, Address dst, uint16_t x_length, uint16_t y_length, uint16_t dst_stride) {
+  // The source stride is 0 too, so each line reads the same 4 bytes again and again. The value is written back
+  // from the CPU caches with the control block, before the channel is started.
+  dma_s->fill_value = value;
+  set_memcpy_2d(memory_impl::resolve_kernel_va((uintptr_t)&dma_s->fill_value, true), dst, x_length, y_length, 0,
+                dst_stride);
+  dma_s->ti &= ~TI_SRC_INC;
+}
+
+void Request::set_write(uint32_t value, Address dst) {
+  dma_s->fill_value = value;
+  set_fill(memory_impl::resolve_kernel_va((uintptr_t)&dma_s->fill_value, true), dst, sizeof(uint32_t));
+}
+
+void Request::set_dest_dreq(uint8_t peripheral) {
+  dma_s->ti &= ~(TI_PERMAP_MASK | TI_DEST_INC);
+  dma_s->ti |= TI_DEST_DREQ | ((uint32_t)peripheral << TI_PERMAP_SHIFT);
+}
+
+void Request::set_src_dreq(uint8_t peripheral) {
+  dma_s->ti &= ~(TI_PERMAP_MASK | TI_SRC_INC);
+  dma_s->ti |= TI_SRC_DREQ | ((uint32_t)peripheral << TI_PERMAP_SHIFT);
+}
+
+void Request::set_dest_ignore() {
+  dma_s->ti = (dma_s->ti & ~TI_DEST_INC) | TI_DEST_IGNORE;
+}
+
 Request* Request::memcpy(Address src, Address dest, uint32_t length) {
   return new Request(src, dest, length);
 }
@@ -82,6 +168,25 @@ Request* Request::memcpy_2d(Address src,
   return new Request(src, dst, x_length, y_length, src_strid, dst_stride);
 }
 
+Request* Request::fill_2d(uint32_t value, Address dst, uint16_t x_length, uint16_t y_length, uint16_t dst_stride) {
+  auto* request = new Request();
+  if (request != nullptr)
+    request->set_fill_2d(value, dst, x_length, y_length, dst_stride);
+  return request;
+}
+
+void Request::set_interrupt_enable(bool enable) {
+  if (enable) {
+    dma_s->ti |= TI_INT_EN;
+  } else {
+    dma_s->ti &= ~TI_INT_EN;
+  }
+}
+
+void Request::clean_control_block() const {
+  libk::clean_dcache_range(dma_s, sizeof(DMAStruct));
+}
+
 Request* Request::link_to(Request* next) {
   auto* old_next = next_req;
   next_req = next;
@@ -9,6 +9,10 @@ class Request {
  public:
   ~Request();
 
+  /** Requests are allocated from a dedicated object cache rather than the general kernel heap. */
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   /** Create a Request that will write @a byte_length bytes from @a src to @a dst.
    * Beware, @a src is a DMA Address, so if byte_length > page_size, it must
    * be made of continuous **physical** address ! Use Buffer to have an buffer continuous in memory.
@@ -32,6 +36,53 @@ class Request {
                            uint16_t src_stride,
                            uint16_t dst_stride);
 
+  /** Create a Request that will 2D write the 4-byte @a value on @a dst, the lines being as in memcpy_2d().
+   * The value is stored with the request, so there is no source buffer to keep alive.
+   * YOU FREE THIS THING */
+  static Request* fill_2d(uint32_t value,
+                          Address dst,
+                          uint16_t line_byte_length,
+                          uint16_t nb_lines,
+                          uint16_t dst_stride);
+
+  /** Reinitializes this request (not linked and not being executed) as a copy, see memcpy(). */
+  void set_memcpy(Address src, Address dst, uint32_t byte_length);
+
+  /** Reinitializes this request (not linked and not being executed) to fill @a byte_length bytes of @a dst
+   * with the 4-byte value at @a pattern. @a dst and @a byte_length should be multiples of 4. */
+  void set_fill(Address pattern, Address dst, uint32_t byte_length);
+
+  /** Reinitializes this request (not linked and not being executed) as a 2D copy, see memcpy_2d().
+   * This allows to reuse requests instead of allocating new ones. */
+  void set_memcpy_2d(Address src,
+                     Address dst,
+                     uint16_t line_byte_length,
+                     uint16_t nb_lines,
+                     uint16_t src_stride,
+                     uint16_t dst_stride);
+
+  /** Reinitializes this request (not linked and not being executed) as a 2D fill, see fill_2d(). */
+  void set_fill_2d(uint32_t value,
+                   Address dst,
+                   uint16_t line_byte_length,
+                   uint16_t nb_lines,
+                   uint16_t dst_stride);
+
+  /** Reinitializes this request (not linked and not being executed) to write the 4-byte @a value at @a dst, a
+   * peripheral register for example. The value is stored with the request, as for fill_2d(). */
+  void set_write(uint32_t value, Address dst);
+
+  /** Paces the writes of this request by the DREQ signal of the @a peripheral (its PERMAP number): each write
+   * waits for the peripheral to request data. The destination is then a FIFO, its address is not incremented. */
+  void set_dest_dreq(uint8_t peripheral);
+  /** Same as set_dest_dreq() for the reads: each read waits for the @a peripheral to have data in its FIFO. */
+  void set_src_dreq(uint8_t peripheral);
+  /** Reads the source without writing anything, to drain a peripheral FIFO. */
+  void set_dest_ignore();
+
+  /** Raises the channel interrupt when this request is done (see Channel::submit()). */
+  void set_interrupt_enable(bool enable);
+
   /** Execute the request @a next after this one.
    * The previous following request is returned and overwritten.
    * This operation modify this request and so any list in witch this request appear. */
@@ -49,6 +100,9 @@ class Request {
   Request(Address src, Address dest, uint32_t length);
   Request(Address src, Address dest, uint16_t x_length, uint16_t y_length, uint16_t src_strid, uint16_t dst_stride);
 
+  /** Writes back the control block from the CPU caches, the DMA reads it from memory. */
+  void clean_control_block() const;
+
   friend Channel;
 
   struct DMAStruct;
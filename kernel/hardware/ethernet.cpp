@@ -0,0 +1,779 @@
+#include "hardware/ethernet.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "hardware/irq/irq_lists.hpp"
+#include "hardware/kernel_dt.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "hardware/timer.hpp"
+#include "memory/buffer.hpp"
+#include "memory/kernel_internal_memory.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+
+namespace Ethernet {
+// The GENET registers (see the Linux bcmgenet driver, there is no public datasheet), by block.
+constexpr uint32_t SYS_REV_CTRL = 0x0000;
+constexpr uint32_t SYS_PORT_CTRL = 0x0004;
+constexpr uint32_t SYS_RBUF_FLUSH_CTRL = 0x0008;
+constexpr uint32_t EXT_RGMII_OOB_CTRL = 0x008c;
+constexpr uint32_t INTRL2_0 = 0x0200;
+constexpr uint32_t INTRL2_1 = 0x0240;
+constexpr uint32_t RBUF_CTRL = 0x0300;
+constexpr uint32_t RBUF_TBUF_SIZE_CTRL = 0x03b4;
+constexpr uint32_t UMAC_CMD = 0x0808;
+constexpr uint32_t UMAC_MAC0 = 0x080c;
+constexpr uint32_t UMAC_MAC1 = 0x0810;
+constexpr uint32_t UMAC_MAX_FRAME_LEN = 0x0814;
+constexpr uint32_t UMAC_TX_FLUSH = 0x0b34;
+constexpr uint32_t UMAC_MIB_CTRL = 0x0d80;
+constexpr uint32_t UMAC_MDIO_CMD = 0x0e14;
+constexpr uint32_t UMAC_MDF_CTRL = 0x0e50;
+constexpr uint32_t UMAC_MDF_ADDR = 0x0e54;
+constexpr uint32_t RDMA = 0x2000;
+constexpr uint32_t TDMA = 0x4000;
+
+// SYS_REV_CTRL and SYS_PORT_CTRL fields.
+constexpr uint32_t REV_MAJOR_SHIFT = 24;
+constexpr uint32_t REV_MAJOR_V5 = 6;
+constexpr uint32_t PORT_MODE_EXT_GPHY = 3;
+
+// EXT_RGMII_OOB_CTRL fields.
+constexpr uint32_t RGMII_LINK = 1 << 4;
+constexpr uint32_t OOB_DISABLE = 1 << 5;
+constexpr uint32_t RGMII_MODE_EN = 1 << 6;
+constexpr uint32_t ID_MODE_DIS = 1 << 16;
+
+// The registers of the interrupt controllers (INTRL2_0 for the default rings, INTRL2_1 for the others), and
+// the INTRL2_0 interrupts.
+constexpr uint32_t INTRL2_STAT = 0x00;
+constexpr uint32_t INTRL2_CLEAR = 0x08;
+constexpr uint32_t INTRL2_MASK_STATUS = 0x0c;
+constexpr uint32_t INTRL2_MASK_SET = 0x10;
+constexpr uint32_t INTRL2_MASK_CLEAR = 0x14;
+constexpr uint32_t IRQ_RXDMA_MBDONE = 1 << 13;
+constexpr uint32_t IRQ_TXDMA_MBDONE = 1 << 16;
+
+// RBUF_CTRL fields: the received frames are preceded by 2 bytes, to align their IP header.
+constexpr uint32_t RBUF_ALIGN_2B = 1 << 1;
+constexpr size_t RX_PADDING = 2;
+
+// UMAC_CMD fields.
+constexpr uint32_t CMD_TX_EN = 1 << 0;
+constexpr uint32_t CMD_RX_EN = 1 << 1;
+constexpr uint32_t CMD_SPEED_SHIFT = 2;
+constexpr uint32_t CMD_SPEED_MASK = 3 << CMD_SPEED_SHIFT;
+constexpr uint32_t CMD_SPEED_10 = 0;
+constexpr uint32_t CMD_SPEED_100 = 1;
+constexpr uint32_t CMD_SPEED_1000 = 2;
+constexpr uint32_t CMD_RX_PAUSE_IGNORE = 1 << 8;
+constexpr uint32_t CMD_HD_EN = 1 << 10;
+constexpr uint32_t CMD_SW_RESET = 1 << 13;
+constexpr uint32_t CMD_LCL_LOOP_EN = 1 << 15;
+constexpr uint32_t CMD_TX_PAUSE_IGNORE = 1 << 28;
+
+// UMAC_MIB_CTRL fields: resets the RX, runt and TX counters.
+constexpr uint32_t MIB_RESET_ALL = 0b111;
+
+// UMAC_MDIO_CMD fields.
+constexpr uint32_t MDIO_START_BUSY = 1 << 29;
+constexpr uint32_t MDIO_READ_FAIL = 1 << 28;
+constexpr uint32_t MDIO_RD = 2 << 26;
+constexpr uint32_t MDIO_WR = 1 << 26;
+constexpr uint32_t MDIO_PMD_SHIFT = 21;
+constexpr uint32_t MDIO_REG_SHIFT = 16;
+
+// The 17 address filters of UMAC_MDF_CTRL are enabled from the highest bit: the broadcast and our address.
+constexpr uint32_t MDF_ENABLE_2_FILTERS = (1 << 16) | (1 << 15);
+
+// The DMA descriptors, at the start of the RDMA and TDMA blocks, shared by all their rings. Only the default
+// ring (16) is used, with all of them.
+constexpr size_t RING_SIZE = 256;
+constexpr uint32_t DESC_SIZE = 12;
+constexpr uint32_t DESC_WORDS = DESC_SIZE / sizeof(uint32_t);
+constexpr uint32_t DESC_LENGTH_STATUS = 0x0;
+constexpr uint32_t DESC_ADDRESS_LO = 0x4;
+constexpr uint32_t DESC_ADDRESS_HI = 0x8;
+
+// DESC_LENGTH_STATUS fields.
+constexpr uint32_t DESC_LENGTH_SHIFT = 16;
+constexpr uint32_t DESC_LENGTH_MASK = 0xfff;
+constexpr uint32_t DESC_EOP = 0x4000;
+constexpr uint32_t DESC_SOP = 0x2000;
+constexpr uint32_t DESC_TX_APPEND_CRC = 0x0040;
+constexpr uint32_t DESC_TX_QTAG = 0x3f << 7;
+constexpr uint32_t DESC_RX_ERRORS = 0x1f;  // too long, non octet aligned, RX error, CRC error, overrun
+
+// The registers of the default ring, after the descriptors, the RX and TX ones mostly differ by their indices.
+constexpr uint32_t RING = RING_SIZE * DESC_SIZE + 16 * 0x40;
+constexpr uint32_t RDMA_WRITE_PTR = 0x00;
+constexpr uint32_t RDMA_PROD_INDEX = 0x08;
+constexpr uint32_t RDMA_CONS_INDEX = 0x0c;
+constexpr uint32_t RDMA_XON_XOFF_THRESH = 0x28;
+constexpr uint32_t RDMA_READ_PTR = 0x2c;
+constexpr uint32_t TDMA_READ_PTR = 0x00;
+constexpr uint32_t TDMA_CONS_INDEX = 0x08;
+constexpr uint32_t TDMA_PROD_INDEX = 0x0c;
+constexpr uint32_t TDMA_FLOW_PERIOD = 0x28;
+constexpr uint32_t TDMA_WRITE_PTR = 0x2c;
+constexpr uint32_t DMA_RING_BUF_SIZE = 0x10;
+constexpr uint32_t DMA_START_ADDR = 0x14;
+constexpr uint32_t DMA_END_ADDR = 0x1c;
+constexpr uint32_t DMA_MBUF_DONE_THRESH = 0x24;
+// The producer and consumer indices are free running on 16 bits.
+constexpr uint32_t INDEX_MASK = 0xffff;
+
+// The registers common to all the rings, after the ones of the 17 rings.
+constexpr uint32_t DMA = RING_SIZE * DESC_SIZE + 17 * 0x40;
+constexpr uint32_t DMA_RING_CFG = 0x00;
+constexpr uint32_t DMA_CTRL = 0x04;
+constexpr uint32_t DMA_STATUS = 0x08;
+constexpr uint32_t DMA_SCB_BURST_SIZE = 0x0c;
+constexpr uint32_t DMA_RING16_TIMEOUT = 0x6c;
+constexpr uint32_t DMA_EN = 1 << 0;
+constexpr uint32_t DMA_RING16_BUF_EN = 1 << 17;
+constexpr uint32_t DMA_RING16_CFG_EN = 1 << 16;
+constexpr uint32_t DMA_DISABLED = 1 << 0;
+constexpr uint32_t DMA_MAX_BURST_LENGTH = 8;
+// The RX timeout is counted in steps of 8192 ns.
+constexpr uint32_t DMA_TIMEOUT_STEP_NS = 8192;
+// The flow control thresholds of the RX ring, in descriptors.
+constexpr uint32_t RX_XON_THRESH = 5;
+
+// The MII registers of the PHY.
+constexpr uint32_t MII_BMCR = 0;
+constexpr uint32_t MII_BMSR = 1;
+constexpr uint32_t MII_ADVERTISE = 4;
+constexpr uint32_t MII_LPA = 5;
+constexpr uint32_t MII_CTRL1000 = 9;
+constexpr uint32_t MII_STAT1000 = 10;
+constexpr uint32_t BMCR_ANRESTART = 1 << 9;
+constexpr uint32_t BMCR_ANENABLE = 1 << 12;
+constexpr uint32_t BMCR_RESET = 1 << 15;
+constexpr uint32_t BMSR_LSTATUS = 1 << 2;
+constexpr uint32_t BMSR_ANEGCOMPLETE = 1 << 5;
+constexpr uint32_t ADVERTISE_CSMA = 0x0001;
+constexpr uint32_t ADVERTISE_10HALF = 1 << 5;
+constexpr uint32_t ADVERTISE_10FULL = 1 << 6;
+constexpr uint32_t ADVERTISE_100HALF = 1 << 7;
+constexpr uint32_t ADVERTISE_100FULL = 1 << 8;
+constexpr uint32_t ADVERTISE_1000FULL = 1 << 9;
+constexpr uint32_t LPA_1000FULL = 1 << 11;
+constexpr uint32_t DEFAULT_PHY_ADDRESS = 1;
+
+constexpr size_t SLOT_SIZE = 2048;
+constexpr size_t SLOT_COUNT = RX_SLOT_COUNT + TX_SLOT_COUNT;
+static_assert(RX_SLOT_COUNT > RING_SIZE && TX_SLOT_COUNT <= RING_SIZE);
+static_assert(MAX_FRAME_SIZE + RX_PADDING <= SLOT_SIZE);
+
+constexpr uint64_t MDIO_TIMEOUT_MS = 10;
+constexpr uint64_t DMA_STOP_TIMEOUT_MS = 10;
+constexpr uint64_t PHY_RESET_TIMEOUT_MS = 500;
+constexpr uint64_t LINK_POLL_PERIOD_US = 1'000'000;
+
+static uintptr_t g_base = 0;
+static uint32_t g_phy_address = DEFAULT_PHY_ADDRESS;
+static uint8_t g_mac_address[MAC_ADDRESS_SIZE] = {};
+static uint32_t g_link_speed = 0;
+static bool g_is_full_duplex = false;
+static bool g_is_initialized = false;
+static Stats g_stats = {};
+
+// The slots of all the frames, the RX ones then the TX ones.
+static Buffer* g_slots = nullptr;
+static PhysicalPA g_slots_pa = 0;
+
+// The slot of each RX descriptor, the free RX slots (a stack, the most recently released is the most likely
+// to be cached) and the received frames not taken yet (a ring).
+static uint16_t g_rx_desc_slots[RING_SIZE];
+static uint16_t g_rx_free_slots[RX_SLOT_COUNT];
+static size_t g_rx_nb_free_slots = 0;
+static uint16_t g_rx_pending_slots[RX_SLOT_COUNT];
+static uint16_t g_rx_pending_sizes[RX_SLOT_COUNT];
+static size_t g_rx_pending_head = 0;
+static size_t g_rx_pending_tail = 0;
+static uint32_t g_rx_cons_index = 0;
+static WaitList g_rx_wait_list;
+
+static uint16_t g_tx_desc_slots[RING_SIZE];
+static uint16_t g_tx_free_slots[TX_SLOT_COUNT];
+static size_t g_tx_nb_free_slots = 0;
+static uint32_t g_tx_prod_index = 0;
+static uint32_t g_tx_cons_index = 0;
+static WaitList g_tx_wait_list;
+
+static uint32_t read(uint32_t offset) {
+  return libk::read32(g_base + offset);
+}
+
+static void write(uint32_t offset, uint32_t value) {
+  libk::write32(g_base + offset, value);
+}
+
+static void delay_us(uint64_t us) {
+  const uint64_t end = GenericTimer::get_elapsed_time_in_micros() + us;
+  while (GenericTimer::get_elapsed_time_in_micros() < end)
+    libk::yield();
+}
+
+static size_t slot_offset(uint32_t slot) {
+  return slot * SLOT_SIZE;
+}
+
+static uint8_t* slot_data(uint32_t slot) {
+  return (uint8_t*)g_slots->get() + slot_offset(slot);
+}
+
+/*
+ * PHY
+ */
+
+static bool mdio_wait(uint32_t* cmd) {
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + MDIO_TIMEOUT_MS;
+  while (((*cmd = read(UMAC_MDIO_CMD)) & MDIO_START_BUSY) != 0) {
+    if (GenericTimer::get_elapsed_time_in_ms() > end)
+      return false;
+    libk::yield();
+  }
+
+  return true;
+}
+
+static bool mdio_read(uint32_t reg, uint32_t* value) {
+  const uint32_t cmd = MDIO_RD | (g_phy_address << MDIO_PMD_SHIFT) | (reg << MDIO_REG_SHIFT);
+  write(UMAC_MDIO_CMD, cmd);
+  write(UMAC_MDIO_CMD, cmd | MDIO_START_BUSY);
+
+  uint32_t result;
+  if (!mdio_wait(&result) || (result & MDIO_READ_FAIL) != 0)
+    return false;
+
+  *value = result & 0xffff;
+  return true;
+}
+
+static bool mdio_write(uint32_t reg, uint32_t value) {
+  const uint32_t cmd = MDIO_WR | (g_phy_address << MDIO_PMD_SHIFT) | (reg << MDIO_REG_SHIFT) | value;
+  write(UMAC_MDIO_CMD, cmd);
+  write(UMAC_MDIO_CMD, cmd | MDIO_START_BUSY);
+
+  uint32_t result;
+  return mdio_wait(&result);
+}
+
+/** Resets the PHY and starts the autonegotiation of all the speeds (1000 Mbit/s in full duplex only). */
+static bool init_phy() {
+  if (!mdio_write(MII_BMCR, BMCR_RESET))
+    return false;
+
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + PHY_RESET_TIMEOUT_MS;
+  uint32_t bmcr;
+  do {
+    if (!mdio_read(MII_BMCR, &bmcr) || GenericTimer::get_elapsed_time_in_ms() > end)
+      return false;
+  } while ((bmcr & BMCR_RESET) != 0);
+
+  const uint32_t advertise =
+      ADVERTISE_CSMA | ADVERTISE_10HALF | ADVERTISE_10FULL | ADVERTISE_100HALF | ADVERTISE_100FULL;
+  return mdio_write(MII_ADVERTISE, advertise) && mdio_write(MII_CTRL1000, ADVERTISE_1000FULL) &&
+         mdio_write(MII_BMCR, BMCR_ANENABLE | BMCR_ANRESTART);
+}
+
+/** Reads the negotiated speed in Mbit/s (0 if the link is down), and its duplex into @a is_full_duplex. */
+static uint32_t read_link_speed(bool* is_full_duplex) {
+  // The link status is latched low until read, the second read is the current one.
+  uint32_t bmsr;
+  if (!mdio_read(MII_BMSR, &bmsr) || !mdio_read(MII_BMSR, &bmsr))
+    return 0;
+  if ((bmsr & BMSR_LSTATUS) == 0 || (bmsr & BMSR_ANEGCOMPLETE) == 0)
+    return 0;
+
+  uint32_t ctrl1000, stat1000, advertise, lpa;
+  if (!mdio_read(MII_CTRL1000, &ctrl1000) || !mdio_read(MII_STAT1000, &stat1000) ||
+      !mdio_read(MII_ADVERTISE, &advertise) || !mdio_read(MII_LPA, &lpa))
+    return 0;
+
+  *is_full_duplex = true;
+  if ((ctrl1000 & ADVERTISE_1000FULL) != 0 && (stat1000 & LPA_1000FULL) != 0)
+    return 1000;
+
+  // The LPA bits are at the same position as the ADVERTISE ones.
+  const uint32_t common = advertise & lpa;
+  if ((common & ADVERTISE_100FULL) != 0)
+    return 100;
+  *is_full_duplex = false;
+  if ((common & ADVERTISE_100HALF) != 0)
+    return 100;
+  *is_full_duplex = (common & ADVERTISE_10FULL) != 0;
+  return 10;
+}
+
+/** Configures the MAC for the speed of the link, once up. */
+static void configure_link(uint32_t speed, bool is_full_duplex) {
+  const uint32_t speed_bits = speed == 1000 ? CMD_SPEED_1000 : (speed == 100 ? CMD_SPEED_100 : CMD_SPEED_10);
+  uint32_t cmd = read(UMAC_CMD) & ~(CMD_SPEED_MASK | CMD_HD_EN);
+  cmd |= speed_bits << CMD_SPEED_SHIFT;
+  if (!is_full_duplex)
+    cmd |= CMD_HD_EN;
+  write(UMAC_CMD, cmd);
+
+  write(EXT_RGMII_OOB_CTRL, (read(EXT_RGMII_OOB_CTRL) & ~OOB_DISABLE) | RGMII_LINK);
+}
+
+static void poll_link() {
+  bool is_full_duplex = false;
+  const uint32_t speed = read_link_speed(&is_full_duplex);
+  if (speed == g_link_speed && is_full_duplex == g_is_full_duplex)
+    return;
+
+  g_link_speed = speed;
+  g_is_full_duplex = is_full_duplex;
+  if (speed == 0) {
+    LOG_INFO("[Ethernet] Link down");
+    return;
+  }
+
+  configure_link(speed, is_full_duplex);
+  LOG_INFO("[Ethernet] Link up at {} Mbit/s, {} duplex", speed, is_full_duplex ? "full" : "half");
+}
+
+static void run_link_poll() {
+  while (true) {
+    {
+      KernelTaskLockGuard kernel_lock;
+      poll_link();
+    }
+
+    sys_usleep(LINK_POLL_PERIOD_US);
+  }
+}
+
+/*
+ * RX and TX rings
+ */
+
+static void set_descriptor_address(uint32_t dma, size_t desc, PhysicalPA pa) {
+  write(dma + desc * DESC_SIZE + DESC_ADDRESS_LO, (uint32_t)pa);
+  write(dma + desc * DESC_SIZE + DESC_ADDRESS_HI, (uint32_t)(pa >> 32));
+}
+
+/** Gives the RX slot @a slot to the RX descriptor @a desc. */
+static void arm_rx_descriptor(size_t desc, uint32_t slot) {
+  // No line of the slot must be written back over the frames written by the DMA.
+  g_slots->invalidate(slot_offset(slot), SLOT_SIZE);
+  g_rx_desc_slots[desc] = slot;
+  set_descriptor_address(RDMA, desc, g_slots_pa + slot_offset(slot));
+}
+
+static bool has_pending_rx_frames() {
+  return g_rx_pending_head != g_rx_pending_tail;
+}
+
+/** Moves the frames received by the DMA to the pending frames, giving their descriptors free slots. */
+static void process_rx() {
+  const uint32_t prod_index = read(RDMA + RING + RDMA_PROD_INDEX) & INDEX_MASK;
+  if (prod_index == g_rx_cons_index)
+    return;
+
+  for (; g_rx_cons_index != prod_index; g_rx_cons_index = (g_rx_cons_index + 1) & INDEX_MASK) {
+    const size_t desc = g_rx_cons_index % RING_SIZE;
+    const uint32_t status = read(RDMA + desc * DESC_SIZE + DESC_LENGTH_STATUS);
+    const size_t length = (status >> DESC_LENGTH_SHIFT) & DESC_LENGTH_MASK;
+
+    // The frames larger than a descriptor or erroneous are dropped, their descriptor keeps its slot.
+    if ((status & (DESC_SOP | DESC_EOP)) != (DESC_SOP | DESC_EOP) || (status & DESC_RX_ERRORS) != 0 ||
+        length <= RX_PADDING || length > SLOT_SIZE) {
+      g_stats.nb_rx_errors++;
+      continue;
+    }
+
+    if (g_rx_nb_free_slots == 0) {
+      g_stats.nb_rx_dropped++;
+      continue;
+    }
+
+    const uint32_t slot = g_rx_desc_slots[desc];
+    // The CPU may have speculatively loaded lines of the slot while the DMA was writing it.
+    g_slots->invalidate(slot_offset(slot), length);
+    g_rx_pending_slots[g_rx_pending_tail % RX_SLOT_COUNT] = slot;
+    g_rx_pending_sizes[g_rx_pending_tail % RX_SLOT_COUNT] = length - RX_PADDING;
+    g_rx_pending_tail++;
+
+    arm_rx_descriptor(desc, g_rx_free_slots[--g_rx_nb_free_slots]);
+    g_stats.nb_rx_frames++;
+    g_stats.nb_rx_bytes += length - RX_PADDING;
+  }
+
+  write(RDMA + RING + RDMA_CONS_INDEX, g_rx_cons_index);
+}
+
+/** Recycles the slots of the frames sent by the DMA. */
+static void reclaim_tx() {
+  const uint32_t cons_index = read(TDMA + RING + TDMA_CONS_INDEX) & INDEX_MASK;
+  for (; g_tx_cons_index != cons_index; g_tx_cons_index = (g_tx_cons_index + 1) & INDEX_MASK)
+    g_tx_free_slots[g_tx_nb_free_slots++] = g_tx_desc_slots[g_tx_cons_index % RING_SIZE];
+}
+
+static void handle_irq(void*) {
+  const uint32_t status = read(INTRL2_0 + INTRL2_STAT) & ~read(INTRL2_0 + INTRL2_MASK_STATUS);
+  write(INTRL2_0 + INTRL2_CLEAR, status);
+  g_stats.nb_irqs++;
+
+  if ((status & IRQ_RXDMA_MBDONE) != 0) {
+    process_rx();
+    if (has_pending_rx_frames())
+      g_rx_wait_list.wake_all();
+  }
+
+  if ((status & IRQ_TXDMA_MBDONE) != 0) {
+    reclaim_tx();
+    if (g_tx_nb_free_slots > 0) {
+      // Only unmasked while a task waits for a slot.
+      write(INTRL2_0 + INTRL2_MASK_SET, IRQ_TXDMA_MBDONE);
+      g_tx_wait_list.wake_all();
+    }
+  }
+}
+
+/** Stops the RX and TX DMA, and waits for their ongoing transfers. */
+static bool stop_dma() {
+  write(RDMA + DMA + DMA_CTRL, read(RDMA + DMA + DMA_CTRL) & ~DMA_EN);
+  write(TDMA + DMA + DMA_CTRL, read(TDMA + DMA + DMA_CTRL) & ~DMA_EN);
+
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + DMA_STOP_TIMEOUT_MS;
+  while ((read(RDMA + DMA + DMA_STATUS) & DMA_DISABLED) == 0 || (read(TDMA + DMA + DMA_STATUS) & DMA_DISABLED) == 0) {
+    if (GenericTimer::get_elapsed_time_in_ms() > end)
+      return false;
+    libk::yield();
+  }
+
+  return true;
+}
+
+static void init_rings() {
+  // The RX ring, with the RX slots then its coalescing.
+  for (size_t desc = 0; desc < RING_SIZE; ++desc)
+    arm_rx_descriptor(desc, desc);
+  for (size_t slot = RING_SIZE; slot < RX_SLOT_COUNT; ++slot)
+    g_rx_free_slots[g_rx_nb_free_slots++] = slot;
+
+  write(RDMA + RING + RDMA_PROD_INDEX, 0);
+  write(RDMA + RING + RDMA_CONS_INDEX, 0);
+  write(RDMA + RING + DMA_RING_BUF_SIZE, (RING_SIZE << 16) | SLOT_SIZE);
+  write(RDMA + RING + RDMA_XON_XOFF_THRESH, (RX_XON_THRESH << 16) | (RING_SIZE >> 4));
+  write(RDMA + RING + DMA_START_ADDR, 0);
+  write(RDMA + RING + DMA_END_ADDR, RING_SIZE * DESC_WORDS - 1);
+  write(RDMA + RING + RDMA_READ_PTR, 0);
+  write(RDMA + RING + RDMA_WRITE_PTR, 0);
+  write(RDMA + RING + DMA_MBUF_DONE_THRESH, RX_COALESCE_FRAMES);
+  write(RDMA + DMA + DMA_RING16_TIMEOUT, libk::div_round_up(RX_COALESCE_US * 1000, DMA_TIMEOUT_STEP_NS));
+
+  // The TX ring, a completion is signaled for each frame (only used to wait for a free slot).
+  for (size_t i = 0; i < TX_SLOT_COUNT; ++i)
+    g_tx_free_slots[g_tx_nb_free_slots++] = RX_SLOT_COUNT + i;
+
+  write(TDMA + RING + TDMA_PROD_INDEX, 0);
+  write(TDMA + RING + TDMA_CONS_INDEX, 0);
+  write(TDMA + RING + DMA_MBUF_DONE_THRESH, 1);
+  write(TDMA + RING + TDMA_FLOW_PERIOD, 0);
+  write(TDMA + RING + DMA_RING_BUF_SIZE, (RING_SIZE << 16) | SLOT_SIZE);
+  write(TDMA + RING + DMA_START_ADDR, 0);
+  write(TDMA + RING + DMA_END_ADDR, RING_SIZE * DESC_WORDS - 1);
+  write(TDMA + RING + TDMA_READ_PTR, 0);
+  write(TDMA + RING + TDMA_WRITE_PTR, 0);
+
+  for (const uint32_t dma : {RDMA, TDMA}) {
+    write(dma + DMA + DMA_SCB_BURST_SIZE, DMA_MAX_BURST_LENGTH);
+    write(dma + DMA + DMA_RING_CFG, DMA_RING16_CFG_EN);
+    write(dma + DMA + DMA_CTRL, DMA_RING16_BUF_EN | DMA_EN);
+  }
+}
+
+/*
+ * Initialization
+ */
+
+/** Reads the address of the controller. Its node is under /scb, whose addresses are 2 cells wide (unlike the
+ * /soc ones expected by KernelDT::get_device_address()). */
+static bool get_base_address(const Node& node, uintptr_t* base) {
+  Property reg;
+  if (!node.find_property("reg", &reg))
+    return false;
+
+  // <address size>, with a single size cell.
+  size_t index = 0;
+  uint64_t soc_address = 0;
+  if (!reg.get_variable_int(&index, &soc_address, reg.length >= 3 * sizeof(uint32_t)))
+    return false;
+
+  *base = KernelDT::convert_soc_address(soc_address);
+  return true;
+}
+
+static void read_mac_address(const Node& node) {
+  // Set by the firmware, from the OTP of the board.
+  Property prop;
+  if (node.find_property("local-mac-address", &prop) && prop.length == MAC_ADDRESS_SIZE) {
+    libk::memcpy(g_mac_address, prop.data, MAC_ADDRESS_SIZE);
+    if ((g_mac_address[0] | g_mac_address[1] | g_mac_address[2] | g_mac_address[3] | g_mac_address[4] |
+         g_mac_address[5]) != 0)
+      return;
+  }
+
+  // A locally administered address, stable for the board.
+  const uint64_t serial = KernelDT::get_board_serial();
+  g_mac_address[0] = 0x02;
+  for (size_t i = 1; i < MAC_ADDRESS_SIZE; ++i)
+    g_mac_address[i] = (uint8_t)(serial >> ((MAC_ADDRESS_SIZE - 1 - i) * 8));
+  LOG_WARNING("[Ethernet] No MAC address in the device tree, using a local one");
+}
+
+static void read_phy_address(const Node& node) {
+  Property prop;
+  Node phy_node;
+  if (!node.find_property("phy-handle", &prop) || !prop.get_u32().has_value() ||
+      !KernelDT::find_node_by_phandle(prop.get_u32().get_value(), &phy_node))
+    return;
+
+  if (phy_node.find_property("reg", &prop) && prop.get_u32().has_value())
+    g_phy_address = prop.get_u32().get_value();
+}
+
+static void reset_umac() {
+  write(SYS_RBUF_FLUSH_CTRL, read(SYS_RBUF_FLUSH_CTRL) | (1 << 1));
+  delay_us(10);
+  write(SYS_RBUF_FLUSH_CTRL, read(SYS_RBUF_FLUSH_CTRL) & ~(1 << 1));
+  delay_us(10);
+  write(SYS_RBUF_FLUSH_CTRL, 0);
+
+  // The soft reset is done in local loopback, for a stable RX clock.
+  write(UMAC_CMD, 0);
+  write(UMAC_CMD, CMD_SW_RESET | CMD_LCL_LOOP_EN);
+  delay_us(2);
+  write(UMAC_CMD, 0);
+
+  write(UMAC_MIB_CTRL, MIB_RESET_ALL);
+  write(UMAC_MIB_CTRL, 0);
+  write(UMAC_MAX_FRAME_LEN, 1536);
+  write(RBUF_CTRL, read(RBUF_CTRL) | RBUF_ALIGN_2B);
+  write(RBUF_TBUF_SIZE_CTRL, 1);
+
+  write(UMAC_TX_FLUSH, 1);
+  delay_us(10);
+  write(UMAC_TX_FLUSH, 0);
+
+  for (const uint32_t intrl2 : {INTRL2_0, INTRL2_1}) {
+    write(intrl2 + INTRL2_MASK_SET, 0xffffffff);
+    write(intrl2 + INTRL2_CLEAR, 0xffffffff);
+  }
+}
+
+static void set_mac_filter() {
+  const uint8_t* mac = g_mac_address;
+  write(UMAC_MAC0, (mac[0] << 24) | (mac[1] << 16) | (mac[2] << 8) | mac[3]);
+  write(UMAC_MAC1, (mac[4] << 8) | mac[5]);
+
+  // Each filter is an address on two registers: its first 2 bytes, then the other 4.
+  write(UMAC_MDF_ADDR + 0, 0xffff);
+  write(UMAC_MDF_ADDR + 4, 0xffffffff);
+  write(UMAC_MDF_ADDR + 8, (mac[0] << 8) | mac[1]);
+  write(UMAC_MDF_ADDR + 12, (mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5]);
+  write(UMAC_MDF_CTRL, MDF_ENABLE_2_FILTERS);
+}
+
+/** Checks that @a node is a GENET controller, "ethernet0" is the USB one on the Raspberry Pi 3. */
+static bool is_genet(const Node& node) {
+  Property compatible;
+  if (!node.find_property("compatible", &compatible) || !compatible.get_string_list().has_value())
+    return false;
+
+  for (const auto comp : compatible.get_string_list().get_value()) {
+    if (comp.find("genet") != libk::StringView::npos)
+      return true;
+  }
+
+  return false;
+}
+
+bool init() {
+  Node node;
+  if (!KernelDT::get_device_node("ethernet0", &node) || !is_genet(node) || !get_base_address(node, &g_base)) {
+    LOG_WARNING("[Ethernet] No controller");
+    return false;
+  }
+
+  const uint32_t major = (read(SYS_REV_CTRL) >> REV_MAJOR_SHIFT) & 0xf;
+  if (major != REV_MAJOR_V5) {
+    LOG_WARNING("[Ethernet] Unsupported GENET revision {:#x}", read(SYS_REV_CTRL));
+    return false;
+  }
+
+  read_mac_address(node);
+  read_phy_address(node);
+
+  reset_umac();
+  set_mac_filter();
+
+  // The Pi 4 PHY is on RGMII, with the RX delay added by the PHY ("rgmii-rxid") or by none of them.
+  write(SYS_PORT_CTRL, PORT_MODE_EXT_GPHY);
+  uint32_t oob_ctrl = read(EXT_RGMII_OOB_CTRL) | RGMII_MODE_EN;
+  Property phy_mode;
+  if (node.find_property("phy-mode", &phy_mode) && phy_mode.get_string().has_value() &&
+      phy_mode.get_string().get_value() == "rgmii")
+    oob_ctrl |= ID_MODE_DIS;
+  write(EXT_RGMII_OOB_CTRL, oob_ctrl);
+
+  if (!init_phy()) {
+    LOG_WARNING("[Ethernet] The PHY {} does not answer", g_phy_address);
+    return false;
+  }
+
+  // Never moved, the DMA addresses are the physical ones.
+  g_slots = new Buffer(SLOT_COUNT * SLOT_SIZE);
+  KASSERT(g_slots != nullptr);
+  g_slots->pin();
+  g_slots_pa = memory_impl::resolve_kernel_va((VirtualAddress)g_slots->get(), false);
+
+  if (!stop_dma()) {
+    LOG_WARNING("[Ethernet] The DMA does not stop");
+    return false;
+  }
+
+  init_rings();
+
+  IRQManager::register_irq_handler(VC_GENET_0, &handle_irq, nullptr);
+  write(INTRL2_0 + INTRL2_MASK_CLEAR, IRQ_RXDMA_MBDONE);
+
+  // The speed is set once the link is up.
+  write(UMAC_CMD, CMD_RX_PAUSE_IGNORE | CMD_TX_PAUSE_IGNORE | CMD_TX_EN | CMD_RX_EN |
+                      (CMD_SPEED_1000 << CMD_SPEED_SHIFT));
+
+  auto task = TaskManager::get().create_kernel_task(&run_link_poll);
+  KASSERT(task != nullptr);
+  TaskManager::get().wake_task(task);
+
+  g_is_initialized = true;
+  uint64_t mac = 0;
+  for (const uint8_t byte : g_mac_address)
+    mac = (mac << 8) | byte;
+  LOG_INFO("[Ethernet] GENET v5, MAC address {:#x}, PHY {}", mac, g_phy_address);
+  return true;
+}
+
+bool is_initialized() {
+  return g_is_initialized;
+}
+
+void stop() {
+  if (!g_is_initialized)
+    return;
+
+  // No more frame is written into the slots once the DMA is stopped.
+  write(UMAC_CMD, read(UMAC_CMD) & ~(CMD_TX_EN | CMD_RX_EN));
+  write(INTRL2_0 + INTRL2_MASK_SET, 0xffffffff);
+  if (!stop_dma())
+    LOG_WARNING("[Ethernet] The DMA does not stop");
+}
+
+void get_mac_address(uint8_t mac_address[MAC_ADDRESS_SIZE]) {
+  libk::memcpy(mac_address, g_mac_address, MAC_ADDRESS_SIZE);
+}
+
+uint32_t get_link_speed() {
+  return g_link_speed;
+}
+
+const Stats& get_stats() {
+  return g_stats;
+}
+
+/*
+ * Frames
+ */
+
+bool receive(Frame* frame) {
+  KASSERT(g_is_initialized);
+  // The frames below the coalescing threshold are only signaled by the timeout, take them now.
+  if (!has_pending_rx_frames())
+    process_rx();
+  if (!has_pending_rx_frames())
+    return false;
+
+  const size_t index = g_rx_pending_head++ % RX_SLOT_COUNT;
+  frame->slot = g_rx_pending_slots[index];
+  frame->data = slot_data(frame->slot) + RX_PADDING;
+  frame->byte_size = g_rx_pending_sizes[index];
+  return true;
+}
+
+void release(const Frame& frame) {
+  KASSERT(frame.slot < RX_SLOT_COUNT && g_rx_nb_free_slots < RX_SLOT_COUNT);
+  g_rx_free_slots[g_rx_nb_free_slots++] = frame.slot;
+}
+
+bool block_task_until_received(const libk::IntrusivePtr<Task>& task) {
+  KASSERT(g_is_initialized);
+  if (!has_pending_rx_frames())
+    process_rx();
+  if (has_pending_rx_frames())
+    return false;
+
+  g_rx_wait_list.add(task);
+  return true;
+}
+
+bool allocate_tx_frame(Frame* frame) {
+  KASSERT(g_is_initialized);
+  if (g_tx_nb_free_slots == 0)
+    reclaim_tx();
+  if (g_tx_nb_free_slots == 0)
+    return false;
+
+  frame->slot = g_tx_free_slots[--g_tx_nb_free_slots];
+  frame->data = slot_data(frame->slot);
+  frame->byte_size = MAX_FRAME_SIZE;
+  return true;
+}
+
+void send(const Frame& frame, size_t byte_size) {
+  KASSERT(frame.slot >= RX_SLOT_COUNT && frame.slot < SLOT_COUNT);
+  const size_t offset = frame.data - slot_data(frame.slot);
+  const size_t frame_size = libk::max(byte_size, MIN_FRAME_SIZE);
+  KASSERT(byte_size <= MAX_FRAME_SIZE && offset + frame_size <= SLOT_SIZE);
+  if (byte_size < MIN_FRAME_SIZE)
+    libk::bzero(frame.data + byte_size, MIN_FRAME_SIZE - byte_size);
+
+  g_slots->clean(slot_offset(frame.slot) + offset, frame_size);
+
+  const size_t desc = g_tx_prod_index % RING_SIZE;
+  g_tx_desc_slots[desc] = frame.slot;
+  set_descriptor_address(TDMA, desc, g_slots_pa + slot_offset(frame.slot) + offset);
+  write(TDMA + desc * DESC_SIZE + DESC_LENGTH_STATUS,
+        (frame_size << DESC_LENGTH_SHIFT) | DESC_SOP | DESC_EOP | DESC_TX_APPEND_CRC | DESC_TX_QTAG);
+
+  g_tx_prod_index = (g_tx_prod_index + 1) & INDEX_MASK;
+  write(TDMA + RING + TDMA_PROD_INDEX, g_tx_prod_index);
+
+  g_stats.nb_tx_frames++;
+  g_stats.nb_tx_bytes += frame_size;
+}
+
+void discard_tx_frame(const Frame& frame) {
+  KASSERT(frame.slot >= RX_SLOT_COUNT && frame.slot < SLOT_COUNT && g_tx_nb_free_slots < TX_SLOT_COUNT);
+  g_tx_free_slots[g_tx_nb_free_slots++] = frame.slot;
+}
+
+bool block_task_until_tx_slot_free(const libk::IntrusivePtr<Task>& task) {
+  KASSERT(g_is_initialized);
+  reclaim_tx();
+  if (g_tx_nb_free_slots > 0)
+    return false;
+
+  // The interrupt of the next completion reclaims the slots and wakes the task.
+  g_tx_wait_list.add(task);
+  write(INTRL2_0 + INTRL2_MASK_CLEAR, IRQ_TXDMA_MBDONE);
+  return true;
+}
+}  // namespace Ethernet
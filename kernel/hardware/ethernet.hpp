@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "task/wait_list.hpp"
+
+/**
+ * The Ethernet driver of the Raspberry Pi 4: the Broadcom GENET v5 controller (the "ethernet0" device) and its
+ * BCM54213 PHY, exposed as a raw frames device.
+ *
+ * The frames are moved by the DMA of the controller, through its rings of descriptors (RX and TX, in the
+ * controller itself). Their data lives in fixed size slots of a single pinned Buffer, there are more RX slots
+ * than RX descriptors: a received frame is read in place while its descriptor is already given back to the
+ * controller with a free slot, and its own slot is recycled once released. A frame is sent from the TX slot it
+ * was written into. The RX interrupt is coalesced: it is raised after RX_COALESCE_FRAMES frames, or at most
+ * RX_COALESCE_US after the first one. The TX completions are only reclaimed when a TX slot is needed.
+ *
+ * The PHY is configured through MDIO to autonegotiate the link, which is then polled by a kernel task to follow
+ * its speed. All the functions must be called with the kernel lock held.
+ */
+namespace Ethernet {
+static constexpr size_t MAC_ADDRESS_SIZE = 6;
+/** The maximum byte size of a frame (destination, source, type and payload), the CRC is handled by the
+ * controller. The shorter frames are padded to MIN_FRAME_SIZE when sent. */
+static constexpr size_t MAX_FRAME_SIZE = 1514;
+static constexpr size_t MIN_FRAME_SIZE = 60;
+
+static constexpr size_t RX_SLOT_COUNT = 384;
+static constexpr size_t TX_SLOT_COUNT = 128;
+static constexpr uint32_t RX_COALESCE_FRAMES = 16;
+static constexpr uint32_t RX_COALESCE_US = 100;
+
+/** A frame in a slot of the driver, read or written in place. */
+struct Frame {
+  uint8_t* data;
+  size_t byte_size;
+  uint32_t slot;
+};  // struct Frame
+
+struct Stats {
+  uint64_t nb_rx_frames;
+  uint64_t nb_rx_bytes;
+  uint64_t nb_rx_errors;
+  uint64_t nb_rx_dropped;  // no free slot, all of them held by unreleased frames
+  uint64_t nb_tx_frames;
+  uint64_t nb_tx_bytes;
+  uint64_t nb_irqs;
+};  // struct Stats
+
+/** Detects and initializes the controller and its PHY, and starts the link polling task. Returns false if
+ * there is no (supported) controller. */
+[[nodiscard]] bool init();
+[[nodiscard]] bool is_initialized();
+/** Stops the controller and its DMA, before restarting into another kernel (see Kexec). The driver must not be
+ * used anymore. */
+void stop();
+
+void get_mac_address(uint8_t mac_address[MAC_ADDRESS_SIZE]);
+/** Returns the speed of the link in Mbit/s, or 0 if it is down. */
+[[nodiscard]] uint32_t get_link_speed();
+[[nodiscard]] const Stats& get_stats();
+
+/** Takes the oldest received frame, its slot is recycled by release(). Returns false if there is none. */
+[[nodiscard]] bool receive(Frame* frame);
+void release(const Frame& frame);
+/** Blocks @a task until a frame is received. Returns false without blocking if there is already one. */
+bool block_task_until_received(const libk::IntrusivePtr<Task>& task);
+
+/** Takes a free TX slot, to write a frame of at most MAX_FRAME_SIZE into and then send() it. Returns false if
+ * all the slots are being sent. */
+[[nodiscard]] bool allocate_tx_frame(Frame* frame);
+/** Sends the @a byte_size bytes at the data of @a frame (returned by allocate_tx_frame(), the data may have been
+ * moved within its slot), its slot is recycled once sent. */
+void send(const Frame& frame, size_t byte_size);
+/** Gives back the slot of @a frame (returned by allocate_tx_frame()) without sending it. */
+void discard_tx_frame(const Frame& frame);
+/** Blocks @a task until a TX slot is free. Returns false without blocking if there is already one. */
+bool block_task_until_tx_slot_free(const libk::IntrusivePtr<Task>& task);
+};  // namespace Ethernet
@@ -0,0 +1,50 @@
+#include "fpu.hpp"
+#include "hardware/smp.hpp"
+#include "task/task.hpp"
+
+namespace FPU {
+// The task whose registers are loaded in each core, if any.
+static const Task* g_owners[SMP::MAX_CORES] = {};
+
+/** Traps (or not) the FP/SIMD instructions of EL0. The ones of EL1 never trap. */
+static void set_el0_access(bool enabled) {
+  // CPACR_EL1.FPEN: 0b01 traps EL0 only, 0b11 traps nothing.
+  const uint64_t cpacr = (enabled ? 0b11ull : 0b01ull) << 20;
+  asm volatile("msr CPACR_EL1, %0\n"
+               "isb" ::"r"(cpacr));
+}
+
+void switch_task(Task* old_task, Task* new_task) {
+  const size_t core_id = SMP::get_core_id();
+  if (old_task != nullptr && !old_task->is_terminated() && g_owners[core_id] == old_task)
+    old_task->get_saved_state().fpu_regs.save();
+
+  set_el0_access(new_task != nullptr && g_owners[core_id] == new_task);
+}
+
+void handle_trap(Task* task) {
+  // The registers of task may still be loaded in another core, but they were saved when it was switched
+  // out there: its saved state is up to date.
+  for (auto& owner : g_owners) {
+    if (owner == task)
+      owner = nullptr;
+  }
+
+  const size_t core_id = SMP::get_core_id();
+  task->get_saved_state().fpu_regs.restore();
+  g_owners[core_id] = task;
+  set_el0_access(true);
+}
+
+void flush(Task* task) {
+  if (g_owners[SMP::get_core_id()] == task)
+    task->get_saved_state().fpu_regs.save();
+}
+
+void release(const Task* task) {
+  for (auto& owner : g_owners) {
+    if (owner == task)
+      owner = nullptr;
+  }
+}
+}  // namespace FPU
@@ -0,0 +1,33 @@
+#pragma once
+
+class Task;
+
+/**
+ * The lazy switching of the floating-point/SIMD registers between the user tasks.
+ *
+ * The FP/SIMD instructions of EL0 trap (CPACR_EL1.FPEN) until the task running on the core owns the core
+ * registers: the registers of a task are only loaded on its first FP/SIMD instruction since it was
+ * scheduled, and only if another task used them in between. Tasks that never use them never pay for their
+ * (more than 512 bytes) state.
+ *
+ * A task may be scheduled on another core the next time, so an owner saves its registers when it is
+ * switched out. The ownership is tracked per core, and a task owns the registers of at most one core.
+ *
+ * All these functions must be called with the big kernel lock held.
+ */
+namespace FPU {
+/** Called on the calling core when @a old_task (if not null and not terminated) is switched out for
+ * @a new_task. */
+void switch_task(Task* old_task, Task* new_task);
+
+/** Handles the trap of the FP/SIMD instructions for @a task, the current task of the calling core,
+ * by giving it the core registers. */
+void handle_trap(Task* task);
+
+/** Saves the registers of @a task into its saved state, if it owns the registers of the calling core
+ * (e.g. before copying the saved state on fork). */
+void flush(Task* task);
+
+/** Forgets the task @a task that is being destroyed. */
+void release(const Task* task);
+};  // namespace FPU
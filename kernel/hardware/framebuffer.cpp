@@ -2,8 +2,14 @@
 
 #include <libk/assert.hpp>
 #include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
 #include "hardware/mailbox.hpp"
 
+#ifdef CONFIG_SPI_DISPLAY
+#include "memory/mem_alloc.hpp"
+#endif  // CONFIG_SPI_DISPLAY
+
 FrameBuffer& FrameBuffer::get() {
   static FrameBuffer framebuffer;
   return framebuffer;
@@ -65,12 +71,8 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
     uint32_t end_tag = 0;
   };  // struct PropertyMessage
 
-  // Allocate a virtual buffer double the size in case of double buffering.
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  const uint32_t requested_virtual_height = height * 2;
-#else
-  const uint32_t requested_virtual_height = height;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  // Allocate a virtual buffer holding all the buffers, one below the other.
+  const uint32_t requested_virtual_height = height * NB_BUFFERS;
 
   PropertyMessage message;
   message.set_physical_size_tag.status = 0;
@@ -80,28 +82,30 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
   message.set_virtual_size_tag.buffer.height = requested_virtual_height;
   message.set_virtual_offset_tag.buffer.x = 0;
   message.set_virtual_offset_tag.buffer.y = 0;
-  message.set_depth_tag.buffer = 32;             // 32-bits per pixel (8-bits per component)
-  message.set_pixel_order_tag.buffer = 0;        // BGR (so we have 0xRRGGBB, yep, this seems inverted but is not)
-  message.allocate_tag.buffer.alignment = 4096;  // Which value to choose?
+  message.set_depth_tag.buffer = PixelFormat::DEPTH;  // 32 (8-bits per component) or 16 (RGB565) bits per pixel
+  message.set_pixel_order_tag.buffer = 0;             // BGR (so we have 0xRRGGBB, yep, this seems inverted but is not)
+  message.allocate_tag.buffer.alignment = 4096;       // Which value to choose?
   message.get_pitch_tag.buffer = 0;
   const bool success = MailBox::send_property(message);
   if (!success)
     return false;
 
+  if (message.set_depth_tag.buffer != PixelFormat::DEPTH) {
+    LOG_ERROR("Framebuffer depth of {} bits not supported (got {})", PixelFormat::DEPTH, message.set_depth_tag.buffer);
+    return false;
+  }
+
   // Read back the responses. The GPU may have changed some requested parameters.
   m_width = message.set_virtual_size_tag.buffer.width;
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  m_height = message.set_virtual_size_tag.buffer.height / 2;
-#else
-  m_height = message.set_virtual_size_tag.buffer.height;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  m_height = message.set_virtual_size_tag.buffer.height / NB_BUFFERS;
   m_pitch = message.get_pitch_tag.buffer / sizeof(m_buffer[0]);
-  m_buffer_size = message.allocate_tag.buffer.response.size / sizeof(uint32_t);
+  m_buffer_size = message.allocate_tag.buffer.response.size / sizeof(Pixel);
 
   uint64_t buffer_address = message.allocate_tag.buffer.response.base_address;
   buffer_address &= 0x3FFFFFFF;  // convert GPU address to ARM address
   buffer_address = KernelMemory::get_virtual_vc_address(buffer_address);
-  m_buffer = (uint32_t*)buffer_address;
+  m_buffers = (Pixel*)buffer_address;
+  m_buffer = m_buffers;
 
   LOG_INFO("Framebuffer of size {}x{} allocated (requested {}x{})", m_width, m_height, width, height);
 
@@ -113,64 +117,178 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
 
   // Initially clear the framebuffer with black color. In case the VideoCore gives us
   // an uninitialized framebuffer.
-  // This is called before double buffering initialization, so both the front and back
-  // buffers are cleared.
+  // This is called before multiple buffering initialization, so all the buffers are cleared.
   clear(0x00000000);
 
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  // Display the screen 0.
-  m_is_screen0 = true;
-  set_virtual_offset(0, 0);
-  // Switch to screen 1 (the back buffer)
-  m_buffer_size = m_height * m_pitch;
-  m_buffer += m_buffer_size;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  if constexpr (NB_BUFFERS > 1) {
+    // Display the buffer 0, and draw into the buffer 1.
+    set_virtual_offset(0, 0);
+    m_buffer_size = m_height * m_pitch;
+    m_buffer_index = 1;
+    m_buffer = m_buffers + m_buffer_size;
+  }
 
   m_initialized = true;
   return true;
 }
 
+#ifdef CONFIG_SPI_DISPLAY
+bool FrameBuffer::init_spi_display(const SpiDisplay::Config& config) {
+  KASSERT(!m_initialized);
+
+  m_spi_display = SpiDisplay::create(config);
+  if (!m_spi_display)
+    return false;
+
+  // The buffer is in cached memory: the panel is only written through its DMA buffers, and the CPU converts
+  // the pixels into them.
+  m_width = m_spi_display->get_width();
+  m_height = m_spi_display->get_height();
+  m_pitch = m_width;
+  m_buffer_size = m_width * m_height;
+  m_buffers = (Pixel*)kmalloc(sizeof(Pixel) * m_buffer_size, alignof(max_align_t));
+  if (m_buffers == nullptr) {
+    m_spi_display.reset();
+    return false;
+  }
+
+  m_buffer = m_buffers;
+  m_buffer_index = 0;
+  clear(0x00000000);
+  m_initialized = true;
+  present_rect(0, 0, m_width, m_height);
+  LOG_INFO("Framebuffer of size {}x{} on the SPI display", m_width, m_height);
+  return true;
+}
+#endif  // CONFIG_SPI_DISPLAY
+
+void FrameBuffer::present_rect(int32_t x, int32_t y, int32_t width, int32_t height) {
+#ifdef CONFIG_SPI_DISPLAY
+  if (!m_spi_display)
+    return;
+
+  const int32_t left = libk::max(x, 0);
+  const int32_t top = libk::max(y, 0);
+  const int32_t right = libk::min<int32_t>(x + width, m_width);
+  const int32_t bottom = libk::min<int32_t>(y + height, m_height);
+  if (left >= right || top >= bottom)
+    return;
+
+  m_spi_display->write_rect(m_buffer, m_pitch, left, top, right - left, bottom - top);
+#else
+  (void)x;
+  (void)y;
+  (void)width;
+  (void)height;
+#endif  // CONFIG_SPI_DISPLAY
+}
+
 void FrameBuffer::clear(uint32_t color) {
-  // Clear the current framebuffer.
-  for (uint32_t i = 0; i < m_buffer_size; ++i) {
-    m_buffer[i] = color;
+  // Clear the current framebuffer (by words, two RGB565 pixels each).
+  const Pixel pixel = PixelFormat::from_argb(color);
+  if constexpr (sizeof(Pixel) == sizeof(uint32_t)) {
+    libk::memset32_large((uint32_t*)m_buffer, pixel, m_buffer_size);
+  } else {
+    libk::memset32_large((uint32_t*)m_buffer, pixel | ((uint32_t)pixel << 16), m_buffer_size / 2);
   }
 }
 
 uint32_t FrameBuffer::get_pixel(uint32_t x, uint32_t y) const {
   KASSERT(x < m_width && y < m_height);
-  return m_buffer[x + m_pitch * y];
+  return PixelFormat::to_argb(m_buffer[x + m_pitch * y]);
 }
 
 void FrameBuffer::set_pixel(uint32_t x, uint32_t y, uint32_t color) {
   KASSERT(x < m_width && y < m_height);
-  m_buffer[x + m_pitch * y] = color;
+  m_buffer[x + m_pitch * y] = PixelFormat::from_argb(color);
 }
 
 void FrameBuffer::present() {
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  if (m_is_screen0) {
-    // We are displaying screen0, switch to screen1.
-    set_virtual_offset(0, m_height);
-    // Swap back buffer <-> front buffer.
-    m_buffer -= m_buffer_size;
-  } else {
-    set_virtual_offset(0, 0);
-    m_buffer += m_buffer_size;
+  m_frame_count++;
+  m_buffer_frames[m_buffer_index] = m_frame_count;
+
+  // A panel with its own memory got the changed areas already, and keeps showing them.
+  if (has_partial_present())
+    return;
+
+  if constexpr (NB_BUFFERS > 1) {
+    // There is at most one queued flip: the buffer it shows must be displayed before flipping again.
+    finish_flip();
+    queue_flip(m_buffer_index);
+
+    // With two buffers, the next one is the displayed one until the flip is done.
+    if constexpr (NB_BUFFERS == 2)
+      finish_flip();
+
+    m_buffer_index = (m_buffer_index + 1) % NB_BUFFERS;
+    m_buffer = m_buffers + m_buffer_size * m_buffer_index;
   }
+}
+
+uint32_t FrameBuffer::get_buffer_age() const {
+  const uint64_t frame = m_buffer_frames[m_buffer_index];
+  if (frame == 0)
+    return 0;
 
-  m_is_screen0 = !m_is_screen0;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  return m_frame_count - frame + 1;
 }
 
-bool FrameBuffer::set_virtual_offset(uint32_t x, uint32_t y) {
-  struct SetVirtualOffsetTagBuffer {
-    uint32_t x;
-    uint32_t y;
-  };  // struct SetVirtualOffsetTagBuffer
+namespace {
+struct WaitForVSyncTagBuffer {
+  uint32_t unused;
+};  // struct WaitForVSyncTagBuffer
 
-  using SetVirtualOffsetTag = MailBox::PropertyTag<0x00048009, SetVirtualOffsetTagBuffer>;
+struct SetVirtualOffsetTagBuffer {
+  uint32_t x;
+  uint32_t y;
+};  // struct SetVirtualOffsetTagBuffer
+
+using WaitForVSyncTag = MailBox::PropertyTag<0x0004000e, WaitForVSyncTagBuffer>;
+using SetVirtualOffsetTag = MailBox::PropertyTag<0x00048009, SetVirtualOffsetTagBuffer>;
+
+// The tags are processed in order: the VideoCore answers once the offset is changed, after the vertical sync.
+struct alignas(16) FlipMessage {
+  uint32_t buffer_size = sizeof(FlipMessage);
+  volatile uint32_t status = 0;
+  WaitForVSyncTag wait_for_vsync_tag = {};
+  SetVirtualOffsetTag set_virtual_offset_tag = {};
+  uint32_t end_tag = 0;
+};  // struct FlipMessage
 
+// The message of the queued flip, it must stay alive until the VideoCore response.
+FlipMessage g_flip_message;
+}  // namespace
+
+void FrameBuffer::queue_flip(uint32_t index) {
+  KASSERT(!m_is_flip_pending);
+
+  g_flip_message.status = 0;
+  g_flip_message.wait_for_vsync_tag.status = sizeof(WaitForVSyncTagBuffer);
+  g_flip_message.set_virtual_offset_tag.status = sizeof(SetVirtualOffsetTagBuffer);
+  g_flip_message.set_virtual_offset_tag.buffer.x = 0;
+  g_flip_message.set_virtual_offset_tag.buffer.y = m_height * index;
+  MailBox::send_property_async(g_flip_message);
+  m_is_flip_pending = true;
+}
+
+void FrameBuffer::finish_flip() {
+  if (!m_is_flip_pending)
+    return;
+
+  MailBox::finish_async_property();
+  m_is_flip_pending = false;
+
+  if (!MailBox::check_tag_status(g_flip_message.set_virtual_offset_tag.status))
+    LOG_WARNING("[FrameBuffer] The VideoCore failed to flip the displayed buffer");
+}
+
+bool FrameBuffer::wait_for_vsync() {
+  MailBox::PropertyMessage<WaitForVSyncTag> message = {};
+  const bool success = MailBox::send_property(message);
+  return success && MailBox::check_tag_status(message.tag.status);
+}
+
+bool FrameBuffer::set_virtual_offset(uint32_t x, uint32_t y) {
   MailBox::PropertyMessage<SetVirtualOffsetTag> message = {};
   message.tag.buffer.x = x;
   message.tag.buffer.y = y;
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <cstdint>
+#include "graphics/pixel_format.hpp"
+
+#ifdef CONFIG_SPI_DISPLAY
+#include "hardware/spi_display.hpp"
+#endif  // CONFIG_SPI_DISPLAY
 
 /**
  * There can only be one framebuffer at any time that can be accessed using get().
@@ -33,9 +38,29 @@
  *   fb.present();
  * }
  * ```
+ *
+ * With CONFIG_SPI_DISPLAY, the framebuffer may instead be a copy in RAM of the memory of an SPI panel (see
+ * init_spi_display()). Then present() does nothing more, the changed areas are sent with present_rect().
  */
 class FrameBuffer {
  public:
+#if defined(CONFIG_USE_TRIPLE_BUFFERING)
+  /** Count of buffers the frames are drawn into in turn. */
+  static constexpr uint32_t NB_BUFFERS = 3;
+#elif defined(CONFIG_USE_DOUBLE_BUFFERING)
+  static constexpr uint32_t NB_BUFFERS = 2;
+#else
+  static constexpr uint32_t NB_BUFFERS = 1;
+#endif  // CONFIG_USE_TRIPLE_BUFFERING
+
+#ifdef CONFIG_FRAMEBUFFER_RGB565
+  /** The pixel format of the buffers, the colors given to the functions below are converted to it. */
+  using PixelFormat = graphics::PixelFormatRgb565;
+#else
+  using PixelFormat = graphics::PixelFormatXrgb8888;
+#endif  // CONFIG_FRAMEBUFFER_RGB565
+  using Pixel = PixelFormat::Pixel;
+
   /** @brief Returns the framebuffer instance. It should be initialized first. */
   static FrameBuffer& get();
 
@@ -43,6 +68,23 @@ class FrameBuffer {
   [[nodiscard]] bool is_initialized() const { return m_initialized; }
   /** @brief Initializes a framebuffer of the given size. */
   bool init(uint32_t width, uint32_t height);
+#ifdef CONFIG_SPI_DISPLAY
+  /** @brief Initializes the SPI panel described by @a config, and a single buffer of its size in RAM. */
+  bool init_spi_display(const SpiDisplay::Config& config);
+#endif  // CONFIG_SPI_DISPLAY
+
+  /** Checks if the screen only shows the areas given to present_rect() (it has its own memory). */
+  [[nodiscard]] bool has_partial_present() const {
+#ifdef CONFIG_SPI_DISPLAY
+    return (bool)m_spi_display;
+#else
+    return false;
+#endif  // CONFIG_SPI_DISPLAY
+  }
+  /** @brief Sends the area at (x, y) of the current buffer to the screen, if has_partial_present().
+   *
+   * The area is clipped to the framebuffer. It is read before this returns, so it can be drawn again. */
+  void present_rect(int32_t x, int32_t y, int32_t width, int32_t height);
 
   /** @brief Converts a color to 0xAARRGGBB format suitable to be directly written to the buffer. */
   [[gnu::always_inline, nodiscard]] constexpr static uint32_t from_rgb(uint8_t r,
@@ -68,13 +110,29 @@ class FrameBuffer {
    *
    * To be called after a frame was rendered.
    *
-   * This effectively swaps the front and back buffer if double buffering
-   * is enabled. Otherwise, this function does nothing. */
+   * This effectively flips to the current buffer (at the next vertical sync) if double or triple
+   * buffering is enabled. Otherwise, this function does nothing. The buffer returned by get_buffer()
+   * changes after each present in this case.
+   *
+   * With double buffering, this waits for the flip (the next buffer is the displayed one until then).
+   * With triple buffering, the flip is queued and this only waits for the previous one: the next frame
+   * can be drawn while the presented one waits for the vertical sync. */
   void present();
 
+  /** @brief Gets the age of the buffer returned by get_buffer().
+   *
+   * The age is 1 if the buffer holds the last presented frame, 2 if it holds the frame before, and so on.
+   * It is 0 if the buffer content is unknown (never presented). So what changed in the last age - 1
+   * frames must be drawn again, in addition to what changed in the new frame. */
+  [[nodiscard]] uint32_t get_buffer_age() const;
+
+  /** @brief Blocks until the next vertical sync of the display.
+   * @returns `false` if the firmware does not support it (nothing is done in this case). */
+  bool wait_for_vsync();
+
   /** @brief Gets the internal framebuffer buffer. */
-  [[nodiscard]] uint32_t* get_buffer() { return m_buffer; }
-  [[nodiscard]] const uint32_t* get_buffer() const { return m_buffer; }
+  [[nodiscard]] Pixel* get_buffer() { return m_buffer; }
+  [[nodiscard]] const Pixel* get_buffer() const { return m_buffer; }
 
   /** @brief Gets the framebuffer width, in pixels. */
   [[nodiscard]] uint32_t get_width() const { return m_width; }
@@ -83,7 +141,7 @@ class FrameBuffer {
   /** @brief Gets the framebuffer pitch, in pixels. */
   [[nodiscard]] uint32_t get_pitch() const { return m_pitch; }
   /** @brief Gets the framebuffer size, in bytes. */
-  [[nodiscard]] uint32_t get_byte_size() const { return m_buffer_size * sizeof(uint32_t); }
+  [[nodiscard]] uint32_t get_byte_size() const { return m_buffer_size * sizeof(Pixel); }
 
  private:
   // Private constructor so there can be only once instance of Framebuffer
@@ -92,15 +150,24 @@ class FrameBuffer {
 
   /** @brief Sends a SET_VIRTUAL_OFFSET request to VideoCore. */
   bool set_virtual_offset(uint32_t x, uint32_t y);
+  /** @brief Queues a flip to the buffer @a index at the next vertical sync, see finish_flip(). */
+  void queue_flip(uint32_t index);
+  /** @brief Waits for the queued flip, if any. */
+  void finish_flip();
 
-  uint32_t* m_buffer = nullptr;
-  uint32_t m_buffer_size = 0;  // in count of uint32_t, the size of either front or back buffer
+  Pixel* m_buffers = nullptr;  // the first buffer, the others follow it
+  Pixel* m_buffer = nullptr;   // the current buffer, to draw into
+  uint32_t m_buffer_index = 0;
+  uint32_t m_buffer_size = 0;  // in count of pixels, the size of one buffer
   uint32_t m_width = 0;        // in pixels
   uint32_t m_height = 0;       // in pixels
   uint32_t m_pitch = 0;        // length of a row, in pixels (this may be greater than the frame width)
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  // display screen when using double buffering
-  bool m_is_screen0 = true;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  // Count of presented frames, and the frame each buffer was last presented at (0 if never).
+  uint64_t m_frame_count = 0;
+  uint64_t m_buffer_frames[NB_BUFFERS] = {};
+  bool m_is_flip_pending = false;
   bool m_initialized = false;
+#ifdef CONFIG_SPI_DISPLAY
+  libk::ScopedPointer<SpiDisplay> m_spi_display;
+#endif  // CONFIG_SPI_DISPLAY
 };  // class FrameBuffer
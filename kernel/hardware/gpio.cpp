@@ -180,6 +180,28 @@ void write(size_t gpio_pin, bool on) {
   }
 }
 
+void write_mask(uint64_t set_mask, uint64_t clear_mask) {
+  // The writes of 0 bits have no effect, so the banks without any change are skipped.
+  for (size_t reg = 0; reg < 2; ++reg) {
+    const auto set_bits = (uint32_t)(set_mask >> (32 * reg));
+    const auto clear_bits = (uint32_t)(clear_mask >> (32 * reg));
+    if (set_bits != 0)
+      libk::write32(gpio_base + GPSET + sizeof(uint32_t) * reg, set_bits);
+    if (clear_bits != 0)
+      libk::write32(gpio_base + GPCLR + sizeof(uint32_t) * reg, clear_bits);
+  }
+}
+
+bool get_output_bus_addresses(uint32_t* set_address, uint32_t* clear_address) {
+  uintptr_t soc_address;
+  if (!KernelDT::get_device_soc_address("gpio", &soc_address))
+    return false;
+
+  *set_address = soc_address + GPSET;
+  *clear_address = soc_address + GPCLR;
+  return true;
+}
+
 bool has_event(size_t gpio_pin) {
   const uint8_t reg = gpio_pin / 32;
   const uint8_t shift = gpio_pin % 32;
@@ -45,6 +45,14 @@ bool read(size_t gpio_pin);
 /** Sets a gpio pin to an OUTPUT and write the specified value to it. */
 void write(size_t gpio_pin, bool on);
 
+/** Sets the pins of @a set_mask and clears the pins of @a clear_mask (bit i for the pin i), with at most one
+ * register write per bank of 32 pins. Unlike write(), the mode is not changed: the pins must be OUTPUT already,
+ * so that the changes are not delayed by set_mode(). */
+void write_mask(uint64_t set_mask, uint64_t clear_mask);
+
+/** Gets the bus addresses of the GPSET0 and GPCLR0 registers (pins 0 to 31), for the DMA (see Waveform). */
+[[nodiscard]] bool get_output_bus_addresses(uint32_t* set_address, uint32_t* clear_address);
+
 /** Checks if one of the event that is registered for the gpio pin @a gpio_pin has occurred.
  * If multiple event are registered for a pin, you can't detect which one it is. */
 bool has_event(size_t gpio_pin);
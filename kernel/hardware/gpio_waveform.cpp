@@ -0,0 +1,198 @@
+#include "hardware/gpio_waveform.hpp"
+
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "hardware/dma/dma_controller.hpp"
+#include "hardware/gpio.hpp"
+#include "hardware/kernel_dt.hpp"
+
+namespace GPIO {
+// Offsets from the clock manager base, the PWM clock registers are not in BCM2835-ARM-Peripherals.pdf (see the
+// clk-bcm2835 Linux driver).
+static constexpr uint32_t CM_PWMCTL = 0xa0;
+static constexpr uint32_t CM_PWMDIV = 0xa4;
+static constexpr uint32_t CM_PASSWORD = 0x5a << 24;
+static constexpr uint32_t CM_SRC_OSCILLATOR = 1;
+static constexpr uint32_t CM_ENAB = 1 << 4;
+static constexpr uint32_t CM_BUSY = 1 << 7;
+static constexpr uint32_t CM_DIVI_SHIFT = 12;
+
+// Offsets from the PWM base, taken from BCM2835-ARM-Peripherals.pdf, page 141.
+static constexpr uint32_t PWM_CTL = 0x00;
+static constexpr uint32_t PWM_STA = 0x04;
+static constexpr uint32_t PWM_DMAC = 0x08;
+static constexpr uint32_t PWM_RNG1 = 0x10;
+static constexpr uint32_t PWM_FIF1 = 0x18;
+static constexpr uint32_t PWM_CTL_PWEN1 = 1 << 0;
+static constexpr uint32_t PWM_CTL_MODE1 = 1 << 1;  // serializer mode
+static constexpr uint32_t PWM_CTL_USEF1 = 1 << 5;
+static constexpr uint32_t PWM_CTL_CLRF1 = 1 << 6;
+static constexpr uint32_t PWM_STA_FULL1 = 1 << 0;
+// The DMA is requested while the FIFO has less than 15 words, so it never runs empty.
+static constexpr uint32_t PWM_DMAC_SETTINGS = (1u << 31) | (15 << 8) | 15;
+
+/** The DREQ of the PWM, for the PERMAP field of the DMA requests. */
+static constexpr uint8_t PWM_DREQ = 5;
+/** The PWM clock is divided from the oscillator to at most this frequency. */
+static constexpr uint64_t PWM_MAX_CLOCK_HZ = 25'000'000;
+
+static bool g_is_pwm_used = false;
+static uintptr_t g_pwm_base = 0;
+
+struct PwmPacer {
+  uintptr_t pwm_base;
+  uintptr_t clock_base;
+  uint32_t fifo_bus_address;
+  uint64_t clock_hz;
+};  // struct PwmPacer
+
+/** Finds the PWM and the clock manager, and sets the PWM clock. */
+static bool init_pwm_pacer(PwmPacer* pacer) {
+  uintptr_t pwm_soc_address;
+  Property oscillator_frequency;
+  if (!KernelDT::get_device_address("pwm", &pacer->pwm_base) ||
+      !KernelDT::get_device_soc_address("pwm", &pwm_soc_address) ||
+      !KernelDT::get_device_address("clocks", &pacer->clock_base) ||
+      !KernelDT::find_property("/clocks/clk-osc/clock-frequency", &oscillator_frequency)) {
+    LOG_ERROR("The PWM or its clock is not in the device tree");
+    return false;
+  }
+
+  const auto oscillator_hz = oscillator_frequency.get_u32();
+  if (!oscillator_hz.has_value() || oscillator_hz.get_value() == 0)
+    return false;
+
+  pacer->fifo_bus_address = pwm_soc_address + PWM_FIF1;
+  const uint64_t divisor = libk::max<uint64_t>(1, libk::div_round_up(oscillator_hz.get_value(), PWM_MAX_CLOCK_HZ));
+  pacer->clock_hz = oscillator_hz.get_value() / divisor;
+
+  // The clock must be stopped (and not busy anymore) before changing its divisor.
+  libk::write32(pacer->pwm_base + PWM_CTL, 0);
+  libk::write32(pacer->clock_base + CM_PWMCTL, CM_PASSWORD | CM_SRC_OSCILLATOR);
+  while ((libk::read32(pacer->clock_base + CM_PWMCTL) & CM_BUSY) != 0)
+    libk::yield();
+
+  libk::write32(pacer->clock_base + CM_PWMDIV, CM_PASSWORD | (divisor << CM_DIVI_SHIFT));
+  libk::write32(pacer->clock_base + CM_PWMCTL, CM_PASSWORD | CM_SRC_OSCILLATOR | CM_ENAB);
+  return true;
+}
+
+libk::ScopedPointer<Waveform> Waveform::create(const Sample* samples, size_t count, uint32_t sample_period_ns) {
+  uint32_t set_address;
+  uint32_t clear_address;
+  if (count == 0 || g_is_pwm_used || !DMA::has_free_channel())
+    return nullptr;
+  if (!get_output_bus_addresses(&set_address, &clear_address))
+    return nullptr;
+
+  PwmPacer pacer;
+  if (!init_pwm_pacer(&pacer))
+    return nullptr;
+
+  libk::ScopedPointer<Waveform> waveform(new Waveform);
+  if (!waveform)
+    return nullptr;
+
+  waveform->m_pwm_range = libk::max<uint64_t>(2, sample_period_ns * pacer.clock_hz / 1'000'000'000);
+  waveform->m_sample_period_ns = waveform->m_pwm_range * 1'000'000'000 / pacer.clock_hz;
+
+  // Each sample is up to 3 requests: the set and clear writes (when not empty), and the paced FIFO write that
+  // waits for the next period.
+  const auto append_write = [&](uint32_t value, DMA::Address dst) -> DMA::Request* {
+    auto* request = DMA::Request::memcpy(0, 0, 0);
+    if (request == nullptr)
+      return nullptr;
+
+    request->set_write(value, dst);
+    if (waveform->m_first_request == nullptr)
+      waveform->m_first_request = request;
+    else
+      waveform->m_last_request->link_to(request);
+    waveform->m_last_request = request;
+    return request;
+  };
+
+  for (size_t i = 0; i < count; ++i) {
+    if (samples[i].set_mask != 0 && append_write(samples[i].set_mask, set_address) == nullptr)
+      return nullptr;
+    if (samples[i].clear_mask != 0 && append_write(samples[i].clear_mask, clear_address) == nullptr)
+      return nullptr;
+
+    auto* pace_request = append_write(0, pacer.fifo_bus_address);
+    if (pace_request == nullptr)
+      return nullptr;
+    pace_request->set_dest_dreq(PWM_DREQ);
+  }
+
+  waveform->m_channel.reset(new DMA::Channel);
+  if (!waveform->m_channel)
+    return nullptr;
+
+  g_is_pwm_used = true;
+  g_pwm_base = pacer.pwm_base;
+  return waveform;
+}
+
+Waveform::~Waveform() {
+  if (m_channel) {
+    stop();
+    g_is_pwm_used = false;
+  }
+
+  // The requests are a list, or a cycle if looping.
+  if (m_last_request != nullptr)
+    m_last_request->unlink();
+
+  DMA::Request* request = m_first_request;
+  while (request != nullptr) {
+    DMA::Request* next = request->unlink();
+    delete request;
+    request = next;
+  }
+}
+
+bool Waveform::start(bool loop, DMA::Completion* completion) {
+  if (m_is_started)
+    return false;
+
+  // The FIFO is filled first, so the first sample already waits for a whole period and the PWM then consumes a
+  // word every period.
+  libk::write32(g_pwm_base + PWM_CTL, PWM_CTL_CLRF1);
+  libk::write32(g_pwm_base + PWM_RNG1, m_pwm_range);
+  while ((libk::read32(g_pwm_base + PWM_STA) & PWM_STA_FULL1) == 0)
+    libk::write32(g_pwm_base + PWM_FIF1, 0);
+  libk::write32(g_pwm_base + PWM_DMAC, PWM_DMAC_SETTINGS);
+  libk::write32(g_pwm_base + PWM_CTL, PWM_CTL_USEF1 | PWM_CTL_MODE1 | PWM_CTL_PWEN1);
+
+  m_last_request->unlink();
+  bool is_started;
+  if (loop) {
+    m_last_request->link_to(m_first_request);
+    is_started = m_channel->execute_requests(m_first_request);
+  } else if (completion != nullptr) {
+    is_started = m_channel->submit(m_first_request, completion);
+  } else {
+    is_started = m_channel->execute_requests(m_first_request);
+  }
+
+  m_is_started = is_started;
+  return is_started;
+}
+
+void Waveform::stop() {
+  m_channel->abort_previous();
+  libk::write32(g_pwm_base + PWM_DMAC, 0);
+  libk::write32(g_pwm_base + PWM_CTL, PWM_CTL_CLRF1);
+  m_is_started = false;
+}
+
+bool Waveform::wait() {
+  KASSERT(m_last_request->next() == nullptr && "waiting for a looping waveform");
+
+  const bool has_error = m_channel->wait();
+  libk::write32(g_pwm_base + PWM_DMAC, 0);
+  libk::write32(g_pwm_base + PWM_CTL, PWM_CTL_CLRF1);
+  m_is_started = false;
+  return !has_error;
+}
+}  // namespace GPIO
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+
+#include "hardware/dma/channel.hpp"
+
+namespace GPIO {
+/**
+ * Outputs a precomputed waveform on the GPIO pins 0 to 31 without the CPU, for the bit-banged protocols.
+ *
+ * A DMA channel writes the set and clear masks of each sample into GPSET0 and GPCLR0, then writes a dummy word
+ * into the FIFO of the PWM, with the writes gated by the PWM DREQ. The PWM consumes a FIFO word every sample
+ * period (it is in serializer mode, the range being the period), so the samples are output at its pace whatever
+ * the CPU does. The PWM output itself is not routed to any pin.
+ *
+ * The PWM paces a single waveform at once, and the pins must be OUTPUT (see set_mode()).
+ */
+class Waveform {
+ public:
+  struct Sample {
+    uint32_t set_mask;    // the pins set at this sample (bit i for the pin i)
+    uint32_t clear_mask;  // the pins cleared at this sample
+  };  // struct Sample
+
+  ~Waveform();
+
+  /** Builds the DMA requests outputting @a count @a samples, one every @a sample_period_ns nanoseconds. Returns
+   * nullptr if out of memory, if no DMA channel is free, or if the PWM is unavailable or already used. */
+  [[nodiscard]] static libk::ScopedPointer<Waveform> create(const Sample* samples,
+                                                            size_t count,
+                                                            uint32_t sample_period_ns);
+
+  /** Starts the output, the waveform is repeated until stop() if @a loop. Otherwise, @a completion (if any) is
+   * signalled once the last sample is output. Returns false if already started. */
+  bool start(bool loop, DMA::Completion* completion = nullptr);
+  /** Stops the output, after any sample. */
+  void stop();
+  /** Waits for the end of the waveform (by polling the channel), it must not loop. Returns false on error. */
+  bool wait();
+
+  /** Gets the actual sample period, rounded to the PWM clock. */
+  [[nodiscard]] uint32_t get_sample_period_ns() const { return m_sample_period_ns; }
+
+ private:
+  Waveform() = default;
+
+  libk::ScopedPointer<DMA::Channel> m_channel;
+  DMA::Request* m_first_request = nullptr;
+  DMA::Request* m_last_request = nullptr;
+  uint32_t m_pwm_range = 0;  // the sample period, in PWM clock cycles
+  uint32_t m_sample_period_ns = 0;
+  bool m_is_started = false;
+};  // class Waveform
+}  // namespace GPIO
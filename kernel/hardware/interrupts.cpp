@@ -1,7 +1,16 @@
 #include "interrupts.hpp"
 #include <libk/log.hpp>
+#include "hardware/fpu.hpp"
 #include "hardware/irq/irq_manager.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "hardware/timer.hpp"
+#include "kernel_symbols.hpp"
+#include "kexec.hpp"
+#include "latency_tracer.hpp"
+#include "memory/user_access.hpp"
+#include "profiler.hpp"
 #include "task/task_manager.hpp"
+#include "trace.hpp"
 
 ExceptionLevel get_current_exception_level() {
   // The current exception level is stored in the system register CurrentEL in the bits [3:2].
@@ -28,10 +37,15 @@ void jump_to_el1() {
     default:
       break;
   }
+
+  // Gives EL0 read access to the virtual counter (CNTKCTL_EL1.EL0VCTEN), so the programs can timestamp
+  // without a system call (see sys_get_ticks()). The timers themselves stay reserved to the kernel.
+  asm volatile("msr CNTKCTL_EL1, %0" : : "r"(0b10ull));
 }
 
 static bool do_syscall(Registers& registers) {
-  auto current_task = TaskManager::get().get_current_task();
+  // The context switcher keeps a reference to the current task, no need to take another one.
+  Task* current_task = TaskManager::get().get_current_task_ptr();
   // current_task is guaranteed to be non-null here.
 
   // The system call number is stored in w8 (lower 32-bits of x8).
@@ -40,6 +54,33 @@ static bool do_syscall(Registers& registers) {
   return true;  // Syscall handled
 }
 
+/** Handles the translation faults on the demand paged (or paged out) memory of the current process, the
+ * writes to its copy-on-write pages and the accesses to its pages watched by the page-out.
+ * @returns `true` if the page is now mapped and the faulting access can be retried. */
+static bool do_page_fault(Registers& registers) {
+  // Translation faults (DFSC = 0b0001xx) are caused by pages not mapped yet (or paged out), access flag
+  // faults (DFSC = 0b0010xx) by the first access to a page since its flag was cleared, and permission faults
+  // (DFSC = 0b0011xx) on a write (WnR bit) by copy-on-write pages.
+  const uint32_t dfsc = registers.esr & 0x3F;
+  const bool is_translation_fault = (dfsc & 0b111100) == 0b000100;
+  const bool is_access_flag_fault = (dfsc & 0b111100) == 0b001000;
+  const bool is_write_fault = (dfsc & 0b111100) == 0b001100 && (registers.esr & (1 << 6)) != 0;
+  if ((!is_translation_fault && !is_access_flag_fault && !is_write_fault) || registers.far >= KERNEL_BASE ||
+      !TaskManager::get().is_ready())
+    return false;
+
+  auto current_task = TaskManager::get().get_current_task();
+  if (current_task == nullptr || current_task->get_memory() == nullptr)
+    return false;
+
+  current_task->get_cpu_stats().page_faults++;
+  if (is_translation_fault)
+    return current_task->get_memory()->handle_page_fault(registers.far);
+  if (is_access_flag_fault)
+    return current_task->get_memory()->handle_access_fault(registers.far);
+  return current_task->get_memory()->handle_write_fault(registers.far);
+}
+
 static bool do_dispatch_userspace_interrupt(Registers& registers) {
   const uint32_t ec = (registers.esr >> 26) & 0x3F;
 
@@ -53,10 +94,16 @@ static bool do_dispatch_userspace_interrupt(Registers& registers) {
       // Handle AArch64 syscall
     case 0b010101:  // SVC instruction execution in AArch64 state.
       return do_syscall(registers);
+    case 0b000111:  // Access to SIMD or floating-point registers trapped by CPACR_EL1.FPEN.
+      FPU::handle_trap(current_task.get());
+      return true;
     case 0b100000:
       LOG_WARNING("Instruction Abort from user space (pid={}) at {:#x}. PC = {:#x}", pid, far, pc);
       break;
     case 0b100100:
+      if (do_page_fault(registers))
+        return true;
+
       LOG_WARNING("Data Abort from user space (pid={}) at {:#x}. PC = {:#x}", pid, far, pc);
       break;
     case 0b100010:
@@ -120,6 +167,12 @@ static bool do_userspace_interrupt(Registers& registers) {
       break;
   }
 
+  // The stack trace of the interrupted kernel code (the one printed by the panic is the handler's).
+  if (source == InterruptSource::CURRENT_SP_EL0 || source == InterruptSource::CURRENT_SP_ELX) {
+    libk::flush_logs();
+    KernelSymbols::print_stack_trace(registers.elr, registers.gp_regs.x29);
+  }
+
   LOG_CRITICAL("Unhandled interrupt, source = {}, kind = {}\r\nELR_EL1 = {:#x}\r\nESR_EL1 = {:#x}\r\nFAR_EL1 = {:#x}",
                source_name, kind_name, registers.elr, registers.esr, registers.far);
 }
@@ -135,6 +188,13 @@ static bool do_kernelspace_interrupt(Registers& registers) {
       LOG_WARNING("Instruction Abort from kernel space at {:#x}.", registers.far);
       break;
     case 0b100101:
+      // The kernel may touch a demand paged page of the current process (e.g. a syscall buffer).
+      if (do_page_fault(registers))
+        return true;
+      // Or an invalid syscall buffer, in a copy to or from the process memory.
+      if (fixup_user_access_fault(registers))
+        return true;
+
       LOG_WARNING("Data Abort from kernel space at {:#x}.", registers.far);
       break;
     case 0b100010:
@@ -166,17 +226,30 @@ class ContextSwitcher {
     if (m_old_task != nullptr && m_old_task->is_marked_to_be_killed())
       TaskManager::get().kill_task(m_old_task);
 
+    // Stop the tick of this core if it has nothing to run, or restart it otherwise.
+    TaskManager::get().update_core_tick();
+
+    const uint64_t now = GenericTimer::get_tick_count();
+    if (m_old_task != nullptr)
+      m_old_task->account_kernel_exit(now);
+
     auto current_task = Task::current();
     if (current_task == m_old_task)
       return;
 
     if (current_task != nullptr) {
+      current_task->start_accounting(now);
       if (m_old_task != nullptr && !m_old_task->is_terminated()) {
         m_old_task->get_saved_state().save(m_regs);
       }
 
       // Do context switch.
       current_task->get_saved_state().restore(m_regs);
+      // Read by sys_getpid() without a system call.
+      asm volatile("msr TPIDRRO_EL0, %0" : : "r"((uint64_t)current_task->get_id()));
+      current_task->run_continuation(m_regs);
+      FPU::switch_task(m_old_task.get(), current_task.get());
+      TRACE_EVENT(CONTEXT_SWITCH, m_old_task != nullptr ? m_old_task->get_id() : 0, current_task->get_id());
       LOG_TRACE("Context switch to pid={} from pid={}", current_task->get_id(),
                 m_old_task ? m_old_task->get_id() : UINT16_MAX);
     } else {
@@ -189,13 +262,87 @@ class ContextSwitcher {
   TaskPtr m_old_task;
 };  // class ContextSwitcher
 
+#ifdef CONFIG_LATENCY_TRACER
+/** RAII helper timing an exception as a section with the IRQs masked (see LatencyTracer), from its entry to the
+ * exception return. The section goes on if the returned to context runs with its IRQs masked (SPSR_EL1.I). The
+ * registers are read once the context switch is done. */
+class IrqsOffSection {
+ public:
+  explicit IrqsOffSection(const Registers& registers) : m_registers(registers) {
+    LATENCY_TRACE(irqs_off, registers.elr);
+  }
+  ~IrqsOffSection() {
+    if ((m_registers.spsr & (1 << 7)) == 0)
+      LATENCY_TRACE(irqs_on);
+  }
+
+ private:
+  const Registers& m_registers;
+};  // class IrqsOffSection
+#endif  // CONFIG_LATENCY_TRACER
+
+/** Called by the fast path of the system calls from EL0 (see interrupts.S), where @a registers only holds the
+ * caller-saved registers. Returns false if the system call must go through exception_handler(). */
+extern "C" bool fast_syscall_handler(Registers& registers) {
+  LATENCY_TRACE(irqs_off, registers.elr);
+  KernelLockGuard kernel_lock;
+
+  TaskManager& task_manager = TaskManager::get();
+  if (!task_manager.is_ready())
+    return false;
+
+  Task* current_task = task_manager.get_current_task_ptr();
+  current_task->account_kernel_entry(/* from_user= */ true, GenericTimer::get_tick_count());
+
+  // The system call number is stored in w8 (lower 32-bits of x8).
+  const uint32_t syscall_id = registers.gp_regs.x8 & 0xFFFFFFFF;
+  const bool is_handled = current_task->call_fast_syscall(syscall_id, registers);
+  current_task->account_kernel_exit(GenericTimer::get_tick_count());
+  // Otherwise, the section with the IRQs masked goes on in exception_handler().
+  if (is_handled)
+    LATENCY_TRACE(irqs_on);
+  return is_handled;
+}
+
 extern "C" void exception_handler(InterruptSource source, InterruptKind kind, Registers& registers) {
+#ifdef CONFIG_LATENCY_TRACER
+  IrqsOffSection irqs_off_section(registers);
+#endif  // CONFIG_LATENCY_TRACER
+
+  // A warm restart stops the cores at their next exception, before they wait for the kernel lock (see Kexec).
+  if (Kexec::is_restarting())
+    Kexec::stop_core();
+
+  // Only one core at a time runs the kernel. The guard is released after the context switch.
+  KernelLockGuard kernel_lock;
+
   if ((source == InterruptSource::CURRENT_SP_ELX || source == InterruptSource::CURRENT_SP_EL0) &&
       kind == InterruptKind::SYNCHRONOUS) {
     if (do_kernelspace_interrupt(registers))
       return;
   }
 
+#ifdef CONFIG_PROFILER
+  // Before the dispatch, the PMU IRQ handler has not access to the interrupted registers.
+  if (kind == InterruptKind::IRQ)
+    Profiler::handle_overflow(registers);
+#endif  // CONFIG_PROFILER
+
+  if (kind == InterruptKind::IRQ && IRQManager::is_in_irq_handler()) {
+    // A higher priority IRQ interrupted an IRQ handler (see IRQManager::set_irq_priority()). The registers
+    // are the ones of the interrupted handler, any context switch is done once it returns.
+    IRQManager::handle_interrupts();
+    return;
+  }
+
+  // Charge the time since the last kernel exit to the interrupted task, see ~ContextSwitcher().
+  if (TaskManager::get().is_ready()) {
+    Task* current_task = TaskManager::get().get_current_task_ptr();
+    const bool from_user = source == InterruptSource::LOWER_AARCH64 || source == InterruptSource::LOWER_AARCH32;
+    if (current_task != nullptr)
+      current_task->account_kernel_entry(from_user, GenericTimer::get_tick_count());
+  }
+
   ContextSwitcher context_switcher(registers);
 
   if (kind == InterruptKind::IRQ) {
@@ -45,7 +45,7 @@ enum class ExceptionLevel : uint8_t {
  */
 [[nodiscard]] ExceptionLevel get_current_exception_level();
 
-/** Enables the FPU and Neon unit. To be called when in EL3 or EL2. */
+/** Enables the FPU and Neon unit for EL1 (see fpu.hpp for EL0). To be called when in EL3 or EL2. */
 extern "C" void enable_fpu_and_neon();
 
 /**
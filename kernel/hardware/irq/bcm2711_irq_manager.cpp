@@ -1,5 +1,6 @@
 #include "bcm2711_irq_manager.hpp"
 #include "hardware/kernel_dt.hpp"
+#include "hardware/smp.hpp"
 #include "irq_lists.hpp"
 #include "libk/log.hpp"
 
@@ -8,20 +9,39 @@ static inline constexpr uint32_t GICC_BASE = 0x1000;
 
 static inline constexpr uint32_t GICD_ISENABLER_BASE = GICD_BASE + 0x100;
 static inline constexpr uint32_t GICD_ICENABLER_BASE = GICD_BASE + 0x180;
+static inline constexpr uint32_t GICD_IPRIORITYR_BASE = GICD_BASE + 0x400;
 static inline constexpr uint32_t GICD_ITARGETSR_BASE = GICD_BASE + 0x800;
+static inline constexpr uint32_t GICD_SGIR = GICD_BASE + 0xF00;
 
+static inline constexpr uint32_t GICC_CTLR = GICC_BASE + 0x00;
+static inline constexpr uint32_t GICC_PMR = GICC_BASE + 0x04;
 static inline constexpr uint32_t GICC_IAR = GICC_BASE + 0x0C;
 static inline constexpr uint32_t GICC_EOIR = GICC_BASE + 0x10;
 
 static inline constexpr uint32_t ARMC_IRQ_START = 64;
 static inline constexpr uint32_t VC_IRQ_START = 96;
+// The ETH_PCIe IRQs follow the VideoCore ones, they are handled as such.
+static inline constexpr uint32_t VC_IRQ_END = VC_IRQ_START + VC_IRQ_NB + ETH_PCIE_IRQ_NB;
+
+/** GIC id of the PMU interrupt of the core 0, the next cores follow. They are SPIs, but each one is only raised
+ * by its own core (see get_local_gic_id()). */
+static inline constexpr uint32_t PMU_GIC_ID_BASE = 48;
+
+/** GIC ids of the core local (PPI and SGI) interrupts, indexed by the Local IRQ id. */
+static inline constexpr uint32_t LOCAL_IRQ_GIC_ID[LOCAL_IRQ_NB] = {29, 30, 26, 27, 0, PMU_GIC_ID_BASE};
+
+/** The GIC priorities (lower is higher), the GIC-400 only implements their 4 upper bits. An IRQ
+ * handler is interrupted by the IRQs of a higher priority group (their bits above GICC_BPR). */
+static inline constexpr uint8_t GIC_PRIORITY_HIGH = 0x40;
+static inline constexpr uint8_t GIC_PRIORITY_NORMAL = 0xA0;
 
 static uintptr_t _base;
 
+// The acknowledged IAR of SGIs, per core. Their EOIR must also include the source core id.
+static uint32_t _sgi_iar[SMP::MAX_CORES];
+
 void enable_irq_gid_range(uint32_t irq_gic_start, uint32_t irq_gid_stop) {
-  uint32_t core_id;
-  asm volatile("mrs %x0, mpidr_el1" : "=r"(core_id));
-  core_id &= 0b11;
+  const uint32_t core_id = SMP::get_core_id();
 
   for (uint32_t irq_gic_id = irq_gic_start; irq_gic_id < irq_gid_stop; ++irq_gic_id) {
     const uint32_t n = irq_gic_id / 4;
@@ -34,11 +54,41 @@ void enable_irq_gid_range(uint32_t irq_gic_start, uint32_t irq_gid_stop) {
   }
 }
 
+/** Returns the GIC id of the local IRQ @a local_id for the calling core. */
+static uint32_t get_local_gic_id(uint64_t local_id) {
+  if (local_id == LOCAL_PMU.id)
+    return PMU_GIC_ID_BASE + SMP::get_core_id();
+
+  return LOCAL_IRQ_GIC_ID[local_id];
+}
+
+static void set_gic_priority(uint32_t irq_gic_id, uint8_t priority) {
+  const uint32_t n = irq_gic_id / 4;
+  const uint32_t shift = (irq_gic_id % 4) * 8;
+  const uintptr_t reg_address = _base + GICD_IPRIORITYR_BASE + n * sizeof(uint32_t);
+
+  const uint32_t prev_val = libk::read32(reg_address);
+  libk::write32(reg_address, (prev_val & ~(0xFF << shift)) | ((uint32_t)priority << shift));
+}
+
 void BCM2711_IRQManager::init() {
   _base = KernelDT::force_get_device_address("gicv2");
 
   enable_irq_gid_range(ARMC_IRQ_START, ARMC_IRQ_START + ARMC_IRQ_NB);
-  enable_irq_gid_range(VC_IRQ_START, VC_IRQ_START + VC_IRQ_NB);
+  enable_irq_gid_range(VC_IRQ_START, VC_IRQ_END);
+
+  for (uint32_t irq_gic_id = ARMC_IRQ_START; irq_gic_id < VC_IRQ_END; ++irq_gic_id)
+    set_gic_priority(irq_gic_id, GIC_PRIORITY_NORMAL);
+}
+
+void BCM2711_IRQManager::init_core() {
+  // The priorities of the SGIs and PPIs are banked per core (the PMU SPI is only used by this core).
+  for (uint64_t local_id = 0; local_id < LOCAL_IRQ_NB; ++local_id)
+    set_gic_priority(get_local_gic_id(local_id), GIC_PRIORITY_NORMAL);
+
+  // Accept interrupts of all priorities and enable the CPU interface of the calling core.
+  libk::write32(_base + GICC_PMR, 0xFF);
+  libk::write32(_base + GICC_CTLR, libk::read32(_base + GICC_CTLR) | 0b1);
 }
 
 void enable_gic_distributor(uint32_t irq_id) {
@@ -62,6 +112,16 @@ void BCM2711_IRQManager::enable_irq(IRQ irq) {
     case IRQ::Type::VideoCore:
       enable_gic_distributor(irq.id + VC_IRQ_START);
       break;
+
+    case IRQ::Type::Local: {
+      // PPIs enable registers are banked, so this only affects the calling core. The PMU SPI of the calling
+      // core must also target it.
+      const uint32_t irq_gic_id = get_local_gic_id(irq.id);
+      if (irq.id == LOCAL_PMU.id)
+        enable_irq_gid_range(irq_gic_id, irq_gic_id + 1);
+      enable_gic_distributor(irq_gic_id);
+      break;
+    }
   }
 }
 
@@ -74,6 +134,10 @@ void BCM2711_IRQManager::disable_irq(IRQ irq) {
     case IRQ::Type::VideoCore:
       disable_gic_distributor(irq.id + VC_IRQ_START);
       break;
+
+    case IRQ::Type::Local:
+      disable_gic_distributor(get_local_gic_id(irq.id));
+      break;
   }
 }
 
@@ -86,12 +150,20 @@ void BCM2711_IRQManager::mask_as_processed(IRQ irq) {
     case IRQ::Type::VideoCore:
       libk::write32(_base + GICC_EOIR, irq.id + VC_IRQ_START);
       break;
+
+    case IRQ::Type::Local:
+      if (irq.id == LOCAL_IPI.id) {
+        libk::write32(_base + GICC_EOIR, _sgi_iar[SMP::get_core_id()]);
+      } else {
+        libk::write32(_base + GICC_EOIR, get_local_gic_id(irq.id));
+      }
+      break;
   }
 }
 
 bool BCM2711_IRQManager::has_pending_interrupt(IRQ* irq) {
   const uint32_t IAR = libk::read32(_base + GICC_IAR);
-  const uint64_t irq_gic_id = IAR & libk::mask_bits(0, 23);
+  const uint64_t irq_gic_id = IAR & libk::mask_bits(0, 9);  // bits [12:10] are the source core of SGIs
 
   if (ARMC_IRQ_START <= irq_gic_id && irq_gic_id < ARMC_IRQ_START + ARMC_IRQ_NB) {
     irq->type = IRQ::Type::ARMCore;
@@ -99,11 +171,55 @@ bool BCM2711_IRQManager::has_pending_interrupt(IRQ* irq) {
     return true;
   }
 
-  if (VC_IRQ_START <= irq_gic_id && irq_gic_id < VC_IRQ_START + VC_IRQ_NB) {
+  if (VC_IRQ_START <= irq_gic_id && irq_gic_id < VC_IRQ_END) {
     irq->type = IRQ::Type::VideoCore;
     irq->id = irq_gic_id - VC_IRQ_START;
     return true;
   }
 
+  for (uint64_t local_id = 0; local_id < LOCAL_IRQ_NB; ++local_id) {
+    if (get_local_gic_id(local_id) == irq_gic_id) {
+      if (local_id == LOCAL_IPI.id)
+        _sgi_iar[SMP::get_core_id()] = IAR;
+
+      irq->type = IRQ::Type::Local;
+      irq->id = local_id;
+      return true;
+    }
+  }
+
   return false;
 }
+
+void BCM2711_IRQManager::set_priority(IRQ irq, IRQManager::Priority priority) {
+  const uint8_t gic_priority = priority == IRQManager::Priority::HIGH ? GIC_PRIORITY_HIGH : GIC_PRIORITY_NORMAL;
+  switch (irq.type) {
+    case IRQ::Type::ARMCore:
+      set_gic_priority(irq.id + ARMC_IRQ_START, gic_priority);
+      break;
+
+    case IRQ::Type::VideoCore:
+      set_gic_priority(irq.id + VC_IRQ_START, gic_priority);
+      break;
+
+    case IRQ::Type::Local:
+      set_gic_priority(get_local_gic_id(irq.id), gic_priority);
+      break;
+  }
+}
+
+void BCM2711_IRQManager::set_affinity(IRQ irq, uint32_t core_mask) {
+  const uint32_t irq_gic_id = irq.id + (irq.type == IRQ::Type::ARMCore ? ARMC_IRQ_START : VC_IRQ_START);
+  const uint32_t n = irq_gic_id / 4;
+  const uint32_t shift = (irq_gic_id % 4) * 8;
+  const uintptr_t reg_address = _base + GICD_ITARGETSR_BASE + n * sizeof(uint32_t);
+
+  // One byte per IRQ, one bit per CPU interface.
+  const uint32_t prev_val = libk::read32(reg_address);
+  libk::write32(reg_address, (prev_val & ~(0xFF << shift)) | ((core_mask & 0xFF) << shift));
+}
+
+void BCM2711_IRQManager::send_ipi(size_t core_id) {
+  // TargetListFilter=0: only send to the cores of CPUTargetList.
+  libk::write32(_base + GICD_SGIR, ((uint32_t)1 << (16 + core_id)) | LOCAL_IRQ_GIC_ID[LOCAL_IPI.id]);
+}
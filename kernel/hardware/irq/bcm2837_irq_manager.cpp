@@ -1,5 +1,6 @@
 #include "bcm2837_irq_manager.hpp"
 #include "hardware/kernel_dt.hpp"
+#include "hardware/smp.hpp"
 
 #include <libk/log.hpp>
 #include "hardware/irq/irq_lists.hpp"
@@ -36,10 +37,57 @@ static inline constexpr uint32_t IRQ_DISABLE_VC_BASE = 0x1C;
 /** ARM Disable IRQ */
 static inline constexpr uint32_t IRQ_DISABLE_BASIC = 0x24;
 
+/** GPU interrupts routing in the local interrupt controller (bits [1:0]: the core taking the GPU IRQs). */
+static inline constexpr uint32_t LOCAL_GPU_INT_ROUTING = 0x0C;
+
+/** PMU interrupts routing write-set and write-clear registers in the local interrupt controller (bit i routes
+ * the PMU interrupt of the core i to its IRQ). */
+static inline constexpr uint32_t LOCAL_PMU_ROUTING_SET = 0x10;
+static inline constexpr uint32_t LOCAL_PMU_ROUTING_CLEAR = 0x14;
+
+/** Core timers interrupt control base (one register per core) in the local interrupt controller. */
+static inline constexpr uint32_t LOCAL_TIMER_CONTROL_BASE = 0x40;
+
+/** Core mailboxes interrupt control base (one register per core) in the local interrupt controller. */
+static inline constexpr uint32_t LOCAL_MAILBOX_CONTROL_BASE = 0x50;
+
+/** Core mailbox 0 write-set base (one register every 16 bytes per core), used for inter-processor interrupts. */
+static inline constexpr uint32_t LOCAL_MAILBOX0_SET_BASE = 0x80;
+
+/** Core mailbox 0 read/write-high-to-clear base (one register every 16 bytes per core). */
+static inline constexpr uint32_t LOCAL_MAILBOX0_CLEAR_BASE = 0xC0;
+
+/** Core IRQ source base (one register per core) in the local interrupt controller. */
+static inline constexpr uint32_t LOCAL_IRQ_SOURCE_BASE = 0x60;
+
+/** Bit set in the core IRQ source register when a GPU interrupt is pending. */
+static inline constexpr uint32_t LOCAL_IRQ_SOURCE_GPU = 8;
+
+/** Bit set in the core IRQ source register when a PMU interrupt is pending. */
+static inline constexpr uint32_t LOCAL_IRQ_SOURCE_PMU = 9;
+
 static uintptr_t _base;
+static uintptr_t _local_base;
 
 void BCM2837_IRQManager::init() {
   _base = KernelDT::force_get_device_address("intc");
+  _local_base = KernelDT::force_get_device_address("local_intc");
+}
+
+/** Returns the register of the local interrupt controller enabling @a local_id for the calling core. */
+static uintptr_t get_local_control_reg(uint64_t local_id, uint32_t* bit) {
+  const size_t core_offset = SMP::get_core_id() * sizeof(uint32_t);
+  if (local_id == LOCAL_IPI.id) {
+    *bit = 0;  // mailbox 0
+    return _local_base + LOCAL_MAILBOX_CONTROL_BASE + core_offset;
+  }
+
+  *bit = local_id;
+  return _local_base + LOCAL_TIMER_CONTROL_BASE + core_offset;
+}
+
+void BCM2837_IRQManager::init_core() {
+  // Nothing to do: the local interrupt controller is ready after reset.
 }
 
 void BCM2837_IRQManager::enable_irq(IRQ irq) {
@@ -66,6 +114,23 @@ void BCM2837_IRQManager::enable_irq(IRQ irq) {
       const uint32_t enable_mask = (uint32_t)1 << (irq.id % 32);
       libk::write32(_base + IRQ_ENABLE_VC_BASE + enable_reg * sizeof(uint32_t), enable_mask);
 
+      break;
+    }
+    case IRQ::Type::Local: {
+      if (irq.id >= LOCAL_IRQ_NB) {
+        LOG_ERROR("Unknown Local IRQ {}", irq.id);
+        libk::panic("Unable to activate an IRQ");
+      }
+
+      if (irq.id == LOCAL_PMU.id) {
+        libk::write32(_local_base + LOCAL_PMU_ROUTING_SET, (uint32_t)1 << SMP::get_core_id());
+        break;
+      }
+
+      uint32_t bit;
+      const uintptr_t control_reg = get_local_control_reg(irq.id, &bit);
+      libk::write32(control_reg, libk::read32(control_reg) | ((uint32_t)1 << bit));
+
       break;
     }
   }
@@ -95,13 +160,32 @@ void BCM2837_IRQManager::disable_irq(IRQ irq) {
       const uint32_t disable_mask = (uint32_t)1 << (irq.id % 32);
       libk::write32(_base + IRQ_DISABLE_VC_BASE + disable_reg * sizeof(uint32_t), disable_mask);
 
+      break;
+    }
+    case IRQ::Type::Local: {
+      if (irq.id >= LOCAL_IRQ_NB) {
+        LOG_ERROR("Unknown Local IRQ {}", irq.id);
+        libk::panic("Unable to activate an IRQ");
+      }
+
+      if (irq.id == LOCAL_PMU.id) {
+        libk::write32(_local_base + LOCAL_PMU_ROUTING_CLEAR, (uint32_t)1 << SMP::get_core_id());
+        break;
+      }
+
+      uint32_t bit;
+      const uintptr_t control_reg = get_local_control_reg(irq.id, &bit);
+      libk::write32(control_reg, libk::read32(control_reg) & ~((uint32_t)1 << bit));
+
       break;
     }
   }
 }
 
 void BCM2837_IRQManager::mask_as_processed(IRQ irq) {
-  (void)irq;
+  if (irq.type == IRQ::Type::Local && irq.id == LOCAL_IPI.id) {
+    libk::write32(_local_base + LOCAL_MAILBOX0_CLEAR_BASE + SMP::get_core_id() * 0x10, UINT32_MAX);
+  }
 }
 
 bool fill_vc_1(IRQ* irq) {
@@ -137,6 +221,21 @@ bool fill_vc_2(IRQ* irq) {
 }
 
 bool BCM2837_IRQManager::has_pending_interrupt(IRQ* irq) {
+  const uintptr_t local_source_reg = _local_base + LOCAL_IRQ_SOURCE_BASE + SMP::get_core_id() * sizeof(uint32_t);
+  const uint32_t local_pending = libk::read32(local_source_reg);
+
+  FILL_IRQ(irq, local_pending, 0, LOCAL_CNTPS.id, LOCAL_CNTPS.type);
+  FILL_IRQ(irq, local_pending, 1, LOCAL_CNTPNS.id, LOCAL_CNTPNS.type);
+  FILL_IRQ(irq, local_pending, 2, LOCAL_CNTHP.id, LOCAL_CNTHP.type);
+  FILL_IRQ(irq, local_pending, 3, LOCAL_CNTV.id, LOCAL_CNTV.type);
+  FILL_IRQ(irq, local_pending, 4, LOCAL_IPI.id, LOCAL_IPI.type);
+  FILL_IRQ(irq, local_pending, LOCAL_IRQ_SOURCE_PMU, LOCAL_PMU.id, LOCAL_PMU.type);
+
+  // GPU interrupts are only routed to one core, others do not have to look at the pending registers.
+  if (((local_pending >> LOCAL_IRQ_SOURCE_GPU) & 0b1) == 0) {
+    return false;
+  }
+
   const uint32_t base_pending = libk::read32(_base + IRQ_PEND_BASIC);
 
   FILL_IRQ(irq, base_pending, 0, ARMC_TIMER.id, ARMC_TIMER.type);
@@ -164,3 +263,14 @@ bool BCM2837_IRQManager::has_pending_interrupt(IRQ* irq) {
 
   return false;
 }
+
+void BCM2837_IRQManager::send_ipi(size_t core_id) {
+  libk::write32(_local_base + LOCAL_MAILBOX0_SET_BASE + core_id * 0x10, 1);
+}
+
+void BCM2837_IRQManager::set_affinity(IRQ, uint32_t core_mask) {
+  // The GPU IRQs (ARMC and VideoCore) can only be routed all together to a single core.
+  const uint32_t core_id = __builtin_ctz(core_mask);
+  const uint32_t prev_val = libk::read32(_local_base + LOCAL_GPU_INT_ROUTING);
+  libk::write32(_local_base + LOCAL_GPU_INT_ROUTING, (prev_val & ~0b11) | core_id);
+}
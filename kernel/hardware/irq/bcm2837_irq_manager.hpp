@@ -5,10 +5,15 @@
 
 namespace BCM2837_IRQManager {
 void init();
+void init_core();
 
 void enable_irq(IRQ irq_id);
 void disable_irq(IRQ irq_id);
 
 void mask_as_processed(IRQ irq_id);
 bool has_pending_interrupt(IRQ* irq_id);
+
+void send_ipi(size_t core_id);
+
+void set_affinity(IRQ irq, uint32_t core_mask);
 };  // namespace BCM2837_IRQManager
@@ -6,6 +6,9 @@
 
 static inline constexpr size_t ARMC_IRQ_NB = 7;
 static inline constexpr size_t VC_IRQ_NB = 64;
+/** The BCM2711 ETH_PCIe IRQs, numbered as VideoCore IRQs after the VC_IRQ_NB first ones. */
+static inline constexpr size_t ETH_PCIE_IRQ_NB = 57;
+static inline constexpr size_t LOCAL_IRQ_NB = 6;
 
 /** ARM Core Timer IRQ id. */
 static inline constexpr IRQ ARMC_TIMER = {.type = IRQ::Type::ARMCore, .id = 0};
@@ -38,6 +41,12 @@ static inline constexpr IRQ VC_TIMER_BASE = {.type = IRQ::Type::VideoCore, .id =
 // Timer 2: 2
 // Timer 3: 3
 
+/** Base for DMA IRQ id. */
+static inline constexpr IRQ VC_DMA_BASE = {.type = IRQ::Type::VideoCore, .id = 16};
+// DMA channel 0: 16
+// ...
+// DMA channel 10: 26
+
 /** AUX IRQ id. */
 static inline constexpr IRQ VC_AUX = {.type = IRQ::Type::VideoCore, .id = 29};
 
@@ -62,3 +71,25 @@ static inline constexpr IRQ VC_UART = {.type = IRQ::Type::VideoCore, .id = 57};
 
 /** EMMC IRQ id. */
 static inline constexpr IRQ VC_EMMC = {.type = IRQ::Type::VideoCore, .id = 62};
+
+/** BCM2711 only: GENET (Ethernet) IRQ ids, of its default rings and of the other ones. */
+static inline constexpr IRQ VC_GENET_0 = {.type = IRQ::Type::VideoCore, .id = VC_IRQ_NB + 29};
+static inline constexpr IRQ VC_GENET_1 = {.type = IRQ::Type::VideoCore, .id = VC_IRQ_NB + 30};
+
+/** Core local secure physical timer IRQ id. */
+static inline constexpr IRQ LOCAL_CNTPS = {.type = IRQ::Type::Local, .id = 0};
+
+/** Core local non-secure physical timer IRQ id. */
+static inline constexpr IRQ LOCAL_CNTPNS = {.type = IRQ::Type::Local, .id = 1};
+
+/** Core local hypervisor timer IRQ id. */
+static inline constexpr IRQ LOCAL_CNTHP = {.type = IRQ::Type::Local, .id = 2};
+
+/** Core local virtual timer IRQ id. */
+static inline constexpr IRQ LOCAL_CNTV = {.type = IRQ::Type::Local, .id = 3};
+
+/** Inter-processor interrupt IRQ id (see IRQManager::send_ipi()). */
+static inline constexpr IRQ LOCAL_IPI = {.type = IRQ::Type::Local, .id = 4};
+
+/** Core local performance monitors (PMU counter overflow) IRQ id. */
+static inline constexpr IRQ LOCAL_PMU = {.type = IRQ::Type::Local, .id = 5};
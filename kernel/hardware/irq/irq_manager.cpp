@@ -2,6 +2,9 @@
 #include "libk/log.hpp"
 
 #include "hardware/kernel_dt.hpp"
+#include "hardware/smp.hpp"
+#include "latency_tracer.hpp"
+#include "trace.hpp"
 
 #include "bcm2711_irq_manager.hpp"
 #include "bcm2837_irq_manager.hpp"
@@ -12,6 +15,10 @@ static void (*_enable_irq)(IRQ);
 static void (*_disable_irq)(IRQ);
 static void (*_mask_as_processed)(IRQ);
 static bool (*_has_pending_interrupt)(IRQ*);
+static void (*_init_core)();
+static void (*_send_ipi)(size_t);
+static void (*_set_priority)(IRQ, Priority) = nullptr;
+static void (*_set_affinity)(IRQ, uint32_t);
 
 struct CallBackAssoc {
   IRQCallBack cb = nullptr;
@@ -19,7 +26,32 @@ struct CallBackAssoc {
 };
 
 static CallBackAssoc armc_handler[ARMC_IRQ_NB] = {};
-static CallBackAssoc vc_handler[VC_IRQ_NB] = {};
+static CallBackAssoc vc_handler[VC_IRQ_NB + ETH_PCIE_IRQ_NB] = {};
+static CallBackAssoc local_handler[LOCAL_IRQ_NB] = {};
+
+/** The index of @a irq into the counters, the ARMC IRQs first then the VideoCore and the local ones. */
+static size_t get_irq_index(IRQ irq) {
+  switch (irq.type) {
+    case IRQ::Type::ARMCore:
+      return irq.id;
+    case IRQ::Type::VideoCore:
+      return ARMC_IRQ_NB + irq.id;
+    case IRQ::Type::Local:
+      return ARMC_IRQ_NB + VC_IRQ_NB + ETH_PCIE_IRQ_NB + irq.id;
+  }
+
+  return 0;
+}
+
+/** The count of handled IRQs since boot, per core so only written by their core (see get_irq_count()). */
+static uint64_t g_irq_counts[SMP::MAX_CORES][ARMC_IRQ_NB + VC_IRQ_NB + ETH_PCIE_IRQ_NB + LOCAL_IRQ_NB] = {};
+
+/** The count of IRQ handlers being run by each core (more than one if nested). */
+static size_t g_nesting_depth[SMP::MAX_CORES] = {};
+
+static constexpr size_t MAX_DEFERRED_CALLBACKS = 4;
+static CallBackAssoc g_deferred_callbacks[SMP::MAX_CORES][MAX_DEFERRED_CALLBACKS] = {};
+static size_t g_deferred_count[SMP::MAX_CORES] = {};
 
 void init() {
   for (const auto comp : KernelDT::get_board_compatible()) {
@@ -28,8 +60,12 @@ void init() {
       _disable_irq = &BCM2837_IRQManager::disable_irq;
       _mask_as_processed = &BCM2837_IRQManager::mask_as_processed;
       _has_pending_interrupt = &BCM2837_IRQManager::has_pending_interrupt;
+      _init_core = &BCM2837_IRQManager::init_core;
+      _send_ipi = &BCM2837_IRQManager::send_ipi;
+      _set_affinity = &BCM2837_IRQManager::set_affinity;
 
       BCM2837_IRQManager::init();
+      BCM2837_IRQManager::init_core();
       return;
     }
 
@@ -38,22 +74,46 @@ void init() {
       _disable_irq = &BCM2711_IRQManager::disable_irq;
       _mask_as_processed = &BCM2711_IRQManager::mask_as_processed;
       _has_pending_interrupt = &BCM2711_IRQManager::has_pending_interrupt;
+      _init_core = &BCM2711_IRQManager::init_core;
+      _send_ipi = &BCM2711_IRQManager::send_ipi;
+      _set_priority = &BCM2711_IRQManager::set_priority;
+      _set_affinity = &BCM2711_IRQManager::set_affinity;
 
       BCM2711_IRQManager::init();
+      BCM2711_IRQManager::init_core();
       return;
     }
   }
 }
 
+void init_core() {
+  (*_init_core)();
+}
+
 void enable_irq_interrupts() {
-  asm volatile("msr daifclr, #2");
+  LATENCY_TRACE(irqs_on);
+  asm volatile("msr daifclr, #2" ::: "memory");
 }
 
 void disable_irq_interrupts() {
-  asm volatile("msr daifset, #2");
+  asm volatile("msr daifset, #2" ::: "memory");
+  LATENCY_TRACE(irqs_off);
+}
+
+static void run_deferred_callbacks(size_t core_id) {
+  // The callbacks run IRQs masked, so no other callback is deferred meanwhile.
+  for (size_t i = 0; i < g_deferred_count[core_id]; ++i) {
+    const CallBackAssoc cb_assoc = g_deferred_callbacks[core_id][i];
+    (*cb_assoc.cb)(cb_assoc.cb_handle);
+  }
+
+  g_deferred_count[core_id] = 0;
 }
 
 void handle_interrupts() {
+  const size_t core_id = SMP::get_core_id();
+  g_nesting_depth[core_id]++;
+
   IRQ irq;
 
   while ((*_has_pending_interrupt)(&irq)) {
@@ -65,7 +125,9 @@ void handle_interrupts() {
       case IRQ::Type::VideoCore:
         cb_assoc = vc_handler[irq.id];
         break;
-
+      case IRQ::Type::Local:
+        cb_assoc = local_handler[irq.id];
+        break;
     }
 
     if (cb_assoc.cb == nullptr) {
@@ -73,9 +135,77 @@ void handle_interrupts() {
       libk::panic("IRQ Handler Missing");
     }
 
+    g_irq_counts[core_id][get_irq_index(irq)]++;
+    TRACE_EVENT(IRQ_ENTER, (uint64_t)irq.type, irq.id);
+    LATENCY_TRACE(set_irqs_off_site, (uintptr_t)cb_assoc.cb);
+    // The interrupt controller only signals the IRQs of a higher priority than the one being handled,
+    // they are handled by a nested call (see exception_handler()).
+    if (_set_priority != nullptr)
+      enable_irq_interrupts();
     (*cb_assoc.cb)(cb_assoc.cb_handle);
+    if (_set_priority != nullptr)
+      disable_irq_interrupts();
     (*_mask_as_processed)(irq);
+    TRACE_EVENT(IRQ_EXIT, (uint64_t)irq.type, irq.id);
+
+    if (g_nesting_depth[core_id] == 1)
+      run_deferred_callbacks(core_id);
+  }
+
+  g_nesting_depth[core_id]--;
+}
+
+bool is_in_irq_handler() {
+  return g_nesting_depth[SMP::get_core_id()] > 0;
+}
+
+bool is_nested() {
+  return g_nesting_depth[SMP::get_core_id()] > 1;
+}
+
+void defer_until_unnested(IRQCallBack callback, void* callback_handle) {
+  const size_t core_id = SMP::get_core_id();
+  KASSERT(is_nested());
+
+  // The same callback is only run once.
+  for (size_t i = 0; i < g_deferred_count[core_id]; ++i) {
+    const CallBackAssoc& cb_assoc = g_deferred_callbacks[core_id][i];
+    if (cb_assoc.cb == callback && cb_assoc.cb_handle == callback_handle)
+      return;
   }
+
+  KASSERT(g_deferred_count[core_id] < MAX_DEFERRED_CALLBACKS && "too many deferred IRQ callbacks");
+  g_deferred_callbacks[core_id][g_deferred_count[core_id]++] = {callback, callback_handle};
+}
+
+bool has_irq_handler(IRQ irq) {
+  switch (irq.type) {
+    case IRQ::Type::ARMCore:
+      return armc_handler[irq.id].cb != nullptr;
+    case IRQ::Type::VideoCore:
+      return vc_handler[irq.id].cb != nullptr;
+    case IRQ::Type::Local:
+      return local_handler[irq.id].cb != nullptr;
+  }
+
+  return false;
+}
+
+uint64_t get_irq_count(IRQ irq, size_t core_id) {
+  KASSERT(core_id < SMP::MAX_CORES);
+  // Updated by the other cores meanwhile, a slightly stale count is fine.
+  return g_irq_counts[core_id][get_irq_index(irq)];
+}
+
+void set_irq_priority(IRQ irq, Priority priority) {
+  if (_set_priority != nullptr)
+    (*_set_priority)(irq, priority);
+}
+
+void set_affinity(IRQ irq, uint32_t core_mask) {
+  KASSERT(irq.type != IRQ::Type::Local && "local IRQs can not be routed");
+  KASSERT(core_mask != 0 && (core_mask >> SMP::get_online_cores_count()) == 0);
+  (*_set_affinity)(irq, core_mask);
 }
 
 void register_irq_handler(IRQ irq, IRQCallBack callback, void* cb_handle) {
@@ -86,6 +216,9 @@ void register_irq_handler(IRQ irq, IRQCallBack callback, void* cb_handle) {
     case IRQ::Type::VideoCore:
       vc_handler[irq.id] = {callback, cb_handle};
       break;
+    case IRQ::Type::Local:
+      local_handler[irq.id] = {callback, cb_handle};
+      break;
   }
 
   activate_irq(irq);
@@ -118,6 +251,18 @@ void unregister_irq_handle(IRQ irq, IRQCallBack* callback, void** callback_handl
       }
       break;
     }
+
+    case IRQ::Type::Local: {
+      const auto cb_entry = local_handler[irq.id];
+
+      if (callback != nullptr) {
+        *callback = cb_entry.cb;
+      }
+      if (callback_handle != nullptr) {
+        *callback_handle = cb_entry.cb_handle;
+      }
+      break;
+    }
   }
 }
 
@@ -128,4 +273,25 @@ void activate_irq(IRQ irq) {
 void deactivate_irq(IRQ irq) {
   (*_disable_irq)(irq);
 }
+
+void deactivate_all_irqs() {
+  for (uint64_t id = 0; id < ARMC_IRQ_NB; ++id) {
+    if (armc_handler[id].cb != nullptr)
+      deactivate_irq({IRQ::Type::ARMCore, id});
+  }
+
+  for (uint64_t id = 0; id < VC_IRQ_NB + ETH_PCIE_IRQ_NB; ++id) {
+    if (vc_handler[id].cb != nullptr)
+      deactivate_irq({IRQ::Type::VideoCore, id});
+  }
+
+  for (uint64_t id = 0; id < LOCAL_IRQ_NB; ++id) {
+    if (local_handler[id].cb != nullptr)
+      deactivate_irq({IRQ::Type::Local, id});
+  }
+}
+
+void send_ipi(size_t core_id) {
+  (*_send_ipi)(core_id);
+}
 }  // namespace IRQManager
@@ -4,7 +4,7 @@
 #include <cstdint>
 
 struct IRQ {
-  enum class Type { ARMCore, VideoCore };
+  enum class Type { ARMCore, VideoCore, Local };
 
   Type type;
   uint64_t id;
@@ -13,8 +13,15 @@ struct IRQ {
 namespace IRQManager {
 using IRQCallBack = void (*)(void*);
 
+/** The IRQ handlers are interrupted by the IRQs of a higher priority (if the interrupt controller supports it). */
+enum class Priority { HIGH, NORMAL };
+
 void init();
 
+/** Initializes the interrupt controller for the calling core.
+ * Must be called once on each secondary core, after init(). */
+void init_core();
+
 /** Enable IRQ Interrupts */
 void enable_irq_interrupts();
 
@@ -24,6 +31,37 @@ void disable_irq_interrupts();
 /** Handle All Interrupts. */
 void handle_interrupts();
 
+/** Checks if the calling core is running an IRQ handler. */
+[[nodiscard]] bool is_in_irq_handler();
+/** Checks if the calling core is running an IRQ handler which interrupted another IRQ handler. */
+[[nodiscard]] bool is_nested();
+/**
+ * Calls @a callback once the interrupted IRQ handler of the calling core returns (see is_nested()).
+ * This is for the work of nested handlers which must not run in the middle of another handler.
+ */
+void defer_until_unnested(IRQCallBack callback, void* callback_handle);
+
+/** Checks if a handler is registered for @a irq. */
+[[nodiscard]] bool has_irq_handler(IRQ irq);
+/** Gets the count of @a irq handled by the core @a core_id since boot. */
+[[nodiscard]] uint64_t get_irq_count(IRQ irq, size_t core_id);
+
+/**
+ * Sets the priority of @a irq, all IRQs have the NORMAL priority by default. The priorities of local
+ * IRQs are per core. Ignored if the interrupt controller does not support priorities (BCM2837), the
+ * IRQ handlers are then never interrupted.
+ */
+void set_irq_priority(IRQ irq, Priority priority);
+
+/**
+ * Routes @a irq to the cores of @a core_mask (bit i for the core i), which must be online. By default, all
+ * IRQs are routed to the boot core. Local IRQs can not be routed, they are always taken by their own core.
+ *
+ * The BCM2837 can only route all the (ARMC and VideoCore) IRQs together to a single core: setting the
+ * affinity of any of them routes all of them to the first core of @a core_mask.
+ */
+void set_affinity(IRQ irq, uint32_t core_mask);
+
 /** Add the handler @& callback in order to handle the irq @a irq_id.
  * Older handler is replaced. */
 void register_irq_handler(IRQ irq, IRQCallBack callback, void* callback_handle);
@@ -32,10 +70,17 @@ void register_irq_handler(IRQ irq, IRQCallBack callback, void* callback_handle);
  * If @a callback or @a callback_handle are not null, they are filled with the removed hander. */
 void unregister_irq_handle(IRQ irq, IRQCallBack* callback, void** callback_handle);
 
-/** Activate the IRQ */
+/** Activate the IRQ. Local IRQs are only activated for the calling core. */
 void activate_irq(IRQ irq);
 
 /** Deactivate the IRQ */
 void deactivate_irq(IRQ irq);
 
+/** Deactivates all the IRQs having a handler (the local ones for the calling core only), before restarting into
+ * another kernel (see Kexec): no device interrupts it before its drivers are initialized. */
+void deactivate_all_irqs();
+
+/** Raises the LOCAL_IPI interrupt on the core @a core_id. */
+void send_ipi(size_t core_id);
+
 };  // namespace IRQManager
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include "latency_tracer.hpp"
+
+namespace IRQSave {
+/** Masks the IRQs on the calling core and returns the previous DAIF value, to give to restore_irqs(). */
+[[nodiscard]] static inline uint64_t mask_irqs() {
+  uint64_t daif;
+  asm volatile("mrs %0, DAIF\n"
+               "msr DAIFSet, #0b0010"
+               : "=r"(daif)
+               :
+               : "memory");
+  if ((daif & (1 << 7)) == 0)
+    LATENCY_TRACE(irqs_off);
+  return daif;
+}
+
+/** Restores the IRQs mask saved by mask_irqs(). */
+static inline void restore_irqs(uint64_t daif) {
+  if ((daif & (1 << 7)) == 0)
+    LATENCY_TRACE(irqs_on);
+  asm volatile("msr DAIF, %0" : : "r"(daif) : "memory");
+}
+
+/** Checks if an IRQ is pending on the calling core (ISR_EL1.I), it is then taken as soon as the IRQs are
+ * unmasked. */
+[[nodiscard]] static inline bool is_irq_pending() {
+  uint64_t isr;
+  asm volatile("mrs %0, ISR_EL1" : "=r"(isr));
+  return (isr & (1 << 7)) != 0;
+}
+};  // namespace IRQSave
+
+/** RAII helper masking the IRQs of the calling core for its lifetime (nested guards are fine). */
+class IrqSaveGuard {
+ public:
+  IrqSaveGuard() : m_daif(IRQSave::mask_irqs()) {}
+  ~IrqSaveGuard() { IRQSave::restore_irqs(m_daif); }
+
+  // No copy and move
+  IrqSaveGuard(const IrqSaveGuard&) = delete;
+  IrqSaveGuard(IrqSaveGuard&&) = delete;
+  IrqSaveGuard& operator=(const IrqSaveGuard&) = delete;
+  IrqSaveGuard& operator=(IrqSaveGuard&&) = delete;
+
+ private:
+  const uint64_t m_daif;
+};  // class IrqSaveGuard
@@ -10,6 +10,11 @@ static uint64_t _board_serial = 0;
 static Node _alias;
 static Node _symbols;
 static Property _soc_ranges;
+static Property _board_compatible;
+
+// The index is built before the kernel memory is set up, so it lives in the BSS.
+static constexpr size_t DT_INDEX_MEMORY_SIZE = 64 * 1024;
+alignas(uint64_t) static char _dt_index_memory[DT_INDEX_MEMORY_SIZE];
 
 bool KernelDT::init(uintptr_t dtb) {
   _dt = DeviceTree(dtb);
@@ -18,6 +23,10 @@ bool KernelDT::init(uintptr_t dtb) {
     return false;
   }
 
+  // If the blob does not fit, the lookups walk it instead.
+  libk::LinearAllocator index_allocator((uintptr_t)_dt_index_memory, DT_INDEX_MEMORY_SIZE);
+  (void)_dt.build_index(index_allocator);
+
   Property prop = {};
 
   // Fill _board_model
@@ -73,6 +82,11 @@ bool KernelDT::init(uintptr_t dtb) {
     return false;
   }
 
+  // Fill _board_compatible
+  if (!KernelDT::find_property("/compatible", &_board_compatible) || !_board_compatible.is_string_list()) {
+    return false;
+  }
+
   return true;
 }
 
@@ -112,6 +126,10 @@ bool KernelDT::find_property(libk::StringView path, Property* property) {
   return _dt.find_property(path, property);
 }
 
+bool KernelDT::find_node_by_phandle(uint32_t phandle, Node* node) {
+  return _dt.find_node_by_phandle(phandle, node);
+}
+
 libk::StringView KernelDT::get_board_model() {
   return _board_model;
 }
@@ -127,7 +145,7 @@ uint64_t KernelDT::get_board_serial() {
 bool get_device_node_from(libk::StringView device, Node resolver, Node* target) {
   Property prop;
 
-  if (!resolver.find_property(device, &prop)) {
+  if (!_dt.find_property(resolver, device, &prop)) {
     return false;
   }
 
@@ -156,6 +174,16 @@ bool KernelDT::get_device_node(libk::StringView device, Node* device_node) {
 }
 
 bool KernelDT::get_device_address(libk::StringView device, uintptr_t* device_address) {
+  uintptr_t dev_soc_addr = 0;
+  if (!get_device_soc_address(device, &dev_soc_addr)) {
+    return false;
+  }
+
+  *device_address = convert_soc_address(dev_soc_addr);
+  return true;
+}
+
+bool KernelDT::get_device_soc_address(libk::StringView device, uintptr_t* soc_address) {
   Node dev_node;
 
   if (!get_device_node(device, &dev_node)) {
@@ -164,7 +192,7 @@ bool KernelDT::get_device_address(libk::StringView device, uintptr_t* device_add
 
   Property prop;
 
-  if (!dev_node.find_property("reg", &prop)) {
+  if (!_dt.find_property(dev_node, "reg", &prop)) {
     return false;
   }
 
@@ -175,7 +203,7 @@ bool KernelDT::get_device_address(libk::StringView device, uintptr_t* device_add
     return false;
   }
 
-  *device_address = convert_soc_address(dev_soc_addr);
+  *soc_address = dev_soc_addr;
   return true;
 }
 
@@ -217,18 +245,7 @@ uintptr_t KernelDT::force_get_device_address(libk::StringView device) {
 
   return device_address;
 }
-StringList KernelDT::get_board_compatible() {
-  Property prop;
 
-  if (!KernelDT::find_property("/compatible", &prop)) {
-    libk::panic("No 'compatible' field in DeviceTree.");
-  }
-
-  const auto compatible = prop.get_string_list();
-
-  if (!compatible.has_value()) {
-    libk::panic("'compatible' field is not a StringList in this DeviceTree.");
-  }
-
-  return compatible.get_value();
+StringList KernelDT::get_board_compatible() {
+  return StringList(&_board_compatible);
 }
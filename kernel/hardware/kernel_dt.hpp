@@ -13,6 +13,7 @@ bool init(uintptr_t dtb);
 
 [[nodiscard]] bool find_node(libk::StringView path, Node* node);
 [[nodiscard]] bool find_property(libk::StringView path, Property* property);
+[[nodiscard]] bool find_node_by_phandle(uint32_t phandle, Node* node);
 
 [[nodiscard]] libk::StringView get_board_model();
 [[nodiscard]] uint32_t get_board_revision();
@@ -21,6 +22,9 @@ bool init(uintptr_t dtb);
 
 [[nodiscard]] bool get_device_node(libk::StringView device, Node* device_node);
 [[nodiscard]] bool get_device_address(libk::StringView device, uintptr_t* device_address);
+/** Same as get_device_address(), but gets the address on the SoC bus (as seen by the DMA) instead of the kernel
+ * virtual address. */
+[[nodiscard]] bool get_device_soc_address(libk::StringView device, uintptr_t* soc_address);
 [[nodiscard]] uintptr_t convert_soc_address(uintptr_t soc_address);
 
 [[nodiscard]] uintptr_t force_get_device_address(libk::StringView device);
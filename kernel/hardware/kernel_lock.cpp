@@ -0,0 +1,69 @@
+#include "kernel_lock.hpp"
+
+#include <libk/assert.hpp>
+
+#include "hardware/irq_save.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/spin_lock.hpp"
+#include "task/task.hpp"
+
+namespace KernelLock {
+static inline constexpr size_t NO_OWNER = SMP::MAX_CORES;
+
+static BakeryLock g_lock;
+static size_t g_owner = NO_OWNER;
+static size_t g_depth = 0;
+
+template <class T>
+static inline T load(const T& var) {
+  return __atomic_load_n(&var, __ATOMIC_SEQ_CST);
+}
+
+template <class T>
+static inline void store(T& var, T value) {
+  __atomic_store_n(&var, value, __ATOMIC_SEQ_CST);
+}
+
+void acquire() {
+  const uint64_t daif = IRQSave::mask_irqs();
+  const size_t core_id = SMP::get_core_id();
+
+  if (load(g_owner) == core_id) {
+    g_depth++;
+    IRQSave::restore_irqs(daif);
+    return;
+  }
+
+  g_lock.lock();
+  store(g_owner, core_id);
+  g_depth = 1;
+  IRQSave::restore_irqs(daif);
+}
+
+void release() {
+  const uint64_t daif = IRQSave::mask_irqs();
+  const size_t core_id = SMP::get_core_id();
+  KASSERT(load(g_owner) == core_id);
+
+  if (--g_depth == 0) {
+    store(g_owner, NO_OWNER);
+    g_lock.unlock();
+  }
+
+  IRQSave::restore_irqs(daif);
+}
+
+bool is_owned() {
+  return load(g_owner) == SMP::get_core_id();
+}
+}  // namespace KernelLock
+
+KernelTaskLockGuard::KernelTaskLockGuard() {
+  Task::current()->disable_preempt();
+  KernelLock::acquire();
+}
+
+KernelTaskLockGuard::~KernelTaskLockGuard() {
+  KernelLock::release();
+  Task::current()->enable_preempt();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * The big kernel lock, serializing the kernel code run by the different cores.
+ *
+ * It is taken for each exception (IRQs, syscalls, faults) and by the kernel tasks
+ * touching shared state. The lock is recursive for the core owning it. IRQs are
+ * masked while waiting for it, so it can be taken from any context.
+ *
+ * The data cache is disabled (see setup_sctlr() in mmu_init.cpp) and exclusive
+ * accesses are not guaranteed to work on non-cacheable memory. Therefore, this is
+ * a Lamport's bakery lock, using only ordered loads and stores. For the same reason,
+ * the kernel has no atomic read-modify-write (compare-and-swap, fetch-and-add...):
+ * the shared variables are written under a lock, or by a single writer.
+ */
+namespace KernelLock {
+void acquire();
+void release();
+
+/** @brief Checks if the calling core owns the lock. */
+[[nodiscard]] bool is_owned();
+};  // namespace KernelLock
+
+/** RAII helper around KernelLock::acquire() and KernelLock::release(). */
+class KernelLockGuard {
+ public:
+  KernelLockGuard() { KernelLock::acquire(); }
+  ~KernelLockGuard() { KernelLock::release(); }
+
+  // No copy and move
+  KernelLockGuard(const KernelLockGuard&) = delete;
+  KernelLockGuard(KernelLockGuard&&) = delete;
+  KernelLockGuard& operator=(const KernelLockGuard&) = delete;
+  KernelLockGuard& operator=(KernelLockGuard&&) = delete;
+};  // class KernelLockGuard
+
+/**
+ * RAII helper for the kernel tasks: disables the preemption of the current task, then takes the kernel lock.
+ *
+ * A kernel task switched out while holding the kernel lock would stall the system calls and IRQs of all the
+ * cores until it runs again, so it is never preempted meanwhile. A deferred preemption happens once the lock
+ * is released (see Task::enable_preempt()). The exception handlers use KernelLockGuard, they are never preempted.
+ */
+class KernelTaskLockGuard {
+ public:
+  KernelTaskLockGuard();
+  ~KernelTaskLockGuard();
+
+  // No copy and move
+  KernelTaskLockGuard(const KernelTaskLockGuard&) = delete;
+  KernelTaskLockGuard(KernelTaskLockGuard&&) = delete;
+  KernelTaskLockGuard& operator=(const KernelTaskLockGuard&) = delete;
+  KernelTaskLockGuard& operator=(KernelTaskLockGuard&&) = delete;
+};  // class KernelTaskLockGuard
@@ -35,6 +35,8 @@ static constexpr uint32_t CHANNEL_MASK = (1 << CHANNEL_WIDTH) - 1;
 }
 
 static uintptr_t mailbox_base;
+// The message sent by send_property_async() whose response is not received yet, 0 if none.
+static uint32_t pending_async_addr = 0;
 
 void init() {
   mailbox_base = KernelDT::force_get_device_address("mailbox");
@@ -71,4 +73,18 @@ void send(Channel channel, uint32_t message) {
   message = (static_cast<uint32_t>(channel) & CHANNEL_MASK) | (message << CHANNEL_WIDTH);
   libk::write32(mailbox_base + MBOX1_RW, message);
 }
+
+void set_async_property(uint32_t addr) {
+  KASSERT(pending_async_addr == 0);
+  pending_async_addr = addr;
+}
+
+void finish_async_property() {
+  if (pending_async_addr == 0)
+    return;
+
+  const uint32_t response = receive(Channel::TagArmToVC);
+  KASSERT(response == pending_async_addr);
+  pending_async_addr = 0;
+}
 }  // namespace MailBox
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include <libk/assert.hpp>
+#include <libk/cache.hpp>
 #include <libk/log.hpp>
 #include "memory/memory.hpp"
 
@@ -44,15 +45,46 @@ struct alignas(16) PropertyMessage {
   return (status >> 31) == 1;
 }
 
+/** Waits for the response of the message sent by send_property_async(), if any. */
+void finish_async_property();
+/** Used by send_property_async(), records the message whose response is not received yet. */
+void set_async_property(uint32_t addr);
+
 template <class Message>
 bool send_property(Message& message) {
   static_assert(alignof(Message) >= 16, "property messages must be 16-bytes aligned");
 
+  // The pending asynchronous response would be taken as the response of this message otherwise.
+  finish_async_property();
+
+  // The VideoCore reads the message from memory and writes its response there.
+  libk::clean_invalidate_dcache_range(&message, sizeof(Message));
+
   const uint32_t addr = (uint32_t)((uintptr_t)&message >> 4);
   MailBox::send(MailBox::Channel::TagArmToVC, addr);
   const uint32_t response = MailBox::receive(MailBox::Channel::TagArmToVC);
   KASSERT(response == addr);
+  libk::invalidate_dcache_range(&message, sizeof(Message));
   constexpr uint32_t STATUS_SUCCESS = 0x80000000;
   return message.status == STATUS_SUCCESS;
 }
+
+/**
+ * Sends the property @a message without waiting for the VideoCore response (for example, for tags that
+ * only complete at the next vertical sync). The response is received by finish_async_property(), called
+ * by the next property message, so @a message must stay alive until then.
+ */
+template <class Message>
+void send_property_async(Message& message) {
+  static_assert(alignof(Message) >= 16, "property messages must be 16-bytes aligned");
+
+  finish_async_property();
+
+  // The response is never read by the CPU, so the message is only written back.
+  libk::clean_dcache_range(&message, sizeof(Message));
+
+  const uint32_t addr = (uint32_t)((uintptr_t)&message >> 4);
+  MailBox::send(MailBox::Channel::TagArmToVC, addr);
+  set_async_property(addr);
+}
 }  // namespace MailBox
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "hardware/smp.hpp"
+
+/**
+ * One instance of T per core, the calling core accessing its own with get().
+ *
+ * Accessing the instance of the calling core needs no lock, as long as it is not also used by the IRQ
+ * handlers (otherwise mask the IRQs, see IrqSaveGuard) and the task is not migrated in the middle. Each
+ * instance is on its own cache line, ready for when the data cache is enabled.
+ */
+template <class T>
+class PerCore {
+ public:
+  [[nodiscard]] T& get() { return m_values[SMP::get_core_id()].value; }
+  [[nodiscard]] const T& get() const { return m_values[SMP::get_core_id()].value; }
+
+  /** Gets the instance of the core @a core_id. */
+  [[nodiscard]] T& get(size_t core_id) { return m_values[core_id].value; }
+  [[nodiscard]] const T& get(size_t core_id) const { return m_values[core_id].value; }
+
+  [[nodiscard]] T& operator*() { return get(); }
+  [[nodiscard]] T* operator->() { return &get(); }
+
+ private:
+  struct alignas(SMP::CACHE_LINE_SIZE) Value {
+    T value = {};
+  };  // struct Value
+
+  Value m_values[SMP::MAX_CORES];
+};  // class PerCore
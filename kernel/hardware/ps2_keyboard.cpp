@@ -1,8 +1,7 @@
 #include "ps2_keyboard.hpp"
 #include <libk/log.hpp>
-#include <libk/option.hpp>
 #include "gpio.hpp"
-#include "sys/keyboard.h"
+#include "task/task_manager.hpp"
 #include "timer.hpp"
 
 static inline constexpr size_t CLOCK_PIN = 23;
@@ -11,245 +10,129 @@ static inline constexpr size_t DATA_PIN = 24;
 namespace PS2Keyboard {
 
 static Event on_event = nullptr;
-static bool is_sending = false;
-static bool sticky = false;
 
-libk::Option<uint8_t> receive_message() {
-  static uint64_t message = 0;
-  static uint64_t nb_bit = 0;
-  static uint64_t parity = 0;
-
-  static uint64_t last_update = 0;
-
-  if (last_update == 0) {
-    // Initialise Clock
-    last_update = GenericTimer::get_elapsed_time_in_ms();
-  }
-
-  if (GenericTimer::get_elapsed_time_in_ms() - last_update > 10) {
-    // Too long between 2 interrupts, we reset.
-    message = 0;
-    nb_bit = 0;
-  }
-
-  last_update = GenericTimer::get_elapsed_time_in_ms();
-
-  nb_bit++;
-  uint64_t bit_val = (uint64_t)GPIO::read(24);
-
-  parity += bit_val;
-  message |= (bit_val << 11);
-  message >>= 1;
-
-  if (nb_bit < 11) {
-    return {};
-  }
-
-  nb_bit = 0;
-
-  if (message & 0x1) {
-    LOG_ERROR("[PS2Keyboard] Invalid start bit {:#x}", message);
-    parity = 0;
-    message = 0;
-    return {};
-  }
-
-  if (!(message & 0x400)) {
-    LOG_ERROR("[PS2Keyboard] Invalid stop bit {:#x}", message);
-    parity = 0;
-    message = 0;
-    return {};
-  }
-  if ((((message & 0x200 >> 8) & 0x1) + (parity & 0x1)) & 0x1) {
-    LOG_ERROR("[PS2Keyboard] Parity error {:#x} {:#x}", message, parity);
-    parity = 0;
-    message = 0;
-    return {};
-  }
-
-  parity = 0;
-
-  uint8_t key = (message >> 1) & 0xff;
-  message = 0;
-  return key;
-}
-
-void process_message(uint8_t message) {
-  static bool ctrl_on = false;
-  static bool shift_on = false;
-  static bool alt_on = false;
-  static bool num_on = false;
-  static bool caps_on = false;
-  static bool scroll_on = false;
-  static bool is_release = false;
-  static uint64_t msg_stack = 0;
-
-  if (message == 0xf0) {
-    is_release = true;
-    return;
-  }
-
-  msg_stack = msg_stack << 8 | message;
-
-  if (message >= 0x90) {
-    // Not a Key code, wait for more...
-    return;
-  }
-
-  if (msg_stack == 0xe012 || msg_stack == 0xe07c) {
-    // Likely to be a Print Screen
-    return;
-  }
-
-  if (msg_stack == 0xe114 || msg_stack == 0xe11477 || msg_stack == 0xe11477e114) {
-    // Likely to be a Pause
-    return;
-  }
-
-  if (msg_stack == 0x14 || msg_stack == 0xe014) {
-    // Control Key press
-    if (sticky) {
-      if (is_release) {
-        ctrl_on = !ctrl_on;
-      }
-    } else {
-      if (is_release) {
-        // We only update on Release
-        ctrl_on = false;
-      } else {
-        ctrl_on = true;
-      }
+/** A frame is 11 bits, LSB first: a start bit (0), 8 data bits, an odd parity bit and a stop bit (1). */
+static constexpr uint32_t FRAME_BIT_COUNT = 11;
+/** The keyboard clock is 10-16.7 kHz: a longer gap between two edges means that an edge was lost, the bits
+ * received so far are dropped (the next edge starts a new frame). */
+static constexpr uint64_t MAX_EDGE_GAP = 1'000;  // in microseconds
+static uint64_t g_max_edge_gap_ticks = 0;
+
+/** The frame being received by the clock IRQ (the top half). */
+static uint32_t g_frame = 0;
+static uint32_t g_frame_bit_count = 0;
+static uint64_t g_frame_timestamp = 0;
+static uint64_t g_last_edge_timestamp = 0;
+
+/** The frames received, decoded by decode_frames() in the IRQ work queue (the bottom half). */
+struct Frame {
+  uint16_t bits;
+  uint64_t timestamp;
+};  // struct Frame
+
+static constexpr size_t FRAME_RING_SIZE = 64;
+static Frame g_frames[FRAME_RING_SIZE];
+static size_t g_frames_head = 0;
+static size_t g_frames_tail = 0;
+static bool g_is_decode_queued = false;
+
+/** The state of the scancode decoder, between the bytes of a key. */
+static bool g_is_extended = false;  // after 0xE0
+static bool g_is_release = false;   // after 0xF0
+static size_t g_pause_bytes = 0;    // the bytes of the Pause sequence still to be skipped
+
+static void decode_byte(uint8_t byte, uint64_t timestamp) {
+  // Pause is the sequence E1 14 77 E1 F0 14 F0 77 when pressed, it is never released.
+  if (g_pause_bytes > 0) {
+    if (--g_pause_bytes == 0 && on_event != nullptr) {
+      (*on_event)(SYS_KEY_PAUSE, true, timestamp);
+      (*on_event)(SYS_KEY_PAUSE, false, timestamp);
     }
-
-    msg_stack = 0;
-    is_release = false;
     return;
   }
 
-  if (msg_stack == 0x12 || msg_stack == 0x59) {
-    // Shift Key press
-    if (sticky) {
-      if (is_release) {
-        // We only update on Release
-        shift_on = !shift_on;
-      }
-    } else {
-      if (is_release) {
-        shift_on = false;
-      } else {
-        shift_on = true;
-      }
-    }
-
-    msg_stack = 0;
-    is_release = false;
+  switch (byte) {
+    case 0xE0:
+      g_is_extended = true;
+      return;
+    case 0xF0:
+      g_is_release = true;
+      return;
+    case 0xE1:
+      g_pause_bytes = 7;
+      return;
+    default:
+      break;
+  }
+
+  // The key codes are the scancodes, prefixed by 0xE0 for the extended keys.
+  const auto keycode = (sys_key_code_t)(g_is_extended ? (0xE000 | byte) : byte);
+  const bool is_pressed = !g_is_release;
+  g_is_extended = false;
+  g_is_release = false;
+
+  // Print Screen is sent as E0 12 E0 7C (reversed on release), the fake shift E0 12 is ignored.
+  if (keycode == SYS_KEY_PRINT_SCREEN)
     return;
-  }
 
-  if (msg_stack == 0x11 || msg_stack == 0xe011) {
-    // Alt Key Press
-    if (sticky) {
-      if (is_release) {
-        // We only update on Release
-        alt_on = !alt_on;
-      }
-    } else {
-      if (is_release) {
-        alt_on = false;
-      } else {
-        alt_on = true;
-      }
-    }
+  if (on_event != nullptr)
+    (*on_event)(keycode == 0xE07C ? SYS_KEY_PRINT_SCREEN : keycode, is_pressed, timestamp);
+}
 
-    msg_stack = 0;
-    is_release = false;
-    return;
-  }
+/** Checks the framing bits and the parity of @a bits (see FRAME_BIT_COUNT). */
+static bool is_valid_frame(uint16_t bits) {
+  const bool start_bit = (bits & 0x1) != 0;
+  const bool stop_bit = (bits & (1 << 10)) != 0;
+  const bool has_odd_parity = (__builtin_popcount((bits >> 1) & 0x1ff) & 0x1) != 0;
+  return !start_bit && stop_bit && has_odd_parity;
+}
 
-  if (msg_stack == 0x77) {
-    // Num Lock Screen Press
+/** Decodes the frames received so far. Run by the IRQ work queue, as the events are dispatched to the window
+ * manager. */
+static void decode_frames(void*) {
+  g_is_decode_queued = false;
 
-    if (is_release) {
-      // We only update on Release
-      num_on = !num_on;
+  while (g_frames_tail != g_frames_head) {
+    const Frame frame = g_frames[g_frames_tail++ % FRAME_RING_SIZE];
+    if (!is_valid_frame(frame.bits)) {
+      LOG_ERROR("[PS2Keyboard] Invalid frame {:#x}", frame.bits);
+      continue;
     }
 
-    msg_stack = 0;
-    is_release = false;
-    return;
+    decode_byte((uint8_t)(frame.bits >> 1), frame.timestamp);
   }
+}
 
-  if (msg_stack == 0x58) {
-    // Caps Lock Screen Press
+/** The top half, run at each falling edge of the clock: the data pin is sampled and stored, nothing else. */
+static void gpio_clock_handler(size_t) {
+  const uint64_t now = GenericTimer::get_tick_count();
+  const bool bit = GPIO::read(DATA_PIN);
 
-    if (is_release) {
-      // We only update on Release
-      caps_on = !caps_on;
-    }
+  if (g_frame_bit_count != 0 && now - g_last_edge_timestamp > g_max_edge_gap_ticks)
+    g_frame_bit_count = 0;
 
-    msg_stack = 0;
-    is_release = false;
-    return;
+  g_last_edge_timestamp = now;
+  if (g_frame_bit_count == 0) {
+    g_frame = 0;
+    g_frame_timestamp = now;
   }
 
-  if (msg_stack == 0x7e) {
-    // Scroll Lock Screen Press
-
-    if (is_release) {
-      // We only update on Release
-      scroll_on = !scroll_on;
-    }
-
-    msg_stack = 0;
-    is_release = false;
+  g_frame |= (uint32_t)bit << g_frame_bit_count;
+  if (++g_frame_bit_count < FRAME_BIT_COUNT)
     return;
-  }
-
-  if (msg_stack == 0xe012e07c || msg_stack == 0xe07ce012) {
-    // Print Screen Press
-    msg_stack = SYS_KEY_PRINT_SCREEN;
-  }
-
-  if (msg_stack == 0xe11477e11477) {
-    // Pause Press
-    msg_stack = SYS_KEY_PAUSE;
-  }
-
-  sys_key_modifiers_t mods = SYS_KEY_MOD_NONE;
-  if (ctrl_on)
-    mods |= SYS_KEY_MOD_CTRL;
-  if (shift_on)
-    mods |= SYS_KEY_MOD_SHIFT;
-  if (alt_on)
-    mods |= SYS_KEY_MOD_ALT;
-  if (num_on)
-    mods |= SYS_KEY_MOD_NUM;
-  if (caps_on)
-    mods |= SYS_KEY_MOD_CAPS;
-  if (scroll_on)
-    mods |= SYS_KEY_MOD_SCROLL;
 
-  sys_key_code_t keycode = (sys_key_code_t)msg_stack;
-  sys_key_event_t event = is_release ? sys_create_release_event(keycode, mods) : sys_create_press_event(keycode, mods);
+  g_frame_bit_count = 0;
+  if (g_frames_head - g_frames_tail == FRAME_RING_SIZE)
+    return;  // the bottom half is late, the frame is lost
 
-  if (on_event != nullptr) {
-    (*on_event)(event);
-  }
-  msg_stack = 0;
-  is_release = false;
-}
-
-void gpio_clock_handler(size_t) {
-  if (is_sending) {
-  } else {
-    auto msg = receive_message();
-    if (msg.has_value()) {
-      process_message(msg.get_value());
-    }
-  }
+  g_frames[g_frames_head++ % FRAME_RING_SIZE] = {(uint16_t)g_frame, g_frame_timestamp};
+  if (!g_is_decode_queued)
+    g_is_decode_queued = TaskManager::get().get_irq_work_queue().queue(&decode_frames, nullptr);
 }
 
 void init() {
+  g_max_edge_gap_ticks = (MAX_EDGE_GAP * GenericTimer::get_frequency()) / 1'000'000;
+
   GPIO::set_mode(CLOCK_PIN, GPIO::Mode::INPUT);
   GPIO::set_mode(DATA_PIN, GPIO::Mode::INPUT);
 
@@ -264,8 +147,4 @@ void set_on_event(Event ev) {
   on_event = ev;
 }
 
-void set_sticky_keys(bool enable) {
-  sticky = enable;
-}
-
 }  // namespace PS2Keyboard
@@ -1,13 +1,15 @@
 #pragma once
 
+#include <sys/keyboard.h>
 #include <cstdint>
 
 namespace PS2Keyboard {
-using Event = void (*)(uint64_t);
+/** Called for each key event with the tick count of the generic timer at the first clock edge of its last
+ * byte, see KeyboardSystem::notify_hardware_event(). */
+using Event = void (*)(sys_key_code_t keycode, bool is_pressed, uint64_t timestamp);
 
+/** Decodes the scancodes (set 2) received on the GPIO pins. Requires the task manager. */
 void init();
 
 void set_on_event(Event ev);
-
-void set_sticky_keys(bool enable);
 };  // namespace PS2Keyboard
@@ -26,6 +26,9 @@ static_assert(sizeof(fpu_reg_t) == 16);
 
 /**
  * Floating-point and SIMD registers on Aarch64.
+ *
+ * The kernel itself is built with -mgeneral-regs-only, so these registers only hold the state of user
+ * tasks. They are switched lazily, see fpu.hpp.
  */
 struct FPURegisters {
   fpu_reg_t v0, v1, v2, v3, v4, v5, v6, v7;
@@ -33,93 +36,59 @@ struct FPURegisters {
   fpu_reg_t v15, v16, v17, v18, v19, v20;
   fpu_reg_t v21, v22, v23, v24, v25, v26;
   fpu_reg_t v27, v28, v29, v30, v31;
+  uint64_t fpcr, fpsr;
 
   /** Saves the current floating-point/SIMD registers into this structure. */
   void save() {
-#if 0
-#define SAVE_REG(number)          \
-  auto* ptr##number = &v##number; \
-  asm volatile("str v" #number ", %0" : "=m"(ptr##number))
-
-    SAVE_REG(0);
-    SAVE_REG(1);
-    SAVE_REG(2);
-    SAVE_REG(3);
-    SAVE_REG(4);
-    SAVE_REG(5);
-    SAVE_REG(6);
-    SAVE_REG(7);
-    SAVE_REG(8);
-    SAVE_REG(9);
-    SAVE_REG(10);
-    SAVE_REG(11);
-    SAVE_REG(12);
-    SAVE_REG(13);
-    SAVE_REG(14);
-    SAVE_REG(15);
-    SAVE_REG(16);
-    SAVE_REG(17);
-    SAVE_REG(18);
-    SAVE_REG(19);
-    SAVE_REG(20);
-    SAVE_REG(21);
-    SAVE_REG(22);
-    SAVE_REG(23);
-    SAVE_REG(24);
-    SAVE_REG(25);
-    SAVE_REG(26);
-    SAVE_REG(27);
-    SAVE_REG(28);
-    SAVE_REG(29);
-    SAVE_REG(30);
-    SAVE_REG(31);
-
-#undef SAVE_REG
-#endif
+    uint64_t fpcr_value, fpsr_value;
+    asm volatile(
+        "stp q0, q1, [%[base], #0]\n"
+        "stp q2, q3, [%[base], #32]\n"
+        "stp q4, q5, [%[base], #64]\n"
+        "stp q6, q7, [%[base], #96]\n"
+        "stp q8, q9, [%[base], #128]\n"
+        "stp q10, q11, [%[base], #160]\n"
+        "stp q12, q13, [%[base], #192]\n"
+        "stp q14, q15, [%[base], #224]\n"
+        "stp q16, q17, [%[base], #256]\n"
+        "stp q18, q19, [%[base], #288]\n"
+        "stp q20, q21, [%[base], #320]\n"
+        "stp q22, q23, [%[base], #352]\n"
+        "stp q24, q25, [%[base], #384]\n"
+        "stp q26, q27, [%[base], #416]\n"
+        "stp q28, q29, [%[base], #448]\n"
+        "stp q30, q31, [%[base], #480]\n"
+        "mrs %[fpcr], fpcr\n"
+        "mrs %[fpsr], fpsr\n"
+        : "=m"(*this), [fpcr] "=&r"(fpcr_value), [fpsr] "=&r"(fpsr_value)
+        : [base] "r"(this));
+    fpcr = fpcr_value;
+    fpsr = fpsr_value;
   }
 
   /** Restores the saved floating-point/SIMD registers of this structure. */
-  void restore() {
-#if 0
-#define RESTORE_REG(number)       \
-  auto* ptr##number = &v##number; \
-  asm volatile("ldr v" #number ", %0" : "=m"(ptr##number))
-
-    RESTORE_REG(0);
-    RESTORE_REG(1);
-    RESTORE_REG(2);
-    RESTORE_REG(3);
-    RESTORE_REG(4);
-    RESTORE_REG(5);
-    RESTORE_REG(6);
-    RESTORE_REG(7);
-    RESTORE_REG(8);
-    RESTORE_REG(9);
-    RESTORE_REG(10);
-    RESTORE_REG(11);
-    RESTORE_REG(12);
-    RESTORE_REG(13);
-    RESTORE_REG(14);
-    RESTORE_REG(15);
-    RESTORE_REG(16);
-    RESTORE_REG(17);
-    RESTORE_REG(18);
-    RESTORE_REG(19);
-    RESTORE_REG(20);
-    RESTORE_REG(21);
-    RESTORE_REG(22);
-    RESTORE_REG(23);
-    RESTORE_REG(24);
-    RESTORE_REG(25);
-    RESTORE_REG(26);
-    RESTORE_REG(27);
-    RESTORE_REG(28);
-    RESTORE_REG(29);
-    RESTORE_REG(30);
-    RESTORE_REG(31);
-
-#undef RESTORE_REG
-#endif
+  void restore() const {
+    asm volatile(
+        "ldp q0, q1, [%[base], #0]\n"
+        "ldp q2, q3, [%[base], #32]\n"
+        "ldp q4, q5, [%[base], #64]\n"
+        "ldp q6, q7, [%[base], #96]\n"
+        "ldp q8, q9, [%[base], #128]\n"
+        "ldp q10, q11, [%[base], #160]\n"
+        "ldp q12, q13, [%[base], #192]\n"
+        "ldp q14, q15, [%[base], #224]\n"
+        "ldp q16, q17, [%[base], #256]\n"
+        "ldp q18, q19, [%[base], #288]\n"
+        "ldp q20, q21, [%[base], #320]\n"
+        "ldp q22, q23, [%[base], #352]\n"
+        "ldp q24, q25, [%[base], #384]\n"
+        "ldp q26, q27, [%[base], #416]\n"
+        "ldp q28, q29, [%[base], #448]\n"
+        "ldp q30, q31, [%[base], #480]\n"
+        "msr fpcr, %[fpcr]\n"
+        "msr fpsr, %[fpsr]\n"
+        :
+        : [base] "r"(this), [fpcr] "r"(fpcr), [fpsr] "r"(fpsr), "m"(*this));
   }
 };  // struct FPURegisters
 
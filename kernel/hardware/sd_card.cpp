@@ -0,0 +1,416 @@
+#include "hardware/sd_card.hpp"
+
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "hardware/device.hpp"
+#include "hardware/gpio.hpp"
+#include "hardware/kernel_dt.hpp"
+#include "hardware/timer.hpp"
+
+namespace SDCard {
+// The SDHCI registers (see the SD Host Controller Simplified Specification and BCM2835-ARM-Peripherals.pdf,
+// chapter 5, for the Arasan controller).
+constexpr uint32_t BLKSIZECNT = 0x04;
+constexpr uint32_t ARG1 = 0x08;
+constexpr uint32_t CMDTM = 0x0c;
+constexpr uint32_t RESP0 = 0x10;
+constexpr uint32_t RESP1 = 0x14;
+constexpr uint32_t RESP2 = 0x18;
+constexpr uint32_t RESP3 = 0x1c;
+constexpr uint32_t DATA = 0x20;
+constexpr uint32_t STATUS = 0x24;
+constexpr uint32_t CONTROL0 = 0x28;
+constexpr uint32_t CONTROL1 = 0x2c;
+constexpr uint32_t INTERRUPT = 0x30;
+constexpr uint32_t IRPT_MASK = 0x34;
+constexpr uint32_t IRPT_EN = 0x38;
+constexpr uint32_t SLOTISR_VER = 0xfc;
+
+// CMDTM fields.
+constexpr uint32_t TM_BLKCNT_EN = 1 << 1;
+constexpr uint32_t TM_AUTO_CMD12 = 1 << 2;
+constexpr uint32_t TM_DAT_DIR_READ = 1 << 4;
+constexpr uint32_t TM_MULTI_BLOCK = 1 << 5;
+constexpr uint32_t CMD_RSPNS_136 = 1 << 16;
+constexpr uint32_t CMD_RSPNS_48 = 2 << 16;
+constexpr uint32_t CMD_RSPNS_48_BUSY = 3 << 16;
+constexpr uint32_t CMD_CRCCHK_EN = 1 << 19;
+constexpr uint32_t CMD_IXCHK_EN = 1 << 20;
+constexpr uint32_t CMD_ISDATA = 1 << 21;
+
+// STATUS fields.
+constexpr uint32_t SR_CMD_INHIBIT = 1 << 0;
+constexpr uint32_t SR_DAT_INHIBIT = 1 << 1;
+
+// CONTROL0 fields.
+constexpr uint32_t C0_HCTL_DWIDTH = 1 << 1;
+// SD bus power on, at 3.3V (the SDHCI power control register).
+constexpr uint32_t C0_POWER_3V3 = 0xf << 8;
+
+// CONTROL1 fields.
+constexpr uint32_t C1_CLK_INTLEN = 1 << 0;
+constexpr uint32_t C1_CLK_STABLE = 1 << 1;
+constexpr uint32_t C1_CLK_EN = 1 << 2;
+constexpr uint32_t C1_CLK_FREQ_MASK = 0xffc0;
+constexpr uint32_t C1_DATA_TOUNIT_MAX = 0xe << 16;
+constexpr uint32_t C1_SRST_HC = 1 << 24;
+
+// INTERRUPT fields.
+constexpr uint32_t INT_CMD_DONE = 1 << 0;
+constexpr uint32_t INT_DATA_DONE = 1 << 1;
+constexpr uint32_t INT_WRITE_RDY = 1 << 4;
+constexpr uint32_t INT_READ_RDY = 1 << 5;
+constexpr uint32_t INT_ERROR_MASK = 0xffff8000;
+
+// The card commands, with their response type.
+constexpr uint32_t CMD_GO_IDLE = 0;
+constexpr uint32_t CMD_ALL_SEND_CID = (2 << 24) | CMD_RSPNS_136;
+constexpr uint32_t CMD_SEND_REL_ADDR = (3 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN;
+constexpr uint32_t CMD_CARD_SELECT = (7 << 24) | CMD_RSPNS_48_BUSY | CMD_CRCCHK_EN;
+constexpr uint32_t CMD_SEND_IF_COND = (8 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN;
+constexpr uint32_t CMD_SEND_CSD = (9 << 24) | CMD_RSPNS_136;
+constexpr uint32_t CMD_SET_BLOCKLEN = (16 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN;
+constexpr uint32_t CMD_READ_SINGLE = (17 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN | CMD_ISDATA | TM_DAT_DIR_READ;
+constexpr uint32_t CMD_READ_MULTI = (18 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN | CMD_ISDATA | TM_DAT_DIR_READ |
+                                    TM_BLKCNT_EN | TM_MULTI_BLOCK | TM_AUTO_CMD12;
+constexpr uint32_t CMD_WRITE_SINGLE = (24 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN | CMD_ISDATA;
+constexpr uint32_t CMD_WRITE_MULTI =
+    (25 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN | CMD_ISDATA | TM_BLKCNT_EN | TM_MULTI_BLOCK | TM_AUTO_CMD12;
+constexpr uint32_t CMD_APP_CMD = (55 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN;
+// The application commands (preceded by CMD_APP_CMD).
+constexpr uint32_t ACMD_SET_BUS_WIDTH = (6 << 24) | CMD_RSPNS_48 | CMD_CRCCHK_EN;
+constexpr uint32_t ACMD_SEND_OP_COND = (41 << 24) | CMD_RSPNS_48;
+
+// SEND_IF_COND argument: 2.7-3.6V and a check pattern echoed by the card.
+constexpr uint32_t IF_COND_PATTERN = 0x1aa;
+// SEND_OP_COND argument: high capacity support and 3.2-3.4V.
+constexpr uint32_t OP_COND_HCS = 1 << 30;
+constexpr uint32_t OP_COND_VOLTAGE = 0x00300000;
+constexpr uint32_t OP_COND_READY = 1u << 31;
+constexpr uint32_t OP_COND_CCS = 1 << 30;
+
+constexpr uint32_t IDENTIFICATION_CLOCK = 400'000;
+constexpr uint32_t TRANSFER_CLOCK = 25'000'000;
+// The block count register is 16 bits wide.
+constexpr size_t MAX_BLOCKS_PER_COMMAND = UINT16_MAX;
+
+constexpr uint64_t COMMAND_TIMEOUT_MS = 500;
+constexpr uint64_t DATA_TIMEOUT_MS = 1000;
+constexpr uint64_t INIT_TIMEOUT_MS = 1000;
+
+static uintptr_t g_base = 0;
+static uint32_t g_base_clock = 0;
+static uint32_t g_host_version = 0;
+static uint32_t g_rca = 0;
+// Standard capacity cards take byte addresses, high capacity ones block addresses.
+static bool g_is_high_capacity = false;
+static uint64_t g_block_count = 0;
+static bool g_is_initialized = false;
+
+static void delay_us(uint64_t us) {
+  const uint64_t end = GenericTimer::get_elapsed_time_in_micros() + us;
+  while (GenericTimer::get_elapsed_time_in_micros() < end)
+    libk::yield();
+}
+
+/** Waits until all the bits of @a mask are cleared in the register @a offset. */
+static bool wait_for_clear(uint32_t offset, uint32_t mask, uint64_t timeout_ms) {
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + timeout_ms;
+  while ((libk::read32(g_base + offset) & mask) != 0) {
+    if (GenericTimer::get_elapsed_time_in_ms() > end)
+      return false;
+  }
+
+  return true;
+}
+
+/** Waits for one of the @a mask interrupts (which is then acknowledged), or for an error. */
+static bool wait_for_interrupt(uint32_t mask, uint64_t timeout_ms) {
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + timeout_ms;
+  uint32_t status;
+  while (((status = libk::read32(g_base + INTERRUPT)) & (mask | INT_ERROR_MASK)) == 0) {
+    if (GenericTimer::get_elapsed_time_in_ms() > end) {
+      LOG_ERROR("SD card: timeout waiting for the interrupt {:#x}", mask);
+      return false;
+    }
+  }
+
+  if ((status & INT_ERROR_MASK) != 0) {
+    LOG_ERROR("SD card: error interrupt {:#x}", status);
+    libk::write32(g_base + INTERRUPT, status);
+    return false;
+  }
+
+  libk::write32(g_base + INTERRUPT, mask);
+  return true;
+}
+
+/** Sends the command @a command (CMDTM value) with @a arg. For data commands, the transfer is then done by
+ * the caller. */
+static bool send_command(uint32_t command, uint32_t arg, uint32_t block_count = 1) {
+  const uint32_t inhibit = ((command & CMD_ISDATA) != 0) ? (SR_CMD_INHIBIT | SR_DAT_INHIBIT) : SR_CMD_INHIBIT;
+  if (!wait_for_clear(STATUS, inhibit, COMMAND_TIMEOUT_MS)) {
+    LOG_ERROR("SD card: controller busy before the command {}", command >> 24);
+    return false;
+  }
+
+  // Acknowledge previous interrupts.
+  libk::write32(g_base + INTERRUPT, libk::read32(g_base + INTERRUPT));
+
+  libk::write32(g_base + BLKSIZECNT, (block_count << 16) | BLOCK_SIZE);
+  libk::write32(g_base + ARG1, arg);
+  libk::write32(g_base + CMDTM, command);
+  return wait_for_interrupt(INT_CMD_DONE, COMMAND_TIMEOUT_MS);
+}
+
+static bool send_app_command(uint32_t command, uint32_t arg) {
+  return send_command(CMD_APP_CMD, g_rca << 16) && send_command(command, arg);
+}
+
+static bool set_clock(uint32_t frequency) {
+  if (!wait_for_clear(STATUS, SR_CMD_INHIBIT | SR_DAT_INHIBIT, COMMAND_TIMEOUT_MS))
+    return false;
+
+  uint32_t control1 = libk::read32(g_base + CONTROL1) & ~C1_CLK_EN;
+  libk::write32(g_base + CONTROL1, control1);
+  delay_us(10);
+
+  // The SD clock is the base clock divided by 2 * divisor. Before SDHCI 3.0, the divisor is 8 bits wide and
+  // must be a power of two.
+  uint32_t divisor = libk::div_round_up(g_base_clock, 2 * frequency);
+  uint32_t divisor_bits;
+  if (g_host_version < 2) {
+    uint32_t power = 1;
+    while (power < divisor && power < 0x80)
+      power <<= 1;
+    divisor_bits = (power & 0xff) << 8;
+  } else {
+    divisor = libk::min<uint32_t>(divisor, 0x3ff);
+    divisor_bits = ((divisor & 0xff) << 8) | (((divisor >> 8) & 0x3) << 6);
+  }
+
+  control1 = (control1 & ~C1_CLK_FREQ_MASK) | divisor_bits | C1_CLK_INTLEN;
+  libk::write32(g_base + CONTROL1, control1);
+  delay_us(10);
+
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + COMMAND_TIMEOUT_MS;
+  while ((libk::read32(g_base + CONTROL1) & C1_CLK_STABLE) == 0) {
+    if (GenericTimer::get_elapsed_time_in_ms() > end) {
+      LOG_ERROR("SD card: the clock is not stable");
+      return false;
+    }
+  }
+
+  libk::write32(g_base + CONTROL1, control1 | C1_CLK_EN);
+  delay_us(10);
+  return true;
+}
+
+static bool reset_host() {
+  libk::write32(g_base + CONTROL0, 0);
+  libk::write32(g_base + CONTROL1, libk::read32(g_base + CONTROL1) | C1_SRST_HC);
+  if (!wait_for_clear(CONTROL1, C1_SRST_HC, COMMAND_TIMEOUT_MS)) {
+    LOG_ERROR("SD card: failed to reset the controller");
+    return false;
+  }
+
+  libk::write32(g_base + CONTROL0, C0_POWER_3V3);
+  libk::write32(g_base + CONTROL1, libk::read32(g_base + CONTROL1) | C1_CLK_INTLEN | C1_DATA_TOUNIT_MAX);
+  delay_us(10);
+
+  // Only poll the interrupt statuses, none of them is signaled to the interrupt controller.
+  libk::write32(g_base + IRPT_EN, 0);
+  libk::write32(g_base + IRPT_MASK, 0xffffffff);
+  return true;
+}
+
+/** Reads the card capacity from its CSD register (the response of CMD_SEND_CSD). */
+static uint64_t parse_block_count() {
+  // The R2 response does not have the CRC byte, so the CSD bit n is the response bit n - 8.
+  const uint32_t resp1 = libk::read32(g_base + RESP1);
+  const uint32_t resp2 = libk::read32(g_base + RESP2);
+  const uint32_t resp3 = libk::read32(g_base + RESP3);
+
+  const uint32_t csd_structure = (resp3 >> 22) & 0x3;
+  if (csd_structure == 1) {
+    // CSD version 2.0: C_SIZE is CSD[69:48], the capacity is (C_SIZE + 1) * 512 KiB.
+    const uint64_t c_size = (resp1 >> 8) & 0x3fffff;
+    return (c_size + 1) * 1024;
+  }
+
+  // CSD version 1.0: the capacity is (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) * 2^READ_BL_LEN.
+  const uint64_t c_size = ((resp1 >> 22) & 0x3ff) | ((resp2 & 0x3) << 10);
+  const uint32_t c_size_mult = (resp1 >> 7) & 0x7;
+  const uint32_t read_bl_len = (resp2 >> 8) & 0xf;
+  return ((c_size + 1) << (c_size_mult + 2 + read_bl_len)) / BLOCK_SIZE;
+}
+
+static bool init_card() {
+  if (!send_command(CMD_GO_IDLE, 0))
+    return false;
+
+  // Only SD version 2 cards (and later) answer, the older ones are not supported.
+  if (!send_command(CMD_SEND_IF_COND, IF_COND_PATTERN) || (libk::read32(g_base + RESP0) & 0xfff) != IF_COND_PATTERN) {
+    LOG_WARNING("SD card: no card or not a SD version 2 card");
+    return false;
+  }
+
+  // Wait for the card to be powered up.
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + INIT_TIMEOUT_MS;
+  uint32_t op_cond = 0;
+  while ((op_cond & OP_COND_READY) == 0) {
+    if (GenericTimer::get_elapsed_time_in_ms() > end) {
+      LOG_ERROR("SD card: the card did not power up");
+      return false;
+    }
+
+    if (!send_app_command(ACMD_SEND_OP_COND, OP_COND_HCS | OP_COND_VOLTAGE))
+      return false;
+
+    op_cond = libk::read32(g_base + RESP0);
+    if ((op_cond & OP_COND_READY) == 0)
+      delay_us(10'000);
+  }
+
+  g_is_high_capacity = (op_cond & OP_COND_CCS) != 0;
+
+  if (!send_command(CMD_ALL_SEND_CID, 0) || !send_command(CMD_SEND_REL_ADDR, 0))
+    return false;
+
+  g_rca = libk::read32(g_base + RESP0) >> 16;
+
+  if (!send_command(CMD_SEND_CSD, g_rca << 16))
+    return false;
+
+  g_block_count = parse_block_count();
+
+  if (!send_command(CMD_CARD_SELECT, g_rca << 16) || !set_clock(TRANSFER_CLOCK))
+    return false;
+
+  // All SD memory cards support the 4-bit bus.
+  if (!send_app_command(ACMD_SET_BUS_WIDTH, 2))
+    return false;
+
+  libk::write32(g_base + CONTROL0, libk::read32(g_base + CONTROL0) | C0_HCTL_DWIDTH);
+
+  // Ignored by high capacity cards, always 512 bytes.
+  return send_command(CMD_SET_BLOCKLEN, BLOCK_SIZE);
+}
+
+bool init() {
+  if (g_is_initialized)
+    return true;
+
+  // The BCM2711 has a dedicated controller for the SD card. On the BCM2837, the Arasan controller is shared
+  // with the WiFi chip and the SD card pins must be routed to it (the firmware routes them to SDHOST).
+  bool is_emmc2 = true;
+  if (!KernelDT::get_device_address("emmc2", &g_base)) {
+    is_emmc2 = false;
+    if (!KernelDT::get_device_address("mmc", &g_base)) {
+      LOG_WARNING("SD card: no SDHCI controller found");
+      return false;
+    }
+
+    for (size_t pin = 48; pin <= 53; ++pin) {
+      GPIO::set_mode(pin, GPIO::Mode::ALT3);
+      GPIO::set_pull_up_down(pin, (pin == 48) ? GPIO::PUD_Mode::Off : GPIO::PUD_Mode::PullUp);
+    }
+  }
+
+  g_base_clock = Device::get_clock_rate(is_emmc2 ? Device::EMMC2 : Device::EMMC);
+  if (g_base_clock == 0) {
+    LOG_WARNING("SD card: unknown controller clock rate");
+    return false;
+  }
+
+  g_host_version = (libk::read32(g_base + SLOTISR_VER) >> 16) & 0xff;
+
+  if (!reset_host() || !set_clock(IDENTIFICATION_CLOCK) || !init_card())
+    return false;
+
+  g_is_initialized = true;
+  LOG_INFO("SD card initialized ({} MiB, {} capacity)", (g_block_count * BLOCK_SIZE) >> 20,
+           g_is_high_capacity ? "high" : "standard");
+  return true;
+}
+
+bool is_initialized() {
+  return g_is_initialized;
+}
+
+uint64_t get_block_count() {
+  return g_block_count;
+}
+
+/** Moves a block through the data port, the buffer may be unaligned. */
+template <bool IsRead>
+static void transfer_block(uint8_t* buffer) {
+  if (((uintptr_t)buffer % alignof(uint32_t)) == 0) {
+    auto* words = (uint32_t*)buffer;
+    for (size_t i = 0; i < BLOCK_SIZE / sizeof(uint32_t); ++i) {
+      if constexpr (IsRead)
+        words[i] = libk::read32(g_base + DATA);
+      else
+        libk::write32(g_base + DATA, words[i]);
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < BLOCK_SIZE; i += sizeof(uint32_t)) {
+    uint32_t word;
+    if constexpr (IsRead) {
+      word = libk::read32(g_base + DATA);
+      libk::memcpy(buffer + i, &word, sizeof(word));
+    } else {
+      libk::memcpy(&word, buffer + i, sizeof(word));
+      libk::write32(g_base + DATA, word);
+    }
+  }
+}
+
+template <bool IsRead>
+static bool transfer_blocks(uint64_t block, uint8_t* buffer, size_t count) {
+  if (!g_is_initialized || block + count > g_block_count)
+    return false;
+
+  while (count > 0) {
+    const size_t block_count = libk::min(count, MAX_BLOCKS_PER_COMMAND);
+    const uint32_t address = g_is_high_capacity ? block : block * BLOCK_SIZE;
+
+    uint32_t command;
+    if constexpr (IsRead)
+      command = (block_count == 1) ? CMD_READ_SINGLE : CMD_READ_MULTI;
+    else
+      command = (block_count == 1) ? CMD_WRITE_SINGLE : CMD_WRITE_MULTI;
+
+    if (!send_command(command, address, block_count))
+      return false;
+
+    // The host raises READ_RDY (or WRITE_RDY) each time a block can be moved through the data port.
+    for (size_t i = 0; i < block_count; ++i) {
+      if (!wait_for_interrupt(IsRead ? INT_READ_RDY : INT_WRITE_RDY, DATA_TIMEOUT_MS))
+        return false;
+
+      transfer_block<IsRead>(buffer);
+      buffer += BLOCK_SIZE;
+    }
+
+    if (!wait_for_interrupt(INT_DATA_DONE, DATA_TIMEOUT_MS))
+      return false;
+
+    block += block_count;
+    count -= block_count;
+  }
+
+  return true;
+}
+
+bool read_blocks(uint64_t block, void* buffer, size_t count) {
+  return transfer_blocks<true>(block, (uint8_t*)buffer, count);
+}
+
+bool write_blocks(uint64_t block, const void* buffer, size_t count) {
+  return transfer_blocks<false>(block, (uint8_t*)buffer, count);
+}
+}  // namespace SDCard
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The SD card driver, for the SDHCI host controllers of the Raspberry Pi (the Arasan "mmc" one of the
+ * BCM2837 and "emmc2" of the BCM2711).
+ *
+ * The card is used with a 4-bit bus at 25 MHz (default speed). Transfers of multiple blocks are done by a
+ * single command (CMD18/CMD25, the host stopping them with an automatic CMD12), and the CPU moves the data
+ * through the data port of the controller.
+ */
+namespace SDCard {
+/** The size of a block in bytes, the unit of all transfers. */
+static constexpr size_t BLOCK_SIZE = 512;
+
+/** Detects and initializes the card. Returns false if there is no controller or no (supported) card. */
+[[nodiscard]] bool init();
+[[nodiscard]] bool is_initialized();
+
+/** Returns the card capacity in blocks. */
+[[nodiscard]] uint64_t get_block_count();
+
+/** Reads @a count blocks starting at the block @a block into @a buffer (no alignment required). */
+[[nodiscard]] bool read_blocks(uint64_t block, void* buffer, size_t count);
+/** Writes @a count blocks from @a buffer starting at the block @a block (no alignment required). */
+[[nodiscard]] bool write_blocks(uint64_t block, const void* buffer, size_t count);
+};  // namespace SDCard
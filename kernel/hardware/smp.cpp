@@ -0,0 +1,222 @@
+#include "smp.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/cache.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+
+#include "hardware/irq/irq_manager.hpp"
+#include "hardware/kernel_dt.hpp"
+#include "hardware/timer.hpp"
+#include "profiler.hpp"
+#include "task/task_manager.hpp"
+
+// Entry point of the secondary cores, defined in boot.S. It is executed with the MMU disabled.
+extern "C" void _secondary_start();
+
+namespace SMP {
+
+/** Function ID of PSCI CPU_ON (SMC64 calling convention). */
+static inline constexpr uint64_t PSCI_CPU_ON = 0xC4000003;
+
+/** Time (in milliseconds) given to a secondary core to come online. */
+static inline constexpr uint64_t CORE_BOOT_TIMEOUT = 100;
+
+static bool g_online[MAX_CORES] = {};
+static bool g_scheduling_started = false;
+
+static bool is_online(size_t core_id) {
+  return __atomic_load_n(&g_online[core_id], __ATOMIC_ACQUIRE);
+}
+
+/** Function ID of PSCI CPU_OFF. */
+static inline constexpr uint64_t PSCI_CPU_OFF = 0x84000002;
+/** Function ID of PSCI AFFINITY_INFO (SMC64 calling convention). */
+static inline constexpr uint64_t PSCI_AFFINITY_INFO = 0xC4000004;
+/** The AFFINITY_INFO state of a core turned off. */
+static inline constexpr int64_t PSCI_AFFINITY_OFF = 1;
+
+static int64_t psci_call(bool use_hvc, uint64_t function, uint64_t arg0, uint64_t arg1, uint64_t arg2) {
+  register uint64_t x0 asm("x0") = function;
+  register uint64_t x1 asm("x1") = arg0;
+  register uint64_t x2 asm("x2") = arg1;
+  register uint64_t x3 asm("x3") = arg2;
+
+  if (use_hvc) {
+    asm volatile("hvc #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x3) : "memory");
+  } else {
+    asm volatile("smc #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x3) : "memory");
+  }
+
+  return (int64_t)x0;
+}
+
+static bool psci_cpu_on(bool use_hvc, uint64_t target_cpu, PhysicalPA entry_point) {
+  // The last argument is the context id.
+  return psci_call(use_hvc, PSCI_CPU_ON, target_cpu, entry_point, 0) == 0;  // PSCI_SUCCESS
+}
+
+bool get_enable_method(size_t core_id, EnableMethod* method) {
+  char path[] = "/cpus/cpu@0";
+  path[sizeof(path) - 2] = (char)('0' + core_id);
+
+  Node cpu_node;
+  if (!KernelDT::find_node(path, &cpu_node)) {
+    return false;
+  }
+
+  Property prop;
+  if (!cpu_node.find_property("enable-method", &prop)) {
+    return false;
+  }
+
+  const auto enable_method = prop.get_string();
+  if (!enable_method.has_value()) {
+    return false;
+  }
+
+  if (enable_method.get_value() == "spin-table") {
+    if (!cpu_node.find_property("cpu-release-addr", &prop)) {
+      return false;
+    }
+
+    const auto release_addr = prop.get_u32_or_u64();
+    if (!release_addr.has_value()) {
+      return false;
+    }
+
+    *method = {EnableMethod::Kind::SPIN_TABLE, release_addr.get_value(), false};
+    return true;
+  }
+
+  if (enable_method.get_value() == "psci") {
+    if (!cpu_node.find_property("reg", &prop)) {
+      return false;
+    }
+
+    const auto target_cpu = prop.get_u32_or_u64();
+    if (!target_cpu.has_value() || !KernelDT::find_property("/psci/method", &prop)) {
+      return false;
+    }
+
+    const auto psci_method = prop.get_string();
+    if (!psci_method.has_value()) {
+      return false;
+    }
+
+    *method = {EnableMethod::Kind::PSCI, target_cpu.get_value(), psci_method.get_value() == "hvc"};
+    return true;
+  }
+
+  LOG_WARNING("Unsupported enable method '{}' for core {}", enable_method.get_value(), core_id);
+  return false;
+}
+
+static bool wake_core(size_t core_id, PhysicalPA entry_point) {
+  EnableMethod method;
+  if (!get_enable_method(core_id, &method)) {
+    return false;
+  }
+
+  if (method.kind == EnableMethod::Kind::SPIN_TABLE) {
+    // The core is spinning (inside the firmware stub, or parked by the previous kernel, see Kexec) on its release
+    // address, with its MMU off, waiting for an entry point to be written there.
+    libk::write64(NORMAL_MEMORY + method.address, entry_point);
+    libk::clean_dcache_range((const void*)(NORMAL_MEMORY + method.address), sizeof(uint64_t));
+    asm volatile("dsb sy");
+    libk::sev();
+    return true;
+  }
+
+  return psci_cpu_on(method.use_hvc, method.address, entry_point);
+}
+
+void init() {
+  g_online[DEFAULT_CORE] = true;
+
+  // The kernel is mapped at KERNEL_BASE + its physical address.
+  const PhysicalPA entry_point = (uintptr_t)&_secondary_start - KERNEL_BASE;
+
+  // Cores are woken up one after the other, so they never race during their initialization.
+  for (size_t core_id = 0; core_id < MAX_CORES; ++core_id) {
+    if (core_id == DEFAULT_CORE)
+      continue;
+
+    if (!wake_core(core_id, entry_point)) {
+      LOG_WARNING("Unable to wake up the core {}", core_id);
+      continue;
+    }
+
+    const uint64_t deadline = GenericTimer::get_elapsed_time_in_ms() + CORE_BOOT_TIMEOUT;
+    while (!is_online(core_id) && GenericTimer::get_elapsed_time_in_ms() < deadline) {
+      libk::yield();
+    }
+
+    if (!is_online(core_id)) {
+      LOG_WARNING("The core {} did not come online", core_id);
+    }
+  }
+
+  LOG_INFO("{} cores online", get_online_cores_count());
+}
+
+size_t get_online_cores_count() {
+  size_t count = 0;
+  for (size_t core_id = 0; core_id < MAX_CORES; ++core_id) {
+    if (is_online(core_id))
+      count++;
+  }
+
+  return count;
+}
+
+uint32_t get_online_cores_mask() {
+  uint32_t mask = 0;
+  for (size_t core_id = 0; core_id < MAX_CORES; ++core_id) {
+    if (is_online(core_id))
+      mask |= (uint32_t)1 << core_id;
+  }
+
+  return mask;
+}
+
+void start_scheduling() {
+  __atomic_store_n(&g_scheduling_started, true, __ATOMIC_RELEASE);
+  asm volatile("dsb sy");
+  libk::sev();
+}
+
+void turn_off_core(const EnableMethod& method) {
+  KASSERT(method.kind == EnableMethod::Kind::PSCI);
+  (void)psci_call(method.use_hvc, PSCI_CPU_OFF, 0, 0, 0);
+}
+
+bool is_core_off(const EnableMethod& method) {
+  KASSERT(method.kind == EnableMethod::Kind::PSCI);
+  // The lowest affinity level, the core itself.
+  return psci_call(method.use_hvc, PSCI_AFFINITY_INFO, method.address, 0, 0) == PSCI_AFFINITY_OFF;
+}
+
+[[noreturn]] void secondary_main(size_t core_id) {
+  IRQManager::init_core();
+
+  // The boot core is waiting for us, so we still have the UART for ourselves.
+  LOG_INFO("Core {} online", core_id);
+  __atomic_store_n(&g_online[core_id], true, __ATOMIC_RELEASE);
+
+  while (!__atomic_load_n(&g_scheduling_started, __ATOMIC_ACQUIRE)) {
+    libk::wfe();
+  }
+
+  // From now, this core is driven by its scheduler tick as any other core.
+  TaskManager::get().init_core();
+#ifdef CONFIG_PROFILER
+  Profiler::init_core();
+#endif  // CONFIG_PROFILER
+  IRQManager::enable_irq_interrupts();
+
+  while (true) {
+    libk::wfi();
+  }
+}
+}  // namespace SMP
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "boot/mmu_utils.hpp"
+
+namespace SMP {
+/** The maximum count of cores handled by the kernel. */
+static inline constexpr size_t MAX_CORES = NB_CORES;
+/** The size of the data cache lines, the data written by different cores is kept on different lines (see PerCore). */
+static inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+/** @brief Returns the id of the calling core (between 0 and MAX_CORES - 1). */
+[[nodiscard]] static inline size_t get_core_id() {
+  uint64_t mpidr;
+  asm volatile("mrs %x0, mpidr_el1" : "=r"(mpidr));
+  return mpidr & 0b11;
+}
+
+/** @brief Checks if the calling core is the one that booted the kernel. */
+[[nodiscard]] static inline bool is_boot_core() {
+  return get_core_id() == DEFAULT_CORE;
+}
+
+/** How a secondary core is woken up, from the "enable-method" of its device tree node. */
+struct EnableMethod {
+  enum class Kind { SPIN_TABLE, PSCI };
+
+  Kind kind;
+  /** The physical address the core polls for its entry point (SPIN_TABLE), or its PSCI target id. */
+  uint64_t address;
+  bool use_hvc;  // PSCI only, the conduit of the calls (SMC otherwise)
+};  // struct EnableMethod
+
+/** Reads the enable method of the core @a core_id. Returns false if it is missing or not supported. */
+[[nodiscard]] bool get_enable_method(size_t core_id, EnableMethod* method);
+
+/** Wakes up the secondary cores (as described by the device tree) and waits for them to be online. */
+void init();
+
+/** @brief Returns the count of cores currently online (including the boot core). */
+[[nodiscard]] size_t get_online_cores_count();
+/** Returns the cores currently online, bit i for the core i. */
+[[nodiscard]] uint32_t get_online_cores_mask();
+
+/** Allows secondary cores to start running tasks. Called once the task manager is ready. */
+void start_scheduling();
+
+/** Turns the calling secondary core off with PSCI CPU_OFF (@a method must be PSCI), it can then be woken up again.
+ * Returns only on failure. */
+void turn_off_core(const EnableMethod& method);
+/** Checks with PSCI AFFINITY_INFO if the core of @a method (turned off by turn_off_core()) is off. */
+[[nodiscard]] bool is_core_off(const EnableMethod& method);
+
+/** The secondary cores entry point once in the C++ world. */
+[[noreturn]] void secondary_main(size_t core_id);
+};  // namespace SMP
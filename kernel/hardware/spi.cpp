@@ -0,0 +1,130 @@
+#include "hardware/spi.hpp"
+
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "hardware/device.hpp"
+#include "hardware/dma/dma_controller.hpp"
+#include "hardware/gpio.hpp"
+#include "hardware/kernel_dt.hpp"
+#include "memory/buffer.hpp"
+
+// Offsets from the SPI0 base, taken from BCM2835-ARM-Peripherals.pdf, page 152.
+static constexpr uint32_t SPI_CS = 0x00;    //<! Master Control and Status
+static constexpr uint32_t SPI_FIFO = 0x04;  //<! Master TX and RX FIFOs
+static constexpr uint32_t SPI_CLK = 0x08;   //<! Master Clock Divider
+
+static constexpr uint32_t CS_CLEAR_TX = 1 << 4;
+static constexpr uint32_t CS_CLEAR_RX = 1 << 5;
+static constexpr uint32_t CS_TA = 1 << 7;      // Transfer Active
+static constexpr uint32_t CS_DMAEN = 1 << 8;   // DMA Enable
+static constexpr uint32_t CS_ADCS = 1 << 11;   // Automatically Deassert Chip Select at the end of a DMA transfer
+static constexpr uint32_t CS_DONE = 1 << 16;   // Transfer Done
+static constexpr uint32_t CS_RXD = 1 << 17;    // RX FIFO contains Data
+static constexpr uint32_t CS_TXD = 1 << 18;    // TX FIFO can accept Data
+
+/** The DREQs of SPI0, for the PERMAP field of the DMA requests. */
+static constexpr uint8_t SPI_TX_DREQ = 6;
+static constexpr uint8_t SPI_RX_DREQ = 7;
+
+/** The GPIO pins of SPI0 (in ALT0 mode): CE0, MISO, MOSI and SCLK. */
+static constexpr size_t SPI_PINS[] = {8, 9, 10, 11};
+
+SPI::SPI(uint32_t clock_hz) {
+  uintptr_t soc_address;
+  if (!KernelDT::get_device_address("spi", &m_base) || !KernelDT::get_device_soc_address("spi", &soc_address)) {
+    LOG_ERROR("SPI0 not found in the device tree");
+    m_base = 0;
+    return;
+  }
+
+  m_fifo_bus_address = soc_address + SPI_FIFO;
+
+  for (size_t pin : SPI_PINS)
+    GPIO::set_mode(pin, GPIO::Mode::ALT0);
+
+  // The clock is the core clock divided by an even divisor (0 means 65536).
+  const uint32_t core_clock = Device::get_clock_rate(Device::CORE);
+  uint32_t divisor = libk::div_round_up(core_clock, libk::max<uint32_t>(clock_hz, 1));
+  divisor = libk::clamp<uint32_t>((divisor + 1) & ~1u, 2, 65534);
+  libk::write32(m_base + SPI_CS, CS_CLEAR_TX | CS_CLEAR_RX);
+  libk::write32(m_base + SPI_CLK, divisor);
+  LOG_INFO("SPI0 clock set to {} Hz", core_clock / divisor);
+
+  if (!DMA::has_free_channel())
+    return;
+  m_rx_channel.reset(new DMA::Channel);
+  if (!DMA::has_free_channel()) {
+    m_rx_channel.reset();
+    return;
+  }
+
+  m_tx_channel.reset(new DMA::Channel);
+  m_tx_request.reset(DMA::Request::memcpy(0, 0, 0));
+  m_rx_request.reset(DMA::Request::memcpy(0, 0, 0));
+  if (!m_tx_request || !m_rx_request)
+    m_tx_channel.reset();
+}
+
+SPI::~SPI() {
+  if (m_tx_channel)
+    wait();
+}
+
+void SPI::write(const uint8_t* data, size_t length) {
+  wait();
+
+  libk::write32(m_base + SPI_CS, CS_CLEAR_TX | CS_CLEAR_RX | CS_TA);
+
+  size_t written = 0;
+  while (written < length) {
+    if ((libk::read32(m_base + SPI_CS) & CS_TXD) != 0)
+      libk::write32(m_base + SPI_FIFO, data[written++]);
+
+    // Drain the RX FIFO, the transfer stalls once it is full.
+    while ((libk::read32(m_base + SPI_CS) & CS_RXD) != 0)
+      (void)libk::read32(m_base + SPI_FIFO);
+  }
+
+  while ((libk::read32(m_base + SPI_CS) & CS_DONE) == 0) {
+    while ((libk::read32(m_base + SPI_CS) & CS_RXD) != 0)
+      (void)libk::read32(m_base + SPI_FIFO);
+  }
+
+  libk::write32(m_base + SPI_CS, 0);
+}
+
+void SPI::start_dma_write(Buffer& buffer, size_t length) {
+  KASSERT(is_initialized() && length > 0 && length <= MAX_DMA_LENGTH);
+  KASSERT(buffer.get_byte_size() >= DMA_HEADER_SIZE + libk::align_to_next(length, sizeof(uint32_t)));
+  wait();
+
+  // The header starts the transfer: its length and the low byte of the control flags (with TA set).
+  auto* header = (uint32_t*)buffer.get();
+  *header = (length << 16) | CS_TA;
+  buffer.clean(0, DMA_HEADER_SIZE);
+
+  // The FIFO is accessed by words, the bytes after the transfer length are ignored.
+  const size_t fifo_length = libk::align_to_next(length, sizeof(uint32_t));
+  m_tx_request->set_memcpy(buffer.get_dma_address(), m_fifo_bus_address, DMA_HEADER_SIZE + fifo_length);
+  m_tx_request->set_dest_dreq(SPI_TX_DREQ);
+  m_rx_request->set_memcpy(m_fifo_bus_address, 0, fifo_length);
+  m_rx_request->set_src_dreq(SPI_RX_DREQ);
+  m_rx_request->set_dest_ignore();
+
+  libk::write32(m_base + SPI_CS, CS_CLEAR_TX | CS_CLEAR_RX | CS_DMAEN | CS_ADCS);
+  const bool is_started = m_rx_channel->execute_requests(m_rx_request.get()) &&
+                          m_tx_channel->execute_requests(m_tx_request.get());
+  KASSERT(is_started);
+  m_is_dma_pending = true;
+}
+
+void SPI::wait() {
+  if (!m_is_dma_pending)
+    return;
+
+  // The RX channel ends last, once the last byte is shifted out.
+  m_tx_channel->wait();
+  m_rx_channel->wait();
+  libk::write32(m_base + SPI_CS, 0);
+  m_is_dma_pending = false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+
+#include "hardware/dma/channel.hpp"
+
+class Buffer;
+
+/**
+ * The SPI0 master (BCM2835-ARM-Peripherals.pdf, page 148), on the GPIO pins 8 (chip select 0) to 11.
+ *
+ * The small writes (the commands of a device) are polled. The large ones are done by two DMA channels paced by
+ * the SPI DREQs: one feeds the TX FIFO from a buffer, the other one drains the RX FIFO (the received bytes are
+ * discarded, the transfer would stall once the RX FIFO is full otherwise).
+ */
+class SPI {
+ public:
+  /** The bytes reserved at the start of the buffers given to start_dma_write(): in DMA mode, the first word
+   * written into the FIFO is the transfer length and the control flags. */
+  static constexpr size_t DMA_HEADER_SIZE = sizeof(uint32_t);
+  /** The longest DMA transfer, in bytes (the length register is 16 bits wide). */
+  static constexpr size_t MAX_DMA_LENGTH = 65532;
+
+  /** Initializes SPI0 with the closest clock not above @a clock_hz, in mode 0. */
+  explicit SPI(uint32_t clock_hz);
+  ~SPI();
+
+  /** Checks if the SPI is found and its DMA channels allocated. */
+  [[nodiscard]] bool is_initialized() const { return m_base != 0 && m_tx_channel; }
+
+  /** Writes the @a length bytes of @a data by polling, it waits for the pending DMA write first. */
+  void write(const uint8_t* data, size_t length);
+
+  /**
+   * Starts writing by DMA the @a length bytes following the DMA_HEADER_SIZE first bytes of @a buffer, which
+   * must stay alive (and pinned) until wait(). The bytes must be written back from the CPU caches already.
+   * It waits for the pending DMA write first.
+   */
+  void start_dma_write(Buffer& buffer, size_t length);
+  /** Waits for the pending DMA write, if any. */
+  void wait();
+
+ private:
+  uintptr_t m_base = 0;
+  uint32_t m_fifo_bus_address = 0;
+  libk::ScopedPointer<DMA::Channel> m_tx_channel;
+  libk::ScopedPointer<DMA::Channel> m_rx_channel;
+  libk::ScopedPointer<DMA::Request> m_tx_request;
+  libk::ScopedPointer<DMA::Request> m_rx_request;
+  bool m_is_dma_pending = false;
+};  // class SPI
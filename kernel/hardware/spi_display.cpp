@@ -0,0 +1,174 @@
+#include "hardware/spi_display.hpp"
+
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "graphics/pixel_format.hpp"
+#include "hardware/gpio.hpp"
+#include "hardware/timer.hpp"
+#include "memory/buffer.hpp"
+
+// The commands common to the ILI9341 and the ST7789 (see their datasheets).
+static constexpr uint8_t CMD_SWRESET = 0x01;  //<! Software Reset
+static constexpr uint8_t CMD_SLPOUT = 0x11;   //<! Sleep Out
+static constexpr uint8_t CMD_NORON = 0x13;    //<! Normal Display Mode On
+static constexpr uint8_t CMD_INVON = 0x21;    //<! Display Inversion On
+static constexpr uint8_t CMD_DISPON = 0x29;   //<! Display On
+static constexpr uint8_t CMD_CASET = 0x2a;    //<! Column Address Set
+static constexpr uint8_t CMD_RASET = 0x2b;    //<! Page (Row) Address Set
+static constexpr uint8_t CMD_RAMWR = 0x2c;    //<! Memory Write
+static constexpr uint8_t CMD_MADCTL = 0x36;   //<! Memory Access Control
+static constexpr uint8_t CMD_COLMOD = 0x3a;   //<! Pixel Format Set
+
+static constexpr uint8_t MADCTL_MX = 1 << 6;   // column address order
+static constexpr uint8_t MADCTL_MV = 1 << 5;   // row and column exchange
+static constexpr uint8_t MADCTL_BGR = 1 << 3;  // BGR order of the subpixels
+static constexpr uint8_t COLMOD_RGB565 = 0x55;
+
+/** The byte size of the pixels sent per DMA transfer (the two buffers are this big). */
+static constexpr size_t CHUNK_BYTE_SIZE = 32 * 1024;
+
+static void wait_ms(uint64_t ms) {
+  const uint64_t end = GenericTimer::get_elapsed_time_in_ms() + ms;
+  while (GenericTimer::get_elapsed_time_in_ms() < end)
+    libk::yield();
+}
+
+SpiDisplay::SpiDisplay(const Config& config) : m_config(config), m_spi(config.clock_hz) {}
+
+SpiDisplay::~SpiDisplay() {
+  if (m_spi.is_initialized())
+    m_spi.wait();
+}
+
+libk::ScopedPointer<SpiDisplay> SpiDisplay::create(const Config& config) {
+  libk::ScopedPointer<SpiDisplay> display(new SpiDisplay(config));
+  if (!display || !display->m_spi.is_initialized())
+    return nullptr;
+
+  for (auto& buffer : display->m_buffers) {
+    buffer.reset(new Buffer(SPI::DMA_HEADER_SIZE + CHUNK_BYTE_SIZE));
+    if (!buffer || buffer->get() == nullptr)
+      return nullptr;
+    buffer->pin();  // its DMA address is read at each transfer
+  }
+
+  GPIO::set_mode(config.dc_pin, GPIO::Mode::OUTPUT);
+  GPIO::set_mode(config.reset_pin, GPIO::Mode::OUTPUT);
+  GPIO::write_mask(0, 1ull << config.reset_pin);
+  wait_ms(10);
+  GPIO::write_mask(1ull << config.reset_pin, 0);
+  wait_ms(120);
+
+  display->send_command(CMD_SWRESET);
+  wait_ms(150);
+  display->send_command(CMD_SLPOUT);
+  wait_ms(120);
+
+  const uint8_t colmod = COLMOD_RGB565;
+  display->send_command(CMD_COLMOD, &colmod, 1);
+
+  // Both controllers are portrait (240 columns), the landscape panels exchange the rows and the columns.
+  const bool is_landscape = config.width > config.height;
+  uint8_t madctl;
+  if (config.controller == Controller::ILI9341) {
+    madctl = MADCTL_BGR | (is_landscape ? MADCTL_MV : MADCTL_MX);
+  } else {
+    madctl = is_landscape ? (MADCTL_MV | MADCTL_MX) : 0;
+    display->send_command(CMD_INVON);  // the ST7789 panels are inverted
+  }
+  display->send_command(CMD_MADCTL, &madctl, 1);
+
+  display->send_command(CMD_NORON);
+  display->send_command(CMD_DISPON);
+  wait_ms(20);
+
+  LOG_INFO("SPI display of {}x{} pixels initialized", config.width, config.height);
+  return display;
+}
+
+void SpiDisplay::send_command(uint8_t command, const uint8_t* parameters, size_t count) {
+  GPIO::write_mask(0, 1ull << m_config.dc_pin);
+  m_spi.write(&command, 1);
+
+  if (count > 0) {
+    GPIO::write_mask(1ull << m_config.dc_pin, 0);
+    m_spi.write(parameters, count);
+  }
+}
+
+void SpiDisplay::set_address_window(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  // The start and end addresses are inclusive and big-endian.
+  const uint32_t x1 = x + m_config.x_offset;
+  const uint32_t x2 = x1 + width - 1;
+  const uint32_t y1 = y + m_config.y_offset;
+  const uint32_t y2 = y1 + height - 1;
+  const uint8_t columns[] = {(uint8_t)(x1 >> 8), (uint8_t)x1, (uint8_t)(x2 >> 8), (uint8_t)x2};
+  const uint8_t pages[] = {(uint8_t)(y1 >> 8), (uint8_t)y1, (uint8_t)(y2 >> 8), (uint8_t)y2};
+  send_command(CMD_CASET, columns, sizeof(columns));
+  send_command(CMD_RASET, pages, sizeof(pages));
+  send_command(CMD_RAMWR);
+}
+
+template <class Pixel>
+void SpiDisplay::write_rect_impl(const Pixel* pixels,
+                                 size_t pitch,
+                                 uint32_t x,
+                                 uint32_t y,
+                                 uint32_t width,
+                                 uint32_t height) {
+  if (x >= m_config.width || y >= m_config.height)
+    return;
+
+  width = libk::min(width, m_config.width - x);
+  height = libk::min(height, m_config.height - y);
+  if (width == 0 || height == 0)
+    return;
+
+  // The commands are polled, after the previous rectangle. Then the memory write goes on through the chunks.
+  set_address_window(x, y, width, height);
+  GPIO::write_mask(1ull << m_config.dc_pin, 0);
+
+  const uint32_t rows_per_chunk = libk::max<uint32_t>(1, CHUNK_BYTE_SIZE / (sizeof(uint16_t) * width));
+  for (uint32_t chunk_y = 0; chunk_y < height; chunk_y += rows_per_chunk) {
+    const uint32_t chunk_height = libk::min(rows_per_chunk, height - chunk_y);
+    Buffer& buffer = *m_buffers[m_next_buffer];
+    m_next_buffer = (m_next_buffer + 1) % 2;
+
+    // This buffer was sent two chunks ago, the previous chunk may still be sent meanwhile.
+    auto* dst = (uint16_t*)((uint8_t*)buffer.get() + SPI::DMA_HEADER_SIZE);
+    for (uint32_t j = 0; j < chunk_height; ++j) {
+      const Pixel* src = pixels + x + pitch * (y + chunk_y + j);
+      for (uint32_t i = 0; i < width; ++i) {
+        uint16_t rgb565;
+        if constexpr (sizeof(Pixel) == sizeof(uint32_t)) {
+          rgb565 = graphics::PixelFormatRgb565::from_argb(src[i]);
+        } else {
+          rgb565 = src[i];
+        }
+        *dst++ = __builtin_bswap16(rgb565);  // the panel reads the most significant byte first
+      }
+    }
+
+    const size_t byte_size = sizeof(uint16_t) * width * chunk_height;
+    buffer.clean(SPI::DMA_HEADER_SIZE, byte_size);
+    m_spi.start_dma_write(buffer, byte_size);
+  }
+}
+
+void SpiDisplay::write_rect(const uint32_t* pixels,
+                            size_t pitch,
+                            uint32_t x,
+                            uint32_t y,
+                            uint32_t width,
+                            uint32_t height) {
+  write_rect_impl(pixels, pitch, x, y, width, height);
+}
+
+void SpiDisplay::write_rect(const uint16_t* pixels,
+                            size_t pitch,
+                            uint32_t x,
+                            uint32_t y,
+                            uint32_t width,
+                            uint32_t height) {
+  write_rect_impl(pixels, pitch, x, y, width, height);
+}
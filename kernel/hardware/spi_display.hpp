@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+
+#include "hardware/spi.hpp"
+
+/**
+ * A small TFT panel (ILI9341 or ST7789 controller) on SPI0, the screen of the units without HDMI.
+ *
+ * The panel has its own memory: only the rectangles written by write_rect() are sent, through the column and page
+ * address window of the controller. Their pixels are converted to big-endian RGB565 on the fly, by chunks of rows
+ * into two DMA buffers in turn: a chunk is converted while the previous one is sent.
+ */
+class SpiDisplay {
+ public:
+  enum class Controller : uint8_t {
+    ILI9341,
+    ST7789,
+  };
+
+  struct Config {
+    Controller controller;
+    uint16_t width;  // in the orientation of the panel, it is landscape if width > height
+    uint16_t height;
+    // The offsets of the visible area in the controller memory (some ST7789 panels are smaller than it).
+    uint16_t x_offset;
+    uint16_t y_offset;
+    uint8_t dc_pin;     // the GPIO pin selecting between command (low) and data (high)
+    uint8_t reset_pin;  // the GPIO pin of the hardware reset (active low)
+    uint32_t clock_hz;
+  };  // struct Config
+
+  ~SpiDisplay();
+
+  /** Resets and initializes the panel, returns nullptr if the SPI or the memory is unavailable. */
+  [[nodiscard]] static libk::ScopedPointer<SpiDisplay> create(const Config& config);
+
+  [[nodiscard]] uint32_t get_width() const { return m_config.width; }
+  [[nodiscard]] uint32_t get_height() const { return m_config.height; }
+
+  /** Sends the @a width x @a height pixels at (@a x, @a y) of @a pixels (whose rows are @a pitch pixels long, in
+   * XRGB8888 or RGB565). The last chunk is still being sent when this returns, see wait(). */
+  void write_rect(const uint32_t* pixels, size_t pitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+  void write_rect(const uint16_t* pixels, size_t pitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+  /** Waits for the last chunk sent. */
+  void wait() { m_spi.wait(); }
+
+ private:
+  explicit SpiDisplay(const Config& config);
+
+  void send_command(uint8_t command, const uint8_t* parameters = nullptr, size_t count = 0);
+  void set_address_window(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+  template <class Pixel>
+  void write_rect_impl(const Pixel* pixels, size_t pitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+  Config m_config;
+  SPI m_spi;
+  libk::ScopedPointer<Buffer> m_buffers[2];
+  size_t m_next_buffer = 0;
+};  // class SpiDisplay
@@ -0,0 +1,218 @@
+#include "spin_lock.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+
+#include "hardware/irq_save.hpp"
+
+template <class T>
+static inline T load(const T& var) {
+  return __atomic_load_n(&var, __ATOMIC_SEQ_CST);
+}
+
+template <class T>
+static inline void store(T& var, T value) {
+  __atomic_store_n(&var, value, __ATOMIC_SEQ_CST);
+}
+
+void BakeryLock::lock() {
+  const size_t core_id = SMP::get_core_id();
+
+  // Take a ticket greater than all the others.
+  store(m_choosing[core_id], true);
+  uint64_t max_ticket = 0;
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    max_ticket = libk::max(max_ticket, load(m_ticket[i]));
+  }
+
+  const uint64_t ticket = max_ticket + 1;
+  store(m_ticket[core_id], ticket);
+  store(m_choosing[core_id], false);
+
+  // Wait for all cores with a smaller ticket (ties are broken by the core id).
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if (i == core_id)
+      continue;
+
+    while (load(m_choosing[i])) {
+      libk::yield();
+    }
+
+    while (true) {
+      const uint64_t other_ticket = load(m_ticket[i]);
+      if (other_ticket == 0 || other_ticket > ticket || (other_ticket == ticket && i > core_id))
+        break;
+
+      libk::yield();
+    }
+  }
+}
+
+void BakeryLock::unlock() {
+  store(m_ticket[SMP::get_core_id()], (uint64_t)0);
+}
+
+#ifdef CONFIG_LOCKDEP
+/**
+ * The lock order validator.
+ *
+ * Each spin lock gets an id on its first acquisition. The bit b of g_taken_after[a] is set once the
+ * lock b was taken while holding (directly or through other locks) the lock a. Taking a while holding b
+ * is then an inversion that may deadlock, even if it never did so far, and the kernel panics.
+ */
+struct Lockdep {
+  static constexpr uint32_t MAX_LOCKS = 64;  // the ids fit in the bits of a uint64_t
+  static constexpr size_t MAX_HELD_LOCKS = 8;
+
+  struct HeldLocks {
+    const SpinLock* locks[MAX_HELD_LOCKS];
+    size_t count = 0;
+  };  // struct HeldLocks
+
+  static void before_acquire(SpinLock& lock);
+  static void after_release(const SpinLock& lock);
+  static const char* get_name(const SpinLock& lock) { return lock.m_name != nullptr ? lock.m_name : "unnamed"; }
+};  // struct Lockdep
+
+static BakeryLock g_lockdep_lock;  // protects the order graph below
+static uint64_t g_taken_after[Lockdep::MAX_LOCKS] = {};
+static uint32_t g_next_lockdep_id = 1;  // 0 means no id (yet)
+static PerCore<Lockdep::HeldLocks> g_held_locks;
+
+void Lockdep::before_acquire(SpinLock& lock) {
+  auto& held_locks = g_held_locks.get();
+
+  g_lockdep_lock.lock();
+  if (lock.m_lockdep_id == 0 && g_next_lockdep_id < MAX_LOCKS)
+    lock.m_lockdep_id = g_next_lockdep_id++;
+
+  const uint32_t id = lock.m_lockdep_id;
+  for (size_t i = 0; i < held_locks.count; ++i) {
+    const SpinLock& held_lock = *held_locks.locks[i];
+    const uint32_t held_id = held_lock.m_lockdep_id;
+    if (id == 0 || held_id == 0)
+      continue;  // out of ids, these locks are not checked
+
+    if ((g_taken_after[id] & (1ull << held_id)) != 0) {
+      g_lockdep_lock.unlock();
+      LOG_CRITICAL("Lockdep: {} taken while holding {}, the opposite order was seen before", get_name(lock),
+                   get_name(held_lock));
+    }
+
+    // Record held_lock -> lock, and everything taken after lock, for all locks that come before held_lock.
+    const uint64_t new_edges = (1ull << id) | g_taken_after[id];
+    for (uint32_t j = 1; j < MAX_LOCKS; ++j) {
+      if (j == held_id || (g_taken_after[j] & (1ull << held_id)) != 0)
+        g_taken_after[j] |= new_edges;
+    }
+  }
+  g_lockdep_lock.unlock();
+
+  KASSERT(held_locks.count < MAX_HELD_LOCKS && "too many spin locks held");
+  held_locks.locks[held_locks.count++] = &lock;
+}
+
+void Lockdep::after_release(const SpinLock& lock) {
+  // The locks are usually released in the reverse order.
+  auto& held_locks = g_held_locks.get();
+  for (size_t i = held_locks.count; i > 0; --i) {
+    if (held_locks.locks[i - 1] != &lock)
+      continue;
+
+    for (size_t j = i; j < held_locks.count; ++j)
+      held_locks.locks[j - 1] = held_locks.locks[j];
+    held_locks.count--;
+    return;
+  }
+
+  KASSERT(false && "released a spin lock that was not held");
+}
+#endif  // CONFIG_LOCKDEP
+
+void SpinLock::acquire() {
+  const uint64_t daif = IRQSave::mask_irqs();
+  KASSERT(!is_owned() && "spin locks are not recursive");
+
+#ifdef CONFIG_LOCKDEP
+  Lockdep::before_acquire(*this);
+#endif  // CONFIG_LOCKDEP
+
+  m_lock.lock();
+  store(m_owner, SMP::get_core_id());
+  m_saved_daif = daif;
+}
+
+void SpinLock::release() {
+  KASSERT(is_owned());
+
+  const uint64_t daif = m_saved_daif;
+  store(m_owner, NO_OWNER);
+  m_lock.unlock();
+
+#ifdef CONFIG_LOCKDEP
+  Lockdep::after_release(*this);
+#endif  // CONFIG_LOCKDEP
+
+  IRQSave::restore_irqs(daif);
+}
+
+bool SpinLock::is_owned() const {
+  return load(m_owner) == SMP::get_core_id();
+}
+
+void RWSpinLock::acquire_read() {
+  const uint64_t daif = IRQSave::mask_irqs();
+  auto& reader = m_readers.get();
+  if (reader.depth > 0) {
+    // Already reading: the writers are waiting for this core.
+    reader.depth++;
+    return;
+  }
+
+  // Announce the reader first, then check for a writer (the writer does the opposite).
+  while (true) {
+    store(reader.depth, 1u);
+    if (!load(m_writer_active))
+      break;
+
+    store(reader.depth, 0u);
+    while (load(m_writer_active)) {
+      libk::yield();
+    }
+  }
+
+  reader.saved_daif = daif;
+}
+
+void RWSpinLock::release_read() {
+  auto& reader = m_readers.get();
+  KASSERT(reader.depth > 0);
+
+  if (reader.depth > 1) {
+    reader.depth--;
+    return;
+  }
+
+  const uint64_t daif = reader.saved_daif;
+  store(reader.depth, 0u);
+  IRQSave::restore_irqs(daif);
+}
+
+void RWSpinLock::acquire_write() {
+  m_writer_lock.acquire();
+  KASSERT(m_readers.get().depth == 0 && "the read lock can not be upgraded");
+
+  // Block the new readers, then wait for the current ones to leave.
+  store(m_writer_active, true);
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    while (load(m_readers.get(i).depth) != 0) {
+      libk::yield();
+    }
+  }
+}
+
+void RWSpinLock::release_write() {
+  store(m_writer_active, false);
+  m_writer_lock.release();
+}
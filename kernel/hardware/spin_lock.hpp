@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include "hardware/per_core.hpp"
+#include "hardware/smp.hpp"
+
+/**
+ * Lamport's bakery lock: mutual exclusion between the cores using only ordered loads and stores.
+ *
+ * Exclusive accesses (LDAXR/STLXR) are not guaranteed to work with the data cache disabled (see
+ * KernelLock), this is why there are no ticket or MCS locks. The lock is not recursive, does not know
+ * about IRQs and does not track its owner: prefer SpinLock.
+ */
+class BakeryLock {
+ public:
+  void lock();
+  void unlock();
+
+ private:
+  // All accesses are sequentially consistent (LDAR/STLR), as required by the bakery algorithm.
+  bool m_choosing[SMP::MAX_CORES] = {};
+  uint64_t m_ticket[SMP::MAX_CORES] = {};
+};  // class BakeryLock
+
+/**
+ * A spin lock protecting data shared between the cores and with the IRQ handlers.
+ *
+ * The IRQs of the owner core are masked while it holds the lock, so an IRQ handler taking the same
+ * lock can not deadlock against the code it interrupted. The lock is not recursive. With CONFIG_LOCKDEP,
+ * the order in which the spin locks are taken is checked, see spin_lock.cpp.
+ */
+class SpinLock {
+ public:
+  /** @a name is only used by the lock order validator messages. */
+  explicit SpinLock(const char* name = nullptr) : m_name(name) {}
+
+  void acquire();
+  void release();
+
+  /** @brief Checks if the calling core owns the lock. */
+  [[nodiscard]] bool is_owned() const;
+
+ private:
+  friend class RWSpinLock;
+  friend struct Lockdep;
+
+  static constexpr size_t NO_OWNER = SMP::MAX_CORES;
+
+  BakeryLock m_lock;
+  size_t m_owner = NO_OWNER;
+  uint64_t m_saved_daif = 0;  // the IRQs mask of the owner before acquire()
+  const char* m_name;
+#ifdef CONFIG_LOCKDEP
+  uint32_t m_lockdep_id = 0;  // 0 until the first acquire()
+#endif  // CONFIG_LOCKDEP
+};  // class SpinLock
+
+/**
+ * A readers-writer spin lock, for data read by the cores far more often than it is written.
+ *
+ * Readers only write to their core own counter, so they never wait for each other. A writer waits for
+ * the readers to leave, and the new readers wait for it. As for SpinLock, the IRQs are masked while the
+ * lock is held. A core may take the read lock several times, but must not take the write lock while
+ * holding the read lock.
+ */
+class RWSpinLock {
+ public:
+  explicit RWSpinLock(const char* name = nullptr) : m_writer_lock(name) {}
+
+  void acquire_read();
+  void release_read();
+
+  void acquire_write();
+  void release_write();
+
+ private:
+  struct Reader {
+    uint32_t depth = 0;  // only written by its core
+    uint64_t saved_daif = 0;
+  };  // struct Reader
+
+  SpinLock m_writer_lock;  // serializes the writers
+  bool m_writer_active = false;
+  PerCore<Reader> m_readers;
+};  // class RWSpinLock
+
+/** RAII helper around SpinLock::acquire() and SpinLock::release(). */
+class SpinLockGuard {
+ public:
+  explicit SpinLockGuard(SpinLock& lock) : m_lock(lock) { m_lock.acquire(); }
+  ~SpinLockGuard() { m_lock.release(); }
+
+  // No copy and move
+  SpinLockGuard(const SpinLockGuard&) = delete;
+  SpinLockGuard(SpinLockGuard&&) = delete;
+  SpinLockGuard& operator=(const SpinLockGuard&) = delete;
+  SpinLockGuard& operator=(SpinLockGuard&&) = delete;
+
+ private:
+  SpinLock& m_lock;
+};  // class SpinLockGuard
+
+/** RAII helper around RWSpinLock::acquire_read() and RWSpinLock::release_read(). */
+class ReadLockGuard {
+ public:
+  explicit ReadLockGuard(RWSpinLock& lock) : m_lock(lock) { m_lock.acquire_read(); }
+  ~ReadLockGuard() { m_lock.release_read(); }
+
+  // No copy and move
+  ReadLockGuard(const ReadLockGuard&) = delete;
+  ReadLockGuard(ReadLockGuard&&) = delete;
+  ReadLockGuard& operator=(const ReadLockGuard&) = delete;
+  ReadLockGuard& operator=(ReadLockGuard&&) = delete;
+
+ private:
+  RWSpinLock& m_lock;
+};  // class ReadLockGuard
+
+/** RAII helper around RWSpinLock::acquire_write() and RWSpinLock::release_write(). */
+class WriteLockGuard {
+ public:
+  explicit WriteLockGuard(RWSpinLock& lock) : m_lock(lock) { m_lock.acquire_write(); }
+  ~WriteLockGuard() { m_lock.release_write(); }
+
+  // No copy and move
+  WriteLockGuard(const WriteLockGuard&) = delete;
+  WriteLockGuard(WriteLockGuard&&) = delete;
+  WriteLockGuard& operator=(const WriteLockGuard&) = delete;
+  WriteLockGuard& operator=(WriteLockGuard&&) = delete;
+
+ private:
+  RWSpinLock& m_lock;
+};  // class WriteLockGuard
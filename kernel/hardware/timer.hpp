@@ -30,4 +30,23 @@ class GenericTimer {
   [[nodiscard]] static inline uint64_t get_elapsed_time_in_ms() { return (get_tick_count() * 1'000) / get_frequency(); }
   /** @brief Returns elapsed time (in seconds) since boot. */
   [[nodiscard]] static inline uint64_t get_elapsed_time_in_s() { return get_tick_count() / get_frequency(); }
+
+  /** @brief Arms the EL1 physical timer of the calling core to fire once in @a ticks ticks. */
+  static inline void arm_physical_timer(uint64_t ticks) {
+    asm volatile("msr CNTP_TVAL_EL0, %0" : : "r"(ticks));
+    asm volatile("msr CNTP_CTL_EL0, %0" : : "r"(1ull));  // ENABLE=1, IMASK=0
+  }
+
+  /** @brief Disables the EL1 physical timer of the calling core. */
+  static inline void disarm_physical_timer() { asm volatile("msr CNTP_CTL_EL0, xzr"); }
+
+  /** @brief Arms the virtual timer of the calling core to fire once the tick count reaches @a deadline.
+   * The virtual count is the physical one (CNTVOFF_EL2 is zeroed when entering EL1), see get_tick_count(). */
+  static inline void arm_virtual_timer_at(uint64_t deadline) {
+    asm volatile("msr CNTV_CVAL_EL0, %0" : : "r"(deadline));
+    asm volatile("msr CNTV_CTL_EL0, %0" : : "r"(1ull));  // ENABLE=1, IMASK=0
+  }
+
+  /** @brief Disables the virtual timer of the calling core. */
+  static inline void disarm_virtual_timer() { asm volatile("msr CNTV_CTL_EL0, xzr"); }
 };  // class GenericTimer
@@ -1,8 +1,12 @@
 #include "hardware/uart.hpp"
 
+#include <libk/string.hpp>
 #include <libk/utils.hpp>
 #include "device.hpp"
 #include "hardware/gpio.hpp"
+#include "hardware/irq/irq_lists.hpp"
+#include "hardware/irq/irq_manager.hpp"
+#include "hardware/kernel_lock.hpp"
 #include "hardware/mailbox.hpp"
 #include "kernel_dt.hpp"
 
@@ -25,7 +29,7 @@ static inline constexpr int UART_LCRH = 0x2c;
 static inline constexpr int UART_CR = 0x30;
 
 /** UART Interrupt FIFO Level Select Register (size: 32) */
-// static inline constexpr int UART_IFLS = 0x34;
+static inline constexpr int UART_IFLS = 0x34;
 
 /** UART Interrupt Mask Set Clear Register (size: 32) */
 static inline constexpr int UART_IMSC = 0x38;
@@ -34,10 +38,10 @@ static inline constexpr int UART_IMSC = 0x38;
 // static inline constexpr int UART_RIS = 0x3c;
 
 /** UART Masked Interrupt Status Register (size: 32) */
-// static inline constexpr int UART_MIS = 0x40;
+static inline constexpr int UART_MIS = 0x40;
 
 /** UART Interrupt Clear Register (size: 32) */
-// static inline constexpr int UART_ICR = 0x44;
+static inline constexpr int UART_ICR = 0x44;
 
 /** UART DMA Control Register (size: 32) */
 // static inline constexpr int UART_DMACR = 0x48;
@@ -54,10 +58,38 @@ static inline constexpr int UART_IMSC = 0x38;
 /** UART Test Data Register (size: 32) */
 // static inline constexpr int UART_TDR = 0x8c;
 
+/** Receive interrupt (the RX FIFO reached its level, see UART_IFLS). */
+static inline constexpr uint32_t UART_INT_RX = 1 << 4;
+/** Transmit interrupt (the TX FIFO went down to its level, see UART_IFLS). */
+static inline constexpr uint32_t UART_INT_TX = 1 << 5;
+/** Receive timeout interrupt (the RX FIFO is not empty and nothing was received for 32 bits). */
+static inline constexpr uint32_t UART_INT_RT = 1 << 6;
+
+/** UART_IFLS: interrupt when the TX FIFO is 1/8 full, and when the RX FIFO is 1/2 full. */
+static inline constexpr uint32_t UART_FIFO_LEVELS = (0b000 << 0) | (0b010 << 3);
+
+struct UART::Buffers {
+  // The rings are only accessed with the kernel lock held, by the UART user and the IRQ handler.
+  char rx[RX_BUFFER_SIZE];
+  size_t rx_head = 0;
+  size_t rx_tail = 0;
+  char tx[TX_BUFFER_SIZE];
+  size_t tx_head = 0;
+  size_t tx_tail = 0;
+
+  ReceiveCallback receive_callback = nullptr;
+  void* receive_handle = nullptr;
+};  // struct UART::Buffers
+
+static_assert((UART::RX_BUFFER_SIZE & (UART::RX_BUFFER_SIZE - 1)) == 0, "the size must be a power of two");
+static_assert((UART::TX_BUFFER_SIZE & (UART::TX_BUFFER_SIZE - 1)) == 0, "the size must be a power of two");
+
 UART::UART(uint32_t baud_rate, libk::StringView name, bool enabling_irqs)
-    : _uart_base(KernelDT::force_get_device_address(name)) {
-  // We don't yet support IRQs for UART1 (UART1 is a bit different from the others).
-  KASSERT(!enabling_irqs || name != "uart1");
+    : _uart_base(KernelDT::force_get_device_address(name)), _buffers(enabling_irqs ? new Buffers : nullptr) {
+  // We don't yet support IRQs for UART1 (UART1 is a bit different from the others), and only the IRQ of
+  // UART0 is wired.
+  KASSERT(!enabling_irqs || name == "uart0");
+  KASSERT(!enabling_irqs || _buffers != nullptr);
 
   // Get the UART Clock
   uint32_t uart_clock = Device::get_clock_rate(Device::UART);
@@ -84,9 +116,79 @@ UART::UART(uint32_t baud_rate, libk::StringView name, bool enabling_irqs)
   libk::write32(_uart_base + UART_CR, (1 << 0) | (1 << 8) | (1 << 9));
 
   if (enabling_irqs) {
-    // Enable IRQs
-    libk::write32(_uart_base + UART_IMSC, (1 << 1) | (1 << 4));
+    // Enable the RX IRQs, the TX IRQ is only enabled while there are bytes to transmit.
+    libk::write32(_uart_base + UART_IFLS, UART_FIFO_LEVELS);
+    libk::write32(_uart_base + UART_ICR, 0x7FF);
+    libk::write32(_uart_base + UART_IMSC, UART_INT_RX | UART_INT_RT);
+    IRQManager::register_irq_handler(VC_UART, &UART::handle_irq, this);
+  }
+}
+
+UART::~UART() {
+  if (_buffers != nullptr) {
+    libk::write32(_uart_base + UART_IMSC, 0);
+    IRQManager::unregister_irq_handle(VC_UART, nullptr, nullptr);
+    delete _buffers;
+  }
+}
+
+void UART::handle_irq(void* handle) {
+  auto* uart = (UART*)handle;
+  Buffers* buffers = uart->_buffers;
+  const uint32_t status = libk::read32(uart->_uart_base + UART_MIS);
+  libk::write32(uart->_uart_base + UART_ICR, status & (UART_INT_RX | UART_INT_TX | UART_INT_RT));
+
+  if ((status & (UART_INT_RX | UART_INT_RT)) != 0) {
+    bool has_received = false;
+    while (!uart->is_fifo_empty()) {
+      const char value = (char)libk::read32(uart->_uart_base + UART_DR);
+      // The bytes received while the ring is full are dropped.
+      if (buffers->rx_head - buffers->rx_tail < RX_BUFFER_SIZE) {
+        buffers->rx[buffers->rx_head++ % RX_BUFFER_SIZE] = value;
+        has_received = true;
+      }
+    }
+
+    if (has_received && buffers->receive_callback != nullptr)
+      buffers->receive_callback(uart, buffers->receive_handle);
+  }
+
+  if ((status & UART_INT_TX) != 0)
+    uart->fill_tx_fifo();
+}
+
+void UART::fill_tx_fifo() const {
+  while (_buffers->tx_tail != _buffers->tx_head && !is_fifo_full()) {
+    libk::write32(_uart_base + UART_DR, _buffers->tx[_buffers->tx_tail++ % TX_BUFFER_SIZE]);
   }
+
+  // The TX IRQ is raised when the FIFO goes down to its level, only ask for it if there is more to send.
+  uint32_t mask = libk::read32(_uart_base + UART_IMSC);
+  if (_buffers->tx_tail == _buffers->tx_head) {
+    mask &= ~UART_INT_TX;
+  } else {
+    mask |= UART_INT_TX;
+  }
+
+  libk::write32(_uart_base + UART_IMSC, mask);
+}
+
+void UART::set_receive_callback(ReceiveCallback callback, void* handle) {
+  KASSERT(_buffers != nullptr);
+  _buffers->receive_callback = callback;
+  _buffers->receive_handle = handle;
+}
+
+size_t UART::read_available(char* buffer, size_t buffer_length) const {
+  KASSERT(_buffers != nullptr);
+  KASSERT(KernelLock::is_owned());
+
+  size_t count = 0;
+  for (; count < buffer_length && _buffers->rx_tail != _buffers->rx_head; ++count) {
+    buffer[count] = _buffers->rx[_buffers->rx_tail++ % RX_BUFFER_SIZE];
+  }
+
+  return count;
 }
 
 bool UART::is_fifo_empty() const {
@@ -98,7 +200,14 @@ bool UART::is_fifo_full() const {
 }
 
 void UART::write_one(char value) const {
-  // Wait for UART to become ready to transmit.
+  if (_buffers != nullptr) {
+    write(&value, 1);
+    return;
+  }
+
+  // Wait for UART to become ready to transmit. This is called from the logger, so we
+  // can not block here: the wait is bounded by a few character times at the configured
+  // baud rate.
   while (is_fifo_full()) {
     libk::yield();
   }
@@ -107,6 +216,9 @@ void UART::write_one(char value) const {
 }
 
 char UART::read_one() const {
+  // The received bytes go to the RX ring, see read_available().
+  KASSERT(_buffers == nullptr);
+
   // Wait for UART to have received something.
   while (is_fifo_empty()) {
     libk::yield();
@@ -116,11 +228,42 @@ char UART::read_one() const {
 }
 
 void UART::write(const char* buffer, size_t buffer_length) const {
+  if (_buffers != nullptr) {
+    KASSERT(KernelLock::is_owned());
+
+    for (size_t i = 0; i < buffer_length; i++) {
+      // The ring is full, wait for the FIFO to make room (the TX IRQ may be handled by this core).
+      while (_buffers->tx_head - _buffers->tx_tail == TX_BUFFER_SIZE) {
+        fill_tx_fifo();
+        libk::yield();
+      }
+
+      _buffers->tx[_buffers->tx_head++ % TX_BUFFER_SIZE] = buffer[i];
+    }
+
+    fill_tx_fifo();
+    return;
+  }
+
   for (size_t i = 0; i < buffer_length; i++) {
     write_one(buffer[i]);
   }
 }
 
+size_t UART::write_available(const char* buffer, size_t buffer_length) const {
+  KASSERT(_buffers != nullptr);
+  KASSERT(KernelLock::is_owned());
+
+  size_t count = 0;
+  for (; count < buffer_length && _buffers->tx_head - _buffers->tx_tail < TX_BUFFER_SIZE; ++count) {
+    _buffers->tx[_buffers->tx_head++ % TX_BUFFER_SIZE] = buffer[count];
+  }
+
+  if (count > 0)
+    fill_tx_fifo();
+  return count;
+}
+
 void UART::read(char* buffer, size_t buffer_length) const {
   for (size_t i = 0; i < buffer_length; i++) {
     buffer[i] = read_one();
@@ -128,10 +271,7 @@ void UART::read(char* buffer, size_t buffer_length) const {
 }
 
 void UART::puts(const char* buffer) const {
-  const char* it = buffer;
-  while (*it != '\0') {
-    write_one((uint8_t)*it++);
-  }
+  write(buffer, libk::strlen(buffer));
 }
 
 void UART::writeln(const char* buffer, size_t buffer_length) {
@@ -6,6 +6,15 @@
 
 class UART : public libk::Logger {
  public:
+  /** Size of the ring buffer of the received bytes (only with IRQs enabled). */
+  static constexpr size_t RX_BUFFER_SIZE = 256;
+  /** Size of the ring buffer of the bytes to transmit (only with IRQs enabled). It lasts a frame at 2 Mbaud, so a
+   * stream refilled at each frame (see ScreenStream) keeps the line busy. */
+  static constexpr size_t TX_BUFFER_SIZE = 4096;
+
+  /** Called from the UART IRQ handler when bytes were received, see read_available(). */
+  using ReceiveCallback = void (*)(UART* uart, void* handle);
+
   /** Initializes the PL011 UART0 channel.
    * Accepted baud_rate :
    *  - 300     [Tested]
@@ -23,8 +32,19 @@ class UART : public libk::Logger {
    *  - 1000000 [Tested]
    *  - 1500000 [Tested]
    *  - 2000000 [Tested]
+   *
+   * With @a enabling_irqs, the UART FIFOs are filled and drained by the UART IRQ handler through ring
+   * buffers: the writes return as soon as the bytes are queued, and the received bytes are read with
+   * read_available(). Then, the kernel lock must be held to use the UART.
    */
   explicit UART(uint32_t baud_rate, libk::StringView name = "uart0", bool enabling_irqs = false);
+  ~UART();
+
+  // No copy and move
+  UART(const UART&) = delete;
+  UART(UART&&) = delete;
+  UART& operator=(const UART&) = delete;
+  UART& operator=(UART&&) = delete;
 
   /** Returns true if the UART FIFO is empty (aka cannot read anymore from it). */
   [[nodiscard]] bool is_fifo_empty() const;
@@ -33,17 +53,29 @@ class UART : public libk::Logger {
 
   /** Writes the given @a value into this UART. */
   void write_one(char value) const;
-  /** Reads a single byte from this UART. */
+  /** Reads a single byte from this UART, waiting for it. Not supported with IRQs enabled. */
   char read_one() const;
 
+  /** Reads at most @a buffer_length of the bytes already received into @a buffer, without waiting.
+   * Returns the count of bytes read. Only supported with IRQs enabled. */
+  size_t read_available(char* buffer, size_t buffer_length) const;
+
+  /** Sets the function called when bytes are received (only with IRQs enabled). */
+  void set_receive_callback(ReceiveCallback callback, void* handle);
+
   /** Writes the given @a buffer of length @a buffer_length into this UART. */
   void write(const char* buffer, size_t buffer_length) const;
 
+  /** Writes at most @a buffer_length bytes of @a buffer, as many as the TX ring has room for, without waiting.
+   * Returns the count of bytes written. Only supported with IRQs enabled. */
+  size_t write_available(const char* buffer, size_t buffer_length) const;
+
   /** Writes the given @a buffer of length @a buffer_length into this UART.
    * This function add a newline after the buffer end */
   void writeln(const char* buffer, size_t buffer_length);
 
-  /** Reads the requested @a buffer_length count of bytes into @a buffer from this UART. */
+  /** Reads the requested @a buffer_length count of bytes into @a buffer from this UART.
+   * Not supported with IRQs enabled. */
   void read(char* buffer, size_t buffer_length) const;
 
   /** Same as write() but takes a C NUL-terminated string.
@@ -53,5 +85,12 @@ class UART : public libk::Logger {
   bool support_colors() const { return true; }
 
  private:
+  static void handle_irq(void* handle);
+  /** Moves the bytes of the TX ring buffer into the TX FIFO, until it is full. */
+  void fill_tx_fifo() const;
+
+  struct Buffers;
+
   const uintptr_t _uart_base;
+  Buffers* const _buffers;
 };
@@ -1,70 +1,104 @@
 #include "uart_keyboard.hpp"
-#include "hardware/irq/irq_lists.hpp"
-#include "hardware/irq/irq_manager.hpp"
 #include "input/keyboard_input.hpp"
 #include "input/mouse_input.hpp"
+#include "task/task_manager.hpp"
+#include "timer.hpp"
+#include "wm/window_manager.hpp"
 
 namespace UARTKeyboard {
 UART* keyboard_uart = nullptr;
 
-void init(UART* uart) {
-  KASSERT(uart != nullptr);
-  keyboard_uart = uart;
+/** The longest packet: a header and two bytes of payload. */
+static constexpr size_t MAX_PACKET_SIZE = 3;
 
-  IRQManager::register_irq_handler(
-      VC_UART,
-      [](void*) {
-        if (keyboard_uart->is_fifo_empty())
-          return;
+/** The packet being received, it may be split across several UART IRQs. */
+static uint8_t g_packet[MAX_PACKET_SIZE];
+static size_t g_packet_size = 0;
 
-        uint8_t header = (uint8_t)keyboard_uart->read_one();
+/** Is decode_packets() already queued? */
+static bool g_is_decode_queued = false;
+/** The tick count of the IRQ that queued decode_packets(), the timestamp of all the events it decodes. */
+static uint64_t g_receive_timestamp = 0;
 
-        switch (header & 0xF) {
-          case 0x1:  // mouse move
-          {
-            uint8_t dx_mag = (uint8_t)keyboard_uart->read_one();
-            uint8_t dy_mag = (uint8_t)keyboard_uart->read_one();
+/** Returns the size of the packet, header included, starting with @a header. */
+static size_t get_packet_size(uint8_t header) {
+  switch (header & 0xF) {
+    case 0x1:  // mouse move
+    case 0x3:  // mouse scroll
+    case 0x4:  // key press/release
+      return 3;
+    case 0x2:  // mouse click
+      return 2;
+    case 0x5:  // screen stream key frame request
+      return 1;
+    default:  // unknown, skip the header
+      return 1;
+  }
+}
 
-            int16_t dx = dx_mag;
-            int16_t dy = dy_mag;
+static void handle_packet(const uint8_t* packet, uint64_t timestamp) {
+  const uint8_t header = packet[0];
 
-            if ((header & (1 << 4)) != 0)
-              dx = -dx;
-            if ((header & (1 << 5)) != 0)
-              dy = -dy;
+  switch (header & 0xF) {
+    case 0x1:  // mouse move
+    case 0x3:  // mouse scroll
+    {
+      int16_t dx = packet[1];
+      int16_t dy = packet[2];
 
-            MouseSystem::notify_hardware_move_event(dx, dy);
-          } break;
-          case 0x2:  // mouse click
-          {
-            uint8_t button = (uint8_t)keyboard_uart->read_one();
-          } break;
-          case 0x3:  // mouse scroll
-          {
-            uint8_t dx_mag = (uint8_t)keyboard_uart->read_one();
-            uint8_t dy_mag = (uint8_t)keyboard_uart->read_one();
+      if ((header & (1 << 4)) != 0)
+        dx = -dx;
+      if ((header & (1 << 5)) != 0)
+        dy = -dy;
 
-            int16_t dx = dx_mag;
-            int16_t dy = dy_mag;
+      if ((header & 0xF) == 0x1) {
+        MouseSystem::notify_hardware_move_event(dx, dy);
+      } else {
+        MouseSystem::notify_hardware_scroll_event(dx, dy);
+      }
+    } break;
+    case 0x2:  // mouse click (not supported yet)
+      break;
+    case 0x4:  // key press/release
+    {
+      const uint16_t key = packet[1] | (packet[2] << 8);
+      const bool is_pressed = (header & (1 << 4)) != 0;
+      KeyboardSystem::notify_hardware_event((sys_key_code_t)key, is_pressed, timestamp);
+    } break;
+    case 0x5:  // screen stream key frame request (the viewer started)
+      WindowManager::get().request_screen_key_frame();
+      break;
+  }
+}
 
-            if (header & (1 << 4) != 0)
-              dx = -dx;
-            if (header & (1 << 5) != 0)
-              dy = -dy;
+/** Decodes the packets received so far, the remaining bytes of a packet are waited for in later IRQs.
+ * Run by the IRQ work queue, as the events are dispatched to the window manager. */
+static void decode_packets(void*) {
+  g_is_decode_queued = false;
 
-            MouseSystem::notify_hardware_scroll_event(dx, dy);
-          } break;
-          case 0x4:  // key press/release
-          {
-            uint16_t key;
-            keyboard_uart->read((char*)&key, sizeof(key));
+  char buffer[UART::RX_BUFFER_SIZE];
+  const size_t length = keyboard_uart->read_available(buffer, sizeof(buffer));
+  for (size_t i = 0; i < length; ++i) {
+    g_packet[g_packet_size++] = (uint8_t)buffer[i];
+    if (g_packet_size == get_packet_size(g_packet[0])) {
+      handle_packet(g_packet, g_receive_timestamp);
+      g_packet_size = 0;
+    }
+  }
+}
 
-            bool is_pressed = (header & (1 << 4)) != 0;
-            KeyboardSystem::notify_hardware_event((sys_key_code_t)key, is_pressed);
-          } break;
-        }
-      },
-      nullptr);
+static void on_receive(UART*, void*) {
+  // The received bytes wait in the UART ring buffer meanwhile.
+  if (!g_is_decode_queued) {
+    g_receive_timestamp = GenericTimer::get_tick_count();
+    g_is_decode_queued = TaskManager::get().get_irq_work_queue().queue(&decode_packets, nullptr);
+  }
+}
+
+void init(UART* uart) {
+  KASSERT(uart != nullptr);
+  keyboard_uart = uart;
+  uart->set_receive_callback(&on_receive, nullptr);
 
   LOG_INFO("UART keyboard & mouse driver initialized");
 }
@@ -4,5 +4,6 @@
 #include "hardware/uart.hpp"
 
 namespace UARTKeyboard {
+/** Decodes the keyboard and mouse packets received by @a uart (IRQs enabled). Requires the task manager. */
 void init(UART* uart);
 }  // namespace UARTKeyboard
@@ -0,0 +1,71 @@
+#include "initcall.hpp"
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "hardware/timer.hpp"
+#include "sys/syscall.h"
+#include "task/sync.hpp"
+#include "task/task_manager.hpp"
+
+namespace Initcall {
+static const Descriptor* g_initcalls = nullptr;
+/** Completed once the step of the same index is done. */
+static Completion g_done[MAX_INITCALLS];
+
+static void wait_for(size_t index) {
+  while (true) {
+    bool is_blocked;
+    {
+      KernelTaskLockGuard kernel_lock;
+      is_blocked = g_done[index].wait_or_block(Task::current());
+    }
+
+    if (!is_blocked)
+      return;
+
+    // Awaken once the dependency is done, check it again.
+    sys_yield();
+  }
+}
+
+static void run(void* arg) {
+  const size_t index = (size_t)arg;
+  const Descriptor& initcall = g_initcalls[index];
+
+  for (size_t i = 0; i < index; ++i) {
+    if ((initcall.dependencies & after(i)) != 0)
+      wait_for(i);
+  }
+
+#ifdef CONFIG_BOOT_PROFILE
+  const uint64_t start_time = GenericTimer::get_elapsed_time_in_micros();
+#endif  // CONFIG_BOOT_PROFILE
+
+  {
+    KernelTaskLockGuard kernel_lock;
+    initcall.function();
+    g_done[index].complete();
+  }
+
+#ifdef CONFIG_BOOT_PROFILE
+  LOG_INFO("Boot step '{}' done in {} us", initcall.name, GenericTimer::get_elapsed_time_in_micros() - start_time);
+#endif  // CONFIG_BOOT_PROFILE
+}
+
+void start(const Descriptor* initcalls, size_t count) {
+  KASSERT(g_initcalls == nullptr && "the boot steps are already started");
+  KASSERT(count <= MAX_INITCALLS);
+
+  g_initcalls = initcalls;
+
+  TaskManager& task_manager = TaskManager::get();
+  for (size_t i = 0; i < count; ++i) {
+    // Only the steps before may be depended on, so the dependencies can not be cyclic.
+    KASSERT((initcalls[i].dependencies >> i) == 0 && "a boot step depends on a later one");
+
+    auto task = task_manager.create_kernel_task(&run, (void*)i);
+    KASSERT(task != nullptr);
+    task_manager.wake_task(task);
+  }
+}
+}  // namespace Initcall
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The boot steps run once the task manager is created, each one as a kernel task started as soon as the
+ * steps it depends on are done. Then, independent steps (mounting the file system, decoding the wallpaper,
+ * starting the init program...) no longer wait for each other as they did when run one after another.
+ *
+ * The steps run with the kernel lock held and the preemption disabled, as the other kernel tasks sharing
+ * the kernel state (the heap, the file system...). The other tasks run between the steps.
+ * With CONFIG_BOOT_PROFILE, the duration of each step is logged.
+ */
+namespace Initcall {
+/** The maximum count of steps, the dependencies being a bitmask. */
+static constexpr size_t MAX_INITCALLS = 32;
+
+using Function = void (*)();
+
+struct Descriptor {
+  const char* name;
+  Function function;
+  /** The steps to be done before this one, a bitmask of their indices in the table (see after()). */
+  uint32_t dependencies = 0;
+};  // struct Descriptor
+
+/** Returns the dependency on the step at @a index, to be or-ed with the other ones. */
+[[nodiscard]] constexpr uint32_t after(size_t index) {
+  return UINT32_C(1) << index;
+}
+
+/**
+ * Creates and wakes the kernel task of each of the @a count steps of @a initcalls, which must outlive
+ * them. A step may only depend on the steps before it in the table (so there is no cycle).
+ * Requires the task manager.
+ */
+void start(const Descriptor* initcalls, size_t count);
+
+template <size_t N>
+void start(const Descriptor (&initcalls)[N]) {
+  start(initcalls, N);
+}
+}  // namespace Initcall
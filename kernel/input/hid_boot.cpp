@@ -0,0 +1,113 @@
+#include "hid_boot.hpp"
+#include "input/keyboard_input.hpp"
+#include "input/mouse_input.hpp"
+
+namespace HIDBoot {
+// The key codes of the HID usages of the keyboard page, 0 if not supported (see HID Usage Tables, chapter 10).
+static constexpr uint16_t FIRST_USAGE = 0x04;
+static constexpr uint16_t g_usage_to_keycode[] = {
+    // From 0x04: a-z.
+    SYS_KEY_A, SYS_KEY_B, SYS_KEY_C, SYS_KEY_D, SYS_KEY_E, SYS_KEY_F, SYS_KEY_G, SYS_KEY_H, SYS_KEY_I, SYS_KEY_J,
+    SYS_KEY_K, SYS_KEY_L, SYS_KEY_M, SYS_KEY_N, SYS_KEY_O, SYS_KEY_P, SYS_KEY_Q, SYS_KEY_R, SYS_KEY_S, SYS_KEY_T,
+    SYS_KEY_U, SYS_KEY_V, SYS_KEY_W, SYS_KEY_X, SYS_KEY_Y, SYS_KEY_Z,
+    // From 0x1E: 1-9, 0.
+    SYS_KEY_1, SYS_KEY_2, SYS_KEY_3, SYS_KEY_4, SYS_KEY_5, SYS_KEY_6, SYS_KEY_7, SYS_KEY_8, SYS_KEY_9, SYS_KEY_0,
+    // From 0x28.
+    SYS_KEY_ENTER, SYS_KEY_ESCAPE, SYS_KEY_BACKSPACE, SYS_KEY_TAB, SYS_KEY_SPACE, SYS_KEY_MINUS, SYS_KEY_EQUAL,
+    SYS_KEY_OPEN_BRACKET, SYS_KEY_CLOSE_BRACKET, SYS_KEY_BACKSLASH,
+    // From 0x32: the non-US # is the backslash key of the US layout.
+    SYS_KEY_BACKSLASH, SYS_KEY_SEMI_COLON, SYS_KEY_APOSTROPHE, SYS_KEY_BACK_TICK, SYS_KEY_COMMA, SYS_KEY_DOT,
+    SYS_KEY_SLASH, SYS_KEY_CAPS_LOCK,
+    // From 0x3A: F1-F12.
+    SYS_KEY_F1, SYS_KEY_F2, SYS_KEY_F3, SYS_KEY_F4, SYS_KEY_F5, SYS_KEY_F6, SYS_KEY_F7, SYS_KEY_F8, SYS_KEY_F9,
+    SYS_KEY_F10, SYS_KEY_F11, SYS_KEY_F12,
+    // From 0x46.
+    SYS_KEY_PRINT_SCREEN, SYS_KEY_SCROLL, SYS_KEY_PAUSE, SYS_KEY_INSERT, SYS_KEY_HOME, SYS_KEY_PAGE_UP, SYS_KEY_DELETE,
+    SYS_KEY_END, SYS_KEY_PAGE_DOWN, SYS_KEY_RIGHT_ARROW, SYS_KEY_LEFT_ARROW, SYS_KEY_DOWN_ARROW, SYS_KEY_UP_ARROW,
+    // From 0x53.
+    SYS_KEY_NUM_LOCK, SYS_KEY_NUMPAD_SLASH, SYS_KEY_NUMPAD_STAR, SYS_KEY_NUMPAD_MINUS, SYS_KEY_NUMPAD_PLUS,
+    SYS_KEY_NUMPAD_ENTER,
+    // From 0x59.
+    SYS_KEY_NUMPAD_1, SYS_KEY_NUMPAD_2, SYS_KEY_NUMPAD_3, SYS_KEY_NUMPAD_4, SYS_KEY_NUMPAD_5, SYS_KEY_NUMPAD_6,
+    SYS_KEY_NUMPAD_7, SYS_KEY_NUMPAD_8, SYS_KEY_NUMPAD_9, SYS_KEY_NUMPAD_0, SYS_KEY_NUMPAD_DOT,
+    // From 0x64.
+    SYS_KEY_LESS_MORE, SYS_KEY_APPS,
+};
+static constexpr size_t USAGE_COUNT = sizeof(g_usage_to_keycode) / sizeof(g_usage_to_keycode[0]);
+
+// The key codes of the bits of the modifiers byte.
+static constexpr sys_key_code_t g_modifier_keycodes[8] = {
+    SYS_KEY_LEFT_CTRL,  SYS_KEY_LEFT_SHIFT,  SYS_KEY_LEFT_ALT,  SYS_KEY_LEFT_GUI,
+    SYS_KEY_RIGHT_CTRL, SYS_KEY_RIGHT_SHIFT, SYS_KEY_RIGHT_ALT, SYS_KEY_RIGHT_GUI,
+};
+
+// The HID usage reported for all the keys when too many of them are pressed.
+static constexpr uint8_t ERROR_ROLL_OVER = 0x01;
+
+// The previous keyboard report, to find the keys that changed.
+static uint8_t g_previous_report[KEYBOARD_REPORT_SIZE] = {};
+
+static sys_key_code_t get_keycode(uint8_t usage) {
+  if (usage < FIRST_USAGE || usage >= FIRST_USAGE + USAGE_COUNT)
+    return (sys_key_code_t)0;
+
+  return (sys_key_code_t)g_usage_to_keycode[usage - FIRST_USAGE];
+}
+
+static bool contains_key(const uint8_t* report, uint8_t usage) {
+  for (size_t i = 2; i < KEYBOARD_REPORT_SIZE; ++i) {
+    if (report[i] == usage)
+      return true;
+  }
+
+  return false;
+}
+
+void handle_keyboard_report(const uint8_t* report, size_t size, uint64_t timestamp) {
+  if (size < KEYBOARD_REPORT_SIZE)
+    return;
+
+  // The keys are unknown while rolled over, keep the previous state until the next valid report.
+  if (report[2] == ERROR_ROLL_OVER)
+    return;
+
+  const uint8_t changed_modifiers = report[0] ^ g_previous_report[0];
+  for (size_t bit = 0; bit < 8; ++bit) {
+    if ((changed_modifiers & (1 << bit)) != 0)
+      KeyboardSystem::notify_hardware_event(g_modifier_keycodes[bit], (report[0] & (1 << bit)) != 0, timestamp);
+  }
+
+  // Release the keys first, so a key replaced by another one in the same report is not seen as held.
+  for (size_t i = 2; i < KEYBOARD_REPORT_SIZE; ++i) {
+    const uint8_t usage = g_previous_report[i];
+    const sys_key_code_t keycode = get_keycode(usage);
+    if (keycode != 0 && !contains_key(report, usage))
+      KeyboardSystem::notify_hardware_event(keycode, false, timestamp);
+  }
+
+  for (size_t i = 2; i < KEYBOARD_REPORT_SIZE; ++i) {
+    const uint8_t usage = report[i];
+    const sys_key_code_t keycode = get_keycode(usage);
+    if (keycode != 0 && !contains_key(g_previous_report, usage))
+      KeyboardSystem::notify_hardware_event(keycode, true, timestamp);
+  }
+
+  for (size_t i = 0; i < KEYBOARD_REPORT_SIZE; ++i)
+    g_previous_report[i] = report[i];
+}
+
+void handle_mouse_report(const uint8_t* report, size_t size) {
+  if (size < MOUSE_REPORT_SIZE)
+    return;
+
+  // The buttons (report[0]) are not supported yet, as with the other mouse drivers.
+  const auto dx = (int8_t)report[1];
+  const auto dy = (int8_t)report[2];
+  if (dx != 0 || dy != 0)
+    MouseSystem::notify_hardware_move_event(dx, dy);
+
+  // The wheel is positive when scrolled away from the user.
+  if (size > MOUSE_REPORT_SIZE && report[3] != 0)
+    MouseSystem::notify_hardware_scroll_event(0, -(int8_t)report[3]);
+}
+}  // namespace HIDBoot
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The USB HID boot protocol reports of the keyboards and the mice, translated into the events of
+ * KeyboardSystem and MouseSystem. To be called by the host controller driver for each report received on the
+ * interrupt IN endpoint of a device in boot protocol (SET_PROTOCOL 0), with the kernel lock held.
+ */
+namespace HIDBoot {
+/** The size of a keyboard report: the modifiers, a reserved byte, and up to 6 pressed keys (HID usages). */
+static constexpr size_t KEYBOARD_REPORT_SIZE = 8;
+/** The minimal size of a mouse report: the buttons and the X and Y moves, optionally followed by the wheel. */
+static constexpr size_t MOUSE_REPORT_SIZE = 3;
+
+/** Sends the press and release events of the keys that changed since the previous report of the keyboard.
+ * The @a timestamp is the tick count of the generic timer when the report was received. */
+void handle_keyboard_report(const uint8_t* report, size_t size, uint64_t timestamp);
+/** Sends the move and scroll events of a mouse report. */
+void handle_mouse_report(const uint8_t* report, size_t size);
+}  // namespace HIDBoot
@@ -1,4 +1,9 @@
 #include "keyboard_input.hpp"
+#include <libk/string.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "hardware/timer.hpp"
+#include "task/task_manager.hpp"
+#include "task/wait_list.hpp"
 #include "wm/window_manager.hpp"
 
 namespace KeyboardSystem {
@@ -32,8 +37,21 @@ sys_key_modifiers_t get_current_key_modifiers() {
   return mods;
 }
 
+// The last pressed key is repeated while held (the modifiers and the locks are never repeated), by the key
+// repeat task at g_repeat_deadline (in timer ticks).
+static bool g_is_repeating = false;
+static sys_key_code_t g_repeat_keycode;
+static uint64_t g_repeat_deadline = 0;
+static WaitList g_repeat_wait_list;
+
+// The latencies of the delivered key events, in timer ticks (see SyscallStats for the histogram buckets).
+static uint64_t g_latency_count = 0;
+static uint64_t g_latency_total_ticks = 0;
+static uint64_t g_latency_max_ticks = 0;
+static uint32_t g_latency_histogram[SYS_STATS_HISTOGRAM_SIZE] = {};
+
 // Send a key event to the window manager.
-static void dispatch_key_event_to_wm(sys_key_event_t event) {
+static void dispatch_key_event_to_wm(sys_key_event_t event, uint64_t timestamp) {
   sys_message_t msg = {};
   if (sys_is_press_event(event))
     msg.id = SYS_MSG_KEYDOWN;
@@ -43,11 +61,66 @@ static void dispatch_key_event_to_wm(sys_key_event_t event) {
     return;
 
   msg.param1 = event;
-  msg.param2 = 0;
+  msg.param2 = timestamp;
   WindowManager::get().post_message(msg);
 }
 
-void press(sys_key_code_t keycode) {
+static bool is_repeatable(sys_key_code_t keycode) {
+  switch (keycode) {
+    case SYS_KEY_LEFT_CTRL:
+    case SYS_KEY_RIGHT_CTRL:
+    case SYS_KEY_LEFT_SHIFT:
+    case SYS_KEY_RIGHT_SHIFT:
+    case SYS_KEY_LEFT_ALT:
+    case SYS_KEY_RIGHT_ALT:
+    case SYS_KEY_LEFT_GUI:
+    case SYS_KEY_RIGHT_GUI:
+    case SYS_KEY_CAPS_LOCK:
+    case SYS_KEY_NUM_LOCK:
+      return false;
+    default:
+      return true;
+  }
+}
+
+static uint64_t micros_to_ticks(uint64_t micros) {
+  return (micros * GenericTimer::get_frequency()) / 1'000'000;
+}
+
+// The key repeat task, posting the repeated press events of the held key.
+static void run_key_repeat() {
+  while (true) {
+    uint64_t sleep_time = 0;
+    bool is_blocked = false;
+    {
+      KernelTaskLockGuard kernel_lock;
+      const uint64_t now = GenericTimer::get_tick_count();
+      if (!g_is_repeating) {
+        g_repeat_wait_list.add(Task::current());
+        is_blocked = true;
+      } else if (now >= g_repeat_deadline) {
+        dispatch_key_event_to_wm(sys_create_repeat_event(g_repeat_keycode, get_current_key_modifiers()), now);
+        g_repeat_deadline += micros_to_ticks(REPEAT_PERIOD);
+      } else {
+        sleep_time = ((g_repeat_deadline - now) * 1'000'000) / GenericTimer::get_frequency();
+      }
+    }
+
+    if (is_blocked) {
+      sys_yield();
+    } else if (sleep_time > 0) {
+      sys_usleep(sleep_time);
+    }
+  }
+}
+
+void init() {
+  auto repeat_task = TaskManager::get().create_kernel_task(&run_key_repeat);
+  KASSERT(repeat_task != nullptr);
+  TaskManager::get().wake_task(repeat_task);
+}
+
+void press(sys_key_code_t keycode, uint64_t timestamp) {
   switch (keycode) {
     case SYS_KEY_LEFT_CTRL:
     case SYS_KEY_RIGHT_CTRL:
@@ -77,12 +150,19 @@ void press(sys_key_code_t keycode) {
       break;
   }
 
+  if (is_repeatable(keycode)) {
+    g_is_repeating = true;
+    g_repeat_keycode = keycode;
+    g_repeat_deadline = timestamp + micros_to_ticks(REPEAT_DELAY);
+    g_repeat_wait_list.wake_all();
+  }
+
   const auto modifiers = get_current_key_modifiers();
   const auto event = sys_create_press_event(keycode, modifiers);
-  dispatch_key_event_to_wm(event);
+  dispatch_key_event_to_wm(event, timestamp);
 }
 
-void release(sys_key_code_t keycode) {
+void release(sys_key_code_t keycode, uint64_t timestamp) {
   switch (keycode) {
     case SYS_KEY_LEFT_CTRL:
     case SYS_KEY_RIGHT_CTRL:
@@ -116,15 +196,41 @@ void release(sys_key_code_t keycode) {
       break;
   }
 
+  if (g_is_repeating && keycode == g_repeat_keycode)
+    g_is_repeating = false;
+
   const auto modifiers = get_current_key_modifiers();
   const auto event = sys_create_release_event(keycode, modifiers);
-  dispatch_key_event_to_wm(event);
+  dispatch_key_event_to_wm(event, timestamp);
 }
 
-void notify_hardware_event(sys_key_code_t keycode, bool is_pressed) {
+void notify_hardware_event(sys_key_code_t keycode, bool is_pressed, uint64_t timestamp) {
   if (is_pressed)
-    press(keycode);
+    press(keycode, timestamp);
   else
-    release(keycode);
+    release(keycode, timestamp);
+}
+
+void record_delivery(const sys_message_t& message) {
+  if (message.id != SYS_MSG_KEYDOWN && message.id != SYS_MSG_KEYUP)
+    return;
+
+  const uint64_t now = GenericTimer::get_tick_count();
+  const uint64_t ticks = now > message.param2 ? now - message.param2 : 0;
+  g_latency_count++;
+  g_latency_total_ticks += ticks;
+  if (ticks > g_latency_max_ticks)
+    g_latency_max_ticks = ticks;
+
+  const size_t bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+  g_latency_histogram[bucket < SYS_STATS_HISTOGRAM_SIZE ? bucket : SYS_STATS_HISTOGRAM_SIZE - 1]++;
+}
+
+void get_latency_stats(sys_syscall_stats_t& stats) {
+  stats.count = g_latency_count;
+  stats.total_ticks = g_latency_total_ticks;
+  stats.max_ticks = g_latency_max_ticks;
+  stats.tick_frequency = GenericTimer::get_frequency();
+  libk::memcpy(stats.histogram, g_latency_histogram, sizeof(stats.histogram));
 }
 }  // namespace KeyboardSystem
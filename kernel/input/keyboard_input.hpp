@@ -1,11 +1,27 @@
 #pragma once
 
 #include <sys/keyboard.h>
+#include <sys/syscall.h>
+#include <sys/window.h>
 
 namespace KeyboardSystem {
-void press(sys_key_code_t keycode);
-void release(sys_key_code_t keycode);
+/** The delay before a held key is repeated, and then the period of the repeats (in microseconds). */
+static constexpr uint64_t REPEAT_DELAY = 500'000;
+static constexpr uint64_t REPEAT_PERIOD = 33'000;
 
-// These functions must be called from the hardware driver.
-void notify_hardware_event(sys_key_code_t keycode, bool is_pressed);
+/** Starts the key repeat task. */
+void init();
+
+// The key events are posted to the window manager, their param2 is @a timestamp (in timer ticks).
+void press(sys_key_code_t keycode, uint64_t timestamp);
+void release(sys_key_code_t keycode, uint64_t timestamp);
+
+// These functions must be called from the hardware driver. The @a timestamp is the tick count of the generic
+// timer when the hardware interrupt was received.
+void notify_hardware_event(sys_key_code_t keycode, bool is_pressed, uint64_t timestamp);
+
+/** Records the latency of the key event @a message (if it is one) once delivered to its window. */
+void record_delivery(const sys_message_t& message);
+/** Fills @a stats with the latencies of the key events, from the hardware interrupt to the delivery. */
+void get_latency_stats(sys_syscall_stats_t& stats);
 }  // namespace KeyboardSystem
@@ -17,6 +17,7 @@ int32_t get_mouse_y() {
 void move_mouse(int32_t x, int32_t y) {
   mouse_x = libk::clamp(x, MIN_POSITION, MAX_POSITION);
   mouse_y = libk::clamp(y, MIN_POSITION, MAX_POSITION);
+  WindowManager::get().move_cursor(mouse_x, mouse_y);
 
   sys_message_t msg = {};
   msg.id = SYS_MSG_MOUSEMOVE;
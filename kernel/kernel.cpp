@@ -1,16 +1,38 @@
+#include <libk/benchmark.hpp>
+#include <libk/cpu_features.hpp>
 #include <libk/log.hpp>
+#include <libk/qemu.hpp>
 
+#include "hardware/cpufreq.hpp"
 #include "hardware/device.hpp"
+#include "hardware/ethernet.hpp"
 #include "hardware/framebuffer.hpp"
 #include "hardware/interrupts.hpp"
+#include "hardware/irq/irq_manager.hpp"
 #include "hardware/kernel_dt.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "hardware/timer.hpp"
 #include "hardware/ps2_keyboard.hpp"
 #include "hardware/uart_keyboard.hpp"
 
 #include "fs/filesystem.hpp"
+#include "input/keyboard_input.hpp"
+#include "graphics/text_run_cache.hpp"
+#include "graphics/thumbnail_cache.hpp"
+#include "memory/kernel_internal_memory.hpp"
+#include "memory/memory_pressure.hpp"
+#include "net/net.hpp"
 
+#include "boot_profile.hpp"
+#include "boot_snapshot.hpp"
+#include "deferred_log.hpp"
+#include "initcall.hpp"
+#include "kernel_symbols.hpp"
+#include "latency_tracer.hpp"
+#include "profiler.hpp"
 #include "sys/syscall.h"
 #include "task/task_manager.hpp"
+#include "trace.hpp"
 #include "wm/window_manager.hpp"
 
 #if defined(__clang__)
@@ -21,30 +43,202 @@
 #define COMPILER_NAME "Unknown Compiler"
 #endif
 
+// The window manager task (thread), redrawing the screen when damaged.
+static void run_window_manager() {
+  uint64_t last_update_time = 0;
+  while (true) {
+    // Do not update more often than the display refresh rate, the damages are accumulated meanwhile.
+    const uint64_t elapsed_time = GenericTimer::get_elapsed_time_in_micros() - last_update_time;
+    if (elapsed_time < WindowManager::FRAME_PERIOD)
+      sys_usleep(WindowManager::FRAME_PERIOD - elapsed_time);
+
+    // The window manager is shared with the syscalls run by the other cores.
+    bool is_blocked;
+    {
+      KernelTaskLockGuard kernel_lock;
+      last_update_time = GenericTimer::get_elapsed_time_in_micros();
+      WindowManager::get().update();
+
+      // Sleep while the DMA does the copies.
+      is_blocked = WindowManager::get().block_task_until_update_done(Task::current());
+    }
+
+    if (is_blocked)
+      sys_yield();
+
+    {
+      KernelTaskLockGuard kernel_lock;
+      WindowManager::get().finish_update();
+
+      // Sleep until something must be redrawn, an idle desktop costs nothing.
+      is_blocked = WindowManager::get().block_task_until_damaged(Task::current());
+    }
+
+    if (is_blocked)
+      sys_yield();
+  }
+}
+
+/*
+ * The boot steps, see Initcall. A step only depends on the ones above it.
+ */
+
+enum BootStep : size_t {
+  FILE_SYSTEM,
+  FRAMEBUFFER,
+  BOOT_SNAPSHOT,
+  WINDOW_MANAGER,
+  WALLPAPER,
+  KEYBOARD,
+  INIT_PROGRAM,
+  BOOT_PROFILE,
+  ETHERNET,
+  NETWORK,
+  KERNEL_SYMBOLS,
+  SAVE_BOOT_SNAPSHOT,
+};  // enum BootStep
+
+static void init_file_system() {
+  FileSystem::get().init();
+}
+
+static void init_framebuffer() {
+#ifdef CONFIG_SPI_DISPLAY
+  // An ILI9341 panel in landscape, falling back to the HDMI output if SPI0 is unavailable.
+  const SpiDisplay::Config spi_display_config = {SpiDisplay::Controller::ILI9341, 320, 240, 0, 0, 25, 24, 32'000'000};
+  if (FrameBuffer::get().init_spi_display(spi_display_config)) {
+    BootProfile::mark(BootProfile::Stage::FRAMEBUFFER);
+    return;
+  }
+
+  LOG_WARNING("failed to initialize the SPI display");
+#endif  // CONFIG_SPI_DISPLAY
+
+  if (!FrameBuffer::get().init(1280, 720)) {
+    LOG_WARNING("failed to initialize framebuffer");
+  }
+
+  BootProfile::mark(BootProfile::Stage::FRAMEBUFFER);
+}
+
+static void load_boot_snapshot() {
+  if (BootSnapshot::load())
+    BootProfile::mark(BootProfile::Stage::BOOT_SNAPSHOT);
+}
+
+static void init_window_manager() {
+  WindowManager* window_manager = new WindowManager;
+  KASSERT(window_manager != nullptr);
+
+  auto window_manager_task = TaskManager::get().create_kernel_task(&run_window_manager);
+  KASSERT(window_manager_task != nullptr);
+
+  // The compositor runs at each frame whatever the load of the other tasks, up to half of each frame.
+  const DeadlineParams frame_params = {WindowManager::FRAME_PERIOD / 2, WindowManager::FRAME_PERIOD,
+                                       WindowManager::FRAME_PERIOD};
+  if (!TaskManager::get().set_task_deadline(window_manager_task, frame_params))
+    LOG_WARNING("Unable to schedule the window manager at each frame");
+
+  TaskManager::get().wake_task(window_manager_task);
+
+  BootProfile::mark(BootProfile::Stage::WINDOW_MANAGER);
+}
+
+static void load_wallpaper() {
+  WindowManager::get().load_wallpaper();
+  BootProfile::mark(BootProfile::Stage::WALLPAPER);
+}
+
+static void init_keyboard() {
+  PS2Keyboard::set_on_event(&KeyboardSystem::notify_hardware_event);
+  PS2Keyboard::init();
+
+  static UART* uart0 = new UART(2000000, "uart0", /* irqs= */ true);
+  KASSERT(uart0 != nullptr);
+  UARTKeyboard::init(uart0);
+  KeyboardSystem::init();
+
+#ifdef CONFIG_SCREEN_STREAM
+  // The frames go back to the host on the same UART, see tools/uart-input-server.py --screen.
+  if (!WindowManager::get().start_screen_stream(uart0))
+    LOG_WARNING("Unable to stream the screen over the UART");
+#endif  // CONFIG_SCREEN_STREAM
+}
+
+#ifdef BUILD_BENCHMARKS
+/** Checks if the kernel is booted to only run the benchmarks, with the boot option `kbench` (see kernel-bench-img
+ * and tools/run-benchmarks.py). The init program is then not started, so nothing else competes with them. */
+static bool is_benchmark_boot() {
+  Property bootargs = {};
+  if (!KernelDT::find_property("/chosen/bootargs", &bootargs))
+    return false;
+
+  const auto cmdline = bootargs.get_string();
+  return cmdline.has_value() && cmdline.get_value().find("kbench") != libk::StringView::npos;
+}
+#endif  // BUILD_BENCHMARKS
+
 // Load the init program and execute it! This is the entry point of the userspace world.
-[[noreturn]] static void load_init() {
-  // Create the task manager.
-  TaskManager& task_manager = TaskManager::get();
-  auto init_task = task_manager.create_task("/bin/init");
+static void start_init_program() {
+#ifdef BUILD_BENCHMARKS
+  if (is_benchmark_boot()) {
+    LOG_INFO("Benchmark boot, the init program is not started");
+    return;
+  }
+#endif  // BUILD_BENCHMARKS
+
+  auto init_task = TaskManager::get().create_task("/bin/init");
   if (init_task == nullptr) {
     LOG_CRITICAL("Failed to load the init program");
   }
 
-  // Execute the init program.
   LOG_INFO("Starting the init program");
-  task_manager.wake_task(init_task);
+  TaskManager::get().wake_task(init_task);
+  BootProfile::mark(BootProfile::Stage::INIT_PROGRAM);
+}
 
-  while (task_manager.get_current_task() != init_task)
-    task_manager.schedule();
+static void dump_boot_profile() {
+  BootProfile::mark(BootProfile::Stage::BOOT_DONE);
+  BootProfile::dump();
+}
 
-  // Enter userspace!
-  enable_fpu_and_neon();
-  init_task->get_saved_state().memory->activate();
-  task_manager.mark_as_ready();
-  jump_to_el0(init_task->get_saved_state().pc, (uintptr_t)init_task->get_saved_state().sp);
-  LOG_CRITICAL("Exited from userspace");
+static void init_ethernet() {
+  // The driver logs why it is not available, the system calls then fail.
+  (void)Ethernet::init();
 }
 
+static void init_network() {
+  Net::init();
+}
+
+static void load_kernel_symbols() {
+  // Logs why they are not available, the stack traces then only have the addresses.
+  (void)KernelSymbols::init();
+}
+
+static void save_boot_snapshot() {
+  // Once the first boot is done, the next ones show the desktop right away.
+  BootSnapshot::save(WindowManager::get().get_wallpaper());
+}
+
+static constexpr Initcall::Descriptor g_boot_steps[] = {
+    {"file system", &init_file_system},
+    {"framebuffer", &init_framebuffer},
+    {"boot snapshot", &load_boot_snapshot, Initcall::after(FILE_SYSTEM) | Initcall::after(FRAMEBUFFER)},
+    // The window manager takes the wallpaper of the boot snapshot, its first frames show the same screen.
+    {"window manager", &init_window_manager, Initcall::after(FRAMEBUFFER) | Initcall::after(BOOT_SNAPSHOT)},
+    {"wallpaper", &load_wallpaper, Initcall::after(FILE_SYSTEM) | Initcall::after(WINDOW_MANAGER)},
+    {"keyboard", &init_keyboard, Initcall::after(WINDOW_MANAGER)},
+    // The programs load their resources from the file system and open windows.
+    {"init program", &start_init_program, Initcall::after(FILE_SYSTEM) | Initcall::after(WINDOW_MANAGER)},
+    {"boot profile", &dump_boot_profile,
+     Initcall::after(WALLPAPER) | Initcall::after(KEYBOARD) | Initcall::after(INIT_PROGRAM)},
+    {"ethernet", &init_ethernet},
+    {"network", &init_network, Initcall::after(ETHERNET)},
+    {"kernel symbols", &load_kernel_symbols, Initcall::after(FILE_SYSTEM)},
+    {"save boot snapshot", &save_boot_snapshot, Initcall::after(BOOT_PROFILE)},
+};
+
 [[noreturn]] void kmain() {
   LOG_INFO("Kernel built at " __TIME__ " on " __DATE__ " with " COMPILER_NAME " !");
 
@@ -53,36 +247,80 @@
   LOG_INFO("Board serial: {:#x}", KernelDT::get_board_serial());
   LOG_INFO("Temp: {} °C / {} °C", Device::get_current_temp() / 1000, Device::get_max_temp() / 1000);
 
-  FileSystem::get().init();
+  const libk::CpuFeatures& features = libk::get_cpu_features();
+  LOG_INFO("Caches: L1d {} KiB, L2 {} KiB, line {} B, DC ZVA block {} B, large copies from {} B",
+           features.l1d_size / 1024, features.l2_size / 1024, features.dcache_line_size, features.dc_zva_block_size,
+           features.large_copy_threshold);
 
-  FrameBuffer& framebuffer = FrameBuffer::get();
-  if (!framebuffer.init(1280, 720)) {
-    LOG_WARNING("failed to initialize framebuffer");
-  }
+  TaskManager* task_manager = new TaskManager;
+  KASSERT(task_manager != nullptr);
+  BootProfile::mark(BootProfile::Stage::TASK_MANAGER);
 
-  WindowManager* window_manager = new WindowManager;
-  KASSERT(window_manager != nullptr);
+  // From now on, the log messages are written by a kernel task.
+  DeferredLog::init();
 
-  // PS2Keyboard::init();
-  // PS2Keyboard::set_on_event(&dispatch_key_event_to_wm);
+  MemoryPressure::init();
+  MemoryPressure::register_shrinker("segment cache", &SegmentCache::shrink);
+  MemoryPressure::register_shrinker("text run cache", &graphics::TextRunCache::shrink);
+  MemoryPressure::register_shrinker("thumbnail cache", &graphics::ThumbnailCache::shrink);
+  MemoryPressure::register_shrinker("page table cache", &memory_impl::shrink_table_cache);
 
-  UART uart0(2000000, "uart0", /* irqs= */true);
-  UARTKeyboard::init(&uart0);
+  CpuFreq::init();
 
-  TaskManager* task_manager = new TaskManager;
-  KASSERT(task_manager != nullptr);
+  Initcall::start(g_boot_steps);
 
-  // Run the window manager task (thread).
-  auto window_manager_task = task_manager->create_kernel_task([]() {
+#ifdef CONFIG_DUMP_SYSCALL_STATS
+  auto syscall_stats_task = task_manager->create_kernel_task([]() {
     while (true) {
-      WindowManager::get().update();
-      sys_usleep(63333);
+      sys_sleep(CONFIG_DUMP_SYSCALL_STATS);
+
+      {
+        KernelTaskLockGuard kernel_lock;
+        SyscallStats::get_global().dump();
+      }
     }
   });
 
-  KASSERT(window_manager_task != nullptr);
-  task_manager->wake_task(window_manager_task);
+  KASSERT(syscall_stats_task != nullptr);
+  task_manager->wake_task(syscall_stats_task);
+#endif  // CONFIG_DUMP_SYSCALL_STATS
+
+#ifdef CONFIG_TRACE
+  Trace::start_drain_task();
+#endif  // CONFIG_TRACE
 
-  // Run the init program.
-  load_init();
+#ifdef CONFIG_PROFILER
+  // The secondary cores program their own PMU, see SMP::secondary_main().
+  Profiler::init_core();
+  Profiler::start_drain_task();
+#endif  // CONFIG_PROFILER
+
+#ifdef CONFIG_LATENCY_TRACER
+  LatencyTracer::start_wakeup_task();
+#endif  // CONFIG_LATENCY_TRACER
+
+#ifdef BUILD_BENCHMARKS
+  auto benchmarks_task = task_manager->create_kernel_task([]() {
+    kbench::run_benchmarks();
+
+#ifdef TARGET_QEMU
+    // Write the deferred results, the runner waits for QEMU to exit.
+    if (is_benchmark_boot()) {
+      libk::flush_logs();
+      libk::qemu_exit(0);
+    }
+#endif  // TARGET_QEMU
+  });
+  KASSERT(benchmarks_task != nullptr);
+  task_manager->wake_task(benchmarks_task);
+#endif  // BUILD_BENCHMARKS
+
+  // From now on, the boot core only runs the tasks, as the secondary cores (see SMP::secondary_main()).
+  enable_fpu_and_neon();
+  task_manager->mark_as_ready();
+  IRQManager::enable_irq_interrupts();
+
+  while (true) {
+    libk::wfi();
+  }
 }
@@ -0,0 +1,150 @@
+#include "kernel_symbols.hpp"
+
+#include <sys/file.h>
+
+#include <elf/symbols.hpp>
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "fs/file.hpp"
+#include "fs/filesystem.hpp"
+#include "memory/mem_alloc.hpp"
+
+namespace KernelSymbols {
+static libk::PanicHook g_previous_panic_hook = nullptr;
+static elf::SymbolTable g_table;
+static uint32_t* g_index = nullptr;
+static uint64_t g_index_size = 0;
+
+/** Reads the @a byte_size bytes at @a offset of @a file into a new allocation, or returns nullptr. */
+static void* read_at(File* file, uint64_t offset, size_t byte_size) {
+  if (offset > file->get_size() || file->get_size() - offset < byte_size || !file->seek(offset))
+    return nullptr;
+
+  void* buffer = kmalloc(byte_size, alignof(uint64_t));
+  size_t read_bytes = 0;
+  if (buffer != nullptr && (!file->read(buffer, byte_size, &read_bytes) || read_bytes != byte_size)) {
+    kfree(buffer);
+    return nullptr;
+  }
+
+  return buffer;
+}
+
+/** Reads the symbol and string tables of the ELF @a file into g_table. */
+static bool read_tables(File* file) {
+  elf::Header header;
+  size_t read_bytes = 0;
+  if (!file->read(&header, sizeof(header), &read_bytes) || read_bytes != sizeof(header) ||
+      elf::check_header(&header) != elf::Error::NONE || !elf::has_section_headers(&header))
+    return false;
+
+  void* section_headers =
+      read_at(file, header.section_header_offset, sizeof(elf::SectionHeader) * header.section_header_entry_count);
+  if (section_headers == nullptr)
+    return false;
+
+  const elf::SectionHeader* symbols;
+  const elf::SectionHeader* strings;
+  bool is_ok = elf::find_symbol_sections(&header, section_headers, &symbols, &strings);
+  if (is_ok) {
+    g_table.symbols = (const elf::Symbol*)read_at(file, symbols->offset, symbols->size);
+    g_table.symbol_count = symbols->size / sizeof(elf::Symbol);
+    g_table.strings = (const char*)read_at(file, strings->offset, strings->size);
+    g_table.strings_size = strings->size;
+    is_ok = g_table.symbols != nullptr && g_table.strings != nullptr;
+  }
+
+  kfree(section_headers);
+  return is_ok;
+}
+
+/** Checks if the 16-byte frame record at the kernel address @a fp can be read: the address is translated first,
+ * with the AT instruction (as the profiler does). */
+static bool is_frame_record_mapped(uint64_t fp) {
+  // The frame records are 16-byte aligned (as the stack pointer), so they never cross a page.
+  if ((fp & 0xF) != 0 || fp < KERNEL_BASE)
+    return false;
+
+  uint64_t par_el1;
+  asm volatile("at s1e1r, %x1\n\tisb\n\tmrs %x0, PAR_EL1" : "=r"(par_el1) : "r"(fp));
+  return (par_el1 & 0b1) == 0;
+}
+
+static void print_frame(size_t i, uint64_t address) {
+  uint64_t offset;
+  const char* name = find(address, &offset);
+  if (name != nullptr)
+    libk::print("  #{} {:#x} {}+{:#x}", i, address, name, offset);
+  else
+    libk::print("  #{} {:#x}", i, address);
+}
+
+/** Called by libk::panic(), the stack trace starts in it. */
+static void print_panic_stack_trace() {
+  print_stack_trace((uint64_t)__builtin_return_address(0), (uint64_t)__builtin_frame_address(0));
+  if (g_previous_panic_hook != nullptr)
+    g_previous_panic_hook();
+}
+
+bool init() {
+  // Printed at the next panics even without the symbols, with the addresses alone.
+  g_previous_panic_hook = libk::set_panic_hook(&print_panic_stack_trace);
+
+  File* file = FileSystem::get().open(KERNEL_ELF_PATH, SYS_FM_READ);
+  if (file == nullptr) {
+    LOG_INFO("No kernel symbols ({} not found)", KERNEL_ELF_PATH);
+    return false;
+  }
+
+  const bool is_ok = read_tables(file);
+  FileSystem::get().close(file);
+  if (!is_ok) {
+    LOG_ERROR("Failed to read the kernel symbols from {}", KERNEL_ELF_PATH);
+    kfree((void*)g_table.symbols);
+    kfree((void*)g_table.strings);
+    g_table = {};
+    return false;
+  }
+
+  g_index = (uint32_t*)kmalloc(sizeof(uint32_t) * elf::count_address_symbols(g_table), alignof(uint32_t));
+  if (g_index == nullptr)
+    return false;
+
+  g_index_size = elf::build_address_index(g_table, g_index);
+  LOG_INFO("Kernel symbols: {} functions", g_index_size);
+  return true;
+}
+
+const char* find(uint64_t address, uint64_t* offset) {
+  if (g_index_size == 0)
+    return nullptr;
+
+  const elf::Symbol* symbol = elf::find_symbol_by_address(g_table, g_index, g_index_size, address);
+  if (symbol == nullptr)
+    return nullptr;
+
+  *offset = address - symbol->value;
+  return g_table.get_name(symbol);
+}
+
+void print_stack_trace(uint64_t pc, uint64_t fp) {
+  libk::print("Stack trace:");
+  print_frame(0, pc);
+
+  for (size_t i = 1; i < MAX_FRAMES && fp != 0 && is_frame_record_mapped(fp); ++i) {
+    const auto* frame_record = (const uint64_t*)fp;
+    if (frame_record[1] == 0)
+      break;
+
+    // The return address is after the call, the one before is in the caller (even if it was a tail call).
+    print_frame(i, frame_record[1] - 4);
+
+    // The stack grows down: the frames of the callers are above, anything else is a corrupted chain.
+    if (frame_record[0] <= fp)
+      break;
+    fp = frame_record[0];
+  }
+}
+}  // namespace KernelSymbols
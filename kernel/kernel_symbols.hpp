@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The symbols of the kernel functions, to print the stack traces of the kernel panics and of the unhandled
+ * exceptions with the function names.
+ *
+ * The kernel image is a raw binary, without symbols: they are read from the kernel ELF copied next to it on the SD
+ * card (KERNEL_ELF_PATH, see tools/create-boot-img.sh). Only its symbol and string tables are read, at boot, and the
+ * functions are indexed by address once (see elf::build_address_index()): a code address is then symbolized by a
+ * binary search, without allocation nor file access, so even at panic time.
+ *
+ * Without the file, the addresses are printed alone, to be symbolized on the host with addr2line and the kernel ELF.
+ */
+namespace KernelSymbols {
+static constexpr const char* KERNEL_ELF_PATH = "1:/kernel8.elf";
+/** The maximum count of frames printed by print_stack_trace(). */
+static constexpr size_t MAX_FRAMES = 16;
+
+/** Reads the kernel symbols, once the file system is initialized, and prints the stack trace of the next kernel
+ * panics. Returns false if they can not be read (the stack traces are still printed). */
+bool init();
+
+/** Returns the name of the kernel function containing @a address and the @a offset of the address into it, or
+ * nullptr if unknown. */
+[[nodiscard]] const char* find(uint64_t address, uint64_t* offset);
+
+/** Prints (with libk::print()) the code address @a pc then the return addresses of the frame records from @a fp,
+ * symbolized. The frame records are checked to be mapped before being read. */
+void print_stack_trace(uint64_t pc, uint64_t fp);
+}  // namespace KernelSymbols
@@ -0,0 +1,303 @@
+#include "kexec.hpp"
+
+#include <sys/file.h>
+
+#include <libk/assert.hpp>
+#include <libk/cache.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "fs/fat/ramdisk.hpp"
+#include "fs/file.hpp"
+#include "fs/filesystem.hpp"
+#include "hardware/dma/dma_controller.hpp"
+#include "hardware/ethernet.hpp"
+#include "hardware/irq/irq_manager.hpp"
+#include "hardware/irq_save.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "memory/buffer.hpp"
+#include "memory/kernel_internal_memory.hpp"
+
+// Defined in boot/kexec.S.
+extern "C" {
+[[noreturn]] void kexec_park(PhysicalPA pgd, PhysicalPA park_loop, PhysicalPA release_address, PhysicalPA parked_flag);
+[[noreturn]] void kexec_jump(PhysicalPA pgd,
+                             PhysicalPA relocate,
+                             PhysicalPA segments,
+                             size_t segment_count,
+                             PhysicalPA dtb,
+                             PhysicalPA entry);
+extern const uint8_t kexec_blob_start[];
+extern const uint8_t kexec_park_loop[];
+extern const uint8_t kexec_relocate[];
+extern const uint8_t kexec_blob_end[];
+}
+
+namespace Kexec {
+/** A copy done by kexec_relocate(), with the MMU off. */
+struct Segment {
+  PhysicalPA destination;
+  PhysicalPA source;
+  uint64_t byte_size;  // a multiple of 16
+};  // struct Segment
+static_assert(sizeof(Segment) == 24, "read by kexec_relocate()");
+
+/** The ramdisk then the kernel, copied in this order. */
+static constexpr size_t MAX_SEGMENTS = 2;
+/** The time left to the UART to send its FIFO, before the jump. */
+static constexpr uint64_t UART_DRAIN_MS = 1;
+
+/** The content of the kexec page (PHYSICAL_KEXEC_PAGE). */
+struct ControlPage {
+  uint8_t code[MAX_CODE_SIZE];  // from kexec_blob_start
+  Segment segments[MAX_SEGMENTS];
+  // Set by the parked cores with their MMU off, so each one on its own cache line.
+  struct alignas(SMP::CACHE_LINE_SIZE) ParkedFlag {
+    uint64_t value;
+  } parked[SMP::MAX_CORES];
+};  // struct ControlPage
+static_assert(sizeof(ControlPage) <= PAGE_SIZE);
+
+static Segment g_segments[MAX_SEGMENTS];
+static PhysicalPA g_segment_last_pages[MAX_SEGMENTS];  // to free the sources
+static size_t g_segment_count = 0;
+static SMP::EnableMethod g_enable_methods[SMP::MAX_CORES];
+
+static bool g_is_restarting = false;
+// A flag per core rather than a mask, each one only written by its core.
+static bool g_is_core_stopping[SMP::MAX_CORES] = {};
+
+static ControlPage* get_control_page() {
+  return (ControlPage*)(NORMAL_MEMORY + PHYSICAL_KEXEC_PAGE);
+}
+
+/** Returns the physical address of @a ptr, into the control page. */
+static PhysicalPA get_control_pa(const void* ptr) {
+  return PHYSICAL_KEXEC_PAGE + ((uintptr_t)ptr - (uintptr_t)get_control_page());
+}
+
+/** Returns the physical address of the kexec code @a symbol, once copied into the control page. */
+static PhysicalPA get_code_pa(const uint8_t* symbol) {
+  return get_control_pa(get_control_page()->code) + (symbol - kexec_blob_start);
+}
+
+static PhysicalPA get_kernel_pgd() {
+  return memory_impl::resolve_table_pgd(*memory_impl::get_kernel_tbl());
+}
+
+static void unload() {
+  for (size_t i = 0; i < g_segment_count; ++i)
+    memory_impl::free_buffer_pa(g_segments[i].source, g_segment_last_pages[i]);
+  g_segment_count = 0;
+}
+
+/** Reads the file at @a path into free memory, as the next segment copied to @a destination. */
+static bool load_segment(const char* path, PhysicalPA destination, size_t max_byte_size) {
+  File* file = FileSystem::get().open(path, SYS_FM_READ);
+  if (file == nullptr) {
+    LOG_ERROR("[Kexec] Failed to open {}", path);
+    return false;
+  }
+
+  const size_t size = file->get_size();
+  const size_t byte_size = libk::align_to_next(size, 16);
+  if (size == 0 || byte_size > max_byte_size) {
+    LOG_ERROR("[Kexec] {} does not fit ({} bytes, at most {})", path, size, max_byte_size);
+    FileSystem::get().close(file);
+    return false;
+  }
+
+  // The images are large: the free pages may have to be compacted first, as for the big buffers.
+  const size_t nb_pages = libk::div_round_up(byte_size, PAGE_SIZE);
+  PhysicalPA start, last_page;
+  if (!memory_impl::allocate_buffer_pa(nb_pages, &start, &last_page) &&
+      (!Buffer::compact(nb_pages) || !memory_impl::allocate_buffer_pa(nb_pages, &start, &last_page))) {
+    LOG_ERROR("[Kexec] No memory to load {} ({} pages)", path, nb_pages);
+    FileSystem::get().close(file);
+    return false;
+  }
+
+  auto* data = (uint8_t*)(NORMAL_MEMORY + start);
+  size_t read_bytes = 0;
+  const bool is_ok = file->read(data, size, &read_bytes) && read_bytes == size;
+  FileSystem::get().close(file);
+  if (!is_ok) {
+    LOG_ERROR("[Kexec] Failed to read {}", path);
+    memory_impl::free_buffer_pa(start, last_page);
+    return false;
+  }
+
+  libk::bzero(data + size, byte_size - size);
+  g_segments[g_segment_count] = {destination, start, byte_size};
+  g_segment_last_pages[g_segment_count] = last_page;
+  ++g_segment_count;
+  return true;
+}
+
+bool load(const char* kernel_path, const char* ramdisk_path) {
+  unload();
+
+  const uint32_t online_cores_mask = SMP::get_online_cores_mask();
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if (i != DEFAULT_CORE && (online_cores_mask & (1u << i)) != 0 &&
+        !SMP::get_enable_method(i, &g_enable_methods[i])) {
+      LOG_ERROR("[Kexec] The core {} can not be stopped", i);
+      return false;
+    }
+  }
+
+  // The device tree and the ramdisk are not moved, the new kernel must end before them.
+  PhysicalPA kernel_end = RAM_FS_PHYSICAL_LOAD_ADDRESS;
+  if (_init_data.dtb_page_start > PHYSICAL_KERNEL_LOAD_ADDRESS)
+    kernel_end = libk::min(kernel_end, _init_data.dtb_page_start);
+
+  if ((ramdisk_path != nullptr && !load_segment(ramdisk_path, RAM_FS_PHYSICAL_LOAD_ADDRESS, RAM_FS_BYTE_SIZE)) ||
+      !load_segment(kernel_path, PHYSICAL_KERNEL_LOAD_ADDRESS, kernel_end - PHYSICAL_KERNEL_LOAD_ADDRESS)) {
+    unload();
+    return false;
+  }
+
+  LOG_INFO("[Kexec] Loaded {} ({} segments)", kernel_path, g_segment_count);
+  return true;
+}
+
+/** Fills the control page, before the cores are stopped. */
+static void prepare_control_page() {
+  ControlPage* page = get_control_page();
+  const size_t code_size = kexec_blob_end - kexec_blob_start;
+  KASSERT(code_size <= MAX_CODE_SIZE);
+  libk::memcpy(page->code, kexec_blob_start, code_size);
+  libk::memcpy(page->segments, g_segments, sizeof(Segment) * g_segment_count);
+  for (auto& flag : page->parked)
+    flag.value = 0;
+  libk::clean_dcache_range(page, sizeof(ControlPage));
+
+  // The parked cores wait for the next kernel to write their entry point.
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if (i == DEFAULT_CORE || (SMP::get_online_cores_mask() & (1u << i)) == 0 ||
+        g_enable_methods[i].kind != SMP::EnableMethod::Kind::SPIN_TABLE)
+      continue;
+
+    auto* release_address = (uint64_t*)(NORMAL_MEMORY + g_enable_methods[i].address);
+    libk::write64((uintptr_t)release_address, 0);
+    libk::clean_dcache_range(release_address, sizeof(uint64_t));
+  }
+}
+
+static bool is_stopping(size_t core_id) {
+  return __atomic_load_n(&g_is_core_stopping[core_id], __ATOMIC_ACQUIRE);
+}
+
+/** Checks if the secondary core @a core_id is parked (or off), it does not access the memory anymore. */
+static bool is_parked(size_t core_id) {
+  const SMP::EnableMethod& method = g_enable_methods[core_id];
+  if (method.kind == SMP::EnableMethod::Kind::PSCI)
+    return SMP::is_core_off(method);
+
+  // Written with the MMU (and so the data cache) off.
+  const auto* flag = &get_control_page()->parked[core_id].value;
+  libk::invalidate_dcache_range(flag, sizeof(uint64_t));
+  return __atomic_load_n(flag, __ATOMIC_ACQUIRE) != 0;
+}
+
+/** Sends an IPI to the cores of @a cores_mask which are not stopping yet. */
+static void interrupt_cores(uint32_t cores_mask) {
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if ((cores_mask & (1u << i)) != 0 && !is_stopping(i))
+      IRQManager::send_ipi(i);
+  }
+}
+
+/** Waits until @a is_done is true for all the cores of @a cores_mask, interrupting them again every millisecond (an
+ * IPI may be taken before the restart is visible). Panics after STOP_TIMEOUT_MS. */
+static void wait_for_cores(uint32_t cores_mask, bool (*is_done)(size_t)) {
+  const uint64_t start = GenericTimer::get_elapsed_time_in_ms();
+  uint64_t last_interrupt = start;
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    while ((cores_mask & (1u << i)) != 0 && !is_done(i)) {
+      const uint64_t now = GenericTimer::get_elapsed_time_in_ms();
+      if (now - start > STOP_TIMEOUT_MS)
+        libk::panic("[Kexec] A core did not stop");
+      if (now != last_interrupt) {
+        interrupt_cores(cores_mask);
+        last_interrupt = now;
+      }
+
+      libk::yield();
+    }
+  }
+}
+
+/** Parks the calling secondary core, once the boot core is stopping too (it may still wait for its IPI). */
+[[noreturn]] static void park_core(size_t core_id) {
+  wait_for_cores(1u << DEFAULT_CORE, &is_stopping);
+
+  const SMP::EnableMethod& method = g_enable_methods[core_id];
+  if (method.kind == SMP::EnableMethod::Kind::PSCI) {
+    SMP::turn_off_core(method);
+    // The boot core panics once its timeout expires.
+    libk::halt();
+  }
+
+  kexec_park(get_kernel_pgd(), get_code_pa(kexec_park_loop), method.address,
+             get_control_pa(&get_control_page()->parked[core_id]));
+}
+
+/** Stops the devices and jumps to the new kernel, once the other cores are parked. */
+[[noreturn]] static void jump_to_new_kernel() {
+  const uint32_t secondary_cores_mask = SMP::get_online_cores_mask() & ~(1u << DEFAULT_CORE);
+  wait_for_cores(secondary_cores_mask, &is_parked);
+
+  // Alone from now on, the drivers expect the kernel lock.
+  KernelLock::acquire();
+  libk::flush_logs();
+  LOG_INFO("[Kexec] Jumping to the new kernel");
+
+  DMA::reset_channels();
+  Ethernet::stop();
+  IRQManager::deactivate_all_irqs();
+
+  const uint64_t start = GenericTimer::get_elapsed_time_in_ms();
+  while (GenericTimer::get_elapsed_time_in_ms() - start <= UART_DRAIN_MS)
+    libk::yield();
+
+  const ControlPage* page = get_control_page();
+  kexec_jump(get_kernel_pgd(), get_code_pa(kexec_relocate), get_control_pa(page->segments), g_segment_count,
+             _init_data.dtb, PHYSICAL_KERNEL_LOAD_ADDRESS);
+}
+
+void restart() {
+  KASSERT(g_segment_count > 0);
+  prepare_control_page();
+  LOG_INFO("[Kexec] Restarting");
+  __atomic_store_n(&g_is_restarting, true, __ATOMIC_RELEASE);
+
+  // The other cores may be waiting for the kernel lock, with their IRQs masked: they take the IPI once it is free.
+  (void)IRQSave::mask_irqs();
+  while (KernelLock::is_owned())
+    KernelLock::release();
+
+  interrupt_cores(SMP::get_online_cores_mask() & ~(1u << SMP::get_core_id()));
+  stop_core();
+}
+
+bool is_restarting() {
+  return __atomic_load_n(&g_is_restarting, __ATOMIC_ACQUIRE);
+}
+
+void stop_core() {
+  (void)IRQSave::mask_irqs();
+  GenericTimer::disarm_physical_timer();
+  GenericTimer::disarm_virtual_timer();
+
+  const size_t core_id = SMP::get_core_id();
+  __atomic_store_n(&g_is_core_stopping[core_id], true, __ATOMIC_SEQ_CST);
+  if (SMP::is_boot_core())
+    jump_to_new_kernel();
+  park_core(core_id);
+}
+}  // namespace Kexec
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The warm restart into another kernel, without going through the firmware (as the Linux kexec): the new kernel
+ * image and ramdisk are read into free memory by load(), then restart() stops the cores and the devices and jumps
+ * to the new kernel as the firmware does, with the same device tree.
+ *
+ * The cores are stopped at their next exception, before they wait for the kernel lock (see stop_core()), so the
+ * restart is started by sending them an IPI with the kernel lock released. The secondary cores are parked as the
+ * next kernel expects them: spinning on their release address with their MMU off, in the kexec page which every
+ * kernel keeps free (PHYSICAL_KEXEC_PAGE), or turned off with PSCI. The boot core then stops the DMA transfers
+ * and the IRQs, turns its MMU off, copies the new images over the old ones (the code doing it runs from the kexec
+ * page too) and jumps to the new kernel.
+ */
+namespace Kexec {
+/** The maximum byte size of the kexec code, copied at the start of the kexec page. */
+static constexpr size_t MAX_CODE_SIZE = 2048;
+/** The time given to the other cores to stop, in milliseconds. */
+static constexpr uint64_t STOP_TIMEOUT_MS = 100;
+
+/**
+ * Reads the kernel image at @a kernel_path and the ramdisk image at @a ramdisk_path (the current ramdisk is kept
+ * if nullptr) into free memory, for restart(). Returns false if a file can not be read or does not fit where it is
+ * loaded by the firmware.
+ */
+[[nodiscard]] bool load(const char* kernel_path, const char* ramdisk_path);
+
+/** Restarts into the kernel read by load(). Must be called with the kernel lock held, it is released. */
+[[noreturn]] void restart();
+
+/** Checks if a restart is in progress: the cores must then call stop_core() at their next exception. */
+[[nodiscard]] bool is_restarting();
+
+/** Stops the calling core for the restart, with the kernel lock not held. */
+[[noreturn]] void stop_core();
+}  // namespace Kexec
@@ -0,0 +1,159 @@
+#include "latency_tracer.hpp"
+#include <libk/assert.hpp>
+#include "hardware/per_core.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "task/scheduler.hpp"
+#include "task/task_manager.hpp"
+
+namespace LatencyTracer {
+struct Stats {
+  uint64_t count;
+  uint64_t total_ticks;
+  uint64_t max_ticks;
+  uintptr_t max_site;
+  uint32_t histogram[SYS_STATS_HISTOGRAM_SIZE];
+};  // struct Stats
+
+struct CoreState {
+  bool is_irqs_off;
+  uint64_t irqs_off_start;
+  uintptr_t irqs_off_site;
+  bool is_preempt_off;
+  uint64_t preempt_off_start;
+  uintptr_t preempt_off_site;
+  Stats stats[(size_t)Kind::COUNT];
+};  // struct CoreState
+
+// Only written by their core, IRQs masked. Not with IRQSave, whose masking is itself traced.
+static PerCore<CoreState> g_cores;
+
+static inline uint64_t mask_irqs() {
+  uint64_t daif;
+  asm volatile("mrs %0, DAIF\n"
+               "msr DAIFSet, #0b0010"
+               : "=r"(daif)
+               :
+               : "memory");
+  return daif;
+}
+
+static inline void restore_irqs(uint64_t daif) {
+  asm volatile("msr DAIF, %0" : : "r"(daif) : "memory");
+}
+
+/** Records a latency of @a ticks at @a site into @a stats, IRQs masked. */
+static void record(Stats& stats, uint64_t ticks, uintptr_t site) {
+  stats.count++;
+  stats.total_ticks += ticks;
+  if (ticks > stats.max_ticks) {
+    stats.max_ticks = ticks;
+    stats.max_site = site;
+  }
+
+  const size_t bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+  stats.histogram[bucket < SYS_STATS_HISTOGRAM_SIZE ? bucket : SYS_STATS_HISTOGRAM_SIZE - 1]++;
+}
+
+[[gnu::noinline]] void irqs_off(uintptr_t site) {
+  CoreState& core = g_cores.get();
+  if (core.is_irqs_off)
+    return;
+
+  core.is_irqs_off = true;
+  core.irqs_off_start = GenericTimer::get_tick_count();
+  core.irqs_off_site = site != 0 ? site : (uintptr_t)__builtin_return_address(0);
+}
+
+void irqs_on() {
+  CoreState& core = g_cores.get();
+  if (!core.is_irqs_off)
+    return;
+
+  core.is_irqs_off = false;
+  record(core.stats[(size_t)Kind::IRQS_OFF], GenericTimer::get_tick_count() - core.irqs_off_start,
+         core.irqs_off_site);
+}
+
+void set_irqs_off_site(uintptr_t site) {
+  CoreState& core = g_cores.get();
+  if (core.is_irqs_off)
+    core.irqs_off_site = site;
+}
+
+[[gnu::noinline]] void preempt_off() {
+  const uint64_t daif = mask_irqs();
+  CoreState& core = g_cores.get();
+  if (!core.is_preempt_off) {
+    core.is_preempt_off = true;
+    core.preempt_off_start = GenericTimer::get_tick_count();
+    core.preempt_off_site = (uintptr_t)__builtin_return_address(0);
+  }
+
+  restore_irqs(daif);
+}
+
+void preempt_on() {
+  const uint64_t daif = mask_irqs();
+  CoreState& core = g_cores.get();
+  if (core.is_preempt_off) {
+    core.is_preempt_off = false;
+    record(core.stats[(size_t)Kind::PREEMPT_OFF], GenericTimer::get_tick_count() - core.preempt_off_start,
+           core.preempt_off_site);
+  }
+
+  restore_irqs(daif);
+}
+
+bool get_stats(Kind kind, sys_syscall_stats_t& stats, uint64_t& max_site) {
+#ifdef CONFIG_LATENCY_TRACER
+  if (kind >= Kind::COUNT)
+    return false;
+
+  // The other cores may update their statistics meanwhile, a slightly stale snapshot is fine.
+  stats = {};
+  max_site = 0;
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    const Stats& core_stats = g_cores.get(i).stats[(size_t)kind];
+    stats.count += core_stats.count;
+    stats.total_ticks += core_stats.total_ticks;
+    if (core_stats.max_ticks > stats.max_ticks) {
+      stats.max_ticks = core_stats.max_ticks;
+      max_site = core_stats.max_site;
+    }
+
+    for (size_t j = 0; j < SYS_STATS_HISTOGRAM_SIZE; ++j)
+      stats.histogram[j] += core_stats.histogram[j];
+  }
+
+  stats.tick_frequency = GenericTimer::get_frequency();
+  return true;
+#else
+  (void)kind;
+  (void)stats;
+  (void)max_site;
+  return false;
+#endif  // CONFIG_LATENCY_TRACER
+}
+
+void start_wakeup_task() {
+  // As cyclictest: the task never takes the kernel lock, it only sleeps and measures.
+  auto task = TaskManager::get().create_kernel_task([]() {
+    const uint64_t period = (WAKEUP_PERIOD * GenericTimer::get_frequency()) / 1'000'000;
+    while (true) {
+      // The deadline of the sleep timer, minus the few ticks of the system call entry.
+      const uint64_t deadline = GenericTimer::get_tick_count() + period;
+      sys_usleep(WAKEUP_PERIOD);
+      const uint64_t now = GenericTimer::get_tick_count();
+
+      const uint64_t daif = mask_irqs();
+      record(g_cores.get().stats[(size_t)Kind::WAKEUP], now > deadline ? now - deadline : 0, 0);
+      restore_irqs(daif);
+    }
+  });
+
+  KASSERT(task != nullptr);
+  TaskManager::get().set_task_priority(task, Scheduler::MAX_PRIORITY);
+  TaskManager::get().wake_task(task);
+}
+}  // namespace LatencyTracer
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "sys/syscall.h"
+
+/**
+ * An in-kernel cyclictest and irqsoff tracer, to validate the scheduling latencies on the real boards.
+ *
+ * A real-time kernel task of the highest priority sleeps periodically, and records how late it runs after
+ * the deadline of its sleep timer (the wakeup latency). The sections run with the IRQs masked (from the
+ * exception entry or the masking of IRQSave, to the exception return or the unmasking) and the sections run
+ * with the preemption disabled (see Task::disable_preempt()) are timed too, each core tracking its own.
+ *
+ * Each kind of latency has a histogram as the system call statistics (see sys_syscall_stats_t), and the call
+ * site of its longest section: a code address (symbolized on the host with addr2line and the kernel ELF), the
+ * system call or IRQ handler for the exceptions. They are read with sys_get_latency_stats().
+ *
+ * The probes (see LATENCY_TRACE()) are only compiled in with CONFIG_LATENCY_TRACER, they can be called from
+ * any context and never take the kernel lock.
+ */
+namespace LatencyTracer {
+/** The kinds of latencies, the same as SYS_LATENCY_WAKEUP and the like. */
+enum class Kind : uint32_t {
+  WAKEUP,
+  IRQS_OFF,
+  PREEMPT_OFF,
+  COUNT,
+};  // enum class Kind
+
+/** The period (in microseconds) of the measurement task. */
+static constexpr uint64_t WAKEUP_PERIOD = 1'000;
+
+/** Starts a section with the IRQs masked on the calling core, at @a site (or at the caller if 0). Nothing is
+ * done if the IRQs were already masked, the outermost section is timed. */
+void irqs_off(uintptr_t site = 0);
+/** Ends the section with the IRQs masked of the calling core, if any. */
+void irqs_on();
+/** Sets the call site of the current section with the IRQs masked (e.g. the system call being run). */
+void set_irqs_off_site(uintptr_t site);
+
+/** Starts a section with the preemption disabled on the calling core, at the caller. */
+void preempt_off();
+/** Ends the section with the preemption disabled of the calling core, if any. */
+void preempt_on();
+
+/** Fills @a stats with the latencies of @a kind of all the cores, and @a max_site with the call site of the
+ * longest one. Returns false if @a kind is unknown or if the tracer is not compiled in. */
+[[nodiscard]] bool get_stats(Kind kind, sys_syscall_stats_t& stats, uint64_t& max_site);
+
+/** Starts the measurement task of the wakeup latency. Requires the task manager. */
+void start_wakeup_task();
+};  // namespace LatencyTracer
+
+#ifdef CONFIG_LATENCY_TRACER
+#define LATENCY_TRACE(probe, ...) ::LatencyTracer::probe(__VA_ARGS__)
+#else
+#define LATENCY_TRACE(probe, ...) ((void)0)
+#endif  // CONFIG_LATENCY_TRACER
@@ -0,0 +1,140 @@
+#include "alloc_profiler.hpp"
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "hardware/timer.hpp"
+
+namespace AllocProfiler {
+static_assert((MAX_SITES & (MAX_SITES - 1)) == 0 && (MAX_ALLOCATIONS & (MAX_ALLOCATIONS - 1)) == 0);
+
+struct Site {
+  SiteStats stats;
+  uint64_t nb_allocs_at_dump;  // nb_allocs at the previous dump, for the allocation rate
+};  // struct Site
+
+struct Allocation {
+  uintptr_t ptr;  // 0 if the entry is free
+  uint32_t byte_size;
+  uint32_t site_index;
+};  // struct Allocation
+
+// Both tables are open addressing hash tables with linear probing.
+static Site g_sites[MAX_SITES];
+static size_t g_nb_sites = 0;
+static Allocation g_allocations[MAX_ALLOCATIONS];
+static size_t g_nb_allocations = 0;
+static uint64_t g_nb_untracked = 0;
+static uint64_t g_last_dump_ms = 0;
+
+static size_t hash(uintptr_t value) {
+  return (size_t)((value >> 4) * UINT64_C(0x9e3779b97f4a7c15) >> 32);
+}
+
+/** Returns the entry of @a site in g_sites, creating it. Returns MAX_SITES if the table is full. */
+static size_t find_site(uintptr_t site) {
+  for (size_t i = hash(site) % MAX_SITES;; i = (i + 1) % MAX_SITES) {
+    if (g_sites[i].stats.site == site)
+      return i;
+
+    if (g_sites[i].stats.site == 0) {
+      // Keep a free entry so the probing always ends.
+      if (g_nb_sites == MAX_SITES - 1)
+        return MAX_SITES;
+
+      g_nb_sites++;
+      g_sites[i].stats.site = site;
+      return i;
+    }
+  }
+}
+
+void record_alloc(void* ptr, size_t byte_size, uintptr_t site) {
+  const size_t site_index = find_site(site);
+  if (site_index == MAX_SITES || g_nb_allocations == MAX_ALLOCATIONS - 1) {
+    g_nb_untracked++;
+    return;
+  }
+
+  size_t i = hash((uintptr_t)ptr) % MAX_ALLOCATIONS;
+  while (g_allocations[i].ptr != 0)
+    i = (i + 1) % MAX_ALLOCATIONS;
+
+  g_allocations[i] = {(uintptr_t)ptr, (uint32_t)byte_size, (uint32_t)site_index};
+  g_nb_allocations++;
+
+  SiteStats& stats = g_sites[site_index].stats;
+  stats.live_byte_size += byte_size;
+  stats.live_count++;
+  stats.peak_byte_size = libk::max(stats.peak_byte_size, stats.live_byte_size);
+  stats.nb_allocs++;
+}
+
+void record_free(void* ptr) {
+  size_t i = hash((uintptr_t)ptr) % MAX_ALLOCATIONS;
+  while (g_allocations[i].ptr != (uintptr_t)ptr) {
+    if (g_allocations[i].ptr == 0)
+      return;  // not tracked
+    i = (i + 1) % MAX_ALLOCATIONS;
+  }
+
+  SiteStats& stats = g_sites[g_allocations[i].site_index].stats;
+  stats.live_byte_size -= g_allocations[i].byte_size;
+  stats.live_count--;
+  stats.nb_frees++;
+  g_nb_allocations--;
+
+  // Backward shift deletion: move back the following entries which would not be found past the hole.
+  size_t hole = i;
+  for (size_t j = (i + 1) % MAX_ALLOCATIONS; g_allocations[j].ptr != 0; j = (j + 1) % MAX_ALLOCATIONS) {
+    const size_t home = hash(g_allocations[j].ptr) % MAX_ALLOCATIONS;
+    // The entry stays if its home is cyclically in (hole, j].
+    const bool stays = hole < j ? (hole < home && home <= j) : (hole < home || home <= j);
+    if (stays)
+      continue;
+
+    g_allocations[hole] = g_allocations[j];
+    hole = j;
+  }
+
+  g_allocations[hole].ptr = 0;
+}
+
+void dump(size_t max_sites) {
+  max_sites = libk::min(max_sites, MAX_DUMPED_SITES);
+
+  // The indices of the sites with the most live bytes, in decreasing order.
+  size_t top[MAX_DUMPED_SITES];
+  size_t nb_top = 0;
+  for (size_t i = 0; i < MAX_SITES; ++i) {
+    if (g_sites[i].stats.site == 0 || g_sites[i].stats.live_byte_size == 0)
+      continue;
+
+    size_t j = libk::min(nb_top, max_sites);
+    for (; j > 0 && g_sites[top[j - 1]].stats.live_byte_size < g_sites[i].stats.live_byte_size; --j) {
+      if (j < max_sites)
+        top[j] = top[j - 1];
+    }
+
+    if (j < max_sites) {
+      top[j] = i;
+      nb_top = libk::min(nb_top + 1, max_sites);
+    }
+  }
+
+  const uint64_t now_ms = GenericTimer::get_elapsed_time_in_ms();
+  const uint64_t elapsed_ms = libk::max<uint64_t>(now_ms - g_last_dump_ms, 1);
+  g_last_dump_ms = now_ms;
+
+  LOG_INFO("[AllocProfiler] {} live allocations in {} sites, {} untracked", g_nb_allocations, g_nb_sites,
+           g_nb_untracked);
+  for (size_t i = 0; i < nb_top; ++i) {
+    const SiteStats& stats = g_sites[top[i]].stats;
+    LOG_INFO("[AllocProfiler] {:#x}: {} bytes live in {} allocations (peak {} bytes), {} allocs/s, {} frees",
+             stats.site, stats.live_byte_size, stats.live_count, stats.peak_byte_size,
+             (g_sites[top[i]].stats.nb_allocs - g_sites[top[i]].nb_allocs_at_dump) * 1000 / elapsed_ms,
+             stats.nb_frees);
+  }
+
+  for (Site& site : g_sites)
+    site.nb_allocs_at_dump = site.stats.nb_allocs;
+}
+}  // namespace AllocProfiler
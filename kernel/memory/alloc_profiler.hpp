@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A profiler of the kernel heap allocations per call site, to find the code whose allocations keep growing.
+ *
+ * Each allocation is recorded with its call site (the return address of kmalloc(), or of the operator new)
+ * in a fixed-size hash table, so the profiler itself never allocates. Each site counts its live bytes and
+ * allocations, its peak of live bytes, and its allocations since the boot. The allocations made while the
+ * table is full are not tracked (and neither are their frees).
+ *
+ * The call sites are code addresses, symbolized on the host with addr2line and the kernel ELF. The profiler
+ * is only compiled in with CONFIG_ALLOC_PROFILER, all the functions must be called with the kernel lock held.
+ */
+namespace AllocProfiler {
+static constexpr size_t MAX_SITES = 1024;
+static constexpr size_t MAX_ALLOCATIONS = 16384;
+/** The maximum count of sites printed by dump(). */
+static constexpr size_t MAX_DUMPED_SITES = 32;
+
+struct SiteStats {
+  uintptr_t site;
+  size_t live_byte_size;
+  size_t live_count;
+  size_t peak_byte_size;
+  // Since the boot.
+  uint64_t nb_allocs;
+  uint64_t nb_frees;
+};  // struct SiteStats
+
+/** Records the allocation of @a byte_size bytes at @a ptr by the call site @a site. */
+void record_alloc(void* ptr, size_t byte_size, uintptr_t site);
+/** Records that @a ptr was freed. */
+void record_free(void* ptr);
+
+/** Logs the @a max_sites sites (at most MAX_DUMPED_SITES) with the most live bytes, with their allocation rate
+ * since the previous dump. */
+void dump(size_t max_sites);
+};  // namespace AllocProfiler
@@ -0,0 +1,106 @@
+#include "asid_allocator.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/string.hpp>
+#include "hardware/smp.hpp"
+
+namespace ASIDAllocator {
+static constexpr size_t NB_ASIDS = 256;
+
+static uint64_t g_generation = 1;
+static uint64_t g_used_asids[NB_ASIDS / 64] = {};
+static size_t g_next_asid = 1;
+
+// The entry active on each core (their ASID is possibly in the TLB and can not be reused yet).
+static Entry* g_active_entries[SMP::MAX_CORES] = {};
+
+static inline bool is_used(size_t asid) {
+  return (g_used_asids[asid / 64] & (1ull << (asid % 64))) != 0;
+}
+
+static inline void set_used(size_t asid, bool used) {
+  if (used)
+    g_used_asids[asid / 64] |= (1ull << (asid % 64));
+  else
+    g_used_asids[asid / 64] &= ~(1ull << (asid % 64));
+}
+
+static inline void invalidate_asid(uint8_t asid) {
+  asm volatile("tlbi aside1is, %0" : : "r"((uint64_t)asid << 48));
+  asm volatile("dsb ish; isb" ::: "memory");
+}
+
+static void start_new_generation() {
+  g_generation++;
+  libk::bzero(g_used_asids, sizeof(g_used_asids));
+  g_next_asid = 1;
+
+  // Keep the ASIDs of the running processes, they are still in use.
+  for (auto* entry : g_active_entries) {
+    if (entry != nullptr) {
+      entry->generation = g_generation;
+      set_used(entry->asid, true);
+    }
+  }
+
+  // The TLB entries of the old generation ASIDs must go away before reusing them.
+  asm volatile("tlbi vmalle1is");
+  asm volatile("dsb ish; isb" ::: "memory");
+}
+
+// Returns a free ASID (searching from the last allocated one), or 0 if there is none.
+static uint8_t find_free_asid() {
+  for (size_t i = 0; i < NB_ASIDS - 1; ++i) {
+    const size_t asid = 1 + (g_next_asid - 1 + i) % (NB_ASIDS - 1);
+    if (!is_used(asid))
+      return asid;
+  }
+
+  return 0;
+}
+
+static uint8_t allocate() {
+  uint8_t asid = find_free_asid();
+  if (asid == 0) {
+    start_new_generation();
+    asid = find_free_asid();
+  }
+
+  // At most one ASID per core is kept across generations.
+  KASSERT(asid != 0);
+
+  set_used(asid, true);
+  g_next_asid = asid + 1;
+  return asid;
+}
+
+uint8_t activate(Entry& entry) {
+  if (entry.generation != g_generation) {
+    entry.asid = allocate();
+    entry.generation = g_generation;
+  }
+
+  g_active_entries[SMP::get_core_id()] = &entry;
+  return entry.asid;
+}
+
+void deactivate() {
+  g_active_entries[SMP::get_core_id()] = nullptr;
+}
+
+void release(Entry& entry) {
+  for (auto*& active_entry : g_active_entries) {
+    if (active_entry == &entry)
+      active_entry = nullptr;
+  }
+
+  if (entry.generation == g_generation) {
+    // The ASID may be reused in the current generation, forget about the old mappings now.
+    invalidate_asid(entry.asid);
+    set_used(entry.asid, false);
+  }
+
+  entry.generation = 0;
+  entry.asid = 0;
+}
+}  // namespace ASIDAllocator
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Allocates the 8-bit ASIDs (Address Space IDs) tagging the process TLB entries, so
+ * context switches do not need to flush the TLB.
+ *
+ * ASIDs are handed out lazily when a process memory is activated. Once they are all
+ * used, a new generation starts: the whole TLB is flushed once and every process gets
+ * a new ASID at its next activation, except those running on a core which keep theirs.
+ *
+ * ASID 0 is never allocated, it is used when no process memory is active.
+ */
+namespace ASIDAllocator {
+struct Entry {
+  uint64_t generation = 0;  // generation 0 is never valid
+  uint8_t asid = 0;
+};  // struct Entry
+
+/** Makes @a entry hold a valid ASID for the current generation and marks it as active on the calling core.
+ * @returns the ASID to program into TTBR0. */
+uint8_t activate(Entry& entry);
+/** Marks that no process memory is active anymore on the calling core. */
+void deactivate();
+/** Releases the ASID of @a entry (its process memory is destroyed), invalidating its TLB entries. */
+void release(Entry& entry);
+};  // namespace ASIDAllocator
@@ -1,30 +1,41 @@
 #include "buffer.hpp"
 #include <algorithm>
+#include <libk/cache.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
 #include "boot/mmu_utils.hpp"
 #include "hardware/mailbox.hpp"
 #include "kernel_internal_memory.hpp"
 #include "process_memory.hpp"
 
-Buffer::Buffer(uint32_t byte_size) {
+libk::IntrusiveList<Buffer, &Buffer::m_hook> Buffer::g_buffers;
+
+Buffer::Buffer(uint32_t byte_size, bool is_mirrored) : m_is_mirrored(is_mirrored) {
   const size_t nb_pages = libk::div_round_up(byte_size, PAGE_SIZE);
-  if (!memory_impl::allocate_buffer_pa(nb_pages, &buffer_pa_start, &buffer_pa_end)) {
+  if (!memory_impl::allocate_buffer_pa(nb_pages, &buffer_pa_start, &buffer_pa_end) &&
+      !(compact(nb_pages) && memory_impl::allocate_buffer_pa(nb_pages, &buffer_pa_start, &buffer_pa_end))) {
     libk::panic("Error Allocating Buffer.");
   }
 
+  link();
+
 //  LOG_DEBUG("We have a Buffer {:#x} -> {:#x}", buffer_pa_start, buffer_pa_end);
-  kernel_va = memory_impl::map_buffer(buffer_pa_start, buffer_pa_end);
+  kernel_va = memory_impl::map_buffer(buffer_pa_start, buffer_pa_end, m_is_mirrored);
 //  LOG_DEBUG("Mapped from {:#x}", kernel_va);
 }
 
 Buffer::~Buffer() {
   // Free all mapping in processes
-  for (const auto proc : _proc) {
+  while (!_proc.is_empty()) {
+    const auto proc = _proc.back();
     proc.proc->unmap_memory(proc.buffer_start);  // <- proc will be removed from the list by the unregister call
   }
 
   KASSERT(_proc.is_empty());
+  KASSERT(!is_pinned());
 
-  memory_impl::unmap_buffer(kernel_va, kernel_va + buffer_pa_end - buffer_pa_start);
+  g_buffers.remove(this);
+  memory_impl::unmap_buffer(kernel_va, end_address(kernel_va));
   memory_impl::free_buffer_pa(buffer_pa_start, buffer_pa_end);
 }
 
@@ -32,6 +43,10 @@ size_t Buffer::get_byte_size() const {
   return buffer_pa_end - buffer_pa_start + PAGE_SIZE;
 }
 
+size_t Buffer::get_mapped_byte_size() const {
+  return m_is_mirrored ? 2 * get_byte_size() : get_byte_size();
+}
+
 void* Buffer::get() const {
   return (void*)kernel_va;
 }
@@ -40,12 +55,22 @@ DMA::Address Buffer::get_dma_address() {
   return DMA::get_dma_bus_address(kernel_va, false);
 }
 
-VirtualPA Buffer::end_address(VirtualPA start_address) {
-  return start_address + get_byte_size() - PAGE_SIZE;
+void Buffer::clean(size_t offset, size_t byte_size) const {
+  KASSERT(offset + byte_size <= get_byte_size());
+  libk::clean_dcache_range((const void*)(kernel_va + offset), byte_size);
 }
 
-void Buffer::register_mapping(ProcessMemory* proc_mem, VirtualPA start_addr) {
-  _proc.emplace_back(start_addr, proc_mem);
+void Buffer::invalidate(size_t offset, size_t byte_size) const {
+  KASSERT(offset + byte_size <= get_byte_size());
+  libk::invalidate_dcache_range((const void*)(kernel_va + offset), byte_size);
+}
+
+VirtualPA Buffer::end_address(VirtualPA start_address) const {
+  return start_address + get_mapped_byte_size() - PAGE_SIZE;
+}
+
+void Buffer::register_mapping(ProcessMemory* proc_mem, VirtualPA start_addr, const PagesAttributes& attributes) {
+  _proc.emplace_back(start_addr, proc_mem, attributes);
 }
 
 void Buffer::unregister_mapping(ProcessMemory* proc_mem) {
@@ -57,3 +82,95 @@ void Buffer::unregister_mapping(ProcessMemory* proc_mem) {
 
   _proc.erase(it);
 }
+
+void Buffer::link() {
+  Buffer* previous = nullptr;
+  for (Buffer* buffer : g_buffers) {
+    if (buffer->buffer_pa_start > buffer_pa_start) {
+      break;
+    }
+
+    previous = buffer;
+  }
+
+  g_buffers.insert_after(previous, this);
+}
+
+void Buffer::move_to(PhysicalPA pa_start, PhysicalPA pa_end) {
+  KASSERT(pa_end - pa_start == buffer_pa_end - buffer_pa_start);
+
+  // The accesses of the processes fault until the buffer is remapped, and the faults wait for the kernel lock.
+  for (const auto& mapping : _proc) {
+    mapping.proc->unmap_buffer_pages(*this, mapping.buffer_start);
+  }
+
+  // The new pages are reached through the linear mapping of the physical memory.
+  libk::memcpy_large((void*)(NORMAL_MEMORY + pa_start), (const void*)kernel_va, get_byte_size());
+
+  memory_impl::free_buffer_pa(buffer_pa_start, buffer_pa_end);
+  buffer_pa_start = pa_start;
+  buffer_pa_end = pa_end;
+
+  // The kernel and process addresses are kept.
+  memory_impl::remap_buffer(kernel_va, end_address(kernel_va), buffer_pa_start, m_is_mirrored);
+  for (const auto& mapping : _proc) {
+    mapping.proc->remap_buffer_pages(*this, mapping.buffer_start, mapping.attributes);
+  }
+
+  g_buffers.remove(this);
+  link();
+}
+
+bool Buffer::compact(size_t nb_pages) {
+  // The ranges are sorted by address, as the buffers.
+  libk::SmallVector<PageAllocList::PageRange, 32> movable;
+  for (const Buffer* buffer : g_buffers) {
+    if (!buffer->is_pinned()) {
+      movable.push_back({buffer->buffer_pa_start, buffer->buffer_pa_end});
+    }
+  }
+
+  PageAllocList* page_alloc = memory_impl::get_kernel_alloc();
+  PhysicalPA block_start, block_end;
+  if (!page_alloc->reserve_compaction_block(nb_pages, movable.begin(), movable.get_size(), &block_start,
+                                            &block_end)) {
+    return false;
+  }
+
+  struct Move {
+    Buffer* buffer;
+    PhysicalPA pa_start;
+    PhysicalPA pa_end;
+  };
+
+  // All the buffers inside the block are moved, or none: their new pages are allocated first.
+  libk::SmallVector<Move, 8> moves;
+  bool is_allocated = true;
+  for (Buffer* buffer : g_buffers) {
+    if (buffer->is_pinned() || buffer->buffer_pa_end < block_start || buffer->buffer_pa_start > block_end) {
+      continue;
+    }
+
+    const size_t nb_buffer_pages = (buffer->buffer_pa_end - buffer->buffer_pa_start) / PAGE_SIZE + 1;
+    Move& move = moves.emplace_back(buffer, 0, 0);
+    if (!memory_impl::allocate_buffer_pa(nb_buffer_pages, &move.pa_start, &move.pa_end)) {
+      moves.pop_back();
+      is_allocated = false;
+      break;
+    }
+  }
+
+  if (is_allocated) {
+    for (const auto& move : moves) {
+      move.buffer->move_to(move.pa_start, move.pa_end);
+    }
+  } else {
+    for (const auto& move : moves) {
+      memory_impl::free_buffer_pa(move.pa_start, move.pa_end);
+    }
+  }
+
+  page_alloc->release_compaction_block(block_start, block_end, movable.begin(), movable.get_size());
+  LOG_DEBUG("Buffer compaction for {} pages: {} buffers moved", nb_pages, is_allocated ? moves.get_size() : 0);
+  return is_allocated;
+}
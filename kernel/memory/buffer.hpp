@@ -2,47 +2,102 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <libk/assert.hpp>
 #include "hardware/dma/dma_controller.hpp"
-#include "libk/linked_list.hpp"
+#include "libk/intrusive_list.hpp"
+#include "libk/small_vector.hpp"
 #include "memory.hpp"
+#include "mmu_table.hpp"
 
 class ProcessMemory;
 
+/**
+ * Physically contiguous memory, mapped in the kernel and possibly in processes (e.g. for the DMA).
+ *
+ * The buffers are movable in physical memory, so the free memory fragmented by their allocations can be
+ * compacted (see compact()): their kernel and process addresses are kept, only their DMA address changes.
+ * A buffer read or written by a running DMA transfer must be pinned meanwhile.
+ *
+ * A mirrored buffer is mapped twice back to back, in the kernel and in the processes: the byte at
+ * `get_byte_size() + i` is the byte `i`. A ring in it can be read or written across its wrap by a single
+ * memcpy(), up to get_byte_size() bytes from any offset below get_byte_size(). The data caches are physically
+ * indexed and tagged, so the two mappings need no maintenance.
+ */
 class Buffer {
  public:
-  /** Creates a memory buffer of @a byte_size bytes. */
-  Buffer(uint32_t byte_size);
+  /** Creates a memory buffer of @a byte_size bytes (rounded up to whole pages), mirrored if @a is_mirrored. If the
+   * physical memory is too fragmented, the other buffers are moved to make room. */
+  Buffer(uint32_t byte_size, bool is_mirrored = false);
 
   /** Free this buffer. */
   ~Buffer();
 
   /** Returns the number of bytes of this buffer. */
   [[nodiscard]] size_t get_byte_size() const;
+  /** Returns the number of bytes of the mappings of this buffer, twice get_byte_size() if it is mirrored. */
+  [[nodiscard]] size_t get_mapped_byte_size() const;
+  [[nodiscard]] bool is_mirrored() const { return m_is_mirrored; }
 
   /** Returns the raw pointer of this buffer.
-   * Reading or Writing before or after the buffer's end is undefined. */
+   * Reading or Writing before or after the buffer's end (its second mapping, if mirrored) is undefined. */
   [[nodiscard]] void* get() const;
 
-  /** Returns the DMA Address of this buffer. */
+  /** Returns the DMA Address of this buffer. It may change when the buffer is not pinned. */
   [[nodiscard]] DMA::Address get_dma_address();
 
+  /** Prevents this buffer from being moved in physical memory until unpin() (calls are counted). */
+  void pin() { ++m_pin_count; }
+  void unpin() {
+    KASSERT(m_pin_count > 0);
+    --m_pin_count;
+  }
+  [[nodiscard]] bool is_pinned() const { return m_pin_count > 0; }
+
+  /**
+   * Compaction of the physical memory, to allocate @a nb_pages contiguous pages when it is too fragmented:
+   * moves the buffers (not pinned) out of the block where they fit. The processes accessing a moved buffer
+   * fault until it is remapped. Must be called with the kernel lock held.
+   * @returns `true` if the pages can now be allocated.
+   */
+  static bool compact(size_t nb_pages);
+
+  /** Writes back the CPU caches of the @a byte_size bytes at @a offset, before a device reads them. */
+  void clean(size_t offset, size_t byte_size) const;
+
+  /** Discards the CPU caches of the @a byte_size bytes at @a offset, after a device wrote them. */
+  void invalidate(size_t offset, size_t byte_size) const;
+
  private:
 //  const size_t nb_pages;
   PhysicalPA buffer_pa_start;
   PhysicalPA buffer_pa_end;
   VirtualPA kernel_va;
+  bool m_is_mirrored;
 
   friend ProcessMemory;
 
   struct ProcessMapped {
-    ProcessMapped(VirtualPA start, ProcessMemory* proc) : buffer_start(start), proc(proc) {}
+    ProcessMapped(VirtualPA start, ProcessMemory* proc, const PagesAttributes& attributes)
+        : buffer_start(start), proc(proc), attributes(attributes) {}
     VirtualPA buffer_start;
     ProcessMemory* proc;
+    PagesAttributes attributes;  // to map the buffer again once moved
   };
 
-  libk::LinkedList<ProcessMapped> _proc;
+  libk::SmallVector<ProcessMapped, 2> _proc;  // usually mapped in a single process
+  size_t m_pin_count = 0;
+  libk::IntrusiveListHook m_hook;
+
+  // All the buffers, sorted by physical address.
+  static libk::IntrusiveList<Buffer, &Buffer::m_hook> g_buffers;
 
-  void register_mapping(ProcessMemory* proc_mem, VirtualPA start_addr);
+  void register_mapping(ProcessMemory* proc_mem, VirtualPA start_addr, const PagesAttributes& attributes);
   void unregister_mapping(ProcessMemory* proc_mem);
-  VirtualPA end_address(VirtualPA start_address);
+  VirtualPA end_address(VirtualPA start_address) const;
+
+  /** Inserts this buffer into g_buffers, at the position of its physical address. */
+  void link();
+  /** Moves the content of this buffer to the physical pages from @a pa_start to @a pa_end, and frees its old
+   * pages. */
+  void move_to(PhysicalPA pa_start, PhysicalPA pa_end);
 };
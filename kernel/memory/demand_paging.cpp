@@ -0,0 +1,208 @@
+#include "demand_paging.hpp"
+
+#include <libk/string.hpp>
+#include "boot/mmu_utils.hpp"
+#include "memory/kernel_internal_memory.hpp"
+#include "memory/zram.hpp"
+
+namespace DemandPaging {
+static PhysicalPA g_zeroed_pages[POOL_SIZE];
+static size_t g_nb_zeroed_pages = 0;
+
+bool fresh_zeroed_page(PhysicalPA* pa) {
+  if (g_nb_zeroed_pages > 0) {
+    *pa = g_zeroed_pages[--g_nb_zeroed_pages];
+    return true;
+  }
+
+  // The pool is empty, zero the page now.
+  if (!memory_impl::get_kernel_alloc()->fresh_page(pa)) {
+    return false;
+  }
+
+  zero_pages(*pa + KERNEL_BASE, 1);
+  return true;
+}
+
+bool map_zeroed_page(MMUTable* table, VirtualPA va, PagesAttributes attr) {
+  PhysicalPA pa;
+  if (!fresh_zeroed_page(&pa)) {
+    return false;
+  }
+
+  if (!map_range(table, va, va, pa, attr)) {
+    memory_impl::get_kernel_alloc()->free_page(pa);
+    return false;
+  }
+
+  return true;
+}
+
+/** Maps a new page at @a va with @a attr, holding the content of the paged out page @a swap_id. */
+static bool page_in(MMUTable* table, VirtualPA va, uint64_t swap_id, PagesAttributes attr) {
+  PhysicalPA pa;
+  if (!memory_impl::get_kernel_alloc()->fresh_page(&pa)) {
+    return false;
+  }
+
+  Zram::load(swap_id, pa);
+
+  // Overwrites the swap entry.
+  if (!map_range(table, va, va, pa, attr)) {
+    memory_impl::get_kernel_alloc()->free_page(pa);
+    return false;
+  }
+
+  Zram::free(swap_id);
+  return true;
+}
+
+bool fault_in_page(MMUTable* table, VirtualPA va, PagesAttributes attr) {
+  uint64_t swap_id;
+  if (get_swap_entry(table, va, &swap_id)) {
+    return page_in(table, va, swap_id, attr);
+  }
+
+  return map_zeroed_page(table, va, attr);
+}
+
+/** Moves the page @a pa mapped at @a va into the Zram store. Returns the count of bytes freed. */
+static size_t page_out(MMUTable* table, VirtualPA va, PhysicalPA pa, PagesAttributes attr) {
+  // Unmapped before being compressed, the other cores running the process must not write to it meanwhile
+  // (their faults wait for the kernel lock).
+  if (!unmap_range(table, va, va)) {
+    return 0;
+  }
+
+  const uint64_t swap_id = Zram::store(pa);
+  if (swap_id == 0 || !set_swap_entry(table, va, swap_id)) {
+    if (swap_id != 0) {
+      Zram::free(swap_id);
+    }
+
+    if (!map_range(table, va, va, pa, attr)) {
+      libk::panic("[DemandPaging] Unable to map back a page.");
+    }
+
+    return 0;
+  }
+
+  memory_impl::get_kernel_alloc()->free_page(pa, true);
+  return PAGE_SIZE - Zram::get_byte_size(swap_id);
+}
+
+size_t page_out_cold_pages(MMUTable* table, VirtualPA start, VirtualPA end, size_t byte_size) {
+  PageAllocList* alloc = memory_impl::get_kernel_alloc();
+
+  size_t freed_byte_size = 0;
+  for (VirtualPA va = start; va < end && freed_byte_size < byte_size; va += PAGE_SIZE) {
+    PhysicalPA pa;
+    PagesAttributes attr;
+    if (!get_pa(table, va, &pa) || !get_attr(table, va, &attr) || attr.rw == ReadWritePermission::ReadOnly ||
+        alloc->is_shared(pa)) {
+      continue;
+    }
+
+    bool was_accessed;
+    if (!test_and_clear_access_flag(table, va, &was_accessed) || was_accessed) {
+      continue;
+    }
+
+    freed_byte_size += page_out(table, va, pa, attr);
+  }
+
+  return freed_byte_size;
+}
+
+bool release_range(MMUTable* table, VirtualPA start, VirtualPA end) {
+  for (VirtualPA va = start; va < end; va += PAGE_SIZE) {
+    PhysicalPA pa;
+    if (!get_pa(table, va, &pa)) {
+      uint64_t swap_id;
+      if (get_swap_entry(table, va, &swap_id)) {
+        clear_swap_entry(table, va);
+        Zram::free(swap_id);
+      }
+
+      continue;  // never touched, or paged out
+    }
+
+    if (!unmap_range(table, va, va)) {
+      return false;
+    }
+
+    memory_impl::get_kernel_alloc()->free_page(pa);
+  }
+
+  return true;
+}
+
+bool share_range(MMUTable* from, MMUTable* to, VirtualPA start, VirtualPA end, PagesAttributes read_only_attr) {
+  for (VirtualPA va = start; va < end; va += PAGE_SIZE) {
+    PhysicalPA pa;
+    if (!get_pa(from, va, &pa)) {
+      uint64_t swap_id;
+      if (!get_swap_entry(from, va, &swap_id)) {
+        continue;  // never touched
+      }
+
+      // Both processes could page it in, but the compressed copy can only have a single owner.
+      if (!page_in(from, va, swap_id, read_only_attr) || !get_pa(from, va, &pa)) {
+        return false;
+      }
+    }
+
+    if (!map_range(to, va, va, pa, read_only_attr)) {
+      return false;
+    }
+
+    memory_impl::get_kernel_alloc()->share_page(pa);
+
+    if (!change_attr_range(from, va, va, read_only_attr)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool copy_on_write(MMUTable* table, VirtualPA va, PhysicalPA pa, bool is_owned, PagesAttributes attr) {
+  PageAllocList* alloc = memory_impl::get_kernel_alloc();
+  if (is_owned && !alloc->is_shared(pa)) {
+    // The other owners have already made their own copy.
+    return change_attr_range(table, va, va, attr);
+  }
+
+  PhysicalPA copy_pa;
+  if (!alloc->fresh_page(&copy_pa)) {
+    return false;
+  }
+
+  libk::memcpy((void*)(copy_pa + KERNEL_BASE), (const void*)(pa + KERNEL_BASE), PAGE_SIZE);
+
+  if (!map_range(table, va, va, copy_pa, attr)) {
+    alloc->free_page(copy_pa);
+    return false;
+  }
+
+  if (is_owned) {
+    alloc->free_page(pa);  // only removes this mapping from the owners
+  }
+
+  return true;
+}
+
+bool refill_pool() {
+  for (size_t i = 0; i < POOL_REFILL_BATCH && g_nb_zeroed_pages < POOL_SIZE; ++i) {
+    PhysicalPA pa;
+    if (!memory_impl::get_kernel_alloc()->fresh_page(&pa)) {
+      return true;
+    }
+
+    zero_pages(pa + KERNEL_BASE, 1);
+    g_zeroed_pages[g_nb_zeroed_pages++] = pa;
+  }
+
+  return g_nb_zeroed_pages == POOL_SIZE;
+}
+}  // namespace DemandPaging
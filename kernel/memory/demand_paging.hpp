@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "memory/mmu_table.hpp"
+
+/**
+ * Support for the demand paged regions of the process memories (heap and stack).
+ *
+ * Such regions are only reserved: their pages are mapped when first touched, on the translation
+ * fault raised by the access. The mapped pages are taken from a pool of pre-zeroed pages, refilled
+ * by the idle cores, so the fault is cheap and the process never sees stale data. The kernel heap grows
+ * with the pages of this pool too (see fresh_zeroed_page()).
+ *
+ * The pages can also be shared (read-only) between processes. The first write to a shared page
+ * raises a permission fault, and the writer gets its own copy (copy-on-write).
+ *
+ * Under memory pressure, the cold pages (not accessed for a while, see page_out_cold_pages()) are compressed
+ * into the Zram store and unmapped, their page table entry keeping their ID. They are decompressed back on
+ * the translation fault raised by their next access (see fault_in_page()).
+ */
+namespace DemandPaging {
+/** Maximum count of pre-zeroed pages kept in the pool. */
+static constexpr size_t POOL_SIZE = 64;
+/** Count of pages zeroed by each call to refill_pool(). */
+static constexpr size_t POOL_REFILL_BATCH = 8;
+
+/** Allocates a zeroed page, taken from the pool if it is not empty (otherwise it is zeroed now).
+ * @returns `false` if out of memory. */
+[[nodiscard]] bool fresh_zeroed_page(PhysicalPA* pa);
+
+/** Maps a zeroed page at the page aligned virtual address @a va with the attributes @a attr.
+ * @returns `false` if out of memory or if the mapping failed. */
+[[nodiscard]] bool map_zeroed_page(MMUTable* table, VirtualPA va, PagesAttributes attr);
+
+/** Maps the page at the page aligned virtual address @a va with the attributes @a attr, after a translation
+ * fault: its content is loaded back if it was paged out, otherwise the page is zeroed.
+ * @returns `false` if out of memory or if the mapping failed. */
+[[nodiscard]] bool fault_in_page(MMUTable* table, VirtualPA va, PagesAttributes attr);
+
+/**
+ * Pages out the cold pages mapped between the page aligned addresses @a start and @a end (excluded), until
+ * @a byte_size bytes are freed. A page is cold if it was not accessed since the previous call: the access flag
+ * of each page is cleared as it is checked (the second chance of the clock algorithm). The read-only pages,
+ * shared with copy-on-write, are skipped.
+ * @returns the count of bytes freed (the page minus its compressed size).
+ */
+size_t page_out_cold_pages(MMUTable* table, VirtualPA start, VirtualPA end, size_t byte_size);
+
+/** Unmaps and frees the pages mapped between the page aligned addresses @a start and @a end (excluded), the
+ * paged out ones included. Pages not mapped yet are skipped. */
+[[nodiscard]] bool release_range(MMUTable* table, VirtualPA start, VirtualPA end);
+
+/** Shares the pages mapped in @a from between @a start and @a end (excluded) with @a to, at the same
+ * addresses. The pages are mapped read-only with @a read_only_attr in both tables, for copy-on-write.
+ * The paged out pages are loaded back first. */
+[[nodiscard]] bool share_range(MMUTable* from,
+                               MMUTable* to,
+                               VirtualPA start,
+                               VirtualPA end,
+                               PagesAttributes read_only_attr);
+
+/** Handles a write to the read-only page @a pa mapped at @a va, by mapping a copy of it with @a attr.
+ * If @a is_owned, the page belongs to the mapping (otherwise it is owned by someone else, e.g. a
+ * cached file segment), and is simply made writable if this mapping is its last owner. */
+[[nodiscard]] bool copy_on_write(MMUTable* table, VirtualPA va, PhysicalPA pa, bool is_owned, PagesAttributes attr);
+
+/** Zeroes some pages for the pool, to be called when the core is idle.
+ * @returns `true` if there is nothing more to do (the pool is full or the memory is exhausted). */
+bool refill_pool();
+};  // namespace DemandPaging
@@ -1,7 +1,9 @@
 #include "memory/heap_manager.hpp"
 #include <libk/log.hpp>
+#include <libk/utils.hpp>
 #include "boot/mmu_utils.hpp"
 #include "kernel_internal_memory.hpp"
+#include "memory/demand_paging.hpp"
 
 static inline constexpr PagesAttributes kernel_rw_memory = {.sh = Shareability::InnerShareable,
                                                             .exec = ExecutionPermission::NeverExecute,
@@ -23,61 +25,42 @@ HeapManager::HeapManager(HeapManager::Kind kind, MMUTable* table)
       _tbl(table) {}
 
 VirtualAddress HeapManager::change_heap_end(long byte_offset) {
+  const VirtualAddress old_heap_end = libk::align_to_next(get_heap_end(), PAGE_SIZE);
   _heap_byte_size += byte_offset;
 
-  while (_heap_va_end < get_heap_end()) {
-    // Increase heap here.
-    PhysicalPA new_heap_pa_page = -1;
+  if (_heap_kind == Kind::Process) {
+    // Process heaps are demand paged: the pages are only mapped when first touched (see handle_page_fault()).
+    if (!DemandPaging::release_range(_tbl, libk::align_to_next(get_heap_end(), PAGE_SIZE), old_heap_end)) {
+      return 0;
+    }
 
-    if (!memory_impl::get_kernel_alloc()->fresh_page(&new_heap_pa_page)) {
+    return get_heap_end();
+  }
+
+  while (_heap_va_end < get_heap_end()) {
+    // Increase heap here, with the pages zeroed in advance by the idle cores (see DemandPaging::refill_pool()).
+    PhysicalPA new_heap_pa;
+    if (!DemandPaging::fresh_zeroed_page(&new_heap_pa)) {
       return 0;
     }
 
-    switch (_heap_kind) {
-      case Kind::Process: {
-        if (!map_range(_tbl, _heap_va_end, _heap_va_end, new_heap_pa_page, process_rw_memory)) {
-          return 0;
-        }
-
-        _allocated_pa.push_back(new_heap_pa_page);
-        break;
-      }
-      case Kind::Kernel: {
-        if (!map_range(_tbl, _heap_va_end, _heap_va_end, new_heap_pa_page, kernel_rw_memory)) {
-          return 0;
-        }
-        break;
-      }
+    if (!map_range(_tbl, _heap_va_end, _heap_va_end, new_heap_pa, kernel_rw_memory)) {
+      memory_impl::get_kernel_alloc()->free_page(new_heap_pa);
+      return 0;
     }
 
-    zero_pages(_heap_va_end, 1);
     _heap_va_end += PAGE_SIZE;
   }
 
   while (_heap_va_end - PAGE_SIZE >= get_heap_end()) {
-    // Decrease heap here.
-
+    // Decrease heap here. The pages are zeroed when allocated, not when freed.
     const VirtualPA va_to_del = _heap_va_end - PAGE_SIZE;
-    PhysicalPA pa_to_del;
-    zero_pages(va_to_del, 1);
-
-    switch (_heap_kind) {
-      case Kind::Process: {
-        pa_to_del = _allocated_pa.pop_back();
-        break;
-      }
-      case Kind::Kernel: {
-        pa_to_del = memory_impl::resolve_kernel_va(va_to_del, false);
-        break;
-      }
-      default: {
-        libk::panic("Unknown heap kind.");
-      }
-    }
+    const PhysicalPA pa_to_del = memory_impl::resolve_kernel_va(va_to_del, false);
 
     if (!unmap_range(_tbl, va_to_del, va_to_del)) {
       return 0;
     }
+    memory_impl::invalidate_translations();
 
     memory_impl::get_kernel_alloc()->free_page(pa_to_del);
 
@@ -87,6 +70,33 @@ VirtualAddress HeapManager::change_heap_end(long byte_offset) {
   return get_heap_end();
 }
 
+bool HeapManager::handle_page_fault(VirtualAddress va) {
+  if (_heap_kind != Kind::Process || !contains(va)) {
+    return false;
+  }
+
+  const VirtualPA page_va = libk::align_to_previous(va, PAGE_SIZE);
+
+  // The page may have been mapped meanwhile by another thread of the process.
+  PhysicalPA pa;
+  if (get_pa(_tbl, page_va, &pa)) {
+    return true;
+  }
+
+  return DemandPaging::fault_in_page(_tbl, page_va, process_rw_memory);
+}
+
+bool HeapManager::fork_into(HeapManager& child) const {
+  KASSERT(_heap_kind == Kind::Process && child._heap_kind == Kind::Process && child._heap_byte_size == 0);
+
+  child._heap_byte_size = _heap_byte_size;
+
+  PagesAttributes read_only_memory = process_rw_memory;
+  read_only_memory.rw = ReadWritePermission::ReadOnly;
+  return DemandPaging::share_range(_tbl, child._tbl, _heap_start, libk::align_to_next(get_heap_end(), PAGE_SIZE),
+                                   read_only_memory);
+}
+
 VirtualAddress HeapManager::get_heap_end() const {
   return _heap_start + get_heap_byte_size();
 }
@@ -96,32 +106,30 @@ size_t HeapManager::get_heap_byte_size() const {
 }
 
 void HeapManager::free() {
-  while (_heap_byte_size > 0) {
-    const VirtualPA va_to_del = get_heap_end() - PAGE_SIZE;
-    PhysicalPA pa_to_del;
-
-    switch (_heap_kind) {
-      case Kind::Process: {
-        pa_to_del = _allocated_pa.pop_back();
-        break;
-      }
-      case Kind::Kernel: {
-        pa_to_del = memory_impl::resolve_kernel_va(va_to_del, false);
-        break;
-      }
-      default: {
-        libk::panic("Unknown heap kind.");
-      }
+  if (_heap_kind == Kind::Process) {
+    if (!DemandPaging::release_range(_tbl, _heap_start, libk::align_to_next(get_heap_end(), PAGE_SIZE))) {
+      libk::panic("[HeapManager] Unable to free heap.");
     }
 
+    _heap_byte_size = 0;
+    return;
+  }
+
+  while (_heap_va_end > _heap_start) {
+    const VirtualPA va_to_del = _heap_va_end - PAGE_SIZE;
+    const PhysicalPA pa_to_del = memory_impl::resolve_kernel_va(va_to_del, false);
+
     if (!unmap_range(_tbl, va_to_del, va_to_del)) {
       libk::panic("[HeapManager] Unable to free heap.");
     }
+    memory_impl::invalidate_translations();
 
     memory_impl::get_kernel_alloc()->free_page(pa_to_del);
 
-    _heap_byte_size -= PAGE_SIZE;
+    _heap_va_end -= PAGE_SIZE;
   }
+
+  _heap_byte_size = 0;
 }
 
 VirtualAddress HeapManager::get_heap_start() const {
@@ -2,7 +2,6 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <libk/linked_list.hpp>
 
 #include "memory/memory.hpp"
 #include "memory/page_alloc_list.hpp"
@@ -15,6 +14,16 @@ class HeapManager {
 
   VirtualAddress change_heap_end(long byte_offset);
 
+  /** Maps the page containing @a va if it is in a process heap but not mapped yet.
+   * @returns `true` if the page is now mapped (the faulting access can be retried). */
+  bool handle_page_fault(VirtualAddress va);
+
+  /** Checks if @a va is inside the (reserved) heap. */
+  [[nodiscard]] bool contains(VirtualAddress va) const { return va >= _heap_start && va < get_heap_end(); }
+
+  /** Makes @a child (an empty process heap) a copy-on-write copy of this process heap. */
+  [[nodiscard]] bool fork_into(HeapManager& child) const;
+
   VirtualAddress get_heap_end() const;
 
   VirtualAddress get_heap_start() const;
@@ -30,6 +39,4 @@ class HeapManager {
   VirtualAddress _heap_va_end = 0;
   size_t _heap_byte_size = 0;
   MMUTable* _tbl = nullptr;
-
-  libk::LinkedList<PhysicalPA> _allocated_pa;
 };
@@ -3,9 +3,10 @@
 #include <libk/assert.hpp>
 #include <libk/utils.hpp>
 #include "boot/mmu_utils.hpp"
-#include "contiguous_page_alloc.hpp"
 #include "fs/fat/ramdisk.hpp"
+#include "hardware/irq_save.hpp"
 #include "hardware/kernel_dt.hpp"
+#include "hardware/smp.hpp"
 #include "libk/log.hpp"
 
 static inline constexpr PagesAttributes custom_memory_rw = {.sh = Shareability::InnerShareable,
@@ -14,27 +15,45 @@ static inline constexpr PagesAttributes custom_memory_rw = {.sh = Shareability::
                                                             .access = Accessibility::Privileged,
                                                             .type = MemoryType::Normal};
 
+// The buffers are drawn into by the CPU, so they are cacheable: the DMA coherency is kept by Buffer::clean()
+// and Buffer::invalidate().
 static inline constexpr PagesAttributes buffer_memory_rw = {.sh = Shareability::OuterShareable,
                                                             .exec = ExecutionPermission::NeverExecute,
                                                             .rw = ReadWritePermission::ReadWrite,
                                                             .access = Accessibility::Privileged,
-                                                            .type = MemoryType::Device_nGnRnE};
-
-static inline constexpr size_t reserved_contiguous_size = 100 * 1024 * 1024;  // 100 Mio.
+                                                            .type = MemoryType::Normal};
 
 static libk::LinearAllocator _mem_alloc;
 static PageAllocList _page_alloc;
 
-static ContiguousPageAllocator _contiguous_alloc;
-
-static PhysicalPA _contiguous_start = 0;
-static PhysicalPA _contiguous_stop = 0;
-
 static MMUTable _tbl;
 
+// The zeroed pages reused by mmu_alloc_page(): the freed tables (the page tables of an exited process are enough
+// for the next one), topped up by the idle cores (see refill_table_cache()). Building the tables of a new process,
+// or of a new mapping, then never zeroes pages. Protected by the kernel lock, as the page tables.
+static constexpr size_t TABLE_CACHE_SIZE = 64;
+static constexpr size_t TABLE_CACHE_REFILL_TARGET = 16;
+static VirtualPA _zeroed_tables[TABLE_CACHE_SIZE];
+static size_t _nb_zeroed_tables = 0;
+
 static VirtualPA _custom_pages = CUSTOM_PAGES_MEMORY;
 static VirtualPA _buffer_pages = BUFFER_MEMORY;
 
+/** A translation cached by try_resolve_kernel_va(), valid while its generation is the current one. */
+struct CachedTranslation {
+  VirtualPA va_page;
+  PhysicalPA pa_page;
+  uint64_t generation;
+  bool writable;
+};  // struct CachedTranslation
+
+// A direct-mapped cache of the kernel translations per core (indexed by the VA page), so the heap and the DMA
+// control blocks and buffers are not translated by the MMU each time. A core only touches its own entries, IRQs
+// masked, and the unmappings invalidate all of them at once by changing the generation.
+static constexpr size_t TRANSLATION_CACHE_SIZE = 64;
+static CachedTranslation _translation_cache[SMP::MAX_CORES][TRANSLATION_CACHE_SIZE];
+static uint64_t _translation_generation = 1;
+
 VirtualPA mmu_resolve_pa(void*, PhysicalPA page_address) {
   return page_address + KERNEL_BASE;
 }
@@ -44,6 +63,10 @@ PhysicalPA mmu_resolve_va(void*, VirtualPA page_address) {
 }
 
 VirtualPA mmu_alloc_page(void*) {
+  if (_nb_zeroed_tables > 0) {
+    return _zeroed_tables[--_nb_zeroed_tables];
+  }
+
   PhysicalPA addr = -1;
 
   if (!_page_alloc.fresh_page(&addr)) {
@@ -57,24 +80,18 @@ VirtualPA mmu_alloc_page(void*) {
 }
 
 void mmu_free_page(void*, VirtualPA page_address) {
+  // A table is only freed once all its entries are cleared, it is still zeroed.
+  if (_nb_zeroed_tables < TABLE_CACHE_SIZE) {
+    _zeroed_tables[_nb_zeroed_tables++] = page_address;
+    return;
+  }
+
   const PhysicalPA addr = mmu_resolve_va(nullptr, page_address);
 
   _page_alloc.free_page(addr);
 }
 
 void mark_as_used_range(PhysicalPA start, PhysicalPA end) {
-  if (start >= end) {
-    return;
-  }
-
-  if (end > _contiguous_start && start < _contiguous_stop) {
-    // We have an intersection in contiguous allocator.
-    const auto page_start = libk::max(start, _contiguous_start) - _contiguous_start;
-    const auto page_stop = libk::min(end, _contiguous_stop) - _contiguous_start;
-
-    _contiguous_alloc.mark_as_used(page_start, libk::div_round_up(page_stop - page_start + 1, PAGE_SIZE));
-  }
-
   _page_alloc.mark_as_used_range(start, end);
 }
 
@@ -91,34 +108,13 @@ bool memory_impl::init() {
     _mem_alloc = libk::LinearAllocator(linear_alloc_memory, linear_allocator_size * PAGE_SIZE);
   }
 
-  /* Set up the PageAllocList */
-  _page_alloc = PageAllocList(_mem_alloc, reserved_contiguous_size);
-
-  /* Set up the ContiguousPageAllocator */
-  {
-    _contiguous_start = _page_alloc.get_reserved_start();
-    _contiguous_stop = _page_alloc.get_reserved_stop();
-
-    if (_contiguous_start + reserved_contiguous_size > _contiguous_stop) {
-      return false;  // reservation failed.
-    }
-
-    const size_t nb_pages = libk::div_round_down(_contiguous_stop - _contiguous_start + 1, PAGE_SIZE);
-    const size_t nb_used_page = libk::div_round_up(ContiguousPageAllocator::memory_needed(nb_pages), PAGE_SIZE);
-
-    PhysicalPA contiguous_physical_memory;
-    if (!allocate_pages(_lin_alloc, nb_used_page, &contiguous_physical_memory)) {
-      return false;
-    }
-
-    const uintptr_t contiguous_memory = (contiguous_physical_memory + KERNEL_BASE);
-    _contiguous_alloc = ContiguousPageAllocator(nb_pages, contiguous_memory);
-  }
+  /* Set up the PageAllocList (it also serves the contiguous buffers) */
+  _page_alloc = PageAllocList(_mem_alloc);
 
   // Protect the Stack, Kernel, DeviceTree, Page Allocator Memory, MMU Allocated Memory & Reserved Memory.
   {
-    // Stack
-    mark_as_used_range(PHYSICAL_STACK_TOP, PHYSICAL_STACK_TOP + KERNEL_STACK_SIZE);
+    // Stacks (one per core), and the kexec page below them
+    mark_as_used_range(PHYSICAL_KEXEC_PAGE, PHYSICAL_STACK_TOP + KERNEL_STACK_SIZE);
 
     // Kernel
     mark_as_used_range(_init_data.kernel_start, _init_data.kernel_stop);
@@ -184,25 +180,55 @@ PhysicalPA memory_impl::resolve_table_pgd(const MMUTable& tbl) {
   return mmu_resolve_va(nullptr, tbl.pgd);
 }
 
+bool memory_impl::refill_table_cache() {
+  // Only a part of the cache is filled in advance, the rest is left for the tables freed by the processes.
+  if (_nb_zeroed_tables >= TABLE_CACHE_REFILL_TARGET) {
+    return true;
+  }
+
+  PhysicalPA addr;
+  if (!_page_alloc.fresh_page(&addr)) {
+    return true;
+  }
+
+  const VirtualPA va = mmu_resolve_pa(nullptr, addr);
+  zero_pages(va, 1);
+  _zeroed_tables[_nb_zeroed_tables++] = va;
+  return _nb_zeroed_tables >= TABLE_CACHE_REFILL_TARGET;
+}
+
+size_t memory_impl::shrink_table_cache(size_t byte_size) {
+  size_t freed_byte_size = 0;
+  while (_nb_zeroed_tables > 0 && freed_byte_size < byte_size) {
+    _page_alloc.free_page(mmu_resolve_va(nullptr, _zeroed_tables[--_nb_zeroed_tables]));
+    freed_byte_size += PAGE_SIZE;
+  }
+
+  return freed_byte_size;
+}
+
 void memory_impl::delete_process_tbl(MMUTable& tbl) {
   clear_all(&tbl);
   mmu_free_page(nullptr, tbl.pgd);
   tbl.pgd = 0;
 }
 
-VirtualPA memory_impl::allocate_pages_section(const size_t nb_pages, PhysicalPA* pages_ptr) {
+VirtualPA memory_impl::allocate_pages_section(const size_t nb_pages, PhysicalPA* pages_ptr, bool is_zeroed) {
   const VirtualPA section_start = _custom_pages;
 
+  if (!_page_alloc.fresh_pages(nb_pages, pages_ptr)) {
+    return 0;
+  }
+
   for (size_t page_id = 0; page_id < nb_pages; ++page_id) {
-    if (!_page_alloc.fresh_page(&(pages_ptr[page_id]))) {
+    if (!map_range(&_tbl, _custom_pages, _custom_pages, pages_ptr[page_id], custom_memory_rw)) {
       return 0;
     }
 
-    if (!map_range(&_tbl, _custom_pages, _custom_pages, pages_ptr[page_id], custom_memory_rw)) {
-      return 0;
+    if (is_zeroed) {
+      zero_pages(_custom_pages, 1);
     }
 
-    zero_pages(_custom_pages, 1);
     _custom_pages += PAGE_SIZE;
   }
 
@@ -217,62 +243,106 @@ void memory_impl::free_section(size_t nb_pages, VirtualPA kernel_va, PhysicalPA*
     libk::panic("Failed to free a custom memory chunk!");
   }
 
-  for (size_t page_id = 0; page_id < nb_pages; ++page_id) {
-    _page_alloc.free_page(pages_ptr[page_id]);
-  }
+  invalidate_translations();
+
+  _page_alloc.free_pages(nb_pages, pages_ptr);
 }
 
 PhysicalPA memory_impl::resolve_kernel_va(VirtualAddress va, bool read_only) {
+  PhysicalPA pa;
+  if (!try_resolve_kernel_va(va, read_only, &pa)) {
+    libk::panic("[MemoryImpl] Unable to resolve physical address.");
+  }
+
+  return pa;
+}
+
+bool memory_impl::try_resolve_kernel_va(VirtualAddress va, bool read_only, PhysicalPA* pa) {
+  // The linear map covers all the RAM read-write, except the kernel image and the device tree which are never
+  // given to a device to write.
+  if (va >= NORMAL_MEMORY && va < VC_MEMORY) {
+    *pa = va - KERNEL_BASE;
+    return true;
+  }
+
+  const VirtualPA va_page = libk::align_to_previous(va, PAGE_SIZE);
+  const size_t index = (va_page / PAGE_SIZE) % TRANSLATION_CACHE_SIZE;
+
+  const uint64_t daif = IRQSave::mask_irqs();
+  CachedTranslation& entry = _translation_cache[SMP::get_core_id()][index];
+  // Read before the translation: if the range is unmapped meanwhile, the entry is stale as soon as filled.
+  const uint64_t generation = __atomic_load_n(&_translation_generation, __ATOMIC_ACQUIRE);
+  if (entry.generation == generation && entry.va_page == va_page && (read_only || entry.writable)) {
+    *pa = entry.pa_page | (va & (PAGE_SIZE - 1));
+    IRQSave::restore_irqs(daif);
+    return true;
+  }
+
   if (read_only) {
     asm volatile("at s1e1r, %x0" ::"r"(va));
   } else {
     asm volatile("at s1e1w, %x0" ::"r"(va));
   }
   uint64_t par_el1;
-  asm volatile("mrs %x0, PAR_EL1" : "=r"(par_el1));
+  asm volatile("isb\n\tmrs %x0, PAR_EL1" : "=r"(par_el1));
 
   if (par_el1 & 0x1) {
-    libk::panic("[MemoryImpl] Unable to resolve physical address.");
-  }
-
-  return (par_el1 & libk::mask_bits(12, 47)) | (va & libk::mask_bits(1, 11));
-}
-
-bool memory_impl::allocate_buffer_pa(size_t nb_pages, PhysicalPA* buffer_start, PhysicalPA* buffer_end) {
-  if (!_contiguous_alloc.fresh_pages(nb_pages, buffer_start, buffer_end)) {
+    IRQSave::restore_irqs(daif);
     return false;
   }
 
-  //  LOG_DEBUG("Allocated {:#x} -> {:#x}", *buffer_start, *buffer_end);
-  //  LOG_DEBUG("Offset {:#x}", _contiguous_start);
+  const PhysicalPA pa_page = par_el1 & libk::mask_bits(12, 47);
+  // A write translation is also a read one, but the read ones say nothing about the write permission.
+  if (entry.generation != generation || entry.va_page != va_page || !read_only) {
+    entry = {.va_page = va_page, .pa_page = pa_page, .generation = generation, .writable = !read_only};
+  }
 
-  *buffer_start += _contiguous_start;
-  *buffer_end += _contiguous_start;
+  IRQSave::restore_irqs(daif);
+  *pa = pa_page | (va & (PAGE_SIZE - 1));
+  return true;
+}
 
-  //  LOG_DEBUG("Target Range {:#x} -> {:#x}", *buffer_start, *buffer_end);
+void memory_impl::invalidate_translations() {
+  // The writers hold the kernel lock (or run alone, at boot), the readers only load the generation.
+  __atomic_store_n(&_translation_generation, __atomic_load_n(&_translation_generation, __ATOMIC_RELAXED) + 1,
+                   __ATOMIC_RELEASE);
+}
 
-  return true;
+bool memory_impl::allocate_buffer_pa(size_t nb_pages, PhysicalPA* buffer_start, PhysicalPA* buffer_end) {
+  return _page_alloc.fresh_contiguous_pages(nb_pages, buffer_start, buffer_end);
 }
 
 void memory_impl::free_buffer_pa(PhysicalPA buffer_start, PhysicalPA buffer_end) {
-  //  LOG_DEBUG("Freeing page {:#x} -> {:#x}", buffer_start, buffer_end);
-  //  LOG_DEBUG("Offset {:#x}", _contiguous_start);
-
-  const PhysicalPA target_start = buffer_start - _contiguous_start;
-  const PhysicalPA target_end = buffer_end - _contiguous_start;
+  _page_alloc.free_contiguous_pages(buffer_start, buffer_end);
+}
 
-  //  LOG_DEBUG("Target {:#x} -> {:#x}", target_start, target_end);
+/** Maps the kernel range from @a va_start to @a va_end to the physical pages from @a pa_start, the first half then
+ * the second half to the same pages if @a is_mirrored. */
+static bool map_buffer_range(VirtualPA va_start, VirtualPA va_end, PhysicalPA pa_start, bool is_mirrored) {
+  if (!is_mirrored) {
+    return map_range(&_tbl, va_start, va_end, pa_start, buffer_memory_rw);
+  }
 
-  _contiguous_alloc.free_pages(target_start, target_end);
+  const size_t byte_size = (va_end + PAGE_SIZE - va_start) / 2;
+  return map_range(&_tbl, va_start, va_start + byte_size - PAGE_SIZE, pa_start, buffer_memory_rw) &&
+         map_range(&_tbl, va_start + byte_size, va_end, pa_start, buffer_memory_rw);
 }
 
-VirtualPA memory_impl::map_buffer(PhysicalPA buffer_start, PhysicalPA buffer_end) {
+VirtualPA memory_impl::map_buffer(PhysicalPA buffer_start, PhysicalPA buffer_end, bool is_mirrored) {
+  // Big buffers get the same offset in a 2 MiB block in virtual and physical memory, so they can be
+  // mapped with large blocks (taking much less TLB entries).
+  static constexpr size_t BLOCK_SIZE = 2 * 1024 * 1024;
+  const size_t byte_size = buffer_end - buffer_start + PAGE_SIZE;
   VirtualPA buffer_va_start = _buffer_pages;
-  VirtualPA buffer_va_end = _buffer_pages + buffer_end - buffer_start;
+  if (byte_size >= BLOCK_SIZE) {
+    buffer_va_start = libk::align_to_next(_buffer_pages, BLOCK_SIZE) + (buffer_start & (BLOCK_SIZE - 1));
+  }
+
+  VirtualPA buffer_va_end = buffer_va_start + (is_mirrored ? 2 * byte_size : byte_size) - PAGE_SIZE;
 
   //  LOG_DEBUG("Mapping buffer {:#x} -> {:#x} to {:#x} -> {:#x}", buffer_start, buffer_end, buffer_va_start,
   //            buffer_va_end);
-  if (!map_range(&_tbl, buffer_va_start, buffer_va_end, buffer_start, buffer_memory_rw)) {
+  if (!map_buffer_range(buffer_va_start, buffer_va_end, buffer_start, is_mirrored)) {
     libk::panic("Failed to map buffer memory in kernel space.");
   }
   //  LOG_DEBUG("Done.");
@@ -288,4 +358,54 @@ void memory_impl::unmap_buffer(VirtualPA buffer_start, VirtualPA buffer_end) {
   if (!unmap_range(&_tbl, buffer_start, buffer_end)) {
     libk::panic("Failed to unmap buffer memory!");
   }
+
+  invalidate_translations();
+}
+
+void memory_impl::remap_buffer(VirtualPA buffer_start, VirtualPA buffer_end, PhysicalPA pa_start, bool is_mirrored) {
+  if (!unmap_range(&_tbl, buffer_start, buffer_end) ||
+      !map_buffer_range(buffer_start, buffer_end, pa_start, is_mirrored)) {
+    libk::panic("Failed to remap buffer memory in kernel space.");
+  }
+
+  invalidate_translations();
+}
+
+/*
+ * Benchmarks
+ */
+
+#include <libk/benchmark.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "task/task.hpp"
+
+BENCHMARK("kernel.page_alloc") {
+  {
+    KernelTaskLockGuard kernel_lock;
+    while (state.keep_running()) {
+      PhysicalPA page;
+      if (!_page_alloc.fresh_page(&page))
+        libk::panic("[KernelInternalMemory] Unable to allocate a page for the benchmark.");
+      _page_alloc.free_page(page);
+    }
+  }
+}
+
+BENCHMARK("kernel.map_range.16_pages") {
+  static constexpr size_t NB_PAGES = 16;
+  static constexpr VirtualPA VA_START = 0x10000000;
+
+  {
+    KernelTaskLockGuard kernel_lock;
+
+    // The table is never activated, so neither its ASID nor the mapped physical pages matter.
+    MMUTable tbl = memory_impl::new_process_tbl(0);
+    while (state.keep_running()) {
+      const VirtualPA va_end = VA_START + (NB_PAGES - 1) * PAGE_SIZE;
+      if (!map_range(&tbl, VA_START, va_end, 0, custom_memory_rw) || !unmap_range(&tbl, VA_START, va_end))
+        libk::panic("[KernelInternalMemory] Unable to map the benchmark range.");
+    }
+
+    memory_impl::delete_process_tbl(tbl);
+  }
 }
@@ -12,15 +12,31 @@ MMUTable* get_kernel_tbl();
 MMUTable new_process_tbl(uint8_t asid);
 void delete_process_tbl(MMUTable& tbl);
 PhysicalPA resolve_table_pgd(const MMUTable& tbl);
+/** Zeroes a page for the cache of page table pages, called by the idle cores. Returns true once the cache holds
+ * enough pages (or if out of memory). */
+bool refill_table_cache();
+/** Frees up to @a byte_size bytes of the cache of page table pages, see MemoryPressure::register_shrinker(). */
+size_t shrink_table_cache(size_t byte_size);
 
-VirtualPA allocate_pages_section(size_t nb_pages, PhysicalPA* pages_ptr);
+VirtualPA allocate_pages_section(size_t nb_pages, PhysicalPA* pages_ptr, bool is_zeroed = true);
 void free_section(size_t nb_pages, VirtualPA kernel_va, PhysicalPA* pages_ptr);
 
 bool allocate_buffer_pa(size_t nb_pages, PhysicalPA* buffer_start, PhysicalPA* buffer_end);
 void free_buffer_pa(PhysicalPA buffer_start, PhysicalPA buffer_end);
-VirtualPA map_buffer(PhysicalPA buffer_start, PhysicalPA buffer_end);
+/** Maps the physical pages of a buffer at a new kernel address. If @a is_mirrored, they are mapped twice, back to
+ * back (see Buffer::is_mirrored()). */
+VirtualPA map_buffer(PhysicalPA buffer_start, PhysicalPA buffer_end, bool is_mirrored = false);
 void unmap_buffer(VirtualPA buffer_start, VirtualPA buffer_end);
+/** Maps the buffer at @a buffer_start (returned by map_buffer()) to the physical pages from @a pa_start instead. */
+void remap_buffer(VirtualPA buffer_start, VirtualPA buffer_end, PhysicalPA pa_start, bool is_mirrored = false);
 
+/** Resolves the physical address of the kernel @a va (with the write permission unless @a read_only). The linear
+ * map is resolved arithmetically, the other translations are cached until invalidate_translations(). */
 PhysicalPA resolve_kernel_va(VirtualAddress va, bool read_only);
+/** Same as resolve_kernel_va(), but returns false instead of panicking if @a va is not mapped. */
+bool try_resolve_kernel_va(VirtualAddress va, bool read_only, PhysicalPA* pa);
+/** Drops the translations cached by resolve_kernel_va(), to call after a kernel range is unmapped or has its
+ * attributes changed (done by the functions above). */
+void invalidate_translations();
 
 };  // namespace memory_impl
@@ -1,10 +1,23 @@
 #include "mem_alloc.hpp"
+#include "boot/mmu_utils.hpp"
 #include "memory.hpp"
 
+#include <libk/assert.hpp>
+#include <libk/string.hpp>
 #include <libk/utils.hpp>
 
+#ifdef CONFIG_ALLOC_PROFILER
+#include "alloc_profiler.hpp"
+#endif  // CONFIG_ALLOC_PROFILER
+
+/** Allocates for the call site @a site, the allocations are recorded by it with CONFIG_ALLOC_PROFILER. */
+static void* allocate_for(size_t byte_count, size_t alignment, uintptr_t site);
+
+/** The return address of the calling function, the call site of the allocation. */
+#define CALL_SITE() ((uintptr_t)__builtin_return_address(0))
+
 #ifdef CONFIG_USE_NAIVE_MALLOC
-void* kmalloc(size_t byte_count, size_t alignment) {
+static void* allocate(size_t byte_count, size_t alignment) {
   if (alignment == 0)
     alignment++;
 
@@ -16,211 +29,393 @@ void* kmalloc(size_t byte_count, size_t alignment) {
   return (void*)libk::align_to_next(ptr, alignment);
 }
 
-void kfree(void* ptr) {
+static void release(void* ptr) {
   (void)ptr;
 }
+
+extern "C" void* krealloc(void* ptr, size_t new_size) {
+  kfree(ptr);
+  return allocate_for(new_size, alignof(max_align_t), CALL_SITE());
+}
 #else
-using MetaPtr = struct MetaBlock*;
-
-struct MetaBlock {
-  size_t size;
-  MetaPtr next;
-  MetaPtr previous;
-  void* ptr;
-  bool is_free;
-  char data[1];
-};  // struct MetaBlock
-
-constexpr size_t META_BLOCK_SIZE = offsetof(MetaBlock, data);
-
-static MetaPtr g_malloc_meta_head = nullptr;
-
-#if 0
-static void split_space(MetaPtr block, size_t bytes_count) {
-  KASSERT(block != nullptr);
-  MetaPtr sub_block;
-  uintptr_t next_addr = (uintptr_t)block->ptr + bytes_count;
-
-  KASSERT(next_addr < KernelMemory::get_heap_end());
-
-  sub_block = (MetaPtr)next_addr;
-  sub_block->is_free = true;
-  sub_block->next = block->next;
-  sub_block->previous = block;
-  sub_block->size = block->size - bytes_count - META_BLOCK_SIZE;
-  block->size = bytes_count;
-  sub_block->ptr = sub_block->data;
-  block->next = sub_block;
-}
-#endif
-
-static MetaPtr extend_heap(MetaPtr last, size_t size, size_t alignment) {  // alignment is always at least 1
-  auto end = (MetaPtr)KernelMemory::get_heap_end();
-  uintptr_t next_addr = libk::align_to_next((uintptr_t)end + META_BLOCK_SIZE, alignment);
-  auto heap_offset = next_addr - (uintptr_t)end + size;
-  auto brk = KernelMemory::change_heap_end(heap_offset);
-  if (brk == 0) {
-    return nullptr;
+/*
+ * The kernel allocator is a slab allocator: small allocations are served from per size class
+ * caches, each one owning slabs of a single page split into objects of the same size. Larger
+ * allocations get their own pages. All the pages come from the kernel heap, and the freed ones
+ * are kept in a list of free page runs to be reused.
+ *
+ * The header of each slab or large allocation is stored at the start of its first page, so it can
+ * be found from any allocated pointer (see get_header()).
+ */
+
+/** Object sizes of the caches are all the powers of two between 2^MIN_SIZE_SHIFT and 2^MAX_SIZE_SHIFT. */
+static constexpr size_t MIN_SIZE_SHIFT = 4;   // 16 bytes
+static constexpr size_t MAX_SIZE_SHIFT = 10;  // 1024 bytes
+static constexpr size_t NB_SIZE_CLASSES = MAX_SIZE_SHIFT - MIN_SIZE_SHIFT + 1;
+
+enum class PageKind : uint32_t {
+  Slab = 0x51ab51ab,
+  Large = 0x1a76e1a7,
+};  // enum class PageKind
+
+struct FreeObject {
+  FreeObject* next;
+};  // struct FreeObject
+
+struct SlabCache;
+
+struct SlabHeader {
+  PageKind kind;
+  uint32_t nb_free;  // count of free objects in this slab
+  SlabCache* cache;
+  FreeObject* free_list;
+  SlabHeader* next;  // in the list of partial slabs of the cache
+  SlabHeader* previous;
+};  // struct SlabHeader
+
+struct SlabCache {
+  size_t object_size;
+  size_t first_object_offset;  // aligned to object_size, so all objects are naturally aligned
+  size_t nb_objects;           // per slab
+  SlabHeader* partial_slabs;   // slabs with at least one free object
+  SlabHeader* empty_slab;      // a completely free slab kept to avoid freeing and allocating pages in loop
+};  // struct SlabCache
+
+struct LargeHeader {
+  PageKind kind;
+  VirtualAddress first_page;
+  size_t nb_pages;
+};  // struct LargeHeader
+
+struct FreeRun {
+  size_t nb_pages;
+  FreeRun* next;  // runs are sorted by address
+};  // struct FreeRun
+
+static SlabCache g_caches[NB_SIZE_CLASSES];
+static bool g_caches_initialized = false;
+static FreeRun* g_free_runs = nullptr;
+
+static void init_caches() {
+  for (size_t i = 0; i < NB_SIZE_CLASSES; ++i) {
+    SlabCache& cache = g_caches[i];
+    cache.object_size = 1ull << (MIN_SIZE_SHIFT + i);
+    cache.first_object_offset = libk::align_to_next(sizeof(SlabHeader), cache.object_size);
+    cache.nb_objects = (PAGE_SIZE - cache.first_object_offset) / cache.object_size;
+    cache.partial_slabs = nullptr;
+    cache.empty_slab = nullptr;
   }
 
-  end->size = size;
-  end->is_free = false;
-  end->next = nullptr;
-  end->previous = last;
-  end->ptr = (void*)next_addr;
+  g_caches_initialized = true;
+}
+
+static SlabCache& get_cache(size_t size) {
+  KASSERT(size <= (1ull << MAX_SIZE_SHIFT));
+
+  size_t shift = MIN_SIZE_SHIFT;
+  while ((1ull << shift) < size)
+    shift++;
 
-  if (last != nullptr)
-    last->next = end;
+  return g_caches[shift - MIN_SIZE_SHIFT];
+}
 
-  return end;
+/** Returns the page storing the header of the slab or of the large allocation containing @a ptr. */
+static inline VirtualAddress get_header(const void* ptr) {
+  // Allocated pointers are never at the start of a page, except page aligned large allocations
+  // whose header is in the previous page.
+  return libk::align_to_previous((VirtualAddress)ptr - 1, PAGE_SIZE);
 }
 
-static MetaPtr find_suitable_block(size_t memory, size_t alignment) {
-  MetaPtr block = g_malloc_meta_head;
-  while (block != nullptr && block->next != nullptr) {
-    const size_t offset = libk::align_to_next((uintptr_t)block->ptr, alignment) - (uintptr_t)block->ptr;
-    if (block->size >= memory + offset && block->is_free) {
-      auto next_addr = (uintptr_t)block->ptr + offset;
-      block->ptr = (void*)next_addr;
-      block->is_free = false;
-      block->size -= offset;
-      return block;
+static VirtualAddress allocate_pages(size_t nb_pages) {
+  // First fit in the runs of pages previously freed.
+  for (FreeRun** link = &g_free_runs; *link != nullptr; link = &(*link)->next) {
+    FreeRun* run = *link;
+    if (run->nb_pages < nb_pages)
+      continue;
+
+    if (run->nb_pages == nb_pages) {
+      *link = run->next;
+    } else {
+      auto* rest = (FreeRun*)((VirtualAddress)run + nb_pages * PAGE_SIZE);
+      rest->nb_pages = run->nb_pages - nb_pages;
+      rest->next = run->next;
+      *link = rest;
     }
 
-    block = block->next;
+    return (VirtualAddress)run;
   }
 
-  return extend_heap(block, memory, alignment);
+  // Otherwise, take fresh pages at the end of the heap.
+  const VirtualAddress heap_end = KernelMemory::get_heap_end();
+  const VirtualAddress pages_start = libk::align_to_next(heap_end, PAGE_SIZE);
+  if (KernelMemory::change_heap_end((long)(pages_start - heap_end + nb_pages * PAGE_SIZE)) == 0)
+    return 0;
+
+  return pages_start;
 }
 
-static MetaPtr get_block_addr(VirtualAddress addr) {
-  if (addr < KernelMemory::get_heap_end()) {
-    MetaPtr b = g_malloc_meta_head;
-    if (b != nullptr && (VirtualAddress)b->ptr == addr) {
-      return b;
-    }
+static void free_pages(VirtualAddress pages_start, size_t nb_pages) {
+  auto* run = (FreeRun*)pages_start;
+  run->nb_pages = nb_pages;
 
-    while (b != nullptr && (uintptr_t)b->ptr + b->size < addr) {
-      b = b->next;
-    }
+  // Insert the run at its place, merging it with its neighbours.
+  FreeRun* previous = nullptr;
+  FreeRun* next = g_free_runs;
+  while (next != nullptr && (VirtualAddress)next < pages_start) {
+    previous = next;
+    next = next->next;
+  }
 
-    if (b != nullptr && (uintptr_t)b->ptr > addr)
-      return nullptr;
-    return b;
+  run->next = next;
+  if (next != nullptr && pages_start + nb_pages * PAGE_SIZE == (VirtualAddress)next) {
+    run->nb_pages += next->nb_pages;
+    run->next = next->next;
   }
-  return nullptr;
+
+  if (previous == nullptr) {
+    g_free_runs = run;
+  } else if ((VirtualAddress)previous + previous->nb_pages * PAGE_SIZE == pages_start) {
+    previous->nb_pages += run->nb_pages;
+    previous->next = run->next;
+  } else {
+    previous->next = run;
+  }
+}
+
+static void push_partial_slab(SlabCache& cache, SlabHeader* slab) {
+  slab->previous = nullptr;
+  slab->next = cache.partial_slabs;
+  if (cache.partial_slabs != nullptr)
+    cache.partial_slabs->previous = slab;
+  cache.partial_slabs = slab;
+}
+
+static void remove_partial_slab(SlabCache& cache, SlabHeader* slab) {
+  if (slab->previous != nullptr)
+    slab->previous->next = slab->next;
+  else
+    cache.partial_slabs = slab->next;
+
+  if (slab->next != nullptr)
+    slab->next->previous = slab->previous;
+
+  slab->next = nullptr;
+  slab->previous = nullptr;
 }
 
-static inline bool is_addr_valid(VirtualAddress addr) {
-  if (g_malloc_meta_head == nullptr)
-    return false;
+static SlabHeader* create_slab(SlabCache& cache) {
+  const VirtualAddress page = allocate_pages(1);
+  if (page == 0)
+    return nullptr;
 
-  if (addr > (VirtualAddress)g_malloc_meta_head && addr < KernelMemory::get_heap_end()) {
-    MetaPtr b = get_block_addr(addr);
-    return (b != nullptr && addr == (VirtualAddress)b->ptr);
+  auto* slab = (SlabHeader*)page;
+  slab->kind = PageKind::Slab;
+  slab->nb_free = cache.nb_objects;
+  slab->cache = &cache;
+  slab->next = nullptr;
+  slab->previous = nullptr;
+
+  // Thread all the objects in the free list.
+  slab->free_list = nullptr;
+  for (size_t i = cache.nb_objects; i > 0; --i) {
+    auto* object = (FreeObject*)(page + cache.first_object_offset + (i - 1) * cache.object_size);
+    object->next = slab->free_list;
+    slab->free_list = object;
   }
 
-  return false;
+  return slab;
 }
 
-static void merge_block(MetaPtr lhs, MetaPtr rhs) {
-  KASSERT(lhs != nullptr);
-  KASSERT(rhs != nullptr);
-  KASSERT(lhs->next == rhs);
-  KASSERT(rhs->is_free);
+static void* allocate_object(SlabCache& cache) {
+  SlabHeader* slab = cache.partial_slabs;
+  if (slab == nullptr) {
+    if (cache.empty_slab != nullptr) {
+      slab = cache.empty_slab;
+      cache.empty_slab = nullptr;
+    } else {
+      slab = create_slab(cache);
+      if (slab == nullptr)
+        return nullptr;
+    }
+
+    push_partial_slab(cache, slab);
+  }
+
+  FreeObject* object = slab->free_list;
+  slab->free_list = object->next;
+  slab->nb_free--;
+
+  if (slab->nb_free == 0)
+    remove_partial_slab(cache, slab);
 
-  lhs->size += rhs->size + META_BLOCK_SIZE;
-  lhs->next = rhs->next;
-  if (rhs->next != nullptr)
-    (rhs->next)->previous = lhs;
+  return object;
 }
 
-void* kmalloc(size_t byte_count, size_t alignment) {
-  if (alignment == 0)
-    alignment++;
+static void free_object(SlabHeader* slab, void* ptr) {
+  SlabCache& cache = *slab->cache;
+  KASSERT(((VirtualAddress)ptr - (VirtualAddress)slab - cache.first_object_offset) % cache.object_size == 0);
 
-  if (byte_count == 0)
-    byte_count++;  // ensure that we have a unique pointer address even when allocating 0 bytes
+  auto* object = (FreeObject*)ptr;
+  object->next = slab->free_list;
+  slab->free_list = object;
+  slab->nb_free++;
 
-  MetaPtr block;
-  if (g_malloc_meta_head == nullptr) {
-    block = extend_heap(nullptr, byte_count, alignment);
-    if (block == nullptr) {
-      return nullptr;
-    }
-    g_malloc_meta_head = block;
-    return block->ptr;
+  // The slab was full, it is now partial.
+  if (slab->nb_free == 1)
+    push_partial_slab(cache, slab);
+
+  if (slab->nb_free == cache.nb_objects) {
+    remove_partial_slab(cache, slab);
+
+    if (cache.empty_slab == nullptr)
+      cache.empty_slab = slab;
+    else
+      free_pages((VirtualAddress)slab, 1);
   }
+}
 
-  block = find_suitable_block(byte_count, alignment);
-  if (block == nullptr) {
-    return nullptr;
+static void* allocate_large(size_t byte_count, size_t alignment) {
+  VirtualAddress first_page;
+  VirtualAddress object;
+  size_t nb_pages;
+
+  if (alignment < PAGE_SIZE) {
+    // The object follows the header in the first page.
+    const size_t offset = libk::align_to_next(sizeof(LargeHeader), alignment);
+    nb_pages = libk::div_round_up(offset + byte_count, PAGE_SIZE);
+    first_page = allocate_pages(nb_pages);
+    if (first_page == 0)
+      return nullptr;
+
+    object = first_page + offset;
+  } else {
+    // The object is page aligned, the header is in the page just before.
+    nb_pages = 1 + libk::div_round_up(byte_count + alignment - PAGE_SIZE, PAGE_SIZE);
+    first_page = allocate_pages(nb_pages);
+    if (first_page == 0)
+      return nullptr;
+
+    object = libk::align_to_next(first_page + PAGE_SIZE, alignment);
   }
 
-#if 0
-  if (block->size > byte_count + META_BLOCK_SIZE) {
-    split_space(block, byte_count);
-    // LOG_INFO("Free addr {}", (VirtualAddress)(block->next)->ptr);
-    kfree((block->next)->ptr);
+  auto* header = (LargeHeader*)get_header((void*)object);
+  header->kind = PageKind::Large;
+  header->first_page = first_page;
+  header->nb_pages = nb_pages;
+  return (void*)object;
+}
+
+/** Returns the usable size of the allocation @a ptr. */
+static size_t get_allocation_size(void* ptr) {
+  const VirtualAddress header = get_header(ptr);
+  switch (*(PageKind*)header) {
+    case PageKind::Slab:
+      return ((SlabHeader*)header)->cache->object_size;
+    case PageKind::Large: {
+      const auto* large = (LargeHeader*)header;
+      return large->first_page + large->nb_pages * PAGE_SIZE - (VirtualAddress)ptr;
+    }
   }
-#endif
 
-  return block->ptr;
+  libk::panic("[kmalloc] Invalid pointer.");
 }
 
-void kfree(void* ptr) {
-  if (ptr == nullptr)
-    return;
+static void* allocate(size_t byte_count, size_t alignment) {
+  if (alignment == 0)
+    alignment++;
 
-  KASSERT(is_addr_valid((VirtualAddress)ptr));
+  if (byte_count == 0)
+    byte_count++;  // ensure that we have a unique pointer address even when allocating 0 bytes
 
-  MetaPtr block = get_block_addr((VirtualAddress)ptr);
-  block->is_free = true;
-  block->ptr = block->data;
-  block->size += (uintptr_t)ptr - (uintptr_t)block->ptr;
+  if (!g_caches_initialized)
+    init_caches();
 
-  if (block->next != nullptr && (block->next)->is_free) {
-    merge_block(block, block->next);
-  }
+  // Objects of a cache are aligned to their size.
+  const size_t size = libk::max(byte_count, alignment);
+  if (size <= (1ull << MAX_SIZE_SHIFT))
+    return allocate_object(get_cache(size));
 
-  if (block->previous != nullptr && (block->previous)->is_free) {
-    if (!((block->previous)->next == block)) {
-      if (get_block_addr((VirtualAddress)((block->previous)->next)->ptr) == block) {
-        (block->previous)->next = block;
-        merge_block(block->previous, block);
-      }
+  return allocate_large(byte_count, alignment);
+}
 
+static void release(void* ptr) {
+  if (ptr == nullptr)
+    return;
+
+  const VirtualAddress header = get_header(ptr);
+  switch (*(PageKind*)header) {
+    case PageKind::Slab:
+      free_object((SlabHeader*)header, ptr);
+      return;
+    case PageKind::Large: {
+      const auto* large = (LargeHeader*)header;
+      free_pages(large->first_page, large->nb_pages);
       return;
     }
-
-    merge_block(block->previous, block);
   }
+
+  libk::panic("[kfree] Invalid pointer.");
 }
-#endif  // CONFIG_USE_NAIVE_MALLOC
 
 extern "C" void* krealloc(void* ptr, size_t new_size) {
+  if (ptr == nullptr)
+    return allocate_for(new_size, alignof(max_align_t), CALL_SITE());
+
+  const size_t old_size = get_allocation_size(ptr);
+  if (new_size <= old_size)
+    return ptr;
+
+  void* new_ptr = allocate_for(new_size, alignof(max_align_t), CALL_SITE());
+  if (new_ptr == nullptr)
+    return nullptr;
+
+  libk::memcpy(new_ptr, ptr, old_size);
   kfree(ptr);
-  return kmalloc(new_size, alignof(max_align_t));
+  return new_ptr;
+}
+#endif  // CONFIG_USE_NAIVE_MALLOC
+
+static void* allocate_for(size_t byte_count, size_t alignment, uintptr_t site) {
+  void* ptr = allocate(byte_count, alignment);
+#ifdef CONFIG_ALLOC_PROFILER
+  if (ptr != nullptr)
+    AllocProfiler::record_alloc(ptr, byte_count, site);
+#else
+  (void)site;
+#endif  // CONFIG_ALLOC_PROFILER
+  return ptr;
+}
+
+void* kmalloc(size_t byte_count, size_t alignment) {
+  return allocate_for(byte_count, alignment, CALL_SITE());
+}
+
+void kfree(void* ptr) {
+#ifdef CONFIG_ALLOC_PROFILER
+  if (ptr != nullptr)
+    AllocProfiler::record_free(ptr);
+#endif  // CONFIG_ALLOC_PROFILER
+  release(ptr);
 }
 
 #include <new>
 
-// Provide the C++ operators new and delete:
+// Provide the C++ operators new and delete (the allocations are charged to their caller):
 
 void* operator new(size_t bytes_count) {
-  return kmalloc(bytes_count, alignof(std::max_align_t));
+  return allocate_for(bytes_count, alignof(std::max_align_t), CALL_SITE());
 }
 
 void* operator new(size_t bytes_count, std::align_val_t alignment) {
-  return kmalloc(bytes_count, (size_t)alignment);
+  return allocate_for(bytes_count, (size_t)alignment, CALL_SITE());
 }
 
 void* operator new[](size_t bytes_count) {
-  return kmalloc(bytes_count, alignof(std::max_align_t));
+  return allocate_for(bytes_count, alignof(std::max_align_t), CALL_SITE());
 }
 
 void* operator new[](size_t bytes_count, std::align_val_t alignment) {
-  return kmalloc(bytes_count, (size_t)alignment);
+  return allocate_for(bytes_count, (size_t)alignment, CALL_SITE());
 }
 
 void operator delete(void* ptr) {
@@ -238,3 +433,19 @@ void operator delete[](void* ptr) {
 void operator delete[](void* ptr, size_t) {
   kfree(ptr);
 }
+
+/*
+ * Benchmarks
+ */
+
+#include <libk/benchmark.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "task/task.hpp"
+
+BENCHMARK("kernel.kmalloc.64") {
+  {
+    KernelTaskLockGuard kernel_lock;
+    while (state.keep_running())
+      kfree(kmalloc(64, alignof(max_align_t)));
+  }
+}
@@ -1,33 +1,50 @@
 #include "memory_chunk.hpp"
 
 #include <algorithm>
+#include <libk/cpu_features.hpp>
 #include <libk/log.hpp>
 #include <libk/string.hpp>
 #include <libk/utils.hpp>
 
 #include "boot/mmu_utils.hpp"
+#include "hardware/dma/copy_engine.hpp"
 #include "memory/kernel_internal_memory.hpp"
 #include "memory/process_memory.hpp"
 
-MemoryChunk::MemoryChunk(size_t nb_pages)
+MemoryChunk::MemoryChunk(size_t nb_pages, bool is_zeroed)
     : _nb_pages(nb_pages),
       _pas(new PhysicalPA[_nb_pages]),
-      _kernel_va(memory_impl::allocate_pages_section(_nb_pages, _pas)) {
+      _kernel_va(memory_impl::allocate_pages_section(_nb_pages, _pas, is_zeroed)) {
   if (_kernel_va == 0) {
     LOG_ERROR("[MemoryChunk] Failed to allocate {} pages.", nb_pages);
   }
 }
 
+MemoryChunk::MemoryChunk(VirtualPA kernel_va, PhysicalPA pa, size_t nb_pages)
+    : _nb_pages(nb_pages), _pas(new PhysicalPA[_nb_pages]), _kernel_va(kernel_va), _owns_pages(false) {
+  if (_pas == nullptr) {
+    _kernel_va = 0;
+    return;
+  }
+
+  for (size_t page_id = 0; page_id < _nb_pages; ++page_id) {
+    _pas[page_id] = pa + page_id * PAGE_SIZE;
+  }
+}
+
 MemoryChunk::~MemoryChunk() {
   // Free all mapping in processes
-  for (const auto proc : _proc) {
+  while (!_proc.is_empty()) {
+    const auto proc = _proc.back();
     proc.proc->unmap_memory(proc.chunk_start);  // <- proc will be removed from the list by the unregister call
   }
 
   KASSERT(_proc.is_empty());
 
   // Free the kernel memory
-  memory_impl::free_section(_nb_pages, _kernel_va, _pas);
+  if (_owns_pages) {
+    memory_impl::free_section(_nb_pages, _kernel_va, _pas);
+  }
 
   // Free the array & invalidate object.
   delete[] _pas;
@@ -44,7 +61,9 @@ size_t MemoryChunk::write(size_t byte_offset, const void* data, size_t data_byte
   const size_t available_to_write = get_byte_size() - byte_offset;
   const size_t to_write = libk::min(available_to_write, data_byte_length);
 
-  libk::memcpy(begin, data, to_write);
+  if (!transfer_with_dma(byte_offset, (void*)data, to_write, true)) {
+    libk::memcpy_large(begin, data, to_write);
+  }
 
   return to_write;
 }
@@ -58,11 +77,66 @@ size_t MemoryChunk::read(size_t byte_offset, void* data, size_t data_byte_length
   const size_t available_to_read = get_byte_size() - byte_offset;
   const size_t to_read = libk::min(available_to_read, data_byte_length);
 
-  libk::memcpy(data, begin, to_read);
+  if (!transfer_with_dma(byte_offset, data, to_read, false)) {
+    libk::memcpy_large(data, begin, to_read);
+  }
 
   return to_read;
 }
 
+size_t MemoryChunk::get_segments(size_t byte_offset,
+                                 size_t byte_length,
+                                 Segment* segments,
+                                 size_t max_segments) const {
+  if (byte_offset >= get_byte_size() || _pas == nullptr) {
+    return 0;
+  }
+
+  const size_t end = byte_offset + libk::min(byte_length, get_byte_size() - byte_offset);
+  size_t nb_segments = 0;
+  size_t offset = byte_offset;
+  while (offset < end && nb_segments < max_segments) {
+    // Extends the segment while the next pages follow in physical memory.
+    size_t page_id = offset / PAGE_SIZE;
+    const PhysicalPA pa = _pas[page_id] + offset % PAGE_SIZE;
+    size_t segment_end = (page_id + 1) * PAGE_SIZE;
+    while (segment_end < end && _pas[page_id + 1] == _pas[page_id] + PAGE_SIZE) {
+      page_id++;
+      segment_end += PAGE_SIZE;
+    }
+
+    segment_end = libk::min(segment_end, end);
+    segments[nb_segments++] = {pa, segment_end - offset};
+    offset = segment_end;
+  }
+
+  return nb_segments;
+}
+
+bool MemoryChunk::transfer_with_dma(size_t byte_offset, void* data, size_t byte_length, bool to_chunk) const {
+  // The segments are built by batches, on the stack.
+  static constexpr size_t NB_BATCH_SEGMENTS = 16;
+
+  if (byte_length < libk::get_cpu_features().large_copy_threshold) {
+    return false;
+  }
+
+  Segment segments[NB_BATCH_SEGMENTS];
+  size_t done = 0;
+  while (done < byte_length) {
+    const size_t nb_segments = get_segments(byte_offset + done, byte_length - done, segments, NB_BATCH_SEGMENTS);
+    if (!DMA::copy_segments(segments, nb_segments, (uint8_t*)data + done, to_chunk)) {
+      return false;
+    }
+
+    for (size_t i = 0; i < nb_segments; ++i) {
+      done += segments[i].byte_size;
+    }
+  }
+
+  return true;
+}
+
 size_t MemoryChunk::get_byte_size() const {
   return _nb_pages * PAGE_SIZE;
 }
@@ -2,14 +2,24 @@
 
 #include "memory/mmu_table.hpp"
 
-#include <libk/linked_list.hpp>
+#include <libk/small_vector.hpp>
 
 class ProcessMemory;
 
 class MemoryChunk {
  public:
-  /** Creates a memory chunk of @a nb_pages continuous pages. */
-  MemoryChunk(size_t nb_pages);
+  /** A run of physically contiguous bytes of the chunk, an entry of its scatter-gather list. */
+  struct Segment {
+    PhysicalPA pa;
+    size_t byte_size;
+  };  // struct Segment
+
+  /** Creates a memory chunk of @a nb_pages continuous pages. They are zeroed, unless @a is_zeroed is false:
+   * the caller then overwrites all of them itself (their previous content must never reach a process). */
+  MemoryChunk(size_t nb_pages, bool is_zeroed = true);
+  /** Creates a memory chunk of the @a nb_pages existing continuous pages starting at @a pa, mapped at
+   * @a kernel_va in the kernel address space (e.g. some ramdisk pages). They are not freed with the chunk. */
+  MemoryChunk(VirtualPA kernel_va, PhysicalPA pa, size_t nb_pages);
 
   /** Free this memory chunk. */
   ~MemoryChunk();
@@ -27,9 +37,21 @@ class MemoryChunk {
    * Can be different of @a data_byte_length when @a byte_offset is too big. */
   [[nodiscard]] size_t read(size_t byte_offset, void* data, size_t data_byte_length) const;
 
+  /** Fills @a segments with the scatter-gather list of the @a byte_length bytes at @a byte_offset (up to the chunk
+   * end): each segment is a run of physically contiguous pages, so it can be given to a single DMA request.
+   * @returns the count of segments written, at most @a max_segments (they then cover fewer bytes). */
+  [[nodiscard]] size_t get_segments(size_t byte_offset,
+                                    size_t byte_length,
+                                    Segment* segments,
+                                    size_t max_segments) const;
+
   /** Returns the number of bytes of this chunk. */
   [[nodiscard]] size_t get_byte_size() const;
 
+  /** Returns the raw pointer of this chunk in the kernel address space.
+   * Reading or Writing before or after the chunk's end is undefined. */
+  [[nodiscard]] void* get() const { return (void*)_kernel_va; }
+
   /** @returns the size of a page. */
   static size_t get_page_byte_size();
 
@@ -40,6 +62,7 @@ class MemoryChunk {
   PhysicalPA* _pas;
 
   VirtualPA _kernel_va;
+  const bool _owns_pages = true;
 
   struct ProcessMapped {
     ProcessMapped(VirtualPA start, ProcessMemory* proc) : chunk_start(start), proc(proc) {}
@@ -47,7 +70,11 @@ class MemoryChunk {
     ProcessMemory* proc;
   };
 
-  libk::LinkedList<ProcessMapped> _proc;
+  libk::SmallVector<ProcessMapped, 2> _proc;  // usually mapped in a single process
+
+  /** Copies the @a byte_length bytes at @a byte_offset with the DMA, from the chunk to @a data or the reverse if
+   * @a to_chunk. Returns false if the copy must be done by the CPU (it may be partially done). */
+  bool transfer_with_dma(size_t byte_offset, void* data, size_t byte_length, bool to_chunk) const;
 
   void register_mapping(ProcessMemory* proc_mem, VirtualPA start_addr);
   void unregister_mapping(ProcessMemory* proc_mem);
@@ -0,0 +1,165 @@
+#include "memory_pressure.hpp"
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "memory/kernel_internal_memory.hpp"
+#include "memory/process_memory.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+#include "task/wait_list.hpp"
+
+namespace MemoryPressure {
+struct ShrinkerEntry {
+  const char* name;
+  Shrinker shrinker;
+};  // struct ShrinkerEntry
+
+static ShrinkerEntry g_shrinkers[MAX_SHRINKERS];
+static size_t g_nb_shrinkers = 0;
+
+static size_t g_low_watermark = 0;
+static size_t g_high_watermark = 0;
+/** Set by a failed allocation, until the reclaim task handled it. */
+static bool g_has_failed = false;
+static WaitList g_wait_list;
+static Stats g_stats = {};
+
+void register_shrinker(const char* name, Shrinker shrinker) {
+  KASSERT(shrinker != nullptr);
+  KASSERT(g_nb_shrinkers < MAX_SHRINKERS);
+  g_shrinkers[g_nb_shrinkers++] = {name, shrinker};
+}
+
+const Stats& get_stats() {
+  return g_stats;
+}
+
+/** Called by the page allocator, see PageAllocList::PressureCallback. */
+static void on_pressure(bool has_failed) {
+  if (has_failed) {
+    g_has_failed = true;
+    g_stats.nb_failures++;
+  }
+
+  g_wait_list.wake_all();
+}
+
+/** Runs the shrinkers until the high watermark is reached (or the caches are empty). */
+static void shrink_caches() {
+  const size_t nb_free_pages = memory_impl::get_kernel_alloc()->get_nb_free_pages();
+  if (nb_free_pages >= g_high_watermark)
+    return;
+
+  const size_t byte_size = (g_high_watermark - nb_free_pages) * PAGE_SIZE;
+  size_t freed_byte_size = 0;
+  for (size_t i = 0; i < g_nb_shrinkers && freed_byte_size < byte_size; ++i) {
+    const size_t freed = g_shrinkers[i].shrinker(byte_size - freed_byte_size);
+    if (freed > 0)
+      LOG_DEBUG("[MemoryPressure] {} bytes reclaimed from the {}", freed, g_shrinkers[i].name);
+
+    freed_byte_size += freed;
+  }
+
+  g_stats.nb_reclaims++;
+  g_stats.reclaimed_byte_size += freed_byte_size;
+}
+
+/** Kills the process with the largest resident memory, see the out of memory killer in memory_pressure.hpp. */
+static void kill_largest_process() {
+  Task::id_t victim_id = 0;
+  size_t victim_byte_size = 0;
+  TaskManager::get().for_each_task([&](const Task* task) {
+    // The threads share the memory of their process, and are killed with it.
+    if (task->is_kernel() || task->is_thread() || task->get_parent() == nullptr || task->is_terminated())
+      return;
+
+    const size_t byte_size = task->get_memory()->get_resident_byte_size();
+    if (byte_size > victim_byte_size) {
+      victim_id = task->get_id();
+      victim_byte_size = byte_size;
+    }
+  });
+
+  const auto victim = TaskManager::get().find_task(victim_id);
+  if (victim == nullptr) {
+    LOG_WARNING("[MemoryPressure] Out of memory, but there is no process to kill");
+    return;
+  }
+
+  memory_impl::get_kernel_alloc()->for_each_zone([](PhysicalPA start, PhysicalPA stop, size_t nb_free_pages) {
+    LOG_WARNING("[MemoryPressure] Zone {:#x}-{:#x}: {} free pages", start, stop, nb_free_pages);
+  });
+  LOG_WARNING("[MemoryPressure] Out of memory, kill the task pid={} ({}) using {} KiB", victim_id,
+              victim->get_name(), victim_byte_size / 1024);
+
+  g_stats.nb_oom_kills++;
+  TaskManager::get().kill_task(victim, OOM_EXIT_CODE);
+}
+
+/** Moves the cold pages of the processes into the compressed store until the high watermark is reached. Each
+ * call only takes the pages not accessed since the previous one (see DemandPaging::page_out_cold_pages()). */
+static void page_out_processes() {
+  const size_t nb_free_pages = memory_impl::get_kernel_alloc()->get_nb_free_pages();
+  if (nb_free_pages >= g_high_watermark)
+    return;
+
+  const size_t byte_size = (g_high_watermark - nb_free_pages) * PAGE_SIZE;
+  size_t freed_byte_size = 0;
+  TaskManager::get().for_each_task([&](const Task* task) {
+    if (freed_byte_size >= byte_size || task->is_kernel() || task->is_thread() || task->is_terminated())
+      return;
+
+    freed_byte_size += task->get_memory()->page_out_cold_pages(byte_size - freed_byte_size);
+  });
+
+  if (freed_byte_size > 0)
+    LOG_DEBUG("[MemoryPressure] {} bytes reclaimed by paging out", freed_byte_size);
+
+  g_stats.paged_out_byte_size += freed_byte_size;
+}
+
+static void reclaim() {
+  shrink_caches();
+  page_out_processes();
+
+  // Only a failed allocation kills: being under the low watermark is not enough, it is the normal state of a
+  // loaded system whose caches are already empty.
+  if (!g_has_failed)
+    return;
+
+  g_has_failed = false;
+  if (memory_impl::get_kernel_alloc()->get_nb_free_pages() < g_low_watermark)
+    kill_largest_process();
+}
+
+static void run() {
+  while (true) {
+    {
+      KernelTaskLockGuard kernel_lock;
+      reclaim();
+
+      // Sleep until the page allocator reports the pressure again.
+      g_wait_list.add(Task::current());
+    }
+
+    sys_yield();
+  }
+}
+
+void init() {
+  PageAllocList* page_alloc = memory_impl::get_kernel_alloc();
+  g_low_watermark = libk::max(page_alloc->get_nb_pages() / LOW_WATERMARK_DIVISOR, MIN_LOW_WATERMARK);
+  g_high_watermark = 2 * g_low_watermark;
+
+  auto task = TaskManager::get().create_kernel_task(&run);
+  KASSERT(task != nullptr);
+  // It must preempt the tasks allocating, to free the caches while there is still memory left.
+  TaskManager::get().set_task_priority(task, Scheduler::REALTIME_MIN_PRIORITY);
+  TaskManager::get().wake_task(task);
+
+  page_alloc->set_pressure_callback(g_low_watermark, &on_pressure);
+  LOG_INFO("[MemoryPressure] Watermarks: {} and {} pages of {}", g_low_watermark, g_high_watermark,
+           page_alloc->get_nb_pages());
+}
+};  // namespace MemoryPressure
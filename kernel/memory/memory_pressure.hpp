@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The reaction of the kernel to the lack of free physical pages.
+ *
+ * The page allocator reports when it gives pages while fewer than the low watermark are free, and when an
+ * allocation fails (see PageAllocList::set_pressure_callback()). This wakes a kernel task that shrinks the
+ * kernel caches (through the registered shrinkers) until the high watermark is reached again, so the caches
+ * only give their memory back under pressure instead of at each allocation. If the caches are not enough, the
+ * pages of the processes not accessed since the previous reclaim are compressed into the Zram store.
+ *
+ * If an allocation failed and the free pages are still below the low watermark once the caches are shrunk,
+ * the process with the largest resident memory is killed (the out of memory killer). The first process
+ * (without parent) and the kernel tasks are never chosen.
+ */
+namespace MemoryPressure {
+/**
+ * Frees about @a byte_size bytes of a cache, the least recently used entries first. Returns the count of
+ * bytes freed, less than @a byte_size if the cache is empty (or its remaining entries are used elsewhere).
+ * It is called with the kernel lock held.
+ */
+using Shrinker = size_t (*)(size_t byte_size);
+
+/** The maximum count of registered shrinkers. */
+static constexpr size_t MAX_SHRINKERS = 8;
+/** The low watermark is this fraction of the memory, but at least MIN_LOW_WATERMARK pages. */
+static constexpr size_t LOW_WATERMARK_DIVISOR = 64;
+static constexpr size_t MIN_LOW_WATERMARK = 256;
+/** The exit code of the processes killed by the out of memory killer. */
+static constexpr int OOM_EXIT_CODE = 137;
+
+struct Stats {
+  // The count of times the caches were shrunk, and the bytes they freed.
+  uint64_t nb_reclaims;
+  uint64_t reclaimed_byte_size;
+  // The bytes freed by paging out the processes cold pages.
+  uint64_t paged_out_byte_size;
+  // The count of failed allocations reported, and of processes killed.
+  uint64_t nb_failures;
+  uint64_t nb_oom_kills;
+};  // struct Stats
+
+/** Adds @a shrinker for the cache named @a name, tried after the already registered ones. */
+void register_shrinker(const char* name, Shrinker shrinker);
+
+/** Gets the counters since the boot. */
+[[nodiscard]] const Stats& get_stats();
+
+/** Computes the watermarks and starts the reclaim kernel task. Requires the task manager. */
+void init();
+};  // namespace MemoryPressure
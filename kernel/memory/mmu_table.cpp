@@ -39,9 +39,28 @@ static inline constexpr uint64_t PAGE_MARKER = 0b11;
 static inline constexpr uint64_t BLOCK_MARKER = 0b01;
 static inline constexpr uint64_t TABLE_MARKER = 0b11;
 
+/** Set on each entry of an aligned group of CONTIGUOUS_GROUP pages mapping contiguous physical pages
+ * with the same attributes: the group then takes a single TLB entry. */
+static inline constexpr uint64_t CONTIGUOUS_BIT = 1ull << 52;
+static inline constexpr size_t CONTIGUOUS_GROUP = 16;
+static_assert(CONTIGUOUS_GROUP * PAGE_SIZE == CONTIGUOUS_MAPPING_SIZE);
+
+/** The access flag of an entry. The cores do not set it themselves (no hardware management of the flag): an access
+ * through an entry without it raises an access flag fault. */
+static inline constexpr uint64_t ACCESS_FLAG = 1ull << 10;
+
+/** The low bits of an invalid page entry holding a swap ID (see set_swap_entry()), the ID being above them. */
+static inline constexpr uint64_t SWAP_MARKER = 0b10;
+static inline constexpr size_t SWAP_ID_SHIFT = 2;
+
 enum class EntryKind { Invalid, Table, Page, Block };
 
-static inline void data_sync() {
+/** Makes the table writes visible to the table walkers. Not needed while the table is inactive. */
+static inline void data_sync(const MMUTable* tbl) {
+  if (tbl->is_inactive) {
+    return;
+  }
+
   asm volatile("dsb sy" ::: "memory");
 }
 
@@ -108,14 +127,31 @@ static inline constexpr VirtualPA table_last_page(VirtualPA table_first_page_va,
   return table_first_page_va + libk::mask_bits(12, 12 + 9 * (4 - table_level + 1) - 1);
 }
 
-uint64_t encode_new_entry(MMUTable* tbl, PhysicalPA pa, size_t entry_level, PagesAttributes attr) {
-  const uint64_t upper_attr = (uint64_t)attr.exec << 53;
+/** Checks if the entry of a table of level @a table_level, covering [@a entry_va_start; @a entry_va_stop],
+ * can be a block descriptor (1 GiB at level 2, 2 MiB at level 3) mapping it to @a entry_pa: the entry must
+ * be inside [@a va_start; @a va_end] and the physical address aligned on the block size. */
+static inline constexpr bool can_map_block(size_t table_level,
+                                           VirtualPA entry_va_start,
+                                           VirtualPA entry_va_stop,
+                                           VirtualPA va_start,
+                                           VirtualPA va_end,
+                                           PhysicalPA entry_pa) {
+  return table_level >= 2 && table_level < 4 && va_start <= entry_va_start && entry_va_stop <= va_end &&
+         (entry_pa & libk::mask_bits(0, 12 + 9 * (4 - table_level) - 1)) == 0;
+}
+
+uint64_t encode_new_entry(MMUTable* tbl,
+                          PhysicalPA pa,
+                          size_t entry_level,
+                          PagesAttributes attr,
+                          bool contiguous = false) {
+  const uint64_t upper_attr = ((uint64_t)attr.exec << 53) | (contiguous ? CONTIGUOUS_BIT : 0);
 
   const uint8_t nG_flag = tbl->kind == MMUTable::Kind::Kernel ? 0 : 1;
 
   const uint64_t lower_attr = ((uint64_t)attr.type << 2) | ((uint64_t)attr.access << 6) | ((uint64_t)attr.rw << 7) |
                               ((uint64_t)attr.sh << 8) |
-                              ((uint64_t)1 << 10)  // Set the Access flag to disable access interrupts
+                              ACCESS_FLAG  // Set the Access flag to disable access interrupts
                               | (nG_flag << 11);
 
   const uint64_t marker = entry_level == 4 ? PAGE_MARKER : BLOCK_MARKER;
@@ -142,6 +178,150 @@ void reload_tlb() {
   asm volatile("dsb sy; isb" ::: "memory");
 }
 
+static inline void tlb_sync(const MMUTable* tbl) {
+  if (tbl->is_inactive) {
+    return;
+  }
+
+  asm volatile("dsb ish; isb" ::: "memory");
+}
+
+/** Invalidates the TLB entries translating @a va in all cores. If @a last_level is false, the cached
+ * table walks are also invalidated (needed when a table entry is removed). */
+static inline void invalidate_va(const MMUTable* tbl, VirtualPA va, bool last_level) {
+  if (tbl->is_inactive) {
+    return;  // Nothing may be cached in the TLB.
+  }
+
+  // Bits [43:0] hold VA[55:12] and bits [63:48] the ASID (ignored for the global kernel entries).
+  const uint64_t operand = ((va >> 12) & libk::mask_bits(0, 43)) | ((uint64_t)tbl->asid << 48);
+  if (last_level) {
+    asm volatile("tlbi vale1is, %0" : : "r"(operand));
+  } else {
+    asm volatile("tlbi vae1is, %0" : : "r"(operand));
+  }
+}
+
+/** Invalidates all the TLB entries of the table address space in all cores. */
+static inline void invalidate_all(const MMUTable* tbl) {
+  if (tbl->is_inactive) {
+    return;
+  }
+
+  if (tbl->kind == MMUTable::Kind::Process) {
+    asm volatile("tlbi aside1is, %0" : : "r"((uint64_t)tbl->asid << 48));
+  } else {
+    asm volatile("tlbi vmalle1is");
+  }
+}
+
+/** Invalidates now the TLB entries translating @a va, as required by break-before-make sequences. */
+static inline void invalidate_entry(const MMUTable* tbl, VirtualPA va, bool last_level) {
+  invalidate_va(tbl, va, last_level);
+  tlb_sync(tbl);
+}
+
+/** Checks if the group of contiguous page entries containing the page @a va is inside [@a va_start; @a va_end]. */
+static inline constexpr bool is_contiguous_group_inside(VirtualPA va, VirtualPA va_start, VirtualPA va_end) {
+  const VirtualPA group_va_start = va & ~(CONTIGUOUS_GROUP * PAGE_SIZE - 1);
+  return va_start <= group_va_start && group_va_start + (CONTIGUOUS_GROUP - 1) * PAGE_SIZE <= va_end;
+}
+
+/** Removes the contiguous bit of the group of entries containing the entry @a index (mapping @a va) of the
+ * page @a table, so this entry can be modified alone. As required, the whole group is invalidated before
+ * being written again (break-before-make). */
+static void break_contiguous_group(const MMUTable* tbl, uint64_t* table, size_t index, VirtualPA va) {
+  if ((table[index] & CONTIGUOUS_BIT) == 0) {
+    return;
+  }
+
+  const size_t group_index = index & ~(CONTIGUOUS_GROUP - 1);
+  const VirtualPA group_va = va & ~(CONTIGUOUS_GROUP * PAGE_SIZE - 1);
+
+  uint64_t entries[CONTIGUOUS_GROUP];
+  for (size_t i = 0; i < CONTIGUOUS_GROUP; ++i) {
+    entries[i] = table[group_index + i];
+    table[group_index + i] = 0ull;
+  }
+
+  data_sync(tbl);
+  for (size_t i = 0; i < CONTIGUOUS_GROUP; ++i) {
+    invalidate_va(tbl, group_va + i * PAGE_SIZE, true);
+  }
+
+  tlb_sync(tbl);
+  for (size_t i = 0; i < CONTIGUOUS_GROUP; ++i) {
+    table[group_index + i] = entries[i] & ~CONTIGUOUS_BIT;
+  }
+
+  data_sync(tbl);
+}
+
+/** Collects the virtual addresses whose translation has been removed or changed during a mapping
+ * operation, to invalidate them all at once at its end. Invalidating too many pages one by one
+ * is slower than invalidating the whole address space: past a threshold, this is what is done.
+ *
+ * The unlinked tables are only freed by flush(): they may still be in the walk caches until then, and
+ * would be walked again if their pages were reused meanwhile. */
+class TLBInvalidationBatch {
+ public:
+  explicit TLBInvalidationBatch(const MMUTable* tbl) : m_tbl(tbl) {}
+
+  void add(VirtualPA va, bool last_level) {
+    if (m_nb_entries < MAX_ENTRIES) {
+      m_entries[m_nb_entries] = {va, last_level};
+    }
+
+    m_nb_entries++;
+  }
+
+  /** Frees the unlinked @a table (its entry must have been added) once invalidated, flushing if too many wait. */
+  void free_table(VirtualPA table) {
+    m_freed_tables[m_nb_freed_tables++] = table;
+    if (m_nb_freed_tables == MAX_FREED_TABLES) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (m_nb_entries == 0) {
+      return;
+    }
+
+    if (m_nb_entries > MAX_ENTRIES) {
+      invalidate_all(m_tbl);
+    } else {
+      for (size_t i = 0; i < m_nb_entries; ++i) {
+        invalidate_va(m_tbl, m_entries[i].va, m_entries[i].last_level);
+      }
+    }
+
+    tlb_sync(m_tbl);
+    m_nb_entries = 0;
+
+    for (size_t i = 0; i < m_nb_freed_tables; ++i) {
+      m_tbl->free(m_tbl->handle, m_freed_tables[i]);
+    }
+
+    m_nb_freed_tables = 0;
+  }
+
+ private:
+  static constexpr size_t MAX_ENTRIES = 32;
+  static constexpr size_t MAX_FREED_TABLES = 16;
+
+  struct Entry {
+    VirtualPA va;
+    bool last_level;
+  };  // struct Entry
+
+  const MMUTable* m_tbl;
+  Entry m_entries[MAX_ENTRIES] = {};
+  size_t m_nb_entries = 0;
+  VirtualPA m_freed_tables[MAX_FREED_TABLES] = {};
+  size_t m_nb_freed_tables = 0;
+};  // class TLBInvalidationBatch
+
 // Prerequisites :
 // - tbl != nullptr
 // - cur_tbl != nullptr
@@ -207,6 +387,27 @@ bool get_attr(const MMUTable* tbl, VirtualPA va, PagesAttributes* attr) {
   return true;
 }
 
+bool get_pa(const MMUTable* tbl, VirtualPA va, PhysicalPA* pa) {
+  if (tbl == nullptr || (uint64_t*)tbl->pgd == nullptr || tbl->resolve_pa == nullptr || !check_va(tbl, va)) {
+    return false;
+  }
+
+  uint64_t* va_table;
+  size_t va_index;
+  size_t va_level;
+
+  if (!find_entry_in_table(tbl, (uint64_t*)tbl->pgd, 1, va, &va_table, &va_index, &va_level)) {
+    // No entry found :/
+    return false;
+  }
+
+  // Blocks (of upper levels) cover more than a page, the lower bits of the address are kept.
+  const uint64_t offset_mask = libk::mask_bits(0, 12 + 9 * (4 - va_level) - 1);
+  *pa = (decode_entry(va_table[va_index], nullptr) & ~offset_mask) | (va & offset_mask);
+
+  return true;
+}
+
 bool change_attr_va(MMUTable* tbl, VirtualPA va, PagesAttributes attr) {
   if (tbl == nullptr || (uint64_t*)tbl->pgd == nullptr || tbl->resolve_pa == nullptr || !check_va(tbl, va)) {
     return false;
@@ -222,16 +423,144 @@ bool change_attr_va(MMUTable* tbl, VirtualPA va, PagesAttributes attr) {
   }
 
   // Entry found !
+  if (va_level == 4) {
+    break_contiguous_group(tbl, va_table, va_index, va);
+  }
+
   const uint64_t old_pa = decode_entry(va_table[va_index], nullptr);
   const uint64_t new_entry = encode_new_entry(tbl, old_pa, va_level, attr);
   va_table[va_index] = 0ull;
-  data_sync();
-  reload_tlb();
+  data_sync(tbl);
+  invalidate_entry(tbl, va, true);
   va_table[va_index] = new_entry;
-  data_sync();
+  data_sync(tbl);
   return true;
 }
 
+/** Finds the entry of the page @a va in its last level table, valid or not. Returns nullptr if there is no such
+ * table (nothing is mapped around @a va, or it is mapped by a block). */
+static uint64_t* find_page_entry(const MMUTable* tbl, VirtualPA va) {
+  if (tbl == nullptr || (uint64_t*)tbl->pgd == nullptr || tbl->resolve_pa == nullptr || !check_va(tbl, va)) {
+    return nullptr;
+  }
+
+  auto* table = (uint64_t*)tbl->pgd;
+  for (size_t level = 1; level < 4; ++level) {
+    const uint64_t entry = table[get_index_in_table(va, level)];
+    if (get_entry_kind(entry, level) != EntryKind::Table) {
+      return nullptr;
+    }
+
+    table = (uint64_t*)tbl->resolve_pa(tbl->handle, get_table_pa_from_entry(entry));
+  }
+
+  return &table[get_index_in_table(va, 4)];
+}
+
+bool test_and_clear_access_flag(MMUTable* tbl, VirtualPA va, bool* was_accessed) {
+  uint64_t* entry = find_page_entry(tbl, va);
+  if (entry == nullptr || get_entry_kind(*entry, 4) != EntryKind::Page || (*entry & CONTIGUOUS_BIT) != 0) {
+    return false;
+  }
+
+  *was_accessed = (*entry & ACCESS_FLAG) != 0;
+  if (!*was_accessed) {
+    return true;
+  }
+
+  // Only the flag changes, no break-before-make needed. But the TLB may still hold the entry with the flag set.
+  *entry &= ~ACCESS_FLAG;
+  data_sync(tbl);
+  invalidate_entry(tbl, va, true);
+  return true;
+}
+
+bool set_access_flag(MMUTable* tbl, VirtualPA va) {
+  uint64_t* entry = find_page_entry(tbl, va);
+  if (entry == nullptr || get_entry_kind(*entry, 4) != EntryKind::Page) {
+    return false;
+  }
+
+  // The entries without the flag are never cached by the TLB, there is nothing to invalidate.
+  *entry |= ACCESS_FLAG;
+  data_sync(tbl);
+  return true;
+}
+
+bool set_swap_entry(MMUTable* tbl, VirtualPA va, uint64_t swap_id) {
+  KASSERT(swap_id != 0 && swap_id < (1ull << (64 - SWAP_ID_SHIFT)));
+
+  uint64_t* entry = find_page_entry(tbl, va);
+  if (entry == nullptr || get_entry_kind(*entry, 4) != EntryKind::Invalid) {
+    return false;
+  }
+
+  *entry = (swap_id << SWAP_ID_SHIFT) | SWAP_MARKER;
+  return true;
+}
+
+bool get_swap_entry(const MMUTable* tbl, VirtualPA va, uint64_t* swap_id) {
+  const uint64_t* entry = find_page_entry(tbl, va);
+  if (entry == nullptr || (*entry & 0b11) != SWAP_MARKER) {
+    return false;
+  }
+
+  *swap_id = *entry >> SWAP_ID_SHIFT;
+  return true;
+}
+
+void clear_swap_entry(MMUTable* tbl, VirtualPA va) {
+  uint64_t* entry = find_page_entry(tbl, va);
+  if (entry != nullptr && (*entry & 0b11) == SWAP_MARKER) {
+    *entry = 0ull;
+  }
+}
+
+void map_range_in_table(MMUTable* tbl,
+                        VirtualPA va_start,
+                        VirtualPA va_end,
+                        PhysicalPA pa_start,
+                        PagesAttributes attr,
+                        uint64_t* table,
+                        size_t table_level,
+                        VirtualPA table_first_page_va);
+struct ClearedPageVisitor {
+  ClearedPageCallback callback;
+  void* data;
+};  // struct ClearedPageVisitor
+
+void clear_table(MMUTable* tbl,
+                 uint64_t* table,
+                 size_t table_level,
+                 VirtualPA table_va,
+                 TLBInvalidationBatch& batch,
+                 const ClearedPageVisitor* visitor = nullptr);
+
+/** Maps in @a new_table (not linked yet, replacing the block [@a entry_va_start; @a entry_va_stop] mapped
+ * to @a block_pa with @a block_attr) the regions of the block outside of [@a va_start; @a va_end]. */
+static void split_block_in_table(MMUTable* tbl,
+                                 VirtualPA va_start,
+                                 VirtualPA va_end,
+                                 PhysicalPA block_pa,
+                                 PagesAttributes block_attr,
+                                 uint64_t* new_table,
+                                 size_t new_table_level,
+                                 VirtualPA entry_va_start,
+                                 VirtualPA entry_va_stop) {
+  // Mapping [Entry_VA_Start; VA_Start[ -> [Entry_PA; ...[
+  if (va_start > entry_va_start) {
+    map_range_in_table(tbl, entry_va_start, va_start - PAGE_SIZE, block_pa, block_attr, new_table, new_table_level,
+                       entry_va_start);
+  }
+
+  // Mapping ]VA_End; Entry_VA_End] -> [Entry_PA + PA_Offset; ...[
+  if (va_end < entry_va_stop) {
+    const size_t pa_offset = va_end + PAGE_SIZE - entry_va_start;
+    map_range_in_table(tbl, va_end + PAGE_SIZE, entry_va_stop, block_pa + pa_offset, block_attr, new_table,
+                       new_table_level, entry_va_start);
+  }
+}
+
 /** All bound are *INCLUSIVE*
  * Prerequisites :
  *  - tbl != nullptr
@@ -267,67 +596,106 @@ void map_range_in_table(MMUTable* tbl,
   for (size_t index = inter_start_index; index <= inter_end_index; ++index) {
     const uint64_t entry = table[index];
     const auto entry_va_start = get_entry_va_from_table_index(table_first_page_va, table_level, index);
+    const auto entry_va_stop = table_last_page(entry_va_start, table_level + 1);
+    // Only meaningful if the entry is inside the mapped range.
+    const auto entry_pa = pa_start + (entry_va_start - va_start);
 
     const auto entry_kind = get_entry_kind(entry, table_level);
 
     if (entry_kind == EntryKind::Table) {
       auto* sub_table = (uint64_t*)tbl->resolve_pa(tbl->handle, get_table_pa_from_entry(entry));
-      map_range_in_table(tbl, va_start, va_end, pa_start, attr, sub_table, table_level + 1, entry_va_start);
+      if (!can_map_block(table_level, entry_va_start, entry_va_stop, va_start, va_end, entry_pa)) {
+        map_range_in_table(tbl, va_start, va_end, pa_start, attr, sub_table, table_level + 1, entry_va_start);
+        continue;
+      }
+
+      // The whole sub table is overwritten, it is replaced by a block.
+      table[index] = 0ull;
+      data_sync(tbl);
+
+      TLBInvalidationBatch batch(tbl);
+      clear_table(tbl, sub_table, table_level + 1, entry_va_start, batch);
+      batch.add(entry_va_start, false);
+      batch.flush();
+      tbl->free(tbl->handle, VirtualPA((uintptr_t)sub_table));
+
+      table[index] = encode_new_entry(tbl, entry_pa, table_level, attr);
+      data_sync(tbl);
       continue;
     }
 
     // entry_kind = Block, Page or Invalid
-    const auto entry_va_stop = table_last_page(entry_va_start, table_level + 1);
+    if (table_level == 4) {
+      const auto group_va_stop = entry_va_start + (CONTIGUOUS_GROUP - 1) * PAGE_SIZE;
+      const bool is_group_aligned =
+          index % CONTIGUOUS_GROUP == 0 && (entry_pa & (CONTIGUOUS_GROUP * PAGE_SIZE - 1)) == 0;
+      if (is_group_aligned && va_start <= entry_va_start && group_va_stop <= va_end) {
+        // The whole group is mapped with the contiguous bit, the old entries are all removed first.
+        bool has_old_entries = false;
+        for (size_t i = 0; i < CONTIGUOUS_GROUP; ++i) {
+          has_old_entries |= get_entry_kind(table[index + i], table_level) != EntryKind::Invalid;
+          table[index + i] = 0ull;
+        }
+
+        if (has_old_entries) {
+          data_sync(tbl);
+          for (size_t i = 0; i < CONTIGUOUS_GROUP; ++i) {
+            invalidate_va(tbl, entry_va_start + i * PAGE_SIZE, true);
+          }
+
+          tlb_sync(tbl);
+        }
+
+        for (size_t i = 0; i < CONTIGUOUS_GROUP; ++i) {
+          table[index + i] = encode_new_entry(tbl, entry_pa + i * PAGE_SIZE, table_level, attr, true);
+        }
+
+        data_sync(tbl);
+        index += CONTIGUOUS_GROUP - 1;
+        continue;
+      }
+
+      break_contiguous_group(tbl, table, index, entry_va_start);
+    }
 
-    if (table_level == 4 || (va_start <= entry_va_start && entry_va_stop <= va_end && table_level >= 2)) {
+    if (table_level == 4 || can_map_block(table_level, entry_va_start, entry_va_stop, va_start, va_end, entry_pa)) {
       // Map with a block/table
-      const size_t offset = entry_va_start - va_start;
-      const auto entry_pa = pa_start + offset;
       const uint64_t new_entry = encode_new_entry(tbl, entry_pa, table_level, attr);
       if (entry_kind != EntryKind::Invalid) {
         // entry_kind = Block or Page -> Need to invalidate previous entry
         table[index] = 0ull;
-        data_sync();
-        reload_tlb();
+        data_sync(tbl);
+        invalidate_entry(tbl, entry_va_start, true);
       }
 
       table[index] = new_entry;
-      data_sync();
+      data_sync(tbl);
       continue;
     }
 
     // table_level < 4
     // entry_kind = Block or Invalid
-    // Map with a table
+    // Map with a table: it is filled before being linked, so the untouched regions of a block stay
+    // mapped until the table replaces it.
+    VirtualPA new_table = tbl->alloc(tbl->handle);
+    PhysicalPA new_table_pa = tbl->resolve_va(tbl->handle, new_table);
 
-    // Store old attributes in case it was a block
-    PagesAttributes old_attr = {};
-    PhysicalPA old_pa = decode_entry(entry, &old_attr);
+    map_range_in_table(tbl, va_start, va_end, pa_start, attr, (uint64_t*)new_table, table_level + 1, entry_va_start);
 
     if (entry_kind == EntryKind::Block) {
+      PagesAttributes old_attr = {};
+      PhysicalPA old_pa = decode_entry(entry, &old_attr);
+      split_block_in_table(tbl, va_start, va_end, old_pa, old_attr, (uint64_t*)new_table, table_level + 1,
+                           entry_va_start, entry_va_stop);
+
       // entry_kind = Block -> Need to invalidate previous entry
       table[index] = 0ull;
-      data_sync();
-      reload_tlb();
+      data_sync(tbl);
+      invalidate_entry(tbl, entry_va_start, true);
     }
 
-    VirtualPA new_table = tbl->alloc(tbl->handle);
-    PhysicalPA new_table_pa = tbl->resolve_va(tbl->handle, new_table);
     table[index] = new_table_pa | TABLE_MARKER;
-    data_sync();
-
-    map_range_in_table(tbl, va_start, va_end, pa_start, attr, (uint64_t*)new_table, table_level + 1, entry_va_start);
-
-    if (entry_kind == EntryKind::Block) {
-      // Remap untouched regions
-      map_range_in_table(tbl, entry_va_start, va_start - PAGE_SIZE, old_pa, old_attr, (uint64_t*)new_table,
-                         table_level + 1, entry_va_start);
-
-      // Mapping ]VA_End; Entry_VA_End] -> [Entry_PA + PA_Offset; ...[
-      size_t pa_offset = va_end + PAGE_SIZE - entry_va_start;
-      map_range_in_table(tbl, va_end + PAGE_SIZE, entry_va_stop, old_pa + pa_offset, old_attr, (uint64_t*)new_table,
-                         table_level + 1, entry_va_start);
-    }
+    data_sync(tbl);
   }
 }
 
@@ -358,7 +726,8 @@ void unmap_range_in_table(MMUTable* tbl,
                           VirtualPA va_end,
                           uint64_t* table,
                           size_t table_level,
-                          VirtualPA table_first_page_va) {
+                          VirtualPA table_first_page_va,
+                          TLBInvalidationBatch& batch) {
   const auto table_last_page_va = table_last_page(table_first_page_va, table_level);
 
   if ((va_end < table_first_page_va) || (va_start > table_last_page_va) || (va_start > va_end)) {
@@ -379,66 +748,67 @@ void unmap_range_in_table(MMUTable* tbl,
 
     switch (get_entry_kind(entry, table_level)) {
       case EntryKind::Invalid: {
-        // Nothing to do here !
+        // Drop a swap entry left (see set_swap_entry()), so a freed table is always zeroed (see mmu_free_page()).
+        table[index] = 0ull;
         break;
       }
 
       case EntryKind::Block: {
         // May need to split the block :/
-        const auto entry_va_stop = table_last_page(table_first_page_va, table_level + 1);
+        const auto entry_va_stop = table_last_page(entry_va_start, table_level + 1);
 
         if (va_start <= entry_va_start && entry_va_stop <= va_end) {
           // Can erase the whole block !
           table[index] = 0ull;
-          data_sync();
-          reload_tlb();
+          data_sync(tbl);
+          batch.add(entry_va_start, true);
         } else {
           // Need to split :/
           // 1. Retrieve attributes and page
           PagesAttributes entry_attr{};
           PhysicalPA entry_pa = decode_entry(entry, &entry_attr);
 
-          // 2. Allocate new table
+          // 2. Allocate a new table and map the untouched regions in it
           VirtualPA new_table = tbl->alloc(tbl->handle);
           PhysicalPA new_table_pa = tbl->resolve_va(tbl->handle, new_table);
+          split_block_in_table(tbl, va_start, va_end, entry_pa, entry_attr, (uint64_t*)new_table, table_level + 1,
+                               entry_va_start, entry_va_stop);
+
+          // 3. And replace the block by the table
           table[index] = 0ull;
-          data_sync();
-          reload_tlb();
+          data_sync(tbl);
+          invalidate_entry(tbl, entry_va_start, true);
           table[index] = new_table_pa | TABLE_MARKER;
-          data_sync();
-
-          // 3. And map untouched regions
-
-          // Mapping [Entry_VA_Start; VA_Start[ -> [Entry_PA; ...[
-          map_range_in_table(tbl, entry_va_start, va_start - PAGE_SIZE, entry_pa, entry_attr, (uint64_t*)new_table,
-                             table_level + 1, entry_va_start);
-
-          // Mapping ]VA_End; Entry_VA_End] -> [Entry_PA + PA_Offset; ...[
-          size_t pa_offset = va_end + PAGE_SIZE - entry_va_start;
-          map_range_in_table(tbl, va_end + PAGE_SIZE, entry_va_stop, entry_pa + pa_offset, entry_attr,
-                             (uint64_t*)new_table, table_level + 1, entry_va_start);
+          data_sync(tbl);
         }
         break;
       }
 
       case EntryKind::Page: {
+        // A whole contiguous group can be removed at once, but not a part of it.
+        if (!is_contiguous_group_inside(entry_va_start, va_start, va_end)) {
+          break_contiguous_group(tbl, table, index, entry_va_start);
+        }
+
         table[index] = 0ull;
-        data_sync();
-        reload_tlb();
+        data_sync(tbl);
+        batch.add(entry_va_start, true);
         break;
       }
 
       case EntryKind::Table: {
-        const auto entry_va_stop = table_last_page(table_first_page_va, table_level + 1);
+        const auto entry_va_stop = table_last_page(entry_va_start, table_level + 1);
         VirtualPA sub_table_va = tbl->resolve_pa(tbl->handle, get_table_pa_from_entry(entry));
 
-        unmap_range_in_table(tbl, va_start, va_end, (uint64_t*)sub_table_va, table_level + 1, entry_va_start);
+        unmap_range_in_table(tbl, va_start, va_end, (uint64_t*)sub_table_va, table_level + 1, entry_va_start, batch);
 
         if (va_start <= entry_va_start && entry_va_stop <= va_end) {
           // The whole page as been unmapped, we can free it !
-          tbl->free(tbl->handle, sub_table_va);
           table[index] = 0ull;
-          data_sync();
+          data_sync(tbl);
+          // The table may still be in the walk caches, they must forget it before the page is reused.
+          invalidate_entry(tbl, entry_va_start, false);
+          tbl->free(tbl->handle, sub_table_va);
         }
       }
     }
@@ -453,7 +823,9 @@ bool unmap_range(MMUTable* tbl, VirtualPA va_start, VirtualPA va_end) {
     return false;
   }
 
-  unmap_range_in_table(tbl, va_start, va_end, (uint64_t*)tbl->pgd, 1, get_base_address(tbl));
+  TLBInvalidationBatch batch(tbl);
+  unmap_range_in_table(tbl, va_start, va_end, (uint64_t*)tbl->pgd, 1, get_base_address(tbl), batch);
+  batch.flush();
   return true;
 }
 
@@ -464,40 +836,92 @@ bool unmap_range(MMUTable* tbl, VirtualPA va_start, VirtualPA va_end) {
  *  - tbl->resolve_pa != nullptr
  *  - table != nullptr
  */
-void clear_table(MMUTable* tbl, uint64_t* table, size_t table_level, VirtualPA table_va) {
+void clear_table(MMUTable* tbl,
+                 uint64_t* table,
+                 size_t table_level,
+                 VirtualPA table_va,
+                 TLBInvalidationBatch& batch,
+                 const ClearedPageVisitor* visitor) {
   for (size_t i = 0; i < TABLE_ENTRIES; ++i) {
     const uint64_t entry = table[i];
+    if (entry == 0ull) {
+      continue;  // Most entries are empty, no need to write them.
+    }
+
     const VirtualPA entry_va = get_entry_va_from_table_index(table_va, table_level, i);
     table[i] = 0ull;  // Clear entry
-    data_sync();
+    data_sync(tbl);
 
     switch (get_entry_kind(entry, table_level)) {
       case EntryKind::Invalid: {
-        // Nothing else to do good !
+        if (visitor != nullptr && table_level == 4 && (entry & 0b11) == SWAP_MARKER) {
+          visitor->callback(visitor->data, entry_va, 0, entry >> SWAP_ID_SHIFT);
+        }
         break;
       }
       case EntryKind::Table: {
         auto* sub_table = (uint64_t*)tbl->resolve_pa(tbl->handle, get_table_pa_from_entry(entry));
-        clear_table(tbl, sub_table, table_level + 1, entry_va);
-        tbl->free(tbl->handle, VirtualPA((uintptr_t)sub_table));
+        clear_table(tbl, sub_table, table_level + 1, entry_va, batch, visitor);
+        batch.add(entry_va, false);
+        batch.free_table(VirtualPA((uintptr_t)sub_table));
         break;
       }
 
       case EntryKind::Page:
       case EntryKind::Block: {
-        reload_tlb();
+        batch.add(entry_va, true);
+        if (visitor != nullptr) {
+          const PhysicalPA pa = decode_entry(entry, nullptr);
+          const size_t entry_byte_size = (size_t)1 << (12 + 9 * (4 - table_level));
+          for (size_t offset = 0; offset < entry_byte_size; offset += PAGE_SIZE) {
+            visitor->callback(visitor->data, entry_va + offset, pa + offset, 0);
+          }
+        }
         break;
       }
     }
   }
 }
 
-void clear_all(MMUTable* tbl) {
+static size_t count_mapped_pages_in_table(const MMUTable* tbl, const uint64_t* table, size_t table_level) {
+  size_t count = 0;
+  for (size_t i = 0; i < TABLE_ENTRIES; ++i) {
+    const uint64_t entry = table[i];
+    switch (get_entry_kind(entry, table_level)) {
+      case EntryKind::Invalid:
+        break;
+      case EntryKind::Table: {
+        const auto* sub_table = (const uint64_t*)tbl->resolve_pa(tbl->handle, get_table_pa_from_entry(entry));
+        count += count_mapped_pages_in_table(tbl, sub_table, table_level + 1);
+        break;
+      }
+      case EntryKind::Page:
+      case EntryKind::Block:
+        count += (size_t)1 << (9 * (4 - table_level));
+        break;
+    }
+  }
+
+  return count;
+}
+
+size_t count_mapped_pages(const MMUTable* tbl) {
+  if (tbl == nullptr || tbl->resolve_pa == nullptr || (uint64_t*)tbl->pgd == nullptr) {
+    return 0;
+  }
+
+  return count_mapped_pages_in_table(tbl, (const uint64_t*)tbl->pgd, 1);
+}
+
+void clear_all(MMUTable* tbl, ClearedPageCallback callback, void* data) {
   if (tbl == nullptr || tbl->free == nullptr || tbl->resolve_pa == nullptr || (uint64_t*)tbl->pgd == nullptr) {
     return;
   }
 
-  clear_table(tbl, (uint64_t*)tbl->pgd, 1, get_base_address(tbl));
+  TLBInvalidationBatch batch(tbl);
+  const ClearedPageVisitor visitor = {callback, data};
+  clear_table(tbl, (uint64_t*)tbl->pgd, 1, get_base_address(tbl), batch, callback != nullptr ? &visitor : nullptr);
+  batch.flush();
 }
 
 /** All bound are *INCLUSIVE*
@@ -516,7 +940,8 @@ void change_properties_for_range(MMUTable* tbl,
                                  PagesAttributes attr,
                                  uint64_t* table,
                                  size_t table_level,
-                                 VirtualPA table_first_page_va) {
+                                 VirtualPA table_first_page_va,
+                                 TLBInvalidationBatch& batch) {
   const auto table_last_page_va = table_last_page(table_first_page_va, table_level);
 
   if ((va_end < table_first_page_va) || (va_start > table_last_page_va) || (va_start > va_end)) {
@@ -543,7 +968,7 @@ void change_properties_for_range(MMUTable* tbl,
 
       case EntryKind::Block: {
         // May need to split the block :/
-        const auto entry_va_stop = table_last_page(table_first_page_va, table_level + 1);
+        const auto entry_va_stop = table_last_page(entry_va_start, table_level + 1);
 
         PagesAttributes entry_attr{};
         PhysicalPA entry_pa = decode_entry(entry, &entry_attr);
@@ -551,32 +976,31 @@ void change_properties_for_range(MMUTable* tbl,
         if (va_start <= entry_va_start && entry_va_stop <= va_end) {
           // We can change the whole block !
           table[index] = encode_new_entry(tbl, entry_pa, table_level, attr);
-          data_sync();
-          reload_tlb();
+          data_sync(tbl);
+          batch.add(entry_va_start, true);
         } else {
           // Need to split :/
-          // 1. Allocate new table
+          // 1. Allocate a new table
           VirtualPA new_table = tbl->alloc(tbl->handle);
           PhysicalPA new_table_pa = tbl->resolve_va(tbl->handle, new_table);
-          table[index] = new_table_pa | TABLE_MARKER;
-          data_sync();
-          reload_tlb();
-
-          // 2. And map untouched regions
 
-          // Mapping [Entry_VA_Start; VA_Start[ -> [Entry_PA; ...[
-          map_range_in_table(tbl, entry_va_start, va_start - PAGE_SIZE, entry_pa, entry_attr, (uint64_t*)new_table,
+          // 2. Map the changed region, [VA_Start; VA_End] -> [Entry_PA + PA_Offset; ...[ (the part inside the block)
+          const auto changed_va_start = libk::max(va_start, entry_va_start);
+          const auto changed_va_end = libk::min(va_end, entry_va_stop);
+          const auto changed_pa_start = entry_pa + (changed_va_start - entry_va_start);
+          map_range_in_table(tbl, changed_va_start, changed_va_end, changed_pa_start, attr, (uint64_t*)new_table,
                              table_level + 1, entry_va_start);
 
-          // Mapping [VA_Start; VA_End] -> [Entry_PA + PA_Offset1; ...[
-          size_t pa_offset1 = va_start - entry_va_start;
-          map_range_in_table(tbl, va_start, va_end, entry_pa + pa_offset1, attr, (uint64_t*)new_table, table_level + 1,
-                             entry_va_start);
+          // 3. And the untouched regions
+          split_block_in_table(tbl, va_start, va_end, entry_pa, entry_attr, (uint64_t*)new_table, table_level + 1,
+                               entry_va_start, entry_va_stop);
 
-          // Mapping ]VA_End; Entry_VA_End] -> [Entry_PA + PA_Offset2; ...[
-          size_t pa_offset2 = va_end + PAGE_SIZE - entry_va_start;
-          map_range_in_table(tbl, va_end + PAGE_SIZE, entry_va_stop, entry_pa + pa_offset2, entry_attr,
-                             (uint64_t*)new_table, table_level + 1, entry_va_start);
+          // 4. Replace the block by the table
+          table[index] = 0ull;
+          data_sync(tbl);
+          invalidate_entry(tbl, entry_va_start, true);
+          table[index] = new_table_pa | TABLE_MARKER;
+          data_sync(tbl);
         }
 
         break;
@@ -585,15 +1009,21 @@ void change_properties_for_range(MMUTable* tbl,
       case EntryKind::Page: {
         PhysicalPA entry_pa = decode_entry(entry, nullptr);
 
-        table[index] = encode_new_entry(tbl, entry_pa, table_level, attr);
-        data_sync();
-        reload_tlb();
+        // The entries of a contiguous group must keep the same attributes.
+        if (!is_contiguous_group_inside(entry_va_start, va_start, va_end)) {
+          break_contiguous_group(tbl, table, index, entry_va_start);
+        }
+
+        const bool is_contiguous = (table[index] & CONTIGUOUS_BIT) != 0;
+        table[index] = encode_new_entry(tbl, entry_pa, table_level, attr, is_contiguous);
+        data_sync(tbl);
+        batch.add(entry_va_start, true);
         break;
       }
 
       case EntryKind::Table: {
         auto* sub_table = (uint64_t*)tbl->resolve_pa(tbl->handle, get_table_pa_from_entry(entry));
-        change_properties_for_range(tbl, va_start, va_end, attr, sub_table, table_level + 1, entry_va_start);
+        change_properties_for_range(tbl, va_start, va_end, attr, sub_table, table_level + 1, entry_va_start, batch);
         break;
       }
     }
@@ -606,7 +1036,9 @@ bool change_attr_range(MMUTable* tbl, VirtualPA va_start, VirtualPA va_end, Page
     return false;
   }
 
-  change_properties_for_range(tbl, va_start, va_end, attr, (uint64_t*)tbl->pgd, 1, get_base_address(tbl));
+  TLBInvalidationBatch batch(tbl);
+  change_properties_for_range(tbl, va_start, va_end, attr, (uint64_t*)tbl->pgd, 1, get_base_address(tbl), batch);
+  batch.flush();
   return true;
 }
 
@@ -67,6 +67,8 @@ struct MMUTable {
   FreeFun free;          //<! The function used to free a page
   ResolvePA resolve_pa;  //<! The function used to convert a physical address to a virtual one
   ResolveVA resolve_va;  //<! The function used to convert a virtual address to a physical one
+
+  bool is_inactive = false;  //<! Not used by any core yet: written without per-entry barriers nor TLB invalidations
 };
 
 /** Finds, if it exists, the entry specific to the virtual address @a va.
@@ -77,6 +79,13 @@ struct MMUTable {
  */
 [[nodiscard]] bool get_attr(const MMUTable* table, VirtualPA va, PagesAttributes* attr);
 
+/** Finds, if it exists, the physical address mapped at the virtual address @a va.
+ *
+ * @returns - `true` if the entry exists, @a pa is filled in this case. @n
+ *          - `false` if the entry is not found, @a pa is not modified.
+ */
+[[nodiscard]] bool get_pa(const MMUTable* table, VirtualPA va, PhysicalPA* pa);
+
 /** Change parameters associated with the virtual address @a va.
  *
  * @returns - `true` if the operation was completed successfully. @n
@@ -87,7 +96,8 @@ struct MMUTable {
 /** Maps the virtual address range from @a va_start to @a va_end *INCLUSIVE*
  * to the physical addresses @a pa_start and following, using the attributes @a attr.
  * Be careful, this operation *will overwrite* any already existing mapping for the specified range.
- * Mapping is done in a way to minimize the number of tables used.
+ * Mapping is done in a way to minimize the number of tables used: block descriptors (1 GiB or 2 MiB) are
+ * used wherever the range covers them and the physical address is aligned on their size.
  *
  * @returns - `true` if the full operation was completed successfully. @n
  *          - `false` if certain prerequisites are not checked, the table is not modified.
@@ -99,6 +109,7 @@ struct MMUTable {
                              PagesAttributes attr);
 
 /** Unmaps the virtual address range from @a va_start to @a va_end *INCLUSIVE*.
+ * The blocks partially inside the range are split.
  *
  * @returns - `true` if the full operation was completed successfully. @n
  *          - `false` if certain prerequisites are not checked. The table is not modified in this case.
@@ -112,8 +123,37 @@ struct MMUTable {
  */
 [[nodiscard]] bool change_attr_range(MMUTable* table, VirtualPA va_start, VirtualPA va_end, PagesAttributes attr);
 
-/** Clear the whole table, deallocating all used pages and unmapping everything. */
-void clear_all(MMUTable* table);
+/** Clears the access flag of the page mapped at @a va, and stores into @a was_accessed whether it was set: if the
+ * page was accessed since the flag was last cleared. The next access raises an access flag fault, to be handled by
+ * set_access_flag(). Returns false if @a va is not mapped by a single page (a block or a contiguous group). */
+[[nodiscard]] bool test_and_clear_access_flag(MMUTable* table, VirtualPA va, bool* was_accessed);
+
+/** Sets the access flag of the page mapped at @a va, after an access flag fault. Returns false if it is not mapped
+ * by a page. */
+[[nodiscard]] bool set_access_flag(MMUTable* table, VirtualPA va);
+
+/** Stores the non-zero @a swap_id into the unmapped page @a va (an invalid entry, not seen by the table walkers),
+ * to find the content of a page moved out of memory (see Zram). The accesses raise translation faults.
+ * Returns false if the page is mapped, or if there is no last level table for it. */
+[[nodiscard]] bool set_swap_entry(MMUTable* table, VirtualPA va, uint64_t swap_id);
+
+/** Finds the swap ID stored at @a va by set_swap_entry(). Returns false if there is none. */
+[[nodiscard]] bool get_swap_entry(const MMUTable* table, VirtualPA va, uint64_t* swap_id);
+
+/** Removes the swap ID stored at @a va by set_swap_entry(), if any. */
+void clear_swap_entry(MMUTable* table, VirtualPA va);
+
+/** Returns the count of pages mapped by @a table (a block counts as all the pages it covers). */
+[[nodiscard]] size_t count_mapped_pages(const MMUTable* table);
+
+/** Called by clear_all() for each page mapped by the table (each page of a block) with its physical address
+ * @a pa, and for each swap entry (see set_swap_entry()) with @a pa = 0 and its @a swap_id. */
+using ClearedPageCallback = void (*)(void* data, VirtualPA va, PhysicalPA pa, uint64_t swap_id);
+
+/** Clear the whole table, deallocating all used pages and unmapping everything. The mapped pages themselves
+ * are not freed, but they are given to @a callback (if any) with @a data, so the caller can free the ones it
+ * owns during the same walk. */
+void clear_all(MMUTable* table, ClearedPageCallback callback = nullptr, void* data = nullptr);
 
 /** Refresh the TLB for this page mapping. */
 void reload_tlb();
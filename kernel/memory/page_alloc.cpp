@@ -1,103 +1,287 @@
 #include "page_alloc.hpp"
-#include <climits>
+#include <libk/assert.hpp>
+#include <libk/utils.hpp>
 #include "boot/mmu_utils.hpp"
-#include <libk/log.hpp>
+#include "trace.hpp"
 
-uint64_t PageAlloc::memory_needed(uintptr_t nb_pages) {
-  return libk::div_round_up(nb_pages * 2, CHAR_BIT);
+uint64_t PageAlloc::memory_needed(size_t nb_pages) {
+  return nb_pages * sizeof(PageInfo);
 }
 
-PageAlloc::PageAlloc(size_t nb_pages, uintptr_t array) : m_nb_pages(nb_pages), m_mmap(array, memory_needed(nb_pages)) {
-  m_mmap.fill_array(true);
-  m_mmap.set_bit(0, false);
+PageAlloc::PageAlloc(size_t nb_pages, uintptr_t array) : m_nb_pages(nb_pages), m_pages((PageInfo*)array) {
+  KASSERT(nb_pages < NO_PAGE);
+
+  for (auto& list : m_free_lists) {
+    list = NO_PAGE;
+  }
+
+  // Only the first zone is initialized at boot, the next ones on their first use.
+  init_next_zone();
+}
+
+bool PageAlloc::init_next_zone() {
+  if (m_nb_initialized_pages == m_nb_pages) {
+    return false;
+  }
+
+  const size_t zone_start = m_nb_initialized_pages;
+  const size_t zone_end = libk::min(zone_start + ZONE_NB_PAGES, m_nb_pages);
+
+  // A zeroed page info is a tail page without extra references, its links are only used by the block heads.
+  zero_range((VirtualPA)&m_pages[zone_start], (VirtualPA)&m_pages[zone_end]);
+  static_assert(STATE_TAIL == 0);
+
+  // Cover the zone with the biggest possible blocks.
+  size_t index = zone_start;
+  while (index < zone_end) {
+    size_t order = 0;
+    while (order < MAX_ORDER && (index & (1ul << order)) == 0 && index + (2ul << order) <= zone_end) {
+      order++;
+    }
+
+    push_free_block(index, order);
+    index += 1ul << order;
+  }
+
+  m_nb_initialized_pages = zone_end;
+  return true;
 }
 
 size_t PageAlloc::page_index(PhysicalPA addr) const {
-  return m_nb_pages + addr / PAGE_SIZE;
+  return addr / PAGE_SIZE;
 }
 
-bool PageAlloc::page_status(PhysicalPA addr) const {
-  return m_mmap.get_bit(page_index(addr));
+bool PageAlloc::is_free_block(size_t index, size_t order) const {
+  return m_pages[index].state == (STATE_FREE | order);
 }
 
-void PageAlloc::mark_as_used(PhysicalPA addr) {
-  size_t index = page_index(addr);
-  bool side_value = false;
-  while (!side_value & (index != 0)) {
-    m_mmap.set_bit(index, false);
-    side_value = m_mmap.get_bit(index ^ 0x1ul);
-    index = index / 2;
+bool PageAlloc::find_free_block(size_t index, size_t* block, size_t* order) const {
+  // Blocks are aligned on their size, so the block containing the page starts at one of these indices.
+  for (size_t candidate_order = 0; candidate_order <= MAX_ORDER; ++candidate_order) {
+    const size_t candidate = index & ~((1ul << candidate_order) - 1);
+    const uint8_t state = m_pages[candidate].state;
+    if (state == STATE_TAIL)
+      continue;
+
+    // The first block head found is the one containing the page (it can not be smaller than the alignment).
+    if ((state & STATE_FREE) == 0)
+      return false;
+
+    *block = candidate;
+    *order = state & STATE_ORDER_MASK;
+    KASSERT(index < candidate + (1ul << *order));
+    return true;
   }
+
+  return false;
 }
 
-void PageAlloc::free_page(PhysicalPA addr) {
-  size_t index = page_index(addr);
-  while (index != 0) {
-    if (m_mmap.get_bit(index)) {
-      break;
+void PageAlloc::push_free_block(size_t index, size_t order) {
+  PageInfo& page = m_pages[index];
+  page.state = STATE_FREE | order;
+  page.previous = NO_PAGE;
+  page.next = m_free_lists[order];
+
+  if (page.next != NO_PAGE) {
+    m_pages[page.next].previous = index;
+  }
+
+  m_free_lists[order] = index;
+  m_nb_free_pages += 1ul << order;
+}
+
+void PageAlloc::remove_free_block(size_t index, size_t order) {
+  PageInfo& page = m_pages[index];
+  KASSERT(is_free_block(index, order));
+
+  if (page.previous == NO_PAGE) {
+    m_free_lists[order] = page.next;
+  } else {
+    m_pages[page.previous].next = page.next;
+  }
+
+  if (page.next != NO_PAGE) {
+    m_pages[page.next].previous = page.previous;
+  }
+
+  page = {NO_PAGE, NO_PAGE, STATE_TAIL, 0};
+  m_nb_free_pages -= 1ul << order;
+}
+
+void PageAlloc::set_used_block(size_t index, size_t order) {
+  m_pages[index].state = STATE_USED | order;
+}
+
+void PageAlloc::mark_as_used(PhysicalPA addr) {
+  const size_t index = page_index(addr);
+  if (index >= m_nb_pages) {
+    return;
+  }
+
+  while (index >= m_nb_initialized_pages) {
+    init_next_zone();
+  }
+
+  size_t block, order;
+  if (!find_free_block(index, &block, &order)) {
+    return;  // already used
+  }
+
+  // Split the block until the page is alone, giving back the halves without it.
+  remove_free_block(block, order);
+  while (order > 0) {
+    order--;
+    const size_t half = 1ul << order;
+    if (index < block + half) {
+      push_free_block(block + half, order);
     } else {
-      m_mmap.set_bit(index, true);
-      index = index / 2;
+      push_free_block(block, order);
+      block += half;
     }
   }
+
+  set_used_block(index, 0);
 }
 
-bool PageAlloc::fresh_page(PhysicalPA* addr) {
-  size_t index = 1;
-  while (true) {
-    if (m_mmap.get_bit(index)) {
-      if (index >= m_nb_pages) {
-        *addr = (index - m_nb_pages) * PAGE_SIZE;
-        mark_as_used(*addr);
-        return true;
-      } else {
-        index = index * 2;
-      }
-    } else if (index % 2) {
-      return false;
-    } else {
-      index += 1;
+bool PageAlloc::fresh_pages(size_t nb_pages, PhysicalPA* start) {
+  if (nb_pages == 0) {
+    return false;
+  }
+
+  size_t wanted_order = 0;
+  while ((1ul << wanted_order) < nb_pages) {
+    wanted_order++;
+  }
+
+  if (wanted_order > MAX_ORDER) {
+    return false;
+  }
+
+  size_t order = wanted_order;
+  while (order <= MAX_ORDER && m_free_lists[order] == NO_PAGE) {
+    order++;
+
+    // The initialized zones are exhausted, try again with the next one.
+    if (order > MAX_ORDER && init_next_zone()) {
+      order = wanted_order;
+    }
+  }
+
+  if (order > MAX_ORDER) {
+    return false;
+  }
+
+  // Split the found block until it has the wanted order.
+  const size_t block = m_free_lists[order];
+  remove_free_block(block, order);
+  while (order > wanted_order) {
+    order--;
+    push_free_block(block + (1ul << order), order);
+  }
+
+  // The block may be bigger than asked: it is cut in used sub-blocks (one per bit of nb_pages, biggest
+  // first, so they stay aligned), and the remaining pages are given back.
+  size_t index = block;
+  for (size_t sub_order = wanted_order + 1; sub_order-- > 0;) {
+    if (nb_pages & (1ul << sub_order)) {
+      set_used_block(index, sub_order);
+      index += 1ul << sub_order;
     }
   }
+
+  const size_t block_end = block + (1ul << wanted_order);
+  for (size_t sub_order = 0; index < block_end; ++sub_order) {
+    if ((index - block) & (1ul << sub_order)) {
+      push_free_block(index, sub_order);
+      index += 1ul << sub_order;
+    }
+  }
+
+  *start = block * PAGE_SIZE;
+  TRACE_EVENT(PAGE_ALLOC, *start, nb_pages);
+  return true;
 }
 
-/* Test functions
-
-void test_bit_array() {
-  uint64_t mon_tableau[2];
-  libk::BitArray test = libk::BitArray(mon_tableau, sizeof(mon_tableau) * 8);
-  // test.set_bit((size_t)0, true);
-  // libk::print("Le premier bit est {}", test.get_bit((size_t)0));
-  // libk::print("Le second bit est {}", test.get_bit((size_t)1));
-  test.set_bit((size_t)3, false);
-  for (size_t i = 0; i <= 65; i++) {
-    libk::print("Le bit {} est {}", i, test.get_bit(i));
-  }
-}
-
-void test_page_alloc() {
-  // Test du PageAlloc
-  libk::print("Test begin");
-  const size_t nb_pages = 64;
-  KASSERT(PageAlloc::memory_needed(nb_pages) == 16);
-  uint8_t array_mem[16];
-  PageAlloc test = PageAlloc(nb_pages, array_mem);
-  test.mark_as_used(31);
-  libk::print("Mark 1");
-  PhysicalPA addr;
-  test.fresh_page(&addr);
-  libk::print("Mark 2");
-  libk::print("Le statut de la page {} est {}", addr, test.page_status(addr));
-  while (test.fresh_page(&addr)) {
-  }
-  test.mmu_free_page(0);
-  libk::print("Mark 3");
-  libk::print("Le statut de la première page est {}", test.page_status(0));
-  if (test.fresh_page(&addr)) {
-    libk::print("Test succeeded !");
-  } else {
-    libk::print("Test failed ...");
+bool PageAlloc::fresh_aligned_pages(size_t order, PhysicalPA* start) {
+  if (!fresh_pages(1ul << order, start)) {
+    return false;
+  }
+
+  // Each page becomes a used block of its own.
+  const size_t index = page_index(*start);
+  for (size_t i = 0; i < (1ul << order); ++i) {
+    set_used_block(index + i, 0);
+  }
+
+  return true;
+}
+
+void PageAlloc::free_block(size_t index) {
+  KASSERT((m_pages[index].state & STATE_USED) != 0);
+  size_t order = m_pages[index].state & STATE_ORDER_MASK;
+  m_pages[index].state = STATE_TAIL;
+
+  // Merge with the buddy while it is free.
+  while (order < MAX_ORDER) {
+    const size_t buddy = index ^ (1ul << order);
+    if (buddy + (1ul << order) > m_nb_initialized_pages || !is_free_block(buddy, order)) {
+      break;
+    }
+
+    remove_free_block(buddy, order);
+    index = libk::min(index, buddy);
+    order++;
+  }
+
+  push_free_block(index, order);
+}
+
+void PageAlloc::free_pages(PhysicalPA start, size_t nb_pages) {
+  size_t index = page_index(start);
+  const size_t end = index + nb_pages;
+  KASSERT(end <= m_nb_pages);
+  TRACE_EVENT(PAGE_FREE, start, nb_pages);
+
+  // Pages are freed by sub-blocks, the same as allocated by fresh_pages().
+  while (index < end) {
+    const size_t order = m_pages[index].state & STATE_ORDER_MASK;
+    free_block(index);
+    index += 1ul << order;
   }
 }
 
- */
+void PageAlloc::add_reference(PhysicalPA addr) {
+  PageInfo& page = m_pages[page_index(addr)];
+  KASSERT(page.state == (STATE_USED | 0));
+  KASSERT(page.nb_extra_references < UINT16_MAX);
+  page.nb_extra_references++;
+}
+
+bool PageAlloc::remove_reference(PhysicalPA addr) {
+  PageInfo& page = m_pages[page_index(addr)];
+  if (page.nb_extra_references == 0) {
+    return false;
+  }
+
+  page.nb_extra_references--;
+  return true;
+}
+
+bool PageAlloc::is_shared(PhysicalPA addr) const {
+  return m_pages[page_index(addr)].nb_extra_references > 0;
+}
+
+bool PageAlloc::page_status(PhysicalPA addr) const {
+  const size_t index = page_index(addr);
+  if (index >= m_nb_pages) {
+    return false;
+  }
+
+  // The pages of the zones not initialized yet were never allocated.
+  if (index >= m_nb_initialized_pages) {
+    return true;
+  }
+
+  size_t block, order;
+  return find_free_block(index, &block, &order);
+}
@@ -1,9 +1,28 @@
 #pragma once
-#include <libk/bit_array.hpp>
+#include <cstddef>
+#include <cstdint>
 #include "mmu_table.hpp"
 
+/**
+ * A buddy allocator managing a contiguous section of physical pages.
+ *
+ * Free pages are grouped in blocks of 2^order pages (aligned on their size, relatively to the
+ * section start) kept in one free list per order. An allocation splits the smallest large enough
+ * block, and a freed block is merged with its buddy as long as the buddy is also free.
+ *
+ * The bookkeeping is done in a separate array (see memory_needed()), so the free pages are never
+ * written by the allocator.
+ *
+ * The section is initialized by zones of ZONE_NB_PAGES pages: only the first one at boot, the next ones when
+ * the initialized ones are exhausted (or when one of their pages is marked as used). Its pages are then free.
+ */
 class PageAlloc {
  public:
+  /** Biggest managed blocks are 2^MAX_ORDER pages (1 GiB). */
+  static constexpr size_t MAX_ORDER = 18;
+  /** The count of pages initialized at once (256 MiB), a power of two so the zones are made of whole blocks. */
+  static constexpr size_t ZONE_NB_PAGES = 1ul << 16;
+
   explicit PageAlloc() = default;
   explicit PageAlloc(size_t nb_pages, uintptr_t array);
 
@@ -14,22 +33,81 @@ class PageAlloc {
   /** Tries to find a fresh page.
    * @returns   - `true` in case of success, @a addr is filled in this case. @n
    *            - `false` otherwise, @a addr is not modified. */
-  bool fresh_page(PhysicalPA* addr);
+  bool fresh_page(PhysicalPA* addr) { return fresh_pages(1, addr); }
+
+  /** Tries to find @a nb_pages physically contiguous fresh pages.
+   * @returns   - `true` in case of success, @a start is filled with the first page in this case. @n
+   *            - `false` otherwise, @a start is not modified. */
+  bool fresh_pages(size_t nb_pages, PhysicalPA* start);
+
+  /** Tries to find 2^@a order physically contiguous fresh pages, aligned on their count (relatively to
+   * the section start). Unlike fresh_pages(), each page can then be freed alone by free_page().
+   * @returns   - `true` in case of success, @a start is filled with the first page in this case. @n
+   *            - `false` otherwise, @a start is not modified. */
+  bool fresh_aligned_pages(size_t order, PhysicalPA* start);
 
   /** @brief Free the physical page @a addr. */
-  void free_page(PhysicalPA addr);
+  void free_page(PhysicalPA addr) { free_pages(addr, 1); }
+
+  /** @brief Free @a nb_pages pages starting from @a start, previously returned by fresh_pages(). */
+  void free_pages(PhysicalPA start, size_t nb_pages);
+
+  /** Adds an owner to the used page @a addr (pages are shared by the copy-on-write mappings). */
+  void add_reference(PhysicalPA addr);
+
+  /** Removes an owner of the used page @a addr, if it has several ones.
+   * @returns `true` if the page is still used by other owners, `false` if it has a single owner. */
+  bool remove_reference(PhysicalPA addr);
+
+  /** Checks if the used page @a addr has several owners. */
+  [[nodiscard]] bool is_shared(PhysicalPA addr) const;
 
   /** Check if physical page is free or not
    * @returns   - `true` if page is free @n
    *            - `false` otherwise */
   bool page_status(PhysicalPA addr) const;
 
+  /** Gets the count of free pages, the ones of the zones not initialized yet included. */
+  [[nodiscard]] size_t get_nb_free_pages() const { return m_nb_free_pages + (m_nb_pages - m_nb_initialized_pages); }
+
   /** @brief Returns the memory needed by this construction to manage
    * @a nb_pages pages in *bytes* */
   static uint64_t memory_needed(size_t nb_pages);
 
- protected:
-  inline size_t page_index(PhysicalPA addr) const;
-  uint64_t m_nb_pages;
-  libk::BitArray m_mmap;
+ private:
+  static constexpr uint32_t NO_PAGE = UINT32_MAX;
+
+  /** The state of a page that is not the first page of a block. */
+  static constexpr uint8_t STATE_TAIL = 0;
+  /** Flags of the first page of a block, the lower bits store the block order. */
+  static constexpr uint8_t STATE_FREE = 1 << 7;
+  static constexpr uint8_t STATE_USED = 1 << 6;
+  static constexpr uint8_t STATE_ORDER_MASK = STATE_USED - 1;
+
+  struct PageInfo {
+    // Links inside the free list of the block order (only for the first page of a free block).
+    uint32_t next;
+    uint32_t previous;
+    uint8_t state;
+    // Count of owners of the page (for a used single page), minus one.
+    uint16_t nb_extra_references;
+  };  // struct PageInfo
+
+  [[nodiscard]] size_t page_index(PhysicalPA addr) const;
+  [[nodiscard]] bool is_free_block(size_t index, size_t order) const;
+  /** Finds the free block containing the page @a index, returns false if the page is used. */
+  bool find_free_block(size_t index, size_t* block, size_t* order) const;
+
+  void push_free_block(size_t index, size_t order);
+  void remove_free_block(size_t index, size_t order);
+  void set_used_block(size_t index, size_t order);
+  void free_block(size_t index);
+  /** Initializes the next zone of the section, returns false if they are all initialized. */
+  bool init_next_zone();
+
+  size_t m_nb_pages = 0;
+  size_t m_nb_initialized_pages = 0;
+  size_t m_nb_free_pages = 0;
+  PageInfo* m_pages = nullptr;
+  uint32_t m_free_lists[MAX_ORDER + 1] = {};
 };
@@ -1,13 +1,11 @@
 #include "page_alloc_list.hpp"
+#include <libk/assert.hpp>
 #include <libk/utils.hpp>
 #include "boot/mmu_utils.hpp"
 #include "hardware/kernel_dt.hpp"
+#include "hardware/smp.hpp"
 
-bool PageAllocList::parse_memory_reg(libk::LinearAllocator& mem_alloc,
-                                     Property prop,
-                                     PageAllocList* list,
-                                     size_t contiguous_res_bytes) {
-  bool reserved_section = false;
+bool PageAllocList::parse_memory_reg(libk::LinearAllocator& mem_alloc, Property prop) {
   size_t index = 0;
 
   while (index < prop.length) {
@@ -23,31 +21,17 @@ bool PageAllocList::parse_memory_reg(libk::LinearAllocator& mem_alloc,
     }
 
     // Memory Chunk start
-    const PhysicalPA chunk_start = memory_chunk_start;
+    const PhysicalPA chunk_start = libk::align_to_next(memory_chunk_start, PAGE_SIZE);
 
     // Memory Chunk end
     const PhysicalPA chunk_end = libk::align_to_previous(memory_chunk_start + memory_chunk_size, PAGE_SIZE);
 
-    // Number of page of the Chunk.
-    const size_t chunk_nb_pages = (chunk_end - chunk_start) / PAGE_SIZE;
-
-    // Number of asked reserved pages.
-    const size_t nb_reserved_pages = libk::div_round_up(contiguous_res_bytes, PAGE_SIZE);
-
-    const PhysicalPA page_start = chunk_start;  // Starting page of the allocator.
-    PhysicalPA page_end;                        // Stopping page of the allocator.
-
-    if (!reserved_section && chunk_nb_pages > 2 * nb_reserved_pages) {
-      page_end = chunk_end - contiguous_res_bytes - PAGE_SIZE;
-
-      contiguous_res_start = page_end;
-      contiguous_res_stop = chunk_end;
-      reserved_section = true;
-    } else {
-      page_end = chunk_end;
+    if (chunk_end <= chunk_start) {
+      continue;
     }
 
-    const size_t nb_pages = libk::div_round_down(page_end - page_start + 1, PAGE_SIZE);
+    // Number of page of the Chunk.
+    const size_t nb_pages = (chunk_end - chunk_start) / PAGE_SIZE;
     const size_t nb_used_page = libk::div_round_up(PageAlloc::memory_needed(nb_pages), PAGE_SIZE);
 
     PhysicalPA page_alloc_physical_memory;
@@ -56,18 +40,16 @@ bool PageAllocList::parse_memory_reg(libk::LinearAllocator& mem_alloc,
     }
 
     const uintptr_t page_alloc_memory = (page_alloc_physical_memory + KERNEL_BASE);
-    list->add_allocator(mem_alloc, page_start, page_end, nb_pages, page_alloc_memory);
+    add_allocator(mem_alloc, chunk_start, chunk_end, nb_pages, page_alloc_memory);
   }
 
-  return reserved_section;
+  return true;
 }
 
-PageAllocList::PageAllocList(libk::LinearAllocator& mem_alloc, size_t contiguous_res_bytes)
-    : contiguous_res_start(0), contiguous_res_stop(0), _list_beg(nullptr), _list_end(nullptr) {
+PageAllocList::PageAllocList(libk::LinearAllocator& mem_alloc) : _list_beg(nullptr), _list_end(nullptr) {
   // Set up the list of page allocators
   Property prop;
 
-  bool reserved_ok = false;
   for (const auto& node : KernelDT::get_root().get_children()) {
     if (node.get_name().starts_with("memory@")) {
       // Found a memory node !
@@ -76,12 +58,28 @@ PageAllocList::PageAllocList(libk::LinearAllocator& mem_alloc, size_t contiguous
         continue;
       }
 
-      reserved_ok = parse_memory_reg(mem_alloc, prop, this, reserved_ok ? 0 : contiguous_res_bytes);
+      if (!parse_memory_reg(mem_alloc, prop)) {
+        libk::panic("[PageAllocList] Unable to set up the page allocators.");
+      }
     }
   }
 }
 
-bool PageAllocList::fresh_page(PhysicalPA* addr) {
+PageAllocList::AllocList* PageAllocList::find_allocator(PhysicalPA addr) const {
+  AllocList* cur = _list_beg;
+
+  while (cur != nullptr) {
+    if (cur->section_start <= addr && addr < cur->section_stop) {
+      return cur;
+    }
+
+    cur = cur->next;
+  }
+
+  return nullptr;
+}
+
+bool PageAllocList::buddy_fresh_page(PhysicalPA* addr) {
   AllocList* cur = _list_beg;
 
   while (cur != nullptr) {
@@ -96,16 +94,182 @@ bool PageAllocList::fresh_page(PhysicalPA* addr) {
   return false;
 }
 
-void PageAllocList::free_page(PhysicalPA addr) {
+bool PageAllocList::buddy_fresh_run(PhysicalPA* start) {
   AllocList* cur = _list_beg;
 
   while (cur != nullptr) {
-    if (cur->section_start <= addr && addr < cur->section_stop) {
-      cur->alloc.free_page(addr - cur->section_start);
+    if (cur->alloc.fresh_aligned_pages(CONTIGUOUS_RUN_ORDER, start)) {
+      *start += cur->section_start;
+      return true;
     }
 
     cur = cur->next;
   }
+
+  return false;
+}
+
+void PageAllocList::buddy_free_page(PhysicalPA addr) {
+  AllocList* alloc = find_allocator(addr);
+  KASSERT(alloc != nullptr);
+  alloc->alloc.free_page(addr - alloc->section_start);
+}
+
+PageAllocList::PageCache& PageAllocList::get_local_cache() {
+  return _caches[SMP::get_core_id()];
+}
+
+bool PageAllocList::refill_cache(PageCache& cache) {
+  while (cache.count < PAGE_CACHE_BATCH) {
+    if (!buddy_fresh_page(&cache.pages[cache.count])) {
+      break;
+    }
+
+    cache.count++;
+  }
+
+  check_watermark(false);
+  return cache.count > 0;
+}
+
+void PageAllocList::drain_cache(PageCache& cache, size_t nb_pages) {
+  nb_pages = libk::min(nb_pages, cache.count);
+
+  // The coldest pages (at the beginning) are given back.
+  for (size_t i = 0; i < nb_pages; ++i) {
+    buddy_free_page(cache.pages[i]);
+  }
+
+  cache.count -= nb_pages;
+  for (size_t i = 0; i < cache.count; ++i) {
+    cache.pages[i] = cache.pages[i + nb_pages];
+  }
+}
+
+void PageAllocList::drain_all_caches() {
+  for (auto& cache : _caches) {
+    drain_cache(cache, cache.count);
+  }
+}
+
+bool PageAllocList::fresh_page(PhysicalPA* addr) {
+  PageCache& cache = get_local_cache();
+  if (cache.count == 0 && !refill_cache(cache)) {
+    // The buddy allocators are empty, but other cores may have pages left in their caches.
+    drain_all_caches();
+    if (!refill_cache(cache)) {
+      check_watermark(true);
+      return false;
+    }
+  }
+
+  *addr = cache.pages[--cache.count];
+  return true;
+}
+
+void PageAllocList::share_page(PhysicalPA addr) {
+  AllocList* alloc = find_allocator(addr);
+  KASSERT(alloc != nullptr);
+  alloc->alloc.add_reference(addr - alloc->section_start);
+}
+
+bool PageAllocList::is_shared(PhysicalPA addr) const {
+  AllocList* alloc = find_allocator(addr);
+  KASSERT(alloc != nullptr);
+  return alloc->alloc.is_shared(addr - alloc->section_start);
+}
+
+void PageAllocList::free_page(PhysicalPA addr, bool cold) {
+  AllocList* alloc = find_allocator(addr);
+  KASSERT(alloc != nullptr);
+  if (alloc->alloc.remove_reference(addr - alloc->section_start)) {
+    return;  // still used by another owner
+  }
+
+  PageCache& cache = get_local_cache();
+  if (cache.count == PAGE_CACHE_HIGH) {
+    drain_cache(cache, PAGE_CACHE_BATCH);
+  }
+
+  if (cold) {
+    for (size_t i = cache.count; i > 0; --i) {
+      cache.pages[i] = cache.pages[i - 1];
+    }
+
+    cache.pages[0] = addr;
+  } else {
+    cache.pages[cache.count] = addr;
+  }
+
+  cache.count++;
+}
+
+bool PageAllocList::fresh_pages(size_t nb_pages, PhysicalPA* pages) {
+  static constexpr size_t RUN_SIZE = 1ul << CONTIGUOUS_RUN_ORDER;
+
+  // The runs come directly from the buddy allocators, the remaining pages from the cache.
+  size_t i = 0;
+  PhysicalPA run_start;
+  while (nb_pages - i >= RUN_SIZE && buddy_fresh_run(&run_start)) {
+    for (size_t j = 0; j < RUN_SIZE; ++j) {
+      pages[i++] = run_start + j * PAGE_SIZE;
+    }
+  }
+
+  for (; i < nb_pages; ++i) {
+    if (!fresh_page(&pages[i])) {
+      free_pages(i, pages);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void PageAllocList::free_pages(size_t nb_pages, const PhysicalPA* pages) {
+  // Freed in reverse order, so the first pages are the hottest ones when reallocated.
+  for (size_t i = nb_pages; i > 0; --i) {
+    free_page(pages[i - 1]);
+  }
+}
+
+bool PageAllocList::try_fresh_contiguous_pages(size_t nb_pages, PhysicalPA* start, PhysicalPA* end) {
+  AllocList* cur = _list_beg;
+
+  while (cur != nullptr) {
+    if (cur->alloc.fresh_pages(nb_pages, start)) {
+      *start += cur->section_start;
+      *end = *start + (nb_pages - 1) * PAGE_SIZE;
+      return true;
+    }
+
+    cur = cur->next;
+  }
+
+  return false;
+}
+
+bool PageAllocList::fresh_contiguous_pages(size_t nb_pages, PhysicalPA* start, PhysicalPA* end) {
+  if (try_fresh_contiguous_pages(nb_pages, start, end)) {
+    check_watermark(false);
+    return true;
+  }
+
+  // The cached pages may be what is missing to build a big enough block.
+  drain_all_caches();
+  const bool is_allocated = try_fresh_contiguous_pages(nb_pages, start, end);
+  check_watermark(!is_allocated);
+  return is_allocated;
+}
+
+void PageAllocList::free_contiguous_pages(PhysicalPA start, PhysicalPA end) {
+  if (start > end) {
+    return;
+  }
+
+  AllocList* alloc = find_allocator(start);
+  KASSERT(alloc != nullptr && end < alloc->section_stop);
+  alloc->alloc.free_pages(start - alloc->section_start, (end - start) / PAGE_SIZE + 1);
 }
 
 void PageAllocList::mark_as_used_range(PhysicalPA start, PhysicalPA end) {
@@ -130,6 +294,159 @@ void PageAllocList::mark_as_used_range(PhysicalPA start, PhysicalPA end) {
   }
 }
 
+size_t PageAllocList::get_nb_free_pages() const {
+  size_t nb_free_pages = 0;
+  for (const AllocList* cur = _list_beg; cur != nullptr; cur = cur->next) {
+    nb_free_pages += cur->alloc.get_nb_free_pages();
+  }
+
+  for (const auto& cache : _caches) {
+    nb_free_pages += cache.count;
+  }
+
+  return nb_free_pages;
+}
+
+size_t PageAllocList::get_nb_pages() const {
+  size_t nb_pages = 0;
+  for (const AllocList* cur = _list_beg; cur != nullptr; cur = cur->next) {
+    nb_pages += (cur->section_stop - cur->section_start) / PAGE_SIZE;
+  }
+
+  return nb_pages;
+}
+
+void PageAllocList::set_pressure_callback(size_t nb_pages, PressureCallback callback) {
+  _low_watermark = nb_pages;
+  _pressure_callback = callback;
+}
+
+void PageAllocList::check_watermark(bool has_failed) const {
+  if (_pressure_callback == nullptr) {
+    return;
+  }
+
+  if (has_failed || get_nb_free_pages() < _low_watermark) {
+    _pressure_callback(has_failed);
+  }
+}
+
+/** Finds the range containing the page @a addr among the @a nb_ranges @a ranges sorted by address. */
+static const PageAllocList::PageRange* find_range(const PageAllocList::PageRange* ranges,
+                                                  size_t nb_ranges,
+                                                  PhysicalPA addr) {
+  size_t low = 0;
+  size_t high = nb_ranges;
+  while (low < high) {
+    const size_t middle = (low + high) / 2;
+    if (ranges[middle].end < addr) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  if (low < nb_ranges && ranges[low].start <= addr) {
+    return &ranges[low];
+  }
+
+  return nullptr;
+}
+
+bool PageAllocList::get_compaction_cost(const AllocList& alloc,
+                                        PhysicalPA start,
+                                        PhysicalPA end,
+                                        const PageRange* movable,
+                                        size_t nb_ranges,
+                                        size_t* nb_moved_pages) {
+  *nb_moved_pages = 0;
+
+  PhysicalPA page = start;
+  while (page <= end) {
+    if (alloc.alloc.page_status(page - alloc.section_start)) {
+      page += PAGE_SIZE;
+      continue;
+    }
+
+    // A range is moved as a whole, even its pages outside of the block.
+    const PageRange* range = find_range(movable, nb_ranges, page);
+    if (range == nullptr) {
+      return false;
+    }
+
+    *nb_moved_pages += (range->end - range->start) / PAGE_SIZE + 1;
+    page = range->end + PAGE_SIZE;
+  }
+
+  return true;
+}
+
+bool PageAllocList::reserve_compaction_block(size_t nb_pages,
+                                             const PageRange* movable,
+                                             size_t nb_ranges,
+                                             PhysicalPA* start,
+                                             PhysicalPA* end) {
+  // The block must have the order taken by PageAlloc::fresh_pages().
+  size_t order = 0;
+  while ((1ul << order) < nb_pages) {
+    order++;
+  }
+
+  if (nb_pages == 0 || order > PageAlloc::MAX_ORDER) {
+    return false;
+  }
+
+  // The cached pages look used to the buddy allocators.
+  drain_all_caches();
+
+  const size_t block_size = PAGE_SIZE << order;
+  AllocList* best_alloc = nullptr;
+  PhysicalPA best_start = 0;
+  size_t best_cost = SIZE_MAX;
+  for (AllocList* cur = _list_beg; cur != nullptr; cur = cur->next) {
+    // The blocks are aligned relatively to the section start.
+    for (PhysicalPA block = cur->section_start; block + block_size <= cur->section_stop; block += block_size) {
+      size_t cost;
+      if (get_compaction_cost(*cur, block, block + block_size - PAGE_SIZE, movable, nb_ranges, &cost) &&
+          cost < best_cost) {
+        best_alloc = cur;
+        best_start = block;
+        best_cost = cost;
+      }
+    }
+  }
+
+  if (best_alloc == nullptr) {
+    return false;
+  }
+
+  *start = best_start;
+  *end = best_start + block_size - PAGE_SIZE;
+  for (PhysicalPA page = *start; page <= *end; page += PAGE_SIZE) {
+    if (best_alloc->alloc.page_status(page - best_alloc->section_start)) {
+      best_alloc->alloc.mark_as_used(page - best_alloc->section_start);
+    }
+  }
+
+  return true;
+}
+
+void PageAllocList::release_compaction_block(PhysicalPA start,
+                                             PhysicalPA end,
+                                             const PageRange* movable,
+                                             size_t nb_ranges) {
+  AllocList* alloc = find_allocator(start);
+  KASSERT(alloc != nullptr && end < alloc->section_stop);
+
+  // Given back to the buddy allocator directly, so the freed pages merge into the block.
+  for (PhysicalPA page = start; page <= end; page += PAGE_SIZE) {
+    const PhysicalPA index = page - alloc->section_start;
+    if (!alloc->alloc.page_status(index) && find_range(movable, nb_ranges, page) == nullptr) {
+      alloc->alloc.free_page(index);
+    }
+  }
+}
+
 void PageAllocList::add_allocator(libk::LinearAllocator& mem_alloc,
                                   PhysicalPA page_start,
                                   PhysicalPA page_end,
@@ -142,7 +459,7 @@ void PageAllocList::add_allocator(libk::LinearAllocator& mem_alloc,
   new_elm->alloc = PageAlloc(nb_pages, array);
   new_elm->next = nullptr;
 
-  if (_list_end != nullptr){
+  if (_list_end != nullptr) {
     _list_end->next = new_elm;
   }
 
@@ -152,3 +469,4 @@ void PageAllocList::add_allocator(libk::LinearAllocator& mem_alloc,
 
   _list_end = new_elm;
 }
+
@@ -1,22 +1,102 @@
 #pragma once
 
+#include "boot/mmu_utils.hpp"
 #include "dtb/node.hpp"
 #include "libk/linear_allocator.hpp"
 #include "memory/page_alloc.hpp"
 
+/**
+ * The physical page allocator of the kernel: one buddy allocator per memory section.
+ *
+ * Single pages are served from small per-core caches, refilled and drained by batches from the
+ * buddy allocators. Freed pages are hot (likely still in the CPU caches) and are reused first,
+ * unless they are given back as cold.
+ */
 class PageAllocList {
  public:
+  /** Count of pages moved at once between a per-core cache and the buddy allocators. */
+  static constexpr size_t PAGE_CACHE_BATCH = 16;
+  /** Maximum count of pages kept in a per-core cache. */
+  static constexpr size_t PAGE_CACHE_HIGH = 4 * PAGE_CACHE_BATCH;
+  /** Allocations of several pages take aligned runs of 2^CONTIGUOUS_RUN_ORDER contiguous pages when
+   * possible, so they can be mapped with the contiguous hint (one TLB entry per run). */
+  static constexpr size_t CONTIGUOUS_RUN_ORDER = 4;
+
   PageAllocList() = default;
-  PageAllocList(libk::LinearAllocator& mem_alloc, size_t contiguous_res_bytes);
+  explicit PageAllocList(libk::LinearAllocator& mem_alloc);
 
   bool fresh_page(PhysicalPA* addr);
 
-  void free_page(PhysicalPA addr);
+  /** Free the page @a addr (or removes an owner if it is shared). A @a cold page (not recently accessed)
+   * is reused after the hot ones. */
+  void free_page(PhysicalPA addr, bool cold = false);
+
+  /** Adds an owner to the page @a addr: it is only freed once free_page() is called by each owner. */
+  void share_page(PhysicalPA addr);
+
+  /** Checks if the page @a addr has several owners. */
+  [[nodiscard]] bool is_shared(PhysicalPA addr) const;
+
+  /** Tries to find @a nb_pages fresh pages (not necessarily contiguous) and stores them in @a pages.
+   * Either all the pages are allocated, or none. Each page can be freed alone. */
+  bool fresh_pages(size_t nb_pages, PhysicalPA* pages);
+
+  /** Free the @a nb_pages pages stored in @a pages. */
+  void free_pages(size_t nb_pages, const PhysicalPA* pages);
+
+  /** Tries to find @a nb_pages physically contiguous fresh pages, @a start and @a end (the last page,
+   * inclusive) are filled in case of success. */
+  bool fresh_contiguous_pages(size_t nb_pages, PhysicalPA* start, PhysicalPA* end);
+
+  /** Free the pages from @a start to @a end (inclusive), previously returned by fresh_contiguous_pages(). */
+  void free_contiguous_pages(PhysicalPA start, PhysicalPA end);
 
   void mark_as_used_range(PhysicalPA start, PhysicalPA end);
 
-  PhysicalPA get_reserved_start() const { return contiguous_res_start; }
-  PhysicalPA get_reserved_stop() const { return contiguous_res_stop; }
+  /** Gets the count of free pages, the ones kept in the per-core caches included. */
+  [[nodiscard]] size_t get_nb_free_pages() const;
+  /** Gets the count of pages managed by the allocator. */
+  [[nodiscard]] size_t get_nb_pages() const;
+
+  /** Calls @a f(start, stop, nb_free_pages) for each memory zone (a section, @a stop excluded). The pages kept in
+   * the per-core caches are counted as used. */
+  template <class F>
+  void for_each_zone(F f) const {
+    for (const AllocList* cur = _list_beg; cur != nullptr; cur = cur->next) {
+      f(cur->section_start, cur->section_stop, cur->alloc.get_nb_free_pages());
+    }
+  }
+
+  /** Called with `false` when the buddy allocators give pages while fewer than the low watermark are free, and
+   * with `true` when an allocation fails. */
+  using PressureCallback = void (*)(bool has_failed);
+
+  /** Reports the memory pressure to @a callback (see PressureCallback), with a low watermark of @a nb_pages. */
+  void set_pressure_callback(size_t nb_pages, PressureCallback callback);
+
+  /** A range of used pages, @a end being its last page (inclusive). */
+  struct PageRange {
+    PhysicalPA start;
+    PhysicalPA end;
+  };
+
+  /**
+   * Compaction of the contiguous allocations, when none of @a nb_pages pages can be found: finds the block
+   * where they would fit whose used pages are all inside the @a nb_ranges @a movable ranges (sorted by address),
+   * with the fewest pages to move. Its free pages are then reserved until release_compaction_block(), so the
+   * pages allocated to move the ranges elsewhere are outside of it.
+   * @returns   - `true` in case of success, the block is stored into @a start and @a end (inclusive). @n
+   *            - `false` otherwise.
+   */
+  bool reserve_compaction_block(size_t nb_pages,
+                                const PageRange* movable,
+                                size_t nb_ranges,
+                                PhysicalPA* start,
+                                PhysicalPA* end);
+
+  /** Frees the pages reserved by reserve_compaction_block() in the block from @a start to @a end, the pages still
+   * used by the @a movable ranges are kept. Once they are all moved and freed, the whole block is free. */
+  void release_compaction_block(PhysicalPA start, PhysicalPA end, const PageRange* movable, size_t nb_ranges);
 
  private:
   struct AllocList {
@@ -26,16 +106,42 @@ class PageAllocList {
     AllocList* next;
   };
 
-  PhysicalPA contiguous_res_start;
-  PhysicalPA contiguous_res_stop;
+  struct PageCache {
+    // The hottest pages are at the end of the array.
+    PhysicalPA pages[PAGE_CACHE_HIGH];
+    size_t count;
+  };
 
   AllocList* _list_beg = nullptr;
   AllocList* _list_end = nullptr;
+  PageCache _caches[NB_CORES] = {};
+  size_t _low_watermark = 0;
+  PressureCallback _pressure_callback = nullptr;
+
+  PageCache& get_local_cache();
+  bool refill_cache(PageCache& cache);
+  void drain_cache(PageCache& cache, size_t nb_pages);
+  void drain_all_caches();
+  void check_watermark(bool has_failed) const;
+
+  bool buddy_fresh_page(PhysicalPA* addr);
+  bool buddy_fresh_run(PhysicalPA* start);
+  bool try_fresh_contiguous_pages(size_t nb_pages, PhysicalPA* start, PhysicalPA* end);
+  void buddy_free_page(PhysicalPA addr);
+  /** Counts the pages to move to free the block from @a start to @a end (see reserve_compaction_block()).
+   * Returns false if a used page of the block is not movable. */
+  static bool get_compaction_cost(const AllocList& alloc,
+                                  PhysicalPA start,
+                                  PhysicalPA end,
+                                  const PageRange* movable,
+                                  size_t nb_ranges,
+                                  size_t* nb_moved_pages);
 
   void add_allocator(libk::LinearAllocator& mem_alloc,
                      PhysicalPA page_start,
                      PhysicalPA page_end,
                      size_t nb_pages,
                      uintptr_t array);
-  bool parse_memory_reg(libk::LinearAllocator& mem_alloc, Property prop, PageAllocList* list, size_t contiguous_res);
+  bool parse_memory_reg(libk::LinearAllocator& mem_alloc, Property prop);
+  AllocList* find_allocator(PhysicalPA addr) const;
 };
@@ -1,12 +1,13 @@
 #include "process_memory.hpp"
 #include <libk/log.hpp>
 #include "boot/mmu_utils.hpp"
+#include "memory/demand_paging.hpp"
 #include "memory/kernel_internal_memory.hpp"
+#include "memory/zram.hpp"
+#include "task/futex.hpp"
 
 #include <algorithm>
 
-uint8_t ProcessMemory::_new_asid = 1;
-
 static inline PagesAttributes get_properties(bool read_only, bool executable) {
   return {.sh = Shareability::InnerShareable,
           .exec = executable ? ExecutionPermission::ProcessExecute : ExecutionPermission::NeverExecute,
@@ -16,14 +17,10 @@ static inline PagesAttributes get_properties(bool read_only, bool executable) {
 }
 
 ProcessMemory::ProcessMemory(size_t minimum_stack_byte_size)
-    : _tbl(memory_impl::new_process_tbl(_new_asid++)),
+    : _tbl(memory_impl::new_process_tbl(0)),
       _heap(HeapManager::Kind::Process, &_tbl),
-      _stack(libk::div_round_up(minimum_stack_byte_size, PAGE_SIZE)) {
-  if (!_stack.is_status_okay()) {
-    libk::panic("[ProcessMemory] Unable to allocate the process stack.");
-  }
-
-  map_chunk(_stack, PROCESS_STACK_BASE, false, false);
+      _stack_byte_size(libk::align_to_next(minimum_stack_byte_size, PAGE_SIZE)) {
+  KASSERT(_stack_byte_size > 0);
 }
 
 ProcessMemory::~ProcessMemory() {
@@ -39,7 +36,259 @@ VirtualAddress ProcessMemory::get_stack_end() const {
 }
 
 VirtualAddress ProcessMemory::get_stack_start() const {
-  return PROCESS_STACK_BASE + _stack.get_byte_size();
+  return PROCESS_STACK_BASE + _stack_byte_size;
+}
+
+VirtualAddress ProcessMemory::map_thread_stack(MemoryChunk& stack) {
+  KASSERT(stack.get_byte_size() < PROCESS_THREAD_STACK_SLOT_SIZE);
+
+  _nb_thread_stacks++;
+  const VirtualAddress stack_end = PROCESS_STACK_BASE - _nb_thread_stacks * PROCESS_THREAD_STACK_SLOT_SIZE;
+  if (!map_chunk(stack, stack_end, false, false)) {
+    return 0;
+  }
+
+  // The stack belongs to a thread, it is not inherited by the forked processes.
+  _sec.back().is_inherited = false;
+
+  return stack_end + stack.get_byte_size();
+}
+
+bool ProcessMemory::map_info_page() {
+  static_assert(PROCESS_INFO_PAGE == SYS_INFO_PAGE_ADDRESS);
+  KASSERT(!_info_page);
+
+  _info_page = libk::make_scoped<MemoryChunk>(1);
+  if (!_info_page || !_info_page->is_status_okay() || !map_chunk(*_info_page, PROCESS_INFO_PAGE, true, false)) {
+    _info_page.reset();
+    return false;
+  }
+
+  _sec.back().is_inherited = false;
+  return true;
+}
+
+sys_info_page_t* ProcessMemory::get_info_page() const {
+  return _info_page ? (sys_info_page_t*)_info_page->get() : nullptr;
+}
+
+VirtualAddress ProcessMemory::allocate_surface_address() {
+  if (_nb_surfaces == PROCESS_SURFACE_SLOT_COUNT) {
+    return 0;
+  }
+
+  return PROCESS_SURFACE_BASE + (_nb_surfaces++) * PROCESS_SURFACE_SLOT_SIZE;
+}
+
+bool ProcessMemory::map_surface(MemoryChunk& surface, VirtualAddress address) {
+  KASSERT(surface.get_byte_size() <= PROCESS_SURFACE_SLOT_SIZE);
+
+  if (!map_chunk(surface, address, false, false)) {
+    return false;
+  }
+
+  _sec.back().is_inherited = false;
+  return true;
+}
+
+bool ProcessMemory::map_surface(Buffer& surface, VirtualAddress address) {
+  KASSERT(surface.get_mapped_byte_size() <= PROCESS_SURFACE_SLOT_SIZE);
+
+  // Buffers are never inherited.
+  return map_buffer(surface, address, false, false);
+}
+
+VirtualAddress ProcessMemory::map_anonymous(size_t byte_size) {
+  if (byte_size == 0 || byte_size > PROCESS_ANONYMOUS_END - PROCESS_ANONYMOUS_BASE) {
+    return 0;
+  }
+
+  return allocate_range(libk::align_to_next(byte_size, PAGE_SIZE), nullptr);
+}
+
+bool ProcessMemory::map_zeroed(VirtualAddress address, size_t byte_size) {
+  const VirtualPA end = libk::align_to_next(address + byte_size, PAGE_SIZE);
+  if (byte_size == 0 || address % PAGE_SIZE != 0 || end < address || end > PROCESS_ANONYMOUS_BASE) {
+    return false;
+  }
+
+  // Keep the mappings sorted.
+  auto it = _anonymous_ranges.begin();
+  while (it != _anonymous_ranges.end() && it->end <= address) {
+    ++it;
+  }
+
+  if (it == _anonymous_ranges.end()) {
+    _anonymous_ranges.push_back({address, end});
+  } else if (it->start >= end) {
+    _anonymous_ranges.insert_before(it, {address, end});
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+VirtualAddress ProcessMemory::allocate_range(size_t size, MemoryChunk* file_chunk, bool is_shared) {
+  // First fit among the gaps between the (sorted) mappings, keeping a free guard page after each one.
+  VirtualPA start = PROCESS_ANONYMOUS_BASE;
+  for (auto it = _anonymous_ranges.begin(); it != _anonymous_ranges.end(); ++it) {
+    // The zeroed ranges of map_zeroed() come first, below the anonymous mappings address space.
+    if (it->start < PROCESS_ANONYMOUS_BASE) {
+      continue;
+    }
+
+    if (it->start - start >= size + PAGE_SIZE) {
+      _anonymous_ranges.insert_before(it, {start, start + size, file_chunk, is_shared});
+      return start;
+    }
+
+    start = it->end + PAGE_SIZE;
+  }
+
+  if (PROCESS_ANONYMOUS_END - start < size) {
+    return 0;
+  }
+
+  _anonymous_ranges.push_back({start, start + size, file_chunk, is_shared});
+  return start;
+}
+
+void ProcessMemory::release_range(VirtualAddress start) {
+  auto it = _anonymous_ranges.begin();
+  while (it->start != start) {
+    ++it;
+  }
+
+  _anonymous_ranges.erase(it);
+}
+
+bool ProcessMemory::unmap_anonymous(VirtualAddress address, size_t byte_size) {
+  if (byte_size == 0 || address % PAGE_SIZE != 0) {
+    return false;
+  }
+
+  const VirtualPA end = libk::align_to_next(address + byte_size, PAGE_SIZE);
+  auto it = _anonymous_ranges.begin();
+  while (it != _anonymous_ranges.end() && !(address >= it->start && address < it->end)) {
+    ++it;
+  }
+
+  if (it == _anonymous_ranges.end() || !it->is_demand_paged() || end > it->end || end < address) {
+    return false;
+  }
+
+  if (!DemandPaging::release_range(&_tbl, address, end)) {
+    return false;
+  }
+
+  // The mapping may be cut in two parts.
+  const AnonymousRange range = *it;
+  if (range.start < address && end < range.end) {
+    it->end = address;
+    _anonymous_ranges.insert_after(it, {end, range.end});
+  } else if (range.start < address) {
+    it->end = address;
+  } else if (end < range.end) {
+    it->start = end;
+  } else {
+    _anonymous_ranges.erase(it);
+  }
+
+  return true;
+}
+
+ProcessMemory::AnonymousRange* ProcessMemory::find_anonymous_range(VirtualAddress va) {
+  if (va >= PROCESS_ANONYMOUS_END) {
+    return nullptr;
+  }
+
+  for (auto& range : _anonymous_ranges) {
+    if (va >= range.start && va < range.end) {
+      return range.is_demand_paged() ? &range : nullptr;
+    }
+  }
+
+  return nullptr;
+}
+
+VirtualAddress ProcessMemory::map_file(MemoryChunk& chunk) {
+  const VirtualAddress start = allocate_range(chunk.get_byte_size(), &chunk);
+  if (start == 0) {
+    return 0;
+  }
+
+  if (!map_chunk(chunk, start, true, false)) {
+    // Unmap the pages mapped before the failure, the chunk does not know this mapping.
+    (void)unmap_range(&_tbl, start, start + chunk.get_byte_size() - PAGE_SIZE);
+    release_range(start);
+    return 0;
+  }
+
+  return start;
+}
+
+MemoryChunk* ProcessMemory::unmap_file(VirtualAddress address) {
+  auto it = _anonymous_ranges.begin();
+  while (it != _anonymous_ranges.end() && it->start != address) {
+    ++it;
+  }
+
+  if (it == _anonymous_ranges.end() || it->file_chunk == nullptr) {
+    return nullptr;
+  }
+
+  MemoryChunk* chunk = it->file_chunk;
+  unmap_memory(address);
+  _anonymous_ranges.erase(it);
+  return chunk;
+}
+
+VirtualAddress ProcessMemory::map_shared(Buffer& buffer, bool read_only) {
+  const VirtualAddress start = allocate_range(buffer.get_mapped_byte_size(), nullptr, true);
+  if (start == 0) {
+    return 0;
+  }
+
+  // Buffers are never inherited.
+  if (!map_buffer(buffer, start, read_only, false)) {
+    (void)unmap_range(&_tbl, start, buffer.end_address(start));
+    release_range(start);
+    return 0;
+  }
+
+  return start;
+}
+
+VirtualAddress ProcessMemory::map_shared(MemoryChunk& chunk) {
+  const VirtualAddress start = allocate_range(chunk.get_byte_size(), nullptr, true);
+  if (start == 0) {
+    return 0;
+  }
+
+  if (!map_chunk(chunk, start, false, false)) {
+    (void)unmap_range(&_tbl, start, chunk.end_address(start));
+    release_range(start);
+    return 0;
+  }
+
+  _sec.back().is_inherited = false;
+  return start;
+}
+
+bool ProcessMemory::unmap_shared(VirtualAddress address) {
+  auto it = _anonymous_ranges.begin();
+  while (it != _anonymous_ranges.end() && it->start != address) {
+    ++it;
+  }
+
+  if (it == _anonymous_ranges.end() || !it->is_shared) {
+    return false;
+  }
+
+  unmap_memory(address);
+  _anonymous_ranges.erase(it);
+  return true;
 }
 
 VirtualPA ProcessMemory::change_heap_end(long byte_offset) {
@@ -54,31 +303,237 @@ size_t ProcessMemory::get_heap_byte_size() const {
   return _heap.get_heap_byte_size();
 }
 
-void ProcessMemory::activate() const {
-  // First set TTBR0 to a null pointer, to invalidate all TBL with our ASID
-  asm volatile("msr ttbr0_el1, xzr");
-  reload_tlb();
+bool ProcessMemory::handle_page_fault(VirtualAddress va) {
+  const VirtualPA page_va = libk::align_to_previous(va, PAGE_SIZE);
+
+  // The page may have been mapped meanwhile by another thread of the process, or be a page of a buffer
+  // remapped once moved (see Buffer::compact()).
+  PhysicalPA pa;
+  if (get_pa(&_tbl, page_va, &pa)) {
+    return true;
+  }
+
+  const bool is_anonymous = find_anonymous_range(va) != nullptr;
+  if (!is_anonymous && (va < get_stack_end() || va >= get_stack_start())) {
+    return _heap.handle_page_fault(va);
+  }
+
+  return DemandPaging::fault_in_page(&_tbl, page_va, get_properties(false, false));
+}
+
+bool ProcessMemory::handle_access_fault(VirtualAddress va) {
+  return set_access_flag(&_tbl, libk::align_to_previous(va, PAGE_SIZE));
+}
+
+size_t ProcessMemory::page_out_cold_pages(size_t byte_size) {
+  size_t freed_byte_size = DemandPaging::page_out_cold_pages(&_tbl, get_stack_end(), get_stack_start(), byte_size);
+
+  const VirtualPA heap_end = libk::align_to_next(_heap.get_heap_end(), PAGE_SIZE);
+  if (freed_byte_size < byte_size) {
+    freed_byte_size +=
+        DemandPaging::page_out_cold_pages(&_tbl, _heap.get_heap_start(), heap_end, byte_size - freed_byte_size);
+  }
+
+  for (const auto& range : _anonymous_ranges) {
+    if (freed_byte_size >= byte_size) {
+      break;
+    }
+
+    if (range.is_demand_paged()) {
+      freed_byte_size +=
+          DemandPaging::page_out_cold_pages(&_tbl, range.start, range.end, byte_size - freed_byte_size);
+    }
+  }
+
+  return freed_byte_size;
+}
+
+bool ProcessMemory::handle_write_fault(VirtualAddress va) {
+  const VirtualPA page_va = libk::align_to_previous(va, PAGE_SIZE);
+
+  PhysicalPA pa;
+  if (!get_pa(&_tbl, page_va, &pa)) {
+    return false;
+  }
+
+  // The stack, heap and anonymous pages are shared with copy-on-write by fork().
+  const bool is_stack = va >= get_stack_end() && va < get_stack_start();
+  if (is_stack || _heap.contains(va) || find_anonymous_range(va) != nullptr) {
+    return DemandPaging::copy_on_write(&_tbl, page_va, pa, true, get_properties(false, false));
+  }
+
+  MappedSections* section = find_section(va);
+  if (section == nullptr || !section->is_cow) {
+    return false;
+  }
+
+  // The pages still mapped from the chunk are not owned by this process, they must be copied.
+  const auto* chunk = (const MemoryChunk*)section->mem;
+  const bool is_owned = pa != chunk->_pas[(page_va - section->start) / PAGE_SIZE];
+  return DemandPaging::copy_on_write(&_tbl, page_va, pa, is_owned, get_properties(false, is_executable(page_va)));
+}
+
+libk::SharedPointer<ProcessMemory> ProcessMemory::fork() {
+  auto child = libk::make_shared<ProcessMemory>(_stack_byte_size);
+  if (!child) {
+    return nullptr;
+  }
+
+  const PagesAttributes stack_attr = get_properties(true, false);
+  if (!DemandPaging::share_range(&_tbl, &child->_tbl, get_stack_end(), get_stack_start(), stack_attr)) {
+    return nullptr;
+  }
+
+  if (!_heap.fork_into(child->_heap)) {
+    return nullptr;
+  }
+
+  const PagesAttributes anonymous_attr = get_properties(true, false);
+  for (const auto& range : _anonymous_ranges) {
+    // The shared mappings are not inherited.
+    if (range.is_shared) {
+      continue;
+    }
+
+    // The file mappings are mapped again with the other chunks below.
+    if (range.file_chunk == nullptr &&
+        !DemandPaging::share_range(&_tbl, &child->_tbl, range.start, range.end, anonymous_attr)) {
+      return nullptr;
+    }
+
+    child->_anonymous_ranges.push_back(range);
+  }
+
+  for (const auto& section : _sec) {
+    if (section.is_inherited && !fork_section(section, *child)) {
+      return nullptr;
+    }
+  }
+
+  return child;
+}
+
+bool ProcessMemory::fork_section(const MappedSections& section, ProcessMemory& child) {
+  // Only the chunks are inherited, not the buffers.
+  KASSERT(!section.is_buffer);
+  auto& chunk = *(MemoryChunk*)section.mem;
+
+  if (!section.is_cow) {
+    return child.map_chunk(chunk, section.start, is_read_only(section.start), is_executable(section.start));
+  }
+
+  const bool executable = is_executable(section.start);
+  if (!child.map_chunk_cow(chunk, section.start, executable)) {
+    return false;
+  }
+
+  // The pages already copied by this process are shared with the child.
+  const PagesAttributes read_only_attr = get_properties(true, executable);
+  for (size_t page_id = 0; page_id < chunk._nb_pages; ++page_id) {
+    const VirtualPA va = section.start + page_id * PAGE_SIZE;
+
+    PhysicalPA pa;
+    if (get_pa(&_tbl, va, &pa) && pa != chunk._pas[page_id] &&
+        !DemandPaging::share_range(&_tbl, &child._tbl, va, va + PAGE_SIZE, read_only_attr)) {
+      return false;
+    }
+  }
+
+  return true;
+}
 
-  // Next we set the correct value for TTBR0
-  asm volatile("msr ttbr0_el1, %x0" ::"r"(memory_impl::resolve_table_pgd(_tbl)));
-  reload_tlb();
+void ProcessMemory::activate() {
+  // The TLB entries are tagged by the ASID, no need to flush them: the ones of the other processes
+  // are simply not used anymore.
+  _tbl.asid = ASIDAllocator::activate(_asid);
+
+  const uint64_t ttbr0 = memory_impl::resolve_table_pgd(_tbl) | ((uint64_t)_tbl.asid << 48);
+  asm volatile("msr ttbr0_el1, %x0" ::"r"(ttbr0));
+  asm volatile("isb" ::: "memory");
 }
 
 void ProcessMemory::deactivate() {
+  // ASID 0 is never allocated to a process.
   asm volatile("msr ttbr0_el1, xzr");
-  reload_tlb();
+  asm volatile("isb" ::: "memory");
+  ASIDAllocator::deactivate();
 }
 
-void ProcessMemory::free() {
-  // Free the heap
-  _heap.free();
+namespace {
+/** The state of ProcessMemory::free(): the pages to free are given back to the allocator by batches. */
+struct Teardown {
+  explicit Teardown(ProcessMemory* memory) : memory(memory) {}
+
+  ProcessMemory* memory;
+  PhysicalPA pages[PageAllocList::PAGE_CACHE_BATCH] = {};
+  size_t nb_pages = 0;
+
+  void add_page(PhysicalPA pa) {
+    pages[nb_pages++] = pa;
+    if (nb_pages == PageAllocList::PAGE_CACHE_BATCH) {
+      flush();
+    }
+  }
+
+  void flush() {
+    memory_impl::get_kernel_alloc()->free_pages(nb_pages, pages);
+    nb_pages = 0;
+  }
+};  // struct Teardown
+}  // namespace
+
+bool ProcessMemory::owns_page(VirtualPA va, PhysicalPA pa) {
+  // The stack, heap and anonymous pages are demand paged, shared ones included (free_page() drops an owner).
+  const bool is_stack = va >= get_stack_end() && va < get_stack_start();
+  if (is_stack || _heap.contains(va) || find_anonymous_range(va) != nullptr) {
+    return true;
+  }
+
+  // Only the pages copied on write belong to the process, not those still mapped from the chunk.
+  const MappedSections* section = find_section(va);
+  if (section == nullptr || !section->is_cow) {
+    return false;
+  }
+
+  const auto* chunk = (const MemoryChunk*)section->mem;
+  return pa != chunk->_pas[(va - section->start) / PAGE_SIZE];
+}
+
+void ProcessMemory::release_cleared_page(void* data, VirtualPA va, PhysicalPA pa, uint64_t swap_id) {
+  auto* teardown = (Teardown*)data;
+  if (pa == 0) {
+    Zram::free(swap_id);
+  } else if (teardown->memory->owns_page(va, pa)) {
+    teardown->add_page(pa);
+  }
+}
 
-  // Free all mappings
-  for (const auto chunk : _sec) {
-    unmap_memory(chunk.start);  // <- chunk will be removed from the list by unmap
+void ProcessMemory::free() {
+  // The address space is not used by any core anymore (the tasks of the process are dead). Instead of unmapping
+  // each mapping page by page, each with its TLB invalidation, the TLB entries of the process are invalidated at
+  // once by releasing its ASID, then the table is cleared in a single walk without barriers nor invalidations,
+  // which frees its pages on the way.
+  ASIDAllocator::release(_asid);
+  _tbl.is_inactive = true;
+
+  // The queues of the futexes are keyed by this address, they must not be found by a next process allocated there.
+  Futex::drop(this);
+
+  Teardown teardown(this);
+  clear_all(&_tbl, &ProcessMemory::release_cleared_page, &teardown);
+  teardown.flush();
+
+  // The pages of the chunks and buffers belong to them, they only forget the mappings.
+  for (const auto& section : _sec) {
+    if (section.is_buffer) {
+      ((Buffer*)section.mem)->unregister_mapping(this);
+    } else {
+      ((MemoryChunk*)section.mem)->unregister_mapping(this);
+    }
   }
 
-  KASSERT(_sec.is_empty());
+  _sec.clear();
+  _anonymous_ranges.clear();
 
   // Free MMU Table
   memory_impl::delete_process_tbl(_tbl);
@@ -92,14 +547,20 @@ bool ProcessMemory::map_chunk(MemoryChunk& chunk, const VirtualPA page_va, bool
 
   const PagesAttributes attr = get_properties(read_only, executable);
 
-  for (size_t page_id = 0; page_id < chunk._nb_pages; ++page_id) {
-    const PhysicalPA page_pa = chunk._pas[page_id];
+  // Each segment (physically contiguous pages) is mapped at once, so it can use the contiguous hint.
+  size_t byte_offset = 0;
+  while (byte_offset < chunk.get_byte_size()) {
+    MemoryChunk::Segment segment;
+    if (chunk.get_segments(byte_offset, chunk.get_byte_size() - byte_offset, &segment, 1) == 0) {
+      return false;
+    }
 
-    //    LOG_DEBUG("Mapping {:#x} -> {:#x} to {:#x}", page_va + page_id * PAGE_SIZE, page_va + page_id * PAGE_SIZE,
-    //    page_pa);
-    if (!map_range(&_tbl, page_va + page_id * PAGE_SIZE, page_va + page_id * PAGE_SIZE, page_pa, attr)) {
+    const VirtualPA segment_va = page_va + byte_offset;
+    if (!map_range(&_tbl, segment_va, segment_va + segment.byte_size - PAGE_SIZE, segment.pa, attr)) {
       return false;
     }
+
+    byte_offset += segment.byte_size;
   }
 
   _sec.emplace_back(page_va, false, &chunk);
@@ -108,24 +569,69 @@ bool ProcessMemory::map_chunk(MemoryChunk& chunk, const VirtualPA page_va, bool
   return true;
 }
 
+bool ProcessMemory::map_chunk_cow(MemoryChunk& chunk, VirtualPA address, bool executable) {
+  if (!map_chunk(chunk, address, true, executable)) {
+    return false;
+  }
+
+  MappedSections& section = _sec.back();
+  section.is_cow = true;
+  return true;
+}
+
 bool ProcessMemory::map_buffer(Buffer& chunk, VirtualPA page_va, bool read_only, bool executable) {
   if (chunk.buffer_pa_start == 0) {
     return false;
   }
 
   const PagesAttributes attr = get_properties(read_only, executable);
+  if (!map_buffer_range(chunk, page_va, attr)) {
+    return false;
+  }
+
+  _sec.emplace_back(page_va, true, &chunk).is_inherited = false;
+  chunk.register_mapping(this, page_va, attr);
 
-  const PhysicalPA buffer_va_start = page_va;
-  const PhysicalPA buffer_va_end = buffer_va_start + chunk.buffer_pa_end - chunk.buffer_pa_start;
+  return true;
+}
 
-  if (!map_range(&_tbl, buffer_va_start, buffer_va_end, chunk.buffer_pa_start, attr)) {
+bool ProcessMemory::map_buffer_range(const Buffer& buffer, VirtualPA start_address, const PagesAttributes& attributes) {
+  const VirtualPA first_end = start_address + buffer.get_byte_size() - PAGE_SIZE;
+  if (!map_range(&_tbl, start_address, first_end, buffer.buffer_pa_start, attributes)) {
     return false;
   }
 
-  _sec.emplace_back(buffer_va_start, true, &chunk);
-  chunk.register_mapping(this, page_va);
+  // The second mapping of a mirrored buffer follows the first one, to the same pages.
+  const VirtualPA second_start = first_end + PAGE_SIZE;
+  return !buffer.is_mirrored() ||
+         map_range(&_tbl, second_start, buffer.end_address(start_address), buffer.buffer_pa_start, attributes);
+}
 
-  return true;
+ProcessMemory::MappedSections* ProcessMemory::find_section(VirtualPA va) {
+  for (auto& section : _sec) {
+    VirtualAddress end_address;
+    if (section.is_buffer) {
+      end_address = ((Buffer*)section.mem)->end_address(section.start);
+    } else {
+      end_address = ((MemoryChunk*)section.mem)->end_address(section.start);
+    }
+
+    if (va >= section.start && va < end_address + PAGE_SIZE) {
+      return &section;
+    }
+  }
+
+  return nullptr;
+}
+
+void ProcessMemory::release_cow_pages(const MappedSections& section) {
+  const auto* chunk = (const MemoryChunk*)section.mem;
+  for (size_t page_id = 0; page_id < chunk->_nb_pages; ++page_id) {
+    PhysicalPA pa;
+    if (get_pa(&_tbl, section.start + page_id * PAGE_SIZE, &pa) && pa != chunk->_pas[page_id]) {
+      memory_impl::get_kernel_alloc()->free_page(pa);
+    }
+  }
 }
 
 void ProcessMemory::unmap_memory(VirtualPA start_address) {
@@ -141,6 +647,10 @@ void ProcessMemory::unmap_memory(VirtualPA start_address) {
     return;
   }
 
+  if (it->is_cow) {
+    release_cow_pages(*it);
+  }
+
   VirtualAddress end_address;
   if (it->is_buffer) {
     end_address = ((Buffer*)it->mem)->end_address(it->start);
@@ -162,6 +672,18 @@ void ProcessMemory::unmap_memory(VirtualPA start_address) {
   _sec.erase(it);
 }
 
+void ProcessMemory::unmap_buffer_pages(Buffer& buffer, VirtualPA start_address) {
+  if (!unmap_range(&_tbl, start_address, buffer.end_address(start_address))) {
+    libk::panic("[ProcessMemory] Unable to unmap a moved buffer.");
+  }
+}
+
+void ProcessMemory::remap_buffer_pages(Buffer& buffer, VirtualPA start_address, const PagesAttributes& attributes) {
+  if (!map_buffer_range(buffer, start_address, attributes)) {
+    libk::panic("[ProcessMemory] Unable to map a moved buffer.");
+  }
+}
+
 bool ProcessMemory::change_memory_attr(VirtualPA start_address, bool read_only, bool executable) {
   auto it = _sec.begin();
   for (; it != std::end(_sec); ++it) {
@@ -206,3 +728,7 @@ bool ProcessMemory::is_executable(VirtualPA va) const {
 
   return attr.exec == ExecutionPermission::ProcessExecute;
 }
+
+size_t ProcessMemory::get_resident_byte_size() const {
+  return count_mapped_pages(&_tbl) * PAGE_SIZE;
+}
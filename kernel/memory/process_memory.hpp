@@ -1,39 +1,126 @@
 #pragma once
 
 #include <libk/linked_list.hpp>
+#include <libk/memory.hpp>
+#include <sys/syscall.h>
 
+#include "asid_allocator.hpp"
 #include "buffer.hpp"
 #include "memory/heap_manager.hpp"
 #include "memory_chunk.hpp"
 
 class ProcessMemory {
  public:
+  /** The stack (of at least @a minimum_stack_byte_size bytes) and the heap are demand paged. */
   explicit ProcessMemory(size_t minimum_stack_byte_size);
   ~ProcessMemory();
 
-  /** Returns the ASID (Address Space ID) for this process. */
+  /** Returns the ASID (Address Space ID) for this process. It is only allocated at the first activation,
+   * and may change at each activation. */
   uint8_t get_asid() const;
 
   /* Stack Management */
   VirtualAddress get_stack_end() const;
   VirtualAddress get_stack_start() const;
 
+  /** Maps @a stack as the stack of a new thread of this process.
+   * @returns the top of the mapped stack (its initial stack pointer), or 0 on failure. */
+  VirtualAddress map_thread_stack(MemoryChunk& stack);
+
+  /* Information page Management */
+  /** Maps a new zeroed information page read-only at PROCESS_INFO_PAGE (SYS_INFO_PAGE_ADDRESS), to be filled
+   * by the task manager. It is not inherited by the forked processes, which get their own. */
+  bool map_info_page();
+  /** Returns the information page in the kernel address space, or nullptr if it is not mapped. */
+  [[nodiscard]] sys_info_page_t* get_info_page() const;
+
+  /* Window surfaces Management */
+  /** Reserves the address of a new window surface, the slots are never reused.
+   * @returns the surface address, or 0 if there are no more slots. */
+  VirtualAddress allocate_surface_address();
+  /** Maps the window @a surface read-write at @a address (previously returned by allocate_surface_address()).
+   * Surfaces are not inherited by the forked processes. */
+  bool map_surface(MemoryChunk& surface, VirtualAddress address);
+  bool map_surface(Buffer& surface, VirtualAddress address);
+
   /* Heap Management */
   VirtualPA change_heap_end(long byte_offset);
   VirtualPA get_heap_end() const;
   size_t get_heap_byte_size() const;
 
+  /* Anonymous memory Management */
+  /** Reserves @a byte_size bytes of zeroed memory, demand paged like the heap. The memory is copied on
+   * write by fork(). The address space is allocated first-fit, a free page is left between two mappings.
+   * @returns the start of the mapping, or 0 if there is no free range large enough. */
+  VirtualAddress map_anonymous(size_t byte_size);
+  /** Unmaps the @a byte_size bytes at @a address, they must be inside a single anonymous mapping (whose
+   * remaining parts stay mapped). Returns false if they are not. */
+  bool unmap_anonymous(VirtualAddress address, size_t byte_size);
+  /** Reserves the @a byte_size bytes of zeroed memory at the page aligned @a address, outside of the anonymous
+   * mappings address space (e.g. the end of the program BSS). They are then handled as an anonymous mapping.
+   * Returns false if the range overlaps another anonymous mapping. */
+  bool map_zeroed(VirtualAddress address, size_t byte_size);
+
+  /* File mappings Management */
+  /** Maps @a chunk (holding a file content) read-only, at an address allocated as for the anonymous mappings.
+   * The chunk must stay alive while it is mapped. The mapping is inherited by the forked processes.
+   * @returns the start of the mapping, or 0 on failure. */
+  VirtualAddress map_file(MemoryChunk& chunk);
+  /** Unmaps the file mapping starting at @a address (returned by map_file()). Returns the unmapped chunk,
+   * or nullptr if there is no such mapping. */
+  MemoryChunk* unmap_file(VirtualAddress address);
+
+  /* Shared memory Management */
+  /** Maps @a buffer (or @a chunk) read-write (or read-only) at an address allocated as for the anonymous
+   * mappings, to share it with other processes. It must stay alive while it is mapped. The mapping is not
+   * inherited by the forked processes. A mirrored buffer is mapped twice, back to back (see Buffer::is_mirrored()).
+   * @returns the start of the mapping, or 0 on failure. */
+  VirtualAddress map_shared(Buffer& buffer, bool read_only = false);
+  VirtualAddress map_shared(MemoryChunk& chunk);
+  /** Unmaps the shared mapping starting at @a address (returned by map_shared()). Returns false if there is
+   * no such mapping. */
+  bool unmap_shared(VirtualAddress address);
+
+  /** Maps the page containing @a va if it is in the stack, the heap or an anonymous mapping but not mapped yet.
+   * @returns `true` if the page is now mapped (the faulting access can be retried). */
+  bool handle_page_fault(VirtualAddress va);
+
+  /** Handles a write to the read-only page containing @a va if it is a copy-on-write page.
+   * @returns `true` if the page is now writable (the faulting access can be retried). */
+  bool handle_write_fault(VirtualAddress va);
+
+  /** Handles the first access to the page containing @a va since its access flag was cleared by
+   * page_out_cold_pages(). @returns `true` if the faulting access can be retried. */
+  bool handle_access_fault(VirtualAddress va);
+
+  /** Moves the pages of the stack, the heap and the anonymous mappings not accessed since the previous call
+   * into the compressed store, until about @a byte_size bytes are freed (see DemandPaging::page_out_cold_pages()).
+   * Returns the byte size freed. */
+  size_t page_out_cold_pages(size_t byte_size);
+
+  /** Creates a copy of this process memory: the stack, the heap and the mapped chunks (except the thread
+   * stacks and the buffers) are shared with copy-on-write. The mapped chunks must stay alive while the
+   * copy is. Returns nullptr on failure. */
+  [[nodiscard]] libk::SharedPointer<ProcessMemory> fork();
+
   /** Change the memory mapping to take this process memory in account. */
-  void activate() const;
+  void activate();
 
   /** Change the memory mapping to remove any process memory in account. */
   static void deactivate();
 
   /* Memory chunk management */
   bool map_chunk(MemoryChunk& chunk, VirtualPA address, bool read_only, bool executable);
+  /** Maps @a chunk as a private writable memory: it is mapped read-only and each page is copied at its
+   * first write, so the chunk content itself is never modified (and can be shared). */
+  bool map_chunk_cow(MemoryChunk& chunk, VirtualPA address, bool executable);
   bool map_buffer(Buffer& chunk, VirtualPA address, bool read_only, bool executable);
 
   void unmap_memory(VirtualPA start_address);
+  /** Unmaps the pages of @a buffer mapped at @a start_address while it is moved in physical memory (see
+   * Buffer::compact()): the accesses of the process fault until remap_buffer_pages() maps its new pages. */
+  void unmap_buffer_pages(Buffer& buffer, VirtualPA start_address);
+  void remap_buffer_pages(Buffer& buffer, VirtualPA start_address, const PagesAttributes& attributes);
   bool change_memory_attr(VirtualPA start_address, bool read_only, bool executable);
 
   void free();
@@ -41,19 +128,61 @@ class ProcessMemory {
   bool is_read_only(VirtualPA va) const;
   bool is_executable(VirtualPA va) const;
 
+  /** Returns the byte size of the memory mapped in this process (the shared pages included). */
+  [[nodiscard]] size_t get_resident_byte_size() const;
+
  private:
-  static uint8_t _new_asid;
+  size_t _nb_thread_stacks = 0;  // slots are never reused, the address space is large enough
+  size_t _nb_surfaces = 0;       // same for the window surfaces slots
   MMUTable _tbl;
+  ASIDAllocator::Entry _asid;
 
   HeapManager _heap;
-  MemoryChunk _stack;
+  size_t _stack_byte_size;
+  libk::ScopedPointer<MemoryChunk> _info_page;
 
   struct MappedSections {
     MappedSections(VirtualPA start, bool is_buffer, void* mem) : start(start), is_buffer(is_buffer), mem(mem) {}
     VirtualPA start;
     bool is_buffer;
+    bool is_cow = false;       // the chunk is mapped copy-on-write (see map_chunk_cow())
+    bool is_inherited = true;  // the section is shared with the forked processes
     void* mem;
   };
 
+  MappedSections* find_section(VirtualPA va);
+  /** Maps the pages of @a buffer from @a start_address, twice if it is mirrored (see Buffer::is_mirrored()). */
+  [[nodiscard]] bool map_buffer_range(const Buffer& buffer, VirtualPA start_address, const PagesAttributes& attributes);
+  /** Checks if the page @a pa mapped at @a va belongs to this process, and not to a chunk or a buffer. */
+  [[nodiscard]] bool owns_page(VirtualPA va, PhysicalPA pa);
+  /** Frees the pages owned by the process and the paged out ones as free() clears the table (see clear_all()),
+   * @a data being the teardown state. */
+  static void release_cleared_page(void* data, VirtualPA va, PhysicalPA pa, uint64_t swap_id);
+  /** Frees the pages copied on write in the copy-on-write @a section. */
+  void release_cow_pages(const MappedSections& section);
+  [[nodiscard]] bool fork_section(const MappedSections& section, ProcessMemory& child);
+
   libk::LinkedList<MappedSections> _sec;
+
+  struct AnonymousRange {
+    VirtualPA start;
+    VirtualPA end;  // excluded
+    // Not null for a file mapping, whose pages are those of the chunk (and not demand paged).
+    MemoryChunk* file_chunk = nullptr;
+    // A map_shared() mapping, whose pages are those of a buffer or a chunk (and not demand paged).
+    bool is_shared = false;
+
+    [[nodiscard]] bool is_demand_paged() const { return file_chunk == nullptr && !is_shared; }
+  };
+
+  /** Reserves a range of @a size bytes (a multiple of PAGE_SIZE) of the anonymous mappings address space.
+   * @returns the start of the range, or 0 if there is no free range large enough. */
+  VirtualAddress allocate_range(size_t size, MemoryChunk* file_chunk, bool is_shared = false);
+  /** Releases the range starting at @a start, reserved by allocate_range() (its pages must be unmapped). */
+  void release_range(VirtualAddress start);
+  /** Finds the anonymous mapping containing @a va, returns nullptr if there is none. */
+  AnonymousRange* find_anonymous_range(VirtualAddress va);
+
+  // Sorted by address, the file mappings included.
+  libk::LinkedList<AnonymousRange> _anonymous_ranges;
 };
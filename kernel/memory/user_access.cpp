@@ -0,0 +1,106 @@
+#include "user_access.hpp"
+
+#include <libk/utils.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "memory/process_memory.hpp"
+#include "task/syscall_table.hpp"
+#include "task/task.hpp"
+
+// See user_copy.S.
+extern "C" size_t user_copy_from(void* dst, const void* user_src, size_t length);
+extern "C" size_t user_copy_to(void* user_dst, const void* src, size_t length);
+extern "C" size_t user_strncpy_from(char* dst, const char* user_src, size_t length);
+extern "C" const char user_copy_start[];
+extern "C" const char user_copy_end[];
+extern "C" const char user_copy_fault[];
+
+bool is_user_range(const void* ptr, size_t byte_size) {
+  const auto start = (uintptr_t)ptr;
+  return start + byte_size >= start && start + byte_size <= KERNEL_BASE;
+}
+
+bool copy_from_user(void* dst, const void* user_src, size_t byte_size) {
+  return is_user_range(user_src, byte_size) && user_copy_from(dst, user_src, byte_size) == 0;
+}
+
+bool strncpy_from_user(char* dst, const char* user_src, size_t byte_size) {
+  if (!is_user_range(user_src, 1))
+    return false;
+
+  // Stops at the end of the process address space: the faults on kernel addresses are not fixed up.
+  const size_t max_size = libk::min(byte_size, KERNEL_BASE - (uintptr_t)user_src);
+  return user_strncpy_from(dst, user_src, max_size) == 0;
+}
+
+bool copy_to_user(void* user_dst, const void* src, size_t byte_size) {
+  return is_user_range(user_dst, byte_size) && user_copy_to(user_dst, src, byte_size) == 0;
+}
+
+/** Translates @a va as an EL0 access, returns the PAR_EL1 register (its bit 0 is set on failure, and its
+ * bits 1 to 6 then hold the fault status, encoded as DFSC). */
+static uint64_t translate_user_va(uintptr_t va, bool needs_write) {
+  if (needs_write) {
+    asm volatile("at s1e0w, %x0" ::"r"(va));
+  } else {
+    asm volatile("at s1e0r, %x0" ::"r"(va));
+  }
+
+  uint64_t par_el1;
+  asm volatile("isb\n\tmrs %x0, PAR_EL1" : "=r"(par_el1));
+  return par_el1;
+}
+
+/** Resolves the fault which an access by the process to @a va would raise, reported by PAR_EL1 @a par_el1. */
+static bool resolve_user_fault(ProcessMemory* memory, uintptr_t va, uint64_t par_el1, bool needs_write) {
+  const uint32_t fault_status = (par_el1 >> 1) & 0x3F;
+  switch (fault_status & 0b111100) {
+    case 0b000100:  // translation fault
+      return memory->handle_page_fault(va);
+    case 0b001000:  // access flag fault
+      return memory->handle_access_fault(va);
+    case 0b001100:  // permission fault
+      return needs_write && memory->handle_write_fault(va);
+    default:
+      return false;
+  }
+}
+
+bool probe_user_range(const void* ptr, size_t byte_size, bool needs_write) {
+  if (!is_user_range(ptr, byte_size)) {
+    return false;
+  }
+
+  if (byte_size == 0) {
+    return true;
+  }
+
+  const auto memory = Task::current()->get_memory();
+  if (memory == nullptr) {
+    return false;
+  }
+
+  const uintptr_t end = (uintptr_t)ptr + byte_size;
+  for (uintptr_t va = libk::align_to_previous((uintptr_t)ptr, PAGE_SIZE); va < end; va += PAGE_SIZE) {
+    const uint64_t par_el1 = translate_user_va(va, needs_write);
+    if ((par_el1 & 0x1) == 0) {
+      continue;
+    }
+
+    if (!resolve_user_fault(memory.get(), va, par_el1, needs_write) || (translate_user_va(va, needs_write) & 0x1) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool fixup_user_access_fault(Registers& registers) {
+  if (registers.elr < (uintptr_t)user_copy_start || registers.elr >= (uintptr_t)user_copy_end ||
+      registers.far >= KERNEL_BASE) {
+    return false;
+  }
+
+  registers.elr = (uintptr_t)user_copy_fault;
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct Registers;
+
+/**
+ * The accesses of the kernel to the memory of the current process (the syscall arguments).
+ *
+ * The copies do not check the pages first: the process memory is accessed with the EL0 permissions, and a
+ * fault the page fault handler does not resolve (an unmapped or kernel address, a read-only page written)
+ * stops the copy instead of crashing the kernel (see fixup_user_access_fault()). So a valid pointer costs
+ * no page table walk.
+ *
+ * The kernel functions which read the process memory directly (e.g. the blits) can not recover from a fault,
+ * their whole buffer is validated first with probe_user_range(), by the address translation instructions.
+ */
+
+/** Checks that the @a byte_size bytes at @a ptr are in the process address space (no translation). */
+[[nodiscard]] bool is_user_range(const void* ptr, size_t byte_size);
+
+/** Copies @a byte_size bytes of the current process memory at @a user_src into @a dst.
+ * @returns `false` if the process memory is not all readable (@a dst may then be partially written). */
+[[nodiscard]] bool copy_from_user(void* dst, const void* user_src, size_t byte_size);
+
+/** Copies the NUL-terminated string of the current process memory at @a user_src into the @a byte_size bytes at
+ * @a dst, so the kernel then reads its own copy (a string can not be validated before by probe_user_range()).
+ * @returns `false` if the string is not all readable or does not fit in @a dst with its NUL. */
+[[nodiscard]] bool strncpy_from_user(char* dst, const char* user_src, size_t byte_size);
+
+/** Copies @a byte_size bytes from @a src into the current process memory at @a user_dst.
+ * @returns `false` if the process memory is not all writable (it may then be partially written). */
+[[nodiscard]] bool copy_to_user(void* user_dst, const void* src, size_t byte_size);
+
+/** Checks with the address translation instructions (AT S1E0R or S1E0W) that the @a byte_size bytes at
+ * @a ptr are readable (or writable if @a needs_write) by the current process. The pages not mapped yet, paged
+ * out or copy-on-write are resolved as the process access would be, so they can then be accessed directly. */
+[[nodiscard]] bool probe_user_range(const void* ptr, size_t byte_size, bool needs_write);
+
+/** Makes a copy to or from the process memory which faulted (see @a registers) return its failure.
+ * @returns `false` if the fault did not happen in such a copy. */
+bool fixup_user_access_fault(Registers& registers);
@@ -0,0 +1,108 @@
+#include "zram.hpp"
+#include <libk/assert.hpp>
+#include <libk/lz4.hpp>
+#include <libk/string.hpp>
+#include "memory/mem_alloc.hpp"
+
+namespace Zram {
+struct Slot {
+  uint8_t* data;  // nullptr if the slot is free
+  uint32_t byte_size;
+  uint32_t next_free;  // the ID of the next free slot (0 if none), for a free slot
+};  // struct Slot
+
+static constexpr size_t INITIAL_NB_SLOTS = 256;
+
+static Slot* g_slots = nullptr;
+static size_t g_nb_slots = 0;
+static uint32_t g_first_free = 0;
+static Stats g_stats = {};
+
+/** The compression output, a byte more than accepted to tell the pages too big apart. */
+static uint8_t g_buffer[MAX_COMPRESSED_SIZE + 1];
+
+static Slot& get_slot(uint64_t id) {
+  KASSERT(id != 0 && id <= g_nb_slots && g_slots[id - 1].data != nullptr);
+  return g_slots[id - 1];
+}
+
+/** Takes a free slot, the slot table is doubled when full. Returns its ID, or 0 if out of memory. */
+static uint32_t allocate_slot() {
+  if (g_first_free == 0) {
+    const size_t nb_slots = g_nb_slots == 0 ? INITIAL_NB_SLOTS : 2 * g_nb_slots;
+    if (nb_slots > UINT32_MAX)
+      return 0;
+
+    auto* slots = (Slot*)kmalloc(nb_slots * sizeof(Slot), alignof(Slot));
+    if (slots == nullptr)
+      return 0;
+
+    libk::memcpy(slots, g_slots, g_nb_slots * sizeof(Slot));
+    kfree(g_slots);
+
+    // The new slots are chained in order.
+    for (size_t i = g_nb_slots; i < nb_slots; ++i)
+      slots[i] = {nullptr, 0, i + 1 < nb_slots ? (uint32_t)(i + 2) : 0};
+
+    g_first_free = g_nb_slots + 1;
+    g_slots = slots;
+    g_nb_slots = nb_slots;
+  }
+
+  const uint32_t id = g_first_free;
+  g_first_free = g_slots[id - 1].next_free;
+  return id;
+}
+
+uint64_t store(PhysicalPA pa) {
+  const size_t byte_size = libk::lz4_compress((const void*)(pa + KERNEL_BASE), PAGE_SIZE, g_buffer, sizeof(g_buffer));
+  if (byte_size == 0 || byte_size > MAX_COMPRESSED_SIZE) {
+    g_stats.nb_rejected_pages++;
+    return 0;
+  }
+
+  auto* data = (uint8_t*)kmalloc(byte_size, alignof(uint8_t));
+  if (data == nullptr)
+    return 0;
+
+  const uint32_t id = allocate_slot();
+  if (id == 0) {
+    kfree(data);
+    return 0;
+  }
+
+  libk::memcpy(data, g_buffer, byte_size);
+  g_slots[id - 1] = {data, (uint32_t)byte_size, 0};
+
+  g_stats.nb_stored_pages++;
+  g_stats.compressed_byte_size += byte_size;
+  g_stats.nb_page_outs++;
+  return id;
+}
+
+void load(uint64_t id, PhysicalPA pa) {
+  const Slot& slot = get_slot(id);
+  if (!libk::lz4_decompress(slot.data, slot.byte_size, (void*)(pa + KERNEL_BASE), PAGE_SIZE))
+    libk::panic("[Zram] Corrupted compressed page.");
+
+  g_stats.nb_page_ins++;
+}
+
+void free(uint64_t id) {
+  Slot& slot = get_slot(id);
+  kfree(slot.data);
+  g_stats.nb_stored_pages--;
+  g_stats.compressed_byte_size -= slot.byte_size;
+
+  slot = {nullptr, 0, g_first_free};
+  g_first_free = (uint32_t)id;
+}
+
+size_t get_byte_size(uint64_t id) {
+  return get_slot(id).byte_size;
+}
+
+const Stats& get_stats() {
+  return g_stats;
+}
+}  // namespace Zram
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "boot/mmu_utils.hpp"
+#include "memory/memory.hpp"
+
+/**
+ * A compressed store in memory for the pages moved out of the processes (a swap without disk).
+ *
+ * Each page is compressed with LZ4 into a kernel heap allocation of its compressed size, and identified by the
+ * ID of its slot (stored into the page table entry, see set_swap_entry()). The pages that do not compress to at
+ * most MAX_COMPRESSED_SIZE bytes are not stored: the larger allocations take whole pages of the kernel heap
+ * (see kmalloc()), nothing would be freed.
+ *
+ * All the functions must be called with the kernel lock held.
+ */
+namespace Zram {
+static constexpr size_t MAX_COMPRESSED_SIZE = 1024;
+
+struct Stats {
+  size_t nb_stored_pages;
+  size_t compressed_byte_size;
+  // Since the boot.
+  uint64_t nb_page_outs;
+  uint64_t nb_page_ins;
+  uint64_t nb_rejected_pages;  // not compressible enough
+};  // struct Stats
+
+/** Compresses the page @a pa into the store. Returns its ID (never 0), or 0 if it does not compress well enough
+ * or if out of memory. The page itself is left to the caller. */
+[[nodiscard]] uint64_t store(PhysicalPA pa);
+
+/** Decompresses the page @a id into the page @a pa. The page stays in the store until free() is called. */
+void load(uint64_t id, PhysicalPA pa);
+
+/** Removes the page @a id from the store. */
+void free(uint64_t id);
+
+/** Gets the byte size of the memory used by the page @a id in the store. */
+[[nodiscard]] size_t get_byte_size(uint64_t id);
+
+[[nodiscard]] const Stats& get_stats();
+};  // namespace Zram
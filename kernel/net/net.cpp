@@ -0,0 +1,592 @@
+#include "net.hpp"
+
+#include <utility>
+#include <libk/assert.hpp>
+#include <libk/hash_table.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "hardware/timer.hpp"
+#include "net/udp_socket.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+
+namespace Net {
+constexpr uint16_t ETHERTYPE_IPV4 = 0x0800;
+constexpr uint16_t ETHERTYPE_ARP = 0x0806;
+
+constexpr uint16_t ARP_HARDWARE_ETHERNET = 1;
+constexpr uint16_t ARP_REQUEST = 1;
+constexpr uint16_t ARP_REPLY = 2;
+
+constexpr uint8_t IPV4_VERSION = 4;
+constexpr uint8_t IPV4_TTL = 64;
+constexpr uint16_t IPV4_DONT_FRAGMENT = 1 << 14;
+constexpr uint16_t IPV4_MORE_FRAGMENTS = 1 << 13;
+constexpr uint16_t IPV4_FRAGMENT_OFFSET_MASK = 0x1fff;
+constexpr uint8_t PROTOCOL_ICMP = 1;
+constexpr uint8_t PROTOCOL_UDP = 17;
+
+constexpr uint8_t ICMP_ECHO_REPLY = 0;
+constexpr uint8_t ICMP_ECHO_REQUEST = 8;
+
+constexpr uint16_t EPHEMERAL_PORT_FIRST = 49152;
+
+// The ARP cache: the resolutions expire, a request is sent again if not answered in time.
+constexpr size_t ARP_CACHE_SIZE = 16;
+constexpr uint64_t ARP_REQUEST_TIMEOUT_MS = 1'000;
+constexpr uint64_t ARP_ENTRY_TIMEOUT_MS = 5 * 60'000;
+
+// The frames processed by the RX task between two checks of the wait list, and the queue of the raw frames.
+constexpr size_t RX_BATCH_SIZE = 64;
+constexpr size_t RAW_QUEUE_SIZE = 32;
+
+// All the header fields are big endian.
+struct [[gnu::packed]] EthernetHeader {
+  uint8_t destination[Ethernet::MAC_ADDRESS_SIZE];
+  uint8_t source[Ethernet::MAC_ADDRESS_SIZE];
+  uint16_t type;
+};  // struct EthernetHeader
+
+struct [[gnu::packed]] ArpPacket {
+  uint16_t hardware_type;
+  uint16_t protocol_type;
+  uint8_t hardware_size;
+  uint8_t protocol_size;
+  uint16_t operation;
+  uint8_t sender_mac[Ethernet::MAC_ADDRESS_SIZE];
+  uint32_t sender_address;
+  uint8_t target_mac[Ethernet::MAC_ADDRESS_SIZE];
+  uint32_t target_address;
+};  // struct ArpPacket
+
+struct [[gnu::packed]] Ipv4Header {
+  uint8_t version_ihl;
+  uint8_t tos;
+  uint16_t total_length;
+  uint16_t id;
+  uint16_t flags_fragment_offset;
+  uint8_t ttl;
+  uint8_t protocol;
+  uint16_t checksum;
+  uint32_t source;
+  uint32_t destination;
+};  // struct Ipv4Header
+
+struct [[gnu::packed]] IcmpHeader {
+  uint8_t type;
+  uint8_t code;
+  uint16_t checksum;
+  uint16_t id;
+  uint16_t sequence;
+};  // struct IcmpHeader
+
+struct [[gnu::packed]] UdpHeader {
+  uint16_t source_port;
+  uint16_t destination_port;
+  uint16_t length;
+  uint16_t checksum;
+};  // struct UdpHeader
+
+// The part of the IPv4 header covered by the UDP checksum.
+struct [[gnu::packed]] UdpPseudoHeader {
+  uint32_t source;
+  uint32_t destination;
+  uint8_t zero;
+  uint8_t protocol;
+  uint16_t length;
+};  // struct UdpPseudoHeader
+
+static_assert(sizeof(EthernetHeader) == ETHERNET_HEADER_SIZE && sizeof(Ipv4Header) == IPV4_HEADER_SIZE &&
+              sizeof(UdpHeader) == UDP_HEADER_SIZE && sizeof(ArpPacket) == 28 && sizeof(IcmpHeader) == 8);
+
+struct ArpEntry {
+  uint32_t address;  // 0 if the entry is free
+  uint8_t mac[Ethernet::MAC_ADDRESS_SIZE];
+  bool is_resolved;
+  uint64_t timestamp_ms;  // of the resolution, or of the last request
+  // The last packet waiting for the resolution, with its IPv4 header.
+  libk::IntrusivePtr<PacketBuffer> pending;
+};  // struct ArpEntry
+
+static constexpr uint8_t BROADCAST_MAC[Ethernet::MAC_ADDRESS_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+static constexpr uint8_t UNKNOWN_MAC[Ethernet::MAC_ADDRESS_SIZE] = {};
+
+static bool g_is_initialized = false;
+static uint8_t g_mac_address[Ethernet::MAC_ADDRESS_SIZE];
+static Ipv4Config g_config;
+static Stats g_stats;
+static uint16_t g_next_ip_id = 0;
+
+static ArpEntry g_arp_cache[ARP_CACHE_SIZE];
+
+static libk::HashTable<uint16_t, UdpSocket*> g_sockets;
+static uint16_t g_next_ephemeral_port = EPHEMERAL_PORT_FIRST;
+
+static libk::IntrusivePtr<PacketBuffer> g_raw_queue[RAW_QUEUE_SIZE];
+static size_t g_raw_head = 0;
+static size_t g_raw_tail = 0;
+static WaitList g_raw_wait_list;
+
+/*
+ * Checksums
+ */
+
+/**
+ * Adds the 16-bit words of @a data to the one's complement @a sum, unfolded. The words are summed 4 bytes at a
+ * time in the native byte order, which gives the same folded checksum in memory (see RFC 1071).
+ */
+static uint64_t checksum_add(uint64_t sum, const void* data, size_t byte_size) {
+  const auto* bytes = (const uint8_t*)data;
+  for (; byte_size >= 4; bytes += 4, byte_size -= 4) {
+    uint32_t word;
+    libk::memcpy(&word, bytes, 4);
+    sum += word;
+  }
+
+  if (byte_size >= 2) {
+    uint16_t word;
+    libk::memcpy(&word, bytes, 2);
+    sum += word;
+    bytes += 2;
+    byte_size -= 2;
+  }
+
+  // The last odd byte is the first one of a word padded with a zero (little endian).
+  if (byte_size == 1)
+    sum += bytes[0];
+  return sum;
+}
+
+/** Returns the checksum of @a sum, to be stored as is. A received header is valid if its checksum is 0. */
+static uint16_t checksum_fold(uint64_t sum) {
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return (uint16_t)~sum;
+}
+
+static uint64_t udp_pseudo_header_sum(uint32_t source, uint32_t destination, size_t udp_byte_size) {
+  const UdpPseudoHeader pseudo = {libk::to_be(source), libk::to_be(destination), 0, PROTOCOL_UDP,
+                                  libk::to_be((uint16_t)udp_byte_size)};
+  return checksum_add(0, &pseudo, sizeof(pseudo));
+}
+
+/*
+ * Ethernet and ARP
+ */
+
+static void transmit(const libk::IntrusivePtr<PacketBuffer>& packet,
+                     const uint8_t destination[Ethernet::MAC_ADDRESS_SIZE],
+                     uint16_t type) {
+  auto* header = (EthernetHeader*)packet->push(sizeof(EthernetHeader));
+  libk::memcpy(header->destination, destination, Ethernet::MAC_ADDRESS_SIZE);
+  libk::memcpy(header->source, g_mac_address, Ethernet::MAC_ADDRESS_SIZE);
+  header->type = libk::to_be(type);
+
+  packet->transmit();
+  g_stats.nb_tx_packets++;
+}
+
+static void send_arp(uint16_t operation, const uint8_t target_mac[Ethernet::MAC_ADDRESS_SIZE], uint32_t target) {
+  // Dropped if all the frames are being sent, as any lost packet.
+  auto packet = PacketBuffer::allocate(ETHERNET_HEADER_SIZE);
+  if (!packet)
+    return;
+
+  auto* arp = (ArpPacket*)packet->put(sizeof(ArpPacket));
+  arp->hardware_type = libk::to_be(ARP_HARDWARE_ETHERNET);
+  arp->protocol_type = libk::to_be(ETHERTYPE_IPV4);
+  arp->hardware_size = Ethernet::MAC_ADDRESS_SIZE;
+  arp->protocol_size = sizeof(uint32_t);
+  arp->operation = libk::to_be(operation);
+  libk::memcpy(arp->sender_mac, g_mac_address, Ethernet::MAC_ADDRESS_SIZE);
+  arp->sender_address = libk::to_be(g_config.address);
+  libk::memcpy(arp->target_mac, target_mac, Ethernet::MAC_ADDRESS_SIZE);
+  arp->target_address = libk::to_be(target);
+
+  transmit(packet, operation == ARP_REQUEST ? BROADCAST_MAC : target_mac, ETHERTYPE_ARP);
+}
+
+static ArpEntry* find_arp_entry(uint32_t address) {
+  for (ArpEntry& entry : g_arp_cache) {
+    if (entry.address == address)
+      return &entry;
+  }
+
+  return nullptr;
+}
+
+/** Returns a new entry for @a address, replacing a free entry or else the oldest one. */
+static ArpEntry* add_arp_entry(uint32_t address) {
+  ArpEntry* oldest = &g_arp_cache[0];
+  for (ArpEntry& entry : g_arp_cache) {
+    if (entry.address == 0) {
+      oldest = &entry;
+      break;
+    }
+
+    if (entry.timestamp_ms < oldest->timestamp_ms)
+      oldest = &entry;
+  }
+
+  if (oldest->pending)
+    g_stats.nb_tx_unresolved++;
+
+  *oldest = {};
+  oldest->address = address;
+  return oldest;
+}
+
+static void handle_arp(const libk::IntrusivePtr<PacketBuffer>& packet) {
+  const auto* arp = (const ArpPacket*)packet->pull(sizeof(ArpPacket));
+  if (arp == nullptr || libk::from_be(arp->hardware_type) != ARP_HARDWARE_ETHERNET ||
+      libk::from_be(arp->protocol_type) != ETHERTYPE_IPV4 || arp->hardware_size != Ethernet::MAC_ADDRESS_SIZE ||
+      arp->protocol_size != sizeof(uint32_t)) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  const uint32_t sender = libk::from_be(arp->sender_address);
+  const bool is_for_us = libk::from_be(arp->target_address) == g_config.address;
+
+  // Learn from all the packets of the known hosts, but only add the hosts talking to us.
+  ArpEntry* entry = find_arp_entry(sender);
+  if (entry == nullptr && is_for_us && sender != 0)
+    entry = add_arp_entry(sender);
+
+  if (entry != nullptr) {
+    libk::memcpy(entry->mac, arp->sender_mac, Ethernet::MAC_ADDRESS_SIZE);
+    entry->is_resolved = true;
+    entry->timestamp_ms = GenericTimer::get_elapsed_time_in_ms();
+    if (entry->pending) {
+      transmit(entry->pending, entry->mac, ETHERTYPE_IPV4);
+      entry->pending.reset();
+    }
+  }
+
+  if (is_for_us && libk::from_be(arp->operation) == ARP_REQUEST)
+    send_arp(ARP_REPLY, arp->sender_mac, sender);
+}
+
+/*
+ * IPv4
+ */
+
+/** Checks if @a address is ours, or a broadcast one. */
+static bool is_local_address(uint32_t address) {
+  return address == g_config.address || address == BROADCAST_ADDRESS ||
+         address == (g_config.address | ~g_config.netmask);
+}
+
+/** Sends @a packet (with its IPv4 header) to the next hop towards @a destination, once resolved. */
+static void route(const libk::IntrusivePtr<PacketBuffer>& packet, uint32_t destination) {
+  if (destination == BROADCAST_ADDRESS || destination == (g_config.address | ~g_config.netmask)) {
+    transmit(packet, BROADCAST_MAC, ETHERTYPE_IPV4);
+    return;
+  }
+
+  const bool is_on_link = ((destination ^ g_config.address) & g_config.netmask) == 0;
+  const uint32_t next_hop = is_on_link || g_config.gateway == 0 ? destination : g_config.gateway;
+
+  const uint64_t now_ms = GenericTimer::get_elapsed_time_in_ms();
+  ArpEntry* entry = find_arp_entry(next_hop);
+  if (entry != nullptr && entry->is_resolved && now_ms - entry->timestamp_ms < ARP_ENTRY_TIMEOUT_MS) {
+    transmit(packet, entry->mac, ETHERTYPE_IPV4);
+    return;
+  }
+
+  if (entry == nullptr) {
+    entry = add_arp_entry(next_hop);
+  } else if (entry->is_resolved) {
+    // Expired: resolve it again.
+    entry->is_resolved = false;
+    entry->timestamp_ms = 0;
+  }
+
+  // Only the last packet is held, the previous ones are dropped.
+  if (entry->pending)
+    g_stats.nb_tx_unresolved++;
+  entry->pending = packet;
+
+  if (now_ms - entry->timestamp_ms >= ARP_REQUEST_TIMEOUT_MS) {
+    entry->timestamp_ms = now_ms;
+    send_arp(ARP_REQUEST, UNKNOWN_MAC, next_hop);
+  }
+}
+
+static void send_ipv4(const libk::IntrusivePtr<PacketBuffer>& packet, uint8_t protocol, uint32_t destination) {
+  auto* header = (Ipv4Header*)packet->push(sizeof(Ipv4Header));
+  header->version_ihl = (IPV4_VERSION << 4) | (sizeof(Ipv4Header) / 4);
+  header->tos = 0;
+  header->total_length = libk::to_be((uint16_t)packet->get_byte_size());
+  header->id = libk::to_be(g_next_ip_id++);
+  header->flags_fragment_offset = libk::to_be(IPV4_DONT_FRAGMENT);
+  header->ttl = IPV4_TTL;
+  header->protocol = protocol;
+  header->checksum = 0;
+  header->source = libk::to_be(g_config.address);
+  header->destination = libk::to_be(destination);
+  header->checksum = checksum_fold(checksum_add(0, header, sizeof(Ipv4Header)));
+
+  route(packet, destination);
+}
+
+static void handle_icmp(const libk::IntrusivePtr<PacketBuffer>& packet, uint32_t source) {
+  const size_t byte_size = packet->get_byte_size();
+  const auto* request = (const IcmpHeader*)packet->pull(sizeof(IcmpHeader));
+  if (request == nullptr || checksum_fold(checksum_add(0, request, byte_size)) != 0) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  if (request->type != ICMP_ECHO_REQUEST || request->code != 0)
+    return;
+
+  // The received frames cannot be sent from their RX slot, the reply is copied into a TX one.
+  auto reply = PacketBuffer::allocate(ETHERNET_HEADER_SIZE + IPV4_HEADER_SIZE);
+  if (!reply)
+    return;
+
+  auto* header = (IcmpHeader*)reply->put(byte_size);
+  *header = *request;
+  header->type = ICMP_ECHO_REPLY;
+  header->checksum = 0;
+  libk::memcpy(header + 1, packet->get_data(), packet->get_byte_size());
+  header->checksum = checksum_fold(checksum_add(0, header, byte_size));
+
+  send_ipv4(reply, PROTOCOL_ICMP, source);
+}
+
+static void handle_udp(const libk::IntrusivePtr<PacketBuffer>& packet, uint32_t source, uint32_t destination) {
+  const size_t byte_size = packet->get_byte_size();
+  const auto* header = (const UdpHeader*)packet->pull(sizeof(UdpHeader));
+  const size_t length = header != nullptr ? libk::from_be(header->length) : 0;
+  if (header == nullptr || length < sizeof(UdpHeader) || length > byte_size) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  packet->trim(length - sizeof(UdpHeader));
+
+  // The checksum is optional, 0 if none.
+  if (header->checksum != 0 &&
+      checksum_fold(checksum_add(udp_pseudo_header_sum(source, destination, length), header, length)) != 0) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  UdpSocket* socket = find_socket(libk::from_be(header->destination_port));
+  if (socket == nullptr) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  socket->deliver(source, libk::from_be(header->source_port), packet->get_data(), packet->get_byte_size());
+}
+
+static void handle_ipv4(const libk::IntrusivePtr<PacketBuffer>& packet) {
+  const auto* header = (const Ipv4Header*)packet->pull(sizeof(Ipv4Header));
+  if (header == nullptr || (header->version_ihl >> 4) != IPV4_VERSION) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  // Skip the options, which follow the header.
+  const size_t header_size = (header->version_ihl & 0xf) * 4;
+  const size_t total_length = libk::from_be(header->total_length);
+  if (header_size < sizeof(Ipv4Header) || packet->pull(header_size - sizeof(Ipv4Header)) == nullptr ||
+      total_length < header_size || total_length - header_size > packet->get_byte_size() ||
+      checksum_fold(checksum_add(0, header, header_size)) != 0) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  // Without the Ethernet padding of the short frames.
+  packet->trim(total_length - header_size);
+
+  const uint32_t source = libk::from_be(header->source);
+  const uint32_t destination = libk::from_be(header->destination);
+  const uint16_t flags_fragment_offset = libk::from_be(header->flags_fragment_offset);
+  const bool is_fragment =
+      (flags_fragment_offset & IPV4_MORE_FRAGMENTS) || (flags_fragment_offset & IPV4_FRAGMENT_OFFSET_MASK);
+  if (is_fragment || !is_local_address(destination)) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  switch (header->protocol) {
+    case PROTOCOL_ICMP:
+      handle_icmp(packet, source);
+      break;
+    case PROTOCOL_UDP:
+      handle_udp(packet, source, destination);
+      break;
+    default:
+      g_stats.nb_rx_dropped++;
+      break;
+  }
+}
+
+/*
+ * Receive task
+ */
+
+static void queue_raw(const libk::IntrusivePtr<PacketBuffer>& packet) {
+  if (g_raw_tail - g_raw_head == RAW_QUEUE_SIZE) {
+    g_stats.nb_rx_dropped++;
+    return;
+  }
+
+  g_raw_queue[g_raw_tail++ % RAW_QUEUE_SIZE] = packet;
+  g_raw_wait_list.wake_all();
+}
+
+static void handle_frame(const libk::IntrusivePtr<PacketBuffer>& packet) {
+  const auto* header = (const EthernetHeader*)packet->pull(sizeof(EthernetHeader));
+  if (header == nullptr)
+    return;
+
+  switch (libk::from_be(header->type)) {
+    case ETHERTYPE_ARP:
+      g_stats.nb_rx_packets++;
+      handle_arp(packet);
+      break;
+    case ETHERTYPE_IPV4:
+      g_stats.nb_rx_packets++;
+      handle_ipv4(packet);
+      break;
+    default:
+      // Given to the raw frames system calls as received.
+      (void)packet->push(sizeof(EthernetHeader));
+      queue_raw(packet);
+      break;
+  }
+}
+
+static void run_rx() {
+  while (true) {
+    bool is_blocked;
+
+    {
+      KernelTaskLockGuard kernel_lock;
+      Ethernet::Frame frame;
+      for (size_t i = 0; i < RX_BATCH_SIZE && Ethernet::receive(&frame); ++i) {
+        auto packet = PacketBuffer::wrap_received(frame);
+        if (packet)
+          handle_frame(packet);
+      }
+
+      is_blocked = Ethernet::block_task_until_received(Task::current());
+    }
+
+    if (is_blocked)
+      sys_yield();
+  }
+}
+
+/*
+ * API
+ */
+
+void init() {
+  if (!Ethernet::is_initialized())
+    return;
+
+  // A link-local address (RFC 3927), without probing: 169.254.1.0 to 169.254.254.255.
+  Ethernet::get_mac_address(g_mac_address);
+  g_config.address = (169 << 24) | (254 << 16) | ((1 + g_mac_address[4] % 254) << 8) | g_mac_address[5];
+  g_config.netmask = 0xffff0000;
+  g_config.gateway = 0;
+
+  auto task = TaskManager::get().create_kernel_task(&run_rx);
+  KASSERT(task != nullptr);
+  TaskManager::get().wake_task(task);
+
+  g_is_initialized = true;
+  LOG_INFO("[Net] IPv4 address {:#x}", g_config.address);
+}
+
+bool is_initialized() {
+  return g_is_initialized;
+}
+
+const Ipv4Config& get_ipv4_config() {
+  return g_config;
+}
+
+void set_ipv4_config(const Ipv4Config& config) {
+  g_config = config;
+
+  // The resolutions may not be valid on the new network.
+  for (ArpEntry& entry : g_arp_cache)
+    entry = {};
+}
+
+const Stats& get_stats() {
+  return g_stats;
+}
+
+void send_udp(const libk::IntrusivePtr<PacketBuffer>& packet,
+              uint16_t source_port,
+              uint32_t destination,
+              uint16_t destination_port) {
+  KASSERT(g_is_initialized && packet->get_byte_size() <= UDP_MAX_PAYLOAD);
+
+  auto* header = (UdpHeader*)packet->push(sizeof(UdpHeader));
+  const size_t length = packet->get_byte_size();
+  header->source_port = libk::to_be(source_port);
+  header->destination_port = libk::to_be(destination_port);
+  header->length = libk::to_be((uint16_t)length);
+  header->checksum = 0;
+
+  // A computed checksum of 0 is sent as its one's complement equivalent, 0 meaning none.
+  const uint16_t checksum =
+      checksum_fold(checksum_add(udp_pseudo_header_sum(g_config.address, destination, length), header, length));
+  header->checksum = checksum != 0 ? checksum : 0xffff;
+
+  send_ipv4(packet, PROTOCOL_UDP, destination);
+}
+
+void register_socket(UdpSocket* socket) {
+  KASSERT(socket != nullptr);
+  const bool is_inserted = g_sockets.insert(socket->get_port(), socket);
+  KASSERT(is_inserted);
+}
+
+void unregister_socket(UdpSocket* socket) {
+  (void)g_sockets.remove(socket->get_port());
+}
+
+uint16_t allocate_port() {
+  constexpr size_t EPHEMERAL_PORT_COUNT = 65536 - EPHEMERAL_PORT_FIRST;
+  for (size_t i = 0; i < EPHEMERAL_PORT_COUNT; ++i) {
+    const uint16_t port = g_next_ephemeral_port;
+    g_next_ephemeral_port = port == 65535 ? EPHEMERAL_PORT_FIRST : port + 1;
+    if (!g_sockets.contains(port))
+      return port;
+  }
+
+  return 0;
+}
+
+UdpSocket* find_socket(uint16_t port) {
+  UdpSocket* const* socket = g_sockets.find(port);
+  return socket != nullptr ? *socket : nullptr;
+}
+
+libk::IntrusivePtr<PacketBuffer> receive_raw() {
+  if (g_raw_head == g_raw_tail)
+    return nullptr;
+
+  return std::move(g_raw_queue[g_raw_head++ % RAW_QUEUE_SIZE]);
+}
+
+bool block_task_until_raw_received(const libk::IntrusivePtr<Task>& task) {
+  if (g_raw_head != g_raw_tail)
+    return false;
+
+  g_raw_wait_list.add(task);
+  return true;
+}
+}  // namespace Net
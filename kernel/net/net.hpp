@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+#include "net/packet_buffer.hpp"
+#include "task/wait_list.hpp"
+
+class UdpSocket;
+
+/**
+ * A minimal IPv4 stack over the Ethernet driver: ARP, ICMP (echo replies only) and UDP, without fragments or
+ * options. The IPv4 addresses and the ports are in the native byte order.
+ *
+ * The received frames are processed by a kernel task, in place in their PacketBuffer: the UDP payloads are
+ * copied once, straight into the receive ring of their socket (see UdpSocket). The frames of other protocols
+ * are queued for the raw frames system calls. The packets to send are allocated with the headroom of all the
+ * headers (see UDP_HEADROOM), their payload is written first and each layer then prepends its header.
+ *
+ * The address defaults to a link-local one (169.254.0.0/16) derived from the MAC address, until configured.
+ * All the functions must be called with the kernel lock held.
+ */
+namespace Net {
+static constexpr size_t ETHERNET_HEADER_SIZE = 14;
+static constexpr size_t IPV4_HEADER_SIZE = 20;
+static constexpr size_t UDP_HEADER_SIZE = 8;
+/** The headroom of a UDP packet, and the maximum byte size of its payload. */
+static constexpr size_t UDP_HEADROOM = ETHERNET_HEADER_SIZE + IPV4_HEADER_SIZE + UDP_HEADER_SIZE;
+static constexpr size_t UDP_MAX_PAYLOAD = Ethernet::MAX_FRAME_SIZE - UDP_HEADROOM;
+
+static constexpr uint32_t BROADCAST_ADDRESS = 0xffffffff;
+
+struct Ipv4Config {
+  uint32_t address;
+  uint32_t netmask;
+  uint32_t gateway;  // 0 if none
+};  // struct Ipv4Config
+
+struct Stats {
+  uint64_t nb_rx_packets;
+  uint64_t nb_rx_dropped;  // malformed, or for an unknown port or protocol
+  uint64_t nb_tx_packets;
+  uint64_t nb_tx_unresolved;  // dropped while their destination was being resolved
+};  // struct Stats
+
+/** Starts the stack, if the Ethernet controller is initialized. */
+void init();
+[[nodiscard]] bool is_initialized();
+
+[[nodiscard]] const Ipv4Config& get_ipv4_config();
+void set_ipv4_config(const Ipv4Config& config);
+[[nodiscard]] const Stats& get_stats();
+
+/** Sends the UDP payload of @a packet (allocated with UDP_HEADROOM) from the local @a source_port to
+ * @a destination:@a destination_port. The packet is held until the destination is resolved. */
+void send_udp(const libk::IntrusivePtr<PacketBuffer>& packet,
+              uint16_t source_port,
+              uint32_t destination,
+              uint16_t destination_port);
+
+/** Adds @a socket to the sockets receiving the datagrams sent to its port. */
+void register_socket(UdpSocket* socket);
+void unregister_socket(UdpSocket* socket);
+/** Returns a free local port for a socket, or 0 if there is none. */
+[[nodiscard]] uint16_t allocate_port();
+/** Returns the socket of the local @a port, or nullptr. */
+[[nodiscard]] UdpSocket* find_socket(uint16_t port);
+
+/** Takes the oldest received frame that is not for the stack (neither ARP nor IPv4). Returns nullptr if there
+ * is none. */
+[[nodiscard]] libk::IntrusivePtr<PacketBuffer> receive_raw();
+/** Blocks @a task until a frame is returned by receive_raw(). Returns false without blocking if there is one. */
+bool block_task_until_raw_received(const libk::IntrusivePtr<Task>& task);
+}  // namespace Net
@@ -0,0 +1,92 @@
+#include "packet_buffer.hpp"
+#include <libk/assert.hpp>
+#include <libk/object_cache.hpp>
+#include <libk/utils.hpp>
+
+static libk::ObjectCache<PacketBuffer> g_packet_cache;
+
+void* PacketBuffer::operator new(size_t size) {
+  KASSERT(size == sizeof(PacketBuffer));
+  return g_packet_cache.allocate();
+}
+
+void PacketBuffer::operator delete(void* ptr) {
+  g_packet_cache.deallocate(ptr);
+}
+
+PacketBuffer::PacketBuffer(const Ethernet::Frame& frame, bool is_received)
+    : m_frame(frame), m_data(frame.data), m_is_received(is_received) {
+  if (is_received)
+    m_byte_size = frame.byte_size;
+}
+
+PacketBuffer::~PacketBuffer() {
+  if (m_is_received) {
+    Ethernet::release(m_frame);
+  } else if (!m_is_sent) {
+    Ethernet::discard_tx_frame(m_frame);
+  }
+}
+
+libk::IntrusivePtr<PacketBuffer> PacketBuffer::allocate(size_t headroom) {
+  Ethernet::Frame frame;
+  if (!Ethernet::allocate_tx_frame(&frame))
+    return nullptr;
+
+  auto* packet = new PacketBuffer(frame, false);
+  if (packet == nullptr) {
+    Ethernet::discard_tx_frame(frame);
+    return nullptr;
+  }
+
+  KASSERT(headroom <= frame.byte_size);
+  packet->m_data += headroom;
+  return libk::IntrusivePtr<PacketBuffer>(packet);
+}
+
+libk::IntrusivePtr<PacketBuffer> PacketBuffer::wrap_received(const Ethernet::Frame& frame) {
+  auto* packet = new PacketBuffer(frame, true);
+  if (packet == nullptr) {
+    Ethernet::release(frame);
+    return nullptr;
+  }
+
+  return libk::IntrusivePtr<PacketBuffer>(packet);
+}
+
+uint8_t* PacketBuffer::push(size_t byte_size) {
+  KASSERT(byte_size <= get_headroom());
+  m_data -= byte_size;
+  m_byte_size += byte_size;
+  return m_data;
+}
+
+const uint8_t* PacketBuffer::pull(size_t byte_size) {
+  if (byte_size > m_byte_size)
+    return nullptr;
+
+  const uint8_t* data = m_data;
+  m_data += byte_size;
+  m_byte_size -= byte_size;
+  return data;
+}
+
+uint8_t* PacketBuffer::put(size_t byte_size) {
+  KASSERT(byte_size <= get_tailroom());
+  uint8_t* data = m_data + m_byte_size;
+  m_byte_size += byte_size;
+  return data;
+}
+
+void PacketBuffer::trim(size_t byte_size) {
+  m_byte_size = libk::min(m_byte_size, byte_size);
+}
+
+void PacketBuffer::transmit() {
+  KASSERT(!m_is_received && !m_is_sent);
+  m_is_sent = true;
+
+  Ethernet::Frame frame = m_frame;
+  frame.data = m_data;
+  Ethernet::send(frame, m_byte_size);
+}
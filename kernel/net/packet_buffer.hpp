@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+#include "hardware/ethernet.hpp"
+
+/**
+ * A network packet, in place in the slot of an Ethernet frame (see Ethernet::Frame).
+ *
+ * The layers strip their headers from the front of a received packet (pull()), and write theirs into the
+ * headroom reserved in front of the payload of a packet to send (push()), so the data is never copied from
+ * one layer to another. The packets are reference counted (e.g. a packet is held by the ARP cache until its
+ * destination is resolved), the slot of a packet is given back to the driver with its last reference.
+ *
+ * All the methods must be called with the kernel lock held.
+ */
+class PacketBuffer : public libk::RefCounted {
+ public:
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
+  /** Returns a packet to send, with @a headroom bytes in front of its empty payload, or nullptr if all the
+   * TX frames are being sent. */
+  [[nodiscard]] static libk::IntrusivePtr<PacketBuffer> allocate(size_t headroom);
+  /** Returns the packet of the received @a frame, which is released with the packet. */
+  [[nodiscard]] static libk::IntrusivePtr<PacketBuffer> wrap_received(const Ethernet::Frame& frame);
+
+  ~PacketBuffer();
+
+  [[nodiscard]] uint8_t* get_data() const { return m_data; }
+  [[nodiscard]] size_t get_byte_size() const { return m_byte_size; }
+  [[nodiscard]] size_t get_headroom() const { return m_data - m_frame.data; }
+  [[nodiscard]] size_t get_tailroom() const { return m_frame.byte_size - get_headroom() - m_byte_size; }
+
+  /** Prepends @a byte_size bytes (at most the headroom) and returns them. */
+  uint8_t* push(size_t byte_size);
+  /** Strips the @a byte_size first bytes and returns them, or nullptr if the packet is shorter. */
+  const uint8_t* pull(size_t byte_size);
+  /** Appends @a byte_size bytes (at most the tailroom) and returns them. */
+  uint8_t* put(size_t byte_size);
+  /** Cuts the packet to its @a byte_size first bytes (e.g. to remove the Ethernet padding). */
+  void trim(size_t byte_size);
+
+  /** Sends the packet, which must start with its Ethernet header. A packet is only sent once. */
+  void transmit();
+
+ private:
+  PacketBuffer(const Ethernet::Frame& frame, bool is_received);
+
+  Ethernet::Frame m_frame;  // the whole slot for a packet to send
+  uint8_t* m_data;
+  size_t m_byte_size = 0;
+  bool m_is_received;
+  bool m_is_sent = false;
+};  // class PacketBuffer
@@ -0,0 +1,108 @@
+#include "udp_socket.hpp"
+
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "hardware/ethernet.hpp"
+#include "memory/process_memory.hpp"
+#include "net/net.hpp"
+#include "task/task.hpp"
+
+static_assert(SYS_UDP_MAX_PAYLOAD == Net::UDP_MAX_PAYLOAD);
+
+UdpSocket::UdpSocket(uint16_t port, Task* process)
+    : m_port(port), m_process(process), m_rings(libk::make_scoped<Buffer>(2 * sizeof(sys_udp_ring_t))) {
+  // The buffer memory is not zeroed.
+  libk::bzero(m_rings->get(), 2 * sizeof(sys_udp_ring_t));
+}
+
+UdpSocket::~UdpSocket() {
+  if (m_address != 0)
+    (void)m_process->get_memory()->unmap_shared(m_address);
+}
+
+UdpSocket* UdpSocket::create(uint16_t port, Task* process) {
+  KASSERT(process != nullptr && process->get_memory());
+
+  if (port == 0)
+    port = Net::allocate_port();
+  if (port == 0 || Net::find_socket(port) != nullptr)
+    return nullptr;
+
+  auto* socket = new UdpSocket(port, process);
+  if (socket == nullptr)
+    return nullptr;
+
+  socket->m_address = process->get_memory()->map_shared(*socket->m_rings);
+  if (socket->m_address == 0) {
+    delete socket;
+    return nullptr;
+  }
+
+  Net::register_socket(socket);
+  return socket;
+}
+
+void UdpSocket::close(UdpSocket* socket) {
+  Net::unregister_socket(socket);
+  socket->m_wait_list.wake_all();
+  delete socket;
+}
+
+void UdpSocket::deliver(uint32_t source, uint16_t source_port, const uint8_t* payload, size_t byte_size) {
+  sys_udp_ring_t& ring = get_receive_ring();
+
+  // The tail is only written by the kernel, the head is advanced concurrently by the process.
+  const uint32_t tail = ring.tail;
+  if (tail - __atomic_load_n(&ring.head, __ATOMIC_SEQ_CST) >= SYS_UDP_RING_SIZE)
+    return;
+
+  sys_udp_datagram_t& datagram = ring.datagrams[tail % SYS_UDP_RING_SIZE];
+  datagram.address = source;
+  datagram.port = source_port;
+  datagram.size = (uint16_t)byte_size;
+  libk::memcpy(datagram.data, payload, byte_size);
+
+  // Sequentially consistent, as sys_channel_commit_send(): either we see the waiting flag, or the receiver
+  // sees the new tail before blocking.
+  __atomic_store_n(&ring.tail, tail + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring.receiver_waiting, __ATOMIC_SEQ_CST)) {
+    __atomic_store_n(&ring.receiver_waiting, 0, __ATOMIC_SEQ_CST);
+    m_wait_list.wake_all();
+  }
+}
+
+bool UdpSocket::flush(const libk::IntrusivePtr<Task>& task) {
+  sys_udp_ring_t& ring = get_send_ring();
+
+  uint32_t head = ring.head;
+  while (head != __atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST)) {
+    auto packet = PacketBuffer::allocate(Net::UDP_HEADROOM);
+    if (!packet)
+      return Ethernet::block_task_until_tx_slot_free(task);
+
+    // Read each field once, the process may change them concurrently.
+    const sys_udp_datagram_t& datagram = ring.datagrams[head % SYS_UDP_RING_SIZE];
+    const uint32_t destination = datagram.address;
+    const uint16_t destination_port = datagram.port;
+    const size_t byte_size = libk::min<size_t>(datagram.size, SYS_UDP_MAX_PAYLOAD);
+    libk::memcpy(packet->put(byte_size), datagram.data, byte_size);
+
+    Net::send_udp(packet, m_port, destination, destination_port);
+    __atomic_store_n(&ring.head, ++head, __ATOMIC_SEQ_CST);
+  }
+
+  return false;
+}
+
+bool UdpSocket::block_task_until_received(const libk::IntrusivePtr<Task>& task) {
+  sys_udp_ring_t& ring = get_receive_ring();
+
+  // Flag the wait before checking the ring: either deliver() sees the flag, or we see its new tail here.
+  __atomic_store_n(&ring.receiver_waiting, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring.head, __ATOMIC_SEQ_CST) != __atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST))
+    return false;
+
+  m_wait_list.add(task);
+  return true;
+}
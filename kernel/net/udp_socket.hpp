@@ -0,0 +1,56 @@
+#pragma once
+
+#include <sys/net.h>
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+#include "memory/buffer.hpp"
+#include "task/wait_list.hpp"
+
+class Task;
+
+/**
+ * A UDP socket bound to a local port: the kernel side of a sys_udp_socket_t (see sys/net.h).
+ *
+ * As for the channels, its two rings (sys_udp_ring_t, the send ring first) are in a Buffer mapped into its
+ * process, the kernel accessing them through its own mapping. A received datagram is copied once, from its
+ * Ethernet frame into the receive ring, and a datagram to send from the send ring into its Ethernet frame.
+ * The ring indices and sizes read from the shared memory are only used in comparisons or clamped.
+ *
+ * All the methods must be called with the kernel lock held.
+ */
+class UdpSocket {
+ public:
+  /** Creates the socket of @a process bound to the local @a port, or to a free one if 0. Returns nullptr if
+   * the port is already used (or if out of memory). */
+  [[nodiscard]] static UdpSocket* create(uint16_t port, Task* process);
+  /** Unbinds @a socket, unmaps its memory and deletes it. */
+  static void close(UdpSocket* socket);
+
+  [[nodiscard]] uint16_t get_port() const { return m_port; }
+  /** Returns the address of the rings in the process memory. */
+  [[nodiscard]] VirtualAddress get_address() const { return m_address; }
+
+  /** Copies the datagram of @a byte_size bytes at @a payload, from @a source:@a source_port, into the receive
+   * ring. It is dropped if the ring is full. */
+  void deliver(uint32_t source, uint16_t source_port, const uint8_t* payload, size_t byte_size);
+
+  /** Sends the datagrams of the send ring. If all the Ethernet frames are being sent, blocks @a task until one
+   * is free and returns true (see sync.hpp), the remaining datagrams are then sent by the next flush(). */
+  bool flush(const libk::IntrusivePtr<Task>& task);
+  /** Blocks @a task until the receive ring is not empty. Returns false without blocking if it is not. */
+  bool block_task_until_received(const libk::IntrusivePtr<Task>& task);
+
+ private:
+  UdpSocket(uint16_t port, Task* process);
+  ~UdpSocket();
+
+  [[nodiscard]] sys_udp_ring_t& get_send_ring() const { return ((sys_udp_ring_t*)m_rings->get())[0]; }
+  [[nodiscard]] sys_udp_ring_t& get_receive_ring() const { return ((sys_udp_ring_t*)m_rings->get())[1]; }
+
+  uint16_t m_port;
+  Task* m_process;
+  libk::ScopedPointer<Buffer> m_rings;
+  VirtualAddress m_address = 0;
+  WaitList m_wait_list;
+};  // class UdpSocket
@@ -0,0 +1,276 @@
+#include "profiler.hpp"
+#include <libk/assert.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "boot/mmu_utils.hpp"
+#include "drain_task.hpp"
+#include "hardware/irq/irq_lists.hpp"
+#include "hardware/irq_save.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "hardware/uart.hpp"
+#include "task/task_manager.hpp"
+
+namespace Profiler {
+static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "the ring size must be a power of two");
+
+// The PMU events counted by the event counters 0 and 1 (see the Arm ARM, "Common event numbers").
+static constexpr uint64_t PMU_L1D_CACHE_REFILL = 0x03;
+static constexpr uint64_t PMU_BR_MIS_PRED = 0x10;
+
+/** The bit of each event counter in the PMCNTENSET, PMINTENSET and PMOVSCLR registers, indexed by Event. */
+static constexpr uint64_t COUNTER_BITS[NB_EVENTS] = {1ul << 31, 1ul << 0, 1ul << 1};
+static constexpr uint64_t ALL_COUNTER_BITS = COUNTER_BITS[0] | COUNTER_BITS[1] | COUNTER_BITS[2];
+
+// PMCR_EL0 bits: enable, reset the event counters, reset the cycle counter.
+static constexpr uint64_t PMCR_E = 1 << 0;
+static constexpr uint64_t PMCR_P = 1 << 1;
+static constexpr uint64_t PMCR_C = 1 << 2;
+
+struct Ring {
+  // Written only by the core owning the ring.
+  uint64_t head;
+  uint64_t lost_count;
+  // Written only by the draining task.
+  alignas(64) uint64_t tail;
+  Record records[RING_SIZE];
+};  // struct Ring
+
+static Ring g_rings[SMP::MAX_CORES];
+static const UART* g_output = nullptr;
+
+/** Sets the counter of @a event so it overflows after its period. The cycle counter overflows on its 32 bits,
+ * as the event counters (PMCR_EL0.LC is 0). */
+static void arm_counter(Event event) {
+  const uint64_t value = (uint32_t)(0 - PERIODS[(size_t)event]);
+  switch (event) {
+    case Event::CYCLES:
+      asm volatile("msr PMCCNTR_EL0, %0" : : "r"(value));
+      break;
+    case Event::CACHE_MISSES:
+      asm volatile("msr PMEVCNTR0_EL0, %0" : : "r"(value));
+      break;
+    case Event::BRANCH_MISSES:
+      asm volatile("msr PMEVCNTR1_EL0, %0" : : "r"(value));
+      break;
+  }
+}
+
+/** Appends a record to @a ring if there is room, filling its header. Only called by the core owning the ring,
+ * IRQs masked. Returns the record to fill, or nullptr. */
+static Record* push(Ring& ring, uint32_t core, RecordKind kind, uint32_t pid, uint64_t pc) {
+  const uint64_t head = ring.head;
+  if (head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+    return nullptr;
+
+  Record& record = ring.records[head % RING_SIZE];
+  record.timestamp = GenericTimer::get_tick_count();
+  record.pid = pid;
+  record.core = (uint16_t)core;
+  record.kind = kind;
+  record.event = Event::CYCLES;
+  record.pc = pc;
+  record.nb_frames = 0;
+  return &record;
+}
+
+/** Publishes the record returned by the last push() to @a ring. */
+static void commit(Ring& ring) {
+  __atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+}
+
+/** Starts a record on the calling core, IRQs masked, after the LOST record of the previous drops if any.
+ * Returns nullptr if the ring is full. */
+static Record* begin_record(Ring& ring, size_t core, RecordKind kind, uint32_t pid, uint64_t pc) {
+  if (ring.lost_count > 0) {
+    Record* lost = push(ring, core, RecordKind::LOST, 0, ring.lost_count);
+    if (lost == nullptr) {
+      ring.lost_count++;
+      return nullptr;
+    }
+
+    commit(ring);
+    ring.lost_count = 0;
+  }
+
+  Record* record = push(ring, core, kind, pid, pc);
+  if (record == nullptr)
+    ring.lost_count++;
+  return record;
+}
+
+/** Copies @a path into @a record, truncated if needed. */
+static void set_path(Record& record, const char* path) {
+  const size_t length = libk::min(libk::strlen(path), sizeof(record.path));
+  libk::memcpy(record.path, path, length);
+  if (length < sizeof(record.path))
+    record.path[length] = '\0';
+}
+
+/** Reads the 16-byte frame record at @a fp (the caller frame pointer, then the return address) without
+ * faulting: the address is translated first (with the EL0 permissions if @a from_user), then read through the
+ * linear mapping. The interrupted code may be between an AT instruction and its PAR_EL1 read, so PAR_EL1 is
+ * preserved. */
+static bool read_frame_record(uint64_t fp, bool from_user, uint64_t record[2]) {
+  // The frame records are 16-byte aligned (as the stack pointer), so they never cross a page.
+  if ((fp & 0xF) != 0 || (fp >= KERNEL_BASE) == from_user)
+    return false;
+
+  uint64_t saved_par_el1;
+  asm volatile("mrs %x0, PAR_EL1" : "=r"(saved_par_el1));
+  if (from_user) {
+    asm volatile("at s1e0r, %x0" ::"r"(fp));
+  } else {
+    asm volatile("at s1e1r, %x0" ::"r"(fp));
+  }
+
+  uint64_t par_el1;
+  asm volatile("isb\n\tmrs %x0, PAR_EL1" : "=r"(par_el1));
+  asm volatile("msr PAR_EL1, %x0" ::"r"(saved_par_el1));
+  if ((par_el1 & 0b1) != 0)
+    return false;
+
+  const PhysicalPA pa = (par_el1 & libk::mask_bits(12, 47)) | (fp & (PAGE_SIZE - 1));
+  libk::memcpy(record, (const void*)(pa + KERNEL_BASE), 2 * sizeof(uint64_t));
+  return true;
+}
+
+/** Fills the return addresses of @a record by walking the frame records from @a fp. */
+static void walk_frames(Record& record, uint64_t fp, bool from_user) {
+  uint64_t frame_record[2];
+  while (record.nb_frames < MAX_FRAMES && fp != 0 && read_frame_record(fp, from_user, frame_record)) {
+    record.frames[record.nb_frames++] = frame_record[1];
+
+    // The stack grows down: the frames of the callers are above, anything else is a corrupted chain.
+    if (frame_record[0] <= fp)
+      break;
+    fp = frame_record[0];
+  }
+}
+
+static void sample(Event event, const Registers& registers) {
+  const size_t core = SMP::get_core_id();
+  const Task* task = TaskManager::get().is_ready() ? TaskManager::get().get_current_task_ptr() : nullptr;
+  const uint32_t pid = task != nullptr ? (uint32_t)task->get_id() : 0;
+
+  Ring& ring = g_rings[core];
+  Record* record = begin_record(ring, core, RecordKind::SAMPLE, pid, registers.elr);
+  if (record == nullptr)
+    return;
+
+  record->event = event;
+  // SPSR_EL1.M is 0 (EL0t) if the user space was interrupted.
+  const bool from_user = (registers.spsr & 0xF) == 0;
+  walk_frames(*record, registers.gp_regs.x29, from_user);
+  commit(ring);
+}
+
+void handle_overflow(const Registers& registers) {
+  uint64_t overflows;
+  asm volatile("mrs %0, PMOVSCLR_EL0" : "=r"(overflows));
+  overflows &= ALL_COUNTER_BITS;
+  if (overflows == 0)
+    return;
+
+  // Clearing the overflow flags lowers the IRQ, it is then dispatched to handle_irq() or not at all.
+  asm volatile("msr PMOVSCLR_EL0, %0" : : "r"(overflows));
+  for (size_t i = 0; i < NB_EVENTS; ++i) {
+    if ((overflows & COUNTER_BITS[i]) == 0)
+      continue;
+
+    arm_counter((Event)i);
+    sample((Event)i, registers);
+  }
+}
+
+static void handle_irq(void*) {
+  // Nothing to do, the samples are taken by handle_overflow() with the interrupted registers.
+}
+
+void init_core() {
+  // Stop and reset all the counters, and do not give their access to EL0.
+  asm volatile("msr PMCR_EL0, %0" : : "r"(PMCR_P | PMCR_C));
+  asm volatile("msr PMUSERENR_EL0, xzr");
+
+  // Count at EL0 and EL1 (the P and U filtering bits are 0).
+  asm volatile("msr PMEVTYPER0_EL0, %0" : : "r"(PMU_L1D_CACHE_REFILL));
+  asm volatile("msr PMEVTYPER1_EL0, %0" : : "r"(PMU_BR_MIS_PRED));
+  asm volatile("msr PMCCFILTR_EL0, xzr");
+
+  for (size_t i = 0; i < NB_EVENTS; ++i)
+    arm_counter((Event)i);
+
+  asm volatile("msr PMOVSCLR_EL0, %0" : : "r"(ALL_COUNTER_BITS));
+  asm volatile("msr PMINTENSET_EL1, %0" : : "r"(ALL_COUNTER_BITS));
+  asm volatile("msr PMCNTENSET_EL0, %0" : : "r"(ALL_COUNTER_BITS));
+
+  IRQManager::register_irq_handler(LOCAL_PMU, &handle_irq, nullptr);
+  asm volatile("msr PMCR_EL0, %0\n\tisb" : : "r"(PMCR_E));
+}
+
+/** Records a PROGRAM, FORK or LIBRARY record on the calling core. */
+static void record_event(RecordKind kind, uint32_t pid, uint64_t pc, const char* path) {
+  const uint64_t daif = IRQSave::mask_irqs();
+
+  const size_t core = SMP::get_core_id();
+  Ring& ring = g_rings[core];
+  Record* record = begin_record(ring, core, kind, pid, pc);
+  if (record != nullptr) {
+    if (path != nullptr)
+      set_path(*record, path);
+    commit(ring);
+  }
+
+  IRQSave::restore_irqs(daif);
+}
+
+void record_program(uint32_t pid, const char* path) {
+  record_event(RecordKind::PROGRAM, pid, 0, path);
+}
+
+void record_fork(uint32_t parent_pid, uint32_t pid) {
+  record_event(RecordKind::FORK, pid, parent_pid, nullptr);
+}
+
+void record_library(uintptr_t base, const char* path) {
+  record_event(RecordKind::LIBRARY, 0, base, path);
+}
+
+void set_output(const UART& uart) {
+  g_output = &uart;
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks, uint64_t frequency) {
+  // Split to not overflow after a few minutes.
+  return (ticks / frequency) * 1'000'000'000 + ((ticks % frequency) * 1'000'000'000) / frequency;
+}
+
+/** Sends at most @a max_records records of the rings over the output UART, each one prefixed by "PRF". */
+static size_t drain(size_t max_records) {
+  if (g_output == nullptr)
+    return 0;
+
+  const uint64_t frequency = GenericTimer::get_frequency();
+  size_t count = 0;
+  for (Ring& ring : g_rings) {
+    uint64_t tail = ring.tail;
+    const uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+    for (; tail != head && count < max_records; ++tail, ++count) {
+      Record record = ring.records[tail % RING_SIZE];
+      record.timestamp = ticks_to_ns(record.timestamp, frequency);
+      LogUARTLockGuard log_uart_lock;
+      g_output->write("PRF", 3);
+      g_output->write((const char*)&record, sizeof(record));
+    }
+
+    __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+  }
+
+  return count;
+}
+
+void start_drain_task() {
+  static constexpr size_t MAX_RECORDS_PER_DRAIN = 32;
+  TaskManager::get().wake_task(DrainTask::create(&drain, MAX_RECORDS_PER_DRAIN));
+}
+}  // namespace Profiler
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class UART;
+struct Registers;
+
+/**
+ * A sampling profiler using the performance monitors (PMU) of the cores, as the Linux perf.
+ *
+ * Each core counts its cycles, its L1 data cache refills and its mispredicted branches, at EL0 and EL1. Each
+ * time one of them reaches its period, the PMU raises an overflow IRQ and a sample is recorded: the interrupted
+ * PC, the current task and its call chain (walked with the frame pointers, which GCC keeps on AArch64). The
+ * samples are appended to a ring buffer per core, drained over the log UART by a kernel task as for the trace
+ * (see trace.hpp), and symbolized on the host by tools/profile-decoder.py with the kernel and programs ELFs.
+ *
+ * The user PCs are only meaningful with the program the task runs, and the base address of the shared libraries:
+ * both are recorded too, when a program is loaded (see PROFILER_PROGRAM()) or a library is placed.
+ *
+ * The profiler is only compiled in with CONFIG_PROFILER.
+ */
+namespace Profiler {
+/** The sampled events (keep in sync with profile-decoder.py). */
+enum class Event : uint8_t {
+  CYCLES,
+  CACHE_MISSES,  // L1 data cache refills
+  BRANCH_MISSES,
+};  // enum class Event
+
+static constexpr size_t NB_EVENTS = 3;
+/** The count of events between two samples, per event. */
+static constexpr uint32_t PERIODS[NB_EVENTS] = {1'000'000, 20'000, 20'000};
+
+/** The kinds of records (keep in sync with profile-decoder.py). */
+enum class RecordKind : uint8_t {
+  /** pc: the interrupted PC, event: the overflowed event, frames: the return addresses */
+  SAMPLE,
+  /** path: the program run by the task pid */
+  PROGRAM,
+  /** pc: the parent pid, the task pid runs the same program */
+  FORK,
+  /** pc: the base address, path: the shared library */
+  LIBRARY,
+  /** pc: the count of records dropped since the last record of the core */
+  LOST,
+};  // enum class RecordKind
+
+static constexpr size_t MAX_FRAMES = 12;
+
+struct Record {
+  uint64_t timestamp;  // in timer ticks, converted to nanoseconds when drained
+  uint32_t pid;        // 0 if no task is running
+  uint16_t core;
+  RecordKind kind;
+  Event event;
+  uint64_t pc;
+  uint64_t nb_frames;
+  union {
+    uint64_t frames[MAX_FRAMES];
+    char path[MAX_FRAMES * sizeof(uint64_t)];  // NUL-terminated unless truncated
+  };
+};  // struct Record
+
+static_assert(sizeof(Record) == 128);
+
+/** Count of records of the ring of each core. */
+static constexpr size_t RING_SIZE = 256;
+
+/** Programs the PMU of the calling core and enables its overflow IRQ. Must be called on each core. */
+void init_core();
+
+/** Samples the overflowed counters of the calling core. Called on each IRQ with the interrupted @a registers,
+ * before the IRQ is dispatched (the PMU IRQ handler itself has not access to them). */
+void handle_overflow(const Registers& registers);
+
+/** Records that the task @a pid runs the program @a path. */
+void record_program(uint32_t pid, const char* path);
+/** Records that the task @a pid was forked from @a parent_pid. */
+void record_fork(uint32_t parent_pid, uint32_t pid);
+/** Records that the shared library @a path is loaded at @a base in all processes. */
+void record_library(uintptr_t base, const char* path);
+
+/** Sets the UART the records are drained into (the log UART). */
+void set_output(const UART& uart);
+
+/** Starts the kernel task that drains the rings. Requires the task manager. */
+void start_drain_task();
+};  // namespace Profiler
+
+#ifdef CONFIG_PROFILER
+#define PROFILER_PROGRAM(pid, path) ::Profiler::record_program(pid, path)
+#define PROFILER_FORK(parent_pid, pid) ::Profiler::record_fork(parent_pid, pid)
+#define PROFILER_LIBRARY(base, path) ::Profiler::record_library(base, path)
+#else
+#define PROFILER_PROGRAM(pid, path) ((void)0)
+#define PROFILER_FORK(parent_pid, pid) ((void)0)
+#define PROFILER_LIBRARY(base, path) ((void)0)
+#endif  // CONFIG_PROFILER
@@ -0,0 +1,302 @@
+#include "channel.hpp"
+
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "memory/process_memory.hpp"
+#include "task/task.hpp"
+#include "task/task_manager.hpp"
+
+libk::LinkedList<Channel*> Channel::g_listening;
+
+Channel::Channel() : m_rings(libk::make_scoped<Buffer>(2 * sizeof(sys_channel_ring_t))) {
+  m_endpoints[0].channel = this;
+  m_endpoints[1].channel = this;
+
+  // The buffer memory is not zeroed.
+  libk::bzero(m_rings->get(), 2 * sizeof(sys_channel_ring_t));
+}
+
+Channel::~Channel() {
+  KASSERT(m_grants.is_empty());
+}
+
+Channel::Endpoint* Channel::create(const char* name, Task* process) {
+  KASSERT(process != nullptr && process->get_memory());
+
+  const size_t name_length = libk::strlen(name);
+  if (name_length == 0 || name_length > SYS_CHANNEL_NAME_MAX)
+    return nullptr;
+
+  for (const Channel* channel : g_listening) {
+    if (libk::strcmp(channel->m_name, name) == 0)
+      return nullptr;
+  }
+
+  auto* channel = new Channel;
+  if (channel == nullptr)
+    return nullptr;
+
+  Endpoint& endpoint = channel->m_endpoints[0];
+  endpoint.process = process;
+  endpoint.address = process->get_memory()->map_shared(*channel->m_rings);
+  if (endpoint.address == 0) {
+    delete channel;
+    return nullptr;
+  }
+
+  libk::memcpy(channel->m_name, name, name_length + 1);
+  g_listening.push_back(channel);
+  return &endpoint;
+}
+
+Channel::Endpoint* Channel::connect(const char* name, Task* process) {
+  KASSERT(process != nullptr && process->get_memory());
+
+  auto it = g_listening.begin();
+  while (it != g_listening.end() && libk::strcmp((*it)->m_name, name) != 0)
+    ++it;
+
+  if (it == g_listening.end())
+    return nullptr;
+
+  Channel* channel = *it;
+  Endpoint& endpoint = channel->m_endpoints[1];
+  endpoint.process = process;
+  endpoint.address = process->get_memory()->map_shared(*channel->m_rings);
+  if (endpoint.address == 0)
+    return nullptr;
+
+  g_listening.erase(it);
+  return &endpoint;
+}
+
+void Channel::close(Endpoint& endpoint) {
+  KASSERT(!endpoint.is_closed);
+  Channel* channel = endpoint.channel;
+
+  for (auto it = channel->m_grants.begin(); it != channel->m_grants.end();) {
+    auto grant_it = it++;
+    if (grant_it->owner == &endpoint)
+      channel->free_grant(grant_it);
+  }
+
+  (void)endpoint.process->get_memory()->unmap_shared(endpoint.address);
+  endpoint.process = nullptr;
+  endpoint.is_closed = true;
+  endpoint.wait_list.wake_all();
+  abort_calls(endpoint);
+
+  // The peer must not wait forever.
+  Endpoint& peer = endpoint.get_peer();
+  peer.wait_list.wake_all();
+  abort_calls(peer);
+
+  // Never connected: the peer is closed from the start.
+  if (endpoint.is_creator() && peer.process == nullptr) {
+    auto it = g_listening.begin();
+    while (*it != channel)
+      ++it;
+
+    g_listening.erase(it);
+    peer.is_closed = true;
+  }
+
+  if (peer.is_closed)
+    delete channel;
+}
+
+bool Channel::is_ready(const Endpoint& endpoint, bool for_send) {
+  const sys_channel_ring_t* rings = endpoint.channel->get_rings();
+  const sys_channel_ring_t& ring = (endpoint.is_creator() == for_send) ? rings[0] : rings[1];
+
+  const uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_SEQ_CST);
+  const uint32_t tail = __atomic_load_n(&ring.tail, __ATOMIC_SEQ_CST);
+  return for_send ? tail - head < SYS_CHANNEL_RING_SIZE : head != tail;
+}
+
+bool Channel::block_task_until_ready(Endpoint& endpoint, const libk::IntrusivePtr<Task>& task, bool for_send) {
+  Channel* channel = endpoint.channel;
+  if (endpoint.get_peer().is_closed)
+    return false;
+
+  sys_channel_ring_t* rings = channel->get_rings();
+  sys_channel_ring_t& ring = (endpoint.is_creator() == for_send) ? rings[0] : rings[1];
+  uint32_t& waiting = for_send ? ring.sender_waiting : ring.receiver_waiting;
+
+  // Flag the wait before checking the ring: either the peer sees the flag once it updated the ring, or we
+  // see its update here (see sys_channel_commit_send()).
+  __atomic_store_n(&waiting, 1, __ATOMIC_SEQ_CST);
+  if (is_ready(endpoint, for_send))
+    return false;
+
+  endpoint.wait_list.add(task);
+  return true;
+}
+
+void Channel::notify(Endpoint& endpoint) {
+  // Clear the flags of the waits that the caller could have satisfied, the woken tasks set them again if
+  // they still have to wait.
+  sys_channel_ring_t* rings = endpoint.channel->get_rings();
+  sys_channel_ring_t& send_ring = endpoint.is_creator() ? rings[0] : rings[1];
+  sys_channel_ring_t& receive_ring = endpoint.is_creator() ? rings[1] : rings[0];
+  __atomic_store_n(&send_ring.receiver_waiting, 0, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&receive_ring.sender_waiting, 0, __ATOMIC_SEQ_CST);
+
+  endpoint.get_peer().wait_list.wake_all();
+}
+
+/** Copies the message of a synchronous call (or its reply) from @a source to @a destination. */
+static void copy_call_message(const GPRegisters& source, GPRegisters& destination) {
+  destination.x0 = SYS_ERR_OK;
+  destination.x1 = source.x1;
+  destination.x2 = source.x2;
+  destination.x3 = source.x3;
+  destination.x4 = source.x4;
+}
+
+void Channel::call(Endpoint& endpoint, const libk::IntrusivePtr<Task>& task, GPRegisters& regs) {
+  Endpoint& peer = endpoint.get_peer();
+  if (peer.is_closed) {
+    regs.x0 = SYS_ERR_CHANNEL_CLOSED;
+    return;
+  }
+
+  // The receiver may be a thread killed meanwhile.
+  if (peer.receiver != nullptr && peer.receiver->is_terminated())
+    peer.receiver = nullptr;
+
+  if (peer.receiver == nullptr) {
+    // The request stays in the saved registers of the task until the receiver takes it.
+    peer.callers.push_back(task);
+    TaskManager::get().pause_task(task);
+    return;
+  }
+
+  const libk::IntrusivePtr<Task> receiver = peer.receiver;
+  peer.receiver = nullptr;
+  peer.reply_to = task;
+
+  // The receiver registers were saved when it blocked, they are restored by the switch.
+  copy_call_message(regs, receiver->get_saved_state().gp_regs);
+  TaskManager::get().hand_off_to(receiver);
+}
+
+void Channel::reply_wait(Endpoint& endpoint, const libk::IntrusivePtr<Task>& task, GPRegisters& regs) {
+  libk::IntrusivePtr<Task> replied = endpoint.reply_to;
+  endpoint.reply_to = nullptr;
+  if (replied != nullptr && replied->is_terminated())
+    replied = nullptr;
+
+  if (replied != nullptr)
+    copy_call_message(regs, replied->get_saved_state().gp_regs);
+
+  // Serve the next call right away, the replied caller is woken as usual.
+  while (!endpoint.callers.is_empty()) {
+    libk::IntrusivePtr<Task> caller = endpoint.callers.pop_front();
+    if (caller->is_terminated())
+      continue;
+
+    copy_call_message(caller->get_saved_state().gp_regs, regs);
+    endpoint.reply_to = caller;
+    if (replied != nullptr)
+      TaskManager::get().wake_task(replied);
+    return;
+  }
+
+  if (endpoint.get_peer().is_closed) {
+    regs.x0 = SYS_ERR_CHANNEL_CLOSED;
+    if (replied != nullptr)
+      TaskManager::get().wake_task(replied);
+    return;
+  }
+
+  endpoint.receiver = task;
+  if (replied != nullptr) {
+    TaskManager::get().hand_off_to(replied);
+  } else {
+    TaskManager::get().pause_task(task);
+  }
+}
+
+void Channel::abort_calls(Endpoint& endpoint) {
+  auto abort = [](const libk::IntrusivePtr<Task>& task) {
+    if (task == nullptr || task->is_terminated())
+      return;
+
+    task->get_saved_state().gp_regs.x0 = SYS_ERR_CHANNEL_CLOSED;
+    TaskManager::get().wake_task(task);
+  };
+
+  abort(endpoint.receiver);
+  abort(endpoint.reply_to);
+  endpoint.receiver = nullptr;
+  endpoint.reply_to = nullptr;
+  while (!endpoint.callers.is_empty())
+    abort(endpoint.callers.pop_front());
+}
+
+uint64_t Channel::allocate_grant(Endpoint& endpoint, size_t byte_size, VirtualAddress* address) {
+  if (byte_size == 0 || byte_size > SYS_CHANNEL_GRANT_MAX_SIZE)
+    return 0;
+
+  auto* chunk = new MemoryChunk(libk::div_round_up(byte_size, PAGE_SIZE));
+  if (chunk == nullptr)
+    return 0;
+
+  if (!chunk->is_status_okay()) {
+    delete chunk;
+    return 0;
+  }
+
+  *address = endpoint.process->get_memory()->map_shared(*chunk);
+  if (*address == 0) {
+    delete chunk;
+    return 0;
+  }
+
+  Channel* channel = endpoint.channel;
+  const uint64_t id = channel->m_next_grant_id++;
+  channel->m_grants.push_back({id, chunk, &endpoint, *address});
+  return id;
+}
+
+bool Channel::accept_grant(Endpoint& endpoint, uint64_t grant, VirtualAddress* address, size_t* byte_size) {
+  Endpoint& peer = endpoint.get_peer();
+  for (auto& granted : endpoint.channel->m_grants) {
+    if (granted.id != grant || granted.owner != &peer)
+      continue;
+
+    // Map it first, the grant stays with the peer on failure.
+    const VirtualAddress new_address = endpoint.process->get_memory()->map_shared(*granted.chunk);
+    if (new_address == 0)
+      return false;
+
+    (void)peer.process->get_memory()->unmap_shared(granted.address);
+    granted.owner = &endpoint;
+    granted.address = new_address;
+    *address = new_address;
+    *byte_size = granted.chunk->get_byte_size();
+    return true;
+  }
+
+  return false;
+}
+
+bool Channel::release_grant(Endpoint& endpoint, VirtualAddress address) {
+  Channel* channel = endpoint.channel;
+  for (auto it = channel->m_grants.begin(); it != channel->m_grants.end(); ++it) {
+    if (it->owner == &endpoint && it->address == address) {
+      channel->free_grant(it);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Channel::free_grant(libk::LinkedList<Grant>::Iterator it) {
+  (void)it->owner->process->get_memory()->unmap_shared(it->address);
+  delete it->chunk;
+  m_grants.erase(it);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <sys/channel.h>
+#include <cstdint>
+#include <libk/linked_list.hpp>
+#include <libk/memory.hpp>
+#include "hardware/regs.hpp"
+#include "memory/buffer.hpp"
+#include "memory/memory_chunk.hpp"
+#include "task/wait_list.hpp"
+
+class Task;
+
+/**
+ * A message channel between two processes: the kernel side of a sys_channel_t (see sys/channel.h).
+ *
+ * Its two rings (sys_channel_ring_t, the first one sent by the creator) are in a Buffer mapped into both
+ * processes, the kernel accessing them through its own mapping. The messages never go through the kernel:
+ * it only blocks the tasks waiting for a ring (in the WaitList of their endpoint) and wakes them when their
+ * peer rings the doorbell. The ring indices read from the shared memory are only used in comparisons.
+ *
+ * The grants are chunks mapped into a single process at a time: the endpoint that allocated them, then the
+ * one that accepted them. They are freed when released or when their owner endpoint is closed.
+ *
+ * The synchronous calls (see call()) do not use the rings: the request and the reply are passed in the
+ * registers, and the kernel switches directly from the caller to the task serving the calls and back
+ * (see TaskManager::hand_off_to()), so that a round trip costs two context switches.
+ *
+ * All the methods must be called with the kernel lock held.
+ */
+class Channel {
+ public:
+  /** One side of the channel, owned by a process (see Task::register_channel()). */
+  struct Endpoint {
+    Channel* channel;
+    Task* process;
+    /** The address of the rings in the process memory. */
+    VirtualAddress address = 0;
+    bool is_closed = false;
+    WaitList wait_list;
+
+    // The synchronous calls served by this endpoint.
+    libk::IntrusivePtr<Task> receiver;                   // blocked in reply_wait(), waiting for a call
+    libk::IntrusivePtr<Task> reply_to;                   // the caller being served, waiting for the reply
+    libk::LinkedList<libk::IntrusivePtr<Task>> callers;  // the callers waiting for the receiver
+
+    [[nodiscard]] bool is_creator() const { return this == &channel->m_endpoints[0]; }
+    [[nodiscard]] Endpoint& get_peer() const { return channel->m_endpoints[is_creator() ? 1 : 0]; }
+  };  // struct Endpoint
+
+  /** Creates the channel named @a name for @a process and returns its endpoint, or nullptr if the name is
+   * already used by a channel not connected yet (or if out of memory). */
+  [[nodiscard]] static Endpoint* create(const char* name, Task* process);
+  /** Connects @a process to the channel named @a name and returns its endpoint, or nullptr if there is
+   * no such channel (or if out of memory). The name can then be used by another channel. */
+  [[nodiscard]] static Endpoint* connect(const char* name, Task* process);
+
+  /** Closes @a endpoint and unmaps its memory (its grants are freed). The channel is deleted once both
+   * endpoints are closed. */
+  static void close(Endpoint& endpoint);
+
+  /**
+   * Blocks @a task of @a endpoint until its send ring is not full if @a for_send is true, or until its
+   * receive ring is not empty otherwise, unless the peer closed the channel. Returns true if the task was
+   * blocked (see sync.hpp).
+   */
+  static bool block_task_until_ready(Endpoint& endpoint, const libk::IntrusivePtr<Task>& task, bool for_send);
+  /** Checks if the send ring of @a endpoint is not full if @a for_send is true, or if its receive ring is not
+   * empty otherwise. */
+  [[nodiscard]] static bool is_ready(const Endpoint& endpoint, bool for_send);
+  /** Wakes the tasks of the peer of @a endpoint blocked in block_task_until_ready(). */
+  static void notify(Endpoint& endpoint);
+
+  /**
+   * Sends the request in the registers x1-x4 of the current @a task (of @a endpoint) to the peer, and blocks
+   * the task until the reply is written into the same registers (see reply_wait()). The task switches
+   * directly to the receiver of the peer if it waits for a call, otherwise it is queued.
+   * The error is written into x0 of @a regs, or into the saved x0 of the task once it is awaken.
+   */
+  static void call(Endpoint& endpoint, const libk::IntrusivePtr<Task>& task, GPRegisters& regs);
+  /**
+   * Replies with the registers x1-x4 of the current @a task (of @a endpoint) to the call being served, if
+   * any, then gets the next call into the same registers. If there is none yet, the task blocks (switching
+   * directly to the replied caller) until a call is made. The error is written as for call().
+   */
+  static void reply_wait(Endpoint& endpoint, const libk::IntrusivePtr<Task>& task, GPRegisters& regs);
+
+  /** Allocates and maps a grant of @a byte_size bytes into the process of @a endpoint, and stores its
+   * address into @a address. Returns its ID, or 0 on failure. */
+  [[nodiscard]] static uint64_t allocate_grant(Endpoint& endpoint, size_t byte_size, VirtualAddress* address);
+  /** Moves the @a grant allocated by the peer of @a endpoint into its process, and stores its address
+   * and byte size. Returns false if there is no such grant. */
+  [[nodiscard]] static bool accept_grant(Endpoint& endpoint,
+                                         uint64_t grant,
+                                         VirtualAddress* address,
+                                         size_t* byte_size);
+  /** Frees the grant owned by @a endpoint mapped at @a address. Returns false if there is no such grant. */
+  [[nodiscard]] static bool release_grant(Endpoint& endpoint, VirtualAddress address);
+
+ private:
+  struct Grant {
+    uint64_t id;
+    MemoryChunk* chunk;
+    Endpoint* owner;
+    VirtualAddress address;  // in the owner process memory
+  };  // struct Grant
+
+  Channel();
+  ~Channel();
+
+  [[nodiscard]] sys_channel_ring_t* get_rings() const { return (sys_channel_ring_t*)m_rings->get(); }
+  void free_grant(libk::LinkedList<Grant>::Iterator it);
+  /** Wakes the tasks of @a endpoint blocked in call() or reply_wait() with SYS_ERR_CHANNEL_CLOSED. */
+  static void abort_calls(Endpoint& endpoint);
+
+  // The channels created but not connected yet, waiting for their peer.
+  static libk::LinkedList<Channel*> g_listening;
+
+  char m_name[SYS_CHANNEL_NAME_MAX + 1] = {};
+  libk::ScopedPointer<Buffer> m_rings;
+  Endpoint m_endpoints[2];
+  libk::LinkedList<Grant> m_grants;
+  uint64_t m_next_grant_id = 1;
+};  // class Channel
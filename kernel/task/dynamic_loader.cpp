@@ -0,0 +1,291 @@
+#include "dynamic_loader.hpp"
+
+#include <elf/symbols.hpp>
+#include <libk/linked_list.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "memory/mem_alloc.hpp"
+#include "profiler.hpp"
+
+namespace DynamicLoader {
+/** The symbol binding of the weak symbols, which are 0 if not found. */
+static constexpr uint8_t STB_WEAK = 2;
+
+struct LibraryRange {
+  char* path;
+  VirtualAddress base;
+  size_t byte_size;
+};  // struct LibraryRange
+
+// There are only a few libraries, a list is enough. The ranges are never freed.
+static libk::LinkedList<LibraryRange> g_libraries;
+static VirtualAddress g_next_base = PROCESS_LIBRARY_BASE;
+
+void* Object::translate(uint64_t addr, size_t byte_size) const {
+  for (size_t i = 0; i < segment_count; ++i) {
+    const Segment& segment = segments[i];
+    if (addr >= segment.va_start && byte_size <= segment.byte_size &&
+        addr - segment.va_start <= segment.byte_size - byte_size) {
+      return segment.data + (addr - segment.va_start);
+    }
+  }
+
+  return nullptr;
+}
+
+size_t Object::get_byte_size_after(uint64_t addr) const {
+  for (size_t i = 0; i < segment_count; ++i) {
+    const Segment& segment = segments[i];
+    if (addr >= segment.va_start && addr - segment.va_start < segment.byte_size)
+      return segment.byte_size - (addr - segment.va_start);
+  }
+
+  return 0;
+}
+
+/** Computes the symbol count of @a object from its hash table, it is needed to bound the symbol lookups. */
+static uint64_t get_symbol_count(const Object& object) {
+  if (object.gnu_hash_table != 0) {
+    const auto* hash_table =
+        (const elf::GnuHashTable*)object.translate(object.gnu_hash_table, sizeof(elf::GnuHashTable));
+    return hash_table == nullptr ? 0
+                                 : elf::get_symbol_count(hash_table, object.get_byte_size_after(object.gnu_hash_table));
+  }
+
+  const auto* hash_table = (const elf::HashTable*)object.translate(object.hash_table, sizeof(elf::HashTable));
+  if (hash_table == nullptr)
+    return 0;
+
+  const size_t table_size =
+      sizeof(elf::HashTable) + sizeof(uint32_t) * ((size_t)hash_table->bucket_count + hash_table->chain_count);
+  return object.translate(object.hash_table, table_size) == nullptr ? 0 : hash_table->chain_count;
+}
+
+bool parse(Object& object) {
+  const auto* entries = (const elf::Dynamic*)object.translate(object.dynamic_addr, object.dynamic_size);
+  if (entries == nullptr)
+    return false;
+
+  const size_t entry_count = object.dynamic_size / sizeof(elf::Dynamic);
+  for (size_t i = 0; i < entry_count && entries[i].tag != elf::DynamicTag::NULL_TAG; ++i) {
+    const uint64_t value = entries[i].value;
+    switch (entries[i].tag) {
+      case elf::DynamicTag::NEEDED:
+        if (object.needed_count == MAX_LIBRARIES) {
+          LOG_ERROR("[DynamicLoader] Too many needed libraries");
+          return false;
+        }
+
+        object.needed[object.needed_count++] = value;
+        break;
+      case elf::DynamicTag::STRING_TABLE:
+        object.string_table = value;
+        break;
+      case elf::DynamicTag::STRING_TABLE_SIZE:
+        object.string_table_size = value;
+        break;
+      case elf::DynamicTag::SYMBOL_TABLE:
+        object.symbol_table = value;
+        break;
+      case elf::DynamicTag::HASH:
+        object.hash_table = value;
+        break;
+      case elf::DynamicTag::GNU_HASH:
+        object.gnu_hash_table = value;
+        break;
+      case elf::DynamicTag::RELA:
+        object.rela = value;
+        break;
+      case elf::DynamicTag::RELA_SIZE:
+        object.rela_size = value;
+        break;
+      case elf::DynamicTag::JUMP_REL:
+        object.plt_rela = value;
+        break;
+      case elf::DynamicTag::PLT_REL_SIZE:
+        object.plt_rela_size = value;
+        break;
+      case elf::DynamicTag::PLT_REL:
+        // Only the relocations with addend are supported.
+        if (value != (uint64_t)elf::DynamicTag::RELA)
+          return false;
+        break;
+      default:
+        break;
+    }
+  }
+
+  object.symbol_count = get_symbol_count(object);
+  return true;
+}
+
+/** Returns the string at @a offset in the string table of @a object, or nullptr if it is out of the table. */
+static const char* get_string(const Object& object, uint64_t offset) {
+  if (offset >= object.string_table_size)
+    return nullptr;
+
+  const auto* table = (const char*)object.translate(object.string_table, object.string_table_size);
+  if (table == nullptr)
+    return nullptr;
+
+  // The string must be terminated inside the table.
+  if (libk::memchr(table + offset, '\0', object.string_table_size - offset) == nullptr)
+    return nullptr;
+
+  return table + offset;
+}
+
+bool get_library_path(const Object& object, size_t index, char* path) {
+  const char* name = index < object.needed_count ? get_string(object, object.needed[index]) : nullptr;
+  if (name == nullptr || libk::strchr(name, '/') != nullptr)
+    return false;
+
+  const size_t directory_length = libk::strlen(LIBRARY_DIRECTORY);
+  const size_t name_length = libk::strlen(name);
+  if (directory_length + name_length >= MAX_PATH_LENGTH)
+    return false;
+
+  libk::memcpy(path, LIBRARY_DIRECTORY, directory_length);
+  libk::memcpy(path + directory_length, name, name_length + 1);
+  return true;
+}
+
+VirtualAddress get_library_base(const char* path, const elf::Header* header, const void* program_headers) {
+  size_t byte_size = 0;
+  for (uint64_t i = 0; i < header->program_header_entry_count; ++i) {
+    const elf::ProgramHeader* segment = elf::get_program_header(header, program_headers, i);
+    if (segment != nullptr && segment->is_load())
+      byte_size = libk::max<size_t>(byte_size, segment->virtual_addr + segment->mem_size);
+  }
+
+  byte_size = libk::align_to_next(byte_size, PAGE_SIZE);
+  for (const auto& library : g_libraries) {
+    if (libk::strcmp(library.path, path) == 0 && byte_size <= library.byte_size)
+      return library.base;
+  }
+
+  // A free page is left between two libraries.
+  const VirtualAddress base = g_next_base;
+  if (byte_size == 0 || PROCESS_LIBRARY_END - base < byte_size)
+    return 0;
+
+  const size_t path_length = libk::strlen(path);
+  char* path_copy = (char*)kmalloc(path_length + 1, alignof(char));
+  if (path_copy == nullptr)
+    return 0;
+
+  libk::memcpy(path_copy, path, path_length + 1);
+  g_libraries.push_back({path_copy, base, byte_size});
+  g_next_base = base + byte_size + PAGE_SIZE;
+  PROFILER_LIBRARY(base, path_copy);
+  return base;
+}
+
+/** Finds the symbol named @a name defined by @a object, using its hash table (the GNU one if any, its bloom filter
+ * rejects most of the names defined by the other libraries). The tables were bounded by parse(). */
+static const elf::Symbol* find_symbol(const Object& object, const char* name) {
+  if (object.symbol_count == 0)
+    return nullptr;
+
+  elf::SymbolTable table;
+  table.symbol_count = object.symbol_count;
+  table.symbols =
+      (const elf::Symbol*)object.translate(object.symbol_table, sizeof(elf::Symbol) * object.symbol_count);
+  table.strings_size = object.string_table_size;
+  table.strings = (const char*)object.translate(object.string_table, object.string_table_size);
+  if (table.symbols == nullptr || table.strings == nullptr)
+    return nullptr;
+
+  if (object.gnu_hash_table != 0)
+    return elf::find_symbol(table, (const elf::GnuHashTable*)object.translate(object.gnu_hash_table, 1), name);
+  return elf::find_symbol(table, (const elf::HashTable*)object.translate(object.hash_table, 1), name);
+}
+
+/** Resolves the address of the symbol @a index of @a object. */
+static bool resolve(const Object& object,
+                    uint32_t index,
+                    const Object* libraries,
+                    size_t library_count,
+                    uint64_t* address) {
+  const auto* symbol =
+      (const elf::Symbol*)object.translate(object.symbol_table + index * sizeof(elf::Symbol), sizeof(elf::Symbol));
+  if (symbol == nullptr)
+    return false;
+
+  if (symbol->is_defined()) {
+    *address = object.base + symbol->value;
+    return true;
+  }
+
+  const char* name = get_string(object, symbol->name_offset);
+  if (name == nullptr)
+    return false;
+
+  for (size_t i = 0; i < library_count; ++i) {
+    const elf::Symbol* definition = find_symbol(libraries[i], name);
+    if (definition != nullptr) {
+      *address = libraries[i].base + definition->value;
+      return true;
+    }
+  }
+
+  if ((symbol->info >> 4) == STB_WEAK) {
+    *address = 0;
+    return true;
+  }
+
+  LOG_ERROR("[DynamicLoader] Undefined symbol {}", name);
+  return false;
+}
+
+static bool relocate_table(const Object& object,
+                           uint64_t table,
+                           uint64_t table_size,
+                           const Object* libraries,
+                           size_t library_count) {
+  if (table_size == 0)
+    return true;
+
+  const auto* relocations = (const elf::Rela*)object.translate(table, table_size);
+  if (relocations == nullptr)
+    return false;
+
+  for (size_t i = 0; i < table_size / sizeof(elf::Rela); ++i) {
+    const elf::Rela& relocation = relocations[i];
+    if (relocation.get_type() == elf::RelocationType::NONE)
+      continue;
+
+    auto* target = (uint64_t*)object.translate(relocation.offset, sizeof(uint64_t));
+    if (target == nullptr)
+      return false;
+
+    uint64_t symbol_address;
+    switch (relocation.get_type()) {
+      case elf::RelocationType::RELATIVE:
+        *target = object.base + relocation.addend;
+        break;
+      case elf::RelocationType::ABS64:
+      case elf::RelocationType::GLOB_DAT:
+      case elf::RelocationType::JUMP_SLOT:
+        if (!resolve(object, relocation.get_symbol_index(), libraries, library_count, &symbol_address))
+          return false;
+
+        *target = symbol_address + relocation.addend;
+        break;
+      default:
+        LOG_ERROR("[DynamicLoader] Unsupported relocation type {}", (uint32_t)relocation.get_type());
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool relocate(const Object& object, const Object* libraries, size_t library_count) {
+  return relocate_table(object, object.rela, object.rela_size, libraries, library_count) &&
+         relocate_table(object, object.plt_rela, object.plt_rela_size, libraries, library_count);
+}
+}  // namespace DynamicLoader
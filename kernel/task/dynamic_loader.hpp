@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <elf/dynamic.hpp>
+#include <elf/elf.hpp>
+
+#include "memory/memory.hpp"
+
+/**
+ * The dynamic linking of the user programs with their shared libraries (e.g. libsyscall.so).
+ *
+ * There is no loader in user space: the kernel maps the libraries needed by a program (its DT_NEEDED
+ * entries, searched in /lib) and resolves all the relocations when the program is loaded (no lazy binding).
+ *
+ * Each library gets its own address range, the same in all processes: once relocated, its segments are the
+ * same for every process, so they are shared through the SegmentCache like the program segments (the
+ * writable ones being copied on write). The relocations are done again at each load, writing the same values.
+ *
+ * Only the relocations of the Aarch64 programs linked without copy relocations are handled (see
+ * elf::RelocationType). The libraries must have a symbol hash table (DT_GNU_HASH, or DT_HASH) and no
+ * dependencies of their own.
+ */
+namespace DynamicLoader {
+/** The maximum count of libraries needed by a program. */
+static constexpr size_t MAX_LIBRARIES = 4;
+/** The maximum count of loadable segments of a program or library. */
+static constexpr size_t MAX_SEGMENTS = 8;
+/** The directory of the shared libraries. */
+static constexpr const char* LIBRARY_DIRECTORY = "/lib/";
+static constexpr size_t MAX_PATH_LENGTH = 64;
+
+/** A program or library loaded in memory, its segments being addressed by their link address. */
+struct Object {
+  struct Segment {
+    uint64_t va_start;  // page aligned link address
+    size_t byte_size;
+    uint8_t* data;  // in the kernel address space
+  };  // struct Segment
+
+  /** Added to the link addresses: 0 for the programs. */
+  VirtualAddress base = 0;
+
+  Segment segments[MAX_SEGMENTS];
+  size_t segment_count = 0;
+
+  /** The link address and byte size of the dynamic table (PT_DYNAMIC), 0 if the object is linked statically. */
+  uint64_t dynamic_addr = 0;
+  uint64_t dynamic_size = 0;
+
+  // Filled by parse(), from the dynamic table.
+  uint64_t string_table = 0;
+  uint64_t string_table_size = 0;
+  uint64_t symbol_table = 0;
+  uint64_t hash_table = 0;
+  uint64_t gnu_hash_table = 0;
+  // The count of symbols of the symbol table, known from the hash table (0 without any).
+  uint64_t symbol_count = 0;
+  uint64_t rela = 0;
+  uint64_t rela_size = 0;
+  uint64_t plt_rela = 0;
+  uint64_t plt_rela_size = 0;
+  uint64_t needed[MAX_LIBRARIES];  // string table offsets of the needed libraries names
+  size_t needed_count = 0;
+
+  /** Returns the kernel address of the @a byte_size bytes at the link address @a addr, or nullptr if they are
+   * not all in the loaded segments. */
+  [[nodiscard]] void* translate(uint64_t addr, size_t byte_size) const;
+  /** Returns the count of bytes of the loaded segment from the link address @a addr to its end, 0 if it is not
+   * in the loaded segments. */
+  [[nodiscard]] size_t get_byte_size_after(uint64_t addr) const;
+};  // struct Object
+
+/** Reads the dynamic table of @a object. Returns false if it is malformed or not supported. */
+[[nodiscard]] bool parse(Object& object);
+
+/** Writes the path of the @a index-th library needed by @a object into @a path (MAX_PATH_LENGTH bytes). */
+[[nodiscard]] bool get_library_path(const Object& object, size_t index, char* path);
+
+/**
+ * Returns the base address of the library at @a path (the address range of its segments is reserved for it
+ * in all processes), or 0 if there is no more room. The same library always gets the same address, unless
+ * it grew.
+ */
+[[nodiscard]] VirtualAddress get_library_base(const char* path,
+                                              const elf::Header* header,
+                                              const void* program_headers);
+
+/**
+ * Applies the relocations of @a object. Its imported symbols are searched in the @a library_count
+ * @a libraries, in order. Returns false if a relocation is not supported or a symbol is not found.
+ */
+[[nodiscard]] bool relocate(const Object& object, const Object* libraries, size_t library_count);
+}  // namespace DynamicLoader
@@ -0,0 +1,85 @@
+#include "futex.hpp"
+#include "task.hpp"
+#include "wait_list.hpp"
+
+#include <libk/linked_list.hpp>
+
+namespace Futex {
+struct FutexQueue {
+  FutexQueue(const ProcessMemory* memory, const uint32_t* address) : memory(memory), address(address) {}
+
+  const ProcessMemory* memory;
+  const uint32_t* address;
+  WaitList waiters;
+};  // struct FutexQueue
+
+// Only futexes with blocked tasks have a queue here. There are usually very few of them.
+static libk::LinkedList<FutexQueue> g_queues;
+
+/** Erases the queues whose waiters have all been terminated (e.g. killed) while blocked, and never awaken. */
+static void remove_terminated_waiters() {
+  auto it = g_queues.begin();
+  while (it != g_queues.end()) {
+    auto next = it;
+    ++next;
+    it->waiters.remove_terminated();
+    if (it->waiters.is_empty())
+      g_queues.erase(it);
+    it = next;
+  }
+}
+
+static auto find_queue(const ProcessMemory* memory, const uint32_t* address) {
+  auto it = g_queues.begin();
+  for (; it != g_queues.end(); ++it) {
+    if (it->memory == memory && it->address == address)
+      break;
+  }
+
+  return it;
+}
+
+bool wait(const libk::IntrusivePtr<Task>& task, const uint32_t* address, uint32_t expected_value) {
+  KASSERT(task != nullptr);
+
+  // The value may be changed concurrently by a thread of the same process running on another core.
+  if (__atomic_load_n(address, __ATOMIC_SEQ_CST) != expected_value)
+    return false;
+
+  remove_terminated_waiters();
+
+  // Kernel tasks have no process memory and all share the kernel address space.
+  const ProcessMemory* memory = task->get_memory().get();
+  auto it = find_queue(memory, address);
+  if (it == g_queues.end()) {
+    g_queues.emplace_back(memory, address);
+    it = find_queue(memory, address);
+  }
+
+  it->waiters.add(task);
+  return true;
+}
+
+size_t wake(const ProcessMemory* memory, const uint32_t* address, size_t count) {
+  auto it = find_queue(memory, address);
+  if (it == g_queues.end())
+    return 0;
+
+  const size_t awaken_count = it->waiters.wake(count);
+  if (it->waiters.is_empty())
+    g_queues.erase(it);
+
+  return awaken_count;
+}
+
+void drop(const ProcessMemory* memory) {
+  auto it = g_queues.begin();
+  while (it != g_queues.end()) {
+    auto next = it;
+    ++next;
+    if (it->memory == memory)
+      g_queues.erase(it);
+    it = next;
+  }
+}
+}  // namespace Futex
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/memory.hpp>
+
+class Task;
+class ProcessMemory;
+
+/**
+ * Fast userspace mutexes: the userspace does its locking with atomic operations on
+ * a 32-bit word, and only calls the kernel (SYS_FUTEX_WAIT and SYS_FUTEX_WAKE) to
+ * block when the lock is contended and to wake the blocked tasks.
+ *
+ * A futex is identified by its address in the memory of the calling task, therefore
+ * only tasks sharing the same ProcessMemory can use the same futex.
+ */
+namespace Futex {
+/**
+ * Blocks @a task on the futex at @a address if it still contains @a expected_value.
+ * Returns false, without blocking, if the value has changed meanwhile.
+ *
+ * The task is awaken by a later call to wake() and returns normally from the system call.
+ * The caller must then check again the futex value.
+ */
+bool wait(const libk::IntrusivePtr<Task>& task, const uint32_t* address, uint32_t expected_value);
+
+/** Wakes at most @a count tasks blocked on the futex at @a address of @a memory. Returns the awaken count. */
+size_t wake(const ProcessMemory* memory, const uint32_t* address, size_t count);
+
+/** Forgets all the futexes of @a memory, freed: a new ProcessMemory may be allocated at the same address. */
+void drop(const ProcessMemory* memory);
+};  // namespace Futex
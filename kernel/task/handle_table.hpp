@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <libk/assert.hpp>
+
+/** A handle to a kernel object of a task, as seen by the userspace (see HandleTable). */
+using Handle = uint64_t;
+
+/** Never returned by HandleTable::insert(), so the userspace can keep using 0 (NULL) as an invalid handle. */
+static constexpr Handle INVALID_HANDLE = 0;
+
+/**
+ * Maps small integer handles to the kernel objects owned by a task (a slot map).
+ *
+ * The objects are stored in a dense array of slots, and a handle encodes the index of its slot (plus one, in
+ * the low 32 bits) and the generation of the slot (in the high 32 bits). The generation of a slot is
+ * incremented each time it is freed, so a stale handle is rejected even once its slot is reused. Validating a
+ * handle coming from the userspace is then one bounds check and one generation compare, instead of looking
+ * up a kernel pointer in a set.
+ */
+template <class T>
+class HandleTable {
+  struct Slot {
+    T* object = nullptr;  // nullptr if the slot is free
+    uint32_t generation = 0;
+    uint32_t next_free = NO_FREE_SLOT;
+  };  // struct Slot
+
+  static constexpr uint32_t NO_FREE_SLOT = UINT32_MAX;
+
+ public:
+  /** The capacity allocated for the first inserted object. */
+  static constexpr uint32_t MIN_CAPACITY = 8;
+
+  HandleTable() = default;
+  ~HandleTable() { delete[] m_slots; }
+
+  // No copy
+  HandleTable(const HandleTable&) = delete;
+  HandleTable& operator=(const HandleTable&) = delete;
+
+  [[nodiscard]] bool is_empty() const { return m_size == 0; }
+  [[nodiscard]] size_t get_size() const { return m_size; }
+
+  /** Returns the object of @a handle, or nullptr if @a handle is not valid (or was removed). */
+  [[nodiscard]] T* get(Handle handle) const {
+    // The invalid handle underflows to NO_FREE_SLOT, which is out of bounds.
+    const uint32_t index = (uint32_t)handle - 1;
+    if (index >= m_capacity)
+      return nullptr;
+
+    const Slot& slot = m_slots[index];
+    if (slot.generation != (uint32_t)(handle >> 32))
+      return nullptr;
+
+    return slot.object;
+  }
+
+  /** Adds @a object to the table and returns its handle, or INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle insert(T* object) {
+    KASSERT(object != nullptr);
+
+    if (m_free_index == NO_FREE_SLOT && !grow())
+      return INVALID_HANDLE;
+
+    const uint32_t index = m_free_index;
+    Slot& slot = m_slots[index];
+    m_free_index = slot.next_free;
+    slot.object = object;
+    ++m_size;
+    return ((Handle)slot.generation << 32) | (index + 1);
+  }
+
+  /** Removes the object of @a handle and returns it, or nullptr if @a handle is not valid. */
+  T* remove(Handle handle) {
+    T* object = get(handle);
+    if (object == nullptr)
+      return nullptr;
+
+    const uint32_t index = (uint32_t)handle - 1;
+    Slot& slot = m_slots[index];
+    slot.object = nullptr;
+    ++slot.generation;
+    slot.next_free = m_free_index;
+    m_free_index = index;
+    --m_size;
+    return object;
+  }
+
+  /** Calls @a callback(handle, object) for each object in the table. The callback may remove its object. */
+  template <class Function>
+  void for_each(Function callback) {
+    for (uint32_t i = 0; i < m_capacity; ++i) {
+      if (m_slots[i].object != nullptr)
+        callback(((Handle)m_slots[i].generation << 32) | (i + 1), m_slots[i].object);
+    }
+  }
+
+  /** Removes all the objects, their handles become invalid (the memory is kept). */
+  void clear() {
+    for_each([this](Handle handle, T*) { remove(handle); });
+  }
+
+ private:
+  bool grow() {
+    const uint32_t old_capacity = m_capacity;
+    if (old_capacity >= NO_FREE_SLOT / 2)
+      return false;
+
+    const uint32_t new_capacity = old_capacity == 0 ? MIN_CAPACITY : old_capacity * 2;
+    Slot* new_slots = new Slot[new_capacity];
+    if (new_slots == nullptr)
+      return false;
+
+    for (uint32_t i = 0; i < old_capacity; ++i)
+      new_slots[i] = m_slots[i];
+
+    // Chain the new slots in the free list, lowest index first.
+    for (uint32_t i = old_capacity; i < new_capacity; ++i)
+      new_slots[i].next_free = (i + 1 < new_capacity) ? i + 1 : m_free_index;
+    m_free_index = old_capacity;
+
+    delete[] m_slots;
+    m_slots = new_slots;
+    m_capacity = new_capacity;
+    return true;
+  }
+
+  Slot* m_slots = nullptr;
+  uint32_t m_capacity = 0;
+  uint32_t m_free_index = NO_FREE_SLOT;  // head of the free slots list
+  size_t m_size = 0;
+};  // class HandleTable
@@ -0,0 +1,196 @@
+#include "io_ring.hpp"
+#include "fs/filesystem.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "memory/user_access.hpp"
+#include "task/futex.hpp"
+#include "task/task.hpp"
+#include "task/task_manager.hpp"
+
+#include <sys/syscall.h>
+
+#include <libk/utils.hpp>
+
+IoRing::IoRing(Task* process, sys_io_ring_t* ring)
+    : m_process(process), m_memory(process->get_memory().get()), m_ring(ring) {}
+
+IoRing* IoRing::create(Task* process, sys_io_ring_t* ring) {
+  KASSERT(process != nullptr && process->get_memory());
+
+  auto* io_ring = new IoRing(process, ring);
+  if (io_ring == nullptr)
+    return nullptr;
+
+  auto worker = TaskManager::get().create_kernel_task(worker_main, io_ring);
+  if (worker == nullptr) {
+    delete io_ring;
+    return nullptr;
+  }
+
+  // The worker runs in the process address space, to access the ring and the buffers.
+  worker->get_saved_state().memory = process->get_memory();
+  worker->set_name("io_worker");
+  TaskManager::get().wake_task(worker);
+  return io_ring;
+}
+
+void IoRing::notify() {
+  __atomic_store_n(&m_wake_sequence, m_wake_sequence + 1, __ATOMIC_SEQ_CST);
+  Futex::wake(m_memory, &m_wake_sequence, 1);
+}
+
+bool IoRing::block_task_until_completions(const libk::IntrusivePtr<Task>& task, uint32_t count) {
+  const uint32_t completion_count = m_completion_tail - __atomic_load_n(&m_ring->completion_head, __ATOMIC_ACQUIRE);
+  const bool has_submissions = __atomic_load_n(&m_ring->submission_tail, __ATOMIC_ACQUIRE) != m_submission_head;
+  if (completion_count >= count || !has_submissions)
+    return false;
+
+  m_completion_wait_list.add(task);
+  return true;
+}
+
+void IoRing::close() {
+  m_process = nullptr;
+  m_is_closed = true;
+  m_completion_wait_list.wake_all();
+  notify();
+}
+
+void IoRing::worker_main(void* arg) {
+  auto* io_ring = (IoRing*)arg;
+  while (true) {
+    // Read before executing the submissions, so a notify() meanwhile is not missed by the futex wait.
+    uint32_t wake_sequence;
+    bool is_closed;
+
+    // The ring is shared with the system calls of the process run by the other cores.
+    {
+      KernelTaskLockGuard kernel_lock;
+      wake_sequence = io_ring->m_wake_sequence;
+      is_closed = io_ring->m_is_closed;
+      if (is_closed)
+        delete io_ring;
+      else
+        io_ring->execute_submissions();
+    }
+
+    // Returning terminates the task (see TaskManager::create_kernel_task()).
+    if (is_closed)
+      return;
+
+    sys_futex_wait(&io_ring->m_wake_sequence, wake_sequence);
+  }
+}
+
+void IoRing::execute_submissions() {
+  const uint32_t submission_tail = __atomic_load_n(&m_ring->submission_tail, __ATOMIC_ACQUIRE);
+  bool has_completed = false;
+  while (m_submission_head != submission_tail) {
+    // Stop when the completion ring is full, the process notifies us again once it made room.
+    const uint32_t completion_head = __atomic_load_n(&m_ring->completion_head, __ATOMIC_ACQUIRE);
+    if (m_completion_tail - completion_head >= SYS_IO_RING_SIZE)
+      break;
+
+    // Copy the submission, the process may reuse its entry as soon as the head is advanced.
+    const sys_io_submission_t submission = m_ring->submissions[m_submission_head % SYS_IO_RING_SIZE];
+    __atomic_store_n(&m_ring->submission_head, ++m_submission_head, __ATOMIC_RELEASE);
+
+    sys_io_completion_t completion;
+    completion.user_data = submission.user_data;
+    completion.value = 0;
+    completion.error = execute(submission, completion.value);
+    m_ring->completions[m_completion_tail % SYS_IO_RING_SIZE] = completion;
+    __atomic_store_n(&m_ring->completion_tail, ++m_completion_tail, __ATOMIC_RELEASE);
+    has_completed = true;
+  }
+
+  if (has_completed)
+    m_completion_wait_list.wake_all();
+}
+
+sys_error_t IoRing::execute(const sys_io_submission_t& submission, sys_word_t& value) {
+  auto& fs = FileSystem::get();
+  const auto handle = (Handle)submission.handle;
+  auto* file = m_process->get_file(handle);
+  auto* dir = m_process->get_dir(handle);
+
+  // Same checks and results as the synchronous system calls (see pika_syscalls.cpp): the worker runs in the
+  // process address space, the paths are copied and the buffers probed as for the process itself.
+  char path[SYS_MAX_STRING_SIZE];
+  switch (submission.op) {
+    case SYS_IO_OP_OPEN_FILE:
+      if (!strncpy_from_user(path, submission.path, sizeof(path)))
+        return SYS_ERR_INVALID_ADDRESS;
+
+      file = fs.open(path, (sys_file_mode_t)submission.mode);
+      if (file == nullptr)
+        return SYS_ERR_GENERIC;
+
+      value = m_process->register_file(file);
+      if (value == INVALID_HANDLE) {
+        fs.close(file);
+        return SYS_ERR_OUT_OF_MEM;
+      }
+
+      return SYS_ERR_OK;
+    case SYS_IO_OP_CLOSE_FILE:
+      if (file == nullptr)
+        return SYS_ERR_INVALID_FILE;
+
+      fs.close(file);
+      m_process->unregister_file(handle);
+      return SYS_ERR_OK;
+    case SYS_IO_OP_READ_FILE: {
+      if (file == nullptr)
+        return SYS_ERR_INVALID_FILE;
+      if (!probe_user_range(submission.buffer, submission.size, /* needs_write= */ true))
+        return SYS_ERR_INVALID_ADDRESS;
+
+      size_t read_bytes = 0;
+      const bool success = file->read(submission.buffer, submission.size, &read_bytes);
+      value = read_bytes;
+      return success ? SYS_ERR_OK : SYS_ERR_GENERIC;
+    }
+    case SYS_IO_OP_SEEK_FILE:
+      if (file == nullptr)
+        return SYS_ERR_INVALID_FILE;
+
+      return file->seek(libk::min<size_t>(submission.size, file->get_size())) ? SYS_ERR_OK : SYS_ERR_GENERIC;
+    case SYS_IO_OP_GET_FILE_SIZE:
+      if (file == nullptr)
+        return SYS_ERR_INVALID_FILE;
+
+      value = file->get_size();
+      return SYS_ERR_OK;
+    case SYS_IO_OP_OPEN_DIR:
+      if (!strncpy_from_user(path, submission.path, sizeof(path)))
+        return SYS_ERR_INVALID_ADDRESS;
+
+      dir = fs.open_dir(path);
+      if (dir == nullptr)
+        return SYS_ERR_GENERIC;
+
+      value = m_process->register_dir(dir);
+      if (value == INVALID_HANDLE) {
+        fs.close_dir(dir);
+        return SYS_ERR_OUT_OF_MEM;
+      }
+
+      return SYS_ERR_OK;
+    case SYS_IO_OP_CLOSE_DIR:
+      if (dir == nullptr)
+        return SYS_ERR_INVALID_DIR;
+
+      fs.close_dir(dir);
+      m_process->unregister_dir(handle);
+      return SYS_ERR_OK;
+    case SYS_IO_OP_READ_DIR:
+      if (dir == nullptr)
+        return SYS_ERR_INVALID_DIR;
+      if (!probe_user_range(submission.buffer, sizeof(sys_file_info_t), /* needs_write= */ true))
+        return SYS_ERR_INVALID_ADDRESS;
+
+      return dir->read((sys_file_info_t*)submission.buffer) ? SYS_ERR_OK : SYS_ERR_GENERIC;
+    default:
+      return SYS_ERR_INVALID_IO_OP;
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <sys/file.h>
+#include <cstdint>
+#include "task/wait_list.hpp"
+
+class Task;
+class ProcessMemory;
+
+/**
+ * The asynchronous file I/O of a process: the kernel side of a sys_io_ring_t (see sys/file.h).
+ *
+ * The submissions are executed by a kernel worker, a kernel task mapping the process memory so it
+ * accesses the ring, the paths and the buffers directly. The worker sleeps on a futex of its own
+ * until notify() is called. The tasks waiting for completions are blocked in a WaitList.
+ *
+ * The ring indices written by the kernel are kept here, those read from the process memory are
+ * only trusted to be in the ring.
+ *
+ * All the methods must be called with the kernel lock held.
+ */
+class IoRing {
+ public:
+  /** Starts the worker of @a ring for @a process. Returns nullptr if out of memory. */
+  [[nodiscard]] static IoRing* create(Task* process, sys_io_ring_t* ring);
+
+  [[nodiscard]] sys_io_ring_t* get_ring() const { return m_ring; }
+
+  /** Wakes the worker so it executes the new submissions. */
+  void notify();
+  /**
+   * Blocks @a task until at least @a count completions are queued, unless all the submissions are
+   * already completed. Returns true if the task was blocked (see sync.hpp).
+   */
+  bool block_task_until_completions(const libk::IntrusivePtr<Task>& task, uint32_t count);
+  /** Detaches the ring from its process, which is terminated. The worker then exits and deletes it. */
+  void close();
+
+ private:
+  IoRing(Task* process, sys_io_ring_t* ring);
+
+  static void worker_main(void* arg);
+  void execute_submissions();
+  [[nodiscard]] sys_error_t execute(const sys_io_submission_t& submission, sys_word_t& value);
+
+ private:
+  Task* m_process;
+  // Kept alive by the worker, which maps it.
+  const ProcessMemory* m_memory;
+  sys_io_ring_t* m_ring;
+  uint32_t m_submission_head = 0;
+  uint32_t m_completion_tail = 0;
+  // The futex of the worker, incremented by each notify().
+  uint32_t m_wake_sequence = 0;
+  bool m_is_closed = false;
+  WaitList m_completion_wait_list;
+};  // class IoRing
@@ -1,13 +1,32 @@
 #include "pika_syscalls.hpp"
 
 #include <sys/file.h>
+#include <sys/net.h>
 #include <sys/syscall.h>
 #include <sys/window.h>
 
 #include <libk/assert.hpp>
 #include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include <type_traits>
 
+#include "coverage.hpp"
 #include "fs/filesystem.hpp"
+#include "fs/page_cache.hpp"
+#include "graphics/thumbnail_cache.hpp"
+#include "hardware/ethernet.hpp"
+#include "hardware/irq_save.hpp"
+#include "hardware/timer.hpp"
+#include "input/keyboard_input.hpp"
+#include "kexec.hpp"
+#include "latency_tracer.hpp"
+#include "memory/alloc_profiler.hpp"
+#include "memory/user_access.hpp"
+#include "net/net.hpp"
+#include "net/udp_socket.hpp"
+#include "task/futex.hpp"
+#include "task/io_ring.hpp"
 #include "task/task.hpp"
 #include "task/task_manager.hpp"
 #include "wm/window.hpp"
@@ -26,8 +45,50 @@ static void step_back_one_inst(Registers& regs) {
     regs.elr -= 2;  // 16-bits instruction
 }
 
-static bool check_ptr(Registers& regs, void* ptr, bool needs_write = false) {
-  // FIXME: check if pointer is accessible by current task
+/**
+ * A preemption point of the long system calls. They run with the IRQs masked and the kernel lock held, so they
+ * delay the tick, the wakeups and the other cores. If an IRQ is pending, the system call is interrupted: the
+ * SVC instruction is executed again once the IRQ was handled (and maybe the task preempted meanwhile), and the
+ * system call then resumes at @a progress, given back by Task::take_syscall_progress().
+ * Returns true if the system call was interrupted, it must then return at once.
+ */
+static bool preempt_syscall_if_needed(Registers& regs, uint64_t progress) {
+  if (!IRQSave::is_irq_pending())
+    return false;
+
+  Task::current()->set_syscall_progress(progress);
+  step_back_one_inst(regs);
+  return true;
+}
+
+/** Checks that the @a byte_size bytes at @a ptr are accessible by the current process (writable if
+ * @a needs_write), so the kernel can access them directly. Sets SYS_ERR_INVALID_ADDRESS otherwise. */
+static bool check_range(Registers& regs, const void* ptr, size_t byte_size, bool needs_write = false) {
+  if (!probe_user_range(ptr, byte_size, needs_write)) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return false;
+  }
+
+  return true;
+}
+
+/** Same as check_range(), for the object at @a ptr. The strings are copied instead, see copy_string(). */
+template <class T>
+static bool check_ptr(Registers& regs, T* ptr, bool needs_write = false) {
+  static_assert(!std::is_void_v<T>, "the byte size of the object is unknown");
+  return check_range(regs, ptr, sizeof(T), needs_write);
+}
+
+/** Copies the string argument at @a user_str into @a str (NUL included): the kernel never reads the strings in
+ * the process memory, as they can not be validated first. Sets SYS_ERR_INVALID_ADDRESS if it is not all
+ * readable or does not fit. */
+template <size_t N>
+static bool copy_string(Registers& regs, char (&str)[N], const char* user_str) {
+  if (!strncpy_from_user(str, user_str, N)) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return false;
+  }
+
   return true;
 }
 
@@ -59,20 +120,129 @@ static void pika_sys_yield(Registers& regs) {
 }
 
 static void pika_sys_print(Registers& regs) {
-  const auto* msg = (const char*)regs.gp_regs.x0;
-  if (!check_ptr(regs, (void*)msg))
+  char msg[SYS_MAX_TEXT_SIZE];
+  if (!copy_string(regs, msg, (const char*)regs.gp_regs.x0))
     return;
 
   libk::print("sys_print() from pid={}: {}", Task::current()->get_id(), msg);
   set_error(regs, SYS_ERR_OK);
 }
 
+static void pika_sys_debug(Registers& regs) {
+  switch (regs.gp_regs.x1) {
+    case SYS_DEBUG_PRINT:
+      libk::print("Debug: {} from pid={}", regs.gp_regs.x0, Task::current()->get_id());
+      set_error(regs, SYS_ERR_OK);
+      return;
+#ifdef CONFIG_ALLOC_PROFILER
+    case SYS_DEBUG_DUMP_ALLOC_SITES:
+      AllocProfiler::dump(regs.gp_regs.x0);
+      set_error(regs, SYS_ERR_OK);
+      return;
+#endif  // CONFIG_ALLOC_PROFILER
+#ifdef CONFIG_COVERAGE
+    case SYS_DEBUG_DUMP_COVERAGE:
+      Coverage::dump(regs.gp_regs.x0 != 0);
+      set_error(regs, SYS_ERR_OK);
+      return;
+#endif  // CONFIG_COVERAGE
+    default:
+      set_error(regs, SYS_ERR_GENERIC);
+      return;
+  }
+}
+
 static void pika_sys_getpid(Registers& regs) {
-  auto task = Task::current();
-  const sys_pid_t pid = Task::current()->get_id();
+  const sys_pid_t pid = TaskManager::get().get_current_task_ptr()->get_id();
   regs.gp_regs.x0 = pid;
 }
 
+static void pika_sys_get_stats(Registers& regs) {
+  const auto id = (uint32_t)regs.gp_regs.x0;
+  const bool global = regs.gp_regs.x1 != 0;
+  auto* stats = (sys_syscall_stats_t*)regs.gp_regs.x2;
+  if (!check_ptr(regs, stats, /* needs_write= */ true))
+    return;
+
+  const SyscallStats* source = global ? &SyscallStats::get_global()
+                                      : TaskManager::get().get_current_task_ptr()->get_syscall_stats();
+  if (source == nullptr) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  if (!source->get(id, *stats)) {
+    set_error(regs, SYS_ERR_UNKNOWN_SYSCALL);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_get_input_latency_stats(Registers& regs) {
+  auto* stats = (sys_syscall_stats_t*)regs.gp_regs.x0;
+  if (!check_ptr(regs, stats, /* needs_write= */ true))
+    return;
+
+  KeyboardSystem::get_latency_stats(*stats);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_get_latency_stats(Registers& regs) {
+  const auto kind = (LatencyTracer::Kind)regs.gp_regs.x0;
+  auto* stats = (sys_syscall_stats_t*)regs.gp_regs.x1;
+  auto* max_site = (uint64_t*)regs.gp_regs.x2;
+  if (!check_ptr(regs, stats, /* needs_write= */ true) || !check_ptr(regs, max_site, /* needs_write= */ true))
+    return;
+
+  if (!LatencyTracer::get_stats(kind, *stats, *max_site)) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_task_stats(Registers& regs) {
+  auto* stats = (sys_task_stats_t*)regs.gp_regs.x0;
+  const size_t max_count = regs.gp_regs.x1;
+  auto* count = (size_t*)regs.gp_regs.x2;
+  if (!check_ptr(regs, stats, /* needs_write= */ true) || !check_ptr(regs, count, /* needs_write= */ true))
+    return;
+
+  const uint64_t tick_frequency = GenericTimer::get_frequency();
+  size_t task_count = 0;
+  TaskManager::get().for_each_task([&](const Task* task) {
+    if (task->is_terminated())
+      return;
+
+    if (task_count < max_count) {
+      const TaskCpuStats& cpu_stats = task->get_cpu_stats();
+      const auto memory = task->get_memory();
+
+      sys_task_stats_t& task_stats = stats[task_count];
+      task_stats.pid = task->get_id();
+      task_stats.parent_pid = task->has_parent() ? task->get_parent()->get_id() : 0;
+      task_stats.priority = task->get_priority();
+      task_stats.state = (uint32_t)task->get_state();
+      task_stats.is_kernel = task->is_kernel();
+      task_stats.is_thread = task->is_thread();
+      task_stats.user_ticks = cpu_stats.user_ticks;
+      task_stats.system_ticks = cpu_stats.system_ticks;
+      task_stats.tick_frequency = tick_frequency;
+      task_stats.voluntary_switches = cpu_stats.voluntary_switches;
+      task_stats.involuntary_switches = cpu_stats.involuntary_switches;
+      task_stats.page_faults = cpu_stats.page_faults;
+      task_stats.resident_byte_size = memory != nullptr ? memory->get_resident_byte_size() : 0;
+    }
+
+    ++task_count;
+  });
+
+  *count = task_count;
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_sbrk(Registers& regs) {
   const ptrdiff_t increment = regs.gp_regs.x0;
   auto task = Task::current();
@@ -83,20 +253,226 @@ static void pika_sys_sbrk(Registers& regs) {
   regs.gp_regs.x0 = previous_brk;
 }
 
+static void pika_sys_mmap(Registers& regs) {
+  const size_t length = regs.gp_regs.x0;
+  auto** address = (void**)regs.gp_regs.x1;
+  if (!check_ptr(regs, address, true))
+    return;
+
+  const VirtualAddress start = Task::current()->get_memory()->map_anonymous(length);
+  if (start == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *address = (void*)start;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static Task* get_process(Task* task) {
+  // The threads share the resources of their process main task.
+  return task->is_thread() ? task->get_parent() : task;
+}
+
+static void pika_sys_munmap(Registers& regs) {
+  const VirtualAddress address = regs.gp_regs.x0;
+  const size_t length = regs.gp_regs.x1;
+
+  auto memory = Task::current()->get_memory();
+  if (memory->unmap_anonymous(address, length)) {
+    set_error(regs, SYS_ERR_OK);
+    return;
+  }
+
+  // A file mapping is always unmapped as a whole.
+  auto* chunk = memory->unmap_file(address);
+  if (chunk == nullptr) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return;
+  }
+
+  get_process(Task::current().get())->remove_mapped_chunk(chunk);
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_spawn(Registers& regs) {
-  const auto* path = (const char*)regs.gp_regs.x0;
-  if (!check_ptr(regs, (void*)path))
+  char path[SYS_MAX_STRING_SIZE];
+  const auto group_id = (TaskGroup::id_t)regs.gp_regs.x1;
+  if (!copy_string(regs, path, (const char*)regs.gp_regs.x0))
     return;
 
+  // Without group, the new process stays in the group of the caller (see TaskManager::create_task()).
+  TaskGroup* group = nullptr;
+  if (group_id != TaskGroup::INVALID_ID) {
+    group = TaskManager::get().find_task_group(group_id);
+    if (group == nullptr) {
+      set_error(regs, SYS_ERR_INVALID_TASK_GROUP);
+      return;
+    }
+  }
+
   auto task = TaskManager::get().create_task(path, Task::current().get());
   if (task == nullptr) {
     set_error(regs, SYS_ERR_GENERIC);
   } else {
+    if (group != nullptr)
+      TaskManager::get().set_task_group(task, group);
     TaskManager::get().wake_task(task);
     set_error(regs, SYS_ERR_OK);
   }
 }
 
+static void pika_sys_zygote_start(Registers& regs) {
+  char path[SYS_MAX_STRING_SIZE];
+  if (!copy_string(regs, path, (const char*)regs.gp_regs.x0))
+    return;
+
+  auto task = TaskManager::get().start_zygote(path, Task::current().get());
+  if (task == nullptr) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  TaskManager::get().wake_task(task);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_zygote_ready(Registers& regs) {
+  // The copies of the zygote resume with the result of this call.
+  set_error(regs, SYS_ERR_OK);
+  (void)TaskManager::get().make_zygote_ready(Task::current(), regs);
+}
+
+static void pika_sys_spawn_from_zygote(Registers& regs) {
+  char path[SYS_MAX_STRING_SIZE];
+  if (!copy_string(regs, path, (const char*)regs.gp_regs.x0))
+    return;
+
+  auto task = TaskManager::get().spawn_from_zygote(path, Task::current().get());
+  if (task == nullptr) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  TaskManager::get().wake_task(task);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_task_group_create(Registers& regs) {
+  const uint64_t quota = regs.gp_regs.x0;
+  const uint64_t period = regs.gp_regs.x1;
+  auto* group_id = (sys_task_group_t*)regs.gp_regs.x2;
+  if (!check_ptr(regs, group_id, /* needs_write= */ true))
+    return;
+
+  TaskGroup* group = TaskManager::get().create_task_group(quota, period);
+  if (group == nullptr) {
+    set_error(regs, SYS_ERR_INVALID_TASK_GROUP);
+    return;
+  }
+
+  *group_id = group->id;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_task_group_destroy(Registers& regs) {
+  TaskGroup* group = TaskManager::get().find_task_group(regs.gp_regs.x0);
+  if (group == nullptr) {
+    set_error(regs, SYS_ERR_INVALID_TASK_GROUP);
+    return;
+  }
+
+  if (!TaskManager::get().destroy_task_group(group)) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_fork(Registers& regs) {
+  // Only the main task of a user process can be forked, the other threads would be lost.
+  auto current_task = Task::current();
+  if (!current_task->get_memory() || current_task->is_thread()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  auto child = TaskManager::get().fork_task(current_task.get(), regs);
+  if (child == nullptr) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  // The child process ID is returned in x1, see sys_fork() in libsyscall.
+  TaskManager::get().wake_task(child);
+  regs.gp_regs.x1 = child->get_id();
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_thread_create(Registers& regs) {
+  auto* tid = (sys_pid_t*)regs.gp_regs.x3;
+  if (!check_ptr(regs, tid, true))
+    return;
+
+  // Kernel tasks have no process memory to share.
+  auto current_task = Task::current();
+  if (!current_task->get_memory()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  const auto entry = regs.gp_regs.x0;
+  auto thread = TaskManager::get().create_thread(current_task.get(), entry, regs.gp_regs.x1);
+  if (thread == nullptr) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  // The thread entry point takes a second argument, see sys_thread_create() in libsyscall.
+  thread->get_saved_state().gp_regs.x1 = regs.gp_regs.x2;
+
+  *tid = thread->get_id();
+  TaskManager::get().wake_task(thread);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_thread_join(Registers& regs) {
+  const sys_pid_t tid = regs.gp_regs.x0;
+  auto* exit_code = (int*)regs.gp_regs.x1;
+  if (exit_code != nullptr && !check_ptr(regs, exit_code, true))
+    return;
+
+  // Threads are all children of the process main task.
+  auto current_task = Task::current();
+  const Task* process = current_task->is_thread() ? current_task->get_parent() : current_task.get();
+
+  TaskPtr thread;
+  for (auto it = process->children_begin(); it != process->children_end(); ++it) {
+    if ((*it)->is_thread() && (*it)->get_id() == tid) {
+      thread = *it;
+      break;
+    }
+  }
+
+  if (thread == nullptr || thread == current_task) {
+    set_error(regs, SYS_ERR_INVALID_THREAD);
+    return;
+  }
+
+  if (thread->get_exit_completion().wait_or_block(current_task)) {
+    // Task was blocked, the thread is still running.
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  if (exit_code != nullptr)
+    *exit_code = thread->get_exit_code();
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_sched_set_priority(Registers& regs) {
   //  const sys_pid_t pid = regs.gp_regs.x0;  // Unused
   const uint32_t priority = regs.gp_regs.x1;
@@ -113,7 +489,7 @@ static void pika_sys_sched_set_priority(Registers& regs) {
 static void pika_sys_sched_get_priority(Registers& regs) {
   //  const sys_pid_t pid = regs.gp_regs.x0;  // Unused
   uint32_t* priority = (uint32_t*)regs.gp_regs.x1;
-  if (!check_ptr(regs, (void*)priority, /* needs_write= */ true))
+  if (!check_ptr(regs, priority, /* needs_write= */ true))
     return;
 
   // TODO: use pid to set priority of another process
@@ -121,49 +497,93 @@ static void pika_sys_sched_get_priority(Registers& regs) {
   set_error(regs, SYS_ERR_OK);
 }
 
-static bool check_file(Registers& regs, File* file) {
-  if (Task::current()->own_file(file))
-    return true;
+/** Gets the task @a pid (the current one if 0), or sets the error and returns nullptr if it is neither the current
+ * task nor a thread of its process. */
+static TaskPtr check_sched_task(Registers& regs, sys_pid_t pid) {
+  TaskPtr task = pid == 0 ? Task::current() : TaskManager::get().find_task(pid);
+  if (task == nullptr || get_process(task.get()) != get_process(Task::current().get())) {
+    set_error(regs, SYS_ERR_INVALID_THREAD);
+    return nullptr;
+  }
+
+  return task;
+}
+
+static void pika_sys_sched_set_affinity(Registers& regs) {
+  const sys_pid_t pid = regs.gp_regs.x0;
+  const uint32_t core_mask = regs.gp_regs.x1;
+  TaskPtr task = check_sched_task(regs, pid);
+  if (task == nullptr)
+    return;
 
-  set_error(regs, SYS_ERR_INVALID_FILE);
-  return false;
+  if (!TaskManager::get().set_task_affinity(task, core_mask)) {
+    set_error(regs, SYS_ERR_INVALID_AFFINITY);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_sched_get_affinity(Registers& regs) {
+  const sys_pid_t pid = regs.gp_regs.x0;
+  auto* core_mask = (uint32_t*)regs.gp_regs.x1;
+  if (!check_ptr(regs, core_mask, /* needs_write= */ true))
+    return;
+
+  TaskPtr task = check_sched_task(regs, pid);
+  if (task == nullptr)
+    return;
+
+  *core_mask = task->get_affinity();
+  set_error(regs, SYS_ERR_OK);
+}
+
+/** Gets the file of @a handle, or sets the error and returns nullptr if it is not one of the current task. */
+static File* check_file(Registers& regs, Handle handle) {
+  File* file = Task::current()->get_file(handle);
+  if (file == nullptr)
+    set_error(regs, SYS_ERR_INVALID_FILE);
+  return file;
 }
 
 static void pika_sys_open_file(Registers& regs) {
-  const char* path = (const char*)regs.gp_regs.x0;
-  if (!check_ptr(regs, (void*)path))
+  char path[SYS_MAX_STRING_SIZE];
+  if (!copy_string(regs, path, (const char*)regs.gp_regs.x0))
     return;
 
   const sys_file_mode_t mode = (sys_file_mode_t)regs.gp_regs.x1;
   auto* file = FileSystem::get().open(path, mode);
-  regs.gp_regs.x0 = (sys_word_t)file;
+  regs.gp_regs.x0 = INVALID_HANDLE;
   if (file == nullptr)
     return;
 
-  Task::current()->register_file(file);
+  regs.gp_regs.x0 = Task::current()->register_file(file);
+  if (regs.gp_regs.x0 == INVALID_HANDLE)
+    FileSystem::get().close(file);
 }
 
 static void pika_sys_close_file(Registers& regs) {
-  File* file = (File*)regs.gp_regs.x0;
-  if (!check_file(regs, file))
+  const Handle handle = regs.gp_regs.x0;
+  auto* file = check_file(regs, handle);
+  if (file == nullptr)
     return;
 
   FileSystem::get().close(file);
-  Task::current()->unregister_file(file);
+  Task::current()->unregister_file(handle);
   set_error(regs, SYS_ERR_OK);
 }
 
 static void pika_sys_read_file(Registers& regs) {
-  File* file = (File*)regs.gp_regs.x0;
-  if (!check_file(regs, file))
+  auto* file = check_file(regs, regs.gp_regs.x0);
+  if (file == nullptr)
     return;
 
   void* buffer = (void*)regs.gp_regs.x1;
   size_t* read_bytes = (size_t*)regs.gp_regs.x3;
-  if (!check_ptr(regs, buffer) || !check_ptr(regs, read_bytes))
+  size_t bytes_to_read = regs.gp_regs.x2;
+  if (!check_range(regs, buffer, bytes_to_read, true) || !check_ptr(regs, read_bytes, true))
     return;
 
-  size_t bytes_to_read = regs.gp_regs.x2;
   bool success = file->read(buffer, bytes_to_read, read_bytes);
   if (success)
     set_error(regs, SYS_ERR_OK);
@@ -171,52 +591,171 @@ static void pika_sys_read_file(Registers& regs) {
     set_error(regs, SYS_ERR_GENERIC);
 }
 
+static void pika_sys_write_file(Registers& regs) {
+  auto* file = check_file(regs, regs.gp_regs.x0);
+  if (file == nullptr)
+    return;
+
+  const void* buffer = (const void*)regs.gp_regs.x1;
+  size_t* wrote_bytes = (size_t*)regs.gp_regs.x3;
+  size_t bytes_to_write = regs.gp_regs.x2;
+  if (!check_range(regs, buffer, bytes_to_write, false) || !check_ptr(regs, wrote_bytes, true))
+    return;
+
+  if (file->write(buffer, bytes_to_write, wrote_bytes))
+    set_error(regs, SYS_ERR_OK);
+  else
+    set_error(regs, SYS_ERR_GENERIC);
+}
+
+static void pika_sys_truncate_file(Registers& regs) {
+  auto* file = check_file(regs, regs.gp_regs.x0);
+  if (file == nullptr)
+    return;
+
+  if (file->truncate())
+    set_error(regs, SYS_ERR_OK);
+  else
+    set_error(regs, SYS_ERR_GENERIC);
+}
+
+static void pika_sys_sync(Registers& regs) {
+  if (FileSystem::get().sync())
+    set_error(regs, SYS_ERR_OK);
+  else
+    set_error(regs, SYS_ERR_GENERIC);
+}
+
 static void pika_sys_get_file_size(Registers& regs) {
-  File* file = (File*)regs.gp_regs.x0;
-  if (!check_file(regs, file))
+  auto* file = check_file(regs, regs.gp_regs.x0);
+  if (file == nullptr)
     return;
 
   regs.gp_regs.x0 = file->get_size();
 }
 
-static bool check_dir(Registers& regs, Dir* dir) {
-  if (Task::current()->own_dir(dir))
-    return true;
+static void pika_sys_mmap_file(Registers& regs) {
+  auto* file = check_file(regs, regs.gp_regs.x0);
+  if (file == nullptr)
+    return;
+
+  auto** address = (const void**)regs.gp_regs.x1;
+  if (!check_ptr(regs, address, true))
+    return;
+
+  auto chunk = PageCache::get(file);
+  if (!chunk) {
+    set_error(regs, file->get_size() == 0 ? SYS_ERR_GENERIC : SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  const VirtualAddress start = Task::current()->get_memory()->map_file(*chunk);
+  if (start == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
 
-  set_error(regs, SYS_ERR_INVALID_DIR);
-  return false;
+  get_process(Task::current().get())->add_mapped_chunk(chunk);
+  *address = (const void*)start;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_get_thumbnail(Registers& regs) {
+  char path[SYS_MAX_STRING_SIZE];
+  auto* result = (sys_thumbnail_t*)regs.gp_regs.x3;
+  if (!copy_string(regs, path, (const char*)regs.gp_regs.x0) || !check_ptr(regs, result, true))
+    return;
+
+  graphics::ThumbnailCache::Thumbnail thumbnail;
+  if (!graphics::ThumbnailCache::get(path, regs.gp_regs.x1, regs.gp_regs.x2, thumbnail)) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  const VirtualAddress start = Task::current()->get_memory()->map_file(*thumbnail.chunk);
+  if (start == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  get_process(Task::current().get())->add_mapped_chunk(thumbnail.chunk);
+  result->pixels = (const uint32_t*)start;
+  result->width = thumbnail.width;
+  result->height = thumbnail.height;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_kexec(Registers& regs) {
+  char kernel_path[SYS_MAX_STRING_SIZE];
+  char ramdisk_path[SYS_MAX_STRING_SIZE];
+  const auto* user_ramdisk_path = (const char*)regs.gp_regs.x1;
+  if (!copy_string(regs, kernel_path, (const char*)regs.gp_regs.x0) ||
+      (user_ramdisk_path != nullptr && !copy_string(regs, ramdisk_path, user_ramdisk_path)))
+    return;
+
+  // The written files are lost otherwise.
+  if (!FileSystem::get().sync() ||
+      !Kexec::load(kernel_path, user_ramdisk_path != nullptr ? ramdisk_path : nullptr)) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  Kexec::restart();
+}
+
+static void pika_sys_seek_file(Registers& regs) {
+  auto* file = check_file(regs, regs.gp_regs.x0);
+  if (file == nullptr)
+    return;
+
+  const size_t offset = regs.gp_regs.x1;
+  if (file->seek(libk::min<size_t>(offset, file->get_size())))
+    set_error(regs, SYS_ERR_OK);
+  else
+    set_error(regs, SYS_ERR_GENERIC);
+}
+
+/** Gets the dir of @a handle, or sets the error and returns nullptr if it is not one of the current task. */
+static Dir* check_dir(Registers& regs, Handle handle) {
+  Dir* dir = Task::current()->get_dir(handle);
+  if (dir == nullptr)
+    set_error(regs, SYS_ERR_INVALID_DIR);
+  return dir;
 }
 
 static void pika_sys_open_dir(Registers& regs) {
-  const char* path = (const char*)regs.gp_regs.x0;
-  if (!check_ptr(regs, (void*)path))
+  char path[SYS_MAX_STRING_SIZE];
+  if (!copy_string(regs, path, (const char*)regs.gp_regs.x0))
     return;
 
   auto* dir = FileSystem::get().open_dir(path);
-  regs.gp_regs.x0 = (sys_word_t)dir;
+  regs.gp_regs.x0 = INVALID_HANDLE;
   if (dir == nullptr)
     return;
 
-  Task::current()->register_dir(dir);
+  regs.gp_regs.x0 = Task::current()->register_dir(dir);
+  if (regs.gp_regs.x0 == INVALID_HANDLE)
+    FileSystem::get().close_dir(dir);
 }
 
 static void pika_sys_close_dir(Registers& regs) {
-  Dir* dir = (Dir*)regs.gp_regs.x0;
-  if (!check_dir(regs, dir))
+  const Handle handle = regs.gp_regs.x0;
+  auto* dir = check_dir(regs, handle);
+  if (dir == nullptr)
     return;
 
   FileSystem::get().close_dir(dir);
-  Task::current()->unregister_dir(dir);
+  Task::current()->unregister_dir(handle);
   set_error(regs, SYS_ERR_OK);
 }
 
 static void pika_sys_read_dir(Registers& regs) {
-  Dir* dir = (Dir*)regs.gp_regs.x0;
-  if (!check_dir(regs, dir))
+  auto* dir = check_dir(regs, regs.gp_regs.x0);
+  if (dir == nullptr)
     return;
 
   sys_file_info_t* file_info = (sys_file_info_t*)regs.gp_regs.x1;
-  if (!check_dir(regs, dir))
+  if (dir == nullptr)
     return;
 
   if (dir->read(file_info))
@@ -225,78 +764,416 @@ static void pika_sys_read_dir(Registers& regs) {
     set_error(regs, SYS_ERR_GENERIC);
 }
 
-static bool check_window(Registers& regs, Window* window) {
-  if (Task::current()->own_window(window))
+static void pika_sys_read_dir_many(Registers& regs) {
+  auto* dir = check_dir(regs, regs.gp_regs.x0);
+  if (dir == nullptr)
+    return;
+
+  void* buffer = (void*)regs.gp_regs.x1;
+  const size_t buffer_size = regs.gp_regs.x2;
+  size_t* read_size = (size_t*)regs.gp_regs.x4;
+  if (!check_range(regs, buffer, buffer_size, true) || !check_ptr(regs, read_size, true))
+    return;
+
+  // The entry fields are accessed as naturally aligned words.
+  if ((uintptr_t)buffer % SYS_DIR_ENTRY_ALIGNMENT != 0) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return;
+  }
+
+  const bool names_only = (regs.gp_regs.x3 & SYS_DIR_NAMES_ONLY) != 0;
+  if (dir->read_many(buffer, buffer_size, names_only, read_size))
+    set_error(regs, SYS_ERR_OK);
+  else
+    set_error(regs, SYS_ERR_GENERIC);
+}
+
+static void pika_sys_io_setup(Registers& regs) {
+  auto* ring = (sys_io_ring_t*)regs.gp_regs.x0;
+  if (!check_ptr(regs, ring, true))
+    return;
+
+  // Kernel tasks have no process memory to share with a worker.
+  auto* process = get_process(Task::current().get());
+  if (!process->get_memory() || process->get_io_ring() != nullptr) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  auto* io_ring = IoRing::create(process, ring);
+  if (io_ring == nullptr) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  process->set_io_ring(io_ring);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_io_enter(Registers& regs) {
+  auto* ring = (sys_io_ring_t*)regs.gp_regs.x0;
+  auto* io_ring = get_process(Task::current().get())->get_io_ring();
+  if (io_ring == nullptr || io_ring->get_ring() != ring) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return;
+  }
+
+  io_ring->notify();
+
+  const auto min_completions = libk::min<uint32_t>(regs.gp_regs.x1, SYS_IO_RING_SIZE);
+  if (io_ring->block_task_until_completions(Task::current(), min_completions)) {
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+/** Registers the new channel @a endpoint (if not nullptr) into the current process and returns its handle and
+ * the address of its rings, as for sys_channel_create(). */
+static void register_channel_endpoint(Registers& regs, Task* process, Channel::Endpoint* endpoint) {
+  auto* handle = (Handle*)regs.gp_regs.x1;
+  auto* address = (void**)regs.gp_regs.x2;
+  if (endpoint == nullptr) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  const Handle new_handle = process->register_channel(endpoint);
+  if (new_handle == INVALID_HANDLE) {
+    Channel::close(*endpoint);
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *handle = new_handle;
+  *address = (void*)endpoint->address;
+  set_error(regs, SYS_ERR_OK);
+}
+
+/** Checks the arguments of sys_channel_create() and sys_channel_connect(), and copies the channel name. */
+static bool check_channel_args(Registers& regs, Task* process, char (&name)[SYS_MAX_STRING_SIZE]) {
+  if (!copy_string(regs, name, (const char*)regs.gp_regs.x0) || !check_ptr(regs, (Handle*)regs.gp_regs.x1, true) ||
+      !check_ptr(regs, (void**)regs.gp_regs.x2, true))
+    return false;
+
+  // Kernel tasks have no process memory to share.
+  if (!process->get_memory()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return false;
+  }
+
+  return true;
+}
+
+static void pika_sys_channel_create(Registers& regs) {
+  auto* process = get_process(Task::current().get());
+  char name[SYS_MAX_STRING_SIZE];
+  if (check_channel_args(regs, process, name))
+    register_channel_endpoint(regs, process, Channel::create(name, process));
+}
+
+static void pika_sys_channel_connect(Registers& regs) {
+  auto* process = get_process(Task::current().get());
+  char name[SYS_MAX_STRING_SIZE];
+  if (check_channel_args(regs, process, name))
+    register_channel_endpoint(regs, process, Channel::connect(name, process));
+}
+
+/** Gets the channel endpoint of @a handle, or sets the error and returns nullptr if it is not one of the
+ * current process. */
+static Channel::Endpoint* check_channel(Registers& regs, Handle handle) {
+  Channel::Endpoint* endpoint = get_process(Task::current().get())->get_channel(handle);
+  if (endpoint == nullptr)
+    set_error(regs, SYS_ERR_INVALID_CHANNEL);
+  return endpoint;
+}
+
+static void pika_sys_channel_close(Registers& regs) {
+  const Handle handle = regs.gp_regs.x0;
+  auto* endpoint = check_channel(regs, handle);
+  if (endpoint == nullptr)
+    return;
+
+  get_process(Task::current().get())->unregister_channel(handle);
+  Channel::close(*endpoint);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_channel_wait(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint == nullptr)
+    return;
+
+  const bool for_send = regs.gp_regs.x1 != 0;
+  if (Channel::block_task_until_ready(*endpoint, Task::current(), for_send)) {
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  set_error(regs, Channel::is_ready(*endpoint, for_send) ? SYS_ERR_OK : SYS_ERR_CHANNEL_CLOSED);
+}
+
+static void pika_sys_channel_notify(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint == nullptr)
+    return;
+
+  Channel::notify(*endpoint);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_channel_call(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint != nullptr)
+    Channel::call(*endpoint, Task::current(), regs.gp_regs);
+}
+
+static void pika_sys_channel_reply_wait(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint != nullptr)
+    Channel::reply_wait(*endpoint, Task::current(), regs.gp_regs);
+}
+
+static void pika_sys_channel_grant_alloc(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint == nullptr)
+    return;
+
+  const size_t byte_size = regs.gp_regs.x1;
+  auto* address = (void**)regs.gp_regs.x2;
+  auto* grant = (sys_word_t*)regs.gp_regs.x3;
+  if (!check_ptr(regs, address, true) || !check_ptr(regs, grant, true))
+    return;
+
+  VirtualAddress start;
+  const uint64_t id = Channel::allocate_grant(*endpoint, byte_size, &start);
+  if (id == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *address = (void*)start;
+  *grant = id;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_channel_grant_accept(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint == nullptr)
+    return;
+
+  const uint64_t grant = regs.gp_regs.x1;
+  auto* address = (void**)regs.gp_regs.x2;
+  auto* byte_size = (size_t*)regs.gp_regs.x3;
+  if (!check_ptr(regs, address, true) || !check_ptr(regs, byte_size, true))
+    return;
+
+  VirtualAddress start;
+  if (!Channel::accept_grant(*endpoint, grant, &start, byte_size)) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return;
+  }
+
+  *address = (void*)start;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_channel_grant_release(Registers& regs) {
+  auto* endpoint = check_channel(regs, regs.gp_regs.x0);
+  if (endpoint == nullptr)
+    return;
+
+  const VirtualAddress address = regs.gp_regs.x1;
+  set_error(regs, Channel::release_grant(*endpoint, address) ? SYS_ERR_OK : SYS_ERR_INVALID_ADDRESS);
+}
+
+/** Gets the window of @a handle, or sets the error and returns nullptr if it is not one of the current task. */
+static Window* check_window(Registers& regs, Handle handle) {
+  Window* window = Task::current()->get_window(handle);
+  if (window == nullptr)
+    set_error(regs, SYS_ERR_INVALID_WINDOW);
+  return window;
+}
+
+/** Dequeues a message of @a queue into the process memory at @a msg, and sets the error of the system call.
+ * Returns false (without setting the error) if the queue is empty. */
+static bool deliver_message(Registers& regs, MessageQueue& queue, sys_message_t* msg) {
+  sys_message_t message;
+  if (!queue.dequeue(message))
+    return false;
+
+  if (!copy_to_user(msg, &message, sizeof(message))) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
     return true;
+  }
 
-  set_error(regs, SYS_ERR_INVALID_WINDOW);
-  return false;
+  KeyboardSystem::record_delivery(message);
+  set_error(regs, SYS_ERR_OK);
+  return true;
 }
 
 static void pika_sys_poll_msg(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   auto* msg = (sys_message_t*)regs.gp_regs.x1;
-  if (!check_ptr(regs, msg, true))
+  if (!deliver_message(regs, window->get_message_queue(), msg))
+    set_error(regs, SYS_ERR_MSG_QUEUE_EMPTY);
+}
+
+static void pika_sys_poll_msgs(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
-  MessageQueue& queue = window->get_message_queue();
+  auto* msgs = (sys_message_t*)regs.gp_regs.x1;
+  auto* count = (size_t*)regs.gp_regs.x3;
+  const size_t max_count = regs.gp_regs.x2;
+  if (max_count > SIZE_MAX / sizeof(sys_message_t) ||
+      !check_range(regs, msgs, max_count * sizeof(sys_message_t), true) || !check_ptr(regs, count, true))
+    return;
+
+  *count = window->get_message_queue().dequeue_many(msgs, max_count);
+  for (size_t i = 0; i < *count; ++i)
+    KeyboardSystem::record_delivery(msgs[i]);
 
-  if (queue.dequeue(*msg))
+  if (*count > 0)
     set_error(regs, SYS_ERR_OK);
   else
     set_error(regs, SYS_ERR_MSG_QUEUE_EMPTY);
 }
 
+/** The continuation of pika_sys_wait_msg(), see Task::Continuation. The registers are the ones of the
+ * system call, with the SVC instruction to be executed again. */
+static bool resume_wait_msg(Registers& regs, void* window) {
+  auto* msg = (sys_message_t*)regs.gp_regs.x1;
+  if (!deliver_message(regs, ((Window*)window)->get_message_queue(), msg))
+    return false;
+
+  // Skips the SVC instruction (always 32-bit in AArch64), the system call is done.
+  regs.elr += 4;
+  return true;
+}
+
 static void pika_sys_wait_msg(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   auto* msg = (sys_message_t*)regs.gp_regs.x1;
-  if (!check_ptr(regs, msg, true))
+  if (!is_user_range(msg, sizeof(*msg))) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
     return;
+  }
 
   auto current_task = Task::current();
   MessageQueue& queue = window->get_message_queue();
 
   if (queue.block_task_until_not_empty(current_task)) {
-    // Task was blocked, the message queue is currently empty.
-    // Step back at the SVC instruction, so the next time this task
-    // is preempted, the system call is resubmitted.
+    // Task was blocked, the message queue is currently empty. The message is delivered by
+    // resume_wait_msg() once awaken, the SVC instruction is only executed again if another thread
+    // of the process took it meanwhile.
     step_back_one_inst(regs);
+    current_task->set_continuation(&resume_wait_msg, window);
+    return;
+  }
+
+  if (!deliver_message(regs, queue, msg))
+    set_error(regs, SYS_ERR_INTERNAL);
+}
+
+/** Checks the futex word at @a address, probed for writes if @a needs_write (it is then written by the kernel). */
+static bool check_futex(Registers& regs, uint32_t* address, bool needs_write = false) {
+  // Futex words must be naturally aligned to be accessed atomically.
+  if (address == nullptr || ((uintptr_t)address % alignof(uint32_t)) != 0) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return false;
+  }
+
+  return check_ptr(regs, address, needs_write);
+}
+
+static void pika_sys_futex_wait(Registers& regs) {
+  auto* address = (uint32_t*)regs.gp_regs.x0;
+  if (!check_futex(regs, address))
+    return;
+
+  const auto expected_value = (uint32_t)regs.gp_regs.x1;
+
+  // Unlike the other blocking system calls, the futex wait is not resubmitted when
+  // the task is awaken: the userspace checks again the futex value by itself.
+  set_error(regs, SYS_ERR_OK);
+  if (!Futex::wait(Task::current(), address, expected_value))
+    set_error(regs, SYS_ERR_FUTEX_VALUE_CHANGED);
+}
+
+static void pika_sys_futex_wake(Registers& regs) {
+  auto* address = (uint32_t*)regs.gp_regs.x0;
+  if (!check_futex(regs, address)) {
+    regs.gp_regs.x0 = 0;
+    return;
+  }
+
+  const auto count = (uint32_t)regs.gp_regs.x1;
+  regs.gp_regs.x0 = Futex::wake(Task::current()->get_memory().get(), address, count);
+}
+
+// The mutex word of sys_mutex_lock() is 0 if unlocked, 1 if locked. Once the process has threads, it is only
+// written here, under the kernel lock: there is no exclusive access in the userspace.
+static void pika_sys_mutex_lock(Registers& regs) {
+  auto* address = (uint32_t*)regs.gp_regs.x0;
+  if (!check_futex(regs, address, true))
+    return;
+
+  const uint32_t value = __atomic_load_n(address, __ATOMIC_ACQUIRE);
+  if (value == 0) {
+    __atomic_store_n(address, 1, __ATOMIC_RELAXED);
+    set_error(regs, SYS_ERR_OK);
     return;
   }
 
-  if (queue.dequeue(*msg))
-    set_error(regs, SYS_ERR_OK);
-  else
-    set_error(regs, SYS_ERR_INTERNAL);
+  // Resubmitted once awaken by the unlock, as another thread may have taken the mutex meanwhile.
+  step_back_one_inst(regs);
+  Futex::wait(Task::current(), address, value);
+}
+
+static void pika_sys_mutex_unlock(Registers& regs) {
+  auto* address = (uint32_t*)regs.gp_regs.x0;
+  if (!check_futex(regs, address, true))
+    return;
+
+  __atomic_store_n(address, 0, __ATOMIC_RELEASE);
+  Futex::wake(Task::current()->get_memory().get(), address, 1);
+  set_error(regs, SYS_ERR_OK);
 }
 
 static void pika_sys_window_create(Registers& regs) {
   const auto flags = regs.gp_regs.x0;
   auto* window = WindowManager::get().create_window(Task::current(), flags);
-  regs.gp_regs.x0 = (sys_word_t)window;
+  regs.gp_regs.x0 = window != nullptr ? window->get_handle() : INVALID_HANDLE;
 }
 
 static void pika_sys_window_destroy(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   set_error(regs, SYS_ERR_OK);
 }
 
 static void pika_sys_window_set_title(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
-  const char* title = (const char*)regs.gp_regs.x1;
-  if (!check_ptr(regs, (void*)title))
+  char title[SYS_MAX_STRING_SIZE];
+  if (!copy_string(regs, title, (const char*)regs.gp_regs.x1))
     return;
 
   window->set_title(title);
@@ -304,8 +1181,8 @@ static void pika_sys_window_set_title(Registers& regs) {
 }
 
 static void pika_sys_window_get_visibility(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   bool* is_visible = (bool*)regs.gp_regs.x1;
@@ -320,8 +1197,8 @@ static void pika_sys_window_get_visibility(Registers& regs) {
 }
 
 static void pika_sys_window_set_visibility(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   const bool is_visible = regs.gp_regs.x1;
@@ -330,8 +1207,8 @@ static void pika_sys_window_set_visibility(Registers& regs) {
 }
 
 static void pika_sys_window_get_geometry(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   int32_t* x = (int32_t*)regs.gp_regs.x1;
@@ -373,8 +1250,8 @@ static void pika_sys_window_get_geometry(Registers& regs) {
 }
 
 static void pika_sys_window_set_geometry(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   const int32_t x = (int32_t)regs.gp_regs.x1;
@@ -387,17 +1264,125 @@ static void pika_sys_window_set_geometry(Registers& regs) {
 }
 
 static void pika_sys_window_present(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   WindowManager::get().present_window(window);
   set_error(regs, SYS_ERR_OK);
 }
 
+static void pika_sys_window_get_surface(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  uint32_t** pixels = (uint32_t**)regs.gp_regs.x1;
+  uint32_t* pitch = (uint32_t*)regs.gp_regs.x2;
+  if (!check_ptr(regs, pixels, true) || !check_ptr(regs, pitch, true))
+    return;
+
+  const VirtualAddress address = window->map_surface();
+  if (address == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *pixels = (uint32_t*)address;
+  *pitch = window->get_framebuffer_pitch();
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_window_request_frame(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  WindowManager::get().request_window_frame(window);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_window_set_buffer_count(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  const uint64_t count = regs.gp_regs.x1;
+  if (count == 0 || count > Window::MAX_BUFFERS) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  if (!WindowManager::get().set_window_buffer_count(window, count)) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_window_swap_buffers(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  uint32_t** pixels = (uint32_t**)regs.gp_regs.x1;
+  uint32_t* age = (uint32_t*)regs.gp_regs.x2;
+  if (!check_ptr(regs, pixels, true) || (age != nullptr && !check_ptr(regs, age, true)))
+    return;
+
+  WindowManager::get().swap_window_buffers(window);
+
+  const VirtualAddress address = window->map_surface();
+  if (address == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *pixels = (uint32_t*)address;
+  if (age != nullptr)
+    *age = window->get_back_buffer_age();
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_window_set_surface_size(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  const uint64_t width = regs.gp_regs.x1;
+  const uint64_t height = regs.gp_regs.x2;
+  if ((width == 0) != (height == 0) || width > (uint64_t)Window::MAX_WIDTH || height > (uint64_t)Window::MAX_HEIGHT) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  WindowManager::get().set_window_surface_size(window, width, height);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_window_get_state(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  const auto** state = (const sys_window_state_t**)regs.gp_regs.x1;
+  if (!check_ptr(regs, state, true))
+    return;
+
+  const VirtualAddress address = window->map_state();
+  if (address == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *state = (const sys_window_state_t*)address;
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_gfx_clear(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   const uint32_t argb = regs.gp_regs.x1;
@@ -410,9 +1395,27 @@ static void unpack_couple(uint64_t reg, uint32_t& fst, uint32_t& snd) {
   snd = (reg >> 32) & UINT32_MAX;
 }
 
+static void pika_sys_window_present_rect(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  uint32_t x, y, width, height;
+  unpack_couple(regs.gp_regs.x1, x, y);
+  unpack_couple(regs.gp_regs.x2, width, height);
+
+  // Keep the values in the surface range (so they fit in Rect), the window manager does the exact clipping.
+  width = libk::min<uint32_t>(width, window->get_surface_width());
+  height = libk::min<uint32_t>(height, window->get_surface_height());
+  if (x < window->get_surface_width() && y < window->get_surface_height())
+    WindowManager::get().present_window(window, Rect::from_pos_and_size(x, y, width, height));
+
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_gfx_draw_line(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   uint32_t x0, y0, x1, y1;
@@ -426,8 +1429,8 @@ static void pika_sys_gfx_draw_line(Registers& regs) {
 }
 
 static void pika_sys_gfx_draw_rect(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   uint32_t x, y, width, height;
@@ -441,8 +1444,8 @@ static void pika_sys_gfx_draw_rect(Registers& regs) {
 }
 
 static void pika_sys_gfx_fill_rect(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   uint32_t x, y, width, height;
@@ -456,15 +1459,15 @@ static void pika_sys_gfx_fill_rect(Registers& regs) {
 }
 
 static void pika_sys_gfx_draw_text(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   uint32_t x, y;
   unpack_couple(regs.gp_regs.x1, x, y);
 
-  const char* text = (const char*)regs.gp_regs.x2;
-  if (!check_ptr(regs, (void*)text))
+  char text[SYS_MAX_TEXT_SIZE];
+  if (!copy_string(regs, text, (const char*)regs.gp_regs.x2))
     return;
 
   const uint32_t argb = regs.gp_regs.x3;
@@ -473,9 +1476,25 @@ static void pika_sys_gfx_draw_text(Registers& regs) {
   set_error(regs, SYS_ERR_OK);
 }
 
+static void pika_sys_gfx_measure_text(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  char text[SYS_MAX_TEXT_SIZE];
+  auto* width = (uint32_t*)regs.gp_regs.x2;
+  if (!copy_string(regs, text, (const char*)regs.gp_regs.x1) || !check_ptr(regs, width, /* needs_write= */ true))
+    return;
+
+  *width = window->measure_text(text);
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_gfx_blit(Registers& regs) {
-  auto* window = (Window*)regs.gp_regs.x0;
-  if (!check_window(regs, window))
+  // The rows already blitted, if this system call was interrupted.
+  const uint64_t first_row = Task::current()->take_syscall_progress();
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
     return;
 
   uint32_t x, y;
@@ -483,11 +1502,383 @@ static void pika_sys_gfx_blit(Registers& regs) {
   unpack_couple(regs.gp_regs.x1, x, y);
   unpack_couple(regs.gp_regs.x2, width, height);
 
+  // The window reads the pixels directly, the whole buffer is checked first.
   const uint32_t* argb_buffer = (const uint32_t*)regs.gp_regs.x3;
-  if (!check_ptr(regs, (void*)argb_buffer))
+  if (!check_range(regs, argb_buffer, (size_t)width * height * sizeof(uint32_t)))
+    return;
+
+  // A big image is blitted by bands of rows, with a preemption point between them.
+  static constexpr uint64_t BAND_PIXEL_COUNT = 64 * 1024;
+  const uint64_t band_height = libk::max<uint64_t>(BAND_PIXEL_COUNT / libk::max(width, 1u), 1);
+  for (uint64_t row = first_row; row < height && y + row < window->get_surface_height(); row += band_height) {
+    if (row != first_row && preempt_syscall_if_needed(regs, row))
+      return;
+
+    const auto band = (uint32_t)libk::min<uint64_t>(band_height, height - row);
+    window->blit(x, y + row, width, band, argb_buffer + row * width);
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_gfx_copy_area(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  uint32_t src_x, src_y;
+  uint32_t width, height;
+  uint32_t dst_x, dst_y;
+  unpack_couple(regs.gp_regs.x1, src_x, src_y);
+  unpack_couple(regs.gp_regs.x2, width, height);
+  unpack_couple(regs.gp_regs.x3, dst_x, dst_y);
+
+  window->copy_area(src_x, src_y, width, height, dst_x, dst_y);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static bool check_gfx_command(const sys_gfx_command_t& command, const uint8_t* data, size_t data_size) {
+  switch (command.op) {
+    case SYS_GFX_OP_CLEAR:
+    case SYS_GFX_OP_DRAW_LINE:
+    case SYS_GFX_OP_DRAW_RECT:
+    case SYS_GFX_OP_FILL_RECT:
+    case SYS_GFX_OP_SET_CLIP:
+    case SYS_GFX_OP_RESET_CLIP:
+      return true;
+    case SYS_GFX_OP_DRAW_TEXT:
+      // The text must be NUL terminated inside the data area.
+      return command.data_offset < data_size &&
+             libk::memchr(data + command.data_offset, '\0', data_size - command.data_offset) != nullptr;
+    case SYS_GFX_OP_BLIT: {
+      if (command.data_offset > data_size || command.data_offset % alignof(uint32_t) != 0)
+        return false;
+
+      // The pixels must be inside the data area (the blit itself is clipped to the window).
+      const uint64_t max_pixels = (data_size - command.data_offset) / sizeof(uint32_t);
+      return (uint64_t)command.width * command.height <= max_pixels;
+    }
+    default:
+      return false;
+  }
+}
+
+static void execute_gfx_command(Window* window, const sys_gfx_command_t& command, const uint8_t* data) {
+  switch (command.op) {
+    case SYS_GFX_OP_CLEAR:
+      window->clear(command.argb);
+      break;
+    case SYS_GFX_OP_DRAW_LINE:
+      window->draw_line(command.x, command.y, command.width, command.height, command.argb);
+      break;
+    case SYS_GFX_OP_DRAW_RECT:
+      window->draw_rect(command.x, command.y, command.width, command.height, command.argb);
+      break;
+    case SYS_GFX_OP_FILL_RECT:
+      window->fill_rect(command.x, command.y, command.width, command.height, command.argb);
+      break;
+    case SYS_GFX_OP_DRAW_TEXT:
+      window->draw_text(command.x, command.y, (const char*)(data + command.data_offset), command.argb);
+      break;
+    case SYS_GFX_OP_BLIT:
+      window->blit(command.x, command.y, command.width, command.height,
+                   (const uint32_t*)(data + command.data_offset));
+      break;
+    case SYS_GFX_OP_SET_CLIP:
+      window->set_clipping(command.x, command.y, command.width, command.height);
+      break;
+    case SYS_GFX_OP_RESET_CLIP:
+      window->revert_clipping();
+      break;
+    default:
+      KASSERT(false && "unchecked graphics command");
+  }
+}
+
+static void pika_sys_gfx_submit(Registers& regs) {
+  // The commands already executed, if this system call was interrupted.
+  const uint64_t first_command = Task::current()->take_syscall_progress();
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  if (window == nullptr)
+    return;
+
+  const auto* commands = (const sys_gfx_command_t*)regs.gp_regs.x1;
+  const size_t command_count = regs.gp_regs.x2;
+  if (command_count > SIZE_MAX / sizeof(sys_gfx_command_t) ||
+      !check_range(regs, commands, command_count * sizeof(sys_gfx_command_t))) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return;
+  }
+
+  const auto* data = (const uint8_t*)regs.gp_regs.x3;
+  const size_t data_size = regs.gp_regs.x4;
+  if (!check_range(regs, data, data_size)) {
+    set_error(regs, SYS_ERR_INVALID_ADDRESS);
+    return;
+  }
+
+  // Validate the whole buffer first, so nothing is drawn from an invalid one. It is validated again when
+  // resumed, the process may have changed it meanwhile.
+  for (size_t i = 0; i < command_count; ++i) {
+    if (!check_gfx_command(commands[i], data, data_size)) {
+      if (first_command != 0)
+        window->revert_clipping();
+      set_error(regs, SYS_ERR_INVALID_GFX_COMMAND);
+      return;
+    }
+  }
+
+  // A preemption point between the commands, the clipping set by the previous ones is kept when resumed.
+  for (size_t i = first_command; i < command_count; ++i) {
+    if (i != first_command && preempt_syscall_if_needed(regs, i))
+      return;
+
+    execute_gfx_command(window, commands[i], data);
+  }
+
+  // The clipping is local to the submission.
+  window->revert_clipping();
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_net_get_info(Registers& regs) {
+  auto* info = (sys_net_info_t*)regs.gp_regs.x0;
+  if (!Ethernet::is_initialized()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  if (!check_ptr(regs, info, true))
+    return;
+
+  const Ethernet::Stats& stats = Ethernet::get_stats();
+  Ethernet::get_mac_address(info->mac_address);
+  info->link_speed = Ethernet::get_link_speed();
+  info->rx_frames = stats.nb_rx_frames;
+  info->rx_dropped = stats.nb_rx_errors + stats.nb_rx_dropped;
+  info->tx_frames = stats.nb_tx_frames;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_net_send(Registers& regs) {
+  const auto* data = (const uint8_t*)regs.gp_regs.x0;
+  const size_t byte_size = regs.gp_regs.x1;
+  if (!Ethernet::is_initialized() || byte_size == 0 || byte_size > SYS_NET_MAX_FRAME_SIZE) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  if (!check_range(regs, data, byte_size))
+    return;
+
+  if (Ethernet::block_task_until_tx_slot_free(Task::current())) {
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  Ethernet::Frame frame;
+  if (!Ethernet::allocate_tx_frame(&frame)) {
+    set_error(regs, SYS_ERR_INTERNAL);
+    return;
+  }
+
+  libk::memcpy(frame.data, data, byte_size);
+  Ethernet::send(frame, byte_size);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_net_receive(Registers& regs) {
+  auto* buffer = (uint8_t*)regs.gp_regs.x0;
+  const size_t capacity = regs.gp_regs.x1;
+  auto* received_size = (size_t*)regs.gp_regs.x2;
+  if (!Net::is_initialized()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  if (!check_range(regs, buffer, capacity, true) || !check_ptr(regs, received_size, true))
+    return;
+
+  // The frames are received by the IPv4 stack, which queues the others.
+  if (Net::block_task_until_raw_received(Task::current())) {
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  const auto packet = Net::receive_raw();
+  if (!packet) {
+    set_error(regs, SYS_ERR_INTERNAL);
+    return;
+  }
+
+  const bool fits = packet->get_byte_size() <= capacity;
+  if (fits) {
+    libk::memcpy(buffer, packet->get_data(), packet->get_byte_size());
+    *received_size = packet->get_byte_size();
+  }
+
+  set_error(regs, fits ? SYS_ERR_OK : SYS_ERR_GENERIC);
+}
+
+static void pika_sys_net_get_ipv4_config(Registers& regs) {
+  auto* config = (sys_net_ipv4_config_t*)regs.gp_regs.x0;
+  if (!Net::is_initialized()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  if (!check_ptr(regs, config, true))
+    return;
+
+  const Net::Ipv4Config& ipv4_config = Net::get_ipv4_config();
+  config->address = ipv4_config.address;
+  config->netmask = ipv4_config.netmask;
+  config->gateway = ipv4_config.gateway;
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_net_set_ipv4_config(Registers& regs) {
+  const auto* config = (const sys_net_ipv4_config_t*)regs.gp_regs.x0;
+  if (!Net::is_initialized()) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  if (!check_ptr(regs, config))
+    return;
+
+  Net::set_ipv4_config({config->address, config->netmask, config->gateway});
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_udp_open(Registers& regs) {
+  const auto port = (uint16_t)regs.gp_regs.x0;
+  auto* handle = (Handle*)regs.gp_regs.x1;
+  auto* address = (void**)regs.gp_regs.x2;
+  auto* bound_port = (uint16_t*)regs.gp_regs.x3;
+  auto* process = get_process(Task::current().get());
+  if (!check_ptr(regs, handle, true) || !check_ptr(regs, address, true) || !check_ptr(regs, bound_port, true))
+    return;
+
+  // Kernel tasks have no process memory to share.
+  if (!Net::is_initialized() || !process->get_memory()) {
+    set_error(regs, SYS_ERR_GENERIC);
     return;
+  }
+
+  UdpSocket* socket = UdpSocket::create(port, process);
+  if (socket == nullptr) {
+    set_error(regs, SYS_ERR_GENERIC);
+    return;
+  }
+
+  const Handle new_handle = process->register_udp_socket(socket);
+  if (new_handle == INVALID_HANDLE) {
+    UdpSocket::close(socket);
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *handle = new_handle;
+  *address = (void*)socket->get_address();
+  *bound_port = socket->get_port();
+  set_error(regs, SYS_ERR_OK);
+}
+
+/** Gets the UDP socket of @a handle, or sets the error and returns nullptr if it is not one of the current
+ * process. */
+static UdpSocket* check_udp_socket(Registers& regs, Handle handle) {
+  UdpSocket* socket = get_process(Task::current().get())->get_udp_socket(handle);
+  if (socket == nullptr)
+    set_error(regs, SYS_ERR_INVALID_SOCKET);
+  return socket;
+}
+
+static void pika_sys_udp_close(Registers& regs) {
+  const Handle handle = regs.gp_regs.x0;
+  auto* socket = check_udp_socket(regs, handle);
+  if (socket == nullptr)
+    return;
+
+  get_process(Task::current().get())->unregister_udp_socket(handle);
+  UdpSocket::close(socket);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_udp_flush(Registers& regs) {
+  auto* socket = check_udp_socket(regs, regs.gp_regs.x0);
+  if (socket == nullptr)
+    return;
+
+  if (socket->flush(Task::current())) {
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_udp_wait(Registers& regs) {
+  auto* socket = check_udp_socket(regs, regs.gp_regs.x0);
+  if (socket == nullptr)
+    return;
+
+  if (socket->block_task_until_received(Task::current())) {
+    // Step back at the SVC instruction, so the next time this task
+    // is preempted, the system call is resubmitted.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_timer_create(Registers& regs) {
+  auto* window = check_window(regs, regs.gp_regs.x0);
+  auto* handle = (Handle*)regs.gp_regs.x1;
+  if (window == nullptr || !check_ptr(regs, handle, true))
+    return;
+
+  WindowTimer* timer = window->create_timer();
+  if (timer == nullptr) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *handle = timer->get_handle();
+  set_error(regs, SYS_ERR_OK);
+}
 
-  window->blit(x, y, width, height, argb_buffer);
+/** Gets the window timer of @a handle, or sets the error and returns nullptr if it is not one of the current
+ * task. */
+static WindowTimer* check_window_timer(Registers& regs, Handle handle) {
+  WindowTimer* timer = Task::current()->get_window_timer(handle);
+  if (timer == nullptr)
+    set_error(regs, SYS_ERR_INVALID_TIMER);
+  return timer;
+}
+
+static void pika_sys_timer_arm(Registers& regs) {
+  auto* timer = check_window_timer(regs, regs.gp_regs.x0);
+  if (timer == nullptr)
+    return;
+
+  timer->arm(regs.gp_regs.x1, regs.gp_regs.x2);
+  set_error(regs, SYS_ERR_OK);
+}
+
+static void pika_sys_timer_destroy(Registers& regs) {
+  auto* timer = check_window_timer(regs, regs.gp_regs.x0);
+  if (timer == nullptr)
+    return;
+
+  timer->get_window()->destroy_timer(timer);
   set_error(regs, SYS_ERR_OK);
 }
 
@@ -497,28 +1888,69 @@ SyscallTable* create_pika_syscalls() {
 
   table->set_unknown_callback(pika_sys_unknown);
   table->register_syscall(SYS_EXIT, pika_sys_exit);
-  table->register_syscall(SYS_PRINT, pika_sys_print);
-  table->register_syscall(SYS_GETPID, pika_sys_getpid);
+  table->register_fast_syscall(SYS_PRINT, pika_sys_print);
+  table->register_fast_syscall(SYS_GETPID, pika_sys_getpid);
   table->register_syscall(SYS_SPAWN, pika_sys_spawn);
-  table->register_syscall(SYS_DEBUG, [](Registers& regs) {
-    libk::print("Debug: {} from pid={}", regs.gp_regs.x0, Task::current()->get_id());
-    set_error(regs, SYS_ERR_OK);
-  });
+  table->register_syscall(SYS_FORK, pika_sys_fork);
+  table->register_syscall(SYS_ZYGOTE_START, pika_sys_zygote_start);
+  table->register_syscall(SYS_ZYGOTE_READY, pika_sys_zygote_ready);
+  table->register_syscall(SYS_SPAWN_FROM_ZYGOTE, pika_sys_spawn_from_zygote);
+  table->register_syscall(SYS_THREAD_CREATE, pika_sys_thread_create);
+  table->register_syscall(SYS_THREAD_JOIN, pika_sys_thread_join);
+  table->register_fast_syscall(SYS_DEBUG, pika_sys_debug);
+  table->register_fast_syscall(SYS_GET_STATS, pika_sys_get_stats);
+  table->register_syscall(SYS_TASK_STATS, pika_sys_task_stats);
+  table->register_syscall(SYS_GET_INPUT_LATENCY_STATS, pika_sys_get_input_latency_stats);
+  table->register_syscall(SYS_GET_LATENCY_STATS, pika_sys_get_latency_stats);
 
   // Memory system calls.
   table->register_syscall(SYS_SBRK, pika_sys_sbrk);
+  table->register_syscall(SYS_MMAP, pika_sys_mmap);
+  table->register_syscall(SYS_MUNMAP, pika_sys_munmap);
 
   // Scheduler system calls.
   table->register_syscall(SYS_SLEEP, pika_sys_sleep);
   table->register_syscall(SYS_YIELD, pika_sys_yield);
   table->register_syscall(SYS_SCHED_SET_PRIORITY, pika_sys_sched_set_priority);
-  table->register_syscall(SYS_SCHED_GET_PRIORITY, pika_sys_sched_get_priority);
+  table->register_fast_syscall(SYS_SCHED_GET_PRIORITY, pika_sys_sched_get_priority);
+  table->register_syscall(SYS_SCHED_SET_AFFINITY, pika_sys_sched_set_affinity);
+  table->register_fast_syscall(SYS_SCHED_GET_AFFINITY, pika_sys_sched_get_affinity);
+  table->register_syscall(SYS_TASK_GROUP_CREATE, pika_sys_task_group_create);
+  table->register_syscall(SYS_TASK_GROUP_DESTROY, pika_sys_task_group_destroy);
+
+  // Synchronization system calls.
+  table->register_syscall(SYS_FUTEX_WAIT, pika_sys_futex_wait);
+  table->register_syscall(SYS_FUTEX_WAKE, pika_sys_futex_wake);
 
   // File system calls.
   table->register_syscall(SYS_OPEN_FILE, pika_sys_open_file);
   table->register_syscall(SYS_CLOSE_FILE, pika_sys_close_file);
   table->register_syscall(SYS_READ_FILE, pika_sys_read_file);
   table->register_syscall(SYS_GET_FILE_SIZE, pika_sys_get_file_size);
+  table->register_syscall(SYS_SEEK_FILE, pika_sys_seek_file);
+  table->register_syscall(SYS_WRITE_FILE, pika_sys_write_file);
+  table->register_syscall(SYS_TRUNCATE_FILE, pika_sys_truncate_file);
+  table->register_syscall(SYS_SYNC, pika_sys_sync);
+  table->register_syscall(SYS_IO_SETUP, pika_sys_io_setup);
+  table->register_syscall(SYS_IO_ENTER, pika_sys_io_enter);
+
+  // Inter-process channels system calls.
+  table->register_syscall(SYS_CHANNEL_CREATE, pika_sys_channel_create);
+  table->register_syscall(SYS_CHANNEL_CONNECT, pika_sys_channel_connect);
+  table->register_syscall(SYS_CHANNEL_CLOSE, pika_sys_channel_close);
+  table->register_syscall(SYS_CHANNEL_WAIT, pika_sys_channel_wait);
+  table->register_syscall(SYS_CHANNEL_NOTIFY, pika_sys_channel_notify);
+  table->register_syscall(SYS_CHANNEL_GRANT_ALLOC, pika_sys_channel_grant_alloc);
+  table->register_syscall(SYS_CHANNEL_GRANT_ACCEPT, pika_sys_channel_grant_accept);
+  table->register_syscall(SYS_CHANNEL_GRANT_RELEASE, pika_sys_channel_grant_release);
+  table->register_syscall(SYS_CHANNEL_CALL, pika_sys_channel_call);
+  table->register_syscall(SYS_CHANNEL_REPLY_WAIT, pika_sys_channel_reply_wait);
+  table->register_syscall(SYS_READ_DIR_MANY, pika_sys_read_dir_many);
+  table->register_syscall(SYS_MMAP_FILE, pika_sys_mmap_file);
+  table->register_syscall(SYS_GET_THUMBNAIL, pika_sys_get_thumbnail);
+  table->register_syscall(SYS_KEXEC, pika_sys_kexec);
+  table->register_syscall(SYS_MUTEX_LOCK, pika_sys_mutex_lock);
+  table->register_syscall(SYS_MUTEX_UNLOCK, pika_sys_mutex_unlock);
   table->register_syscall(SYS_OPEN_DIR, pika_sys_open_dir);
   table->register_syscall(SYS_CLOSE_DIR, pika_sys_close_dir);
   table->register_syscall(SYS_READ_DIR, pika_sys_read_dir);
@@ -526,6 +1958,7 @@ SyscallTable* create_pika_syscalls() {
   // Window manager system calls.
   table->register_syscall(SYS_POLL_MESSAGE, pika_sys_poll_msg);
   table->register_syscall(SYS_WAIT_MESSAGE, pika_sys_wait_msg);
+  table->register_syscall(SYS_POLL_MESSAGES, pika_sys_poll_msgs);
   table->register_syscall(SYS_WINDOW_CREATE, pika_sys_window_create);
   table->register_syscall(SYS_WINDOW_DESTROY, pika_sys_window_destroy);
   table->register_syscall(SYS_WINDOW_SET_TITLE, pika_sys_window_set_title);
@@ -536,12 +1969,48 @@ SyscallTable* create_pika_syscalls() {
 
   // Window graphics calls.
   table->register_syscall(SYS_WINDOW_PRESENT, pika_sys_window_present);
+  table->register_syscall(SYS_WINDOW_PRESENT_RECT, pika_sys_window_present_rect);
+  table->register_syscall(SYS_WINDOW_GET_SURFACE, pika_sys_window_get_surface);
+  table->register_syscall(SYS_WINDOW_GET_STATE, pika_sys_window_get_state);
+  table->register_syscall(SYS_WINDOW_SET_SURFACE_SIZE, pika_sys_window_set_surface_size);
+  table->register_syscall(SYS_WINDOW_SET_BUFFER_COUNT, pika_sys_window_set_buffer_count);
+  table->register_syscall(SYS_WINDOW_SWAP_BUFFERS, pika_sys_window_swap_buffers);
+  table->register_syscall(SYS_WINDOW_REQUEST_FRAME, pika_sys_window_request_frame);
   table->register_syscall(SYS_GFX_CLEAR, pika_sys_gfx_clear);
   table->register_syscall(SYS_GFX_DRAW_LINE, pika_sys_gfx_draw_line);
   table->register_syscall(SYS_GFX_DRAW_RECT, pika_sys_gfx_draw_rect);
   table->register_syscall(SYS_GFX_FILL_RECT, pika_sys_gfx_fill_rect);
   table->register_syscall(SYS_GFX_DRAW_TEXT, pika_sys_gfx_draw_text);
+  table->register_syscall(SYS_GFX_MEASURE_TEXT, pika_sys_gfx_measure_text);
   table->register_syscall(SYS_GFX_BLIT, pika_sys_gfx_blit);
+  table->register_syscall(SYS_GFX_COPY_AREA, pika_sys_gfx_copy_area);
+  table->register_syscall(SYS_GFX_SUBMIT, pika_sys_gfx_submit);
+
+  // Raw Ethernet frames system calls.
+  table->register_syscall(SYS_NET_GET_INFO, pika_sys_net_get_info);
+  table->register_syscall(SYS_NET_SEND, pika_sys_net_send);
+  table->register_syscall(SYS_NET_RECEIVE, pika_sys_net_receive);
+  table->register_syscall(SYS_NET_GET_IPV4_CONFIG, pika_sys_net_get_ipv4_config);
+  table->register_syscall(SYS_NET_SET_IPV4_CONFIG, pika_sys_net_set_ipv4_config);
+  table->register_syscall(SYS_UDP_OPEN, pika_sys_udp_open);
+  table->register_syscall(SYS_UDP_CLOSE, pika_sys_udp_close);
+  table->register_syscall(SYS_UDP_FLUSH, pika_sys_udp_flush);
+  table->register_syscall(SYS_UDP_WAIT, pika_sys_udp_wait);
+  table->register_syscall(SYS_TIMER_CREATE, pika_sys_timer_create);
+  table->register_syscall(SYS_TIMER_ARM, pika_sys_timer_arm);
+  table->register_syscall(SYS_TIMER_DESTROY, pika_sys_timer_destroy);
 
   return table;
 }
+
+/*
+ * Benchmarks
+ */
+
+#include <libk/benchmark.hpp>
+
+BENCHMARK("kernel.syscall.getpid") {
+  // A fast system call round-trip, from a kernel task.
+  while (state.keep_running())
+    (void)sys_getpid();
+}
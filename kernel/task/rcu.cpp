@@ -0,0 +1,134 @@
+#include "rcu.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/linked_list.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "hardware/per_core.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+#include "task/work_queue.hpp"
+
+namespace RCU {
+struct CoreState {
+  uint64_t quiescent_count = 0;  // incremented at each quiescent state of the core
+  uint32_t read_depth = 0;       // nesting of the read-side critical sections
+  bool is_idle = true;           // running its idle task (or not started yet)
+};  // struct CoreState
+
+/** The quiescent counts of all the cores, when a grace period started. */
+struct Snapshot {
+  uint64_t quiescent_counts[SMP::MAX_CORES];
+};  // struct Snapshot
+
+struct PendingCallback {
+  Callback callback;
+  void* data;
+  Snapshot snapshot;
+};  // struct PendingCallback
+
+// Each core only writes to its own state, the other cores read it (sequentially consistent accesses).
+static PerCore<CoreState> g_cores;
+
+// Protected by the kernel lock.
+static libk::LinkedList<PendingCallback> g_pending_callbacks;
+static bool g_is_process_queued = false;
+
+static Snapshot take_snapshot() {
+  Snapshot snapshot;
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i)
+    snapshot.quiescent_counts[i] = __atomic_load_n(&g_cores.get(i).quiescent_count, __ATOMIC_SEQ_CST);
+  return snapshot;
+}
+
+static bool is_grace_period_over(const Snapshot& snapshot) {
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    const CoreState& core = g_cores.get(i);
+    if (__atomic_load_n(&core.quiescent_count, __ATOMIC_SEQ_CST) != snapshot.quiescent_counts[i])
+      continue;
+
+    // An idle core is in an extended quiescent state, unless an IRQ handler is reading.
+    if (__atomic_load_n(&core.is_idle, __ATOMIC_SEQ_CST) && __atomic_load_n(&core.read_depth, __ATOMIC_SEQ_CST) == 0)
+      continue;
+
+    return false;
+  }
+
+  return true;
+}
+
+static void note_quiescent_state(CoreState& core) {
+  __atomic_store_n(&core.quiescent_count, core.quiescent_count + 1, __ATOMIC_SEQ_CST);
+}
+
+void read_lock() {
+  // The task must stay on this core until read_unlock().
+  Task* task = TaskManager::get().get_current_task_ptr();
+  if (task != nullptr)
+    task->disable_preempt();
+
+  CoreState& core = g_cores.get();
+  __atomic_store_n(&core.read_depth, core.read_depth + 1, __ATOMIC_SEQ_CST);
+}
+
+void read_unlock() {
+  CoreState& core = g_cores.get();
+  KASSERT(core.read_depth > 0);
+  __atomic_store_n(&core.read_depth, core.read_depth - 1, __ATOMIC_SEQ_CST);
+
+  Task* task = TaskManager::get().get_current_task_ptr();
+  if (task != nullptr)
+    task->enable_preempt();
+}
+
+void synchronize() {
+  KASSERT(!KernelLock::is_owned() && "the other cores could not tick");
+
+  // The ticks of the calling core are quiescent states too, even when there is nothing else to run.
+  const Snapshot snapshot = take_snapshot();
+  while (!is_grace_period_over(snapshot)) {
+    sys_yield();
+  }
+}
+
+void call(Callback callback, void* data) {
+  KASSERT(KernelLock::is_owned());
+  g_pending_callbacks.push_back({callback, data, take_snapshot()});
+}
+
+static void process_callbacks(void*) {
+  g_is_process_queued = false;
+
+  auto it = g_pending_callbacks.begin();
+  while (it != g_pending_callbacks.end()) {
+    auto current = it++;
+    if (!is_grace_period_over(current->snapshot))
+      continue;
+
+    // The callback may call RCU::call() again.
+    const PendingCallback pending = *current;
+    g_pending_callbacks.erase(current);
+    pending.callback(pending.data);
+  }
+}
+
+void note_context_switch(bool to_idle_task) {
+  CoreState& core = g_cores.get();
+  KASSERT(core.read_depth == 0 && "context switch inside an RCU read-side critical section");
+
+  note_quiescent_state(core);
+  __atomic_store_n(&core.is_idle, to_idle_task, __ATOMIC_SEQ_CST);
+}
+
+void note_tick() {
+  CoreState& core = g_cores.get();
+  if (core.read_depth == 0)
+    note_quiescent_state(core);
+
+  // The oldest callbacks are the most likely to be ready, the others are checked once they run.
+  if (g_is_process_queued || g_pending_callbacks.is_empty() ||
+      !is_grace_period_over(g_pending_callbacks.front().snapshot))
+    return;
+
+  g_is_process_queued = TaskManager::get().get_irq_work_queue().queue(process_callbacks, nullptr);
+}
+}  // namespace RCU
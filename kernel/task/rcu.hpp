@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Read-copy-update, for data read far more often than it is modified.
+ *
+ * The readers do not take any lock: they only mark their read-side critical section (which disables
+ * the preemption of the current task). A writer publishes a new version of the data with assign(),
+ * then waits for all the readers that could still see the old version before freeing it, either by
+ * blocking in synchronize() or by deferring the free with call().
+ *
+ * This is a quiescent-state based implementation: a core that context switches, that is idle, or that
+ * ticks outside of a read-side critical section can not hold any reference to the old version anymore.
+ * A grace period ends once every core went through such a quiescent state.
+ */
+namespace RCU {
+using Callback = void (*)(void* data);
+
+/** Starts a read-side critical section. They can be nested, and must not block. */
+void read_lock();
+/** Ends the read-side critical section started by read_lock(). */
+void read_unlock();
+
+/**
+ * Waits for the end of a grace period: all the read-side critical sections started before the call have
+ * ended. Must be called from a task, without holding the kernel lock.
+ */
+void synchronize();
+
+/**
+ * Calls @a callback with @a data once a grace period has ended, from the IRQ work queue (with the kernel
+ * lock held). Can be called from any context, the kernel lock held.
+ */
+void call(Callback callback, void* data);
+
+/** Called by the scheduler on each context switch of the calling core. */
+void note_context_switch(bool to_idle_task);
+/** Called by the scheduler on each tick of the calling core. */
+void note_tick();
+
+/** Publishes @a value into @a pointer, the readers see the pointed data initialized. */
+template <class T>
+static inline void assign(T*& pointer, T* value) {
+  __atomic_store_n(&pointer, value, __ATOMIC_RELEASE);
+}
+
+/** Reads @a pointer published with assign(), inside a read-side critical section. */
+template <class T>
+[[nodiscard]] static inline T* dereference(T* const& pointer) {
+  return __atomic_load_n(&pointer, __ATOMIC_ACQUIRE);
+}
+};  // namespace RCU
+
+/** RAII helper around RCU::read_lock() and RCU::read_unlock(). */
+class RCUReadGuard {
+ public:
+  RCUReadGuard() { RCU::read_lock(); }
+  ~RCUReadGuard() { RCU::read_unlock(); }
+
+  // No copy and move
+  RCUReadGuard(const RCUReadGuard&) = delete;
+  RCUReadGuard(RCUReadGuard&&) = delete;
+  RCUReadGuard& operator=(const RCUReadGuard&) = delete;
+  RCUReadGuard& operator=(RCUReadGuard&&) = delete;
+};  // class RCUReadGuard
@@ -1,7 +1,11 @@
 #include "scheduler.hpp"
 
-#include <algorithm>
 #include <libk/log.hpp>
+#include <libk/utils.hpp>
+#include "hardware/irq/irq_manager.hpp"
+#include "hardware/timer.hpp"
+#include "task/rcu.hpp"
+#include "task/task_manager.hpp"
 
 Scheduler* Scheduler::g_instance = nullptr;
 
@@ -9,13 +13,329 @@ Scheduler::Scheduler() {
   g_instance = this;
 }
 
-void Scheduler::add_task(const TaskPtr& task) {
+void Scheduler::DeadlineQueue::enqueue(Task* task) {
+  Task* position = tasks.back();
+  while (position != nullptr && position->m_deadline > task->m_deadline)
+    position = tasks.previous(position);
+
+  tasks.insert_after(position, task);
+}
+
+void Scheduler::RealTimeQueue::enqueue(Task* task) {
+  const uint32_t priority = task->get_priority();
+  tasks[priority].push_back(task);
+  ready_mask |= (uint32_t)1 << priority;
+}
+
+void Scheduler::RealTimeQueue::remove(Task* task, uint32_t priority) {
+  tasks[priority].remove(task);
+  if (tasks[priority].is_empty())
+    ready_mask &= ~((uint32_t)1 << priority);
+}
+
+void Scheduler::RealTimeQueue::move_to_front(Task* task, uint32_t priority) {
+  tasks[priority].remove(task);
+  tasks[priority].push_front(task);
+}
+
+Task* Scheduler::RealTimeQueue::get_first(uint32_t priority_mask) const {
+  const int priority = get_highest_priority(ready_mask & priority_mask);
+  return priority >= 0 ? tasks[priority].front() : nullptr;
+}
+
+Task* Scheduler::RealTimeQueue::get_last() const {
+  // The tail of the highest priority: these tasks are the ones that would have waited the most there.
+  const int priority = get_highest_priority(ready_mask);
+  return priority >= 0 ? tasks[priority].back() : nullptr;
+}
+
+void Scheduler::FairQueue::enqueue(Task* task) {
+  // Usually the task goes at the end (it just ran), so search from there. Equal tasks are kept in FIFO order.
+  Task* position = tasks.back();
+  while (position != nullptr && position->m_vruntime > task->m_vruntime)
+    position = tasks.previous(position);
+
+  tasks.insert_after(position, task);
+}
+
+void Scheduler::FairQueue::update_min_vruntime(const Task* current_task) {
+  const Task* first_task = get_first();
+  if (current_task == nullptr && first_task == nullptr)
+    return;
+
+  uint64_t vruntime = current_task != nullptr ? current_task->m_vruntime : first_task->m_vruntime;
+  if (first_task != nullptr)
+    vruntime = libk::min(vruntime, first_task->m_vruntime);
+
+  min_vruntime = libk::max(min_vruntime, vruntime);
+}
+
+size_t Scheduler::add_task(const TaskPtr& task) {
   KASSERT(task != nullptr);
   KASSERT(!task->is_running());
 
+  // A task of a throttled group waits for the next period of its group, out of the run queues.
+  if (is_group_throttled(task.get())) {
+    task->m_is_throttled = true;
+    return task->m_core;
+  }
+
+  const size_t core_id = select_core(task.get());
+  enqueue_task(core_id, task);
+  return core_id;
+}
+
+size_t Scheduler::select_core(const Task* task) const {
+  const uint32_t allowed_cores = task->get_affinity() & SMP::get_online_cores_mask();
+  KASSERT(allowed_cores != 0);
+
+  // Keep the task on the core it last ran on, unless another core has nothing to do.
+  // Load balancing moves it elsewhere later if needed.
+  size_t core_id = task->m_core;
+  if ((allowed_cores & ((uint32_t)1 << core_id)) == 0)
+    core_id = __builtin_ctz(allowed_cores);
+
+  if (!is_core_idle(core_id)) {
+    for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+      if ((allowed_cores & ((uint32_t)1 << i)) != 0 && is_core_idle(i) && m_run_queues[i].nb_tasks == 0) {
+        core_id = i;
+        break;
+      }
+    }
+  }
+
+  return core_id;
+}
+
+void Scheduler::set_isolated_cores(uint32_t core_mask) {
+  m_isolated_cores = core_mask & ALL_CORES_MASK & ~((uint32_t)1 << DEFAULT_CORE);
+}
+
+bool Scheduler::set_task_affinity(const TaskPtr& task, uint32_t affinity) {
+  KASSERT(task != nullptr);
+
+  if ((affinity & SMP::get_online_cores_mask()) == 0)
+    return false;
+
+  task->m_affinity = affinity;
+  if (task->is_allowed_on(task->m_core))
+    return true;
+
+  // A running task is moved by its core, which reschedules in the IPI handler (see schedule()). The caller may
+  // be the task itself, outside of any exception if it is a kernel task.
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if (m_run_queues[i].current_task == task) {
+      IRQManager::send_ipi(i);
+      return true;
+    }
+  }
+
+  // An enqueued task is moved right away, a blocked one is enqueued on one of its cores once woken up.
+  if (task->m_run_queue_hook.is_linked()) {
+    remove_from_run_queue(m_run_queues[task->m_core], task.get(), task->get_priority());
+    const size_t core_id = select_core(task.get());
+    enqueue_task(core_id, task);
+    reschedule_if_needed(core_id, task.get());
+  }
+
+  return true;
+}
+
+TaskGroup* Scheduler::create_task_group(uint64_t quota, uint64_t period) {
+  constexpr uint64_t tick = TaskManager::TICK_TIME * 1000;
+  if (quota < tick || period < tick || period > MAX_GROUP_PERIOD)
+    return nullptr;
+
+  for (size_t i = 0; i < MAX_TASK_GROUPS; ++i) {
+    TaskGroup& group = m_task_groups[i];
+    if (group.id != TaskGroup::INVALID_ID)
+      continue;
+
+    group.id = i + 1;
+    group.quota = quota;
+    group.period = period;
+    group.runtime = 0;
+    group.period_end = 0;  // a new period starts when its tasks first run
+    group.throttled_count = 0;
+    group.is_throttled = false;
+    return &group;
+  }
+
+  return nullptr;
+}
+
+bool Scheduler::destroy_task_group(TaskGroup* group) {
+  KASSERT(group != nullptr);
+
+  if (!group->tasks.is_empty())
+    return false;
+
+  (void)group->period_timer.cancel();
+  group->is_throttled = false;
+  group->id = TaskGroup::INVALID_ID;
+  return true;
+}
+
+TaskGroup* Scheduler::find_task_group(TaskGroup::id_t id) {
+  if (id == TaskGroup::INVALID_ID || id > MAX_TASK_GROUPS)
+    return nullptr;
+
+  TaskGroup& group = m_task_groups[id - 1];
+  return group.id == id ? &group : nullptr;
+}
+
+void Scheduler::set_task_group(Task* task, TaskGroup* group) {
+  KASSERT(task != nullptr);
+  KASSERT(!task->m_run_queue_hook.is_linked() && !task->m_is_throttled);
+
+  if (task->m_group != nullptr)
+    task->m_group->tasks.remove(task);
+
+  task->m_group = group;
+  if (group != nullptr)
+    group->tasks.push_back(task);
+}
+
+void Scheduler::charge_task_group(Task* task, uint64_t now) {
+  TaskGroup* group = task->m_group;
+  if (group == nullptr || group->is_throttled)
+    return;
+
+  // The periods start lazily: a group whose tasks did not run for a while starts a new one.
+  if (now >= group->period_end) {
+    group->runtime = 0;
+    group->period_end = now + group->period;
+  }
+
+  group->runtime += TaskManager::TICK_TIME * 1000;
+  if (group->runtime >= group->quota)
+    throttle_task_group(group);
+}
+
+void Scheduler::throttle_task_group(TaskGroup* group) {
+  group->is_throttled = true;
+  group->throttled_count++;
+
+  // The enqueued tasks are parked until the next period (see unthrottle_task_group()), the running ones are
+  // switched out by their core (see must_move_out()), at the end of this tick for the calling core.
+  const size_t core_id = SMP::get_core_id();
+  for (Task* task = group->tasks.front(); task != nullptr; task = group->tasks.next(task)) {
+    if (task->m_run_queue_hook.is_linked()) {
+      remove_from_run_queue(m_run_queues[task->m_core], task, task->get_priority());
+      task->m_is_throttled = true;
+      continue;
+    }
+
+    for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+      if (i != core_id && m_run_queues[i].current_task.get() == task)
+        IRQManager::send_ipi(i);
+    }
+  }
+
+  const uint64_t now = GenericTimer::get_elapsed_time_in_micros();
+  group->period_timer.start_in_us(group->period_end > now ? group->period_end - now : 0);
+}
+
+void Scheduler::unthrottle_task_group(TaskGroup* group) {
+  group->is_throttled = false;
+  group->runtime = 0;
+  group->period_end = GenericTimer::get_elapsed_time_in_micros() + group->period;
+
+  for (Task* task = group->tasks.front(); task != nullptr; task = group->tasks.next(task)) {
+    if (!task->m_is_throttled)
+      continue;
+
+    task->m_is_throttled = false;
+    const size_t core_id = select_core(task);
+    enqueue_task(core_id, TaskPtr(task));
+    reschedule_if_needed(core_id, task);
+  }
+}
+
+void TaskGroup::end_period(void* group) {
+  Scheduler::get().unthrottle_task_group((TaskGroup*)group);
+}
+
+bool Scheduler::must_move_out(const Task* task) const {
+  return task != nullptr && !is_idle_task(task) &&
+         (is_group_throttled(task) || !task->is_allowed_on(SMP::get_core_id()));
+}
+
+bool Scheduler::is_core_idle(size_t core_id) const {
+  const auto& run_queue = m_run_queues[core_id];
+  return run_queue.idle_task != nullptr && run_queue.current_task == run_queue.idle_task;
+}
+
+uint64_t Scheduler::get_idle_ticks(size_t core_id, uint64_t now) const {
+  const Task* idle_task = m_run_queues[core_id].idle_task.get();
+  if (idle_task == nullptr)
+    return 0;
+
+  const TaskCpuStats& cpu_stats = idle_task->get_cpu_stats();
+  uint64_t idle_ticks = cpu_stats.user_ticks + cpu_stats.system_ticks;
+  // An idle core does not tick: the time since it last left the kernel is not charged yet.
+  if (is_core_idle(core_id) && now > idle_task->m_accounting_time)
+    idle_ticks += now - idle_task->m_accounting_time;
+  return idle_ticks;
+}
+
+void Scheduler::reschedule_if_needed(size_t core_id, Task* woken_task) {
+  if (is_core_idle(core_id)) {
+    if (core_id == SMP::get_core_id()) {
+      schedule();
+    } else {
+      IRQManager::send_ipi(core_id);
+    }
+
+    return;
+  }
+
+  if (!must_preempt_on_wakeup(core_id, woken_task))
+    return;
+
+  // A current task that cannot be preempted yet is preempted once it can (see Task::enable_preempt()), the
+  // other cores defer it the same way in the IPI handler.
+  Task* current_task = m_run_queues[core_id].current_task.get();
+  if (core_id == SMP::get_core_id() && !current_task->can_preempt()) {
+    current_task->defer_preemption();
+    return;
+  }
+
+  // The caller may be a task outside of any exception (a kernel task), where the current task can not be
+  // switched: the core interrupts itself and reschedules in the IPI handler.
+  IRQManager::send_ipi(core_id);
+}
+
+bool Scheduler::must_preempt_on_wakeup(size_t core_id, Task* task) {
+  auto& run_queue = m_run_queues[core_id];
+  const Task* current_task = run_queue.current_task.get();
+  if (current_task == nullptr || !task->m_run_queue_hook.is_linked())
+    return false;
+
+  if (is_deadline_active(task) || is_deadline_active(current_task))
+    return must_preempt_for_deadline(core_id);
+
   const uint32_t priority = task->get_priority();
-  KASSERT(priority >= MIN_PRIORITY && priority <= MAX_PRIORITY);
-  m_run_queue[priority].push_back(task);
+  const uint32_t current_priority = current_task->get_priority();
+  if (is_realtime_priority(priority)) {
+    if (!is_realtime_priority(current_priority) || priority > current_priority)
+      return true;
+
+    // The woken task did not use its time slice, unlike the current task of the same priority: it goes first,
+    // unless the current task just started to run.
+    const uint64_t run_time = GenericTimer::get_elapsed_time_in_micros() - current_task->m_run_start_time;
+    if (priority != current_priority || run_time < WAKEUP_PREEMPT_GRANULARITY)
+      return false;
+
+    run_queue.realtime.move_to_front(task, priority);
+    return true;
+  }
+
+  if (is_realtime_priority(current_priority))
+    return false;
+
+  // The woken task was credited for its sleep (see place_fair_task()), it is usually way behind the current one.
+  return task == run_queue.fair.get_first() && task->m_vruntime + FAIR_WAKEUP_GRANULARITY < current_task->m_vruntime;
 }
 
 bool Scheduler::remove_task(const TaskPtr& task) {
@@ -27,28 +347,40 @@ bool Scheduler::remove_task(const TaskPtr& task) {
 
   // The task to remove is the current one.
   // This case is easy: reschedule.
-  if (m_current_task == task) {
-    m_current_task = nullptr;
+  auto& current_task = get_local_run_queue().current_task;
+  if (current_task == task) {
+    current_task->get_cpu_stats().voluntary_switches++;
+    current_task = nullptr;
     schedule();
     return true;
   }
 
-  // Otherwise, the task is probably in the run queue.
-  auto& run_queue = m_run_queue[priority];
-  auto it = std::find(run_queue.begin(), run_queue.end(), task);
-  if (it == run_queue.end())
+  // The task is being run by another core, only this core can deschedule it.
+  if (is_running_on_other_core(task))
+    return false;
+
+  // A throttled task is only known by its group.
+  if (task->m_is_throttled) {
+    task->m_is_throttled = false;
+    return true;
+  }
+
+  // Otherwise, the task is probably in the run queue of the core it last ran on.
+  if (!task->m_run_queue_hook.is_linked())
     return false;  // but it can also not be registered in the scheduler (e.g. paused task)
 
-  run_queue.erase(it);
+  remove_from_run_queue(m_run_queues[task->m_core], task.get(), priority);
   return true;
 }
 
 void Scheduler::update_task_priority(const TaskPtr& task, uint32_t old_priority) {
   KASSERT(task != nullptr);
 
-  if (m_current_task == task) {
-    // Its current task! Nothing to do as the task is not in a run queue.
-    return;
+  for (const auto& run_queue : m_run_queues) {
+    if (run_queue.current_task == task) {
+      // Its a current task! Nothing to do as the task is not in a run queue.
+      return;
+    }
   }
 
   const uint32_t new_priority = task->get_priority();
@@ -58,34 +390,93 @@ void Scheduler::update_task_priority(const TaskPtr& task, uint32_t old_priority)
     return;  // nothing has changed...
 
   // Remove the task from its old run queue.
-  auto& run_queue = m_run_queue[old_priority];
-  auto it = std::find(run_queue.begin(), run_queue.end(), task);
-  if (it == run_queue.end())
+  if (!task->m_run_queue_hook.is_linked())
     return;  // The task was not registered in the scheduler, stop there is nothing to update.
 
-  run_queue.erase(it);
+  remove_from_run_queue(m_run_queues[task->m_core], task.get(), old_priority);
 
-  // Add back the task to its new run queue.
-  m_run_queue[new_priority].push_back(task);
+  // Add back the task to its new run queue (maybe of another scheduling class).
+  enqueue_task(task->m_core, task);
 }
 
-void Scheduler::schedule() {
-  auto old_task = Task::current();
-  if (old_task != nullptr && !old_task->can_preempt())
-    return;  // we cannot preempt the current task.
+bool Scheduler::set_deadline_params(const TaskPtr& task, const DeadlineParams& params) {
+  KASSERT(task != nullptr);
 
-  TaskPtr new_task = nullptr;
+  const auto get_bandwidth = [](const DeadlineParams& params) -> uint64_t {
+    return params.runtime == 0 ? 0 : (params.runtime * DEADLINE_BANDWIDTH_ONE) / params.period;
+  };
 
-  // Find a new task starting with higher priority tasks.
-  for (int i = MAX_PRIORITY; i >= (int)MIN_PRIORITY; --i) {
-    auto& run_queue = m_run_queue[i];
-    if (!run_queue.is_empty()) {
-      new_task = run_queue.pop_front();
-      break;
-    }
+  if (params.runtime != 0 && (params.runtime > params.deadline || params.deadline > params.period))
+    return false;
+
+  // Admission control: the deadline tasks must be able to meet all their deadlines.
+  const uint64_t bandwidth = m_deadline_bandwidth - get_bandwidth(task->m_deadline_params) + get_bandwidth(params);
+  if (bandwidth > DEADLINE_MAX_BANDWIDTH)
+    return false;
+
+  m_deadline_bandwidth = bandwidth;
+
+  // The task is moved to the queue of its new class. The current tasks are switched to it when enqueued again.
+  const bool is_enqueued = task->m_run_queue_hook.is_linked();
+  if (is_enqueued)
+    remove_from_run_queue(m_run_queues[task->m_core], task.get(), task->get_priority());
+
+  task->m_deadline_params = params;
+  task->m_deadline_period_end = 0;  // a new period starts now
+  task->m_run_start_time = GenericTimer::get_elapsed_time_in_micros();
+  refill_deadline_budget(task.get(), task->m_run_start_time);
+
+  if (is_enqueued)
+    enqueue_task(task->m_core, task);
+
+  return true;
+}
+
+bool Scheduler::hand_off(const TaskPtr& task) {
+  KASSERT(task != nullptr);
+  KASSERT(!task->is_running());
+
+  // The deadline tasks keep the EDF order, they go through the run queues.
+  auto& run_queue = get_local_run_queue();
+  Task* old_task = run_queue.current_task.get();
+  if (old_task == nullptr || is_idle_task(old_task) || !old_task->can_preempt() || is_deadline_active(old_task) ||
+      task->m_deadline_params.runtime != 0 || is_group_throttled(task.get()))
+    return false;
+
+  const size_t core_id = SMP::get_core_id();
+  if (!task->is_allowed_on(core_id))
+    return false;
+
+  const uint32_t elapsed_ticks = old_task->m_elapsed_ticks;
+  old_task->get_cpu_stats().voluntary_switches++;
+
+  if (!is_realtime_priority(task->get_priority()))
+    place_fair_task(task.get(), core_id);
+
+  // The old current task is released by the assignment, it is blocked and not enqueued again.
+  run_queue.current_task = task;
+  task->m_core = core_id;
+  task->m_elapsed_ticks = elapsed_ticks;
+  task->m_run_start_time = GenericTimer::get_elapsed_time_in_micros();
+
+  RCU::note_context_switch(false);
+  return true;
+}
+
+void Scheduler::schedule() {
+  // No reference is taken on the current task, the run queue keeps it alive until switch_to().
+  Task* old_task = get_current_task_ptr();
+  if (old_task != nullptr && !old_task->can_preempt()) {
+    old_task->defer_preemption();  // we cannot preempt the current task yet.
+    return;
   }
 
-  switch_to(new_task);
+  TaskPtr new_task = pick_next_task();
+
+  // Nothing to run at all, fall back to the idle task. So does a throttled task, or a task no longer allowed on
+  // this core (see set_task_affinity()): switch_to() parks or moves it.
+  if (new_task == nullptr && (old_task == nullptr || must_move_out(old_task)))
+    new_task = get_local_run_queue().idle_task;
 
 #if LOG_MIN_LEVEL <= LOG_TRACE_LEVEL
   const auto old_task_id = old_task ? old_task->get_id() : UINT16_MAX;
@@ -93,99 +484,463 @@ void Scheduler::schedule() {
   if (old_task_id != new_task_id)
     LOG_TRACE("Scheduler: old={}, new={}", old_task_id, new_task_id);
 #endif
+
+  switch_to(std::move(new_task));
 }
 
 void Scheduler::tick() {
-  auto old_task = Task::current();
+  // No reference is taken on the current task, the run queue keeps it alive until switch_to().
+  Task* old_task = get_current_task_ptr();
+  auto& local_run_queue = get_local_run_queue();
+
+  RCU::note_tick();
 
   // Algorithm overview:
-  //   - We have multiple run queues, one per thread priority (currently there are 32 priorities).
+  //   - Each core has its own run queue for each scheduling class (see the Scheduler class).
   //   - At each tick:
-  //      - If there is a higher priority task, switch to it unconditionally.
-  //      - Otherwise, do a round-robin scheduling of tasks inside the same run queue
-  //        as the current task. We respect allocated time slices, that is we do nothing
-  //        if the current task has not consumed all its CPU ticks.
-  //        If there are no more tasks with the same priority, we fall back to use
-  //        lower priority tasks.
-  // This algorithm is called multilevel queue scheduling. It has some advantages:
-  //   - It is quite simple and efficient.
-  //   - Higher priority tasks can preempt.
-  // However, sometimes lower priority tasks can starve.
+  //      - The deadline task with the earliest deadline preempts any other task, and runs until it used all
+  //        its runtime for the current period.
+  //      - If there is a higher priority real-time task, switch to it unconditionally (any real-time task
+  //        preempts a fair one).
+  //      - A real-time task is scheduled in round-robin with the tasks of the same priority. We respect allocated
+  //        time slices, that is we do nothing if the current task has not consumed all its CPU ticks.
+  //        If there are no more tasks with the same priority, we fall back to use lower priority tasks.
+  //      - A fair task is charged its tick in virtual run time, and is preempted once it is ahead of the fair
+  //        task that ran the least (a waking task is placed a bit before the others so it runs quickly).
+  //      - The tick is charged to the task group of the current task, which is throttled (whatever its
+  //        class) once it used its quota for the current period.
+  //   - A core without any task steals one from the busiest core, and every BALANCE_INTERVAL
+  //     ticks each core pulls tasks from the busiest core to even the load out.
+  // The real-time tasks can starve the fair ones, but the fair tasks never starve each other: the low
+  // priority background tasks still progress, just slower.
+
+  if (++local_run_queue.ticks_since_balance >= BALANCE_INTERVAL) {
+    local_run_queue.ticks_since_balance = 0;
+    balance_load();
+  }
+
+  push_to_idle_cores();
 
   if (old_task != nullptr)
     old_task->m_elapsed_ticks++;
 
-  if (old_task != nullptr && !old_task->can_preempt())
-    return;  // we cannot preempt the current task.
-
-  // Check if there is a waiting process with a higher priority.
-  TaskPtr new_task = find_higher_priority_task_than_current();
-
-  // Otherwise, check if the current task time slice has expired and if yes
-  // then schedule using round-robin.
-  if (new_task == nullptr &&
-      (old_task != nullptr && old_task->m_elapsed_ticks >= get_time_slice_for_priority(old_task->get_priority()))) {
-    const uint32_t current_priority = get_current_priority();
-    for (int i = (int)current_priority; i >= (int)MIN_PRIORITY; --i) {
-      if (!m_run_queue[current_priority].is_empty()) {
-        new_task = m_run_queue[current_priority].pop_front();
-        break;
+  if (old_task != nullptr && !is_idle_task(old_task)) {
+    if (old_task->m_deadline_params.runtime != 0) {
+      const uint64_t now = GenericTimer::get_elapsed_time_in_micros();
+      if (is_deadline_active(old_task)) {
+        charge_deadline_runtime(old_task, now);
+
+        // Out of runtime: the task goes on in the fair class.
+        if (!is_deadline_active(old_task))
+          place_fair_task(old_task, SMP::get_core_id());
+      } else {
+        // Run in the fair class, until the next period.
+        refill_deadline_budget(old_task, now);
+        old_task->m_run_start_time = now;
       }
     }
+
+    if (!is_deadline_active(old_task) && !is_realtime_priority(old_task->get_priority()))
+      account_fair_tick(local_run_queue, old_task);
+
+    charge_task_group(old_task, GenericTimer::get_elapsed_time_in_micros());
   }
 
-  switch_to(new_task);
+  if (old_task != nullptr && !old_task->can_preempt()) {
+    old_task->defer_preemption();  // we cannot preempt the current task yet.
+    return;
+  }
+
+  TaskPtr new_task = nullptr;
+  if (old_task == nullptr || is_idle_task(old_task)) {
+    // Any runnable task preempts the idle task.
+    new_task = pick_next_task();
+    if (new_task == nullptr && old_task == nullptr)
+      new_task = local_run_queue.idle_task;
+  } else if (must_move_out(old_task)) {
+    // Its group was throttled, or its affinity changed.
+    new_task = pick_next_task();
+    if (new_task == nullptr)
+      new_task = local_run_queue.idle_task;
+  } else {
+    // Check if there is a waiting process with a higher priority.
+    new_task = find_higher_priority_task_than_current();
+
+    // Otherwise, check if the current task used its share of the CPU.
+    if (new_task == nullptr)
+      new_task = find_task_after_time_slice();
+  }
 
 #if LOG_MIN_LEVEL <= LOG_TRACE_LEVEL
-  if (new_task == nullptr)
+  if (new_task != nullptr) {
+    const auto old_task_id = old_task ? old_task->get_id() : UINT16_MAX;
+    const auto new_task_id = new_task->get_id();
+    if (old_task_id != new_task_id)
+      LOG_TRACE("Scheduler (tick): old={}, new={}", old_task_id, new_task_id);
+  }
+#endif
+
+  switch_to(std::move(new_task));
+}
+
+void Scheduler::place_fair_task(Task* task, size_t core_id) {
+  // The virtual run time of a task is relative to the min_vruntime of its core (they drift apart between cores).
+  // A task that waited gets a bounded credit: it runs soon, without monopolizing the core for its sleep time.
+  const uint64_t old_min_vruntime = m_run_queues[task->m_core].fair.min_vruntime;
+  const int64_t lag = libk::max((int64_t)(task->m_vruntime - old_min_vruntime), -(int64_t)FAIR_SLEEPER_CREDIT);
+  task->m_vruntime = m_run_queues[core_id].fair.min_vruntime + lag;
+}
+
+void Scheduler::enqueue_task(size_t core_id, const TaskPtr& task) {
+  const uint32_t priority = task->get_priority();
+  KASSERT(priority >= MIN_PRIORITY && priority <= MAX_PRIORITY);
+
+  auto& run_queue = m_run_queues[core_id];
+  if (task->m_deadline_params.runtime != 0)
+    refill_deadline_budget(task.get(), GenericTimer::get_elapsed_time_in_micros());
+
+  if (is_deadline_active(task.get())) {
+    run_queue.deadline.enqueue(task.get());
+    task->m_core = core_id;
     return;
+  }
 
-  const auto old_task_id = old_task ? old_task->get_id() : UINT16_MAX;
-  const auto new_task_id = new_task ? new_task->get_id() : UINT16_MAX;
-  if (old_task_id != new_task_id)
-    LOG_TRACE("Scheduler (tick): old={}, new={}", old_task_id, new_task_id);
-#endif
+  if (is_realtime_priority(priority)) {
+    run_queue.realtime.enqueue(task.get());
+  } else {
+    place_fair_task(task.get(), core_id);
+    run_queue.fair.enqueue(task.get());
+  }
+
+  run_queue.nb_tasks++;
+  task->m_core = core_id;
+}
+
+void Scheduler::remove_from_run_queue(RunQueue& run_queue, Task* task, uint32_t priority) {
+  // The budget of an enqueued task does not change, it is in the queue chosen by enqueue_task().
+  if (is_deadline_active(task)) {
+    run_queue.deadline.remove(task);
+    return;
+  }
+
+  if (is_realtime_priority(priority)) {
+    run_queue.realtime.remove(task, priority);
+  } else {
+    run_queue.fair.remove(task);
+  }
+
+  run_queue.nb_tasks--;
+}
+
+TaskPtr Scheduler::dequeue_task(RunQueue& run_queue, Task* task) {
+  remove_from_run_queue(run_queue, task, task->get_priority());
+
+  // Tasks are owned by the task manager, run queues only link them.
+  return TaskPtr(task);
+}
+
+TaskPtr Scheduler::dequeue_next_task(RunQueue& run_queue, bool from_tail) {
+  // The deadline tasks always go first, then the real-time ones. The deadline tasks are never migrated.
+  Task* task = from_tail ? nullptr : run_queue.deadline.get_first();
+  if (task == nullptr)
+    task = from_tail ? run_queue.realtime.get_last() : run_queue.realtime.get_first();
+  if (task == nullptr)
+    task = from_tail ? run_queue.fair.get_last() : run_queue.fair.get_first();
+
+  KASSERT(task != nullptr);
+  return dequeue_task(run_queue, task);
+}
+
+Task* Scheduler::find_task_to_migrate(const RunQueue& run_queue, size_t core_id) const {
+  // From the tail of the highest priority, as dequeue_next_task(): the first task allowed on the core.
+  for (int priority = get_highest_priority(run_queue.realtime.ready_mask); priority >= 0; --priority) {
+    const TaskList& tasks = run_queue.realtime.tasks[priority];
+    for (Task* task = tasks.back(); task != nullptr; task = tasks.previous(task)) {
+      if (task->is_allowed_on(core_id))
+        return task;
+    }
+  }
+
+  for (Task* task = run_queue.fair.get_last(); task != nullptr; task = run_queue.fair.tasks.previous(task)) {
+    if (task->is_allowed_on(core_id))
+      return task;
+  }
+
+  return nullptr;
+}
+
+size_t Scheduler::find_busiest_core() const {
+  const size_t core_id = SMP::get_core_id();
+
+  // The isolated cores keep their tasks.
+  size_t busiest_core = SMP::MAX_CORES;
+  size_t busiest_nb_tasks = 0;
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if (i != core_id && !is_core_isolated(i) && m_run_queues[i].nb_tasks > busiest_nb_tasks) {
+      busiest_core = i;
+      busiest_nb_tasks = m_run_queues[i].nb_tasks;
+    }
+  }
+
+  return busiest_core;
+}
+
+TaskPtr Scheduler::steal_task() {
+  const size_t core_id = SMP::get_core_id();
+  if (is_core_isolated(core_id))
+    return nullptr;
+
+  const size_t busiest_core = find_busiest_core();
+  if (busiest_core == SMP::MAX_CORES)
+    return nullptr;  // all other cores are idle too
+
+  // Steal from the tail: these tasks are the ones that would have waited the most there.
+  auto& busiest_run_queue = m_run_queues[busiest_core];
+  Task* task = find_task_to_migrate(busiest_run_queue, core_id);
+  if (task == nullptr)
+    return nullptr;
+
+  return dequeue_task(busiest_run_queue, task);
+}
+
+void Scheduler::balance_load() {
+  const size_t core_id = SMP::get_core_id();
+  if (is_core_isolated(core_id))
+    return;
+
+  const size_t busiest_core = find_busiest_core();
+  if (busiest_core == SMP::MAX_CORES)
+    return;
+
+  auto& local_run_queue = m_run_queues[core_id];
+  auto& busiest_run_queue = m_run_queues[busiest_core];
+
+  // Pull tasks until both cores have roughly the same load (or only tasks pinned elsewhere are left).
+  while (busiest_run_queue.nb_tasks > local_run_queue.nb_tasks + 1) {
+    Task* task = find_task_to_migrate(busiest_run_queue, core_id);
+    if (task == nullptr)
+      break;
+
+    enqueue_task(core_id, dequeue_task(busiest_run_queue, task));
+  }
+}
+
+void Scheduler::push_to_idle_cores() {
+  // Idle cores do not tick, and therefore never steal: give them the tasks waiting here.
+  const size_t core_id = SMP::get_core_id();
+  if (is_core_isolated(core_id))
+    return;
+
+  auto& local_run_queue = m_run_queues[core_id];
+  for (size_t i = 0; i < SMP::MAX_CORES && local_run_queue.nb_tasks > 0; ++i) {
+    if (i == core_id || is_core_isolated(i) || !is_core_idle(i) || m_run_queues[i].nb_tasks > 0)
+      continue;
+
+    Task* task = find_task_to_migrate(local_run_queue, i);
+    if (task == nullptr)
+      continue;
+
+    enqueue_task(i, dequeue_task(local_run_queue, task));
+    IRQManager::send_ipi(i);
+  }
 }
 
 uint32_t Scheduler::get_current_priority() const {
-  if (m_current_task == nullptr)
+  const auto& current_task = get_local_run_queue().current_task;
+  if (current_task == nullptr)
     return 0;
-  return m_current_task->get_priority();
+  return current_task->get_priority();
+}
+
+bool Scheduler::is_running_on_other_core(const TaskPtr& task) const {
+  const size_t core_id = SMP::get_core_id();
+  for (size_t i = 0; i < SMP::MAX_CORES; ++i) {
+    if (i != core_id && m_run_queues[i].current_task == task)
+      return true;
+  }
+
+  return false;
+}
+
+bool Scheduler::is_idle_task(const Task* task) const {
+  return task != nullptr && task == get_local_run_queue().idle_task.get();
+}
+
+TaskPtr Scheduler::pick_next_task() {
+  // Find a new task starting with higher priority tasks.
+  auto& run_queue = get_local_run_queue();
+  if (run_queue.nb_tasks > 0 || run_queue.deadline.get_first() != nullptr)
+    return dequeue_next_task(run_queue);
+
+  // Nothing to do locally, try to help the other cores.
+  return steal_task();
 }
 
 TaskPtr Scheduler::find_higher_priority_task_than_current() {
+  auto& run_queue = get_local_run_queue();
+  if (must_preempt_for_deadline(SMP::get_core_id()))
+    return dequeue_task(run_queue, run_queue.deadline.get_first());
+
+  const Task* current_task = run_queue.current_task.get();
+  if (is_deadline_active(current_task))
+    return nullptr;
+
+  // Any real-time task preempts a fair task.
   const uint32_t current_priority = get_current_priority();
-  for (uint32_t i = MAX_PRIORITY; i > current_priority; --i) {
-    auto& run_queue = m_run_queue[i];
-    if (!run_queue.is_empty()) {
-      return run_queue.pop_front();
-    }
+  uint32_t higher_mask = UINT32_MAX;
+  if (is_realtime_priority(current_priority))
+    higher_mask = ~(uint32_t)((2ull << current_priority) - 1);
+
+  Task* task = run_queue.realtime.get_first(higher_mask);
+  if (task == nullptr)
+    return nullptr;
+
+  return dequeue_task(run_queue, task);
+}
+
+TaskPtr Scheduler::find_task_after_time_slice() {
+  auto& run_queue = get_local_run_queue();
+  const Task* current_task = run_queue.current_task.get();
+  const uint32_t current_priority = current_task->get_priority();
+
+  Task* task = nullptr;
+  if (is_deadline_active(current_task)) {
+    // It runs until its runtime is used (see tick()).
+    return nullptr;
+  } else if (is_realtime_priority(current_priority)) {
+    // Round-robin with the tasks of the same priority, or the lower priority ones.
+    if (current_task->m_elapsed_ticks < TIME_SLICE)
+      return nullptr;
+
+    const uint32_t lower_or_equal_mask = (uint32_t)((2ull << current_priority) - 1);
+    task = run_queue.realtime.get_first(lower_or_equal_mask);
+    if (task == nullptr)
+      task = run_queue.fair.get_first();
+  } else {
+    // The fair task that ran the least goes first, with some hysteresis to not switch at each tick.
+    task = run_queue.fair.get_first();
+    if (task != nullptr && current_task->m_vruntime <= task->m_vruntime + FAIR_PREEMPT_GRANULARITY)
+      task = nullptr;
   }
 
-  return nullptr;
+  if (task == nullptr)
+    return nullptr;
+
+  return dequeue_task(run_queue, task);
 }
 
-void Scheduler::switch_to(const TaskPtr& new_task) {
+void Scheduler::switch_to(TaskPtr&& new_task) {
   if (new_task == nullptr)
     return;  // no new task, nothing to do
 
   KASSERT(new_task->is_running());
 
-  // Enqueue again the old task into the run queue.
-  if (m_current_task != nullptr && m_current_task != new_task) {
-    const uint32_t current_priority = m_current_task->get_priority();
-    m_run_queue[current_priority].push_back(m_current_task);
+  const size_t core_id = SMP::get_core_id();
+  auto& current_task = m_run_queues[core_id].current_task;
+
+  const uint64_t now = GenericTimer::get_elapsed_time_in_micros();
+  if (current_task != nullptr && current_task != new_task && is_deadline_active(current_task.get()))
+    charge_deadline_runtime(current_task.get(), now);
+
+  // Enqueue again the old task into the run queue (the idle task is never enqueued). It was still runnable, like
+  // Linux a yield is also counted as an involuntary switch.
+  if (current_task != nullptr && current_task != new_task && !is_idle_task(current_task.get())) {
+    current_task->get_cpu_stats().involuntary_switches++;
+    if (is_group_throttled(current_task.get())) {
+      current_task->m_is_throttled = true;  // enqueued again at the next period of its group
+    } else if (current_task->is_allowed_on(core_id)) {
+      enqueue_task(core_id, current_task);
+    } else {
+      // Its affinity changed while it was running.
+      const size_t new_core_id = select_core(current_task.get());
+      enqueue_task(new_core_id, current_task);
+      reschedule_if_needed(new_core_id, current_task.get());
+    }
   }
 
-  m_current_task = new_task;
-  m_current_task->m_elapsed_ticks = 0;  // start a new time slice for the new task
+  // A task stolen from another core: its virtual run time is relative to the other core.
+  if (new_task->m_core != core_id && !is_realtime_priority(new_task->get_priority()))
+    place_fair_task(new_task.get(), core_id);
+
+  // Move the reference, the old current task is released by the assignment.
+  current_task = std::move(new_task);
+  current_task->m_core = core_id;
+  current_task->m_elapsed_ticks = 0;  // start a new time slice for the new task
+  current_task->m_run_start_time = now;
+
+  RCU::note_context_switch(is_idle_task(current_task.get()));
 }
 
-uint64_t Scheduler::get_time_slice_for_priority(uint32_t priority) {
-  switch (priority) {
-    case 0:  // low-priority process, try to preempt more often.
-      return 1;
-    default:
-      return 10;
+uint64_t Scheduler::get_fair_weight(uint32_t priority) {
+  uint64_t weight = FAIR_DEFAULT_WEIGHT;
+  for (uint32_t i = priority; i < DEFAULT_PRIORITY; ++i)
+    weight = weight * 4 / 5;
+  for (uint32_t i = DEFAULT_PRIORITY; i < priority; ++i)
+    weight = weight * 5 / 4;
+  return weight;
+}
+
+void Scheduler::refill_deadline_budget(Task* task, uint64_t now) {
+  if (now < task->m_deadline_period_end)
+    return;
+
+  const DeadlineParams& params = task->m_deadline_params;
+  task->m_deadline = now + params.deadline;
+  task->m_deadline_period_end = now + params.period;
+  task->m_deadline_budget = (int64_t)params.runtime;
+}
+
+void Scheduler::charge_deadline_runtime(Task* task, uint64_t now) {
+  task->m_deadline_budget -= (int64_t)(now - task->m_run_start_time);
+  task->m_run_start_time = now;
+}
+
+bool Scheduler::must_preempt_for_deadline(size_t core_id) const {
+  const auto& run_queue = m_run_queues[core_id];
+  const Task* task = run_queue.deadline.get_first();
+  if (task == nullptr)
+    return false;
+
+  // Earliest deadline first.
+  const Task* current_task = run_queue.current_task.get();
+  return !is_deadline_active(current_task) || task->m_deadline < current_task->m_deadline;
+}
+
+void Scheduler::account_fair_tick(RunQueue& run_queue, Task* task) {
+  // A tick costs FAIR_DEFAULT_WEIGHT to a task of the default priority, less to the higher priorities.
+  task->m_vruntime += FAIR_DEFAULT_WEIGHT * FAIR_DEFAULT_WEIGHT / get_fair_weight(task->get_priority());
+  run_queue.fair.update_min_vruntime(task);
+}
+
+/*
+ * Benchmarks
+ */
+
+#include <libk/benchmark.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "sys/syscall.h"
+#include "task/task_manager.hpp"
+
+static bool g_is_yield_benchmark_done = false;
+
+BENCHMARK("kernel.context_switch") {
+  // Each iteration yields to a task yielding back immediately, that is two context switches when both
+  // tasks run on the same core (a yield without switch otherwise).
+  __atomic_store_n(&g_is_yield_benchmark_done, false, __ATOMIC_SEQ_CST);
+  {
+    KernelTaskLockGuard kernel_lock;
+    auto partner = TaskManager::get().create_kernel_task([]() {
+      while (!__atomic_load_n(&g_is_yield_benchmark_done, __ATOMIC_SEQ_CST)) {
+        sys_yield();
+      }
+    });
+
+    KASSERT(partner != nullptr);
+    TaskManager::get().wake_task(partner);
   }
+
+  while (state.keep_running())
+    sys_yield();
+
+  __atomic_store_n(&g_is_yield_benchmark_done, true, __ATOMIC_SEQ_CST);
 }
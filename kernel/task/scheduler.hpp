@@ -1,13 +1,34 @@
 #pragma once
 
-#include <libk/linked_list.hpp>
+#include <libk/intrusive_list.hpp>
+#include "hardware/smp.hpp"
 #include "task.hpp"
+#include "task_group.hpp"
 
+/**
+ * The tasks are scheduled by three scheduling classes:
+ *   - The deadline class (the tasks with DeadlineParams): each task runs up to its runtime in each of its
+ *     periods, the earliest deadline first. They go before all the other tasks, the admission control
+ *     (see set_deadline_params()) ensures they never use more than DEADLINE_MAX_BANDWIDTH of a core.
+ *     A task that used all its runtime runs in the fair class until its next period.
+ *   - The real-time class (priorities REALTIME_MIN_PRIORITY to MAX_PRIORITY): strict priorities, the highest
+ *     one always runs first and the tasks of the same priority are scheduled in round-robin.
+ *   - The fair class (the lower priorities): the tasks share the CPU time in proportion of their weight
+ *     (derived from their priority), so none of them starves. They only run when no real-time task is ready.
+ *
+ * Whatever their class, the tasks of a TaskGroup are throttled once the group used its CPU bandwidth quota, so
+ * a runaway program can not starve the rest of the system (see create_task_group()).
+ */
 class Scheduler {
  public:
   static constexpr uint32_t MIN_PRIORITY = 0;
   static constexpr uint32_t MAX_PRIORITY = 31;
   static constexpr uint32_t DEFAULT_PRIORITY = (MAX_PRIORITY - MIN_PRIORITY) / 2;
+  static constexpr uint32_t REALTIME_MIN_PRIORITY = 24;
+
+  [[nodiscard]] static constexpr bool is_realtime_priority(uint32_t priority) {
+    return priority >= REALTIME_MIN_PRIORITY;
+  }
 
   Scheduler();
 
@@ -19,28 +40,241 @@ class Scheduler {
 
   static Scheduler& get() { return *g_instance; }
 
-  /** Returns the task being currently run. */
-  [[nodiscard]] TaskPtr get_current_task() const { return m_current_task; }
+  /** Returns the task being currently run by the calling core. */
+  [[nodiscard]] TaskPtr get_current_task() const { return get_local_run_queue().current_task; }
+  /** Same as get_current_task() but without taking a reference, the run queue keeps the task alive until
+   * it is switched out. */
+  [[nodiscard]] Task* get_current_task_ptr() const { return get_local_run_queue().current_task.get(); }
+
+  /** Sets the task run by @a core_id when there is nothing else to do. It is never enqueued. */
+  void set_idle_task(size_t core_id, const TaskPtr& task) { m_run_queues[core_id].idle_task = task; }
+
+  /** Checks if @a task is being currently run by a core other than the calling one. */
+  [[nodiscard]] bool is_running_on_other_core(const TaskPtr& task) const;
+
+  /** Checks if the core @a core_id is running its idle task. */
+  [[nodiscard]] bool is_core_idle(size_t core_id) const;
+
+  /** Gets the time (in timer ticks) the core @a core_id spent in its idle task since the boot, until @a now.
+   * The utilization of the core over an interval is the part of it not spent there. */
+  [[nodiscard]] uint64_t get_idle_ticks(size_t core_id, uint64_t now) const;
+
+  /** Makes the core @a core_id reschedule now if it is idle (idle cores do not tick), or if the @a woken_task
+   * just enqueued there must preempt its current task (see must_preempt_on_wakeup()). */
+  void reschedule_if_needed(size_t core_id, Task* woken_task);
+
+  /**
+   * Isolates the cores of @a core_mask (bit i for the core i): they are left out of the load balancing and of
+   * the default affinity, so they only run the tasks pinned there (see set_task_affinity()). The IRQs are
+   * routed to the boot core unless pinned too (see IRQManager::set_affinity()), which can not be isolated.
+   */
+  void set_isolated_cores(uint32_t core_mask);
+  [[nodiscard]] uint32_t get_isolated_cores() const { return m_isolated_cores; }
+  /** Returns the affinity of the new tasks without parent: all the cores but the isolated ones. */
+  [[nodiscard]] uint32_t get_default_affinity() const { return ALL_CORES_MASK & ~m_isolated_cores; }
+  /**
+   * Restricts @a task to the cores of @a affinity (bit i for the core i), moving it to one of them if needed.
+   * Returns false if none of them is online.
+   */
+  [[nodiscard]] bool set_task_affinity(const TaskPtr& task, uint32_t affinity);
+
+  /**
+   * Creates a group of tasks running at most @a quota microseconds (summed over all cores) in each @a period,
+   * see TaskGroup. Returns nullptr if the parameters are invalid (the quota and the period must be at least a
+   * tick, and the period at most MAX_GROUP_PERIOD) or if there are already MAX_TASK_GROUPS groups.
+   */
+  [[nodiscard]] TaskGroup* create_task_group(uint64_t quota, uint64_t period);
+  /** Destroys @a group. Returns false, without doing anything, if it still has tasks. */
+  [[nodiscard]] bool destroy_task_group(TaskGroup* group);
+  /** Returns the group of the given @a id, or nullptr if there is none. */
+  [[nodiscard]] TaskGroup* find_task_group(TaskGroup::id_t id);
+  /** Moves the new (not yet enqueued) or terminated @a task to @a group, or out of any group if nullptr. */
+  void set_task_group(Task* task, TaskGroup* group);
+  /** Starts a new period of the throttled @a group (at the end of the current one), see TaskGroup::end_period(). */
+  void unthrottle_task_group(TaskGroup* group);
 
-  void add_task(const TaskPtr& task);
+  /** Enqueues @a task and returns the core whose run queue it was put in. */
+  size_t add_task(const TaskPtr& task);
   bool remove_task(const TaskPtr& task);
+  /**
+   * Replaces the current task of the calling core (which blocks) by the paused @a task, without going through
+   * the run queues: @a task runs the rest of the time slice of the current task. Returns false, without doing
+   * anything, if the current task can not be switched out this way (e.g. a deadline task).
+   */
+  [[nodiscard]] bool hand_off(const TaskPtr& task);
   void update_task_priority(const TaskPtr& task, uint32_t old_priority);
 
+  /**
+   * Puts @a task in the deadline class with the given @a params (or removes it if the runtime is 0).
+   * Returns false if the parameters are invalid (runtime <= deadline <= period is required) or if the
+   * total bandwidth of the deadline tasks would exceed DEADLINE_MAX_BANDWIDTH.
+   */
+  [[nodiscard]] bool set_deadline_params(const TaskPtr& task, const DeadlineParams& params);
+
   void schedule();
   void tick();
 
  private:
+  static constexpr uint32_t PRIORITY_COUNT = MAX_PRIORITY - MIN_PRIORITY + 1;
+  static constexpr uint32_t ALL_CORES_MASK = (uint32_t)((1ull << SMP::MAX_CORES) - 1);
+
+  using TaskList = libk::IntrusiveList<Task, &Task::m_run_queue_hook>;
+
+  /*
+   * The scheduling classes all have the same interface:
+   *   - enqueue() and remove() a task,
+   *   - get_first() the task to run next and get_last() the one that would wait the most, or nullptr.
+   * The Scheduler chooses the class of a task from its priority (see is_realtime_priority()).
+   */
+
+  /** The deadline tasks of a core, sorted by absolute deadline. They are not migrated (no get_last()). */
+  struct DeadlineQueue {
+    TaskList tasks;  // sorted by increasing m_deadline
+
+    void enqueue(Task* task);
+    void remove(Task* task) { tasks.remove(task); }
+    [[nodiscard]] Task* get_first() const { return tasks.front(); }
+  };  // struct DeadlineQueue
+
+  /** The real-time tasks of a core: one FIFO per priority. */
+  struct RealTimeQueue {
+    TaskList tasks[PRIORITY_COUNT];
+    uint32_t ready_mask = 0;  // bit i is set if tasks[i] is not empty
+
+    void enqueue(Task* task);
+    void remove(Task* task, uint32_t priority);
+    void move_to_front(Task* task, uint32_t priority);
+    /** Returns the first task whose priority is in @a priority_mask, or nullptr. */
+    [[nodiscard]] Task* get_first(uint32_t priority_mask = UINT32_MAX) const;
+    [[nodiscard]] Task* get_last() const;
+  };  // struct RealTimeQueue
+
+  /**
+   * The fair tasks of a core, sorted by virtual run time: the run time of a task divided by its weight.
+   * The task that got the least CPU time relatively to its weight runs first.
+   */
+  struct FairQueue {
+    TaskList tasks;  // sorted by increasing m_vruntime
+    // Never decreases, the reference of the tasks enqueued on this core. It starts above 0 so that the
+    // credited tasks (see place_fair_task()) never go below 0.
+    uint64_t min_vruntime = FAIR_SLEEPER_CREDIT;
+
+    void enqueue(Task* task);
+    void remove(Task* task) { tasks.remove(task); }
+    [[nodiscard]] Task* get_first() const { return tasks.front(); }
+    [[nodiscard]] Task* get_last() const { return tasks.back(); }
+    void update_min_vruntime(const Task* current_task);
+  };  // struct FairQueue
+
+  /** The scheduling state of a single core, on its own cache lines as each core mostly updates its own. */
+  struct alignas(SMP::CACHE_LINE_SIZE) RunQueue {
+    TaskPtr current_task = nullptr;
+    TaskPtr idle_task = nullptr;
+    DeadlineQueue deadline;
+    RealTimeQueue realtime;
+    FairQueue fair;
+    size_t nb_tasks = 0;  // count of enqueued real-time and fair tasks, the ones migrated between cores
+    uint64_t ticks_since_balance = 0;
+  };  // struct RunQueue
+
+  [[nodiscard]] RunQueue& get_local_run_queue() { return m_run_queues[SMP::get_core_id()]; }
+  [[nodiscard]] const RunQueue& get_local_run_queue() const { return m_run_queues[SMP::get_core_id()]; }
+
+  static_assert(PRIORITY_COUNT <= 32, "the ready mask of a run queue is a 32-bit integer");
+  static_assert(SMP::MAX_CORES <= 32, "the affinities are 32-bit integers");
+
+  /** Returns the highest priority set in @a ready_mask, or -1 if it is empty. */
+  [[nodiscard]] static int get_highest_priority(uint32_t ready_mask) {
+    return ready_mask == 0 ? -1 : 31 - __builtin_clz(ready_mask);
+  }
+
+  void enqueue_task(size_t core_id, const TaskPtr& task);
+  void remove_from_run_queue(RunQueue& run_queue, Task* task, uint32_t priority);
+  /** Sets the virtual run time of the fair @a task (which last ran on task->m_core) to be run on @a core_id. */
+  void place_fair_task(Task* task, size_t core_id);
+  [[nodiscard]] TaskPtr dequeue_task(RunQueue& run_queue, Task* task);
+  /** Dequeues the next task to run from @a run_queue (or the one that would wait the most if @a from_tail). */
+  [[nodiscard]] TaskPtr dequeue_next_task(RunQueue& run_queue, bool from_tail = false);
+
+  /** Checks if @a task must be switched out of the calling core: it is throttled or no longer allowed there. */
+  [[nodiscard]] bool must_move_out(const Task* task) const;
+  [[nodiscard]] static bool is_group_throttled(const Task* task) {
+    return task->m_group != nullptr && task->m_group->is_throttled;
+  }
+  /** Charges a tick of the current @a task to its group, which is throttled once out of quota. */
+  void charge_task_group(Task* task, uint64_t now);
+  void throttle_task_group(TaskGroup* group);
+
+  [[nodiscard]] bool is_core_isolated(size_t core_id) const {
+    return (m_isolated_cores & ((uint32_t)1 << core_id)) != 0;
+  }
+  /** Returns the core to enqueue the waking @a task on, among the online cores it is allowed on. */
+  [[nodiscard]] size_t select_core(const Task* task) const;
+  /** Returns the task of @a run_queue that would wait the most there and may migrate to @a core_id, or nullptr.
+   * The deadline tasks are never migrated. */
+  [[nodiscard]] Task* find_task_to_migrate(const RunQueue& run_queue, size_t core_id) const;
+  [[nodiscard]] size_t find_busiest_core() const;
+  [[nodiscard]] TaskPtr steal_task();
+  void balance_load();
+  void push_to_idle_cores();
+
   [[nodiscard]] uint32_t get_current_priority() const;
+  [[nodiscard]] bool is_idle_task(const Task* task) const;
+  [[nodiscard]] TaskPtr pick_next_task();
   [[nodiscard]] TaskPtr find_higher_priority_task_than_current();
-  void switch_to(const libk::SharedPointer<Task>& new_task);
+  [[nodiscard]] TaskPtr find_task_after_time_slice();
+  void switch_to(TaskPtr&& new_task);
+
+  /** Returns the weight of a fair task: each priority level gives about 25% more CPU time than the previous. */
+  [[nodiscard]] static uint64_t get_fair_weight(uint32_t priority);
+  void account_fair_tick(RunQueue& run_queue, Task* task);
 
-  [[nodiscard]] static uint64_t get_time_slice_for_priority(uint32_t priority);
+  /** Checks if @a task is in the deadline class and has runtime left in its current period. */
+  [[nodiscard]] static bool is_deadline_active(const Task* task) {
+    return task != nullptr && task->m_deadline_params.runtime != 0 && task->m_deadline_budget > 0;
+  }
+
+  /** Starts a new period of the deadline @a task if the current one is over. */
+  static void refill_deadline_budget(Task* task, uint64_t now);
+  /** Charges the deadline @a task for the time it ran since it was switched in or last charged. */
+  static void charge_deadline_runtime(Task* task, uint64_t now);
+  [[nodiscard]] bool must_preempt_for_deadline(size_t core_id) const;
+  /**
+   * Checks if the @a task woken on @a core_id must run before the current task there, without waiting for
+   * the next tick: a higher priority task, a task of the same real-time priority if the current one already
+   * ran for a while, or a fair task that ran much less than the current one thanks to its sleep.
+   */
+  [[nodiscard]] bool must_preempt_on_wakeup(size_t core_id, Task* task);
 
   static Scheduler* g_instance;
-  TaskPtr m_current_task = nullptr;
 
+  /** Count of ticks a real-time task runs before the others of the same priority. */
   static constexpr uint32_t TIME_SLICE = 10;
+  /** The weight of a fair task of DEFAULT_PRIORITY, and the virtual run time of its ticks. */
+  static constexpr uint64_t FAIR_DEFAULT_WEIGHT = 1024;
+  /** A waking fair task is placed this much before the others, so interactive tasks run quickly. */
+  static constexpr uint64_t FAIR_SLEEPER_CREDIT = FAIR_DEFAULT_WEIGHT * 3;
+  /** A fair task is preempted once it runs this much ahead of the first waiting one. */
+  static constexpr uint64_t FAIR_PREEMPT_GRANULARITY = FAIR_DEFAULT_WEIGHT * 2;
+  /** A woken fair task preempts the current one if it ran this much less. */
+  static constexpr uint64_t FAIR_WAKEUP_GRANULARITY = FAIR_DEFAULT_WEIGHT;
+  /** A woken real-time task preempts the current one of the same priority once it ran this long (in us). */
+  static constexpr uint64_t WAKEUP_PREEMPT_GRANULARITY = 1000;
+  /** The longest period of a TaskGroup (in us). */
+  static constexpr uint64_t MAX_GROUP_PERIOD = 10'000'000;
+  static constexpr size_t MAX_TASK_GROUPS = 16;
+  /** Count of ticks between two load balancing of a core. */
+  static constexpr uint64_t BALANCE_INTERVAL = 10;
+  /** The bandwidths (runtime / period) are fixed-point numbers, 1 is a whole core. */
+  static constexpr uint64_t DEADLINE_BANDWIDTH_ONE = 1 << 20;
+  /** The deadline tasks all fit on one core, and leave some CPU time to the others. */
+  static constexpr uint64_t DEADLINE_MAX_BANDWIDTH = DEADLINE_BANDWIDTH_ONE * 9 / 10;
 
-  static constexpr uint32_t PRIORITY_COUNT = MAX_PRIORITY - MIN_PRIORITY + 1;
-  libk::LinkedList<TaskPtr> m_run_queue[PRIORITY_COUNT];
+  uint64_t m_deadline_bandwidth = 0;  // total bandwidth of the deadline tasks
+  uint32_t m_isolated_cores = 0;      // bit i is set if the core i is isolated
+
+  // Indexed by core id.
+  RunQueue m_run_queues[SMP::MAX_CORES];
+  // Indexed by group id minus one, the free ones have the invalid id.
+  TaskGroup m_task_groups[MAX_TASK_GROUPS];
 };  // class Scheduler
@@ -0,0 +1,241 @@
+#include "segment_cache.hpp"
+
+#include <utility>
+
+#include <libk/linked_list.hpp>
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+#include "fs/file.hpp"
+#include "memory/mem_alloc.hpp"
+#include "memory/memory_chunk.hpp"
+
+namespace SegmentCache {
+struct FileEntry {
+  explicit FileEntry(const FileKey& key)
+      : path(copy_path(key.path)), size(key.size), date(key.date), time(key.time) {}
+  ~FileEntry() { kfree(path); }
+
+  // No copy (the path is owned)
+  FileEntry(const FileEntry&) = delete;
+  FileEntry& operator=(const FileEntry&) = delete;
+
+  static char* copy_path(const char* path) {
+    const size_t length = libk::strlen(path);
+    char* copy = (char*)kmalloc(length + 1, alignof(char));
+    if (copy != nullptr)
+      libk::memcpy(copy, path, length + 1);
+    return copy;
+  }
+
+  [[nodiscard]] bool is_same_file(const FileKey& key) const {
+    return path != nullptr && libk::strcmp(path, key.path) == 0;
+  }
+
+  [[nodiscard]] bool is_same_version(const FileKey& key) const {
+    return size == key.size && date == key.date && time == key.time;
+  }
+
+  char* path;
+  uint64_t size;
+  uint16_t date;
+  uint16_t time;
+};  // struct FileEntry
+
+struct Entry : FileEntry {
+  Entry(const FileKey& key, const elf::ProgramHeader* segment, libk::SharedPointer<MemoryChunk> chunk)
+      : FileEntry(key),
+        offset(segment->offset),
+        virtual_addr(segment->virtual_addr),
+        file_size(segment->file_size),
+        mem_size(segment->mem_size),
+        chunk(std::move(chunk)) {}
+
+  [[nodiscard]] bool is_same_segment(const elf::ProgramHeader* segment) const {
+    // The in-page offset of the virtual address is part of the chunk content.
+    return offset == segment->offset && virtual_addr == segment->virtual_addr && file_size == segment->file_size &&
+           mem_size == segment->mem_size;
+  }
+
+  uint64_t offset;
+  uint64_t virtual_addr;
+  uint64_t file_size;
+  uint64_t mem_size;
+  libk::SharedPointer<MemoryChunk> chunk;
+};  // struct Entry
+
+/** The validated headers of a file, so it is not read again if all its segments are cached. */
+struct HeadersEntry : FileEntry {
+  /** The @a program_headers copy is owned by the entry. */
+  HeadersEntry(const FileKey& key, const elf::Header* header, void* program_headers)
+      : FileEntry(key), header(*header), program_headers(program_headers) {}
+  ~HeadersEntry() { kfree(program_headers); }
+
+  elf::Header header;
+  void* program_headers;
+};  // struct HeadersEntry
+
+// There are only a few different programs, a list is enough.
+static libk::LinkedList<Entry> g_entries;
+static libk::LinkedList<HeadersEntry> g_headers;
+
+bool Source::read(uint64_t offset, void* dst, size_t byte_size) const {
+  if (image != nullptr) {
+    libk::memcpy_large(dst, (const uint8_t*)image + offset, byte_size);
+    return true;
+  }
+
+  size_t read_bytes = 0;
+  return file != nullptr && file->seek(offset) && file->read(dst, byte_size, &read_bytes) && read_bytes == byte_size;
+}
+
+bool Source::read(uint64_t offset, MemoryChunk& dst, size_t dst_offset, size_t byte_size) const {
+  if (image != nullptr)
+    return dst.write(dst_offset, (const uint8_t*)image + offset, byte_size) == byte_size;
+
+  return read(offset, (uint8_t*)dst.get() + dst_offset, byte_size);
+}
+
+size_t get_chunk_byte_size(const elf::ProgramHeader* segment) {
+  const auto page_size = MemoryChunk::get_page_byte_size();
+  const bool is_writable = segment->is_writable();
+
+  // The chunk starts at the page containing the segment virtual address.
+  const auto va_start = libk::align_to_previous(segment->virtual_addr, page_size);
+  const auto va_end = segment->virtual_addr + (is_writable ? segment->file_size : segment->mem_size);
+  return libk::align_to_next(va_end, page_size) - va_start;
+}
+
+static libk::SharedPointer<MemoryChunk> load(const Source& source, const elf::ProgramHeader* segment) {
+  const auto page_size = MemoryChunk::get_page_byte_size();
+  const size_t byte_size = get_chunk_byte_size(segment);
+  KASSERT(byte_size > 0);
+
+  // All the bytes are written below, the pages are not zeroed first.
+  auto chunk = libk::make_shared<MemoryChunk>(byte_size / page_size, false);
+  if (!chunk || !chunk->is_status_okay())
+    return nullptr;
+
+  auto* data = (uint8_t*)chunk->get();
+  const size_t data_start = segment->virtual_addr % page_size;
+  const size_t data_end = data_start + segment->file_size;
+
+  libk::bzero(data, data_start);
+  if (segment->file_size > 0 && !source.read(segment->offset, *chunk, data_start, segment->file_size))
+    return nullptr;
+
+  // The end of the last page: the start of the BSS, or the bytes after the segment.
+  libk::bzero(data + data_end, byte_size - data_end);
+  return chunk;
+}
+
+libk::SharedPointer<MemoryChunk> get(const FileKey* key, const Source& source, const elf::ProgramHeader* segment) {
+  if (key == nullptr)
+    return load(source, segment);
+
+  auto it = g_entries.begin();
+  while (it != g_entries.end()) {
+    auto current = it++;
+    if (!current->is_same_file(*key))
+      continue;
+
+    // The file was modified, the old segments are useless now.
+    if (!current->is_same_version(*key)) {
+      g_entries.erase(current);
+      continue;
+    }
+
+    if (current->is_same_segment(segment))
+      return current->chunk;
+  }
+
+  auto chunk = load(source, segment);
+  if (!chunk)
+    return nullptr;
+
+  Entry& entry = g_entries.emplace_back(*key, segment, chunk);
+  if (entry.path == nullptr)
+    LOG_WARNING("[SegmentCache] Unable to cache a segment of {}", key->path);
+
+  return chunk;
+}
+
+size_t shrink(size_t byte_size) {
+  // The chunks still mapped by a process would not be freed. The headers are kept, they are only a few bytes.
+  size_t freed_byte_size = 0;
+  auto it = g_entries.begin();
+  while (freed_byte_size < byte_size && it != g_entries.end()) {
+    auto current = it++;
+    if (!current->chunk.is_unique())
+      continue;
+
+    freed_byte_size += current->chunk->get_byte_size();
+    g_entries.erase(current);
+  }
+
+  return freed_byte_size;
+}
+
+void add_headers(const FileKey& key, const elf::Header* header, const void* program_headers) {
+  const void* cached_program_headers;
+  if (find_headers(key, &cached_program_headers) != nullptr)
+    return;
+
+  const size_t byte_size = elf::get_program_headers_byte_size(header);
+  void* program_headers_copy = kmalloc(byte_size, alignof(elf::ProgramHeader));
+  if (program_headers_copy == nullptr) {
+    LOG_WARNING("[SegmentCache] Unable to cache the headers of {}", key.path);
+    return;
+  }
+
+  libk::memcpy(program_headers_copy, program_headers, byte_size);
+  HeadersEntry& entry = g_headers.emplace_back(key, header, program_headers_copy);
+  if (entry.path == nullptr)
+    LOG_WARNING("[SegmentCache] Unable to cache the headers of {}", key.path);
+}
+
+const elf::Header* find_headers(const FileKey& key, const void** program_headers) {
+  auto it = g_headers.begin();
+  while (it != g_headers.end()) {
+    auto current = it++;
+    if (!current->is_same_file(key))
+      continue;
+
+    // The file was modified, its headers must be read and checked again.
+    if (!current->is_same_version(key)) {
+      g_headers.erase(current);
+      continue;
+    }
+
+    *program_headers = current->program_headers;
+    return &current->header;
+  }
+
+  return nullptr;
+}
+
+bool is_resident(const FileKey& key, const elf::Header* header, const void* program_headers) {
+  for (uint64_t i = 0; i < header->program_header_entry_count; ++i) {
+    const elf::ProgramHeader* segment = elf::get_program_header(header, program_headers, i);
+    if (segment == nullptr)
+      return false;
+
+    if (!segment->is_load() || get_chunk_byte_size(segment) == 0)
+      continue;
+
+    bool is_cached = false;
+    for (const auto& entry : g_entries) {
+      if (entry.is_same_file(key) && entry.is_same_version(key) && entry.is_same_segment(segment)) {
+        is_cached = true;
+        break;
+      }
+    }
+
+    if (!is_cached)
+      return false;
+  }
+
+  return true;
+}
+}  // namespace SegmentCache
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <elf/elf.hpp>
+#include <libk/memory.hpp>
+
+class File;
+class MemoryChunk;
+
+/**
+ * A cache of the loaded segments of the program files, keyed by file and segment.
+ *
+ * Several processes spawned from the same file share the same memory chunks: the read-only
+ * segments are mapped as is, and the writable segments are mapped copy-on-write (so the cached
+ * chunk content is never modified).
+ *
+ * A file is identified by its path and its size and modification timestamp: the segments of
+ * a modified file are loaded again (the processes still running keep the old chunks).
+ *
+ * The validated ELF headers of the files are cached too: a program whose segments are all resident
+ * is spawned again without opening its file (see is_resident()).
+ */
+namespace SegmentCache {
+struct FileKey {
+  const char* path;
+  uint64_t size;
+  uint16_t date;
+  uint16_t time;
+};  // struct FileKey
+
+/** Where the segments data is read from: the program image if it is in memory, otherwise its file. */
+struct Source {
+  const void* image = nullptr;
+  File* file = nullptr;
+
+  /** Copies the @a byte_size bytes at @a offset in the program file into @a dst. */
+  [[nodiscard]] bool read(uint64_t offset, void* dst, size_t byte_size) const;
+  /** Same as read(), into the chunk @a dst at @a dst_offset: the image is copied by DMA, page run by page run. */
+  [[nodiscard]] bool read(uint64_t offset, MemoryChunk& dst, size_t dst_offset, size_t byte_size) const;
+};  // struct Source
+
+/**
+ * Returns the byte size of the chunk holding @a segment, from the page containing its virtual address.
+ *
+ * For the writable segments, the chunk ends with the page holding the last byte read from the file: the
+ * following pages of the BSS are only zeroes, they are left to the caller to be zero filled on demand.
+ * The chunk size may then be 0 (a segment without file data).
+ */
+[[nodiscard]] size_t get_chunk_byte_size(const elf::ProgramHeader* segment);
+
+/**
+ * Gets a memory chunk of get_chunk_byte_size() bytes filled with the data of @a segment (a loadable
+ * segment of the program read from @a source). The data is read straight into the chunk, only the
+ * bytes around it are zeroed.
+ *
+ * If @a key is null, the segment is not cached and a new chunk is always created.
+ * Returns nullptr if out of memory or if the data can not be read.
+ */
+[[nodiscard]] libk::SharedPointer<MemoryChunk> get(const FileKey* key,
+                                                    const Source& source,
+                                                    const elf::ProgramHeader* segment);
+
+/** Evicts the segments not used by any process, the oldest first, until @a byte_size bytes are freed (or there is
+ * none left). Returns the count of bytes freed, see MemoryPressure::Shrinker. */
+size_t shrink(size_t byte_size);
+
+/** Caches a copy of the ELF @a header and @a program_headers (already checked) of the file @a key. */
+void add_headers(const FileKey& key, const elf::Header* header, const void* program_headers);
+
+/**
+ * Returns the cached ELF header of the file @a key and its program header table in @a program_headers,
+ * or nullptr if they are not cached (or the file was modified since).
+ */
+[[nodiscard]] const elf::Header* find_headers(const FileKey& key, const void** program_headers);
+
+/** Checks if the chunks of all the loadable segments of the file @a key are cached. */
+[[nodiscard]] bool is_resident(const FileKey& key, const elf::Header* header, const void* program_headers);
+};  // namespace SegmentCache
@@ -0,0 +1,100 @@
+#include "sync.hpp"
+#include "task.hpp"
+#include "task_manager.hpp"
+
+bool Mutex::is_locked() const {
+  // A task killed while owning the mutex does not keep it locked.
+  return m_owner != nullptr && !m_owner->is_terminated();
+}
+
+bool Mutex::try_lock(const libk::IntrusivePtr<Task>& task) {
+  KASSERT(task != nullptr);
+  KASSERT(m_owner != task && "recursive lock of a mutex");
+
+  if (is_locked())
+    return false;
+
+  m_owner = task;
+  m_owner_priority = task->get_priority();
+
+  // Tasks may still be blocked (they will retry once awaken), the new owner must run
+  // at least as fast as them.
+  inherit_priority(m_wait_list.get_highest_priority());
+  return true;
+}
+
+bool Mutex::lock_or_block(const libk::IntrusivePtr<Task>& task) {
+  if (try_lock(task))
+    return false;
+
+  const uint32_t priority = task->get_priority();
+  m_wait_list.add(task);
+  inherit_priority(priority);
+  return true;
+}
+
+void Mutex::unlock(const libk::IntrusivePtr<Task>& task) {
+  KASSERT(task != nullptr);
+  KASSERT(m_owner == task && "unlocking a mutex not owned");
+
+  // Restore the priority the task had before inheriting one from the blocked tasks.
+  if (task->get_priority() != m_owner_priority)
+    task->get_manager()->set_task_priority(task, m_owner_priority);
+
+  m_owner = nullptr;
+  m_wait_list.wake_one();
+}
+
+void Mutex::inherit_priority(uint32_t priority) {
+  if (m_owner == nullptr || m_owner->is_terminated())
+    return;
+
+  if (priority > m_owner->get_priority())
+    m_owner->get_manager()->set_task_priority(m_owner, priority);
+}
+
+bool Semaphore::try_acquire() {
+  if (m_count == 0)
+    return false;
+
+  m_count--;
+  return true;
+}
+
+bool Semaphore::acquire_or_block(const libk::IntrusivePtr<Task>& task) {
+  KASSERT(task != nullptr);
+
+  if (try_acquire())
+    return false;
+
+  m_wait_list.add(task);
+  return true;
+}
+
+void Semaphore::release(size_t count) {
+  m_count += count;
+  m_wait_list.wake(count);
+}
+
+void ConditionVariable::wait(const libk::IntrusivePtr<Task>& task, Mutex& mutex) {
+  KASSERT(task != nullptr);
+
+  // Block first, so a notification sent by the next mutex owner is not lost.
+  m_wait_list.add(task);
+  mutex.unlock(task);
+}
+
+bool Completion::wait_or_block(const libk::IntrusivePtr<Task>& task) {
+  KASSERT(task != nullptr);
+
+  if (m_completed)
+    return false;
+
+  m_wait_list.add(task);
+  return true;
+}
+
+void Completion::complete() {
+  m_completed = true;
+  m_wait_list.wake_all();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <libk/memory.hpp>
+#include "task/wait_list.hpp"
+
+class Task;
+
+/*
+ * Sleeping synchronization primitives built on top of WaitList.
+ *
+ * Tasks can not be blocked in the middle of kernel code, they are only switched at
+ * exception return. Therefore, the blocking operations follow the same convention
+ * as MessageQueue::block_task_until_not_empty(): they return true if the task was
+ * blocked, in which case the caller (usually a system call) must resubmit the whole
+ * operation once the task is awaken (see step_back_one_inst() in pika_syscalls.cpp). A system call
+ * can avoid this second trap with a continuation (see Task::set_continuation()), completing it at the
+ * context switch to the awaken task.
+ *
+ * All these primitives must be used with the kernel lock held, as is always the case
+ * in exception handlers.
+ */
+
+/**
+ * A sleeping mutex with priority inheritance: while a task of higher priority is
+ * blocked on the mutex, its owner runs with this higher priority. The owner gets back
+ * its original priority when it unlocks the mutex.
+ *
+ * The mutex is not recursive, and the inheritance is not transitive (a task owning
+ * several mutexes gets back its original priority at the first unlock).
+ */
+class Mutex {
+ public:
+  [[nodiscard]] bool is_locked() const;
+  /** Gets the owner of the mutex, or nullptr if it is unlocked. */
+  [[nodiscard]] const libk::IntrusivePtr<Task>& get_owner() const { return m_owner; }
+
+  /** Tries to lock the mutex for @a task without blocking. Returns true on success. */
+  bool try_lock(const libk::IntrusivePtr<Task>& task);
+  /**
+   * Locks the mutex for @a task if it is unlocked, otherwise blocks @a task until
+   * the mutex is unlocked. Returns true if the task was blocked.
+   */
+  bool lock_or_block(const libk::IntrusivePtr<Task>& task);
+  /** Unlocks the mutex owned by @a task and wakes the oldest blocked task. */
+  void unlock(const libk::IntrusivePtr<Task>& task);
+
+ private:
+  void inherit_priority(uint32_t priority);
+
+ private:
+  libk::IntrusivePtr<Task> m_owner;
+  uint32_t m_owner_priority = 0;  // priority of the owner when it locked the mutex
+  WaitList m_wait_list;
+};  // class Mutex
+
+/** A counting semaphore. */
+class Semaphore {
+ public:
+  explicit Semaphore(size_t initial_count = 0) : m_count(initial_count) {}
+
+  [[nodiscard]] size_t get_count() const { return m_count; }
+
+  /** Decrements the semaphore count if it is not zero. Returns true on success. */
+  bool try_acquire();
+  /**
+   * Decrements the semaphore count if it is not zero, otherwise blocks @a task until
+   * the semaphore is released. Returns true if the task was blocked.
+   */
+  bool acquire_or_block(const libk::IntrusivePtr<Task>& task);
+  /** Increments the semaphore count by @a count and wakes as many blocked tasks. */
+  void release(size_t count = 1);
+
+ private:
+  size_t m_count;
+  WaitList m_wait_list;
+};  // class Semaphore
+
+/** A condition variable, to be used together with a Mutex. */
+class ConditionVariable {
+ public:
+  /**
+   * Unlocks @a mutex (owned by @a task) and blocks @a task until notified. Once awaken,
+   * the task must lock again the mutex and check its condition.
+   */
+  void wait(const libk::IntrusivePtr<Task>& task, Mutex& mutex);
+  /** Wakes the oldest task blocked on this condition variable. */
+  void notify_one() { m_wait_list.wake_one(); }
+  /** Wakes all the tasks blocked on this condition variable. */
+  void notify_all() { m_wait_list.wake_all(); }
+
+ private:
+  WaitList m_wait_list;
+};  // class ConditionVariable
+
+/**
+ * A completion: a one-shot event tasks can wait for (e.g. the end of a DMA transfer
+ * or of a thread). Once completed, waiting on it does not block until it is reset.
+ */
+class Completion {
+ public:
+  [[nodiscard]] bool is_completed() const { return m_completed; }
+
+  /** Blocks @a task until the completion is completed. Returns true if the task was blocked. */
+  bool wait_or_block(const libk::IntrusivePtr<Task>& task);
+  /** Marks the completion as completed and wakes all the blocked tasks. */
+  void complete();
+  /** Resets the completion to its initial (not completed) state. */
+  void reset() { m_completed = false; }
+
+ private:
+  bool m_completed = false;
+  WaitList m_wait_list;
+};  // class Completion
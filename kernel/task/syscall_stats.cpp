@@ -0,0 +1,52 @@
+#include "syscall_stats.hpp"
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+#include "hardware/timer.hpp"
+
+static SyscallStats g_global_stats;
+
+SyscallStats& SyscallStats::get_global() {
+  return g_global_stats;
+}
+
+void SyscallStats::record(uint32_t id, uint64_t ticks) {
+  if (id >= MAX_ID)
+    return;
+
+  Entry& entry = m_entries[id];
+  entry.count++;
+  entry.total_ticks += ticks;
+  if (ticks > entry.max_ticks)
+    entry.max_ticks = ticks;
+
+  // The bucket i is for the durations in [2^(i-1), 2^i).
+  const size_t bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+  entry.histogram[bucket < SYS_STATS_HISTOGRAM_SIZE ? bucket : SYS_STATS_HISTOGRAM_SIZE - 1]++;
+}
+
+bool SyscallStats::get(uint32_t id, sys_syscall_stats_t& stats) const {
+  if (id >= MAX_ID)
+    return false;
+
+  const Entry& entry = m_entries[id];
+  stats.count = entry.count;
+  stats.total_ticks = entry.total_ticks;
+  stats.max_ticks = entry.max_ticks;
+  stats.tick_frequency = GenericTimer::get_frequency();
+  libk::memcpy(stats.histogram, entry.histogram, sizeof(stats.histogram));
+  return true;
+}
+
+void SyscallStats::dump() const {
+  const uint64_t frequency = GenericTimer::get_frequency();
+  for (size_t id = 0; id < MAX_ID; ++id) {
+    const Entry& entry = m_entries[id];
+    if (entry.count == 0)
+      continue;
+
+    const uint64_t average_ns = (entry.total_ticks * 1'000'000'000) / (entry.count * frequency);
+    const uint64_t max_ns = (entry.max_ticks * 1'000'000'000) / frequency;
+    LOG_INFO("sys #{}: {} calls, {} ms in total, {} ns on average, {} ns at most", id, entry.count,
+             (entry.total_ticks * 1'000) / frequency, average_ns, max_ns);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "sys/syscall.h"
+
+/**
+ * The count and the durations (in timer ticks, see GenericTimer) of the system calls, per system call ID.
+ * They are kept for each task and globally, see SyscallTable::call_syscall().
+ */
+class SyscallStats {
+ public:
+  /** System calls with a greater (or equal) identifier are not tracked. */
+  static constexpr size_t MAX_ID = 128;
+
+  /** Records a call to the system call @a id that took @a ticks. */
+  void record(uint32_t id, uint64_t ticks);
+
+  /** Fills @a stats with the statistics of the system call @a id. Returns false if @a id is not tracked. */
+  [[nodiscard]] bool get(uint32_t id, sys_syscall_stats_t& stats) const;
+
+  /** Logs the statistics of all the system calls that were called at least once. */
+  void dump() const;
+
+  /** The statistics of the system calls of all the tasks since boot. */
+  [[nodiscard]] static SyscallStats& get_global();
+
+ private:
+  struct Entry {
+    uint64_t count;
+    uint64_t total_ticks;
+    uint64_t max_ticks;
+    uint32_t histogram[SYS_STATS_HISTOGRAM_SIZE];
+  };  // struct Entry
+
+  Entry m_entries[MAX_ID] = {};
+};  // class SyscallStats
@@ -1,19 +1,48 @@
 #include "syscall_table.hpp"
 #include <libk/assert.hpp>
 #include <libk/log.hpp>
+#include "hardware/timer.hpp"
+#include "latency_tracer.hpp"
+#include "syscall_stats.hpp"
+#include "trace.hpp"
 
 SyscallTable::SyscallTable() {
   // Use the default unknown callback for now.
   set_unknown_callback(nullptr);
 }
 
-void SyscallTable::call_syscall(id_t id, Registers& registers) {
+static void record_call(SyscallTable::id_t id, uint64_t start_ticks, SyscallStats* task_stats) {
+  const uint64_t ticks = GenericTimer::get_tick_count() - start_ticks;
+  SyscallStats::get_global().record(id, ticks);
+  if (task_stats != nullptr)
+    task_stats->record(id, ticks);
+}
+
+void SyscallTable::call_syscall(id_t id, Registers& registers, SyscallStats* task_stats) {
+  TRACE_EVENT(SYSCALL_ENTER, id, registers.gp_regs.x0);
+  const uint64_t start_ticks = GenericTimer::get_tick_count();
   if (id >= MAX_ID || m_entries[id] == nullptr) {
     m_unknown_callback(registers);
-    return;
+  } else {
+    LATENCY_TRACE(set_irqs_off_site, (uintptr_t)m_entries[id]);
+    m_entries[id](registers);
   }
 
+  record_call(id, start_ticks, task_stats);
+  TRACE_EVENT(SYSCALL_EXIT, id, registers.gp_regs.x0);
+}
+
+bool SyscallTable::call_fast_syscall(id_t id, Registers& registers, SyscallStats* task_stats) {
+  if (id >= MAX_ID || !m_is_fast[id])
+    return false;
+
+  TRACE_EVENT(SYSCALL_ENTER, id, registers.gp_regs.x0);
+  const uint64_t start_ticks = GenericTimer::get_tick_count();
+  LATENCY_TRACE(set_irqs_off_site, (uintptr_t)m_entries[id]);
   m_entries[id](registers);
+  record_call(id, start_ticks, task_stats);
+  TRACE_EVENT(SYSCALL_EXIT, id, registers.gp_regs.x0);
+  return true;
 }
 
 void SyscallTable::set_unknown_callback(SyscallCallback callback) {
@@ -41,7 +70,16 @@ bool SyscallTable::register_syscall(id_t id, SyscallCallback callback) {
   return true;
 }
 
+bool SyscallTable::register_fast_syscall(id_t id, SyscallCallback callback) {
+  if (!register_syscall(id, callback))
+    return false;
+
+  m_is_fast[id] = true;
+  return true;
+}
+
 void SyscallTable::unregister_syscall(id_t id) {
   KASSERT(id < MAX_ID);
   m_entries[id] = nullptr;
+  m_is_fast[id] = false;
 }
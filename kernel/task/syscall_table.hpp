@@ -4,6 +4,8 @@
 #include <cstdint>
 #include "hardware/regs.hpp"
 
+class SyscallStats;
+
 struct Registers {
   GPRegisters gp_regs;
 
@@ -71,8 +73,11 @@ class SyscallTable {
   /**
    * Calls the kernel callback for the given sys @a id.
    * This effectively dispatch the call using the previously registered mapping.
+   *
+   * The duration of the call is recorded in the global statistics (see SyscallStats::get_global())
+   * and into @a task_stats if not null.
    */
-  void call_syscall(id_t id, Registers& registers);
+  void call_syscall(id_t id, Registers& registers, SyscallStats* task_stats = nullptr);
 
   /**
    * Provides a callback to be used when an unknown system call is called.
@@ -94,6 +99,22 @@ class SyscallTable {
    */
   bool register_syscall(id_t id, SyscallCallback callback);
 
+  /**
+   * Same as register_syscall() but the sys is dispatched by the fast path of the system calls: only the
+   * registers the AAPCS lets the kernel code clobber (x0 to x18, x30, ELR and SPSR) are saved and the
+   * context switcher is skipped.
+   *
+   * Therefore, @a callback must not block, reschedule or kill the current task, and must only read the
+   * arguments registers (the other fields of the Registers structure are undefined).
+   */
+  bool register_fast_syscall(id_t id, SyscallCallback callback);
+
+  /**
+   * Calls the kernel callback for the given sys @a id if it was registered by register_fast_syscall().
+   * Returns false (and does nothing) otherwise, the sys then goes through the regular path.
+   */
+  [[nodiscard]] bool call_fast_syscall(id_t id, Registers& registers, SyscallStats* task_stats = nullptr);
+
   /**
    * Unregisters a previously registered sys handler for @a id.
    *
@@ -104,4 +125,5 @@ class SyscallTable {
  private:
   SyscallCallback m_unknown_callback = nullptr;
   SyscallCallback m_entries[MAX_ID] = {nullptr};
+  bool m_is_fast[MAX_ID] = {false};
 };  // class SyscallTable
@@ -2,13 +2,20 @@
 #include <algorithm>
 #include "task_manager.hpp"
 
+#include <libk/object_cache.hpp>
 #include "fs/filesystem.hpp"
+#include "hardware/fpu.hpp"
+#include "hardware/irq/irq_manager.hpp"
+#include "hardware/smp.hpp"
+#include "io_ring.hpp"
+#include "memory/mem_alloc.hpp"
+#include "net/udp_socket.hpp"
 #include "wm/window.hpp"
 #include "wm/window_manager.hpp"
 
 void TaskSavedState::save(const Registers& current_regs) {
+  // The FPU registers are switched lazily, see fpu.hpp.
   gp_regs = current_regs.gp_regs;
-  fpu_regs.save();
   pc = current_regs.elr;
 
   // Save the stack pointer.
@@ -17,7 +24,6 @@ void TaskSavedState::save(const Registers& current_regs) {
 
 void TaskSavedState::restore(Registers& current_regs) {
   current_regs.gp_regs = gp_regs;
-  fpu_regs.restore();
   current_regs.elr = pc;
 
   if (is_kernel) {
@@ -30,104 +36,153 @@ void TaskSavedState::restore(Registers& current_regs) {
   // Restore the stack pointer.
   asm volatile("msr SP_EL0, %0" : : "r"(sp));
 
+  // A kernel task does not keep the table of the previous process, which may be freed meanwhile (see
+  // TaskManager::reap_task()).
   if (memory)
     memory->activate();
+  else
+    ProcessMemory::deactivate();
+}
+
+// The slots of the object cache are cache line aligned, so are the groups of members of Task.
+static_assert(alignof(Task) == SMP::CACHE_LINE_SIZE);
+static libk::ObjectCache<Task> g_task_cache;
+
+void* Task::operator new(size_t size) {
+  KASSERT(size == sizeof(Task));
+  return g_task_cache.allocate();
+}
+
+void Task::operator delete(void* ptr) {
+  g_task_cache.deallocate(ptr);
 }
 
 Task::~Task() {
+  // The scheduler run queues do not own the tasks they link.
+  KASSERT(!m_run_queue_hook.is_linked());
   free_resources();
+  FPU::release(this);
+
+  // The task is not running anymore, its kernel stack is not used.
+  if (m_kernel_stack != nullptr)
+    kfree(m_kernel_stack);
 }
 
 TaskPtr Task::current() {
   return TaskManager::get().get_current_task();
 }
 
-bool Task::own_window(Window* window) const {
-  if (window == nullptr)
-    return false;
-
-  auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  return it != m_windows.end();
+SyscallStats* Task::get_syscall_stats() {
+  if (m_syscall_stats == nullptr)
+    m_syscall_stats = libk::make_scoped<SyscallStats>();
+  return m_syscall_stats.get();
 }
 
-void Task::register_window(Window* window) {
+Handle Task::register_window(Window* window) {
   KASSERT(window != nullptr && window->get_task().get() == this);
-  m_windows.push_back(window);
+  return m_windows.insert(window);
 }
 
-void Task::unregister_window(Window* window) {
-  KASSERT(window != nullptr && window->get_task().get() == this);
+void Task::unregister_window(Handle handle) {
+  Window* window = m_windows.remove(handle);
+  KASSERT(window != nullptr);
+}
 
-  auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  KASSERT(it != m_windows.end());
-  m_windows.erase(it);
+Handle Task::register_window_timer(WindowTimer* timer) {
+  return m_window_timers.insert(timer);
 }
 
-bool Task::own_file(File* file) const {
-  if (file == nullptr)
-    return false;
+void Task::unregister_window_timer(Handle handle) {
+  WindowTimer* timer = m_window_timers.remove(handle);
+  KASSERT(timer != nullptr);
+}
 
-  auto it = std::find(m_open_files.begin(), m_open_files.end(), file);
-  return it != m_open_files.end();
+Handle Task::register_file(File* file) {
+  return m_open_files.insert(file);
 }
 
-void Task::register_file(File* file) {
+void Task::unregister_file(Handle handle) {
+  File* file = m_open_files.remove(handle);
   KASSERT(file != nullptr);
+}
 
-  m_open_files.push_back(file);
+Handle Task::register_dir(Dir* dir) {
+  return m_open_dirs.insert(dir);
 }
 
-void Task::unregister_file(File* file) {
-  KASSERT(file != nullptr);
+void Task::unregister_dir(Handle handle) {
+  Dir* dir = m_open_dirs.remove(handle);
+  KASSERT(dir != nullptr);
+}
 
-  auto it = std::find(m_open_files.begin(), m_open_files.end(), file);
-  KASSERT(it != m_open_files.end());
-  m_open_files.erase(it);
+Handle Task::register_channel(Channel::Endpoint* endpoint) {
+  return m_channels.insert(endpoint);
 }
 
-bool Task::own_dir(Dir* dir) const {
-  if (dir == nullptr)
-    return false;
+void Task::unregister_channel(Handle handle) {
+  Channel::Endpoint* endpoint = m_channels.remove(handle);
+  KASSERT(endpoint != nullptr);
+}
 
-  auto it = std::find(m_open_dirs.begin(), m_open_dirs.end(), dir);
-  return it != m_open_dirs.end();
+Handle Task::register_udp_socket(UdpSocket* socket) {
+  return m_udp_sockets.insert(socket);
 }
 
-void Task::register_dir(Dir* dir) {
-  KASSERT(dir != nullptr);
+void Task::unregister_udp_socket(Handle handle) {
+  UdpSocket* socket = m_udp_sockets.remove(handle);
+  KASSERT(socket != nullptr);
+}
 
-  m_open_dirs.push_back(dir);
+void Task::remove_mapped_chunk(MemoryChunk* chunk) {
+  auto it = std::find_if(m_mapped_chunks.begin(), m_mapped_chunks.end(),
+                         [chunk](const auto& mapped_chunk) { return mapped_chunk.get() == chunk; });
+  KASSERT(it != m_mapped_chunks.end());
+  m_mapped_chunks.erase(it);
 }
 
-void Task::unregister_dir(Dir* dir) {
-  KASSERT(dir != nullptr);
+void Task::wake_from_sleep(void* task) {
+  const TaskPtr sleepy = std::move(((Task*)task)->m_sleeping_self);
 
-  auto it = std::find(m_open_dirs.begin(), m_open_dirs.end(), dir);
-  KASSERT(it != m_open_dirs.end());
-  m_open_dirs.erase(it);
+  // The task may have been killed while sleeping.
+  if (!sleepy->is_terminated())
+    sleepy->get_manager()->wake_task(sleepy);
+}
+
+void Task::run_deferred_preemption() {
+  m_need_resched = false;
+  // As for a wakeup from a kernel task (see Scheduler::reschedule_if_needed()), the core interrupts itself:
+  // the IPI is taken at once, or when the current exception returns, and reschedules.
+  IRQManager::send_ipi(SMP::get_core_id());
 }
 
 void Task::free_resources() {
-  // Destroy the windows.
+  // Destroy the windows (which unregisters them and their timers).
   auto& window_manager = WindowManager::get();
-  for (auto* window : m_windows) {
-    window_manager.destroy_window(window);
-  }
+  m_windows.for_each([&window_manager](Handle, Window* window) { window_manager.destroy_window(window); });
 
-  m_windows.clear();
+  // Stop the asynchronous I/O first, they use the open files and dirs.
+  if (m_io_ring != nullptr) {
+    m_io_ring->close();
+    m_io_ring = nullptr;
+  }
 
   // Free all open files.
   auto& fs = FileSystem::get();
-  for (auto* file : m_open_files) {
-    fs.close(file);
-  }
-
+  m_open_files.for_each([&fs](Handle, File* file) { fs.close(file); });
   m_open_files.clear();
 
   // Free all open dirs.
-  for (auto* dir : m_open_dirs) {
-    fs.close_dir(dir);
-  }
-
+  m_open_dirs.for_each([&fs](Handle, Dir* dir) { fs.close_dir(dir); });
   m_open_dirs.clear();
+
+  // Close the channels, which unmaps their memory (still alive).
+  m_channels.for_each([](Handle, Channel::Endpoint* endpoint) { Channel::close(*endpoint); });
+  m_channels.clear();
+
+  // Close the UDP sockets, which unmaps their memory too.
+  m_udp_sockets.for_each([](Handle, UdpSocket* socket) { UdpSocket::close(socket); });
+  m_udp_sockets.clear();
+
+  // Unmap the thread stack from the shared memory.
+  m_thread_stack.reset();
 }
@@ -1,10 +1,22 @@
 #pragma once
 
 #include <cstdint>
+#include <utility>
+#include <libk/intrusive_list.hpp>
 #include <libk/memory.hpp>
+#include <libk/small_vector.hpp>
 #include "hardware/regs.hpp"
+#include "hardware/smp.hpp"
+#include "latency_tracer.hpp"
 #include "memory/process_memory.hpp"
+#include "task/channel.hpp"
+#include "task/handle_table.hpp"
+#include "task/sync.hpp"
+#include "task/syscall_stats.hpp"
 #include "task/syscall_table.hpp"
+#include "task/timers.hpp"
+
+struct TaskGroup;
 
 struct TaskSavedState {
   GPRegisters gp_regs;
@@ -18,15 +30,39 @@ struct TaskSavedState {
   void restore(Registers& current_regs);
 };  // struct TaskSavedState
 
+/** The parameters of a task of the deadline scheduling class (see Scheduler), in microseconds. */
+struct DeadlineParams {
+  /** The CPU time the task may use in each period, 0 if the task is not in the deadline class. */
+  uint64_t runtime = 0;
+  uint64_t period = 0;
+  /** Relative to the start of each period, the runtime is used before it. */
+  uint64_t deadline = 0;
+};  // struct DeadlineParams
+
+/** The cumulative CPU usage of a task. The times are in timer ticks (see GenericTimer::get_tick_count()). */
+struct TaskCpuStats {
+  uint64_t user_ticks = 0;
+  uint64_t system_ticks = 0;
+  /** Switched out because it blocked or yielded. */
+  uint64_t voluntary_switches = 0;
+  /** Switched out by a preemption. */
+  uint64_t involuntary_switches = 0;
+  /** Demand paging and copy-on-write faults. */
+  uint64_t page_faults = 0;
+};  // struct TaskCpuStats
+
 class TaskManager;
 class Window;
 class File;
 class Dir;
+class IoRing;
+class UdpSocket;
+class WindowTimer;
 
 /**
  * Represents a runnable task in the system. This can be a user process, a thread, etc.
  */
-class Task {
+class Task : public libk::RefCounted {
  public:
   using id_t = uint32_t;
 
@@ -53,8 +89,12 @@ class Task {
 
   ~Task();
 
+  /** Tasks are allocated from a dedicated object cache rather than the general kernel heap. */
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   /** Gets the current active (running) task. This forward to TaskManager::get_current_task(). */
-  [[nodiscard]] static libk::SharedPointer<Task> current();
+  [[nodiscard]] static libk::IntrusivePtr<Task> current();
 
   /** Gets the task identifier (process id). */
   [[nodiscard]] id_t get_id() const { return m_id; }
@@ -72,6 +112,12 @@ class Task {
 
   /** Gets the task priority for scheduling. The larger it is, the higher the process priority. */
   [[nodiscard]] uint32_t get_priority() const { return m_priority; }
+  [[nodiscard]] const DeadlineParams& get_deadline_params() const { return m_deadline_params; }
+  /** Gets the group sharing the CPU bandwidth quota of the task, or nullptr if none (see TaskGroup). */
+  [[nodiscard]] TaskGroup* get_group() const { return m_group; }
+  /** Gets the cores the task may run on, bit i for the core i (see TaskManager::set_task_affinity()). */
+  [[nodiscard]] uint32_t get_affinity() const { return m_affinity; }
+  [[nodiscard]] bool is_allowed_on(size_t core_id) const { return (m_affinity & ((uint32_t)1 << core_id)) != 0; }
 
   /** Gets the task manager that that ownership over this task. */
   [[nodiscard]] TaskManager* get_manager() { return m_manager; }
@@ -83,7 +129,17 @@ class Task {
   [[nodiscard]] const Task* get_parent() const { return m_parent; }
 
   [[nodiscard]] auto children_begin() const { return m_children.begin(); }
-  [[nodiscard]] auto children_end() const { return m_children.begin(); }
+  [[nodiscard]] auto children_end() const { return m_children.end(); }
+
+  /** Returns true if the task is a thread of another task (its parent), sharing its memory. */
+  [[nodiscard]] bool is_thread() const { return m_is_thread; }
+  /** Returns true if the task runs in the kernel (in EL1). */
+  [[nodiscard]] bool is_kernel() const { return m_is_kernel; }
+
+  /** Gets the exit code of the task, only meaningful once it is terminated. */
+  [[nodiscard]] int get_exit_code() const { return m_exit_code; }
+  /** Gets the completion that is completed when the task is terminated. */
+  [[nodiscard]] Completion& get_exit_completion() { return m_exit_completion; }
 
   /** Gets the task saved execution state. This is all the data needed to do context switch. */
   [[nodiscard]] TaskSavedState& get_saved_state() { return m_saved_state; }
@@ -92,8 +148,34 @@ class Task {
   /** Gets the task virtual memory. */
   [[nodiscard]] libk::SharedPointer<ProcessMemory> get_memory() const { return m_saved_state.memory; }
 
-  /** Forward to `get_syscall_table()->call_syscall(id, registers)`. */
-  void call_syscall(uint32_t id, Registers& registers) { m_syscall_table->call_syscall(id, registers); }
+  /** Forward to `get_syscall_table()->call_syscall(id, registers)`, recording it in the task statistics. */
+  void call_syscall(uint32_t id, Registers& registers) {
+    m_syscall_table->call_syscall(id, registers, get_syscall_stats());
+  }
+  /** Forward to `get_syscall_table()->call_fast_syscall(id, registers)`, recording it in the task statistics. */
+  [[nodiscard]] bool call_fast_syscall(uint32_t id, Registers& registers) {
+    return m_syscall_table->call_fast_syscall(id, registers, get_syscall_stats());
+  }
+  /** Gets the statistics of the system calls made by this task (allocated on the first call), or nullptr if
+   * out of memory. */
+  [[nodiscard]] SyscallStats* get_syscall_stats();
+
+  [[nodiscard]] TaskCpuStats& get_cpu_stats() { return m_cpu_stats; }
+  [[nodiscard]] const TaskCpuStats& get_cpu_stats() const { return m_cpu_stats; }
+
+  /** Charges the time since the task last left the kernel (at @a now, in timer ticks) to its user time if
+   * it comes from user space, or to its system time otherwise (e.g. a kernel task). */
+  void account_kernel_entry(bool from_user, uint64_t now) {
+    (from_user ? m_cpu_stats.user_ticks : m_cpu_stats.system_ticks) += now - m_accounting_time;
+    m_accounting_time = now;
+  }
+  /** Charges the time spent in the kernel since account_kernel_entry() to the task system time. */
+  void account_kernel_exit(uint64_t now) {
+    m_cpu_stats.system_ticks += now - m_accounting_time;
+    m_accounting_time = now;
+  }
+  /** Starts the accounting of a task switched in at @a now, the time it was switched out is not counted. */
+  void start_accounting(uint64_t now) { m_accounting_time = now; }
   /** Gets the task syscall table. */
   [[nodiscard]] SyscallTable* get_syscall_table() { return m_syscall_table; }
   [[nodiscard]] const SyscallTable* get_syscall_table() const { return m_syscall_table; }
@@ -105,53 +187,166 @@ class Task {
   [[nodiscard]] bool is_marked_to_be_killed() const { return m_marked_kill; }
   void mark_to_be_killed() { m_marked_kill = true; }
 
-  [[nodiscard]] bool own_window(Window* window) const;
-  void register_window(Window* window);
-  void unregister_window(Window* window);
+  /** Completes the system call which blocked the task, once it is awaken: called at the context switch to
+   * the task, its registers being restored into @a regs and its memory active. It returns false if the
+   * system call must be submitted again instead (the SVC instruction is then executed again). */
+  using Continuation = bool (*)(Registers& regs, void* context);
+  /** Sets the continuation of the system call blocking the task, so it resumes without a new trap. */
+  void set_continuation(Continuation continuation, void* context) {
+    m_continuation = continuation;
+    m_continuation_context = context;
+  }
+  /** Runs and clears the continuation of the task, if any. Returns true if it completed its system call. */
+  bool run_continuation(Registers& regs) {
+    const Continuation continuation = m_continuation;
+    m_continuation = nullptr;
+    return continuation != nullptr && continuation(regs, m_continuation_context);
+  }
+
+  /** Gets the window of @a handle, or nullptr if it is not a window handle of this task. */
+  [[nodiscard]] Window* get_window(Handle handle) const { return m_windows.get(handle); }
+  /** Gives a handle to @a window, or returns INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle register_window(Window* window);
+  void unregister_window(Handle handle);
+
+  /** Gets the window timer of @a handle, or nullptr if it is not a timer handle of this task. */
+  [[nodiscard]] WindowTimer* get_window_timer(Handle handle) const { return m_window_timers.get(handle); }
+  /** Gives a handle to @a timer, or returns INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle register_window_timer(WindowTimer* timer);
+  void unregister_window_timer(Handle handle);
 
-  [[nodiscard]] bool own_file(File* file) const;
-  void register_file(File* file);
-  void unregister_file(File* file);
+  /** Gets the open file of @a handle, or nullptr if it is not a file handle of this task. */
+  [[nodiscard]] File* get_file(Handle handle) const { return m_open_files.get(handle); }
+  /** Gives a handle to @a file, or returns INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle register_file(File* file);
+  void unregister_file(Handle handle);
 
-  [[nodiscard]] bool own_dir(Dir* dir) const;
-  void register_dir(Dir* dir);
-  void unregister_dir(Dir* dir);
+  /** Gets the open dir of @a handle, or nullptr if it is not a dir handle of this task. */
+  [[nodiscard]] Dir* get_dir(Handle handle) const { return m_open_dirs.get(handle); }
+  /** Gives a handle to @a dir, or returns INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle register_dir(Dir* dir);
+  void unregister_dir(Handle handle);
 
+  /** Gets the channel endpoint of @a handle, or nullptr if it is not a channel handle of this task. */
+  [[nodiscard]] Channel::Endpoint* get_channel(Handle handle) const { return m_channels.get(handle); }
+  /** Gives a handle to @a endpoint, or returns INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle register_channel(Channel::Endpoint* endpoint);
+  void unregister_channel(Handle handle);
+
+  /** Gets the UDP socket of @a handle, or nullptr if it is not a socket handle of this task. */
+  [[nodiscard]] UdpSocket* get_udp_socket(Handle handle) const { return m_udp_sockets.get(handle); }
+  /** Gives a handle to @a socket, or returns INVALID_HANDLE if out of memory. */
+  [[nodiscard]] Handle register_udp_socket(UdpSocket* socket);
+  void unregister_udp_socket(Handle handle);
+
+  /** Keeps @a chunk alive while the task is, it is mapped into the task memory. */
+  void add_mapped_chunk(const libk::SharedPointer<MemoryChunk>& chunk) { m_mapped_chunks.push_back(chunk); }
+  /** Releases a chunk previously given to add_mapped_chunk() (once unmapped). */
+  void remove_mapped_chunk(MemoryChunk* chunk);
+
+  /** Gets the asynchronous file I/O ring of the process, or nullptr if it has not set up one. */
+  [[nodiscard]] IoRing* get_io_ring() const { return m_io_ring; }
+  void set_io_ring(IoRing* io_ring) { m_io_ring = io_ring; }
+
+  /**
+   * The preemption is disabled while the task runs a non-reentrant section, e.g. while a kernel task holds the
+   * kernel lock. A preemption requested meanwhile (by the tick or a wakeup) is not lost: it is deferred until
+   * the section ends, see enable_preempt().
+   */
   [[nodiscard]] bool can_preempt() const { return m_preempt_count == 0; }
-  void disable_preempt() { m_preempt_count++; }
+  void disable_preempt() {
+    if (m_preempt_count++ == 0)
+      LATENCY_TRACE(preempt_off);
+  }
   void enable_preempt() {
     m_preempt_count--;
     KASSERT(m_preempt_count >= 0);
+    if (m_preempt_count == 0)
+      LATENCY_TRACE(preempt_on);
+    if (m_preempt_count == 0 && m_need_resched)
+      run_deferred_preemption();
   }
+  /** Called by the scheduler when it could not preempt the task, which is then preempted by enable_preempt(). */
+  void defer_preemption() { m_need_resched = true; }
+  /** Consumes the resumption point of an interrupted system call, see pika_syscalls.cpp. Returns 0 if its last
+   * run was not interrupted (or if it is not a resumable system call). */
+  [[nodiscard]] uint64_t take_syscall_progress() { return std::exchange(m_syscall_progress, 0); }
+  void set_syscall_progress(uint64_t progress) { m_syscall_progress = progress; }
 
  private:
   void free_resources();
+  void run_deferred_preemption();
+  /** The callback of the sleep timer of @a task (see TaskManager::sleep_task()). */
+  static void wake_from_sleep(void* task);
 
  private:
   friend class TaskManager;
   friend class Scheduler;
+  friend struct TaskGroup;
 
-  id_t m_id;
+  // The members are grouped by cache line, the scheduler mostly touching the first one (with the reference count
+  // of RefCounted) at each tick and switch: the scheduling state and the run queue hook.
   State m_state = State::INTERRUPTIBLE;
+  bool m_is_throttled = false;  // taken out of the run queues by the throttling of m_group?
+  bool m_need_resched = false;  // a preemption was deferred by m_preempt_count?
+  bool m_marked_kill = false;   // is the task marked to be called at the next context switch?
+  bool m_is_kernel = false;     // it is a kernel stack (in EL1)?
+  bool m_is_thread = false;     // does the task share the memory of its parent?
   uint32_t m_priority = 0;
-  TaskSavedState m_saved_state;
-  const char* m_name = nullptr;
+  int m_preempt_count = 0;
+  uint32_t m_affinity = UINT32_MAX;  // bit i is set if the task may run on the core i
+  uint32_t m_core = 0;               // the core whose run queue holds (or last held) the task
+  uint32_t m_elapsed_ticks = 0;      // in the current time slice
+  uint64_t m_vruntime = 0;                   // weighted run time, for the fair scheduling class
+  libk::IntrusiveListHook m_run_queue_hook;  // links inside the scheduler run queue
+
+  // The CPU time charging, the task group and the deadline scheduling class.
+  alignas(SMP::CACHE_LINE_SIZE) uint64_t m_run_start_time = 0;  // when last switched in or charged (in us)
+  TaskGroup* m_group = nullptr;
+  DeadlineParams m_deadline_params;
+  uint64_t m_deadline = 0;             // absolute deadline of the current period (in us)
+  uint64_t m_deadline_period_end = 0;  // (in us)
+  int64_t m_deadline_budget = 0;       // runtime left in the current period (in us)
+
+  // The context switch and the kernel entries and exits.
+  alignas(SMP::CACHE_LINE_SIZE) TaskSavedState m_saved_state;
+  uint64_t m_accounting_time = 0;  // when the task last entered or left the kernel (in timer ticks)
+  TaskCpuStats m_cpu_stats;
   SyscallTable* m_syscall_table = nullptr;
+  uint64_t m_syscall_progress = 0;  // see take_syscall_progress()
+  Continuation m_continuation = nullptr;
+  void* m_continuation_context = nullptr;
+
+  // The cold members, only used when the task is created, blocks, exits or uses its resources.
+  id_t m_id;
+  const char* m_name = nullptr;
   TaskManager* m_manager = nullptr;
-  uint64_t m_elapsed_ticks = 0;
-  bool m_is_kernel = false;    // it is a kernel stack (in EL1)?
-  bool m_marked_kill = false;  // is the task marked to be called at the next context switch?
-  int m_preempt_count = 0;
+  libk::IntrusiveListHook m_group_hook;  // links inside the tasks of m_group
+  libk::IntrusiveListHook m_reap_hook;   // links inside the killed tasks to reap by the task manager
+  HrTimer m_sleep_timer{&Task::wake_from_sleep, this};
+  libk::IntrusivePtr<Task> m_sleeping_self;  // keeps the task alive while its sleep timer is pending
+  int m_exit_code = 0;
+  Completion m_exit_completion;
+
+  // Stacks: kernel tasks have their own kernel stack, threads have a stack mapped in the shared memory.
+  void* m_kernel_stack = nullptr;
+  libk::ScopedPointer<MemoryChunk> m_thread_stack;
+
+  libk::ScopedPointer<SyscallStats> m_syscall_stats;
 
   // Parent-children relationship.
   Task* m_parent = nullptr;  // not a SharedPointer to avoid cyclic dependencies
-  libk::LinkedList<libk::SharedPointer<Task>> m_children;
+  libk::LinkedList<libk::IntrusivePtr<Task>> m_children;
 
-  // Task resources
-  libk::LinkedList<Window*> m_windows;
-  libk::LinkedList<File*> m_open_files;
-  libk::LinkedList<Dir*> m_open_dirs;
-  libk::LinkedList<MemoryChunk> m_mapped_chunks;
+  // Task resources, the userspace only sees their handles.
+  HandleTable<Window> m_windows;
+  HandleTable<WindowTimer> m_window_timers;  // owned by their windows
+  HandleTable<File> m_open_files;
+  HandleTable<Dir> m_open_dirs;
+  HandleTable<Channel::Endpoint> m_channels;
+  HandleTable<UdpSocket> m_udp_sockets;
+  IoRing* m_io_ring = nullptr;  // its worker uses the files and dirs above
+  libk::SmallVector<libk::SharedPointer<MemoryChunk>, 4> m_mapped_chunks;  // may be shared by several processes
 };  // class Task
 
-using TaskPtr = libk::SharedPointer<Task>;
+using TaskPtr = libk::IntrusivePtr<Task>;
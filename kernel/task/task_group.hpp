@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <libk/intrusive_list.hpp>
+#include "task/task.hpp"
+#include "task/timers.hpp"
+
+/**
+ * A group of tasks sharing a CPU bandwidth quota, as the CFS bandwidth control of Linux: together, the tasks of
+ * the group run at most `quota` microseconds (summed over all the cores) in each `period`. Once the quota is used,
+ * the tasks of the group are throttled (taken out of the run queues) until the next period starts.
+ *
+ * The usage is charged by the tick of the cores (see Scheduler::tick()), so the quota is enforced with the
+ * resolution of a tick. A new period starts once the previous one is over and a task of the group runs again.
+ * The groups are owned by the Scheduler, a task joins the group of its parent when created (see
+ * TaskManager::create_task()) unless the group is given when spawned (see sys_spawn_in_group()).
+ */
+struct TaskGroup {
+  using id_t = uint32_t;
+
+  /** Never the id of a group, a task without group (the default) is never throttled. */
+  static constexpr id_t INVALID_ID = 0;
+
+  id_t id = INVALID_ID;     // INVALID_ID if this slot of the Scheduler is free
+  uint64_t quota = 0;       // (in us)
+  uint64_t period = 0;      // (in us)
+  uint64_t runtime = 0;     // used in the current period (in us)
+  uint64_t period_end = 0;  // (in us)
+  uint64_t throttled_count = 0;
+  bool is_throttled = false;
+  libk::IntrusiveList<Task, &Task::m_group_hook> tasks;
+  HrTimer period_timer{&TaskGroup::end_period, this};  // armed while throttled
+
+  /** The callback of period_timer, unthrottles the group (see Scheduler::unthrottle_task_group()). */
+  static void end_period(void* group);
+};  // struct TaskGroup
@@ -1,75 +1,234 @@
 #include "task_manager.hpp"
+#include "dynamic_loader.hpp"
 #include "fs/fat/ff.h"
+#include "fs/filesystem.hpp"
+#include "hardware/fpu.hpp"
 #include "hardware/interrupts.hpp"
-#include "hardware/system_timer.hpp"
+#include "hardware/kernel_dt.hpp"
+#include "hardware/kernel_lock.hpp"
+#include "hardware/irq/irq_lists.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "memory/demand_paging.hpp"
+#include "memory/kernel_internal_memory.hpp"
 #include "memory/mem_alloc.hpp"
 #include "pika_syscalls.hpp"
+#include "profiler.hpp"
+#include "sys/syscall.h"
 #include "wm/window_manager.hpp"
 
 #include <libk/log.hpp>
+#include <libk/string.hpp>
 
 TaskManager* TaskManager::g_instance = nullptr;
 
-TaskManager::TaskManager() : m_delta_queue(this) {
+/** Parses the cores to isolate (bit i for the core i) from the boot option `isolcpus=<core>[,<core>...]` of the
+ * kernel command line (cmdline.txt, passed by the firmware in the device tree). */
+static uint32_t parse_isolated_cores() {
+  Property bootargs = {};
+  if (!KernelDT::find_property("/chosen/bootargs", &bootargs))
+    return 0;
+
+  const auto cmdline = bootargs.get_string();
+  if (!cmdline.has_value())
+    return 0;
+
+  const libk::StringView args = cmdline.get_value();
+  const libk::StringView option = "isolcpus=";
+  const size_t start = args.find(option);
+  if (start == libk::StringView::npos)
+    return 0;
+
+  uint32_t core_mask = 0;
+  for (size_t i = start + option.get_length(); i < args.get_length() && args[i] != ' '; ++i) {
+    if (args[i] >= '0' && args[i] < '0' + (char)SMP::MAX_CORES)
+      core_mask |= (uint32_t)1 << (args[i] - '0');
+  }
+
+  return core_mask;
+}
+
+TaskManager::TaskManager() {
   KASSERT(g_instance == nullptr && "multiple task manager created");
   g_instance = this;
 
   m_default_syscall_table = create_pika_syscalls();
   m_scheduler = libk::make_scoped<Scheduler>();
 
-  // Select a timer and start the tick clock for the scheduler.
-  bool timer_found = false;
-  for (size_t timer_id = 0; timer_id < SystemTimer::nb_timers; ++timer_id) {
-    if (SystemTimer::is_used(timer_id))
-      continue;
+  // Before any task is created, they get the default affinity.
+  m_scheduler->set_isolated_cores(parse_isolated_cores());
+  if (m_scheduler->get_isolated_cores() != 0)
+    LOG_INFO("Isolated cores: {:#x}", m_scheduler->get_isolated_cores());
+
+  // Each core has its own idle task, run when there is nothing else to do.
+  // It prepares zeroed pages for the demand paging and the page tables before sleeping.
+  for (size_t core_id = 0; core_id < SMP::MAX_CORES; ++core_id) {
+    auto idle_task = create_kernel_task([]() {
+      while (true) {
+        bool pool_full;
+        {
+          KernelTaskLockGuard kernel_lock;
+          pool_full = DemandPaging::refill_pool() && memory_impl::refill_table_cache();
+        }
+
+        if (pool_full)
+          libk::wfi();
+      }
+    });
 
-    if (SystemTimer::set_recurrent_ms(timer_id, TICK_TIME, []() { TaskManager::get().tick(); })) {
-      LOG_INFO("System timer {} used for scheduler with tick time {} ms", timer_id, TICK_TIME);
-      timer_found = true;
-      break;
-    }
+    KASSERT(idle_task != nullptr);
+    idle_task->m_priority = Scheduler::MIN_PRIORITY;
+    idle_task->m_state = Task::State::RUNNING;
+    idle_task->m_affinity = (uint32_t)1 << core_id;
+    m_scheduler->set_idle_task(core_id, idle_task);
   }
 
-  if (!timer_found) {
-    LOG_CRITICAL("Not found an available system timer for the scheduler");
-    return;
-  }
+  m_irq_work_queue = libk::make_scoped<WorkQueue>(Scheduler::MAX_PRIORITY);
+
+  auto reaper_task = create_kernel_task(&TaskManager::run_reaper, this);
+  KASSERT(reaper_task != nullptr);
+  wake_task(reaper_task);
+
+  // The scheduler tick and the wake up of the sleeping tasks are driven by the generic timers of the
+  // cores, leaving the system timer channels to the drivers.
+  LOG_INFO("Scheduler tick time is {} ms", TICK_TIME);
 }
 
-TaskPtr TaskManager::create_task_common(bool is_kernel, Task* parent) {
-  auto task = libk::make_shared<Task>();
+namespace {
+/** An ELF file opened to be loaded (a program or a shared library), closed when destroyed. */
+struct ElfFile {
+  File* file = nullptr;
+  SegmentCache::FileKey key = {};
+  SegmentCache::Source source;
+  const elf::Header* header = nullptr;
+  const void* program_headers = nullptr;
+
+  elf::Header header_copy;
+  void* program_headers_copy = nullptr;
+
+  ElfFile() = default;
+  ElfFile(const ElfFile&) = delete;
+  ElfFile& operator=(const ElfFile&) = delete;
+
+  ~ElfFile() {
+    kfree(program_headers_copy);
+    if (file != nullptr)
+      FileSystem::get().close(file);
+  }
+
+  /** Opens the file at @a path and reads its headers. Returns false if it is not a valid ELF file. */
+  bool open(const char* path) {
+    // The file timestamp identifies its version in the segment cache.
+    FILINFO file_info;
+    if (f_stat(path, &file_info) != FR_OK)
+      return false;
+
+    key = {path, file_info.fsize, file_info.fdate, file_info.ftime};
+
+    // A program spawned again: if all its segments are still cached, the file is not even opened.
+    const void* cached_program_headers;
+    if (const elf::Header* cached_header = SegmentCache::find_headers(key, &cached_program_headers);
+        cached_header != nullptr && SegmentCache::is_resident(key, cached_header, cached_program_headers)) {
+      header = cached_header;
+      program_headers = cached_program_headers;
+      return true;
+    }
+
+    file = FileSystem::get().open(path, SYS_FM_READ);
+    if (file == nullptr)
+      return false;
+
+    // The file is usually stored contiguously in the ramdisk, it is then used in place.
+    if (const void* elf_data = file->get_data(); elf_data != nullptr) {
+      header = (const elf::Header*)elf_data;
+      if (file->get_size() < sizeof(elf::Header) || elf::check_header(header) != elf::Error::NONE)
+        return false;
+
+      source = {.image = elf_data};
+      program_headers = (const uint8_t*)elf_data + header->program_header_offset;
+      SegmentCache::add_headers(key, header, program_headers);
+      return true;
+    }
+
+    // Otherwise, only the headers are read here: the segments are read straight into their memory (and only
+    // if they are not cached yet).
+    source = {.file = file};
+    if (!source.read(0, &header_copy, sizeof(header_copy)) || elf::check_header(&header_copy) != elf::Error::NONE)
+      return false;
+
+    const size_t program_headers_byte_size = elf::get_program_headers_byte_size(&header_copy);
+    program_headers_copy = kmalloc(program_headers_byte_size, alignof(elf::ProgramHeader));
+    if (program_headers_copy == nullptr ||
+        !source.read(header_copy.program_header_offset, program_headers_copy, program_headers_byte_size))
+      return false;
+
+    header = &header_copy;
+    program_headers = program_headers_copy;
+    SegmentCache::add_headers(key, header, program_headers);
+    return true;
+  }
+};  // struct ElfFile
+}  // namespace
+
+TaskPtr TaskManager::create_task_common(bool is_kernel,
+                                        Task* parent,
+                                        const libk::SharedPointer<ProcessMemory>& shared_memory,
+                                        const libk::SharedPointer<ProcessMemory>& forked_memory) {
+  TaskPtr task(new Task);
   if (!task)
     return nullptr;
 
   task->m_manager = this;
 
-  // Set parent-child relationship.
-  if (parent != nullptr) {
-    task->m_parent = parent;
-    parent->m_children.push_back(task);
-  }
-
   libk::bzero(&task->m_saved_state, sizeof(task->m_saved_state));
   task->m_saved_state.is_kernel = is_kernel;
 
   if (is_kernel) {
     const auto stack_size = MemoryChunk::get_page_byte_size();
-    const void* stack = kmalloc(stack_size, alignof(std::max_align_t));
-    task->m_saved_state.sp = (uint64_t)stack + stack_size;
-    // FIXME: free the kernel stack once the task is killed
+    task->m_kernel_stack = kmalloc(stack_size, alignof(std::max_align_t));
+    if (task->m_kernel_stack == nullptr)
+      return nullptr;
+
+    task->m_saved_state.sp = (uint64_t)task->m_kernel_stack + stack_size;
+  } else if (shared_memory) {
+    // Share the process virtual memory, only the stack is specific to the task.
+    task->m_saved_state.memory = shared_memory;
+    task->m_thread_stack = libk::make_scoped<MemoryChunk>(STACK_PAGE_COUNT);
+    if (!task->m_thread_stack->is_status_okay())
+      return nullptr;
+
+    task->m_saved_state.sp = shared_memory->map_thread_stack(*task->m_thread_stack);
+    if (task->m_saved_state.sp == 0)
+      return nullptr;
+  } else if (forked_memory) {
+    // The stack is part of the forked memory, the stack pointer is restored with the other registers.
+    task->m_saved_state.memory = forked_memory;
   } else {
     // Create a process virtual memory view and allocate its stack.
-    const auto stack_size = MemoryChunk::get_page_byte_size() * 2;
+    const auto stack_size = MemoryChunk::get_page_byte_size() * PROCESS_STACK_PAGE_COUNT;
     auto memory = libk::make_shared<ProcessMemory>(stack_size);
     task->m_saved_state.memory = memory;
     task->m_saved_state.sp = task->m_saved_state.memory->get_stack_start();
   }
 
+  // Set parent-child relationship.
+  if (parent != nullptr) {
+    task->m_parent = parent;
+    parent->m_children.push_back(task);
+  }
+
   // Set task unique ID.
   task->m_id = m_next_available_pid++;
-  // FIXME: register id mapping
+  m_id_mapping.insert(task->m_id, task);
 
   task->m_priority = Scheduler::DEFAULT_PRIORITY;
+  if (!is_kernel && !shared_memory && !init_info_page(task.get()))
+    return nullptr;
+
+  // Like Linux, the threads and the children inherit the affinity, and the task group.
+  task->m_affinity = parent != nullptr ? parent->m_affinity : m_scheduler->get_default_affinity();
+  if (parent != nullptr)
+    m_scheduler->set_task_group(task.get(), parent->m_group);
 
   task->m_syscall_table = m_default_syscall_table;
 
@@ -86,6 +245,29 @@ TaskPtr TaskManager::create_task_common(bool is_kernel, Task* parent) {
   return task;
 }
 
+bool TaskManager::init_info_page(Task* task) {
+  ProcessMemory* memory = task->get_memory().get();
+  if (!memory->map_info_page())
+    return false;
+
+  sys_info_page_t* info = memory->get_info_page();
+  const uint64_t frequency = GenericTimer::get_frequency();
+  info->tick_frequency = frequency;
+  info->ns_per_tick = (1'000'000'000ull << 32) / frequency;
+  info->sched_tick_period = (frequency * TICK_TIME) / 1000;
+  update_info_page(task);
+  return true;
+}
+
+void TaskManager::update_info_page(const Task* task) {
+  if (task->m_is_kernel || task->m_is_thread || !task->get_memory())
+    return;
+
+  sys_info_page_t* info = task->get_memory()->get_info_page();
+  info->pid = task->get_id();
+  info->priority = task->get_priority();
+}
+
 TaskPtr TaskManager::create_kernel_task(void (*f)()) {
   auto task = create_task_common(true);
   if (!task)
@@ -99,14 +281,11 @@ TaskPtr TaskManager::create_kernel_task(void (*f)()) {
   // Set the return point of the process (when it returns from its function).
   auto* ret = (void (*)())[]() {
     // If this code is reached, you have left the kernel task function.
-    // The task can then be destroyed. Unfortunately, it's quite possible for
-    // this to happen somewhere other than an interrupt. In this case, killing
-    // the task will cause scheduling problems. We therefore mark the task to
-    // be destroyed later (at context switch time) and enter a loop.
-
-    Task::current()->mark_to_be_killed();
-    while (true)
-      asm volatile("");
+    // The task can then be destroyed. Killing the task outside an interrupt
+    // would cause scheduling problems, so we go through the exit syscall:
+    // the task is killed from the exception handler and the core immediately
+    // switches to another task (or its idle task) instead of spinning here.
+    sys_exit(0);
   };
 
   // Set the link register so when we return from the function, we execute ret.
@@ -114,78 +293,259 @@ TaskPtr TaskManager::create_kernel_task(void (*f)()) {
   return task;
 }
 
-TaskPtr TaskManager::create_task(const elf::Header* program_image, Task* parent) {
+TaskPtr TaskManager::create_kernel_task(void (*f)(void*), void* arg) {
+  auto task = create_kernel_task((void (*)())f);
+  if (!task)
+    return nullptr;
+
+  task->m_saved_state.gp_regs.x0 = (uint64_t)arg;
+  return task;
+}
+
+TaskPtr TaskManager::create_task(const elf::Header* program_image,
+                                 Task* parent,
+                                 const SegmentCache::FileKey* file_key) {
+  const void* program_headers = (const uint8_t*)program_image + program_image->program_header_offset;
+  return load_program(program_image, program_headers, {.image = program_image}, parent, file_key);
+}
+
+TaskPtr TaskManager::load_program(const elf::Header* header,
+                                  const void* program_headers,
+                                  const SegmentCache::Source& source,
+                                  Task* parent,
+                                  const SegmentCache::FileKey* file_key) {
   auto task = create_task_common(false, parent);
   if (!task)
     return nullptr;
 
-  // Load the program segments in memory.
+  DynamicLoader::Object program;
+  if (!load_object(task.get(), header, program_headers, source, file_key, &program))
+    return nullptr;
+
+  // The program is linked with shared libraries.
+  if (program.dynamic_addr != 0 && !link_program(task.get(), program))
+    return nullptr;
+
+  // Set the entry point of the process.
+  const auto entry_addr = header->entry_addr;
+  task->m_saved_state.pc = entry_addr;
+  return task;
+}
+
+bool TaskManager::load_object(Task* task,
+                              const elf::Header* header,
+                              const void* program_headers,
+                              const SegmentCache::Source& source,
+                              const SegmentCache::FileKey* file_key,
+                              DynamicLoader::Object* object) {
   ProcessMemory* memory = task->get_memory().get();
-  for (uint64_t i = 0; i < program_image->program_header_entry_count; ++i) {
-    const elf::ProgramHeader* segment = elf::get_program_header(program_image, i);
+  for (uint64_t i = 0; i < header->program_header_entry_count; ++i) {
+    const elf::ProgramHeader* segment = elf::get_program_header(header, program_headers, i);
     if (segment == nullptr)
-      return nullptr;
+      return false;
 
-    if (segment->is_load()) {
-      const auto page_size = MemoryChunk::get_page_byte_size();
+    if (segment->type == elf::ProgramType::DYNAMIC) {
+      object->dynamic_addr = segment->virtual_addr;
+      object->dynamic_size = segment->file_size;
+    }
 
+    if (segment->is_load()) {
       // va_start is required to be on a page boundary (aligned to page size).
+      const auto page_size = MemoryChunk::get_page_byte_size();
       const auto va_start = libk::align_to_previous(segment->virtual_addr, page_size);
-      const auto nb_pages = libk::div_round_up((segment->virtual_addr - va_start) + segment->mem_size, page_size);
+      const auto va_end = libk::align_to_next(segment->virtual_addr + segment->mem_size, page_size);
 
       // The mapped segment attributes.
-      const bool is_executable = (segment->flags & elf::ProgramFlag::EXECUTABLE) != 0;
-      const bool is_writable = (segment->flags & elf::ProgramFlag::WRITABLE) != 0;
-
-      MemoryChunk& chunk = task->m_mapped_chunks.emplace_back(nb_pages);
-      const bool is_mapped = memory->map_chunk(chunk, va_start, !is_writable, is_executable);
-      if (!is_mapped)
-        return nullptr;
-
-      if (segment->file_size > 0) {
-        const char* segment_data = (const char*)(program_image) + segment->offset;
-        const size_t written_bytes = chunk.write(segment->virtual_addr - va_start, segment_data, segment->file_size);
-        KASSERT(written_bytes == segment->file_size);
+      const bool is_executable = segment->is_executable();
+      const bool is_writable = segment->is_writable();
+
+      const size_t chunk_byte_size = SegmentCache::get_chunk_byte_size(segment);
+      if (chunk_byte_size > 0) {
+        auto chunk = SegmentCache::get(file_key, source, segment);
+        if (!chunk || object->segment_count == DynamicLoader::MAX_SEGMENTS)
+          return false;
+
+        task->m_mapped_chunks.push_back(chunk);
+        object->segments[object->segment_count++] = {va_start, chunk_byte_size, (uint8_t*)chunk->get()};
+
+        // The writable segments are copied on write, so the (maybe cached) chunk is never modified.
+        const VirtualAddress address = object->base + va_start;
+        const bool is_mapped = is_writable ? memory->map_chunk_cow(*chunk, address, is_executable)
+                                           : memory->map_chunk(*chunk, address, true, is_executable);
+        if (!is_mapped)
+          return false;
       }
+
+      // The BSS pages after the chunk are only mapped when touched.
+      const auto bss_start = object->base + va_start + chunk_byte_size;
+      if (bss_start < object->base + va_end && !memory->map_zeroed(bss_start, object->base + va_end - bss_start))
+        return false;
     }
   }
 
-  // Set the entry point of the process.
-  const auto entry_addr = program_image->entry_addr;
-  task->m_saved_state.pc = entry_addr;
+  return true;
+}
+
+bool TaskManager::link_program(Task* task, DynamicLoader::Object& program) {
+  if (!DynamicLoader::parse(program))
+    return false;
+
+  DynamicLoader::Object libraries[DynamicLoader::MAX_LIBRARIES];
+  for (size_t i = 0; i < program.needed_count; ++i) {
+    char path[DynamicLoader::MAX_PATH_LENGTH];
+    ElfFile file;
+    if (!DynamicLoader::get_library_path(program, i, path) || !file.open(path)) {
+      LOG_ERROR("[TaskManager] Unable to open a library of the program");
+      return false;
+    }
+
+    // The libraries segments are cached and shared as the program ones, at the same address in all processes.
+    DynamicLoader::Object& library = libraries[i];
+    library.base = DynamicLoader::get_library_base(path, file.header, file.program_headers);
+    if (library.base == 0 ||
+        !load_object(task, file.header, file.program_headers, file.source, &file.key, &library) ||
+        library.dynamic_addr == 0 || !DynamicLoader::parse(library))
+      return false;
+
+    if (library.needed_count != 0) {
+      LOG_ERROR("[TaskManager] The library {} has dependencies, this is not supported", path);
+      return false;
+    }
+
+    if (!DynamicLoader::relocate(library, nullptr, 0))
+      return false;
+  }
+
+  return DynamicLoader::relocate(program, libraries, program.needed_count);
+}
+
+TaskPtr TaskManager::create_thread(Task* process, uint64_t entry, uint64_t arg) {
+  KASSERT(process != nullptr && !process->m_is_kernel);
+
+  // All threads are children of the process main task, which owns the other resources.
+  if (process->m_is_thread)
+    process = process->m_parent;
+
+  auto task = create_task_common(false, process, process->get_memory());
+  if (!task)
+    return nullptr;
+
+  task->m_is_thread = true;
+  task->m_priority = process->get_priority();
+  task->m_saved_state.pc = entry;
+  task->m_saved_state.gp_regs.x0 = arg;
+
+  LOG_TRACE("Create a new thread with pid={} in process pid={}", task->get_id(), process->get_id());
   return task;
 }
 
-TaskPtr TaskManager::create_task(const char* path, Task* parent) {
-  // Load the init program ELF file.
-  FIL f = {};
-  if (f_open(&f, path, FA_READ) != FR_OK)
+TaskPtr TaskManager::fork_task(Task* process, const Registers& regs, Task* parent) {
+  KASSERT(process != nullptr && !process->m_is_kernel && !process->m_is_thread);
+
+  auto memory = process->get_memory()->fork();
+  if (!memory)
+    return nullptr;
+
+  auto task = create_task_common(false, parent != nullptr ? parent : process, nullptr, memory);
+  if (!task)
     return nullptr;
 
-  const UINT file_size = f_size(&f);
-  uint8_t* elf_buffer = (uint8_t*)kmalloc(file_size, alignof(uint64_t));
-  if (elf_buffer == nullptr)
+  // The forked memory maps the same chunks, they must stay alive with it.
+  for (const auto& chunk : process->m_mapped_chunks)
+    task->m_mapped_chunks.push_back(chunk);
+
+  task->m_name = process->m_name;
+  task->m_priority = process->get_priority();
+  task->m_syscall_table = process->m_syscall_table;
+  update_info_page(task.get());
+
+  // The child resumes from the system call, as the parent.
+  task->m_saved_state.save(regs);
+  FPU::flush(process);
+  task->m_saved_state.fpu_regs = process->m_saved_state.fpu_regs;
+  task->m_saved_state.gp_regs.x0 = SYS_ERR_OK;
+  task->m_saved_state.gp_regs.x1 = 0;
+
+  LOG_TRACE("Fork the process pid={} into pid={}", process->get_id(), task->get_id());
+  PROFILER_FORK(process->get_id(), task->get_id());
+  return task;
+}
+
+TaskPtr TaskManager::create_task(const char* path, Task* parent) {
+  ElfFile file;
+  if (!file.open(path))
     return nullptr;
 
-  UINT read_bytes = 0;
-  if (f_read(&f, elf_buffer, file_size, &read_bytes) != FR_OK) {
-    kfree(elf_buffer);
-    f_close(&f);
+  auto task = load_program(file.header, file.program_headers, file.source, parent, &file.key);
+  if (task)
+    PROFILER_PROGRAM(task->get_id(), path);
+  return task;
+}
+
+TaskManager::Zygote* TaskManager::find_zygote(const char* path) {
+  for (auto& zygote : m_zygotes) {
+    if (zygote.task != nullptr && libk::strcmp(zygote.path, path) == 0)
+      return &zygote;
+  }
+
+  return nullptr;
+}
+
+TaskPtr TaskManager::start_zygote(const char* path, Task* parent) {
+  if (libk::strlen(path) >= MAX_ZYGOTE_PATH_LENGTH || find_zygote(path) != nullptr)
     return nullptr;
+
+  Zygote* free_slot = nullptr;
+  for (auto& zygote : m_zygotes) {
+    if (zygote.task == nullptr) {
+      free_slot = &zygote;
+      break;
+    }
   }
 
-  f_close(&f);
+  if (free_slot == nullptr)
+    return nullptr;
 
-  auto* elf = (const elf::Header*)elf_buffer;
-  if (elf::check_header(elf) != elf::Error::NONE) {
-    kfree(elf_buffer);
+  auto task = create_task(path, parent);
+  if (!task)
     return nullptr;
+
+  free_slot->task = task;
+  libk::strcpy(free_slot->path, path);
+  free_slot->is_ready = false;
+  LOG_DEBUG("[TaskManager] Start the zygote of {} with pid={}", path, task->get_id());
+  return task;
+}
+
+bool TaskManager::make_zygote_ready(const TaskPtr& task, const Registers& regs) {
+  for (auto& zygote : m_zygotes) {
+    if (zygote.task != task || zygote.is_ready)
+      continue;
+
+    // The zygote never runs again: its memory is only read by the copies, and stays as it is now.
+    zygote.is_ready = true;
+    zygote.regs = regs;
+    pause_task(task);
+    LOG_DEBUG("[TaskManager] The zygote of {} is ready", zygote.path);
+    return true;
   }
 
-  // Create the task itself.
-  auto task = create_task(elf, parent);
-  kfree(elf_buffer);
+  return false;
+}
+
+TaskPtr TaskManager::spawn_from_zygote(const char* path, Task* parent) {
+  const Zygote* zygote = find_zygote(path);
+  if (zygote == nullptr || !zygote->is_ready)
+    return create_task(path, parent);
 
+  auto task = fork_task(zygote->task.get(), zygote->regs, parent);
+  if (!task)
+    return nullptr;
+
+  // A spawned process, unlike a forked one, gets the default priority.
+  task->m_priority = Scheduler::DEFAULT_PRIORITY;
+  update_info_page(task.get());
+  PROFILER_PROGRAM(task->get_id(), path);
   return task;
 }
 
@@ -197,12 +557,15 @@ void TaskManager::sleep_task(const TaskPtr& task, uint64_t time_in_us) {
   if (!task->is_running())
     return;
 
-  const uint64_t ticks_count = libk::max<uint64_t>(1, libk::div_round_up(time_in_us, TICK_TIME * 1000));
-  LOG_TRACE("Sleep the task pid={} for {} us (i.e. {} ticks)", task->get_id(), time_in_us, ticks_count);
+  const uint64_t duration = (time_in_us * GenericTimer::get_frequency()) / 1'000'000;
+  const uint64_t deadline = GenericTimer::get_tick_count() + duration;
+  LOG_TRACE("Sleep the task pid={} for {} us", task->get_id(), time_in_us);
 
   m_scheduler->remove_task(task);
   task->m_state = Task::State::INTERRUPTIBLE;
-  m_delta_queue.add_task(task, ticks_count);
+  // The timer holds a reference to the task, released once woken (see Task::wake_from_sleep()).
+  task->m_sleeping_self = task;
+  task->m_sleep_timer.start_at(deadline);
 }
 
 void TaskManager::pause_task(const TaskPtr& task) {
@@ -230,7 +593,29 @@ void TaskManager::wake_task(const TaskPtr& task) {
   LOG_TRACE("Wake the task pid={}", task->get_id());
 
   task->m_elapsed_ticks = 0;
-  m_scheduler->add_task(task);
+  const size_t core_id = m_scheduler->add_task(task);
+  task->m_state = Task::State::RUNNING;
+
+  // An idle core does not tick anymore, make it pick the task now. A task woken by an event (e.g. an input
+  // message) also often preempts the current one, see Scheduler::must_preempt_on_wakeup().
+  m_scheduler->reschedule_if_needed(core_id, task.get());
+}
+
+void TaskManager::hand_off_to(const TaskPtr& task) {
+  KASSERT(task != nullptr);
+  KASSERT(task->get_manager() == this);
+  KASSERT(!task->is_terminated() && !task->is_running());
+
+  const TaskPtr current_task = get_current_task();
+  if (!m_scheduler->hand_off(task)) {
+    wake_task(task);
+    pause_task(current_task);
+    return;
+  }
+
+  LOG_TRACE("Hand off from pid={} to pid={}", current_task->get_id(), task->get_id());
+
+  current_task->m_state = Task::State::UNINTERRUPTIBLE;
   task->m_state = Task::State::RUNNING;
 }
 
@@ -241,19 +626,86 @@ void TaskManager::kill_task(const TaskPtr& task, int exit_code) {
   if (task->is_terminated())
     return;  // already killed
 
-  LOG_TRACE("Kill the task pid={} with status {}", task->get_id(), exit_code);
+  // The task is being run by another core: it will be killed there at its next context switch.
+  if (m_scheduler->is_running_on_other_core(task)) {
+    task->m_exit_code = exit_code;
+    task->mark_to_be_killed();
+    return;
+  }
+
+  // Keep the exit code given when the task was marked to be killed.
+  if (!task->is_marked_to_be_killed())
+    task->m_exit_code = exit_code;
+
+  LOG_TRACE("Kill the task pid={} with status {}", task->get_id(), task->m_exit_code);
 
-  // Propagate the kill to children. This is done recursively.
+  // Propagate the kill to the threads of the process, they can not outlive it.
+  // Other children (spawned processes) are independent.
   auto it = task->children_begin();
   for (; it != task->children_end(); ++it) {
     const auto& child = *it;
-    kill_task(child, exit_code);
+    if (child->is_thread())
+      kill_task(child, exit_code);
   }
 
-  m_scheduler->remove_task(task);
+  // Paused or sleeping tasks are not known by the scheduler.
+  if (task->is_running())
+    m_scheduler->remove_task(task);
+
+  // Release the CPU bandwidth reserved by a deadline task.
+  if (task->get_deadline_params().runtime != 0)
+    (void)m_scheduler->set_deadline_params(task, {});
+
+  m_scheduler->set_task_group(task.get(), nullptr);
 
-  task->free_resources();
   task->m_state = Task::State::TERMINATED;
+  m_id_mapping.remove(task->get_id());
+
+  // A killed zygote is started again on demand only.
+  for (auto& zygote : m_zygotes) {
+    if (zygote.task == task)
+      zygote.task = nullptr;
+  }
+
+  // Freeing the resources is long, it is left to the reaper task.
+  m_dead_tasks.push_back(task.get());
+  m_reaper_wait_list.wake_one();
+
+  // Wake up the tasks joining this one.
+  task->m_exit_completion.complete();
+}
+
+void TaskManager::reap_task(Task* task) {
+  task->free_resources();
+
+  // The threads share the memory of their process, the last one to go frees it (see ProcessMemory::free()).
+  // No core uses it anymore: the cores switched to other tasks when killing these ones.
+  task->m_saved_state.memory = nullptr;
+  task->m_mapped_chunks.clear();
+}
+
+void TaskManager::run_reaper(void* manager) {
+  auto* task_manager = (TaskManager*)manager;
+  while (true) {
+    bool is_blocked;
+    {
+      KernelTaskLockGuard kernel_lock;
+
+      // One task at a time, the kernel lock is released between the teardowns.
+      if (Task* task = task_manager->m_dead_tasks.front(); task != nullptr) {
+        task_manager->m_dead_tasks.remove(task);
+        task_manager->reap_task(task);
+      }
+
+      // Sleep until a task is killed.
+      is_blocked = task_manager->m_dead_tasks.is_empty();
+      if (is_blocked)
+        task_manager->m_reaper_wait_list.add(Task::current());
+    }
+
+    if (is_blocked)
+      sys_yield();
+  }
 }
 
 bool TaskManager::set_task_priority(const TaskPtr& task, uint32_t new_priority) {
@@ -266,24 +718,130 @@ bool TaskManager::set_task_priority(const TaskPtr& task, uint32_t new_priority)
   const uint32_t old_priority = task->get_priority();
   task->m_priority = new_priority;
   m_scheduler->update_task_priority(task, old_priority);
+  update_info_page(task.get());
   return true;
 }
 
+bool TaskManager::set_task_affinity(const TaskPtr& task, uint32_t affinity) {
+  KASSERT(task != nullptr);
+  KASSERT(!task->is_terminated());
+
+  return m_scheduler->set_task_affinity(task, affinity);
+}
+
+bool TaskManager::set_task_deadline(const TaskPtr& task, const DeadlineParams& params) {
+  KASSERT(task != nullptr);
+  KASSERT(!task->is_terminated());
+
+  return m_scheduler->set_deadline_params(task, params);
+}
+
+TaskGroup* TaskManager::create_task_group(uint64_t quota, uint64_t period) {
+  return m_scheduler->create_task_group(quota, period);
+}
+
+bool TaskManager::destroy_task_group(TaskGroup* group) {
+  return m_scheduler->destroy_task_group(group);
+}
+
+TaskGroup* TaskManager::find_task_group(TaskGroup::id_t id) const {
+  return m_scheduler->find_task_group(id);
+}
+
+void TaskManager::set_task_group(const TaskPtr& task, TaskGroup* group) {
+  KASSERT(task != nullptr);
+  KASSERT(!task->is_running());
+
+  m_scheduler->set_task_group(task.get(), group);
+}
+
+TaskPtr TaskManager::find_task(Task::id_t id) const {
+  const TaskPtr* task = m_id_mapping.find(id);
+  return task != nullptr ? *task : nullptr;
+}
+
 TaskPtr TaskManager::get_current_task() const {
   return m_scheduler->get_current_task();
 }
 
+Task* TaskManager::get_current_task_ptr() const {
+  return m_scheduler->get_current_task_ptr();
+}
+
+uint64_t TaskManager::get_idle_ticks(size_t core_id, uint64_t now) const {
+  return m_scheduler->get_idle_ticks(core_id, now);
+}
+
 void TaskManager::schedule() {
   m_scheduler->schedule();
 }
 
 void TaskManager::tick() {
-  m_delta_queue.tick();
   m_scheduler->tick();
 }
 
+static void arm_core_tick() {
+  GenericTimer::arm_physical_timer((GenericTimer::get_frequency() * TaskManager::TICK_TIME) / 1000);
+}
+
+void TaskManager::init_core() {
+  // The tick and the reschedule IPI interrupt the other IRQ handlers. Then, the scheduler may be
+  // in the middle of an update: the scheduling is deferred until the interrupted handler returns.
+  IRQManager::register_irq_handler(
+      LOCAL_CNTPNS,
+      [](void*) {
+        arm_core_tick();
+        if (IRQManager::is_nested()) {
+          IRQManager::defer_until_unnested([](void*) { TaskManager::get().tick(); }, nullptr);
+        } else {
+          TaskManager::get().tick();
+        }
+      },
+      nullptr);
+  IRQManager::set_irq_priority(LOCAL_CNTPNS, IRQManager::Priority::HIGH);
+
+  // Sent by the scheduler when it gives a task to this core while it is idle.
+  IRQManager::register_irq_handler(
+      LOCAL_IPI,
+      [](void*) {
+        if (IRQManager::is_nested()) {
+          IRQManager::defer_until_unnested([](void*) { TaskManager::get().schedule(); }, nullptr);
+        } else {
+          TaskManager::get().schedule();
+        }
+      },
+      nullptr);
+  IRQManager::set_irq_priority(LOCAL_IPI, IRQManager::Priority::HIGH);
+
+  // Runs the kernel timers, including the ones waking up the sleeping tasks.
+  IRQManager::register_irq_handler(
+      LOCAL_CNTV,
+      [](void*) {
+        GenericTimer::disarm_virtual_timer();
+        HrTimer::expire();
+      },
+      nullptr);
+
+  arm_core_tick();
+}
+
+void TaskManager::update_core_tick() {
+  bool& tick_stopped = m_tick_stopped.get();
+  const bool is_idle = m_scheduler->is_core_idle(SMP::get_core_id());
+
+  if (is_idle && !tick_stopped) {
+    GenericTimer::disarm_physical_timer();
+    tick_stopped = true;
+  } else if (!is_idle && tick_stopped) {
+    arm_core_tick();
+    tick_stopped = false;
+  }
+}
+
 void TaskManager::mark_as_ready() {
+  init_core();
   m_ready = true;
+  SMP::start_scheduling();
 }
 bool TaskManager::is_ready() const {
   return m_ready;
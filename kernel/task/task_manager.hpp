@@ -2,16 +2,27 @@
 
 #include <elf/elf.hpp>
 #include <libk/hash_table.hpp>
+#include <libk/intrusive_list.hpp>
 #include <libk/linked_list.hpp>
 #include <libk/memory.hpp>
-#include "delta_queue.hpp"
+#include "dynamic_loader.hpp"
+#include "hardware/per_core.hpp"
 #include "scheduler.hpp"
+#include "segment_cache.hpp"
 #include "task.hpp"
+#include "work_queue.hpp"
 
 class TaskManager {
  public:
-  /** Time (in milliseconds) between each tick for the scheduler. */
+  /** Time (in milliseconds) between each tick for the scheduler. Idle cores do not tick. */
   static constexpr uint32_t TICK_TIME = 10;
+  /** Size (in pages) of the stack of user threads. */
+  static constexpr size_t STACK_PAGE_COUNT = 2;
+  /** Size (in pages) of the stack of user processes, it is demand paged so only the touched pages are allocated. */
+  static constexpr size_t PROCESS_STACK_PAGE_COUNT = 256;
+  /** The maximum count of zygotes (see start_zygote()), and the maximum length of their program path. */
+  static constexpr size_t MAX_ZYGOTES = 4;
+  static constexpr size_t MAX_ZYGOTE_PATH_LENGTH = 64;
 
   TaskManager();
 
@@ -20,9 +31,53 @@ class TaskManager {
   [[nodiscard]] SyscallTable* get_default_syscall_table() const { return m_default_syscall_table; }
   void set_default_syscall_table(SyscallTable* table) { m_default_syscall_table = table; }
 
+  /** The work queue of the IRQ bottom halves, run before the other tasks (see WorkQueue). */
+  [[nodiscard]] WorkQueue& get_irq_work_queue() const { return *m_irq_work_queue; }
+
   TaskPtr create_kernel_task(void (*f)());
-  TaskPtr create_task(const elf::Header* program_image, Task* parent = nullptr);
+  /** Creates a new kernel task running @a f with @a arg as argument. */
+  TaskPtr create_kernel_task(void (*f)(void*), void* arg);
+  /** Creates a new user process running @a program_image. Its segments are shared with the other
+   * processes created from the same file if @a file_key is given (see SegmentCache). */
+  TaskPtr create_task(const elf::Header* program_image,
+                      Task* parent = nullptr,
+                      const SegmentCache::FileKey* file_key = nullptr);
   TaskPtr create_task(const char* path, Task* parent = nullptr);
+  /**
+   * Creates a new thread of the user @a process, starting at @a entry with @a arg as first argument.
+   *
+   * The thread shares the memory of the process and only gets its own stack. It is a child of
+   * the process main task (even if @a process is itself a thread) and is killed with it.
+   * The created thread is paused, call wake_task() to start it.
+   */
+  TaskPtr create_thread(Task* process, uint64_t entry, uint64_t arg);
+  /**
+   * Creates a copy of the user @a process, a child of it, which resumes at the same point with the
+   * given @a regs (the registers of its system call), except that x1 is 0.
+   *
+   * The memory is copied on write (see ProcessMemory::fork()). The windows and the opened files are
+   * not inherited. Only the main task of a process can be forked (not its threads).
+   * The copy is a child of @a parent, or of @a process if null.
+   * The created task is paused, call wake_task() to start it.
+   */
+  TaskPtr fork_task(Task* process, const Registers& regs, Task* parent = nullptr);
+
+  /**
+   * Creates the zygote of the program at @a path, a child of @a parent: a process started as usual, which
+   * runs its common initialization (libsyscall, decoded assets, etc.) and then calls sys_zygote_ready() to be
+   * parked there (see make_zygote_ready()). The processes spawned with spawn_from_zygote() are then forked
+   * from it, resuming from sys_zygote_ready() with everything initialized and nothing to load.
+   *
+   * Returns nullptr if the program has a zygote already, if there is no more room or if it failed to load.
+   * The zygote is paused, call wake_task() to start it. It lives until killed.
+   */
+  TaskPtr start_zygote(const char* path, Task* parent);
+  /** Parks the current @a task if it is a zygote that was not ready yet, @a regs being the registers of its
+   * sys_zygote_ready() call. Returns false if @a task is not such a zygote, it then just continues. */
+  bool make_zygote_ready(const TaskPtr& task, const Registers& regs);
+  /** Creates a new user process running the program at @a path, forked from its zygote if it is ready, or
+   * loaded as create_task() does otherwise. The created task is paused, call wake_task() to start it. */
+  TaskPtr spawn_from_zygote(const char* path, Task* parent);
 
   /**
    * Put the given task to sleep for a minimum duration given by @a time_in_us (in microseconds).
@@ -50,11 +105,18 @@ class TaskManager {
    * created by this task manager.
    */
   void wake_task(const TaskPtr& task);
+  /**
+   * Pauses the current task and runs the paused @a task in its place right away, on the rest of its time
+   * slice (see Scheduler::hand_off()). Falls back to wake_task() and pause_task() when a direct switch is
+   * not possible.
+   */
+  void hand_off_to(const TaskPtr& task);
 
   /**
    * Terminates the given task and sets the given exit code.
    *
-   * The task object is deleted. Do not use it after this function.
+   * Its resources (windows, files, address space, etc.) are freed later by the reaper task (see reap_task()),
+   * so the caller, often an exception handler, does not wait for them.
    *
    * @warning @a task is expected to be non null and previously
    * created by this task manager.
@@ -62,25 +124,101 @@ class TaskManager {
   void kill_task(const TaskPtr& task, int exit_code = 0);
 
   bool set_task_priority(const TaskPtr& task, uint32_t new_priority);
+  /** Restricts @a task to the cores of @a affinity, see Scheduler::set_task_affinity(). */
+  bool set_task_affinity(const TaskPtr& task, uint32_t affinity);
+  /** Puts @a task in the deadline scheduling class, see Scheduler::set_deadline_params(). */
+  bool set_task_deadline(const TaskPtr& task, const DeadlineParams& params);
+
+  /** Creates a group of tasks sharing a CPU bandwidth quota, see Scheduler::create_task_group(). */
+  [[nodiscard]] TaskGroup* create_task_group(uint64_t quota, uint64_t period);
+  /** Destroys @a group, see Scheduler::destroy_task_group(). */
+  [[nodiscard]] bool destroy_task_group(TaskGroup* group);
+  [[nodiscard]] TaskGroup* find_task_group(TaskGroup::id_t id) const;
+  /** Moves the new @a task (not woken yet) to @a group, it is then throttled with the group. */
+  void set_task_group(const TaskPtr& task, TaskGroup* group);
+
+  /** Returns the task of the given @a id, or nullptr if there is none (or if it was killed). */
+  [[nodiscard]] TaskPtr find_task(Task::id_t id) const;
+  /** Calls @a f with each task not killed yet (as a const Task*), in no particular order. */
+  template <class F>
+  void for_each_task(F f) const {
+    for (const auto& entry : m_id_mapping)
+      f((const Task*)entry.value.get());
+  }
 
   [[nodiscard]] TaskPtr get_current_task() const;
+  /** Same as get_current_task() but without taking a reference (see Scheduler::get_current_task_ptr()). */
+  [[nodiscard]] Task* get_current_task_ptr() const;
+  /** See Scheduler::get_idle_ticks(). */
+  [[nodiscard]] uint64_t get_idle_ticks(size_t core_id, uint64_t now) const;
 
   void schedule();
   void tick();
 
+  /** Sets up the scheduling of the calling core (its tick and its reschedule IPI). */
+  void init_core();
+
+  /** Starts or stops the tick of the calling core depending on whether it is idle or not.
+   * Called after each scheduling decision. */
+  void update_core_tick();
+
   void mark_as_ready();
   bool is_ready() const;
 
  private:
-  TaskPtr create_task_common(bool is_kernel = false, Task* parent = nullptr);
+  /** Creates a new user process from the program whose ELF @a header and program header table
+   * (@a program_headers) are given, its segments being read from @a source. */
+  TaskPtr load_program(const elf::Header* header,
+                       const void* program_headers,
+                       const SegmentCache::Source& source,
+                       Task* parent,
+                       const SegmentCache::FileKey* file_key);
+  /** Maps the segments of the program or library @a object (at its base address) in the memory of @a task. */
+  bool load_object(Task* task,
+                   const elf::Header* header,
+                   const void* program_headers,
+                   const SegmentCache::Source& source,
+                   const SegmentCache::FileKey* file_key,
+                   DynamicLoader::Object* object);
+  /** Loads the shared libraries needed by the dynamically linked @a program and relocates them all. */
+  bool link_program(Task* task, DynamicLoader::Object& program);
+  /** Runs the reaper task, which frees the resources of the killed tasks one at a time. */
+  static void run_reaper(void* manager);
+  /** Frees the resources of the killed @a task. Its address space is freed with its last task. */
+  void reap_task(Task* task);
+  /** A program pre-initialized by a parked process, see start_zygote(). */
+  struct Zygote {
+    TaskPtr task;  // null if the slot is free
+    char path[MAX_ZYGOTE_PATH_LENGTH];
+    bool is_ready;
+    Registers regs;  // of its sys_zygote_ready() call, once ready
+  };  // struct Zygote
+
+  /** Returns the zygote of the program at @a path, or nullptr if it has none. */
+  Zygote* find_zygote(const char* path);
+
+  /** Maps the information page of the new process @a task (see ProcessMemory::map_info_page()) and fills it. */
+  bool init_info_page(Task* task);
+  /** Updates the fields of the information page that depend on @a task, if it is the main task of a process. */
+  void update_info_page(const Task* task);
+
+  TaskPtr create_task_common(bool is_kernel = false,
+                             Task* parent = nullptr,
+                             const libk::SharedPointer<ProcessMemory>& shared_memory = nullptr,
+                             const libk::SharedPointer<ProcessMemory>& forked_memory = nullptr);
 
  private:
   static TaskManager* g_instance;
   libk::ScopedPointer<Scheduler> m_scheduler;
-  libk::LinkedList<libk::SharedPointer<Task>> m_tasks;
-  //  libk::HashTable<Task::id_t, Task*> m_id_mapping;  // Unused
+  libk::LinkedList<libk::IntrusivePtr<Task>> m_tasks;
+  libk::HashTable<Task::id_t, TaskPtr> m_id_mapping;  // the tasks not killed yet
   Task::id_t m_next_available_pid = 0;
   SyscallTable* m_default_syscall_table = nullptr;
-  DeltaQueue m_delta_queue;
+  libk::ScopedPointer<WorkQueue> m_irq_work_queue;
+  // The killed tasks whose resources are not freed yet (kept alive by m_tasks), and the reaper waiting for them.
+  libk::IntrusiveList<Task, &Task::m_reap_hook> m_dead_tasks;
+  WaitList m_reaper_wait_list;
+  Zygote m_zygotes[MAX_ZYGOTES] = {};
+  PerCore<bool> m_tick_stopped;
   bool m_ready = false;
 };  // class TaskManager
@@ -0,0 +1,193 @@
+#include "task/timers.hpp"
+
+#include <libk/utils.hpp>
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+
+/*
+ * HrTimer
+ */
+
+libk::IntrusiveRbTree<HrTimer, &HrTimer::m_hook, HrTimer::Less> HrTimer::g_timers;
+size_t HrTimer::g_owner_core = 0;
+
+void HrTimer::start_at(uint64_t deadline) {
+  if (is_pending())
+    g_timers.remove(this);
+
+  m_deadline = deadline;
+  g_timers.insert(this);
+  if (g_timers.first() == this)
+    arm();
+}
+
+void HrTimer::start_in_us(uint64_t duration_in_us) {
+  start_at(GenericTimer::get_tick_count() + (duration_in_us * GenericTimer::get_frequency()) / 1'000'000);
+}
+
+bool HrTimer::cancel() {
+  if (!is_pending())
+    return false;
+
+  // The virtual timer may fire for nothing, it is then armed again for the next timer.
+  g_timers.remove(this);
+  return true;
+}
+
+void HrTimer::arm() {
+  if (g_timers.is_empty())
+    return;
+
+  // The compare value is 64-bit, so no wraparound: an already passed deadline fires at once.
+  // The virtual timer of the calling core owns the deadline, the one of the previous owner
+  // (if another core) is ignored when it fires.
+  g_owner_core = SMP::get_core_id();
+  GenericTimer::arm_virtual_timer_at(g_timers.first()->m_deadline);
+}
+
+void HrTimer::expire() {
+  if (g_owner_core != SMP::get_core_id())
+    return;
+
+  const uint64_t now = GenericTimer::get_tick_count();
+  HrTimer* timer;
+  while ((timer = g_timers.first()) != nullptr && timer->m_deadline <= now) {
+    g_timers.remove(timer);
+    // The callback may start the timer again, or even delete it.
+    timer->m_callback(timer->m_arg);
+  }
+
+  arm();
+}
+
+/*
+ * Timeout
+ */
+
+struct Timeout::Wheel {
+  using Slot = libk::IntrusiveList<Timeout, &Timeout::m_hook>;
+
+  static inline Slot slots[LEVEL_COUNT][SLOT_COUNT];
+  static inline uint64_t occupied[LEVEL_COUNT];  // a bit per non-empty slot
+  static inline size_t nb_pending = 0;
+  // The last wheel tick processed, all the pending timeouts expire after it.
+  static inline uint64_t current_tick = 0;
+  static HrTimer driver;
+
+  static uint64_t ticks_per_wheel_tick() { return GenericTimer::get_frequency() * RESOLUTION_IN_MS / 1'000; }
+  static uint64_t now() { return GenericTimer::get_tick_count() / ticks_per_wheel_tick(); }
+
+  static void link(Timeout* timeout) {
+    // The first level whose span covers the delay: the timeout is then in a slot not reached yet (see
+    // MAX_DURATION_IN_MS).
+    const uint64_t delay = timeout->m_expiry - current_tick;
+    size_t level = 0;
+    while (level < LEVEL_COUNT - 1 && delay >= (1ull << (SLOT_BITS * (level + 1))))
+      level++;
+
+    const size_t slot = (timeout->m_expiry >> (SLOT_BITS * level)) % SLOT_COUNT;
+    timeout->m_level = level;
+    timeout->m_slot = slot;
+    slots[level][slot].push_back(timeout);
+    occupied[level] |= 1ull << slot;
+  }
+
+  static void unlink(Timeout* timeout) {
+    Slot& slot = slots[timeout->m_level][timeout->m_slot];
+    slot.remove(timeout);
+    if (slot.is_empty())
+      occupied[timeout->m_level] &= ~(1ull << timeout->m_slot);
+  }
+
+  /** Processes the wheel tick @a tick: moves down the timeouts of the coarser slots reached, then runs the
+   * timeouts of the first level. */
+  static void process_tick(uint64_t tick) {
+    current_tick = tick;
+    for (size_t level = 1; level < LEVEL_COUNT; ++level) {
+      if (tick % (1ull << (SLOT_BITS * level)) != 0)
+        break;
+
+      const size_t index = (tick >> (SLOT_BITS * level)) % SLOT_COUNT;
+      Slot& slot = slots[level][index];
+      occupied[level] &= ~(1ull << index);
+      while (!slot.is_empty())
+        link(slot.pop_front());
+    }
+
+    const size_t index = tick % SLOT_COUNT;
+    Slot& slot = slots[0][index];
+    occupied[0] &= ~(1ull << index);
+    while (!slot.is_empty()) {
+      Timeout* timeout = slot.pop_front();
+      nb_pending--;
+      // The callback may start the timeout again, or even delete it.
+      timeout->m_callback(timeout->m_arg);
+    }
+  }
+
+  /** Returns the next wheel tick to process: the next slot of the first level with timeouts in its current
+   * rotation, or the end of the rotation where the coarser slots are moved down. */
+  static uint64_t get_next_tick() {
+    const uint64_t offset = current_tick % SLOT_COUNT;
+    const uint64_t rotation_end = current_tick - offset + SLOT_COUNT;
+    if (offset == SLOT_COUNT - 1)
+      return rotation_end;
+
+    const uint64_t next_slots = occupied[0] >> (offset + 1);
+    return next_slots != 0 ? current_tick + 1 + __builtin_ctzll(next_slots) : rotation_end;
+  }
+
+  static void arm_driver() {
+    if (nb_pending == 0) {
+      (void)driver.cancel();
+      return;
+    }
+
+    // Most timeouts do not move the next tick, the driver is then left in place.
+    const uint64_t deadline = get_next_tick() * ticks_per_wheel_tick();
+    if (!driver.is_pending() || driver.get_deadline() != deadline)
+      driver.start_at(deadline);
+  }
+
+  static void advance(void*) {
+    const uint64_t target = now();
+    while (nb_pending != 0 && current_tick < target)
+      process_tick(current_tick + 1);
+
+    // Idle: restart from the current time at the next timeout.
+    if (nb_pending == 0)
+      current_tick = target;
+    arm_driver();
+  }
+};  // struct Timeout::Wheel
+
+HrTimer Timeout::Wheel::driver{&Timeout::Wheel::advance, nullptr};
+
+void Timeout::start_in_ms(uint64_t duration_in_ms) {
+  if (is_pending()) {
+    Wheel::unlink(this);
+    Wheel::nb_pending--;
+  }
+
+  // The wheel is only processed up to the next timeout, it may be behind the current time by a rotation.
+  const uint64_t now = Wheel::now();
+  if (Wheel::nb_pending == 0)
+    Wheel::current_tick = now;
+
+  // Plus a full wheel tick: the current one has already started.
+  const uint64_t duration = libk::div_round_up(libk::min(duration_in_ms, MAX_DURATION_IN_MS), RESOLUTION_IN_MS);
+  m_expiry = now + libk::max<uint64_t>(duration, 1) + 1;
+  Wheel::link(this);
+  Wheel::nb_pending++;
+  Wheel::arm_driver();
+}
+
+bool Timeout::cancel() {
+  if (!is_pending())
+    return false;
+
+  Wheel::unlink(this);
+  Wheel::nb_pending--;
+  // The driver is left armed if needed, it then stops by itself once the wheel is empty.
+  return true;
+}
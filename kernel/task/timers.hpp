@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <libk/intrusive_list.hpp>
+#include <libk/rb_tree.hpp>
+
+/**
+ * A one-shot timer calling back a function at a precise deadline (in generic timer ticks, see GenericTimer).
+ *
+ * The pending timers are sorted by deadline in a red-black tree, so starting and cancelling one is O(log n).
+ * The virtual timer of a core is armed at the nearest deadline, the expired timers are run in its interrupt
+ * with the kernel lock held. A timer is owned by its user (usually embedded into an object), nothing is
+ * allocated. All the methods must be called with the kernel lock held.
+ */
+class HrTimer {
+ public:
+  using Callback = void (*)(void* arg);
+
+  HrTimer(Callback callback, void* arg) : m_callback(callback), m_arg(arg) {}
+  ~HrTimer() { (void)cancel(); }
+
+  HrTimer(const HrTimer&) = delete;
+  HrTimer& operator=(const HrTimer&) = delete;
+
+  /** Starts the timer at @a deadline, or moves it there if already pending. A passed deadline expires at once
+   * (in the next interrupt). */
+  void start_at(uint64_t deadline);
+  void start_in_us(uint64_t duration_in_us);
+  /** Stops the timer. Returns false if it was not pending. */
+  bool cancel();
+
+  [[nodiscard]] bool is_pending() const { return m_hook.is_linked(); }
+  [[nodiscard]] uint64_t get_deadline() const { return m_deadline; }
+
+  /** Runs the expired timers and arms the virtual timer for the next one. Called by the interrupt of the virtual
+   * timer, after disarming it. */
+  static void expire();
+
+ private:
+  struct Less {
+    bool operator()(const HrTimer& a, const HrTimer& b) const { return a.m_deadline < b.m_deadline; }
+  };  // struct Less
+
+  static void arm();
+
+  libk::RbTreeHook m_hook;
+  uint64_t m_deadline = 0;
+  Callback m_callback;
+  void* m_arg;
+
+  static libk::IntrusiveRbTree<HrTimer, &HrTimer::m_hook, Less> g_timers;
+  static size_t g_owner_core;  // the core whose virtual timer is armed
+};  // class HrTimer
+
+/**
+ * A coarse one-shot timeout, with a resolution of RESOLUTION_IN_MS, for the timeouts that are usually
+ * cancelled before expiring (e.g. the watchdogs of the drivers).
+ *
+ * The pending timeouts are in a hierarchical timing wheel: LEVEL_COUNT levels of SLOT_COUNT slots, each level
+ * SLOT_COUNT times coarser than the previous one. Starting and cancelling a timeout is O(1), a timeout only
+ * moves down a level when its slot is reached. The wheel is driven by a HrTimer, armed at the next slot with
+ * timeouts (or the next slot of a coarser level) while there are pending timeouts. The longest timeout is
+ * clamped to MAX_DURATION_IN_MS (about 4.6 hours). All the methods must be called with the kernel lock held.
+ */
+class Timeout {
+ public:
+  using Callback = void (*)(void* arg);
+
+  static constexpr uint64_t RESOLUTION_IN_MS = 1;
+  static constexpr size_t SLOT_BITS = 6;
+  static constexpr size_t SLOT_COUNT = 1 << SLOT_BITS;
+  static constexpr size_t LEVEL_COUNT = 4;
+  // The span of the wheel, minus the rotation of the first level that the wheel may be behind.
+  static constexpr uint64_t MAX_DURATION_IN_MS =
+      RESOLUTION_IN_MS * ((1ull << (SLOT_BITS * LEVEL_COUNT)) - 2 * SLOT_COUNT);
+
+  Timeout(Callback callback, void* arg) : m_callback(callback), m_arg(arg) {}
+  ~Timeout() { (void)cancel(); }
+
+  Timeout(const Timeout&) = delete;
+  Timeout& operator=(const Timeout&) = delete;
+
+  /** Starts the timeout to expire in at least @a duration_in_ms, or restarts it if already pending. */
+  void start_in_ms(uint64_t duration_in_ms);
+  /** Stops the timeout. Returns false if it was not pending. */
+  bool cancel();
+
+  [[nodiscard]] bool is_pending() const { return m_hook.is_linked(); }
+
+ private:
+  struct Wheel;
+
+  libk::IntrusiveListHook m_hook;
+  uint64_t m_expiry = 0;  // in wheel ticks
+  uint8_t m_level = 0;
+  uint8_t m_slot = 0;
+  Callback m_callback;
+  void* m_arg;
+};  // class Timeout
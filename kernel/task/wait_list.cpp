@@ -2,7 +2,7 @@
 #include "task.hpp"
 #include "task_manager.hpp"
 
-void WaitList::add(const libk::SharedPointer<Task>& task) {
+void WaitList::add(const libk::IntrusivePtr<Task>& task) {
   KASSERT(task);
 
   if (task->is_terminated())
@@ -12,17 +12,25 @@ void WaitList::add(const libk::SharedPointer<Task>& task) {
   m_wait_list.push_back(task);
 }
 
-void WaitList::wake_one() {
+bool WaitList::wake_one() {
   // Retrieve the first task that is not terminated.
-  libk::SharedPointer<Task> task;
+  libk::IntrusivePtr<Task> task;
   do {
     if (m_wait_list.is_empty())
-      return;
+      return false;
 
     task = m_wait_list.pop_front();
-  } while (!task->is_terminated());
+  } while (task->is_terminated());
 
   task->get_manager()->wake_task(task);
+  return true;
+}
+
+size_t WaitList::wake(size_t count) {
+  size_t awaken_count = 0;
+  while (awaken_count < count && wake_one())
+    ++awaken_count;
+  return awaken_count;
 }
 
 void WaitList::wake_all() {
@@ -36,3 +44,24 @@ void WaitList::wake_all() {
 
   m_wait_list.clear();
 }
+
+void WaitList::remove_terminated() {
+  auto it = m_wait_list.begin();
+  while (it != m_wait_list.end()) {
+    auto next = it;
+    ++next;
+    if ((*it)->is_terminated())
+      m_wait_list.erase(it);
+    it = next;
+  }
+}
+
+uint32_t WaitList::get_highest_priority() const {
+  uint32_t highest_priority = 0;
+  for (const auto& task : m_wait_list) {
+    if (!task->is_terminated() && task->get_priority() > highest_priority)
+      highest_priority = task->get_priority();
+  }
+
+  return highest_priority;
+}
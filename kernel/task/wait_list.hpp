@@ -5,12 +5,31 @@
 
 class Task;
 
+/**
+ * A list of tasks blocked until some event happens (a message is received, a mutex is
+ * released, etc). Added tasks are paused and awaken in FIFO order.
+ *
+ * This is the building block of all the kernel synchronization primitives (see sync.hpp).
+ */
 class WaitList {
  public:
-  void add(const libk::SharedPointer<Task>& task);
-  void wake_one();
+  /** Returns true if no task is blocked in this wait list. */
+  [[nodiscard]] bool is_empty() const { return m_wait_list.is_empty(); }
+
+  /** Pauses the given @a task and adds it to the wait list. */
+  void add(const libk::IntrusivePtr<Task>& task);
+  /** Wakes the oldest blocked task. Returns true if a task was awaken. */
+  bool wake_one();
+  /** Wakes at most @a count blocked tasks (oldest first). Returns the number of awaken tasks. */
+  size_t wake(size_t count);
+  /** Wakes all the blocked tasks. */
   void wake_all();
+  /** Forgets the tasks terminated while blocked (e.g. killed), which are otherwise only dropped when awaken. */
+  void remove_terminated();
+
+  /** Returns the highest priority of the blocked tasks, or 0 if there is none. */
+  [[nodiscard]] uint32_t get_highest_priority() const;
 
  private:
-  libk::LinkedList<libk::SharedPointer<Task>> m_wait_list;
+  libk::LinkedList<libk::IntrusivePtr<Task>> m_wait_list;
 };  // class WaitList
@@ -0,0 +1,50 @@
+#include "work_queue.hpp"
+#include <libk/assert.hpp>
+#include "hardware/kernel_lock.hpp"
+#include "sys/syscall.h"
+#include "task_manager.hpp"
+
+WorkQueue::WorkQueue(uint32_t priority) {
+  auto task = TaskManager::get().create_kernel_task(&WorkQueue::run, this);
+  KASSERT(task != nullptr);
+  TaskManager::get().set_task_priority(task, priority);
+  TaskManager::get().wake_task(task);
+}
+
+bool WorkQueue::queue(Function function, void* data) {
+  KASSERT(function != nullptr);
+
+  if (m_head - m_tail == MAX_PENDING_WORKS)
+    return false;
+
+  m_works[m_head++ % MAX_PENDING_WORKS] = {function, data};
+  m_wait_list.wake_one();
+  return true;
+}
+
+void WorkQueue::run_pending_works() {
+  // The works may queue other works.
+  while (m_head != m_tail) {
+    const Work work = m_works[m_tail++ % MAX_PENDING_WORKS];
+    work.function(work.data);
+  }
+}
+
+void WorkQueue::run(void* queue) {
+  auto* work_queue = (WorkQueue*)queue;
+  while (true) {
+    bool is_blocked;
+    {
+      KernelTaskLockGuard kernel_lock;
+      work_queue->run_pending_works();
+
+      // Sleep until a work is queued.
+      is_blocked = work_queue->m_head == work_queue->m_tail;
+      if (is_blocked)
+        work_queue->m_wait_list.add(Task::current());
+    }
+
+    if (is_blocked)
+      sys_yield();
+  }
+}
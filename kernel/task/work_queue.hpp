@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "wait_list.hpp"
+
+/**
+ * A queue of deferred works, run in order by a dedicated kernel task.
+ *
+ * This is the bottom half of the IRQ handlers: they only acknowledge the hardware and queue the
+ * rest of the work, which then runs with the IRQs unmasked and at the priority of the queue task.
+ * The works run with the kernel lock held, as the IRQ handlers.
+ */
+class WorkQueue {
+ public:
+  using Function = void (*)(void* data);
+
+  static constexpr size_t MAX_PENDING_WORKS = 64;
+
+  /** Creates the kernel task running the works, at the given @a priority. Requires the task manager. */
+  explicit WorkQueue(uint32_t priority);
+
+  /**
+   * Queues the call of @a function with @a data. Can be called from any context, the kernel lock held.
+   * Returns false if the queue is full.
+   */
+  bool queue(Function function, void* data);
+
+ private:
+  static void run(void* queue);
+  void run_pending_works();
+
+  struct Work {
+    Function function;
+    void* data;
+  };  // struct Work
+
+  WaitList m_wait_list;
+  size_t m_head = 0;
+  size_t m_tail = 0;
+  Work m_works[MAX_PENDING_WORKS];
+};  // class WorkQueue
@@ -0,0 +1,91 @@
+#include "trace.hpp"
+#include <libk/assert.hpp>
+#include "drain_task.hpp"
+#include "hardware/irq_save.hpp"
+#include "hardware/smp.hpp"
+#include "hardware/timer.hpp"
+#include "hardware/uart.hpp"
+#include "task/task_manager.hpp"
+
+namespace Trace {
+static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "the ring size must be a power of two");
+
+struct Ring {
+  // Written only by the core owning the ring.
+  uint64_t head;
+  uint64_t lost_count;
+  // Written only by the draining task.
+  alignas(64) uint64_t tail;
+  Record records[RING_SIZE];
+};  // struct Ring
+
+static Ring g_rings[SMP::MAX_CORES];
+static const UART* g_output = nullptr;
+
+/** Appends a record to @a ring if there is room. Only called by the core owning the ring, IRQs masked. */
+static bool push(Ring& ring, uint32_t core, Event event, uint64_t arg0, uint64_t arg1) {
+  const uint64_t head = ring.head;
+  if (head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+    return false;
+
+  Record& record = ring.records[head % RING_SIZE];
+  record.timestamp = GenericTimer::get_tick_count();
+  record.event = (uint32_t)event;
+  record.core = core;
+  record.args[0] = arg0;
+  record.args[1] = arg1;
+  __atomic_store_n(&ring.head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+void record(Event event, uint64_t arg0, uint64_t arg1) {
+  const uint64_t daif = IRQSave::mask_irqs();
+
+  const size_t core = SMP::get_core_id();
+  Ring& ring = g_rings[core];
+  if (ring.lost_count > 0 && push(ring, core, Event::LOST, ring.lost_count, 0))
+    ring.lost_count = 0;
+
+  if (ring.lost_count > 0 || !push(ring, core, event, arg0, arg1))
+    ring.lost_count++;
+
+  IRQSave::restore_irqs(daif);
+}
+
+void set_output(const UART& uart) {
+  g_output = &uart;
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks, uint64_t frequency) {
+  // Split to not overflow after a few minutes.
+  return (ticks / frequency) * 1'000'000'000 + ((ticks % frequency) * 1'000'000'000) / frequency;
+}
+
+size_t drain(size_t max_records) {
+  if (g_output == nullptr)
+    return 0;
+
+  const uint64_t frequency = GenericTimer::get_frequency();
+  size_t count = 0;
+  for (Ring& ring : g_rings) {
+    uint64_t tail = ring.tail;
+    const uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+    for (; tail != head && count < max_records; ++tail, ++count) {
+      Record record = ring.records[tail % RING_SIZE];
+      record.timestamp = ticks_to_ns(record.timestamp, frequency);
+      LogUARTLockGuard log_uart_lock;
+      g_output->write("TRC", 3);
+      g_output->write((const char*)&record, sizeof(record));
+    }
+
+    __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+  }
+
+  return count;
+}
+
+void start_drain_task() {
+  static constexpr size_t MAX_RECORDS_PER_DRAIN = 64;
+  TaskManager::get().wake_task(DrainTask::create(&drain, MAX_RECORDS_PER_DRAIN));
+}
+}  // namespace Trace
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class UART;
+
+/**
+ * A binary trace of the kernel events, to profile the kernel without the cost (and the timing changes) of
+ * formatting and writing log lines.
+ *
+ * Each core appends fixed-size records to its own ring buffer, IRQs masked, without any lock (the rings
+ * are single producer single consumer, using only ordered loads and stores, see KernelLock for why).
+ * A kernel task drains the rings over the log UART and the host decodes them with tools/trace-decoder.py.
+ * A record is dropped if its ring is full, the count of dropped records is then traced as an Event::LOST.
+ *
+ * The tracepoints (see TRACE_EVENT()) are only compiled in with CONFIG_TRACE.
+ */
+namespace Trace {
+/** The traced events, the meaning of the arguments is given for each (keep in sync with trace-decoder.py). */
+enum class Event : uint32_t {
+  /** The records dropped since the last record of the core: count. */
+  LOST,
+  /** old task ID (or 0), new task ID */
+  CONTEXT_SWITCH,
+  /** IRQ type, IRQ ID */
+  IRQ_ENTER,
+  /** IRQ type, IRQ ID */
+  IRQ_EXIT,
+  /** syscall ID, first argument */
+  SYSCALL_ENTER,
+  /** syscall ID, returned value (x0) */
+  SYSCALL_EXIT,
+  /** physical address, count of pages */
+  PAGE_ALLOC,
+  /** physical address, count of pages */
+  PAGE_FREE,
+  /** DMA channel base address, first request */
+  DMA_SUBMIT,
+};  // enum class Event
+
+struct Record {
+  uint64_t timestamp;  // in timer ticks (see GenericTimer), converted to nanoseconds when drained
+  uint32_t event;
+  uint32_t core;
+  uint64_t args[2];
+};  // struct Record
+
+static_assert(sizeof(Record) == 32);
+
+/** Count of records of the ring of each core. */
+static constexpr size_t RING_SIZE = 1024;
+
+/** Records @a event on the calling core, can be called from any context. */
+void record(Event event, uint64_t arg0 = 0, uint64_t arg1 = 0);
+
+/** Sets the UART the records are drained into (the log UART). */
+void set_output(const UART& uart);
+
+/**
+ * Sends at most @a max_records records of the rings over the output UART, each one prefixed by "TRC".
+ * Returns the count of records sent. It must not be called by several cores at the same time.
+ */
+size_t drain(size_t max_records);
+
+/** Starts the kernel task that drains the rings. Requires the task manager. */
+void start_drain_task();
+};  // namespace Trace
+
+#ifdef CONFIG_TRACE
+#define TRACE_EVENT(event, ...) ::Trace::record(::Trace::Event::event __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define TRACE_EVENT(event, ...)
+#endif  // CONFIG_TRACE
@@ -0,0 +1,155 @@
+#include "wm/cursor.hpp"
+
+#include <libk/log.hpp>
+#include "hardware/mailbox.hpp"
+
+namespace {
+// 'X' is the outline, '.' the inside, the other pixels are transparent.
+constexpr const char* CURSOR_IMAGE[Cursor::SIZE] = {
+    "X               ",  //
+    "XX              ",  //
+    "X.X             ",  //
+    "X..X            ",  //
+    "X...X           ",  //
+    "X....X          ",  //
+    "X.....X         ",  //
+    "X......X        ",  //
+    "X.......X       ",  //
+    "X........X      ",  //
+    "X.....XXXXX     ",  //
+    "X..X..X         ",  //
+    "X.X X..X        ",  //
+    "XX  X..X        ",  //
+    "X    X..X       ",  //
+    "     XXXX       ",  //
+};
+
+// In the ARGB format expected by the VideoCore, also used by the software cursor.
+alignas(16) uint32_t g_cursor_pixels[Cursor::SIZE * Cursor::SIZE];
+
+union SetCursorInfoTagBuffer {
+  struct Request {
+    uint32_t width;
+    uint32_t height;
+    uint32_t unused;
+    uint32_t pixels;  // address of the ARGB image
+    uint32_t hotspot_x;
+    uint32_t hotspot_y;
+  } request;
+  uint32_t response;  // 0 if the cursor image is valid
+};  // union SetCursorInfoTagBuffer
+
+union SetCursorStateTagBuffer {
+  struct Request {
+    uint32_t enable;
+    uint32_t x;
+    uint32_t y;
+    uint32_t flags;  // 0 for display coordinates, 1 for framebuffer coordinates
+  } request;
+  uint32_t response;  // 0 if the state is valid
+};  // union SetCursorStateTagBuffer
+
+using SetCursorInfoTag = MailBox::PropertyTag<0x00008010, SetCursorInfoTagBuffer>;
+using SetCursorStateTag = MailBox::PropertyTag<0x00008011, SetCursorStateTagBuffer>;
+
+// The message of the last move, sent asynchronously: it must stay alive until the VideoCore response.
+MailBox::PropertyMessage<SetCursorStateTag> g_state_message;
+
+void fill_cursor_pixels() {
+  for (int32_t y = 0; y < Cursor::SIZE; ++y) {
+    for (int32_t x = 0; x < Cursor::SIZE; ++x) {
+      uint32_t color = 0x00000000;
+      if (CURSOR_IMAGE[y][x] == 'X')
+        color = 0xff000000;
+      else if (CURSOR_IMAGE[y][x] == '.')
+        color = 0xffffffff;
+      g_cursor_pixels[x + y * Cursor::SIZE] = color;
+    }
+  }
+}
+
+void fill_state_message(MailBox::PropertyMessage<SetCursorStateTag>& message, int32_t x, int32_t y) {
+  message.status = 0;
+  message.tag.status = sizeof(SetCursorStateTagBuffer);
+  message.tag.buffer.request.enable = 1;
+  message.tag.buffer.request.x = x;
+  message.tag.buffer.request.y = y;
+  message.tag.buffer.request.flags = 1;
+}
+
+bool init_hardware_cursor(int32_t x, int32_t y) {
+  MailBox::PropertyMessage<SetCursorInfoTag> info_message;
+  info_message.tag.buffer.request.width = Cursor::SIZE;
+  info_message.tag.buffer.request.height = Cursor::SIZE;
+  info_message.tag.buffer.request.unused = 0;
+  info_message.tag.buffer.request.pixels = (uint32_t)(uintptr_t)g_cursor_pixels;
+  info_message.tag.buffer.request.hotspot_x = 0;
+  info_message.tag.buffer.request.hotspot_y = 0;
+  if (!MailBox::send_property(info_message) || !MailBox::check_tag_status(info_message.tag.status) ||
+      info_message.tag.buffer.response != 0)
+    return false;
+
+  MailBox::PropertyMessage<SetCursorStateTag> state_message;
+  fill_state_message(state_message, x, y);
+  return MailBox::send_property(state_message) && MailBox::check_tag_status(state_message.tag.status) &&
+         state_message.tag.buffer.response == 0;
+}
+}  // namespace
+
+void Cursor::init(int32_t screen_width, int32_t screen_height) {
+  m_screen_width = screen_width;
+  m_screen_height = screen_height;
+  fill_cursor_pixels();
+
+  m_is_hardware = init_hardware_cursor(m_x, m_y);
+  if (m_is_hardware)
+    LOG_INFO("Using the hardware mouse cursor");
+  else
+    LOG_INFO("Hardware mouse cursor not supported, using a software cursor");
+}
+
+Rect Cursor::get_rect() const {
+  return Rect(m_x, m_y, m_x + SIZE, m_y + SIZE).intersected({0, 0, m_screen_width, m_screen_height});
+}
+
+void Cursor::set_position(int32_t x, int32_t y) {
+  m_x = libk::clamp(x, 0, libk::max(m_screen_width - 1, 0));
+  m_y = libk::clamp(y, 0, libk::max(m_screen_height - 1, 0));
+
+  if (m_is_hardware) {
+    // Only the previous move may be waited for, the VideoCore answers quickly.
+    fill_state_message(g_state_message, m_x, m_y);
+    MailBox::send_property_async(g_state_message);
+  }
+}
+
+void Cursor::draw(FrameBuffer::Pixel* buffer, size_t pitch) {
+  m_drawn_rect = get_rect();
+  m_is_drawn = true;
+
+  const int32_t width = m_drawn_rect.width();
+  for (int32_t y = 0; y < m_drawn_rect.height(); ++y) {
+    FrameBuffer::Pixel* dst = buffer + m_drawn_rect.x() + (m_drawn_rect.y() + y) * pitch;
+    const uint32_t* src = g_cursor_pixels + (m_drawn_rect.y() - m_y + y) * SIZE + (m_drawn_rect.x() - m_x);
+    FrameBuffer::Pixel* saved = m_save_under + y * SIZE;
+    for (int32_t x = 0; x < width; ++x) {
+      saved[x] = dst[x];
+      if ((src[x] >> 24) != 0)
+        dst[x] = FrameBuffer::PixelFormat::from_argb(src[x]);
+    }
+  }
+}
+
+void Cursor::erase(FrameBuffer::Pixel* buffer, size_t pitch) {
+  if (!m_is_drawn)
+    return;
+
+  m_is_drawn = false;
+  const int32_t width = m_drawn_rect.width();
+  for (int32_t y = 0; y < m_drawn_rect.height(); ++y) {
+    FrameBuffer::Pixel* dst = buffer + m_drawn_rect.x() + (m_drawn_rect.y() + y) * pitch;
+    const FrameBuffer::Pixel* saved = m_save_under + y * SIZE;
+    for (int32_t x = 0; x < width; ++x)
+      dst[x] = saved[x];
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "hardware/framebuffer.hpp"
+#include "wm/geometry.hpp"
+
+/**
+ * The mouse cursor, drawn above all the windows.
+ *
+ * When the firmware supports it, the VideoCore hardware cursor is used: moving it is a single property
+ * message and the screen buffer is never touched. Otherwise, the cursor is a software overlay drawn into
+ * the screen buffer, and the pixels it covers are saved first so erase() can restore them without
+ * redrawing the windows below (see WindowManager::move_cursor()).
+ */
+class Cursor {
+ public:
+  /** The width and height of the cursor image, in pixels. Its hotspot is the top-left corner. */
+  static constexpr int32_t SIZE = 16;
+
+  /** Uploads the cursor image to the VideoCore, if it supports a hardware cursor. */
+  void init(int32_t screen_width, int32_t screen_height);
+
+  [[nodiscard]] bool is_hardware() const { return m_is_hardware; }
+
+  /** Gets the screen area covered by the cursor at its current position. */
+  [[nodiscard]] Rect get_rect() const;
+
+  /** Moves the cursor hotspot to the screen coordinates (@a x, @a y), clamped to the screen. */
+  void set_position(int32_t x, int32_t y);
+
+  /** Draws the software cursor into @a buffer, saving the pixels below it. */
+  void draw(FrameBuffer::Pixel* buffer, size_t pitch);
+  /** Restores the pixels saved by the last draw() into the same @a buffer, if the cursor is still drawn. */
+  void erase(FrameBuffer::Pixel* buffer, size_t pitch);
+
+ private:
+  int32_t m_screen_width = 0, m_screen_height = 0;
+  int32_t m_x = 0, m_y = 0;
+  bool m_is_hardware = false;
+
+  // The area of the screen buffer covered by the software cursor, and its previous content.
+  bool m_is_drawn = false;
+  Rect m_drawn_rect;
+  FrameBuffer::Pixel m_save_under[SIZE * SIZE];
+};  // class Cursor
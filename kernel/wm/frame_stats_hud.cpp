@@ -0,0 +1,110 @@
+#include "wm/frame_stats_hud.hpp"
+
+#include <libk/format.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "graphics/graphics.hpp"
+
+FrameStatsHud::~FrameStatsHud() {
+  delete[] m_pixels;
+}
+
+void FrameStatsHud::init(int32_t screen_width) {
+  const int32_t height = LINE_COUNT * graphics::Painter().get_font().get_line_height() + 2 * MARGIN;
+  m_rect = Rect::from_pos_and_size(screen_width - WIDTH - MARGIN, MARGIN, WIDTH, height);
+}
+
+bool FrameStatsHud::toggle() {
+  if (m_is_enabled) {
+    m_is_enabled = false;
+    return true;
+  }
+
+  if (m_pixels == nullptr) {
+    m_pixels = new uint32_t[WIDTH * m_rect.height()];
+    if (m_pixels == nullptr)
+      return false;
+  }
+
+  // Nothing was measured while hidden, the next frame starts a new period.
+  m_is_enabled = true;
+  m_period_start = 0;
+  libk::strcpy(m_text, "waiting for a frame...");
+  render();
+  return true;
+}
+
+bool FrameStatsHud::record_frame(const Frame& frame, uint64_t now) {
+  // The first frame shown starts the first period.
+  if (m_period_start == 0) {
+    start_period(now);
+    return false;
+  }
+
+  ++m_frame_count;
+  m_composite_time += frame.composite_time;
+  m_present_time += frame.present_time;
+  m_max_frame_time = libk::max(m_max_frame_time, frame.composite_time + frame.present_time);
+  m_damaged_pixels += frame.damaged_pixels;
+  m_drawn_pixels += frame.drawn_pixels;
+  m_dma_requests += frame.dma_requests;
+
+  const uint64_t elapsed_time = now - m_period_start;
+  if (elapsed_time < REFRESH_PERIOD)
+    return false;
+
+  // The times are printed in tenths of milliseconds, the kernel does not use floating points.
+  const uint64_t fps_tenths = (m_frame_count * 10'000'000) / elapsed_time;
+  const uint64_t frame_time = (m_composite_time + m_present_time) / (100 * m_frame_count);
+  const uint64_t composite_time = m_composite_time / (100 * m_frame_count);
+  const uint64_t present_time = m_present_time / (100 * m_frame_count);
+  const uint64_t max_frame_time = m_max_frame_time / 100;
+  const uint64_t overdraw =
+      m_damaged_pixels != 0 ? ((m_drawn_pixels - m_damaged_pixels) * 100) / m_damaged_pixels : 0;
+
+  char text[MAX_TEXT_SIZE];
+  char* end = libk::format_to(text,
+                              "{}.{} fps, frame {}.{} ms (max {}.{})\n"
+                              "composite {}.{} ms, present {}.{} ms\n"
+                              "{} px damaged/frame\n"
+                              "{} DMA requests/frame, overdraw {}%",
+                              fps_tenths / 10, fps_tenths % 10, frame_time / 10, frame_time % 10, max_frame_time / 10,
+                              max_frame_time % 10, composite_time / 10, composite_time % 10, present_time / 10,
+                              present_time % 10, m_damaged_pixels / m_frame_count, m_dma_requests / m_frame_count,
+                              overdraw);
+  *end = '\0';
+
+  start_period(now);
+  if (libk::strcmp(text, m_text) == 0)
+    return false;
+
+  libk::strcpy(m_text, text);
+  render();
+  return true;
+}
+
+void FrameStatsHud::start_period(uint64_t now) {
+  m_period_start = now;
+  m_frame_count = 0;
+  m_composite_time = m_present_time = m_max_frame_time = 0;
+  m_damaged_pixels = m_drawn_pixels = 0;
+  m_dma_requests = 0;
+}
+
+void FrameStatsHud::render() {
+  graphics::Painter painter(m_pixels, WIDTH, m_rect.height(), WIDTH);
+  painter.clear(graphics::make_color(0x20, 0x20, 0x20));
+  painter.draw_text(MARGIN, MARGIN, m_text, 0x7fff7f);
+}
+
+void FrameStatsHud::draw(FrameBuffer::Pixel* buffer, size_t pitch, const Rect& rect) const {
+  const Rect area = m_rect.intersected(rect);
+  if (!m_is_enabled || !area.has_surface())
+    return;
+
+  const int32_t x = area.left() - m_rect.left();
+  for (int32_t y = area.top(); y < area.bottom(); ++y) {
+    graphics::convert_from_argb<FrameBuffer::PixelFormat>(&buffer[area.left() + pitch * y],
+                                                          &m_pixels[x + WIDTH * (y - m_rect.top())], area.width());
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "hardware/framebuffer.hpp"
+#include "wm/geometry.hpp"
+
+/**
+ * A debug overlay showing the compositor statistics in the top-right corner of the screen, above the windows (but
+ * below the cursor). It is toggled by Alt+H, see WindowManager::handle_key_event().
+ *
+ * The statistics of the presented frames are accumulated, and summed up at most every REFRESH_PERIOD: the FPS,
+ * the average frame time (split into the composition and the present, which includes the wait for the DMA
+ * requests), the damaged pixels, the DMA requests and the overdraw ratio. The text is only rendered again when
+ * it changes, into a small buffer copied over the damaged part of the HUD at each frame, so the HUD costs a few
+ * row copies per frame and one small redraw of its area per refresh.
+ */
+class FrameStatsHud {
+ public:
+  /** The statistics of a presented frame. */
+  struct Frame {
+    uint64_t composite_time;  // (in us)
+    uint64_t present_time;    // (in us)
+    uint64_t damaged_pixels;
+    uint64_t drawn_pixels;
+    size_t dma_requests;
+  };  // struct Frame
+
+  /** The minimum time (in microseconds) between two updates of the text. */
+  static constexpr uint64_t REFRESH_PERIOD = 500'000;
+
+  ~FrameStatsHud();
+
+  void init(int32_t screen_width);
+
+  [[nodiscard]] bool is_enabled() const { return m_is_enabled; }
+  /** Gets the screen area covered by the HUD. */
+  [[nodiscard]] Rect get_rect() const { return m_rect; }
+
+  /** Shows or hides the HUD. Returns false if out of memory. In any case, get_rect() is to be redrawn. */
+  bool toggle();
+
+  /** Accumulates the statistics of a frame presented at @a now (in us). Returns true if the text changed, the HUD
+   * area must then be redrawn. */
+  bool record_frame(const Frame& frame, uint64_t now);
+
+  /** Draws the part of the HUD inside @a rect into the screen @a buffer. */
+  void draw(FrameBuffer::Pixel* buffer, size_t pitch, const Rect& rect) const;
+
+ private:
+  static constexpr int32_t WIDTH = 360;
+  static constexpr int32_t MARGIN = 8;
+  static constexpr size_t LINE_COUNT = 4;
+  static constexpr size_t MAX_TEXT_SIZE = 256;
+
+  /** Starts accumulating the frames presented after @a now. */
+  void start_period(uint64_t now);
+  /** Renders m_text into m_pixels. */
+  void render();
+
+  bool m_is_enabled = false;
+  Rect m_rect;
+  uint32_t* m_pixels = nullptr;  // WIDTH x m_rect.height(), allocated when first shown
+  char m_text[MAX_TEXT_SIZE] = {};
+
+  // The frames presented since the start of the current period (0 if not started).
+  uint64_t m_period_start = 0;
+  size_t m_frame_count = 0;
+  uint64_t m_composite_time = 0;
+  uint64_t m_present_time = 0;
+  uint64_t m_max_frame_time = 0;
+  uint64_t m_damaged_pixels = 0;
+  uint64_t m_drawn_pixels = 0;
+  size_t m_dma_requests = 0;
+};  // class FrameStatsHud
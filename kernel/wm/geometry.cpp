@@ -0,0 +1,202 @@
+#include "geometry.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/string.hpp>
+
+#include <utility>
+
+Region::Region(const Rect& rect) {
+  if (!rect.has_surface())
+    return;
+
+  push_back(rect);
+}
+
+Region::~Region() {
+  delete[] m_rects;
+}
+
+Region::Region(const Region& other) {
+  *this = other;
+}
+
+Region::Region(Region&& other) noexcept {
+  *this = std::move(other);
+}
+
+Region& Region::operator=(const Region& other) {
+  if (this == &other)
+    return *this;
+
+  m_count = 0;
+  reserve(other.m_count);
+  if (other.m_count > 0)
+    libk::memcpy(m_rects, other.m_rects, sizeof(Rect) * other.m_count);
+  m_count = other.m_count;
+  return *this;
+}
+
+Region& Region::operator=(Region&& other) noexcept {
+  if (this == &other)
+    return *this;
+
+  delete[] m_rects;
+  m_rects = std::exchange(other.m_rects, nullptr);
+  m_count = std::exchange(other.m_count, 0);
+  m_capacity = std::exchange(other.m_capacity, 0);
+  return *this;
+}
+
+Rect Region::get_bounding_rect() const {
+  if (is_empty())
+    return {0, 0, 0, 0};
+
+  // The bands are sorted by y, but the left and right edges can be in any band.
+  Rect bounding_rect = m_rects[0];
+  for (size_t i = 1; i < m_count; ++i)
+    bounding_rect = bounding_rect.united(m_rects[i]);
+  return bounding_rect;
+}
+
+void Region::push_back(const Rect& rect) {
+  if (m_count == m_capacity)
+    reserve(libk::max<size_t>(8, 2 * m_capacity));
+
+  m_rects[m_count++] = rect;
+}
+
+void Region::reserve(size_t capacity) {
+  if (capacity <= m_capacity)
+    return;
+
+  Rect* rects = new Rect[capacity];
+  KASSERT(rects != nullptr);
+  if (m_count > 0)
+    libk::memcpy(rects, m_rects, sizeof(Rect) * m_count);
+
+  delete[] m_rects;
+  m_rects = rects;
+  m_capacity = capacity;
+}
+
+size_t Region::next_band(size_t index) const {
+  const int32_t top = m_rects[index].top();
+  while (index < m_count && m_rects[index].top() == top)
+    ++index;
+  return index;
+}
+
+bool Region::is_inside(bool in_a, bool in_b, Operation operation) {
+  switch (operation) {
+    case Operation::UNION:
+      return in_a || in_b;
+    case Operation::INTERSECTION:
+      return in_a && in_b;
+    case Operation::DIFFERENCE:
+      return in_a && !in_b;
+  }
+
+  return false;
+}
+
+void Region::append_band(int32_t top,
+                         int32_t bottom,
+                         const Rect* a,
+                         size_t a_count,
+                         const Rect* b,
+                         size_t b_count,
+                         Operation operation,
+                         size_t& last_band) {
+  const size_t band = m_count;
+
+  // Sweep the x axis, splitting it at each span edge of both bands.
+  size_t i = 0, j = 0;
+  int32_t x = INT32_MIN;
+  while (true) {
+    while (i < a_count && a[i].right() <= x)
+      ++i;
+    while (j < b_count && b[j].right() <= x)
+      ++j;
+    if (i == a_count && j == b_count)
+      break;
+
+    const int32_t a_left = (i < a_count) ? a[i].left() : INT32_MAX;
+    const int32_t b_left = (j < b_count) ? b[j].left() : INT32_MAX;
+    x = libk::max(x, libk::min(a_left, b_left));
+
+    const bool in_a = (a_left <= x);
+    const bool in_b = (b_left <= x);
+    const int32_t x_next = libk::min(in_a ? a[i].right() : a_left, in_b ? b[j].right() : b_left);
+
+    if (is_inside(in_a, in_b, operation)) {
+      if (m_count > band && m_rects[m_count - 1].right() == x)
+        m_rects[m_count - 1].x2 = x_next;  // touching the previous span
+      else
+        push_back({x, top, x_next, bottom});
+    }
+
+    x = x_next;
+  }
+
+  if (m_count == band)
+    return;  // empty band
+
+  // Merge the band with the previous one if they are adjacent and have the same spans.
+  const size_t band_size = m_count - band;
+  if (last_band < band && band - last_band == band_size && m_rects[last_band].bottom() == top) {
+    bool same_spans = true;
+    for (size_t k = 0; k < band_size; ++k) {
+      const Rect& previous = m_rects[last_band + k];
+      const Rect& current = m_rects[band + k];
+      if (previous.left() != current.left() || previous.right() != current.right()) {
+        same_spans = false;
+        break;
+      }
+    }
+
+    if (same_spans) {
+      for (size_t k = 0; k < band_size; ++k)
+        m_rects[last_band + k].y2 = bottom;
+      m_count = band;
+      return;
+    }
+  }
+
+  last_band = band;
+}
+
+Region Region::combine(const Region& a, const Region& b, Operation operation) {
+  Region result;
+  result.reserve(a.m_count + b.m_count);
+
+  // Sweep the y axis, splitting it at each band edge of both regions. As bands do not overlap,
+  // at most one band of each region covers each resulting interval.
+  size_t i = 0, j = 0;
+  size_t last_band = SIZE_MAX;
+  int32_t y = INT32_MIN;
+  while (true) {
+    while (i < a.m_count && a.m_rects[i].bottom() <= y)
+      i = a.next_band(i);
+    while (j < b.m_count && b.m_rects[j].bottom() <= y)
+      j = b.next_band(j);
+    if (i == a.m_count && j == b.m_count)
+      break;
+
+    const int32_t a_top = (i < a.m_count) ? a.m_rects[i].top() : INT32_MAX;
+    const int32_t b_top = (j < b.m_count) ? b.m_rects[j].top() : INT32_MAX;
+    y = libk::max(y, libk::min(a_top, b_top));
+
+    const bool in_a = (a_top <= y);
+    const bool in_b = (b_top <= y);
+    const int32_t y_next =
+        libk::min(in_a ? a.m_rects[i].bottom() : a_top, in_b ? b.m_rects[j].bottom() : b_top);
+
+    const size_t a_count = in_a ? a.next_band(i) - i : 0;
+    const size_t b_count = in_b ? b.next_band(j) - j : 0;
+    result.append_band(y, y_next, a.m_rects + i, a_count, b.m_rects + j, b_count, operation, last_band);
+
+    y = y_next;
+  }
+
+  return result;
+}
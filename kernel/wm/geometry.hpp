@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <libk/utils.hpp>
 
 struct Rect {
   int32_t x1, y1, x2, y2;
@@ -90,6 +91,28 @@ struct Rect {
     return true;
   }
 
+  /** Returns the smallest rectangle containing both this rectangle and @a r (null rectangles are ignored). */
+  [[nodiscard]] Rect united(const Rect& r) const {
+    if (!r.has_surface())
+      return *this;
+    if (!has_surface())
+      return r;
+
+    return {libk::min(x1, r.x1), libk::min(y1, r.y1), libk::max(x2, r.x2), libk::max(y2, r.y2)};
+  }
+
+  /** Returns the intersection of this rectangle and @a r (a null rectangle if they do not overlap). */
+  [[nodiscard]] Rect intersected(const Rect& r) const {
+    const int32_t left = libk::max(x1, r.x1);
+    const int32_t top = libk::max(y1, r.y1);
+    const int32_t right = libk::min(x2, r.x2);
+    const int32_t bottom = libk::min(y2, r.y2);
+    if (left >= right || top >= bottom)
+      return {0, 0, 0, 0};
+
+    return {left, top, right, bottom};
+  }
+
   static Rect from_edges(int32_t left, int32_t top, int32_t right, int32_t bottom) {
     return {left, top, right, bottom};
   }
@@ -98,3 +121,69 @@ struct Rect {
     return {x, y, x + width, y + height};
   }
 };  // struct Rect
+
+/**
+ * A set of pixels, stored as a list of non-overlapping rectangles.
+ *
+ * The rectangles are sorted in bands: a band is a row of rectangles with the same top and bottom
+ * edges, sorted by x and not touching each other. Bands are sorted by y and do not overlap, and two
+ * adjacent bands never have the same x spans (they are merged). So a region has a unique representation,
+ * with as few rectangles as the banded form allows.
+ */
+class Region {
+ public:
+  Region() = default;
+  explicit Region(const Rect& rect);
+  ~Region();
+
+  Region(const Region& other);
+  Region(Region&& other) noexcept;
+  Region& operator=(const Region& other);
+  Region& operator=(Region&& other) noexcept;
+
+  [[nodiscard]] bool is_empty() const { return m_count == 0; }
+  [[nodiscard]] size_t get_rect_count() const { return m_count; }
+  /** Returns the smallest rectangle containing the whole region (a null rectangle if empty). */
+  [[nodiscard]] Rect get_bounding_rect() const;
+
+  [[nodiscard]] const Rect* begin() const { return m_rects; }
+  [[nodiscard]] const Rect* end() const { return m_rects + m_count; }
+
+  void clear() { m_count = 0; }
+
+  /** Adds the pixels of @a other to this region. */
+  void unite(const Region& other) { *this = combine(*this, other, Operation::UNION); }
+  void unite(const Rect& rect) { unite(Region(rect)); }
+  /** Keeps only the pixels that are also in @a other. */
+  void intersect(const Region& other) { *this = combine(*this, other, Operation::INTERSECTION); }
+  void intersect(const Rect& rect) { intersect(Region(rect)); }
+  /** Removes the pixels of @a other from this region. */
+  void subtract(const Region& other) { *this = combine(*this, other, Operation::DIFFERENCE); }
+  void subtract(const Rect& rect) { subtract(Region(rect)); }
+
+ private:
+  enum class Operation { UNION, INTERSECTION, DIFFERENCE };
+
+  static Region combine(const Region& a, const Region& b, Operation operation);
+  /** Checks if a pixel (inside @a a or not, and inside @a b or not) is in the result of the @a operation. */
+  [[nodiscard]] static bool is_inside(bool in_a, bool in_b, Operation operation);
+  /** Appends the band [@a top, @a bottom) obtained by combining the x spans of two bands (given as
+   * sorted arrays of rectangles). @a last_band is the index of the previous band first rectangle. */
+  void append_band(int32_t top,
+                   int32_t bottom,
+                   const Rect* a,
+                   size_t a_count,
+                   const Rect* b,
+                   size_t b_count,
+                   Operation operation,
+                   size_t& last_band);
+  /** Returns the index of the first rectangle of the band following the one starting at @a index. */
+  [[nodiscard]] size_t next_band(size_t index) const;
+
+  void push_back(const Rect& rect);
+  void reserve(size_t capacity);
+
+  Rect* m_rects = nullptr;
+  size_t m_count = 0;
+  size_t m_capacity = 0;
+};  // class Region
@@ -1,36 +1,69 @@
 #include "message_queue.hpp"
 
-#include <libk/string.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
 
 bool MessageQueue::enqueue(const sys_message_t& msg) {
-  if (is_full())
+  const size_t tail = m_tail;
+  const size_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+
+  if (tail != head && is_coalescable(msg.id)) {
+    sys_message_t& last = m_queue[(tail - 1) % MAX_PENDING_MESSAGES];
+    if (last.id == msg.id && msg.id != SYS_MSG_TIMER) {
+      last = msg;
+      return true;
+    }
+
+    // The ticks of a same timer add up (see WindowTimer).
+    if (last.id == msg.id && last.param1 == msg.param1) {
+      last.timestamp = msg.timestamp;
+      last.param2 += msg.param2;
+      return true;
+    }
+  }
+
+  if (tail - head == MAX_PENDING_MESSAGES) {
+    if (m_dropped_count++ == 0)
+      LOG_WARNING("A window message queue is full, the new messages are dropped");
     return false;
+  }
 
-  m_queue[m_pending_count] = msg;
-  m_pending_count++;
-  m_wait_list.wake_all();
+  m_queue[tail % MAX_PENDING_MESSAGES] = msg;
+  __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+
+  // The tasks only wait on an empty queue.
+  if (tail == head)
+    m_wait_list.wake_all();
   return true;
 }
 
 bool MessageQueue::dequeue(sys_message_t& msg) {
-  if (is_empty())
-    return false;
+  return dequeue_many(&msg, 1) == 1;
+}
 
-  m_pending_count--;
-  msg = m_queue[0];
-  libk::memmove(&m_queue[0], &m_queue[1], sizeof(m_queue[0]) * m_pending_count);
-  return true;
+size_t MessageQueue::dequeue_many(sys_message_t* msgs, size_t max_count) {
+  const size_t head = m_head;
+  const size_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+
+  const size_t count = libk::min(tail - head, max_count);
+  for (size_t i = 0; i < count; ++i) {
+    msgs[i] = m_queue[(head + i) % MAX_PENDING_MESSAGES];
+  }
+
+  __atomic_store_n(&m_head, head + count, __ATOMIC_RELEASE);
+  return count;
 }
 
 bool MessageQueue::peek(sys_message_t& msg) {
-  if (is_empty())
+  const size_t head = m_head;
+  if (head == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE))
     return false;
 
-  msg = m_queue[0];
+  msg = m_queue[head % MAX_PENDING_MESSAGES];
   return true;
 }
 
-bool MessageQueue::block_task_until_not_empty(const libk::SharedPointer<Task>& task) {
+bool MessageQueue::block_task_until_not_empty(const libk::IntrusivePtr<Task>& task) {
   if (!is_empty())
     return false;
 
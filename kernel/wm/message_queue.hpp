@@ -3,18 +3,40 @@
 #include <sys/window.h>
 #include "task/wait_list.hpp"
 
+/**
+ * The messages sent to a window, waiting to be read by its task.
+ *
+ * The messages are stored in a ring indexed by free running head (next message to read) and tail
+ * (next free slot) counters, so both enqueue() and dequeue() are O(1). The tail is only written by the
+ * producer (the window manager) and the head only by the consumer (the system calls of the window task),
+ * with release stores after the slots are accessed: a single producer and a single consumer do not need
+ * any lock nor to mask the IRQs.
+ *
+ * Consecutive mouse moves and resizes are coalesced: only the latest position or size of a burst is
+ * kept. Consecutive ticks of a same timer are merged too, their expiration counts are added up. This
+ * rewrites the newest message in place, which is only safe because the producer and the consumer are
+ * also serialized by the kernel lock.
+ */
 class MessageQueue {
  public:
   static constexpr size_t MAX_PENDING_MESSAGES = 64;
+  static_assert((MAX_PENDING_MESSAGES & (MAX_PENDING_MESSAGES - 1)) == 0, "must be a power of two");
 
-  [[nodiscard]] bool is_empty() const { return m_pending_count == 0; }
-  [[nodiscard]] bool is_full() const { return m_pending_count == MAX_PENDING_MESSAGES; }
-  [[nodiscard]] size_t get_pending_count() const { return m_pending_count; }
+  [[nodiscard]] bool is_empty() const { return get_pending_count() == 0; }
+  [[nodiscard]] bool is_full() const { return get_pending_count() == MAX_PENDING_MESSAGES; }
+  [[nodiscard]] size_t get_pending_count() const {
+    return __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+  }
 
-  /** Returns true if succeeded (queue not full). */
+  /** Gets the count of messages dropped because the queue was full. */
+  [[nodiscard]] size_t get_dropped_count() const { return m_dropped_count; }
+
+  /** Returns true if succeeded (queue not full, or the message was coalesced). */
   bool enqueue(const sys_message_t& msg);
   /** Returns true if succeeded (queue not empty). */
   bool dequeue(sys_message_t& msg);
+  /** Dequeues up to @a max_count messages into @a msgs, and returns their count. */
+  size_t dequeue_many(sys_message_t* msgs, size_t max_count);
   /** Returns true if succeeded (queue not empty). */
   bool peek(sys_message_t& msg);
 
@@ -26,10 +48,16 @@ class MessageQueue {
    * Returns true if the task was blocked (the queue is currently empty).
    * Otherwise, returns false.
    */
-  bool block_task_until_not_empty(const libk::SharedPointer<Task>& task);
+  bool block_task_until_not_empty(const libk::IntrusivePtr<Task>& task);
 
  private:
+  [[nodiscard]] static bool is_coalescable(uint32_t id) {
+    return id == SYS_MSG_MOUSEMOVE || id == SYS_MSG_RESIZE || id == SYS_MSG_TIMER;
+  }
+
   WaitList m_wait_list;
-  size_t m_pending_count = 0;
+  size_t m_head = 0;
+  size_t m_tail = 0;
+  size_t m_dropped_count = 0;
   sys_message_t m_queue[MAX_PENDING_MESSAGES];
 };  // class MessageQueue
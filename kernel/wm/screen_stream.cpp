@@ -0,0 +1,184 @@
+#include "wm/screen_stream.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+#include "hardware/uart.hpp"
+
+namespace {
+enum PacketType : uint8_t {
+  PACKET_RESET = 0,
+  PACKET_RECT = 1,
+};  // enum PacketType
+
+enum TokenOperation : uint8_t {
+  TOKEN_SKIP = 0,
+  TOKEN_REPEAT = 1,
+  TOKEN_LITERAL = 2,
+};  // enum TokenOperation
+
+/** The longest run of pixels in a token. */
+constexpr int32_t MAX_TOKEN_COUNT = 64;
+
+struct [[gnu::packed]] ResetPacket {
+  char magic[3];
+  uint8_t type;
+  uint16_t width;
+  uint16_t height;
+};  // struct ResetPacket
+
+struct [[gnu::packed]] RectPacket {
+  char magic[3];
+  uint8_t type;
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+  uint32_t byte_size;  // of the data following the packet
+};  // struct RectPacket
+}  // namespace
+
+ScreenStream::~ScreenStream() {
+  delete[] m_reference;
+  delete[] m_row;
+  delete[] m_output;
+}
+
+bool ScreenStream::init(UART* uart, int32_t width, int32_t height) {
+  KASSERT(m_uart == nullptr && uart != nullptr);
+
+  m_reference = new uint32_t[(size_t)width * height];
+  m_row = new uint32_t[width];
+  m_output = new uint8_t[OUTPUT_BUFFER_SIZE];
+  if (m_reference == nullptr || m_row == nullptr || m_output == nullptr)
+    return false;
+
+  m_uart = uart;
+  m_width = width;
+  m_height = height;
+  request_key_frame();
+  return true;
+}
+
+void ScreenStream::request_key_frame() {
+  // The reset packet is appended by flush(), once the output buffer has room.
+  m_is_key_frame_pending = true;
+}
+
+void ScreenStream::append(const void* data, size_t size) {
+  KASSERT(m_output_size + size <= OUTPUT_BUFFER_SIZE);
+  libk::memcpy(m_output + m_output_size, data, size);
+  m_output_size += size;
+}
+
+void ScreenStream::encode_row(const FrameBuffer::Pixel* src, uint32_t* reference, int32_t width) {
+  for (int32_t i = 0; i < width; ++i) {
+    const uint32_t rgb = FrameBuffer::PixelFormat::to_argb(src[i]) & 0xffffff;
+    m_row[i] = rgb ^ reference[i];
+    reference[i] = rgb;
+  }
+
+  const auto append_token = [this](uint8_t operation, int32_t count) {
+    m_output[m_output_size++] = (operation << 6) | (count - 1);
+  };
+  const auto append_value = [this](uint32_t value) {
+    m_output[m_output_size++] = value >> 16;
+    m_output[m_output_size++] = value >> 8;
+    m_output[m_output_size++] = value;
+  };
+
+  int32_t i = 0;
+  while (i < width) {
+    const uint32_t value = m_row[i];
+    int32_t run = 1;
+    while (i + run < width && run < MAX_TOKEN_COUNT && m_row[i + run] == value)
+      ++run;
+
+    if (value == 0) {
+      append_token(TOKEN_SKIP, run);
+      i += run;
+    } else if (run > 1) {
+      append_token(TOKEN_REPEAT, run);
+      append_value(value);
+      i += run;
+    } else {
+      // The literal ends where an unchanged pixel or a repeat starts.
+      int32_t count = 0;
+      while (i + count < width && count < MAX_TOKEN_COUNT && m_row[i + count] != 0 &&
+             (i + count + 1 == width || m_row[i + count + 1] != m_row[i + count]))
+        ++count;
+
+      append_token(TOKEN_LITERAL, count);
+      for (int32_t j = 0; j < count; ++j)
+        append_value(m_row[i + j]);
+      i += count;
+    }
+  }
+}
+
+void ScreenStream::send(const FrameBuffer::Pixel* buffer, size_t pitch, const Rect& rect) {
+  if (!is_enabled())
+    return;
+
+  const Rect area = rect.intersected({0, 0, m_width, m_height});
+  if (!area.has_surface())
+    return;
+
+  // The rows are sent while the output buffer has room for their worst case, the remaining ones later.
+  const size_t max_row_size = 4 * (size_t)area.width();
+  int32_t y = area.top();
+  if (m_output_size + sizeof(RectPacket) + max_row_size <= OUTPUT_BUFFER_SIZE) {
+    const size_t packet_offset = m_output_size;
+    m_output_size += sizeof(RectPacket);
+
+    while (y < area.bottom() && m_output_size + max_row_size <= OUTPUT_BUFFER_SIZE) {
+      encode_row(buffer + area.left() + pitch * y, m_reference + area.left() + (size_t)m_width * y, area.width());
+      ++y;
+    }
+
+    const RectPacket packet = {{'S', 'C', 'R'},
+                               PACKET_RECT,
+                               (uint16_t)area.left(),
+                               (uint16_t)area.top(),
+                               (uint16_t)area.width(),
+                               (uint16_t)(y - area.top()),
+                               (uint32_t)(m_output_size - packet_offset - sizeof(RectPacket))};
+    libk::memcpy(m_output + packet_offset, &packet, sizeof(packet));
+  }
+
+  if (y < area.bottom()) {
+    m_pending.unite(Rect::from_edges(area.left(), y, area.right(), area.bottom()));
+    if (m_pending.get_rect_count() > MAX_PENDING_RECTS)
+      m_pending = Region(m_pending.get_bounding_rect());
+  }
+}
+
+void ScreenStream::flush() {
+  if (!is_enabled())
+    return;
+
+  if (m_is_key_frame_pending && m_output_size + sizeof(ResetPacket) <= OUTPUT_BUFFER_SIZE) {
+    // The viewer starts from a black screen, so the whole screen is sent XORed against black.
+    const ResetPacket packet = {{'S', 'C', 'R'}, PACKET_RESET, (uint16_t)m_width, (uint16_t)m_height};
+    append(&packet, sizeof(packet));
+    libk::bzero(m_reference, sizeof(uint32_t) * m_width * m_height);
+    m_pending = Region({0, 0, m_width, m_height});
+    m_is_key_frame_pending = false;
+  }
+
+  const size_t written = m_uart->write_available((const char*)m_output, m_output_size);
+  if (written > 0) {
+    libk::memmove(m_output, m_output + written, m_output_size - written);
+    m_output_size -= written;
+  }
+}
+
+Region ScreenStream::take_pending_damage() {
+  // Drawing the areas again is only worth it if most of them can be sent.
+  if (m_output_size > OUTPUT_BUFFER_SIZE / 2)
+    return {};
+
+  Region pending = std::move(m_pending);
+  m_pending.clear();
+  return pending;
+}
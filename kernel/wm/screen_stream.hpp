@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "hardware/framebuffer.hpp"
+#include "wm/geometry.hpp"
+
+class UART;
+
+/**
+ * Streams the presented frames to a host viewer over a UART (see tools/uart-input-server.py), for the boards and
+ * QEMU runs without a screen. Enabled by CONFIG_SCREEN_STREAM.
+ *
+ * Only the damaged areas are sent, XORed against the previous content sent (kept in a reference copy of the
+ * screen) and run-length encoded: the unchanged pixels of a damaged area cost almost nothing, the bandwidth scales
+ * with what changed. The encoded bytes wait in an output buffer drained into the UART without blocking, at each
+ * frame. When it is full, the remaining areas are kept and drawn again once it has room (see take_pending_damage()).
+ *
+ * The packets start with "SCR" and their type, the integers are little-endian:
+ * - RESET (0): the screen width and height (16 bits each). The viewer clears its screen to black.
+ * - RECT (1): the x, y, width and height of a rectangle (16 bits each), the byte size of its data (32 bits),
+ *   then the data. Each row is a list of tokens: a byte holding the operation (2 high bits) and the count of
+ *   pixels minus 1 (6 low bits), followed by:
+ *   - SKIP (0): nothing, the pixels are unchanged.
+ *   - REPEAT (1): a RGB value XORed into all the pixels.
+ *   - LITERAL (2): a RGB value XORed into each pixel.
+ */
+class ScreenStream {
+ public:
+  ~ScreenStream();
+
+  /** Starts streaming a @a width x @a height screen to @a uart (with IRQs enabled), with a key frame.
+   * Returns false if out of memory. */
+  bool init(UART* uart, int32_t width, int32_t height);
+
+  [[nodiscard]] bool is_enabled() const { return m_uart != nullptr; }
+
+  /** Sends a full frame again (the viewer restarted), see take_pending_damage(). */
+  void request_key_frame();
+
+  /** Encodes the @a rect area of the presented @a buffer, or keeps it for later if the output buffer is full. */
+  void send(const FrameBuffer::Pixel* buffer, size_t pitch, const Rect& rect);
+
+  /** Writes the encoded bytes into the UART, as much as its TX ring accepts. To be called at each frame. */
+  void flush();
+  /** Checks if some bytes or areas are still to be sent, flush() must then be called at the next frame. */
+  [[nodiscard]] bool is_busy() const { return m_output_size > 0 || m_is_key_frame_pending || !m_pending.is_empty(); }
+
+  /** Takes the areas that could not be sent, once the output buffer has room for them: they are to be redrawn,
+   * so send() gets them with the next presented frame. */
+  [[nodiscard]] Region take_pending_damage();
+
+ private:
+  static constexpr size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+  /** Above this count of rectangles, the pending areas are simplified to their bounding rectangle. */
+  static constexpr size_t MAX_PENDING_RECTS = 16;
+
+  /** Appends @a size bytes to the output buffer, which must have room for them. */
+  void append(const void* data, size_t size);
+  /** Encodes the row of @a width pixels at @a src, updating the reference row @a reference. The output buffer must
+   * have room for 4 bytes per pixel (the worst case). */
+  void encode_row(const FrameBuffer::Pixel* src, uint32_t* reference, int32_t width);
+
+  UART* m_uart = nullptr;
+  int32_t m_width = 0;
+  int32_t m_height = 0;
+  uint32_t* m_reference = nullptr;  // the pixels as known by the viewer, in 0x00RRGGBB format
+  uint32_t* m_row = nullptr;        // the XORed values of the row being encoded
+  uint8_t* m_output = nullptr;      // OUTPUT_BUFFER_SIZE bytes
+  size_t m_output_size = 0;
+  Region m_pending;  // the areas not sent yet
+  bool m_is_key_frame_pending = false;
+};  // class ScreenStream
@@ -1,21 +1,64 @@
 #include "window.hpp"
+#include <libk/log.hpp>
+#include <libk/object_cache.hpp>
+#include "boot/mmu_utils.hpp"
 #include "data/pika_icon.hpp"
+#include "graphics/text_width_cache.hpp"
 #include "memory/mem_alloc.hpp"
 
-Window::Window(const libk::SharedPointer<Task>& task) : m_task(task) {
+static libk::ObjectCache<Window> g_window_cache;
+
+void* Window::operator new(size_t size) {
+  KASSERT(size == sizeof(Window));
+  return g_window_cache.allocate();
+}
+
+void Window::operator delete(void* ptr) {
+  g_window_cache.deallocate(ptr);
+}
+
+Window::Window(const libk::IntrusivePtr<Task>& task) : m_task(task) {
   KASSERT(task != nullptr);
 
   m_painter = {nullptr, 0, 0, 0};
 
 #ifdef CONFIG_USE_DMA
 #ifdef CONFIG_WINDOW_LARGE_FRAMEBUFFER
-  m_framebuffer = libk::make_scoped<Buffer>(sizeof(uint32_t) * MAX_WIDTH * MAX_HEIGHT);
+  m_framebuffers[0] = allocate_framebuffer(MAX_WIDTH, MAX_HEIGHT);
   m_geometry = {0, 0, 0, 0};
   m_framebuffer_pitch = 0;
 #endif  // CONFIG_WINDOW_LARGE_FRAMEBUFFER
 #endif  // CONFIG_USE_DMA
 }
 
+WindowTimer* Window::create_timer() {
+  auto* timer = new WindowTimer(this);
+  if (timer == nullptr)
+    return nullptr;
+
+  timer->m_handle = m_task->register_window_timer(timer);
+  if (timer->m_handle == INVALID_HANDLE) {
+    delete timer;
+    return nullptr;
+  }
+
+  m_timers.push_back(timer);
+  return timer;
+}
+
+void Window::destroy_timer(WindowTimer* timer) {
+  KASSERT(timer->get_window() == this);
+
+  m_task->unregister_window_timer(timer->m_handle);
+  m_timers.remove(timer);
+  delete timer;  // which cancels it
+}
+
+void Window::destroy_timers() {
+  while (!m_timers.is_empty())
+    destroy_timer(m_timers.front());
+}
+
 void Window::set_title(libk::StringView title) {
   delete[] m_title.get_data();
 
@@ -26,16 +69,57 @@ void Window::set_title(libk::StringView title) {
   libk::memcpy(buffer, title.get_data(), length);
   buffer[length] = '\0';
   m_title = {buffer, length};
+  m_is_decoration_valid = false;
 }
 
 void Window::set_geometry(const Rect& rect) {
-  const bool resized = rect.width() != m_geometry.width() || rect.height() != m_geometry.height();
+  const auto old_geometry = m_geometry;
+  const uint32_t old_surface_width = get_surface_width();
+  const uint32_t old_surface_height = get_surface_height();
 
   m_geometry = rect;
+  publish_state();
 
-  // Reallocate the framebuffer if needed.
-  if (resized)
-    reallocate_framebuffer();
+  // Reallocate the framebuffer if needed. The decoration only depends on the width (not on the position).
+  if (get_surface_width() != old_surface_width || get_surface_height() != old_surface_height)
+    resize_framebuffer(old_surface_width, old_surface_height);
+  if (rect.width() != old_geometry.width())
+    m_is_decoration_valid = false;
+}
+
+void Window::set_surface_size(uint32_t width, uint32_t height) {
+  const uint32_t old_surface_width = get_surface_width();
+  const uint32_t old_surface_height = get_surface_height();
+
+  m_surface_width = width;
+  m_surface_height = height;
+  publish_state();
+
+  if (get_surface_width() != old_surface_width || get_surface_height() != old_surface_height)
+    resize_framebuffer(old_surface_width, old_surface_height);
+}
+
+Rect Window::surface_to_window(const Rect& rect) const {
+  if (!is_scaled())
+    return rect;
+
+  // The bilinear scaling blends each pixel with its neighbors, so one more surface pixel is taken on each side.
+  const int64_t window_width = m_geometry.width();
+  const int64_t window_height = m_geometry.height();
+  const int64_t surface_width = get_surface_width();
+  const int64_t surface_height = get_surface_height();
+  const int64_t x1 = libk::max<int64_t>(((int64_t)rect.left() - 1) * window_width / surface_width, 0);
+  const int64_t y1 = libk::max<int64_t>(((int64_t)rect.top() - 1) * window_height / surface_height, 0);
+  const int64_t x2 =
+      libk::min<int64_t>(libk::div_round_up(((int64_t)rect.right() + 1) * window_width, surface_width), window_width);
+  const int64_t y2 = libk::min<int64_t>(
+      libk::div_round_up(((int64_t)rect.bottom() + 1) * window_height, surface_height), window_height);
+  return {(int32_t)x1, (int32_t)y1, (int32_t)x2, (int32_t)y2};
+}
+
+void Window::set_visibility(bool visible) {
+  m_visible = visible;
+  publish_state();
 }
 
 void Window::clear(uint32_t argb) {
@@ -58,57 +142,307 @@ void Window::draw_text(uint32_t x, uint32_t y, const char* text, uint32_t argb)
   m_painter.draw_text(x, y, text, argb);
 }
 
+uint32_t Window::measure_text(const char* text) const {
+  return graphics::TextWidthCache::get(m_painter.get_font(), text);
+}
+
 void Window::blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer) {
   m_painter.blit(x, y, width, height, argb_buffer);
 }
 
-void Window::draw_frame() {
-  if (!m_has_frame)
-    return;
+void Window::copy_area(uint32_t src_x,
+                       uint32_t src_y,
+                       uint32_t width,
+                       uint32_t height,
+                       uint32_t dst_x,
+                       uint32_t dst_y) {
+  // Out of range values are outside the framebuffer, and clipped as such.
+  const auto clamp = [](uint32_t value) { return (int32_t)libk::min<uint32_t>(value, INT32_MAX); };
+  m_painter.copy_area(clamp(src_x), clamp(src_y), clamp(width), clamp(height), clamp(dst_x), clamp(dst_y));
+}
+
+void Window::set_clipping(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  // The painter bounds are inclusive and limited to the framebuffer, so the values only need to fit in int32_t.
+  const int64_t x_max = libk::min<int64_t>((int64_t)x + width, INT32_MAX) - 1;
+  const int64_t y_max = libk::min<int64_t>((int64_t)y + height, INT32_MAX) - 1;
+  m_painter.set_clipping(libk::min<uint32_t>(x, INT32_MAX), libk::min<uint32_t>(y, INT32_MAX), x_max, y_max);
+}
+
+void Window::revert_clipping() {
+  m_painter.revert_clipping();
+}
+
+const uint32_t* Window::get_decoration() {
+  const int32_t width = m_geometry.width();
+  const size_t byte_size = sizeof(uint32_t) * width * DECORATION_HEIGHT;
+  if (!m_decoration || m_decoration->get_byte_size() < byte_size) {
+    auto decoration = libk::make_scoped<MemoryChunk>(libk::max<size_t>(libk::div_round_up(byte_size, PAGE_SIZE), 1),
+                                                     /* is_zeroed= */ false);
+    if (!decoration || !decoration->is_status_okay())
+      return nullptr;
+
+    m_decoration = std::move(decoration);
+    m_is_decoration_valid = false;
+  }
+
+  auto* pixels = (uint32_t*)m_decoration->get();
+  if (m_is_decoration_valid)
+    return pixels;
 
-  constexpr const uint32_t TITLE_BAR_HEIGHT = 30;
   constexpr const graphics::Color BACKGROUND_COLOR = 0xff282828;
-  constexpr const graphics::Color BORDER_COLOR = 0xff121212;
 
-  m_painter.fill_rect(0, 0, m_geometry.width(), TITLE_BAR_HEIGHT, BACKGROUND_COLOR);
-  m_painter.draw_rect(0, 0, m_geometry.width(), m_geometry.height(), BORDER_COLOR);
-  m_painter.draw_line(0, TITLE_BAR_HEIGHT, m_geometry.width(), TITLE_BAR_HEIGHT, BORDER_COLOR);
+  // The painter clips the left, top and right borders to the title bar.
+  graphics::Painter painter(pixels, width, DECORATION_HEIGHT, width);
+  painter.set_font(m_painter.get_font());
+  painter.fill_rect(0, 0, width, TITLE_BAR_HEIGHT, BACKGROUND_COLOR);
+  painter.draw_rect(0, 0, width, m_geometry.height(), BORDER_COLOR);
+  painter.draw_line(0, TITLE_BAR_HEIGHT, width, TITLE_BAR_HEIGHT, BORDER_COLOR);
 
   // Draw the pikachu icon.
   constexpr uint32_t pika_color = 0xffffff;
   for (uint32_t i = 0; i < pika_icon_width; ++i) {
     for (uint32_t j = 0; j < pika_icon_height; ++j) {
       const uint32_t color = pika_color | (pika_icon[i + pika_icon_height * j] << 24);
-      m_painter.draw_pixel(5 + i, 2 + j, color);
+      painter.draw_pixel(5 + i, 2 + j, color);
     }
   }
 
-  const auto text_width = m_painter.get_font().get_width(m_title.get_data(), m_title.get_length());
-  const auto text_x = (m_geometry.width() - text_width) / 2;
-  const auto text_y = (TITLE_BAR_HEIGHT - m_painter.get_font().get_char_height()) / 2;
-  m_painter.draw_text(text_x, text_y, m_title.get_data(), 0xffffff);
+  const auto text_width = graphics::TextWidthCache::get(painter.get_font(), m_title.get_data(), m_title.get_length());
+  const auto text_x = (width - text_width) / 2;
+  const auto text_y = (TITLE_BAR_HEIGHT - painter.get_font().get_char_height()) / 2;
+  painter.draw_text(text_x, text_y, m_title.get_data(), 0xffffff);
+
+  m_is_decoration_valid = true;
+  return pixels;
 }
 
-void Window::reallocate_framebuffer() {
+void Window::resize_framebuffer(uint32_t old_width, uint32_t old_height) {
+#if defined(CONFIG_USE_DMA) && defined(CONFIG_WINDOW_LARGE_FRAMEBUFFER)
+  // The framebuffer is allocated for the biggest window. With a constant pitch, the content stays in place.
+  (void)old_width;
+  (void)old_height;
+  m_framebuffer_pitch = MAX_WIDTH;
+  m_framebuffer_capacity_height = MAX_HEIGHT;
+#else
+  const uint32_t width = get_surface_width();
+  const uint32_t height = get_surface_height();
+  const bool fits = m_framebuffers[0] && width <= m_framebuffer_pitch && height <= m_framebuffer_capacity_height;
+  // Only shrink when most of the framebuffer is unused, so resizing back and forth does not reallocate.
+  const bool is_too_big = (uint64_t)width * height * FRAMEBUFFER_SHRINK_RATIO <
+                          (uint64_t)m_framebuffer_pitch * m_framebuffer_capacity_height;
+
+  if (is_too_big) {
+    replace_framebuffer(width, height, old_width, old_height);
+  } else if (!fits) {
+    // Grow geometrically the dimensions that are too small, so the next steps of an interactive
+    // resize fit in the new framebuffer.
+    const auto grow = [](uint32_t capacity, uint32_t needed, uint32_t max) {
+      if (needed <= capacity)
+        return capacity;
+      return libk::clamp(capacity + capacity / 2, needed, max);
+    };
+
+    replace_framebuffer(grow(m_framebuffer_pitch, width, MAX_WIDTH),
+                        grow(m_framebuffer_capacity_height, height, MAX_HEIGHT), old_width, old_height);
+  }
+#endif  // CONFIG_USE_DMA && CONFIG_WINDOW_LARGE_FRAMEBUFFER
+
+  update_painter();
+}
+
+void Window::update_painter() {
+  auto* pixels = m_framebuffers[m_back_buffer] ? (uint32_t*)m_framebuffers[m_back_buffer]->get() : nullptr;
+  m_painter = graphics::Painter(pixels, get_surface_width(), get_surface_height(), m_framebuffer_pitch);
+}
+
+#if !defined(CONFIG_USE_DMA) || !defined(CONFIG_WINDOW_LARGE_FRAMEBUFFER)
+void Window::replace_framebuffer(uint32_t pitch, uint32_t capacity_height, uint32_t old_width, uint32_t old_height) {
+  const size_t row_byte_size = sizeof(uint32_t) * libk::min<uint32_t>(old_width, get_surface_width());
+  const uint32_t nb_rows = libk::min<uint32_t>(old_height, get_surface_height());
+  for (uint32_t i = 0; i < m_nb_buffers; ++i) {
+    auto framebuffer = allocate_framebuffer(pitch, capacity_height);
+    KASSERT(framebuffer);
+    auto* pixels = (uint32_t*)framebuffer->get();
+
+    // Keep the old content that is still visible, so the window does not flicker until its owner redraws it.
+    if (m_framebuffers[i]) {
+      const auto* old_pixels = (const uint32_t*)m_framebuffers[i]->get();
+      for (uint32_t y = 0; y < nb_rows; ++y)
+        libk::memcpy(pixels + pitch * y, old_pixels + m_framebuffer_pitch * y, row_byte_size);
+    }
+
+    // The old framebuffer is unmapped from the owner process when destroyed.
+    m_framebuffers[i].reset();
+    m_framebuffers[i] = std::move(framebuffer);
+    if (m_surface_addresses[i] != 0)
+      map_surface_at(i, m_surface_addresses[i]);
+  }
+
+  m_framebuffer_pitch = pitch;
+  m_framebuffer_capacity_height = capacity_height;
+}
+#endif  // CONFIG_USE_DMA && CONFIG_WINDOW_LARGE_FRAMEBUFFER
+
+libk::ScopedPointer<Window::Framebuffer> Window::allocate_framebuffer(uint32_t pitch, uint32_t capacity_height) {
+  const size_t byte_size = sizeof(uint32_t) * pitch * capacity_height;
 #ifdef CONFIG_USE_DMA
-#ifdef CONFIG_WINDOW_LARGE_FRAMEBUFFER
-  // Update the painter.
-  uint32_t* framebuffer = (uint32_t*)m_framebuffer->get();
-  m_framebuffer_pitch = m_geometry.width();
-  m_painter = graphics::Painter(framebuffer, m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
+  auto framebuffer = libk::make_scoped<Buffer>(byte_size);
 #else
-  m_framebuffer.reset();
-  const auto buffer_size = sizeof(uint32_t) * m_geometry.width() * m_geometry.height();
-  m_framebuffer = libk::make_scoped<Buffer>(buffer_size);
-  m_task->get_memory()->map_buffer(*m_framebuffer.get(), 0x0000ff0000000000, false, false);
-  m_painter =
-      graphics::Painter((uint32_t*)m_framebuffer->get(), m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
-#endif
+  // The new framebuffer is zeroed.
+  auto framebuffer = libk::make_scoped<MemoryChunk>(libk::max<size_t>(libk::div_round_up(byte_size, PAGE_SIZE), 1));
+  if (framebuffer && !framebuffer->is_status_okay())
+    framebuffer.reset();
+#endif  // CONFIG_USE_DMA
+  return framebuffer;
+}
+
+bool Window::set_buffer_count(uint32_t count) {
+  KASSERT(count >= 1 && count <= MAX_BUFFERS);
+  if (count == m_nb_buffers)
+    return true;
+
+  // Allocate the new buffers first, so nothing changes if out of memory. Without framebuffer yet, they are all
+  // allocated by the first resize.
+  libk::ScopedPointer<Framebuffer> new_buffers[MAX_BUFFERS];
+  const Framebuffer* front_buffer = get_front_buffer();
+  for (uint32_t i = m_nb_buffers; i < count && front_buffer != nullptr; ++i) {
+#if defined(CONFIG_USE_DMA) && defined(CONFIG_WINDOW_LARGE_FRAMEBUFFER)
+    new_buffers[i] = allocate_framebuffer(MAX_WIDTH, MAX_HEIGHT);
 #else
-  delete[] m_framebuffer;
-  m_framebuffer = new uint32_t[m_geometry.width() * m_geometry.height()];
-  m_framebuffer_pitch = m_geometry.width();
-  libk::bzero(m_framebuffer, sizeof(uint32_t) * m_geometry.width() * m_geometry.height());
-  m_painter = graphics::Painter(m_framebuffer, m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
-#endif
+    new_buffers[i] = allocate_framebuffer(m_framebuffer_pitch, m_framebuffer_capacity_height);
+#endif  // CONFIG_USE_DMA && CONFIG_WINDOW_LARGE_FRAMEBUFFER
+    if (!new_buffers[i])
+      return false;
+
+    // Start with the front content, the owner may only redraw what changed.
+    auto* pixels = (uint32_t*)new_buffers[i]->get();
+    const auto* front_pixels = (const uint32_t*)front_buffer->get();
+    for (uint32_t y = 0; y < get_surface_height(); ++y) {
+      libk::memcpy(pixels + m_framebuffer_pitch * y, front_pixels + m_framebuffer_pitch * y,
+                   sizeof(uint32_t) * get_surface_width());
+    }
+  }
+
+  // The front buffer is moved first, the buffers above the count are freed.
+
+  std::swap(m_framebuffers[0], m_framebuffers[m_front_buffer]);
+  std::swap(m_surface_addresses[0], m_surface_addresses[m_front_buffer]);
+  for (uint32_t i = 1; i < MAX_BUFFERS; ++i) {
+    if (i >= count) {
+      m_framebuffers[i].reset();  // which unmaps it
+      m_surface_addresses[i] = 0;
+    } else if (i >= m_nb_buffers) {
+      m_framebuffers[i] = std::move(new_buffers[i]);
+    }
+  }
+
+  m_nb_buffers = count;
+  m_front_buffer = 0;
+  m_back_buffer = count > 1 ? 1 : 0;
+  for (auto& swap_count : m_buffer_swap_counts)
+    swap_count = m_swap_count;  // they all have the front content
+  update_painter();
+  return true;
+}
+
+bool Window::swap_buffers() {
+  ++m_swap_count;
+  m_front_buffer = m_back_buffer;
+  m_buffer_swap_counts[m_front_buffer] = m_swap_count;
+  if (m_nb_buffers == 1)
+    return true;
+
+  return select_back_buffer();
+}
+
+uint32_t Window::get_back_buffer_age() const {
+  return m_swap_count - m_buffer_swap_counts[m_back_buffer] + 1;
+}
+
+bool Window::select_back_buffer() {
+  // The oldest buffer first. A buffer pinned by the composition in progress is still read by the DMA.
+  for (uint32_t i = 1; i < m_nb_buffers; ++i) {
+    const uint32_t buffer = (m_front_buffer + i) % m_nb_buffers;
+#ifdef CONFIG_USE_DMA
+    if (m_framebuffers[buffer] && m_framebuffers[buffer]->is_pinned())
+      continue;
+#endif  // CONFIG_USE_DMA
+
+    m_back_buffer = buffer;
+    update_painter();
+    return true;
+  }
+
+  m_back_buffer = m_front_buffer;
+  update_painter();
+  return false;
+}
+
+VirtualAddress Window::map_surface() {
+  if (m_surface_addresses[m_back_buffer] != 0)
+    return m_surface_addresses[m_back_buffer];
+
+  if (!m_framebuffers[m_back_buffer])
+    return 0;
+
+  const VirtualAddress address = m_task->get_memory()->allocate_surface_address();
+  if (address == 0 || !map_surface_at(m_back_buffer, address))
+    return 0;
+
+  m_surface_addresses[m_back_buffer] = address;
+  return address;
+}
+
+VirtualAddress Window::map_state() {
+  if (m_state_address != 0)
+    return m_state_address;
+
+  m_state_page = libk::make_scoped<Buffer>(PAGE_SIZE);
+  libk::bzero(m_state_page->get(), sizeof(sys_window_state_t));
+  publish_state();
+
+  m_state_address = m_task->get_memory()->map_shared(*m_state_page, /* read_only= */ true);
+  if (m_state_address == 0)
+    m_state_page.reset();
+  return m_state_address;
+}
+
+void Window::unmap_state() {
+  if (m_state_address == 0)
+    return;
+
+  (void)m_task->get_memory()->unmap_shared(m_state_address);
+  m_state_address = 0;
+  m_state_page.reset();
+}
+
+void Window::publish_state() {
+  if (!m_state_page)
+    return;
+
+  // A seqlock: the sequence is odd while the state is written, so the readers retry (see sys_window_get_state()).
+  auto* state = (sys_window_state_t*)m_state_page->get();
+  const uint32_t sequence = state->sequence;
+  __atomic_store_n(&state->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  __atomic_store_n(&state->x, m_geometry.x(), __ATOMIC_RELAXED);
+  __atomic_store_n(&state->y, m_geometry.y(), __ATOMIC_RELAXED);
+  __atomic_store_n(&state->width, (uint32_t)m_geometry.width(), __ATOMIC_RELAXED);
+  __atomic_store_n(&state->height, (uint32_t)m_geometry.height(), __ATOMIC_RELAXED);
+  __atomic_store_n(&state->visible, (uint32_t)m_visible, __ATOMIC_RELAXED);
+  __atomic_store_n(&state->focus, (uint32_t)m_focus, __ATOMIC_RELAXED);
+  __atomic_store_n(&state->surface_width, get_surface_width(), __ATOMIC_RELAXED);
+  __atomic_store_n(&state->surface_height, get_surface_height(), __ATOMIC_RELAXED);
+
+  __atomic_store_n(&state->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+bool Window::map_surface_at(uint32_t buffer, VirtualAddress address) {
+  if (!m_task->get_memory()->map_surface(*m_framebuffers[buffer], address)) {
+    LOG_ERROR("Failed to map the surface of a window in the process pid={}", m_task->get_id());
+    return false;
+  }
+
+  return true;
 }
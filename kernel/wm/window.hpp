@@ -1,12 +1,16 @@
 #pragma once
 
+#include <sys/window.h>
+#include <libk/intrusive_list.hpp>
 #include <libk/memory.hpp>
 #include <libk/string_view.hpp>
 #include "graphics/graphics.hpp"
 #include "memory/buffer.hpp"
+#include "memory/memory_chunk.hpp"
 #include "task/task.hpp"
 #include "wm/geometry.hpp"
 #include "wm/message_queue.hpp"
+#include "wm/window_timer.hpp"
 
 class Window {
  public:
@@ -21,11 +25,23 @@ class Window {
   static constexpr int32_t MAX_HEIGHT = UINT16_MAX;
 #endif  // CONFIG_WINDOW_LARGE_FRAMEBUFFER
   static constexpr size_t MAX_TITLE_LENGTH = 255;
+  /** The maximum count of framebuffers, see set_buffer_count(). */
+  static constexpr uint32_t MAX_BUFFERS = SYS_WINDOW_MAX_BUFFERS;
+  static constexpr int32_t TITLE_BAR_HEIGHT = 30;
+  /** The height of the decoration (see get_decoration()): the title bar and the line below it. */
+  static constexpr int32_t DECORATION_HEIGHT = TITLE_BAR_HEIGHT + 1;
+  static constexpr uint32_t BORDER_COLOR = 0xff121212;
 
-  Window(const libk::SharedPointer<Task>& task);
+  Window(const libk::IntrusivePtr<Task>& task);
+
+  /** Windows are allocated from a dedicated object cache rather than the general kernel heap. */
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
 
   /** Gets the owner task of this window. All windows have an owner. */
-  [[nodiscard]] libk::SharedPointer<Task> get_task() const { return m_task; }
+  [[nodiscard]] libk::IntrusivePtr<Task> get_task() const { return m_task; }
+  /** Gets the handle of this window in its owner task, as seen by the userspace. */
+  [[nodiscard]] Handle get_handle() const { return m_handle; }
 
   /** Gets the UTF-8 encoded title of this window (to be displayed). */
   [[nodiscard]] libk::StringView get_title() const { return m_title; }
@@ -35,70 +51,188 @@ class Window {
   [[nodiscard]] bool is_visible() const { return m_visible; }
   void show() { set_visibility(true); }
   void hide() { set_visibility(false); }
-  void set_visibility(bool visible) { m_visible = visible; }
+  void set_visibility(bool visible);
 
   [[nodiscard]] bool has_focus() const { return m_focus; }
 
   [[nodiscard]] Rect get_geometry() const { return m_geometry; }
   void set_geometry(const Rect& rect);
 
+  /**
+   * The surface (the framebuffer drawn by the owner) is the window size, unless a surface size is set: the
+   * surface is then scaled to the window size when composited (see WindowManager::draw_window_content()), and
+   * the resizes of the window do not reallocate it. @a width and @a height to 0 make it follow the window size.
+   */
+  void set_surface_size(uint32_t width, uint32_t height);
+  [[nodiscard]] uint32_t get_surface_width() const {
+    return m_surface_width != 0 ? m_surface_width : m_geometry.width();
+  }
+  [[nodiscard]] uint32_t get_surface_height() const {
+    return m_surface_height != 0 ? m_surface_height : m_geometry.height();
+  }
+  /** Checks if the surface is scaled to the window size (a surface size is set, and is not the window size). */
+  [[nodiscard]] bool is_scaled() const {
+    return get_surface_width() != (uint32_t)m_geometry.width() ||
+           get_surface_height() != (uint32_t)m_geometry.height();
+  }
+  /** Returns the window area (in the window coordinates) showing the pixels of @a rect of the surface,
+   * including the neighbor pixels blended by the scaling. */
+  [[nodiscard]] Rect surface_to_window(const Rect& rect) const;
+
   [[nodiscard]] MessageQueue& get_message_queue() { return m_message_queue; }
   [[nodiscard]] const MessageQueue& get_message_queue() const { return m_message_queue; }
 
+  /** Creates a timer posting into the message queue, with a handle in the owner task (see WindowTimer).
+   * Returns nullptr if out of memory. */
+  [[nodiscard]] WindowTimer* create_timer();
+  void destroy_timer(WindowTimer* timer);
+  /** Destroys all the timers, before the window is destroyed. */
+  void destroy_timers();
+
   // Graphics functions:
+  /** Gets the front framebuffer, the one composited (see set_buffer_count()). */
 #ifdef CONFIG_USE_DMA
-  [[nodiscard]] uint32_t* get_framebuffer() { return (uint32_t*)m_framebuffer->get(); }
-  [[nodiscard]] const uint32_t* get_framebuffer() const { return (const uint32_t*)m_framebuffer->get(); }
-  [[nodiscard]] DMA::Address get_framebuffer_dma_addr() const { return m_framebuffer->get_dma_address(); }
+  [[nodiscard]] const uint32_t* get_framebuffer() const { return (const uint32_t*)get_front_buffer()->get(); }
+  [[nodiscard]] DMA::Address get_framebuffer_dma_addr() const { return get_front_buffer()->get_dma_address(); }
 #else
-  [[nodiscard]] uint32_t* get_framebuffer() { return m_framebuffer; }
-  [[nodiscard]] const uint32_t* get_framebuffer() const { return m_framebuffer; }
+  [[nodiscard]] const uint32_t* get_framebuffer() const {
+    return get_front_buffer() ? (const uint32_t*)get_front_buffer()->get() : nullptr;
+  }
 #endif  // CONFIG_USE_DMA
   [[nodiscard]] uint32_t get_framebuffer_pitch() const { return m_framebuffer_pitch; }
+
+  /**
+   * Sets the count of framebuffers, from 1 to MAX_BUFFERS. With a single one (the default), the owner draws
+   * into the framebuffer read by the compositor. With several ones, it draws into a back buffer while the
+   * compositor reads the front one, and swap_buffers() exchanges them: there is no tearing, no copy and no wait
+   * for the compositor. The front content is kept, the other buffers start with a copy of it.
+   * @returns false if out of memory (the count is then unchanged).
+   */
+  [[nodiscard]] bool set_buffer_count(uint32_t count);
+  [[nodiscard]] uint32_t get_buffer_count() const { return m_nb_buffers; }
+  /** Makes the back buffer the front one, then takes a back buffer that is not read by the compositor.
+   * Returns false if there is none yet (two buffers, the old front one is still read by the DMA), the back
+   * buffer is then the front one until select_back_buffer() succeeds. */
+  [[nodiscard]] bool swap_buffers();
+  [[nodiscard]] bool select_back_buffer();
+  /** Returns the age of the back buffer content: 1 if it is the front one, 2 if it is the one presented before
+   * the front one, etc. (see sys_window_swap_buffers()). */
+  [[nodiscard]] uint32_t get_back_buffer_age() const;
+
+  /** Maps the back framebuffer (the only one if single-buffered) read-write into the owner process, so it can
+   * draw in place. Each buffer has its own address, mapped again each time the buffer is reallocated.
+   * @returns the framebuffer address in the owner process, or 0 on failure. */
+  VirtualAddress map_surface();
+  /** Maps the state page (see sys_window_state_t) read-only into the owner process, so it can read the window
+   * state without system calls. @returns its address in the owner process, or 0 on failure. */
+  VirtualAddress map_state();
+  /** Unmaps the state page from the owner process, before the window is destroyed. */
+  void unmap_state();
+
   void clear(uint32_t argb = 0x000000);
   void draw_line(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint32_t argb);
   void draw_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t argb);
   void fill_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t argb);
   void draw_text(uint32_t x, uint32_t y, const char* text, uint32_t argb);
+  /** Returns the horizontal advance of @a text drawn by draw_text() on a single line, in pixels. */
+  [[nodiscard]] uint32_t measure_text(const char* text) const;
   void blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer);
-  // Draw the window frame decoration (title bar + borders).
-  void draw_frame();
+  void copy_area(uint32_t src_x, uint32_t src_y, uint32_t width, uint32_t height, uint32_t dst_x, uint32_t dst_y);
+  /** Restricts the drawing functions above to the given rectangle, until revert_clipping() is called. */
+  void set_clipping(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+  void revert_clipping();
+
+  /** Checks if the window has a frame (title bar + borders), composited around the framebuffer content. */
+  [[nodiscard]] bool has_frame() const { return m_has_frame; }
+  /**
+   * Returns the pixels of the title bar, with its borders, as get_geometry().width() x DECORATION_HEIGHT pixels
+   * (a row is the window width long), or nullptr if out of memory. The other borders are plain BORDER_COLOR.
+   *
+   * The decoration is cached: it is only rendered again when the title or the window width changed, so the
+   * window manager composites it without drawing the title at each frame.
+   */
+  [[nodiscard]] const uint32_t* get_decoration();
 
  private:
-  void reallocate_framebuffer();
+#ifdef CONFIG_USE_DMA
+  using Framebuffer = Buffer;
+#else
+  using Framebuffer = MemoryChunk;
+#endif  // CONFIG_USE_DMA
+
+  [[nodiscard]] Framebuffer* get_front_buffer() const { return m_framebuffers[m_front_buffer].get(); }
+  /** Updates the framebuffer to the new surface size. It is only reallocated if too small or way too big, the
+   * visible old content is kept. */
+  void resize_framebuffer(uint32_t old_width, uint32_t old_height);
+#if !defined(CONFIG_USE_DMA) || !defined(CONFIG_WINDOW_LARGE_FRAMEBUFFER)
+  void replace_framebuffer(uint32_t pitch, uint32_t capacity_height, uint32_t old_width, uint32_t old_height);
+#endif  // !CONFIG_USE_DMA || !CONFIG_WINDOW_LARGE_FRAMEBUFFER
+  /** Allocates a framebuffer of @a pitch x @a capacity_height pixels, nullptr if out of memory. */
+  [[nodiscard]] static libk::ScopedPointer<Framebuffer> allocate_framebuffer(uint32_t pitch, uint32_t capacity_height);
+  bool map_surface_at(uint32_t buffer, VirtualAddress address);
+  /** Makes the painter draw into the back buffer. */
+  void update_painter();
+  /** Copies the geometry, the visibility and the focus into the state page (if mapped), under its sequence
+   * counter. It must be called after each change of them. */
+  void publish_state();
 
  private:
   friend class WindowManager;
+  friend class WindowGrid;
 
   // The task that owns this window. A window is always owned by a unique task.
   // When the task is killed, all child windows are destroyed.
-  libk::SharedPointer<Task> m_task;
+  libk::IntrusivePtr<Task> m_task;
+  Handle m_handle = INVALID_HANDLE;
+  libk::IntrusiveListHook m_wm_hook;  // links inside the window manager list of windows
+  uint32_t m_grid_slot = 0;           // the slot inside the window manager spatial index (see WindowGrid)
 
   // The window-specific message queue (messages from the keyboard driver,
   // the window manager, users, etc.).
   MessageQueue m_message_queue;
+  libk::IntrusiveList<WindowTimer, &WindowTimer::m_window_hook> m_timers;
 
   // The window allocates the title pointer on the kernel side.
   // It is free when the window is destroyed or when the title is modified.
   libk::StringView m_title;
 
   // The window size and position (relative to the screen).
-  Rect m_geometry;
-
-  // The framebuffer is allocated on the kernel side. It is updated each time
-  // the window geometry changes. The size of the framebuffer is the same
-  // as the window size (see m_geometry variable).
-#ifdef CONFIG_USE_DMA
-  libk::ScopedPointer<Buffer> m_framebuffer;
-#else
-  uint32_t* m_framebuffer;
-#endif
+  Rect m_geometry = {0, 0, 0, 0};
+  // The surface size set by the owner, 0 if the surface follows the window size (see set_surface_size()).
+  uint32_t m_surface_width = 0;
+  uint32_t m_surface_height = 0;
+
+  // The framebuffers are allocated on the kernel side. They are updated each time
+  // the surface size changes. The size of the framebuffers is the same
+  // as the surface size (the window size, unless a surface size is set).
+  libk::ScopedPointer<Framebuffer> m_framebuffers[MAX_BUFFERS];
+  uint32_t m_nb_buffers = 1;
+  uint32_t m_front_buffer = 0;  // read by the compositor
+  uint32_t m_back_buffer = 0;   // drawn by the owner, the front one if single-buffered
+  // The count of swap_buffers() calls, and its value when each buffer was last made the front one.
+  uint32_t m_swap_count = 0;
+  uint32_t m_buffer_swap_counts[MAX_BUFFERS] = {};
+  // The framebuffer is allocated for up to m_framebuffer_pitch x m_framebuffer_capacity_height pixels, so small
+  // resizes do not reallocate it. It is shrunk once FRAMEBUFFER_SHRINK_RATIO times bigger than the window.
+  static constexpr uint64_t FRAMEBUFFER_SHRINK_RATIO = 4;
   uint32_t m_framebuffer_pitch = 0;
+  uint32_t m_framebuffer_capacity_height = 0;
+  // The framebuffer addresses in the owner process, 0 if not mapped (see map_surface()).
+  VirtualAddress m_surface_addresses[MAX_BUFFERS] = {};
+
+  // The page holding a sys_window_state_t, allocated when first mapped (see map_state()).
+  libk::ScopedPointer<Buffer> m_state_page;
+  VirtualAddress m_state_address = 0;
 
   graphics::Painter m_painter;
 
+  // The cached title bar, see get_decoration().
+  libk::ScopedPointer<MemoryChunk> m_decoration;
+  bool m_is_decoration_valid = false;
+
   // Some flags about the window:
-  bool m_has_frame : 1 = true;  // should we draw the window frame (title bar + borders)?
-  bool m_visible : 1 = false;   // the window is currently visible?
-  bool m_focus : 1 = false;     // the window currently has the focus (receives keyboard inputs)?
+  bool m_has_frame : 1 = true;     // should we draw the window frame (title bar + borders)?
+  bool m_visible : 1 = false;      // the window is currently visible?
+  bool m_focus : 1 = false;        // the window currently has the focus (receives keyboard inputs)?
+  bool m_wants_frame : 1 = false;  // a SYS_MSG_FRAME message is requested (see request_window_frame())?
 };  // class Window
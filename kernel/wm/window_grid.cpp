@@ -0,0 +1,153 @@
+#include "wm/window_grid.hpp"
+
+#include <libk/assert.hpp>
+#include <libk/utils.hpp>
+#include "wm/window.hpp"
+
+WindowGrid::~WindowGrid() {
+  delete[] m_cells;
+}
+
+bool WindowGrid::init(int32_t screen_width, int32_t screen_height) {
+  m_columns = libk::max<int32_t>(1, libk::div_round_up(screen_width, CELL_SIZE));
+  m_rows = libk::max<int32_t>(1, libk::div_round_up(screen_height, CELL_SIZE));
+  m_cells = new Mask[m_columns * m_rows];
+  if (m_cells == nullptr)
+    return false;
+
+  for (int32_t i = 0; i < m_columns * m_rows; ++i)
+    m_cells[i] = 0;
+  return true;
+}
+
+uint32_t WindowGrid::get_slot(const Window* window) {
+  return window->m_grid_slot;
+}
+
+bool WindowGrid::add(Window* window) {
+  if (m_used_slots == UINT64_MAX)
+    return false;
+
+  const uint32_t slot = __builtin_ctzll(~m_used_slots);
+  m_used_slots |= 1ull << slot;
+  m_windows[slot] = window;
+  m_ranks[slot] = MAX_WINDOWS;  // behind the other windows, until restack()
+  window->m_grid_slot = slot;
+  return true;
+}
+
+void WindowGrid::remove(Window* window) {
+  const uint32_t slot = get_slot(window);
+  KASSERT(m_windows[slot] == window);
+
+  if ((m_visible_slots & (1ull << slot)) != 0)
+    mark_cells(m_rects[slot], slot, false);
+
+  m_visible_slots &= ~(1ull << slot);
+  m_used_slots &= ~(1ull << slot);
+  m_windows[slot] = nullptr;
+}
+
+void WindowGrid::update(Window* window) {
+  const uint32_t slot = get_slot(window);
+  KASSERT(m_windows[slot] == window);
+
+  if ((m_visible_slots & (1ull << slot)) != 0)
+    mark_cells(m_rects[slot], slot, false);
+
+  const Rect geometry = window->get_geometry();
+  if (!window->is_visible() || !geometry.has_surface()) {
+    m_visible_slots &= ~(1ull << slot);
+    return;
+  }
+
+  m_rects[slot] = geometry;
+  m_visible_slots |= 1ull << slot;
+  mark_cells(geometry, slot, true);
+}
+
+Window* WindowGrid::find_at(int32_t x, int32_t y) const {
+  const Rect point = Rect::from_pos_and_size(x, y, 1, 1);
+  Window* front_window = nullptr;
+  uint32_t front_rank = UINT32_MAX;
+  for (Mask candidates = get_candidates(point); candidates != 0; candidates &= candidates - 1) {
+    const uint32_t slot = __builtin_ctzll(candidates);
+    const Rect& rect = m_rects[slot];
+    if (x < rect.left() || x >= rect.right() || y < rect.top() || y >= rect.bottom())
+      continue;
+
+    if (m_ranks[slot] < front_rank) {
+      front_rank = m_ranks[slot];
+      front_window = m_windows[slot];
+    }
+  }
+
+  return front_window;
+}
+
+bool WindowGrid::is_covered(const Window* window, const Rect& rect) const {
+  // The focus border of a window is one pixel around it, so the candidates are looked for one pixel around too.
+  const Rect bordered_rect = Rect::from_edges(rect.left() - 1, rect.top() - 1, rect.right() + 1, rect.bottom() + 1);
+  const uint32_t rank = m_ranks[get_slot(window)];
+  for (Mask candidates = get_candidates(bordered_rect); candidates != 0; candidates &= candidates - 1) {
+    const uint32_t slot = __builtin_ctzll(candidates);
+    if (m_ranks[slot] < rank && m_rects[slot].intersected(bordered_rect).has_surface())
+      return true;
+  }
+
+  return false;
+}
+
+WindowGrid::Mask WindowGrid::get_candidates(const Rect& rect) const {
+  if (!rect.has_surface())
+    return 0;
+
+  // The division rounds toward 0, the coordinates left or above the screen end up in the first cells anyway.
+  const int32_t first_column = libk::clamp<int32_t>(rect.left() / CELL_SIZE, 0, m_columns - 1);
+  const int32_t last_column = libk::clamp<int32_t>((rect.right() - 1) / CELL_SIZE, 0, m_columns - 1);
+  const int32_t first_row = libk::clamp<int32_t>(rect.top() / CELL_SIZE, 0, m_rows - 1);
+  const int32_t last_row = libk::clamp<int32_t>((rect.bottom() - 1) / CELL_SIZE, 0, m_rows - 1);
+
+  Mask candidates = 0;
+  for (int32_t row = first_row; row <= last_row; ++row) {
+    for (int32_t column = first_column; column <= last_column; ++column)
+      candidates |= m_cells[column + m_columns * row];
+  }
+
+  return candidates & m_visible_slots;
+}
+
+void WindowGrid::mark_cells(const Rect& rect, uint32_t slot, bool is_set) {
+  const int32_t first_column = libk::clamp<int32_t>(rect.left() / CELL_SIZE, 0, m_columns - 1);
+  const int32_t last_column = libk::clamp<int32_t>((rect.right() - 1) / CELL_SIZE, 0, m_columns - 1);
+  const int32_t first_row = libk::clamp<int32_t>(rect.top() / CELL_SIZE, 0, m_rows - 1);
+  const int32_t last_row = libk::clamp<int32_t>((rect.bottom() - 1) / CELL_SIZE, 0, m_rows - 1);
+
+  const Mask bit = 1ull << slot;
+  for (int32_t row = first_row; row <= last_row; ++row) {
+    for (int32_t column = first_column; column <= last_column; ++column) {
+      Mask& cell = m_cells[column + m_columns * row];
+      cell = is_set ? (cell | bit) : (cell & ~bit);
+    }
+  }
+}
+
+size_t WindowGrid::find_intersecting(const Rect& rect, Window** windows) const {
+  // The candidates are few, they are sorted by insertion from front to back.
+  uint32_t slots[MAX_WINDOWS];
+  size_t count = 0;
+  for (Mask candidates = get_candidates(rect); candidates != 0; candidates &= candidates - 1) {
+    const uint32_t slot = __builtin_ctzll(candidates);
+    if (!m_rects[slot].intersected(rect).has_surface())
+      continue;
+
+    size_t i = count++;
+    for (; i > 0 && m_ranks[slots[i - 1]] > m_ranks[slot]; --i)
+      slots[i] = slots[i - 1];
+    slots[i] = slot;
+  }
+
+  for (size_t i = 0; i < count; ++i)
+    windows[i] = m_windows[slots[i]];
+  return count;
+}
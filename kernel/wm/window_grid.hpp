@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "wm/geometry.hpp"
+
+class Window;
+
+/**
+ * A uniform grid over the screen, indexing the visible windows by the cells their geometry covers. It finds the
+ * windows intersecting a rectangle, or under a point, without walking all the windows: the damage composition,
+ * the raises and the pointer hit-tests only look at the windows near the area.
+ *
+ * Each window has a slot, so there are at most MAX_WINDOWS windows, and each cell holds the mask of the slots of
+ * the visible windows overlapping it. A query ORs the masks of the cells it covers, then checks the geometry of
+ * these candidates only. The windows partially outside the screen are indexed in the border cells.
+ *
+ * The stacking order is kept as a rank per slot (0 is the front), set by restack() when the windows are reordered,
+ * which is far less frequent than the queries.
+ */
+class WindowGrid {
+ public:
+  static constexpr size_t MAX_WINDOWS = 64;
+  /** The width and height of a cell, in pixels. */
+  static constexpr int32_t CELL_SIZE = 128;
+
+  ~WindowGrid();
+
+  /** Creates the cells covering a screen of the given size. Returns false if out of memory. */
+  [[nodiscard]] bool init(int32_t screen_width, int32_t screen_height);
+
+  /** Gives a slot to @a window, behind the other windows. It is indexed by update(). Returns false if there are
+   * already MAX_WINDOWS windows. */
+  [[nodiscard]] bool add(Window* window);
+  void remove(Window* window);
+  /** Indexes the current geometry of @a window if it is visible, or removes it from the cells if it is hidden. */
+  void update(Window* window);
+  /** Sets the stacking order to the one of @a windows, from front to back. */
+  template <class List>
+  void restack(const List& windows) {
+    uint32_t rank = 0;
+    for (const Window* window : windows)
+      m_ranks[get_slot(window)] = rank++;
+  }
+
+  /** Gets the count of visible windows. */
+  [[nodiscard]] size_t get_visible_count() const { return __builtin_popcountll(m_visible_slots); }
+
+  /** Calls @a f(window) for each visible window intersecting @a rect, from front to back. */
+  template <class F>
+  void for_each_intersecting(const Rect& rect, F f) const {
+    Window* windows[MAX_WINDOWS];
+    const size_t count = find_intersecting(rect, windows);
+    for (size_t i = 0; i < count; ++i)
+      f(windows[i]);
+  }
+
+  /** Returns the frontmost visible window under the screen point (@a x, @a y), or nullptr. */
+  [[nodiscard]] Window* find_at(int32_t x, int32_t y) const;
+  /** Checks if a visible window in front of @a window intersects @a rect, or its focus border does (one pixel
+   * around the window). */
+  [[nodiscard]] bool is_covered(const Window* window, const Rect& rect) const;
+
+ private:
+  using Mask = uint64_t;
+
+  [[nodiscard]] static uint32_t get_slot(const Window* window);
+  /** Gets the candidates of the cells covered by @a rect. */
+  [[nodiscard]] Mask get_candidates(const Rect& rect) const;
+  /** Sets (or clears) the bit of @a slot in the cells covered by @a rect. */
+  void mark_cells(const Rect& rect, uint32_t slot, bool is_set);
+  /** Stores into @a windows the visible windows intersecting @a rect, from front to back, and returns their count. */
+  size_t find_intersecting(const Rect& rect, Window** windows) const;
+
+  Mask* m_cells = nullptr;
+  int32_t m_columns = 0;
+  int32_t m_rows = 0;
+
+  Window* m_windows[MAX_WINDOWS] = {};
+  // The geometry indexed for each slot (it is not indexed if not in m_visible_slots).
+  Rect m_rects[MAX_WINDOWS];
+  uint32_t m_ranks[MAX_WINDOWS] = {};
+  Mask m_used_slots = 0;
+  Mask m_visible_slots = 0;
+};  // class WindowGrid
@@ -1,18 +1,23 @@
 #include "wm/window_manager.hpp"
+#include "boot_snapshot.hpp"
 #include "graphics/graphics.hpp"
+#include "graphics/image_decoder.hpp"
 #include "hardware/framebuffer.hpp"
 #include "hardware/timer.hpp"
+#include "libk/cpu_features.hpp"
 #include "libk/log.hpp"
+#include "libk/small_vector.hpp"
 #include "task/task_manager.hpp"
 #include "wm/window.hpp"
 
 #include <algorithm>
+#include <utility>
 
 #ifdef CONFIG_USE_DMA
 #include "hardware/dma/request.hpp"
 #endif  // CONFIG_USE_DMA
 
-#include "graphics/stb_image.h"
+#include "memory/mem_alloc.hpp"
 
 WindowManager* WindowManager::g_instance = nullptr;
 
@@ -28,24 +33,195 @@ WindowManager::WindowManager() {
     m_screen_height = fb.get_height();
     m_screen_pitch = fb.get_pitch();
     m_screen_buffer = fb.get_buffer();
+    m_damage = Region({0, 0, m_screen_width, m_screen_height});
+    // The boot snapshot is already on the screen, the first frames draw it too instead of an empty background.
+    if (BootSnapshot::has_wallpaper())
+      read_wallpaper();
+    m_cursor.init(m_screen_width, m_screen_height);
+    m_hud.init(m_screen_width);
+    if (!m_window_grid.init(m_screen_width, m_screen_height)) {
+      LOG_ERROR("Failed to allocate the window grid");
+      m_is_supported = false;
+    }
+#if defined(CONFIG_WM_TILED_COMPOSITION) || defined(CONFIG_FRAMEBUFFER_RGB565)
+    if (!toggle_tiled_composition()) {
+      LOG_ERROR("Failed to enable the tiled composition");
+#ifdef CONFIG_FRAMEBUFFER_RGB565
+      m_is_supported = false;  // nothing can be drawn into the screen
+#endif  // CONFIG_FRAMEBUFFER_RGB565
+    }
+#endif  // CONFIG_WM_TILED_COMPOSITION || CONFIG_FRAMEBUFFER_RGB565
+    // The CPU writes the screen buffer of a panel with its own memory, then reads the damaged areas to send them:
+    // the screen buffer is cached, the DMA copies into it are not seen by the CPU.
+    if (fb.has_partial_present() && !m_is_tiled && !toggle_tiled_composition()) {
+      LOG_ERROR("Failed to enable the tiled composition");
+      m_is_supported = false;
+    }
 
 #ifdef CONFIG_USE_DMA
     m_screen_buffer_dma_addr = DMA::get_dma_bus_address((VirtualAddress)m_screen_buffer, false);
+    m_dma_request_queue.reserve(NB_PREALLOCATED_DMA_REQUESTS);
 #endif  // CONFIG_USE_DMA
   }
+}
+
+bool WindowManager::start_screen_stream(UART* uart) {
+  if (!m_is_supported)
+    return false;
+
+  return m_screen_stream.init(uart, m_screen_width, m_screen_height);
+}
+
+void WindowManager::load_wallpaper() {
+  if (!m_is_supported || m_wallpaper != nullptr)
+    return;
 
   read_wallpaper();
+  add_damage({0, 0, m_screen_width, m_screen_height});
 }
 
-[[nodiscard]] bool WindowManager::is_valid(Window* window) const {
-  if (window == nullptr)
-    return false;
+#ifdef CONFIG_USE_DMA
+/** Writes back the CPU caches of the @a nb_rows rows of @a buffer read by a 2D DMA copy, the first one at
+ * @a offset. Only the copied bytes are cleaned, not the whole pitch. */
+static void clean_rows(const Buffer& buffer, size_t offset, size_t row_byte_size, size_t nb_rows, size_t pitch) {
+  for (size_t i = 0; i < nb_rows; ++i) {
+    buffer.clean(offset + pitch * i, row_byte_size);
+  }
+}
 
-  const auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  return it != m_windows.end();
+WindowManager::DMARequestQueue::~DMARequestQueue() {
+  clear();
+
+  // Free the DMA requests.
+  auto* request = free_requests;
+  while (request != nullptr) {
+    auto* next = request->unlink();
+    delete request;
+    request = next;
+  }
+}
+
+void WindowManager::DMARequestQueue::reserve(size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    auto* request = DMA::Request::memcpy(0, 0, 0);
+    KASSERT(request != nullptr);
+    if (free_requests != nullptr)
+      request->link_to(free_requests);
+    free_requests = request;
+  }
 }
 
-Window* WindowManager::create_window(const libk::SharedPointer<Task>& task, uint32_t flags) {
+void WindowManager::DMARequestQueue::add_memcpy_2d(DMA::Address src,
+                                                   DMA::Address dst,
+                                                   uint16_t line_byte_length,
+                                                   uint16_t nb_lines,
+                                                   uint16_t src_stride,
+                                                   uint16_t dst_stride) {
+  DMA::Request* request = free_requests;
+  if (request != nullptr) {
+    free_requests = request->unlink();
+    request->set_memcpy_2d(src, dst, line_byte_length, nb_lines, src_stride, dst_stride);
+  } else {
+    request = DMA::Request::memcpy_2d(src, dst, line_byte_length, nb_lines, src_stride, dst_stride);
+    KASSERT(request != nullptr);
+  }
+
+  add_request(request);
+}
+
+void WindowManager::DMARequestQueue::add_fill_2d(uint32_t value,
+                                                 DMA::Address dst,
+                                                 uint16_t line_byte_length,
+                                                 uint16_t nb_lines,
+                                                 uint16_t dst_stride) {
+  DMA::Request* request = free_requests;
+  if (request != nullptr) {
+    free_requests = request->unlink();
+    request->set_fill_2d(value, dst, line_byte_length, nb_lines, dst_stride);
+  } else {
+    request = DMA::Request::fill_2d(value, dst, line_byte_length, nb_lines, dst_stride);
+    KASSERT(request != nullptr);
+  }
+
+  add_request(request);
+}
+
+void WindowManager::DMARequestQueue::add_request(DMA::Request* request) {
+  // Distribute the requests among the channels (they never overlap, see draw_windows()).
+  Chain& chain = chains[next_chain];
+  next_chain = (next_chain + 1) % NB_DMA_CHANNELS;
+
+  if (chain.first_request == nullptr) {
+    chain.first_request = request;
+  } else {
+    chain.last_request->link_to(request);
+  }
+
+  chain.last_request = request;
+  ++request_count;
+}
+
+void WindowManager::DMARequestQueue::pin(Buffer& buffer) {
+  // A window is usually drawn in several consecutive requests.
+  if (!pinned_buffers.is_empty() && pinned_buffers.back() == &buffer)
+    return;
+
+  buffer.pin();
+  pinned_buffers.push_back(&buffer);
+}
+
+bool WindowManager::DMARequestQueue::submit(DMA::Channel* channels, DMA::Completion* completion) {
+  bool is_submitted = false;
+  for (size_t i = 0; i < NB_DMA_CHANNELS; ++i) {
+    if (chains[i].first_request == nullptr)
+      continue;
+
+    const bool is_started = channels[i].submit(chains[i].first_request, completion);
+    KASSERT(is_started);
+    is_submitted = true;
+  }
+
+  return is_submitted;
+}
+
+void WindowManager::DMARequestQueue::execute_and_wait(DMA::Channel* channels) {
+  for (size_t i = 0; i < NB_DMA_CHANNELS; ++i) {
+    if (chains[i].first_request != nullptr)
+      channels[i].execute_requests(chains[i].first_request);
+  }
+
+  for (size_t i = 0; i < NB_DMA_CHANNELS; ++i) {
+    if (chains[i].first_request != nullptr)
+      channels[i].wait();
+  }
+
+  clear();
+}
+
+void WindowManager::DMARequestQueue::clear() {
+  for (auto& chain : chains) {
+    if (chain.first_request == nullptr)
+      continue;
+
+    if (free_requests != nullptr)
+      chain.last_request->link_to(free_requests);
+    free_requests = chain.first_request;
+    chain = {};
+  }
+
+  next_chain = 0;
+  request_count = 0;
+
+  while (!pinned_buffers.is_empty())
+    pinned_buffers.pop_back()->unpin();
+}
+#endif  // CONFIG_USE_DMA
+
+[[nodiscard]] bool WindowManager::is_valid(Window* window) const {
+  return window != nullptr && m_valid_windows.contains(window);
+}
+
+Window* WindowManager::create_window(const libk::IntrusivePtr<Task>& task, uint32_t flags) {
   if (!m_is_supported)
     return nullptr;
 
@@ -56,34 +232,54 @@ Window* WindowManager::create_window(const libk::SharedPointer<Task>& task, uint
   if ((flags & SYS_WF_NO_FRAME) != 0)
     window->m_has_frame = false;
 
-  task->register_window(window);
+  if (!m_window_grid.add(window)) {
+    LOG_ERROR("Failed to create a window, there are already {} windows", WindowGrid::MAX_WINDOWS);
+    delete window;
+    return nullptr;
+  }
+
+  window->m_handle = task->register_window(window);
+  if (window->m_handle == INVALID_HANDLE) {
+    m_window_grid.remove(window);
+    delete window;
+    return nullptr;
+  }
+
   ++m_window_count;
   m_windows.push_back(window);
+  m_valid_windows.insert(window);
+  m_window_grid.restack(m_windows);
+  m_window_grid.update(window);
 
   if (m_focus_window == nullptr)
     focus_window(window);
 
-  m_dirty = true;
+  add_window_damage(window);
   return window;
 }
 
 void WindowManager::destroy_window(Window* window) {
   KASSERT(is_valid(window));
 
-  window->get_task()->unregister_window(window);
+  // The pending DMA requests may still read the window framebuffer.
+  finish_update();
+
+  window->destroy_timers();
+  window->get_task()->unregister_window(window->m_handle);
+  window->unmap_state();
+  add_window_damage(window);
 
   if (m_focus_window == window) {
     // Unfocus the window.
     unfocus_window(window);
   }
 
-  const auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  m_windows.erase(it);
+  m_windows.remove(window);
+  m_valid_windows.remove(window);
+  m_window_grid.remove(window);
 
   --m_window_count;
   delete window;
-
-  m_dirty = true;
 }
 
 void WindowManager::set_window_visibility(Window* window, bool visible) {
@@ -92,7 +288,9 @@ void WindowManager::set_window_visibility(Window* window, bool visible) {
   if (window->is_visible() == visible)
     return;  // already the correct visibility
 
-  window->m_visible = visible;
+  window->set_visibility(visible);
+  m_window_grid.update(window);
+  add_window_damage(window);
 
   // Update the focus window if needed.
   if (visible) {  // show the window
@@ -108,8 +306,6 @@ void WindowManager::set_window_visibility(Window* window, bool visible) {
   libk::bzero(&message, sizeof(sys_message_t));
   message.id = visible ? SYS_MSG_SHOW : SYS_MSG_HIDE;
   post_message(window, message);
-
-  m_dirty = true;
 }
 
 void WindowManager::set_window_geometry(Window* window, Rect rect) {
@@ -125,9 +321,16 @@ void WindowManager::set_window_geometry(Window* window, Rect rect) {
 
   rect.normalize();
 
+  // The window framebuffer may be reallocated, the pending DMA requests may still read it.
+  finish_update();
+
   const auto old_rect = window->get_geometry();
 
+  // Both the old and the new window areas must be redrawn.
+  add_window_damage(window);
   window->set_geometry(rect);
+  m_window_grid.update(window);
+  add_window_damage(window);
 
   const bool moved = old_rect.x() != rect.x() || old_rect.y() != rect.y();
   const bool resized = old_rect.width() != rect.width() || old_rect.height() != rect.height();
@@ -150,8 +353,16 @@ void WindowManager::set_window_geometry(Window* window, Rect rect) {
     message.param2 = rect.height();
     post_message(window, message);
   }
+}
 
-  m_dirty = true;
+void WindowManager::set_window_surface_size(Window* window, uint32_t width, uint32_t height) {
+  KASSERT(is_valid(window));
+
+  // The window framebuffer may be reallocated, the pending DMA requests may still read it.
+  finish_update();
+
+  window->set_surface_size(width, height);
+  add_window_damage(window);
 }
 
 void WindowManager::set_window_geometry(Window* window, int32_t x, int32_t y, int32_t w, int32_t h) {
@@ -194,13 +405,37 @@ void WindowManager::focus_window(Window* window) {
 
   m_focus_window = window;
   m_focus_window->m_focus = true;
+  m_focus_window->publish_state();
 
-  // TODO: Move focus window to front
-  auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  KASSERT(it != m_windows.end());
-  m_windows.erase(it);
+  raise_window(window);
+  add_window_border_damage(window);
+}
+
+void WindowManager::raise_window(Window* window) {
+  // Raising the window only changes its pixels that were hidden by the windows in front of it.
+  const auto geometry = window->get_geometry();
+  const auto bordered_geometry =
+      Rect::from_edges(geometry.left() - 1, geometry.top() - 1, geometry.right() + 1, geometry.bottom() + 1);
+
+  // Only the windows intersecting it are looked at, the ones in front of it are before it in the list.
+  Region exposed;
+  bool is_in_front = true;
+  m_window_grid.for_each_intersecting(bordered_geometry, [&](Window* w) {
+    if (w == window)
+      is_in_front = false;
+    else if (is_in_front)
+      exposed.unite(w->get_geometry().intersected(bordered_geometry));
+  });
+
+  m_windows.remove(window);
   m_windows.push_front(window);
-  m_dirty = true;
+  m_window_grid.restack(m_windows);
+
+  if (!window->is_visible())
+    return;
+
+  for (const Rect& rect : exposed)
+    add_damage(rect);
 }
 
 void WindowManager::unfocus_window(Window* window) {
@@ -211,6 +446,8 @@ void WindowManager::unfocus_window(Window* window) {
 
   if (m_focus_window != nullptr) {
     m_focus_window->m_focus = false;
+    m_focus_window->publish_state();
+    add_window_border_damage(m_focus_window);
 
     // Send focus out messsage.
     sys_message_t message;
@@ -246,6 +483,15 @@ void WindowManager::post_message(sys_message_t message) {
       return;  // the key event was handled by the window manager, do not propagate it.
   }
 
+  // The pointer messages only go to the window under the cursor, the other ones to all the windows.
+  if (message.id == SYS_MSG_MOUSEMOVE || message.id == SYS_MSG_MOUSECLICK || message.id == SYS_MSG_MOUSESCROLL) {
+    const Rect cursor_rect = m_cursor.get_rect();
+    Window* window = m_window_grid.find_at(cursor_rect.x(), cursor_rect.y());
+    if (window != nullptr)
+      window->get_message_queue().enqueue(message);
+    return;
+  }
+
   for (auto* window : m_windows) {
     window->get_message_queue().enqueue(message);
   }
@@ -261,23 +507,153 @@ bool WindowManager::post_message(Window* window, sys_message_t message) {
 void WindowManager::present_window(Window* window) {
   KASSERT(is_valid(window));
 
-  if (!m_dirty && window->has_focus()) {
-    // If no update is required for now and the window is at front (has focus), then
-    // only redraw the window.
-    DMARequestQueue dma_request_queue;
-    draw_window(window, {0, 0, m_screen_width, m_screen_height}, dma_request_queue);
+  present_window(window, Rect::from_pos_and_size(0, 0, window->get_surface_width(), window->get_surface_height()));
+}
+
+void WindowManager::present_window(Window* window, const Rect& rect) {
+  KASSERT(is_valid(window));
+
+  if (!window->is_visible())
+    return;
+
+  const auto geometry = window->get_geometry();
+  const Rect window_rect = window->surface_to_window(rect);
+  const Rect screen_rect = {0, 0, m_screen_width, m_screen_height};
+  const Rect damage = Rect::from_pos_and_size(geometry.x() + window_rect.x(), geometry.y() + window_rect.y(),
+                                              window_rect.width(), window_rect.height())
+                          .intersected(geometry)
+                          .intersected(screen_rect);
+  if (!damage.has_surface())
+    return;
+
+  if (m_damage.is_empty() && !m_is_update_pending && !FrameBuffer::get().has_partial_present() &&
+      !m_window_grid.is_covered(window, damage)) {
+    // If no update is required for now and no window (nor focus border) in front covers the presented area,
+    // then only redraw it.
+    draw_window(window, damage, m_dma_request_queue);
 #ifdef CONFIG_USE_DMA
-    dma_request_queue.execute_and_wait(m_dma_channel);
+    m_dma_request_queue.execute_and_wait(m_dma_channels);
 #endif  // CONFIG_USE_DMA
+    m_screen_stream.send(m_screen_buffer, m_screen_pitch, damage);
+  } else {
+    // Only the pixels visible on the screen should be drawn: the window may be behind other windows.
+    // Let the next update redraw the area.
+    add_damage(damage);
+  }
+}
+
+void WindowManager::request_window_frame(Window* window) {
+  KASSERT(is_valid(window));
+
+  window->m_wants_frame = true;
+  if (window->is_visible())
+    m_update_wait_list.wake_all();
+}
+
+bool WindowManager::has_frame_requests() const {
+  for (const auto* window : m_windows) {
+    if (window->m_wants_frame && window->is_visible())
+      return true;
+  }
+
+  return false;
+}
+
+void WindowManager::post_frame_messages() {
+  // The hidden windows get theirs once shown, they do not draw for nothing meanwhile.
+  const uint64_t frame_time = GenericTimer::get_elapsed_time_in_micros();
+  for (auto* window : m_windows) {
+    if (!window->m_wants_frame || !window->is_visible())
+      continue;
+
+    window->m_wants_frame = false;
+    sys_message_t message;
+    libk::bzero(&message, sizeof(sys_message_t));
+    message.id = SYS_MSG_FRAME;
+    message.param1 = frame_time;
+    post_message(window, message);
+  }
+}
+
+bool WindowManager::set_window_buffer_count(Window* window, uint32_t count) {
+  KASSERT(is_valid(window));
+
+  // The framebuffers above the count are freed, the pending DMA requests may still read them.
+  finish_update();
+
+  return window->set_buffer_count(count);
+}
+
+void WindowManager::swap_window_buffers(Window* window) {
+  KASSERT(is_valid(window));
+
+  if (!window->swap_buffers()) {
+    // With two buffers, the new back one may still be read by the DMA for the update in progress. Finish it
+    // (the copies are usually done), rather than letting the owner draw into the buffer being composited.
+    finish_update();
+    (void)window->select_back_buffer();
+  }
+
+  present_window(window);
+}
+
+void WindowManager::move_cursor(int32_t x, int32_t y) {
+  if (!m_is_supported)
+    return;
+
+  const Rect old_rect = m_cursor.get_rect();
+  m_cursor.set_position(x, y);
+  if (m_cursor.is_hardware())
+    return;
+
+  if constexpr (FrameBuffer::NB_BUFFERS == 1) {
+    // The pending update draws the cursor once its DMA requests, that may write below it, are done.
+    if (m_is_update_pending)
+      return;
+
+    m_cursor.erase(m_screen_buffer, m_screen_pitch);
+    m_cursor.draw(m_screen_buffer, m_screen_pitch);
+    present_screen_rect(old_rect);
+    present_screen_rect(m_cursor.get_rect());
   } else {
-    // Let do a full update the next time.
-    // A partial update is more challenging as we should only draw the pixels that are visible on the screen.
-    // This is straightforward if the window is a top level window (e.g. has focus),
-    // but it becomes tricky if the window is behind other windows.
-    m_dirty = true;  // mark the screen as dirty and needs an update
+    // The other buffers do not have the same content, only the two small cursor areas are redrawn.
+    add_damage(old_rect);
+    add_damage(m_cursor.get_rect());
   }
 }
 
+void WindowManager::add_damage(const Rect& rect) {
+  const Rect screen_rect = rect.intersected({0, 0, m_screen_width, m_screen_height});
+  if (!screen_rect.has_surface())
+    return;
+
+  m_damage.unite(screen_rect);
+  m_update_wait_list.wake_all();
+
+  // Keep the region simple, redrawing a bit more is cheaper than handling many small rectangles.
+  if (m_damage.get_rect_count() > MAX_DAMAGE_RECTS)
+    m_damage = Region(m_damage.get_bounding_rect());
+}
+
+void WindowManager::add_window_damage(Window* window) {
+  // The focus border is drawn one pixel around the window.
+  const auto geometry = window->get_geometry();
+  add_damage(Rect::from_edges(geometry.left() - 1, geometry.top() - 1, geometry.right() + 1, geometry.bottom() + 1));
+}
+
+void WindowManager::add_window_border_damage(Window* window) {
+  // Only the four one pixel wide sides around the window.
+  const auto geometry = window->get_geometry();
+  const int32_t left = geometry.left() - 1;
+  const int32_t top = geometry.top() - 1;
+  const int32_t right = geometry.right() + 1;
+  const int32_t bottom = geometry.bottom() + 1;
+  add_damage(Rect::from_edges(left, top, right, geometry.top()));
+  add_damage(Rect::from_edges(left, geometry.bottom(), right, bottom));
+  add_damage(Rect::from_edges(left, geometry.top(), geometry.left(), geometry.bottom()));
+  add_damage(Rect::from_edges(geometry.right(), geometry.top(), right, geometry.bottom()));
+}
+
 void WindowManager::mosaic_layout() {
   if (m_window_count == 0)
     return;
@@ -318,205 +694,647 @@ void WindowManager::mosaic_layout() {
 }
 
 void WindowManager::update() {
-  if (!m_dirty || !m_is_supported)
-    return;
+  finish_update();
+
+  // The previous frame is on the screen, the windows waiting for it may draw the next one.
+  post_frame_messages();
+
+  // The screen stream is drained at each frame, the areas it had no room for are drawn and sent again.
+  m_screen_stream.flush();
+  for (const Rect& rect : m_screen_stream.take_pending_damage())
+    add_damage(rect);
+
+  if (m_damage.is_empty() || !m_is_supported)
+    return;  // nothing changed since the last update
+
+  m_update_start_time = GenericTimer::get_elapsed_time_in_micros();
+
+  // The windows are drawn below the software cursor, it is drawn again on top by present_update().
+  if constexpr (FrameBuffer::NB_BUFFERS == 1) {
+    m_update_cursor_rect = m_cursor.get_rect();
+    m_cursor.erase(m_screen_buffer, m_screen_pitch);
+  }
+
+  // Only redraw the damaged area, the remaining of the screen is still up to date.
+  // The damages added while the update is pending are for the next update.
+  const uint32_t buffer_age = FrameBuffer::get().get_buffer_age();
+  if constexpr (FrameBuffer::NB_BUFFERS == 1) {
+    m_update_damage = std::move(m_damage);
+  } else if (buffer_age == 0 || buffer_age > FrameBuffer::NB_BUFFERS) {
+    // The buffer content is unknown, redraw everything.
+    m_update_damage = Region({0, 0, m_screen_width, m_screen_height});
+  } else {
+    // The buffer also misses the frames presented since it was last drawn.
+    m_update_damage = m_damage;
+    for (uint32_t i = 0; i + 1 < buffer_age; ++i)
+      m_update_damage.unite(m_damage_history[i]);
+
+    if (m_update_damage.get_rect_count() > MAX_DAMAGE_RECTS)
+      m_update_damage = Region(m_update_damage.get_bounding_rect());
+  }
+
+  if constexpr (FrameBuffer::NB_BUFFERS > 1) {
+    for (size_t i = FrameBuffer::NB_BUFFERS - 1; i > 0; --i)
+      m_damage_history[i] = std::move(m_damage_history[i - 1]);
+    m_damage_history[0] = std::move(m_damage);
+  }
+
+  m_damage.clear();
+
+  if (m_focus_window != nullptr && m_focus_window->is_visible())
+    m_update_focus_window = m_focus_window;
 
-  const auto start = GenericTimer::get_elapsed_time_in_micros();
   draw_windows();
-  const auto end = GenericTimer::get_elapsed_time_in_micros();
 
-  m_dirty = false;
-  LOG_DEBUG("Window manager update done in {} ms for {} window(s)", (end - start) / 1000, m_window_count);
+#ifdef CONFIG_USE_DMA
+  // The screen is presented once the DMA requests are done, meanwhile the CPU is free.
+  m_is_update_pending = m_dma_request_queue.submit(m_dma_channels, &m_dma_completion);
+  if (m_is_update_pending)
+    return;
+#endif  // CONFIG_USE_DMA
+
+  present_update();
+}
+
+bool WindowManager::block_task_until_update_done(const libk::IntrusivePtr<Task>& task) {
+#ifdef CONFIG_USE_DMA
+  if (m_is_update_pending)
+    return m_dma_completion.block_task_until_done(task);
+#endif  // CONFIG_USE_DMA
+
+  (void)task;
+  return false;
+}
+
+void WindowManager::finish_update() {
+  if (!m_is_update_pending)
+    return;
+
+#ifdef CONFIG_USE_DMA
+  // Usually already done (signalled by the DMA interrupts), otherwise poll the channels.
+  for (auto& channel : m_dma_channels)
+    channel.wait();
+  m_dma_request_queue.clear();
+#endif  // CONFIG_USE_DMA
+
+  m_is_update_pending = false;
+  present_update();
+}
+
+bool WindowManager::block_task_until_damaged(const libk::IntrusivePtr<Task>& task) {
+  // Without screen, nothing is ever damaged: the task is blocked forever.
+  if ((!m_damage.is_empty() || has_frame_requests() || m_screen_stream.is_busy()) && m_is_supported)
+    return false;
+
+  m_update_wait_list.add(task);
+  return true;
 }
 
 void WindowManager::draw_background(const Rect& rect, DMARequestQueue& request_queue) {
   if (m_wallpaper == nullptr) {
     // No wallpaper found. Fill the background.
-    fill_rect(rect, 0xffffff);
+    fill_rect(rect, 0xffffff, request_queue);
     return;
   }
 
 #if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
-  const auto framebuffer_dma_addr = m_wallpaper->get_dma_address();
-  const auto src_stride = 0;
-  const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - m_screen_width);
-  auto* request =
-      DMA::Request::memcpy_2d(framebuffer_dma_addr, m_screen_buffer_dma_addr, sizeof(uint32_t) * (m_wallpaper_width),
-                              m_wallpaper_height, src_stride, dst_stride);
-  request_queue.add(request);
+  if (!m_is_drawing_tile) {
+    const auto wallpaper_dma_addr =
+        m_wallpaper->get_dma_address() + sizeof(uint32_t) * (rect.x() + m_wallpaper_width * rect.y());
+    const auto screen_dma_addr =
+        m_screen_buffer_dma_addr + sizeof(uint32_t) * (rect.x() + m_screen_pitch * rect.y());
+    const auto src_stride = sizeof(uint32_t) * (m_wallpaper_width - rect.width());
+    const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - rect.width());
+    clean_rows(*m_wallpaper, sizeof(uint32_t) * (rect.x() + m_wallpaper_width * rect.y()),
+               sizeof(uint32_t) * rect.width(), rect.height(), sizeof(uint32_t) * m_wallpaper_width);
+    request_queue.pin(*m_wallpaper);
+    request_queue.add_memcpy_2d(wallpaper_dma_addr, screen_dma_addr, sizeof(uint32_t) * rect.width(), rect.height(),
+                                src_stride, dst_stride);
+    return;
+  }
+
+  const auto* wallpaper = (const uint32_t*)m_wallpaper->get();
 #else
   (void)request_queue;
+  const uint32_t* wallpaper = m_wallpaper;
+#endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
 
-  for (int32_t x = rect.left(); x < rect.right(); ++x) {
-    for (int32_t y = rect.top(); y < rect.bottom(); ++y) {
-      m_screen_buffer[x + m_screen_pitch * y] = m_wallpaper[x + m_wallpaper_width * y];
-    }
+  // Copy row by row, both buffers are stored in row-major order.
+  const size_t row_byte_size = sizeof(uint32_t) * rect.width();
+  for (int32_t y = rect.top(); y < rect.bottom(); ++y) {
+    libk::memcpy(get_target_pixel(rect.left(), y), &wallpaper[rect.left() + m_wallpaper_width * y], row_byte_size);
   }
-#endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
 }
 
-void WindowManager::fill_rect(const Rect& rect, uint32_t color) {
-  // TODO: replace this by an optimized function
-  for (int32_t x = rect.left(); x < rect.right(); ++x) {
-    for (int32_t y = rect.top(); y < rect.bottom(); ++y) {
-      m_screen_buffer[x + m_screen_pitch * y] = color;
-    }
+void WindowManager::fill_rect(const Rect& rect, uint32_t color, DMARequestQueue& request_queue) {
+  if (!rect.has_surface())
+    return;
+
+#ifndef CONFIG_FRAMEBUFFER_RGB565
+#ifdef CONFIG_USE_DMA
+  // The screen areas big enough are filled by the DMA with the rest of the update, the CPU only waits for them
+  // once the update is presented. The narrow rows (the window borders) are cheaper for the CPU, and the tiles
+  // stay in the CPU cache.
+  const size_t row_byte_size = sizeof(uint32_t) * rect.width();
+  const auto& cpu_features = libk::get_cpu_features();
+  if (!m_is_drawing_tile && row_byte_size >= cpu_features.dcache_line_size &&
+      row_byte_size * rect.height() >= cpu_features.large_copy_threshold) {
+    const auto screen_dma_addr =
+        m_screen_buffer_dma_addr + sizeof(uint32_t) * (rect.left() + m_screen_pitch * rect.top());
+    const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - rect.width());
+    request_queue.add_fill_2d(color, screen_dma_addr, row_byte_size, rect.height(), dst_stride);
+    return;
+  }
+#else
+  (void)request_queue;
+
+  // Full width rectangles are a single span of the screen buffer, big enough to be offloaded (but not the tiles,
+  // they stay in the CPU cache).
+  if (!m_is_drawing_tile && rect.left() == 0 && (size_t)rect.width() == m_screen_pitch) {
+    libk::memset32_large(&m_screen_buffer[m_screen_pitch * rect.top()], color, m_screen_pitch * rect.height());
+    return;
+  }
+#endif  // CONFIG_USE_DMA
+#else
+  (void)request_queue;
+#endif  // !CONFIG_FRAMEBUFFER_RGB565
+
+  for (int32_t y = rect.top(); y < rect.bottom(); ++y) {
+    libk::memset32(get_target_pixel(rect.left(), y), color, rect.width());
   }
 }
 
 void WindowManager::draw_window(Window* window, const Rect& dst_rect, DMARequestQueue& request_queue) {
+  const Rect& geometry = window->m_geometry;
+  if (!window->has_frame()) {
+    draw_window_content(window, geometry.intersected(dst_rect), request_queue);
+    return;
+  }
+
+  // The frame is composited as separate strips around the content (which is drawn below the frame in the
+  // framebuffer): the title bar from the cached decoration, and the other borders as plain fills.
+  const int32_t title_bar_bottom = libk::min(geometry.top() + Window::DECORATION_HEIGHT, geometry.bottom());
+  const Rect title_bar = {geometry.left(), geometry.top(), geometry.right(), title_bar_bottom};
+  draw_window_decoration(window, title_bar.intersected(dst_rect));
+
+  if (title_bar_bottom == geometry.bottom())
+    return;  // only the title bar is visible
+
+  const Rect left_border = {geometry.left(), title_bar_bottom, geometry.left() + 1, geometry.bottom()};
+  const Rect right_border = {geometry.right() - 1, title_bar_bottom, geometry.right(), geometry.bottom()};
+  const Rect bottom_border = {geometry.left(), geometry.bottom() - 1, geometry.right(), geometry.bottom()};
+  fill_rect(left_border.intersected(dst_rect), Window::BORDER_COLOR, request_queue);
+  fill_rect(right_border.intersected(dst_rect), Window::BORDER_COLOR, request_queue);
+  fill_rect(bottom_border.intersected(dst_rect), Window::BORDER_COLOR, request_queue);
+
+  if (geometry.bottom() - title_bar_bottom > 1) {
+    const Rect content = {geometry.left() + 1, title_bar_bottom, geometry.right() - 1, geometry.bottom() - 1};
+    draw_window_content(window, content.intersected(dst_rect), request_queue);
+  }
+}
+
+void WindowManager::draw_window_content(Window* window, const Rect& rect, DMARequestQueue& request_queue) {
 #ifndef CONFIG_USE_DMA
   (void)request_queue;
 #endif  // !CONFIG_USE_DMA
 
-  const Rect& src_rect = window->m_geometry;
-  if (!src_rect.intersects(dst_rect))
+  if (!rect.has_surface())
     return;
 
-  window->draw_frame();
+  if (window->is_scaled()) {
+    draw_scaled_window_content(window, rect, request_queue);
+    return;
+  }
 
   const uint32_t* framebuffer = window->get_framebuffer();
-  const uint32_t framebuffer_pitch = window->get_geometry().width();
+  const uint32_t framebuffer_pitch = window->get_framebuffer_pitch();
   KASSERT(framebuffer != nullptr);
 
-  uint32_t x1 = 0, x2 = src_rect.width();
-  uint32_t y1 = 0, y2 = src_rect.height();
-
-  // Do clipping to avoid drawing outside the destination rect.
-  if (src_rect.left() < dst_rect.left())
-    x1 = dst_rect.left() - src_rect.left();
-  if (src_rect.top() < dst_rect.top())
-    y1 = dst_rect.top() - src_rect.top();
-  if (src_rect.right() > dst_rect.right())
-    x2 = x1 + dst_rect.right() - libk::max(src_rect.left(), dst_rect.left());
-  if (src_rect.bottom() > dst_rect.bottom())
-    y2 = y1 + dst_rect.bottom() - libk::max(src_rect.top(), dst_rect.top());
+  // The rectangle in the window coordinates.
+  const uint32_t x1 = rect.left() - window->m_geometry.left();
+  const uint32_t y1 = rect.top() - window->m_geometry.top();
+  const uint32_t x2 = x1 + rect.width();
+  const uint32_t y2 = y1 + rect.height();
 
-  if (x1 == x2 || y1 == y2)
-    return;
-
-    // Blit the framebuffer into the screen.
+  // Blit the framebuffer into the screen.
 #if CONFIG_USE_DMA
-  const auto framebuffer_dma_addr =
-      window->get_framebuffer_dma_addr() + sizeof(uint32_t) * (x1 + framebuffer_pitch * y1);
-  const auto screen_dma_addr =
-      m_screen_buffer_dma_addr + sizeof(uint32_t) * (src_rect.x() + x1 + m_screen_pitch * (src_rect.y() + y1));
-  const auto src_stride = sizeof(uint32_t) * (framebuffer_pitch - (x2 - x1));
-  const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - (x2 - x1));
-  auto* request = DMA::Request::memcpy_2d(framebuffer_dma_addr, screen_dma_addr, sizeof(uint32_t) * (x2 - x1), y2 - y1,
-                                          src_stride, dst_stride);
-  request_queue.add(request);
-#else
-  for (uint32_t src_x = x1, dst_x = src_rect.x() + x1; src_x < x2; ++src_x, dst_x++) {
-    for (uint32_t src_y = y1, dst_y = src_rect.y() + y1; src_y < y2; ++src_y, dst_y++) {
-      const auto color = framebuffer[src_x + framebuffer_pitch * src_y];
-      m_screen_buffer[dst_x + m_screen_pitch * dst_y] = color;
-    }
+  if (!m_is_drawing_tile) {
+    const auto framebuffer_dma_addr =
+        window->get_framebuffer_dma_addr() + sizeof(uint32_t) * (x1 + framebuffer_pitch * y1);
+    const auto screen_dma_addr =
+        m_screen_buffer_dma_addr + sizeof(uint32_t) * (rect.left() + m_screen_pitch * rect.top());
+    const auto src_stride = sizeof(uint32_t) * (framebuffer_pitch - (x2 - x1));
+    const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - (x2 - x1));
+    clean_rows(*window->get_front_buffer(), sizeof(uint32_t) * (x1 + framebuffer_pitch * y1),
+               sizeof(uint32_t) * (x2 - x1), y2 - y1, sizeof(uint32_t) * framebuffer_pitch);
+    request_queue.pin(*window->get_front_buffer());
+    request_queue.add_memcpy_2d(framebuffer_dma_addr, screen_dma_addr, sizeof(uint32_t) * (x2 - x1), y2 - y1,
+                                src_stride, dst_stride);
+    return;
   }
 #endif  // CONFIG_USE_DMA
 
-  // Draw the focus border to inform the user what window has the focus.
-  if (window->has_focus()) {
-    graphics::Painter painter(m_screen_buffer, m_screen_width, m_screen_height, m_screen_pitch);
-    painter.set_clipping(dst_rect.x1, dst_rect.y1, dst_rect.x2, dst_rect.y2);
-    const auto window_rect = window->get_geometry();
-    painter.draw_rect(window_rect.x() - 1, window_rect.y() - 1, window_rect.width() + 2, window_rect.height() + 2,
-                      0xAA6BA4B8);
+  // Copy row by row, both buffers are stored in row-major order.
+  const size_t row_byte_size = sizeof(uint32_t) * (x2 - x1);
+  for (uint32_t src_y = y1, dst_y = rect.top(); src_y < y2; ++src_y, dst_y++) {
+    libk::memcpy(get_target_pixel(rect.left(), dst_y), &framebuffer[x1 + framebuffer_pitch * src_y], row_byte_size);
   }
 }
 
-void WindowManager::draw_windows(libk::LinkedList<Window*>::Iterator it,
-                                 const Rect& dst_rect,
-                                 DMARequestQueue& request_queue) {
-  KASSERT(dst_rect.left() >= 0 && dst_rect.right() <= m_screen_width && dst_rect.top() >= 0 &&
-          dst_rect.bottom() <= m_screen_height);
+/** Blends the pixels @a a and @a b, with the weight @a weight (out of 256) for @a b. The 4 channels are blended
+ * two by two in 64-bit registers, as the kernel does not use the SIMD registers. */
+static uint32_t blend_pixels(uint32_t a, uint32_t b, uint32_t weight) {
+  const uint64_t a_channels = (a & 0x00ff00ff) | ((uint64_t)(a & 0xff00ff00) << 24);
+  const uint64_t b_channels = (b & 0x00ff00ff) | ((uint64_t)(b & 0xff00ff00) << 24);
+  const uint64_t channels = ((a_channels * (256 - weight) + b_channels * weight) >> 8) & 0x00ff00ff00ff00ff;
+  return (uint32_t)(channels & 0x00ff00ff) | (uint32_t)((channels >> 24) & 0xff00ff00);
+}
 
+void WindowManager::draw_scaled_window_content(Window* window, const Rect& rect, DMARequestQueue& request_queue) {
 #ifndef CONFIG_USE_DMA
   (void)request_queue;
 #endif  // !CONFIG_USE_DMA
 
-  if (!dst_rect.has_surface())
+  const uint32_t* framebuffer = window->get_framebuffer();
+  const uint32_t framebuffer_pitch = window->get_framebuffer_pitch();
+  KASSERT(framebuffer != nullptr);
+
+  const uint32_t surface_width = window->get_surface_width();
+  const uint32_t surface_height = window->get_surface_height();
+  const uint32_t window_width = window->m_geometry.width();
+  const uint32_t window_height = window->m_geometry.height();
+  const uint32_t x1 = rect.left() - window->m_geometry.left();
+  const uint32_t y1 = rect.top() - window->m_geometry.top();
+  const size_t row_byte_size = sizeof(uint32_t) * rect.width();
+  const size_t pitch = get_target_pitch();
+
+  if (window_width % surface_width == 0 && window_height % surface_height == 0) {
+    // Integer upscale: each surface pixel is duplicated. Only the first screen row of each surface row is scaled
+    // by the CPU, the next ones are copies of it (a DMA 2D copy with a negative source stride reads the same row
+    // again for each line).
+    const uint32_t x_factor = window_width / surface_width;
+    const uint32_t y_factor = window_height / surface_height;
+    for (uint32_t y = y1; y < y1 + rect.height();) {
+      const uint32_t* src_row = &framebuffer[framebuffer_pitch * (y / y_factor)];
+      uint32_t* dst_row = get_target_pixel(rect.left(), rect.top() + y - y1);
+      for (uint32_t x = x1; x < x1 + rect.width(); ++x)
+        dst_row[x - x1] = src_row[x / x_factor];
+
+      const uint32_t nb_copies = libk::min(y_factor - y % y_factor, y1 + rect.height() - y) - 1;
+#ifdef CONFIG_USE_DMA
+      if (nb_copies > 0 && row_byte_size <= INT16_MAX && !m_is_drawing_tile) {
+        const auto row_dma_addr =
+            m_screen_buffer_dma_addr + sizeof(uint32_t) * (rect.left() + m_screen_pitch * (rect.top() + y - y1));
+        request_queue.add_memcpy_2d(row_dma_addr, row_dma_addr + sizeof(uint32_t) * m_screen_pitch, row_byte_size,
+                                    nb_copies, (uint16_t)-(int16_t)row_byte_size,
+                                    sizeof(uint32_t) * m_screen_pitch - row_byte_size);
+        y += nb_copies + 1;
+        continue;
+      }
+#endif  // CONFIG_USE_DMA
+
+      for (uint32_t i = 1; i <= nb_copies; ++i)
+        libk::memcpy(dst_row + pitch * i, dst_row, row_byte_size);
+      y += nb_copies + 1;
+    }
+
     return;
+  }
+
+  // Bilinear scaling, with 16.16 fixed point positions of the window pixel centers in the surface. Each screen
+  // pixel is computed by the CPU (the DMA cannot blend).
+  const uint64_t x_step = ((uint64_t)surface_width << 16) / window_width;
+  const uint64_t y_step = ((uint64_t)surface_height << 16) / window_height;
+  const uint64_t max_x = (uint64_t)(surface_width - 1) << 16;
+  const uint64_t max_y = (uint64_t)(surface_height - 1) << 16;
+  const auto get_position = [](uint32_t i, uint64_t step, uint64_t max) {
+    const int64_t position = (int64_t)(i * step + step / 2) - (1 << 15);
+    return libk::clamp<int64_t>(position, 0, max);
+  };
+
+  // The filter is separable: the surface rows are first blended horizontally, then each screen pixel is a
+  // single blend of two filtered rows. When upscaling, the consecutive screen rows share their surface rows,
+  // which are then filtered once. The source column and weight of each screen column are also computed once.
+  const size_t width = rect.width();
+  uint32_t* columns = get_scale_buffer(3 * width);
+  if (columns == nullptr)
+    return;  // out of memory, the content is not drawn
+
+  for (size_t i = 0; i < width; ++i) {
+    const uint64_t src_x = get_position(x1 + i, x_step, max_x);
+    columns[i] = ((src_x >> 16) << 8) | ((src_x >> 8) & 0xff);
+  }
+
+  const auto filter_row = [&](uint32_t surface_y, uint32_t* filtered_row) {
+    const uint32_t* src_row = &framebuffer[framebuffer_pitch * surface_y];
+    for (size_t i = 0; i < width; ++i) {
+      const uint32_t i0 = columns[i] >> 8;
+      const uint32_t i1 = i0 + 1 < surface_width ? i0 + 1 : i0;
+      filtered_row[i] = blend_pixels(src_row[i0], src_row[i1], columns[i] & 0xff);
+    }
+  };
+
+  // The two filtered rows, and the surface rows they come from (-1 if none yet).
+  uint32_t* filtered_rows[2] = {columns + width, columns + 2 * width};
+  int64_t filtered_rows_y[2] = {-1, -1};
+  for (uint32_t y = y1; y < y1 + rect.height(); ++y) {
+    const uint64_t src_y = get_position(y, y_step, max_y);
+    const uint32_t row0_y = src_y >> 16;
+    const uint32_t row1_y = row0_y + 1 < surface_height ? row0_y + 1 : row0_y;
+    const uint32_t y_weight = (src_y >> 8) & 0xff;
+
+    if (filtered_rows_y[0] != row0_y) {
+      if (filtered_rows_y[1] == row0_y) {
+        // Moved down by one surface row, the second row becomes the first one.
+        std::swap(filtered_rows[0], filtered_rows[1]);
+        std::swap(filtered_rows_y[0], filtered_rows_y[1]);
+      } else {
+        filter_row(row0_y, filtered_rows[0]);
+        filtered_rows_y[0] = row0_y;
+      }
+    }
+
+    if (filtered_rows_y[1] != row1_y) {
+      filter_row(row1_y, filtered_rows[1]);
+      filtered_rows_y[1] = row1_y;
+    }
+
+    uint32_t* dst_row = get_target_pixel(rect.left(), rect.top() + y - y1);
+    if (y_weight == 0) {
+      libk::memcpy(dst_row, filtered_rows[0], sizeof(uint32_t) * width);
+      continue;
+    }
 
-  if (it == m_windows.end()) {
-    // No more windows, we hit the background image!
-    // draw_background(dst_rect);
-    return;  // end of recursion
+    for (size_t i = 0; i < width; ++i)
+      dst_row[i] = blend_pixels(filtered_rows[0][i], filtered_rows[1][i], y_weight);
   }
+}
 
-  Rect src_rect = (*it)->m_geometry;
+uint32_t* WindowManager::get_scale_buffer(size_t size) {
+  if (size > m_scale_buffer_size) {
+    delete[] m_scale_buffer;
+    m_scale_buffer = new uint32_t[size];
+    m_scale_buffer_size = m_scale_buffer != nullptr ? size : 0;
+  }
 
-  // Draw the current window (into the destination rectangle):
-  draw_window(*it, dst_rect, request_queue);
+  return m_scale_buffer;
+}
 
-  // Recursively draw the windows behind:
-  // dst_rect:
-  //  |---------------------------------------------------------|
-  //  |               |         TOP           |                 |
-  //  |               |                       |                 |
-  //  |               |-----------------------|                 |
-  //  |               |                       |                 |
-  //  |     LEFT      |        CENTER         |      RIGHT      |
-  //  |               |       src_rect        |                 |
-  //  |               |-----------------------|                 |
-  //  |               |                       |                 |
-  //  |               |        BOTTOM         |                 |
-  //  |               |                       |                 |
-  //  |---------------------------------------------------------|
+void WindowManager::draw_window_decoration(Window* window, const Rect& rect) {
+  if (!rect.has_surface())
+    return;
 
-  if (src_rect.right() > dst_rect.right())
-    src_rect.set_right(dst_rect.right());
-  if (src_rect.left() < dst_rect.left())
-    src_rect.set_left(dst_rect.left());
-  if (src_rect.bottom() > dst_rect.bottom())
-    src_rect.set_bottom(dst_rect.bottom());
-  if (src_rect.top() < dst_rect.top())
-    src_rect.set_top(dst_rect.top());
+  const uint32_t* decoration = window->get_decoration();
+  if (decoration == nullptr) {
+    // Out of memory, at least show where the title bar is.
+    fill_rect(rect, Window::BORDER_COLOR, m_dma_request_queue);
+    return;
+  }
 
-  const Rect left = Rect::from_edges(dst_rect.left(), dst_rect.top(), src_rect.left(), dst_rect.bottom());
-  const Rect top = Rect::from_edges(src_rect.left(), dst_rect.top(), src_rect.right(), src_rect.top());
-  const Rect right = Rect::from_edges(src_rect.right(), dst_rect.top(), dst_rect.right(), dst_rect.bottom());
-  const Rect bottom = Rect::from_edges(src_rect.left(), src_rect.bottom(), src_rect.right(), dst_rect.bottom());
+  // The decoration is small and the same for each frame, it is copied by the CPU (as the fills of the borders).
+  const uint32_t pitch = window->m_geometry.width();
+  const uint32_t x1 = rect.left() - window->m_geometry.left();
+  const uint32_t y1 = rect.top() - window->m_geometry.top();
+  const size_t row_byte_size = sizeof(uint32_t) * rect.width();
+  for (int32_t j = 0; j < rect.height(); ++j) {
+    libk::memcpy(get_target_pixel(rect.left(), rect.top() + j), &decoration[x1 + pitch * (y1 + j)], row_byte_size);
+  }
+}
 
-  // get the next visible window (windows are sorted from front to back).
-  do {
-    it++;
-  } while (it != m_windows.end() && !(*it)->is_visible());
+void WindowManager::draw_focus_border(Window* window, const Rect& dst_rect) {
+  // Draw the focus border to inform the user what window has the focus.
+  // It is translucent, so it must be drawn after what is below it.
+  // The painter coordinates are relative to the buffer drawn into (the screen, or the tile).
+  const Rect target = m_is_drawing_tile ? m_tile_rect : Rect{0, 0, m_screen_width, m_screen_height};
+  graphics::Painter painter(get_target_pixel(target.left(), target.top()), target.width(), target.height(),
+                            get_target_pitch());
+  painter.set_clipping(dst_rect.left() - target.left(), dst_rect.top() - target.top(),
+                       dst_rect.right() - target.left() - 1, dst_rect.bottom() - target.top() - 1);
+  const auto window_rect = window->get_geometry();
+  painter.draw_rect(window_rect.x() - target.left() - 1, window_rect.y() - target.top() - 1, window_rect.width() + 2,
+                    window_rect.height() + 2, 0xAA6BA4B8);
+}
 
-  draw_windows(it, left, request_queue);
-  draw_windows(it, top, request_queue);
-  draw_windows(it, right, request_queue);
-  draw_windows(it, bottom, request_queue);
+uint64_t WindowManager::get_area(const Region& region) {
+  uint64_t area = 0;
+  for (const Rect& rect : region)
+    area += (uint64_t)rect.width() * rect.height();
+  return area;
 }
 
 void WindowManager::draw_windows() {
+  if (m_is_tiled) {
+    draw_windows_tiled();
+    return;
+  }
+
+  const Region& damage = m_update_damage;
+  DMARequestQueue& dma_request_queue = m_dma_request_queue;
+  m_update_stats = {};
+  m_update_stats.damaged_pixels = get_area(damage);
+
+  // Windows are sorted from front to back: each window takes the damaged pixels it covers and that are
+  // not already taken, and the background gets the remaining ones. So each pixel is set exactly once (the
+  // windows are opaque), and the windows and the background covered by the windows in front are not touched.
+  // Only the windows intersecting the damage bounds are looked at, the other ones are culled.
+  Region remaining = damage;
+  m_window_grid.for_each_intersecting(damage.get_bounding_rect(), [&](Window* window) {
+    Region visible = remaining;
+    visible.intersect(window->get_geometry());
+    if (visible.is_empty())
+      return;
+
+    for (const Rect& rect : visible)
+      draw_window(window, rect, dma_request_queue);
+
+    ++m_update_stats.drawn_windows;
+    m_update_stats.drawn_pixels += get_area(visible);
+    remaining.subtract(window->get_geometry());
+  });
+  m_update_stats.culled_windows = m_window_grid.get_visible_count() - m_update_stats.drawn_windows;
+
+  for (const Rect& rect : remaining)
+    draw_background(rect, dma_request_queue);
+  m_update_stats.drawn_pixels += get_area(remaining);
+
 #ifdef CONFIG_USE_DMA
-  m_dma_channel.abort_previous();
+  m_update_stats.dma_requests = dma_request_queue.request_count;
 #endif  // CONFIG_USE_DMA
+  m_update_stats.composite_time = GenericTimer::get_elapsed_time_in_micros() - m_update_start_time;
+}
 
-  DMARequestQueue dma_request_queue;
-  draw_background({0, 0, m_screen_width, m_screen_height}, dma_request_queue);
+void WindowManager::draw_windows_tiled() {
+  const Region& damage = m_update_damage;
+  m_update_stats = {};
+  m_update_stats.damaged_pixels = get_area(damage);
+
+  // The same culling as draw_windows(), but the visible part of each window is kept to be drawn tile by tile.
+  struct Layer {
+    Window* window;
+    Region visible;
+  };  // struct Layer
+  libk::SmallVector<Layer, 16> layers;
+  Region remaining = damage;
+  m_window_grid.for_each_intersecting(damage.get_bounding_rect(), [&](Window* window) {
+    Region visible = remaining;
+    visible.intersect(window->get_geometry());
+    if (visible.is_empty())
+      return;
 
-  if (!m_windows.is_empty()) {
-#if CONFIG_USE_NAIVE_WM_UPDATE
-    auto it = m_windows.begin();
-    while (it.has_next())
-      ++it;
+    ++m_update_stats.drawn_windows;
+    m_update_stats.drawn_pixels += get_area(visible);
+    remaining.subtract(window->get_geometry());
+    layers.emplace_back(window, std::move(visible));
+  });
+  m_update_stats.culled_windows = m_window_grid.get_visible_count() - m_update_stats.drawn_windows;
+
+  m_update_stats.drawn_pixels += get_area(remaining);
+
+  // The focus border is blended in the tiles too, so present_update() has nothing left to draw below the HUD.
+  Window* focus_window = m_update_focus_window;
+  m_update_focus_window = nullptr;
+  Rect focus_border_rect;
+  if (focus_window != nullptr) {
+    const Rect window_rect = focus_window->get_geometry();
+    focus_border_rect = {window_rect.left() - 1, window_rect.top() - 1, window_rect.right() + 1,
+                         window_rect.bottom() + 1};
+    for (const Rect& rect : damage) {
+      m_update_stats.drawn_pixels += get_area(Region(focus_border_rect.intersected(rect))) -
+                                     get_area(Region(window_rect.intersected(rect)));
+    }
+  }
 
-    while (it != m_windows.end()) {
-      draw_window(*it, {0, 0, m_screen_width, m_screen_height}, dma_request_queue);
-      --it;
+  // Each tile gets all its layers while it is in the L1 cache, then is copied (or converted to RGB565) into the
+  // screen buffer: each screen pixel is written once, by rows of TILE_WIDTH pixels.
+  m_is_drawing_tile = true;
+  for (const Rect& rect : damage) {
+    for (int32_t y = rect.top(); y < rect.bottom(); y += m_tile_height) {
+      for (int32_t x = rect.left(); x < rect.right(); x += TILE_WIDTH) {
+        m_tile_rect = {x, y, libk::min(x + TILE_WIDTH, rect.right()), libk::min(y + m_tile_height, rect.bottom())};
+
+        for (const Layer& layer : layers) {
+          for (const Rect& visible_rect : layer.visible) {
+            const Rect tile_rect = visible_rect.intersected(m_tile_rect);
+            if (tile_rect.has_surface())
+              draw_window(layer.window, tile_rect, m_dma_request_queue);
+          }
+        }
+
+        for (const Rect& remaining_rect : remaining) {
+          const Rect tile_rect = remaining_rect.intersected(m_tile_rect);
+          if (tile_rect.has_surface())
+            draw_background(tile_rect, m_dma_request_queue);
+        }
+
+        if (focus_window != nullptr && focus_border_rect.intersected(m_tile_rect).has_surface())
+          draw_focus_border(focus_window, m_tile_rect);
+
+        for (int32_t j = 0; j < m_tile_rect.height(); ++j) {
+          graphics::convert_from_argb<FrameBuffer::PixelFormat>(
+              &m_screen_buffer[m_tile_rect.left() + m_screen_pitch * (m_tile_rect.top() + j)],
+              &m_tile_buffer[TILE_WIDTH * j], m_tile_rect.width());
+        }
+      }
     }
-#else
-    draw_windows(m_windows.begin(), {0, 0, m_screen_width, m_screen_height}, dma_request_queue);
-#endif  // CONFIG_USE_NAIVE_WM_UPDATE
   }
 
+  m_is_drawing_tile = false;
+  m_update_stats.composite_time = GenericTimer::get_elapsed_time_in_micros() - m_update_start_time;
+}
+
+bool WindowManager::toggle_tiled_composition() {
+  if (m_is_tiled) {
+#ifndef CONFIG_FRAMEBUFFER_RGB565
+    // Required by a panel with its own memory (see the constructor).
+    if (!FrameBuffer::get().has_partial_present())
+      m_is_tiled = false;
+#endif  // !CONFIG_FRAMEBUFFER_RGB565
+    return true;
+  }
+
+  if (m_tile_buffer == nullptr) {
+    // Half of the L1 data cache, the other half is for the source rows (the window framebuffers, the wallpaper).
+    const size_t l1d_size = libk::get_cpu_features().l1d_size != 0 ? libk::get_cpu_features().l1d_size : 32 * 1024;
+    m_tile_height = libk::clamp<int32_t>(l1d_size / 2 / (sizeof(uint32_t) * TILE_WIDTH), 8, 64);
+    m_tile_buffer = new uint32_t[TILE_WIDTH * m_tile_height];
+    if (m_tile_buffer == nullptr)
+      return false;
+
+    LOG_INFO("Tiled composition with tiles of {}x{} pixels", TILE_WIDTH, m_tile_height);
+  }
+
+  m_is_tiled = true;
+  return true;
+}
+
+void WindowManager::present_update() {
+  if (m_update_focus_window != nullptr) {
+    // The focus border is translucent: its pixels are set twice.
+    const Rect window_rect = m_update_focus_window->get_geometry();
+    const Rect border_rect = {window_rect.left() - 1, window_rect.top() - 1, window_rect.right() + 1,
+                              window_rect.bottom() + 1};
+    for (const Rect& rect : m_update_damage) {
+      draw_focus_border(m_update_focus_window, rect);
+      m_update_stats.drawn_pixels += get_area(Region(border_rect.intersected(rect))) -
+                                     get_area(Region(window_rect.intersected(rect)));
+    }
+  }
+
+  // The HUD is not counted in the statistics it shows.
+  if (m_hud.is_enabled()) {
+    for (const Rect& rect : m_update_damage)
+      m_hud.draw(m_screen_buffer, m_screen_pitch, rect);
+  }
+
+  if (!m_cursor.is_hardware())
+    m_cursor.draw(m_screen_buffer, m_screen_pitch);
+
+  // A panel with its own memory and the screen stream only get the redrawn areas, and the cursor erased before
+  // they were drawn.
+  auto& fb = FrameBuffer::get();
+  if (fb.has_partial_present() || m_screen_stream.is_enabled()) {
+    for (const Rect& rect : m_update_damage)
+      present_screen_rect(rect);
+    if constexpr (FrameBuffer::NB_BUFFERS == 1) {
+      if (!m_cursor.is_hardware()) {
+        present_screen_rect(m_update_cursor_rect);
+        present_screen_rect(m_cursor.get_rect());
+      }
+    }
+
+    m_screen_stream.flush();
+  }
+
+  fb.present();
+
+  // With double buffering, the next frame is drawn into the other buffer.
+  m_screen_buffer = fb.get_buffer();
 #ifdef CONFIG_USE_DMA
-  dma_request_queue.execute_and_wait(m_dma_channel);
+  m_screen_buffer_dma_addr = DMA::get_dma_bus_address((VirtualAddress)m_screen_buffer, false);
 #endif  // CONFIG_USE_DMA
 
-  FrameBuffer::get().present();
+  const auto end = GenericTimer::get_elapsed_time_in_micros();
+  const UpdateStats& stats = m_update_stats;
+  const uint64_t overdraw = stats.drawn_pixels - stats.damaged_pixels;
+  LOG_DEBUG("Window manager update done in {} ms for {} window(s): {} drawn, {} culled, {} pixels damaged, {} "
+            "overdrawn ({}%)",
+            (end - m_update_start_time) / 1000, m_window_count, stats.drawn_windows, stats.culled_windows,
+            stats.damaged_pixels, overdraw, stats.damaged_pixels != 0 ? overdraw * 100 / stats.damaged_pixels : 0);
+
+  if (m_hud.is_enabled()) {
+    const FrameStatsHud::Frame frame = {stats.composite_time, end - m_update_start_time - stats.composite_time,
+                                        stats.damaged_pixels, stats.drawn_pixels, stats.dma_requests};
+    if (m_hud.record_frame(frame, end))
+      add_damage(m_hud.get_rect());
+  }
+
+  m_update_damage.clear();
+  m_update_focus_window = nullptr;
+}
+
+void WindowManager::present_screen_rect(const Rect& rect) {
+  FrameBuffer::get().present_rect(rect.x(), rect.y(), rect.width(), rect.height());
+  m_screen_stream.send(m_screen_buffer, m_screen_pitch, rect);
 }
 
 bool WindowManager::handle_key_event(sys_key_event_t event) {
@@ -573,6 +1391,16 @@ bool WindowManager::handle_key_event(sys_key_event_t event) {
     case SYS_KEY_SEMI_COLON:  // Alt+M -> mosaic layout
       mosaic_layout();
       return true;
+    case SYS_KEY_H:  // Alt+H -> toggle the frame stats HUD
+      if (!m_hud.toggle())
+        LOG_ERROR("Failed to show the frame stats HUD");
+      add_damage(m_hud.get_rect());
+      return true;
+    case SYS_KEY_T:  // Alt+T -> toggle the tiled composition
+      if (!toggle_tiled_composition())
+        LOG_ERROR("Failed to enable the tiled composition");
+      add_damage({0, 0, m_screen_width, m_screen_height});
+      return true;
     case SYS_KEY_E: {  // Alt+E -> spawn the file explorer
       auto explorer = TaskManager::get().create_task("/bin/explorer");
       if (explorer == nullptr) {
@@ -598,7 +1426,7 @@ void WindowManager::switch_focus() {
     return;
 
   if (m_focus_window == nullptr) {
-    focus_window(*m_windows.begin());
+    focus_window(m_windows.front());
     return;
   } else {
     auto old_window_it = std::find(m_windows.begin(), m_windows.end(), m_focus_window);
@@ -631,15 +1459,16 @@ void WindowManager::switch_focus() {
 
     // Move new window to front
     auto new_window = *new_window_it;
-    m_windows.erase(new_window_it);
-    m_windows.push_front(new_window);
+    raise_window(new_window);
+    add_window_border_damage(new_window);
 
-    // Move old window to back
+    // Move old window to back, it may be covered by any other window now.
     auto old_window = *old_window_it;
-    m_windows.erase(old_window_it);
+    m_windows.remove(old_window);
     m_windows.push_back(old_window);
+    m_window_grid.restack(m_windows);
 
-    m_dirty = true;
+    add_window_damage(old_window);
   }
 }
 
@@ -725,52 +1554,166 @@ void WindowManager::resize_focus_window_down() {
 
 #include "fs/fat/ff.h"
 
-void WindowManager::read_wallpaper() {
-  constexpr const char* WALLPAPER_PATH = "/wallpaper.jpg";
+namespace {
+// The decoded wallpaper, already scaled to the screen size and in the screen pixel format. It is produced
+// at build time (tools/jpg2pkimg.py), the filesystem is read-only.
+constexpr const char* WALLPAPER_CACHE_PATH = "/wallpaper.pkimg";
+constexpr uint32_t WALLPAPER_CACHE_MAGIC = 0x4d494b50;  // "PKIM"
+// The wallpaper images, tried in order. The QOI one is converted at build time (see tools/img2qoi.py).
+constexpr const char* WALLPAPER_PATHS[] = {"/wallpaper.qoi", "/wallpaper.jpg"};
+
+struct WallpaperCacheHeader {
+  uint32_t magic;
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;
+};  // struct WallpaperCacheHeader
+}  // namespace
+
+uint32_t* WindowManager::allocate_wallpaper() {
+  const size_t byte_size = sizeof(uint32_t) * m_screen_width * m_screen_height;
+#if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
+  m_wallpaper = libk::make_scoped<Buffer>(byte_size);
+  return (uint32_t*)m_wallpaper->get();
+#else
+  auto* wallpaper = (uint32_t*)kmalloc(byte_size, alignof(max_align_t));
+  KASSERT(wallpaper != nullptr);
+  m_wallpaper = wallpaper;
+  return wallpaper;
+#endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
+}
 
+bool WindowManager::read_wallpaper_cache() {
   FIL file = {};
-  if (f_open(&file, WALLPAPER_PATH, FA_READ) != FR_OK) {
-    LOG_WARNING("Failed to open '{}'", WALLPAPER_PATH);
-    return;
+  if (f_open(&file, WALLPAPER_CACHE_PATH, FA_READ) != FR_OK)
+    return false;
+
+  WallpaperCacheHeader header = {};
+  UINT read_bytes;
+  const size_t byte_size = sizeof(uint32_t) * m_screen_width * m_screen_height;
+  if (f_read(&file, &header, sizeof(header), &read_bytes) != FR_OK || read_bytes != sizeof(header) ||
+      header.magic != WALLPAPER_CACHE_MAGIC || header.width != (uint32_t)m_screen_width ||
+      header.height != (uint32_t)m_screen_height || f_size(&file) != sizeof(header) + byte_size) {
+    LOG_WARNING("Ignoring '{}', not made for the screen size {}x{}", WALLPAPER_CACHE_PATH, m_screen_width,
+                m_screen_height);
+    f_close(&file);
+    return false;
   }
 
-  const UINT file_size = f_size(&file);
-  uint8_t* buffer = (uint8_t*)kmalloc(file_size, alignof(max_align_t));
+  // Already in the screen format, read it directly into the wallpaper buffer.
+  uint32_t* wallpaper = allocate_wallpaper();
+  const auto result = f_read(&file, wallpaper, byte_size, &read_bytes);
+  KASSERT(result == FR_OK);
+  KASSERT(read_bytes == byte_size);
+  f_close(&file);
+  return true;
+}
+
+/** Reads the whole file at @a path into a new kmalloc() buffer, whose byte size is written to @a size. */
+static uint8_t* read_whole_file(const char* path, size_t& size) {
+  FIL file = {};
+  if (f_open(&file, path, FA_READ) != FR_OK)
+    return nullptr;
+
+  size = f_size(&file);
+  uint8_t* buffer = (uint8_t*)kmalloc(size, alignof(max_align_t));
   KASSERT(buffer != nullptr);
 
   UINT read_bytes;
-  const auto result = f_read(&file, buffer, file_size, &read_bytes);
+  const auto result = f_read(&file, buffer, size, &read_bytes);
   KASSERT(result == FR_OK);
-  KASSERT(read_bytes == file_size);
+  KASSERT(read_bytes == size);
   f_close(&file);
+  return buffer;
+}
 
-  int wallpaper_width, wallpaper_height;
-  uint32_t* wallpaper =
-      (uint32_t*)stbi_load_from_memory(buffer, file_size, &wallpaper_width, &wallpaper_height, nullptr, 4);
-  kfree(buffer);
+void WindowManager::scale_wallpaper(const uint32_t* image, uint32_t image_width, uint32_t image_height) {
+  // Scale the image to the screen size (nearest neighbor, 16.16 fixed point steps), once. Then the background is a
+  // plain copy of the wallpaper.
+  uint32_t* wallpaper = allocate_wallpaper();
+  const uint32_t step_x = ((uint64_t)image_width << 16) / m_screen_width;
+  const uint32_t step_y = ((uint64_t)image_height << 16) / m_screen_height;
+  for (int32_t y = 0; y < m_screen_height; ++y) {
+    const uint32_t* src_row = image + image_width * ((y * step_y) >> 16);
+    uint32_t* dst_row = wallpaper + m_screen_width * y;
+    for (int32_t x = 0; x < m_screen_width; ++x)
+      dst_row[x] = src_row[(x * step_x) >> 16];
+  }
+}
 
-  if (wallpaper == nullptr) {
-    LOG_WARNING("Failed to load the wallpaper, the file is probably badly formatted or not a JPEG");
-    return;
+bool WindowManager::read_wallpaper_image(const char* path) {
+  size_t file_size;
+  uint8_t* buffer = read_whole_file(path, file_size);
+  if (buffer == nullptr)
+    return false;
+
+  uint32_t image_width, image_height;
+  bool is_ok = graphics::read_image_size(buffer, file_size, image_width, image_height);
+  if (is_ok && image_width == (uint32_t)m_screen_width && image_height == (uint32_t)m_screen_height) {
+    // Already at the screen size, decoded directly into the wallpaper buffer.
+    is_ok = graphics::decode_image(buffer, file_size, allocate_wallpaper(), m_screen_width);
+  } else if (is_ok) {
+    auto* image = (uint32_t*)kmalloc(sizeof(uint32_t) * image_width * image_height, alignof(max_align_t));
+    is_ok = image != nullptr && graphics::decode_image(buffer, file_size, image, image_width);
+    if (is_ok)
+      scale_wallpaper(image, image_width, image_height);
+    kfree(image);
   }
 
-  // The wallpaper is in RGBA, we expect ABGR. Do the conversion once.
-  for (int32_t x = 0; x < wallpaper_width; ++x) {
-    for (int32_t y = 0; y < wallpaper_height; ++y) {
-      // The wallpaper is in RGBA, we expect ABGR.
-      const auto color = libk::bswap(wallpaper[x + wallpaper_width * y]);
-      wallpaper[x + wallpaper_width * y] = color >> 8;
-    }
+  kfree(buffer);
+  if (is_ok) {
+    LOG_INFO("Wallpaper loaded from '{}' (size {}x{}, scaled to {}x{})", path, image_width, image_height,
+             m_wallpaper_width, m_wallpaper_height);
+  } else {
+    LOG_WARNING("Ignoring '{}', the file is badly formatted or not a supported image", path);
+  }
+
+  return is_ok;
+}
+
+uint64_t WindowManager::get_wallpaper_digest() {
+  const auto& fb = FrameBuffer::get();
+  uint64_t digest = libk::hash_multiple(fb.get_width(), fb.get_height());
+  for (const char* path : {WALLPAPER_CACHE_PATH, WALLPAPER_PATHS[0], WALLPAPER_PATHS[1]}) {
+    FILINFO file_info;
+    if (f_stat(path, &file_info) == FR_OK)
+      libk::hash_combine(digest, path, (uint64_t)file_info.fsize, file_info.fdate, file_info.ftime);
   }
 
+  return digest;
+}
+
+const uint32_t* WindowManager::get_wallpaper() const {
 #if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
-  m_wallpaper = libk::make_scoped<Buffer>(sizeof(uint32_t) * wallpaper_width * wallpaper_height);
-  libk::memcpy(m_wallpaper->get(), wallpaper, m_wallpaper->get_byte_size());
+  return m_wallpaper ? (const uint32_t*)m_wallpaper->get() : nullptr;
 #else
-  m_wallpaper = wallpaper;
+  return m_wallpaper;
 #endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
-  m_wallpaper_width = wallpaper_width;
-  m_wallpaper_height = wallpaper_height;
+}
+
+void WindowManager::read_wallpaper() {
+  if (!m_is_supported)
+    return;
+
+  m_wallpaper_width = m_screen_width;
+  m_wallpaper_height = m_screen_height;
+
+  if (BootSnapshot::has_wallpaper()) {
+    BootSnapshot::take_wallpaper(allocate_wallpaper());
+    LOG_INFO("Wallpaper taken from the boot snapshot (size {}x{})", m_wallpaper_width, m_wallpaper_height);
+    return;
+  }
+
+  if (read_wallpaper_cache()) {
+    LOG_INFO("Wallpaper loaded from '{}' (size {}x{})", WALLPAPER_CACHE_PATH, m_wallpaper_width, m_wallpaper_height);
+    return;
+  }
+
+  // The QOI image, if converted at build time, is decoded much faster than the JPEG.
+  for (const char* path : WALLPAPER_PATHS) {
+    if (read_wallpaper_image(path))
+      return;
+  }
 
-  LOG_INFO("Wallpaper loaded (size {}x{})", m_wallpaper_width, m_wallpaper_height);
+  LOG_WARNING("Failed to load the wallpaper");
 }
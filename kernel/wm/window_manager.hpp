@@ -1,47 +1,126 @@
 #pragma once
 
 #include <sys/window.h>
-#include <libk/linked_list.hpp>
+#include <libk/hash_table.hpp>
+#include <libk/intrusive_list.hpp>
 #include <libk/memory.hpp>
 #include "geometry.hpp"
+#include "hardware/framebuffer.hpp"
 #include "task/task.hpp"
+#include "task/wait_list.hpp"
+#include "wm/cursor.hpp"
+#include "wm/frame_stats_hud.hpp"
+#include "wm/screen_stream.hpp"
+#include "wm/window.hpp"
+#include "wm/window_grid.hpp"
 #include "sys/keyboard.h"
 
 #ifdef CONFIG_USE_DMA
 #include "hardware/dma/channel.hpp"
 #endif  // CONFIG_USE_DMA
 
-class Window;
 class Task;
 
 class WindowManager {
  public:
+  /** Minimum time (in microseconds) between two updates, the display refresh period (60 Hz). */
+  static constexpr uint64_t FRAME_PERIOD = 16667;
+
   WindowManager();
 
   [[nodiscard]] static WindowManager& get() { return *g_instance; }
 
+  /**
+   * Reads the wallpaper and redraws the whole screen with it. The constructor does not read it, so the
+   * first frames (without wallpaper) do not wait for the JPEG decoding. It only takes the wallpaper of the boot
+   * snapshot, if any (see BootSnapshot).
+   */
+  void load_wallpaper();
+  /** Returns a digest of the wallpaper files (path, size and modification timestamp) and of the screen size, the
+   * wallpaper read by load_wallpaper() is the same while it does not change. */
+  [[nodiscard]] static uint64_t get_wallpaper_digest();
+  /** Returns the wallpaper scaled to the screen size (in 0x00RRGGBB format), or nullptr if not read. */
+  [[nodiscard]] const uint32_t* get_wallpaper() const;
+
+  /** Streams the presented frames to a host viewer over @a uart (see ScreenStream). Returns false if out of
+   * memory. */
+  bool start_screen_stream(UART* uart);
+  /** Sends the whole screen again to the host viewer, when it asks for it. */
+  void request_screen_key_frame() { m_screen_stream.request_key_frame(); }
+
   /** Checks if the window manager is supported (screen connected). */
   [[nodiscard]] bool is_supported() const { return m_is_supported; }
 
   /** Checks if the given window is a valid window, registered in this window manager. */
   [[nodiscard]] bool is_valid(Window* window) const;
+  /** Calls @a f with each window (as a const Window*), from front to back. */
+  template <class F>
+  void for_each_window(F f) const {
+    for (const auto* window : m_windows)
+      f(window);
+  }
 
-  Window* create_window(const libk::SharedPointer<Task>& task, uint32_t flags);
+  /** Returns the frontmost visible window under the screen point (@a x, @a y), or nullptr. */
+  [[nodiscard]] Window* get_window_at(int32_t x, int32_t y) const { return m_window_grid.find_at(x, y); }
+
+  /** Creates a window owned by @a task, behind the other windows. Returns nullptr if out of memory or if there are
+   * already WindowGrid::MAX_WINDOWS windows. */
+  Window* create_window(const libk::IntrusivePtr<Task>& task, uint32_t flags);
   void destroy_window(Window* window);
 
   void set_window_visibility(Window* window, bool visible);
   void set_window_geometry(Window* window, Rect rect);
   void set_window_geometry(Window* window, int32_t x, int32_t y, int32_t w, int32_t h);
+  /** Sets the surface size of @a window, see Window::set_surface_size(). */
+  void set_window_surface_size(Window* window, uint32_t width, uint32_t height);
 
+  /** Redraws the damaged screen area. With DMA, the update may still be pending when this returns: the screen
+   * is presented by finish_update() once the DMA requests are done. */
   void update();
 
+  /**
+   * Blocks the given task until the DMA requests of the pending update are done.
+   * The given task will be paused and awaken by the DMA interrupts.
+   *
+   * Returns true if the task was blocked. Otherwise (no pending update), returns false.
+   */
+  bool block_task_until_update_done(const libk::IntrusivePtr<Task>& task);
+  /** Finishes and presents the pending update, if any (waiting for the DMA requests if needed). */
+  void finish_update();
+
+  /**
+   * Blocks the given task until the screen needs to be updated (some area is damaged).
+   * The given task will be paused and awaken at the next damage.
+   *
+   * Returns true if the task was blocked (nothing is damaged currently).
+   * Otherwise, returns false.
+   */
+  bool block_task_until_damaged(const libk::IntrusivePtr<Task>& task);
+
   void focus_window(Window* window);
   void unfocus_window(Window* window);
 
   void post_message(sys_message_t message);
   bool post_message(Window* window, sys_message_t message);
 
+  /** Presents the whole window framebuffer to the screen. */
   void present_window(Window* window);
+  /** Presents only the pixels of @a rect (in the surface coordinates) to the screen. */
+  void present_window(Window* window, const Rect& rect);
+  /** Posts a SYS_MSG_FRAME message to @a window at the next frame, once it is visible (see
+   * sys_window_request_frame()). The requests before the message are merged. */
+  void request_window_frame(Window* window);
+  /** Sets the count of framebuffers of @a window, see Window::set_buffer_count(). */
+  [[nodiscard]] bool set_window_buffer_count(Window* window, uint32_t count);
+  /** Makes the back framebuffer of @a window the front one and presents it whole, see Window::swap_buffers().
+   * The owner never waits for the compositor with three buffers. */
+  void swap_window_buffers(Window* window);
+
+  /**
+   * Moves the mouse cursor to the screen coordinates (@a x, @a y). This never damages the windows below:
+   * the hardware cursor is simply moved, and the software cursor only restores the pixels it covered.
+   */
+  void move_cursor(int32_t x, int32_t y);
 
   void mosaic_layout();
 
@@ -57,60 +136,132 @@ class WindowManager {
   void resize_focus_window_up();
   void resize_focus_window_down();
 
+  /** Marks the given screen area (clipped to the screen) as to be redrawn by the next update(). */
+  void add_damage(const Rect& rect);
+  /** Marks the window area, including its focus border, as to be redrawn by the next update(). */
+  void add_window_damage(Window* window);
+  /** Checks if a visible window waits for a frame message, see request_window_frame(). */
+  [[nodiscard]] bool has_frame_requests() const;
+  /** Posts the frame messages requested by the visible windows. */
+  void post_frame_messages();
+  /** Marks only the focus border of the window as to be redrawn by the next update() (the focus changed). */
+  void add_window_border_damage(Window* window);
+  /** Moves the window to the front, only its area that was covered by other windows is damaged. */
+  void raise_window(Window* window);
+
+  /** Reads the wallpaper scaled to the screen size, from the boot snapshot or the prebuilt cache if any, or by
+   * decoding the image. */
   void read_wallpaper();
-  void fill_rect(const Rect& rect, uint32_t color);
+  [[nodiscard]] bool read_wallpaper_cache();
+  /** Decodes the image file at @a path (see graphics::decode_image()) into the wallpaper. */
+  [[nodiscard]] bool read_wallpaper_image(const char* path);
+  /** Scales the decoded @a image, in the screen format, to the screen size into a new wallpaper. */
+  void scale_wallpaper(const uint32_t* image, uint32_t image_width, uint32_t image_height);
+  [[nodiscard]] uint32_t* allocate_wallpaper();
+
+  /** Returns the address of the screen pixel (@a x, @a y) in the buffer drawn into: the screen buffer, or the
+   * tile buffer while a tile is composited (see draw_windows_tiled()). */
+  [[nodiscard]] uint32_t* get_target_pixel(int32_t x, int32_t y) const {
+#ifndef CONFIG_FRAMEBUFFER_RGB565
+    if (!m_is_drawing_tile)
+      return &m_screen_buffer[x + m_screen_pitch * y];
+#endif  // !CONFIG_FRAMEBUFFER_RGB565
+    return &m_tile_buffer[(x - m_tile_rect.left()) + TILE_WIDTH * (y - m_tile_rect.top())];
+  }
+  /** Returns the pitch (in pixels) of the buffer drawn into. */
+  [[nodiscard]] size_t get_target_pitch() const { return m_is_drawing_tile ? TILE_WIDTH : m_screen_pitch; }
+  /** Enables or disables the tiled composition. Returns false if out of memory. With an RGB565 screen, it cannot
+   * be disabled: the window framebuffers (in XRGB8888) are converted to the screen format by the tiles. */
+  bool toggle_tiled_composition();
 
 #ifdef CONFIG_USE_DMA
+  /** Count of DMA channels used in parallel to blit disjoint rectangles. */
+  static constexpr size_t NB_DMA_CHANNELS = 2;
+  /** Count of DMA requests allocated up front (more are allocated if needed). */
+  static constexpr size_t NB_PREALLOCATED_DMA_REQUESTS = 64;
+
+  // The DMA requests of an update, split into one chain per channel. The executed requests are kept
+  // in a free list and reused by the next updates, so no request is allocated per frame.
   struct DMARequestQueue {
-    DMA::Request* first_request = nullptr;
-    DMA::Request* last_request = nullptr;
-
-    ~DMARequestQueue() {
-      // Free the DMA request queue.
-      auto* request = first_request;
-      while (request != nullptr) {
-        auto* next = request->next();
-        delete request;
-        request = next;
-      }
-    }
-
-    void add(DMA::Request* request) {
-      KASSERT(request != nullptr);
-
-      if (first_request == nullptr) {
-        first_request = request;
-        last_request = request;
-      } else {
-        last_request->link_to(request);
-        last_request = request;
-      }
-    }
-
-    void execute_and_wait(DMA::Channel& channel) {
-      if (first_request == nullptr)
-        return;
-
-      channel.execute_requests(first_request);
-      channel.wait();
-    }
-  };
+    struct Chain {
+      DMA::Request* first_request = nullptr;
+      DMA::Request* last_request = nullptr;
+    };  // struct Chain
+
+    Chain chains[NB_DMA_CHANNELS];
+    size_t next_chain = 0;
+    DMA::Request* free_requests = nullptr;
+    size_t request_count = 0;  // queued since the last clear()
+    // The buffers read by the queued requests, they must not be moved (see Buffer::compact()).
+    libk::SmallVector<Buffer*, 16> pinned_buffers;
+
+    ~DMARequestQueue();
+
+    /** Allocates @a count requests into the free list. */
+    void reserve(size_t count);
+    /** Adds a 2D copy request, see DMA::Request::memcpy_2d(). */
+    void add_memcpy_2d(DMA::Address src,
+                       DMA::Address dst,
+                       uint16_t line_byte_length,
+                       uint16_t nb_lines,
+                       uint16_t src_stride,
+                       uint16_t dst_stride);
+    /** Adds a 2D fill request, see DMA::Request::fill_2d(). */
+    void add_fill_2d(uint32_t value,
+                     DMA::Address dst,
+                     uint16_t line_byte_length,
+                     uint16_t nb_lines,
+                     uint16_t dst_stride);
+    /** Appends @a request to the next chain, round robin. */
+    void add_request(DMA::Request* request);
+    /** Pins @a buffer until clear(), it is read by the requests added next. */
+    void pin(Buffer& buffer);
+    /** Submits the chains to the given channels (executed in parallel), @a completion is signalled once they
+     * are all done. Call clear() after. Returns false if the queue is empty. */
+    bool submit(DMA::Channel* channels, DMA::Completion* completion);
+    /** Executes the chains in parallel on the given channels, waits for them and clears the queue. */
+    void execute_and_wait(DMA::Channel* channels);
+    /** Gives back all the queued requests to the free list, and unpins the buffers. */
+    void clear();
+  };  // struct DMARequestQueue
 #else
   // Stub class when DMA usage is disabled.
   struct DMARequestQueue {};  // struct DMARequestQueue
 #endif  // CONFIG_USE_DMA
 
+  /** Fills @a rect of the screen (or of the tile) with @a color, by a DMA request of @a request_queue if it is
+   * big enough. */
+  void fill_rect(const Rect& rect, uint32_t color, DMARequestQueue& request_queue);
   void draw_background(const Rect& rect, DMARequestQueue& request_queue);
+  /** Draws the part of @a window inside @a dst_rect: its framebuffer content and its frame strips. */
   void draw_window(Window* window, const Rect& dst_rect, DMARequestQueue& request_queue);
-  void draw_windows(libk::LinkedList<Window*>::Iterator it, const Rect& dst_rect, DMARequestQueue& request_queue);
+  /** Copies the @a rect (in screen coordinates, inside the window) of the framebuffer of @a window. */
+  void draw_window_content(Window* window, const Rect& rect, DMARequestQueue& request_queue);
+  /** Same as draw_window_content(), for a window whose surface is scaled (see Window::is_scaled()). */
+  void draw_scaled_window_content(Window* window, const Rect& rect, DMARequestQueue& request_queue);
+  /** Returns the scratch buffer of the scaling, of at least @a size pixels (nullptr if out of memory). */
+  [[nodiscard]] uint32_t* get_scale_buffer(size_t size);
+  /** Copies the @a rect (in screen coordinates, inside the title bar) of the cached decoration of @a window. */
+  void draw_window_decoration(Window* window, const Rect& rect);
+  void draw_focus_border(Window* window, const Rect& dst_rect);
 
+  /** Returns the number of pixels of @a region. */
+  [[nodiscard]] static uint64_t get_area(const Region& region);
   void draw_windows();
+  /** Same as draw_windows(), but the damage is composited by the CPU tile by tile into the tile buffer, and each
+   * tile is then copied once into the screen buffer. */
+  void draw_windows_tiled();
+  void present_update();
+  /** Sends @a rect of the screen buffer to a panel with its own memory (see FrameBuffer::present_rect()), and to
+   * the screen stream. */
+  void present_screen_rect(const Rect& rect);
 
  private:
   static WindowManager* g_instance;
 
   Window* m_focus_window = nullptr;  // the window that actually has focus
-  libk::LinkedList<Window*> m_windows;
+  libk::IntrusiveList<Window, &Window::m_wm_hook> m_windows;  // from front to back
+  libk::HashSet<Window*> m_valid_windows;  // the same windows, for is_valid()
   size_t m_window_count = 0;
 
   uint32_t m_last_window_x = 50, m_last_window_y = 50;
@@ -118,21 +269,69 @@ class WindowManager {
 #if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
   libk::ScopedPointer<Buffer> m_wallpaper;
 #else
-  const uint32_t* m_wallpaper;
+  const uint32_t* m_wallpaper = nullptr;
 #endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
-  uint32_t m_wallpaper_width, m_wallpaper_height;
+  // The wallpaper is scaled to the screen size, a row is m_wallpaper_width pixels long.
+  uint32_t m_wallpaper_width = 0, m_wallpaper_height = 0;
 
 #ifdef CONFIG_USE_DMA
-  DMA::Channel m_dma_channel;
+  DMA::Channel m_dma_channels[NB_DMA_CHANNELS];
 #endif  // CONFIG_USE_DMA
+  DMARequestQueue m_dma_request_queue;
 
-  uint32_t* m_screen_buffer;
+  FrameBuffer::Pixel* m_screen_buffer;
 #ifdef CONFIG_USE_DMA
   VirtualAddress m_screen_buffer_dma_addr;
 #endif  // CONFIG_USE_DMA
   size_t m_screen_pitch;
   int32_t m_screen_width, m_screen_height;
 
-  bool m_dirty = true;         // true when the windows need to be redrawn/updated.
+  // The tiled composition: a tile is TILE_WIDTH x m_tile_height pixels, sized to stay in the L1 data cache
+  // with the source rows read, so each layer is blended in the cache and the screen pixels are written once.
+  static constexpr int32_t TILE_WIDTH = 128;
+  bool m_is_tiled = false;
+  bool m_is_drawing_tile = false;
+  Rect m_tile_rect;  // the tile being composited into m_tile_buffer
+  int32_t m_tile_height = 0;
+  uint32_t* m_tile_buffer = nullptr;  // TILE_WIDTH x m_tile_height, allocated when first enabled
+
+  // The scratch buffer of draw_scaled_window_content() (see get_scale_buffer()), grown as needed.
+  uint32_t* m_scale_buffer = nullptr;
+  size_t m_scale_buffer_size = 0;
+
+  // Above this count of rectangles, the damage is simplified to its bounding rectangle.
+  static constexpr size_t MAX_DAMAGE_RECTS = 32;
+  // The screen area that needs to be redrawn by the next update.
+  Region m_damage;
+  // With several screen buffers, the damages of the last frames (the most recent first), to bring an old
+  // buffer up to date (see FrameBuffer::get_buffer_age()).
+  Region m_damage_history[FrameBuffer::NB_BUFFERS];
+  // The tasks waiting for some damage (see block_task_until_damaged()).
+  WaitList m_update_wait_list;
+  // The screen area redrawn by the current update, and the window whose focus border is drawn.
+  Region m_update_damage;
+  Window* m_update_focus_window = nullptr;
+  // With a single screen buffer, the software cursor erased by the current update (see update()).
+  Rect m_update_cursor_rect;
+  uint64_t m_update_start_time = 0;
+  // The pixel counts of the current update, logged once presented (see present_update()).
+  struct UpdateStats {
+    uint64_t damaged_pixels;  // the screen area to redraw
+    uint64_t drawn_pixels;    // the pixels set, the overdraw is the difference with the damage
+    size_t drawn_windows;
+    size_t culled_windows;  // the visible windows outside the damage or covered by the windows in front
+    size_t dma_requests;
+    uint64_t composite_time;  // (in us) from the start of the update to the end of draw_windows()
+  };  // struct UpdateStats
+  UpdateStats m_update_stats = {};
+  bool m_is_update_pending = false;  // are the DMA requests of the update still running?
+  Cursor m_cursor;
+  FrameStatsHud m_hud;
+  ScreenStream m_screen_stream;
+  // The visible windows indexed by their geometry, for the queries by area or by point.
+  WindowGrid m_window_grid;
+#ifdef CONFIG_USE_DMA
+  DMA::Completion m_dma_completion;
+#endif  // CONFIG_USE_DMA
   bool m_is_supported = true;  // is the window manager supported (screen connected)?
 };  // class WindowManager
@@ -0,0 +1,40 @@
+#include "window_timer.hpp"
+
+#include <libk/utils.hpp>
+#include "hardware/timer.hpp"
+#include "wm/window.hpp"
+#include "wm/window_manager.hpp"
+
+void WindowTimer::arm(uint64_t delay_in_us, uint64_t period_in_us) {
+  if (delay_in_us == 0) {
+    (void)m_timer.cancel();
+    return;
+  }
+
+  m_period = 0;
+  if (period_in_us != 0)
+    m_period = libk::max(period_in_us, MIN_PERIOD_IN_US) * GenericTimer::get_frequency() / 1'000'000;
+
+  m_timer.start_in_us(delay_in_us);
+}
+
+void WindowTimer::expire(void* timer) {
+  auto* self = (WindowTimer*)timer;
+
+  uint64_t count = 1;
+  if (self->m_period != 0) {
+    // Skip the periods already passed (the interrupt was late), they are only counted.
+    const uint64_t now = GenericTimer::get_tick_count();
+    const uint64_t deadline = self->m_timer.get_deadline() + self->m_period;
+    if (deadline <= now)
+      count += (now - deadline) / self->m_period + 1;
+
+    self->m_timer.start_at(self->m_timer.get_deadline() + count * self->m_period);
+  }
+
+  sys_message_t message = {};
+  message.id = SYS_MSG_TIMER;
+  message.param1 = self->m_handle;
+  message.param2 = count;
+  (void)WindowManager::get().post_message(self->m_window, message);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <libk/intrusive_list.hpp>
+#include "task/handle_table.hpp"
+#include "task/timers.hpp"
+
+class Window;
+
+/**
+ * A timer posting SYS_MSG_TIMER messages into the queue of its window (see sys_timer_create()), so a task can
+ * wait for its animation ticks and its input in the same sys_wait_message().
+ *
+ * The timer is owned by its window and destroyed with it. A periodic timer keeps its phase: the next deadline
+ * is the previous one plus the period, and the periods missed (e.g. while the queue was full or the task slow)
+ * are counted in param2 of the message instead of being posted one by one. The pending messages of a timer are
+ * also coalesced by the queue, adding up their counts.
+ *
+ * All the methods must be called with the kernel lock held.
+ */
+class WindowTimer {
+ public:
+  // Shorter periods are clamped, so a task cannot flood its queue.
+  static constexpr uint64_t MIN_PERIOD_IN_US = 1000;
+
+  explicit WindowTimer(Window* window) : m_window(window) {}
+
+  [[nodiscard]] Window* get_window() const { return m_window; }
+  /** Gets the handle of this timer in the window owner task, as seen by the userspace. */
+  [[nodiscard]] Handle get_handle() const { return m_handle; }
+
+  /** Posts the first message in @a delay_in_us, then each @a period_in_us if not 0. A delay of 0 disarms the
+   * timer. Arming it again restarts it. */
+  void arm(uint64_t delay_in_us, uint64_t period_in_us);
+
+ private:
+  friend class Window;
+
+  static void expire(void* timer);
+
+  Window* m_window;
+  Handle m_handle = INVALID_HANDLE;
+  uint64_t m_period = 0;  // in generic timer ticks, 0 for a one-shot timer
+  HrTimer m_timer{&WindowTimer::expire, this};
+  libk::IntrusiveListHook m_window_hook;  // links inside the timers of the window
+};  // class WindowTimer
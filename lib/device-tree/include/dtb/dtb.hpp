@@ -1,5 +1,6 @@
 #pragma once
 
+#include "index.hpp"
 #include "node.hpp"
 #include "parser.hpp"
 #include "reserved_sections.hpp"
@@ -15,12 +16,23 @@ class DeviceTree {
 
   [[nodiscard]] bool get_reserved_sections(ReservedSections* res) const;
 
+  /**
+   * Indexes the nodes and properties of the blob, the lookups below then no longer walk it.
+   * The index refers to this object, so it must not be copied or moved afterward.
+   */
+  bool build_index(libk::LinearAllocator& allocator) { return m_index.build(&m_p, allocator); }
+  [[nodiscard]] bool is_indexed() const { return m_index.is_built(); }
+
   [[nodiscard]] bool get_root(Node* node) const;
 
   [[nodiscard]] bool find_node(libk::StringView path, Node* node) const;
 
   [[nodiscard]] bool find_property(libk::StringView path, Property* property) const;
+  [[nodiscard]] bool find_property(const Node& node, libk::StringView name, Property* property) const;
+
+  [[nodiscard]] bool find_node_by_phandle(uint32_t phandle, Node* node) const;
 
  private:
   DeviceTreeParser m_p;
+  DeviceTreeIndex m_index;
 };
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <libk/linear_allocator.hpp>
+#include <libk/string_view.hpp>
+
+#include "node.hpp"
+#include "parser.hpp"
+
+/**
+ * An index of the nodes and properties of a device tree blob, built in one walk of the blob.
+ *
+ * The nodes are stored in depth-first order (the order of the blob), each one knowing its parent and where
+ * its subtree ends, so the children of a node are found without walking the blob. The names are compared
+ * by their hash first. The phandles are resolved with a direct table.
+ */
+class DeviceTreeIndex {
+ public:
+  static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+  DeviceTreeIndex() = default;
+
+  /**
+   * Builds the index of the blob read by @a parser, its arrays being allocated from @a allocator.
+   * Returns false if the allocator has not enough memory or the blob is not well-formed: the index is then
+   * left empty and the caller should walk the blob instead.
+   */
+  [[nodiscard]] bool build(const DeviceTreeParser* parser, libk::LinearAllocator& allocator);
+
+  [[nodiscard]] bool is_built() const { return m_parser != nullptr; }
+  [[nodiscard]] uint32_t get_node_count() const { return m_node_count; }
+
+  /** Finds the node of absolute @a path, returns its index or NO_NODE. */
+  [[nodiscard]] uint32_t find_node(libk::StringView path) const;
+  /** Finds the direct child of @a node named @a name, returns its index or NO_NODE. */
+  [[nodiscard]] uint32_t find_child(uint32_t node, libk::StringView name) const;
+  /** Finds the node whose `phandle` property is @a phandle, returns its index or NO_NODE. */
+  [[nodiscard]] uint32_t find_node_by_phandle(uint32_t phandle) const;
+  /** Finds the index of @a node (which must come from the indexed blob), or NO_NODE. */
+  [[nodiscard]] uint32_t find_node_index(const Node& node) const;
+
+  [[nodiscard]] bool find_property(uint32_t node, libk::StringView name, Property* property) const;
+
+  [[nodiscard]] Node get_node(uint32_t node) const;
+
+ private:
+  struct IndexedNode {
+    uint32_t offset;       // of the DTB_BEGIN_NODE token
+    uint32_t name_hash;
+    uint32_t parent;       // NO_NODE for the root
+    uint32_t subtree_end;  // the index following the last node of the subtree
+    uint32_t first_property;
+    uint32_t property_count;
+  };  // struct IndexedNode
+
+  struct IndexedProperty {
+    uint32_t offset;  // of the DTB_PROP token
+    uint32_t name_hash;
+  };  // struct IndexedProperty
+
+  struct Counts {
+    uint32_t nodes = 0;
+    uint32_t properties = 0;
+    uint32_t max_phandle = 0;
+  };  // struct Counts
+
+  // Above, the phandles are not indexed (the table would be too large).
+  static constexpr uint32_t MAX_PHANDLE = UINT16_MAX;
+  // Deeper blobs are not indexed.
+  static constexpr size_t MAX_DEPTH = 32;
+
+  [[nodiscard]] static uint32_t hash_name(libk::StringView name);
+  /** Walks the blob, only counting if m_nodes is not allocated yet, or filling the arrays otherwise. */
+  [[nodiscard]] bool walk(const DeviceTreeParser* parser, Counts* counts);
+
+  [[nodiscard]] libk::StringView get_node_name(uint32_t node) const;
+  [[nodiscard]] libk::StringView get_property_name(uint32_t property) const;
+
+  const DeviceTreeParser* m_parser = nullptr;  // only set once the index is built
+  IndexedNode* m_nodes = nullptr;
+  IndexedProperty* m_properties = nullptr;
+  uint32_t* m_phandles = nullptr;  // indexed by the phandle, NO_NODE if no node has it
+  uint32_t m_node_count = 0;
+  uint32_t m_property_count = 0;
+  uint32_t m_phandle_count = 0;  // the size of m_phandles
+};  // class DeviceTreeIndex
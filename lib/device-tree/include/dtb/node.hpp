@@ -7,6 +7,7 @@
 #include "parser.hpp"
 
 class DeviceTree;
+class DeviceTreeIndex;
 
 class Node;
 struct StringList;
@@ -194,6 +195,7 @@ class Node {
 
  protected:
   friend DeviceTree;
+  friend DeviceTreeIndex;
   friend NodeIterator;
   explicit Node(const DeviceTreeParser* parser, size_t offset);
 
@@ -2,6 +2,16 @@
 #include <libk/string_view.hpp>
 
 bool DeviceTree::find_node(libk::StringView path, Node* node) const {
+  if (m_index.is_built()) {
+    const uint32_t index = m_index.find_node(path);
+    if (index == DeviceTreeIndex::NO_NODE) {
+      return false;
+    }
+
+    *node = m_index.get_node(index);
+    return true;
+  }
+
   Node current_node = {};
 
   if (!get_root(&current_node)) {
@@ -43,14 +53,61 @@ bool DeviceTree::find_property(libk::StringView path, Property* property) const
       return false;
     }
 
-    return node.find_property(path, property);
+    return find_property(node, path, property);
   } else {
     if (!find_node({path.begin(), last_delim}, &node)) {
       return false;
     }
 
-    return node.find_property(last_delim + 1, property);
+    return find_property(node, {last_delim + 1, path.end()}, property);
+  }
+}
+
+bool DeviceTree::find_property(const Node& node, libk::StringView name, Property* property) const {
+  const uint32_t index = m_index.find_node_index(node);
+  if (index == DeviceTreeIndex::NO_NODE) {
+    return node.find_property(name, property);
   }
+
+  return m_index.find_property(index, name, property);
+}
+
+static bool find_node_by_phandle_from(const Node& current, uint32_t phandle, Node* node) {
+  Property property;
+  if (current.find_property("phandle", &property) || current.find_property("linux,phandle", &property)) {
+    const auto value = property.get_u32();
+    if (value.has_value() && value.get_value() == phandle) {
+      *node = current;
+      return true;
+    }
+  }
+
+  for (const Node child : current.get_children()) {
+    if (find_node_by_phandle_from(child, phandle, node)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool DeviceTree::find_node_by_phandle(uint32_t phandle, Node* node) const {
+  if (m_index.is_built()) {
+    const uint32_t index = m_index.find_node_by_phandle(phandle);
+    if (index == DeviceTreeIndex::NO_NODE) {
+      return false;
+    }
+
+    *node = m_index.get_node(index);
+    return true;
+  }
+
+  Node root = {};
+  if (!get_root(&root)) {
+    return false;
+  }
+
+  return find_node_by_phandle_from(root, phandle, node);
 }
 
 bool DeviceTree::get_reserved_sections(ReservedSections* res) const {
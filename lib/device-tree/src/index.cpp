@@ -0,0 +1,289 @@
+#include "dtb/index.hpp"
+
+#include <libk/hash.hpp>
+#include <libk/string.hpp>
+#include "utils.hpp"
+
+uint32_t DeviceTreeIndex::hash_name(libk::StringView name) {
+  return (uint32_t)libk::hash((const uint8_t*)name.get_data(), name.get_length());
+}
+
+bool DeviceTreeIndex::walk(const DeviceTreeParser* parser, Counts* counts) {
+  const bool fill = m_nodes != nullptr;
+
+  uint32_t stack[MAX_DEPTH];
+  bool has_children[MAX_DEPTH];
+  size_t depth = 0;
+
+  uint32_t node_count = 0;
+  uint32_t property_count = 0;
+  uint32_t max_phandle = 0;
+
+  size_t offset = parser->get_struct_offset();
+  while (true) {
+    const uint32_t token = parser->get_uint32(offset);
+    switch (token) {
+      case DTB_BEGIN_NODE: {
+        if (depth == MAX_DEPTH || (depth == 0 && node_count != 0)) {
+          // Too deep, or a second root
+          return false;
+        }
+
+        const libk::StringView name = parser->get_string(offset + sizeof(uint32_t));
+        if (fill) {
+          m_nodes[node_count] = {
+              .offset = (uint32_t)offset,
+              .name_hash = hash_name(name),
+              .parent = depth == 0 ? NO_NODE : stack[depth - 1],
+              .subtree_end = 0,
+              .first_property = property_count,
+              .property_count = 0,
+          };
+        }
+
+        if (depth != 0) {
+          has_children[depth - 1] = true;
+        }
+
+        has_children[depth] = false;
+        stack[depth++] = node_count++;
+
+        // We count the \000 at the end of the name
+        offset = libk::align_to_next(offset + sizeof(uint32_t) + name.get_length() + 1, alignof(uint32_t));
+        break;
+      }
+
+      case DTB_PROP: {
+        // The properties of a node must precede its children, so that they are contiguous in the index.
+        if (depth == 0 || has_children[depth - 1]) {
+          return false;
+        }
+
+        const uint32_t node = stack[depth - 1];
+        const uint32_t length = parser->get_uint32(offset + sizeof(uint32_t));
+        const size_t name_offset = parser->get_uint32(offset + 2 * sizeof(uint32_t));
+        const libk::StringView name = parser->get_string(parser->get_string_offset() + name_offset);
+
+        if (fill) {
+          m_properties[property_count] = {.offset = (uint32_t)offset, .name_hash = hash_name(name)};
+          m_nodes[node].property_count++;
+        }
+
+        if (length == sizeof(uint32_t) && (name == "phandle" || name == "linux,phandle")) {
+          const uint32_t phandle = parser->get_uint32(offset + 3 * sizeof(uint32_t));
+          if (!fill) {
+            max_phandle = libk::max(max_phandle, phandle);
+          } else if (phandle < m_phandle_count) {
+            m_phandles[phandle] = node;
+          }
+        }
+
+        property_count++;
+        offset = parser->skip_property(offset);
+        break;
+      }
+
+      case DTB_NOP: {
+        offset += sizeof(uint32_t);
+        break;
+      }
+
+      case DTB_END_NODE: {
+        if (depth == 0) {
+          return false;
+        }
+
+        depth--;
+        if (fill) {
+          m_nodes[stack[depth]].subtree_end = node_count;
+        }
+
+        offset += sizeof(uint32_t);
+        break;
+      }
+
+      case DTB_END: {
+        if (depth != 0 || node_count == 0) {
+          return false;
+        }
+
+        counts->nodes = node_count;
+        counts->properties = property_count;
+        counts->max_phandle = max_phandle;
+        return true;
+      }
+
+      default:
+        return false;
+    }
+  }
+}
+
+bool DeviceTreeIndex::build(const DeviceTreeParser* parser, libk::LinearAllocator& allocator) {
+  if (parser == nullptr || !parser->is_initialized()) {
+    return false;
+  }
+
+  Counts counts;
+  if (!walk(parser, &counts)) {
+    return false;
+  }
+
+  auto* nodes = (IndexedNode*)allocator.malloc(counts.nodes * sizeof(IndexedNode), alignof(IndexedNode));
+  auto* properties =
+      (IndexedProperty*)allocator.malloc(counts.properties * sizeof(IndexedProperty), alignof(IndexedProperty));
+  if (nodes == nullptr || properties == nullptr) {
+    return false;
+  }
+
+  uint32_t phandle_count = 0;
+  uint32_t* phandles = nullptr;
+  if (counts.max_phandle <= MAX_PHANDLE) {
+    phandle_count = counts.max_phandle + 1;
+    phandles = (uint32_t*)allocator.malloc(phandle_count * sizeof(uint32_t), alignof(uint32_t));
+    if (phandles == nullptr) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < phandle_count; ++i) {
+      phandles[i] = NO_NODE;
+    }
+  }
+
+  m_nodes = nodes;
+  m_properties = properties;
+  m_phandles = phandles;
+  m_phandle_count = phandle_count;
+
+  if (!walk(parser, &counts)) {
+    *this = {};
+    return false;
+  }
+
+  m_node_count = counts.nodes;
+  m_property_count = counts.properties;
+  m_parser = parser;
+  return true;
+}
+
+libk::StringView DeviceTreeIndex::get_node_name(uint32_t node) const {
+  return m_parser->get_string(m_nodes[node].offset + sizeof(uint32_t));
+}
+
+libk::StringView DeviceTreeIndex::get_property_name(uint32_t property) const {
+  const size_t name_offset = m_parser->get_uint32(m_properties[property].offset + 2 * sizeof(uint32_t));
+  return m_parser->get_string(m_parser->get_string_offset() + name_offset);
+}
+
+uint32_t DeviceTreeIndex::find_node(libk::StringView path) const {
+  if (!is_built()) {
+    return NO_NODE;
+  }
+
+  uint32_t current_node = 0;  // The root
+  size_t begin = 0;
+
+  if (!path.is_empty() && path[0] == '/') {
+    begin++;
+  }
+
+  while (begin < path.get_length() && current_node != NO_NODE) {
+    const auto* next_delim = libk::strchrnul(path.get_data() + begin, '/');
+    const size_t node_name_length = libk::min<size_t>(next_delim - path.begin(), path.get_length()) - begin;
+
+    current_node = find_child(current_node, libk::StringView(path.begin() + begin, node_name_length));
+
+    begin += node_name_length;
+    if (begin < path.get_length()) {
+      begin++;  // Skip the '/'
+    }
+  }
+
+  return current_node;
+}
+
+uint32_t DeviceTreeIndex::find_child(uint32_t node, libk::StringView name) const {
+  if (node >= m_node_count) {
+    return NO_NODE;
+  }
+
+  const uint32_t name_hash = hash_name(name);
+
+  // The children are contiguous, each one followed by its own subtree.
+  for (uint32_t child = node + 1; child < m_nodes[node].subtree_end; child = m_nodes[child].subtree_end) {
+    if (m_nodes[child].name_hash == name_hash && get_node_name(child) == name) {
+      return child;
+    }
+  }
+
+  return NO_NODE;
+}
+
+uint32_t DeviceTreeIndex::find_node_by_phandle(uint32_t phandle) const {
+  if (!is_built()) {
+    return NO_NODE;
+  }
+
+  if (m_phandles != nullptr) {
+    return phandle < m_phandle_count ? m_phandles[phandle] : NO_NODE;
+  }
+
+  // Too large phandles to be in a table, search them.
+  Property property;
+  for (uint32_t node = 0; node < m_node_count; ++node) {
+    if (find_property(node, "phandle", &property) || find_property(node, "linux,phandle", &property)) {
+      const auto value = property.get_u32();
+      if (value.has_value() && value.get_value() == phandle) {
+        return node;
+      }
+    }
+  }
+
+  return NO_NODE;
+}
+
+uint32_t DeviceTreeIndex::find_node_index(const Node& node) const {
+  if (!is_built() || node.m_p == nullptr || !(*node.m_p == *m_parser)) {
+    return NO_NODE;
+  }
+
+  // The node offset is after its name, so we search the last indexed node starting before it.
+  uint32_t low = 0;
+  uint32_t high = m_node_count;
+  while (high - low > 1) {
+    const uint32_t middle = low + (high - low) / 2;
+    if (m_nodes[middle].offset < node.m_off) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  if (get_node(low).m_off != node.m_off) {
+    return NO_NODE;
+  }
+
+  return low;
+}
+
+bool DeviceTreeIndex::find_property(uint32_t node, libk::StringView name, Property* property) const {
+  if (node >= m_node_count) {
+    return false;
+  }
+
+  const uint32_t name_hash = hash_name(name);
+  const uint32_t end = m_nodes[node].first_property + m_nodes[node].property_count;
+
+  for (uint32_t i = m_nodes[node].first_property; i < end; ++i) {
+    if (m_properties[i].name_hash == name_hash && get_property_name(i) == name) {
+      *property = *PropertyIterator(m_parser, m_properties[i].offset);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Node DeviceTreeIndex::get_node(uint32_t node) const {
+  return Node(m_parser, m_nodes[node].offset);
+}
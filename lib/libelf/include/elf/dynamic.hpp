@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * The structures of the dynamic linking information of an ELF file (the PT_DYNAMIC segment and the
+ * tables it points to). Only what is needed to link the Aarch64 programs with their shared libraries
+ * is described (no lazy binding, no versioning, no TLS).
+ */
+
+namespace elf {
+/** The different tags of the dynamic table entries. */
+enum class DynamicTag : int64_t {
+  /** Marks the end of the dynamic table. */
+  NULL_TAG = 0,
+  /** The string table offset of the name of a needed library. */
+  NEEDED = 1,
+  /** Byte size of the relocations of the PLT (see JUMP_REL). */
+  PLT_REL_SIZE = 2,
+  /** Address of the symbol hash table (System V). */
+  HASH = 4,
+  /** Address of the dynamic string table. */
+  STRING_TABLE = 5,
+  /** Address of the dynamic symbol table. */
+  SYMBOL_TABLE = 6,
+  /** Address of the relocations with addend. */
+  RELA = 7,
+  /** Byte size of the relocations with addend. */
+  RELA_SIZE = 8,
+  /** Byte size of a relocation with addend entry. */
+  RELA_ENTRY_SIZE = 9,
+  /** Byte size of the dynamic string table. */
+  STRING_TABLE_SIZE = 10,
+  /** Byte size of a symbol entry. */
+  SYMBOL_ENTRY_SIZE = 11,
+  /** Type of the relocations of the PLT (7 for RELA). */
+  PLT_REL = 20,
+  /** Address of the relocations of the PLT. */
+  JUMP_REL = 23,
+  /** Address of the GNU symbol hash table. */
+  GNU_HASH = 0x6ffffef5,
+};  // enum class DynamicTag
+
+/**
+ * ELF 64-bits dynamic table entry.
+ */
+struct Dynamic {
+  DynamicTag tag;
+  /** An address or a value, depending on the tag. */
+  uint64_t value;
+};  // struct Dynamic
+
+/**
+ * ELF 64-bits symbol table entry.
+ */
+struct Symbol {
+  /** Offset of the symbol name in the string table. */
+  uint32_t name_offset;
+  uint8_t info;
+  uint8_t other;
+  /** Index of the section defining the symbol, 0 if it is undefined. */
+  uint16_t section_index;
+  /** The address of the symbol. */
+  uint64_t value;
+  uint64_t size;
+
+  /** Check if this symbol is defined by the file (and not imported). */
+  [[nodiscard]] bool is_defined() const { return section_index != 0; }
+
+  /** Check if this symbol is a function (STT_FUNC). */
+  [[nodiscard]] bool is_function() const { return (info & 0xf) == SYMBOL_TYPE_FUNCTION; }
+
+  static constexpr uint8_t SYMBOL_TYPE_FUNCTION = 2;
+};  // struct Symbol
+
+/** The Aarch64 relocation types handled by the dynamic linking. */
+enum class RelocationType : uint32_t {
+  NONE = 0,
+  /** S + A, a 64-bits absolute address. */
+  ABS64 = 257,
+  /** Copy the symbol data (not supported, the programs must not import data). */
+  COPY = 1024,
+  /** S + A, a GOT entry. */
+  GLOB_DAT = 1025,
+  /** S + A, a PLT GOT entry. */
+  JUMP_SLOT = 1026,
+  /** B + A, an address inside the file itself. */
+  RELATIVE = 1027,
+};  // enum class RelocationType
+
+/**
+ * ELF 64-bits relocation with addend.
+ */
+struct Rela {
+  /** Address of the relocated 64-bits word. */
+  uint64_t offset;
+  /** The symbol index (high 32 bits) and the relocation type (low 32 bits). */
+  uint64_t info;
+  int64_t addend;
+
+  [[nodiscard]] RelocationType get_type() const { return (RelocationType)(info & UINT32_MAX); }
+  [[nodiscard]] uint32_t get_symbol_index() const { return info >> 32; }
+};  // struct Rela
+
+/**
+ * The header of the System V symbol hash table (DT_HASH), followed by the buckets and the chains.
+ */
+struct HashTable {
+  uint32_t bucket_count;
+  /** Also the count of symbols in the symbol table. */
+  uint32_t chain_count;
+
+  [[nodiscard]] const uint32_t* get_buckets() const { return (const uint32_t*)(this + 1); }
+  [[nodiscard]] const uint32_t* get_chains() const { return get_buckets() + bucket_count; }
+};  // struct HashTable
+
+/**
+ * Computes the System V hash of the symbol @a name, as used by the DT_HASH table.
+ */
+[[nodiscard]] uint32_t hash_symbol_name(const char* name);
+
+/**
+ * The header of the GNU symbol hash table (DT_GNU_HASH), followed by the bloom filter, the buckets and the chains.
+ *
+ * Only the symbols from symbol_offset are hashed, sorted by bucket. A bucket holds the index of its first symbol
+ * (0 if empty), the chain entry of each symbol holds its hash with the lowest bit set on the last symbol of the
+ * bucket. Most of the lookups of missing names are rejected by the bloom filter without touching the symbols.
+ */
+struct GnuHashTable {
+  uint32_t bucket_count;
+  /** The index of the first symbol hashed, the chains start with it. */
+  uint32_t symbol_offset;
+  /** The count of 64-bits words of the bloom filter (a power of 2). */
+  uint32_t bloom_size;
+  uint32_t bloom_shift;
+
+  [[nodiscard]] const uint64_t* get_bloom() const { return (const uint64_t*)(this + 1); }
+  [[nodiscard]] const uint32_t* get_buckets() const { return (const uint32_t*)(get_bloom() + bloom_size); }
+  /** The chain entry of the symbol i is at index i - symbol_offset. */
+  [[nodiscard]] const uint32_t* get_chains() const { return get_buckets() + bucket_count; }
+
+  /** Returns the byte size of the table without its chains. */
+  [[nodiscard]] uint64_t get_byte_size_without_chains() const {
+    return sizeof(GnuHashTable) + sizeof(uint64_t) * (uint64_t)bloom_size + sizeof(uint32_t) * (uint64_t)bucket_count;
+  }
+
+  /** Checks the bloom filter: returns false if no symbol has the hash @a hash (see hash_gnu_symbol_name()). */
+  [[nodiscard]] bool may_contain(uint32_t hash) const {
+    const uint64_t word = get_bloom()[(hash / 64) & (bloom_size - 1)];
+    const uint64_t mask = (1ull << (hash % 64)) | (1ull << ((hash >> bloom_shift) % 64));
+    return (word & mask) == mask;
+  }
+};  // struct GnuHashTable
+
+/**
+ * Computes the GNU hash of the symbol @a name (DJB), as used by the DT_GNU_HASH table.
+ */
+[[nodiscard]] uint32_t hash_gnu_symbol_name(const char* name);
+}  // namespace elf
@@ -331,5 +331,25 @@ enum class Error {
  * @return Nullptr if the header is invalid or if the index is out of bounds, the program header otherwise.
  */
 [[nodiscard]] const ProgramHeader* get_program_header(const Header* header, uint64_t idx);
+
+/**
+ * Same as get_program_header(), but for a file streamed rather than loaded in memory: only the @a header
+ * and the program header table (read from header->program_header_offset) are in memory.
+ *
+ * @param header The ELF file header.
+ * @param program_headers The program header table, get_program_headers_byte_size() bytes.
+ * @param idx The program header index.
+ */
+[[nodiscard]] const ProgramHeader* get_program_header(const Header* header,
+                                                      const void* program_headers,
+                                                      uint64_t idx);
+
+/**
+ * Returns the byte size of the program header table of the given ELF file.
+ */
+[[nodiscard]] inline uint64_t get_program_headers_byte_size(const Header* header) {
+  return header == nullptr ? 0 : header->program_header_entry_count * sizeof(ProgramHeader);
+}
+
 [[nodiscard]] const SectionHeader* get_section_header(const Header* header, uint64_t idx);
 }  // namespace elf
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include "elf/dynamic.hpp"
+#include "elf/elf.hpp"
+
+/*
+ * The lookup of the symbols of an ELF file: by name with its hash tables (for the dynamic linking), and by
+ * address with an index of its function symbols sorted by address (to symbolize the code addresses of the
+ * stack traces).
+ *
+ * How to symbolize an address:
+ * ```c++
+ * elf::SymbolTable table;
+ * if (!elf::get_symbol_table(header, file_size, table))
+ *    return;
+ *
+ * // Built once, then each lookup is a binary search.
+ * uint32_t* index = new uint32_t[elf::count_address_symbols(table)];
+ * const uint64_t index_size = elf::build_address_index(table, index);
+ *
+ * const elf::Symbol* symbol = elf::find_symbol_by_address(table, index, index_size, pc);
+ * if (symbol != nullptr)
+ *    print("{}+{:#x}", table.get_name(symbol), pc - symbol->value);
+ * ```
+ */
+
+namespace elf {
+/** A symbol table and its string table, both in memory. */
+struct SymbolTable {
+  const Symbol* symbols = nullptr;
+  uint64_t symbol_count = 0;
+  const char* strings = nullptr;
+  uint64_t strings_size = 0;
+
+  /** Returns the name of @a symbol, or nullptr if it is not terminated inside the string table. */
+  [[nodiscard]] const char* get_name(const Symbol* symbol) const;
+};  // struct SymbolTable
+
+/**
+ * Same as get_section_header(), but for a file streamed rather than loaded in memory: only the @a header
+ * and the section header table (read from header->section_header_offset) are in memory.
+ */
+[[nodiscard]] const SectionHeader* get_section_header(const Header* header,
+                                                      const void* section_headers,
+                                                      uint64_t idx);
+
+/**
+ * Finds the symbol table section of the ELF file (SectionType::SYMBOL_TABLE, or DYNAMIC_SYMBOLS if the file is
+ * stripped) and its string table section, in the @a section_headers table (see get_section_header()).
+ * Returns false if there is none, or if they are malformed.
+ */
+[[nodiscard]] bool find_symbol_sections(const Header* header,
+                                        const void* section_headers,
+                                        const SectionHeader** symbols,
+                                        const SectionHeader** strings);
+
+/**
+ * Fills @a table with the symbol table of the ELF file loaded in memory (@a file_size bytes at @a header).
+ * Returns false if there is none, or if it is not inside the file.
+ */
+[[nodiscard]] bool get_symbol_table(const Header* header, uint64_t file_size, SymbolTable& table);
+
+/**
+ * Finds the defined symbol named @a name in @a table, the symbol table hashed by @a hash (DT_HASH). The chain
+ * count of the hash table must be the symbol count of @a table, and the table must be in memory.
+ */
+[[nodiscard]] const Symbol* find_symbol(const SymbolTable& table, const HashTable* hash, const char* name);
+
+/**
+ * Returns the count of symbols of the symbol table hashed by the GNU hash table @a hash, whose @a byte_size first
+ * bytes are in memory (its chains end with its last symbol). Returns 0 if the table is malformed.
+ */
+[[nodiscard]] uint64_t get_symbol_count(const GnuHashTable* hash, uint64_t byte_size);
+
+/**
+ * Finds the defined symbol named @a name in @a table, the symbol table hashed by @a hash (DT_GNU_HASH). The symbol
+ * count of @a table must be the one of get_symbol_count().
+ */
+[[nodiscard]] const Symbol* find_symbol(const SymbolTable& table, const GnuHashTable* hash, const char* name);
+
+/** Returns the count of symbols indexed by build_address_index(), the size of its index. */
+[[nodiscard]] uint64_t count_address_symbols(const SymbolTable& table);
+
+/**
+ * Writes into @a index the indices of the defined functions of @a table, sorted by address. Returns their count
+ * (the one of count_address_symbols()).
+ */
+uint64_t build_address_index(const SymbolTable& table, uint32_t* index);
+
+/**
+ * Finds the function containing @a address, with the @a index_size symbols of the @a index of @a table (see
+ * build_address_index()) by a binary search. The functions without size contain the addresses up to the next one.
+ * Returns nullptr if there is none.
+ */
+[[nodiscard]] const Symbol* find_symbol_by_address(const SymbolTable& table,
+                                                   const uint32_t* index,
+                                                   uint64_t index_size,
+                                                   uint64_t address);
+}  // namespace elf
@@ -0,0 +1,24 @@
+#include "elf/dynamic.hpp"
+
+namespace elf {
+uint32_t hash_symbol_name(const char* name) {
+  uint32_t hash = 0;
+  while (*name != '\0') {
+    hash = (hash << 4) + (uint8_t)*name++;
+    const uint32_t high = hash & 0xf0000000;
+    if (high != 0)
+      hash ^= high >> 24;
+    hash &= ~high;
+  }
+
+  return hash;
+}
+
+uint32_t hash_gnu_symbol_name(const char* name) {
+  uint32_t hash = 5381;
+  while (*name != '\0')
+    hash = hash * 33 + (uint8_t)*name++;
+
+  return hash;
+}
+}  // namespace elf
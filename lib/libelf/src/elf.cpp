@@ -53,11 +53,17 @@ const ProgramHeader* get_program_header(const Header* header, uint64_t idx) {
   if (header == nullptr)
     return nullptr;
 
+  return get_program_header(header, (const uint8_t*)header + header->program_header_offset, idx);
+}
+
+const ProgramHeader* get_program_header(const Header* header, const void* program_headers, uint64_t idx) {
+  if (header == nullptr || program_headers == nullptr)
+    return nullptr;
+
   if (idx >= header->program_header_entry_count)
     return nullptr;
 
-  const ProgramHeader* program_headers = (const ProgramHeader*)((const uint8_t*)header + header->program_header_offset);
-  const ProgramHeader* program_header = &program_headers[idx];
+  const ProgramHeader* program_header = &((const ProgramHeader*)program_headers)[idx];
 
   // Some sanity checks
   if (program_header->mem_size < program_header->file_size)
@@ -0,0 +1,195 @@
+#include "elf/symbols.hpp"
+
+#include <algorithm>
+
+namespace elf {
+/** Compares two NUL-terminated strings, the library does not depend on a C library. */
+static bool is_same_name(const char* lhs, const char* rhs) {
+  while (*lhs != '\0' && *lhs == *rhs) {
+    ++lhs;
+    ++rhs;
+  }
+
+  return *lhs == *rhs;
+}
+
+const char* SymbolTable::get_name(const Symbol* symbol) const {
+  if (symbol->name_offset >= strings_size)
+    return nullptr;
+
+  // The string must be terminated inside the table.
+  for (uint64_t i = symbol->name_offset; i < strings_size; ++i) {
+    if (strings[i] == '\0')
+      return strings + symbol->name_offset;
+  }
+
+  return nullptr;
+}
+
+const SectionHeader* get_section_header(const Header* header, const void* section_headers, uint64_t idx) {
+  if (header == nullptr || section_headers == nullptr)
+    return nullptr;
+
+  if (idx >= header->section_header_entry_count)
+    return nullptr;
+
+  return &((const SectionHeader*)section_headers)[idx];
+}
+
+bool find_symbol_sections(const Header* header,
+                          const void* section_headers,
+                          const SectionHeader** symbols,
+                          const SectionHeader** strings) {
+  const SectionHeader* dynamic_symbols = nullptr;
+  *symbols = nullptr;
+  for (uint64_t i = 0; i < header->section_header_entry_count; ++i) {
+    const SectionHeader* section = get_section_header(header, section_headers, i);
+    if (section->type == SectionType::SYMBOL_TABLE)
+      *symbols = section;
+    else if (section->type == SectionType::DYNAMIC_SYMBOLS)
+      dynamic_symbols = section;
+  }
+
+  if (*symbols == nullptr)
+    *symbols = dynamic_symbols;
+  if (*symbols == nullptr || (*symbols)->entry_size != sizeof(Symbol))
+    return false;
+
+  *strings = get_section_header(header, section_headers, (*symbols)->link);
+  return *strings != nullptr && (*strings)->type == SectionType::STRING_TABLE;
+}
+
+bool get_symbol_table(const Header* header, uint64_t file_size, SymbolTable& table) {
+  if (header == nullptr || header->section_header_offset > file_size ||
+      file_size - header->section_header_offset < sizeof(SectionHeader) * header->section_header_entry_count)
+    return false;
+
+  const SectionHeader* symbols;
+  const SectionHeader* strings;
+  if (!find_symbol_sections(header, (const uint8_t*)header + header->section_header_offset, &symbols, &strings))
+    return false;
+
+  if (symbols->offset > file_size || file_size - symbols->offset < symbols->size || strings->offset > file_size ||
+      file_size - strings->offset < strings->size)
+    return false;
+
+  table.symbols = (const Symbol*)((const uint8_t*)header + symbols->offset);
+  table.symbol_count = symbols->size / sizeof(Symbol);
+  table.strings = (const char*)header + strings->offset;
+  table.strings_size = strings->size;
+  return true;
+}
+
+/** Returns the symbol @a index of @a table if it is defined and named @a name. */
+static const Symbol* match_symbol(const SymbolTable& table, uint64_t index, const char* name) {
+  const Symbol* symbol = &table.symbols[index];
+  const char* symbol_name = table.get_name(symbol);
+  if (symbol->is_defined() && symbol_name != nullptr && is_same_name(symbol_name, name))
+    return symbol;
+  return nullptr;
+}
+
+const Symbol* find_symbol(const SymbolTable& table, const HashTable* hash, const char* name) {
+  if (hash->bucket_count == 0 || hash->chain_count != table.symbol_count)
+    return nullptr;
+
+  const uint32_t* chains = hash->get_chains();
+  uint32_t index = hash->get_buckets()[hash_symbol_name(name) % hash->bucket_count];
+  for (uint64_t steps = 0; index != 0 && index < hash->chain_count && steps < hash->chain_count; ++steps) {
+    if (const Symbol* symbol = match_symbol(table, index, name); symbol != nullptr)
+      return symbol;
+
+    index = chains[index];
+  }
+
+  return nullptr;
+}
+
+uint64_t get_symbol_count(const GnuHashTable* hash, uint64_t byte_size) {
+  if (byte_size < sizeof(GnuHashTable) || hash->bucket_count == 0 || hash->bloom_size == 0 ||
+      (hash->bloom_size & (hash->bloom_size - 1)) != 0 || byte_size < hash->get_byte_size_without_chains())
+    return 0;
+
+  // The symbols are sorted by bucket: the last one is at the end of the chain of the last non-empty bucket.
+  uint32_t last = 0;
+  for (uint32_t i = 0; i < hash->bucket_count; ++i)
+    last = std::max(last, hash->get_buckets()[i]);
+  if (last == 0)
+    return hash->symbol_offset;  // no symbol hashed
+  if (last < hash->symbol_offset)
+    return 0;
+
+  const uint64_t chain_count = (byte_size - hash->get_byte_size_without_chains()) / sizeof(uint32_t);
+  for (uint64_t i = last - hash->symbol_offset; i < chain_count; ++i) {
+    if ((hash->get_chains()[i] & 1) != 0)
+      return hash->symbol_offset + i + 1;
+  }
+
+  return 0;
+}
+
+const Symbol* find_symbol(const SymbolTable& table, const GnuHashTable* hash, const char* name) {
+  const uint32_t name_hash = hash_gnu_symbol_name(name);
+  if (hash->bucket_count == 0 || !hash->may_contain(name_hash))
+    return nullptr;
+
+  uint64_t index = hash->get_buckets()[name_hash % hash->bucket_count];
+  if (index < hash->symbol_offset)
+    return nullptr;  // empty bucket
+
+  // The lowest bit of the chain entries ends the bucket, the other ones are the symbol hash.
+  for (; index < table.symbol_count; ++index) {
+    const uint32_t chain = hash->get_chains()[index - hash->symbol_offset];
+    if ((chain | 1) == (name_hash | 1)) {
+      if (const Symbol* symbol = match_symbol(table, index, name); symbol != nullptr)
+        return symbol;
+    }
+
+    if ((chain & 1) != 0)
+      break;
+  }
+
+  return nullptr;
+}
+
+/** Checks if @a symbol is indexed by build_address_index(). */
+static bool is_address_symbol(const Symbol& symbol) {
+  return symbol.is_defined() && symbol.is_function() && symbol.value != 0;
+}
+
+uint64_t count_address_symbols(const SymbolTable& table) {
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < table.symbol_count; ++i)
+    count += is_address_symbol(table.symbols[i]) ? 1 : 0;
+  return count;
+}
+
+uint64_t build_address_index(const SymbolTable& table, uint32_t* index) {
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < table.symbol_count; ++i) {
+    if (is_address_symbol(table.symbols[i]))
+      index[count++] = i;
+  }
+
+  std::sort(index, index + count,
+            [&table](uint32_t lhs, uint32_t rhs) { return table.symbols[lhs].value < table.symbols[rhs].value; });
+  return count;
+}
+
+const Symbol* find_symbol_by_address(const SymbolTable& table,
+                                     const uint32_t* index,
+                                     uint64_t index_size,
+                                     uint64_t address) {
+  // The first function starting after the address, the one before may contain it.
+  const uint32_t* next = std::upper_bound(index, index + index_size, address, [&table](uint64_t value, uint32_t i) {
+    return value < table.symbols[i].value;
+  });
+  if (next == index)
+    return nullptr;
+
+  const Symbol* symbol = &table.symbols[*(next - 1)];
+  if (symbol->size != 0 && address - symbol->value >= symbol->size)
+    return nullptr;
+  return symbol;
+}
+}  // namespace elf
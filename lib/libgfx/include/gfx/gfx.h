@@ -0,0 +1,113 @@
+#ifndef __PIKAOS_LIBGFX_GFX_H__
+#define __PIKAOS_LIBGFX_GFX_H__
+
+#include <sys/__types.h>
+#include <sys/__utils.h>
+#include <sys/window.h>
+
+__SYS_EXTERN_C_BEGIN
+
+/* 2D rendering library, drawing into the window surfaces mapped into the process (see sys_window_get_surface()).
+ *
+ * It is the userspace port of the kernel painter (kernel/graphics/graphics.hpp) and gives the same pixels: the
+ * drawing runs on the core of the calling task, without a system call nor the kernel lock, and only the damaged
+ * area is then presented. The spans are filled and blended by NEON, 4 pixels at once. The colors are given in
+ * 0xAARRGGBB format and the pixels are written in 0x00RRGGBB format. */
+
+/* A PKF font (v1 or v2, see doc/pkf.md) and the cache of its glyphs. */
+typedef struct __gfx_glyph_t gfx_glyph_t;
+
+/* The code points whose glyphs are cached, the other ones are not drawn (the texts are drawn byte per byte). */
+#define GFX_FONT_CACHED_GLYPHS 256
+
+typedef struct __gfx_font_t {
+  const uint8_t* data;
+  /* The byte size of the file mapping, 0 if the data is not owned by the font. */
+  size_t mapping_size;
+  /* The glyphs as dense alpha maps, built the first time they are drawn (NULL until then). */
+  gfx_glyph_t* glyphs[GFX_FONT_CACHED_GLYPHS];
+} gfx_font_t;
+
+/* Initializes `font` from the PKF file at `path`, mapped into the process (see sys_mmap_file()). */
+sys_error_t gfx_font_load(gfx_font_t* font, const char* path);
+/* Initializes `font` from the PKF file content `data`, which must outlive the font. */
+void gfx_font_init(gfx_font_t* font, const uint8_t* data);
+/* Releases the glyph cache of `font`, and its file mapping if loaded by gfx_font_load(). */
+void gfx_font_destroy(gfx_font_t* font);
+
+/* The baseline-to-baseline distance, in pixels. */
+uint32_t gfx_font_get_line_height(const gfx_font_t* font);
+/* Returns the horizontal advance of `text` drawn on a single line, in pixels, kerning included. */
+uint32_t gfx_font_measure_text(const gfx_font_t* font, const char* text);
+
+/* A box of pixels, the maximums are included. It is empty if x_min > x_max or y_min > y_max. */
+typedef struct __gfx_box_t {
+  int32_t x_min;
+  int32_t y_min;
+  int32_t x_max;
+  int32_t y_max;
+} gfx_box_t;
+
+/* The painter of a buffer of pixels. All the drawing functions are clipped to the clipping box, and the drawn
+ * pixels are accumulated into the damage box, to be presented by gfx_present(). */
+typedef struct __gfx_painter_t {
+  uint32_t* pixels;
+  uint32_t width;
+  uint32_t height;
+  /* The length of a row, in pixels. */
+  uint32_t pitch;
+  /* The font of gfx_draw_text(), nothing is drawn if NULL. */
+  gfx_font_t* font;
+  gfx_box_t clipping;
+  gfx_box_t damage;
+} gfx_painter_t;
+
+/* Initializes `painter` to draw into the `width` x `height` pixels of `pixels`, without font nor damage. */
+void gfx_painter_init(gfx_painter_t* painter, uint32_t* pixels, uint32_t width, uint32_t height, uint32_t pitch);
+/* Same as gfx_painter_init() for the current surface of `window` (the back buffer if there are several). It must
+ * be called again once the surface changed: after a resize, a buffer swap or a change of the surface size. */
+sys_error_t gfx_painter_init_window(gfx_painter_t* painter, sys_window_t* window);
+
+static inline void gfx_set_font(gfx_painter_t* painter, gfx_font_t* font) {
+  painter->font = font;
+}
+
+/* Limits the drawing to the given box (intersected with the buffer), until gfx_reset_clipping(). */
+void gfx_set_clipping(gfx_painter_t* painter, int32_t x_min, int32_t y_min, int32_t x_max, int32_t y_max);
+void gfx_reset_clipping(gfx_painter_t* painter);
+
+/* The translucent colors (alpha below 255) are blended over the pixels, the transparent ones draw nothing.
+ * gfx_clear() is the exception: it stores the color into the whole buffer, whatever the clipping and the alpha. */
+void gfx_clear(gfx_painter_t* painter, uint32_t argb);
+void gfx_draw_pixel(gfx_painter_t* painter, int32_t x, int32_t y, uint32_t argb);
+void gfx_draw_line(gfx_painter_t* painter, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t argb);
+void gfx_draw_rect(gfx_painter_t* painter, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t argb);
+void gfx_fill_rect(gfx_painter_t* painter, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t argb);
+/* Draws `text` with the painter font, the lines are broken at '\n' only. Returns the x coordinate after the last
+ * character drawn. */
+int32_t gfx_draw_text(gfx_painter_t* painter, int32_t x, int32_t y, const char* text, uint32_t argb);
+/* Copies the `width` x `height` pixels of `argb_buffer` (row-major, without padding) at (`x`, `y`). */
+void gfx_blit(gfx_painter_t* painter,
+              int32_t x,
+              int32_t y,
+              uint32_t width,
+              uint32_t height,
+              const uint32_t* argb_buffer);
+/* Moves the `width` x `height` pixels at (`src_x`, `src_y`) to (`dst_x`, `dst_y`), the areas may overlap. */
+void gfx_copy_area(gfx_painter_t* painter,
+                   int32_t src_x,
+                   int32_t src_y,
+                   int32_t width,
+                   int32_t height,
+                   int32_t dst_x,
+                   int32_t dst_y);
+
+/* Adds the given area to the damage, for the pixels written without the painter. */
+void gfx_add_damage(gfx_painter_t* painter, int32_t x, int32_t y, int32_t width, int32_t height);
+/* Presents the damaged area of the surface of `window` (see sys_window_present_rect()) and clears the damage.
+ * Nothing is presented if nothing was drawn. */
+sys_error_t gfx_present(gfx_painter_t* painter, sys_window_t* window);
+
+__SYS_EXTERN_C_END
+
+#endif  // !__PIKAOS_LIBGFX_GFX_H__
@@ -0,0 +1,255 @@
+#include <gfx/gfx.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+
+#include "font.h"
+
+/*
+ * The PKF file layout, the same as kernel/graphics/pkfont.hpp (see doc/pkf.md).
+ */
+
+typedef struct {
+  uint32_t char_width;
+  uint32_t char_height;
+  uint32_t advance;
+  uint32_t line_height;
+} pkf_metrics_t;
+
+#define PKF_HEADER_SIZE 16
+#define PKF_V1_FIRST_CHARACTER 0x21
+#define PKF_V1_LAST_CHARACTER 0x7e
+#define PKF2_MAGIC 0x32464b50
+#define PKF2_ENCODING_OPAQUE 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t range_count;
+  uint32_t glyph_count;
+  uint32_t kerning_count;
+  pkf_metrics_t metrics;
+} pkf2_header_t;
+
+typedef struct {
+  uint32_t first_code_point;
+  uint32_t count;
+  uint32_t first_glyph;
+} pkf2_range_t;
+
+typedef struct {
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+  uint8_t encoding;
+  uint8_t advance;
+  uint8_t reserved[2];
+  uint32_t offset;
+} pkf2_glyph_t;
+
+typedef struct {
+  uint32_t left;
+  uint32_t right;
+  int32_t adjustment;
+} pkf2_kerning_pair_t;
+
+// Marks the code points without a glyph in the cache.
+static gfx_glyph_t g_missing_glyph;
+
+static sys_bool_t is_v2(const gfx_font_t* font) {
+  return *(const uint32_t*)font->data == PKF2_MAGIC;
+}
+
+static const pkf_metrics_t* get_metrics(const gfx_font_t* font) {
+  if (is_v2(font))
+    return &((const pkf2_header_t*)font->data)->metrics;
+  return (const pkf_metrics_t*)font->data;
+}
+
+static const pkf2_glyph_t* find_v2_glyph(const gfx_font_t* font, uint32_t code_point) {
+  const pkf2_header_t* header = (const pkf2_header_t*)font->data;
+  const pkf2_range_t* ranges = (const pkf2_range_t*)(font->data + sizeof(pkf2_header_t));
+  const pkf2_glyph_t* glyphs = (const pkf2_glyph_t*)(ranges + header->range_count);
+
+  // There are only a few ranges (usually ASCII and some Latin-1 or symbol blocks).
+  for (uint32_t i = 0; i < header->range_count; ++i) {
+    if (code_point - ranges[i].first_code_point < ranges[i].count)
+      return &glyphs[ranges[i].first_glyph + (code_point - ranges[i].first_code_point)];
+  }
+
+  return NULL;  // the font does not contain this glyph
+}
+
+/** Builds the cached glyph of @a code_point, or returns NULL if the font has no such glyph. */
+static gfx_glyph_t* create_glyph(const gfx_font_t* font, uint32_t code_point) {
+  const pkf_metrics_t* metrics = get_metrics(font);
+
+  // The v1 glyphs are already dense alpha maps of the whole cell, they are used in place.
+  if (!is_v2(font)) {
+    if (code_point < PKF_V1_FIRST_CHARACTER || code_point > PKF_V1_LAST_CHARACTER)
+      return NULL;
+
+    gfx_glyph_t* glyph = (gfx_glyph_t*)malloc(sizeof(gfx_glyph_t));
+    if (glyph == NULL)
+      return NULL;
+
+    const size_t cell_size = (size_t)metrics->char_width * metrics->char_height;
+    glyph->x = 0;
+    glyph->y = 0;
+    glyph->width = metrics->char_width;
+    glyph->height = metrics->char_height;
+    glyph->advance = metrics->advance;
+    glyph->alphas = font->data + PKF_HEADER_SIZE + cell_size * (code_point - PKF_V1_FIRST_CHARACTER);
+    return glyph;
+  }
+
+  const pkf2_glyph_t* pkf_glyph = find_v2_glyph(font, code_point);
+  if (pkf_glyph == NULL)
+    return NULL;
+
+  // The spans are decoded once into a dense alpha map of the glyph box, following the glyph.
+  const size_t map_size = (size_t)pkf_glyph->width * pkf_glyph->height;
+  gfx_glyph_t* glyph = (gfx_glyph_t*)malloc(sizeof(gfx_glyph_t) + map_size);
+  if (glyph == NULL)
+    return NULL;
+
+  uint8_t* alphas = (uint8_t*)(glyph + 1);
+  memset(alphas, 0, map_size);
+  glyph->x = pkf_glyph->x;
+  glyph->y = pkf_glyph->y;
+  glyph->width = pkf_glyph->width;
+  glyph->height = pkf_glyph->height;
+  glyph->advance = pkf_glyph->advance != 0 ? pkf_glyph->advance : metrics->advance;
+  glyph->alphas = alphas;
+
+  // Each row is a span count, then (skip, length) pairs, each followed by the alpha values if not opaque.
+  const sys_bool_t is_opaque = pkf_glyph->encoding == PKF2_ENCODING_OPAQUE;
+  const uint8_t* data = font->data + pkf_glyph->offset;
+  for (uint32_t j = 0; j < glyph->height; ++j) {
+    uint8_t* row = alphas + (size_t)glyph->width * j;
+    uint32_t x = 0;
+    for (uint32_t span_count = *data++; span_count > 0; --span_count) {
+      x += data[0];
+      const uint32_t length = data[1];
+      data += 2;
+
+      if (is_opaque) {
+        memset(row + x, 0xff, length);
+      } else {
+        memcpy(row + x, data, length);
+        data += length;
+      }
+      x += length;
+    }
+  }
+
+  return glyph;
+}
+
+const gfx_glyph_t* __gfx_font_get_glyph(gfx_font_t* font, uint32_t code_point) {
+  if (code_point >= GFX_FONT_CACHED_GLYPHS)
+    return NULL;
+
+  gfx_glyph_t* glyph = font->glyphs[code_point];
+  if (glyph == NULL) {
+    glyph = create_glyph(font, code_point);
+    font->glyphs[code_point] = glyph != NULL ? glyph : &g_missing_glyph;
+  }
+
+  return glyph != &g_missing_glyph ? glyph : NULL;
+}
+
+uint32_t __gfx_font_get_advance(const gfx_font_t* font, uint32_t code_point) {
+  if (is_v2(font)) {
+    const pkf2_glyph_t* glyph = find_v2_glyph(font, code_point);
+    if (glyph != NULL)
+      return glyph->advance != 0 ? glyph->advance : get_metrics(font)->advance;
+  } else if (code_point >= PKF_V1_FIRST_CHARACTER && code_point <= PKF_V1_LAST_CHARACTER) {
+    return get_metrics(font)->advance;
+  }
+
+  return code_point == ' ' ? get_metrics(font)->advance : 0;
+}
+
+int32_t __gfx_font_get_kerning(const gfx_font_t* font, uint32_t left, uint32_t right) {
+  if (!is_v2(font))
+    return 0;
+
+  const pkf2_header_t* header = (const pkf2_header_t*)font->data;
+  const pkf2_range_t* ranges = (const pkf2_range_t*)(font->data + sizeof(pkf2_header_t));
+  const pkf2_glyph_t* glyphs = (const pkf2_glyph_t*)(ranges + header->range_count);
+  const pkf2_kerning_pair_t* pairs = (const pkf2_kerning_pair_t*)(glyphs + header->glyph_count);
+
+  // Binary search, the pairs are sorted by (left, right).
+  const uint64_t key = ((uint64_t)left << 32) | right;
+  uint32_t begin = 0;
+  uint32_t end = header->kerning_count;
+  while (begin < end) {
+    const uint32_t middle = begin + (end - begin) / 2;
+    const uint64_t middle_key = ((uint64_t)pairs[middle].left << 32) | pairs[middle].right;
+    if (middle_key == key)
+      return pairs[middle].adjustment;
+
+    if (middle_key < key)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+
+  return 0;
+}
+
+uint32_t __gfx_font_get_char_width(const gfx_font_t* font) {
+  return get_metrics(font)->char_width;
+}
+
+void gfx_font_init(gfx_font_t* font, const uint8_t* data) {
+  memset(font, 0, sizeof(gfx_font_t));
+  font->data = data;
+}
+
+sys_error_t gfx_font_load(gfx_font_t* font, const char* path) {
+  sys_file_t* file = sys_open_file(path, SYS_FM_READ);
+  if (file == NULL)
+    return SYS_ERR_INVALID_FILE;
+
+  const size_t size = sys_get_file_size(file);
+  const void* data = NULL;
+  sys_error_t error = size < PKF_HEADER_SIZE ? SYS_ERR_INVALID_FILE : sys_mmap_file(file, &data);
+  sys_close_file(file);
+  if (!SYS_IS_OK(error))
+    return error;
+
+  gfx_font_init(font, (const uint8_t*)data);
+  font->mapping_size = size;
+  return SYS_ERR_OK;
+}
+
+void gfx_font_destroy(gfx_font_t* font) {
+  for (uint32_t i = 0; i < GFX_FONT_CACHED_GLYPHS; ++i) {
+    if (font->glyphs[i] != &g_missing_glyph)
+      free(font->glyphs[i]);
+  }
+
+  if (font->mapping_size != 0)
+    sys_munmap((void*)font->data, font->mapping_size);
+  memset(font, 0, sizeof(gfx_font_t));
+}
+
+uint32_t gfx_font_get_line_height(const gfx_font_t* font) {
+  return get_metrics(font)->line_height;
+}
+
+uint32_t gfx_font_measure_text(const gfx_font_t* font, const char* text) {
+  uint32_t advance = 0;
+  uint32_t previous = 0;
+  for (const char* it = text; *it != '\0'; ++it) {
+    const uint32_t code_point = (uint8_t)*it;
+    advance += __gfx_font_get_advance(font, code_point) + __gfx_font_get_kerning(font, previous, code_point);
+    previous = code_point;
+  }
+
+  return advance;
+}
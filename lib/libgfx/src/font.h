@@ -0,0 +1,24 @@
+#ifndef __PIKAOS_LIBGFX_FONT_H__
+#define __PIKAOS_LIBGFX_FONT_H__
+
+#include <gfx/gfx.h>
+
+/** A cached glyph: a dense alpha map of its box in the character cell (0 = transparent, 255 = opaque). */
+struct __gfx_glyph_t {
+  int32_t x;
+  int32_t y;
+  uint32_t width;
+  uint32_t height;
+  uint32_t advance;
+  /** Row-major, @a width bytes per row. In the font data for the v1 fonts, following the glyph otherwise. */
+  const uint8_t* alphas;
+};
+
+/** Gets the glyph of @a code_point, built on the first call, or NULL if the font has none. */
+const gfx_glyph_t* __gfx_font_get_glyph(gfx_font_t* font, uint32_t code_point);
+/** The same advances and kerning as PKFont::get_horizontal_advance() and PKFont::get_kerning(). */
+uint32_t __gfx_font_get_advance(const gfx_font_t* font, uint32_t code_point);
+int32_t __gfx_font_get_kerning(const gfx_font_t* font, uint32_t left, uint32_t right);
+uint32_t __gfx_font_get_char_width(const gfx_font_t* font);
+
+#endif  // !__PIKAOS_LIBGFX_FONT_H__
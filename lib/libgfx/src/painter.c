@@ -0,0 +1,328 @@
+#include <gfx/gfx.h>
+
+#include <string.h>
+#include <sys/syscall.h>
+
+#include "font.h"
+#include "span.h"
+
+/*
+ * The same algorithms as the kernel painter (kernel/graphics/graphics.cpp): each primitive is clipped once (in
+ * 64-bits, to not overflow), then drawn span by span. The drawn box is added to the damage.
+ */
+
+static inline int64_t max_i64(int64_t a, int64_t b) {
+  return a > b ? a : b;
+}
+
+static inline int64_t min_i64(int64_t a, int64_t b) {
+  return a < b ? a : b;
+}
+
+static inline int32_t abs_i32(int32_t x) {
+  return x < 0 ? -x : x;
+}
+
+static void clear_damage(gfx_painter_t* painter) {
+  painter->damage.x_min = INT32_MAX;
+  painter->damage.y_min = INT32_MAX;
+  painter->damage.x_max = INT32_MIN;
+  painter->damage.y_max = INT32_MIN;
+}
+
+/** Adds the pixels from (@a x_begin, @a y_begin) included to (@a x_end, @a y_end) excluded to the damage. */
+static void add_damage(gfx_painter_t* painter, int64_t x_begin, int64_t y_begin, int64_t x_end, int64_t y_end) {
+  gfx_box_t* damage = &painter->damage;
+  damage->x_min = (int32_t)min_i64(damage->x_min, x_begin);
+  damage->y_min = (int32_t)min_i64(damage->y_min, y_begin);
+  damage->x_max = (int32_t)max_i64(damage->x_max, x_end - 1);
+  damage->y_max = (int32_t)max_i64(damage->y_max, y_end - 1);
+}
+
+void gfx_painter_init(gfx_painter_t* painter, uint32_t* pixels, uint32_t width, uint32_t height, uint32_t pitch) {
+  painter->pixels = pixels;
+  painter->width = width;
+  painter->height = height;
+  painter->pitch = pitch;
+  painter->font = NULL;
+  gfx_reset_clipping(painter);
+  clear_damage(painter);
+}
+
+sys_error_t gfx_painter_init_window(gfx_painter_t* painter, sys_window_t* window) {
+  uint32_t* pixels;
+  uint32_t pitch;
+  sys_error_t error = sys_window_get_surface(window, &pixels, &pitch);
+  if (!SYS_IS_OK(error))
+    return error;
+
+  // The surface size is the window size, unless set by sys_window_set_surface_size().
+  uint32_t width, height;
+  sys_window_state_t state;
+  if (SYS_IS_OK(sys_window_get_state(window, &state))) {
+    width = state.surface_width;
+    height = state.surface_height;
+  } else {
+    error = sys_window_get_geometry(window, NULL, NULL, &width, &height);
+    if (!SYS_IS_OK(error))
+      return error;
+  }
+
+  gfx_painter_init(painter, pixels, width, height, pitch);
+  return SYS_ERR_OK;
+}
+
+void gfx_set_clipping(gfx_painter_t* painter, int32_t x_min, int32_t y_min, int32_t x_max, int32_t y_max) {
+  painter->clipping.x_min = (int32_t)max_i64(0, x_min);
+  painter->clipping.y_min = (int32_t)max_i64(0, y_min);
+  painter->clipping.x_max = (int32_t)min_i64((int64_t)painter->width - 1, x_max);
+  painter->clipping.y_max = (int32_t)min_i64((int64_t)painter->height - 1, y_max);
+}
+
+void gfx_reset_clipping(gfx_painter_t* painter) {
+  painter->clipping.x_min = 0;
+  painter->clipping.y_min = 0;
+  painter->clipping.x_max = (int32_t)painter->width - 1;
+  painter->clipping.y_max = (int32_t)painter->height - 1;
+}
+
+void gfx_clear(gfx_painter_t* painter, uint32_t argb) {
+  // Without padding between the rows, the whole buffer is a single span.
+  if (painter->pitch == painter->width) {
+    __gfx_fill_span(painter->pixels, argb, (size_t)painter->pitch * painter->height);
+  } else {
+    for (uint32_t y = 0; y < painter->height; ++y)
+      __gfx_fill_span(painter->pixels + (size_t)painter->pitch * y, argb, painter->width);
+  }
+
+  if (painter->width != 0 && painter->height != 0)
+    add_damage(painter, 0, 0, painter->width, painter->height);
+}
+
+void gfx_fill_rect(gfx_painter_t* painter, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t argb) {
+  const gfx_box_t* clipping = &painter->clipping;
+  const int64_t x_begin = max_i64(x, clipping->x_min);
+  const int64_t y_begin = max_i64(y, clipping->y_min);
+  const int64_t x_end = min_i64((int64_t)x + width, (int64_t)clipping->x_max + 1);
+  const int64_t y_end = min_i64((int64_t)y + height, (int64_t)clipping->y_max + 1);
+  const uint32_t alpha = argb >> 24;
+  if (x_begin >= x_end || y_begin >= y_end || alpha == 0)
+    return;
+
+  for (int64_t j = y_begin; j < y_end; ++j) {
+    uint32_t* row = painter->pixels + (x_begin + (int64_t)painter->pitch * j);
+    if (alpha == 0xff)
+      __gfx_fill_span(row, argb, x_end - x_begin);
+    else
+      __gfx_blend_span(row, argb, alpha, x_end - x_begin);
+  }
+
+  add_damage(painter, x_begin, y_begin, x_end, y_end);
+}
+
+void gfx_draw_pixel(gfx_painter_t* painter, int32_t x, int32_t y, uint32_t argb) {
+  gfx_fill_rect(painter, x, y, 1, 1, argb);
+}
+
+void gfx_draw_rect(gfx_painter_t* painter, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t argb) {
+  // The edges do not overlap, so the corners of a translucent rectangle are blended once.
+  if (width <= 2 || height <= 2) {
+    gfx_fill_rect(painter, x, y, width, height, argb);
+    return;
+  }
+
+  gfx_fill_rect(painter, x, y, width, 1, argb);                       // top edge
+  gfx_fill_rect(painter, x, y + height - 1, width, 1, argb);          // bottom edge
+  gfx_fill_rect(painter, x, y + 1, 1, height - 2, argb);              // left edge
+  gfx_fill_rect(painter, x + width - 1, y + 1, 1, height - 2, argb);  // right edge
+}
+
+void gfx_draw_line(gfx_painter_t* painter, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t argb) {
+  // The horizontal and vertical lines are spans, clipped once.
+  if (y1 == y2) {
+    gfx_fill_rect(painter, x1 < x2 ? x1 : x2, y1, abs_i32(x2 - x1) + 1, 1, argb);
+    return;
+  }
+  if (x1 == x2) {
+    gfx_fill_rect(painter, x1, y1 < y2 ? y1 : y2, 1, abs_i32(y2 - y1) + 1, argb);
+    return;
+  }
+
+  const uint32_t alpha = argb >> 24;
+  if (alpha == 0)
+    return;
+
+  // See https://en.wikipedia.org/wiki/Bresenham's_line_algorithm (the variant for all octants), only additions
+  // per pixel.
+  const gfx_box_t* clipping = &painter->clipping;
+  const int64_t dx = max_i64(x2, x1) - min_i64(x2, x1);
+  const int64_t dy = min_i64(y2, y1) - max_i64(y2, y1);
+  const int32_t step_x = x1 < x2 ? 1 : -1;
+  const int32_t step_y = y1 < y2 ? 1 : -1;
+
+  const int64_t x_begin = max_i64(min_i64(x1, x2), clipping->x_min);
+  const int64_t y_begin = max_i64(min_i64(y1, y2), clipping->y_min);
+  const int64_t x_end = min_i64(max_i64(x1, x2) + 1, (int64_t)clipping->x_max + 1);
+  const int64_t y_end = min_i64(max_i64(y1, y2) + 1, (int64_t)clipping->y_max + 1);
+  if (x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  int64_t error = dx + dy;
+  while (1) {
+    if (x1 >= x_begin && x1 < x_end && y1 >= y_begin && y1 < y_end) {
+      uint32_t* pixel = painter->pixels + (x1 + (int64_t)painter->pitch * y1);
+      if (alpha == 0xff)
+        __gfx_fill_span(pixel, argb, 1);
+      else
+        __gfx_blend_span(pixel, argb, alpha, 1);
+    }
+
+    if (x1 == x2 && y1 == y2)
+      break;
+
+    const int64_t double_error = 2 * error;
+    if (double_error >= dy) {
+      error += dy;
+      x1 += step_x;
+    }
+    if (double_error <= dx) {
+      error += dx;
+      y1 += step_y;
+    }
+  }
+
+  add_damage(painter, x_begin, y_begin, x_end, y_end);
+}
+
+/** Blends the @a glyph drawn at (@a x, @a y), clipped once, row by row. */
+static void draw_glyph(gfx_painter_t* painter, int64_t x, int64_t y, const gfx_glyph_t* glyph, uint32_t argb) {
+  const gfx_box_t* clipping = &painter->clipping;
+  const int64_t i_begin = max_i64(0, (int64_t)clipping->x_min - x);
+  const int64_t i_end = min_i64(glyph->width, (int64_t)clipping->x_max + 1 - x);
+  const int64_t j_begin = max_i64(0, (int64_t)clipping->y_min - y);
+  const int64_t j_end = min_i64(glyph->height, (int64_t)clipping->y_max + 1 - y);
+  if (i_begin >= i_end || j_begin >= j_end)
+    return;
+
+  for (int64_t j = j_begin; j < j_end; ++j) {
+    uint32_t* row = painter->pixels + ((x + i_begin) + (int64_t)painter->pitch * (y + j));
+    __gfx_blend_mask_span(row, argb, glyph->alphas + (j * glyph->width + i_begin), i_end - i_begin);
+  }
+
+  add_damage(painter, x + i_begin, y + j_begin, x + i_end, y + j_end);
+}
+
+int32_t gfx_draw_text(gfx_painter_t* painter, int32_t x, int32_t y, const char* text, uint32_t argb) {
+  gfx_font_t* font = painter->font;
+  if (font == NULL || (argb >> 24) == 0)
+    return x;
+
+  const uint32_t line_height = gfx_font_get_line_height(font);
+  int32_t current_x = x;
+  int32_t current_y = y;
+
+  uint32_t previous = 0;  // the previous character on the line, for kerning
+  for (const char* it = text; *it != '\0'; ++it) {
+    const uint32_t ch = (uint8_t)*it;
+
+    const gfx_glyph_t* glyph = __gfx_font_get_glyph(font, ch);
+    if (glyph != NULL) {
+      // Early clipping
+      if (current_x > painter->clipping.x_max)
+        continue;
+
+      current_x += __gfx_font_get_kerning(font, previous, ch);
+      draw_glyph(painter, (int64_t)current_x + glyph->x, (int64_t)current_y + glyph->y, glyph, argb);
+      current_x += glyph->advance;
+      previous = ch;
+    } else if (ch == ' ') {
+      current_x += __gfx_font_get_advance(font, ch);
+      previous = ch;
+    } else if (ch == '\n') {
+      current_x = x;
+      current_y += line_height;
+      previous = 0;
+    }
+
+    // Early clipping
+    if (current_y > painter->clipping.y_max)
+      return current_x;
+  }
+
+  return current_x;
+}
+
+void gfx_blit(gfx_painter_t* painter,
+              int32_t x,
+              int32_t y,
+              uint32_t width,
+              uint32_t height,
+              const uint32_t* argb_buffer) {
+  const gfx_box_t* clipping = &painter->clipping;
+  const int64_t x_begin = max_i64(x, clipping->x_min);
+  const int64_t y_begin = max_i64(y, clipping->y_min);
+  const int64_t x_end = min_i64((int64_t)x + width, (int64_t)clipping->x_max + 1);
+  const int64_t y_end = min_i64((int64_t)y + height, (int64_t)clipping->y_max + 1);
+  if (x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  // Both the image and the buffer are row-major, so each visible row is a single copy.
+  for (int64_t j = y_begin; j < y_end; ++j) {
+    memcpy(painter->pixels + (x_begin + (int64_t)painter->pitch * j),
+           argb_buffer + ((x_begin - x) + (int64_t)width * (j - y)), sizeof(uint32_t) * (x_end - x_begin));
+  }
+
+  add_damage(painter, x_begin, y_begin, x_end, y_end);
+}
+
+void gfx_copy_area(gfx_painter_t* painter,
+                   int32_t src_x,
+                   int32_t src_y,
+                   int32_t width,
+                   int32_t height,
+                   int32_t dst_x,
+                   int32_t dst_y) {
+  // The destination, clipped so that its source is inside the buffer.
+  const gfx_box_t* clipping = &painter->clipping;
+  const int64_t offset_x = (int64_t)dst_x - src_x;
+  const int64_t offset_y = (int64_t)dst_y - src_y;
+  const int64_t x_begin = max_i64(max_i64(dst_x, clipping->x_min), offset_x);
+  const int64_t y_begin = max_i64(max_i64(dst_y, clipping->y_min), offset_y);
+  const int64_t x_end =
+      min_i64(min_i64((int64_t)dst_x + width, (int64_t)clipping->x_max + 1), offset_x + painter->width);
+  const int64_t y_end =
+      min_i64(min_i64((int64_t)dst_y + height, (int64_t)clipping->y_max + 1), offset_y + painter->height);
+  if (x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  // When moving down, the rows are copied from the bottom so that the source rows are read before being
+  // overwritten. In a row, memmove() handles the overlap.
+  const size_t row_byte_size = sizeof(uint32_t) * (x_end - x_begin);
+  const int64_t first_row = offset_y > 0 ? y_end - 1 : y_begin;
+  const int64_t row_step = offset_y > 0 ? -1 : 1;
+  for (int64_t j = first_row; j >= y_begin && j < y_end; j += row_step) {
+    memmove(painter->pixels + (x_begin + (int64_t)painter->pitch * j),
+            painter->pixels + ((x_begin - offset_x) + (int64_t)painter->pitch * (j - offset_y)), row_byte_size);
+  }
+
+  add_damage(painter, x_begin, y_begin, x_end, y_end);
+}
+
+void gfx_add_damage(gfx_painter_t* painter, int32_t x, int32_t y, int32_t width, int32_t height) {
+  const int64_t x_begin = max_i64(x, 0);
+  const int64_t y_begin = max_i64(y, 0);
+  const int64_t x_end = min_i64((int64_t)x + width, painter->width);
+  const int64_t y_end = min_i64((int64_t)y + height, painter->height);
+  if (x_begin < x_end && y_begin < y_end)
+    add_damage(painter, x_begin, y_begin, x_end, y_end);
+}
+
+sys_error_t gfx_present(gfx_painter_t* painter, sys_window_t* window) {
+  const gfx_box_t damage = painter->damage;
+  if (damage.x_min > damage.x_max || damage.y_min > damage.y_max)
+    return SYS_ERR_OK;  // nothing was drawn
+
+  clear_damage(painter);
+  return sys_window_present_rect(window, damage.x_min, damage.y_min, damage.x_max - damage.x_min + 1,
+                                 damage.y_max - damage.y_min + 1);
+}
@@ -0,0 +1,123 @@
+#include "span.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+
+// The RGB channels of a color spread into 16-bits lanes (blue in the lowest one), so the three of them
+// are blended by the same 64-bits operations. A lane holds up to 255 * 255 without carrying into the next one.
+#define RGB_LANES_MASK 0x000000ff00ff00ffull
+#define RGB_LANES_ONE 0x0000000100010001ull
+
+static inline uint64_t spread_rgb(uint32_t argb) {
+  return (argb & 0xff) | ((argb & 0xff00) << 8) | ((uint64_t)(argb & 0xff0000) << 16);
+}
+
+static inline uint32_t pack_rgb(uint64_t lanes) {
+  return (lanes & 0xff) | ((lanes >> 8) & 0xff00) | ((lanes >> 16) & 0xff0000);
+}
+
+static inline uint32_t blend_rgb(uint64_t src_lanes, uint32_t dst, uint32_t alpha) {
+  const uint64_t lanes = src_lanes * alpha + spread_rgb(dst) * (255 - alpha);
+  // Exact division by 255 of each lane: x / 255 == (x + 1 + (x >> 8)) >> 8 for x < 2^16.
+  const uint64_t quotients = (lanes + ((lanes >> 8) & RGB_LANES_MASK) + RGB_LANES_ONE) >> 8;
+  return pack_rgb(quotients & RGB_LANES_MASK);
+}
+
+#if defined(__ARM_NEON)
+/** Blends 4 pixels, @a alphas has the alpha of each pixel in its 4 bytes. The same division as blend_rgb(), the
+ * 16-bits products of 8 channels per register. */
+static inline uint32x4_t blend_4_pixels(uint8x16_t src, uint8x16_t dst, uint8x16_t alphas) {
+  const uint8x16_t inverse_alphas = vmvnq_u8(alphas);  // 255 - alpha
+  uint16x8_t low = vmull_u8(vget_low_u8(src), vget_low_u8(alphas));
+  low = vmlal_u8(low, vget_low_u8(dst), vget_low_u8(inverse_alphas));
+  uint16x8_t high = vmull_high_u8(src, alphas);
+  high = vmlal_high_u8(high, dst, inverse_alphas);
+
+  // (x + (x >> 8) + 1) >> 8, the last shift narrows back to bytes.
+  low = vsraq_n_u16(low, low, 8);
+  high = vsraq_n_u16(high, high, 8);
+  const uint16x8_t one = vdupq_n_u16(1);
+  const uint8x16_t result = vaddhn_high_u16(vaddhn_u16(low, one), high, one);
+  return vandq_u32(vreinterpretq_u32_u8(result), vdupq_n_u32(0x00ffffff));
+}
+#endif  // __ARM_NEON
+
+void __gfx_fill_span(uint32_t* dst, uint32_t argb, size_t count) {
+  const uint32_t pixel = argb & 0x00ffffff;
+  size_t i = 0;
+
+#if defined(__ARM_NEON)
+  const uint32x4_t pixels = vdupq_n_u32(pixel);
+  for (; i + 8 <= count; i += 8) {
+    vst1q_u32(dst + i, pixels);
+    vst1q_u32(dst + i + 4, pixels);
+  }
+#endif  // __ARM_NEON
+
+  for (; i < count; ++i)
+    dst[i] = pixel;
+}
+
+void __gfx_blend_span(uint32_t* dst, uint32_t argb, uint32_t alpha, size_t count) {
+  size_t i = 0;
+
+#if defined(__ARM_NEON)
+  const uint8x16_t src = vreinterpretq_u8_u32(vdupq_n_u32(argb));
+  const uint8x16_t alphas = vdupq_n_u8((uint8_t)alpha);
+  for (; i + 4 <= count; i += 4)
+    vst1q_u32(dst + i, blend_4_pixels(src, vreinterpretq_u8_u32(vld1q_u32(dst + i)), alphas));
+#endif  // __ARM_NEON
+
+  const uint64_t src_lanes = spread_rgb(argb);
+  for (; i < count; ++i)
+    dst[i] = blend_rgb(src_lanes, dst[i], alpha);
+}
+
+void __gfx_blend_mask_span(uint32_t* dst, uint32_t argb, const uint8_t* alphas, size_t count) {
+  const uint32_t opaque_pixel = argb & 0x00ffffff;  // the blending result for an alpha of 255
+  size_t i = 0;
+
+#if defined(__ARM_NEON)
+  // 8 pixels at once: the glyph rows are mostly transparent or opaque runs, skipped or stored as is. The alphas
+  // are loaded by bytes (the unaligned accesses are forbidden), then each one is repeated into the 4 bytes of its
+  // pixel.
+  static const uint8_t LOW_INDICES[16] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+  static const uint8_t HIGH_INDICES[16] = {4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7};
+  const uint8x16_t low_indices = vld1q_u8(LOW_INDICES);
+  const uint8x16_t high_indices = vld1q_u8(HIGH_INDICES);
+  const uint8x16_t src = vreinterpretq_u8_u32(vdupq_n_u32(argb));
+  const uint32x4_t opaque_pixels = vdupq_n_u32(opaque_pixel);
+
+  for (; i + 8 <= count; i += 8) {
+    const uint8x8_t alphas_8 = vld1_u8(alphas + i);
+    const uint64_t alphas_word = vget_lane_u64(vreinterpret_u64_u8(alphas_8), 0);
+    if (alphas_word == 0)
+      continue;
+
+    if (alphas_word == UINT64_MAX) {
+      vst1q_u32(dst + i, opaque_pixels);
+      vst1q_u32(dst + i + 4, opaque_pixels);
+      continue;
+    }
+
+    const uint8x16_t table = vcombine_u8(alphas_8, alphas_8);
+    const uint8x16_t dst_low = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+    const uint8x16_t dst_high = vreinterpretq_u8_u32(vld1q_u32(dst + i + 4));
+    vst1q_u32(dst + i, blend_4_pixels(src, dst_low, vqtbl1q_u8(table, low_indices)));
+    vst1q_u32(dst + i + 4, blend_4_pixels(src, dst_high, vqtbl1q_u8(table, high_indices)));
+  }
+#endif  // __ARM_NEON
+
+  const uint64_t src_lanes = spread_rgb(argb);
+  for (; i < count; ++i) {
+    const uint32_t alpha = alphas[i];
+    if (alpha == 0)
+      continue;
+
+    if (alpha == 0xff)
+      dst[i] = opaque_pixel;
+    else
+      dst[i] = blend_rgb(src_lanes, dst[i], alpha);
+  }
+}
@@ -0,0 +1,21 @@
+#ifndef __PIKAOS_LIBGFX_SPAN_H__
+#define __PIKAOS_LIBGFX_SPAN_H__
+
+/*
+ * The horizontal span kernels of the painter, the only loops over the pixels. They are vectorized with NEON when
+ * available (the library is built without -mgeneral-regs-only), and otherwise blend the three channels of a pixel
+ * in 16-bits lanes of a 64-bits word, as the kernel painter. Both give the same pixels as the kernel painter:
+ * dst = (alpha * src + (255 - alpha) * dst) / 255 per channel, exactly rounded down, with a 0 alpha byte.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Sets the @a count pixels at @a dst to the RGB of @a argb. */
+void __gfx_fill_span(uint32_t* dst, uint32_t argb, size_t count);
+/** Blends the RGB of @a argb over the @a count pixels at @a dst, with the same @a alpha (in [1, 254]). */
+void __gfx_blend_span(uint32_t* dst, uint32_t argb, uint32_t alpha, size_t count);
+/** Blends the RGB of @a argb over the @a count pixels at @a dst, with the alphas of @a alphas (a glyph row). */
+void __gfx_blend_mask_span(uint32_t* dst, uint32_t argb, const uint8_t* alphas, size_t count);
+
+#endif  // !__PIKAOS_LIBGFX_SPAN_H__
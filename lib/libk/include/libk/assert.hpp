@@ -4,6 +4,11 @@
 
 namespace libk {
 [[noreturn]] void panic(const char* message, std::source_location source_location = std::source_location::current());
+
+/** Called by panic() after the panic message is printed, e.g. to print the stack trace. */
+using PanicHook = void (*)();
+/** Sets the hook called by panic(), and returns the previous one: the new hook may call it too. */
+PanicHook set_panic_hook(PanicHook hook);
 }  // namespace libk
 
 #ifndef KASSERT
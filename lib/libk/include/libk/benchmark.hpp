@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "libk/test.hpp"
+
+/**
+ * Microbenchmarks, registered as the tests of libk/test.hpp and only built with BUILD_BENCHMARKS:
+ * ```c++
+ * BENCHMARK("libk.memcpy.4096") {
+ *   while (state.keep_running())
+ *     libk::memcpy(dst, src, 4096);
+ * }
+ * ```
+ * Each iteration is timed alone with the PMU cycle counter and the generic timer, after some warmup
+ * iterations. See kbench::run_benchmarks() for the output.
+ */
+namespace kbench {
+class State {
+ public:
+  /** Maximum count of timed iterations of a benchmark. */
+  static constexpr size_t MAX_ITERATIONS = 1024;
+
+#ifdef BUILD_BENCHMARKS
+  /** Forgets the previous samples, to run @a warmup_iterations untimed iterations then @a iterations timed ones. */
+  void reset(size_t warmup_iterations, size_t iterations);
+
+  /** Times the previous iteration, and returns true while another one must be run. */
+  [[nodiscard]] bool keep_running();
+
+  [[nodiscard]] size_t get_iterations_count() const { return m_sample_count; }
+  [[nodiscard]] uint64_t* get_cycles_samples() { return m_cycles; }
+  [[nodiscard]] uint64_t* get_ticks_samples() { return m_ticks; }
+
+ private:
+  size_t m_warmup_iterations = 0;
+  size_t m_iterations = 0;
+  size_t m_started_count = 0;
+  size_t m_sample_count = 0;
+  uint64_t m_last_cycles = 0;
+  uint64_t m_last_ticks = 0;
+  uint64_t m_cycles[MAX_ITERATIONS];
+  uint64_t m_ticks[MAX_ITERATIONS];
+#else
+  [[nodiscard]] bool keep_running() { return false; }
+#endif  // BUILD_BENCHMARKS
+};  // class State
+
+#ifdef BUILD_BENCHMARKS
+class Benchmark {
+ public:
+  Benchmark(const char* name, size_t iterations);
+
+  void run();
+
+ protected:
+  virtual void do_run(State& state) = 0;
+
+ private:
+  const char* m_name;
+  size_t m_iterations;
+};  // class Benchmark
+
+/**
+ * Runs all the registered benchmarks, and writes one line per benchmark to the logs, a tag then a JSON object:
+ * ```
+ * BENCH {"name": "libk.memcpy.4096", "iterations": 1000, "cycles_min": ..., "cycles_median": ..., ...}
+ * ```
+ * The lines are surrounded by `BENCH_BEGIN {"tick_frequency": <Hz>, "count": <benchmarks>}` and `BENCH_END {}`,
+ * see tools/run-benchmarks.py. Must be called from a kernel task (some benchmarks yield or run system calls),
+ * without holding the kernel lock.
+ */
+void run_benchmarks();
+}  // namespace kbench
+
+#define BENCHMARK_ITERATIONS(name, iterations)                                                               \
+  class _KUNIQUEID(_KBenchmark) : public ::kbench::Benchmark {                                               \
+   public:                                                                                                   \
+    using Benchmark::Benchmark;                                                                              \
+                                                                                                             \
+   private:                                                                                                  \
+    void do_run(::kbench::State& state) override;                                                            \
+  };                                                                                                         \
+  static _KUNIQUEID(_KBenchmark) _KUNIQUEID(__kbench_instance_) = _KUNIQUEID(_KBenchmark)(name, iterations); \
+  void _KUNIQUEID(_KBenchmark)::do_run([[maybe_unused]] ::kbench::State& state)
+#else
+static inline void run_benchmarks() {}
+}  // namespace kbench
+
+#define BENCHMARK_ITERATIONS(name, iterations) \
+  void _KUNIQUEID(__kbench_unused_)([[maybe_unused]] ::kbench::State& state)
+#endif  // BUILD_BENCHMARKS
+
+#define BENCHMARK(name) BENCHMARK_ITERATIONS(name, 1000)
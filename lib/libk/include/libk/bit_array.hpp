@@ -6,6 +6,9 @@ namespace libk {
 
 class BitArray {
  public:
+  /** Returned by the find functions when there is no such bit. */
+  static constexpr size_t NOT_FOUND = SIZE_MAX;
+
   // Constructors
   explicit BitArray() = default;
   explicit BitArray(uintptr_t begin, size_t bytes_size);
@@ -18,7 +21,24 @@ class BitArray {
 
   void fill_array(bool value);
 
+  /** Sets the bits from @a begin to @a end (excluded). */
+  void set_range(size_t begin, size_t end) { fill_range(begin, end, true); }
+  /** Clears the bits from @a begin to @a end (excluded). */
+  void clear_range(size_t begin, size_t end) { fill_range(begin, end, false); }
+
+  /** Returns the index of the first set bit at or after @a start, or NOT_FOUND. */
+  [[nodiscard]] size_t find_first_set(size_t start = 0) const { return find_first(true, start); }
+  /** Returns the index of the first clear bit at or after @a start, or NOT_FOUND. */
+  [[nodiscard]] size_t find_first_clear(size_t start = 0) const { return find_first(false, start); }
+  /** Returns the index of the first run of @a count clear bits at or after @a start, or NOT_FOUND. */
+  [[nodiscard]] size_t find_run(size_t count, size_t start = 0) const;
+
+  [[nodiscard]] size_t get_bit_count() const { return m_bytes_size * 8; }
+
  private:
+  void fill_range(size_t begin, size_t end, bool value);
+  [[nodiscard]] size_t find_first(bool value, size_t start) const;
+
   uint64_t* m_array;
   size_t m_bytes_size;
 };
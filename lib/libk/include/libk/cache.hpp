@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libk {
+/*
+ * Data cache maintenance by virtual address range, for the memory shared with devices (DMA, VideoCore).
+ * The operations cover every cache line overlapping [@a ptr, @a ptr + @a byte_size[ and complete
+ * (with a DSB) before returning. They are only allowed at EL1 (SCTLR_EL1.UCI is cleared).
+ *
+ * Without CONFIG_USE_DATA_CACHE, the data cache is disabled and the memory is always coherent with
+ * the devices: the functions do nothing.
+ */
+
+#ifdef CONFIG_USE_DATA_CACHE
+/** Returns the smallest data cache line size, in bytes (from CTR_EL0.DminLine). */
+[[nodiscard]] size_t get_dcache_line_size();
+
+/** Writes back the dirty cache lines to memory (`dc cvac`), before a device reads the range. */
+void clean_dcache_range(const void* ptr, size_t byte_size);
+
+/** Discards the cache lines (`dc ivac`), so the CPU reads what a device wrote in the range.
+ * The lines partially covered by the range are cleaned first, as their other bytes may be dirty. */
+void invalidate_dcache_range(const void* ptr, size_t byte_size);
+
+/** Writes back then discards the cache lines (`dc civac`), for a range both read and written by a device. */
+void clean_invalidate_dcache_range(const void* ptr, size_t byte_size);
+#else
+static inline void clean_dcache_range(const void*, size_t) {}
+static inline void invalidate_dcache_range(const void*, size_t) {}
+static inline void clean_invalidate_dcache_range(const void*, size_t) {}
+#endif  // CONFIG_USE_DATA_CACHE
+}  // namespace libk
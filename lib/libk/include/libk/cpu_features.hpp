@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libk {
+/**
+ * The cache topology of the CPU, and the tuning parameters of the optimized kernel code derived from it, so the
+ * same binary suits both the Cortex-A53 (Pi 3, 512 KiB of L2) and the Cortex-A72 (Pi 4, 1 MiB of L2).
+ *
+ * The topology is read from CTR_EL0, CLIDR_EL1, CCSIDR_EL1 and DCZID_EL0 by probe_cpu_features(), called once
+ * at boot on the boot core (the cores are all the same). Until then, the parameters have conservative defaults.
+ */
+struct CpuFeatures {
+  /** The smallest data and instruction cache line sizes, in bytes (CTR_EL0). */
+  size_t dcache_line_size = 64;
+  size_t icache_line_size = 64;
+  /** The byte sizes of the level 1 data cache and of the level 2 cache, 0 if there is none. */
+  size_t l1d_size = 0;
+  size_t l2_size = 0;
+  /** The byte size of the blocks zeroed by DC ZVA, 0 if it is prohibited. */
+  size_t dc_zva_block_size = 0;
+
+  /** Copies and fills of at least this byte length are given to the large copy engine (DMA), if any, see
+   * memcpy_large(). Below, the CPU copy from and to the cache is faster than the DMA setup. */
+  size_t large_copy_threshold = 1024;
+};  // struct CpuFeatures
+
+/** Gets the features probed at boot (the defaults before probe_cpu_features()). */
+[[nodiscard]] const CpuFeatures& get_cpu_features();
+
+/** Reads the cache topology of the calling core and derives the tuning parameters. Must be called at EL1. */
+void probe_cpu_features();
+}  // namespace libk
@@ -2,6 +2,8 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
+#include <utility>
 #include "libk/string_view.hpp"
 
 namespace libk {
@@ -59,9 +61,189 @@ struct Argument {
   }
 };  // struct Argument
 
+/** A piece of a format string precompiled by FormatString: either a literal text or a replacement field. */
+struct FormatSegment {
+  static constexpr uint8_t LITERAL = UINT8_MAX;
+
+  /** The offset in the format string of the literal text, or of the field spec (after the ':' or at the '}'). */
+  uint16_t offset;
+  /** The length of the literal text. */
+  uint8_t length;
+  /** The index of the formatted argument, or LITERAL. */
+  uint8_t argument_index;
+};  // struct FormatSegment
+
 char* format_to(char* out, const char* fmt, const Argument* args, size_t args_count);
+/** Same as above, but without parsing @a fmt (unless @a segments is nullptr), see FormatString. */
+char* format_to(char* out,
+                const char* fmt,
+                const FormatSegment* segments,
+                size_t segments_count,
+                const Argument* args,
+                size_t args_count);
+
+// Only used in unevaluated contexts, to get the Argument::Type of a C++ type (the same overloads as the
+// Argument constructors, so the same conversions apply).
+template <Argument::Type TYPE>
+using ArgumentTypeTag = std::integral_constant<Argument::Type, TYPE>;
+ArgumentTypeTag<Argument::Type::BOOL> get_argument_type_tag(bool);
+ArgumentTypeTag<Argument::Type::CHAR> get_argument_type_tag(char);
+ArgumentTypeTag<Argument::Type::INTMAX> get_argument_type_tag(int8_t);
+ArgumentTypeTag<Argument::Type::INTMAX> get_argument_type_tag(int16_t);
+ArgumentTypeTag<Argument::Type::INTMAX> get_argument_type_tag(int32_t);
+ArgumentTypeTag<Argument::Type::INTMAX> get_argument_type_tag(int64_t);
+ArgumentTypeTag<Argument::Type::UINTMAX> get_argument_type_tag(uint8_t);
+ArgumentTypeTag<Argument::Type::UINTMAX> get_argument_type_tag(uint16_t);
+ArgumentTypeTag<Argument::Type::UINTMAX> get_argument_type_tag(uint32_t);
+ArgumentTypeTag<Argument::Type::UINTMAX> get_argument_type_tag(uint64_t);
+ArgumentTypeTag<Argument::Type::POINTER> get_argument_type_tag(const void*);
+ArgumentTypeTag<Argument::Type::STRING> get_argument_type_tag(const char*);
+ArgumentTypeTag<Argument::Type::STRING> get_argument_type_tag(StringView);
+
+template <class T>
+inline constexpr Argument::Type ARGUMENT_TYPE_OF = decltype(get_argument_type_tag(std::declval<const T&>()))::value;
+
+// Not constexpr: calling them while parsing a format string at compile time makes the compilation fail,
+// and their name appears in the error.
+void format_string_error_argument_index_out_of_range();
+void format_string_error_invalid_spec_for_argument_type();
+
+/** Checks at compile time the spec starting at @a spec (and ending at '}') for an argument of type @a type. */
+consteval void check_spec(const char* spec, Argument::Type type) {
+  switch (type) {
+    case Argument::Type::BOOL:
+      if (*spec == '}')
+        return;
+      [[fallthrough]];
+    case Argument::Type::INTMAX:
+    case Argument::Type::UINTMAX:
+      // [sign][#][type], see parse_integer_spec().
+      if (*spec == '+' || *spec == '-' || *spec == ' ')
+        ++spec;
+      if (*spec == '#')
+        ++spec;
+      if (*spec == 'b' || *spec == 'B' || *spec == 'd' || *spec == 'o' || *spec == 'x' || *spec == 'X')
+        ++spec;
+      if (*spec != '}')
+        format_string_error_invalid_spec_for_argument_type();
+      return;
+    case Argument::Type::CHAR:
+    case Argument::Type::STRING:
+      for (; *spec != '}'; ++spec) {
+        if (*spec != '$' && *spec != (type == Argument::Type::CHAR ? 'c' : 's'))
+          format_string_error_invalid_spec_for_argument_type();
+      }
+      return;
+    case Argument::Type::POINTER:
+      // The spec is ignored.
+      return;
+  }
+}
 }  // namespace detail
 
+/**
+ * A format string for the arguments of types @a Args, parsed at compile time.
+ *
+ * Using an argument index out of range, or a spec not supported by the argument type, is a compilation
+ * error. The format string is split into up to MAX_SEGMENTS literal texts and replacement fields, so
+ * formatting does not parse it again. Longer format strings are still checked, but parsed when formatted.
+ */
+template <class... Args>
+class FormatString {
+  static_assert(sizeof...(Args) < detail::FormatSegment::LITERAL, "too many arguments");
+
+ public:
+  static constexpr size_t MAX_SEGMENTS = 16;
+
+  consteval FormatString(const char* fmt) : m_format(fmt) {
+    // The extra element avoids an empty array without arguments.
+    constexpr detail::Argument::Type types[] = {detail::ARGUMENT_TYPE_OF<Args>..., detail::Argument::Type::BOOL};
+    constexpr size_t args_count = sizeof...(Args);
+
+    // The same grammar as the runtime parser (see format.re2c), where a lone brace is a literal.
+    size_t next_argument_index = 0;
+    size_t literal_start = 0;
+    size_t i = 0;
+    while (fmt[i] != '\0') {
+      if ((fmt[i] == '{' && fmt[i + 1] == '{') || (fmt[i] == '}' && fmt[i + 1] == '}')) {
+        add_literal(literal_start, i + 1);  // keep a single brace
+        i += 2;
+        literal_start = i;
+        continue;
+      }
+
+      if (fmt[i] != '{') {
+        ++i;
+        continue;
+      }
+
+      size_t end = i + 1;
+      bool has_index = false;
+      size_t index = 0;
+      for (; fmt[end] >= '0' && fmt[end] <= '9'; ++end) {
+        has_index = true;
+        index = index * 10 + (fmt[end] - '0');
+      }
+
+      size_t spec = end;
+      if (fmt[end] == ':') {
+        spec = ++end;
+        while (fmt[end] != '\0' && fmt[end] != '}') {
+          ++end;
+        }
+      }
+
+      if (fmt[end] != '}') {
+        ++i;  // not a replacement field
+        continue;
+      }
+
+      if (!has_index)
+        index = next_argument_index++;
+      if (index >= args_count)
+        detail::format_string_error_argument_index_out_of_range();
+      detail::check_spec(fmt + spec, types[index]);
+
+      add_literal(literal_start, i);
+      add_segment(spec, 0, index);
+      i = end + 1;
+      literal_start = i;
+    }
+
+    add_literal(literal_start, i);
+  }
+
+  [[nodiscard]] const char* get_format() const { return m_format; }
+  /** Returns nullptr if the format string did not fit in the precompiled segments. */
+  [[nodiscard]] const detail::FormatSegment* get_segments() const {
+    return m_is_precompiled ? m_segments : nullptr;
+  }
+  [[nodiscard]] size_t get_segments_count() const { return m_segments_count; }
+
+ private:
+  consteval void add_literal(size_t start, size_t end) {
+    while (start < end) {
+      const size_t length = (end - start) < UINT8_MAX ? (end - start) : UINT8_MAX;
+      add_segment(start, length, detail::FormatSegment::LITERAL);
+      start += length;
+    }
+  }
+
+  consteval void add_segment(size_t offset, size_t length, size_t argument_index) {
+    if (m_segments_count == MAX_SEGMENTS || offset > UINT16_MAX) {
+      m_is_precompiled = false;
+      return;
+    }
+
+    m_segments[m_segments_count++] = {(uint16_t)offset, (uint8_t)length, (uint8_t)argument_index};
+  }
+
+  const char* m_format;
+  detail::FormatSegment m_segments[MAX_SEGMENTS] = {};
+  uint8_t m_segments_count = 0;
+  bool m_is_precompiled = true;
+};  // class FormatString
+
 /**
  * Formats @a args according to specifications in @a fmt, writes the result to
  * the output iterator @a out and returns the iterator past the end of the
@@ -81,8 +263,9 @@ char* format_to(char* out, const char* fmt, const Argument* args, size_t args_co
  * ```
  */
 template <typename... T>
-char* format_to(char* out, const char* fmt, const T&... args) {
+char* format_to(char* out, FormatString<std::type_identity_t<T>...> fmt, const T&... args) {
   detail::Argument args_array[] = {args...};
-  return detail::format_to(out, fmt, args_array, sizeof...(T));
+  return detail::format_to(out, fmt.get_format(), fmt.get_segments(), fmt.get_segments_count(), args_array,
+                           sizeof...(T));
 }
 }  // namespace libk
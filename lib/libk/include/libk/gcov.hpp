@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A freestanding runtime for the GCC arc counters (-fprofile-arcs), as libgcov without a file system: the profile
+ * information of each instrumented object file is serialized in the .gcda format, to be written on the host and
+ * read back by -fprofile-use (or gcov).
+ *
+ * The objects must be compiled with -fprofile-info-section (GCC 12 or later): GCC then puts a pointer to their Info
+ * into the .gcov_info section instead of registering it with a constructor, and the linker script gathers them.
+ * Only the arc counters are supported (no -fprofile-values), updated atomically with -fprofile-update=atomic.
+ */
+namespace libk::gcov {
+/** The count of counter kinds of GCC (gcov-counter.def), the conditions are counted since GCC 14. */
+#if __GNUC__ >= 14
+static constexpr size_t COUNTER_KINDS = 9;
+#else
+static constexpr size_t COUNTER_KINDS = 8;
+#endif  // __GNUC__ >= 14
+
+struct Info;
+
+/** The counters of a kind of a function. */
+struct CounterInfo {
+  uint32_t count;
+  int64_t* values;
+};  // struct CounterInfo
+
+struct FunctionInfo {
+  /** The object file the function is counted by, a COMDAT function (inlines...) being in several ones. */
+  const Info* key;
+  uint32_t ident;
+  uint32_t lineno_checksum;
+  uint32_t cfg_checksum;
+  /** One per counter kind used by the object file (see Info::merge). */
+  CounterInfo counters[];
+};  // struct FunctionInfo
+
+/** The profile information of an object file, as laid out by GCC 12 and later (struct gcov_info of libgcov). */
+struct Info {
+  uint32_t version;
+  Info* next;
+  uint32_t stamp;
+  uint32_t checksum;
+  /** The path of the .gcda file, from -fprofile-dir and the path of the object file. */
+  const char* filename;
+  /** Not null for the counter kinds used by the object file. */
+  void (*merge[COUNTER_KINDS])(int64_t* values, uint32_t count);
+  uint32_t function_count;
+  const FunctionInfo* const* functions;
+};  // struct Info
+
+/** Called by write_gcda() with each part of the .gcda file, in order. */
+using Writer = void (*)(const void* data, size_t byte_size, void* arg);
+
+/** Serializes the counters of @a info in the .gcda format, given to @a writer (with @a arg). Does not allocate, so
+ * it can be called at panic time. The counters may be updated meanwhile. */
+void write_gcda(const Info& info, Writer writer, void* arg);
+/** Returns the byte size of the .gcda file written by write_gcda(). */
+[[nodiscard]] size_t get_gcda_size(const Info& info);
+
+/** Clears the counters of @a info. */
+void reset(const Info& info);
+}  // namespace libk::gcov
+
+/** The merge function of the arc counters referenced by the Info of the instrumented objects, only called by the
+ * host tools merging .gcda files. */
+extern "C" void __gcov_merge_add(int64_t* values, uint32_t count);
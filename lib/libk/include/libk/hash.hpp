@@ -22,8 +22,8 @@ template<std::integral T>
 }
 
 template<class T>
-[[nodiscard]] constexpr inline uint64_t hash(const T *x) {
-  return hash(static_cast<uintptr_t>(x));
+[[nodiscard]] inline uint64_t hash(const T *x) {
+  return hash(reinterpret_cast<uintptr_t>(x));
 }
 
 [[nodiscard]] constexpr inline uint64_t hash(const uint8_t *data, size_t data_len) {
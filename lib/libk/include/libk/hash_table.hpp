@@ -1,14 +1,302 @@
 #pragma once
 
+#include <iterator>
+#include <new>
+#include <utility>
+#include "assert.hpp"
 #include "hash.hpp"
-#include "linked_list.hpp"
 
 namespace libk {
+/**
+ * A hash map from K to T, using open addressing with Robin Hood probing.
+ *
+ * The entries are stored inline in a single array of slots: a lookup reads a few consecutive slots
+ * instead of chasing list nodes. Each slot remembers how far it is from the slot of its hash, an
+ * insertion takes the slot of any entry closer to its own (so all probe sequences stay short), and a
+ * lookup stops as soon as it meets an entry closer than the probed distance. Removals shift the next
+ * entries back, so there are no tombstones.
+ *
+ * Keys are hashed with libk::hash() and compared with operator==.
+ */
 template <class K, class T>
 class HashTable {
  public:
+  struct Entry {
+    K key;
+    T value;
+  };  // struct Entry
+
  private:
-  size_t m_bucket_count;
-  libk::LinkedList<T>* m_buckets;
+  struct Slot {
+    // 0 if the slot is empty, otherwise 1 + the distance from the slot of the hash of the key.
+    uint32_t distance = 0;
+    alignas(Entry) unsigned char storage[sizeof(Entry)];
+
+    [[nodiscard]] Entry& get() { return *std::launder(reinterpret_cast<Entry*>(storage)); }
+    [[nodiscard]] const Entry& get() const { return *std::launder(reinterpret_cast<const Entry*>(storage)); }
+  };  // struct Slot
+
+ public:
+  /** The minimum capacity (a power of two) once an entry is inserted. */
+  static constexpr size_t MIN_CAPACITY = 8;
+
+  HashTable() = default;
+  ~HashTable() {
+    clear();
+    delete[] m_slots;
+  }
+
+  HashTable(HashTable&& other) { *this = std::move(other); }
+  HashTable& operator=(HashTable&& other) {
+    std::swap(m_slots, other.m_slots);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_size, other.m_size);
+    return *this;
+  }
+
+  // No copy
+  HashTable(const HashTable&) = delete;
+  HashTable& operator=(const HashTable&) = delete;
+
+  [[nodiscard]] bool is_empty() const { return m_size == 0; }
+  [[nodiscard]] size_t get_size() const { return m_size; }
+
+  /** Returns the value associated to @a key, or nullptr if there is none. */
+  [[nodiscard]] T* find(const K& key) {
+    Slot* slot = find_slot(key);
+    return slot != nullptr ? &slot->get().value : nullptr;
+  }
+
+  [[nodiscard]] const T* find(const K& key) const {
+    const Slot* slot = const_cast<HashTable*>(this)->find_slot(key);
+    return slot != nullptr ? &slot->get().value : nullptr;
+  }
+
+  [[nodiscard]] bool contains(const K& key) const { return find(key) != nullptr; }
+
+  /** Associates @a value to @a key. Returns false if @a key was already present (its value is replaced). */
+  bool insert(const K& key, const T& value) {
+    T* existing_value = find(key);
+    if (existing_value != nullptr) {
+      *existing_value = value;
+      return false;
+    }
+
+    // Keep the load factor below 3/4, the probe sequences then stay a few slots long.
+    if ((m_size + 1) * 4 > m_capacity * 3)
+      grow();
+
+    insert_new(Entry{key, value});
+    return true;
+  }
+
+  /** Removes the entry of @a key. Returns false if there was none. */
+  bool remove(const K& key) {
+    Slot* slot = find_slot(key);
+    if (slot == nullptr)
+      return false;
+
+    slot->get().~Entry();
+
+    // Shift back the following entries that are not in the slot of their hash.
+    size_t index = slot - m_slots;
+    size_t next_index = (index + 1) & (m_capacity - 1);
+    while (m_slots[next_index].distance > 1) {
+      new (m_slots[index].storage) Entry(std::move(m_slots[next_index].get()));
+      m_slots[index].distance = m_slots[next_index].distance - 1;
+      m_slots[next_index].get().~Entry();
+
+      index = next_index;
+      next_index = (index + 1) & (m_capacity - 1);
+    }
+
+    m_slots[index].distance = 0;
+    --m_size;
+    return true;
+  }
+
+  /** Removes all the entries (the memory is kept). */
+  void clear() {
+    for (size_t i = 0; i < m_capacity; ++i) {
+      if (m_slots[i].distance != 0) {
+        m_slots[i].get().~Entry();
+        m_slots[i].distance = 0;
+      }
+    }
+
+    m_size = 0;
+  }
+
+  template <bool CONST>
+  class BaseIterator {
+    using SlotType = std::conditional_t<CONST, const Slot, Slot>;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using element_type = std::conditional_t<CONST, const Entry, Entry>;
+    using difference_type = std::ptrdiff_t;
+
+    BaseIterator() = default;
+
+    element_type& operator*() const { return m_slot->get(); }
+    element_type* operator->() const { return &(m_slot->get()); }
+
+    BaseIterator& operator++() {
+      ++m_slot;
+      skip_empty_slots();
+      return *this;
+    }
+    BaseIterator operator++(int) {
+      auto old = *this;
+      ++(*this);
+      return old;
+    }
+
+    bool operator==(const BaseIterator& b) const { return m_slot == b.m_slot; }
+
+   private:
+    friend HashTable;
+    BaseIterator(SlotType* slot, SlotType* end) : m_slot(slot), m_end(end) { skip_empty_slots(); }
+
+    void skip_empty_slots() {
+      while (m_slot != m_end && m_slot->distance == 0)
+        ++m_slot;
+    }
+
+    SlotType* m_slot = nullptr;
+    SlotType* m_end = nullptr;
+  };  // class BaseIterator
+
+  using Iterator = BaseIterator<false>;
+  using ConstIterator = BaseIterator<true>;
+
+  // The iterators are invalidated by insert() and remove().
+  [[nodiscard]] Iterator begin() { return Iterator(m_slots, m_slots + m_capacity); }
+  [[nodiscard]] ConstIterator begin() const { return ConstIterator(m_slots, m_slots + m_capacity); }
+  [[nodiscard]] Iterator end() { return Iterator(m_slots + m_capacity, m_slots + m_capacity); }
+  [[nodiscard]] ConstIterator end() const { return ConstIterator(m_slots + m_capacity, m_slots + m_capacity); }
+
+ private:
+  [[nodiscard]] Slot* find_slot(const K& key) {
+    if (m_size == 0)
+      return nullptr;
+
+    size_t index = hash(key) & (m_capacity - 1);
+    for (uint32_t distance = 1;; ++distance) {
+      // The key would have taken this slot if it was present (includes the empty slots).
+      Slot& slot = m_slots[index];
+      if (slot.distance < distance)
+        return nullptr;
+
+      if (slot.get().key == key)
+        return &slot;
+
+      index = (index + 1) & (m_capacity - 1);
+    }
+  }
+
+  /** Inserts @a entry, whose key is not yet present. The capacity must be sufficient. */
+  void insert_new(Entry&& entry) {
+    size_t index = hash(entry.key) & (m_capacity - 1);
+    for (uint32_t distance = 1;; ++distance) {
+      Slot& slot = m_slots[index];
+      if (slot.distance == 0) {
+        new (slot.storage) Entry(std::move(entry));
+        slot.distance = distance;
+        ++m_size;
+        return;
+      }
+
+      // Take the slot of entries closer to their own slot, and continue with them.
+      if (slot.distance < distance) {
+        std::swap(entry, slot.get());
+        std::swap(distance, slot.distance);
+      }
+
+      index = (index + 1) & (m_capacity - 1);
+    }
+  }
+
+  void grow() {
+    const size_t old_capacity = m_capacity;
+    Slot* old_slots = m_slots;
+
+    m_capacity = old_capacity == 0 ? MIN_CAPACITY : old_capacity * 2;
+    m_slots = new Slot[m_capacity];
+    KASSERT(m_slots != nullptr);
+    m_size = 0;
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (old_slots[i].distance != 0) {
+        insert_new(std::move(old_slots[i].get()));
+        old_slots[i].get().~Entry();
+      }
+    }
+
+    delete[] old_slots;
+  }
+
+  Slot* m_slots = nullptr;
+  size_t m_capacity = 0;  // always a power of two (or 0)
+  size_t m_size = 0;
 };  // class HashTable
+
+/** A set of K, see HashTable. */
+template <class K>
+class HashSet {
+  struct Empty {};
+  using Table = HashTable<K, Empty>;
+
+ public:
+  [[nodiscard]] bool is_empty() const { return m_table.is_empty(); }
+  [[nodiscard]] size_t get_size() const { return m_table.get_size(); }
+
+  [[nodiscard]] bool contains(const K& key) const { return m_table.contains(key); }
+
+  /** Returns false if @a key was already present. */
+  bool insert(const K& key) { return m_table.insert(key, {}); }
+  /** Returns false if @a key was not present. */
+  bool remove(const K& key) { return m_table.remove(key); }
+  void clear() { m_table.clear(); }
+
+  class ConstIterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using element_type = const K;
+    using difference_type = std::ptrdiff_t;
+
+    ConstIterator() = default;
+
+    element_type& operator*() const { return m_it->key; }
+    element_type* operator->() const { return &(m_it->key); }
+
+    ConstIterator& operator++() {
+      ++m_it;
+      return *this;
+    }
+    ConstIterator operator++(int) {
+      auto old = *this;
+      ++(*this);
+      return old;
+    }
+
+    bool operator==(const ConstIterator& b) const { return m_it == b.m_it; }
+
+   private:
+    friend HashSet;
+    explicit ConstIterator(typename Table::ConstIterator it) : m_it(it) {}
+
+    typename Table::ConstIterator m_it;
+  };  // class ConstIterator
+
+  // The iterators are invalidated by insert() and remove().
+  [[nodiscard]] ConstIterator begin() const { return ConstIterator(m_table.begin()); }
+  [[nodiscard]] ConstIterator end() const { return ConstIterator(m_table.end()); }
+
+ private:
+  Table m_table;
+};  // class HashSet
 }  // namespace libk
+
+static_assert(std::forward_iterator<libk::HashTable<int, int>::Iterator>);
+static_assert(std::forward_iterator<libk::HashSet<int>::ConstIterator>);
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include "assert.hpp"
+
+namespace libk {
+/** The links to embed into an object so it can be stored into an IntrusiveList. */
+struct IntrusiveListHook {
+  IntrusiveListHook* next = nullptr;
+  IntrusiveListHook* previous = nullptr;
+  bool linked = false;
+
+  /** Checks if the object is currently stored in a list. */
+  [[nodiscard]] bool is_linked() const { return linked; }
+};  // struct IntrusiveListHook
+
+/**
+ * A doubly linked list whose links are stored inside the objects themselves (see IntrusiveListHook).
+ *
+ * The list never allocates memory and does not own the stored objects, so they must outlive
+ * their membership to the list. An object can be in at most one list per hook.
+ */
+template <class T, IntrusiveListHook T::*Hook>
+class IntrusiveList {
+ public:
+  [[nodiscard]] bool is_empty() const { return m_head == nullptr; }
+
+  [[nodiscard]] T* front() const { return m_head != nullptr ? from_hook(m_head) : nullptr; }
+  [[nodiscard]] T* back() const { return m_tail != nullptr ? from_hook(m_tail) : nullptr; }
+
+  void push_back(T* item) {
+    IntrusiveListHook* hook = &(item->*Hook);
+    KASSERT(!hook->is_linked());
+
+    hook->linked = true;
+    hook->next = nullptr;
+    hook->previous = m_tail;
+    if (m_tail == nullptr) {
+      m_head = hook;
+    } else {
+      m_tail->next = hook;
+    }
+
+    m_tail = hook;
+  }
+
+  void push_front(T* item) {
+    IntrusiveListHook* hook = &(item->*Hook);
+    KASSERT(!hook->is_linked());
+
+    hook->linked = true;
+    hook->previous = nullptr;
+    hook->next = m_head;
+    if (m_head == nullptr) {
+      m_tail = hook;
+    } else {
+      m_head->previous = hook;
+    }
+
+    m_head = hook;
+  }
+
+  /** Inserts @a item after @a position (stored in this list), or at the front if @a position is nullptr. */
+  void insert_after(T* position, T* item) {
+    if (position == nullptr) {
+      push_front(item);
+      return;
+    }
+
+    IntrusiveListHook* position_hook = &(position->*Hook);
+    KASSERT(position_hook->is_linked());
+    if (position_hook->next == nullptr) {
+      push_back(item);
+      return;
+    }
+
+    IntrusiveListHook* hook = &(item->*Hook);
+    KASSERT(!hook->is_linked());
+
+    hook->linked = true;
+    hook->previous = position_hook;
+    hook->next = position_hook->next;
+    position_hook->next->previous = hook;
+    position_hook->next = hook;
+  }
+
+  /** Removes @a item from the list. It must be stored in this list. */
+  void remove(T* item) {
+    IntrusiveListHook* hook = &(item->*Hook);
+    KASSERT(hook->is_linked());
+
+    if (hook->previous == nullptr) {
+      m_head = hook->next;
+    } else {
+      hook->previous->next = hook->next;
+    }
+
+    if (hook->next == nullptr) {
+      m_tail = hook->previous;
+    } else {
+      hook->next->previous = hook->previous;
+    }
+
+    hook->next = nullptr;
+    hook->previous = nullptr;
+    hook->linked = false;
+  }
+
+  /** Gets the item following @a item (stored in this list), or nullptr if it is the last one. */
+  [[nodiscard]] T* next(const T* item) const {
+    const IntrusiveListHook* hook = &(item->*Hook);
+    KASSERT(hook->is_linked());
+    return hook->next != nullptr ? from_hook(hook->next) : nullptr;
+  }
+
+  /** Gets the item preceding @a item (stored in this list), or nullptr if it is the first one. */
+  [[nodiscard]] T* previous(const T* item) const {
+    const IntrusiveListHook* hook = &(item->*Hook);
+    KASSERT(hook->is_linked());
+    return hook->previous != nullptr ? from_hook(hook->previous) : nullptr;
+  }
+
+  T* pop_front() {
+    KASSERT(!is_empty());
+    T* item = from_hook(m_head);
+    remove(item);
+    return item;
+  }
+
+  T* pop_back() {
+    KASSERT(!is_empty());
+    T* item = from_hook(m_tail);
+    remove(item);
+    return item;
+  }
+
+  /** Iterates over the items (as T*) from front to back. Removing the current item invalidates it. */
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using element_type = T*;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+
+    T* operator*() const { return from_hook(m_hook); }
+
+    Iterator& operator++() {
+      m_hook = m_hook->next;
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto old = *this;
+      ++(*this);
+      return old;
+    }
+
+    bool operator==(const Iterator& b) const { return m_hook == b.m_hook; }
+
+   private:
+    friend IntrusiveList;
+    explicit Iterator(IntrusiveListHook* hook) : m_hook(hook) {}
+
+    IntrusiveListHook* m_hook = nullptr;
+  };  // class Iterator
+
+  [[nodiscard]] Iterator begin() const { return Iterator(m_head); }
+  [[nodiscard]] Iterator end() const { return Iterator(nullptr); }
+
+ private:
+  [[nodiscard]] static T* from_hook(IntrusiveListHook* hook) {
+    const uintptr_t offset = (uintptr_t)&(((T*)nullptr)->*Hook);
+    return (T*)((uintptr_t)hook - offset);
+  }
+
+  IntrusiveListHook* m_head = nullptr;
+  IntrusiveListHook* m_tail = nullptr;
+};  // class IntrusiveList
+}  // namespace libk
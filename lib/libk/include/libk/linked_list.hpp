@@ -2,6 +2,7 @@
 
 #include <iterator>
 #include "assert.hpp"
+#include "object_cache.hpp"
 
 namespace libk {
 template <class T>
@@ -11,6 +12,19 @@ class LinkedList {
     T data;
     Node* next = nullptr;
     Node* previous = nullptr;
+
+    // Nodes are frequently allocated and freed, so they come from a cache shared by all lists of T.
+    static ObjectCache<Node>& get_cache() {
+      static ObjectCache<Node> cache;
+      return cache;
+    }
+
+    static void* operator new(size_t size) {
+      KASSERT(size == sizeof(Node));
+      return get_cache().allocate();
+    }
+
+    static void operator delete(void* ptr) { get_cache().deallocate(ptr); }
   };  // struct Node
 
   void insert_after(Node* node, Node* new_node) {
@@ -79,6 +93,16 @@ class LinkedList {
  public:
   [[nodiscard]] bool is_empty() const { return m_head == nullptr; }
 
+  [[nodiscard]] T& front() {
+    KASSERT(!is_empty());
+    return m_head->data;
+  }
+
+  [[nodiscard]] T& back() {
+    KASSERT(!is_empty());
+    return m_tail->data;
+  }
+
   void clear() {
     Node* node = m_head;
     while (node != nullptr) {
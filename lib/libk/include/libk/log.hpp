@@ -40,18 +40,60 @@ enum class LogLevel : uint8_t {
   return (uint8_t)lhs < (uint8_t)rhs;
 }
 
+/** A log message, before formatting. */
+struct LogMessage {
+  LogLevel level;
+  /** Emitted by libk::print(), without any header. */
+  bool is_print;
+  /** Is @a time_in_ms set? (only if a log timer is set, see set_log_timer()) */
+  bool has_time;
+  uint64_t time_in_ms;
+  const char* format;
+  /** The precompiled @a format (see FormatString), or nullptr. Only valid during the call to the log deferrer. */
+  const detail::FormatSegment* segments;
+  size_t segments_count;
+  const char* file_name;
+  uint32_t line;
+  const detail::Argument* args;
+  size_t args_count;
+};  // struct LogMessage
+
 namespace detail {
+/** Formats @a message and writes it to all the registered loggers. */
+void write_message(const LogMessage& message);
+
 void vlog(LogLevel level,
           const char* message,
+          const detail::FormatSegment* segments,
+          size_t segments_count,
           std::source_location source_location,
           const detail::Argument* args,
           size_t args_count);
 
-void vprint(const char* message, const detail::Argument* args, size_t args_count);
+void vprint(const char* message,
+            const detail::FormatSegment* segments,
+            size_t segments_count,
+            const detail::Argument* args,
+            size_t args_count);
 }  // namespace detail
 
 void register_logger(Logger& logger);
 
+/** Takes the ownership of a log message to format and write it later, see set_log_deferrer().
+ * Returns false if it must be written immediately instead. */
+using LogDeferrer = bool (*)(const LogMessage& message);
+/** Writes all the log messages taken by the log deferrer. */
+using LogFlusher = void (*)();
+
+/**
+ * Defers the formatting and the writing of the log messages (except the critical ones) to @a deferrer,
+ * so logging costs (almost) nothing to the caller. @a flusher is called before writing a critical
+ * message, so the messages are still written in order before the kernel panics.
+ */
+void set_log_deferrer(LogDeferrer deferrer, LogFlusher flusher);
+/** Writes the deferred log messages now, and stops deferring the next ones (before a kernel panic). */
+void flush_logs();
+
 using LogTimer = uint64_t (*)();
 void set_log_timer(LogTimer timer_in_ms);
 
@@ -59,15 +101,20 @@ void set_log_timer(LogTimer timer_in_ms);
  *
  * Prefer to use the LOG_*() macros. */
 template <class... Args>
-inline void log(LogLevel level, const char* message, std::source_location source_location, const Args&... args) {
+inline void log(LogLevel level,
+                FormatString<std::type_identity_t<Args>...> message,
+                std::source_location source_location,
+                const Args&... args) {
   detail::Argument args_array[] = {args...};
-  detail::vlog(level, message, source_location, args_array, sizeof...(Args));
+  detail::vlog(level, message.get_format(), message.get_segments(), message.get_segments_count(), source_location,
+               args_array, sizeof...(Args));
 }
 
 template <class... Args>
-inline void print(const char* message, const Args&... args) {
+inline void print(FormatString<std::type_identity_t<Args>...> message, const Args&... args) {
   detail::Argument args_array[] = {args...};
-  detail::vprint(message, args_array, sizeof...(Args));
+  detail::vprint(message.get_format(), message.get_segments(), message.get_segments_count(), args_array,
+                 sizeof...(Args));
 }
 }  // namespace libk
 
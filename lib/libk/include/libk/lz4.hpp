@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libk {
+/** The maximum byte size of the data compressed at once by lz4_compress(), the match offsets being 16-bit. */
+static constexpr size_t LZ4_MAX_INPUT_SIZE = 65535;
+
+/**
+ * Compresses the @a src_size bytes at @a src into @a dst as a LZ4 block (the format of the LZ4 frames content,
+ * without any header), using a small greedy hash table to find the matches: fast rather than dense.
+ * @returns the byte size of the block, or 0 if it does not fit in the @a dst_capacity bytes at @a dst.
+ */
+[[nodiscard]] size_t lz4_compress(const void* src, size_t src_size, void* dst, size_t dst_capacity);
+
+/**
+ * Decompresses the LZ4 block of @a src_size bytes at @a src into @a dst, which must be exactly @a dst_size bytes.
+ * The block may come from anywhere: all the lengths and offsets are checked.
+ * @returns `false` if the block is invalid or not of @a dst_size bytes once decompressed.
+ */
+[[nodiscard]] bool lz4_decompress(const void* src, size_t src_size, void* dst, size_t dst_size);
+}  // namespace libk
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstddef>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 #include "assert.hpp"
@@ -65,6 +67,31 @@ template <class T, class... Args>
   return ScopedPointer<T>(ptr);
 }
 
+template <class T>
+class SharedPointer;
+
+/**
+ * Base class for objects owned by a SharedPointer that need to create new SharedPointers to
+ * themselves (e.g. when only a raw pointer is at hand), without creating a second owner.
+ */
+template <class T>
+class EnableSharedFromThis {
+ public:
+  [[nodiscard]] SharedPointer<T> shared_from_this() const;
+
+ private:
+  friend class SharedPointer<T>;
+  mutable void* m_shared_block = nullptr;  // the control block of the owning SharedPointer
+};  // class EnableSharedFromThis
+
+/**
+ * A reference counted pointer, the object is deleted with its last SharedPointer.
+ *
+ * The reference count lives in a control block allocated next to the object, make_shared() allocates
+ * both at once. The count is not atomic: exclusive accesses do not work with the data cache disabled
+ * (see KernelLock), so the shared pointers must only be copied and released under the big kernel lock
+ * (or by a single core).
+ */
 template <class T>
 class SharedPointer {
  public:
@@ -93,6 +120,9 @@ class SharedPointer {
   // Move
   SharedPointer(SharedPointer&& other) : m_block(other.m_block) { other.m_block = nullptr; }
   SharedPointer& operator=(SharedPointer&& other) {
+    if (this == &other)
+      return *this;
+
     reset();
     m_block = other.m_block;
     other.m_block = nullptr;
@@ -100,22 +130,29 @@ class SharedPointer {
   }
 
   void reset() {
-    if (m_block == nullptr)
+    Block* block = m_block;
+    if (block == nullptr)
       return;
 
-    m_block->ref_count--;
-    if (m_block->ref_count == 0) {
-      delete m_block->data;
-      delete m_block;
+    m_block = nullptr;
+    block->ref_count--;
+    if (block->ref_count == 0) {
+      if (block->is_inline) {
+        block->data->~T();
+        delete static_cast<InlineBlock*>(block);
+      } else {
+        delete block->data;
+        delete block;
+      }
     }
   }
 
   template <class U>
   void reset(U* ptr) {
     reset();
-    m_block = new Block;
-    m_block->data = ptr;
-    m_block->ref_count++;
+    Block* block = new Block;
+    block->data = ptr;
+    adopt(block);
   }
 
   [[nodiscard]] T* get() const { return m_block != nullptr ? m_block->data : nullptr; }
@@ -123,16 +160,49 @@ class SharedPointer {
   [[nodiscard]] bool operator!() const { return m_block == nullptr; }
   [[nodiscard]] T& operator*() const { return *m_block->data; }
   [[nodiscard]] T* operator->() const { return m_block->data; }
+  /** Checks if this pointer is the only owner of the object (false if null). */
+  [[nodiscard]] bool is_unique() const { return m_block != nullptr && m_block->ref_count == 1; }
 
  private:
   struct Block {
     T* data = nullptr;
     unsigned int ref_count = 0;
+    bool is_inline = false;  // is data stored in the InlineBlock itself?
   };  // struct Block
 
+  // The control block and the object in a single allocation, see make_shared().
+  struct InlineBlock : Block {
+    alignas(T) unsigned char storage[sizeof(T)];
+  };  // struct InlineBlock
+
+  /** Takes the first reference of @a block. */
+  void adopt(Block* block) {
+    m_block = block;
+    m_block->ref_count++;
+
+    if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+      if (m_block->data != nullptr)
+        static_cast<EnableSharedFromThis<T>*>(m_block->data)->m_shared_block = m_block;
+    }
+  }
+
+  friend class EnableSharedFromThis<T>;
+  template <class U, class... Args>
+  friend SharedPointer<U> make_shared(Args&&... args);
+
   Block* m_block;
 };  // class SharedPointer
 
+template <class T>
+SharedPointer<T> EnableSharedFromThis<T>::shared_from_this() const {
+  KASSERT(m_shared_block != nullptr && "object not owned by a SharedPointer");
+
+  SharedPointer<T> ptr;
+  ptr.m_block = (typename SharedPointer<T>::Block*)m_shared_block;
+  ptr.m_block->ref_count++;
+  return ptr;
+}
+
 template <class T>
 [[nodiscard]] bool operator==(const SharedPointer<T>& lhs, std::nullptr_t) {
   return !lhs;
@@ -143,9 +213,117 @@ template <class T>
   return lhs.get() == rhs.get();
 }
 
+/**
+ * Creates a T owned by a SharedPointer, allocated together with the control block.
+ *
+ * The classes with their own operator new (e.g. allocated from an ObjectCache) keep it: the object and
+ * the control block are then allocated separately.
+ */
 template <class T, class... Args>
 [[nodiscard]] SharedPointer<T> make_shared(Args&&... args) {
-  T* ptr = new T(std::forward<Args>(args)...);
-  return SharedPointer<T>(ptr);
+  if constexpr (requires { T::operator new(sizeof(T)); }) {
+    T* ptr = new T(std::forward<Args>(args)...);
+    return SharedPointer<T>(ptr);
+  } else {
+    using InlineBlock = typename SharedPointer<T>::InlineBlock;
+    auto* block = new InlineBlock;
+    block->data = new (block->storage) T(std::forward<Args>(args)...);
+    block->is_inline = true;
+
+    SharedPointer<T> ptr;
+    ptr.adopt(block);
+    return ptr;
+  }
+}
+
+/**
+ * Base class for the objects owned by IntrusivePtr, holding their reference count.
+ *
+ * Unlike SharedPointer, there is no control block at all: a pointer can be recreated from a raw
+ * pointer to the object at any time. As for SharedPointer, the count is not atomic.
+ */
+class RefCounted {
+ public:
+  [[nodiscard]] unsigned int get_ref_count() const { return m_ref_count; }
+
+ protected:
+  RefCounted() = default;
+  ~RefCounted() = default;
+
+  // No copy, the count belongs to the object identity.
+  RefCounted(const RefCounted&) = delete;
+  RefCounted& operator=(const RefCounted&) = delete;
+
+ private:
+  template <class T>
+  friend class IntrusivePtr;
+
+  mutable unsigned int m_ref_count = 0;
+};  // class RefCounted
+
+/** A reference counted pointer to a RefCounted T, the object is deleted with its last IntrusivePtr. */
+template <class T>
+class IntrusivePtr {
+ public:
+  IntrusivePtr() : m_data(nullptr) {}
+  IntrusivePtr(std::nullptr_t) : m_data(nullptr) {}
+  explicit IntrusivePtr(T* data) : m_data(data) {
+    if (m_data != nullptr)
+      m_data->m_ref_count++;
+  }
+  ~IntrusivePtr() { reset(); }
+
+  // Copy
+  IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.m_data) {}
+  IntrusivePtr& operator=(const IntrusivePtr& other) {
+    if (m_data == other.m_data)  // check self-assignment
+      return *this;
+
+    reset();
+    new (this) IntrusivePtr(other);
+    return *this;
+  }
+
+  // Move
+  IntrusivePtr(IntrusivePtr&& other) : m_data(other.m_data) { other.m_data = nullptr; }
+  IntrusivePtr& operator=(IntrusivePtr&& other) {
+    if (this == &other)
+      return *this;
+
+    reset();
+    m_data = other.m_data;
+    other.m_data = nullptr;
+    return *this;
+  }
+
+  void reset() {
+    T* data = m_data;
+    if (data == nullptr)
+      return;
+
+    m_data = nullptr;
+    data->m_ref_count--;
+    if (data->m_ref_count == 0)
+      delete data;
+  }
+
+  [[nodiscard]] T* get() const { return m_data; }
+  [[nodiscard]] operator bool() const { return m_data != nullptr; }
+  [[nodiscard]] bool operator!() const { return m_data == nullptr; }
+  [[nodiscard]] T& operator*() const { return *m_data; }
+  [[nodiscard]] T* operator->() const { return m_data; }
+
+ private:
+  T* m_data;
+};  // class IntrusivePtr
+
+template <class T>
+[[nodiscard]] bool operator==(const IntrusivePtr<T>& lhs, std::nullptr_t) {
+  return !lhs;
+}
+
+template <class T>
+[[nodiscard]] bool operator==(const IntrusivePtr<T>& lhs, const IntrusivePtr<T>& rhs) {
+  return lhs.get() == rhs.get();
 }
 }  // namespace libk
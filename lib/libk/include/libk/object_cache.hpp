@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "assert.hpp"
+
+namespace libk {
+/**
+ * A cache of objects of type T: the memory of destroyed objects is kept in a free list to quickly
+ * create new ones, without going through the general purpose allocator.
+ *
+ * The memory is allocated by chunks of several objects and is never given back. Consecutive chunks
+ * are colored: their first object is shifted by a different multiple of the cache line size,
+ * so objects at the same index in different chunks do not compete for the same cache sets.
+ *
+ * The constructor (resp. destructor) hook is called on each object created by create() just after
+ * its construction (resp. destroyed by destroy() just before its destruction).
+ *
+ * The constructor is constexpr, so global caches are constant initialized and usable at any time.
+ */
+template <class T>
+class ObjectCache {
+ public:
+  using Hook = void (*)(T*);
+
+  /** Target byte size of the chunks (objects bigger than it get a chunk each). */
+  static constexpr size_t CHUNK_BYTE_SIZE = 4096;
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+  static constexpr size_t NB_COLORS = 4;
+
+  constexpr explicit ObjectCache(Hook constructor_hook = nullptr, Hook destructor_hook = nullptr)
+      : m_constructor_hook(constructor_hook), m_destructor_hook(destructor_hook) {}
+
+  // No copy
+  ObjectCache(const ObjectCache&) = delete;
+  ObjectCache& operator=(const ObjectCache&) = delete;
+
+  /** Creates a new object with the given constructor @a args. Returns nullptr if out of memory. */
+  template <class... Args>
+  [[nodiscard]] T* create(Args&&... args) {
+    void* memory = allocate();
+    if (memory == nullptr)
+      return nullptr;
+
+    T* object = new (memory) T(std::forward<Args>(args)...);
+    if (m_constructor_hook != nullptr)
+      m_constructor_hook(object);
+    return object;
+  }
+
+  /** Destroys the given @a object previously created by create(). Does nothing if @a object is null. */
+  void destroy(T* object) {
+    if (object == nullptr)
+      return;
+
+    if (m_destructor_hook != nullptr)
+      m_destructor_hook(object);
+    object->~T();
+    deallocate(object);
+  }
+
+  /** Allocates uninitialized memory for one object (e.g. to implement a class operator new). */
+  [[nodiscard]] void* allocate() {
+    if (m_free_slots == nullptr && !grow())
+      return nullptr;
+
+    Slot* slot = m_free_slots;
+    m_free_slots = slot->next;
+    m_free_count--;
+    return slot;
+  }
+
+  /** Gives back the memory @a ptr previously returned by allocate(). */
+  void deallocate(void* ptr) {
+    if (ptr == nullptr)
+      return;
+
+    auto* slot = static_cast<Slot*>(ptr);
+    slot->next = m_free_slots;
+    m_free_slots = slot;
+    m_free_count++;
+  }
+
+  /** Gets the count of objects that can be created before allocating a new chunk. */
+  [[nodiscard]] size_t get_free_count() const { return m_free_count; }
+
+ private:
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };  // union Slot
+
+  static constexpr size_t SLOT_ALIGNMENT = alignof(Slot) > CACHE_LINE_SIZE ? alignof(Slot) : CACHE_LINE_SIZE;
+  static constexpr size_t MAX_COLOR_OFFSET = (NB_COLORS - 1) * CACHE_LINE_SIZE;
+  static constexpr size_t OBJECTS_PER_CHUNK =
+      (CHUNK_BYTE_SIZE - MAX_COLOR_OFFSET) / sizeof(Slot) > 0 ? (CHUNK_BYTE_SIZE - MAX_COLOR_OFFSET) / sizeof(Slot) : 1;
+
+  bool grow() {
+    // The color offset must keep the slots aligned.
+    const size_t color_offset = (m_next_color * CACHE_LINE_SIZE + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+    m_next_color = (m_next_color + 1) % NB_COLORS;
+
+    const size_t chunk_size = MAX_COLOR_OFFSET + OBJECTS_PER_CHUNK * sizeof(Slot);
+    void* memory = ::operator new(chunk_size, std::align_val_t(SLOT_ALIGNMENT));
+    if (memory == nullptr)
+      return false;
+
+    auto* slots = reinterpret_cast<Slot*>(static_cast<unsigned char*>(memory) + color_offset);
+    for (size_t i = OBJECTS_PER_CHUNK; i > 0; --i)
+      deallocate(&slots[i - 1]);
+
+    return true;
+  }
+
+ private:
+  Hook m_constructor_hook;
+  Hook m_destructor_hook;
+  Slot* m_free_slots = nullptr;
+  size_t m_free_count = 0;
+  size_t m_next_color = 0;
+};  // class ObjectCache
+}  // namespace libk
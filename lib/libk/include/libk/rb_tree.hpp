@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include "assert.hpp"
+
+namespace libk {
+/** The links to embed into an object so it can be stored into an IntrusiveRbTree. */
+struct RbTreeHook {
+  RbTreeHook* parent = nullptr;
+  RbTreeHook* left = nullptr;
+  RbTreeHook* right = nullptr;
+  bool is_red = false;
+  bool linked = false;
+
+  /** Checks if the object is currently stored in a tree. */
+  [[nodiscard]] bool is_linked() const { return linked; }
+};  // struct RbTreeHook
+
+namespace rb_tree_impl {
+/** Rebalances the tree of @a root after @a node was linked as a leaf. */
+void insert_fixup(RbTreeHook** root, RbTreeHook* node);
+/** Unlinks @a node from the tree of @a root and rebalances it. */
+void erase(RbTreeHook** root, RbTreeHook* node);
+/** Returns the in-order successor of @a node, or nullptr. */
+[[nodiscard]] RbTreeHook* next(RbTreeHook* node);
+}  // namespace rb_tree_impl
+
+/**
+ * A red-black tree whose links are stored inside the objects themselves (see RbTreeHook), sorted by
+ * @a Less (a functor comparing two objects). The objects comparing equal are kept in insertion order.
+ *
+ * Insertions and removals are O(log n) and never allocate memory, the first object is cached so it is
+ * O(1) to get. As IntrusiveList, the tree does not own the stored objects.
+ */
+template <class T, RbTreeHook T::*Hook, class Less>
+class IntrusiveRbTree {
+ public:
+  [[nodiscard]] bool is_empty() const { return m_root == nullptr; }
+
+  /** Returns the smallest object, or nullptr if the tree is empty. */
+  [[nodiscard]] T* first() const { return m_first != nullptr ? from_hook(m_first) : nullptr; }
+
+  /** Returns the object following @a item (stored in this tree), or nullptr if it is the last one. */
+  [[nodiscard]] T* next(T* item) const {
+    RbTreeHook* hook = &(item->*Hook);
+    KASSERT(hook->is_linked());
+    RbTreeHook* next_hook = rb_tree_impl::next(hook);
+    return next_hook != nullptr ? from_hook(next_hook) : nullptr;
+  }
+
+  void insert(T* item) {
+    RbTreeHook* hook = &(item->*Hook);
+    KASSERT(!hook->is_linked());
+
+    RbTreeHook* parent = nullptr;
+    RbTreeHook** link = &m_root;
+    bool is_first = true;
+    while (*link != nullptr) {
+      parent = *link;
+      if (Less()(*item, *from_hook(parent))) {
+        link = &parent->left;
+      } else {
+        link = &parent->right;
+        is_first = false;
+      }
+    }
+
+    *hook = {};
+    hook->parent = parent;
+    hook->linked = true;
+    *link = hook;
+    if (is_first)
+      m_first = hook;
+
+    rb_tree_impl::insert_fixup(&m_root, hook);
+  }
+
+  /** Removes @a item from the tree. It must be stored in this tree. */
+  void remove(T* item) {
+    RbTreeHook* hook = &(item->*Hook);
+    KASSERT(hook->is_linked());
+
+    if (hook == m_first)
+      m_first = rb_tree_impl::next(hook);
+
+    rb_tree_impl::erase(&m_root, hook);
+    *hook = {};
+  }
+
+ private:
+  [[nodiscard]] static T* from_hook(RbTreeHook* hook) {
+    const uintptr_t offset = (uintptr_t)&(((T*)nullptr)->*Hook);
+    return (T*)((uintptr_t)hook - offset);
+  }
+
+  RbTreeHook* m_root = nullptr;
+  RbTreeHook* m_first = nullptr;  // the leftmost node
+};  // class IntrusiveRbTree
+}  // namespace libk
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "assert.hpp"
+
+namespace libk {
+/**
+ * A growable array whose first N elements are stored inline (inside the vector itself).
+ *
+ * Most users only ever store a few elements: they then need no allocation at all, and the elements
+ * are contiguous in memory. Past N elements, the storage moves to the heap and doubles as needed.
+ * Unlike LinkedList, pointers and iterators to the elements are invalidated by insertions and removals.
+ */
+template <class T, size_t N>
+class SmallVector {
+ public:
+  SmallVector() = default;
+  ~SmallVector() {
+    clear();
+    if (!is_inline())
+      ::operator delete(m_data);
+  }
+
+  // No copy
+  SmallVector(const SmallVector&) = delete;
+  SmallVector& operator=(const SmallVector&) = delete;
+
+  [[nodiscard]] bool is_empty() const { return m_size == 0; }
+  [[nodiscard]] size_t get_size() const { return m_size; }
+  [[nodiscard]] size_t get_capacity() const { return m_capacity; }
+
+  [[nodiscard]] T& operator[](size_t index) {
+    KASSERT(index < m_size);
+    return m_data[index];
+  }
+  [[nodiscard]] const T& operator[](size_t index) const {
+    KASSERT(index < m_size);
+    return m_data[index];
+  }
+
+  [[nodiscard]] T& front() { return (*this)[0]; }
+  [[nodiscard]] T& back() { return (*this)[m_size - 1]; }
+
+  void push_back(const T& value) { emplace_back(value); }
+
+  template <class... Args>
+  T& emplace_back(Args&&... args) {
+    if (m_size == m_capacity)
+      grow();
+
+    T* element = new (&m_data[m_size]) T(std::forward<Args>(args)...);
+    ++m_size;
+    return *element;
+  }
+
+  T pop_back() {
+    KASSERT(!is_empty());
+    T value = std::move(m_data[m_size - 1]);
+    m_data[--m_size].~T();
+    return value;
+  }
+
+  /** Removes the element at @a it, the following elements are moved back (the order is kept). */
+  void erase(T* it) {
+    KASSERT(it >= begin() && it < end());
+    for (T* next = it + 1; next != end(); ++it, ++next)
+      *it = std::move(*next);
+    m_data[--m_size].~T();
+  }
+
+  /** Removes all the elements (the memory is kept). */
+  void clear() {
+    for (size_t i = 0; i < m_size; ++i)
+      m_data[i].~T();
+    m_size = 0;
+  }
+
+  [[nodiscard]] T* begin() { return m_data; }
+  [[nodiscard]] const T* begin() const { return m_data; }
+  [[nodiscard]] T* end() { return m_data + m_size; }
+  [[nodiscard]] const T* end() const { return m_data + m_size; }
+
+ private:
+  [[nodiscard]] bool is_inline() const { return m_data == reinterpret_cast<const T*>(m_inline_storage); }
+
+  void grow() {
+    const size_t new_capacity = m_capacity * 2;
+    T* new_data = static_cast<T*>(::operator new(new_capacity * sizeof(T)));
+    KASSERT(new_data != nullptr);
+
+    for (size_t i = 0; i < m_size; ++i) {
+      new (&new_data[i]) T(std::move(m_data[i]));
+      m_data[i].~T();
+    }
+
+    if (!is_inline())
+      ::operator delete(m_data);
+
+    m_data = new_data;
+    m_capacity = new_capacity;
+  }
+
+  static_assert(N > 0, "use a LinkedList or an allocated array instead");
+
+  alignas(T) unsigned char m_inline_storage[N * sizeof(T)];
+  T* m_data = reinterpret_cast<T*>(m_inline_storage);
+  size_t m_size = 0;
+  size_t m_capacity = N;
+};  // class SmallVector
+}  // namespace libk
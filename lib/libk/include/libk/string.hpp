@@ -1,13 +1,23 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <type_traits>
 
 #include "assert.hpp"
 
 namespace libk {
+namespace detail {
+/** The strlen() implementation used at runtime, it scans the text by whole words. */
+size_t strlen_by_words(const char* text);
+}  // namespace detail
+
 /** Implementation of the C standard `strlen()` function. */
 constexpr inline size_t strlen(const char* text) {
+  if (!std::is_constant_evaluated()) {
+    return detail::strlen_by_words(text);
+  }
+
   size_t length = 0;
   while (*text++ != '\0')
     ++length;
@@ -102,44 +112,16 @@ constexpr inline const char* strstr(const char* haystack, const char* needle) {
 }
 
 /** Implementation of the C standard `memchr()` function. */
-inline void* memchr(const void* ptr, int value, size_t length) {
-  const unsigned char* p = (const unsigned char*)ptr;
-
-  while (length-- > 0) {
-    if (*p == (unsigned char)value) {
-      return (void*)p;
-    }
-
-    ++p;
-  }
-
-  return nullptr;
-}
+void* memchr(const void* ptr, int value, size_t length);
 
 /** Implementation of the C standard `memcmp()` function. */
-inline int memcmp(const void* lhs, const void* rhs, size_t length) {
-  const unsigned char* p1 = (const unsigned char*)lhs;
-  const unsigned char* p2 = (const unsigned char*)rhs;
-
-  while (length-- > 0) {
-    if (*p1 != *p2) {
-      return *p1 - *p2;
-    }
-
-    ++p1;
-    ++p2;
-  }
-
-  return 0;
-}
+int memcmp(const void* lhs, const void* rhs, size_t length);
 
 /** Implementation of the C standard `memset()` function. */
-inline void* memset(void* dst, int value, size_t length) {
-  unsigned char* p = (unsigned char*)dst;
-  while (length-- > 0)
-    *p++ = (unsigned char)value;
-  return dst;
-}
+void* memset(void* dst, int value, size_t length);
+
+/** Fills the @a count words at @a dst with @a value. */
+uint32_t* memset32(uint32_t* dst, uint32_t value, size_t count);
 
 /** Zero memory. */
 inline void bzero(void* dst, size_t length) {
@@ -147,30 +129,32 @@ inline void bzero(void* dst, size_t length) {
 }
 
 /** Implementation of the C standard `memcpy()` function. */
-inline void* memcpy(void* dst, const void* src, size_t length) {
-  char* d = (char*)dst;
-  const char* s = (const char*)src;
-  while (length-- > 0)
-    *d++ = *s++;
-  return dst;
-}
+void* memcpy(void* dst, const void* src, size_t length);
 
 /** Implementation of the C standard `memmove()` function. */
-inline void* memmove(void* dst, const void* src, size_t length) {
-  char* d = (char*)dst;
-  const char* s = (const char*)src;
-
-  if (d <= s) {
-    while (length-- > 0)
-      *d++ = *s++;
-  } else {
-    s += length;
-    d += length;
-
-    while (length-- > 0)
-      *--d = *--s;
-  }
-
-  return dst;
-}
+void* memmove(void* dst, const void* src, size_t length);
+
+/**
+ * A facility doing the big copies and fills instead of the CPU (like a DMA controller).
+ *
+ * Each function returns false if it is unable to do the operation (the CPU does it then).
+ * The memory areas never overlap, and the fills are 4-byte aligned (@a pattern is repeated).
+ */
+struct LargeCopyEngine {
+  bool (*copy)(void* dst, const void* src, size_t length);
+  bool (*fill)(uint32_t* dst, uint32_t pattern, size_t length);
+};  // struct LargeCopyEngine
+
+/** Sets the engine used by memcpy_large() and memset_large(), or nullptr to only use the CPU. */
+void set_large_copy_engine(const LargeCopyEngine* engine);
+
+/** Same as memcpy(), but suited for big copies (they are offloaded to the large copy engine, from
+ * CpuFeatures::large_copy_threshold bytes). */
+void* memcpy_large(void* dst, const void* src, size_t length);
+
+/** Same as memset(), but suited for big fills (they are offloaded to the large copy engine). */
+void* memset_large(void* dst, int value, size_t length);
+
+/** Fills the @a count words at @a dst with @a value, big fills are offloaded to the large copy engine. */
+uint32_t* memset32_large(uint32_t* dst, uint32_t value, size_t count);
 }  // namespace libk
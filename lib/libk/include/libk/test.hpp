@@ -40,10 +40,12 @@ void run_tests();
   static _KUNIQUEID(_KTest) _KUNIQUEID(__ktest_instance_) = _KUNIQUEID(_KTest)(name); \
   void _KUNIQUEID(_KTest)::do_run()
 
-#define _KTEST_EXPECT_IMPL(cond) __ktest_expect(!!(cond));
+#define _KTEST_EXPECT_IMPL(cond) __ktest_expect(!!(cond))
 #define _KTEST_ASSERT_IMPL(macro) \
-  if (macro)                      \
-    return;
+  do {                            \
+    if (macro)                    \
+      return;                     \
+  } while (false)
 #else
 namespace ktest {
 static inline void run_tests() {}
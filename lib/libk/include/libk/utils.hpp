@@ -70,6 +70,11 @@ static inline constexpr U div_round_down(U a, V b) {
   asm volatile("wfi");
 }
 
+/** @brief The SEV instruction. */
+[[gnu::always_inline]] static inline void sev() {
+  asm volatile("sev");
+}
+
 /** @brief Halt the CPU (enter into a infinite loop). */
 [[noreturn, gnu::always_inline]] static inline void halt() {
   // The `asm volatile` is required here to avoid Clang to optimize away the infinite loop.
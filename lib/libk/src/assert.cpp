@@ -4,12 +4,27 @@
 #include <libk/qemu.hpp>
 
 namespace libk {
+static PanicHook g_panic_hook = nullptr;
+
+PanicHook set_panic_hook(PanicHook hook) {
+  const PanicHook previous_hook = g_panic_hook;
+  g_panic_hook = hook;
+  return previous_hook;
+}
+
 [[noreturn]] void panic(const char* message, std::source_location source_location) {
+  flush_logs();
   print("KERNEL PANIC at {}:{} in `{}`.", source_location.file_name(), source_location.line(),
         source_location.function_name());
   print("Do not panic. Keep calm and carry on.");
   print("Panic message: {}", message);
 
+  // Cleared first, a panic inside the hook must not call it again.
+  if (PanicHook hook = g_panic_hook; hook != nullptr) {
+    g_panic_hook = nullptr;
+    hook();
+  }
+
 #ifdef TARGET_QEMU
     qemu_exit(1);
 #endif // TARGET_QEMU
@@ -0,0 +1,123 @@
+#include <libk/benchmark.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+
+#ifdef BUILD_BENCHMARKS
+namespace kbench {
+static constexpr size_t _KBENCH_MAX_REGISTERED_BENCHMARKS = 128;
+static Benchmark* __kbench_registered_benchmarks[_KBENCH_MAX_REGISTERED_BENCHMARKS];
+static size_t __kbench_registered_benchmark_count = 0;
+
+static inline uint64_t read_cycle_counter() {
+  uint64_t counter;
+  asm volatile("isb; mrs %x0, pmccntr_el0" : "=r"(counter));
+  return counter;
+}
+
+static inline uint64_t read_tick_counter() {
+  uint64_t counter;
+  asm volatile("isb; mrs %x0, cntvct_el0" : "=r"(counter));
+  return counter;
+}
+
+static void enable_cycle_counter() {
+  // Count the cycles at all the exception levels (PMCCFILTR_EL0), enable the counter (PMCNTENSET_EL0.C),
+  // then enable and reset the counters (PMCR_EL0.E and PMCR_EL0.C).
+  asm volatile("msr pmccfiltr_el0, xzr" ::: "memory");
+  asm volatile("msr pmcntenset_el0, %x0" ::"r"(1ul << 31) : "memory");
+  asm volatile("msr pmcr_el0, %x0" ::"r"((1ul << 0) | (1ul << 2)) : "memory");
+  asm volatile("isb" ::: "memory");
+}
+
+void State::reset(size_t warmup_iterations, size_t iterations) {
+  m_warmup_iterations = warmup_iterations;
+  m_iterations = libk::min(iterations, MAX_ITERATIONS);
+  m_started_count = 0;
+  m_sample_count = 0;
+}
+
+bool State::keep_running() {
+  const uint64_t cycles = read_cycle_counter();
+  const uint64_t ticks = read_tick_counter();
+
+  // The first call starts the first iteration, the next ones end an iteration.
+  if (m_started_count > m_warmup_iterations) {
+    m_cycles[m_sample_count] = cycles - m_last_cycles;
+    m_ticks[m_sample_count] = ticks - m_last_ticks;
+    m_sample_count++;
+  }
+
+  if (m_started_count == m_warmup_iterations + m_iterations)
+    return false;
+
+  m_started_count++;
+
+  // Read again, so the bookkeeping above is not timed.
+  m_last_cycles = read_cycle_counter();
+  m_last_ticks = read_tick_counter();
+  return true;
+}
+
+Benchmark::Benchmark(const char* name, size_t iterations) : m_name(name), m_iterations(iterations) {
+  if (__kbench_registered_benchmark_count < _KBENCH_MAX_REGISTERED_BENCHMARKS)
+    __kbench_registered_benchmarks[__kbench_registered_benchmark_count++] = this;
+}
+
+static void sort_samples(uint64_t* samples, size_t count) {
+  // Shell sort, good enough for a few thousands of samples and needs no memory.
+  for (size_t gap = count / 2; gap > 0; gap /= 2) {
+    for (size_t i = gap; i < count; ++i) {
+      const uint64_t sample = samples[i];
+      size_t j = i;
+      for (; j >= gap && samples[j - gap] > sample; j -= gap)
+        samples[j] = samples[j - gap];
+      samples[j] = sample;
+    }
+  }
+}
+
+struct Summary {
+  uint64_t min;
+  uint64_t median;
+  uint64_t p99;
+};  // struct Summary
+
+static Summary summarize(uint64_t* samples, size_t count) {
+  if (count == 0)
+    return {0, 0, 0};
+
+  sort_samples(samples, count);
+  return {samples[0], samples[count / 2], samples[libk::min(count * 99 / 100, count - 1)]};
+}
+
+void Benchmark::run() {
+  // The state is too big for the kernel task stacks.
+  static State state;
+  state.reset(libk::max<size_t>(m_iterations / 10, 1), m_iterations);
+  do_run(state);
+
+  const size_t count = state.get_iterations_count();
+  const Summary cycles = summarize(state.get_cycles_samples(), count);
+  const Summary ticks = summarize(state.get_ticks_samples(), count);
+  libk::print(
+      "BENCH {{\"name\": \"{}\", \"iterations\": {}, \"cycles_min\": {}, \"cycles_median\": {}, "
+      "\"cycles_p99\": {}, \"ticks_min\": {}, \"ticks_median\": {}, \"ticks_p99\": {}}}",
+      m_name, count, cycles.min, cycles.median, cycles.p99, ticks.min, ticks.median, ticks.p99);
+}
+
+void run_benchmarks() {
+  enable_cycle_counter();
+
+  uint64_t tick_frequency;
+  asm volatile("mrs %x0, cntfrq_el0" : "=r"(tick_frequency));
+  libk::print("BENCH_BEGIN {{\"tick_frequency\": {}, \"count\": {}}}", tick_frequency,
+              __kbench_registered_benchmark_count);
+
+  for (size_t i = 0; i < __kbench_registered_benchmark_count; ++i) {
+    __kbench_registered_benchmarks[i]->run();
+  }
+
+  libk::print("BENCH_END {{}}");
+}
+}  // namespace kbench
+#endif  // BUILD_BENCHMARKS
@@ -33,4 +33,79 @@ void BitArray::fill_array(bool value) {
   const uint8_t int_value = value ? 0xff : 0x00;
   libk::memset(m_array, int_value, m_bytes_size);
 }
+
+static constexpr size_t BITS_PER_WORD = 8 * sizeof(uint64_t);
+
+/** Returns the mask of the bits of a word from @a begin to @a end (excluded), with 0 <= begin < end <= 64. */
+static inline uint64_t get_word_mask(size_t begin, size_t end) {
+  const uint64_t high_mask = (end == BITS_PER_WORD) ? UINT64_MAX : ((1ull << end) - 1);
+  return high_mask & ~((1ull << begin) - 1);
+}
+
+void BitArray::fill_range(size_t begin, size_t end, bool value) {
+  if (m_array == nullptr || begin >= end) {
+    return;
+  }
+
+  size_t word = begin / BITS_PER_WORD;
+  const size_t last_word = (end - 1) / BITS_PER_WORD;
+  const uint64_t fill = value ? UINT64_MAX : 0;
+
+  // The partial words at each end are masked, the full ones in the middle are written at once.
+  if (word == last_word) {
+    const uint64_t mask = get_word_mask(begin % BITS_PER_WORD, (end - 1) % BITS_PER_WORD + 1);
+    m_array[word] = (m_array[word] & ~mask) | (fill & mask);
+    return;
+  }
+
+  const uint64_t first_mask = get_word_mask(begin % BITS_PER_WORD, BITS_PER_WORD);
+  m_array[word] = (m_array[word] & ~first_mask) | (fill & first_mask);
+  for (++word; word < last_word; ++word) {
+    m_array[word] = fill;
+  }
+
+  const uint64_t last_mask = get_word_mask(0, (end - 1) % BITS_PER_WORD + 1);
+  m_array[last_word] = (m_array[last_word] & ~last_mask) | (fill & last_mask);
+}
+
+size_t BitArray::find_first(bool value, size_t start) const {
+  const size_t bit_count = get_bit_count();
+  if (m_array == nullptr || start >= bit_count) {
+    return NOT_FOUND;
+  }
+
+  // Searching a clear bit is searching a set bit in the inverted words.
+  const uint64_t invert = value ? 0 : UINT64_MAX;
+  const size_t words_count = (bit_count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  size_t word = start / BITS_PER_WORD;
+  uint64_t bits = (m_array[word] ^ invert) & get_word_mask(start % BITS_PER_WORD, BITS_PER_WORD);
+  while (bits == 0) {
+    if (++word == words_count) {
+      return NOT_FOUND;
+    }
+
+    bits = m_array[word] ^ invert;
+  }
+
+  const size_t index = word * BITS_PER_WORD + __builtin_ctzll(bits);
+  return index < bit_count ? index : NOT_FOUND;
+}
+
+size_t BitArray::find_run(size_t count, size_t start) const {
+  const size_t bit_count = get_bit_count();
+  while (true) {
+    // Each clear run is delimited by whole word scans.
+    const size_t run_begin = find_first_clear(start);
+    if (run_begin == NOT_FOUND || count > bit_count - run_begin) {
+      return NOT_FOUND;
+    }
+
+    const size_t run_end = find_first_set(run_begin);
+    if (run_end == NOT_FOUND || run_end - run_begin >= count) {
+      return run_begin;
+    }
+
+    start = run_end;
+  }
+}
 }  // namespace libk
@@ -0,0 +1,49 @@
+#include <libk/cache.hpp>
+
+namespace libk {
+#ifdef CONFIG_USE_DATA_CACHE
+size_t get_dcache_line_size() {
+  uint64_t ctr;
+  asm volatile("mrs %x0, ctr_el0" : "=r"(ctr));
+  // DminLine, bits [19:16], is the log2 of the number of words.
+  return sizeof(uint32_t) << ((ctr >> 16) & 0xf);
+}
+
+/** Calls @a op on the address of each cache line in [@a start, @a end[, then waits for their completion. */
+template <class Op>
+static inline void for_each_line(uintptr_t start, uintptr_t end, size_t line_size, Op op) {
+  for (uintptr_t line = start & ~(line_size - 1); line < end; line += line_size) {
+    op(line);
+  }
+
+  asm volatile("dsb sy" ::: "memory");
+}
+
+void clean_dcache_range(const void* ptr, size_t byte_size) {
+  const auto start = (uintptr_t)ptr;
+  for_each_line(start, start + byte_size, get_dcache_line_size(),
+                [](uintptr_t line) { asm volatile("dc cvac, %x0" ::"r"(line) : "memory"); });
+}
+
+void invalidate_dcache_range(const void* ptr, size_t byte_size) {
+  const size_t line_size = get_dcache_line_size();
+  const auto start = (uintptr_t)ptr;
+  const uintptr_t end = start + byte_size;
+
+  // The lines only partially in the range are also cleaned, not to lose the bytes outside of it.
+  for_each_line(start, end, line_size, [start, end, line_size](uintptr_t line) {
+    if (line < start || line + line_size > end) {
+      asm volatile("dc civac, %x0" ::"r"(line) : "memory");
+    } else {
+      asm volatile("dc ivac, %x0" ::"r"(line) : "memory");
+    }
+  });
+}
+
+void clean_invalidate_dcache_range(const void* ptr, size_t byte_size) {
+  const auto start = (uintptr_t)ptr;
+  for_each_line(start, start + byte_size, get_dcache_line_size(),
+                [](uintptr_t line) { asm volatile("dc civac, %x0" ::"r"(line) : "memory"); });
+}
+#endif  // CONFIG_USE_DATA_CACHE
+}  // namespace libk
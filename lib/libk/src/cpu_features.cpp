@@ -0,0 +1,58 @@
+#include <libk/cpu_features.hpp>
+#include <libk/utils.hpp>
+
+namespace libk {
+static CpuFeatures g_cpu_features;
+
+const CpuFeatures& get_cpu_features() {
+  return g_cpu_features;
+}
+
+/** Returns the byte size of the data (or unified) cache of the @a level (1 for L1), from CCSIDR_EL1. */
+static size_t read_cache_size(uint64_t level) {
+  // Select the data or unified cache of the level (InD = 0), then read its geometry.
+  const uint64_t csselr = (level - 1) << 1;
+  asm volatile("msr csselr_el1, %0; isb" : : "r"(csselr));
+  uint64_t ccsidr;
+  asm volatile("mrs %0, ccsidr_el1" : "=r"(ccsidr));
+
+  const size_t line_size = 16ul << (ccsidr & 0b111);
+  const size_t nb_ways = ((ccsidr >> 3) & 0x3ff) + 1;
+  const size_t nb_sets = ((ccsidr >> 13) & 0x7fff) + 1;
+  return line_size * nb_ways * nb_sets;
+}
+
+void probe_cpu_features() {
+  CpuFeatures features;
+
+  uint64_t ctr;
+  asm volatile("mrs %0, ctr_el0" : "=r"(ctr));
+  // DminLine (bits [19:16]) and IminLine (bits [3:0]) are the log2 of the number of words.
+  features.dcache_line_size = sizeof(uint32_t) << ((ctr >> 16) & 0xf);
+  features.icache_line_size = sizeof(uint32_t) << (ctr & 0xf);
+
+  // CLIDR_EL1 has 3 bits per level: 2 for a data cache, 3 for separate caches, 4 for a unified cache.
+  uint64_t clidr;
+  asm volatile("mrs %0, clidr_el1" : "=r"(clidr));
+  for (uint64_t level = 1; level <= 2; ++level) {
+    const uint64_t type = (clidr >> (3 * (level - 1))) & 0b111;
+    if (type < 2 || type > 4)
+      continue;
+
+    const size_t size = read_cache_size(level);
+    (level == 1 ? features.l1d_size : features.l2_size) = size;
+  }
+
+  uint64_t dczid;
+  asm volatile("mrs %0, dczid_el0" : "=r"(dczid));
+  // DZP (bit 4) prohibits DC ZVA, BS (bits [3:0]) is the log2 of the number of words of a block.
+  features.dc_zva_block_size = (dczid & (1 << 4)) != 0 ? 0 : sizeof(uint32_t) << (dczid & 0xf);
+
+  // The faster cores come with the bigger L2: the CPU copies in the cache faster than the DMA is set up for
+  // longer. 1 KiB for the 512 KiB of L2 of the Cortex-A53, 2 KiB for the 1 MiB of the Cortex-A72.
+  if (features.l2_size != 0)
+    features.large_copy_threshold = libk::max(features.large_copy_threshold, features.l2_size / 512);
+
+  g_cpu_features = features;
+}
+}  // namespace libk
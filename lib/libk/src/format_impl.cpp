@@ -8,42 +8,94 @@ namespace libk::detail {
 static constexpr const char LOWER_DIGIT_ALPHABET[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 static constexpr const char UPPER_DIGIT_ALPHABET[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
+// The decimal representations of 0 to 99, to convert two digits at a time.
+static constexpr const char DECIMAL_DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static constexpr uint64_t POWERS_OF_10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+    10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull,
+    10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull};
+
+/** Returns the number of bits needed to represent @a value (at least 1). */
+static inline uint32_t get_bit_width(uint64_t value) {
+  return 64 - __builtin_clzll(value | 1);
+}
+
+static inline size_t count_decimal_digits(uint64_t value) {
+  // log10(value) ~= log2(value) * 1233 / 4096, which is exact or one less.
+  const uint32_t approximate = (get_bit_width(value) * 1233) >> 12;
+  return approximate + ((value | 1) >= POWERS_OF_10[approximate]);  // 0 has one digit too
+}
+
+/** Writes the decimal digits of @a value, ending at @a end. */
+static void write_decimal_digits(uint64_t value, char* end) {
+  while (value >= 100) {
+    const auto pair = (size_t)(value % 100) * 2;
+    value /= 100;
+    *--end = DECIMAL_DIGIT_PAIRS[pair + 1];
+    *--end = DECIMAL_DIGIT_PAIRS[pair];
+  }
+
+  if (value >= 10) {
+    *--end = DECIMAL_DIGIT_PAIRS[value * 2 + 1];
+    *--end = DECIMAL_DIGIT_PAIRS[value * 2];
+  } else {
+    *--end = (char)('0' + value);
+  }
+}
+
+/** Writes the digits of @a value in the radix 2^@a shift, ending at @a end. */
+static void write_power_of_two_digits(uint64_t value,
+                                      char* end,
+                                      size_t digits_count,
+                                      uint32_t shift,
+                                      const char* alphabet) {
+  const uint64_t mask = (1ull << shift) - 1;
+  for (size_t i = 0; i < digits_count; ++i) {
+    *--end = alphabet[value & mask];
+    value >>= shift;
+  }
+}
+
 static char* uint_to_string(uint64_t value,
                             char* buffer,
                             uint32_t radix,
                             bool lowercase = true,
                             size_t width = SIZE_MAX) {
-  size_t i = 0;
-
   const char* alphabet = lowercase ? LOWER_DIGIT_ALPHABET : UPPER_DIGIT_ALPHABET;
 
-  // Handle the case when the number is 0 separately
-  if (value == 0) {
-    buffer[i++] = '0';
-  }
-
-  // Extract digits in reverse order
-  while (value > 0) {
-    const auto digit = value % radix;
-    buffer[i++] = alphabet[digit];
-    value /= radix;
+  size_t digits_count;
+  if (radix == 10) {
+    digits_count = count_decimal_digits(value);
+  } else if ((radix & (radix - 1)) == 0) {
+    const uint32_t shift = __builtin_ctz(radix);
+    digits_count = (get_bit_width(value) + shift - 1) / shift;
+  } else {
+    digits_count = 1;
+    for (uint64_t remaining = value / radix; remaining > 0; remaining /= radix)
+      digits_count++;
   }
 
   // Padding
-  while ((width < SIZE_MAX) && i < width)
-    buffer[i++] = '0';
-
-  // Reverse the string to get the correct order
-  size_t start = 0, end = i - 1;
-  while (start < end) {
-    const char temp = buffer[start];
-    buffer[start] = buffer[end];
-    buffer[end] = temp;
-    start++;
-    end--;
+  for (size_t i = digits_count; (width < SIZE_MAX) && i < width; ++i)
+    *buffer++ = '0';
+
+  char* end = buffer + digits_count;
+  if (radix == 10) {
+    write_decimal_digits(value, end);
+  } else if ((radix & (radix - 1)) == 0) {
+    write_power_of_two_digits(value, end, digits_count, __builtin_ctz(radix), alphabet);
+  } else {
+    for (size_t i = 0; i < digits_count; ++i) {
+      *--end = alphabet[value % radix];
+      value /= radix;
+    }
   }
 
-  return buffer + i;
+  return buffer + digits_count;
 }
 
 enum class SignFormat : uint8_t {
@@ -314,4 +366,122 @@ char* format_argument_to(char* out, const Argument& argument, const char* spec)
 
   KASSERT(false && "argument kind not implemented");
 }
+
+char* format_to(char* out,
+                const char* fmt,
+                const FormatSegment* segments,
+                size_t segments_count,
+                const Argument* args,
+                size_t args_count) {
+  if (segments == nullptr)
+    return format_to(out, fmt, args, args_count);
+
+  // Already checked at compile time.
+  for (size_t i = 0; i < segments_count; ++i) {
+    const FormatSegment& segment = segments[i];
+    if (segment.argument_index == FormatSegment::LITERAL) {
+      memcpy(out, fmt + segment.offset, segment.length);
+      out += segment.length;
+    } else {
+      out = format_argument_to(out, args[segment.argument_index], fmt + segment.offset);
+    }
+  }
+
+  return out;
+}
 }  // namespace libk::detail
+
+/*
+ * Testing
+ */
+
+#include <libk/benchmark.hpp>
+#include <libk/test.hpp>
+
+/** The digit by digit conversion, as a reference. */
+static char* reference_uint_to_string(uint64_t value, char* buffer, uint32_t radix, size_t width = SIZE_MAX) {
+  size_t i = 0;
+  if (value == 0)
+    buffer[i++] = '0';
+
+  while (value > 0) {
+    buffer[i++] = libk::detail::LOWER_DIGIT_ALPHABET[value % radix];
+    value /= radix;
+  }
+
+  while ((width < SIZE_MAX) && i < width)
+    buffer[i++] = '0';
+
+  for (size_t start = 0, end = i - 1; start < end; ++start, --end) {
+    const char temp = buffer[start];
+    buffer[start] = buffer[end];
+    buffer[end] = temp;
+  }
+
+  return buffer + i;
+}
+
+static bool is_same_conversion(uint64_t value, uint32_t radix, size_t width) {
+  char expected[72];
+  char result[72];
+  char* expected_end = reference_uint_to_string(value, expected, radix, width);
+  char* result_end = libk::detail::uint_to_string(value, result, radix, true, width);
+  return (expected_end - expected) == (result_end - result) &&
+         libk::memcmp(expected, result, expected_end - expected) == 0;
+}
+
+TEST("libk.format.integers") {
+  static constexpr uint32_t RADIXES[] = {2, 8, 10, 16};
+  for (uint32_t radix : RADIXES) {
+    EXPECT_TRUE(is_same_conversion(0, radix, SIZE_MAX));
+    EXPECT_TRUE(is_same_conversion(UINT64_MAX, radix, SIZE_MAX));
+    EXPECT_TRUE(is_same_conversion(0x1234, radix, 16));
+
+    // Around all the powers of two and of ten.
+    uint64_t power_of_ten = 1;
+    for (uint32_t i = 0; i < 64; ++i) {
+      EXPECT_TRUE(is_same_conversion((1ull << i) - 1, radix, SIZE_MAX));
+      EXPECT_TRUE(is_same_conversion(1ull << i, radix, SIZE_MAX));
+      if (i < 20) {
+        EXPECT_TRUE(is_same_conversion(power_of_ten - 1, radix, SIZE_MAX));
+        EXPECT_TRUE(is_same_conversion(power_of_ten, radix, SIZE_MAX));
+        power_of_ten *= 10;
+      }
+    }
+  }
+}
+
+// Tick counts, PIDs, and addresses.
+static constexpr uint64_t BENCHMARK_VALUES[] = {42, 123456789, 0xffff00000008a000};
+
+BENCHMARK("libk.format.integers.decimal") {
+  char buffer[72];
+  while (state.keep_running()) {
+    for (uint64_t value : BENCHMARK_VALUES)
+      libk::detail::uint_to_string(value, buffer, 10);
+  }
+}
+
+BENCHMARK("libk.format.integers.decimal.digit_by_digit") {
+  char buffer[72];
+  while (state.keep_running()) {
+    for (uint64_t value : BENCHMARK_VALUES)
+      reference_uint_to_string(value, buffer, 10);
+  }
+}
+
+BENCHMARK("libk.format.integers.hexadecimal") {
+  char buffer[72];
+  while (state.keep_running()) {
+    for (uint64_t value : BENCHMARK_VALUES)
+      libk::detail::uint_to_string(value, buffer, 16);
+  }
+}
+
+BENCHMARK("libk.format.integers.hexadecimal.digit_by_digit") {
+  char buffer[72];
+  while (state.keep_running()) {
+    for (uint64_t value : BENCHMARK_VALUES)
+      reference_uint_to_string(value, buffer, 16);
+  }
+}
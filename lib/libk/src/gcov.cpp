@@ -0,0 +1,77 @@
+#include "libk/gcov.hpp"
+
+/*
+ * A .gcda file (in the byte order of the target, told by its magic): the magic, the version and the stamp of the
+ * object file, and its checksum. Then for each function, a FUNCTION record (tag, length in bytes, then its ident
+ * and checksums) followed by a COUNTER record for each counter kind used (tag, length in bytes, then the 64-bit
+ * counters). A function counted by another object file has an empty FUNCTION record.
+ */
+
+namespace libk::gcov {
+static constexpr uint32_t GCDA_MAGIC = 0x67636461;  // "gcda"
+static constexpr uint32_t TAG_FUNCTION = 0x01000000;
+static constexpr uint32_t TAG_FUNCTION_LENGTH = 3 * sizeof(uint32_t);
+static constexpr uint32_t TAG_COUNTER_BASE = 0x01a10000;
+
+static void write_u32(uint32_t value, Writer writer, void* arg) {
+  writer(&value, sizeof(value), arg);
+}
+
+void write_gcda(const Info& info, Writer writer, void* arg) {
+  write_u32(GCDA_MAGIC, writer, arg);
+  write_u32(info.version, writer, arg);
+  write_u32(info.stamp, writer, arg);
+  write_u32(info.checksum, writer, arg);
+
+  for (uint32_t i = 0; i < info.function_count; ++i) {
+    const FunctionInfo* function = info.functions[i];
+    const bool is_counted = function != nullptr && function->key == &info;
+    write_u32(TAG_FUNCTION, writer, arg);
+    write_u32(is_counted ? TAG_FUNCTION_LENGTH : 0, writer, arg);
+    if (!is_counted)
+      continue;
+
+    write_u32(function->ident, writer, arg);
+    write_u32(function->lineno_checksum, writer, arg);
+    write_u32(function->cfg_checksum, writer, arg);
+
+    const CounterInfo* counters = function->counters;
+    for (uint32_t kind = 0; kind < COUNTER_KINDS; ++kind) {
+      if (info.merge[kind] == nullptr)
+        continue;
+
+      write_u32(TAG_COUNTER_BASE + (kind << 17), writer, arg);
+      write_u32(counters->count * sizeof(int64_t), writer, arg);
+      // The 64-bit counters are written as their low word then their high word, as little endian integers.
+      writer(counters->values, counters->count * sizeof(int64_t), arg);
+      ++counters;
+    }
+  }
+}
+
+size_t get_gcda_size(const Info& info) {
+  size_t byte_size = 0;
+  write_gcda(info, [](const void*, size_t size, void* arg) { *(size_t*)arg += size; }, &byte_size);
+  return byte_size;
+}
+
+void reset(const Info& info) {
+  for (uint32_t i = 0; i < info.function_count; ++i) {
+    const FunctionInfo* function = info.functions[i];
+    if (function == nullptr || function->key != &info)
+      continue;
+
+    const CounterInfo* counters = function->counters;
+    for (uint32_t kind = 0; kind < COUNTER_KINDS; ++kind) {
+      if (info.merge[kind] == nullptr)
+        continue;
+
+      for (uint32_t j = 0; j < counters->count; ++j)
+        __atomic_store_n(&counters->values[j], 0, __ATOMIC_RELAXED);
+      ++counters;
+    }
+  }
+}
+}  // namespace libk::gcov
+
+extern "C" void __gcov_merge_add(int64_t*, uint32_t) {}
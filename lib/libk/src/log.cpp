@@ -9,6 +9,9 @@ static LogLevel current_log_level = LogLevel::TRACE;
 
 static LogTimer log_timer = nullptr;
 
+static LogDeferrer log_deferrer = nullptr;
+static LogFlusher log_flusher = nullptr;
+
 namespace detail {
 static const char* get_level_string(LogLevel level, bool with_colors) {
   switch (level) {
@@ -29,67 +32,95 @@ static const char* get_level_string(LogLevel level, bool with_colors) {
   KASSERT(false && "unknown log level");
 }
 
-void vlog_logger(Logger* logger,
-                 LogLevel level,
-                 const char* message,
-                 std::source_location source_location,
-                 const detail::Argument* args,
-                 size_t args_count) {
+static void write_message_to_logger(Logger* logger, const LogMessage& message) {
   static constexpr size_t MAX_BUFFER_SIZE = 1024;
 
   char buffer[MAX_BUFFER_SIZE];
   char* it = buffer;
 
   // Print the header
-  const char* level_string = get_level_string(level, logger->support_colors());
-  if (log_timer != nullptr) {
-    it = libk::format_to(it, "[{} ms] ", log_timer());
-  }
+  if (!message.is_print) {
+    const char* level_string = get_level_string(message.level, logger->support_colors());
+    if (message.has_time) {
+      it = libk::format_to(it, "[{} ms] ", message.time_in_ms);
+    }
 
-  if (level < LogLevel::INFO) {
-    it = libk::format_to(it, "[{}:{}] ", source_location.file_name(), source_location.line());
-  }
+    if (message.level < LogLevel::INFO) {
+      it = libk::format_to(it, "[{}:{}] ", message.file_name, message.line);
+    }
 
-  it = libk::format_to(it, "[{}] ", level_string);
+    it = libk::format_to(it, "[{}] ", level_string);
+  }
 
   // Print the message itself
-  it = detail::format_to(it, message, args, args_count);
+  it = detail::format_to(it, message.format, message.segments, message.segments_count, message.args,
+                         message.args_count);
   *it = '\0';
   logger->writeln(buffer, (size_t)((intptr_t)it - (intptr_t)buffer));
 }
 
+void write_message(const LogMessage& message) {
+  for (auto* logger : loggers) {
+    if (logger == nullptr)
+      continue;
+    write_message_to_logger(logger, message);
+  }
+}
+
+/** Writes @a message now, or gives it to the log deferrer. */
+static void emit_message(const LogMessage& message) {
+  if (message.level < LogLevel::CRITICAL) {
+    if (log_deferrer != nullptr && log_deferrer(message))
+      return;
+  } else {
+    flush_logs();
+  }
+
+  write_message(message);
+}
+
 void vlog(LogLevel level,
           const char* message,
+          const detail::FormatSegment* segments,
+          size_t segments_count,
           std::source_location source_location,
           const detail::Argument* args,
           size_t args_count) {
   if (level < current_log_level)
     return;
 
-  for (auto* logger : loggers) {
-    if (logger == nullptr)
-      continue;
-    vlog_logger(logger, level, message, source_location, args, args_count);
-  }
+  LogMessage log_message = {};
+  log_message.level = level;
+  log_message.has_time = log_timer != nullptr;
+  log_message.time_in_ms = log_message.has_time ? log_timer() : 0;
+  log_message.format = message;
+  log_message.segments = segments;
+  log_message.segments_count = segments_count;
+  log_message.file_name = source_location.file_name();
+  log_message.line = source_location.line();
+  log_message.args = args;
+  log_message.args_count = args_count;
+  emit_message(log_message);
 
   if (level >= LogLevel::CRITICAL) {
     panic("A critical log message was emitted", source_location);
   }
 }
 
-void vprint(const char* message, const detail::Argument* args, size_t args_count) {
-  static constexpr size_t MAX_BUFFER_SIZE = 1024;
-  char buffer[MAX_BUFFER_SIZE];
-
-  char* it = detail::format_to(buffer, message, args, args_count);
-  *it = '\0';
-
-  for (auto* logger : loggers) {
-    if (logger == nullptr)
-      continue;
-
-    logger->writeln(buffer, (size_t)((intptr_t)it - (intptr_t)buffer));
-  }
+void vprint(const char* message,
+            const detail::FormatSegment* segments,
+            size_t segments_count,
+            const detail::Argument* args,
+            size_t args_count) {
+  LogMessage log_message = {};
+  log_message.level = LogLevel::INFO;
+  log_message.is_print = true;
+  log_message.format = message;
+  log_message.segments = segments;
+  log_message.segments_count = segments_count;
+  log_message.args = args;
+  log_message.args_count = args_count;
+  emit_message(log_message);
 }
 }  // namespace detail
 
@@ -97,6 +128,19 @@ void set_log_timer(LogTimer timer_in_ms) {
   log_timer = timer_in_ms;
 }
 
+void set_log_deferrer(LogDeferrer deferrer, LogFlusher flusher) {
+  log_deferrer = deferrer;
+  log_flusher = flusher;
+}
+
+void flush_logs() {
+  LogFlusher flusher = log_flusher;
+  log_deferrer = nullptr;
+  log_flusher = nullptr;
+  if (flusher != nullptr)
+    flusher();
+}
+
 void register_logger(Logger& logger) {
   for (auto& entry : loggers) {
     if (entry == nullptr) {
@@ -0,0 +1,205 @@
+#include "libk/lz4.hpp"
+#include "libk/assert.hpp"
+#include "libk/string.hpp"
+#include "libk/utils.hpp"
+
+/*
+ * A LZ4 block is a list of sequences: a token (the literals count in its high nibble, the match length minus
+ * MIN_MATCH in its low nibble, 15 meaning that more length bytes follow), the literals, then the match as a
+ * 16-bit little endian offset back into the decompressed data. The last sequence only has literals.
+ */
+
+namespace libk {
+static constexpr size_t MIN_MATCH = 4;
+// The format requires the last bytes to be literals, and the last match to start before the last MF_LIMIT bytes.
+static constexpr size_t LAST_LITERALS = 5;
+static constexpr size_t MF_LIMIT = 12;
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr size_t HASH_LOG = 10;
+
+static uint32_t read32(const uint8_t* data) {
+  uint32_t value;
+  libk::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static size_t hash_sequence(uint32_t sequence) {
+  return (sequence * UINT32_C(2654435761)) >> (32 - HASH_LOG);
+}
+
+/** Writes the part of a length not held by its token nibble: bytes of 255, then the remainder. */
+static bool write_length(uint8_t** out, const uint8_t* out_end, size_t length) {
+  for (; length >= 255; length -= 255) {
+    if (*out == out_end)
+      return false;
+    *(*out)++ = 255;
+  }
+
+  if (*out == out_end)
+    return false;
+  *(*out)++ = (uint8_t)length;
+  return true;
+}
+
+/** Writes a sequence of @a nb_literals @a literals, followed by a match of @a match_length bytes at @a offset
+ * unless @a offset is 0 (the last sequence). */
+static bool write_sequence(uint8_t** out,
+                           const uint8_t* out_end,
+                           const uint8_t* literals,
+                           size_t nb_literals,
+                           size_t offset,
+                           size_t match_length) {
+  if (*out == out_end)
+    return false;
+
+  uint8_t* token = (*out)++;
+  const size_t match_code = offset != 0 ? match_length - MIN_MATCH : 0;
+  *token = (uint8_t)((libk::min(nb_literals, (size_t)15) << 4) | libk::min(match_code, (size_t)15));
+
+  if (nb_literals >= 15 && !write_length(out, out_end, nb_literals - 15))
+    return false;
+
+  if ((size_t)(out_end - *out) < nb_literals)
+    return false;
+  libk::memcpy(*out, literals, nb_literals);
+  *out += nb_literals;
+
+  if (offset == 0)
+    return true;
+
+  if (out_end - *out < 2)
+    return false;
+  *(*out)++ = (uint8_t)offset;
+  *(*out)++ = (uint8_t)(offset >> 8);
+  return match_code < 15 || write_length(out, out_end, match_code - 15);
+}
+
+size_t lz4_compress(const void* src, size_t src_size, void* dst, size_t dst_capacity) {
+  KASSERT(src_size <= LZ4_MAX_INPUT_SIZE);
+  const auto* in = (const uint8_t*)src;
+  auto* out = (uint8_t*)dst;
+  const uint8_t* out_end = out + dst_capacity;
+
+  // The last position where each hashed 4-byte sequence was seen (the candidate matches are checked).
+  uint16_t table[1 << HASH_LOG] = {};
+
+  size_t anchor = 0;  // the first literal not written yet
+  size_t pos = 0;
+  if (src_size > MF_LIMIT) {
+    const size_t match_limit = src_size - MF_LIMIT;
+    while (pos < match_limit) {
+      const uint32_t sequence = read32(in + pos);
+      uint16_t& entry = table[hash_sequence(sequence)];
+      const size_t candidate = entry;
+      entry = (uint16_t)pos;
+
+      if (candidate >= pos || pos - candidate > MAX_OFFSET || read32(in + candidate) != sequence) {
+        ++pos;
+        continue;
+      }
+
+      size_t length = MIN_MATCH;
+      const size_t max_length = src_size - LAST_LITERALS - pos;
+      while (length < max_length && in[candidate + length] == in[pos + length])
+        ++length;
+
+      if (!write_sequence(&out, out_end, in + anchor, pos - anchor, pos - candidate, length))
+        return 0;
+
+      pos += length;
+      anchor = pos;
+    }
+  }
+
+  if (!write_sequence(&out, out_end, in + anchor, src_size - anchor, 0, 0))
+    return 0;
+
+  return out - (uint8_t*)dst;
+}
+
+/** Reads the part of a length following its token nibble, adding it to @a length. */
+static bool read_length(const uint8_t** in, const uint8_t* in_end, size_t* length) {
+  uint8_t byte;
+  do {
+    if (*in == in_end)
+      return false;
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+
+  return true;
+}
+
+bool lz4_decompress(const void* src, size_t src_size, void* dst, size_t dst_size) {
+  const auto* in = (const uint8_t*)src;
+  const uint8_t* in_end = in + src_size;
+  auto* out = (uint8_t*)dst;
+  const uint8_t* out_end = out + dst_size;
+
+  while (in < in_end) {
+    const uint8_t token = *in++;
+
+    size_t nb_literals = token >> 4;
+    if (nb_literals == 15 && !read_length(&in, in_end, &nb_literals))
+      return false;
+
+    if (nb_literals > (size_t)(in_end - in) || nb_literals > (size_t)(out_end - out))
+      return false;
+    libk::memcpy(out, in, nb_literals);
+    in += nb_literals;
+    out += nb_literals;
+
+    // The last sequence has no match.
+    if (in == in_end)
+      break;
+
+    if (in_end - in < 2)
+      return false;
+    const size_t offset = in[0] | ((size_t)in[1] << 8);
+    in += 2;
+    if (offset == 0 || offset > (size_t)(out - (uint8_t*)dst))
+      return false;
+
+    size_t length = token & 15;
+    if (length == 15 && !read_length(&in, in_end, &length))
+      return false;
+    length += MIN_MATCH;
+    if (length > (size_t)(out_end - out))
+      return false;
+
+    // Byte by byte: the match may overlap the bytes it produces (a repeated pattern).
+    const uint8_t* match = out - offset;
+    for (size_t i = 0; i < length; ++i)
+      out[i] = match[i];
+    out += length;
+  }
+
+  return out == out_end;
+}
+}  // namespace libk
+
+/*
+ * Testing
+ */
+
+#include <libk/test.hpp>
+
+TEST("libk.lz4") {
+  static uint8_t data[512];
+  for (size_t i = 0; i < sizeof(data); ++i)
+    data[i] = (i < 200) ? (uint8_t)(i % 7) : (uint8_t)(i * 31 + (i >> 3));
+
+  static uint8_t compressed[600];
+  const size_t compressed_size = libk::lz4_compress(data, sizeof(data), compressed, sizeof(compressed));
+  ASSERT_NE(compressed_size, 0);
+
+  static uint8_t decompressed[512];
+  EXPECT_TRUE(libk::lz4_decompress(compressed, compressed_size, decompressed, sizeof(decompressed)));
+  EXPECT_EQ(libk::memcmp(data, decompressed, sizeof(data)), 0);
+  EXPECT_FALSE(libk::lz4_decompress(compressed, compressed_size, decompressed, sizeof(decompressed) - 1));
+
+  // A page of zeroes takes a few bytes, and does not fit in them.
+  static uint8_t zeroes[4096] = {};
+  EXPECT_LT(libk::lz4_compress(zeroes, sizeof(zeroes), compressed, sizeof(compressed)), 32);
+  EXPECT_EQ(libk::lz4_compress(zeroes, sizeof(zeroes), compressed, 4), 0);
+}
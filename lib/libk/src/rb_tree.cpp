@@ -0,0 +1,254 @@
+#include "libk/rb_tree.hpp"
+
+namespace libk::rb_tree_impl {
+/** Replaces the subtree of @a node by the one of @a replacement (which may be nullptr) in its parent. */
+static void replace_child(RbTreeHook** root, RbTreeHook* node, RbTreeHook* replacement) {
+  if (node->parent == nullptr) {
+    *root = replacement;
+  } else if (node == node->parent->left) {
+    node->parent->left = replacement;
+  } else {
+    node->parent->right = replacement;
+  }
+
+  if (replacement != nullptr)
+    replacement->parent = node->parent;
+}
+
+static void rotate_left(RbTreeHook** root, RbTreeHook* node) {
+  RbTreeHook* pivot = node->right;
+  node->right = pivot->left;
+  if (pivot->left != nullptr)
+    pivot->left->parent = node;
+
+  replace_child(root, node, pivot);
+  pivot->left = node;
+  node->parent = pivot;
+}
+
+static void rotate_right(RbTreeHook** root, RbTreeHook* node) {
+  RbTreeHook* pivot = node->left;
+  node->left = pivot->right;
+  if (pivot->right != nullptr)
+    pivot->right->parent = node;
+
+  replace_child(root, node, pivot);
+  pivot->right = node;
+  node->parent = pivot;
+}
+
+static bool is_red(const RbTreeHook* node) {
+  return node != nullptr && node->is_red;
+}
+
+void insert_fixup(RbTreeHook** root, RbTreeHook* node) {
+  node->is_red = true;
+
+  // The root is black, so a red parent always has a parent.
+  while (is_red(node->parent)) {
+    RbTreeHook* parent = node->parent;
+    RbTreeHook* grandparent = parent->parent;
+    const bool is_left = parent == grandparent->left;
+    RbTreeHook* uncle = is_left ? grandparent->right : grandparent->left;
+
+    if (is_red(uncle)) {
+      parent->is_red = false;
+      uncle->is_red = false;
+      grandparent->is_red = true;
+      node = grandparent;
+      continue;
+    }
+
+    // Move the node to the outside, then rotate the grandparent.
+    if (node == (is_left ? parent->right : parent->left)) {
+      node = parent;
+      is_left ? rotate_left(root, node) : rotate_right(root, node);
+      parent = node->parent;
+    }
+
+    parent->is_red = false;
+    grandparent->is_red = true;
+    is_left ? rotate_right(root, grandparent) : rotate_left(root, grandparent);
+  }
+
+  (*root)->is_red = false;
+}
+
+/** Restores the black heights after a black node was removed above @a node (maybe nullptr), child of @a parent. */
+static void erase_fixup(RbTreeHook** root, RbTreeHook* node, RbTreeHook* parent) {
+  while (node != *root && !is_red(node)) {
+    // The sibling exists: its subtree has one more black node than the one of the node.
+    const bool is_left = node == parent->left;
+    RbTreeHook* sibling = is_left ? parent->right : parent->left;
+
+    if (sibling->is_red) {
+      sibling->is_red = false;
+      parent->is_red = true;
+      is_left ? rotate_left(root, parent) : rotate_right(root, parent);
+      sibling = is_left ? parent->right : parent->left;
+    }
+
+    RbTreeHook* outer = is_left ? sibling->right : sibling->left;
+    RbTreeHook* inner = is_left ? sibling->left : sibling->right;
+    if (!is_red(outer) && !is_red(inner)) {
+      sibling->is_red = true;
+      node = parent;
+      parent = node->parent;
+      continue;
+    }
+
+    if (!is_red(outer)) {
+      inner->is_red = false;
+      sibling->is_red = true;
+      is_left ? rotate_right(root, sibling) : rotate_left(root, sibling);
+      sibling = is_left ? parent->right : parent->left;
+      outer = is_left ? sibling->right : sibling->left;
+    }
+
+    sibling->is_red = parent->is_red;
+    parent->is_red = false;
+    outer->is_red = false;
+    is_left ? rotate_left(root, parent) : rotate_right(root, parent);
+    node = *root;
+  }
+
+  if (node != nullptr)
+    node->is_red = false;
+}
+
+void erase(RbTreeHook** root, RbTreeHook* node) {
+  RbTreeHook* child;
+  RbTreeHook* child_parent;
+  bool removed_red;
+
+  if (node->left == nullptr || node->right == nullptr) {
+    child = node->left != nullptr ? node->left : node->right;
+    child_parent = node->parent;
+    removed_red = node->is_red;
+    replace_child(root, node, child);
+  } else {
+    // Replace the node by its successor, which has no left child.
+    RbTreeHook* successor = node->right;
+    while (successor->left != nullptr)
+      successor = successor->left;
+
+    child = successor->right;
+    removed_red = successor->is_red;
+    if (successor->parent == node) {
+      child_parent = successor;
+    } else {
+      child_parent = successor->parent;
+      replace_child(root, successor, child);
+      successor->right = node->right;
+      successor->right->parent = successor;
+    }
+
+    replace_child(root, node, successor);
+    successor->left = node->left;
+    successor->left->parent = successor;
+    successor->is_red = node->is_red;
+  }
+
+  if (!removed_red)
+    erase_fixup(root, child, child_parent);
+}
+
+RbTreeHook* next(RbTreeHook* node) {
+  if (node->right != nullptr) {
+    node = node->right;
+    while (node->left != nullptr)
+      node = node->left;
+    return node;
+  }
+
+  while (node->parent != nullptr && node == node->parent->right)
+    node = node->parent;
+  return node->parent;
+}
+}  // namespace libk::rb_tree_impl
+
+/*
+ * Testing
+ */
+
+#include <libk/test.hpp>
+
+namespace {
+struct TestItem {
+  uint32_t key;
+  libk::RbTreeHook hook;
+};  // struct TestItem
+
+struct TestItemLess {
+  bool operator()(const TestItem& a, const TestItem& b) const { return a.key < b.key; }
+};  // struct TestItemLess
+
+using TestTree = libk::IntrusiveRbTree<TestItem, &TestItem::hook, TestItemLess>;
+
+/** Returns the black height of @a node, or -1 if a red node has a red child or if the heights differ. */
+int check_subtree(const libk::RbTreeHook* node) {
+  if (node == nullptr)
+    return 0;
+
+  const bool has_red_child = (node->left != nullptr && node->left->is_red) ||
+                             (node->right != nullptr && node->right->is_red);
+  if (node->is_red && has_red_child)
+    return -1;
+
+  const int left = check_subtree(node->left);
+  const int right = check_subtree(node->right);
+  if (left < 0 || left != right)
+    return -1;
+  return left + (node->is_red ? 0 : 1);
+}
+
+/** Checks that @a tree is sorted and balanced, and holds @a count items. */
+bool check_tree(const TestTree& tree, size_t count) {
+  const TestItem* first = tree.first();
+  if (first == nullptr)
+    return count == 0;
+
+  const libk::RbTreeHook* root = &first->hook;
+  while (root->parent != nullptr)
+    root = root->parent;
+
+  size_t nb_items = 0;
+  uint32_t previous = 0;
+  for (TestItem* item = tree.first(); item != nullptr; item = tree.next(item)) {
+    if (item->key < previous)
+      return false;
+    previous = item->key;
+    nb_items++;
+  }
+
+  return !root->is_red && check_subtree(root) > 0 && nb_items == count;
+}
+}  // namespace
+
+TEST("libk.rb_tree") {
+  static TestItem items[256];
+  TestTree tree;
+  EXPECT_TRUE(tree.is_empty());
+
+  // A permutation of the keys, with duplicates.
+  for (size_t i = 0; i < 256; ++i) {
+    items[i].key = (uint32_t)((i * 97) % 128);
+    tree.insert(&items[i]);
+  }
+
+  EXPECT_TRUE(check_tree(tree, 256));
+  EXPECT_EQ(tree.first()->key, 0u);
+
+  // Remove every other item, including the first one.
+  for (size_t i = 0; i < 256; i += 2)
+    tree.remove(&items[i]);
+
+  EXPECT_TRUE(check_tree(tree, 128));
+  EXPECT_FALSE(items[0].hook.is_linked());
+
+  for (size_t i = 1; i < 256; i += 2)
+    tree.remove(&items[i]);
+
+  EXPECT_TRUE(tree.is_empty());
+  EXPECT_EQ(tree.first(), nullptr);
+}
@@ -1,4 +1,330 @@
 #include "libk/string.hpp"
+#include "libk/cpu_features.hpp"
+#include "libk/utils.hpp"
+
+namespace libk {
+/*
+ * The memory is accessed by whole aligned words (unaligned accesses are forbidden, see -mstrict-align).
+ * The words may alias any other type.
+ */
+using Word64 = uint64_t __attribute__((__may_alias__));
+using Word32 = uint32_t __attribute__((__may_alias__));
+using Word16 = uint16_t __attribute__((__may_alias__));
+
+/** Below this byte length, the functions go byte by byte (the alignment handling is not worth it). */
+static constexpr size_t SMALL_LENGTH = 16;
+
+static constexpr uint64_t ONES = 0x0101010101010101;
+static constexpr uint64_t HIGHS = 0x8080808080808080;
+
+static inline bool is_aligned(const void* ptr, size_t alignment) {
+  return ((uintptr_t)ptr & (alignment - 1)) == 0;
+}
+
+/** Checks if one of the bytes of @a word is zero. */
+static inline bool has_zero_byte(uint64_t word) {
+  return ((word - ONES) & ~word & HIGHS) != 0;
+}
+
+/** Gets the biggest word size on which @a dst and @a src can be both aligned. */
+static inline size_t get_common_alignment(const void* dst, const void* src) {
+  const uintptr_t diff = (uintptr_t)dst ^ (uintptr_t)src;
+  if ((diff & 7) == 0)
+    return 8;
+  if ((diff & 3) == 0)
+    return 4;
+  if ((diff & 1) == 0)
+    return 2;
+  return 1;
+}
+
+/** Copies forward the most of the @a length bytes by words of type T, @a dst and @a src are aligned on T. */
+template <class T>
+static inline void copy_forward(unsigned char*& dst, const unsigned char*& src, size_t& length) {
+  auto* d = (T*)dst;
+  const auto* s = (const T*)src;
+
+  // Four words by iteration, the compiler does them as ldp/stp pairs.
+  for (; length >= 4 * sizeof(T); length -= 4 * sizeof(T)) {
+    const T w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+    d[0] = w0;
+    d[1] = w1;
+    d[2] = w2;
+    d[3] = w3;
+    d += 4;
+    s += 4;
+  }
+
+  for (; length >= sizeof(T); length -= sizeof(T))
+    *d++ = *s++;
+
+  dst = (unsigned char*)d;
+  src = (const unsigned char*)s;
+}
+
+/** Same as copy_forward() but from the end: @a dst and @a src point past the bytes to copy. */
+template <class T>
+static inline void copy_backward(unsigned char*& dst, const unsigned char*& src, size_t& length) {
+  auto* d = (T*)dst;
+  const auto* s = (const T*)src;
+
+  for (; length >= 4 * sizeof(T); length -= 4 * sizeof(T)) {
+    d -= 4;
+    s -= 4;
+    const T w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+    d[3] = w3;
+    d[2] = w2;
+    d[1] = w1;
+    d[0] = w0;
+  }
+
+  for (; length >= sizeof(T); length -= sizeof(T))
+    *--d = *--s;
+
+  dst = (unsigned char*)d;
+  src = (const unsigned char*)s;
+}
+
+size_t detail::strlen_by_words(const char* text) {
+  const char* p = text;
+  while (!is_aligned(p, sizeof(Word64))) {
+    if (*p == '\0')
+      return p - text;
+    ++p;
+  }
+
+  // An aligned word never crosses a page, so reading past the end of the text is harmless.
+  const auto* w = (const Word64*)p;
+  while (!has_zero_byte(*w))
+    ++w;
+
+  p = (const char*)w;
+  while (*p != '\0')
+    ++p;
+  return p - text;
+}
+
+void* memchr(const void* ptr, int value, size_t length) {
+  const auto* p = (const unsigned char*)ptr;
+  const auto byte = (unsigned char)value;
+
+  if (length >= SMALL_LENGTH) {
+    for (; !is_aligned(p, sizeof(Word64)); --length, ++p) {
+      if (*p == byte)
+        return (void*)p;
+    }
+
+    // Skip the words without the byte, the matching word is then scanned byte by byte.
+    const uint64_t pattern = byte * ONES;
+    const auto* w = (const Word64*)p;
+    for (; length >= sizeof(Word64) && !has_zero_byte(*w ^ pattern); length -= sizeof(Word64))
+      ++w;
+    p = (const unsigned char*)w;
+  }
+
+  for (; length > 0; --length, ++p) {
+    if (*p == byte)
+      return (void*)p;
+  }
+
+  return nullptr;
+}
+
+int memcmp(const void* lhs, const void* rhs, size_t length) {
+  const auto* p1 = (const unsigned char*)lhs;
+  const auto* p2 = (const unsigned char*)rhs;
+
+  if (length >= SMALL_LENGTH && get_common_alignment(p1, p2) == sizeof(Word64)) {
+    for (; !is_aligned(p1, sizeof(Word64)); --length, ++p1, ++p2) {
+      if (*p1 != *p2)
+        return *p1 - *p2;
+    }
+
+    // Skip the equal words, the first different word is then compared byte by byte.
+    const auto* w1 = (const Word64*)p1;
+    const auto* w2 = (const Word64*)p2;
+    for (; length >= sizeof(Word64) && *w1 == *w2; length -= sizeof(Word64)) {
+      ++w1;
+      ++w2;
+    }
+
+    p1 = (const unsigned char*)w1;
+    p2 = (const unsigned char*)w2;
+  }
+
+  for (; length > 0; --length, ++p1, ++p2) {
+    if (*p1 != *p2)
+      return *p1 - *p2;
+  }
+
+  return 0;
+}
+
+void* memset(void* dst, int value, size_t length) {
+  auto* d = (unsigned char*)dst;
+  const auto byte = (unsigned char)value;
+
+  if (length >= SMALL_LENGTH) {
+    for (; !is_aligned(d, sizeof(Word64)); --length)
+      *d++ = byte;
+
+    const uint64_t pattern = byte * ONES;
+    auto* w = (Word64*)d;
+    for (; length >= 4 * sizeof(Word64); length -= 4 * sizeof(Word64)) {
+      w[0] = pattern;
+      w[1] = pattern;
+      w[2] = pattern;
+      w[3] = pattern;
+      w += 4;
+    }
+
+    for (; length >= sizeof(Word64); length -= sizeof(Word64))
+      *w++ = pattern;
+    d = (unsigned char*)w;
+  }
+
+  while (length-- > 0)
+    *d++ = byte;
+  return dst;
+}
+
+uint32_t* memset32(uint32_t* dst, uint32_t value, size_t count) {
+  uint32_t* d = dst;
+
+  if (count >= SMALL_LENGTH / sizeof(uint32_t)) {
+    if (!is_aligned(d, sizeof(Word64))) {
+      *d++ = value;
+      --count;
+    }
+
+    const uint64_t pattern = value | ((uint64_t)value << 32);
+    auto* w = (Word64*)d;
+    for (; count >= 4 * 2; count -= 4 * 2) {
+      w[0] = pattern;
+      w[1] = pattern;
+      w[2] = pattern;
+      w[3] = pattern;
+      w += 4;
+    }
+
+    for (; count >= 2; count -= 2)
+      *w++ = pattern;
+    d = (uint32_t*)w;
+  }
+
+  while (count-- > 0)
+    *d++ = value;
+  return dst;
+}
+
+void* memcpy(void* dst, const void* src, size_t length) {
+  auto* d = (unsigned char*)dst;
+  const auto* s = (const unsigned char*)src;
+
+  if (length >= SMALL_LENGTH) {
+    // The source and the destination can only be aligned together on the low bits they have in common.
+    const size_t alignment = get_common_alignment(d, s);
+    for (; !is_aligned(d, alignment); --length)
+      *d++ = *s++;
+
+    switch (alignment) {
+      case 8:
+        copy_forward<Word64>(d, s, length);
+        break;
+      case 4:
+        copy_forward<Word32>(d, s, length);
+        break;
+      case 2:
+        copy_forward<Word16>(d, s, length);
+        break;
+      default:
+        break;
+    }
+  }
+
+  while (length-- > 0)
+    *d++ = *s++;
+  return dst;
+}
+
+void* memmove(void* dst, const void* src, size_t length) {
+  auto* d = (unsigned char*)dst;
+  const auto* s = (const unsigned char*)src;
+
+  // A forward copy never overwrites the source bytes not yet read when the destination is before.
+  if (d <= s || d >= s + length) {
+    return memcpy(dst, src, length);
+  }
+
+  d += length;
+  s += length;
+
+  if (length >= SMALL_LENGTH) {
+    const size_t alignment = get_common_alignment(d, s);
+    for (; !is_aligned(d, alignment); --length)
+      *--d = *--s;
+
+    switch (alignment) {
+      case 8:
+        copy_backward<Word64>(d, s, length);
+        break;
+      case 4:
+        copy_backward<Word32>(d, s, length);
+        break;
+      case 2:
+        copy_backward<Word16>(d, s, length);
+        break;
+      default:
+        break;
+    }
+  }
+
+  while (length-- > 0)
+    *--d = *--s;
+  return dst;
+}
+
+static const LargeCopyEngine* g_large_copy_engine = nullptr;
+
+void set_large_copy_engine(const LargeCopyEngine* engine) {
+  g_large_copy_engine = engine;
+}
+
+void* memcpy_large(void* dst, const void* src, size_t length) {
+  if (length < get_cpu_features().large_copy_threshold || g_large_copy_engine == nullptr ||
+      !g_large_copy_engine->copy(dst, src, length)) {
+    memcpy(dst, src, length);
+  }
+
+  return dst;
+}
+
+void* memset_large(void* dst, int value, size_t length) {
+  auto* p = (unsigned char*)dst;
+
+  // The engine only fills whole aligned words, the unaligned head and tail are done by the CPU.
+  const size_t head = libk::min(length, (size_t)(-(uintptr_t)p & (sizeof(uint32_t) - 1)));
+  memset(p, value, head);
+  p += head;
+  length -= head;
+
+  const uint32_t pattern = (unsigned char)value * 0x01010101u;
+  const size_t body = length & ~(sizeof(uint32_t) - 1);
+  memset32_large((uint32_t*)p, pattern, body / sizeof(uint32_t));
+  memset(p + body, value, length - body);
+  return dst;
+}
+
+uint32_t* memset32_large(uint32_t* dst, uint32_t value, size_t count) {
+  const size_t length = count * sizeof(uint32_t);
+  if (length < get_cpu_features().large_copy_threshold || g_large_copy_engine == nullptr ||
+      !g_large_copy_engine->fill(dst, value, length)) {
+    memset32(dst, value, count);
+  }
+
+  return dst;
+}
+}  // namespace libk
 
 /*
  * Start of the C API:
@@ -56,6 +382,7 @@ extern "C" void* memmove(void* dst, const void* src, size_t length) {
  * Testing
  */
 
+#include <libk/benchmark.hpp>
 #include <libk/test.hpp>
 
 TEST("libk.strlen") {
@@ -101,6 +428,16 @@ TEST("libk.memset") {
   EXPECT_EQ(buffer[3], 4);
 }
 
+TEST("libk.memset32") {
+  alignas(8) uint32_t buffer[21] = {};
+  // Start on a word not aligned to 8 bytes, so both the head and the tail are stored alone.
+  libk::memset32(buffer + 1, 0xdeadbeef, 19);
+  EXPECT_EQ(buffer[0], 0u);
+  for (size_t i = 1; i < 20; ++i)
+    EXPECT_EQ(buffer[i], 0xdeadbeef);
+  EXPECT_EQ(buffer[20], 0u);
+}
+
 TEST("libk.bzero") {
   char buffer[] = {1, 2, 3, 4};
   libk::bzero(buffer, sizeof(char) * 3);
@@ -119,3 +456,83 @@ TEST("libk.memcpy") {
   EXPECT_EQ(dst[2], 3);
   EXPECT_EQ(dst[3], 13);
 }
+
+// The byte by byte versions, as reference.
+static void* byte_memcpy(void* dst, const void* src, size_t length) {
+  auto* d = (volatile unsigned char*)dst;
+  const auto* s = (const unsigned char*)src;
+  while (length-- > 0)
+    *d++ = *s++;
+  return dst;
+}
+
+static void* byte_memset(void* dst, int value, size_t length) {
+  auto* d = (volatile unsigned char*)dst;
+  while (length-- > 0)
+    *d++ = (unsigned char)value;
+  return dst;
+}
+
+static unsigned char g_test_src[16384 + 16];
+static unsigned char g_test_dst[16384 + 16];
+
+TEST("libk.memcpy.alignments") {
+  for (size_t i = 0; i < sizeof(g_test_src); ++i)
+    g_test_src[i] = (unsigned char)(i * 7 + 3);
+
+  for (size_t src_offset = 0; src_offset < 8; ++src_offset) {
+    for (size_t dst_offset = 0; dst_offset < 8; ++dst_offset) {
+      for (size_t length = 0; length < 80; length += 3) {
+        libk::memset(g_test_dst, 0xaa, 128);
+        libk::memcpy(g_test_dst + dst_offset, g_test_src + src_offset, length);
+        EXPECT_EQ(libk::memcmp(g_test_dst + dst_offset, g_test_src + src_offset, length), 0);
+        EXPECT_EQ(g_test_dst[dst_offset + length], 0xaa);
+        EXPECT_TRUE(dst_offset == 0 || g_test_dst[dst_offset - 1] == 0xaa);
+      }
+    }
+  }
+}
+
+TEST("libk.memmove.overlap") {
+  for (size_t offset = 0; offset < 24; ++offset) {
+    for (size_t i = 0; i < 128; ++i)
+      g_test_dst[i] = (unsigned char)i;
+
+    // Moves forward then backward, the bytes must come back at their place.
+    libk::memmove(g_test_dst + offset, g_test_dst, 64);
+    EXPECT_EQ(g_test_dst[offset + 63], 63);
+    libk::memmove(g_test_dst, g_test_dst + offset, 64);
+    for (size_t i = 0; i < 64; ++i)
+      EXPECT_EQ(g_test_dst[i], i);
+  }
+}
+
+TEST("libk.memchr.words") {
+  libk::memset(g_test_src, 'a', 100);
+  g_test_src[100] = '\0';
+  g_test_src[77] = 'b';
+  EXPECT_EQ(libk::memchr(g_test_src + 3, 'b', 97), g_test_src + 77);
+  EXPECT_EQ(libk::memchr(g_test_src + 3, 'b', 50), nullptr);
+  EXPECT_EQ(libk::strlen((const char*)g_test_src + 5), 95);
+  EXPECT_GT(libk::memcmp(g_test_src + 1, g_test_src, 100), 0);
+}
+
+BENCHMARK("libk.memcpy.4096") {
+  while (state.keep_running())
+    libk::memcpy(g_test_dst, g_test_src, 4096);
+}
+
+BENCHMARK("libk.memcpy.4096.byte_by_byte") {
+  while (state.keep_running())
+    byte_memcpy(g_test_dst, g_test_src, 4096);
+}
+
+BENCHMARK("libk.memset.4096") {
+  while (state.keep_running())
+    libk::memset(g_test_dst, 0, 4096);
+}
+
+BENCHMARK("libk.memset.4096.byte_by_byte") {
+  while (state.keep_running())
+    byte_memset(g_test_dst, 0, 4096);
+}
@@ -8,6 +8,9 @@ __SYS_EXTERN_C_BEGIN
 
 void* malloc(size_t __n);
 void free(void*);
+void* calloc(size_t __count, size_t __n);
+void* realloc(void* __ptr, size_t __n);
+void* aligned_alloc(size_t __alignment, size_t __n);
 
 #define RAND_MAX INT32_MAX
 void srand(unsigned int __seed);
@@ -0,0 +1,120 @@
+#ifndef __PIKAOS_LIBC_SYS_CHANNEL_H__
+#define __PIKAOS_LIBC_SYS_CHANNEL_H__
+
+#include "__types.h"
+#include "__utils.h"
+
+__SYS_EXTERN_C_BEGIN
+
+/* Inter-process message channels API.
+ *
+ * A channel links two processes: the one that created it under a name, and the first one that connected to
+ * that name (the name is then free again). Each direction is a ring of messages in memory shared by both
+ * processes: a message is written in place by its sender and read in place by its receiver, without any
+ * copy by the kernel. The system calls are only made to block, when a ring is empty (or full), and to wake
+ * the peer blocked on it (the doorbell), which is only done when the peer flagged itself as waiting.
+ *
+ * The payloads larger than a message are sent as grants: memory allocated for a channel and mapped into the
+ * sender, whose pages are moved into the receiver when it accepts the grant (the sender loses access to
+ * them). The ID of a grant is usually sent in a message.
+ *
+ * The ring indices are free running (the message of an index is at index % SYS_CHANNEL_RING_SIZE), the head
+ * is advanced by the receiver of the ring and the tail by its sender. There is a single sender and a single
+ * receiver per direction: the threads using the same channel must serialize their calls. */
+#define SYS_CHANNEL_RING_SIZE 16
+/* The byte size of the payload stored in a message. */
+#define SYS_CHANNEL_MESSAGE_SIZE 240
+/* The maximum length of a channel name, the null terminator excluded. */
+#define SYS_CHANNEL_NAME_MAX 31
+/* The maximum byte size of a grant. */
+#define SYS_CHANNEL_GRANT_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct __sys_channel_message_t {
+  /* The byte size of the payload, at most SYS_CHANNEL_MESSAGE_SIZE. */
+  uint32_t size;
+  /* Free for the application (e.g. a message type). */
+  uint32_t tag;
+  /* The ID of a grant sent with the message, or 0. */
+  sys_word_t grant;
+  uint8_t data[SYS_CHANNEL_MESSAGE_SIZE];
+} sys_channel_message_t;
+
+typedef struct __sys_channel_ring_t {
+  uint32_t head;
+  uint32_t tail;
+  /* Set by the kernel when the receiver (resp. the sender) is blocked until the ring is not empty (resp. not
+   * full). The other side must then call sys_channel_notify() after updating the ring. */
+  uint32_t receiver_waiting;
+  uint32_t sender_waiting;
+  sys_channel_message_t messages[SYS_CHANNEL_RING_SIZE];
+} sys_channel_ring_t;
+
+typedef struct __sys_channel_t {
+  void* handle;
+  sys_channel_ring_t* send_ring;
+  sys_channel_ring_t* receive_ring;
+} sys_channel_t;
+
+/* Creates the channel named `name` and stores it into `channel`. Returns SYS_ERR_GENERIC if the name is
+ * already used by a channel not yet connected. */
+sys_error_t sys_channel_create(const char* name, sys_channel_t* channel);
+/* Connects to the channel named `name`, created by another process, and stores it into `channel`.
+ * Returns SYS_ERR_GENERIC if there is no such channel. */
+sys_error_t sys_channel_connect(const char* name, sys_channel_t* channel);
+/* Closes `channel`: its memory and its grants not yet accepted by the peer are unmapped. The peer then gets
+ * SYS_ERR_CHANNEL_CLOSED once it received all the messages. */
+void sys_channel_close(sys_channel_t* channel);
+
+/* Returns the next free message of the send ring, to be filled in place, or NULL (without blocking) if the
+ * ring is full. The message is sent by sys_channel_commit_send(). */
+sys_channel_message_t* sys_channel_prepare_send(sys_channel_t* channel);
+/* Sends the message returned by sys_channel_prepare_send(), waking the peer if it waits for it. */
+void sys_channel_commit_send(sys_channel_t* channel);
+/* Copies `size` bytes of `data` into a new message with `tag` and `grant` and sends it, blocking while the
+ * send ring is full. */
+sys_error_t sys_channel_send(sys_channel_t* channel, uint32_t tag, const void* data, size_t size, sys_word_t grant);
+
+/* Returns the oldest received message, to be read in place, or NULL (without blocking) if there is none.
+ * The message stays valid until sys_channel_release_receive(). */
+const sys_channel_message_t* sys_channel_peek_receive(sys_channel_t* channel);
+/* Frees the message returned by sys_channel_peek_receive(), waking the peer if it waits for room. */
+void sys_channel_release_receive(sys_channel_t* channel);
+/* Copies the oldest received message into `message`, blocking until there is one. */
+sys_error_t sys_channel_receive(sys_channel_t* channel, sys_channel_message_t* message);
+
+/* Blocks until the send ring is not full if `for_send` is true, or until the receive ring is not empty
+ * otherwise. Returns SYS_ERR_CHANNEL_CLOSED without blocking if the peer closed the channel. */
+sys_error_t sys_channel_wait(sys_channel_t* channel, sys_bool_t for_send);
+/* Wakes the peer blocked in sys_channel_wait(), the functions above call it when needed. */
+sys_error_t sys_channel_notify(sys_channel_t* channel);
+
+/* Synchronous calls API.
+ *
+ * For the request/response services: a call passes a short message in the registers, and the kernel
+ * switches directly from the caller to the task of the peer waiting for calls, then back to the caller
+ * with the reply. The calls do not use the rings. */
+#define SYS_CHANNEL_CALL_WORDS 4
+
+typedef struct __sys_channel_call_t {
+  sys_word_t words[SYS_CHANNEL_CALL_WORDS];
+} sys_channel_call_t;
+
+/* Sends the request `message` to the peer and blocks until it replies, the reply is then stored into
+ * `message`. The calls of the threads of a process are served in order. */
+sys_error_t sys_channel_call(sys_channel_t* channel, sys_channel_call_t* message);
+/* Replies `message` to the call being served (if any), then blocks until the next call whose request is
+ * stored into `message`. */
+sys_error_t sys_channel_reply_wait(sys_channel_t* channel, sys_channel_call_t* message);
+
+/* Allocates `size` bytes of zeroed memory for a grant, stores its address into `address` and its ID into
+ * `grant`. It is unmapped from the caller once the peer accepted it. */
+sys_error_t sys_channel_grant_alloc(sys_channel_t* channel, size_t size, void** address, sys_word_t* grant);
+/* Maps the memory of the `grant` sent by the peer, and stores its address into `address` and its byte size
+ * into `size` (if not NULL). Returns SYS_ERR_INVALID_ADDRESS if the grant is unknown or already accepted. */
+sys_error_t sys_channel_grant_accept(sys_channel_t* channel, sys_word_t grant, void** address, size_t* size);
+/* Unmaps and frees the memory of a grant at `address`, allocated or accepted by the caller. */
+sys_error_t sys_channel_grant_release(sys_channel_t* channel, void* address);
+
+__SYS_EXTERN_C_END
+
+#endif  // !__PIKAOS_LIBC_SYS_CHANNEL_H__
@@ -15,20 +15,139 @@ typedef struct sys_file_info_t {
   sys_bool_t is_dir;
 } sys_file_info_t;
 
+/* An entry written by sys_read_dir_many(). The next entry follows it, at `size` bytes from its start. */
+typedef struct __sys_dir_entry_t {
+  uint32_t size;
+  sys_bool_t is_dir;
+  uint64_t file_size;
+  /* NUL terminated. */
+  char name[];
+} sys_dir_entry_t;
+
+/* The flags of sys_read_dir_many(). */
+enum {
+  /* Writes only the names, as NUL terminated strings following each other (no sys_dir_entry_t). */
+  SYS_DIR_NAMES_ONLY = 0x1,
+};
+
+/* The alignment of the entries written by sys_read_dir_many(), and the size of a buffer that can hold
+ * any single entry. */
+#define SYS_DIR_ENTRY_ALIGNMENT 8
+#define SYS_DIR_ENTRY_MAX_SIZE (sizeof(sys_dir_entry_t) + 256)
+
 typedef enum sys_file_mode_t {
   SYS_FM_READ = 0x1,
   SYS_FM_WRITE = 0x2,
+  /* Creates the file if it does not exist. */
+  SYS_FM_CREATE = 0x4,
+  /* Creates the file, or empties it if it exists. */
+  SYS_FM_TRUNCATE = 0x8,
 } sys_file_mode_t;
 
 sys_file_t* sys_open_file(const char* path, sys_file_mode_t mode);
 void sys_close_file(sys_file_t* file);
 
 sys_error_t sys_file_read(sys_file_t* file, void* buffer, size_t bytes_to_read, size_t* read_bytes);
+/* Writes `bytes_to_write` bytes at the position of `file` (opened with SYS_FM_WRITE), and stores the written byte
+ * count into `wrote_bytes`. The writes are buffered: they reach the volume once the file is closed, by sys_sync()
+ * or by the periodic sync of the kernel. Returns SYS_ERR_GENERIC if the kernel has read-only volumes (without
+ * CONFIG_WRITABLE_FS), or if the volume is full. */
+sys_error_t sys_file_write(sys_file_t* file, const void* buffer, size_t bytes_to_write, size_t* wrote_bytes);
+/* Truncates `file` (opened with SYS_FM_WRITE) at its position. */
+sys_error_t sys_file_truncate(sys_file_t* file);
+/* Writes the data of all the opened files to the volumes. */
+sys_error_t sys_sync(void);
 size_t sys_get_file_size(sys_file_t* file);
+/* Moves the read position of `file` to `offset` bytes from its start (clamped to the file size).
+ * Seeking takes a constant time, whatever the file size and offset. */
+sys_error_t sys_file_seek(sys_file_t* file, size_t offset);
+/* Maps the whole content of `file` read-only at a page aligned address, stored into `address`. The pages
+ * are shared with the other processes mapping the file (without any copy for the files stored contiguously
+ * in the RAM disk). The mapping stays valid once the file is closed, it is released by sys_munmap().
+ * Empty files can not be mapped. */
+sys_error_t sys_mmap_file(sys_file_t* file, const void** address);
+
+/* A decoded image scaled down, see sys_get_thumbnail(). */
+typedef struct __sys_thumbnail_t {
+  /* The width x height pixels in 0x00RRGGBB format (the window surface format), the rows without padding. */
+  const uint32_t* pixels;
+  uint32_t width;
+  uint32_t height;
+} sys_thumbnail_t;
+
+/* Gets the image at `path` (QOI or JPEG) scaled down to fit a `max_width` x `max_height` box, keeping its aspect
+ * ratio (the smaller images are not scaled, the box is clamped to 512 x 512). The thumbnails are decoded once by
+ * the kernel and mapped read-only into the processes asking for the same image and box, the mapping is released
+ * by sys_munmap(`thumbnail->pixels`). Returns SYS_ERR_GENERIC if the file is not an image. */
+sys_error_t sys_get_thumbnail(const char* path, uint32_t max_width, uint32_t max_height, sys_thumbnail_t* thumbnail);
 
 sys_dir_t* sys_open_dir(const char* path);
 void sys_close_dir(sys_dir_t* dir);
 sys_error_t sys_read_dir(sys_dir_t* dir, sys_file_info_t* info);
+/* Reads as many of the next entries of `dir` as fit into `buffer` (of `buffer_size` bytes), and stores the
+ * written byte count into `read_size`. It is 0 once all the entries are read. SYS_ERR_GENERIC is returned
+ * if `buffer` can not even hold the next entry (SYS_DIR_ENTRY_MAX_SIZE bytes always can).
+ * The entries are sys_dir_entry_t, or only their names with the SYS_DIR_NAMES_ONLY flag. */
+sys_error_t sys_read_dir_many(sys_dir_t* dir, void* buffer, size_t buffer_size, uint32_t flags, size_t* read_size);
+
+/* Asynchronous file I/O API.
+ *
+ * The operations are queued into the submission ring of a sys_io_ring_t, shared with the kernel, and are
+ * executed in order by a kernel worker of the process while its threads go on. Their results are queued
+ * into the completion ring. Pushing and popping the entries are not system calls, only sys_io_enter() is.
+ *
+ * The ring indices are free running (the entry of an index is at index % SYS_IO_RING_SIZE), the head ones
+ * are advanced by the consumer of the ring and the tail ones by its producer. There is a single producer
+ * and a single consumer on the process side: the threads using the same ring must serialize their calls. */
+#define SYS_IO_RING_SIZE 32
+
+enum {
+  SYS_IO_OP_OPEN_FILE,     /* path, mode -> value: the sys_file_t* */
+  SYS_IO_OP_CLOSE_FILE,    /* handle */
+  SYS_IO_OP_READ_FILE,     /* handle, buffer, size -> value: the count of read bytes */
+  SYS_IO_OP_SEEK_FILE,     /* handle, size: the offset */
+  SYS_IO_OP_GET_FILE_SIZE, /* handle -> value: the file size */
+  SYS_IO_OP_OPEN_DIR,      /* path -> value: the sys_dir_t* */
+  SYS_IO_OP_CLOSE_DIR,     /* handle */
+  SYS_IO_OP_READ_DIR,      /* handle, buffer: a sys_file_info_t */
+};
+
+typedef struct __sys_io_submission_t {
+  uint32_t op;
+  uint32_t mode;
+  void* handle;
+  const char* path;
+  void* buffer;
+  size_t size;
+  /* Copied as is into the completion, to identify it. */
+  sys_word_t user_data;
+} sys_io_submission_t;
+
+typedef struct __sys_io_completion_t {
+  sys_word_t user_data;
+  sys_word_t value;
+  sys_error_t error;
+} sys_io_completion_t;
+
+typedef struct __sys_io_ring_t {
+  uint32_t submission_head;
+  uint32_t submission_tail;
+  uint32_t completion_head;
+  uint32_t completion_tail;
+  sys_io_submission_t submissions[SYS_IO_RING_SIZE];
+  sys_io_completion_t completions[SYS_IO_RING_SIZE];
+} sys_io_ring_t;
+
+/* Initializes `ring` and starts its worker. A process has at most one ring, its memory must stay valid
+ * until the process exits (the opened files and directories belong to the process, as usual). */
+sys_error_t sys_io_setup(sys_io_ring_t* ring);
+/* Queues `submission`, without notifying the worker. Returns false if the submission ring is full. */
+sys_bool_t sys_io_submit(sys_io_ring_t* ring, const sys_io_submission_t* submission);
+/* Notifies the worker of the queued submissions, then blocks until at least `min_completions` completions
+ * are queued or until all the submissions are completed. Does not block if `min_completions` is 0. */
+sys_error_t sys_io_enter(sys_io_ring_t* ring, uint32_t min_completions);
+/* Pops the oldest completion into `completion`. Returns false, without blocking, if there is none. */
+sys_bool_t sys_io_get_completion(sys_io_ring_t* ring, sys_io_completion_t* completion);
 
 __SYS_EXTERN_C_END
 
@@ -142,9 +142,12 @@ sys_bool_t sys_is_scroll_lock_on(sys_key_event_t event);
 sys_key_code_t sys_get_key_code(sys_key_event_t event);
 sys_bool_t sys_is_press_event(sys_key_event_t event);
 sys_bool_t sys_is_release_event(sys_key_event_t event);
+/* A repeat event is a press event generated by the kernel while the key is held. */
+sys_bool_t sys_is_repeat_event(sys_key_event_t event);
 
 sys_key_event_t sys_create_press_event(sys_key_code_t code, sys_key_modifiers_t mods);
 sys_key_event_t sys_create_release_event(sys_key_code_t code, sys_key_modifiers_t mods);
+sys_key_event_t sys_create_repeat_event(sys_key_code_t code, sys_key_modifiers_t mods);
 
 __SYS_EXTERN_C_END
 
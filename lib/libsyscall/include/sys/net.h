@@ -0,0 +1,117 @@
+#ifndef __PIKAOS_LIBC_SYS_NET_H__
+#define __PIKAOS_LIBC_SYS_NET_H__
+
+#include "__types.h"
+#include "__utils.h"
+
+__SYS_EXTERN_C_BEGIN
+
+/* Raw Ethernet frames API.
+ *
+ * The frames are sent and received whole, from their destination address to their payload: the CRC is added
+ * and checked by the controller, and the frames shorter than 60 bytes are padded when sent. Only the frames
+ * sent to the board address or broadcast are received. All the calls return SYS_ERR_GENERIC if the board has
+ * no (supported) Ethernet controller. */
+
+/* The maximum byte size of a frame. */
+#define SYS_NET_MAX_FRAME_SIZE 1514
+
+typedef struct __sys_net_info_t {
+  uint8_t mac_address[6];
+  /* In Mbit/s, 0 if the link is down. */
+  uint32_t link_speed;
+  uint64_t rx_frames;
+  /* The received frames dropped by the controller (erroneous) or by the kernel (not read in time). */
+  uint64_t rx_dropped;
+  uint64_t tx_frames;
+} sys_net_info_t;
+
+sys_error_t sys_net_get_info(sys_net_info_t* info);
+
+/* Sends the frame of `size` bytes at `frame`. Blocks while all the frames buffers of the kernel are being
+ * sent. */
+sys_error_t sys_net_send(const void* frame, size_t size);
+
+/* Receives the oldest frame into `buffer` of `capacity` bytes, and its byte size into `size`. Blocks until a
+ * frame is received. Returns SYS_ERR_GENERIC if the frame is larger than `capacity` (it is dropped). Only the
+ * frames not handled by the IPv4 stack (neither ARP nor IPv4) are received. */
+sys_error_t sys_net_receive(void* buffer, size_t capacity, size_t* size);
+
+/* IPv4 API.
+ *
+ * The addresses and the ports are in the native byte order, e.g. 0xc0a80001 for 192.168.0.1. The board has a
+ * link-local address (169.254.0.0/16) until configured. */
+typedef struct __sys_net_ipv4_config_t {
+  uint32_t address;
+  uint32_t netmask;
+  /* 0 if there is none. */
+  uint32_t gateway;
+} sys_net_ipv4_config_t;
+
+sys_error_t sys_net_get_ipv4_config(sys_net_ipv4_config_t* config);
+sys_error_t sys_net_set_ipv4_config(const sys_net_ipv4_config_t* config);
+
+/* UDP sockets API.
+ *
+ * A socket is bound to a local port. Its datagrams go through two rings in memory shared with the kernel, as
+ * the ones of the channels (see sys/channel.h): the kernel writes the received datagrams straight from the
+ * Ethernet frames into the receive ring, where they are read in place, and the datagrams written in place into
+ * the send ring are sent by sys_udp_flush(), the kernel copying them straight into the Ethernet frames. The
+ * datagrams are dropped when the receive ring is full. */
+#define SYS_UDP_RING_SIZE 32
+/* The maximum byte size of a datagram payload, fragments are not supported. */
+#define SYS_UDP_MAX_PAYLOAD 1472
+
+typedef struct __sys_udp_datagram_t {
+  /* The source of a received datagram, the destination of a datagram to send. */
+  uint32_t address;
+  uint16_t port;
+  /* The byte size of the payload, at most SYS_UDP_MAX_PAYLOAD. */
+  uint16_t size;
+  uint8_t data[SYS_UDP_MAX_PAYLOAD];
+} sys_udp_datagram_t;
+
+typedef struct __sys_udp_ring_t {
+  uint32_t head;
+  uint32_t tail;
+  /* Set by the kernel when the receiver is blocked until the receive ring is not empty. */
+  uint32_t receiver_waiting;
+  uint32_t reserved;
+  sys_udp_datagram_t datagrams[SYS_UDP_RING_SIZE];
+} sys_udp_ring_t;
+
+typedef struct __sys_udp_socket_t {
+  sys_word_t handle;
+  /* The local port. */
+  uint16_t port;
+  sys_udp_ring_t* send_ring;
+  sys_udp_ring_t* receive_ring;
+} sys_udp_socket_t;
+
+/* Opens a socket bound to the local `port` (or to a free one if 0) and stores it into `socket`. Returns
+ * SYS_ERR_GENERIC if the port is already used or if there is no network. */
+sys_error_t sys_udp_open(uint16_t port, sys_udp_socket_t* socket);
+/* Closes `socket`, its unsent datagrams are dropped. */
+void sys_udp_close(sys_udp_socket_t* socket);
+
+/* Returns the next free datagram of the send ring, to be filled in place, or NULL (without blocking) if the
+ * ring is full. The datagram is queued by sys_udp_commit_send() and sent by the next sys_udp_flush(). */
+sys_udp_datagram_t* sys_udp_prepare_send(sys_udp_socket_t* socket);
+void sys_udp_commit_send(sys_udp_socket_t* socket);
+/* Sends all the queued datagrams, blocking while all the Ethernet frames are being sent. */
+sys_error_t sys_udp_flush(sys_udp_socket_t* socket);
+/* Copies `size` bytes of `data` into a new datagram for `address`:`port` and sends it. */
+sys_error_t sys_udp_send(sys_udp_socket_t* socket, uint32_t address, uint16_t port, const void* data, size_t size);
+
+/* Returns the oldest received datagram, to be read in place, or NULL (without blocking) if there is none.
+ * The datagram stays valid until sys_udp_release_receive(). */
+const sys_udp_datagram_t* sys_udp_peek_receive(sys_udp_socket_t* socket);
+void sys_udp_release_receive(sys_udp_socket_t* socket);
+/* Blocks until the receive ring is not empty. */
+sys_error_t sys_udp_wait(sys_udp_socket_t* socket);
+/* Copies the oldest received datagram into `datagram`, blocking until there is one. */
+sys_error_t sys_udp_receive(sys_udp_socket_t* socket, sys_udp_datagram_t* datagram);
+
+__SYS_EXTERN_C_END
+
+#endif  // !__PIKAOS_LIBC_SYS_NET_H__
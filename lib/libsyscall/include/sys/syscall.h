@@ -11,7 +11,70 @@
 #ifndef __ASSEMBLER__
 typedef int sys_error_t;
 typedef uint32_t sys_pid_t;
+/* A group of tasks sharing a CPU bandwidth quota, see sys_task_group_create(). 0 is never a valid group. */
+typedef uint32_t sys_task_group_t;
 typedef uint64_t sys_word_t;
+
+/* The count of buckets of the system calls duration histograms: the bucket `i` counts the calls that took
+ * less than 2^i timer ticks (and at least 2^(i-1)), the last one also counts all the longer calls. */
+#define SYS_STATS_HISTOGRAM_SIZE 16
+
+/* The statistics of a system call, see sys_get_stats(). */
+typedef struct sys_syscall_stats_t {
+  uint64_t count;
+  uint64_t total_ticks;
+  uint64_t max_ticks;
+  /* The frequency (in Hertz) of the timer ticks. */
+  uint64_t tick_frequency;
+  uint32_t histogram[SYS_STATS_HISTOGRAM_SIZE];
+} sys_syscall_stats_t;
+
+/* The address of the read-only page the kernel maps into every process, see sys_get_info_page(). */
+#define SYS_INFO_PAGE_ADDRESS 0x0000100000000000ull
+
+/* The process information kept up to date by the kernel, read without system calls. */
+typedef struct sys_info_page_t {
+  /* The ID of the process main task (sys_getpid() returns the ID of the calling thread). */
+  sys_pid_t pid;
+  /* The priority of the process main task. */
+  uint32_t priority;
+  /* The frequency (in Hertz) of the ticks of sys_get_ticks(). */
+  uint64_t tick_frequency;
+  /* The nanoseconds per tick, as a 32.32 fixed-point number (see sys_get_time_ns()). */
+  uint64_t ns_per_tick;
+  /* The period of the scheduler tick, in ticks: sys_get_ticks() / sched_tick_period counts the scheduler ticks
+   * since boot. */
+  uint64_t sched_tick_period;
+} sys_info_page_t;
+
+/* The CPU and memory usage of a task, see sys_get_task_stats(). */
+typedef struct sys_task_stats_t {
+  sys_pid_t pid;
+  /* 0 if the task has no parent. */
+  sys_pid_t parent_pid;
+  uint32_t priority;
+  /* 0 if running or ready to run, 1 if sleeping (interruptible), 2 if sleeping (uninterruptible). */
+  uint32_t state;
+  uint8_t is_kernel;
+  uint8_t is_thread;
+  /* The cumulative time spent in user space and in the kernel, in timer ticks. */
+  uint64_t user_ticks;
+  uint64_t system_ticks;
+  /* The frequency (in Hertz) of the timer ticks. */
+  uint64_t tick_frequency;
+  /* Switched out because the task blocked, or because it was preempted (or yielded). */
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+  uint64_t page_faults;
+  /* The byte size of the memory mapped by the task (shared with its threads and the other processes for
+   * the program segments), 0 for the kernel tasks. */
+  uint64_t resident_byte_size;
+} sys_task_stats_t;
+
+/* A mutex shared by the threads of a process, see sys_mutex_lock(). Zero-initialized (unlocked). */
+typedef struct sys_mutex_t {
+  uint32_t word;
+} sys_mutex_t;
 #endif  // !__ASSEMBLER__
 // The system call error codes:
 
@@ -26,25 +89,169 @@ enum {
   SYS_ERR_INVALID_WINDOW,
   SYS_ERR_INVALID_FILE,
   SYS_ERR_INVALID_DIR,
+  SYS_ERR_INVALID_ADDRESS,
+  SYS_ERR_FUTEX_VALUE_CHANGED,
+  SYS_ERR_INVALID_THREAD,
+  SYS_ERR_INVALID_GFX_COMMAND,
+  SYS_ERR_INVALID_IO_OP,
+  SYS_ERR_INVALID_CHANNEL,
+  SYS_ERR_CHANNEL_CLOSED,
+  SYS_ERR_INVALID_SOCKET,
+  SYS_ERR_INVALID_TIMER,
+  SYS_ERR_INVALID_AFFINITY,
+  SYS_ERR_INVALID_TASK_GROUP,
 };
 
 #define SYS_IS_OK(e) ((e) == SYS_ERR_OK)
 
+/* The biggest byte sizes (NUL included) of the string arguments of the system calls: the paths, names and titles,
+ * and the texts (printed or drawn). SYS_ERR_INVALID_ADDRESS is returned for a longer string. */
+#define SYS_MAX_STRING_SIZE 256
+#define SYS_MAX_TEXT_SIZE 1024
+
+// The SYS_DEBUG subcommands:
+
+enum {
+  /* Prints its argument in the kernel log. */
+  SYS_DEBUG_PRINT,
+  /* Logs the kernel heap allocation sites with the most live bytes, its argument is their count (the kernel
+   * must be built with CONFIG_ALLOC_PROFILER). */
+  SYS_DEBUG_DUMP_ALLOC_SITES,
+  /* Sends the kernel arc counters over the log UART, cleared afterwards if its argument is not 0 (the kernel
+   * must be built with KERNEL_PGO=GENERATE, see tools/gcda-extract.py). */
+  SYS_DEBUG_DUMP_COVERAGE,
+};
+
+// The kinds of latencies of sys_get_latency_stats():
+
+enum {
+  /* How late a real-time task runs after the deadline of its sleep timer. */
+  SYS_LATENCY_WAKEUP,
+  /* The sections run with the IRQs masked (exceptions included). */
+  SYS_LATENCY_IRQS_OFF,
+  /* The sections run with the preemption disabled. */
+  SYS_LATENCY_PREEMPT_OFF,
+};
+
 __SYS_EXTERN_C_BEGIN
 
 void sys_exit(int64_t status) __attribute__((__noreturn__));
 sys_error_t sys_sleep(uint64_t time_in_s);
 sys_error_t sys_usleep(uint64_t time_in_us);
+/* Returns the count of timer ticks since boot, read from the generic timer counter without a system call.
+ * It is the most precise time source, e.g. for the benchmarks (see binuser/bench.h). */
+uint64_t sys_get_ticks();
+/* Returns the frequency (in Hertz) of the ticks of sys_get_ticks(). */
+uint64_t sys_get_tick_frequency();
+/* Returns the time since boot in nanoseconds, as sys_get_ticks() without a system call (e.g. for the frame
+ * timings). */
+uint64_t sys_get_time_ns();
+/* Returns the information page of the calling process, mapped read-only by the kernel. */
+const sys_info_page_t* sys_get_info_page();
 sys_error_t sys_print(const char* msg);
 sys_error_t sys_spawn(const char* path);
+/* Same as sys_spawn(), but the new process joins `group` instead of the group of the caller (0 to keep it). */
+sys_error_t sys_spawn_in_group(const char* path, sys_task_group_t group);
+/* Starts the zygote of the program at `path`: a process that runs its common initialization (e.g. decoding its
+ * assets) until it calls sys_zygote_ready(), where it is parked. The processes spawned with
+ * sys_spawn_from_zygote() are then copies of it (on write) resuming from sys_zygote_ready(), so they start
+ * right away without loading nor initializing anything. The windows, channels, files and threads must be
+ * created after sys_zygote_ready(), they are not inherited by the copies. The zygote lives until killed. */
+sys_error_t sys_zygote_start(const char* path);
+/* Parks the calling process if it is a zygote (see sys_zygote_start()), it then returns in its copies only.
+ * Otherwise (the program was spawned as usual), returns right away. */
+sys_error_t sys_zygote_ready();
+/* Same as sys_spawn(), but the new process is a copy of the zygote of the program once it is ready, if any. */
+sys_error_t sys_spawn_from_zygote(const char* path);
 sys_error_t sys_yield();
+/* Returns the ID of the calling task (the thread ID in a thread), without a system call. */
 sys_pid_t sys_getpid();
 sys_error_t sys_sched_set_priority(sys_pid_t pid, uint32_t priority);
 sys_error_t sys_sched_get_priority(sys_pid_t pid, uint32_t* priority);
+/* Restricts the task `pid` (the calling one if 0, or a thread of the calling process) to the cores of
+ * `core_mask` (bit i for the core i), it is moved to one of them if needed. The new threads and processes
+ * inherit the affinity. Returns SYS_ERR_INVALID_AFFINITY if none of the cores is online. By default, the
+ * tasks run on all cores but the isolated ones (boot option `isolcpus=`), which only run the pinned tasks. */
+sys_error_t sys_sched_set_affinity(sys_pid_t pid, uint32_t core_mask);
+/* Stores into `core_mask` the cores the task `pid` may run on, see sys_sched_set_affinity(). */
+sys_error_t sys_sched_get_affinity(sys_pid_t pid, uint32_t* core_mask);
+
+/* Creates a group of tasks that together run at most `quota_us` microseconds (summed over all cores) in each
+ * `period_us`, and stores it into `group`. Once the quota is used, the tasks of the group are throttled until
+ * the next period, whatever their priority, so a runaway program can not take the board down. The tasks join
+ * the group when spawned into it (see sys_spawn_in_group()), and their threads and children follow them. The
+ * quota is enforced with the resolution of the scheduler tick, which is also the minimum quota and period.
+ * Returns SYS_ERR_INVALID_TASK_GROUP if the parameters are invalid or if there are too many groups. */
+sys_error_t sys_task_group_create(uint64_t quota_us, uint64_t period_us, sys_task_group_t* group);
+/* Destroys `group`, which must have no task left (SYS_ERR_GENERIC otherwise). */
+sys_error_t sys_task_group_destroy(sys_task_group_t group);
 sys_error_t sys_debug(uint64_t x);
+/* Runs the SYS_DEBUG subcommand @a command (SYS_DEBUG_PRINT, etc.) with the argument @a x. */
+sys_error_t sys_debug_command(uint32_t command, uint64_t x);
 
 void* sys_sbrk(ptrdiff_t increment);
 
+/* Maps `length` bytes of zeroed memory at a page aligned address, stored into `address`.
+ * Unlike the heap, each mapping can be released independently of the others. The pages are
+ * only allocated when first touched, and are copied on write by sys_fork(). */
+sys_error_t sys_mmap(size_t length, void** address);
+/* Unmaps the `length` bytes at `address` (page aligned), they must be inside a single mapping
+ * returned by sys_mmap(). Returns SYS_ERR_INVALID_ADDRESS if they are not.
+ * A mapping returned by sys_mmap_file() is unmapped as a whole, whatever `length`. */
+sys_error_t sys_munmap(void* address, size_t length);
+
+/* Blocks the calling task while the 32-bit word at `address` contains `expected`.
+ * Returns SYS_ERR_FUTEX_VALUE_CHANGED without blocking if it contains something else.
+ * The caller must always check again the word once this function returns. */
+sys_error_t sys_futex_wait(uint32_t* address, uint32_t expected);
+/* Wakes at most `count` tasks blocked on the futex at `address`.
+ * Returns the count of awaken tasks. */
+uint32_t sys_futex_wake(uint32_t* address, uint32_t count);
+/* Locks `mutex`, blocking the calling thread while another one owns it. The exclusive accesses (LDAXR/STLXR)
+ * are not reliable while the data cache is disabled: once the process has threads, the mutex word is only
+ * written by the kernel (a system call for each lock and unlock). Before that, no system call is made. */
+void sys_mutex_lock(sys_mutex_t* mutex);
+/* Unlocks `mutex` (owned by the calling thread), and wakes a thread blocked on it. */
+void sys_mutex_unlock(sys_mutex_t* mutex);
+
+/* Creates a new thread of the calling process that executes `entry(arg)`, and stores its ID
+ * into `tid`. The thread shares the process memory, but has its own (small) stack.
+ * The thread terminates when `entry` returns or calls sys_exit(), and all threads are
+ * killed when the process main thread terminates. */
+sys_error_t sys_thread_create(void (*entry)(void*), void* arg, sys_pid_t* tid);
+/* Blocks until the thread `tid` of the calling process terminates and stores its exit code
+ * into `exit_code` (if not NULL). */
+sys_error_t sys_thread_join(sys_pid_t tid, int* exit_code);
+
+/* Creates a copy of the calling process, which resumes from this call as the caller does.
+ * The ID of the new process is stored into `child_pid` in the caller, and 0 is stored in
+ * the new process. The memory is copied on write, the windows and the opened files are not
+ * inherited. Threads can not fork (only the process main thread). */
+sys_error_t sys_fork(sys_pid_t* child_pid);
+
+/* Stores into `stats` the count and the durations of the calls to the system call `id` made by the calling
+ * task, or by all tasks since boot if `global` is true. The time spent blocked by a system call is not
+ * counted. Returns SYS_ERR_UNKNOWN_SYSCALL if the statistics of `id` are not tracked. */
+sys_error_t sys_get_stats(uint32_t id, sys_bool_t global, sys_syscall_stats_t* stats);
+
+/* Stores the statistics of at most `max_count` live tasks into `stats`, in no particular order, and their
+ * count into `count`. The count may be more than `max_count` if some tasks did not fit. */
+sys_error_t sys_get_task_stats(sys_task_stats_t* stats, size_t max_count, size_t* count);
+
+/* Stores into `stats` the latencies of the key events since boot, from the hardware interrupt to their
+ * delivery by sys_poll_message() (and the like). The repeated keys are counted from their generation. */
+sys_error_t sys_get_input_latency_stats(sys_syscall_stats_t* stats);
+
+/* Stores into `stats` the latencies of `kind` (SYS_LATENCY_WAKEUP and the like) of all cores since boot, and
+ * into `max_site` the kernel code address of the longest one (0 if unknown). Returns SYS_ERR_GENERIC if the
+ * kernel is not built with CONFIG_LATENCY_TRACER. */
+sys_error_t sys_get_latency_stats(uint32_t kind, sys_syscall_stats_t* stats, uint64_t* max_site);
+
+/* Restarts into the kernel image at `kernel_path`, without going through the firmware, after syncing the written
+ * files. The ramdisk is replaced by the image at `ramdisk_path` unless NULL. Returns only on failure, with
+ * SYS_ERR_GENERIC if an image can not be read or does not fit. */
+sys_error_t sys_kexec(const char* kernel_path, const char* ramdisk_path);
+
 __SYS_EXTERN_C_END
 
 #endif  // !PIKAOS_LIBC_SYS_SYSCALL_H
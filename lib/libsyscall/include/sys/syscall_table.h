@@ -46,7 +46,114 @@ enum {
   SYS_GFX_DRAW_RECT,
   SYS_GFX_FILL_RECT,
   SYS_GFX_DRAW_TEXT,
-  SYS_GFX_BLIT
+  SYS_GFX_BLIT,
+
+  /* Synchronization system calls. */
+  SYS_FUTEX_WAIT,
+  SYS_FUTEX_WAKE,
+
+  /* Thread system calls. */
+  SYS_THREAD_CREATE,
+  SYS_THREAD_JOIN,
+
+  /* Process system calls. */
+  SYS_FORK,
+
+  /* Window surface system calls. */
+  SYS_WINDOW_GET_SURFACE,
+  SYS_WINDOW_PRESENT_RECT,
+
+  /* Anonymous memory system calls. */
+  SYS_MMAP,
+  SYS_MUNMAP,
+
+  /* Window graphics command buffer system calls. */
+  SYS_GFX_SUBMIT,
+
+  /* Filesystem seek system calls. */
+  SYS_SEEK_FILE,
+
+  /* Asynchronous file I/O system calls. */
+  SYS_IO_SETUP,
+  SYS_IO_ENTER,
+
+  /* Bulk directory read system calls. */
+  SYS_READ_DIR_MANY,
+
+  /* File mapping system calls. */
+  SYS_MMAP_FILE,
+
+  /* Statistics system calls. */
+  SYS_GET_STATS,
+
+  /* Batched window messages system calls. */
+  SYS_POLL_MESSAGES,
+
+  /* Task statistics system calls. */
+  SYS_TASK_STATS,
+
+  /* Inter-process channels system calls. */
+  SYS_CHANNEL_CREATE,
+  SYS_CHANNEL_CONNECT,
+  SYS_CHANNEL_CLOSE,
+  SYS_CHANNEL_WAIT,
+  SYS_CHANNEL_NOTIFY,
+  SYS_CHANNEL_GRANT_ALLOC,
+  SYS_CHANNEL_GRANT_ACCEPT,
+  SYS_CHANNEL_GRANT_RELEASE,
+  SYS_CHANNEL_CALL,
+  SYS_CHANNEL_REPLY_WAIT,
+  SYS_WINDOW_GET_STATE,
+  SYS_GET_INPUT_LATENCY_STATS,
+  SYS_GFX_MEASURE_TEXT,
+  SYS_GFX_COPY_AREA,
+  SYS_WINDOW_SET_SURFACE_SIZE,
+
+  /* Raw Ethernet frames system calls. */
+  SYS_NET_GET_INFO,
+  SYS_NET_SEND,
+  SYS_NET_RECEIVE,
+
+  /* IPv4 and UDP sockets system calls. */
+  SYS_NET_GET_IPV4_CONFIG,
+  SYS_NET_SET_IPV4_CONFIG,
+  SYS_UDP_OPEN,
+  SYS_UDP_CLOSE,
+  SYS_UDP_FLUSH,
+  SYS_UDP_WAIT,
+
+  /* Window timers system calls. */
+  SYS_TIMER_CREATE,
+  SYS_TIMER_ARM,
+  SYS_TIMER_DESTROY,
+
+  SYS_GET_LATENCY_STATS,
+
+  SYS_SCHED_SET_AFFINITY,
+  SYS_SCHED_GET_AFFINITY,
+
+  SYS_TASK_GROUP_CREATE,
+  SYS_TASK_GROUP_DESTROY,
+
+  SYS_ZYGOTE_START,
+  SYS_ZYGOTE_READY,
+  SYS_SPAWN_FROM_ZYGOTE,
+
+  SYS_WINDOW_SET_BUFFER_COUNT,
+  SYS_WINDOW_SWAP_BUFFERS,
+  SYS_WINDOW_REQUEST_FRAME,
+
+  /* File writing system calls. */
+  SYS_WRITE_FILE,
+  SYS_TRUNCATE_FILE,
+  SYS_SYNC,
+
+  SYS_GET_THUMBNAIL,
+
+  SYS_KEXEC,
+
+  SYS_MUTEX_LOCK,
+  SYS_MUTEX_UNLOCK
 };
 
 #endif  // !__PIKAOS_LIBC_SYS_SYSCALL_TABLE_H__
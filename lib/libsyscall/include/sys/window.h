@@ -8,6 +8,8 @@ __SYS_EXTERN_C_BEGIN
 
 typedef struct __sys_window_t sys_window_t;
 
+/* For SYS_MSG_KEYDOWN and SYS_MSG_KEYUP, param1 is the sys_key_event_t and param2 the timer tick count when
+ * the hardware interrupt was received (see sys_get_input_latency_stats()). */
 typedef struct __sys_message_t {
   uint32_t id;
   uint32_t timestamp;
@@ -25,7 +27,7 @@ enum {
   SYS_MSG_KEYDOWN,
   SYS_MSG_KEYUP,
 
-  /* Mouse messages. */
+  /* Mouse messages, only sent to the frontmost visible window under the cursor. */
   SYS_MSG_MOUSEMOVE,
   SYS_MSG_MOUSECLICK,
   SYS_MSG_MOUSESCROLL,
@@ -38,6 +40,12 @@ enum {
   SYS_MSG_RESIZE,
   SYS_MSG_FOCUS_IN,
   SYS_MSG_FOCUS_OUT,
+
+  /* Timer messages, see sys_timer_create(). */
+  SYS_MSG_TIMER,
+
+  /* Frame messages, see sys_window_request_frame(). */
+  SYS_MSG_FRAME,
 };
 
 enum { SYS_WF_DEFAULT = 0x0, SYS_WF_NO_FRAME = 0x1 };
@@ -53,9 +61,67 @@ void sys_window_destroy(sys_window_t* window);
 
 /* Window message queue API. */
 sys_bool_t sys_poll_message(sys_window_t* window, sys_message_t* msg);
+/* Same as sys_poll_message() but gets up to `max_count` messages at once, returns their count. */
+size_t sys_poll_messages(sys_window_t* window, sys_message_t* msgs, size_t max_count);
 void sys_poll_all_messages(sys_window_t* window);
 void sys_wait_message(sys_window_t* window, sys_message_t* msg);
 
+/* Window timers API.
+ *
+ * A timer posts SYS_MSG_TIMER messages into the queue of its window, so sys_wait_message() waits for both the
+ * input and the animation ticks. param1 is the timer and param2 its expiration count since the previous message
+ * of this timer (more than 1 if the task was too slow, the pending ticks of a timer are merged). The timer is
+ * destroyed with its window. */
+typedef sys_word_t sys_timer_t;
+
+sys_error_t sys_timer_create(sys_window_t* window, sys_timer_t* timer);
+/* Posts the first message in `delay_us` microseconds, then each `period_us` microseconds if not 0 (at least 1
+ * ms). A delay of 0 disarms the timer. Arming an armed timer restarts it. */
+sys_error_t sys_timer_arm(sys_timer_t timer, uint64_t delay_us, uint64_t period_us);
+sys_error_t sys_timer_destroy(sys_timer_t timer);
+
+/* Frame messages API.
+ *
+ * Asks for one SYS_MSG_FRAME message at the next frame of the window manager (param1 is its time, in
+ * microseconds), or once shown if the window is hidden. The requests made before the message are merged. Drawing
+ * when it is received draws once per displayed frame, instead of once per input message or timer tick. */
+sys_error_t sys_window_request_frame(sys_window_t* window);
+
+/* Event loop API.
+ *
+ * Waits in a single call for the input, the timers and the frames of a window. The messages are given to
+ * `on_message` (if not NULL), and `on_frame` draws and presents the window at the next frame after a call to
+ * sys_event_loop_invalidate(). All the messages received meanwhile are handled before, so a burst of input or of
+ * resizes is drawn once. The window is invalidated when the loop starts, and by SYS_MSG_SHOW and SYS_MSG_RESIZE.
+ * SYS_MSG_FRAME is not given to `on_message`. */
+typedef struct __sys_event_loop_t sys_event_loop_t;
+typedef void (*sys_event_loop_message_fn)(sys_event_loop_t* loop, const sys_message_t* message);
+typedef void (*sys_event_loop_frame_fn)(sys_event_loop_t* loop, uint64_t frame_time_us);
+
+struct __sys_event_loop_t {
+  sys_window_t* window;
+  sys_event_loop_message_fn on_message;
+  sys_event_loop_frame_fn on_frame;
+  void* user_data;
+
+  /* Private, see the functions below. */
+  sys_bool_t is_running;
+  sys_bool_t is_invalidated;
+  sys_bool_t is_frame_requested;
+};
+
+void sys_event_loop_init(sys_event_loop_t* loop,
+                         sys_window_t* window,
+                         sys_event_loop_message_fn on_message,
+                         sys_event_loop_frame_fn on_frame,
+                         void* user_data);
+/* Makes the loop call `on_frame` at the next frame. */
+void sys_event_loop_invalidate(sys_event_loop_t* loop);
+/* Makes sys_event_loop_run() return, once the current callback returns. */
+void sys_event_loop_quit(sys_event_loop_t* loop);
+/* Runs the loop until sys_event_loop_quit() is called. */
+void sys_event_loop_run(sys_event_loop_t* loop);
+
 /* Window title (UTF-8 encoded) API. */
 sys_error_t sys_window_set_title(sys_window_t* window, const char* title);
 
@@ -67,8 +133,61 @@ sys_error_t sys_window_get_visibility(sys_window_t* window, sys_bool_t* visible)
 sys_error_t sys_window_set_geometry(sys_window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height);
 sys_error_t sys_window_get_geometry(sys_window_t* window, uint32_t* x, uint32_t* y, uint32_t* width, uint32_t* height);
 
+/* Window state API.
+ *
+ * The kernel publishes the window state in a page mapped read-only into the process at the window creation,
+ * and updates it each time the window is moved, resized, shown, hidden, focused or unfocused. The getters
+ * above read it without a system call (they fall back to one if the page could not be mapped). */
+typedef struct __sys_window_state_t {
+  /* Odd while the kernel updates the state, incremented twice per update: a state read between two equal
+   * even values is consistent (a seqlock). */
+  uint32_t sequence;
+  int32_t x;
+  int32_t y;
+  uint32_t width;
+  uint32_t height;
+  uint32_t visible;
+  uint32_t focus;
+  /* The surface size, see sys_window_set_surface_size(). */
+  uint32_t surface_width;
+  uint32_t surface_height;
+} sys_window_state_t;
+
+/* Copies a consistent snapshot of the window state into `state`. Comparing its sequence with the one of a
+ * previous snapshot tells if the window changed meanwhile. */
+sys_error_t sys_window_get_state(sys_window_t* window, sys_window_state_t* state);
+
+/* Window surface API.
+ *
+ * The window framebuffer is mapped into the process, and the pixels can be drawn there directly
+ * (ARGB, a row is `pitch` pixels long) before calling sys_window_present(). The surface changes when
+ * the window is resized (SYS_MSG_RESIZE): it must be queried again. */
+sys_error_t sys_window_get_surface(sys_window_t* window, uint32_t** pixels, uint32_t* pitch);
+/* Sets the surface size to `width` x `height` pixels, scaled to the window size when composited: a surface
+ * smaller than the window is cheaper to draw (e.g. half the window size takes four times less pixels), a bigger
+ * one is downscaled. Integer upscales duplicate the pixels, the other scales are bilinear. The surface keeps its
+ * size when the window is resized, and the coordinates of the window functions are the surface ones. The surface
+ * must be queried again after this call. A size of 0 x 0 makes the surface follow the window size again. */
+sys_error_t sys_window_set_surface_size(sys_window_t* window, uint32_t width, uint32_t height);
+
+/* Sets the count of surface buffers, from 1 (the default) to SYS_WINDOW_MAX_BUFFERS. With a single buffer, the
+ * compositor reads the surface while it is drawn: a frame may be shown half drawn. With several buffers, the
+ * surface given by sys_window_get_surface() is a back buffer never shown, and sys_window_swap_buffers() presents
+ * it at once (the sys_gfx_* functions also draw into the back buffer). With three buffers, drawing never waits
+ * for the compositor. The buffers start with the current content, the surface must be queried again after this
+ * call. */
+#define SYS_WINDOW_MAX_BUFFERS 3
+sys_error_t sys_window_set_buffer_count(sys_window_t* window, uint32_t count);
+/* Presents the whole back buffer (it becomes the front one), and stores the next back buffer into `pixels` (same
+ * pitch). It holds the frame presented `age` swaps ago (`age` may be NULL): 2 is the frame before the one just
+ * presented, so only the pixels changed in the last age - 1 frames have to be drawn again. With a single
+ * buffer, this is sys_window_present() and the surface is unchanged (age 1). */
+sys_error_t sys_window_swap_buffers(sys_window_t* window, uint32_t** pixels, uint32_t* age);
+
 /* Window graphics API. */
 sys_error_t sys_window_present(sys_window_t* window);
+/* Same as sys_window_present() but only the given rectangle (in the window coordinates) changed. */
+sys_error_t sys_window_present_rect(sys_window_t* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 sys_error_t sys_gfx_clear(sys_window_t* window, uint32_t argb);
 sys_error_t sys_gfx_draw_line(sys_window_t* window, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y2, uint32_t argb);
 sys_error_t sys_gfx_draw_rect(sys_window_t* window,
@@ -84,6 +203,9 @@ sys_error_t sys_gfx_fill_rect(sys_window_t* window,
                               uint32_t height,
                               uint32_t argb);
 sys_error_t sys_gfx_draw_text(sys_window_t* window, uint32_t x, uint32_t y, const char* text, uint32_t argb);
+/* Stores into `width` the horizontal advance, in pixels, of `text` drawn by sys_gfx_draw_text() on a single line
+ * (the fonts may be proportional and kerned). The widths of the recently measured texts are cached. */
+sys_error_t sys_gfx_measure_text(sys_window_t* window, const char* text, uint32_t* width);
 sys_error_t sys_gfx_blit(sys_window_t* window,
                          uint32_t x,
                          uint32_t y,
@@ -91,6 +213,112 @@ sys_error_t sys_gfx_blit(sys_window_t* window,
                          uint32_t height,
                          const uint32_t* argb_buffer);
 
+typedef struct __sys_gfx_rect_t {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+} sys_gfx_rect_t;
+
+/* Moves the `width` x `height` pixels at (`src_x`, `src_y`) to (`dst_x`, `dst_y`) inside the window, the areas may
+ * overlap. To scroll, only the content scrolled into view has then to be drawn, instead of the whole window.
+ *
+ * If `exposed` is not NULL, it receives the bounding rectangle of the source pixels that are not overwritten by
+ * the move (a strip for a vertical or horizontal scroll, empty if none): they keep their old content and
+ * usually have to be repainted. The moved and repainted areas must then be presented as usual. */
+sys_error_t sys_gfx_copy_area(sys_window_t* window,
+                              uint32_t src_x,
+                              uint32_t src_y,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t dst_x,
+                              uint32_t dst_y,
+                              sys_gfx_rect_t* exposed);
+
+/* Window graphics command buffer API.
+ *
+ * The primitives above are each a system call. Instead, they can be recorded into a command buffer
+ * that is then executed by sys_gfx_submit() in a single system call. Text and pixels of the commands
+ * are copied into the data area of the buffer, so the source memory can be reused right away.
+ *
+ * The clipping rectangle set by SYS_GFX_OP_SET_CLIP only applies to the following commands of the
+ * same submission. */
+enum {
+  SYS_GFX_OP_CLEAR,
+  SYS_GFX_OP_DRAW_LINE,
+  SYS_GFX_OP_DRAW_RECT,
+  SYS_GFX_OP_FILL_RECT,
+  SYS_GFX_OP_DRAW_TEXT,
+  SYS_GFX_OP_BLIT,
+  SYS_GFX_OP_SET_CLIP,
+  SYS_GFX_OP_RESET_CLIP,
+};
+
+/* A recorded command, as read by the kernel. For SYS_GFX_OP_DRAW_LINE, (x, y) is the first point and
+ * (width, height) the second one. For SYS_GFX_OP_DRAW_TEXT and SYS_GFX_OP_BLIT, data_offset is the
+ * offset of the NUL terminated text or the pixels inside the data area. */
+typedef struct __sys_gfx_command_t {
+  uint32_t op;
+  uint32_t argb;
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+  uint64_t data_offset;
+} sys_gfx_command_t;
+
+typedef struct __sys_gfx_buffer_t {
+  sys_gfx_command_t* commands;
+  size_t command_count;
+  size_t command_capacity;
+  /* The data area, 8-bytes aligned entries. */
+  uint8_t* data;
+  size_t data_size;
+  size_t data_capacity;
+  /* An allocation failed while recording, the buffer is not submitted. */
+  sys_bool_t failed;
+} sys_gfx_buffer_t;
+
+void sys_gfx_buffer_init(sys_gfx_buffer_t* buffer);
+void sys_gfx_buffer_destroy(sys_gfx_buffer_t* buffer);
+/* Removes all recorded commands but keeps the memory to record new ones. */
+void sys_gfx_buffer_reset(sys_gfx_buffer_t* buffer);
+
+void sys_gfx_record_clear(sys_gfx_buffer_t* buffer, uint32_t argb);
+void sys_gfx_record_draw_line(sys_gfx_buffer_t* buffer,
+                              uint32_t x0,
+                              uint32_t y0,
+                              uint32_t x1,
+                              uint32_t y1,
+                              uint32_t argb);
+void sys_gfx_record_draw_rect(sys_gfx_buffer_t* buffer,
+                              uint32_t x,
+                              uint32_t y,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t argb);
+void sys_gfx_record_fill_rect(sys_gfx_buffer_t* buffer,
+                              uint32_t x,
+                              uint32_t y,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t argb);
+void sys_gfx_record_draw_text(sys_gfx_buffer_t* buffer, uint32_t x, uint32_t y, const char* text, uint32_t argb);
+void sys_gfx_record_blit(sys_gfx_buffer_t* buffer,
+                         uint32_t x,
+                         uint32_t y,
+                         uint32_t width,
+                         uint32_t height,
+                         const uint32_t* argb_buffer);
+void sys_gfx_record_set_clip(sys_gfx_buffer_t* buffer, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void sys_gfx_record_reset_clip(sys_gfx_buffer_t* buffer);
+
+/* Validates then executes all the commands recorded into @buffer, in order. Nothing is drawn and
+ * SYS_ERR_INVALID_GFX_COMMAND is returned if one of them is invalid (unknown opcode or data outside of the
+ * data area). SYS_ERR_OUT_OF_MEM is returned if the recording failed.
+ * The buffer is not reset. */
+sys_error_t sys_gfx_submit(sys_window_t* window, const sys_gfx_buffer_t* buffer);
+
 __SYS_EXTERN_C_END
 
 #endif  // !__PIKAOS_LIBC_SYS_WINDOW_H__
@@ -1,12 +1,437 @@
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/syscall.h>
 
+/*
+ * A boundary-tag allocator on top of the sbrk() heap.
+ *
+ * The heap is a sequence of chunks, each one starting by a header with its size and whether it and the
+ * previous chunk are used. A free chunk also stores its size at the start of the next chunk (prev_size),
+ * so a freed chunk is merged with its free neighbours in constant time.
+ *
+ * Free chunks are kept in size class bins: one bin per 16 bytes for the small chunks (exact fit), then
+ * one bin per power of two (first fit). The last chunk of the heap (the top chunk) is never in a bin:
+ * it is split to serve the requests that no bin can serve, grown by sbrk() when too small and given
+ * back to the kernel by a negative sbrk() when it becomes too big.
+ *
+ * The big blocks are not taken from the heap but mapped on their own by sys_mmap(), so they are given
+ * back to the kernel as soon as they are freed and never fragment the heap.
+ *
+ * The threads of a process share the heap, which is protected by a sys_mutex_t (there is no thread-local
+ * storage to do per-thread caches).
+ */
+
+typedef struct chunk {
+  /** The size of the previous chunk, only valid if it is free. */
+  size_t prev_size;
+  /** The size of this chunk (header included) and the IN_USE and PREV_IN_USE flags. */
+  size_t size;
+  /** The links of the bin of a free chunk, the user data starts here for the used chunks. */
+  struct chunk* next;
+  struct chunk* prev;
+} chunk_t;
+
+#define IN_USE ((size_t)1)
+#define PREV_IN_USE ((size_t)2)
+/** The chunk is not in the heap, it has its own mapping. */
+#define IS_MAPPED ((size_t)4)
+#define FLAGS_MASK (IN_USE | PREV_IN_USE | IS_MAPPED)
+
+#define ALIGNMENT 16
+#define HEADER_SIZE (2 * sizeof(size_t))
+#define MIN_CHUNK_SIZE sizeof(chunk_t)
+
+#define NB_SMALL_BINS 32
+/** The biggest chunk size kept in the small bins. */
+#define MAX_SMALL_SIZE (MIN_CHUNK_SIZE + (NB_SMALL_BINS - 1) * ALIGNMENT)
+#define NB_BINS 64
+
+/** The heap grows by steps of at least this byte size (a few pages). */
+#define MIN_GROW_SIZE (64 * 1024)
+/** The top chunk is trimmed (down to MIN_GROW_SIZE bytes) when it becomes bigger than this byte size. */
+#define TRIM_THRESHOLD (256 * 1024)
+#define PAGE_SIZE 4096
+/** The chunks of at least this byte size have their own mapping. */
+#define MMAP_THRESHOLD (256 * 1024)
+
+static chunk_t* g_bins[NB_BINS];
+/** A bit for each non-empty bin. */
+static uint64_t g_bin_map;
+
+static chunk_t* g_top;
+/** The end of the heap, the top chunk ends there. */
+static char* g_heap_end;
+
+static sys_mutex_t g_lock;
+
+static void lock(void) {
+  sys_mutex_lock(&g_lock);
+}
+
+static void unlock(void) {
+  sys_mutex_unlock(&g_lock);
+}
+
+static inline size_t chunk_size(const chunk_t* chunk) {
+  return chunk->size & ~FLAGS_MASK;
+}
+
+static inline chunk_t* next_chunk(chunk_t* chunk) {
+  return (chunk_t*)((char*)chunk + chunk_size(chunk));
+}
+
+static inline void* chunk_to_mem(chunk_t* chunk) {
+  return (char*)chunk + HEADER_SIZE;
+}
+
+static inline chunk_t* mem_to_chunk(void* ptr) {
+  return (chunk_t*)((char*)ptr - HEADER_SIZE);
+}
+
+/** Gets the chunk size needed to store @a n bytes, or 0 if too big. */
+static size_t request_to_size(size_t n) {
+  if (n > SIZE_MAX / 2)
+    return 0;
+
+  const size_t size = (n + HEADER_SIZE + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+  return size < MIN_CHUNK_SIZE ? MIN_CHUNK_SIZE : size;
+}
+
+static size_t bin_index(size_t size) {
+  if (size <= MAX_SMALL_SIZE)
+    return (size - MIN_CHUNK_SIZE) / ALIGNMENT;
+
+  // One bin per power of two after the small bins.
+  const size_t index = NB_SMALL_BINS + (63 - __builtin_clzl(size)) - (63 - __builtin_clzl(MAX_SMALL_SIZE));
+  return index < NB_BINS ? index : NB_BINS - 1;
+}
+
+static void insert_free_chunk(chunk_t* chunk) {
+  const size_t index = bin_index(chunk_size(chunk));
+  chunk->prev = NULL;
+  chunk->next = g_bins[index];
+  if (chunk->next != NULL)
+    chunk->next->prev = chunk;
+
+  g_bins[index] = chunk;
+  g_bin_map |= (uint64_t)1 << index;
+}
+
+static void remove_free_chunk(chunk_t* chunk) {
+  const size_t index = bin_index(chunk_size(chunk));
+  if (chunk->prev != NULL) {
+    chunk->prev->next = chunk->next;
+  } else {
+    g_bins[index] = chunk->next;
+    if (chunk->next == NULL)
+      g_bin_map &= ~((uint64_t)1 << index);
+  }
+
+  if (chunk->next != NULL)
+    chunk->next->prev = chunk->prev;
+}
+
+/** Marks the chunk of @a size bytes at @a chunk as free: sets its footer and the flags of the next chunk. */
+static void set_free_chunk(chunk_t* chunk, size_t size) {
+  chunk->size = size | (chunk->size & PREV_IN_USE);
+  chunk_t* next = next_chunk(chunk);
+  next->prev_size = size;
+  next->size &= ~PREV_IN_USE;
+}
+
+/** Frees @a chunk (a used chunk or a remainder), merging it with its free neighbours. */
+static void release_chunk(chunk_t* chunk) {
+  size_t size = chunk_size(chunk);
+
+  if ((chunk->size & PREV_IN_USE) == 0) {
+    chunk_t* previous = (chunk_t*)((char*)chunk - chunk->prev_size);
+    remove_free_chunk(previous);
+    size += chunk_size(previous);
+    chunk = previous;
+  }
+
+  chunk_t* next = (chunk_t*)((char*)chunk + size);
+  if (next == g_top) {
+    // Merged in the top chunk, not in a bin.
+    chunk->size = (size + chunk_size(g_top)) | (chunk->size & PREV_IN_USE);
+    g_top = chunk;
+    return;
+  }
+
+  if ((next->size & IN_USE) == 0) {
+    remove_free_chunk(next);
+    size += chunk_size(next);
+  }
+
+  set_free_chunk(chunk, size);
+  insert_free_chunk(chunk);
+}
+
+/** Marks the @a size first bytes of @a chunk as used, the remaining bytes are freed if big enough. */
+static void split_chunk(chunk_t* chunk, size_t size) {
+  const size_t remaining = chunk_size(chunk) - size;
+  if (remaining < MIN_CHUNK_SIZE) {
+    chunk->size |= IN_USE;
+    next_chunk(chunk)->size |= PREV_IN_USE;
+    return;
+  }
+
+  chunk->size = size | IN_USE | (chunk->size & PREV_IN_USE);
+  chunk_t* remainder = next_chunk(chunk);
+  remainder->size = remaining | PREV_IN_USE;
+  release_chunk(remainder);
+}
+
+static chunk_t* take_from_bins(size_t size) {
+  size_t index = bin_index(size);
+
+  // The first bin may contain smaller chunks (except for the small bins), search it.
+  if (index >= NB_SMALL_BINS) {
+    for (chunk_t* chunk = g_bins[index]; chunk != NULL; chunk = chunk->next) {
+      if (chunk_size(chunk) >= size) {
+        remove_free_chunk(chunk);
+        return chunk;
+      }
+    }
+
+    ++index;
+  }
+
+  // Any chunk of the next non-empty bins is big enough.
+  const uint64_t candidates = index < NB_BINS ? g_bin_map & ~(((uint64_t)1 << index) - 1) : 0;
+  if (candidates == 0)
+    return NULL;
+
+  chunk_t* chunk = g_bins[__builtin_ctzl(candidates)];
+  remove_free_chunk(chunk);
+  return chunk;
+}
+
+/** Grows the top chunk so it has at least @a size bytes. */
+static bool grow_top(size_t size) {
+  char* old_end = sys_sbrk(0);
+  const bool is_contiguous = g_top != NULL && old_end == g_heap_end;
+
+  const size_t top_size = is_contiguous ? chunk_size(g_top) : 0;
+  size_t increment = size + MIN_CHUNK_SIZE - top_size;
+  increment = increment < MIN_GROW_SIZE ? MIN_GROW_SIZE : increment;
+  increment = (increment + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+
+  if (!is_contiguous) {
+    // First call, or the heap was moved by someone else: start a new top chunk. The old one is lost, it
+    // is marked as used so it is never merged.
+    if (g_top != NULL)
+      g_top->size |= IN_USE;
+
+    const size_t padding = -(uintptr_t)old_end & (ALIGNMENT - 1);
+    if (sys_sbrk(increment + padding) != old_end)
+      return false;
+
+    g_top = (chunk_t*)(old_end + padding);
+    g_top->size = increment | PREV_IN_USE;
+    g_heap_end = old_end + padding + increment;
+    return true;
+  }
+
+  if (sys_sbrk(increment) != old_end)
+    return false;
+
+  g_top->size += increment;
+  g_heap_end += increment;
+  return true;
+}
+
+/** Gives back to the kernel the end of the top chunk, if it is too big. */
+static void trim_top(void) {
+  const size_t top_size = chunk_size(g_top);
+  if (top_size <= TRIM_THRESHOLD)
+    return;
+
+  // The heap may have been moved by someone else, then the top chunk is not at its end.
+  if (sys_sbrk(0) != g_heap_end)
+    return;
+
+  const size_t decrement = (top_size - MIN_GROW_SIZE) & ~(size_t)(PAGE_SIZE - 1);
+  sys_sbrk(-(ptrdiff_t)decrement);
+
+  g_top->size -= decrement;
+  g_heap_end -= decrement;
+}
+
+/** Allocates a chunk of @a size bytes (a value given by request_to_size()), with the lock held. */
+static chunk_t* allocate_chunk(size_t size) {
+  chunk_t* chunk = take_from_bins(size);
+  if (chunk != NULL) {
+    split_chunk(chunk, size);
+    return chunk;
+  }
+
+  // Always keep a top chunk, so the last used chunk has a next chunk to store its flags.
+  if (g_top == NULL || chunk_size(g_top) < size + MIN_CHUNK_SIZE) {
+    if (!grow_top(size))
+      return NULL;
+  }
+
+  chunk = g_top;
+  const size_t top_size = chunk_size(g_top);
+  chunk->size = size | IN_USE | (chunk->size & PREV_IN_USE);
+  g_top = next_chunk(chunk);
+  g_top->size = (top_size - size) | PREV_IN_USE;
+  return chunk;
+}
+
+/** Allocates a chunk of @a size bytes with its own mapping, the lock is not needed. */
+static chunk_t* map_chunk(size_t size) {
+  size = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+
+  void* address;
+  if (!SYS_IS_OK(sys_mmap(size, &address)))
+    return NULL;
+
+  chunk_t* chunk = address;
+  chunk->size = size | IN_USE | PREV_IN_USE | IS_MAPPED;
+  return chunk;
+}
+
+static void free_chunk(chunk_t* chunk) {
+  chunk->size &= ~IN_USE;
+  release_chunk(chunk);
+  trim_top();
+}
+
 void* malloc(size_t n) {
-  // TODO: better malloc
-  return sys_sbrk(n);
+  const size_t size = request_to_size(n);
+  if (size == 0)
+    return NULL;
+
+  chunk_t* chunk = size >= MMAP_THRESHOLD ? map_chunk(size) : NULL;
+  if (chunk == NULL) {
+    lock();
+    chunk = allocate_chunk(size);
+    unlock();
+  }
+
+  return chunk != NULL ? chunk_to_mem(chunk) : NULL;
 }
 
 void free(void* ptr) {
-  (void)ptr;
-  // TODO: better free
+  if (ptr == NULL)
+    return;
+
+  chunk_t* chunk = mem_to_chunk(ptr);
+  if ((chunk->size & IS_MAPPED) != 0) {
+    sys_munmap(chunk, chunk_size(chunk));
+    return;
+  }
+
+  lock();
+  free_chunk(chunk);
+  unlock();
+}
+
+void* calloc(size_t count, size_t n) {
+  if (n != 0 && count > SIZE_MAX / n)
+    return NULL;
+
+  // The mapped chunks are already zeroed.
+  void* ptr = malloc(count * n);
+  if (ptr != NULL && (mem_to_chunk(ptr)->size & IS_MAPPED) == 0)
+    memset(ptr, 0, count * n);
+  return ptr;
+}
+
+/** The end of realloc() when @a ptr (in a chunk of @a old_size bytes) can not be resized in place. */
+static void* move_to_new_chunk(void* ptr, size_t old_size, size_t n) {
+  void* new_ptr = malloc(n);
+  if (new_ptr == NULL)
+    return NULL;
+
+  memcpy(new_ptr, ptr, old_size - HEADER_SIZE);
+  free(ptr);
+  return new_ptr;
+}
+
+void* realloc(void* ptr, size_t n) {
+  if (ptr == NULL)
+    return malloc(n);
+
+  if (n == 0) {
+    free(ptr);
+    return NULL;
+  }
+
+  const size_t size = request_to_size(n);
+  if (size == 0)
+    return NULL;
+
+  chunk_t* chunk = mem_to_chunk(ptr);
+  const size_t old_size = chunk_size(chunk);
+  if ((chunk->size & IS_MAPPED) != 0) {
+    if (old_size >= size)
+      return ptr;
+    return move_to_new_chunk(ptr, old_size, n);
+  }
+
+  lock();
+
+  // Try to grow in place, by taking the following free chunk.
+  chunk_t* next = next_chunk(chunk);
+  if (old_size < size && next != g_top && (next->size & IN_USE) == 0 && old_size + chunk_size(next) >= size) {
+    remove_free_chunk(next);
+    chunk->size += chunk_size(next);
+    next_chunk(chunk)->size |= PREV_IN_USE;
+  }
+
+  if (chunk_size(chunk) >= size) {
+    // Shrink in place, the end (if big enough) is given back.
+    chunk->size &= ~IN_USE;
+    split_chunk(chunk, size);
+    unlock();
+    return ptr;
+  }
+
+  unlock();
+  return move_to_new_chunk(ptr, old_size, n);
+}
+
+void* aligned_alloc(size_t alignment, size_t n) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    return NULL;
+
+  if (alignment <= ALIGNMENT)
+    return malloc(n);
+
+  const size_t size = request_to_size(n);
+  if (size == 0 || size > SIZE_MAX / 2 - alignment)
+    return NULL;
+
+  // Take enough bytes to find an aligned chunk, with room for a free chunk before it.
+  lock();
+  chunk_t* chunk = allocate_chunk(size + alignment + MIN_CHUNK_SIZE);
+  if (chunk == NULL) {
+    unlock();
+    return NULL;
+  }
+
+  uintptr_t mem = (uintptr_t)chunk_to_mem(chunk);
+  if ((mem & (alignment - 1)) != 0) {
+    uintptr_t aligned_mem = (mem + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned_mem - mem < MIN_CHUNK_SIZE)
+      aligned_mem += alignment;
+
+    // The leading bytes become a free chunk, the aligned chunk owns the remaining ones.
+    chunk_t* aligned_chunk = mem_to_chunk((void*)aligned_mem);
+    const size_t leading_size = aligned_mem - mem;
+    aligned_chunk->size = (chunk_size(chunk) - leading_size) | IN_USE;
+    chunk->size = leading_size | IN_USE | (chunk->size & PREV_IN_USE);
+    free_chunk(chunk);
+    chunk = aligned_chunk;
+  }
+
+  // Give back the trailing bytes.
+  chunk->size &= ~IN_USE;
+  split_chunk(chunk, size);
+  unlock();
+  return chunk_to_mem(chunk);
 }
@@ -1,8 +1,32 @@
 #include <string.h>
 
+#include "word_copy.h"
+
 void* memcpy(void* dst, const void* src, size_t length) {
-  char* d = (char*)dst;
-  const char* s = (const char*)src;
+  unsigned char* d = (unsigned char*)dst;
+  const unsigned char* s = (const unsigned char*)src;
+
+  if (length >= __SMALL_LENGTH) {
+    // The source and the destination can only be aligned together on the low bits they have in common.
+    const size_t alignment = __get_common_alignment(d, s);
+    for (; !__is_aligned(d, alignment); --length)
+      *d++ = *s++;
+
+    switch (alignment) {
+      case 8:
+        __copy_forward___word64_t(&d, &s, &length);
+        break;
+      case 4:
+        __copy_forward___word32_t(&d, &s, &length);
+        break;
+      case 2:
+        __copy_forward___word16_t(&d, &s, &length);
+        break;
+      default:
+        break;
+    }
+  }
+
   while (length-- > 0)
     *d++ = *s++;
   return dst;
@@ -1,19 +1,39 @@
 #include <string.h>
 
+#include "word_copy.h"
+
 void* memmove(void* dst, const void* src, size_t length) {
-  char* d = (char*)dst;
-  const char* s = (const char*)src;
+  unsigned char* d = (unsigned char*)dst;
+  const unsigned char* s = (const unsigned char*)src;
+
+  // A forward copy never overwrites the source bytes not yet read when the destination is before.
+  if (d <= s || d >= s + length)
+    return memcpy(dst, src, length);
 
-  if (d <= s) {
-    while (length-- > 0)
-      *d++ = *s++;
-  } else {
-    s += length;
-    d += length;
+  d += length;
+  s += length;
 
-    while (length-- > 0)
+  if (length >= __SMALL_LENGTH) {
+    const size_t alignment = __get_common_alignment(d, s);
+    for (; !__is_aligned(d, alignment); --length)
       *--d = *--s;
+
+    switch (alignment) {
+      case 8:
+        __copy_backward___word64_t(&d, &s, &length);
+        break;
+      case 4:
+        __copy_backward___word32_t(&d, &s, &length);
+        break;
+      case 2:
+        __copy_backward___word16_t(&d, &s, &length);
+        break;
+      default:
+        break;
+    }
   }
 
+  while (length-- > 0)
+    *--d = *--s;
   return dst;
 }
@@ -1,8 +1,31 @@
 #include <string.h>
 
+#include "word_copy.h"
+
 void* memset(void* dst, int value, size_t length) {
-  unsigned char* p = (unsigned char*)dst;
+  unsigned char* d = (unsigned char*)dst;
+  const unsigned char byte = (unsigned char)value;
+
+  if (length >= __SMALL_LENGTH) {
+    for (; !__is_aligned(d, sizeof(__word64_t)); --length)
+      *d++ = byte;
+
+    const uint64_t pattern = (uint64_t)byte * 0x0101010101010101;
+    __word64_t* w = (__word64_t*)d;
+    for (; length >= 4 * sizeof(__word64_t); length -= 4 * sizeof(__word64_t)) {
+      w[0] = pattern;
+      w[1] = pattern;
+      w[2] = pattern;
+      w[3] = pattern;
+      w += 4;
+    }
+
+    for (; length >= sizeof(__word64_t); length -= sizeof(__word64_t))
+      *w++ = pattern;
+    d = (unsigned char*)w;
+  }
+
   while (length-- > 0)
-    *p++ = (unsigned char)value;
+    *d++ = byte;
   return dst;
 }
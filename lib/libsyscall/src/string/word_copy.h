@@ -0,0 +1,89 @@
+#ifndef __PIKAOS_LIBC_STRING_WORD_COPY_H__
+#define __PIKAOS_LIBC_STRING_WORD_COPY_H__
+
+/*
+ * Helpers for the memory functions: the memory is accessed by whole aligned words (the unaligned accesses are
+ * forbidden, see -mstrict-align). These are the same algorithms as the libk ones used by the kernel.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/** Below this byte length, the functions go byte by byte (the alignment handling is not worth it). */
+#define __SMALL_LENGTH 16
+
+typedef uint64_t __attribute__((__may_alias__)) __word64_t;
+typedef uint32_t __attribute__((__may_alias__)) __word32_t;
+typedef uint16_t __attribute__((__may_alias__)) __word16_t;
+
+static inline int __is_aligned(const void* ptr, size_t alignment) {
+  return ((uintptr_t)ptr & (alignment - 1)) == 0;
+}
+
+/** Gets the biggest word size on which @a dst and @a src can be both aligned. */
+static inline size_t __get_common_alignment(const void* dst, const void* src) {
+  const uintptr_t diff = (uintptr_t)dst ^ (uintptr_t)src;
+  if ((diff & 7) == 0)
+    return 8;
+  if ((diff & 3) == 0)
+    return 4;
+  if ((diff & 1) == 0)
+    return 2;
+  return 1;
+}
+
+/*
+ * Copies the most of the *length bytes by words of type T, *dst and *src are aligned on T.
+ * The backward versions copy from the end, *dst and *src point past the bytes to copy.
+ * Four words are copied by iteration, the compiler does them as ldp/stp pairs.
+ */
+#define __DEFINE_WORD_COPY(T)                                                            \
+  static inline void __copy_forward_##T(unsigned char** dst, const unsigned char** src,  \
+      size_t* length) {                                                                  \
+    T* d = (T*)*dst;                                                                     \
+    const T* s = (const T*)*src;                                                         \
+    size_t n = *length;                                                                  \
+    for (; n >= 4 * sizeof(T); n -= 4 * sizeof(T)) {                                     \
+      const T w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];                                \
+      d[0] = w0;                                                                         \
+      d[1] = w1;                                                                         \
+      d[2] = w2;                                                                         \
+      d[3] = w3;                                                                         \
+      d += 4;                                                                            \
+      s += 4;                                                                            \
+    }                                                                                    \
+    for (; n >= sizeof(T); n -= sizeof(T))                                               \
+      *d++ = *s++;                                                                       \
+    *dst = (unsigned char*)d;                                                            \
+    *src = (const unsigned char*)s;                                                      \
+    *length = n;                                                                         \
+  }                                                                                      \
+                                                                                         \
+  static inline void __copy_backward_##T(unsigned char** dst, const unsigned char** src, \
+      size_t* length) {                                                                  \
+    T* d = (T*)*dst;                                                                     \
+    const T* s = (const T*)*src;                                                         \
+    size_t n = *length;                                                                  \
+    for (; n >= 4 * sizeof(T); n -= 4 * sizeof(T)) {                                     \
+      d -= 4;                                                                            \
+      s -= 4;                                                                            \
+      const T w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];                                \
+      d[3] = w3;                                                                         \
+      d[2] = w2;                                                                         \
+      d[1] = w1;                                                                         \
+      d[0] = w0;                                                                         \
+    }                                                                                    \
+    for (; n >= sizeof(T); n -= sizeof(T))                                               \
+      *--d = *--s;                                                                       \
+    *dst = (unsigned char*)d;                                                            \
+    *src = (const unsigned char*)s;                                                      \
+    *length = n;                                                                         \
+  }
+
+__DEFINE_WORD_COPY(__word64_t)
+__DEFINE_WORD_COPY(__word32_t)
+__DEFINE_WORD_COPY(__word16_t)
+
+#undef __DEFINE_WORD_COPY
+
+#endif  // !__PIKAOS_LIBC_STRING_WORD_COPY_H__
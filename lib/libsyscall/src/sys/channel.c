@@ -0,0 +1,185 @@
+#include <assert.h>
+#include <string.h>
+#include <sys/channel.h>
+#include <sys/syscall.h>
+
+/* The shared memory of a channel holds two rings: the first one is sent by the creator of the channel, the
+ * second one by its peer. */
+static void init_rings(sys_channel_t* channel, void* shared, sys_bool_t is_creator) {
+  sys_channel_ring_t* rings = (sys_channel_ring_t*)shared;
+  channel->send_ring = is_creator ? &rings[0] : &rings[1];
+  channel->receive_ring = is_creator ? &rings[1] : &rings[0];
+}
+
+sys_error_t sys_channel_create(const char* name, sys_channel_t* channel) {
+  assert(name != NULL && channel != NULL);
+
+  void* shared = NULL;
+  const sys_error_t error = __syscall3(SYS_CHANNEL_CREATE, (sys_word_t)name, (sys_word_t)&channel->handle,
+                                       (sys_word_t)&shared);
+  if (SYS_IS_OK(error))
+    init_rings(channel, shared, sys_true);
+  return error;
+}
+
+sys_error_t sys_channel_connect(const char* name, sys_channel_t* channel) {
+  assert(name != NULL && channel != NULL);
+
+  void* shared = NULL;
+  const sys_error_t error = __syscall3(SYS_CHANNEL_CONNECT, (sys_word_t)name, (sys_word_t)&channel->handle,
+                                       (sys_word_t)&shared);
+  if (SYS_IS_OK(error))
+    init_rings(channel, shared, sys_false);
+  return error;
+}
+
+void sys_channel_close(sys_channel_t* channel) {
+  assert(channel != NULL);
+  __syscall1(SYS_CHANNEL_CLOSE, (sys_word_t)channel->handle);
+  channel->send_ring = NULL;
+  channel->receive_ring = NULL;
+}
+
+sys_channel_message_t* sys_channel_prepare_send(sys_channel_t* channel) {
+  assert(channel != NULL);
+  sys_channel_ring_t* ring = channel->send_ring;
+
+  // The tail is only written by us, the head is advanced concurrently by the peer.
+  const uint32_t tail = ring->tail;
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= SYS_CHANNEL_RING_SIZE)
+    return NULL;
+
+  return &ring->messages[tail % SYS_CHANNEL_RING_SIZE];
+}
+
+void sys_channel_commit_send(sys_channel_t* channel) {
+  assert(channel != NULL);
+  sys_channel_ring_t* ring = channel->send_ring;
+
+  // Sequentially consistent: either we see the waiting flag, or the kernel sees the new tail before blocking
+  // the peer (see Channel::block_task_until_ready()).
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->receiver_waiting, __ATOMIC_SEQ_CST))
+    sys_channel_notify(channel);
+}
+
+sys_error_t sys_channel_send(sys_channel_t* channel, uint32_t tag, const void* data, size_t size, sys_word_t grant) {
+  assert(channel != NULL && (data != NULL || size == 0));
+  if (size > SYS_CHANNEL_MESSAGE_SIZE)
+    return SYS_ERR_GENERIC;
+
+  sys_channel_message_t* message;
+  while ((message = sys_channel_prepare_send(channel)) == NULL) {
+    const sys_error_t error = sys_channel_wait(channel, sys_true);
+    if (!SYS_IS_OK(error))
+      return error;
+  }
+
+  message->size = (uint32_t)size;
+  message->tag = tag;
+  message->grant = grant;
+  memcpy(message->data, data, size);
+  sys_channel_commit_send(channel);
+  return SYS_ERR_OK;
+}
+
+const sys_channel_message_t* sys_channel_peek_receive(sys_channel_t* channel) {
+  assert(channel != NULL);
+  sys_channel_ring_t* ring = channel->receive_ring;
+
+  const uint32_t head = ring->head;
+  if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  return &ring->messages[head % SYS_CHANNEL_RING_SIZE];
+}
+
+void sys_channel_release_receive(sys_channel_t* channel) {
+  assert(channel != NULL);
+  sys_channel_ring_t* ring = channel->receive_ring;
+
+  // Same as sys_channel_commit_send(), for the sender waiting for room.
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->sender_waiting, __ATOMIC_SEQ_CST))
+    sys_channel_notify(channel);
+}
+
+sys_error_t sys_channel_receive(sys_channel_t* channel, sys_channel_message_t* message) {
+  assert(channel != NULL && message != NULL);
+
+  const sys_channel_message_t* received;
+  while ((received = sys_channel_peek_receive(channel)) == NULL) {
+    const sys_error_t error = sys_channel_wait(channel, sys_false);
+    if (!SYS_IS_OK(error))
+      return error;
+  }
+
+  // The size is written by the peer, which may be buggy.
+  const uint32_t size = received->size <= SYS_CHANNEL_MESSAGE_SIZE ? received->size : SYS_CHANNEL_MESSAGE_SIZE;
+  message->size = size;
+  message->tag = received->tag;
+  message->grant = received->grant;
+  memcpy(message->data, received->data, size);
+  sys_channel_release_receive(channel);
+  return SYS_ERR_OK;
+}
+
+sys_error_t sys_channel_wait(sys_channel_t* channel, sys_bool_t for_send) {
+  assert(channel != NULL);
+  return __syscall2(SYS_CHANNEL_WAIT, (sys_word_t)channel->handle, for_send);
+}
+
+sys_error_t sys_channel_notify(sys_channel_t* channel) {
+  assert(channel != NULL);
+  return __syscall1(SYS_CHANNEL_NOTIFY, (sys_word_t)channel->handle);
+}
+
+sys_error_t sys_channel_grant_alloc(sys_channel_t* channel, size_t size, void** address, sys_word_t* grant) {
+  assert(channel != NULL && address != NULL && grant != NULL);
+  return __syscall4(SYS_CHANNEL_GRANT_ALLOC, (sys_word_t)channel->handle, size, (sys_word_t)address,
+                    (sys_word_t)grant);
+}
+
+sys_error_t sys_channel_grant_accept(sys_channel_t* channel, sys_word_t grant, void** address, size_t* size) {
+  assert(channel != NULL && address != NULL);
+
+  size_t byte_size = 0;
+  const sys_error_t error =
+      __syscall4(SYS_CHANNEL_GRANT_ACCEPT, (sys_word_t)channel->handle, grant, (sys_word_t)address,
+                 (sys_word_t)&byte_size);
+  if (size != NULL)
+    *size = byte_size;
+  return error;
+}
+
+sys_error_t sys_channel_grant_release(sys_channel_t* channel, void* address) {
+  assert(channel != NULL);
+  return __syscall2(SYS_CHANNEL_GRANT_RELEASE, (sys_word_t)channel->handle, (sys_word_t)address);
+}
+
+/* The message is passed in x1-x4, in both directions. */
+static sys_error_t __sys_channel_call(uint32_t id, sys_channel_t* channel, sys_channel_call_t* message) {
+  assert(channel != NULL && message != NULL);
+
+  register uint32_t id_reg asm("w8") = id;
+  register sys_word_t x0 asm("x0") = (sys_word_t)channel->handle;
+  register sys_word_t x1 asm("x1") = message->words[0];
+  register sys_word_t x2 asm("x2") = message->words[1];
+  register sys_word_t x3 asm("x3") = message->words[2];
+  register sys_word_t x4 asm("x4") = message->words[3];
+  asm volatile("svc #0" : "+r"(x0), "+r"(x1), "+r"(x2), "+r"(x3), "+r"(x4) : "r"(id_reg) : "memory");
+
+  message->words[0] = x1;
+  message->words[1] = x2;
+  message->words[2] = x3;
+  message->words[3] = x4;
+  return (sys_error_t)x0;
+}
+
+sys_error_t sys_channel_call(sys_channel_t* channel, sys_channel_call_t* message) {
+  return __sys_channel_call(SYS_CHANNEL_CALL, channel, message);
+}
+
+sys_error_t sys_channel_reply_wait(sys_channel_t* channel, sys_channel_call_t* message) {
+  return __sys_channel_call(SYS_CHANNEL_REPLY_WAIT, channel, message);
+}
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <string.h>
 #include <sys/file.h>
 #include <sys/syscall.h>
 
@@ -18,11 +19,42 @@ sys_error_t sys_file_read(sys_file_t* file, void* buffer, size_t bytes_to_read,
   return __syscall4(SYS_READ_FILE, (sys_word_t)file, (sys_word_t)buffer, bytes_to_read, (sys_word_t)read_bytes);
 }
 
+sys_error_t sys_file_write(sys_file_t* file, const void* buffer, size_t bytes_to_write, size_t* wrote_bytes) {
+  assert(file != NULL);
+  assert(bytes_to_write == 0 || buffer != NULL);
+
+  return __syscall4(SYS_WRITE_FILE, (sys_word_t)file, (sys_word_t)buffer, bytes_to_write, (sys_word_t)wrote_bytes);
+}
+
+sys_error_t sys_file_truncate(sys_file_t* file) {
+  assert(file != NULL);
+  return __syscall1(SYS_TRUNCATE_FILE, (sys_word_t)file);
+}
+
+sys_error_t sys_sync(void) {
+  return __syscall0(SYS_SYNC);
+}
+
 size_t sys_get_file_size(sys_file_t* file) {
   assert(file != NULL);
   return __syscall1(SYS_GET_FILE_SIZE, (sys_word_t)file);
 }
 
+sys_error_t sys_file_seek(sys_file_t* file, size_t offset) {
+  assert(file != NULL);
+  return __syscall2(SYS_SEEK_FILE, (sys_word_t)file, offset);
+}
+
+sys_error_t sys_mmap_file(sys_file_t* file, const void** address) {
+  assert(file != NULL && address != NULL);
+  return __syscall2(SYS_MMAP_FILE, (sys_word_t)file, (sys_word_t)address);
+}
+
+sys_error_t sys_get_thumbnail(const char* path, uint32_t max_width, uint32_t max_height, sys_thumbnail_t* thumbnail) {
+  assert(path != NULL && thumbnail != NULL);
+  return __syscall4(SYS_GET_THUMBNAIL, (sys_word_t)path, max_width, max_height, (sys_word_t)thumbnail);
+}
+
 sys_dir_t* sys_open_dir(const char* path) {
   assert(path != NULL);
   return (sys_dir_t*)__syscall1(SYS_OPEN_DIR, (sys_word_t)path);
@@ -37,3 +69,44 @@ sys_error_t sys_read_dir(sys_dir_t* dir, sys_file_info_t* info) {
   assert(dir != NULL && info != NULL);
   return __syscall2(SYS_READ_DIR, (sys_word_t)dir, (sys_word_t)info);
 }
+
+sys_error_t sys_read_dir_many(sys_dir_t* dir, void* buffer, size_t buffer_size, uint32_t flags, size_t* read_size) {
+  assert(dir != NULL && buffer != NULL && read_size != NULL);
+  return __syscall5(SYS_READ_DIR_MANY, (sys_word_t)dir, (sys_word_t)buffer, buffer_size, flags, (sys_word_t)read_size);
+}
+
+sys_error_t sys_io_setup(sys_io_ring_t* ring) {
+  assert(ring != NULL);
+  memset(ring, 0, sizeof(sys_io_ring_t));
+  return __syscall1(SYS_IO_SETUP, (sys_word_t)ring);
+}
+
+sys_bool_t sys_io_submit(sys_io_ring_t* ring, const sys_io_submission_t* submission) {
+  assert(ring != NULL && submission != NULL);
+
+  // The submission tail is only written by us, the head is advanced concurrently by the worker.
+  const uint32_t tail = ring->submission_tail;
+  if (tail - __atomic_load_n(&ring->submission_head, __ATOMIC_ACQUIRE) >= SYS_IO_RING_SIZE)
+    return sys_false;
+
+  ring->submissions[tail % SYS_IO_RING_SIZE] = *submission;
+  __atomic_store_n(&ring->submission_tail, tail + 1, __ATOMIC_RELEASE);
+  return sys_true;
+}
+
+sys_error_t sys_io_enter(sys_io_ring_t* ring, uint32_t min_completions) {
+  assert(ring != NULL);
+  return __syscall2(SYS_IO_ENTER, (sys_word_t)ring, min_completions);
+}
+
+sys_bool_t sys_io_get_completion(sys_io_ring_t* ring, sys_io_completion_t* completion) {
+  assert(ring != NULL && completion != NULL);
+
+  const uint32_t head = ring->completion_head;
+  if (head == __atomic_load_n(&ring->completion_tail, __ATOMIC_ACQUIRE))
+    return sys_false;
+
+  *completion = ring->completions[head % SYS_IO_RING_SIZE];
+  __atomic_store_n(&ring->completion_head, head + 1, __ATOMIC_RELEASE);
+  return sys_true;
+}
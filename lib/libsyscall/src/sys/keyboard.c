@@ -9,6 +9,7 @@
 #define CAP_MASK (MASK(25))
 #define SCROLL_MASK (MASK(26))
 #define KEY_CODE_MASK (0xffff)
+#define REPEAT_EVENT (MASK(29))
 #define PRESS_EVENT (MASK(30))
 #define RELEASE_EVENT (MASK(31))
 
@@ -52,6 +53,10 @@ sys_bool_t sys_is_release_event(sys_key_event_t event) {
   return (event & RELEASE_EVENT) != 0;
 }
 
+sys_bool_t sys_is_repeat_event(sys_key_event_t event) {
+  return (event & REPEAT_EVENT) != 0;
+}
+
 sys_key_event_t sys_create_press_event(sys_key_code_t code, sys_key_modifiers_t mods) {
   sys_key_event_t e = code;
   e |= (mods & SYS_KEY_MOD_CTRL) != 0 ? CTRL_MASK : 0;
@@ -77,3 +82,7 @@ sys_key_event_t sys_create_release_event(sys_key_code_t code, sys_key_modifiers_
   e |= RELEASE_EVENT;
   return e;
 }
+
+sys_key_event_t sys_create_repeat_event(sys_key_code_t code, sys_key_modifiers_t mods) {
+  return sys_create_press_event(code, mods) | REPEAT_EVENT;
+}
@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <string.h>
+#include <sys/net.h>
+#include <sys/syscall.h>
+
+sys_error_t sys_net_get_info(sys_net_info_t* info) {
+  assert(info != NULL);
+  return __syscall1(SYS_NET_GET_INFO, (sys_word_t)info);
+}
+
+sys_error_t sys_net_send(const void* frame, size_t size) {
+  assert(frame != NULL);
+  return __syscall2(SYS_NET_SEND, (sys_word_t)frame, size);
+}
+
+sys_error_t sys_net_receive(void* buffer, size_t capacity, size_t* size) {
+  assert(buffer != NULL && size != NULL);
+  return __syscall3(SYS_NET_RECEIVE, (sys_word_t)buffer, capacity, (sys_word_t)size);
+}
+
+sys_error_t sys_net_get_ipv4_config(sys_net_ipv4_config_t* config) {
+  assert(config != NULL);
+  return __syscall1(SYS_NET_GET_IPV4_CONFIG, (sys_word_t)config);
+}
+
+sys_error_t sys_net_set_ipv4_config(const sys_net_ipv4_config_t* config) {
+  assert(config != NULL);
+  return __syscall1(SYS_NET_SET_IPV4_CONFIG, (sys_word_t)config);
+}
+
+sys_error_t sys_udp_open(uint16_t port, sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+
+  // The shared memory holds the send ring, then the receive ring.
+  void* shared = NULL;
+  const sys_error_t error = __syscall4(SYS_UDP_OPEN, port, (sys_word_t)&socket->handle, (sys_word_t)&shared,
+                                       (sys_word_t)&socket->port);
+  if (SYS_IS_OK(error)) {
+    socket->send_ring = &((sys_udp_ring_t*)shared)[0];
+    socket->receive_ring = &((sys_udp_ring_t*)shared)[1];
+  }
+  return error;
+}
+
+void sys_udp_close(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  __syscall1(SYS_UDP_CLOSE, (sys_word_t)socket->handle);
+  socket->send_ring = NULL;
+  socket->receive_ring = NULL;
+}
+
+sys_udp_datagram_t* sys_udp_prepare_send(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  sys_udp_ring_t* ring = socket->send_ring;
+
+  // The tail is only written by us, the head is advanced concurrently by the kernel.
+  const uint32_t tail = ring->tail;
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= SYS_UDP_RING_SIZE)
+    return NULL;
+
+  return &ring->datagrams[tail % SYS_UDP_RING_SIZE];
+}
+
+void sys_udp_commit_send(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  sys_udp_ring_t* ring = socket->send_ring;
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+sys_error_t sys_udp_flush(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  return __syscall1(SYS_UDP_FLUSH, (sys_word_t)socket->handle);
+}
+
+sys_error_t sys_udp_send(sys_udp_socket_t* socket, uint32_t address, uint16_t port, const void* data, size_t size) {
+  assert(socket != NULL && (data != NULL || size == 0));
+  if (size > SYS_UDP_MAX_PAYLOAD)
+    return SYS_ERR_GENERIC;
+
+  sys_udp_datagram_t* datagram;
+  while ((datagram = sys_udp_prepare_send(socket)) == NULL) {
+    const sys_error_t error = sys_udp_flush(socket);
+    if (!SYS_IS_OK(error))
+      return error;
+  }
+
+  datagram->address = address;
+  datagram->port = port;
+  datagram->size = (uint16_t)size;
+  memcpy(datagram->data, data, size);
+  sys_udp_commit_send(socket);
+  return sys_udp_flush(socket);
+}
+
+const sys_udp_datagram_t* sys_udp_peek_receive(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  sys_udp_ring_t* ring = socket->receive_ring;
+
+  const uint32_t head = ring->head;
+  if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  return &ring->datagrams[head % SYS_UDP_RING_SIZE];
+}
+
+void sys_udp_release_receive(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  sys_udp_ring_t* ring = socket->receive_ring;
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+sys_error_t sys_udp_wait(sys_udp_socket_t* socket) {
+  assert(socket != NULL);
+  return __syscall1(SYS_UDP_WAIT, (sys_word_t)socket->handle);
+}
+
+sys_error_t sys_udp_receive(sys_udp_socket_t* socket, sys_udp_datagram_t* datagram) {
+  assert(socket != NULL && datagram != NULL);
+
+  const sys_udp_datagram_t* received;
+  while ((received = sys_udp_peek_receive(socket)) == NULL) {
+    const sys_error_t error = sys_udp_wait(socket);
+    if (!SYS_IS_OK(error))
+      return error;
+  }
+
+  // The size is written by the kernel, so it is valid.
+  datagram->address = received->address;
+  datagram->port = received->port;
+  datagram->size = received->size;
+  memcpy(datagram->data, received->data, received->size);
+  sys_udp_release_receive(socket);
+  return SYS_ERR_OK;
+}
@@ -14,12 +14,50 @@ sys_error_t sys_usleep(uint64_t time_in_us) {
   return __syscall1(SYS_SLEEP, time_in_us);
 }
 
+uint64_t sys_get_ticks() {
+  uint64_t counter;
+  // The ISB keeps the read from being done before the preceding instructions.
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(counter));
+  return counter;
+}
+
+uint64_t sys_get_tick_frequency() {
+  uint64_t frequency;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+  return frequency;
+}
+
+uint64_t sys_get_time_ns() {
+  const uint64_t ns_per_tick = sys_get_info_page()->ns_per_tick;
+  return (uint64_t)(((unsigned __int128)sys_get_ticks() * ns_per_tick) >> 32);
+}
+
+const sys_info_page_t* sys_get_info_page() {
+  return (const sys_info_page_t*)SYS_INFO_PAGE_ADDRESS;
+}
+
 sys_error_t sys_print(const char* msg) {
   return __syscall1(SYS_PRINT, (sys_word_t)msg);
 }
 
 sys_error_t sys_spawn(const char* path) {
-  return __syscall1(SYS_SPAWN, (sys_word_t)path);
+  return sys_spawn_in_group(path, 0);
+}
+
+sys_error_t sys_spawn_in_group(const char* path, sys_task_group_t group) {
+  return __syscall2(SYS_SPAWN, (sys_word_t)path, group);
+}
+
+sys_error_t sys_zygote_start(const char* path) {
+  return __syscall1(SYS_ZYGOTE_START, (sys_word_t)path);
+}
+
+sys_error_t sys_zygote_ready() {
+  return __syscall0(SYS_ZYGOTE_READY);
+}
+
+sys_error_t sys_spawn_from_zygote(const char* path) {
+  return __syscall1(SYS_SPAWN_FROM_ZYGOTE, (sys_word_t)path);
 }
 
 sys_error_t sys_yield() {
@@ -27,7 +65,10 @@ sys_error_t sys_yield() {
 }
 
 sys_pid_t sys_getpid() {
-  return __syscall0(SYS_GETPID);
+  // The kernel stores the ID of the running task in TPIDRRO_EL0 (read-only from EL0) at each context switch.
+  uint64_t pid;
+  asm volatile("mrs %0, tpidrro_el0" : "=r"(pid));
+  return (sys_pid_t)pid;
 }
 
 sys_error_t sys_sched_set_priority(sys_pid_t pid, uint32_t priority) {
@@ -38,10 +79,118 @@ sys_error_t sys_sched_get_priority(sys_pid_t pid, uint32_t* priority) {
   return __syscall2(SYS_SCHED_SET_PRIORITY, pid, (sys_word_t)priority);
 }
 
+sys_error_t sys_sched_set_affinity(sys_pid_t pid, uint32_t core_mask) {
+  return __syscall2(SYS_SCHED_SET_AFFINITY, pid, core_mask);
+}
+
+sys_error_t sys_sched_get_affinity(sys_pid_t pid, uint32_t* core_mask) {
+  return __syscall2(SYS_SCHED_GET_AFFINITY, pid, (sys_word_t)core_mask);
+}
+
+sys_error_t sys_task_group_create(uint64_t quota_us, uint64_t period_us, sys_task_group_t* group) {
+  return __syscall3(SYS_TASK_GROUP_CREATE, quota_us, period_us, (sys_word_t)group);
+}
+
+sys_error_t sys_task_group_destroy(sys_task_group_t group) {
+  return __syscall1(SYS_TASK_GROUP_DESTROY, group);
+}
+
 sys_error_t sys_debug(uint64_t x) {
-  return __syscall1(SYS_DEBUG, x);
+  return sys_debug_command(SYS_DEBUG_PRINT, x);
+}
+
+sys_error_t sys_debug_command(uint32_t command, uint64_t x) {
+  return __syscall2(SYS_DEBUG, x, command);
 }
 
 void* sys_sbrk(ptrdiff_t __increment) {
   return (void*)__syscall1(SYS_SBRK, __increment);
 }
+
+sys_error_t sys_mmap(size_t length, void** address) {
+  return __syscall2(SYS_MMAP, length, (sys_word_t)address);
+}
+
+sys_error_t sys_munmap(void* address, size_t length) {
+  return __syscall2(SYS_MUNMAP, (sys_word_t)address, length);
+}
+
+sys_error_t sys_futex_wait(uint32_t* address, uint32_t expected) {
+  return __syscall2(SYS_FUTEX_WAIT, (sys_word_t)address, expected);
+}
+
+uint32_t sys_futex_wake(uint32_t* address, uint32_t count) {
+  return __syscall2(SYS_FUTEX_WAKE, (sys_word_t)address, count);
+}
+
+// Set once the process has created a thread (never cleared, a forked child only takes the slow path).
+static sys_bool_t g_has_threads = sys_false;
+
+void sys_mutex_lock(sys_mutex_t* mutex) {
+  // Alone in the process, nobody else can write the word.
+  if (!__atomic_load_n(&g_has_threads, __ATOMIC_RELAXED)) {
+    mutex->word = 1;
+    return;
+  }
+
+  __syscall1(SYS_MUTEX_LOCK, (sys_word_t)&mutex->word);
+}
+
+void sys_mutex_unlock(sys_mutex_t* mutex) {
+  if (!__atomic_load_n(&g_has_threads, __ATOMIC_RELAXED)) {
+    mutex->word = 0;
+    return;
+  }
+
+  __syscall1(SYS_MUTEX_UNLOCK, (sys_word_t)&mutex->word);
+}
+
+// The real thread entry point, called by the kernel with (entry, arg).
+static void __sys_thread_start(void (*entry)(void*), void* arg) {
+  entry(arg);
+  sys_exit(0);
+}
+
+sys_error_t sys_thread_create(void (*entry)(void*), void* arg, sys_pid_t* tid) {
+  // Before the thread exists: a mutex locked without system call is kept locked by its word.
+  __atomic_store_n(&g_has_threads, sys_true, __ATOMIC_SEQ_CST);
+  return __syscall4(SYS_THREAD_CREATE, (sys_word_t)__sys_thread_start, (sys_word_t)entry, (sys_word_t)arg,
+                    (sys_word_t)tid);
+}
+
+sys_error_t sys_thread_join(sys_pid_t tid, int* exit_code) {
+  return __syscall2(SYS_THREAD_JOIN, tid, (sys_word_t)exit_code);
+}
+
+sys_error_t sys_fork(sys_pid_t* child_pid) {
+  // The child process ID is returned in x1 (the child itself gets 0), it can not be written by the
+  // kernel through a pointer as both processes have their own copy of the memory.
+  register uint32_t id_reg asm("w8") = SYS_FORK;
+  register sys_word_t error asm("x0");
+  register sys_word_t pid asm("x1");
+  asm volatile("svc #0" : "=r"(error), "=r"(pid) : "r"(id_reg) : "memory");
+
+  if (SYS_IS_OK(error) && child_pid != NULL)
+    *child_pid = (sys_pid_t)pid;
+  return error;
+}
+
+sys_error_t sys_get_stats(uint32_t id, sys_bool_t global, sys_syscall_stats_t* stats) {
+  return __syscall3(SYS_GET_STATS, id, global, (sys_word_t)stats);
+}
+
+sys_error_t sys_get_task_stats(sys_task_stats_t* stats, size_t max_count, size_t* count) {
+  return __syscall3(SYS_TASK_STATS, (sys_word_t)stats, max_count, (sys_word_t)count);
+}
+
+sys_error_t sys_get_input_latency_stats(sys_syscall_stats_t* stats) {
+  return __syscall1(SYS_GET_INPUT_LATENCY_STATS, (sys_word_t)stats);
+}
+
+sys_error_t sys_get_latency_stats(uint32_t kind, sys_syscall_stats_t* stats, uint64_t* max_site) {
+  return __syscall3(SYS_GET_LATENCY_STATS, kind, (sys_word_t)stats, (sys_word_t)max_site);
+}
+
+sys_error_t sys_kexec(const char* kernel_path, const char* ramdisk_path) {
+  return __syscall2(SYS_KEXEC, (sys_word_t)kernel_path, (sys_word_t)ramdisk_path);
+}
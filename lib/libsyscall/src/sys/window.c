@@ -8,6 +8,8 @@ struct __sys_window_t {
   // Internal handle to identify the window inside the kernel.
   sys_word_t kernel_handle;
   uint32_t flags;
+  // The state page published by the kernel, or NULL if it could not be mapped.
+  const sys_window_state_t* state;
 
   // The saved window title (UTF-8 encoded).
   char* title;
@@ -32,6 +34,10 @@ sys_window_t* sys_window_create(const char* title,
   if (window->kernel_handle == 0)
     goto error;  // kernel_handle is 0 only in case of error.
 
+  // The state is then read without system calls.
+  if (!SYS_IS_OK(__syscall2(SYS_WINDOW_GET_STATE, window->kernel_handle, (sys_word_t)&window->state)))
+    window->state = NULL;
+
   // Configure the window.
   if (!SYS_IS_OK(sys_window_set_title(window, title)))
     goto error;
@@ -85,9 +91,23 @@ sys_bool_t sys_poll_message(sys_window_t* window, sys_message_t* msg) {
   return sys_true;
 }
 
+size_t sys_poll_messages(sys_window_t* window, sys_message_t* msgs, size_t max_count) {
+  assert(window != NULL && msgs != NULL);
+
+  size_t count = 0;
+  sys_word_t result =
+      __syscall4(SYS_POLL_MESSAGES, window->kernel_handle, (sys_word_t)msgs, max_count, (sys_word_t)&count);
+  if (!SYS_IS_OK(result))
+    return 0;
+
+  for (size_t i = 0; i < count; ++i)
+    handle_message(window, &msgs[i]);
+  return count;
+}
+
 void sys_poll_all_messages(sys_window_t* window) {
-  sys_message_t message;
-  while (sys_poll_message(window, &message))
+  sys_message_t messages[16];
+  while (sys_poll_messages(window, messages, 16) > 0)
     continue;
 }
 
@@ -97,6 +117,100 @@ void sys_wait_message(sys_window_t* window, sys_message_t* msg) {
   handle_message(window, msg);
 }
 
+sys_error_t sys_timer_create(sys_window_t* window, sys_timer_t* timer) {
+  assert(window != NULL && timer != NULL);
+  return __syscall2(SYS_TIMER_CREATE, window->kernel_handle, (sys_word_t)timer);
+}
+
+sys_error_t sys_timer_arm(sys_timer_t timer, uint64_t delay_us, uint64_t period_us) {
+  return __syscall3(SYS_TIMER_ARM, timer, delay_us, period_us);
+}
+
+sys_error_t sys_window_request_frame(sys_window_t* window) {
+  assert(window != NULL);
+  return __syscall1(SYS_WINDOW_REQUEST_FRAME, window->kernel_handle);
+}
+
+void sys_event_loop_init(sys_event_loop_t* loop,
+                         sys_window_t* window,
+                         sys_event_loop_message_fn on_message,
+                         sys_event_loop_frame_fn on_frame,
+                         void* user_data) {
+  assert(loop != NULL && window != NULL && on_frame != NULL);
+
+  memset(loop, 0, sizeof(sys_event_loop_t));
+  loop->window = window;
+  loop->on_message = on_message;
+  loop->on_frame = on_frame;
+  loop->user_data = user_data;
+}
+
+void sys_event_loop_invalidate(sys_event_loop_t* loop) {
+  assert(loop != NULL);
+  loop->is_invalidated = sys_true;
+}
+
+void sys_event_loop_quit(sys_event_loop_t* loop) {
+  assert(loop != NULL);
+  loop->is_running = sys_false;
+}
+
+#define EVENT_LOOP_BATCH_SIZE 16
+
+void sys_event_loop_run(sys_event_loop_t* loop) {
+  assert(loop != NULL);
+
+  loop->is_running = sys_true;
+  loop->is_invalidated = sys_true;
+  while (loop->is_running) {
+    if (loop->is_invalidated && !loop->is_frame_requested) {
+      loop->is_frame_requested = SYS_IS_OK(sys_window_request_frame(loop->window));
+      if (!loop->is_frame_requested) {
+        // No frame will come, draw right away.
+        loop->is_invalidated = sys_false;
+        loop->on_frame(loop, 0);
+        continue;
+      }
+    }
+
+    // A single wait for the next message, then take all the pending ones.
+    sys_message_t messages[EVENT_LOOP_BATCH_SIZE];
+    sys_wait_message(loop->window, &messages[0]);
+    const size_t count = 1 + sys_poll_messages(loop->window, messages + 1, EVENT_LOOP_BATCH_SIZE - 1);
+
+    sys_bool_t has_frame = sys_false;
+    uint64_t frame_time = 0;
+    for (size_t i = 0; i < count && loop->is_running; ++i) {
+      const sys_message_t* message = &messages[i];
+      switch (message->id) {
+        case SYS_MSG_FRAME:
+          loop->is_frame_requested = sys_false;
+          has_frame = sys_true;
+          frame_time = message->param1;
+          continue;
+        case SYS_MSG_SHOW:
+        case SYS_MSG_RESIZE:
+          loop->is_invalidated = sys_true;
+          break;
+        default:
+          break;
+      }
+
+      if (loop->on_message != NULL)
+        loop->on_message(loop, message);
+    }
+
+    if (has_frame && loop->is_invalidated && loop->is_running) {
+      loop->is_invalidated = sys_false;
+      loop->on_frame(loop, frame_time);
+    }
+  }
+}
+
+sys_error_t sys_timer_destroy(sys_timer_t timer) {
+  return __syscall1(SYS_TIMER_DESTROY, timer);
+}
+
 sys_error_t sys_window_set_title(sys_window_t* window, const char* title) {
   assert(window != NULL && title != NULL);
 
@@ -119,7 +233,14 @@ sys_error_t sys_window_set_visibility(sys_window_t* window, sys_bool_t visible)
 
 sys_error_t sys_window_get_visibility(sys_window_t* window, sys_bool_t* visible) {
   assert(window != NULL);
-  return __syscall2(SYS_WINDOW_GET_VISIBILITY, window->kernel_handle, (sys_word_t)visible);
+
+  sys_window_state_t state;
+  if (window->state == NULL || !SYS_IS_OK(sys_window_get_state(window, &state)))
+    return __syscall2(SYS_WINDOW_GET_VISIBILITY, window->kernel_handle, (sys_word_t)visible);
+
+  if (visible != NULL)
+    *visible = state.visible != 0;
+  return SYS_ERR_OK;
 }
 
 sys_error_t sys_window_set_geometry(sys_window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height) {
@@ -131,8 +252,46 @@ sys_error_t sys_window_set_geometry(sys_window_t* window, int32_t x, int32_t y,
 sys_error_t sys_window_get_geometry(sys_window_t* window, uint32_t* x, uint32_t* y, uint32_t* width, uint32_t* height) {
   assert(window != NULL);
 
-  return __syscall5(SYS_WINDOW_GET_GEOMETRY, window->kernel_handle, (sys_word_t)x, (sys_word_t)y, (sys_word_t)width,
-                    (sys_word_t)height);
+  sys_window_state_t state;
+  if (window->state == NULL || !SYS_IS_OK(sys_window_get_state(window, &state)))
+    return __syscall5(SYS_WINDOW_GET_GEOMETRY, window->kernel_handle, (sys_word_t)x, (sys_word_t)y,
+                      (sys_word_t)width, (sys_word_t)height);
+
+  if (x != NULL)
+    *x = (uint32_t)state.x;
+  if (y != NULL)
+    *y = (uint32_t)state.y;
+  if (width != NULL)
+    *width = state.width;
+  if (height != NULL)
+    *height = state.height;
+  return SYS_ERR_OK;
+}
+
+sys_error_t sys_window_get_state(sys_window_t* window, sys_window_state_t* state) {
+  assert(window != NULL && state != NULL);
+
+  const sys_window_state_t* shared = window->state;
+  if (shared == NULL)
+    return SYS_ERR_GENERIC;
+
+  // Retry while the kernel updates the state (see Window::publish_state()).
+  uint32_t sequence;
+  do {
+    sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+    state->x = __atomic_load_n(&shared->x, __ATOMIC_RELAXED);
+    state->y = __atomic_load_n(&shared->y, __ATOMIC_RELAXED);
+    state->width = __atomic_load_n(&shared->width, __ATOMIC_RELAXED);
+    state->height = __atomic_load_n(&shared->height, __ATOMIC_RELAXED);
+    state->visible = __atomic_load_n(&shared->visible, __ATOMIC_RELAXED);
+    state->focus = __atomic_load_n(&shared->focus, __ATOMIC_RELAXED);
+    state->surface_width = __atomic_load_n(&shared->surface_width, __ATOMIC_RELAXED);
+    state->surface_height = __atomic_load_n(&shared->surface_height, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((sequence & 1) != 0 || __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) != sequence);
+
+  state->sequence = sequence;
+  return SYS_ERR_OK;
 }
 
 sys_error_t sys_window_present(sys_window_t* window) {
@@ -141,6 +300,39 @@ sys_error_t sys_window_present(sys_window_t* window) {
   return __syscall1(SYS_WINDOW_PRESENT, window->kernel_handle);
 }
 
+sys_error_t sys_window_present_rect(sys_window_t* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  assert(window != NULL);
+
+  const uint64_t param1 = (uint64_t)x | ((uint64_t)y << 32);
+  const uint64_t param2 = (uint64_t)width | ((uint64_t)height << 32);
+  return __syscall3(SYS_WINDOW_PRESENT_RECT, window->kernel_handle, param1, param2);
+}
+
+sys_error_t sys_window_get_surface(sys_window_t* window, uint32_t** pixels, uint32_t* pitch) {
+  assert(window != NULL);
+  assert(pixels != NULL && pitch != NULL);
+
+  return __syscall3(SYS_WINDOW_GET_SURFACE, window->kernel_handle, (sys_word_t)pixels, (sys_word_t)pitch);
+}
+
+sys_error_t sys_window_set_surface_size(sys_window_t* window, uint32_t width, uint32_t height) {
+  assert(window != NULL);
+
+  return __syscall3(SYS_WINDOW_SET_SURFACE_SIZE, window->kernel_handle, width, height);
+}
+
+sys_error_t sys_window_set_buffer_count(sys_window_t* window, uint32_t count) {
+  assert(window != NULL);
+
+  return __syscall2(SYS_WINDOW_SET_BUFFER_COUNT, window->kernel_handle, count);
+}
+
+sys_error_t sys_window_swap_buffers(sys_window_t* window, uint32_t** pixels, uint32_t* age) {
+  assert(window != NULL && pixels != NULL);
+
+  return __syscall3(SYS_WINDOW_SWAP_BUFFERS, window->kernel_handle, (sys_word_t)pixels, (sys_word_t)age);
+}
+
 sys_error_t sys_gfx_clear(sys_window_t* window, uint32_t argb) {
   assert(window != NULL);
   return __syscall2(SYS_GFX_CLEAR, window->kernel_handle, argb);
@@ -187,6 +379,52 @@ sys_error_t sys_gfx_draw_text(sys_window_t* window, uint32_t x, uint32_t y, cons
   return __syscall4(SYS_GFX_DRAW_TEXT, window->kernel_handle, param1, (sys_word_t)text, argb);
 }
 
+/* Computes the part of the span [src, src + length) not covered by [dst, dst + length), if it is a single span. */
+static void get_exposed_span(uint32_t src, uint32_t dst, uint32_t length, uint32_t* start, uint32_t* exposed_length) {
+  if (dst > src) {
+    *start = src;
+    *exposed_length = (dst - src < length) ? dst - src : length;
+  } else {
+    *start = (src - dst < length) ? dst + length : src;
+    *exposed_length = src + length - *start;
+  }
+}
+
+sys_error_t sys_gfx_copy_area(sys_window_t* window,
+                              uint32_t src_x,
+                              uint32_t src_y,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t dst_x,
+                              uint32_t dst_y,
+                              sys_gfx_rect_t* exposed) {
+  assert(window != NULL);
+
+  if (exposed != NULL) {
+    const uint32_t dx = (dst_x > src_x) ? dst_x - src_x : src_x - dst_x;
+    const uint32_t dy = (dst_y > src_y) ? dst_y - src_y : src_y - dst_y;
+    *exposed = (sys_gfx_rect_t){src_x, src_y, width, height};
+    if (dx >= width || dy >= height) {
+      // The areas do not overlap, the whole source is exposed.
+    } else if (dx == 0) {
+      get_exposed_span(src_y, dst_y, height, &exposed->y, &exposed->height);
+    } else if (dy == 0) {
+      get_exposed_span(src_x, dst_x, width, &exposed->x, &exposed->width);
+    }
+    // Otherwise, the exposed pixels are L-shaped: the whole source is its bounding rectangle.
+  }
+
+  const uint64_t param1 = (uint64_t)src_x | ((uint64_t)src_y << 32);
+  const uint64_t param2 = (uint64_t)width | ((uint64_t)height << 32);
+  const uint64_t param3 = (uint64_t)dst_x | ((uint64_t)dst_y << 32);
+  return __syscall4(SYS_GFX_COPY_AREA, window->kernel_handle, param1, param2, param3);
+}
+
+sys_error_t sys_gfx_measure_text(sys_window_t* window, const char* text, uint32_t* width) {
+  assert(window != NULL && text != NULL && width != NULL);
+  return __syscall3(SYS_GFX_MEASURE_TEXT, window->kernel_handle, (sys_word_t)text, (sys_word_t)width);
+}
+
 sys_error_t sys_gfx_blit(sys_window_t* window,
                          uint32_t x,
                          uint32_t y,
@@ -199,3 +437,175 @@ sys_error_t sys_gfx_blit(sys_window_t* window,
   const uint64_t param2 = (uint64_t)width | ((uint64_t)height << 32);
   return __syscall4(SYS_GFX_BLIT, window->kernel_handle, param1, param2, (sys_word_t)argb_buffer);
 }
+
+void sys_gfx_buffer_init(sys_gfx_buffer_t* buffer) {
+  assert(buffer != NULL);
+  memset(buffer, 0, sizeof(sys_gfx_buffer_t));
+}
+
+void sys_gfx_buffer_destroy(sys_gfx_buffer_t* buffer) {
+  assert(buffer != NULL);
+  free(buffer->commands);
+  free(buffer->data);
+  sys_gfx_buffer_init(buffer);
+}
+
+void sys_gfx_buffer_reset(sys_gfx_buffer_t* buffer) {
+  assert(buffer != NULL);
+  buffer->command_count = 0;
+  buffer->data_size = 0;
+  buffer->failed = sys_false;
+}
+
+static sys_gfx_command_t* record_command(sys_gfx_buffer_t* buffer, uint32_t op, uint32_t argb) {
+  assert(buffer != NULL);
+  if (buffer->failed)
+    return NULL;
+
+  if (buffer->command_count == buffer->command_capacity) {
+    const size_t new_capacity = buffer->command_capacity == 0 ? 64 : buffer->command_capacity * 2;
+    sys_gfx_command_t* commands =
+        (sys_gfx_command_t*)realloc(buffer->commands, sizeof(sys_gfx_command_t) * new_capacity);
+    if (commands == NULL) {
+      buffer->failed = sys_true;
+      return NULL;
+    }
+
+    buffer->commands = commands;
+    buffer->command_capacity = new_capacity;
+  }
+
+  sys_gfx_command_t* command = &buffer->commands[buffer->command_count++];
+  memset(command, 0, sizeof(sys_gfx_command_t));
+  command->op = op;
+  command->argb = argb;
+  return command;
+}
+
+/* Copies @size bytes into the data area of @buffer and returns their offset, or SIZE_MAX on failure. */
+static size_t record_data(sys_gfx_buffer_t* buffer, const void* data, size_t size) {
+  // Keep the entries 8-bytes aligned, the kernel reads the pixels by words.
+  const size_t offset = (buffer->data_size + 7) & ~(size_t)7;
+  if (size > SIZE_MAX - offset)
+    goto error;
+
+  if (offset + size > buffer->data_capacity) {
+    size_t new_capacity = buffer->data_capacity == 0 ? 4096 : buffer->data_capacity;
+    while (new_capacity < offset + size)
+      new_capacity *= 2;
+
+    uint8_t* new_data = (uint8_t*)realloc(buffer->data, new_capacity);
+    if (new_data == NULL)
+      goto error;
+
+    buffer->data = new_data;
+    buffer->data_capacity = new_capacity;
+  }
+
+  memcpy(buffer->data + offset, data, size);
+  buffer->data_size = offset + size;
+  return offset;
+
+error:
+  buffer->failed = sys_true;
+  return SIZE_MAX;
+}
+
+static void record_rect(sys_gfx_buffer_t* buffer,
+                        uint32_t op,
+                        uint32_t x,
+                        uint32_t y,
+                        uint32_t width,
+                        uint32_t height,
+                        uint32_t argb) {
+  sys_gfx_command_t* command = record_command(buffer, op, argb);
+  if (command == NULL)
+    return;
+
+  command->x = x;
+  command->y = y;
+  command->width = width;
+  command->height = height;
+}
+
+void sys_gfx_record_clear(sys_gfx_buffer_t* buffer, uint32_t argb) {
+  record_command(buffer, SYS_GFX_OP_CLEAR, argb);
+}
+
+void sys_gfx_record_draw_line(sys_gfx_buffer_t* buffer,
+                              uint32_t x0,
+                              uint32_t y0,
+                              uint32_t x1,
+                              uint32_t y1,
+                              uint32_t argb) {
+  record_rect(buffer, SYS_GFX_OP_DRAW_LINE, x0, y0, x1, y1, argb);
+}
+
+void sys_gfx_record_draw_rect(sys_gfx_buffer_t* buffer,
+                              uint32_t x,
+                              uint32_t y,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t argb) {
+  record_rect(buffer, SYS_GFX_OP_DRAW_RECT, x, y, width, height, argb);
+}
+
+void sys_gfx_record_fill_rect(sys_gfx_buffer_t* buffer,
+                              uint32_t x,
+                              uint32_t y,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t argb) {
+  record_rect(buffer, SYS_GFX_OP_FILL_RECT, x, y, width, height, argb);
+}
+
+void sys_gfx_record_draw_text(sys_gfx_buffer_t* buffer, uint32_t x, uint32_t y, const char* text, uint32_t argb) {
+  assert(text != NULL);
+
+  sys_gfx_command_t* command = record_command(buffer, SYS_GFX_OP_DRAW_TEXT, argb);
+  if (command == NULL)
+    return;
+
+  command->x = x;
+  command->y = y;
+  command->data_offset = record_data(buffer, text, strlen(text) + 1 /* include NUL terminator */);
+}
+
+void sys_gfx_record_blit(sys_gfx_buffer_t* buffer,
+                         uint32_t x,
+                         uint32_t y,
+                         uint32_t width,
+                         uint32_t height,
+                         const uint32_t* argb_buffer) {
+  assert(argb_buffer != NULL);
+
+  sys_gfx_command_t* command = record_command(buffer, SYS_GFX_OP_BLIT, 0);
+  if (command == NULL)
+    return;
+
+  command->x = x;
+  command->y = y;
+  command->width = width;
+  command->height = height;
+  command->data_offset = record_data(buffer, argb_buffer, sizeof(uint32_t) * (size_t)width * height);
+}
+
+void sys_gfx_record_set_clip(sys_gfx_buffer_t* buffer, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  record_rect(buffer, SYS_GFX_OP_SET_CLIP, x, y, width, height, 0);
+}
+
+void sys_gfx_record_reset_clip(sys_gfx_buffer_t* buffer) {
+  record_command(buffer, SYS_GFX_OP_RESET_CLIP, 0);
+}
+
+sys_error_t sys_gfx_submit(sys_window_t* window, const sys_gfx_buffer_t* buffer) {
+  assert(window != NULL && buffer != NULL);
+
+  if (buffer->failed)
+    return SYS_ERR_OUT_OF_MEM;
+  if (buffer->command_count == 0)
+    return SYS_ERR_OK;
+
+  return __syscall5(SYS_GFX_SUBMIT, window->kernel_handle, (sys_word_t)buffer->commands, buffer->command_count,
+                    (sys_word_t)buffer->data, buffer->data_size);
+}
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+
+# Decodes the boot profile record (see kernel/boot_profile.hpp) from a capture of the log UART, and prints
+# the boot timeline. Several captures (several boots) can be given to compare them:
+# ./boot-profile.py `uart capture file`...
+
+import re
+import struct
+import sys
+
+RECORD_PREFIX = re.compile(rb'BOOTPROF ([0-9a-f]+)')
+RECORD_MAGIC = 0x544f4f42
+# magic, stage count, frequency
+HEADER_FORMAT = '<IIQ'
+
+# Keep in sync with BootProfile::Stage in kernel/boot_profile.hpp.
+STAGES = ['start', 'mmu init', 'startup', 'kernel device tree', 'kernel memory', 'mailbox', 'device', 'irq manager',
+          'gpio', 'log uart', 'system timer', 'dma', 'smp', 'task manager', 'file system', 'framebuffer',
+          'boot snapshot', 'window manager', 'wallpaper', 'init program', 'boot done']
+
+def read_record(data: bytes):
+    match = RECORD_PREFIX.search(data)
+    if match is None:
+        return None
+
+    record = bytes.fromhex(match.group(1).decode())
+    magic, stage_count, frequency = struct.unpack_from(HEADER_FORMAT, record)
+    if magic != RECORD_MAGIC:
+        return None
+
+    timestamps = struct.unpack_from(f'<{stage_count}Q', record, struct.calcsize(HEADER_FORMAT))
+    return frequency, timestamps
+
+def print_timeline(frequency: int, timestamps):
+    origin = timestamps[0]
+    previous = origin
+    reached = sorted((timestamp, stage) for stage, timestamp in enumerate(timestamps) if timestamp != 0)
+    for timestamp, stage in reached:
+        name = STAGES[stage] if stage < len(STAGES) else f'stage {stage}'
+        print(f'{(timestamp - origin) * 1e6 / frequency:12.0f} us  (+{(timestamp - previous) * 1e6 / frequency:9.0f} us)  {name}')
+        previous = timestamp
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(f'usage: {sys.argv[0]} `uart capture file`...')
+        sys.exit(1)
+
+    for path in sys.argv[1:]:
+        with open(path, 'rb') as file:
+            record = read_record(file.read())
+
+        print(f'{path}:')
+        if record is None:
+            print('  no boot profile record found')
+        else:
+            print_timeline(*record)
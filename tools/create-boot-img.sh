@@ -1,12 +1,14 @@
 #!/usr/bin/env sh
 
 # This script create a boot image for this kernel.
+# An optional third argument is the kernel command line (written into cmdline.txt).
 
 SCRIPT_DIR="$( cd -- "$( dirname -- "$0" )" > /dev/null && pwd )"
 
 PROJECT_PATH="$SCRIPT_DIR/.."
 BUILD_DIR="$1"
 TARGET_FILE="$2"
+CMDLINE="$3"
 
 if [ "$BUILD_DIR" = "" ]; then
     echo "Unknown build dir"
@@ -22,6 +24,8 @@ RASPI_FIRMWARE="$BUILD_DIR/firmware"
 
 CONFIG_FILE="$PROJECT_PATH/kernel/boot/config.txt"
 KERNEL_FILE="$BUILD_DIR/kernel/kernel8.img"
+# The kernel reads its symbols from its ELF at boot, to print symbolized stack traces.
+KERNEL_ELF_FILE="$BUILD_DIR/kernel/kernel8.elf"
 RAM_FS_FILE="$BUILD_DIR/binuser/fs.img"
 
 #rm -rf "$RASPI_FIRMWARE"
@@ -36,6 +40,11 @@ dd if=/dev/zero bs=1M count=100 of="$TARGET_FILE"
 mformat -i "$TARGET_FILE" -F
 mcopy -s -i "$TARGET_FILE" "$RASPI_FIRMWARE/boot/"* ::
 mcopy -i "$TARGET_FILE" "$KERNEL_FILE" ::
+mcopy -i "$TARGET_FILE" "$KERNEL_ELF_FILE" ::
 mcopy -i "$TARGET_FILE" "$CONFIG_FILE" ::
 mcopy -i "$TARGET_FILE" "$RAM_FS_FILE" ::
+if [ "$CMDLINE" != "" ]; then
+    echo "$CMDLINE" > "$BUILD_DIR/cmdline.txt"
+    mcopy -i "$TARGET_FILE" "$BUILD_DIR/cmdline.txt" ::
+fi
 mdir -i "$TARGET_FILE"
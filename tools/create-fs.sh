@@ -2,6 +2,7 @@
 
 # To create the ramfs image used by Pi-kachULM_OS, please call this script with the name of the file to produce:
 # ./create-fs.sh `target ramfs file path`
+# With RAM_FS_COMPRESS=1, the image is LZ4 compressed by blocks (this needs mkfatimg), the kernel decompresses it.
 
 TARGET_RAM_FS_NAME="$1"
 TARGET_RAM_FS_SIZE=10 #Mio
@@ -14,6 +15,30 @@ fi
 SCRIPT_DIR="$( cd -- "$( dirname -- "$0" )" > /dev/null && pwd )"
 RAM_FS_DIR="$SCRIPT_DIR/../fs"
 
+# Prefer mkfatimg (see tools/mkfatimg), which lays out the files page-aligned and contiguously.
+MKFATIMG_EXEC="$MKFATIMG"
+if [ "$MKFATIMG_EXEC" = "" ]; then
+    MKFATIMG_EXEC=$(command -v mkfatimg)
+fi
+if [ "$MKFATIMG_EXEC" = "" ] && [ -x "$SCRIPT_DIR/mkfatimg/build/mkfatimg" ]; then
+    MKFATIMG_EXEC="$SCRIPT_DIR/mkfatimg/build/mkfatimg"
+fi
+
+MKFATIMG_FLAGS=""
+if [ "$RAM_FS_COMPRESS" = "1" ]; then
+    MKFATIMG_FLAGS="-z"
+fi
+
+if [ "$MKFATIMG_EXEC" != "" ]; then
+    exec "$MKFATIMG_EXEC" "$RAM_FS_DIR" -o "$TARGET_RAM_FS_NAME" -i "$TARGET_RAM_FS_NAME.idx" \
+        -m $((TARGET_RAM_FS_SIZE * 1024)) $MKFATIMG_FLAGS
+fi
+
+if [ "$MKFATIMG_FLAGS" != "" ]; then
+     echo "'mkfatimg' not found, it is needed to compress the image. Please build 'tools/mkfatimg'."
+     exit 2
+fi
+
 DD_EXEC=$(command -v dd)
 if [ "$DD_EXEC" = "" ]; then
      echo "'dd' not found. Please install 'coreutils'. (Wtf ?)"
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+
+# Extracts the kernel arc counters (see kernel/coverage.hpp, built with KERNEL_PGO=GENERATE) from a capture of the
+# log UART, and writes them back as the .gcda files read by the KERNEL_PGO=USE build (or gcov):
+# ./gcda-extract.py [--dump `index`] [--output-dir `directory`] `uart capture file`
+#
+# The last complete dump is written by default. The .gcda files are written at the paths compiled in the kernel
+# (in KERNEL_PGO_DIR), or in --output-dir with their file names.
+
+import argparse
+import os
+import struct
+import sys
+from enum import IntEnum
+
+RECORD_MAGIC = b'GCD'
+# dump, file, kind, payload size, offset, reserved, then the payload
+RECORD_HEADER_FORMAT = '<IHBBII'
+RECORD_HEADER_SIZE = struct.calcsize(RECORD_HEADER_FORMAT)
+PAYLOAD_SIZE = 240
+RECORD_SIZE = RECORD_HEADER_SIZE + PAYLOAD_SIZE
+
+# Keep in sync with Coverage::RecordKind in kernel/coverage.hpp.
+class Kind(IntEnum):
+    FILE = 0
+    DATA = 1
+    END = 2
+
+def read_records(data: bytes):
+    offset = data.find(RECORD_MAGIC)
+    while offset >= 0 and offset + len(RECORD_MAGIC) + RECORD_SIZE <= len(data):
+        start = offset + len(RECORD_MAGIC)
+        dump, file, kind, size, file_offset, reserved = struct.unpack_from(RECORD_HEADER_FORMAT, data, start)
+        # The log lines may be interleaved with the records, skip what does not look like a record.
+        if kind in Kind._value2member_map_ and size <= PAYLOAD_SIZE and reserved == 0:
+            payload = data[start + RECORD_HEADER_SIZE:start + RECORD_HEADER_SIZE + size]
+            yield dump, file, Kind(kind), file_offset, payload
+            offset = data.find(RECORD_MAGIC, start + RECORD_SIZE)
+        else:
+            offset = data.find(RECORD_MAGIC, offset + 1)
+
+class Dump:
+    def __init__(self):
+        self.files = {}  # file index -> bytearray of the stream
+        self.file_count = None  # set by the END record
+
+    def add(self, file: int, kind: Kind, offset: int, payload: bytes):
+        if kind == Kind.FILE:
+            self.files[file] = bytearray(offset)
+        elif kind == Kind.DATA and file in self.files:
+            self.files[file][offset:offset + len(payload)] = payload
+        elif kind == Kind.END:
+            self.file_count = file
+
+    def is_complete(self):
+        return self.file_count is not None and len(self.files) == self.file_count
+
+def main():
+    parser = argparse.ArgumentParser(description='Writes the .gcda files of the kernel arc counters dumps.')
+    parser.add_argument('--dump', type=int, help='the index of the dump to write (the last complete one by default)')
+    parser.add_argument('--output-dir', help='write the .gcda files in this directory instead of their paths')
+    parser.add_argument('capture', help='the capture of the log UART')
+    args = parser.parse_args()
+
+    dumps = {}
+    with open(args.capture, 'rb') as capture:
+        for dump, file, kind, offset, payload in read_records(capture.read()):
+            dumps.setdefault(dump, Dump()).add(file, kind, offset, payload)
+
+    complete = sorted(index for index, dump in dumps.items() if dump.is_complete())
+    index = args.dump if args.dump is not None else (complete[-1] if complete else None)
+    if index not in complete:
+        sys.exit('No complete dump found' if index is None else f'Dump {index} not found or incomplete')
+
+    for stream in dumps[index].files.values():
+        path, _, gcda = bytes(stream).partition(b'\0')
+        path = path.decode(errors='replace')
+        if args.output_dir:
+            path = os.path.join(args.output_dir, os.path.basename(path))
+        os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+        with open(path, 'wb') as output:
+            output.write(gcda)
+
+    print(f'Dump {index}: {len(dumps[index].files)} .gcda files written')
+
+if __name__ == '__main__':
+    main()
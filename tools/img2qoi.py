@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+
+# Converts images (e.g. fs/wallpaper.jpg and the slides) into the QOI format (https://qoiformat.org), decoded by the
+# kernel (kernel/graphics/qoi.hpp) and by the user programs (binuser/qoi.h) at memory speed, unlike the JPEGs:
+# ./img2qoi.py `input image` `output .qoi` [`input image` `output .qoi` ...]
+#
+# The images are stored in RGB (the alpha channel is not used). The fs-img target runs it on the fs images when
+# configured with -DFS_IMAGE_QOI=ON, see binuser/CMakeLists.txt.
+
+import struct
+import sys
+
+QOI_OP_INDEX = 0x00
+QOI_OP_DIFF = 0x40
+QOI_OP_LUMA = 0x80
+QOI_OP_RUN = 0xc0
+QOI_OP_RGB = 0xfe
+QOI_END_MARKER = bytes([0, 0, 0, 0, 0, 0, 0, 1])
+
+def encode_qoi(width: int, height: int, rgb: bytes) -> bytes:
+    """Encodes the width x height pixels of rgb (3 bytes per pixel, row-major) as a QOI image."""
+    output = bytearray(b'qoif' + struct.pack('>IIBB', width, height, 3, 0))
+    index = [None] * 64
+    previous = (0, 0, 0)
+    run = 0
+
+    for offset in range(0, width * height * 3, 3):
+        pixel = (rgb[offset], rgb[offset + 1], rgb[offset + 2])
+        if pixel == previous:
+            run += 1
+            if run == 62:
+                output.append(QOI_OP_RUN | (run - 1))
+                run = 0
+            continue
+
+        if run > 0:
+            output.append(QOI_OP_RUN | (run - 1))
+            run = 0
+
+        r, g, b = pixel
+        hash_index = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64
+        if index[hash_index] == pixel:
+            output.append(QOI_OP_INDEX | hash_index)
+        else:
+            index[hash_index] = pixel
+            # The differences wrap around, as the decoder computes them modulo 256.
+            dr = (r - previous[0] + 128) % 256 - 128
+            dg = (g - previous[1] + 128) % 256 - 128
+            db = (b - previous[2] + 128) % 256 - 128
+            dr_dg, db_dg = dr - dg, db - dg
+            if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+                output.append(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2))
+            elif -32 <= dg <= 31 and -8 <= dr_dg <= 7 and -8 <= db_dg <= 7:
+                output.append(QOI_OP_LUMA | (dg + 32))
+                output.append(((dr_dg + 8) << 4) | (db_dg + 8))
+            else:
+                output.extend((QOI_OP_RGB, r, g, b))
+
+        previous = pixel
+
+    if run > 0:
+        output.append(QOI_OP_RUN | (run - 1))
+
+    output.extend(QOI_END_MARKER)
+    return bytes(output)
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3 or len(sys.argv) % 2 != 1:
+        print('usage: img2qoi.py <input image> <output .qoi> [<input image> <output .qoi> ...]')
+        exit(1)
+
+    from PIL import Image
+
+    for input_path, output_path in zip(sys.argv[1::2], sys.argv[2::2]):
+        image = Image.open(input_path).convert('RGB')
+        with open(output_path, 'wb') as output:
+            output.write(encode_qoi(image.width, image.height, image.tobytes()))
@@ -0,0 +1,29 @@
+#!/usr/bin/env python3
+
+# Converts an image (e.g. fs/wallpaper.jpg) into the raw wallpaper cache read by the window manager at boot
+# (/wallpaper.pkimg), already scaled to the screen size and in the screen pixel format:
+# ./jpg2pkimg.py `input image` `output .pkimg` `screen width` `screen height`
+#
+# The kernel ignores the cache if the screen size does not match and decodes the JPEG instead.
+
+import struct
+import sys
+
+from PIL import Image
+
+PKIMG_MAGIC = 0x4d494b50  # "PKIM"
+
+if len(sys.argv) != 5:
+    print("usage: jpg2pkimg.py <input image> <output .pkimg> <screen width> <screen height>")
+    exit(1)
+
+input_path, output_path = sys.argv[1], sys.argv[2]
+width, height = int(sys.argv[3]), int(sys.argv[4])
+
+# Same scaling as the kernel (nearest neighbor).
+image = Image.open(input_path).convert("RGB").resize((width, height), Image.NEAREST)
+
+with open(output_path, "wb") as output:
+    output.write(struct.pack("<IIII", PKIMG_MAGIC, width, height, 0))
+    # The screen pixels are 0x00RRGGBB little-endian words.
+    output.write(image.tobytes("raw", "BGRX"))
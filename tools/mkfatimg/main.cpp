@@ -0,0 +1,704 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define ERROR "\x1b[1;31merror:\x1b[0m "
+
+namespace fs = std::filesystem;
+
+constexpr uint32_t SECTOR_SIZE = 512;
+// The size of a page in the kernel, the clusters (and so all the files) are aligned on it.
+constexpr uint32_t CLUSTER_SIZE = 4096;
+constexpr uint32_t SECTORS_PER_CLUSTER = CLUSTER_SIZE / SECTOR_SIZE;
+constexpr uint32_t DIR_ENTRY_SIZE = 32;
+// 4 clusters, the root directory of FAT12/16 volumes has a fixed size.
+constexpr uint32_t ROOT_ENTRY_COUNT = 512;
+constexpr uint32_t FAT_COUNT = 2;
+// The FAT type is determined by the cluster count only (see the FatFs find_volume()).
+constexpr uint32_t MAX_FAT12_CLUSTERS = 0xFF5;
+constexpr uint32_t MAX_FAT16_CLUSTERS = 0xFFF5;
+// RAM_FS_BYTE_SIZE in the kernel (see kernel/fs/fat/ramdisk.hpp).
+constexpr uint64_t DEFAULT_MAX_IMAGE_SIZE = 0xa00000;
+// The compressed images (see RamdiskCompressedHeader in kernel/fs/fat/ramdisk.hpp): the decompressed size of the
+// blocks, and the magic starting the header.
+constexpr uint32_t COMPRESSED_BLOCK_SIZE = 32 * 1024;
+constexpr char COMPRESSED_MAGIC[8] = {'P', 'K', 'L', 'Z', '4', 'F', 'S', '\0'};
+
+constexpr uint8_t ATTR_DIRECTORY = 0x10;
+constexpr uint8_t ATTR_ARCHIVE = 0x20;
+constexpr uint8_t ATTR_LONG_NAME = 0x0F;
+constexpr uint32_t LFN_CHARS_PER_ENTRY = 13;
+
+struct Node {
+  std::string name;
+  std::string path;  // inside the image, e.g. "/bin/init"
+  fs::path source;
+  bool is_dir = false;
+  Node* parent = nullptr;
+  std::vector<Node*> children;
+  std::vector<uint8_t> data;  // the file content, or the directory entries
+  uint16_t date = 0;
+  uint16_t time = 0;
+  uint8_t short_name[11] = {};
+  uint32_t first_cluster = 0;
+  uint32_t cluster_count = 0;
+};  // struct Node
+
+struct Options {
+  fs::path input_dir;
+  fs::path output_path;
+  fs::path index_path;
+  std::vector<std::string> hot_files = {"/bin/init", "/wallpaper.jpg"};
+  bool hot_files_given = false;
+  uint64_t free_size = 0;
+  uint64_t max_size = DEFAULT_MAX_IMAGE_SIZE;
+  bool compress = false;
+};  // struct Options
+
+static std::vector<std::unique_ptr<Node>> g_nodes;
+
+static void print_usage() {
+  std::cerr << "usage: mkfatimg <input dir> -o <output image> [-i <index file>] [-p <hot file>]... [-f <free KiB>] "
+               "[-m <max KiB>] [-z]\n";
+}
+
+static bool parse_options(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "-o" && has_value) {
+      options.output_path = argv[++i];
+    } else if (arg == "-i" && has_value) {
+      options.index_path = argv[++i];
+    } else if (arg == "-p" && has_value) {
+      if (!options.hot_files_given)
+        options.hot_files.clear();
+      options.hot_files_given = true;
+      std::string path = argv[++i];
+      options.hot_files.push_back(path.front() == '/' ? path : "/" + path);
+    } else if (arg == "-f" && has_value) {
+      options.free_size = std::stoull(argv[++i]) * 1024;
+    } else if (arg == "-m" && has_value) {
+      options.max_size = std::stoull(argv[++i]) * 1024;
+    } else if (arg == "-z") {
+      options.compress = true;
+    } else if (arg[0] != '-' && options.input_dir.empty()) {
+      options.input_dir = arg;
+    } else {
+      return false;
+    }
+  }
+
+  return !options.input_dir.empty() && !options.output_path.empty();
+}
+
+/** Compresses the @a size bytes at @a src as a LZ4 block, using a greedy hash table (as the kernel libk does). */
+static std::vector<uint8_t> lz4_compress(const uint8_t* src, size_t size) {
+  constexpr size_t MIN_MATCH = 4;
+  constexpr size_t LAST_LITERALS = 5;  // the block ends with literals
+  constexpr size_t MF_LIMIT = 12;      // and its last match starts at least this many bytes before its end
+  constexpr size_t MAX_OFFSET = 65535;
+  constexpr unsigned HASH_BITS = 14;
+
+  std::vector<uint8_t> dst;
+  dst.reserve(size + size / 255 + 16);
+  std::vector<int64_t> table((size_t)1 << HASH_BITS, -1);
+
+  auto read32 = [&](size_t i) {
+    uint32_t value;
+    std::memcpy(&value, src + i, sizeof(value));
+    return value;
+  };
+  auto append_length = [&](size_t length) {
+    for (; length >= 255; length -= 255)
+      dst.push_back(255);
+    dst.push_back((uint8_t)length);
+  };
+  auto append_literals = [&](size_t start, size_t end, size_t match_length) {
+    const size_t length = end - start;
+    dst.push_back((uint8_t)((std::min<size_t>(length, 15) << 4) | std::min<size_t>(match_length, 15)));
+    if (length >= 15)
+      append_length(length - 15);
+    dst.insert(dst.end(), src + start, src + end);
+  };
+
+  size_t anchor = 0;
+  for (size_t i = 0; i + MF_LIMIT <= size;) {
+    const uint32_t hash = (read32(i) * 2654435761u) >> (32 - HASH_BITS);
+    const int64_t candidate = table[hash];
+    table[hash] = (int64_t)i;
+    if (candidate < 0 || i - candidate > MAX_OFFSET || read32(candidate) != read32(i)) {
+      ++i;
+      continue;
+    }
+
+    size_t length = MIN_MATCH;
+    while (i + length < size - LAST_LITERALS && src[candidate + length] == src[i + length])
+      ++length;
+
+    append_literals(anchor, i, length - MIN_MATCH);
+    const size_t offset = i - candidate;
+    dst.push_back((uint8_t)offset);
+    dst.push_back((uint8_t)(offset >> 8));
+    if (length - MIN_MATCH >= 15)
+      append_length(length - MIN_MATCH - 15);
+
+    i += length;
+    anchor = i;
+  }
+
+  append_literals(anchor, size, 0);
+  return dst;
+}
+
+/**
+ * Compresses the @a image by blocks of COMPRESSED_BLOCK_SIZE bytes, on all the host cores: the header, the offsets
+ * of the blocks (and of the end), then the blocks. A block that does not shrink is stored as is.
+ */
+static std::vector<uint8_t> compress_image(const std::vector<uint8_t>& image) {
+  const size_t block_count = (image.size() + COMPRESSED_BLOCK_SIZE - 1) / COMPRESSED_BLOCK_SIZE;
+  std::vector<std::vector<uint8_t>> blocks(block_count);
+
+  std::atomic<size_t> next_block = 0;
+  auto worker = [&]() {
+    for (size_t i = next_block++; i < block_count; i = next_block++) {
+      const uint8_t* src = image.data() + i * COMPRESSED_BLOCK_SIZE;
+      const size_t size = std::min<size_t>(COMPRESSED_BLOCK_SIZE, image.size() - i * COMPRESSED_BLOCK_SIZE);
+      blocks[i] = lz4_compress(src, size);
+      if (blocks[i].size() >= size)
+        blocks[i].assign(src, src + size);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, block_count);
+  for (size_t i = 0; i < thread_count; ++i)
+    threads.emplace_back(worker);
+  for (auto& thread : threads)
+    thread.join();
+
+  // Little-endian, as the kernel reads it in place.
+  std::vector<uint8_t> output(24 + 4 * (block_count + 1));
+  auto write32 = [&](size_t offset, uint32_t value) {
+    for (size_t i = 0; i < 4; ++i)
+      output[offset + i] = (uint8_t)(value >> (8 * i));
+  };
+
+  std::memcpy(output.data(), COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+  write32(8, COMPRESSED_BLOCK_SIZE);
+  write32(12, (uint32_t)block_count);
+  write32(16, (uint32_t)image.size());
+  write32(20, (uint32_t)(image.size() >> 32));
+
+  for (size_t i = 0; i < block_count; ++i) {
+    write32(24 + 4 * i, (uint32_t)output.size());
+    output.insert(output.end(), blocks[i].begin(), blocks[i].end());
+  }
+  write32(24 + 4 * block_count, (uint32_t)output.size());
+  return output;
+}
+
+static void set_timestamp(Node& node) {
+  std::error_code error;
+  const auto file_time = fs::last_write_time(node.source, error);
+  std::time_t time = 0;
+  if (!error) {
+    const auto system_time = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+        file_time - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
+    time = std::chrono::system_clock::to_time_t(system_time);
+  }
+
+  // FAT timestamps start in 1980.
+  const std::tm* tm = std::localtime(&time);
+  if (tm == nullptr || tm->tm_year < 80) {
+    node.date = (0 << 9) | (1 << 5) | 1;
+    node.time = 0;
+    return;
+  }
+
+  node.date = ((tm->tm_year - 80) << 9) | ((tm->tm_mon + 1) << 5) | tm->tm_mday;
+  node.time = (tm->tm_hour << 11) | (tm->tm_min << 5) | (tm->tm_sec / 2);
+}
+
+static Node* scan(const fs::path& source, Node* parent, const std::string& name) {
+  auto& node = *g_nodes.emplace_back(std::make_unique<Node>());
+  node.name = name;
+  node.path = parent == nullptr ? "/" : (parent->parent == nullptr ? "/" : parent->path + "/") + name;
+  node.source = source;
+  node.parent = parent;
+  node.is_dir = fs::is_directory(source);
+  set_timestamp(node);
+
+  if (node.is_dir) {
+    // Sorted, so the image does not depend on the host directory order.
+    std::vector<fs::path> entries;
+    for (const auto& entry : fs::directory_iterator(source))
+      entries.push_back(entry.path());
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto& entry : entries)
+      node.children.push_back(scan(entry, &node, entry.filename().string()));
+  }
+
+  return &node;
+}
+
+/** Reads all the files, on all the host cores. */
+static bool read_files(const std::vector<Node*>& files) {
+  std::atomic<size_t> next_file = 0;
+  std::atomic<bool> success = true;
+  auto worker = [&]() {
+    for (size_t i = next_file++; i < files.size(); i = next_file++) {
+      Node& file = *files[i];
+      std::ifstream input(file.source, std::ios::binary);
+      file.data.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+      if (!input.good() && !input.eof()) {
+        std::cerr << ERROR "failed to read '" << file.source.string() << "'\n";
+        success = false;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, files.size());
+  for (size_t i = 0; i < thread_count; ++i)
+    threads.emplace_back(worker);
+  for (auto& thread : threads)
+    thread.join();
+
+  return success;
+}
+
+/** Decodes an UTF-8 name into UCS-2 (the characters outside the BMP are replaced by '_'). */
+static std::u16string to_ucs2(const std::string& name) {
+  std::u16string result;
+  for (size_t i = 0; i < name.size();) {
+    const auto byte = (uint8_t)name[i];
+    uint32_t code_point;
+    size_t length;
+    if (byte < 0x80) {
+      code_point = byte;
+      length = 1;
+    } else if ((byte & 0xE0) == 0xC0) {
+      code_point = byte & 0x1F;
+      length = 2;
+    } else if ((byte & 0xF0) == 0xE0) {
+      code_point = byte & 0x0F;
+      length = 3;
+    } else {
+      code_point = '_';
+      length = (byte & 0xF8) == 0xF0 ? 4 : 1;
+    }
+
+    for (size_t j = 1; j < length && i + j < name.size(); ++j)
+      code_point = (code_point << 6) | ((uint8_t)name[i + j] & 0x3F);
+
+    result.push_back(length == 4 ? u'_' : (char16_t)code_point);
+    i += length;
+  }
+
+  return result;
+}
+
+static bool is_short_name_char(char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || std::strchr("$%'-_@~`!(){}^#&", c) != nullptr;
+}
+
+/** Generates the 8.3 name of @a node, unique among @a used_names. Returns true if a long name is needed. */
+static bool make_short_name(Node& node, std::set<std::string>& used_names) {
+  const size_t dot = node.name.rfind('.');
+  const std::string base = dot == std::string::npos || dot == 0 ? node.name : node.name.substr(0, dot);
+  const std::string ext = dot == std::string::npos || dot == 0 ? "" : node.name.substr(dot + 1);
+
+  bool is_lossy = false;
+  auto convert = [&is_lossy](const std::string& part, size_t max_length) {
+    std::string result;
+    for (char c : part) {
+      c = (char)std::toupper((unsigned char)c);
+      if (c == ' ' || c == '.') {
+        is_lossy = true;
+        continue;
+      }
+
+      if (!is_short_name_char(c)) {
+        is_lossy = true;
+        c = '_';
+      }
+
+      result.push_back(c);
+    }
+
+    if (result.size() > max_length) {
+      result.resize(max_length);
+      is_lossy = true;
+    }
+
+    return result;
+  };
+
+  std::string short_base = convert(base, 8);
+  const std::string short_ext = convert(ext, 3);
+  if (short_base.empty()) {
+    short_base = "_";
+    is_lossy = true;
+  }
+
+  auto make_key = [](const std::string& base, const std::string& ext) {
+    std::string key = base;
+    key.resize(8, ' ');
+    std::string padded_ext = ext;
+    padded_ext.resize(3, ' ');
+    return key + padded_ext;
+  };
+
+  std::string key = make_key(short_base, short_ext);
+  // Add a numeric tail ("~1") if the name was changed (or collides), as the other FAT implementations.
+  for (int tail = 1; is_lossy || used_names.count(key) != 0; ++tail) {
+    const std::string suffix = "~" + std::to_string(tail);
+    key = make_key(short_base.substr(0, 8 - suffix.size()) + suffix, short_ext);
+    if (used_names.count(key) == 0)
+      break;
+  }
+
+  used_names.insert(key);
+  std::memcpy(node.short_name, key.data(), sizeof(node.short_name));
+
+  // The long name is only omitted for names that are exactly their 8.3 name.
+  const std::string exact_name = ext.empty() ? short_base : short_base + "." + short_ext;
+  return is_lossy || node.name != exact_name;
+}
+
+static uint8_t short_name_checksum(const uint8_t* short_name) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i < 11; ++i)
+    sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + short_name[i]);
+  return sum;
+}
+
+static void put16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+  put16(p, value & 0xFFFF);
+  put16(p + 2, value >> 16);
+}
+
+static void append_short_entry(std::vector<uint8_t>& entries,
+                               const uint8_t* name,
+                               uint8_t attributes,
+                               const Node& node,
+                               uint32_t first_cluster,
+                               uint32_t size) {
+  uint8_t entry[DIR_ENTRY_SIZE] = {};
+  std::memcpy(entry, name, 11);
+  entry[11] = attributes;
+  put16(entry + 14, node.time);  // creation
+  put16(entry + 16, node.date);
+  put16(entry + 18, node.date);  // last access
+  put16(entry + 20, first_cluster >> 16);
+  put16(entry + 22, node.time);  // last write
+  put16(entry + 24, node.date);
+  put16(entry + 26, first_cluster & 0xFFFF);
+  put32(entry + 28, size);
+  entries.insert(entries.end(), entry, entry + DIR_ENTRY_SIZE);
+}
+
+static void append_long_entries(std::vector<uint8_t>& entries, const Node& node) {
+  std::u16string name = to_ucs2(node.name);
+  const size_t entry_count = (name.size() + LFN_CHARS_PER_ENTRY - 1) / LFN_CHARS_PER_ENTRY;
+  // NUL terminated (unless it fills the last entry), then padded by 0xFFFF.
+  if (name.size() % LFN_CHARS_PER_ENTRY != 0)
+    name.push_back(0);
+  name.resize(entry_count * LFN_CHARS_PER_ENTRY, 0xFFFF);
+
+  static constexpr size_t CHAR_OFFSETS[LFN_CHARS_PER_ENTRY] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+  const uint8_t checksum = short_name_checksum(node.short_name);
+  // The last part of the name first.
+  for (size_t i = entry_count; i > 0; --i) {
+    uint8_t entry[DIR_ENTRY_SIZE] = {};
+    entry[0] = (uint8_t)(i | (i == entry_count ? 0x40 : 0));
+    entry[11] = ATTR_LONG_NAME;
+    entry[13] = checksum;
+    for (size_t j = 0; j < LFN_CHARS_PER_ENTRY; ++j)
+      put16(entry + CHAR_OFFSETS[j], name[(i - 1) * LFN_CHARS_PER_ENTRY + j]);
+    entries.insert(entries.end(), entry, entry + DIR_ENTRY_SIZE);
+  }
+}
+
+/** Returns the count of directory entries of @a dir (the long names included). */
+static size_t prepare_short_names(Node& dir, std::map<Node*, bool>& needs_long_name) {
+  std::set<std::string> used_names = {".          ", "..         "};
+  size_t entry_count = dir.parent == nullptr ? 0 : 2;
+  for (Node* child : dir.children) {
+    const bool has_long_name = make_short_name(*child, used_names);
+    needs_long_name[child] = has_long_name;
+    entry_count += 1;
+    if (has_long_name)
+      entry_count += (to_ucs2(child->name).size() + LFN_CHARS_PER_ENTRY - 1) / LFN_CHARS_PER_ENTRY;
+  }
+
+  return entry_count;
+}
+
+static void build_dir_entries(Node& dir, const std::map<Node*, bool>& needs_long_name) {
+  static constexpr uint8_t DOT_NAME[11] = {'.', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+  static constexpr uint8_t DOT_DOT_NAME[11] = {'.', '.', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+
+  std::vector<uint8_t> entries;
+  if (dir.parent != nullptr) {
+    append_short_entry(entries, DOT_NAME, ATTR_DIRECTORY, dir, dir.first_cluster, 0);
+    // The root directory is cluster 0 in "..".
+    append_short_entry(entries, DOT_DOT_NAME, ATTR_DIRECTORY, dir, dir.parent->first_cluster, 0);
+  }
+
+  for (Node* child : dir.children) {
+    if (needs_long_name.at(child))
+      append_long_entries(entries, *child);
+
+    const uint8_t attributes = child->is_dir ? ATTR_DIRECTORY : ATTR_ARCHIVE;
+    const uint32_t size = child->is_dir ? 0 : (uint32_t)child->data.size();
+    append_short_entry(entries, child->short_name, attributes, *child, child->first_cluster, size);
+  }
+
+  // The end of the directory is marked by a free entry (the zero padding).
+  dir.data = std::move(entries);
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage();
+    return 1;
+  }
+
+  if (!fs::is_directory(options.input_dir)) {
+    std::cerr << ERROR "'" << options.input_dir.string() << "' is not a directory\n";
+    return 1;
+  }
+
+  Node* root = scan(options.input_dir, nullptr, "");
+
+  std::vector<Node*> files, dirs;
+  for (const auto& node : g_nodes)
+    (node->is_dir ? dirs : files).push_back(node.get());
+
+  if (!read_files(files))
+    return 1;
+
+  for (Node* file : files) {
+    if (file->data.size() > UINT32_MAX) {
+      std::cerr << ERROR "'" << file->source.string() << "' is too large for a FAT volume\n";
+      return 1;
+    }
+  }
+
+  // The directories sizes depend on the names only, they are allocated as the files.
+  std::map<Node*, bool> needs_long_name;
+  size_t root_entry_count = 0;
+  for (Node* dir : dirs) {
+    const size_t entry_count = prepare_short_names(*dir, needs_long_name);
+    // Leave a free entry at the end, FatFs stops reading a directory at the first free entry.
+    const size_t byte_size = (entry_count + 1) * DIR_ENTRY_SIZE;
+    if (dir == root)
+      root_entry_count = entry_count;
+    else
+      dir->cluster_count = (uint32_t)((byte_size + CLUSTER_SIZE - 1) / CLUSTER_SIZE);
+  }
+
+  if (root_entry_count >= ROOT_ENTRY_COUNT) {
+    std::cerr << ERROR "too many entries in the root directory (at most " << ROOT_ENTRY_COUNT - 1 << ")\n";
+    return 1;
+  }
+
+  for (Node* file : files)
+    file->cluster_count = (uint32_t)((file->data.size() + CLUSTER_SIZE - 1) / CLUSTER_SIZE);
+
+  // Allocation order: the hot files (in the given order), then the directories and the other files.
+  std::vector<Node*> order;
+  for (const auto& hot_file : options.hot_files) {
+    auto it = std::find_if(files.begin(), files.end(), [&](Node* file) { return file->path == hot_file; });
+    if (it == files.end()) {
+      std::cerr << "warning: hot file '" << hot_file << "' not found\n";
+      continue;
+    }
+
+    order.push_back(*it);
+  }
+
+  for (Node* dir : dirs) {
+    if (dir != root)
+      order.push_back(dir);
+  }
+
+  for (Node* file : files) {
+    if (std::find(order.begin(), order.end(), file) == order.end())
+      order.push_back(file);
+  }
+
+  // Every file and directory is a single run of clusters (empty files have none).
+  uint32_t next_cluster = 2;
+  for (Node* node : order) {
+    if (node->cluster_count == 0)
+      continue;
+
+    node->first_cluster = next_cluster;
+    next_cluster += node->cluster_count;
+  }
+
+  const uint32_t free_clusters = (uint32_t)((options.free_size + CLUSTER_SIZE - 1) / CLUSTER_SIZE);
+  const uint32_t cluster_count = std::max<uint32_t>(next_cluster - 2 + free_clusters, 1);
+  if (cluster_count > MAX_FAT16_CLUSTERS) {
+    std::cerr << ERROR "the content is too large for a FAT16 volume\n";
+    return 1;
+  }
+
+  const bool is_fat12 = cluster_count <= MAX_FAT12_CLUSTERS;
+  const uint32_t fat_byte_size = is_fat12 ? ((cluster_count + 2) * 3 + 1) / 2 : (cluster_count + 2) * 2;
+  const uint32_t fat_sector_count = (fat_byte_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  const uint32_t root_sector_count = ROOT_ENTRY_COUNT * DIR_ENTRY_SIZE / SECTOR_SIZE;
+
+  // Pad the reserved area so the data area, and then every cluster, starts at a cluster boundary.
+  uint32_t reserved_sector_count = 1;
+  while ((reserved_sector_count + FAT_COUNT * fat_sector_count + root_sector_count) % SECTORS_PER_CLUSTER != 0)
+    reserved_sector_count++;
+
+  const uint32_t data_sector = reserved_sector_count + FAT_COUNT * fat_sector_count + root_sector_count;
+  const uint32_t total_sector_count = data_sector + cluster_count * SECTORS_PER_CLUSTER;
+  const uint64_t image_size = (uint64_t)total_sector_count * SECTOR_SIZE;
+  // A compressed image is checked once compressed, as it is loaded so.
+  if (!options.compress && image_size > options.max_size) {
+    std::cerr << ERROR "the image needs " << image_size / 1024 << " KiB, more than the maximum of "
+              << options.max_size / 1024 << " KiB\n";
+    return 1;
+  }
+
+  std::vector<uint8_t> image(image_size, 0);
+
+  // The boot sector (BPB).
+  uint8_t* boot = image.data();
+  boot[0] = 0xEB;
+  boot[1] = 0x3C;
+  boot[2] = 0x90;
+  std::memcpy(boot + 3, "MKFATIMG", 8);
+  put16(boot + 11, SECTOR_SIZE);
+  boot[13] = SECTORS_PER_CLUSTER;
+  put16(boot + 14, reserved_sector_count);
+  boot[16] = FAT_COUNT;
+  put16(boot + 17, ROOT_ENTRY_COUNT);
+  if (total_sector_count < 0x10000)
+    put16(boot + 19, total_sector_count);
+  else
+    put32(boot + 32, total_sector_count);
+  boot[21] = 0xF8;  // fixed media
+  put16(boot + 22, fat_sector_count);
+  put16(boot + 24, 32);  // sectors per track
+  put16(boot + 26, 64);  // heads
+  boot[36] = 0x80;       // drive number
+  boot[38] = 0x29;       // extended boot signature
+  put32(boot + 39, 0x50494B41);  // "PIKA", the volume serial number
+  std::memcpy(boot + 43, "PIKAOS     ", 11);
+  std::memcpy(boot + 54, is_fat12 ? "FAT12   " : "FAT16   ", 8);
+  boot[510] = 0x55;
+  boot[511] = 0xAA;
+
+  // The FATs.
+  std::vector<uint16_t> fat(cluster_count + 2, 0);
+  fat[0] = is_fat12 ? 0xFF8 : 0xFFF8;
+  fat[1] = is_fat12 ? 0xFFF : 0xFFFF;
+  for (Node* node : order) {
+    for (uint32_t i = 0; i < node->cluster_count; ++i) {
+      const uint32_t cluster = node->first_cluster + i;
+      const bool is_last = i + 1 == node->cluster_count;
+      fat[cluster] = is_last ? (is_fat12 ? 0xFFF : 0xFFFF) : cluster + 1;
+    }
+  }
+
+  for (uint32_t copy = 0; copy < FAT_COUNT; ++copy) {
+    uint8_t* table = image.data() + (uint64_t)(reserved_sector_count + copy * fat_sector_count) * SECTOR_SIZE;
+    for (uint32_t cluster = 0; cluster < fat.size(); ++cluster) {
+      if (is_fat12) {
+        uint8_t* p = table + cluster * 3 / 2;
+        if (cluster % 2 == 0) {
+          p[0] = fat[cluster] & 0xFF;
+          p[1] = (p[1] & 0xF0) | ((fat[cluster] >> 8) & 0x0F);
+        } else {
+          p[0] = (p[0] & 0x0F) | ((fat[cluster] << 4) & 0xF0);
+          p[1] = fat[cluster] >> 4;
+        }
+      } else {
+        put16(table + cluster * 2, fat[cluster]);
+      }
+    }
+  }
+
+  // The directories and the files content.
+  auto cluster_offset = [&](uint32_t cluster) {
+    return (uint64_t)data_sector * SECTOR_SIZE + (uint64_t)(cluster - 2) * CLUSTER_SIZE;
+  };
+
+  for (Node* dir : dirs) {
+    build_dir_entries(*dir, needs_long_name);
+    const uint64_t offset = dir == root ? (uint64_t)(data_sector - root_sector_count) * SECTOR_SIZE
+                                        : cluster_offset(dir->first_cluster);
+    std::copy(dir->data.begin(), dir->data.end(), image.begin() + offset);
+  }
+
+  for (Node* file : files) {
+    if (file->cluster_count > 0)
+      std::copy(file->data.begin(), file->data.end(), image.begin() + cluster_offset(file->first_cluster));
+  }
+
+  if (options.compress) {
+    image = compress_image(image);
+    if (image.size() > options.max_size) {
+      std::cerr << ERROR "the compressed image needs " << image.size() / 1024 << " KiB, more than the maximum of "
+                << options.max_size / 1024 << " KiB\n";
+      return 1;
+    }
+  }
+
+  std::ofstream output(options.output_path, std::ios::binary);
+  output.write((const char*)image.data(), (std::streamsize)image.size());
+  if (!output.good()) {
+    std::cerr << ERROR "failed to write '" << options.output_path.string() << "'\n";
+    return 1;
+  }
+
+  // The index: the byte offset of each file inside the image, in the allocation order.
+  if (!options.index_path.empty()) {
+    std::ofstream index(options.index_path);
+    index << "# offset size path\n";
+    for (Node* node : order) {
+      if (!node->is_dir)
+        index << (node->cluster_count == 0 ? 0 : cluster_offset(node->first_cluster)) << " " << node->data.size() << " "
+              << node->path << "\n";
+    }
+
+    if (!index.good()) {
+      std::cerr << ERROR "failed to write '" << options.index_path.string() << "'\n";
+      return 1;
+    }
+  }
+
+  std::cout << options.output_path.string() << ": " << (is_fat12 ? "FAT12" : "FAT16") << ", " << files.size()
+            << " files, " << cluster_count << " clusters of " << CLUSTER_SIZE << " bytes (" << image_size / 1024
+            << " KiB";
+  if (options.compress)
+    std::cout << ", " << image.size() / 1024 << " KiB compressed";
+  std::cout << ")\n";
+  return 0;
+}
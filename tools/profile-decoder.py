@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+
+# Decodes the profiler samples (see kernel/profiler.hpp, enabled by CONFIG_PROFILER) from a capture of the log
+# UART, symbolizes them with the kernel ELF and the ELFs of the programs and shared libraries, and prints the
+# functions taking the most samples of each event:
+# ./profile-decoder.py [--folded `output file`] `uart capture file` `kernel ELF` [`program or library ELF`...]
+#
+# The programs and libraries are matched by their file name (e.g. build/binuser/init for /bin/init). With
+# --folded, the call chains of the cycles samples are also written in the folded format of flamegraph.pl.
+
+import argparse
+import bisect
+import os
+import struct
+from collections import Counter
+from enum import IntEnum
+
+RECORD_MAGIC = b'PRF'
+# timestamp (ns), pid, core, kind, event, pc, frame count, then the frames (or a path)
+RECORD_HEADER_FORMAT = '<QIHBBQQ'
+RECORD_HEADER_SIZE = struct.calcsize(RECORD_HEADER_FORMAT)
+MAX_FRAMES = 12
+RECORD_SIZE = RECORD_HEADER_SIZE + MAX_FRAMES * 8
+
+KERNEL_BASE = 0xffff000000000000
+TOP_COUNT = 25
+
+# Keep in sync with Profiler::RecordKind and Profiler::Event in kernel/profiler.hpp.
+class Kind(IntEnum):
+    SAMPLE = 0
+    PROGRAM = 1
+    FORK = 2
+    LIBRARY = 3
+    LOST = 4
+
+class Event(IntEnum):
+    CYCLES = 0
+    CACHE_MISSES = 1
+    BRANCH_MISSES = 2
+
+class Symbols:
+    """The function symbols of an ELF (its .symtab section), loaded at base."""
+
+    def __init__(self, path: str, base: int = 0):
+        self.addresses = []
+        self.entries = []
+        with open(path, 'rb') as file:
+            data = file.read()
+
+        # ELF64 little endian only, as the kernel and the programs.
+        section_offset, = struct.unpack_from('<Q', data, 0x28)
+        section_size, section_count = struct.unpack_from('<HH', data, 0x3a)
+        sections = [struct.unpack_from('<IIQQQQIIQQ', data, section_offset + i * section_size)
+                    for i in range(section_count)]
+        for _, kind, _, _, offset, size, link, _, _, entry_size in sections:
+            if kind != 2:  # SHT_SYMTAB
+                continue
+
+            strings_offset = sections[link][4]
+            for i in range(size // entry_size):
+                name, info, _, _, value, symbol_size = struct.unpack_from('<IBBHQQ', data, offset + i * entry_size)
+                if info & 0xf != 2 or value == 0:  # STT_FUNC
+                    continue
+                name_end = data.index(b'\0', strings_offset + name)
+                self.entries.append((value + base, symbol_size, data[strings_offset + name:name_end].decode()))
+
+        self.entries.sort()
+        self.addresses = [entry[0] for entry in self.entries]
+
+    def lookup(self, address: int):
+        i = bisect.bisect_right(self.addresses, address) - 1
+        if i < 0:
+            return None
+        start, size, name = self.entries[i]
+        if size != 0 and address >= start + size:
+            return None
+        return name
+
+def read_records(data: bytes):
+    offset = data.find(RECORD_MAGIC)
+    while offset >= 0 and offset + len(RECORD_MAGIC) + RECORD_SIZE <= len(data):
+        start = offset + len(RECORD_MAGIC)
+        timestamp, pid, core, kind, event, pc, frame_count = struct.unpack_from(RECORD_HEADER_FORMAT, data, start)
+        # The log lines may be interleaved with the records, skip what does not look like a record.
+        if kind in Kind._value2member_map_ and event in Event._value2member_map_ and core < 4 and \
+                frame_count <= MAX_FRAMES:
+            payload = data[start + RECORD_HEADER_SIZE:start + RECORD_SIZE]
+            yield timestamp, pid, Kind(kind), Event(event), pc, frame_count, payload
+            offset = data.find(RECORD_MAGIC, start + RECORD_SIZE)
+        else:
+            offset = data.find(RECORD_MAGIC, offset + 1)
+
+def decode_path(payload: bytes):
+    return os.path.basename(payload.split(b'\0')[0].decode(errors='replace'))
+
+class Symbolizer:
+    def __init__(self, kernel_elf: str, elfs):
+        self.kernel = Symbols(kernel_elf)
+        self.elfs = {os.path.basename(path): path for path in elfs}
+        self.programs = {}  # pid -> program name
+        self.libraries = []  # (base, Symbols)
+        self.cache = {}
+
+    def symbols(self, name: str, base: int = 0):
+        if name not in self.elfs:
+            return None
+        if (name, base) not in self.cache:
+            self.cache[(name, base)] = Symbols(self.elfs[name], base)
+        return self.cache[(name, base)]
+
+    def add_library(self, base: int, name: str):
+        symbols = self.symbols(name, base)
+        if symbols is not None:
+            self.libraries.append((base, symbols))
+
+    def lookup(self, pid: int, address: int):
+        if address >= KERNEL_BASE:
+            return self.kernel.lookup(address) or f'[kernel] {address:#x}'
+
+        program = self.programs.get(pid)
+        symbols = self.symbols(program) if program is not None else None
+        name = symbols.lookup(address) if symbols is not None else None
+        for base, library in self.libraries:
+            if name is None and address >= base:
+                name = library.lookup(address)
+        return name or f'[{program or "user"}] {address:#x}'
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes and symbolizes the kernel profiler samples.')
+    parser.add_argument('--folded', help='write the cycles call chains in the flamegraph.pl folded format')
+    parser.add_argument('capture', help='the capture of the log UART')
+    parser.add_argument('kernel', help='the kernel ELF (kernel8.elf)')
+    parser.add_argument('elfs', nargs='*', help='the ELFs of the programs and shared libraries')
+    args = parser.parse_args()
+
+    with open(args.capture, 'rb') as capture:
+        records = sorted(read_records(capture.read()), key=lambda record: record[0])
+
+    symbolizer = Symbolizer(args.kernel, args.elfs)
+    self_counts = {event: Counter() for event in Event}
+    folded = Counter()
+    lost_count = 0
+    for _, pid, kind, event, pc, frame_count, payload in records:
+        if kind == Kind.PROGRAM:
+            symbolizer.programs[pid] = decode_path(payload)
+        elif kind == Kind.FORK:
+            if pc in symbolizer.programs:
+                symbolizer.programs[pid] = symbolizer.programs[pc]
+        elif kind == Kind.LIBRARY:
+            symbolizer.add_library(pc, decode_path(payload))
+        elif kind == Kind.LOST:
+            lost_count += pc
+        elif kind == Kind.SAMPLE:
+            leaf = symbolizer.lookup(pid, pc)
+            self_counts[event][leaf] += 1
+            if event == Event.CYCLES:
+                # The frames are return addresses, look up the call instructions before them.
+                frames = struct.unpack_from(f'<{frame_count}Q', payload)
+                callers = [symbolizer.lookup(pid, address - 4) for address in reversed(frames)]
+                task = symbolizer.programs.get(pid, f'pid {pid}' if pid != 0 else 'idle')
+                folded[';'.join([task] + callers + [leaf])] += 1
+
+    for event in Event:
+        total = sum(self_counts[event].values())
+        if total == 0:
+            continue
+        print(f'{event.name.lower()}: {total} samples')
+        for name, count in self_counts[event].most_common(TOP_COUNT):
+            print(f'  {100 * count / total:6.2f}%  {count:8}  {name}')
+        print()
+
+    if lost_count != 0:
+        print(f'{lost_count} records lost')
+
+    if args.folded:
+        with open(args.folded, 'w') as output:
+            for stack, count in folded.items():
+                output.write(f'{stack} {count}\n')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+
+# Runs the kernel benchmarks (see lib/libk/include/libk/benchmark.hpp, built with -DBUILD_BENCHMARKS=ON) and
+# compares them to a baseline. The results are read from the log UART, either of QEMU (the kernel must be built
+# with -DTARGET_QEMU=ON, it then exits QEMU once done) or of a board booted from the kernel-bench-img image:
+# ./run-benchmarks.py --qemu `build dir` [--baseline `json file`] [--save `json file`]
+# ./run-benchmarks.py --capture `uart capture file or serial device` [--baseline `json file`] [--save `json file`]
+#
+# The userspace benchmarks (binuser/bench_*.c) print the same lines, with times in nanoseconds instead of cycles:
+# run one of them on a board (e.g. from /bin/init) and pass the capture of the UART.
+#
+# A benchmark regresses if its median cycle count (or time) exceeds the baseline one by more than the threshold (in
+# percent), given by --threshold or per benchmark in the "thresholds" object of the baseline file. The exit
+# code is 1 if any benchmark regresses or is missing.
+
+import argparse
+import json
+import subprocess
+import sys
+
+BEGIN_TAG = 'BENCH_BEGIN'
+RESULT_TAG = 'BENCH'
+END_TAG = 'BENCH_END'
+# The compared statistic, the minimum and the 99th percentile are too noisy on a board. The userspace benchmarks
+# only report times.
+METRIC = 'cycles_median'
+USER_METRIC = 'ns_median'
+
+def get_metric(result) -> int:
+    return result[METRIC] if METRIC in result else result[USER_METRIC]
+
+def get_unit(result) -> str:
+    return 'cycles' if METRIC in result else 'ns'
+
+def parse_line(line: str):
+    """Returns the tag and the JSON object of a benchmark output line, or None."""
+    for tag in (BEGIN_TAG, END_TAG, RESULT_TAG):
+        start = line.find(tag + ' {')
+        if start != -1:
+            return tag, json.loads(line[start + len(tag) + 1:].strip())
+    return None
+
+def read_results(lines):
+    """Reads the results from the log lines, until the end of the benchmarks."""
+    results = {}
+    tick_frequency = None
+    for line in lines:
+        parsed = parse_line(line)
+        if parsed is None:
+            continue
+
+        tag, value = parsed
+        if tag == BEGIN_TAG:
+            tick_frequency = value['tick_frequency']
+        elif tag == RESULT_TAG:
+            results[value['name']] = value
+            print(f'{value["name"]:40} {get_metric(value):>12} {get_unit(value)} (median)', flush=True)
+        elif tag == END_TAG:
+            break
+    else:
+        print('warning: the output ended before the end of the benchmarks', file=sys.stderr)
+
+    return {'tick_frequency': tick_frequency, 'results': results}
+
+def run_qemu(build_dir: str, qemu: str, timeout: int):
+    command = [qemu, '-M', 'raspi3b', '-display', 'none', '-serial', 'stdio',
+               '-kernel', f'{build_dir}/kernel/kernel8.img', '-dtb', 'doc/DeviceTree/pi3.dtb',
+               '-device', f'loader,file={build_dir}/binuser/fs.img,addr=0x18000000,force-raw=on',
+               '-append', 'kbench']
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, text=True, errors='replace')
+    try:
+        return read_results(process.stdout)
+    finally:
+        try:
+            process.wait(timeout=timeout)
+        except subprocess.TimeoutExpired:
+            process.kill()
+
+def compare(run, baseline, default_threshold: float) -> bool:
+    thresholds = baseline.get('thresholds', {})
+    is_ok = True
+    for name, expected in sorted(baseline['results'].items()):
+        result = run['results'].get(name)
+        if result is None:
+            print(f'MISSING   {name}')
+            is_ok = False
+            continue
+
+        threshold = thresholds.get(name, default_threshold)
+        change = (get_metric(result) - get_metric(expected)) * 100 / max(get_metric(expected), 1)
+        status = 'REGRESSED' if change > threshold else 'ok'
+        print(f'{status:9} {name:40} {get_metric(expected):>12} -> {get_metric(result):>12} ({change:+.1f}%, '
+              f'threshold {threshold}%)')
+        is_ok &= change <= threshold
+
+    for name in sorted(run['results'].keys() - baseline['results'].keys()):
+        print(f'new       {name}')
+
+    return is_ok
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Runs the kernel benchmarks and compares them to a baseline.')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--qemu', metavar='BUILD_DIR', help='run the kernel of this build dir under QEMU')
+    source.add_argument('--capture', help='read the log UART from this file or serial device (configured with stty)')
+    parser.add_argument('--qemu-binary', default='qemu-system-aarch64')
+    parser.add_argument('--timeout', type=int, default=600, help='seconds to wait for QEMU to exit')
+    parser.add_argument('--baseline', help='the results to compare to')
+    parser.add_argument('--threshold', type=float, default=10.0, help='the default regression threshold (in %%)')
+    parser.add_argument('--save', help='write the results into this file, to be used as a baseline')
+    args = parser.parse_args()
+
+    if args.qemu is not None:
+        run = run_qemu(args.qemu, args.qemu_binary, args.timeout)
+    else:
+        with open(args.capture, 'r', errors='replace') as capture:
+            run = read_results(capture)
+
+    if not run['results']:
+        print('error: no benchmark results found', file=sys.stderr)
+        sys.exit(1)
+
+    if args.save is not None:
+        with open(args.save, 'w') as file:
+            json.dump(run, file, indent=2, sort_keys=True)
+
+    if args.baseline is not None:
+        with open(args.baseline) as file:
+            baseline = json.load(file)
+        if not compare(run, baseline, args.threshold):
+            sys.exit(1)
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# Decodes the kernel trace (see kernel/trace.hpp, enabled by CONFIG_TRACE) from a capture of the log UART
+# into the Chrome trace event JSON format, to be opened in https://ui.perfetto.dev or chrome://tracing:
+# ./trace-decoder.py `uart capture file` `output json file`
+
+import json
+import struct
+import sys
+from enum import IntEnum
+
+RECORD_MAGIC = b'TRC'
+# timestamp (ns), event, core, args[0], args[1]
+RECORD_FORMAT = '<QIIQQ'
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+# Keep in sync with Trace::Event in kernel/trace.hpp.
+class Event(IntEnum):
+    LOST = 0
+    CONTEXT_SWITCH = 1
+    IRQ_ENTER = 2
+    IRQ_EXIT = 3
+    SYSCALL_ENTER = 4
+    SYSCALL_EXIT = 5
+    PAGE_ALLOC = 6
+    PAGE_FREE = 7
+    DMA_SUBMIT = 8
+
+IRQ_TYPES = ['ARMCore', 'VideoCore', 'Local']
+
+# The trace tracks: the kernel events of each core, and the tasks running on each core.
+KERNEL_PID = 0
+TASKS_PID = 1
+
+def read_records(data: bytes):
+    offset = data.find(RECORD_MAGIC)
+    while offset >= 0 and offset + len(RECORD_MAGIC) + RECORD_SIZE <= len(data):
+        start = offset + len(RECORD_MAGIC)
+        timestamp, event, core, arg0, arg1 = struct.unpack_from(RECORD_FORMAT, data, start)
+        # The log lines may be interleaved with the records, skip what does not look like a record.
+        if event in Event._value2member_map_ and core < 4:
+            yield timestamp, Event(event), core, arg0, arg1
+            offset = data.find(RECORD_MAGIC, start + RECORD_SIZE)
+        else:
+            offset = data.find(RECORD_MAGIC, offset + 1)
+
+def irq_name(irq_type: int, irq_id: int):
+    type_name = IRQ_TYPES[irq_type] if irq_type < len(IRQ_TYPES) else str(irq_type)
+    return f'irq {type_name}:{irq_id:#x}'
+
+def convert(records):
+    events = []
+    cores = set()
+    for timestamp, event, core, arg0, arg1 in sorted(records, key=lambda record: record[0]):
+        cores.add(core)
+        base = {'ts': timestamp / 1000, 'pid': KERNEL_PID, 'tid': core}
+        if event == Event.CONTEXT_SWITCH:
+            if arg0 != 0:
+                events.append(base | {'ph': 'E', 'pid': TASKS_PID, 'name': f'pid {arg0}'})
+            events.append(base | {'ph': 'B', 'pid': TASKS_PID, 'name': f'pid {arg1}'})
+        elif event == Event.IRQ_ENTER:
+            events.append(base | {'ph': 'B', 'name': irq_name(arg0, arg1)})
+        elif event == Event.IRQ_EXIT:
+            events.append(base | {'ph': 'E', 'name': irq_name(arg0, arg1)})
+        elif event == Event.SYSCALL_ENTER:
+            events.append(base | {'ph': 'B', 'name': f'sys #{arg0}', 'args': {'x0': arg1}})
+        elif event == Event.SYSCALL_EXIT:
+            events.append(base | {'ph': 'E', 'name': f'sys #{arg0}', 'args': {'result': arg1}})
+        elif event in (Event.PAGE_ALLOC, Event.PAGE_FREE):
+            name = 'page alloc' if event == Event.PAGE_ALLOC else 'page free'
+            events.append(base | {'ph': 'i', 's': 't', 'name': name, 'args': {'address': hex(arg0), 'pages': arg1}})
+        elif event == Event.DMA_SUBMIT:
+            events.append(base | {'ph': 'i', 's': 't', 'name': 'dma submit',
+                                  'args': {'channel': hex(arg0), 'request': hex(arg1)}})
+        elif event == Event.LOST:
+            events.append(base | {'ph': 'i', 's': 't', 'name': 'records lost', 'args': {'count': arg0}})
+
+    events.append({'ph': 'M', 'pid': KERNEL_PID, 'name': 'process_name', 'args': {'name': 'kernel'}})
+    events.append({'ph': 'M', 'pid': TASKS_PID, 'name': 'process_name', 'args': {'name': 'tasks'}})
+    for core in sorted(cores):
+        for pid in (KERNEL_PID, TASKS_PID):
+            events.append({'ph': 'M', 'pid': pid, 'tid': core, 'name': 'thread_name', 'args': {'name': f'core {core}'}})
+    return events
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        print('Usage: trace-decoder.py `uart capture file` `output json file`')
+        exit(1)
+
+    with open(sys.argv[1], 'rb') as capture:
+        records = list(read_records(capture.read()))
+
+    with open(sys.argv[2], 'w') as output:
+        json.dump({'traceEvents': convert(records), 'displayTimeUnit': 'ns'}, output)
+
+    print(f'{len(records)} records decoded')
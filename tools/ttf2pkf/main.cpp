@@ -1,7 +1,9 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <utility>
 #include <vector>
 
 #include <ft2build.h>
@@ -19,6 +21,45 @@ struct alignas(16) PKFHeader {
   uint32_t line_height;
 };  // struct PKFHeader
 
+// See doc/pkf.md for the v2 format.
+constexpr uint32_t PKF2_MAGIC = 0x32464b50;  // "PKF2"
+
+struct alignas(16) PKF2Header {
+  uint32_t magic;
+  uint32_t range_count;
+  uint32_t glyph_count;
+  uint32_t kerning_count;
+  PKFHeader metrics;
+};  // struct PKF2Header
+
+struct PKF2Range {
+  uint32_t first_code_point;
+  uint32_t count;
+  uint32_t first_glyph;
+};  // struct PKF2Range
+
+enum PKF2Encoding : uint8_t {
+  PKF2_ENCODING_ALPHA = 0,
+  PKF2_ENCODING_OPAQUE = 1,
+};  // enum PKF2Encoding
+
+struct PKF2Glyph {
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+  uint8_t encoding;
+  uint8_t advance;
+  uint8_t reserved[2];
+  uint32_t offset;
+};  // struct PKF2Glyph
+
+struct PKF2KerningPair {
+  uint32_t left;
+  uint32_t right;
+  int32_t adjustment;
+};  // struct PKF2KerningPair
+
 bool handle_ft_error(FT_Error error, const char* context) {
   fprintf(stderr, ERROR "%s: %s\n", context, FT_Error_String(error));
   return false;
@@ -36,12 +77,11 @@ static bool write_to_file(const char* output_path, const uint8_t* buffer, size_t
   return true;
 }
 
-static uint8_t* render_ascii_code(FT_Face face, char ch, uint8_t* output_buffer) {
-  const FT_UInt char_width = face->size->metrics.x_ppem;
+static uint8_t* render_ascii_code(FT_Face face, uint32_t ch, uint32_t char_width, uint8_t* output_buffer) {
   const FT_UInt char_height = (face->size->metrics.ascender - face->size->metrics.descender) / 64;
   const FT_UInt ascender = face->size->metrics.ascender / 64;
 
-  const FT_UInt glyph_index = FT_Get_Char_Index(face, (uint32_t)ch);
+  const FT_UInt glyph_index = FT_Get_Char_Index(face, ch);
   FT_Error error = FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
   if (error) {
     handle_ft_error(error, "failed to load or render glyph");
@@ -60,8 +100,14 @@ static uint8_t* render_ascii_code(FT_Face face, char ch, uint8_t* output_buffer)
 
   for (uint32_t y = 0; y < bitmap.rows; ++y) {
     for (uint32_t x = 0; x < bitmap.width; ++x) {
+      // The glyphs of the proportional fonts may overflow the cell (e.g. italic overhangs).
+      const int32_t cell_x = face->glyph->bitmap_left + (int32_t)x;
+      const int32_t cell_y = (int32_t)ascender - face->glyph->bitmap_top + (int32_t)y;
+      if (cell_x < 0 || cell_x >= (int32_t)char_width || cell_y < 0 || cell_y >= (int32_t)char_height)
+        continue;
+
       uint8_t alpha = bitmap.buffer[x + y * bitmap.width];
-      output_buffer[(face->glyph->bitmap_left + x) + char_width * (ascender - face->glyph->bitmap_top + y)] = alpha;
+      output_buffer[cell_x + char_width * cell_y] = alpha;
     }
   }
 
@@ -69,7 +115,159 @@ static uint8_t* render_ascii_code(FT_Face face, char ch, uint8_t* output_buffer)
   return output_buffer;
 }
 
-bool convert(const char* input_path, const char* output_path, uint32_t requested_size_in_pixels = 10) {
+/* Encodes the glyph rendered in `cell` (a char_width x char_height alpha map) as the spans of its non-transparent
+ * pixels, appended to `data`, and fills `glyph` (except its offset). */
+static void encode_glyph(const uint8_t* cell, uint32_t char_width, uint32_t char_height, PKF2Glyph& glyph,
+                         std::vector<uint8_t>& data) {
+  // The bounding box of the non-transparent pixels, and whether they are all opaque.
+  uint32_t x_min = char_width, y_min = char_height, x_max = 0, y_max = 0;
+  bool is_opaque = true;
+  for (uint32_t y = 0; y < char_height; ++y) {
+    for (uint32_t x = 0; x < char_width; ++x) {
+      const uint8_t alpha = cell[x + char_width * y];
+      if (alpha == 0)
+        continue;
+
+      x_min = std::min(x_min, x);
+      y_min = std::min(y_min, y);
+      x_max = std::max(x_max, x);
+      y_max = std::max(y_max, y);
+      is_opaque = is_opaque && alpha == 0xff;
+    }
+  }
+
+  glyph = {};
+  if (x_min > x_max)
+    return;  // blank glyph (e.g. the space), no rows
+
+  glyph.x = x_min;
+  glyph.y = y_min;
+  glyph.width = x_max - x_min + 1;
+  glyph.height = y_max - y_min + 1;
+  glyph.encoding = is_opaque ? PKF2_ENCODING_OPAQUE : PKF2_ENCODING_ALPHA;
+
+  for (uint32_t y = y_min; y <= y_max; ++y) {
+    const uint8_t* row = cell + char_width * y;
+    const size_t count_index = data.size();
+    data.push_back(0);
+
+    uint32_t x = x_min;
+    uint32_t previous_end = x_min;
+    while (x <= x_max) {
+      if (row[x] == 0) {
+        ++x;
+        continue;
+      }
+
+      uint32_t end = x;
+      while (end <= x_max && row[end] != 0)
+        ++end;
+
+      data[count_index]++;
+      data.push_back(x - previous_end);
+      data.push_back(end - x);
+      if (!is_opaque)
+        data.insert(data.end(), row + x, row + end);
+      previous_end = end;
+      x = end;
+    }
+  }
+}
+
+/* Returns the horizontal advance of the glyph of `code_point`, in pixels. */
+static uint32_t get_advance(FT_Face face, uint32_t code_point) {
+  if (FT_Load_Glyph(face, FT_Get_Char_Index(face, code_point), FT_LOAD_DEFAULT))
+    return 0;
+  return face->glyph->advance.x / 64;
+}
+
+/* Returns the kerning pairs between the code points of `ranges` whose adjustment is not 0, sorted by left then
+ * right code point. Only the 'kern' table is read by FreeType, not the GPOS kerning. */
+static std::vector<PKF2KerningPair> get_kerning_pairs(FT_Face face,
+                                                      const std::vector<std::pair<uint32_t, uint32_t>>& ranges) {
+  std::vector<PKF2KerningPair> pairs;
+  if (!FT_HAS_KERNING(face))
+    return pairs;
+
+  for (const auto& left_range : ranges) {
+    for (uint32_t left = left_range.first; left <= left_range.second; ++left) {
+      const FT_UInt left_index = FT_Get_Char_Index(face, left);
+      for (const auto& right_range : ranges) {
+        for (uint32_t right = right_range.first; right <= right_range.second; ++right) {
+          FT_Vector delta;
+          if (FT_Get_Kerning(face, left_index, FT_Get_Char_Index(face, right), FT_KERNING_DEFAULT, &delta))
+            continue;
+          if (delta.x / 64 != 0)
+            pairs.push_back({left, right, (int32_t)(delta.x / 64)});
+        }
+      }
+    }
+  }
+
+  std::sort(pairs.begin(), pairs.end(), [](const PKF2KerningPair& a, const PKF2KerningPair& b) {
+    return a.left != b.left ? a.left < b.left : a.right < b.right;
+  });
+  return pairs;
+}
+
+/* Writes the glyphs rendered in `cells` (`char_count` cells of the code points in `ranges`) in the v2 format. */
+static bool write_v2(const char* output_path, FT_Face face, const PKFHeader& metrics,
+                     const std::vector<std::pair<uint32_t, uint32_t>>& ranges, const uint8_t* cells,
+                     size_t char_count) {
+  // The glyph bounding boxes are stored in bytes.
+  if (metrics.char_width > UINT8_MAX || metrics.char_height > UINT8_MAX) {
+    fprintf(stderr, ERROR "the PKF v2 format only supports characters up to 255x255 pixels\n");
+    return false;
+  }
+
+  const std::vector<PKF2KerningPair> kerning_pairs = get_kerning_pairs(face, ranges);
+  const size_t table_size = sizeof(PKF2Header) + sizeof(PKF2Range) * ranges.size() + sizeof(PKF2Glyph) * char_count +
+                            sizeof(PKF2KerningPair) * kerning_pairs.size();
+  std::vector<uint8_t> pkf_buffer(table_size);
+
+  auto* header = reinterpret_cast<PKF2Header*>(pkf_buffer.data());
+  header->magic = PKF2_MAGIC;
+  header->range_count = ranges.size();
+  header->glyph_count = char_count;
+  header->kerning_count = kerning_pairs.size();
+  header->metrics = metrics;
+
+  auto* pkf_ranges = reinterpret_cast<PKF2Range*>(pkf_buffer.data() + sizeof(PKF2Header));
+  uint32_t first_glyph = 0;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const uint32_t count = ranges[i].second - ranges[i].first + 1;
+    pkf_ranges[i] = {ranges[i].first, count, first_glyph};
+    first_glyph += count;
+  }
+
+  // The spans are stored after the glyph table, in the glyph order.
+  auto* glyphs = reinterpret_cast<PKF2Glyph*>(pkf_ranges + ranges.size());
+  std::vector<uint8_t> data;
+  const size_t cell_size = metrics.char_width * metrics.char_height;
+  size_t i = 0;
+  for (const auto& range : ranges) {
+    for (uint32_t code_point = range.first; code_point <= range.second; ++code_point, ++i) {
+      PKF2Glyph glyph;
+      const size_t offset = table_size + data.size();
+      encode_glyph(cells + cell_size * i, metrics.char_width, metrics.char_height, glyph, data);
+      glyph.offset = offset;
+      glyph.advance = std::min<uint32_t>(get_advance(face, code_point), UINT8_MAX);
+      glyphs[i] = glyph;
+    }
+  }
+
+  memcpy(glyphs + char_count, kerning_pairs.data(), sizeof(PKF2KerningPair) * kerning_pairs.size());
+
+  pkf_buffer.insert(pkf_buffer.end(), data.begin(), data.end());
+  return write_to_file(output_path, pkf_buffer.data(), pkf_buffer.size());
+}
+
+using CodePointRanges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+/* Converts the font at `input_path`. The `ranges` of code points (both ends included) are only used by the v2
+ * format, the v1 format always stores the ASCII characters from FIRST_CHARACTER to LAST_CHARACTER. */
+bool convert(const char* input_path, const char* output_path, uint32_t requested_size_in_pixels, bool is_v2,
+             const CodePointRanges& ranges) {
   FT_Library library;
   FT_Error error = FT_Init_FreeType(&library);
   if (error)
@@ -80,8 +278,9 @@ bool convert(const char* input_path, const char* output_path, uint32_t requested
   if (error)
     return handle_ft_error(error, "failed to open font");
 
-  if (!FT_IS_FIXED_WIDTH(face)) {
-    fprintf(stderr, ERROR "the PKF format only support monospace fonts, but the provided one is not monospace");
+  // The v2 format stores an advance per glyph.
+  if (!is_v2 && !FT_IS_FIXED_WIDTH(face)) {
+    fprintf(stderr, ERROR "the PKF v1 format only support monospace fonts, but the provided one is not monospace");
     return false;
   }
   error = FT_Set_Pixel_Sizes(face, 0, requested_size_in_pixels);
@@ -90,13 +289,23 @@ bool convert(const char* input_path, const char* output_path, uint32_t requested
 
   uint32_t real_char_height = (face->size->metrics.ascender - face->size->metrics.descender) / 64;
 
-  const size_t char_count = LAST_CHARACTER - FIRST_CHARACTER + 1;
-  const size_t pkf_buffer_size = sizeof(PKFHeader) + (requested_size_in_pixels * real_char_height) * char_count;
+  const CodePointRanges ascii_range = {{FIRST_CHARACTER, LAST_CHARACTER}};
+  const CodePointRanges& rendered_ranges = is_v2 ? ranges : ascii_range;
+  size_t char_count = 0;
+  for (const auto& range : rendered_ranges)
+    char_count += range.second - range.first + 1;
+
+  // The cell of a proportional font must fit its widest glyph.
+  uint32_t char_width = requested_size_in_pixels;
+  if (!FT_IS_FIXED_WIDTH(face))
+    char_width = std::max<uint32_t>(char_width, face->size->metrics.max_advance / 64);
+
+  const size_t pkf_buffer_size = sizeof(PKFHeader) + (char_width * real_char_height) * char_count;
   uint8_t* pkf_buffer = new uint8_t[pkf_buffer_size];
 
   // Fill in the header:
   PKFHeader* pkf_header = reinterpret_cast<PKFHeader*>(pkf_buffer);
-  pkf_header->char_width = requested_size_in_pixels;
+  pkf_header->char_width = char_width;
   pkf_header->char_height = real_char_height;
   pkf_header->line_height = face->size->metrics.height / 64;
 
@@ -123,13 +332,18 @@ bool convert(const char* input_path, const char* output_path, uint32_t requested
 
   // Render each glyphs:
   uint8_t* glyph_buffer = pkf_buffer + sizeof(PKFHeader);
-  for (uint32_t i = FIRST_CHARACTER; i <= LAST_CHARACTER; ++i) {
-    glyph_buffer = render_ascii_code(face, i, glyph_buffer);
-    if (glyph_buffer == nullptr)
-      return false;
+  for (const auto& range : rendered_ranges) {
+    for (uint32_t i = range.first; i <= range.second; ++i) {
+      glyph_buffer = render_ascii_code(face, i, char_width, glyph_buffer);
+      if (glyph_buffer == nullptr)
+        return false;
+    }
   }
 
-  if (!write_to_file(output_path, pkf_buffer, pkf_buffer_size))
+  // The v2 format is encoded from the full cells rendered for the v1 format.
+  if (is_v2 && !write_v2(output_path, face, *pkf_header, ranges, pkf_buffer + sizeof(PKFHeader), char_count))
+    return false;
+  if (!is_v2 && !write_to_file(output_path, pkf_buffer, pkf_buffer_size))
     return false;
 
   FT_Done_FreeType(library);
@@ -141,6 +355,8 @@ int main(int argc, char* argv[]) {
   const char* output_file = nullptr;
   const char* input_file = nullptr;
   uint32_t font_size = 12;
+  bool is_v2 = false;
+  CodePointRanges ranges;
   bool stop_parsing_options = false;
   for (int i = 1; i < argc; ++i) {
     if (!stop_parsing_options && strcmp(argv[i], "-c++") == 0) {
@@ -161,6 +377,24 @@ int main(int argc, char* argv[]) {
 
       font_size = strtol(argv[i + 1], nullptr, 10);
       ++i;
+    } else if (!stop_parsing_options && strcmp(argv[i], "-v2") == 0) {
+      is_v2 = true;
+    } else if (!stop_parsing_options && strcmp(argv[i], "-r") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, ERROR "missing argument after the option -r\n");
+        return EXIT_FAILURE;
+      }
+
+      char* end = nullptr;
+      const uint32_t first = strtoul(argv[i + 1], &end, 0);
+      const uint32_t last = (*end == '-') ? strtoul(end + 1, &end, 0) : first;
+      if (*end != '\0' || last < first) {
+        fprintf(stderr, ERROR "invalid code point range '%s'\n", argv[i + 1]);
+        return EXIT_FAILURE;
+      }
+
+      ranges.emplace_back(first, last);
+      ++i;
     } else if (!stop_parsing_options && strcmp(argv[i], "--") == 0) {
       stop_parsing_options = true;
     } else {
@@ -173,7 +407,11 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  if (!convert(input_file, output_file, font_size))
+  // The space has its own advance in the proportional fonts.
+  if (ranges.empty())
+    ranges.emplace_back(is_v2 ? ' ' : FIRST_CHARACTER, LAST_CHARACTER);
+
+  if (!convert(input_file, output_file, font_size, is_v2, ranges))
     return EXIT_FAILURE;
 
   return EXIT_SUCCESS;
@@ -1,8 +1,18 @@
+# Sends the keyboard and mouse events to the UART keyboard driver (kernel/hardware/uart_keyboard.cpp) through QEMU:
+# python tools/uart-input-server.py [--screen]
+#
+# With --screen, the frames streamed by the kernel configured with CONFIG_SCREEN_STREAM (see
+# kernel/wm/screen_stream.hpp) are shown in a window. QEMU then gets the events from /tmp/uart-input.in and writes
+# the stream to /tmp/uart-input.out (run it with -serial pipe:/tmp/uart-input as usual).
+
 from pynput import mouse, keyboard
 from enum import IntEnum
 from time import sleep
 from os import mkfifo
+import argparse
 import errno
+import struct
+import threading
 import time
 
 last_mouse_position = (0, 0)
@@ -264,15 +274,131 @@ def on_key_release(key: keyboard.Key):
     pipe.write(code.to_bytes(2, byteorder='little', signed=False))
     pipe.flush()
 
-FIFO_PATH = '/tmp/uart-input'
-try:
-    mkfifo(FIFO_PATH)
-except OSError as oe:
-    if oe.errno != errno.EEXIST:
-        raise
+# Keep in sync with kernel/wm/screen_stream.hpp.
+SCREEN_MAGIC = b'SCR'
+SCREEN_PACKET_RESET = 0
+SCREEN_PACKET_RECT = 1
+SCREEN_RESET_FORMAT = '<HH'      # width, height
+SCREEN_RECT_FORMAT = '<HHHHI'    # x, y, width, height, byte size of the data
+TOKEN_SKIP = 0
+TOKEN_REPEAT = 1
+TOKEN_LITERAL = 2
+
+class ScreenViewer:
+    """Decodes the screen stream into an RGB copy of the screen, shown in a Tk window."""
+
+    def __init__(self):
+        self.width = 0
+        self.height = 0
+        self.pixels = bytearray()
+        self.lock = threading.Lock()
+        self.is_dirty = False
+
+    def read_exact(self, stream, size: int) -> bytes:
+        data = b''
+        while len(data) < size:
+            chunk = stream.read(size - len(data))
+            if not chunk:
+                raise EOFError()
+            data += chunk
+        return data
+
+    def decode_rect(self, x: int, y: int, width: int, height: int, data: bytes):
+        offset = 0
+        for row in range(y, y + height):
+            pixel = 3 * (x + self.width * row)
+            end = pixel + 3 * width
+            while pixel < end:
+                token = data[offset]
+                offset += 1
+                operation, count = token >> 6, (token & 0x3f) + 1
+                if operation == TOKEN_SKIP:
+                    pixel += 3 * count
+                elif operation == TOKEN_REPEAT:
+                    value = data[offset:offset + 3]
+                    offset += 3
+                    for _ in range(count):
+                        for c in range(3):
+                            self.pixels[pixel + c] ^= value[c]
+                        pixel += 3
+                else:
+                    for _ in range(count):
+                        for c in range(3):
+                            self.pixels[pixel + c] ^= data[offset + c]
+                        offset += 3
+                        pixel += 3
+
+    def decode(self, stream):
+        """Decodes the packets read from the stream, until it is closed."""
+        window = b''
+        while True:
+            # Skip what does not look like a packet (the stream may be joined in the middle of one).
+            window = (window + self.read_exact(stream, 1))[-len(SCREEN_MAGIC):]
+            if window != SCREEN_MAGIC:
+                continue
+
+            window = b''
+            packet_type = self.read_exact(stream, 1)[0]
+            if packet_type == SCREEN_PACKET_RESET:
+                width, height = struct.unpack(SCREEN_RESET_FORMAT,
+                                              self.read_exact(stream, struct.calcsize(SCREEN_RESET_FORMAT)))
+                with self.lock:
+                    self.width, self.height = width, height
+                    self.pixels = bytearray(3 * width * height)
+                    self.is_dirty = True
+            elif packet_type == SCREEN_PACKET_RECT:
+                x, y, width, height, size = struct.unpack(SCREEN_RECT_FORMAT,
+                                                          self.read_exact(stream, struct.calcsize(SCREEN_RECT_FORMAT)))
+                data = self.read_exact(stream, size)
+                # The rectangles received before the first reset are relative to an unknown screen.
+                if x + width <= self.width and y + height <= self.height:
+                    with self.lock:
+                        self.decode_rect(x, y, width, height, data)
+                        self.is_dirty = True
+
+    def run(self, stream_path: str):
+        import tkinter
+
+        root = tkinter.Tk()
+        root.title('Pika OS screen')
+        photo = tkinter.PhotoImage(width=1, height=1)
+        label = tkinter.Label(root, image=photo)
+        label.pack()
+
+        def refresh():
+            with self.lock:
+                if self.is_dirty and self.width > 0:
+                    header = f'P6 {self.width} {self.height} 255\n'.encode()
+                    photo.configure(data=header + bytes(self.pixels), format='PPM')
+                    self.is_dirty = False
+            root.after(30, refresh)
+
+        def read_stream():
+            with open(stream_path, 'rb', buffering=0) as stream:
+                print(f"Screen stream opened at {stream_path}.")
+                self.decode(stream)
+
+        threading.Thread(target=read_stream, daemon=True).start()
+        refresh()
+        root.mainloop()
+
+parser = argparse.ArgumentParser(description='Sends the keyboard and mouse events to the kernel through QEMU.')
+parser.add_argument('--screen', action='store_true', help='show the screen streamed by the kernel')
+args = parser.parse_args()
 
-with open(FIFO_PATH, 'wb') as pipe:
-    print(f"Pipe opened at {FIFO_PATH}.")
+FIFO_PATH = '/tmp/uart-input'
+# QEMU uses the .in and .out pipes instead of a single one when they exist.
+input_path = FIFO_PATH + '.in' if args.screen else FIFO_PATH
+stream_path = FIFO_PATH + '.out'
+for path in [input_path, stream_path] if args.screen else [input_path]:
+    try:
+        mkfifo(path)
+    except OSError as oe:
+        if oe.errno != errno.EEXIST:
+            raise
+
+with open(input_path, 'wb') as pipe:
+    print(f"Pipe opened at {input_path}.")
 
     mouse_listener = mouse.Listener(on_move=on_mouse_move, on_click=on_mouse_click, on_scroll=on_mouse_scroll)
     mouse_listener.start()
@@ -282,6 +408,12 @@ with open(FIFO_PATH, 'wb') as pipe:
     keyboard_listener.start()
     print("Keyboard listener started.")
 
-    while True:
-        sleep(1)
+    if args.screen:
+        # Ask for a whole frame, the kernel may have streamed the previous ones to nobody.
+        pipe.write(bytes([0x05]))
+        pipe.flush()
+        ScreenViewer().run(stream_path)
+    else:
+        while True:
+            sleep(1)
 